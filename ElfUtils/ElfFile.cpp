@@ -4,12 +4,20 @@
 
 #include "ElfUtils/ElfFile.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <string_view>
 #include <vector>
 
+#include "7zCrc.h"
 #include "OrbitBase/Logging.h"
+#include "Xz.h"
+#include "XzCrc64.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "llvm/DebugInfo/DWARF/DWARFContext.h"
+#include "llvm/DebugInfo/DWARF/DWARFDebugLine.h"
 #include "llvm/Demangle/Demangle.h"
 #include "llvm/Object/ELFObjectFile.h"
 #include "llvm/Object/ObjectFile.h"
@@ -20,6 +28,96 @@ namespace ElfUtils {
 
 namespace {
 
+// Decompresses the content of a .gnu_debugdata section, i.e. an xz stream
+// containing an ELF file with a .symtab, a.k.a. MiniDebugInfo.
+ErrorMessageOr<std::vector<uint8_t>> DecompressXz(
+    llvm::ArrayRef<uint8_t> compressed) {
+  static const bool crc_tables_generated = [] {
+    CrcGenerateTable();
+    Crc64GenerateTable();
+    return true;
+  }();
+  (void)crc_tables_generated;
+
+  ISzAlloc alloc;
+  alloc.Alloc = [](ISzAllocPtr, size_t size) { return malloc(size); };
+  alloc.Free = [](ISzAllocPtr, void* address) { free(address); };
+  CXzUnpacker state;
+  XzUnpacker_Construct(&state, &alloc);
+
+  std::vector<uint8_t> decompressed;
+  size_t src_offset = 0;
+  size_t dst_offset = 0;
+  ECoderStatus status;
+  do {
+    decompressed.resize(
+        std::max<size_t>(decompressed.size() * 2, compressed.size() * 4));
+    size_t src_remaining = compressed.size() - src_offset;
+    size_t dst_remaining = decompressed.size() - dst_offset;
+    const SRes result = XzUnpacker_Code(
+        &state, decompressed.data() + dst_offset, &dst_remaining,
+        compressed.data() + src_offset, &src_remaining, /*srcFinished=*/true,
+        CODER_FINISH_ANY, &status);
+    if (result != SZ_OK) {
+      XzUnpacker_Free(&state);
+      return ErrorMessage(
+          absl::StrFormat("Unable to decompress .gnu_debugdata: error %d.",
+                          static_cast<int>(result)));
+    }
+    src_offset += src_remaining;
+    dst_offset += dst_remaining;
+    if (src_remaining == 0 && dst_remaining == 0) break;
+  } while (status == CODER_STATUS_NOT_FINISHED);
+  const bool stream_finished = XzUnpacker_IsStreamWasFinished(&state) != 0;
+  XzUnpacker_Free(&state);
+  if (!stream_finished) {
+    return ErrorMessage(
+        "Unable to decompress .gnu_debugdata: truncated xz stream.");
+  }
+  decompressed.resize(dst_offset);
+  return decompressed;
+}
+
+// Adds the function symbols in symbols to module_symbols, returns the number
+// of symbols added.
+size_t AddFunctionSymbols(
+    llvm::object::ELFObjectFileBase::elf_symbol_iterator_range symbols,
+    const std::string& file_path, ModuleSymbols* module_symbols) {
+  size_t symbols_added = 0;
+  for (const llvm::object::ELFSymbolRef& symbol_ref : symbols) {
+    if ((symbol_ref.getFlags() & llvm::object::BasicSymbolRef::SF_Undefined) !=
+        0) {
+      continue;
+    }
+    std::string name = symbol_ref.getName() ? symbol_ref.getName().get() : "";
+    std::string demangled_name = llvm::demangle(name);
+
+    // Unknown type - skip and generate a warning
+    if (!symbol_ref.getType()) {
+      LOG("WARNING: Type is not set for symbol \"%s\" in \"%s\", skipping.",
+          name.c_str(), file_path.c_str());
+      continue;
+    }
+
+    // Limit list of symbols to functions. Ignore sections and variables.
+    if (symbol_ref.getType().get() != llvm::object::SymbolRef::ST_Function) {
+      continue;
+    }
+
+    SymbolInfo* symbol_info = module_symbols->add_symbol_infos();
+    symbol_info->set_name(name);
+    symbol_info->set_demangled_name(demangled_name);
+    symbol_info->set_address(symbol_ref.getValue());
+    symbol_info->set_size(symbol_ref.getSize());
+    // TODO (b/154580143) have correct source file and line here
+    symbol_info->set_source_file("");
+    symbol_info->set_source_line(0);
+
+    ++symbols_added;
+  }
+  return symbols_added;
+}
+
 template <typename ElfT>
 class ElfFileImpl : public ElfFile {
  public:
@@ -28,6 +126,7 @@ class ElfFileImpl : public ElfFile {
       llvm::object::OwningBinary<llvm::object::ObjectFile>&& owning_binary);
 
   ErrorMessageOr<ModuleSymbols> LoadSymbols() const override;
+  ErrorMessageOr<LineTable> LoadLineTable() const override;
   ErrorMessageOr<uint64_t> GetLoadBias() const override;
   bool IsAddressInTextSection(uint64_t address) const override;
   bool HasSymtab() const override;
@@ -37,6 +136,9 @@ class ElfFileImpl : public ElfFile {
 
  private:
   void InitSections();
+  // Adds the function symbols of .gnu_debugdata to module_symbols.
+  ErrorMessageOr<size_t> AddDebugdataSymbols(
+      ModuleSymbols* module_symbols) const;
 
   const std::string file_path_;
   llvm::object::OwningBinary<llvm::object::ObjectFile> owning_binary_;
@@ -44,6 +146,8 @@ class ElfFileImpl : public ElfFile {
   std::unique_ptr<typename ElfT::Shdr> text_section_;
   std::string build_id_;
   bool has_symtab_section_;
+  bool has_dynsym_section_;
+  std::unique_ptr<typename ElfT::Shdr> gnu_debugdata_section_;
 };
 
 template <typename ElfT>
@@ -52,7 +156,8 @@ ElfFileImpl<ElfT>::ElfFileImpl(
     llvm::object::OwningBinary<llvm::object::ObjectFile>&& owning_binary)
     : file_path_(file_path),
       owning_binary_(std::move(owning_binary)),
-      has_symtab_section_(false) {
+      has_symtab_section_(false),
+      has_dynsym_section_(false) {
   object_file_ = llvm::dyn_cast<llvm::object::ELFObjectFile<ElfT>>(
       owning_binary_.getBinary());
   InitSections();
@@ -86,6 +191,14 @@ void ElfFileImpl<ElfT>::InitSections() {
       has_symtab_section_ = true;
     }
 
+    if (name.str() == ".dynsym") {
+      has_dynsym_section_ = true;
+    }
+
+    if (name.str() == ".gnu_debugdata") {
+      gnu_debugdata_section_ = std::make_unique<typename ElfT::Shdr>(section);
+    }
+
     if (name.str() == ".note.gnu.build-id" &&
         section.sh_type == llvm::ELF::SHT_NOTE) {
       llvm::Error error = llvm::Error::success();
@@ -119,12 +232,11 @@ bool ElfFileImpl<ElfT>::IsAddressInTextSection(uint64_t address) const {
 
 template <typename ElfT>
 ErrorMessageOr<ModuleSymbols> ElfFileImpl<ElfT>::LoadSymbols() const {
-  // TODO: if we want to use other sections than .symtab in the future for
-  //       example .dynsym, than we have to change this.
-  if (!has_symtab_section_) {
-    return ErrorMessage("ELF file does not have a .symtab section.");
+  if (!has_symtab_section_ && !has_dynsym_section_ && !gnu_debugdata_section_) {
+    return ErrorMessage(
+        "ELF file does not have a .symtab, .dynsym or .gnu_debugdata "
+        "section.");
   }
-  bool symbols_added = false;
 
   OUTCOME_TRY(load_bias, GetLoadBias());
 
@@ -132,38 +244,31 @@ ErrorMessageOr<ModuleSymbols> ElfFileImpl<ElfT>::LoadSymbols() const {
   module_symbols.set_load_bias(load_bias);
   module_symbols.set_symbols_file_path(file_path_);
 
-  for (const llvm::object::ELFSymbolRef& symbol_ref : object_file_->symbols()) {
-    if ((symbol_ref.getFlags() & llvm::object::BasicSymbolRef::SF_Undefined) !=
-        0) {
-      continue;
-    }
-    std::string name = symbol_ref.getName() ? symbol_ref.getName().get() : "";
-    std::string demangled_name = llvm::demangle(name);
-
-    // Unknown type - skip and generate a warning
-    if (!symbol_ref.getType()) {
-      LOG("WARNING: Type is not set for symbol \"%s\" in \"%s\", skipping.",
-          name.c_str(), file_path_.c_str());
-      continue;
-    }
-
-    // Limit list of symbols to functions. Ignore sections and variables.
-    if (symbol_ref.getType().get() != llvm::object::SymbolRef::ST_Function) {
-      continue;
+  size_t symbols_added = 0;
+  if (has_symtab_section_) {
+    symbols_added += AddFunctionSymbols(object_file_->symbols(), file_path_,
+                                        &module_symbols);
+  } else {
+    // Stripped binaries still have the exported functions in .dynsym, and
+    // possibly the others in .gnu_debugdata.
+    symbols_added += AddFunctionSymbols(
+        object_file_->getDynamicSymbolIterators(), file_path_,
+        &module_symbols);
+    if (gnu_debugdata_section_) {
+      ErrorMessageOr<size_t> debugdata_symbols_added =
+          AddDebugdataSymbols(&module_symbols);
+      if (debugdata_symbols_added) {
+        symbols_added += debugdata_symbols_added.value();
+      } else {
+        LOG("WARNING: Unable to load symbols from .gnu_debugdata of \"%s\": "
+            "%s",
+            file_path_.c_str(),
+            debugdata_symbols_added.error().message().c_str());
+      }
     }
-
-    SymbolInfo* symbol_info = module_symbols.add_symbol_infos();
-    symbol_info->set_name(name);
-    symbol_info->set_demangled_name(demangled_name);
-    symbol_info->set_address(symbol_ref.getValue());
-    symbol_info->set_size(symbol_ref.getSize());
-    // TODO (b/154580143) have correct source file and line here
-    symbol_info->set_source_file("");
-    symbol_info->set_source_line(0);
-
-    symbols_added = true;
   }
-  if (!symbols_added) {
+
+  if (symbols_added == 0) {
     return ErrorMessage(
         "Unable to load symbols from ELF file, not even a single symbol of "
         "type function found.");
@@ -171,6 +276,97 @@ ErrorMessageOr<ModuleSymbols> ElfFileImpl<ElfT>::LoadSymbols() const {
   return module_symbols;
 }
 
+template <typename ElfT>
+ErrorMessageOr<size_t> ElfFileImpl<ElfT>::AddDebugdataSymbols(
+    ModuleSymbols* module_symbols) const {
+  const llvm::object::ELFFile<ElfT>* elf_file = object_file_->getELFFile();
+  llvm::Expected<llvm::ArrayRef<uint8_t>> contents_or_error =
+      elf_file->getSectionContents(gnu_debugdata_section_.get());
+  if (!contents_or_error) {
+    return ErrorMessage(llvm::toString(contents_or_error.takeError()));
+  }
+  OUTCOME_TRY(decompressed, DecompressXz(contents_or_error.get()));
+
+  const llvm::MemoryBufferRef buffer_ref(
+      llvm::StringRef(reinterpret_cast<const char*>(decompressed.data()),
+                      decompressed.size()),
+      llvm::StringRef(".gnu_debugdata"));
+  llvm::Expected<std::unique_ptr<llvm::object::ObjectFile>>
+      object_file_or_error =
+          llvm::object::ObjectFile::createObjectFile(buffer_ref);
+  if (!object_file_or_error) {
+    return ErrorMessage(llvm::toString(object_file_or_error.takeError()));
+  }
+  auto* debugdata_object_file =
+      llvm::dyn_cast<llvm::object::ELFObjectFile<ElfT>>(
+          object_file_or_error.get().get());
+  if (debugdata_object_file == nullptr) {
+    return ErrorMessage("not an ELF file of the same class and endianness.");
+  }
+  // MiniDebugInfo has the same layout as the file it is embedded in, so the
+  // addresses need no adjustment.
+  return AddFunctionSymbols(debugdata_object_file->symbols(), file_path_,
+                            module_symbols);
+}
+
+template <typename ElfT>
+ErrorMessageOr<LineTable> ElfFileImpl<ElfT>::LoadLineTable() const {
+  std::unique_ptr<llvm::DWARFContext> dwarf_context =
+      llvm::DWARFContext::create(*object_file_);
+  if (dwarf_context->getNumCompileUnits() == 0) {
+    return ErrorMessage(absl::StrFormat(
+        "ELF file \"%s\" does not have debug info.", file_path_));
+  }
+
+  std::vector<std::string> file_names;
+  absl::flat_hash_map<std::string, uint32_t> file_indices;
+  std::vector<LineTable::Row> rows;
+  for (const std::unique_ptr<llvm::DWARFUnit>& unit :
+       dwarf_context->compile_units()) {
+    const llvm::DWARFDebugLine::LineTable* unit_line_table =
+        dwarf_context->getLineTableForUnit(unit.get());
+    if (unit_line_table == nullptr) continue;
+
+    // The file indices of the unit's table to the ones of the whole file.
+    absl::flat_hash_map<uint64_t, uint32_t> unit_file_indices;
+    auto get_file_index = [&](uint64_t unit_file_index) {
+      auto it = unit_file_indices.find(unit_file_index);
+      if (it != unit_file_indices.end()) return it->second;
+      std::string file_name;
+      unit_line_table->getFileNameByIndex(
+          unit_file_index, unit->getCompilationDir(),
+          llvm::DILineInfoSpecifier::FileLineInfoKind::AbsoluteFilePath,
+          file_name);
+      auto [file_it, inserted] =
+          file_indices.try_emplace(file_name, file_names.size());
+      if (inserted) file_names.push_back(std::move(file_name));
+      unit_file_indices.emplace(unit_file_index, file_it->second);
+      return file_it->second;
+    };
+
+    bool in_sequence = false;
+    bool skip_sequence = false;
+    for (const llvm::DWARFDebugLine::Row& unit_row : unit_line_table->Rows) {
+      if (!in_sequence) {
+        // The sequences of functions removed by the linker begin at 0.
+        skip_sequence = unit_row.Address.Address == 0;
+        in_sequence = true;
+      }
+      if (unit_row.EndSequence) in_sequence = false;
+      if (skip_sequence) continue;
+
+      LineTable::Row row;
+      row.address = unit_row.Address.Address;
+      if (!unit_row.EndSequence) {
+        row.file_index = get_file_index(unit_row.File);
+        row.line = unit_row.Line;
+      }
+      rows.push_back(row);
+    }
+  }
+  return LineTable(std::move(file_names), std::move(rows));
+}
+
 template <typename ElfT>
 ErrorMessageOr<uint64_t> ElfFileImpl<ElfT>::GetLoadBias() const {
   const llvm::object::ELFFile<ElfT>* elf_file = object_file_->getELFFile();
@@ -7,6 +7,8 @@
 #include "ElfUtils/ElfFile.h"
 
 extern "C" int LLVMFuzzerTestOneInput(uint8_t* buf, size_t len) {
-  (void) ElfUtils::ElfFile::CreateFromBuffer("INMEMORY", buf, len);
+  auto elf_file = ElfUtils::ElfFile::CreateFromBuffer("INMEMORY", buf, len);
+  // Also exercises the .dynsym and .gnu_debugdata fallbacks.
+  if (elf_file) (void)elf_file.value()->LoadSymbols();
   return 0;
 }
\ No newline at end of file
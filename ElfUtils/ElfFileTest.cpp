@@ -5,6 +5,7 @@
 #include <gmock/gmock-matchers.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <fstream>
 #include <utility>
 
@@ -54,6 +55,101 @@ TEST(ElfFile, LoadSymbols) {
   EXPECT_EQ(symbol_info.source_line(), 0);
 }
 
+TEST(ElfFile, LoadSymbolsFromDynsym) {
+  std::string executable_path = Path::GetExecutablePath();
+  std::string file_path = executable_path + "testdata/stripped_lib_elf";
+
+  auto elf_file = ElfFile::Create(file_path);
+  ASSERT_TRUE(elf_file) << elf_file.error().message();
+  EXPECT_FALSE(elf_file.value()->HasSymtab());
+
+  const auto symbols_result = elf_file.value()->LoadSymbols();
+  ASSERT_TRUE(symbols_result) << symbols_result.error().message();
+  EXPECT_EQ(symbols_result.value().symbols_file_path(), file_path);
+  ASSERT_EQ(symbols_result.value().symbol_infos_size(), 1);
+  const SymbolInfo& symbol_info = symbols_result.value().symbol_infos(0);
+  EXPECT_EQ(symbol_info.name(), "ExportedFunction");
+  EXPECT_EQ(symbol_info.address(), 0x10fe);
+  EXPECT_EQ(symbol_info.size(), 9);
+}
+
+TEST(ElfFile, LoadSymbolsFromDynsymAndGnuDebugdata) {
+  std::string executable_path = Path::GetExecutablePath();
+  std::string file_path =
+      executable_path + "testdata/stripped_lib_minidebuginfo_elf";
+
+  auto elf_file = ElfFile::Create(file_path);
+  ASSERT_TRUE(elf_file) << elf_file.error().message();
+  EXPECT_FALSE(elf_file.value()->HasSymtab());
+
+  const auto symbols_result = elf_file.value()->LoadSymbols();
+  ASSERT_TRUE(symbols_result) << symbols_result.error().message();
+  EXPECT_EQ(symbols_result.value().symbols_file_path(), file_path);
+  EXPECT_EQ(symbols_result.value().load_bias(), 0);
+
+  std::vector<SymbolInfo> symbol_infos(
+      symbols_result.value().symbol_infos().begin(),
+      symbols_result.value().symbol_infos().end());
+  // ExportedFunction from .dynsym, and LocalFunction, _init, _fini and four
+  // compiler generated functions from .gnu_debugdata.
+  EXPECT_EQ(symbol_infos.size(), 8);
+  EXPECT_EQ(symbol_infos[0].name(), "ExportedFunction");
+  auto local_function =
+      std::find_if(symbol_infos.begin(), symbol_infos.end(),
+                   [](const SymbolInfo& symbol_info) {
+                     return symbol_info.name() == "LocalFunction";
+                   });
+  ASSERT_NE(local_function, symbol_infos.end());
+  EXPECT_EQ(local_function->address(), 0x10f9);
+  EXPECT_EQ(local_function->size(), 5);
+}
+
+TEST(ElfFile, LoadSymbolsWithoutFunctions) {
+  std::string executable_path = Path::GetExecutablePath();
+  // Its .dynsym only has undefined functions.
+  std::string file_path = executable_path + "testdata/no_symbols_elf";
+
+  auto elf_file = ElfFile::Create(file_path);
+  ASSERT_TRUE(elf_file) << elf_file.error().message();
+  const auto symbols_result = elf_file.value()->LoadSymbols();
+  ASSERT_FALSE(symbols_result);
+  EXPECT_THAT(symbols_result.error().message(),
+              testing::HasSubstr("not even a single symbol"));
+}
+
+TEST(ElfFile, LoadLineTable) {
+  std::string executable_path = Path::GetExecutablePath();
+  std::string file_path = executable_path + "testdata/no_symbols_elf.debug";
+
+  auto elf_file = ElfFile::Create(file_path);
+  ASSERT_TRUE(elf_file) << elf_file.error().message();
+  const auto line_table = elf_file.value()->LoadLineTable();
+  ASSERT_TRUE(line_table) << line_table.error().message();
+
+  // The first instructions of main.
+  auto line_info = line_table.value().FindLine(0x401290);
+  ASSERT_TRUE(line_info);
+  EXPECT_THAT(*line_info->file, testing::EndsWith("hellocpp/main.cpp"));
+  EXPECT_EQ(line_info->line, 8);
+  line_info = line_table.value().FindLine(0x4012a4);
+  ASSERT_TRUE(line_info);
+  EXPECT_EQ(line_info->line, 10);
+
+  EXPECT_FALSE(line_table.value().FindLine(0x400000));
+}
+
+TEST(ElfFile, LoadLineTableWithoutDebugInfo) {
+  std::string executable_path = Path::GetExecutablePath();
+  std::string file_path = executable_path + "testdata/hello_world_elf";
+
+  auto elf_file = ElfFile::Create(file_path);
+  ASSERT_TRUE(elf_file) << elf_file.error().message();
+  const auto line_table = elf_file.value()->LoadLineTable();
+  ASSERT_FALSE(line_table);
+  EXPECT_THAT(line_table.error().message(),
+              testing::HasSubstr("does not have debug info"));
+}
+
 TEST(ElfFile, IsAddressInTextSection) {
   std::string executable_path = Path::GetExecutablePath();
   std::string test_elf_file = executable_path + "/testdata/hello_world_elf";
@@ -0,0 +1,187 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ElfUtils/ElfSymbols.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "OrbitBase/Logging.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "llvm/BinaryFormat/ELF.h"
+#include "llvm/Demangle/Demangle.h"
+#include "llvm/Object/ELF.h"
+
+namespace ElfUtils {
+
+template <typename ElfT>
+ErrorMessageOr<void> ElfSymbols::ReadSymbols() {
+  llvm::Expected<llvm::object::ELFFile<ElfT>> elf_file_or_error =
+      llvm::object::ELFFile<ElfT>::create(buffer_->getBuffer());
+  if (!elf_file_or_error) {
+    return ErrorMessage(
+        absl::StrFormat("Unable to load ELF file \"%s\": %s", file_path_,
+                        llvm::toString(elf_file_or_error.takeError())));
+  }
+  const llvm::object::ELFFile<ElfT>& elf_file = elf_file_or_error.get();
+
+  llvm::Expected<typename ElfT::ShdrRange> sections_or_error =
+      elf_file.sections();
+  if (!sections_or_error) {
+    return ErrorMessage(
+        absl::StrFormat("Unable to load sections of ELF file \"%s\": %s",
+                        file_path_,
+                        llvm::toString(sections_or_error.takeError())));
+  }
+
+  const typename ElfT::Shdr* symtab_section = nullptr;
+  for (const typename ElfT::Shdr& section : sections_or_error.get()) {
+    if (section.sh_type == llvm::ELF::SHT_SYMTAB) {
+      symtab_section = &section;
+    }
+    if (section.sh_type != llvm::ELF::SHT_NOTE) continue;
+    llvm::Expected<llvm::StringRef> name_or_error =
+        elf_file.getSectionName(&section);
+    if (!name_or_error) {
+      llvm::consumeError(name_or_error.takeError());
+      continue;
+    }
+    if (name_or_error.get() != ".note.gnu.build-id") continue;
+    llvm::Error error = llvm::Error::success();
+    for (const typename ElfT::Note& note : elf_file.notes(section, error)) {
+      if (note.getType() != llvm::ELF::NT_GNU_BUILD_ID) continue;
+      for (const uint8_t& byte : note.getDesc()) {
+        absl::StrAppend(&build_id_, absl::Hex(byte, absl::kZeroPad2));
+      }
+    }
+    if (error) {
+      LOG("Error while reading elf notes");
+      llvm::consumeError(std::move(error));
+    }
+  }
+  if (symtab_section == nullptr) {
+    return ErrorMessage("ELF file does not have a .symtab section.");
+  }
+
+  llvm::Expected<typename ElfT::PhdrRange> program_headers =
+      elf_file.program_headers();
+  if (!program_headers) {
+    llvm::consumeError(program_headers.takeError());
+    return ErrorMessage(absl::StrFormat(
+        "Unable to get load bias of ELF file: \"%s\". No program headers "
+        "found.",
+        file_path_));
+  }
+  uint64_t min_vaddr = UINT64_MAX;
+  for (const typename ElfT::Phdr& phdr : program_headers.get()) {
+    if (phdr.p_type != llvm::ELF::PT_LOAD) continue;
+    min_vaddr = std::min<uint64_t>(min_vaddr, phdr.p_vaddr);
+  }
+  if (min_vaddr == UINT64_MAX) {
+    return ErrorMessage(absl::StrFormat(
+        "Unable to get load bias of ELF file: \"%s\". No PT_LOAD program "
+        "headers found.",
+        file_path_));
+  }
+  load_bias_ = min_vaddr;
+
+  llvm::Expected<typename ElfT::SymRange> symbols_or_error =
+      elf_file.symbols(symtab_section);
+  llvm::Expected<llvm::StringRef> string_table_or_error =
+      elf_file.getStringTableForSymtab(*symtab_section);
+  if (!symbols_or_error || !string_table_or_error) {
+    llvm::consumeError(symbols_or_error.takeError());
+    llvm::consumeError(string_table_or_error.takeError());
+    return ErrorMessage(absl::StrFormat(
+        "Unable to read the .symtab section of ELF file \"%s\".", file_path_));
+  }
+
+  symbols_.reserve(symbols_or_error.get().size());
+  for (const typename ElfT::Sym& symbol : symbols_or_error.get()) {
+    // Limit list of symbols to functions, as ElfFile::LoadSymbols.
+    if (symbol.isUndefined() || symbol.getType() != llvm::ELF::STT_FUNC) {
+      continue;
+    }
+    llvm::Expected<llvm::StringRef> name_or_error =
+        symbol.getName(string_table_or_error.get());
+    std::string_view name;
+    if (name_or_error) {
+      name = std::string_view(name_or_error.get().data(),
+                              name_or_error.get().size());
+    } else {
+      llvm::consumeError(name_or_error.takeError());
+    }
+    symbols_.push_back({name, symbol.st_value, symbol.st_size});
+  }
+  symbols_.shrink_to_fit();
+  if (symbols_.empty()) {
+    return ErrorMessage(
+        "Unable to load symbols from ELF file, not even a single symbol of "
+        "type function found.");
+  }
+  return outcome::success();
+}
+
+ErrorMessageOr<std::unique_ptr<ElfSymbols>> ElfSymbols::Load(
+    std::string_view file_path) {
+  std::unique_ptr<ElfSymbols> elf_symbols{new ElfSymbols()};
+  elf_symbols->file_path_ = std::string(file_path);
+
+  // Large files are mapped rather than read.
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer_or_error =
+      llvm::MemoryBuffer::getFile(elf_symbols->file_path_, /*FileSize=*/-1,
+                                  /*RequiresNullTerminator=*/false);
+  if (!buffer_or_error) {
+    return ErrorMessage(absl::StrFormat("Unable to load ELF file \"%s\": %s",
+                                        file_path,
+                                        buffer_or_error.getError().message()));
+  }
+  elf_symbols->buffer_ = std::move(buffer_or_error.get());
+  if (!elf_symbols->buffer_->getBuffer().startswith(llvm::ElfMagic)) {
+    return ErrorMessage(absl::StrFormat(
+        "Unable to load ELF file \"%s\": not an ELF file.", file_path));
+  }
+
+  const auto [elf_class, elf_data] =
+      llvm::object::getElfArchType(elf_symbols->buffer_->getBuffer());
+  if (elf_data != llvm::ELF::ELFDATA2LSB) {
+    return ErrorMessage(absl::StrFormat(
+        "Unable to load \"%s\": Big-endian architectures are not supported.",
+        file_path));
+  }
+  ErrorMessageOr<void> result = outcome::success();
+  if (elf_class == llvm::ELF::ELFCLASS64) {
+    result = elf_symbols->ReadSymbols<llvm::object::ELF64LE>();
+  } else if (elf_class == llvm::ELF::ELFCLASS32) {
+    result = elf_symbols->ReadSymbols<llvm::object::ELF32LE>();
+  } else {
+    return ErrorMessage(absl::StrFormat(
+        "Unable to load ELF file \"%s\": invalid ELF class.", file_path));
+  }
+  if (!result) {
+    return result.error();
+  }
+  return elf_symbols;
+}
+
+ModuleSymbols ElfSymbols::ToModuleSymbols() const {
+  ModuleSymbols module_symbols;
+  module_symbols.set_load_bias(load_bias_);
+  module_symbols.set_symbols_file_path(file_path_);
+  module_symbols.mutable_symbol_infos()->Reserve(symbols_.size());
+  for (const Symbol& symbol : symbols_) {
+    SymbolInfo* symbol_info = module_symbols.add_symbol_infos();
+    symbol_info->set_name(symbol.name.data(), symbol.name.size());
+    symbol_info->set_demangled_name(llvm::demangle(std::string(symbol.name)));
+    symbol_info->set_address(symbol.address);
+    symbol_info->set_size(symbol.size);
+    // TODO (b/154580143) have correct source file and line here
+    symbol_info->set_source_file("");
+    symbol_info->set_source_line(0);
+  }
+  return module_symbols;
+}
+
+}  // namespace ElfUtils
@@ -0,0 +1,85 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gmock/gmock-matchers.h>
+#include <gtest/gtest.h>
+
+#include <utility>
+
+#include "ElfUtils/ElfFile.h"
+#include "ElfUtils/ElfSymbols.h"
+#include "Path.h"
+#include "absl/strings/ascii.h"
+#include "symbol.pb.h"
+
+using ElfUtils::ElfFile;
+using ElfUtils::ElfSymbols;
+
+TEST(ElfSymbols, Load) {
+  std::string file_path =
+      Path::GetExecutablePath() + "testdata/hello_world_elf";
+
+  auto elf_symbols_result = ElfSymbols::Load(file_path);
+  ASSERT_TRUE(elf_symbols_result) << elf_symbols_result.error().message();
+  std::unique_ptr<ElfSymbols> elf_symbols =
+      std::move(elf_symbols_result.value());
+
+  EXPECT_EQ(elf_symbols->GetFilePath(), file_path);
+  EXPECT_EQ(elf_symbols->GetBuildId(),
+            "d12d54bc5b72ccce54a408bdeda65e2530740ac8");
+  EXPECT_EQ(elf_symbols->GetLoadBias(), 0);
+
+  const std::vector<ElfSymbols::Symbol>& symbols = elf_symbols->GetSymbols();
+  ASSERT_EQ(symbols.size(), 10);
+  EXPECT_EQ(symbols[0].name, "deregister_tm_clones");
+  EXPECT_EQ(symbols[0].address, 0x1080);
+  EXPECT_EQ(symbols[0].size, 0);
+  EXPECT_EQ(symbols[9].name, "main");
+  EXPECT_EQ(symbols[9].address, 0x1135);
+  EXPECT_EQ(symbols[9].size, 35);
+}
+
+TEST(ElfSymbols, ToModuleSymbolsMatchesElfFile) {
+  std::string file_path =
+      Path::GetExecutablePath() + "testdata/hello_world_elf";
+
+  auto elf_symbols = ElfSymbols::Load(file_path);
+  ASSERT_TRUE(elf_symbols) << elf_symbols.error().message();
+  auto elf_file = ElfFile::Create(file_path);
+  ASSERT_TRUE(elf_file) << elf_file.error().message();
+  const auto expected_result = elf_file.value()->LoadSymbols();
+  ASSERT_TRUE(expected_result);
+
+  const ModuleSymbols module_symbols = elf_symbols.value()->ToModuleSymbols();
+  const ModuleSymbols& expected = expected_result.value();
+  EXPECT_EQ(module_symbols.load_bias(), expected.load_bias());
+  EXPECT_EQ(module_symbols.symbols_file_path(), expected.symbols_file_path());
+  ASSERT_EQ(module_symbols.symbol_infos_size(), expected.symbol_infos_size());
+  for (int i = 0; i < expected.symbol_infos_size(); ++i) {
+    const SymbolInfo& symbol_info = module_symbols.symbol_infos(i);
+    const SymbolInfo& expected_info = expected.symbol_infos(i);
+    EXPECT_EQ(symbol_info.name(), expected_info.name());
+    EXPECT_EQ(symbol_info.demangled_name(), expected_info.demangled_name());
+    EXPECT_EQ(symbol_info.address(), expected_info.address());
+    EXPECT_EQ(symbol_info.size(), expected_info.size());
+  }
+}
+
+TEST(ElfSymbols, LoadWithoutSymtab) {
+  std::string file_path = Path::GetExecutablePath() + "testdata/no_symbols_elf";
+
+  auto elf_symbols = ElfSymbols::Load(file_path);
+  ASSERT_FALSE(elf_symbols);
+  EXPECT_THAT(elf_symbols.error().message(),
+              testing::HasSubstr("does not have a .symtab section"));
+}
+
+TEST(ElfSymbols, LoadNonExistingFile) {
+  std::string file_path = Path::GetExecutablePath() + "testdata/does_not_exist";
+
+  auto elf_symbols = ElfSymbols::Load(file_path);
+  ASSERT_FALSE(elf_symbols);
+  EXPECT_THAT(absl::AsciiStrToLower(elf_symbols.error().message()),
+              testing::HasSubstr("no such file or directory"));
+}
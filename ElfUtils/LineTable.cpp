@@ -0,0 +1,55 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ElfUtils/LineTable.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace ElfUtils {
+
+LineTable::LineTable(std::vector<std::string> file_names,
+                     std::vector<Row> rows)
+    : file_names_(std::move(file_names)) {
+  // A sequence that begins where another one ends takes precedence over the
+  // end of the other one.
+  std::stable_sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+    if (a.address != b.address) return a.address < b.address;
+    return a.file_index == kNoFile && b.file_index != kNoFile;
+  });
+  rows_.reserve(rows.size());
+  for (const Row& row : rows) {
+    if (!rows_.empty() && rows_.back().address == row.address) {
+      rows_.back() = row;
+    } else if (rows_.empty() || rows_.back().file_index != row.file_index ||
+               rows_.back().line != row.line) {
+      rows_.push_back(row);
+      continue;
+    }
+    // The row replaced one or was dropped, it may now repeat the previous.
+    if (rows_.size() >= 2 &&
+        rows_[rows_.size() - 2].file_index == rows_.back().file_index &&
+        rows_[rows_.size() - 2].line == rows_.back().line) {
+      rows_.pop_back();
+    }
+  }
+  while (!rows_.empty() && rows_.front().file_index == kNoFile) {
+    rows_.erase(rows_.begin());
+  }
+  rows_.shrink_to_fit();
+}
+
+std::optional<LineTable::LineInfo> LineTable::FindLine(
+    uint64_t address) const {
+  auto it = std::upper_bound(
+      rows_.begin(), rows_.end(), address,
+      [](uint64_t address, const Row& row) { return address < row.address; });
+  if (it == rows_.begin()) return std::nullopt;
+  --it;
+  // Also rejects the addresses after the last row, which ends a sequence.
+  if (it->file_index >= file_names_.size()) return std::nullopt;
+  return LineInfo{&file_names_[it->file_index], it->line};
+}
+
+}  // namespace ElfUtils
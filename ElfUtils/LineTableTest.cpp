@@ -0,0 +1,59 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "ElfUtils/LineTable.h"
+
+using ElfUtils::LineTable;
+
+TEST(LineTable, FindLine) {
+  // Two sequences, out of order, the second one begins where the first one
+  // ends.
+  LineTable line_table({"a.cpp", "b.cpp"}, {{0x200, 1, 7},
+                                            {0x208, 1, 8},
+                                            {0x210, LineTable::kNoFile, 0},
+                                            {0x100, 0, 3},
+                                            {0x104, 0, 3},
+                                            {0x108, 0, 4},
+                                            {0x200, LineTable::kNoFile, 0}});
+
+  EXPECT_FALSE(line_table.FindLine(0xff));
+  EXPECT_EQ(*line_table.FindLine(0x100)->file, "a.cpp");
+  EXPECT_EQ(line_table.FindLine(0x106)->line, 3);
+  EXPECT_EQ(line_table.FindLine(0x1ff)->line, 4);
+  EXPECT_EQ(*line_table.FindLine(0x200)->file, "b.cpp");
+  EXPECT_EQ(line_table.FindLine(0x200)->line, 7);
+  EXPECT_EQ(line_table.FindLine(0x20f)->line, 8);
+  EXPECT_FALSE(line_table.FindLine(0x210));
+  EXPECT_FALSE(line_table.FindLine(0x1000));
+}
+
+TEST(LineTable, DropsRedundantRows) {
+  LineTable line_table({"a.cpp"}, {{0x100, 0, 3},
+                                   {0x104, 0, 3},
+                                   {0x108, 0, 5},
+                                   {0x108, 0, 3},
+                                   {0x110, LineTable::kNoFile, 0},
+                                   {0x120, LineTable::kNoFile, 0}});
+
+  const std::vector<LineTable::Row>& rows = line_table.GetRows();
+  ASSERT_EQ(rows.size(), 2);
+  EXPECT_EQ(rows[0].address, 0x100);
+  EXPECT_EQ(rows[0].line, 3);
+  EXPECT_EQ(rows[1].address, 0x110);
+  EXPECT_EQ(rows[1].file_index, LineTable::kNoFile);
+}
+
+TEST(LineTable, Empty) {
+  LineTable line_table;
+  EXPECT_TRUE(line_table.IsEmpty());
+  EXPECT_FALSE(line_table.FindLine(0));
+
+  LineTable only_ends({}, {{0x100, LineTable::kNoFile, 0}});
+  EXPECT_TRUE(only_ends.IsEmpty());
+}
@@ -9,6 +9,7 @@
 #include <optional>
 #include <vector>
 
+#include "ElfUtils/LineTable.h"
 #include "OrbitBase/Result.h"
 #include "llvm/Object/Binary.h"
 #include "llvm/Object/ObjectFile.h"
@@ -21,7 +22,11 @@ class ElfFile {
   ElfFile() = default;
   virtual ~ElfFile() = default;
 
+  // Loads the function symbols of .symtab or, for stripped files, the ones of
+  // .dynsym and of the MiniDebugInfo in .gnu_debugdata, if any.
   virtual ErrorMessageOr<ModuleSymbols> LoadSymbols() const = 0;
+  // Indexes the .debug_line tables of all compile units, by ELF address.
+  virtual ErrorMessageOr<LineTable> LoadLineTable() const = 0;
   // Background and some terminology
   // When an elf file is loaded to memory it has its load segments
   // (segments of PT_LOAD type from program headers) mapped to some
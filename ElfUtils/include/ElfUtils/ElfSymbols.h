@@ -0,0 +1,63 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ELF_UTILS_ELF_SYMBOLS_H_
+#define ELF_UTILS_ELF_SYMBOLS_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "OrbitBase/Result.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "symbol.pb.h"
+
+namespace ElfUtils {
+
+// A lean alternative to ElfFile::LoadSymbols, for large debug files: the file
+// is memory-mapped, and the function symbols of its .symtab are read directly
+// into a flat array whose names point into the mapping, without an
+// llvm::object::ObjectFile nor a string per symbol. ModuleSymbols are only
+// created by ToModuleSymbols, at the RPC boundary.
+class ElfSymbols {
+ public:
+  struct Symbol {
+    // Mangled, in the mapping of the file.
+    std::string_view name;
+    uint64_t address = 0;
+    uint64_t size = 0;
+  };
+
+  // Same errors as ElfFile::Create followed by ElfFile::LoadSymbols.
+  static ErrorMessageOr<std::unique_ptr<ElfSymbols>> Load(
+      std::string_view file_path);
+
+  [[nodiscard]] const std::vector<Symbol>& GetSymbols() const {
+    return symbols_;
+  }
+  [[nodiscard]] uint64_t GetLoadBias() const { return load_bias_; }
+  [[nodiscard]] const std::string& GetBuildId() const { return build_id_; }
+  [[nodiscard]] const std::string& GetFilePath() const { return file_path_; }
+
+  // The same ModuleSymbols as ElfFile::LoadSymbols, with demangled names.
+  [[nodiscard]] ModuleSymbols ToModuleSymbols() const;
+
+ private:
+  ElfSymbols() = default;
+  // For ElfT, as told by the header of the file in buffer_.
+  template <typename ElfT>
+  ErrorMessageOr<void> ReadSymbols();
+
+  std::string file_path_;
+  std::unique_ptr<llvm::MemoryBuffer> buffer_;
+  std::vector<Symbol> symbols_;
+  uint64_t load_bias_ = 0;
+  std::string build_id_;
+};
+
+}  // namespace ElfUtils
+
+#endif  // ELF_UTILS_ELF_SYMBOLS_H_
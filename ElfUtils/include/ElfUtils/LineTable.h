@@ -0,0 +1,57 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ELF_UTILS_LINE_TABLE_H_
+#define ELF_UTILS_LINE_TABLE_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace ElfUtils {
+
+// A compact address to source line table, built once from the DWARF line
+// tables of a file and queried by binary search. Each row covers the
+// addresses up to the next one.
+class LineTable {
+ public:
+  // The file_index of the rows that end a sequence, where the addresses up
+  // to the next row have no source line.
+  static constexpr uint32_t kNoFile = UINT32_MAX;
+
+  struct Row {
+    uint64_t address = 0;
+    uint32_t file_index = kNoFile;
+    uint32_t line = 0;
+  };
+
+  struct LineInfo {
+    const std::string* file = nullptr;
+    uint32_t line = 0;
+  };
+
+  LineTable() = default;
+  // The rows of a sequence are in order, the sequences in any order. Rows
+  // with the same address as the next one or with the same line as the
+  // previous one are dropped.
+  LineTable(std::vector<std::string> file_names, std::vector<Row> rows);
+
+  [[nodiscard]] std::optional<LineInfo> FindLine(uint64_t address) const;
+
+  [[nodiscard]] bool IsEmpty() const { return rows_.empty(); }
+  [[nodiscard]] const std::vector<std::string>& GetFileNames() const {
+    return file_names_;
+  }
+  // Sorted by address.
+  [[nodiscard]] const std::vector<Row>& GetRows() const { return rows_; }
+
+ private:
+  std::vector<std::string> file_names_;
+  std::vector<Row> rows_;
+};
+
+}  // namespace ElfUtils
+
+#endif  // ELF_UTILS_LINE_TABLE_H_
@@ -16,8 +16,27 @@
 // To disable manual instrumentation macros, define ORBIT_API_ENABLED as 0.
 #define ORBIT_API_ENABLED 1
 
+// On Linux, define ORBIT_API_SHARED_MEMORY as 1 before including this header to
+// report ORBIT_SCOPE, ORBIT_START and ORBIT_STOP through a ring buffer in
+// shared memory per thread instead, which OrbitService reads while it captures
+// with manual_instrumentation_shared_memory. Each costs a few tens of
+// nanoseconds rather than the trap of a dynamically instrumented function. The
+// other macros still call the functions that are instrumented.
+#ifndef ORBIT_API_SHARED_MEMORY
+#define ORBIT_API_SHARED_MEMORY 0
+#endif
+
 #if ORBIT_API_ENABLED
 
+#if ORBIT_API_SHARED_MEMORY
+
+#define ORBIT_SCOPE(name) \
+  orbit_api::shared_memory::Scope ORBIT_VAR(ORBIT_NAME_KEY(name))
+#define ORBIT_START(name) orbit_api::shared_memory::Begin(ORBIT_NAME_KEY(name))
+#define ORBIT_STOP() orbit_api::shared_memory::End()
+
+#else
+
 // ORBIT_SCOPE: profile current scope.
 #define ORBIT_SCOPE(name) orbit_api::Scope ORBIT_VAR(ORBIT_STR(name))
 
@@ -25,10 +44,16 @@
 #define ORBIT_START(name) orbit_api::Start(ORBIT_STR(name))
 #define ORBIT_STOP() orbit_api::Stop()
 
+#endif
+
 // ORBIT_START_ASYNC/ORBIT_STOP_ASYNC: profile time span across threads.
 #define ORBIT_START_ASYNC(name, id) orbit_api::StartAsync(ORBIT_STR(name), id)
 #define ORBIT_STOP_ASYNC(id) orbit_api::StopAsync(id)
 
+// ORBIT_FRAME_MARKER: mark the start of a frame, e.g., once per iteration of
+// the main loop. The frames of a name are between its consecutive markers.
+#define ORBIT_FRAME_MARKER(name) orbit_api::FrameMarker(ORBIT_STR(name))
+
 // ORBIT_[type]: graph variables.
 #define ORBIT_INT(name, val) orbit_api::TrackInt(ORBIT_STR(name), val)
 #define ORBIT_INT64(name, val) orbit_api::TrackInt64(ORBIT_STR(name), val)
@@ -44,6 +69,7 @@
 #define ORBIT_STOP()
 #define ORBIT_START_ASYNC(name, id)
 #define ORBIT_STOP_ASYNC(id)
+#define ORBIT_FRAME_MARKER(name)
 #define ORBIT_INT(name, value)
 #define ORBIT_INT64(name, value)
 #define ORBIT_UINT(name, value)
@@ -61,6 +87,15 @@
 #define ORBIT_CONCAT(x, y) ORBIT_CONCAT_IND(x, y)
 #define ORBIT_UNIQUE(x) ORBIT_CONCAT(x, __COUNTER__)
 #define ORBIT_VAR ORBIT_UNIQUE(ORB)
+// The key of a literal name, with the name registered in the section
+// orbit_api_names of the module.
+#define ORBIT_NAME_KEY(name)                                              \
+  ([]() -> uint64_t {                                                     \
+    __attribute__((section("orbit_api_names"), used)) static constexpr    \
+        orbit_api::SharedMemoryName kName{                                \
+            orbit_api::ComputeNameKey(ORBIT_STR(name)), ORBIT_STR(name)}; \
+    return kName.key;                                                     \
+  }())
 #define ORBIT_NOOP()       \
   do {                     \
     static volatile int x; \
@@ -80,6 +115,7 @@ ORBIT_STUB void Start(const char*) { ORBIT_NOOP(); }
 ORBIT_STUB void Stop() { ORBIT_NOOP(); }
 ORBIT_STUB void StartAsync(const char*, uint64_t) { ORBIT_NOOP(); }
 ORBIT_STUB void StopAsync(uint64_t) { ORBIT_NOOP(); }
+ORBIT_STUB void FrameMarker(const char*) { ORBIT_NOOP(); }
 ORBIT_STUB void TrackInt(const char*, int32_t) { ORBIT_NOOP(); }
 ORBIT_STUB void TrackInt64(const char*, int64_t) { ORBIT_NOOP(); }
 ORBIT_STUB void TrackUint(const char*, uint32_t) { ORBIT_NOOP(); }
@@ -103,4 +139,206 @@ struct Scope {
 
 }  // namespace orbit_api
 
+#if ORBIT_API_SHARED_MEMORY
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include "OrbitApiSharedMemory.h"
+
+namespace orbit_api {
+namespace shared_memory {
+
+// Whether the kernel uses the time stamp counter as clock source, i.e., whether
+// it is invariant and synchronized across cores, read once per process.
+inline bool IsTscClockSource() {
+#if defined(__x86_64__)
+  static const bool is_tsc_clock_source = [] {
+    const int fd = open(
+        "/sys/devices/system/clocksource/clocksource0/current_clocksource",
+        O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    char clock_source[8] = {};
+    const ssize_t size = read(fd, clock_source, sizeof(clock_source) - 1);
+    close(fd);
+    return size >= 3 && strncmp(clock_source, "tsc\n", size) == 0;
+  }();
+  return is_tsc_clock_source;
+#else
+  return false;
+#endif
+}
+
+// The buffer of the calling thread, created on its first scope. Scopes are
+// silently not reported if it can't be created.
+class ThreadBuffer {
+ public:
+  static ThreadBuffer& Get() {
+    static thread_local ThreadBuffer thread_buffer;
+    return thread_buffer;
+  }
+
+  ThreadBuffer(const ThreadBuffer&) = delete;
+  ThreadBuffer& operator=(const ThreadBuffer&) = delete;
+
+  ~ThreadBuffer() {
+    if (buffer_ == nullptr) return;
+    munmap(buffer_, sizeof(SharedMemoryBuffer));
+    unlink(path_);
+  }
+
+  void Begin(uint64_t name_key) {
+    const uint32_t depth = depth_++;
+    if (buffer_ == nullptr || dropped_depth_ != kNoDroppedScope) return;
+    // Outside of a capture, the scope and the scopes in it aren't written.
+    if (buffer_->enabled.load(std::memory_order_relaxed) == 0) {
+      dropped_depth_ = depth;
+      return;
+    }
+    const uint64_t write_index =
+        buffer_->write_index.load(std::memory_order_relaxed);
+    const uint64_t read_index =
+        buffer_->read_index.load(std::memory_order_acquire);
+    // The begin, and the ends of the depth + 1 scopes that are then open.
+    if (write_index - read_index + depth + 2 > kSharedMemoryEventCount) {
+      dropped_depth_ = depth;
+      buffer_->dropped_scope_count.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    Write(write_index, name_key);
+  }
+
+  // Adds the bounds of the section orbit_api_names of a module, unless they
+  // were already added.
+  void AddNameTable(const SharedMemoryName* begin,
+                    const SharedMemoryName* end) {
+    if (buffer_ == nullptr) return;
+    const SharedMemoryNameTable table{reinterpret_cast<uint64_t>(begin),
+                                      reinterpret_cast<uint64_t>(end)};
+    const uint32_t count =
+        buffer_->name_table_count.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < count; ++i) {
+      if (buffer_->name_tables[i].begin_address == table.begin_address) return;
+    }
+    if (count == kSharedMemoryNameTableCount) return;
+    buffer_->name_tables[count] = table;
+    buffer_->name_table_count.store(count + 1, std::memory_order_release);
+  }
+
+  void End() {
+    // Unbalanced, e.g., an ORBIT_STOP without an ORBIT_START.
+    if (depth_ == 0) return;
+    const uint32_t depth = --depth_;
+    if (buffer_ == nullptr) return;
+    if (dropped_depth_ != kNoDroppedScope) {
+      if (depth == dropped_depth_) {
+        dropped_depth_ = kNoDroppedScope;
+      }
+      return;
+    }
+    Write(buffer_->write_index.load(std::memory_order_relaxed), 0);
+  }
+
+ private:
+  static constexpr uint32_t kNoDroppedScope = UINT32_MAX;
+
+  ThreadBuffer() {
+    const int32_t pid = getpid();
+    const int32_t tid = static_cast<int32_t>(syscall(SYS_gettid));
+    snprintf(path_, sizeof(path_), "%s%s%d.%d", kSharedMemoryDirectory,
+             kSharedMemoryFilePrefix, pid, tid);
+    const int fd = open(path_, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return;
+    void* memory = MAP_FAILED;
+    if (ftruncate(fd, sizeof(SharedMemoryBuffer)) == 0) {
+      memory = mmap(nullptr, sizeof(SharedMemoryBuffer), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (memory == MAP_FAILED) {
+      unlink(path_);
+      return;
+    }
+    // The file is filled with zeros, so only the other fields need to be set.
+    buffer_ = static_cast<SharedMemoryBuffer*>(memory);
+    buffer_->event_count = kSharedMemoryEventCount;
+    buffer_->pid = pid;
+    buffer_->tid = tid;
+    use_tsc_ = IsTscClockSource();
+    buffer_->clock =
+        use_tsc_ ? kSharedMemoryClockTsc : kSharedMemoryClockMonotonic;
+    buffer_->magic.store(kSharedMemoryMagic, std::memory_order_release);
+  }
+
+  uint64_t ReadTimestamp() const {
+#if defined(__x86_64__)
+    if (use_tsc_) return __rdtsc();
+#endif
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000000000ull * ts.tv_sec + ts.tv_nsec;
+  }
+
+  void Write(uint64_t write_index, uint64_t name_key) {
+    SharedMemoryEvent& event =
+        buffer_->events[write_index % kSharedMemoryEventCount];
+    event.timestamp = ReadTimestamp();
+    event.name_key = name_key;
+    buffer_->write_index.store(write_index + 1, std::memory_order_release);
+  }
+
+  SharedMemoryBuffer* buffer_ = nullptr;
+  char path_[64] = {};
+  uint32_t depth_ = 0;
+  bool use_tsc_ = false;
+  // The depth of the outermost scope that isn't written, if any.
+  uint32_t dropped_depth_ = kNoDroppedScope;
+};
+
+// The bounds of the section orbit_api_names of the module, which the linker
+// defines as it's a valid C identifier.
+extern "C" const SharedMemoryName __start_orbit_api_names[]
+    __attribute__((weak, visibility("hidden")));
+extern "C" const SharedMemoryName __stop_orbit_api_names[]
+    __attribute__((weak, visibility("hidden")));
+
+// What follows is hidden like the bounds, so that each module adds its own
+// table on its first scope in each thread, and the calls of a module are never
+// resolved to the definitions of another one.
+#define ORBIT_HIDDEN __attribute__((visibility("hidden")))
+
+inline thread_local bool name_table_added ORBIT_HIDDEN = false;
+
+ORBIT_HIDDEN inline void Begin(uint64_t name_key) {
+  ThreadBuffer& thread_buffer = ThreadBuffer::Get();
+  if (!name_table_added) {
+    name_table_added = true;
+    thread_buffer.AddNameTable(__start_orbit_api_names,
+                               __stop_orbit_api_names);
+  }
+  thread_buffer.Begin(name_key);
+}
+ORBIT_HIDDEN inline void End() { ThreadBuffer::Get().End(); }
+
+struct ORBIT_HIDDEN Scope {
+  Scope(uint64_t name_key) { Begin(name_key); }
+  ~Scope() { End(); }
+};
+
+#undef ORBIT_HIDDEN
+
+}  // namespace shared_memory
+}  // namespace orbit_api
+
+#endif  // ORBIT_API_SHARED_MEMORY
+
 #endif  // ORBIT_H_
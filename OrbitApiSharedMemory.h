@@ -0,0 +1,97 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_API_SHARED_MEMORY_H_
+#define ORBIT_API_SHARED_MEMORY_H_
+
+#include <stdint.h>
+
+#include <atomic>
+
+// The layout of the shared-memory ring buffers through which Orbit.h reports
+// scopes with ORBIT_API_SHARED_MEMORY, shared by the instrumented process (the
+// producer) and OrbitService (the consumer).
+//
+// Each thread with scopes creates its own buffer, the file
+// /dev/shm/orbit_api.<pid>.<tid>, which it removes when it exits. Only that
+// thread writes events and advances write_index, only OrbitService advances
+// read_index and sets enabled while it captures the process.
+//
+// Events refer to the names of scopes by a key computed at compile time. The
+// keys and names of a module are in its section orbit_api_names, whose bounds
+// are added to name_tables, so that OrbitService reads each name once.
+//
+// When the kernel uses the time stamp counter as clock source, the events are
+// timestamped with the TSC, which OrbitService converts to CLOCK_MONOTONIC, as
+// reading it is much cheaper than clock_gettime.
+
+namespace orbit_api {
+
+constexpr uint32_t kSharedMemoryMagic = 0x4f524233;  // "ORB3"
+constexpr uint32_t kSharedMemoryEventCount = 1u << 14;
+constexpr uint32_t kSharedMemoryNameTableCount = 32;
+constexpr const char kSharedMemoryDirectory[] = "/dev/shm/";
+constexpr const char kSharedMemoryFilePrefix[] = "orbit_api.";
+
+// FNV-1a, never 0 as that denotes the end of a scope.
+constexpr uint64_t ComputeNameKey(const char* name) {
+  uint64_t key = 0xcbf29ce484222325ull;
+  for (; *name != '\0'; ++name) {
+    key = (key ^ static_cast<uint8_t>(*name)) * 0x100000001b3ull;
+  }
+  return key == 0 ? 1 : key;
+}
+
+// An entry of the section orbit_api_names. Aligned to its size, so that the
+// compiler doesn't pad the entries of a section differently.
+struct alignas(16) SharedMemoryName {
+  uint64_t key;
+  const char* name;
+};
+
+// The bounds of the section orbit_api_names of a module, in the address space
+// of the process.
+struct SharedMemoryNameTable {
+  uint64_t begin_address;
+  uint64_t end_address;
+};
+
+// The clocks of the timestamps of the events of a buffer.
+enum SharedMemoryClock : uint32_t {
+  kSharedMemoryClockMonotonic = 0,  // CLOCK_MONOTONIC nanoseconds
+  kSharedMemoryClockTsc = 1,        // the time stamp counter
+};
+
+// The key of the name of the scope for the begin of a scope, 0 for its end.
+struct SharedMemoryEvent {
+  uint64_t timestamp;  // in the clock of the buffer
+  uint64_t name_key;
+};
+
+struct SharedMemoryBuffer {
+  // Set last by the producer, once the other fields are.
+  std::atomic<uint32_t> magic;
+  uint32_t event_count;
+  int32_t pid;
+  int32_t tid;
+  SharedMemoryClock clock;
+  std::atomic<uint32_t> enabled;
+  // Begins that didn't fit, with their scopes. The end of a scope always fits,
+  // as a begin is only written if the ends of all the open scopes fit after it.
+  std::atomic<uint64_t> dropped_scope_count;
+  // The tables before name_table_count are set, and never change.
+  std::atomic<uint32_t> name_table_count;
+  SharedMemoryNameTable name_tables[kSharedMemoryNameTableCount];
+  alignas(64) std::atomic<uint64_t> write_index;
+  alignas(64) std::atomic<uint64_t> read_index;
+  alignas(64) SharedMemoryEvent events[kSharedMemoryEventCount];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "The atomics of SharedMemoryBuffer must be lock-free to be "
+              "shared between processes");
+
+}  // namespace orbit_api
+
+#endif  // ORBIT_API_SHARED_MEMORY_H_
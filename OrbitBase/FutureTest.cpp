@@ -0,0 +1,191 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gmock/gmock-matchers.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "OrbitBase/Future.h"
+#include "OrbitBase/ThreadPool.h"
+#include "absl/time/time.h"
+
+namespace OrbitBase {
+
+namespace {
+
+// Executes the actions only when asked to, to control the order of events.
+class ManualExecutor {
+ public:
+  void Schedule(std::unique_ptr<Action> action) {
+    actions_.push_back(std::move(action));
+  }
+
+  void ExecuteAll() {
+    while (!actions_.empty()) {
+      std::vector<std::unique_ptr<Action>> actions = std::move(actions_);
+      actions_.clear();
+      for (std::unique_ptr<Action>& action : actions) {
+        action->Execute();
+      }
+    }
+  }
+
+  [[nodiscard]] size_t GetActionCount() const { return actions_.size(); }
+
+ private:
+  std::vector<std::unique_ptr<Action>> actions_;
+};
+
+}  // namespace
+
+TEST(Future, SetValue) {
+  Promise<int> promise;
+  Future<int> future = promise.GetFuture();
+  EXPECT_TRUE(future.IsValid());
+  EXPECT_FALSE(future.IsFinished());
+
+  promise.SetValue(42);
+  EXPECT_TRUE(future.IsFinished());
+  EXPECT_FALSE(future.IsCancelled());
+  EXPECT_EQ(future.Get(), 42);
+
+  // Only the first value counts.
+  promise.SetValue(43);
+  EXPECT_EQ(future.Get(), 42);
+
+  EXPECT_FALSE(Future<int>{}.IsValid());
+}
+
+TEST(Future, ThenIsExecutedOnExecutorOnceFinished) {
+  ManualExecutor executor;
+  Promise<int> promise;
+  Future<std::string> future =
+      promise.GetFuture().Then(&executor, [](int value) {
+        return std::to_string(value);
+      });
+  Future<void> last = future.Then(&executor, [](const std::string&) {});
+
+  EXPECT_EQ(executor.GetActionCount(), 0);
+  promise.SetValue(42);
+  EXPECT_EQ(executor.GetActionCount(), 1);
+  EXPECT_FALSE(future.IsFinished());
+
+  executor.ExecuteAll();
+  EXPECT_EQ(future.Get(), "42");
+  EXPECT_TRUE(last.IsFinished());
+}
+
+TEST(Future, ThenOnFinishedFuture) {
+  ManualExecutor executor;
+  Promise<void> promise;
+  promise.SetValue();
+  bool executed = false;
+  promise.GetFuture().Then(&executor, [&] { executed = true; });
+
+  executor.ExecuteAll();
+  EXPECT_TRUE(executed);
+}
+
+TEST(Future, CancelSkipsContinuations) {
+  ManualExecutor executor;
+  Promise<int> promise;
+  Future<int> future = promise.GetFuture();
+  bool executed = false;
+  Future<int> next = future.Then(&executor, [&](int value) {
+    executed = true;
+    return value;
+  });
+  Future<void> last = next.Then(&executor, [&](int) { executed = true; });
+
+  future.Cancel();
+  EXPECT_TRUE(promise.IsCancelled());
+  EXPECT_TRUE(next.IsCancelled());
+  EXPECT_TRUE(last.IsCancelled());
+
+  promise.SetValue(42);
+  executor.ExecuteAll();
+  EXPECT_FALSE(executed);
+  EXPECT_FALSE(future.IsFinished());
+}
+
+TEST(Future, CancelScheduledContinuation) {
+  ManualExecutor executor;
+  Promise<int> promise;
+  bool executed = false;
+  Future<void> next =
+      promise.GetFuture().Then(&executor, [&](int) { executed = true; });
+
+  promise.SetValue(42);
+  next.Cancel();
+  executor.ExecuteAll();
+  EXPECT_FALSE(executed);
+  EXPECT_TRUE(next.IsCancelled());
+}
+
+TEST(Future, WhenAll) {
+  Promise<int> first;
+  Promise<int> second;
+  Future<std::vector<int>> all =
+      WhenAll(std::vector<Future<int>>{first.GetFuture(), second.GetFuture()});
+
+  second.SetValue(2);
+  EXPECT_FALSE(all.IsFinished());
+  first.SetValue(1);
+  EXPECT_THAT(all.Get(), testing::ElementsAre(1, 2));
+
+  EXPECT_TRUE(WhenAll(std::vector<Future<void>>{}).IsFinished());
+}
+
+TEST(Future, WhenAllIsCancelledByAnyInput) {
+  Promise<void> first;
+  Promise<void> second;
+  Future<void> all =
+      WhenAll(std::vector<Future<void>>{first.GetFuture(), second.GetFuture()});
+
+  first.SetValue();
+  second.Cancel();
+  EXPECT_TRUE(all.IsCancelled());
+}
+
+TEST(Future, ParallelPipelineOnThreadPool) {
+  std::unique_ptr<ThreadPool> thread_pool = ThreadPool::CreateWorkStealing(4);
+
+  constexpr int kFutureCount = 100;
+  std::vector<Future<int>> futures;
+  for (int i = 0; i < kFutureCount; ++i) {
+    futures.push_back(
+        ScheduleWithFuture(thread_pool.get(), [i] { return i; })
+            .Then(thread_pool.get(), [](int value) { return 2 * value; }));
+  }
+  std::atomic<int> sum = 0;
+  Future<void> done =
+      WhenAll(std::move(futures))
+          .Then(thread_pool.get(), [&](const std::vector<int>& values) {
+            for (int value : values) {
+              sum += value;
+            }
+          });
+
+  done.Wait();
+  EXPECT_TRUE(done.IsFinished());
+  EXPECT_EQ(sum, kFutureCount * (kFutureCount - 1));
+
+  thread_pool->ShutdownAndWait();
+}
+
+TEST(Future, GetOnCancelledFuture) {
+  EXPECT_DEATH(
+      {
+        Promise<int> promise;
+        promise.Cancel();
+        (void)promise.GetFuture().Get();
+      },
+      "");
+}
+
+}  // namespace OrbitBase
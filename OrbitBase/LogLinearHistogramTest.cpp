@@ -0,0 +1,73 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <vector>
+
+#include "OrbitBase/LogLinearHistogram.h"
+
+using OrbitBase::LogLinearHistogram;
+
+TEST(LogLinearHistogram, SmallValuesHaveOwnBuckets) {
+  for (uint64_t value = 0; value < LogLinearHistogram::SUB_BUCKET_COUNT;
+       ++value) {
+    size_t index = LogLinearHistogram::GetBucketIndex(value);
+    EXPECT_EQ(index, value);
+    EXPECT_EQ(LogLinearHistogram::GetBucketLowerBound(index), value);
+    EXPECT_EQ(LogLinearHistogram::GetBucketUpperBound(index), value);
+  }
+}
+
+TEST(LogLinearHistogram, BucketsAreContiguous) {
+  for (size_t index = 0; index + 1 < LogLinearHistogram::BUCKET_COUNT;
+       ++index) {
+    uint64_t lower_bound = LogLinearHistogram::GetBucketLowerBound(index);
+    uint64_t upper_bound = LogLinearHistogram::GetBucketUpperBound(index);
+    EXPECT_LE(lower_bound, upper_bound);
+    EXPECT_EQ(LogLinearHistogram::GetBucketIndex(lower_bound), index);
+    EXPECT_EQ(LogLinearHistogram::GetBucketIndex(upper_bound), index);
+    EXPECT_EQ(LogLinearHistogram::GetBucketLowerBound(index + 1),
+              upper_bound + 1);
+  }
+  EXPECT_EQ(LogLinearHistogram::GetBucketIndex(
+                std::numeric_limits<uint64_t>::max()),
+            LogLinearHistogram::BUCKET_COUNT - 1);
+}
+
+TEST(LogLinearHistogram, BoundedRelativeError) {
+  for (uint64_t value : {17lu, 1000lu, 123'456lu, 1'000'000'000lu}) {
+    size_t index = LogLinearHistogram::GetBucketIndex(value);
+    uint64_t width = LogLinearHistogram::GetBucketUpperBound(index) -
+                     LogLinearHistogram::GetBucketLowerBound(index) + 1;
+    EXPECT_LE(width * LogLinearHistogram::SUB_BUCKET_COUNT, value);
+  }
+}
+
+TEST(LogLinearHistogram, ComputeQuantile) {
+  std::vector<uint64_t> bucket_counts;
+  EXPECT_FALSE(LogLinearHistogram::ComputeQuantile(bucket_counts, 0.5));
+  bucket_counts.resize(LogLinearHistogram::SUB_BUCKET_COUNT);
+  EXPECT_FALSE(LogLinearHistogram::ComputeQuantile(bucket_counts, 0.5));
+
+  // 90 values equal to 1 and 10 equal to 10.
+  bucket_counts[1] = 90;
+  bucket_counts[10] = 10;
+  EXPECT_EQ(LogLinearHistogram::ComputeQuantile(bucket_counts, 0), 1);
+  EXPECT_EQ(LogLinearHistogram::ComputeQuantile(bucket_counts, 0.5), 1);
+  EXPECT_EQ(LogLinearHistogram::ComputeQuantile(bucket_counts, 0.9), 1);
+  EXPECT_EQ(LogLinearHistogram::ComputeQuantile(bucket_counts, 0.91), 10);
+  EXPECT_EQ(LogLinearHistogram::ComputeQuantile(bucket_counts, 1), 10);
+}
+
+TEST(LogLinearHistogram, ComputeQuantileReturnsMiddleOfBucket) {
+  size_t index = LogLinearHistogram::GetBucketIndex(1'000'000);
+  std::vector<uint64_t> bucket_counts(index + 1);
+  bucket_counts[index] = 1;
+  uint64_t lower_bound = LogLinearHistogram::GetBucketLowerBound(index);
+  uint64_t upper_bound = LogLinearHistogram::GetBucketUpperBound(index);
+  EXPECT_EQ(LogLinearHistogram::ComputeQuantile(bucket_counts, 0.99),
+            lower_bound + (upper_bound - lower_bound) / 2);
+}
@@ -4,6 +4,12 @@
 
 #include <OrbitBase/Logging.h>
 
+#include <array>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <utility>
+
 static absl::Mutex log_file_mutex;
 std::ofstream log_file;
 
@@ -20,3 +26,177 @@ void LogToFile(const std::string& message) {
     log_file.flush();
   }
 }
+
+std::string FormatLogFileAndLine(const char* file, int line) {
+  std::string file_and_line = absl::StrFormat(
+      "%s:%d", std::filesystem::path(file).filename().string(), line);
+  if (file_and_line.size() > 28) {
+    file_and_line = "..." + file_and_line.substr(file_and_line.size() - 25);
+  }
+  return file_and_line;
+}
+
+namespace {
+
+// A bounded multi-producer queue of messages, lock-free for the producers:
+// each slot has a sequence number that tells whether it is free for the push
+// of that index, or holds the message of that index, ready to be popped.
+class AsyncLogQueue {
+ public:
+  AsyncLogQueue() {
+    for (size_t i = 0; i < kCapacity; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  [[nodiscard]] bool TryPush(std::string* message) {
+    size_t index = push_index_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      slot = &slots_[index % kCapacity];
+      const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      const auto difference = static_cast<int64_t>(sequence - index);
+      if (difference == 0) {
+        if (push_index_.compare_exchange_weak(index, index + 1,
+                                              std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        // Full: the slot still holds the message pushed kCapacity earlier.
+        return false;
+      } else {
+        index = push_index_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->message = std::move(*message);
+    slot->sequence.store(index + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Only one thread at a time can pop.
+  [[nodiscard]] bool TryPop(std::string* message) {
+    const size_t index = pop_index_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[index % kCapacity];
+    if (slot.sequence.load(std::memory_order_acquire) != index + 1) {
+      return false;
+    }
+    *message = std::move(slot.message);
+    slot.message.clear();
+    slot.sequence.store(index + kCapacity, std::memory_order_release);
+    pop_index_.store(index + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+ private:
+  static constexpr size_t kCapacity = 4096;
+
+  struct Slot {
+    std::atomic<size_t> sequence;
+    std::string message;
+  };
+
+  std::array<Slot, kCapacity> slots_;
+  alignas(64) std::atomic<size_t> push_index_{0};
+  alignas(64) std::atomic<size_t> pop_index_{0};
+};
+
+// Never destroyed, as it can be logged to until the very end.
+class AsyncLog {
+ public:
+  static AsyncLog* Get() {
+    static AsyncLog* async_log = [] {
+      auto* async_log = new AsyncLog{};
+      std::thread{[async_log] { async_log->Run(); }}.detach();
+      std::atexit(&FlushAsyncLog);
+      return async_log;
+    }();
+    return async_log;
+  }
+
+  void Push(std::string message) {
+    if (!queue_.TryPush(&message)) {
+      dropped_count_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    // Only wake up the writing thread if it might be waiting, so that the
+    // producers only take the mutex for the first of a burst of messages.
+    if (pending_count_.fetch_add(1, std::memory_order_release) == 0) {
+      absl::MutexLock lock{&wake_up_mutex_};
+    }
+  }
+
+  void Flush() {
+    absl::MutexLock lock{&pop_mutex_};
+    std::string message;
+    while (queue_.TryPop(&message)) {
+      pending_count_.fetch_sub(1, std::memory_order_acquire);
+      LogSync(message);
+    }
+    const uint64_t dropped_count =
+        dropped_count_.exchange(0, std::memory_order_relaxed);
+    if (dropped_count > 0) {
+      LogSync(absl::StrFormat("[%28s] %u log messages dropped\n", "Logging",
+                              dropped_count));
+    }
+  }
+
+ private:
+  void Run() {
+    while (true) {
+      {
+        absl::MutexLock lock{&wake_up_mutex_};
+        wake_up_mutex_.Await(absl::Condition(
+            +[](std::atomic<int64_t>* pending_count) {
+              return pending_count->load(std::memory_order_acquire) > 0;
+            },
+            &pending_count_));
+      }
+      Flush();
+    }
+  }
+
+  AsyncLogQueue queue_;
+  // Can be transiently negative, when a message is popped before its push
+  // is counted.
+  std::atomic<int64_t> pending_count_{0};
+  std::atomic<uint64_t> dropped_count_{0};
+  absl::Mutex wake_up_mutex_;
+  absl::Mutex pop_mutex_;
+};
+
+std::atomic<bool> async_log_used{false};
+
+}  // namespace
+
+void LogAsync(std::string message) {
+  async_log_used.store(true, std::memory_order_relaxed);
+  AsyncLog::Get()->Push(std::move(message));
+}
+
+void FlushAsyncLog() {
+  // Don't start the thread only to flush nothing.
+  if (async_log_used.load(std::memory_order_relaxed)) {
+    AsyncLog::Get()->Flush();
+  }
+}
+
+bool LogRateLimiter::ShouldLog(uint64_t* suppressed_count, absl::Time now) {
+  const int64_t now_ns = absl::ToUnixNanos(now);
+  int64_t next_log_ns = next_log_ns_.load(std::memory_order_relaxed);
+  if (now_ns < next_log_ns ||
+      !next_log_ns_.compare_exchange_strong(
+          next_log_ns, now_ns + absl::ToInt64Nanoseconds(kInterval),
+          std::memory_order_relaxed)) {
+    suppressed_count_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  *suppressed_count = suppressed_count_.exchange(0, std::memory_order_relaxed);
+  return true;
+}
+
+std::string FormatSuppressedCount(uint64_t suppressed_count) {
+  if (suppressed_count == 0) {
+    return "";
+  }
+  return absl::StrFormat(" (%u similar messages suppressed)", suppressed_count);
+}
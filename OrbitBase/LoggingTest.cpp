@@ -0,0 +1,70 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "OrbitBase/Logging.h"
+
+TEST(Logging, RateLimiterLogsOncePerInterval) {
+  LogRateLimiter rate_limiter;
+  const absl::Time start = absl::FromUnixSeconds(1000);
+  uint64_t suppressed_count = 42;
+  EXPECT_TRUE(rate_limiter.ShouldLog(&suppressed_count, start));
+  EXPECT_EQ(suppressed_count, 0);
+
+  EXPECT_FALSE(rate_limiter.ShouldLog(&suppressed_count, start));
+  EXPECT_FALSE(rate_limiter.ShouldLog(
+      &suppressed_count, start + LogRateLimiter::kInterval / 2));
+
+  EXPECT_TRUE(rate_limiter.ShouldLog(&suppressed_count,
+                                     start + LogRateLimiter::kInterval));
+  EXPECT_EQ(suppressed_count, 2);
+  EXPECT_TRUE(rate_limiter.ShouldLog(&suppressed_count,
+                                     start + 3 * LogRateLimiter::kInterval));
+  EXPECT_EQ(suppressed_count, 0);
+}
+
+TEST(Logging, FormatSuppressedCount) {
+  EXPECT_EQ(FormatSuppressedCount(0), "");
+  EXPECT_EQ(FormatSuppressedCount(3), " (3 similar messages suppressed)");
+}
+
+TEST(Logging, RateLimitedLogsAreWrittenAsynchronously) {
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "OrbitBaseLoggingTest.log";
+  InitLogFile(path.string());
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([] {
+      for (int j = 0; j < 1000; ++j) {
+        ERROR_RATE_LIMITED("Rate-limited %d", 1);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  LOG("Synchronous");
+  FlushAsyncLog();
+
+  std::ifstream file{path};
+  std::stringstream content;
+  content << file.rdbuf();
+  std::filesystem::remove(path);
+
+  const std::string log = content.str();
+  const size_t first = log.find("Error: Rate-limited 1\n");
+  EXPECT_NE(first, std::string::npos);
+  EXPECT_EQ(log.find("Error: Rate-limited 1", first + 1), std::string::npos);
+  EXPECT_NE(log.find("LoggingTest.cpp"), std::string::npos);
+  EXPECT_NE(log.find("Synchronous\n"), std::string::npos);
+}
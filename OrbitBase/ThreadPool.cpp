@@ -20,11 +20,12 @@ class ThreadPoolImpl : public ThreadPool {
                           absl::Duration thread_ttl);
 
   size_t GetPoolSize() override;
-  void Schedule(std::unique_ptr<Action> action) override;
+  void Schedule(std::unique_ptr<Action> action, Priority priority) override;
   void Shutdown() override;
   void Wait() override;
 
  private:
+  size_t GetScheduledActionCount() const;
   bool ActionsAvailableOrShutdownInitiated();
   // Blocking call - returns nullptr if the worker thread needs to exit.
   std::unique_ptr<Action> TakeAction();
@@ -33,6 +34,7 @@ class ThreadPoolImpl : public ThreadPool {
   void WorkerFunction();
 
   absl::Mutex mutex_;
+  std::list<std::unique_ptr<Action>> scheduled_high_priority_actions_;
   std::list<std::unique_ptr<Action>> scheduled_actions_;
   absl::flat_hash_map<std::thread::id, std::thread> worker_threads_;
   std::vector<std::thread> finished_threads_;
@@ -71,12 +73,17 @@ void ThreadPoolImpl::CreateWorker() {
   worker_threads_.insert_or_assign(thread_id, std::move(thread));
 }
 
-void ThreadPoolImpl::Schedule(std::unique_ptr<Action> action) {
+void ThreadPoolImpl::Schedule(std::unique_ptr<Action> action,
+                              Priority priority) {
   absl::MutexLock lock(&mutex_);
   CHECK(!shutdown_initiated_);
 
-  scheduled_actions_.push_back(std::move(action));
-  if (idle_threads_ < scheduled_actions_.size() &&
+  if (priority == Priority::kHigh) {
+    scheduled_high_priority_actions_.push_back(std::move(action));
+  } else {
+    scheduled_actions_.push_back(std::move(action));
+  }
+  if (idle_threads_ < GetScheduledActionCount() &&
       worker_threads_.size() < thread_pool_max_size_) {
     CreateWorker();
   }
@@ -114,8 +121,12 @@ void ThreadPoolImpl::Wait() {
   CleanupFinishedThreads();
 }
 
+size_t ThreadPoolImpl::GetScheduledActionCount() const {
+  return scheduled_high_priority_actions_.size() + scheduled_actions_.size();
+}
+
 bool ThreadPoolImpl::ActionsAvailableOrShutdownInitiated() {
-  return !scheduled_actions_.empty() || shutdown_initiated_;
+  return GetScheduledActionCount() > 0 || shutdown_initiated_;
 }
 
 std::unique_ptr<Action> ThreadPoolImpl::TakeAction() {
@@ -133,12 +144,16 @@ std::unique_ptr<Action> ThreadPoolImpl::TakeAction() {
     }
   }
 
-  if (scheduled_actions_.empty()) {
+  std::list<std::unique_ptr<Action>>* actions =
+      !scheduled_high_priority_actions_.empty()
+          ? &scheduled_high_priority_actions_
+          : &scheduled_actions_;
+  if (actions->empty()) {
     return nullptr;
   }
 
-  std::unique_ptr<Action> action = std::move(scheduled_actions_.front());
-  scheduled_actions_.pop_front();
+  std::unique_ptr<Action> action = std::move(actions->front());
+  actions->pop_front();
 
   return action;
 }
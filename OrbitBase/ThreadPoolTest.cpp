@@ -5,10 +5,19 @@
 #include <gmock/gmock-matchers.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <iostream>
 #include <memory>
+#include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
+#include "OrbitBase/ParallelFor.h"
+#include "OrbitBase/ParallelSort.h"
 #include "OrbitBase/ThreadPool.h"
+#include "absl/synchronization/blocking_counter.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/clock.h"
 
@@ -320,3 +329,291 @@ TEST(ThreadPool, WaitWithoutShutdown) {
       },
       "");
 }
+
+TEST(ThreadPool, HighPriorityActionsExecutedFirst) {
+  std::unique_ptr<ThreadPool> thread_pool =
+      ThreadPool::Create(1, 1, absl::Milliseconds(5));
+
+  absl::Mutex mutex;
+  std::vector<int> executed;
+  {
+    // The only worker is blocked by the first action until we unlock.
+    absl::MutexLock lock(&mutex);
+    thread_pool->Schedule([&] {
+      absl::MutexLock lock(&mutex);
+      executed.push_back(0);
+    });
+    absl::SleepFor(absl::Milliseconds(10));
+    thread_pool->Schedule([&] { executed.push_back(1); });
+    thread_pool->Schedule([&] { executed.push_back(2); });
+    thread_pool->Schedule([&] { executed.push_back(3); },
+                          ThreadPool::Priority::kHigh);
+    thread_pool->Schedule([&] { executed.push_back(4); },
+                          ThreadPool::Priority::kHigh);
+  }
+
+  thread_pool->ShutdownAndWait();
+
+  EXPECT_THAT(executed, testing::ElementsAre(0, 3, 4, 1, 2));
+}
+
+TEST(WorkStealingThreadPool, Smoke) {
+  constexpr size_t kThreadCount = 4;
+  std::unique_ptr<ThreadPool> thread_pool =
+      ThreadPool::CreateWorkStealing(kThreadCount);
+  EXPECT_EQ(thread_pool->GetPoolSize(), kThreadCount);
+
+  constexpr size_t kNumberOfActions = 1000;
+  std::atomic<size_t> counter = 0;
+  for (size_t i = 0; i < kNumberOfActions; ++i) {
+    thread_pool->Schedule([&] { ++counter; });
+  }
+
+  // Queued actions are executed on shutdown.
+  thread_pool->ShutdownAndWait();
+
+  EXPECT_EQ(counter, kNumberOfActions);
+}
+
+TEST(WorkStealingThreadPool, ScheduleFromAction) {
+  std::unique_ptr<ThreadPool> thread_pool = ThreadPool::CreateWorkStealing(4);
+
+  constexpr size_t kNumberOfActions = 100;
+  absl::Mutex mutex;
+  size_t counter = 0;
+  for (size_t i = 0; i < kNumberOfActions; ++i) {
+    thread_pool->Schedule([&] {
+      for (size_t j = 0; j < kNumberOfActions; ++j) {
+        thread_pool->Schedule([&] {
+          absl::MutexLock lock(&mutex);
+          ++counter;
+        });
+      }
+    });
+  }
+
+  {
+    absl::MutexLock lock(&mutex);
+    EXPECT_TRUE(mutex.AwaitWithTimeout(
+        absl::Condition(
+            +[](size_t* counter) {
+              return *counter == kNumberOfActions * kNumberOfActions;
+            },
+            &counter),
+        absl::Seconds(10)));
+  }
+
+  thread_pool->ShutdownAndWait();
+}
+
+TEST(WorkStealingThreadPool, StealsFromBlockedWorker) {
+  constexpr size_t kThreadCount = 2;
+  std::unique_ptr<ThreadPool> thread_pool =
+      ThreadPool::CreateWorkStealing(kThreadCount);
+
+  absl::Mutex mutex;
+  bool blocked_action_executed = false;
+  std::atomic<bool> other_action_executed = false;
+  {
+    // The action blocks its worker, the actions it schedules are queued on
+    // that worker and can only be executed by the other worker.
+    absl::MutexLock lock(&mutex);
+    thread_pool->Schedule([&] {
+      thread_pool->Schedule([&] { other_action_executed = true; });
+      absl::MutexLock lock(&mutex);
+      blocked_action_executed = true;
+    });
+
+    absl::Time deadline = absl::Now() + absl::Seconds(10);
+    while (!other_action_executed && absl::Now() < deadline) {
+      absl::SleepFor(absl::Milliseconds(1));
+    }
+    EXPECT_TRUE(other_action_executed);
+    EXPECT_FALSE(blocked_action_executed);
+  }
+
+  thread_pool->ShutdownAndWait();
+
+  EXPECT_TRUE(blocked_action_executed);
+}
+
+TEST(WorkStealingThreadPool, HighPriorityActionsExecutedFirst) {
+  std::unique_ptr<ThreadPool> thread_pool = ThreadPool::CreateWorkStealing(1);
+
+  absl::Mutex mutex;
+  std::vector<int> executed;
+  {
+    absl::MutexLock lock(&mutex);
+    thread_pool->Schedule([&] {
+      absl::MutexLock lock(&mutex);
+      executed.push_back(0);
+    });
+    absl::SleepFor(absl::Milliseconds(10));
+    thread_pool->Schedule([&] { executed.push_back(1); });
+    thread_pool->Schedule([&] { executed.push_back(2); },
+                          ThreadPool::Priority::kHigh);
+  }
+
+  thread_pool->ShutdownAndWait();
+
+  EXPECT_THAT(executed, testing::ElementsAre(0, 2, 1));
+}
+
+TEST(WorkStealingThreadPool, InvalidArguments) {
+  EXPECT_DEATH(
+      {
+        auto thread_pool = ThreadPool::CreateWorkStealing(0);
+        thread_pool->ShutdownAndWait();
+      },
+      "");
+}
+
+TEST(WorkStealingThreadPool, ScheduleAfterShutdown) {
+  EXPECT_DEATH(
+      {
+        std::unique_ptr<ThreadPool> thread_pool =
+            ThreadPool::CreateWorkStealing(2);
+        thread_pool->Shutdown();
+        thread_pool->Schedule([] {});
+      },
+      "");
+}
+
+TEST(ParallelFor, CallsBodyOnceForEveryIndex) {
+  std::unique_ptr<ThreadPool> thread_pool = ThreadPool::CreateWorkStealing(4);
+
+  for (size_t grain_size : {1, 3, 1000}) {
+    constexpr size_t kBegin = 10;
+    constexpr size_t kEnd = 1010;
+    std::vector<std::atomic<int>> calls(kEnd);
+    ParallelFor(
+        thread_pool.get(), kBegin, kEnd, [&](size_t i) { ++calls[i]; },
+        grain_size);
+    for (size_t i = 0; i < kEnd; ++i) {
+      EXPECT_EQ(calls[i], i < kBegin ? 0 : 1) << "i=" << i;
+    }
+  }
+
+  // An empty range doesn't call body.
+  ParallelFor(thread_pool.get(), 5, 5, [](size_t) { FAIL(); });
+
+  thread_pool->ShutdownAndWait();
+}
+
+TEST(ParallelFor, NestedInAction) {
+  std::unique_ptr<ThreadPool> thread_pool =
+      ThreadPool::Create(1, 1, absl::Milliseconds(5));
+
+  // The only worker runs the outer action, hence the inner loop is run by the
+  // calling thread alone.
+  constexpr size_t kIndexCount = 100;
+  std::atomic<size_t> counter = 0;
+  absl::Mutex mutex;
+  bool done = false;
+  thread_pool->Schedule([&] {
+    ParallelFor(thread_pool.get(), 0, kIndexCount, [&](size_t) { ++counter; });
+    absl::MutexLock lock(&mutex);
+    done = true;
+  });
+
+  {
+    absl::MutexLock lock(&mutex);
+    EXPECT_TRUE(mutex.AwaitWithTimeout(
+        absl::Condition(
+            +[](bool* done) { return *done; }, &done),
+        absl::Seconds(10)));
+  }
+  EXPECT_EQ(counter, kIndexCount);
+
+  thread_pool->ShutdownAndWait();
+}
+
+TEST(ParallelStableSort, SortsLikeStableSort) {
+  std::unique_ptr<ThreadPool> thread_pool = ThreadPool::CreateWorkStealing(3);
+
+  // Pairs of a key with many duplicates and their original position, so that
+  // the result also shows whether equal keys kept their order.
+  for (size_t size : {0, 1, 10, 1000, 1001, 100000}) {
+    std::vector<std::pair<int, size_t>> values(size);
+    uint64_t random = 42;
+    for (size_t i = 0; i < size; ++i) {
+      random = random * 6364136223846793005 + 1442695040888963407;
+      values[i] = {static_cast<int>(random >> 54), i};
+    }
+    auto compare_keys = [](const std::pair<int, size_t>& a,
+                           const std::pair<int, size_t>& b) {
+      return a.first < b.first;
+    };
+    std::vector<std::pair<int, size_t>> expected = values;
+    std::stable_sort(expected.begin(), expected.end(), compare_keys);
+
+    for (size_t min_chunk_size : {1, 7, 1 << 14}) {
+      std::vector<std::pair<int, size_t>> sorted = values;
+      ParallelStableSort(thread_pool.get(), sorted.begin(), sorted.end(),
+                         compare_keys, min_chunk_size);
+      EXPECT_EQ(sorted, expected)
+          << "size=" << size << " min_chunk_size=" << min_chunk_size;
+    }
+  }
+
+  thread_pool->ShutdownAndWait();
+}
+
+namespace {
+
+// Keeps the compiler from optimizing away the work of the benchmark actions.
+std::atomic<uint64_t> benchmark_sink = 0;
+
+void DoWork(uint64_t iteration_count) {
+  uint64_t value = 0;
+  for (uint64_t i = 0; i < iteration_count; ++i) {
+    value = value * 6364136223846793005 + 1442695040888963407;
+  }
+  benchmark_sink += value;
+}
+
+void RunThroughputBenchmark(const std::string& name,
+                            std::unique_ptr<ThreadPool> thread_pool) {
+  // Iterations per action, from almost empty actions to ones of about 100 us.
+  constexpr uint64_t kTotalIterationCount = 10'000'000;
+  for (uint64_t iteration_count : {10, 100, 1'000, 10'000, 100'000}) {
+    const uint64_t action_count = kTotalIterationCount / iteration_count;
+    absl::BlockingCounter executed_counter(static_cast<int>(action_count));
+
+    absl::Time start = absl::Now();
+    for (uint64_t i = 0; i < action_count; ++i) {
+      thread_pool->Schedule([&] {
+        DoWork(iteration_count);
+        executed_counter.DecrementCount();
+      });
+    }
+    executed_counter.Wait();
+    absl::Duration schedule_duration = absl::Now() - start;
+
+    start = absl::Now();
+    ParallelFor(
+        thread_pool.get(), 0, action_count,
+        [&](size_t) { DoWork(iteration_count); },
+        std::max<uint64_t>(1, 10'000 / iteration_count));
+    absl::Duration parallel_for_duration = absl::Now() - start;
+
+    std::cout << name << ": " << action_count << " actions of "
+              << iteration_count << " iterations in "
+              << absl::ToInt64Milliseconds(schedule_duration)
+              << " ms with Schedule, "
+              << absl::ToInt64Milliseconds(parallel_for_duration)
+              << " ms with ParallelFor" << std::endl;
+  }
+  thread_pool->ShutdownAndWait();
+}
+
+}  // namespace
+
+TEST(ThreadPool, DISABLED_Benchmark) {
+  const size_t thread_count = std::thread::hardware_concurrency();
+  RunThroughputBenchmark(
+      "ThreadPool",
+      ThreadPool::Create(thread_count, thread_count, absl::Seconds(1)));
+  RunThroughputBenchmark("WorkStealingThreadPool",
+                         ThreadPool::CreateWorkStealing(thread_count));
+}
@@ -0,0 +1,193 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include "OrbitBase/Logging.h"
+#include "OrbitBase/ThreadPool.h"
+#include "absl/synchronization/mutex.h"
+
+namespace {
+
+class WorkStealingThreadPool : public ThreadPool {
+ public:
+  explicit WorkStealingThreadPool(size_t thread_count);
+
+  size_t GetPoolSize() override { return workers_.size(); }
+  void Schedule(std::unique_ptr<Action> action, Priority priority) override;
+  void Shutdown() override;
+  void Wait() override;
+
+ private:
+  struct Worker {
+    // Only contended when another worker steals from this one.
+    absl::Mutex mutex;
+    std::deque<std::unique_ptr<Action>> high_priority_actions;
+    std::deque<std::unique_ptr<Action>> actions;
+    std::thread thread;
+  };
+
+  // Returns nullptr if no worker has actions left.
+  std::unique_ptr<Action> TakeAction(size_t worker_index);
+  std::unique_ptr<Action> TakeAction(size_t worker_index, Priority priority);
+  void WorkerFunction(size_t worker_index);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<size_t> next_worker_index_ = 0;
+  // These are incremented before an action is queued and decremented when an
+  // action is taken, so that a worker never goes to sleep while there are
+  // actions to take, and so that the queues of high priority actions are only
+  // inspected when there are some.
+  std::atomic<size_t> scheduled_action_count_ = 0;
+  std::atomic<size_t> scheduled_high_priority_action_count_ = 0;
+  std::atomic<bool> shutdown_initiated_ = false;
+
+  // Schedule only takes sleep_mutex_ to wake up a worker if some are asleep.
+  absl::Mutex sleep_mutex_;
+  absl::CondVar sleep_cond_var_;
+  std::atomic<size_t> sleeping_worker_count_ = 0;
+};
+
+// Lets Schedule find the queue of the worker that runs the current thread.
+thread_local const WorkStealingThreadPool* current_thread_pool = nullptr;
+thread_local size_t current_worker_index = 0;
+
+WorkStealingThreadPool::WorkStealingThreadPool(size_t thread_count) {
+  CHECK(thread_count > 0);
+  for (size_t i = 0; i < thread_count; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  // Only start the threads once workers_ doesn't change anymore.
+  for (size_t i = 0; i < thread_count; ++i) {
+    workers_[i]->thread = std::thread([this, i] { WorkerFunction(i); });
+  }
+}
+
+void WorkStealingThreadPool::Schedule(std::unique_ptr<Action> action,
+                                      Priority priority) {
+  CHECK(!shutdown_initiated_);
+
+  size_t worker_index;
+  if (current_thread_pool == this) {
+    worker_index = current_worker_index;
+  } else {
+    worker_index = next_worker_index_++ % workers_.size();
+  }
+
+  ++scheduled_action_count_;
+  if (priority == Priority::kHigh) {
+    ++scheduled_high_priority_action_count_;
+  }
+  {
+    Worker& worker = *workers_[worker_index];
+    absl::MutexLock lock(&worker.mutex);
+    if (priority == Priority::kHigh) {
+      worker.high_priority_actions.push_back(std::move(action));
+    } else {
+      worker.actions.push_back(std::move(action));
+    }
+  }
+
+  // A worker increments sleeping_worker_count_ before it checks
+  // scheduled_action_count_, and we check them in the opposite order, hence
+  // either the worker sees the new action or we see the sleeping worker.
+  if (sleeping_worker_count_ > 0) {
+    absl::MutexLock lock(&sleep_mutex_);
+    sleep_cond_var_.Signal();
+  }
+}
+
+void WorkStealingThreadPool::Shutdown() {
+  shutdown_initiated_ = true;
+  absl::MutexLock lock(&sleep_mutex_);
+  sleep_cond_var_.SignalAll();
+}
+
+void WorkStealingThreadPool::Wait() {
+  CHECK(shutdown_initiated_);
+  for (const std::unique_ptr<Worker>& worker : workers_) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+}
+
+std::unique_ptr<Action> WorkStealingThreadPool::TakeAction(
+    size_t worker_index) {
+  if (scheduled_high_priority_action_count_ > 0) {
+    std::unique_ptr<Action> action =
+        TakeAction(worker_index, Priority::kHigh);
+    if (action != nullptr) {
+      return action;
+    }
+  }
+  return TakeAction(worker_index, Priority::kNormal);
+}
+
+std::unique_ptr<Action> WorkStealingThreadPool::TakeAction(
+    size_t worker_index, Priority priority) {
+  // Start from the own queue, then steal from the following workers.
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    Worker& worker = *workers_[(worker_index + i) % workers_.size()];
+    absl::MutexLock lock(&worker.mutex);
+    std::deque<std::unique_ptr<Action>>& actions =
+        priority == Priority::kHigh ? worker.high_priority_actions
+                                    : worker.actions;
+    if (actions.empty()) {
+      continue;
+    }
+
+    std::unique_ptr<Action> action;
+    if (i == 0) {
+      action = std::move(actions.back());
+      actions.pop_back();
+    } else {
+      action = std::move(actions.front());
+      actions.pop_front();
+    }
+    if (priority == Priority::kHigh) {
+      --scheduled_high_priority_action_count_;
+    }
+    --scheduled_action_count_;
+    return action;
+  }
+  return nullptr;
+}
+
+void WorkStealingThreadPool::WorkerFunction(size_t worker_index) {
+  current_thread_pool = this;
+  current_worker_index = worker_index;
+
+  while (true) {
+    std::unique_ptr<Action> action = TakeAction(worker_index);
+    if (action != nullptr) {
+      action->Execute();
+      continue;
+    }
+
+    absl::MutexLock lock(&sleep_mutex_);
+    ++sleeping_worker_count_;
+    while (scheduled_action_count_ == 0 && !shutdown_initiated_) {
+      sleep_cond_var_.Wait(&sleep_mutex_);
+    }
+    --sleeping_worker_count_;
+
+    // Queued actions are still executed after Shutdown.
+    if (scheduled_action_count_ == 0) {
+      break;
+    }
+  }
+
+  current_thread_pool = nullptr;
+}
+
+}  // namespace
+
+std::unique_ptr<ThreadPool> ThreadPool::CreateWorkStealing(
+    size_t thread_count) {
+  return std::make_unique<WorkStealingThreadPool>(thread_count);
+}
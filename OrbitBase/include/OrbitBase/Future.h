@@ -0,0 +1,317 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_BASE_FUTURE_H_
+#define ORBIT_BASE_FUTURE_H_
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "OrbitBase/Action.h"
+#include "OrbitBase/Logging.h"
+#include "absl/synchronization/mutex.h"
+
+// Future and Promise chain asynchronous work without blocking any thread.
+// A Future is the result of some work that may not be finished yet: Then
+// schedules a continuation on an executor, i.e., any class with a
+// Schedule(std::unique_ptr<Action>) method like ThreadPool or
+// MainThreadExecutor, once the result is available. WhenAll combines several
+// futures, so that independent work can overlap.
+//
+// A Future can be cancelled: its continuations that haven't started yet are
+// then not executed, and the futures returned by them are cancelled as well.
+// The work producing the result can check Promise::IsCancelled to stop early.
+//
+// Usage example:
+//
+// Future<Symbols> symbols = ScheduleWithFuture(thread_pool, [=] {
+//   return LoadSymbols(module);
+// });
+// symbols.Then(main_thread_executor, [=](const Symbols& symbols) {
+//   UpdateModulesView(symbols);
+// });
+//
+namespace OrbitBase {
+
+template <typename T>
+class Future;
+
+namespace internal {
+
+// Futures of void hold an empty value, so that they can share the same code.
+template <typename T>
+struct FutureValue {
+  using type = T;
+};
+template <>
+struct FutureValue<void> {
+  using type = std::monostate;
+};
+
+template <typename T, typename F>
+struct ContinuationResult {
+  using type = std::invoke_result_t<F, const T&>;
+};
+template <typename F>
+struct ContinuationResult<void, F> {
+  using type = std::invoke_result_t<F>;
+};
+
+template <typename T>
+class FutureState {
+ public:
+  using Value = typename FutureValue<T>::type;
+
+  // Only the first of SetValue and Cancel has an effect.
+  void SetValue(Value value) {
+    std::vector<std::unique_ptr<Action>> callbacks;
+    {
+      absl::MutexLock lock(&mutex_);
+      if (IsDone()) {
+        return;
+      }
+      value_.emplace(std::move(value));
+      callbacks = std::move(callbacks_);
+    }
+    ExecuteCallbacks(&callbacks);
+  }
+
+  void Cancel() {
+    std::vector<std::unique_ptr<Action>> callbacks;
+    {
+      absl::MutexLock lock(&mutex_);
+      if (IsDone()) {
+        return;
+      }
+      cancelled_ = true;
+      callbacks = std::move(callbacks_);
+    }
+    ExecuteCallbacks(&callbacks);
+  }
+
+  [[nodiscard]] bool IsFinished() {
+    absl::MutexLock lock(&mutex_);
+    return value_.has_value();
+  }
+
+  [[nodiscard]] bool IsCancelled() {
+    absl::MutexLock lock(&mutex_);
+    return cancelled_;
+  }
+
+  void Wait() {
+    absl::MutexLock lock(&mutex_);
+    mutex_.Await(absl::Condition(this, &FutureState::IsDone));
+  }
+
+  // The value never changes once set, hence it can be read without the lock.
+  const Value& Get() {
+    Wait();
+    CHECK(!IsCancelled());
+    return *value_;
+  }
+
+  // Executes callback once the value is set or the state cancelled, on the
+  // thread that does so, or right away if that already happened.
+  void OnDone(std::unique_ptr<Action> callback) {
+    {
+      absl::MutexLock lock(&mutex_);
+      if (!IsDone()) {
+        callbacks_.push_back(std::move(callback));
+        return;
+      }
+    }
+    callback->Execute();
+  }
+
+ private:
+  [[nodiscard]] bool IsDone() const { return value_.has_value() || cancelled_; }
+
+  static void ExecuteCallbacks(
+      std::vector<std::unique_ptr<Action>>* callbacks) {
+    for (std::unique_ptr<Action>& callback : *callbacks) {
+      callback->Execute();
+    }
+  }
+
+  absl::Mutex mutex_;
+  std::optional<Value> value_;
+  bool cancelled_ = false;
+  std::vector<std::unique_ptr<Action>> callbacks_;
+};
+
+}  // namespace internal
+
+// The producing side of a Future. It must eventually set the value, or be
+// cancelled, for the continuations of the Future to be executed.
+template <typename T>
+class Promise {
+ public:
+  using Value = typename internal::FutureValue<T>::type;
+
+  Promise() : state_{std::make_shared<internal::FutureState<T>>()} {}
+
+  [[nodiscard]] Future<T> GetFuture() const { return Future<T>{state_}; }
+
+  void SetValue(Value value) const { state_->SetValue(std::move(value)); }
+  template <typename U = T, typename = std::enable_if_t<std::is_void_v<U>>>
+  void SetValue() const {
+    state_->SetValue(Value{});
+  }
+
+  void Cancel() const { state_->Cancel(); }
+  [[nodiscard]] bool IsCancelled() const { return state_->IsCancelled(); }
+
+ private:
+  std::shared_ptr<internal::FutureState<T>> state_;
+};
+
+template <typename T>
+class Future {
+ public:
+  using Value = typename internal::FutureValue<T>::type;
+
+  // A default-constructed Future is not valid and must not be used.
+  Future() = default;
+
+  [[nodiscard]] bool IsValid() const { return state_ != nullptr; }
+  [[nodiscard]] bool IsFinished() const { return state_->IsFinished(); }
+  [[nodiscard]] bool IsCancelled() const { return state_->IsCancelled(); }
+
+  void Cancel() const { state_->Cancel(); }
+
+  // Executes callback on the thread that finishes or cancels this Future, or
+  // right away if that already happened. Meant for short callbacks, as they
+  // run on the producing thread; use Then for any actual work.
+  template <typename F>
+  void OnDone(F&& callback) const {
+    state_->OnDone(CreateAction(std::forward<F>(callback)));
+  }
+
+  // Blocks until the Future is finished or cancelled.
+  void Wait() const { state_->Wait(); }
+
+  // Blocks until the Future is finished. The Future must not be cancelled.
+  const Value& Get() const { return state_->Get(); }
+
+  // Schedules continuation on executor once this Future is finished, with
+  // the value as argument unless T is void, and returns the Future of the
+  // result of continuation. The continuation is not executed if this Future,
+  // or the returned one, is cancelled before it starts. executor must outlive
+  // the pending continuations.
+  template <typename Executor, typename F>
+  auto Then(Executor* executor, F&& continuation) const
+      -> Future<typename internal::ContinuationResult<T, F>::type> {
+    using Result = typename internal::ContinuationResult<T, F>::type;
+    Promise<Result> promise;
+    Future<Result> future = promise.GetFuture();
+    state_->OnDone(CreateAction(
+        [executor, state = state_, promise,
+         continuation = std::forward<F>(continuation)]() mutable {
+          if (state->IsCancelled()) {
+            promise.Cancel();
+            return;
+          }
+          executor->Schedule(CreateAction(
+              [state = std::move(state), promise = std::move(promise),
+               continuation = std::move(continuation)]() mutable {
+                if (promise.IsCancelled()) {
+                  return;
+                }
+                CallContinuation(&promise, &continuation, state->Get());
+              }));
+        }));
+    return future;
+  }
+
+ private:
+  template <typename U>
+  friend class Promise;
+  template <typename U>
+  friend class Future;
+
+  explicit Future(std::shared_ptr<internal::FutureState<T>> state)
+      : state_{std::move(state)} {}
+
+  template <typename Result, typename F>
+  static void CallContinuation(Promise<Result>* promise, F* continuation,
+                               const Value& value) {
+    if constexpr (std::is_void_v<Result>) {
+      if constexpr (std::is_void_v<T>) {
+        (*continuation)();
+      } else {
+        (*continuation)(value);
+      }
+      promise->SetValue();
+    } else {
+      if constexpr (std::is_void_v<T>) {
+        promise->SetValue((*continuation)());
+      } else {
+        promise->SetValue((*continuation)(value));
+      }
+    }
+  }
+
+  std::shared_ptr<internal::FutureState<T>> state_;
+};
+
+// Schedules action on executor and returns the Future of its result.
+template <typename Executor, typename F>
+auto ScheduleWithFuture(Executor* executor, F&& action)
+    -> Future<std::invoke_result_t<F>> {
+  Promise<void> started;
+  started.SetValue();
+  return started.GetFuture().Then(executor, std::forward<F>(action));
+}
+
+// Returns a Future that is finished once all futures are, with their values
+// in the same order unless T is void, or that is cancelled as soon as one of
+// them is cancelled.
+template <typename T>
+auto WhenAll(std::vector<Future<T>> futures)
+    -> Future<std::conditional_t<std::is_void_v<T>, void, std::vector<T>>> {
+  using Result = std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+  Promise<Result> promise;
+  Future<Result> future = promise.GetFuture();
+  if (futures.empty()) {
+    promise.SetValue({});
+    return future;
+  }
+
+  auto shared_futures =
+      std::make_shared<std::vector<Future<T>>>(std::move(futures));
+  auto remaining_count =
+      std::make_shared<std::atomic<size_t>>(shared_futures->size());
+  for (size_t i = 0; i < shared_futures->size(); ++i) {
+    (*shared_futures)[i].OnDone([promise, shared_futures, remaining_count, i] {
+      if ((*shared_futures)[i].IsCancelled()) {
+        promise.Cancel();
+        return;
+      }
+      if (--*remaining_count > 0) {
+        return;
+      }
+      if constexpr (std::is_void_v<T>) {
+        promise.SetValue();
+      } else {
+        std::vector<T> values;
+        values.reserve(shared_futures->size());
+        for (const Future<T>& finished : *shared_futures) {
+          values.push_back(finished.Get());
+        }
+        promise.SetValue(std::move(values));
+      }
+    });
+  }
+  return future;
+}
+
+}  // namespace OrbitBase
+
+#endif  // ORBIT_BASE_FUTURE_H_
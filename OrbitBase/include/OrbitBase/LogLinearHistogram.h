@@ -0,0 +1,94 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_BASE_LOG_LINEAR_HISTOGRAM_H_
+#define ORBIT_BASE_LOG_LINEAR_HISTOGRAM_H_
+
+#include <cmath>
+#include <cstdint>
+#include <optional>
+
+namespace OrbitBase {
+
+// Bucketing of uint64_t values in the style of HdrHistogram: each power of two
+// is split in SUB_BUCKET_COUNT linear buckets, so that the width of a bucket is
+// at most 1/SUB_BUCKET_COUNT of the values in it. Values lower than
+// SUB_BUCKET_COUNT each have their own bucket. This covers the whole uint64_t
+// range with BUCKET_COUNT buckets, with a bounded relative error, which makes
+// it suitable for durations in nanoseconds.
+class LogLinearHistogram {
+ public:
+  static constexpr uint32_t SUB_BUCKET_BITS = 4;
+  static constexpr uint64_t SUB_BUCKET_COUNT = 1lu << SUB_BUCKET_BITS;
+  static constexpr size_t BUCKET_COUNT =
+      (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+  static constexpr size_t GetBucketIndex(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+      return value;
+    }
+    const uint32_t exponent = 63 - __builtin_clzl(value);
+    const uint32_t shift = exponent - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKET_COUNT +
+           ((value >> shift) & (SUB_BUCKET_COUNT - 1));
+  }
+
+  // The lowest value in the bucket.
+  static constexpr uint64_t GetBucketLowerBound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+      return index;
+    }
+    const uint32_t shift = index / SUB_BUCKET_COUNT - 1;
+    return (SUB_BUCKET_COUNT + index % SUB_BUCKET_COUNT) << shift;
+  }
+
+  // The highest value in the bucket.
+  static constexpr uint64_t GetBucketUpperBound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+      return index;
+    }
+    const uint32_t shift = index / SUB_BUCKET_COUNT - 1;
+    return GetBucketLowerBound(index) + ((1lu << shift) - 1);
+  }
+
+  // Returns a value such that (about) the given fraction, between 0 and 1, of
+  // the values counted in bucket_counts are not larger, i.e., the percentile
+  // fraction * 100. This is the middle of the bucket that contains it, hence
+  // at most half a bucket width away from the exact percentile.
+  // bucket_counts[i] is the number of values in the bucket with index i, and
+  // can be shorter than BUCKET_COUNT if the following buckets are empty.
+  // Returns nullopt if bucket_counts is empty or only contains zeros.
+  template <typename Container>
+  static std::optional<uint64_t> ComputeQuantile(
+      const Container& bucket_counts, double fraction) {
+    uint64_t total_count = 0;
+    for (uint64_t count : bucket_counts) {
+      total_count += count;
+    }
+    if (total_count == 0) {
+      return std::nullopt;
+    }
+
+    auto rank = static_cast<uint64_t>(
+        std::ceil(fraction * static_cast<double>(total_count)));
+    if (rank == 0) {
+      rank = 1;
+    }
+    uint64_t cumulative_count = 0;
+    size_t index = 0;
+    for (uint64_t count : bucket_counts) {
+      cumulative_count += count;
+      if (cumulative_count >= rank) {
+        break;
+      }
+      ++index;
+    }
+    const uint64_t lower_bound = GetBucketLowerBound(index);
+    return lower_bound + (GetBucketUpperBound(index) - lower_bound) / 2;
+  }
+};
+
+}  // namespace OrbitBase
+
+#endif  // ORBIT_BASE_LOG_LINEAR_HISTOGRAM_H_
@@ -5,9 +5,12 @@
 #ifndef ORBIT_BASE_LOGGING_H_
 #define ORBIT_BASE_LOGGING_H_
 
+#include <atomic>
+#include <cstdint>
 #include <cstdio>
 #include <filesystem>
 #include <fstream>
+#include <string>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -15,24 +18,14 @@
 
 #include "absl/strings/str_format.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 
 #ifdef __clang__
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wgnu-zero-variadic-macro-arguments"
 #endif
 
-#define LOG(format, ...)                                                      \
-  do {                                                                        \
-    std::string file__ = std::filesystem::path(__FILE__).filename().string(); \
-    std::string file_and_line__ =                                             \
-        absl::StrFormat("%s:%d", file__.c_str(), __LINE__);                   \
-    if (file_and_line__.size() > 28)                                          \
-      file_and_line__ =                                                       \
-          "..." + file_and_line__.substr(file_and_line__.size() - 25);        \
-    std::string formatted_log__ = absl::StrFormat(                            \
-        "[%28s] " format "\n", file_and_line__.c_str(), ##__VA_ARGS__);       \
-    PLATFORM_LOG(formatted_log__.c_str());                                    \
-  } while (0)
+#define LOG(format, ...) ORBIT_INTERNAL_LOG(LogSync, format, ##__VA_ARGS__)
 
 #if defined(_WIN32) && defined(ERROR)
 #undef ERROR
@@ -40,9 +33,28 @@
 
 #define ERROR(format, ...) LOG("Error: " format, ##__VA_ARGS__)
 
+// For the call sites that can be reached for every event, like the failure
+// modes of the tracing: at most one message per second is logged, with the
+// count of the messages suppressed since the previous one, and it is written
+// by a background thread, so that a burst of errors doesn't turn into as
+// many synchronous writes on the threads that hit them.
+#define LOG_RATE_LIMITED(format, ...)                                        \
+  do {                                                                       \
+    static LogRateLimiter rate_limiter__;                                    \
+    uint64_t suppressed_count__;                                             \
+    if (rate_limiter__.ShouldLog(&suppressed_count__)) {                     \
+      ORBIT_INTERNAL_LOG(LogAsync, format "%s", ##__VA_ARGS__,               \
+                         FormatSuppressedCount(suppressed_count__).c_str()); \
+    }                                                                        \
+  } while (0)
+
+#define ERROR_RATE_LIMITED(format, ...) \
+  LOG_RATE_LIMITED("Error: " format, ##__VA_ARGS__)
+
 #define FATAL(format, ...)                \
   do {                                    \
     LOG("Fatal: " format, ##__VA_ARGS__); \
+    FlushAsyncLog();                      \
     abort();                              \
   } while (0)
 
@@ -67,6 +79,7 @@
   do {                                  \
     if (UNLIKELY(!(assertion))) {       \
       LOG("Check failed: " #assertion); \
+      FlushAsyncLog();                  \
       PLATFORM_ABORT();                 \
     }                                   \
   } while (0)
@@ -83,7 +96,45 @@ extern std::ofstream log_file;
 void InitLogFile(const std::string& path);
 void LogToFile(const std::string& message);
 
+// Queues message to be written by the background thread of the asynchronous
+// log, without blocking: the messages that don't fit in its ring buffer are
+// dropped, and counted in the next message written.
+void LogAsync(std::string message);
+// Writes the messages queued by LogAsync, e.g., before aborting. Also called
+// at exit.
+void FlushAsyncLog();
+
+// The state of the call site of LOG_RATE_LIMITED. Constant-initialized and
+// lock-free, as it is checked on every call.
+class LogRateLimiter {
+ public:
+  static constexpr absl::Duration kInterval = absl::Seconds(1);
+
+  constexpr LogRateLimiter() = default;
+
+  // Returns whether the call should log, and then the count of the calls
+  // suppressed since the previous one that logged in suppressed_count.
+  [[nodiscard]] bool ShouldLog(uint64_t* suppressed_count,
+                               absl::Time now = absl::Now());
+
+ private:
+  std::atomic<int64_t> next_log_ns_{0};
+  std::atomic<uint64_t> suppressed_count_{0};
+};
+
+[[nodiscard]] std::string FormatSuppressedCount(uint64_t suppressed_count);
+
 // Internal.
+[[nodiscard]] std::string FormatLogFileAndLine(const char* file, int line);
+
+#define ORBIT_INTERNAL_LOG(write, format, ...)                            \
+  do {                                                                    \
+    static const std::string file_and_line__ =                            \
+        FormatLogFileAndLine(__FILE__, __LINE__);                         \
+    write(absl::StrFormat("[%28s] " format "\n", file_and_line__.c_str(), \
+                          ##__VA_ARGS__));                                \
+  } while (0)
+
 #if defined(_WIN32)
 #define PLATFORM_LOG(message)       \
   do {                              \
@@ -105,6 +156,10 @@ void LogToFile(const std::string& message);
 #define PLATFORM_ABORT() abort()
 #endif
 
+inline void LogSync(const std::string& message) {
+  PLATFORM_LOG(message.c_str());
+}
+
 #ifdef __clang__
 #pragma clang diagnostic pop
 #endif
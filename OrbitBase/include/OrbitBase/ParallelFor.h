@@ -0,0 +1,83 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_BASE_PARALLEL_FOR_H_
+#define ORBIT_BASE_PARALLEL_FOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include "OrbitBase/Logging.h"
+#include "OrbitBase/ThreadPool.h"
+#include "absl/synchronization/mutex.h"
+
+// Calls body(i) for every i in [begin, end) on the worker threads of
+// thread_pool and on the calling thread, and returns once all the calls have
+// returned. The indices are taken in chunks of grain_size, so that the cost of
+// taking them doesn't dominate when body is very short.
+//
+// As the calling thread takes part in the work, ParallelFor can also be called
+// from an action executed by thread_pool, even when all its workers are busy.
+//
+// Usage example:
+//
+// ParallelFor(thread_pool, 0, modules.size(), [&](size_t i) {
+//   LoadSymbols(&modules[i]);
+// });
+//
+template <typename F>
+void ParallelFor(ThreadPool* thread_pool, size_t begin, size_t end, F&& body,
+                 size_t grain_size = 1) {
+  CHECK(grain_size > 0);
+  if (begin >= end) {
+    return;
+  }
+
+  // Shared with the actions, as some of them might only start after we return.
+  struct State {
+    explicit State(size_t chunk_count) : chunk_count{chunk_count} {}
+    const size_t chunk_count;
+    std::atomic<size_t> next_chunk = 0;
+    absl::Mutex mutex;
+    size_t done_chunk_count = 0;
+  };
+  auto state = std::make_shared<State>((end - begin - 1) / grain_size + 1);
+
+  // An action that starts after all chunks have been taken doesn't call body,
+  // hence body doesn't need to outlive this function.
+  auto run_chunks = [state, begin, end, grain_size, &body] {
+    size_t done_chunk_count = 0;
+    for (size_t chunk = state->next_chunk++; chunk < state->chunk_count;
+         chunk = state->next_chunk++) {
+      const size_t chunk_begin = begin + chunk * grain_size;
+      const size_t chunk_end = std::min(end, chunk_begin + grain_size);
+      for (size_t i = chunk_begin; i < chunk_end; ++i) {
+        body(i);
+      }
+      ++done_chunk_count;
+    }
+    if (done_chunk_count > 0) {
+      absl::MutexLock lock(&state->mutex);
+      state->done_chunk_count += done_chunk_count;
+    }
+  };
+
+  const size_t action_count =
+      std::min(thread_pool->GetPoolSize(), state->chunk_count - 1);
+  for (size_t i = 0; i < action_count; ++i) {
+    thread_pool->Schedule(run_chunks);
+  }
+  run_chunks();
+
+  absl::MutexLock lock(&state->mutex);
+  state->mutex.Await(absl::Condition(
+      +[](State* done_state) {
+        return done_state->done_chunk_count == done_state->chunk_count;
+      },
+      state.get()));
+}
+
+#endif  // ORBIT_BASE_PARALLEL_FOR_H_
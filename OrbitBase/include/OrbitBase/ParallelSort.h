@@ -0,0 +1,66 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_BASE_PARALLEL_SORT_H_
+#define ORBIT_BASE_PARALLEL_SORT_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include "OrbitBase/Logging.h"
+#include "OrbitBase/ParallelFor.h"
+#include "OrbitBase/ThreadPool.h"
+
+// Sorts [first, last) like std::stable_sort, on the worker threads of
+// thread_pool and on the calling thread. The range is split into one chunk per
+// thread, the chunks are sorted in parallel, and then adjacent runs are merged
+// pairwise, in parallel, until a single run is left. Ranges of fewer than
+// twice min_chunk_size elements are sorted on the calling thread only, as
+// splitting them costs more than it saves.
+//
+// Like ParallelFor, this can be called from an action executed by thread_pool.
+template <typename RandomIt, typename Compare>
+void ParallelStableSort(ThreadPool* thread_pool, RandomIt first, RandomIt last,
+                        Compare comp, size_t min_chunk_size = 1 << 14) {
+  CHECK(min_chunk_size > 0);
+  const size_t size = std::distance(first, last);
+  const size_t chunk_count =
+      std::min(thread_pool->GetPoolSize() + 1, size / min_chunk_size);
+  if (chunk_count <= 1) {
+    std::stable_sort(first, last, comp);
+    return;
+  }
+
+  // Run i is [first + run_bounds[i], first + run_bounds[i + 1]).
+  std::vector<size_t> run_bounds(chunk_count + 1);
+  for (size_t i = 0; i <= chunk_count; ++i) {
+    run_bounds[i] = size * i / chunk_count;
+  }
+  ParallelFor(thread_pool, 0, chunk_count, [&](size_t i) {
+    std::stable_sort(first + run_bounds[i], first + run_bounds[i + 1], comp);
+  });
+
+  // Only adjacent runs are merged, the left one first, which keeps the sort
+  // stable.
+  while (run_bounds.size() > 2) {
+    const size_t merge_count = (run_bounds.size() - 1) / 2;
+    ParallelFor(thread_pool, 0, merge_count, [&](size_t i) {
+      std::inplace_merge(first + run_bounds[2 * i],
+                         first + run_bounds[2 * i + 1],
+                         first + run_bounds[2 * i + 2], comp);
+    });
+    std::vector<size_t> merged_run_bounds;
+    for (size_t i = 0; i < run_bounds.size(); i += 2) {
+      merged_run_bounds.push_back(run_bounds[i]);
+    }
+    if (merged_run_bounds.back() != run_bounds.back()) {
+      merged_run_bounds.push_back(run_bounds.back());
+    }
+    run_bounds.swap(merged_run_bounds);
+  }
+}
+
+#endif  // ORBIT_BASE_PARALLEL_SORT_H_
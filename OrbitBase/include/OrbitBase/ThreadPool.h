@@ -6,6 +6,7 @@
 #define ORBIT_BASE_THREAD_POOL_H_
 
 #include <memory>
+#include <utility>
 
 #include "OrbitBase/Action.h"
 #include "absl/time/time.h"
@@ -29,14 +30,22 @@
 //
 class ThreadPool {
  public:
+  // Actions with kHigh priority are executed before all the kNormal actions
+  // that are still waiting, e.g., for actions that block the UI.
+  enum class Priority { kNormal, kHigh };
+
   ThreadPool() = default;
   virtual ~ThreadPool() = default;
 
-  virtual void Schedule(std::unique_ptr<Action> action) = 0;
+  void Schedule(std::unique_ptr<Action> action) {
+    Schedule(std::move(action), Priority::kNormal);
+  }
+  virtual void Schedule(std::unique_ptr<Action> action,
+                        Priority priority) = 0;
 
   template <typename F>
-  void Schedule(F&& functor) {
-    Schedule(CreateAction(std::forward<F>(functor)));
+  void Schedule(F&& functor, Priority priority = Priority::kNormal) {
+    Schedule(CreateAction(std::forward<F>(functor)), priority);
   }
 
   // Initiates shutdown, any Schedule after this call will fail.
@@ -70,6 +79,18 @@ class ThreadPool {
   static std::unique_ptr<ThreadPool> Create(size_t thread_pool_min_size,
                                             size_t thread_pool_max_size,
                                             absl::Duration thread_ttl);
+
+  // Create ThreadPool with a fixed number of worker threads, meant for many
+  // short actions, e.g., the ones of ParallelFor.
+  //
+  // Each worker thread has its own queues of actions, so that workers don't
+  // contend on a single lock. An action scheduled from a worker thread goes to
+  // the queue of that worker, which executes the most recent action of its
+  // queue first, as its data is likely still in cache. An action scheduled
+  // from any other thread goes to the queues in turn. A worker whose queue is
+  // empty takes the oldest action of the queue of another worker. Workers only
+  // go to sleep when there are no actions left at all.
+  static std::unique_ptr<ThreadPool> CreateWorkStealing(size_t thread_count);
 };
 
 #endif  // ORBIT_BASE_THREAD_POOL_H_
@@ -5,9 +5,13 @@
 #ifndef ORBIT_TRACING_TRACING_H_
 #define ORBIT_TRACING_TRACING_H_
 
-#include <memory>
+#include <atomic>
 
-#define ORBIT_TRACING_ENABLED 0
+// Scopes are compiled in by default, as they cost a single predicted branch
+// while no handler is set. Define ORBIT_TRACING_ENABLED to 0 to remove them.
+#ifndef ORBIT_TRACING_ENABLED
+#define ORBIT_TRACING_ENABLED 1
+#endif
 
 #if ORBIT_TRACING_ENABLED
 
@@ -26,11 +30,18 @@
 #define ORBIT_CONCAT_IND(x, y) (x##y)
 #define ORBIT_CONCAT(x, y) ORBIT_CONCAT_IND(x, y)
 #define ORBIT_UNIQUE(x) ORBIT_CONCAT(x, __COUNTER__)
-#define ORBIT_CALL(f)               \
-  do {                              \
-    if (orbit::tracing::GHandler) { \
-      orbit::tracing::GHandler->f;  \
-    }                               \
+#if defined(__GNUC__) || defined(__clang__)
+#define ORBIT_TRACING_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define ORBIT_TRACING_UNLIKELY(x) (x)
+#endif
+#define ORBIT_CALL(f)                                               \
+  do {                                                              \
+    orbit::tracing::Handler* orbit_tracing_handler =                \
+        orbit::tracing::GHandler.load(std::memory_order_relaxed);   \
+    if (ORBIT_TRACING_UNLIKELY(orbit_tracing_handler != nullptr)) { \
+      orbit_tracing_handler->f;                                     \
+    }                                                               \
   } while (0)
 
 namespace orbit::tracing {
@@ -44,12 +55,27 @@ class Handler {
   virtual void Track(const char* name, float) = 0;
 };
 
-// This must be instantiated in user code.
-extern std::unique_ptr<Handler> GHandler;
+// This must be instantiated in user code. The handler is not owned: as scopes
+// can still be open on other threads when it is unset, a handler that was set
+// is never destroyed.
+extern std::atomic<Handler*> GHandler;
 
+// A scope that began with a handler also ends with it, even if GHandler has
+// changed in the meantime.
 struct Scope {
-  explicit Scope(const char* name) { ORBIT_BEGIN(name); }
-  ~Scope() { ORBIT_END; }
+  explicit Scope(const char* name)
+      : handler{GHandler.load(std::memory_order_relaxed)} {
+    if (ORBIT_TRACING_UNLIKELY(handler != nullptr)) {
+      handler->Begin(name);
+    }
+  }
+  ~Scope() {
+    if (ORBIT_TRACING_UNLIKELY(handler != nullptr)) {
+      handler->End();
+    }
+  }
+
+  Handler* handler;
 };
 
 }  // namespace orbit::tracing
@@ -60,7 +86,7 @@ struct Scope {
 #define ORBIT_SCOPE_FUNC
 #define ORBIT_BEGIN(name)
 #define ORBIT_END
-#define ORBIT_TRACK(var)
+#define ORBIT_TRACK(name, var)
 
 #endif  // ORBIT_TRACING_ENABLED
 
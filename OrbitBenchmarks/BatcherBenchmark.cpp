@@ -0,0 +1,94 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "Batcher.h"
+#include "CoreMath.h"
+#include "PickingManager.h"
+
+namespace {
+
+constexpr float kBoxHeight = 20.f;
+constexpr float kZ = -0.1f;
+
+Color GetColor(int64_t index) {
+  return Color(static_cast<unsigned char>(index * 17),
+               static_cast<unsigned char>(index * 31),
+               static_cast<unsigned char>(index * 7), 255);
+}
+
+// Fills the batcher with the boxes of the visible timers, as TimerTrack does
+// every frame, each with the PickingUserData for its tooltip.
+void BM_BatcherAddShadedBoxes(benchmark::State& state) {
+  Batcher batcher(PickingID::BatcherId::TIME_GRAPH);
+  for (auto _ : state) {
+    batcher.Reset();
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      Vec2 pos(static_cast<float>(i % 1000), (i / 1000) * kBoxHeight);
+      Vec2 size(0.8f, kBoxHeight);
+      auto user_data = std::make_unique<PickingUserData>(
+          nullptr, [](PickingID) { return std::string(); });
+      batcher.AddShadedBox(pos, size, kZ, GetColor(i), PickingID::BOX,
+                           std::move(user_data));
+    }
+    benchmark::DoNotOptimize(batcher.GetBoxBuffer().m_Boxes.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BatcherAddShadedBoxes)
+    ->Arg(10'000)
+    ->Arg(100'000)
+    ->Arg(1'000'000)
+    ->Unit(benchmark::kMicrosecond);
+
+// The timers narrower than a pixel are drawn as vertical lines instead.
+void BM_BatcherAddVerticalLines(benchmark::State& state) {
+  Batcher batcher(PickingID::BatcherId::TIME_GRAPH);
+  for (auto _ : state) {
+    batcher.Reset();
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      Vec2 pos(static_cast<float>(i % 2000), (i / 2000) * kBoxHeight);
+      batcher.AddVerticalLine(pos, kBoxHeight, kZ, GetColor(i),
+                              PickingID::LINE);
+    }
+    benchmark::DoNotOptimize(batcher.GetLineBuffer().m_Lines.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BatcherAddVerticalLines)
+    ->Arg(10'000)
+    ->Arg(100'000)
+    ->Arg(1'000'000)
+    ->Unit(benchmark::kMicrosecond);
+
+// Tracks fill batchers of their own in parallel, which are then appended to
+// the one of the time graph.
+void BM_BatcherAppend(benchmark::State& state) {
+  Batcher batcher(PickingID::BatcherId::TIME_GRAPH);
+  Batcher track_batcher(PickingID::BatcherId::TIME_GRAPH);
+  for (auto _ : state) {
+    state.PauseTiming();
+    batcher.Reset();
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      Vec2 pos(static_cast<float>(i % 1000), (i / 1000) * kBoxHeight);
+      track_batcher.AddShadedBox(pos, Vec2(0.8f, kBoxHeight), kZ, GetColor(i),
+                                 PickingID::BOX);
+    }
+    state.ResumeTiming();
+    batcher.Append(&track_batcher);
+    benchmark::DoNotOptimize(batcher.GetBoxBuffer().m_Boxes.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BatcherAppend)
+    ->Arg(10'000)
+    ->Arg(100'000)
+    ->Unit(benchmark::kMicrosecond);
+
+}  // namespace
@@ -0,0 +1,125 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+
+#include "BlockChain.h"
+#include "capture_data.pb.h"
+
+using orbit_client_protos::CallstackEvent;
+
+namespace {
+
+// As the callstack events of SamplingProfiler.
+using CallstackEventChain = BlockChain<CallstackEvent, 16 * 1024>;
+// As the colors of the boxes of Batcher, four per box.
+using ColorChain = BlockChain<uint32_t, 4 * 64 * 1024>;
+
+CallstackEvent CreateCallstackEvent(uint64_t index) {
+  CallstackEvent event;
+  event.set_time(1'000'000 * index);
+  event.set_thread_id(static_cast<int32_t>(1 + index / 50 % 64));
+  event.set_callstack_hash(index % 20'000);
+  return event;
+}
+
+void FillCallstackEventChain(int64_t count, CallstackEventChain* chain) {
+  for (int64_t i = 0; i < count; ++i) {
+    chain->push_back(CreateCallstackEvent(i));
+  }
+}
+
+void BM_BlockChainPushBackCallstackEvents(benchmark::State& state) {
+  for (auto _ : state) {
+    CallstackEventChain chain;
+    FillCallstackEventChain(state.range(0), &chain);
+    benchmark::DoNotOptimize(chain.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BlockChainPushBackCallstackEvents)
+    ->Arg(100'000)
+    ->Arg(1'000'000)
+    ->Unit(benchmark::kMillisecond);
+
+// Like the buffers of Batcher, refilled every frame after Reset, which keeps
+// the blocks.
+void BM_BlockChainResetAndPushBackColors(benchmark::State& state) {
+  ColorChain chain;
+  for (auto _ : state) {
+    chain.Reset();
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      chain.push_back_n(static_cast<uint32_t>(i), 4);
+    }
+    benchmark::DoNotOptimize(chain.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) * 4);
+}
+BENCHMARK(BM_BlockChainResetAndPushBackColors)
+    ->Arg(10'000)
+    ->Arg(100'000)
+    ->Arg(1'000'000)
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_BlockChainIterate(benchmark::State& state) {
+  CallstackEventChain chain;
+  FillCallstackEventChain(state.range(0), &chain);
+  for (auto _ : state) {
+    uint64_t checksum = 0;
+    for (const CallstackEvent& event : chain) {
+      checksum += event.callstack_hash();
+    }
+    benchmark::DoNotOptimize(checksum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BlockChainIterate)
+    ->Arg(100'000)
+    ->Arg(1'000'000)
+    ->Unit(benchmark::kMicrosecond);
+
+// As the buffers of Batcher are uploaded, one block at a time.
+void BM_BlockChainIterateBlocks(benchmark::State& state) {
+  ColorChain chain;
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    chain.push_back(static_cast<uint32_t>(i));
+  }
+  for (auto _ : state) {
+    uint64_t checksum = 0;
+    for (uint32_t block = 0; block < chain.GetNumBlocks(); ++block) {
+      const uint32_t* data = chain.GetBlockData(block);
+      const uint32_t size = chain.GetBlockSize(block);
+      for (uint32_t i = 0; i < size; ++i) {
+        checksum += data[i];
+      }
+    }
+    benchmark::DoNotOptimize(checksum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BlockChainIterateBlocks)
+    ->Arg(1'000'000)
+    ->Arg(10'000'000)
+    ->Unit(benchmark::kMicrosecond);
+
+// As the neighbors of the selected callstack event are found.
+void BM_BlockChainGetElementAfter(benchmark::State& state) {
+  CallstackEventChain chain;
+  FillCallstackEventChain(state.range(0), &chain);
+  for (auto _ : state) {
+    const CallstackEvent* event = &chain[0];
+    uint64_t count = 0;
+    for (int i = 0; i < 1000 && event != nullptr; ++i) {
+      event = chain.GetElementAfter(event);
+      ++count;
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(BM_BlockChainGetElementAfter)->Arg(100'000)->Arg(1'000'000);
+
+}  // namespace
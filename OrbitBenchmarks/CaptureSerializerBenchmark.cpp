@@ -0,0 +1,148 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "App.h"
+#include "Callstack.h"
+#include "Capture.h"
+#include "CaptureSerializer.h"
+#include "SamplingProfiler.h"
+#include "StringManager.h"
+#include "TimeGraph.h"
+#include "capture_data.pb.h"
+
+using orbit_client_protos::CallstackEvent;
+using orbit_client_protos::TimerInfo;
+
+namespace {
+
+constexpr int32_t kThreadCount = 32;
+constexpr uint32_t kMaxDepth = 8;
+constexpr size_t kUniqueCallstackCount = 1'000;
+// One callstack event for this many timers.
+constexpr int64_t kTimersPerCallstackEvent = 10;
+
+void InitApp() {
+  static bool initialized = OrbitApp::Init({}, nullptr);
+  (void)initialized;
+}
+
+// Fills the time graph and Capture::GSamplingProfiler with a capture of
+// timer_count nested timers over kThreadCount threads and its callstack
+// events, as the events of a live capture are.
+void FillCapture(int64_t timer_count, TimeGraph* time_graph) {
+  std::mt19937_64 random(42);
+  time_graph->Clear();
+  Capture::GSamplingProfiler =
+      std::make_shared<SamplingProfiler>(Capture::GTargetProcess);
+
+  std::vector<CallstackID> callstack_ids;
+  for (size_t i = 0; i < kUniqueCallstackCount; ++i) {
+    CallStack callstack;
+    for (int depth = 0; depth < 20; ++depth) {
+      callstack.m_Data.push_back(0x7f0000000000 + 16 * (random() % 100'000));
+    }
+    callstack_ids.push_back(callstack.Hash());
+    Capture::GSamplingProfiler->AddUniqueCallStack(callstack);
+  }
+
+  std::vector<uint64_t> timestamps(kThreadCount, 1'000'000);
+  for (int64_t i = 0; i < timer_count; ++i) {
+    const int32_t thread_index = static_cast<int32_t>(random() % kThreadCount);
+    const uint32_t depth = static_cast<uint32_t>(i % kMaxDepth);
+    uint64_t& timestamp = timestamps[thread_index];
+    TimerInfo timer_info;
+    timer_info.set_process_id(1);
+    timer_info.set_thread_id(1 + thread_index);
+    timer_info.set_depth(depth);
+    // Deeper timers are nested in the shallower ones that follow them.
+    timer_info.set_start(timestamp + depth * 10);
+    timer_info.set_end(timestamp + (kMaxDepth - depth) * 1'000);
+    timer_info.set_function_address(0x7f0000000000 +
+                                    16 * (random() % 1'000));
+    if (depth == kMaxDepth - 1) {
+      timestamp += kMaxDepth * 1'000 + random() % 10'000;
+    }
+    time_graph->ProcessTimer(std::move(timer_info));
+
+    if (i % kTimersPerCallstackEvent == 0) {
+      CallstackEvent event;
+      event.set_time(timestamp);
+      event.set_thread_id(1 + thread_index);
+      event.set_callstack_hash(callstack_ids[random() % callstack_ids.size()]);
+      Capture::GSamplingProfiler->GetCallstacks()->push_back(event);
+    }
+  }
+  time_graph->ProcessEnqueuedEvents();
+}
+
+// Both are set up the way the client is when saving or loading a capture.
+class CaptureSerializerFixture {
+ public:
+  explicit CaptureSerializerFixture(int64_t timer_count) {
+    InitApp();
+    time_graph_.SetStringManager(std::make_shared<StringManager>());
+    GCurrentTimeGraph = &time_graph_;
+    serializer_.time_graph_ = &time_graph_;
+    FillCapture(timer_count, &time_graph_);
+  }
+  ~CaptureSerializerFixture() { GCurrentTimeGraph = nullptr; }
+
+  CaptureSerializer* GetSerializer() { return &serializer_; }
+
+ private:
+  TimeGraph time_graph_;
+  CaptureSerializer serializer_;
+};
+
+void BM_CaptureSerializerSave(benchmark::State& state) {
+  CaptureSerializerFixture fixture(state.range(0));
+  uint64_t bytes = 0;
+  for (auto _ : state) {
+    std::ostringstream stream;
+    fixture.GetSerializer()->Save(stream);
+    bytes += stream.tellp();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_CaptureSerializerSave)
+    ->Arg(100'000)
+    ->Arg(1'000'000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Loads the capture entirely, chunks included, as Load does for tests and
+// tools, into the time graph it was saved from.
+void BM_CaptureSerializerLoad(benchmark::State& state) {
+  CaptureSerializerFixture fixture(state.range(0));
+  std::ostringstream output;
+  fixture.GetSerializer()->Save(output);
+  const std::string capture = output.str();
+  for (auto _ : state) {
+    std::istringstream input(capture);
+    ErrorMessageOr<void> result = fixture.GetSerializer()->Load(input);
+    if (result.has_error()) {
+      state.SkipWithError(result.error().message().c_str());
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * capture.size());
+}
+BENCHMARK(BM_CaptureSerializerLoad)
+    ->Arg(100'000)
+    ->Arg(1'000'000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,101 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Pdb.h"
+#include "capture_data.pb.h"
+
+using orbit_client_protos::FunctionInfo;
+
+namespace {
+
+constexpr uint64_t kModuleAddress = 0x7f0000000000;
+constexpr uint64_t kLoadBias = 0x400000;
+constexpr size_t kLookupCount = 1024;
+
+// A Pdb with state.range(0) functions of 16 to 1024 bytes, and the relative
+// addresses of their starts.
+std::unique_ptr<Pdb> CreatePdb(int64_t function_count,
+                               std::vector<uint64_t>* function_addresses) {
+  std::mt19937_64 random(42);
+  auto pdb = std::make_unique<Pdb>(kModuleAddress, kLoadBias,
+                                   "/tmp/libbenchmark.so.debug",
+                                   "/tmp/libbenchmark.so");
+  uint64_t address = kLoadBias;
+  for (int64_t i = 0; i < function_count; ++i) {
+    auto function = std::make_shared<FunctionInfo>();
+    const uint64_t size = 16 * (1 + random() % 64);
+    function->set_address(address);
+    function->set_size(size);
+    pdb->AddFunction(function);
+    function_addresses->push_back(address);
+    address += size;
+  }
+  pdb->PopulateFunctionMap();
+  return pdb;
+}
+
+// The absolute program counters of the frames of callstacks: random
+// functions, or, like the samples of the same loop, a few functions that
+// repeat.
+std::vector<uint64_t> CreateProgramCounters(
+    const std::vector<uint64_t>& function_addresses, bool callstack_like) {
+  std::mt19937_64 random(42);
+  std::vector<uint64_t> program_counters;
+  while (program_counters.size() < kLookupCount) {
+    const uint64_t frame_count = callstack_like ? 3 : 1;
+    uint64_t frames[3];
+    for (uint64_t i = 0; i < frame_count; ++i) {
+      frames[i] = function_addresses[random() % function_addresses.size()] -
+                  kLoadBias + kModuleAddress + 4;
+    }
+    const int repetitions = callstack_like ? 100 : 1;
+    for (int i = 0; i < repetitions && program_counters.size() < kLookupCount;
+         ++i) {
+      program_counters.push_back(frames[i % frame_count]);
+    }
+  }
+  return program_counters;
+}
+
+void BM_PdbGetFunctionFromProgramCounter(benchmark::State& state) {
+  std::vector<uint64_t> function_addresses;
+  std::unique_ptr<Pdb> pdb = CreatePdb(state.range(0), &function_addresses);
+  const std::vector<uint64_t> program_counters =
+      CreateProgramCounters(function_addresses, state.range(1) != 0);
+  for (auto _ : state) {
+    for (uint64_t program_counter : program_counters) {
+      benchmark::DoNotOptimize(
+          pdb->GetFunctionFromProgramCounter(program_counter));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * program_counters.size());
+}
+// state.range(1) is whether the lookups are callstack-like.
+BENCHMARK(BM_PdbGetFunctionFromProgramCounter)
+    ->Args({10'000, 0})
+    ->Args({100'000, 0})
+    ->Args({1'000'000, 0})
+    ->Args({100'000, 1});
+
+void BM_PdbPopulateFunctionMap(benchmark::State& state) {
+  std::vector<uint64_t> function_addresses;
+  std::unique_ptr<Pdb> pdb = CreatePdb(state.range(0), &function_addresses);
+  for (auto _ : state) {
+    pdb->PopulateFunctionMap();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PdbPopulateFunctionMap)
+    ->Arg(100'000)
+    ->Arg(1'000'000)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
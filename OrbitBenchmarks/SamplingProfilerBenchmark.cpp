@@ -0,0 +1,107 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Callstack.h"
+#include "SamplingProfiler.h"
+#include "capture_data.pb.h"
+
+using orbit_client_protos::CallstackEvent;
+
+namespace {
+
+constexpr size_t kUniqueCallstackCount = 20'000;
+constexpr size_t kCallstackDepth = 20;
+constexpr size_t kFunctionCount = 200'000;
+constexpr int32_t kThreadCount = 64;
+// Consecutive samples are mostly of the same thread.
+constexpr int64_t kEventsPerThreadSwitch = 50;
+
+// A SamplingProfiler with the unique callstacks of a capture, but no events.
+std::unique_ptr<SamplingProfiler> CreateSamplingProfiler(
+    std::vector<CallstackID>* callstack_ids) {
+  std::mt19937_64 random(42);
+  auto sampling_profiler = std::make_unique<SamplingProfiler>();
+  for (size_t i = 0; i < kUniqueCallstackCount; ++i) {
+    CallStack callstack;
+    for (size_t depth = 0; depth < kCallstackDepth; ++depth) {
+      callstack.m_Data.push_back(0x7f0000000000 +
+                                 16 * (random() % kFunctionCount));
+    }
+    callstack_ids->push_back(callstack.Hash());
+    sampling_profiler->AddUniqueCallStack(callstack);
+  }
+  return sampling_profiler;
+}
+
+void AddCallstackEvents(const std::vector<CallstackID>& callstack_ids,
+                        int64_t event_count, std::mt19937_64* random,
+                        SamplingProfiler* sampling_profiler) {
+  auto* callstacks = sampling_profiler->GetCallstacks();
+  for (int64_t i = 0; i < event_count; ++i) {
+    CallstackEvent event;
+    event.set_time(callstacks->size());
+    event.set_thread_id(static_cast<int32_t>(
+        1 + i / kEventsPerThreadSwitch % kThreadCount));
+    event.set_callstack_hash(callstack_ids[(*random)() % callstack_ids.size()]);
+    callstacks->push_back(event);
+  }
+}
+
+// Processes all the samples of a capture, as when it is loaded or stopped.
+void BM_SamplingProfilerProcessSamples(benchmark::State& state) {
+  std::mt19937_64 random(42);
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::vector<CallstackID> callstack_ids;
+    std::unique_ptr<SamplingProfiler> sampling_profiler =
+        CreateSamplingProfiler(&callstack_ids);
+    AddCallstackEvents(callstack_ids, state.range(0), &random,
+                       sampling_profiler.get());
+    state.ResumeTiming();
+
+    sampling_profiler->ProcessSamples();
+
+    state.PauseTiming();
+    sampling_profiler.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SamplingProfilerProcessSamples)
+    ->Arg(100'000)
+    ->Arg(1'000'000)
+    ->Unit(benchmark::kMillisecond);
+
+// Processes the samples again after 1% more have been added, as the live
+// sampling report does while capturing.
+void BM_SamplingProfilerProcessNewSamples(benchmark::State& state) {
+  std::mt19937_64 random(42);
+  std::vector<CallstackID> callstack_ids;
+  std::unique_ptr<SamplingProfiler> sampling_profiler =
+      CreateSamplingProfiler(&callstack_ids);
+  AddCallstackEvents(callstack_ids, state.range(0), &random,
+                     sampling_profiler.get());
+  sampling_profiler->ProcessSamples();
+  const int64_t new_event_count = state.range(0) / 100;
+  for (auto _ : state) {
+    state.PauseTiming();
+    AddCallstackEvents(callstack_ids, new_event_count, &random,
+                       sampling_profiler.get());
+    state.ResumeTiming();
+    sampling_profiler->ProcessSamples();
+  }
+  state.SetItemsProcessed(state.iterations() * new_event_count);
+}
+BENCHMARK(BM_SamplingProfilerProcessNewSamples)
+    ->Arg(1'000'000)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
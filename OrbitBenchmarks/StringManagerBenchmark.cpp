@@ -0,0 +1,102 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "StringManager.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+
+namespace {
+
+constexpr size_t kLookupCount = 1024;
+
+// Keys are hashes of the strings, like the user data keys of timers.
+uint64_t GetKey(int64_t index) {
+  return 0x9e3779b97f4a7c15ull * static_cast<uint64_t>(index + 1);
+}
+
+// Shared by the threads of the multi-threaded benchmarks, which call this
+// concurrently before they start.
+StringManager* GetStringManager(int64_t string_count) {
+  static absl::Mutex mutex;
+  static StringManager string_manager;
+  static int64_t filled_string_count = 0;
+  absl::MutexLock lock(&mutex);
+  if (filled_string_count != string_count) {
+    string_manager.Clear();
+    for (int64_t i = 0; i < string_count; ++i) {
+      string_manager.AddIfNotPresent(
+          GetKey(i), absl::StrFormat("orbit::ManualInstrumentationScope%d", i));
+    }
+    filled_string_count = string_count;
+  }
+  return &string_manager;
+}
+
+void BM_StringManagerAddIfNotPresent(benchmark::State& state) {
+  for (auto _ : state) {
+    state.PauseTiming();
+    StringManager string_manager;
+    state.ResumeTiming();
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      string_manager.AddIfNotPresent(GetKey(i), "orbit::AsyncSpanName");
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_StringManagerAddIfNotPresent)
+    ->Arg(10'000)
+    ->Arg(100'000)
+    ->Unit(benchmark::kMicrosecond);
+
+// Looks up the strings of the visible timers, as the tracks do every frame,
+// while the other threads do the same.
+void BM_StringManagerGet(benchmark::State& state) {
+  StringManager* string_manager = GetStringManager(state.range(0));
+  std::mt19937_64 random(
+      std::hash<std::thread::id>{}(std::this_thread::get_id()));
+  for (auto _ : state) {
+    for (size_t i = 0; i < kLookupCount; ++i) {
+      std::optional<std::string> str =
+          string_manager->Get(GetKey(random() % state.range(0)));
+      benchmark::DoNotOptimize(str);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kLookupCount);
+}
+BENCHMARK(BM_StringManagerGet)
+    ->Arg(1'000)
+    ->Arg(100'000)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+void BM_StringManagerGetView(benchmark::State& state) {
+  StringManager* string_manager = GetStringManager(state.range(0));
+  std::mt19937_64 random(
+      std::hash<std::thread::id>{}(std::this_thread::get_id()));
+  for (auto _ : state) {
+    for (size_t i = 0; i < kLookupCount; ++i) {
+      std::optional<std::string_view> view =
+          string_manager->GetView(GetKey(random() % state.range(0)));
+      benchmark::DoNotOptimize(view);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kLookupCount);
+}
+BENCHMARK(BM_StringManagerGetView)
+    ->Arg(1'000)
+    ->Arg(100'000)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+}  // namespace
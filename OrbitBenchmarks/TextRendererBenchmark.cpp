@@ -0,0 +1,76 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CoreMath.h"
+#include "GlCanvas.h"
+#include "TextRenderer.h"
+#include "absl/strings/str_format.h"
+
+namespace {
+
+constexpr int kCanvasWidth = 1920;
+constexpr int kCanvasHeight = 1080;
+constexpr float kWorldWidth = 1000.f;
+constexpr float kWorldHeight = 1000.f;
+constexpr float kLineHeight = 20.f;
+
+// Labels like the ones of the timers, with the function name and the
+// duration, of a few hundred distinct strings.
+std::vector<std::string> CreateLabels() {
+  std::vector<std::string> labels;
+  for (int i = 0; i < 500; ++i) {
+    labels.push_back(absl::StrFormat(
+        "orbit_benchmarks::Namespace%d::Function%d(int, float) %d.%03d ms",
+        i % 17, i, i % 13, i * 7 % 1000));
+  }
+  return labels;
+}
+
+// Adds the texts of the visible timers, as the tracks do every frame: only
+// the vertices are generated here, they are uploaded by Display, which needs
+// an OpenGL context. state.range(1) is the width the texts are elided to, in
+// thousandths of the world width, or 0 for none.
+void BM_TextRendererAddText(benchmark::State& state) {
+  GlCanvas canvas;
+  canvas.Resize(kCanvasWidth, kCanvasHeight);
+  canvas.SetWorldWidth(kWorldWidth);
+  canvas.SetWorldHeight(kWorldHeight);
+  canvas.SetWorldTopLeftX(0.f);
+  canvas.SetWorldTopLeftY(kWorldHeight);
+  TextRenderer& text_renderer = canvas.GetTextRenderer();
+  if (!text_renderer.InitFonts()) {
+    state.SkipWithError("Could not load the fonts from \"fonts/\" next to "
+                        "the executable");
+    return;
+  }
+
+  const std::vector<std::string> labels = CreateLabels();
+  const float max_size =
+      state.range(1) > 0 ? kWorldWidth / 1000 * state.range(1) : -1.f;
+  const Color color(255, 255, 255, 255);
+  for (auto _ : state) {
+    text_renderer.Clear();
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      const float x = static_cast<float>(i % 100) * 10.f;
+      const float y = static_cast<float>(i / 100 % 50) * kLineHeight;
+      text_renderer.AddText(labels[i % labels.size()].c_str(), x, y,
+                            GlCanvas::Z_VALUE_TEXT, color, max_size);
+    }
+    benchmark::DoNotOptimize(text_renderer.GetNumCharacters());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TextRendererAddText)
+    ->Args({1'000, 0})
+    ->Args({10'000, 0})
+    ->Args({10'000, 10})
+    ->Unit(benchmark::kMicrosecond);
+
+}  // namespace
@@ -0,0 +1,108 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+#include <random>
+
+#include "TimerChain.h"
+#include "capture_data.pb.h"
+
+using orbit_client_protos::TimerInfo;
+
+namespace {
+
+// Timers of one depth of a thread: consecutive calls of 1 to 100 us, with
+// gaps of up to 10 us, as instrumented functions called in a loop.
+std::unique_ptr<TimerChain> CreateTimerChain(int64_t count,
+                                             uint64_t* max_timestamp) {
+  std::mt19937_64 random(42);
+  auto chain = std::make_unique<TimerChain>();
+  uint64_t timestamp = 0;
+  for (int64_t i = 0; i < count; ++i) {
+    TimerInfo timer_info;
+    timestamp += random() % 10'000;
+    timer_info.set_start(timestamp);
+    timestamp += 1'000 + random() % 99'000;
+    timer_info.set_end(timestamp);
+    timer_info.set_function_address(0x7f0000000000 + 16 * (random() % 1000));
+    chain->emplace_back(std::move(timer_info));
+  }
+  *max_timestamp = timestamp;
+  return chain;
+}
+
+void BM_TimerChainEmplaceBack(benchmark::State& state) {
+  for (auto _ : state) {
+    uint64_t max_timestamp;
+    std::unique_ptr<TimerChain> chain =
+        CreateTimerChain(state.range(0), &max_timestamp);
+    benchmark::DoNotOptimize(chain->size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TimerChainEmplaceBack)
+    ->Arg(100'000)
+    ->Arg(1'000'000)
+    ->Unit(benchmark::kMillisecond);
+
+// Finds the timers intersecting a visible time range, as TimerTrack does for
+// every frame that is not drawn from the summary. state.range(1) is the
+// fraction of the capture that is visible, in thousandths.
+void BM_TimerChainCulling(benchmark::State& state) {
+  uint64_t max_timestamp;
+  std::unique_ptr<TimerChain> chain =
+      CreateTimerChain(state.range(0), &max_timestamp);
+  const uint64_t visible_range = max_timestamp / 1000 * state.range(1);
+  std::mt19937_64 random(42);
+  uint64_t visible_timer_count = 0;
+  for (auto _ : state) {
+    const uint64_t min_tick = random() % (max_timestamp - visible_range + 1);
+    const uint64_t max_tick = min_tick + visible_range;
+    for (TimerChainIterator it = chain->GetFirstBlockEndingAtOrAfter(min_tick);
+         it != chain->end(); ++it) {
+      TimerBlock& block = *it;
+      if (chain->IsSortedByStart() && block.GetMinTimestamp() > max_tick) {
+        break;
+      }
+      if (!block.Intersects(min_tick, max_tick)) continue;
+      for (size_t k = 0; k < block.size(); ++k) {
+        if (min_tick > block.GetEnd(k) || max_tick < block.GetStart(k)) {
+          continue;
+        }
+        ++visible_timer_count;
+      }
+    }
+    benchmark::DoNotOptimize(visible_timer_count);
+  }
+  state.counters["visible_timers"] =
+      benchmark::Counter(static_cast<double>(visible_timer_count),
+                         benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_TimerChainCulling)
+    ->Args({100'000, 1})
+    ->Args({1'000'000, 1})
+    ->Args({1'000'000, 10})
+    ->Args({1'000'000, 1000})
+    ->Unit(benchmark::kMicrosecond);
+
+// Finds the timer after the one at a timestamp, as when navigating the
+// timers of a track with the keyboard.
+void BM_TimerChainGetElementAfter(benchmark::State& state) {
+  uint64_t max_timestamp;
+  std::unique_ptr<TimerChain> chain =
+      CreateTimerChain(state.range(0), &max_timestamp);
+  std::mt19937_64 random(42);
+  for (auto _ : state) {
+    const TextBox* first = chain->GetFirstStartingAtOrAfter(
+        random() % max_timestamp);
+    if (first == nullptr) continue;
+    benchmark::DoNotOptimize(chain->GetElementAfter(first));
+  }
+}
+BENCHMARK(BM_TimerChainGetElementAfter)->Arg(100'000)->Arg(1'000'000);
+
+}  // namespace
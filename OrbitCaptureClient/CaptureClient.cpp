@@ -4,18 +4,190 @@
 
 #include "OrbitCaptureClient/CaptureClient.h"
 
+#include <google/protobuf/util/delimited_message_util.h>
+
+#include <fstream>
+#include <vector>
+
 #include "FunctionUtils.h"
 #include "OrbitBase/Logging.h"
 
 #include "absl/flags/flag.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
 
 ABSL_DECLARE_FLAG(uint16_t, sampling_rate);
 ABSL_DECLARE_FLAG(bool, frame_pointer_unwinding);
+ABSL_DECLARE_FLAG(bool, ring_buffer_wakeups);
+ABSL_DECLARE_FLAG(uint32_t, ring_buffer_reader_threads);
+ABSL_DECLARE_FLAG(bool, pin_ring_buffer_reader_threads);
+ABSL_DECLARE_FLAG(uint32_t, unwinding_threads);
+ABSL_DECLARE_FLAG(uint32_t, stack_dump_size);
+ABSL_DECLARE_FLAG(bool, adaptive_stack_dump);
+ABSL_DECLARE_FLAG(bool, compress_capture_stream);
+ABSL_DECLARE_FLAG(bool, compact_event_encoding);
+ABSL_DECLARE_FLAG(bool, client_side_symbolization);
+ABSL_DECLARE_FLAG(uint32_t, callstack_sample_counts_interval_ms);
+ABSL_DECLARE_FLAG(uint64_t, max_buffered_event_bytes);
+ABSL_DECLARE_FLAG(bool, block_when_buffer_full);
+ABSL_DECLARE_FLAG(bool, join_running_capture);
+ABSL_DECLARE_FLAG(uint32_t, recorded_argument_count);
+ABSL_DECLARE_FLAG(bool, record_return_values);
+ABSL_DECLARE_FLAG(bool, aggregate_function_calls);
+ABSL_DECLARE_FLAG(bool, hybrid_unwinding);
+ABSL_DECLARE_FLAG(bool, lbr_unwinding);
+ABSL_DECLARE_FLAG(bool, kernel_callchains);
+ABSL_DECLARE_FLAG(bool, trace_performance_counters);
+ABSL_DECLARE_FLAG(std::string, additional_pids);
+ABSL_DECLARE_FLAG(bool, sample_all_processes);
+ABSL_DECLARE_FLAG(bool, auto_ring_buffer_sizes);
+ABSL_DECLARE_FLAG(std::string, ring_buffer_sizes_kb);
+ABSL_DECLARE_FLAG(bool, capture_statistics);
+ABSL_DECLARE_FLAG(bool, introspection);
+ABSL_DECLARE_FLAG(bool, manual_instrumentation_shared_memory);
+ABSL_DECLARE_FLAG(uint64_t, max_instrumented_function_call_rate);
+ABSL_DECLARE_FLAG(bool, thread_state);
+ABSL_DECLARE_FLAG(bool, off_cpu);
+ABSL_DECLARE_FLAG(bool, lock_contention);
+ABSL_DECLARE_FLAG(bool, allocations);
+ABSL_DECLARE_FLAG(bool, syscalls);
+ABSL_DECLARE_FLAG(std::string, syscall_filter);
+ABSL_DECLARE_FLAG(bool, block_io);
+ABSL_DECLARE_FLAG(bool, cpu_power_states);
+ABSL_DECLARE_FLAG(bool, page_faults);
+ABSL_DECLARE_FLAG(uint64_t, minor_page_fault_sampling_period);
+ABSL_DECLARE_FLAG(bool, vulkan_layer);
+ABSL_DECLARE_FLAG(std::string, capture_triggers);
+ABSL_DECLARE_FLAG(uint64_t, capture_trigger_window_ms);
+ABSL_DECLARE_FLAG(std::string, record_capture_responses);
 
 using orbit_client_protos::FunctionInfo;
 
+namespace {
+// Shorter lock waits are only aggregated by the service, not sent one by one.
+constexpr uint64_t kMinLockWaitDurationNs = 100 * 1000;
+// The same for syscalls, which are not aggregated at all.
+constexpr uint64_t kMinSyscallDurationNs = 100 * 1000;
+
+// Parses sizes like "sampling=4096,uprobes=2048".
+void ParseRingBufferSizes(const std::string& sizes_flag,
+                          CaptureOptions::RingBufferSizes* sizes) {
+  for (absl::string_view size_string :
+       absl::StrSplit(sizes_flag, ',', absl::SkipWhitespace())) {
+    std::vector<std::string> kind_and_size =
+        absl::StrSplit(size_string, absl::MaxSplits('=', 1));
+    uint64_t size_kb;
+    if (kind_and_size.size() != 2 ||
+        !absl::SimpleAtoi(kind_and_size[1], &size_kb)) {
+      ERROR("Invalid size in --ring_buffer_sizes_kb: %s",
+            std::string(size_string).c_str());
+      continue;
+    }
+    const std::string& kind = kind_and_size[0];
+    if (kind == "context_switches") {
+      sizes->set_context_switches_kb(size_kb);
+    } else if (kind == "uprobes") {
+      sizes->set_uprobes_kb(size_kb);
+    } else if (kind == "mmap_task") {
+      sizes->set_mmap_task_kb(size_kb);
+    } else if (kind == "sampling") {
+      sizes->set_sampling_kb(size_kb);
+    } else if (kind == "tracepoints") {
+      sizes->set_tracepoints_kb(size_kb);
+    } else if (kind == "gpu_tracing") {
+      sizes->set_gpu_tracing_kb(size_kb);
+    } else if (kind == "sched_switch_counters") {
+      sizes->set_sched_switch_counters_kb(size_kb);
+    } else {
+      ERROR("Unknown ring buffer kind in --ring_buffer_sizes_kb: %s",
+            kind.c_str());
+    }
+  }
+}
+// The options of the instrumented functions come from the flags.
+void SetInstrumentedFunction(
+    const FunctionInfo& function,
+    CaptureOptions::InstrumentedFunction* instrumented_function) {
+  instrumented_function->set_file_path(function.loaded_module_path());
+  instrumented_function->set_file_offset(FunctionUtils::Offset(function));
+  instrumented_function->set_absolute_address(
+      FunctionUtils::GetAbsoluteAddress(function));
+  instrumented_function->set_recorded_argument_count(
+      absl::GetFlag(FLAGS_recorded_argument_count));
+  instrumented_function->set_record_return_value(
+      absl::GetFlag(FLAGS_record_return_values));
+  instrumented_function->set_aggregate_calls(
+      absl::GetFlag(FLAGS_aggregate_function_calls));
+  instrumented_function->set_sampling_ratio(function.sampling_ratio());
+  // The spans of ORBIT_START_ASYNC and ORBIT_STOP_ASYNC are matched by id
+  // in the service, which reports ORBIT_FRAME_MARKERs as such.
+  if (function.type() == FunctionInfo::kOrbitTimerStartAsync) {
+    instrumented_function->set_function_type(
+        CaptureOptions::InstrumentedFunction::kTimerStartAsync);
+  } else if (function.type() == FunctionInfo::kOrbitTimerStopAsync) {
+    instrumented_function->set_function_type(
+        CaptureOptions::InstrumentedFunction::kTimerStopAsync);
+  } else if (function.type() == FunctionInfo::kOrbitFrameMarker) {
+    instrumented_function->set_function_type(
+        CaptureOptions::InstrumentedFunction::kFrameMarker);
+  }
+}
+
+// Parses triggers like "Render>20,frame:Frame>33": the calls of the
+// instrumented functions of which the name contains "Render" lasting more
+// than 20 ms, and the intervals between frame markers named "Frame" longer
+// than 33 ms.
+void ParseCaptureTriggers(
+    const std::string& triggers_flag,
+    const std::map<uint64_t, FunctionInfo*>& selected_functions,
+    CaptureOptions* capture_options) {
+  constexpr absl::string_view kFrameMarkerPrefix = "frame:";
+  for (absl::string_view trigger_string :
+       absl::StrSplit(triggers_flag, ',', absl::SkipWhitespace())) {
+    std::vector<std::string> name_and_duration =
+        absl::StrSplit(trigger_string, absl::MaxSplits('>', 1));
+    double min_duration_ms;
+    if (name_and_duration.size() != 2 || name_and_duration[0].empty() ||
+        !absl::SimpleAtod(name_and_duration[1], &min_duration_ms) ||
+        min_duration_ms < 0) {
+      ERROR("Invalid trigger in --capture_triggers: %s",
+            std::string(trigger_string).c_str());
+      continue;
+    }
+    const auto min_duration_ns = static_cast<uint64_t>(min_duration_ms * 1e6);
+    absl::string_view name = name_and_duration[0];
+    if (absl::ConsumePrefix(&name, kFrameMarkerPrefix)) {
+      CaptureOptions::CaptureTrigger* trigger =
+          capture_options->add_capture_triggers();
+      trigger->set_frame_marker_name(std::string(name));
+      trigger->set_min_duration_ns(min_duration_ns);
+      continue;
+    }
+    bool found = false;
+    for (const auto& [unused_address, function] : selected_functions) {
+      if (function == nullptr ||
+          !absl::StrContains(FunctionUtils::GetDisplayName(*function), name)) {
+        continue;
+      }
+      CaptureOptions::CaptureTrigger* trigger =
+          capture_options->add_capture_triggers();
+      trigger->set_function_absolute_address(
+          FunctionUtils::GetAbsoluteAddress(*function));
+      trigger->set_min_duration_ns(min_duration_ns);
+      found = true;
+    }
+    if (!found) {
+      ERROR("No instrumented function matches the trigger %s",
+            std::string(trigger_string).c_str());
+    }
+  }
+}
+}  // namespace
+
 void CaptureClient::Capture(
-    int32_t pid, const std::map<uint64_t, FunctionInfo*>& selected_functions) {
+    int32_t pid, const std::map<uint64_t, FunctionInfo*>& selected_functions,
+    const std::vector<std::string>& unsymbolized_module_paths) {
   CHECK(reader_writer_ == nullptr);
 
   event_processor_.emplace(capture_listener_);
@@ -32,13 +204,116 @@ void CaptureClient::Capture(
     capture_options->set_unwinding_method(CaptureOptions::kUndefined);
   } else {
     capture_options->set_sampling_rate(sampling_rate);
-    if (absl::GetFlag(FLAGS_frame_pointer_unwinding)) {
+    if (absl::GetFlag(FLAGS_hybrid_unwinding)) {
+      capture_options->set_unwinding_method(CaptureOptions::kHybrid);
+    } else if (absl::GetFlag(FLAGS_lbr_unwinding)) {
+      capture_options->set_unwinding_method(CaptureOptions::kLbr);
+    } else if (absl::GetFlag(FLAGS_frame_pointer_unwinding)) {
       capture_options->set_unwinding_method(CaptureOptions::kFramePointers);
     } else {
       capture_options->set_unwinding_method(CaptureOptions::kDwarf);
     }
+    capture_options->set_kernel_callchains(
+        absl::GetFlag(FLAGS_kernel_callchains));
   }
   capture_options->set_trace_gpu_driver(true);
+  capture_options->set_ring_buffer_wakeups(
+      absl::GetFlag(FLAGS_ring_buffer_wakeups));
+  capture_options->set_ring_buffer_reader_thread_count(
+      absl::GetFlag(FLAGS_ring_buffer_reader_threads));
+  capture_options->set_pin_ring_buffer_reader_threads(
+      absl::GetFlag(FLAGS_pin_ring_buffer_reader_threads));
+  capture_options->set_unwinding_thread_count(
+      absl::GetFlag(FLAGS_unwinding_threads));
+  capture_options->set_stack_dump_size(absl::GetFlag(FLAGS_stack_dump_size));
+  capture_options->set_adaptive_stack_dump(
+      absl::GetFlag(FLAGS_adaptive_stack_dump));
+  capture_options->set_compress_capture_stream(
+      absl::GetFlag(FLAGS_compress_capture_stream));
+  capture_options->set_compact_event_encoding(
+      absl::GetFlag(FLAGS_compact_event_encoding));
+  if (absl::GetFlag(FLAGS_client_side_symbolization)) {
+    capture_options->set_client_side_symbolization(true);
+    for (const std::string& path : unsymbolized_module_paths) {
+      capture_options->add_service_symbolized_map_paths(path);
+    }
+  }
+  capture_options->set_callstack_sample_counts_interval_ns(
+      uint64_t{absl::GetFlag(FLAGS_callstack_sample_counts_interval_ms)} *
+      1'000'000);
+  capture_options->set_max_buffered_event_bytes(
+      absl::GetFlag(FLAGS_max_buffered_event_bytes));
+  if (absl::GetFlag(FLAGS_block_when_buffer_full)) {
+    capture_options->set_buffer_full_policy(CaptureOptions::kBlockProducers);
+  } else {
+    capture_options->set_buffer_full_policy(CaptureOptions::kDropSamples);
+  }
+  capture_options->set_join_running_capture(
+      absl::GetFlag(FLAGS_join_running_capture));
+  capture_options->set_trace_performance_counters(
+      absl::GetFlag(FLAGS_trace_performance_counters));
+  for (absl::string_view pid_string :
+       absl::StrSplit(absl::GetFlag(FLAGS_additional_pids), ',',
+                      absl::SkipWhitespace())) {
+    int32_t additional_pid;
+    if (!absl::SimpleAtoi(pid_string, &additional_pid)) {
+      ERROR("Invalid pid in --additional_pids: %s",
+            std::string(pid_string).c_str());
+      continue;
+    }
+    capture_options->add_additional_pids(additional_pid);
+  }
+  capture_options->set_sample_all_processes(
+      absl::GetFlag(FLAGS_sample_all_processes));
+  capture_options->set_auto_ring_buffer_sizes(
+      absl::GetFlag(FLAGS_auto_ring_buffer_sizes));
+  ParseRingBufferSizes(absl::GetFlag(FLAGS_ring_buffer_sizes_kb),
+                       capture_options->mutable_ring_buffer_sizes());
+  capture_options->set_capture_statistics(
+      absl::GetFlag(FLAGS_capture_statistics));
+  capture_options->set_introspection(absl::GetFlag(FLAGS_introspection));
+  capture_options->set_manual_instrumentation_shared_memory(
+      absl::GetFlag(FLAGS_manual_instrumentation_shared_memory));
+  capture_options->set_max_instrumented_function_call_rate(
+      absl::GetFlag(FLAGS_max_instrumented_function_call_rate));
+  capture_options->set_trace_thread_state(absl::GetFlag(FLAGS_thread_state));
+  capture_options->set_trace_off_cpu(absl::GetFlag(FLAGS_off_cpu));
+  capture_options->set_trace_lock_contention(
+      absl::GetFlag(FLAGS_lock_contention));
+  capture_options->set_min_lock_wait_duration_ns(kMinLockWaitDurationNs);
+  capture_options->set_trace_allocations(absl::GetFlag(FLAGS_allocations));
+  capture_options->set_trace_syscalls(absl::GetFlag(FLAGS_syscalls));
+  for (absl::string_view syscall_nr_string :
+       absl::StrSplit(absl::GetFlag(FLAGS_syscall_filter), ',',
+                      absl::SkipWhitespace())) {
+    int32_t syscall_nr;
+    if (!absl::SimpleAtoi(syscall_nr_string, &syscall_nr)) {
+      ERROR("Invalid syscall number in --syscall_filter: %s",
+            std::string(syscall_nr_string).c_str());
+      continue;
+    }
+    capture_options->add_syscall_filter(syscall_nr);
+  }
+  capture_options->set_min_syscall_duration_ns(kMinSyscallDurationNs);
+  capture_options->set_trace_block_io(absl::GetFlag(FLAGS_block_io));
+  capture_options->set_trace_cpu_power_states(
+      absl::GetFlag(FLAGS_cpu_power_states));
+  capture_options->set_trace_page_faults(absl::GetFlag(FLAGS_page_faults));
+  capture_options->set_minor_page_fault_sampling_period(
+      absl::GetFlag(FLAGS_minor_page_fault_sampling_period));
+  capture_options->set_trace_vulkan_layer(absl::GetFlag(FLAGS_vulkan_layer));
+  ParseCaptureTriggers(absl::GetFlag(FLAGS_capture_triggers),
+                       selected_functions, capture_options);
+  capture_options->set_trigger_window_before_ms(
+      absl::GetFlag(FLAGS_capture_trigger_window_ms));
+  capture_options->set_trigger_window_after_ms(
+      absl::GetFlag(FLAGS_capture_trigger_window_ms));
+  // The functions are numbered from 1, in the order they are sent. The
+  // recorded responses are replayed without the CaptureOptions, hence
+  // without the ids.
+  const bool assign_function_ids =
+      absl::GetFlag(FLAGS_record_capture_responses).empty();
+  std::vector<uint64_t> function_addresses_by_id;
   for (const auto& pair : selected_functions) {
     const FunctionInfo* function = pair.second;
     // TODO: this is temporary fix. We should understand why in
@@ -48,23 +323,52 @@ void CaptureClient::Capture(
     }
     CaptureOptions::InstrumentedFunction* instrumented_function =
         capture_options->add_instrumented_functions();
-    instrumented_function->set_file_path(function->loaded_module_path());
-    instrumented_function->set_file_offset(FunctionUtils::Offset(*function));
-    instrumented_function->set_absolute_address(
-        FunctionUtils::GetAbsoluteAddress(*function));
+    SetInstrumentedFunction(*function, instrumented_function);
+    if (assign_function_ids) {
+      function_addresses_by_id.push_back(
+          instrumented_function->absolute_address());
+      instrumented_function->set_function_id(function_addresses_by_id.size());
+    }
   }
+  event_processor_->SetFunctionAddressesById(
+      std::move(function_addresses_by_id));
 
-  if (!reader_writer_->Write(request)) {
+  bool written;
+  {
+    absl::MutexLock lock{&writer_mutex_};
+    written = reader_writer_->Write(request);
+    if (!written) {
+      reader_writer_->WritesDone();
+    }
+  }
+  if (!written) {
     ERROR("Sending CaptureRequest on Capture's gRPC stream");
-    reader_writer_->WritesDone();
     FinishCapture();
     return;
   }
   LOG("Sent CaptureRequest on Capture's gRPC stream: asking to start "
       "capturing");
 
+  // The responses are recorded as they are received, each one prefixed with
+  // its size.
+  std::ofstream recording;
+  const std::string recording_path =
+      absl::GetFlag(FLAGS_record_capture_responses);
+  if (!recording_path.empty()) {
+    recording.open(recording_path, std::ios::binary | std::ios::trunc);
+    if (!recording.is_open()) {
+      ERROR("Opening \"%s\" to record the capture", recording_path);
+    }
+  }
+
   CaptureResponse response;
   while (reader_writer_->Read(&response)) {
+    if (recording.is_open() &&
+        !google::protobuf::util::SerializeDelimitedToOstream(response,
+                                                             &recording)) {
+      ERROR("Recording CaptureResponse to \"%s\"", recording_path);
+      recording.close();
+    }
     event_processor_->ProcessEvents(response.capture_events());
   }
   LOG("Finished reading from Capture's gRPC stream: all capture data has been "
@@ -72,10 +376,46 @@ void CaptureClient::Capture(
   FinishCapture();
 }
 
-void CaptureClient::StopCapture() {
-  CHECK(reader_writer_ != nullptr);
+bool CaptureClient::UpdateInstrumentedFunctions(
+    const std::vector<const FunctionInfo*>& added_functions,
+    const std::vector<const FunctionInfo*>& removed_functions) {
+  CaptureRequest request;
+  InstrumentedFunctionsUpdate* update =
+      request.mutable_instrumented_functions_update();
+  for (const FunctionInfo* function : added_functions) {
+    SetInstrumentedFunction(*function, update->add_added_functions());
+  }
+  for (const FunctionInfo* function : removed_functions) {
+    update->add_removed_functions()->set_absolute_address(
+        FunctionUtils::GetAbsoluteAddress(*function));
+  }
+
+  absl::MutexLock lock{&writer_mutex_};
+  if (reader_writer_ == nullptr) {
+    return false;
+  }
+  if (!reader_writer_->Write(request)) {
+    ERROR("Sending CaptureRequest on Capture's gRPC stream");
+    return false;
+  }
+  LOG("Sent CaptureRequest on Capture's gRPC stream: asking to add %lu and "
+      "remove %lu instrumented functions",
+      added_functions.size(), removed_functions.size());
+  return true;
+}
 
-  if (!reader_writer_->WritesDone()) {
+void CaptureClient::StopCapture() {
+  bool writes_done;
+  {
+    absl::MutexLock lock{&writer_mutex_};
+    // The capture can have finished on its own, e.g., when the service
+    // failed, before it was asked to stop.
+    if (reader_writer_ == nullptr) {
+      return;
+    }
+    writes_done = reader_writer_->WritesDone();
+  }
+  if (!writes_done) {
     ERROR("Finishing writing on Capture's gRPC stream");
     FinishCapture();
   }
@@ -91,6 +431,9 @@ void CaptureClient::FinishCapture() {
   if (!status.ok()) {
     ERROR("Finishing gRPC call to Capture: %s", status.error_message());
   }
-  reader_writer_.reset();
+  {
+    absl::MutexLock lock{&writer_mutex_};
+    reader_writer_.reset();
+  }
   event_processor_.reset();
 }
\ No newline at end of file
@@ -1,12 +1,31 @@
 #include "OrbitCaptureClient/CaptureEventProcessor.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <optional>
+
+#include "OrbitBase/LogLinearHistogram.h"
 #include "capture_data.pb.h"
 
 using orbit_client_protos::CallstackEvent;
+using orbit_client_protos::FunctionStats;
 using orbit_client_protos::LinuxAddressInfo;
 using orbit_client_protos::TimerInfo;
 
 void CaptureEventProcessor::ProcessEvent(const CaptureEvent& event) {
+  DispatchEvent(event);
+  SendTimersToListener();
+}
+
+void CaptureEventProcessor::SendTimersToListener() {
+  if (timers_.empty()) {
+    return;
+  }
+  capture_listener_->OnTimers(absl::MakeSpan(timers_));
+  timers_.clear();
+}
+
+void CaptureEventProcessor::DispatchEvent(const CaptureEvent& event) {
   switch (event.event_case()) {
     case CaptureEvent::kSchedulingSlice:
       ProcessSchedulingSlice(event.scheduling_slice());
@@ -17,9 +36,33 @@ void CaptureEventProcessor::ProcessEvent(const CaptureEvent& event) {
     case CaptureEvent::kCallstackSample:
       ProcessCallstackSample(event.callstack_sample());
       break;
+    case CaptureEvent::kCallstackSampleCounts:
+      ProcessCallstackSampleCounts(event.callstack_sample_counts());
+      break;
+    case CaptureEvent::kOffCpuCallstackSample:
+      ProcessOffCpuCallstackSample(event.off_cpu_callstack_sample());
+      break;
+    case CaptureEvent::kAllocationSample:
+      ProcessAllocationSample(event.allocation_sample());
+      break;
     case CaptureEvent::kFunctionCall:
       ProcessFunctionCall(event.function_call());
       break;
+    case CaptureEvent::kLockWait:
+      ProcessLockWait(event.lock_wait());
+      break;
+    case CaptureEvent::kSyscallLatency:
+      ProcessSyscallLatency(event.syscall_latency());
+      break;
+    case CaptureEvent::kBlockIoLatency:
+      ProcessBlockIoLatency(event.block_io_latency());
+      break;
+    case CaptureEvent::kGpuQueueSubmission:
+      ProcessGpuQueueSubmission(event.gpu_queue_submission());
+      break;
+    case CaptureEvent::kLockContentionStats:
+      ProcessLockContentionStats(event.lock_contention_stats());
+      break;
     case CaptureEvent::kInternedString:
       ProcessInternedString(event.interned_string());
       break;
@@ -32,6 +75,77 @@ void CaptureEventProcessor::ProcessEvent(const CaptureEvent& event) {
     case CaptureEvent::kAddressInfo:
       ProcessAddressInfo(event.address_info());
       break;
+    case CaptureEvent::kTimestampBase:
+      ProcessTimestampBase(event.timestamp_base());
+      break;
+    case CaptureEvent::kCompactSchedulingSlice:
+      ProcessCompactSchedulingSlice(event.compact_scheduling_slice());
+      break;
+    case CaptureEvent::kCompactFunctionCall:
+      ProcessCompactFunctionCall(event.compact_function_call());
+      break;
+    case CaptureEvent::kCompactInternedCallstack:
+      ProcessCompactInternedCallstack(event.compact_interned_callstack());
+      break;
+    case CaptureEvent::kCompactCallstackSample:
+      ProcessCompactCallstackSample(event.compact_callstack_sample());
+      break;
+    case CaptureEvent::kDroppedEvents:
+      ProcessDroppedEvents(event.dropped_events());
+      break;
+    case CaptureEvent::kFunctionCallStats:
+      ProcessFunctionCallStats(event.function_call_stats());
+      break;
+    case CaptureEvent::kSchedulingSliceCounters:
+      capture_listener_->OnSchedulingSliceCounters(
+          event.scheduling_slice_counters());
+      break;
+    case CaptureEvent::kThreadWakeup:
+      capture_listener_->OnThreadWakeup(event.thread_wakeup());
+      break;
+    case CaptureEvent::kCpuPowerEvent:
+      capture_listener_->OnCpuPowerEvent(event.cpu_power_event());
+      break;
+    case CaptureEvent::kPageFault:
+      ProcessPageFault(event.page_fault());
+      break;
+    case CaptureEvent::kPageFaultStats:
+      capture_listener_->OnPageFaultStats(event.page_fault_stats());
+      break;
+    case CaptureEvent::kCompactThreadWakeup:
+      ProcessCompactThreadWakeup(event.compact_thread_wakeup());
+      break;
+    case CaptureEvent::kModuleMap:
+      capture_listener_->OnModuleMap(event.module_map());
+      break;
+    case CaptureEvent::kDisabledInstrumentedFunctions:
+      capture_listener_->OnDisabledInstrumentedFunctions(
+          event.disabled_instrumented_functions());
+      break;
+    case CaptureEvent::kCpuBudgetStep:
+      ProcessCpuBudgetStep(event.cpu_budget_step());
+      break;
+    case CaptureEvent::kClockOffset:
+      ProcessClockOffset(event.clock_offset());
+      break;
+    case CaptureEvent::kCaptureSetupPhase:
+      ProcessCaptureSetupPhase(event.capture_setup_phase());
+      break;
+    case CaptureEvent::kCaptureStatistics:
+      ProcessCaptureStatistics(event.capture_statistics());
+      break;
+    case CaptureEvent::kIntrospectionScope:
+      ProcessIntrospectionScope(event.introspection_scope());
+      break;
+    case CaptureEvent::kManualInstrumentationScope:
+      ProcessManualInstrumentationScope(event.manual_instrumentation_scope());
+      break;
+    case CaptureEvent::kAsyncSpan:
+      ProcessAsyncSpan(event.async_span());
+      break;
+    case CaptureEvent::kFrameMarker:
+      ProcessFrameMarker(event.frame_marker());
+      break;
     case CaptureEvent::EVENT_NOT_SET:
       ERROR("CaptureEvent::EVENT_NOT_SET read from Capture's gRPC stream");
       break;
@@ -40,7 +154,7 @@ void CaptureEventProcessor::ProcessEvent(const CaptureEvent& event) {
 
 void CaptureEventProcessor::ProcessSchedulingSlice(
     const SchedulingSlice& scheduling_slice) {
-  TimerInfo timer_info;
+  TimerInfo& timer_info = timers_.emplace_back();
   timer_info.set_start(scheduling_slice.in_timestamp_ns());
   timer_info.set_end(scheduling_slice.out_timestamp_ns());
   timer_info.set_process_id(scheduling_slice.pid());
@@ -48,32 +162,34 @@ void CaptureEventProcessor::ProcessSchedulingSlice(
   timer_info.set_processor(static_cast<int8_t>(scheduling_slice.core()));
   timer_info.set_depth(timer_info.processor());
   timer_info.set_type(TimerInfo::kCoreActivity);
-
-  capture_listener_->OnTimer(timer_info);
 }
 
 void CaptureEventProcessor::ProcessInternedCallstack(
     InternedCallstack interned_callstack) {
-  if (callstack_intern_pool.contains(interned_callstack.key())) {
-    ERROR("Overwriting InternedCallstack with key %llu",
-          interned_callstack.key());
-  }
-  callstack_intern_pool.emplace(
-      interned_callstack.key(),
-      std::move(*interned_callstack.mutable_intern()));
+  // The service can assign a key again after evicting it from its intern
+  // table: the key then refers to the new callstack.
+  callstack_hashes_by_key_.insert_or_assign(
+      interned_callstack.key(), GetCallstackHashAndSendToListenerIfNecessary(
+                                    interned_callstack.intern()));
 }
 
 void CaptureEventProcessor::ProcessCallstackSample(
     const CallstackSample& callstack_sample) {
-  Callstack callstack;
+  uint64_t hash = 0;
   if (callstack_sample.callstack_or_key_case() ==
       CallstackSample::kCallstackKey) {
-    callstack = callstack_intern_pool[callstack_sample.callstack_key()];
+    auto hash_it =
+        callstack_hashes_by_key_.find(callstack_sample.callstack_key());
+    if (hash_it == callstack_hashes_by_key_.end()) {
+      ERROR("Unknown callstack key %lu", callstack_sample.callstack_key());
+      return;
+    }
+    hash = hash_it->second;
   } else {
-    callstack = callstack_sample.callstack();
+    hash = GetCallstackHashAndSendToListenerIfNecessary(
+        callstack_sample.callstack());
   }
 
-  uint64_t hash = GetCallstackHashAndSendToListenerIfNecessary(callstack);
   CallstackEvent callstack_event;
   callstack_event.set_time(callstack_sample.timestamp_ns());
   callstack_event.set_callstack_hash(hash);
@@ -81,9 +197,107 @@ void CaptureEventProcessor::ProcessCallstackSample(
   capture_listener_->OnCallstackEvent(std::move(callstack_event));
 }
 
+void CaptureEventProcessor::ProcessCallstackSampleCounts(
+    const CallstackSampleCounts& callstack_sample_counts) {
+  if (callstack_sample_counts.callstack_keys_size() !=
+      callstack_sample_counts.counts_size()) {
+    ERROR("CallstackSampleCounts with %d callstack keys but %d counts",
+          callstack_sample_counts.callstack_keys_size(),
+          callstack_sample_counts.counts_size());
+    return;
+  }
+  absl::flat_hash_map<uint64_t, uint32_t> counts_by_callstack_hash;
+  for (int i = 0; i < callstack_sample_counts.callstack_keys_size(); ++i) {
+    const uint64_t callstack_key = callstack_sample_counts.callstack_keys(i);
+    auto hash_it = callstack_hashes_by_key_.find(callstack_key);
+    if (hash_it == callstack_hashes_by_key_.end()) {
+      ERROR("Unknown callstack key %lu", callstack_key);
+      continue;
+    }
+    counts_by_callstack_hash[hash_it->second] +=
+        callstack_sample_counts.counts(i);
+  }
+  capture_listener_->OnCallstackSampleCounts(
+      callstack_sample_counts.tid(),
+      callstack_sample_counts.begin_timestamp_ns(), counts_by_callstack_hash);
+}
+
+void CaptureEventProcessor::ProcessOffCpuCallstackSample(
+    const OffCpuCallstackSample& off_cpu_callstack_sample) {
+  uint64_t hash = 0;
+  if (off_cpu_callstack_sample.callstack_or_key_case() ==
+      OffCpuCallstackSample::kCallstackKey) {
+    auto hash_it =
+        callstack_hashes_by_key_.find(off_cpu_callstack_sample.callstack_key());
+    if (hash_it == callstack_hashes_by_key_.end()) {
+      ERROR("Unknown callstack key %lu",
+            off_cpu_callstack_sample.callstack_key());
+      return;
+    }
+    hash = hash_it->second;
+  } else {
+    hash = GetCallstackHashAndSendToListenerIfNecessary(
+        off_cpu_callstack_sample.callstack());
+  }
+
+  CallstackEvent callstack_event;
+  callstack_event.set_time(off_cpu_callstack_sample.timestamp_ns());
+  callstack_event.set_callstack_hash(hash);
+  callstack_event.set_thread_id(off_cpu_callstack_sample.tid());
+  capture_listener_->OnOffCpuCallstackEvent(
+      std::move(callstack_event),
+      off_cpu_callstack_sample.off_cpu_duration_ns());
+}
+
+void CaptureEventProcessor::ProcessAllocationSample(
+    const AllocationSample& allocation_sample) {
+  uint64_t hash = 0;
+  if (allocation_sample.callstack_or_key_case() ==
+      AllocationSample::kCallstackKey) {
+    auto hash_it =
+        callstack_hashes_by_key_.find(allocation_sample.callstack_key());
+    if (hash_it == callstack_hashes_by_key_.end()) {
+      ERROR("Unknown callstack key %lu", allocation_sample.callstack_key());
+      return;
+    }
+    hash = hash_it->second;
+  } else {
+    hash = GetCallstackHashAndSendToListenerIfNecessary(
+        allocation_sample.callstack());
+  }
+
+  CallstackEvent callstack_event;
+  callstack_event.set_time(allocation_sample.timestamp_ns());
+  callstack_event.set_callstack_hash(hash);
+  callstack_event.set_thread_id(allocation_sample.tid());
+  capture_listener_->OnAllocationEvent(std::move(callstack_event),
+                                       allocation_sample.sampled_bytes());
+}
+
+void CaptureEventProcessor::ProcessPageFault(const PageFault& page_fault) {
+  uint64_t hash = 0;
+  if (page_fault.callstack_or_key_case() == PageFault::kCallstackKey) {
+    auto hash_it = callstack_hashes_by_key_.find(page_fault.callstack_key());
+    if (hash_it == callstack_hashes_by_key_.end()) {
+      ERROR("Unknown callstack key %lu", page_fault.callstack_key());
+      return;
+    }
+    hash = hash_it->second;
+  } else {
+    hash = GetCallstackHashAndSendToListenerIfNecessary(page_fault.callstack());
+  }
+
+  CallstackEvent callstack_event;
+  callstack_event.set_time(page_fault.timestamp_ns());
+  callstack_event.set_callstack_hash(hash);
+  callstack_event.set_thread_id(page_fault.tid());
+  capture_listener_->OnPageFaultEvent(std::move(callstack_event),
+                                      page_fault.major());
+}
+
 void CaptureEventProcessor::ProcessFunctionCall(
     const FunctionCall& function_call) {
-  TimerInfo timer_info;
+  TimerInfo& timer_info = timers_.emplace_back();
   timer_info.set_thread_id(function_call.tid());
   timer_info.set_start(function_call.begin_timestamp_ns());
   timer_info.set_end(function_call.end_timestamp_ns());
@@ -92,17 +306,73 @@ void CaptureEventProcessor::ProcessFunctionCall(
   timer_info.set_user_data_key(function_call.return_value());
   timer_info.set_processor(-1);
   timer_info.set_type(TimerInfo::kNone);
+}
+
+void CaptureEventProcessor::ProcessLockWait(const LockWait& lock_wait) {
+  TimerInfo& timer_info = timers_.emplace_back();
+  timer_info.set_process_id(lock_wait.pid());
+  timer_info.set_thread_id(lock_wait.tid());
+  timer_info.set_start(lock_wait.begin_timestamp_ns());
+  timer_info.set_end(lock_wait.end_timestamp_ns());
+  timer_info.set_depth(static_cast<uint8_t>(lock_wait.depth()));
+  timer_info.set_user_data_key(lock_wait.lock_address());
+  timer_info.set_processor(-1);
+  timer_info.set_type(TimerInfo::kLockWait);
+}
+
+void CaptureEventProcessor::ProcessSyscallLatency(
+    const SyscallLatency& syscall_latency) {
+  TimerInfo& timer_info = timers_.emplace_back();
+  timer_info.set_process_id(syscall_latency.pid());
+  timer_info.set_thread_id(syscall_latency.tid());
+  timer_info.set_start(syscall_latency.begin_timestamp_ns());
+  timer_info.set_end(syscall_latency.end_timestamp_ns());
+  timer_info.set_depth(static_cast<uint8_t>(syscall_latency.depth()));
+  timer_info.set_user_data_key(syscall_latency.syscall_nr());
+  timer_info.set_processor(-1);
+  timer_info.set_type(TimerInfo::kSyscall);
+}
+
+void CaptureEventProcessor::ProcessBlockIoLatency(
+    const BlockIoLatency& block_io_latency) {
+  // Sectors are always of 512 bytes for the block layer.
+  constexpr uint64_t kSectorSize = 512;
+  TimerInfo& timer_info = timers_.emplace_back();
+  timer_info.set_process_id(block_io_latency.pid());
+  timer_info.set_thread_id(block_io_latency.tid());
+  timer_info.set_start(block_io_latency.issue_timestamp_ns());
+  timer_info.set_end(block_io_latency.complete_timestamp_ns());
+  timer_info.set_depth(static_cast<uint8_t>(block_io_latency.depth()));
+  timer_info.set_user_data_key(block_io_latency.nr_sectors() * kSectorSize);
+  timer_info.set_processor(-1);
+  timer_info.set_type(block_io_latency.write() ? TimerInfo::kBlockIoWrite
+                                               : TimerInfo::kBlockIoRead);
+}
 
-  capture_listener_->OnTimer(timer_info);
+void CaptureEventProcessor::ProcessLockContentionStats(
+    const LockContentionStats& lock_contention_stats) {
+  uint64_t hash = 0;
+  if (lock_contention_stats.callstack_or_key_case() ==
+      LockContentionStats::kCallstackKey) {
+    auto hash_it =
+        callstack_hashes_by_key_.find(lock_contention_stats.callstack_key());
+    if (hash_it == callstack_hashes_by_key_.end()) {
+      ERROR("Unknown callstack key %lu", lock_contention_stats.callstack_key());
+      return;
+    }
+    hash = hash_it->second;
+  } else {
+    hash = GetCallstackHashAndSendToListenerIfNecessary(
+        lock_contention_stats.callstack());
+  }
+  capture_listener_->OnLockContentionStats(hash, lock_contention_stats);
 }
 
 void CaptureEventProcessor::ProcessInternedString(
     InternedString interned_string) {
-  if (string_intern_pool.contains(interned_string.key())) {
-    ERROR("Overwriting InternedString with key %llu", interned_string.key());
-  }
-  string_intern_pool.emplace(interned_string.key(),
-                             std::move(*interned_string.mutable_intern()));
+  // As for InternedCallstack, the key then refers to the new string.
+  string_intern_pool.insert_or_assign(
+      interned_string.key(), std::move(*interned_string.mutable_intern()));
 }
 
 void CaptureEventProcessor::ProcessGpuJob(const GpuJob& gpu_job) {
@@ -117,7 +387,7 @@ void CaptureEventProcessor::ProcessGpuJob(const GpuJob& gpu_job) {
   constexpr const char* sw_queue = "sw queue";
   uint64_t sw_queue_key = GetStringHashAndSendToListenerIfNecessary(sw_queue);
 
-  TimerInfo timer_user_to_sched;
+  TimerInfo& timer_user_to_sched = timers_.emplace_back();
   timer_user_to_sched.set_thread_id(gpu_job.tid());
   timer_user_to_sched.set_start(gpu_job.amdgpu_cs_ioctl_time_ns());
   timer_user_to_sched.set_end(gpu_job.amdgpu_sched_run_job_time_ns());
@@ -126,12 +396,11 @@ void CaptureEventProcessor::ProcessGpuJob(const GpuJob& gpu_job) {
   timer_user_to_sched.set_timeline_hash(timeline_hash);
   timer_user_to_sched.set_processor(-1);
   timer_user_to_sched.set_type(TimerInfo::kGpuActivity);
-  capture_listener_->OnTimer(std::move(timer_user_to_sched));
 
   constexpr const char* hw_queue = "hw queue";
   uint64_t hw_queue_key = GetStringHashAndSendToListenerIfNecessary(hw_queue);
 
-  TimerInfo timer_sched_to_start;
+  TimerInfo& timer_sched_to_start = timers_.emplace_back();
   timer_sched_to_start.set_thread_id(gpu_job.tid());
   timer_sched_to_start.set_start(gpu_job.amdgpu_sched_run_job_time_ns());
   timer_sched_to_start.set_end(gpu_job.gpu_hardware_start_time_ns());
@@ -140,13 +409,12 @@ void CaptureEventProcessor::ProcessGpuJob(const GpuJob& gpu_job) {
   timer_sched_to_start.set_timeline_hash(timeline_hash);
   timer_sched_to_start.set_processor(-1);
   timer_sched_to_start.set_type(TimerInfo::kGpuActivity);
-  capture_listener_->OnTimer(std::move(timer_sched_to_start));
 
   constexpr const char* hw_execution = "hw execution";
   uint64_t hw_execution_key =
       GetStringHashAndSendToListenerIfNecessary(hw_execution);
 
-  TimerInfo timer_start_to_finish;
+  TimerInfo& timer_start_to_finish = timers_.emplace_back();
   timer_start_to_finish.set_thread_id(gpu_job.tid());
   timer_start_to_finish.set_start(gpu_job.gpu_hardware_start_time_ns());
   timer_start_to_finish.set_end(gpu_job.dma_fence_signaled_time_ns());
@@ -155,7 +423,68 @@ void CaptureEventProcessor::ProcessGpuJob(const GpuJob& gpu_job) {
   timer_start_to_finish.set_timeline_hash(timeline_hash);
   timer_start_to_finish.set_processor(-1);
   timer_start_to_finish.set_type(TimerInfo::kGpuActivity);
-  capture_listener_->OnTimer(std::move(timer_start_to_finish));
+
+  // The Vulkan layer reports a submission once its GPU work has completed,
+  // which can be before or after the GpuJob.
+  for (auto it = unmatched_gpu_queue_submissions_.begin();
+       it != unmatched_gpu_queue_submissions_.end(); ++it) {
+    if (it->tid() == gpu_job.tid() &&
+        it->submit_begin_timestamp_ns() <= gpu_job.amdgpu_cs_ioctl_time_ns() &&
+        gpu_job.amdgpu_cs_ioctl_time_ns() <= it->submit_end_timestamp_ns()) {
+      AddGpuCommandBufferTimers(*it, timeline_hash);
+      unmatched_gpu_queue_submissions_.erase(it);
+      break;
+    }
+  }
+  std::deque<SubmittedGpuJob>& gpu_jobs = gpu_jobs_by_tid_[gpu_job.tid()];
+  gpu_jobs.push_back(
+      SubmittedGpuJob{gpu_job.amdgpu_cs_ioctl_time_ns(), timeline_hash});
+  if (gpu_jobs.size() > kMaxSubmittedGpuJobsPerThread) {
+    gpu_jobs.pop_front();
+  }
+}
+
+void CaptureEventProcessor::ProcessGpuQueueSubmission(
+    const GpuQueueSubmission& gpu_queue_submission) {
+  // The driver submits the job during the vkQueueSubmit, on the same thread.
+  auto gpu_jobs_it = gpu_jobs_by_tid_.find(gpu_queue_submission.tid());
+  if (gpu_jobs_it != gpu_jobs_by_tid_.end()) {
+    for (const SubmittedGpuJob& gpu_job : gpu_jobs_it->second) {
+      if (gpu_queue_submission.submit_begin_timestamp_ns() <=
+              gpu_job.amdgpu_cs_ioctl_time_ns &&
+          gpu_job.amdgpu_cs_ioctl_time_ns <=
+              gpu_queue_submission.submit_end_timestamp_ns()) {
+        AddGpuCommandBufferTimers(gpu_queue_submission, gpu_job.timeline_hash);
+        return;
+      }
+    }
+  }
+  // Without the GpuJob, e.g., on a driver without the amdgpu tracepoints, the
+  // timeline of the submission is unknown.
+  unmatched_gpu_queue_submissions_.push_back(gpu_queue_submission);
+  if (unmatched_gpu_queue_submissions_.size() >
+      kMaxUnmatchedGpuQueueSubmissions) {
+    unmatched_gpu_queue_submissions_.pop_front();
+  }
+}
+
+void CaptureEventProcessor::AddGpuCommandBufferTimers(
+    const GpuQueueSubmission& gpu_queue_submission, uint64_t timeline_hash) {
+  constexpr const char* command_buffer = "command buffer";
+  for (const GpuCommandBufferSlice& slice : gpu_queue_submission.slices()) {
+    TimerInfo& timer_info = timers_.emplace_back();
+    timer_info.set_process_id(gpu_queue_submission.pid());
+    timer_info.set_thread_id(gpu_queue_submission.tid());
+    timer_info.set_start(slice.begin_timestamp_ns());
+    timer_info.set_end(std::max(slice.begin_timestamp_ns(),
+                                slice.end_timestamp_ns()));
+    timer_info.set_depth(slice.depth());
+    timer_info.set_user_data_key(GetStringHashAndSendToListenerIfNecessary(
+        slice.label().empty() ? command_buffer : slice.label()));
+    timer_info.set_timeline_hash(timeline_hash);
+    timer_info.set_processor(-1);
+    timer_info.set_type(TimerInfo::kGpuCommandBuffer);
+  }
 }
 
 void CaptureEventProcessor::ProcessThreadName(const ThreadName& thread_name) {
@@ -187,18 +516,284 @@ void CaptureEventProcessor::ProcessAddressInfo(
   capture_listener_->OnAddressInfo(linux_address_info);
 }
 
-uint64_t CaptureEventProcessor::GetCallstackHashAndSendToListenerIfNecessary(
-    const Callstack& callstack) {
-  CallStack cs;
-  for (uint64_t pc : callstack.pcs()) {
-    cs.m_Data.push_back(pc);
+void CaptureEventProcessor::ProcessTimestampBase(
+    const TimestampBase& timestamp_base) {
+  timestamp_base_ns_ = timestamp_base.timestamp_ns();
+}
+
+void CaptureEventProcessor::ProcessCompactSchedulingSlice(
+    const CompactSchedulingSlice& compact_scheduling_slice) {
+  SchedulingSlice scheduling_slice;
+  scheduling_slice.set_pid(compact_scheduling_slice.pid());
+  scheduling_slice.set_tid(compact_scheduling_slice.tid());
+  scheduling_slice.set_core(compact_scheduling_slice.core());
+  uint64_t in_timestamp_ns =
+      DecodeTimestamp(compact_scheduling_slice.in_timestamp_delta_ns());
+  scheduling_slice.set_in_timestamp_ns(in_timestamp_ns);
+  scheduling_slice.set_out_timestamp_ns(
+      in_timestamp_ns + compact_scheduling_slice.duration_ns());
+  ProcessSchedulingSlice(scheduling_slice);
+}
+
+void CaptureEventProcessor::ProcessCompactThreadWakeup(
+    const CompactThreadWakeup& compact_thread_wakeup) {
+  ThreadWakeup thread_wakeup;
+  thread_wakeup.set_wakee_tid(compact_thread_wakeup.wakee_tid());
+  thread_wakeup.set_waker_tid(compact_thread_wakeup.waker_tid());
+  thread_wakeup.set_timestamp_ns(
+      DecodeTimestamp(compact_thread_wakeup.timestamp_delta_ns()));
+  capture_listener_->OnThreadWakeup(thread_wakeup);
+}
+
+void CaptureEventProcessor::ProcessCompactFunctionCall(
+    const CompactFunctionCall& compact_function_call) {
+  uint64_t absolute_address = compact_function_call.absolute_address();
+  const uint64_t function_id = compact_function_call.function_id();
+  if (function_id != 0) {
+    if (function_id > function_addresses_by_id_.size()) {
+      ERROR("Unknown function id %lu", function_id);
+      return;
+    }
+    absolute_address = function_addresses_by_id_[function_id - 1];
+  }
+
+  FunctionCall function_call;
+  function_call.set_pid(compact_function_call.pid());
+  function_call.set_tid(compact_function_call.tid());
+  function_call.set_absolute_address(absolute_address);
+  uint64_t begin_timestamp_ns =
+      DecodeTimestamp(compact_function_call.begin_timestamp_delta_ns());
+  function_call.set_begin_timestamp_ns(begin_timestamp_ns);
+  function_call.set_end_timestamp_ns(begin_timestamp_ns +
+                                     compact_function_call.duration_ns());
+  function_call.set_depth(compact_function_call.depth());
+  function_call.set_return_value(compact_function_call.return_value());
+  *function_call.mutable_registers() = compact_function_call.registers();
+  ProcessFunctionCall(function_call);
+}
+
+void CaptureEventProcessor::ProcessCompactInternedCallstack(
+    const CompactInternedCallstack& compact_interned_callstack) {
+  InternedCallstack interned_callstack;
+  interned_callstack.set_key(compact_interned_callstack.key());
+  uint64_t pc = 0;
+  for (int64_t pc_delta : compact_interned_callstack.pc_deltas()) {
+    pc += static_cast<uint64_t>(pc_delta);
+    interned_callstack.mutable_intern()->add_pcs(pc);
+  }
+  ProcessInternedCallstack(std::move(interned_callstack));
+}
+
+void CaptureEventProcessor::ProcessCompactCallstackSample(
+    const CompactCallstackSample& compact_callstack_sample) {
+  CallstackSample callstack_sample;
+  callstack_sample.set_pid(compact_callstack_sample.pid());
+  callstack_sample.set_tid(compact_callstack_sample.tid());
+  callstack_sample.set_callstack_key(compact_callstack_sample.callstack_key());
+  callstack_sample.set_timestamp_ns(
+      DecodeTimestamp(compact_callstack_sample.timestamp_delta_ns()));
+  ProcessCallstackSample(callstack_sample);
+}
+
+void CaptureEventProcessor::ProcessDroppedEvents(
+    const DroppedEvents& dropped_events) {
+  capture_listener_->OnDroppedEvents(
+      dropped_events.begin_timestamp_ns(), dropped_events.end_timestamp_ns(),
+      dropped_events.callstack_sample_count() +
+          dropped_events.scheduling_slice_count());
+}
+
+void CaptureEventProcessor::ProcessFunctionCallStats(
+    const FunctionCallStats& function_call_stats) {
+  FunctionStats stats;
+  stats.set_count(function_call_stats.count());
+  stats.set_total_time_ns(function_call_stats.total_duration_ns());
+  if (function_call_stats.count() > 0) {
+    stats.set_average_time_ns(function_call_stats.total_duration_ns() /
+                              function_call_stats.count());
+  }
+  stats.set_min_ns(function_call_stats.min_duration_ns());
+  stats.set_max_ns(function_call_stats.max_duration_ns());
+  *stats.mutable_duration_histogram() =
+      function_call_stats.duration_histogram();
+  capture_listener_->OnFunctionCallStats(
+      function_call_stats.absolute_address(), stats);
+}
+
+void CaptureEventProcessor::ProcessCaptureSetupPhase(
+    const CaptureSetupPhase& capture_setup_phase) {
+  constexpr double kNsPerMs = 1'000'000.0;
+  LOG("Capture setup phase \"%s\" %s in %.1f ms",
+      capture_setup_phase.name().c_str(),
+      capture_setup_phase.succeeded() ? "succeeded" : "failed",
+      (capture_setup_phase.end_timestamp_ns() -
+       capture_setup_phase.begin_timestamp_ns()) /
+          kNsPerMs);
+}
+
+void CaptureEventProcessor::ProcessCpuBudgetStep(
+    const CpuBudgetStep& cpu_budget_step) {
+  LOG("The service used %.1f%% of a core over its CPU budget window, and "
+      "gave up fidelity: %s",
+      100 * cpu_budget_step.cpu_usage(),
+      CpuBudgetStep::Action_Name(cpu_budget_step.action()));
+}
+
+void CaptureEventProcessor::ProcessClockOffset(
+    const ClockOffset& clock_offset) {
+  // Only the first offset and the larger adjustments are worth a line.
+  constexpr int64_t kLoggedAdjustmentNs = 1'000'000;
+  if (!realtime_offset_ns_.has_value() ||
+      std::abs(clock_offset.realtime_offset_ns() -
+               realtime_offset_ns_.value()) >= kLoggedAdjustmentNs) {
+    LOG("Service clock: CLOCK_REALTIME is CLOCK_MONOTONIC + %d ns at %u",
+        clock_offset.realtime_offset_ns(), clock_offset.timestamp_ns());
+  }
+  realtime_offset_ns_ = clock_offset.realtime_offset_ns();
+}
+
+void CaptureEventProcessor::ProcessCaptureStatistics(
+    const CaptureStatistics& capture_statistics) {
+  const double window_s =
+      capture_statistics.window_duration_ns() / 1'000'000'000.0;
+  if (window_s <= 0) {
+    return;
+  }
+  std::optional<uint64_t> median_unwind_duration_ns =
+      OrbitBase::LogLinearHistogram::ComputeQuantile(
+          capture_statistics.unwind_duration_histogram(), 0.5);
+  LOG("Service statistics: %.0f samples/s, %.0f sched switches/s, %.0f "
+      "u(ret)probes/s, %.0f lost/s, median unwinding %lu ns, %.1f%% of the "
+      "samples unwound from the memo, %lu events waiting to be processed, %lu "
+      "to be sent, %.0f bytes/s sent, %.1f%% of the time stalled sending",
+      capture_statistics.sample_count() / window_s,
+      capture_statistics.sched_switch_count() / window_s,
+      capture_statistics.uprobes_count() / window_s,
+      capture_statistics.lost_count() / window_s,
+      median_unwind_duration_ns.value_or(0),
+      capture_statistics.sample_count() == 0
+          ? 0.0
+          : 100.0 * capture_statistics.unwind_memo_hit_count() /
+                capture_statistics.sample_count(),
+      capture_statistics.processor_queued_event_count(),
+      capture_statistics.sender_queued_event_count(),
+      capture_statistics.bytes_sent() / window_s,
+      100.0 * capture_statistics.sender_stall_duration_ns() /
+          capture_statistics.window_duration_ns());
+  if (capture_statistics.numa_read_record_count() > 0) {
+    LOG("Service statistics: %.1f%% of the records read across NUMA nodes",
+        100.0 * capture_statistics.cross_numa_node_read_record_count() /
+            capture_statistics.numa_read_record_count());
   }
-  // TODO: Compute the hash without creating the CallStack if not necessary.
-  uint64_t hash = cs.Hash();
+}
 
-  if (!callstack_hashes_seen_.contains(hash)) {
-    callstack_hashes_seen_.emplace(hash);
-    capture_listener_->OnCallstack(cs);
+void CaptureEventProcessor::ProcessIntrospectionScope(
+    const IntrospectionScope& introspection_scope) {
+  std::string name;
+  if (introspection_scope.name_or_key_case() ==
+      IntrospectionScope::kNameKey) {
+    name = string_intern_pool[introspection_scope.name_key()];
+  } else {
+    name = introspection_scope.name();
+  }
+
+  // The scopes of the service are on the tracks of its threads, which are
+  // told apart from the ones of the target by their color.
+  TimerInfo& timer_info = timers_.emplace_back();
+  timer_info.set_start(introspection_scope.begin_timestamp_ns());
+  timer_info.set_end(introspection_scope.end_timestamp_ns());
+  timer_info.set_process_id(introspection_scope.pid());
+  timer_info.set_thread_id(introspection_scope.tid());
+  timer_info.set_depth(introspection_scope.depth());
+  timer_info.set_user_data_key(GetStringHashAndSendToListenerIfNecessary(name));
+  timer_info.set_processor(-1);
+  timer_info.set_type(TimerInfo::kIntrospection);
+}
+
+void CaptureEventProcessor::ProcessManualInstrumentationScope(
+    const ManualInstrumentationScope& manual_instrumentation_scope) {
+  std::string name;
+  if (manual_instrumentation_scope.name_or_key_case() ==
+      ManualInstrumentationScope::kNameKey) {
+    name = string_intern_pool[manual_instrumentation_scope.name_key()];
+  } else {
+    name = manual_instrumentation_scope.name();
+  }
+
+  TimerInfo& timer_info = timers_.emplace_back();
+  timer_info.set_start(manual_instrumentation_scope.begin_timestamp_ns());
+  timer_info.set_end(manual_instrumentation_scope.end_timestamp_ns());
+  timer_info.set_process_id(manual_instrumentation_scope.pid());
+  timer_info.set_thread_id(manual_instrumentation_scope.tid());
+  timer_info.set_depth(manual_instrumentation_scope.depth());
+  timer_info.set_user_data_key(GetStringHashAndSendToListenerIfNecessary(name));
+  timer_info.set_processor(-1);
+  timer_info.set_type(TimerInfo::kManualInstrumentation);
+}
+
+void CaptureEventProcessor::ProcessAsyncSpan(const AsyncSpan& async_span) {
+  std::string name;
+  if (async_span.name_or_key_case() == AsyncSpan::kNameKey) {
+    name = string_intern_pool[async_span.name_key()];
+  } else {
+    name = async_span.name();
+  }
+
+  // The depth is the lane of the span on the track of its name, assigned as
+  // the timer is added to it.
+  TimerInfo& timer_info = timers_.emplace_back();
+  timer_info.set_start(async_span.begin_timestamp_ns());
+  timer_info.set_end(async_span.end_timestamp_ns());
+  timer_info.set_process_id(async_span.pid());
+  timer_info.set_thread_id(async_span.begin_tid());
+  timer_info.set_user_data_key(GetStringHashAndSendToListenerIfNecessary(name));
+  timer_info.set_processor(-1);
+  timer_info.set_type(TimerInfo::kAsync);
+}
+
+void CaptureEventProcessor::ProcessFrameMarker(
+    const FrameMarker& frame_marker) {
+  std::string name;
+  if (frame_marker.name_or_key_case() == FrameMarker::kNameKey) {
+    name = string_intern_pool[frame_marker.name_key()];
+  } else {
+    name = frame_marker.name();
+  }
+  uint64_t name_hash = GetStringHashAndSendToListenerIfNecessary(name);
+
+  // Each marker ends the frame that the previous one of the name started.
+  auto [it, inserted] = last_frame_marker_timestamps_ns_.try_emplace(
+      std::make_pair(frame_marker.pid(), name_hash),
+      frame_marker.timestamp_ns());
+  if (inserted) {
+    return;
+  }
+  const uint64_t frame_begin_ns = it->second;
+  it->second = frame_marker.timestamp_ns();
+  TimerInfo& timer_info = timers_.emplace_back();
+  timer_info.set_start(frame_begin_ns);
+  timer_info.set_end(frame_marker.timestamp_ns());
+  timer_info.set_process_id(frame_marker.pid());
+  timer_info.set_thread_id(frame_marker.tid());
+  timer_info.set_user_data_key(name_hash);
+  timer_info.set_processor(-1);
+  timer_info.set_type(TimerInfo::kFrame);
+}
+
+uint64_t CaptureEventProcessor::DecodeTimestamp(
+    int64_t timestamp_delta_ns) const {
+  return timestamp_base_ns_ + static_cast<uint64_t>(timestamp_delta_ns);
+}
+
+uint64_t CaptureEventProcessor::GetCallstackHashAndSendToListenerIfNecessary(
+    const Callstack& callstack) {
+  const uint64_t hash =
+      CallStack::ComputeHash(callstack.pcs().data(), callstack.pcs_size());
+  if (callstack_hashes_seen_.insert(hash).second) {
+    CallStack cs;
+    cs.m_Data.assign(callstack.pcs().begin(), callstack.pcs().end());
+    cs.m_Hash = hash;
+    capture_listener_->OnCallstack(std::move(cs));
   }
   return hash;
 }
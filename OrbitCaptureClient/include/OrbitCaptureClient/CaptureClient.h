@@ -5,11 +5,15 @@
 #ifndef ORBIT_CAPTURE_CLIENT_CAPTURE_CLIENT_H_
 #define ORBIT_CAPTURE_CLIENT_CAPTURE_CLIENT_H_
 
+#include <map>
 #include <optional>
+#include <string>
+#include <vector>
 
 #include "CaptureEventProcessor.h"
 #include "CaptureListener.h"
 #include "OrbitBase/Logging.h"
+#include "absl/synchronization/mutex.h"
 #include "capture_data.pb.h"
 #include "grpcpp/channel.h"
 #include "services.grpc.pb.h"
@@ -23,9 +27,19 @@ class CaptureClient {
     CHECK(capture_listener_ != nullptr);
   }
 
+  // With --client_side_symbolization, the service only sends the names of
+  // the sampled functions of the modules of unsymbolized_module_paths.
   void Capture(int32_t pid,
                const std::map<uint64_t, orbit_client_protos::FunctionInfo*>&
-                   selected_functions);
+                   selected_functions,
+               const std::vector<std::string>& unsymbolized_module_paths = {});
+  // Changes the instrumented functions of the running capture. Returns false
+  // if there is no capture or the request could not be sent.
+  bool UpdateInstrumentedFunctions(
+      const std::vector<const orbit_client_protos::FunctionInfo*>&
+          added_functions,
+      const std::vector<const orbit_client_protos::FunctionInfo*>&
+          removed_functions);
   void StopCapture();
 
  private:
@@ -34,6 +48,9 @@ class CaptureClient {
   std::unique_ptr<CaptureService::Stub> capture_service_;
   std::unique_ptr<grpc::ClientReaderWriter<CaptureRequest, CaptureResponse>>
       reader_writer_;
+  // Capture, UpdateInstrumentedFunctions and StopCapture write to
+  // reader_writer_ from different threads.
+  absl::Mutex writer_mutex_;
 
   CaptureListener* capture_listener_ = nullptr;
 
@@ -5,6 +5,12 @@
 #ifndef ORBIT_CAPTURE_CLIENT_CAPTURE_EVENT_PROCESSOR_H_
 #define ORBIT_CAPTURE_CLIENT_CAPTURE_EVENT_PROCESSOR_H_
 
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <utility>
+#include <vector>
+
 #include "OrbitCaptureClient/CaptureListener.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
@@ -17,26 +23,104 @@ class CaptureEventProcessor {
 
   void ProcessEvent(const CaptureEvent& event);
 
+  // The absolute address of the function of each
+  // CaptureOptions.InstrumentedFunction.function_id, the id minus one being
+  // the index.
+  void SetFunctionAddressesById(std::vector<uint64_t> function_addresses) {
+    function_addresses_by_id_ = std::move(function_addresses);
+  }
+
+  // CLOCK_REALTIME minus CLOCK_MONOTONIC on the host of the service, whose
+  // clock the timestamps of the capture are in, from the latest ClockOffset.
+  [[nodiscard]] std::optional<int64_t> GetRealtimeOffsetNs() const {
+    return realtime_offset_ns_;
+  }
+
   template <typename Iterable>
   void ProcessEvents(const Iterable& events) {
     for (const auto& event : events) {
-      ProcessEvent(event);
+      DispatchEvent(event);
     }
+    SendTimersToListener();
   }
 
  private:
+  // Timers are built in place in timers_ and sent to the listener in one
+  // OnTimers call per ProcessEvent or ProcessEvents.
+  void DispatchEvent(const CaptureEvent& event);
+  void SendTimersToListener();
   void ProcessSchedulingSlice(const SchedulingSlice& scheduling_slice);
   void ProcessInternedCallstack(InternedCallstack interned_callstack);
   void ProcessCallstackSample(const CallstackSample& callstack_sample);
+  void ProcessCallstackSampleCounts(
+      const CallstackSampleCounts& callstack_sample_counts);
+  void ProcessOffCpuCallstackSample(
+      const OffCpuCallstackSample& off_cpu_callstack_sample);
+  void ProcessAllocationSample(const AllocationSample& allocation_sample);
+  void ProcessPageFault(const PageFault& page_fault);
   void ProcessFunctionCall(const FunctionCall& function_call);
+  void ProcessLockWait(const LockWait& lock_wait);
+  void ProcessSyscallLatency(const SyscallLatency& syscall_latency);
+  void ProcessBlockIoLatency(const BlockIoLatency& block_io_latency);
+  void ProcessLockContentionStats(
+      const LockContentionStats& lock_contention_stats);
   void ProcessInternedString(InternedString interned_string);
   void ProcessGpuJob(const GpuJob& gpu_job);
+  void ProcessGpuQueueSubmission(
+      const GpuQueueSubmission& gpu_queue_submission);
+  // In the GpuTrack of the GpuJob that the submission was matched with.
+  void AddGpuCommandBufferTimers(
+      const GpuQueueSubmission& gpu_queue_submission, uint64_t timeline_hash);
   void ProcessThreadName(const ThreadName& thread_name);
   void ProcessAddressInfo(const AddressInfo& address_info);
+  void ProcessTimestampBase(const TimestampBase& timestamp_base);
+  void ProcessCompactSchedulingSlice(
+      const CompactSchedulingSlice& compact_scheduling_slice);
+  void ProcessCompactFunctionCall(
+      const CompactFunctionCall& compact_function_call);
+  void ProcessCompactInternedCallstack(
+      const CompactInternedCallstack& compact_interned_callstack);
+  void ProcessCompactCallstackSample(
+      const CompactCallstackSample& compact_callstack_sample);
+  void ProcessCompactThreadWakeup(
+      const CompactThreadWakeup& compact_thread_wakeup);
+  void ProcessDroppedEvents(const DroppedEvents& dropped_events);
+  void ProcessFunctionCallStats(const FunctionCallStats& function_call_stats);
+  void ProcessCaptureSetupPhase(const CaptureSetupPhase& capture_setup_phase);
+  void ProcessCaptureStatistics(const CaptureStatistics& capture_statistics);
+  void ProcessCpuBudgetStep(const CpuBudgetStep& cpu_budget_step);
+  void ProcessClockOffset(const ClockOffset& clock_offset);
+  void ProcessIntrospectionScope(
+      const IntrospectionScope& introspection_scope);
+  void ProcessManualInstrumentationScope(
+      const ManualInstrumentationScope& manual_instrumentation_scope);
+  void ProcessAsyncSpan(const AsyncSpan& async_span);
+  void ProcessFrameMarker(const FrameMarker& frame_marker);
+  [[nodiscard]] uint64_t DecodeTimestamp(int64_t timestamp_delta_ns) const;
 
-  absl::flat_hash_map<uint64_t, Callstack> callstack_intern_pool;
+  // The hash of the callstack of each key, computed once when the callstack
+  // is interned rather than for each sample.
+  absl::flat_hash_map<uint64_t, uint64_t> callstack_hashes_by_key_;
   absl::flat_hash_map<uint64_t, std::string> string_intern_pool;
   CaptureListener* capture_listener_ = nullptr;
+  uint64_t timestamp_base_ns_ = 0;
+  std::optional<int64_t> realtime_offset_ns_;
+  std::vector<uint64_t> function_addresses_by_id_;
+  std::vector<orbit_client_protos::TimerInfo> timers_;
+  // By pid and name hash.
+  absl::flat_hash_map<std::pair<int32_t, uint64_t>, uint64_t>
+      last_frame_marker_timestamps_ns_;
+
+  struct SubmittedGpuJob {
+    uint64_t amdgpu_cs_ioctl_time_ns;
+    uint64_t timeline_hash;
+  };
+  static constexpr size_t kMaxSubmittedGpuJobsPerThread = 64;
+  static constexpr size_t kMaxUnmatchedGpuQueueSubmissions = 256;
+  // The last GpuJobs of each thread, by tid, and the GpuQueueSubmissions that
+  // arrived before their GpuJob, oldest first.
+  absl::flat_hash_map<int32_t, std::deque<SubmittedGpuJob>> gpu_jobs_by_tid_;
+  std::deque<GpuQueueSubmission> unmatched_gpu_queue_submissions_;
 
   absl::flat_hash_set<uint64_t> callstack_hashes_seen_;
   uint64_t GetCallstackHashAndSendToListenerIfNecessary(
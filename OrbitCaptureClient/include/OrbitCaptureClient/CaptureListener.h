@@ -9,19 +9,89 @@
 #include "EventBuffer.h"
 #include "KeyAndString.h"
 #include "ScopeTimer.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
+#include "capture.pb.h"
 #include "capture_data.pb.h"
 
 class CaptureListener {
  public:
   virtual ~CaptureListener() = default;
-  virtual void OnTimer(const orbit_client_protos::TimerInfo& timer_info) = 0;
+  // Called with the timers of the events processed together, for instance
+  // all the events of a CaptureResponse. The listener can move out of them.
+  virtual void OnTimers(absl::Span<orbit_client_protos::TimerInfo> timers) = 0;
   virtual void OnKeyAndString(uint64_t key, std::string str) = 0;
   virtual void OnCallstack(CallStack callstack) = 0;
   virtual void OnCallstackEvent(
       orbit_client_protos::CallstackEvent callstack_event) = 0;
+  // Called instead of OnCallstackEvent when the service counts the samples,
+  // see CaptureOptions.callstack_sample_counts_interval_ns, with the number
+  // of samples of the thread by callstack hash over an interval beginning at
+  // begin_timestamp_ns. The callstacks are sent with OnCallstack, as for
+  // OnCallstackEvent.
+  virtual void OnCallstackSampleCounts(
+      int32_t thread_id, uint64_t begin_timestamp_ns,
+      const absl::flat_hash_map<uint64_t, uint32_t>&
+          counts_by_callstack_hash) = 0;
+  // Called for the callstacks of the threads of the target process when they
+  // blocked, with how long they were off-CPU, when the capture traces off-CPU
+  // time. The callstacks are sent with OnCallstack, as for OnCallstackEvent.
+  virtual void OnOffCpuCallstackEvent(
+      orbit_client_protos::CallstackEvent callstack_event,
+      uint64_t off_cpu_duration_ns) = 0;
+  // Called for the sampled malloc calls of the target process, with the
+  // estimated bytes allocated from the callstack that each sample stands for,
+  // when the capture traces allocations. The callstacks are sent with
+  // OnCallstack, as for OnCallstackEvent.
+  virtual void OnAllocationEvent(
+      orbit_client_protos::CallstackEvent callstack_event,
+      uint64_t sampled_bytes) = 0;
+  // Called for the major page faults of the target process, and for the
+  // sampled minor ones, when the capture traces page faults. The callstacks
+  // are sent with OnCallstack, as for OnCallstackEvent.
+  virtual void OnPageFaultEvent(
+      orbit_client_protos::CallstackEvent callstack_event, bool major) = 0;
+  // Called periodically, when the capture traces page faults, with the page
+  // faults and the mmap and munmap calls so far of a thread of the target
+  // process.
+  virtual void OnPageFaultStats(const PageFaultStats& page_fault_stats) = 0;
   virtual void OnThreadName(int32_t thread_id, std::string thread_name) = 0;
   virtual void OnAddressInfo(
       orbit_client_protos::LinuxAddressInfo address_info) = 0;
+  // Called when the service couldn't send some events between the two
+  // timestamps, because this client didn't receive the data fast enough.
+  virtual void OnDroppedEvents(uint64_t begin_timestamp_ns,
+                               uint64_t end_timestamp_ns,
+                               uint64_t dropped_event_count) = 0;
+  // Called periodically for a function whose calls are aggregated by the
+  // service instead of reported one by one with OnTimers, with the stats of
+  // all its calls so far.
+  virtual void OnFunctionCallStats(
+      uint64_t function_address,
+      const orbit_client_protos::FunctionStats& function_stats) = 0;
+  // Called periodically, when the capture traces lock contention, with the
+  // futex waits so far of the target process on a lock from a callstack. The
+  // callstack is sent with OnCallstack, as for OnCallstackEvent.
+  virtual void OnLockContentionStats(
+      uint64_t callstack_hash,
+      const LockContentionStats& lock_contention_stats) = 0;
+  // Called for each scheduling slice of the target process, with the hardware
+  // performance counters, when the capture traces them.
+  virtual void OnSchedulingSliceCounters(
+      const SchedulingSliceCounters& scheduling_slice_counters) = 0;
+  // Called for the wakeups of all threads, when the capture traces thread
+  // states. They can arrive out of order with the scheduling slices.
+  virtual void OnThreadWakeup(const ThreadWakeup& thread_wakeup) = 0;
+  // Called for the frequency changes and the idle states of all cpus, when the
+  // capture traces them with trace_cpu_power_states.
+  virtual void OnCpuPowerEvent(const CpuPowerEvent& cpu_power_event) = 0;
+  // Called with the executable maps of a process that is sampled, but not
+  // captured, when the capture samples all processes.
+  virtual void OnModuleMap(const ModuleMap& module_map) = 0;
+  // Called once, when the service disabled the instrumented functions that
+  // were called too often, see max_instrumented_function_call_rate.
+  virtual void OnDisabledInstrumentedFunctions(
+      const DisabledInstrumentedFunctions& disabled_instrumented_functions) = 0;
 };
 
 #endif  // ORBIT_GL_CAPTURE_LISTENER_H_
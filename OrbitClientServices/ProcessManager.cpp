@@ -4,11 +4,13 @@
 
 #include "OrbitClientServices/ProcessManager.h"
 
+#include <algorithm>
 #include <chrono>
 #include <memory>
 #include <string>
 
 #include "OrbitBase/Logging.h"
+#include "absl/container/flat_hash_map.h"
 #include "grpcpp/grpcpp.h"
 #include "outcome.hpp"
 #include "services.grpc.pb.h"
@@ -17,23 +19,36 @@
 namespace {
 
 constexpr uint64_t kGrpcDefaultTimeoutMilliseconds = 1000;
+// Calls that transfer a lot of data get another default timeout for each
+// of these many bytes.
+constexpr uint64_t kBytesPerGrpcDefaultTimeout = 8 * 1024 * 1024;
+// Loading the symbols of a large module on the remote takes a while.
+constexpr uint64_t kGrpcLoadModuleSymbolsTimeoutMilliseconds = 5 * 60 * 1000;
 
 class ProcessManagerImpl final : public ProcessManager {
  public:
-  explicit ProcessManagerImpl(const std::shared_ptr<grpc::Channel>& channel,
-                              absl::Duration refresh_timeout);
+  explicit ProcessManagerImpl(
+      const std::shared_ptr<grpc::Channel>& channel,
+      absl::Duration refresh_timeout,
+      const std::shared_ptr<grpc::Channel>& bulk_channel);
 
   void SetProcessListUpdateListener(
       const std::function<void(ProcessManager*)>& listener) override;
 
   std::vector<ProcessInfo> GetProcessList() const override;
   ErrorMessageOr<std::vector<ModuleInfo>> LoadModuleList(int32_t pid) override;
+  ErrorMessageOr<ModuleListChanges> LoadModuleListChanges(
+      int32_t pid) override;
 
   ErrorMessageOr<std::string> LoadProcessMemory(int32_t pid, uint64_t address,
                                                 uint64_t size) override;
+  ErrorMessageOr<std::vector<std::string>> LoadProcessMemoryRanges(
+      int32_t pid, const std::vector<MemoryRange>& ranges) override;
 
   ErrorMessageOr<std::string> FindDebugInfoFile(
       const std::string& module_path, const std::string& build_id) override;
+  ErrorMessageOr<ModuleSymbols> LoadModuleSymbols(
+      const std::string& module_path, const std::string& build_id) override;
 
   void Start();
   void Shutdown() override;
@@ -42,24 +57,41 @@ class ProcessManagerImpl final : public ProcessManager {
   std::unique_ptr<grpc::ClientContext> CreateContext(
       uint64_t timeout_milliseconds) const;
   void WorkerFunction();
+  // Applies the changes streamed by the service to the list until the call
+  // ends, which is only on an error or on shutdown.
+  grpc::Status WatchProcessList();
+  void RefreshProcessList();
 
   std::unique_ptr<ProcessService::Stub> process_service_;
+  // For the calls that transfer a lot of data, process_service_ without a
+  // bulk channel.
+  std::unique_ptr<ProcessService::Stub> bulk_process_service_;
 
   absl::Duration refresh_timeout_;
   absl::Mutex shutdown_mutex_;
   bool shutdown_initiated_;
+  // The context of the WatchProcessList call in progress, to cancel it on
+  // shutdown.
+  grpc::ClientContext* watch_context_ ABSL_GUARDED_BY(shutdown_mutex_) =
+      nullptr;
 
   mutable absl::Mutex mutex_;
   std::vector<ProcessInfo> process_list_;
   std::function<void(ProcessManager*)> process_list_update_listener_;
+  // The version of the module list last loaded for each process.
+  absl::flat_hash_map<int32_t, uint64_t> module_list_versions_
+      ABSL_GUARDED_BY(mutex_);
 
   std::thread worker_thread_;
 };
 
 ProcessManagerImpl::ProcessManagerImpl(
     const std::shared_ptr<grpc::Channel>& channel,
-    absl::Duration refresh_timeout)
+    absl::Duration refresh_timeout,
+    const std::shared_ptr<grpc::Channel>& bulk_channel)
     : process_service_(ProcessService::NewStub(channel)),
+      bulk_process_service_(ProcessService::NewStub(
+          bulk_channel != nullptr ? bulk_channel : channel)),
       refresh_timeout_(refresh_timeout),
       shutdown_initiated_(false) {}
 
@@ -91,6 +123,51 @@ ErrorMessageOr<std::vector<ModuleInfo>> ProcessManagerImpl::LoadModuleList(
   return std::vector<ModuleInfo>(modules.begin(), modules.end());
 }
 
+ErrorMessageOr<ProcessManager::ModuleListChanges>
+ProcessManagerImpl::LoadModuleListChanges(int32_t pid) {
+  GetModuleListRequest request;
+  GetModuleListResponse response;
+  request.set_process_id(pid);
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = module_list_versions_.find(pid);
+    if (it != module_list_versions_.end()) {
+      request.set_known_modules_version(it->second);
+    }
+  }
+
+  std::unique_ptr<grpc::ClientContext> context =
+      CreateContext(kGrpcDefaultTimeoutMilliseconds);
+  grpc::Status status =
+      process_service_->GetModuleList(context.get(), request, &response);
+
+  if (!status.ok()) {
+    ERROR("Grpc call failed: code=%d, message=%s", status.error_code(),
+          status.error_message());
+    absl::MutexLock lock(&mutex_);
+    module_list_versions_.erase(pid);
+    return ErrorMessage(status.error_message());
+  }
+
+  {
+    absl::MutexLock lock(&mutex_);
+    // Services without versions always send the whole list.
+    if (response.modules_version() != 0) {
+      module_list_versions_.insert_or_assign(pid, response.modules_version());
+    } else {
+      module_list_versions_.erase(pid);
+    }
+  }
+
+  ModuleListChanges changes;
+  changes.is_incremental = response.is_incremental();
+  const auto& modules = response.modules();
+  changes.changed_modules.assign(modules.begin(), modules.end());
+  const auto& removed = response.removed_module_address_starts();
+  changes.removed_module_address_starts.assign(removed.begin(), removed.end());
+  return changes;
+}
+
 std::vector<ProcessInfo> ProcessManagerImpl::GetProcessList() const {
   absl::MutexLock lock(&mutex_);
   return process_list_;
@@ -117,6 +194,37 @@ ErrorMessageOr<std::string> ProcessManagerImpl::FindDebugInfoFile(
   return response.debug_info_file_path();
 }
 
+ErrorMessageOr<ModuleSymbols> ProcessManagerImpl::LoadModuleSymbols(
+    const std::string& module_path, const std::string& build_id) {
+  GetModuleSymbolsRequest request;
+  request.set_module_path(module_path);
+  request.set_build_id(build_id);
+
+  std::unique_ptr<grpc::ClientContext> context =
+      CreateContext(kGrpcLoadModuleSymbolsTimeoutMilliseconds);
+  std::unique_ptr<grpc::ClientReader<GetModuleSymbolsResponse>> reader =
+      bulk_process_service_->GetModuleSymbols(context.get(), request);
+
+  ModuleSymbols module_symbols;
+  GetModuleSymbolsResponse response;
+  while (reader->Read(&response)) {
+    ModuleSymbols* response_symbols = response.mutable_module_symbols();
+    module_symbols.set_load_bias(response_symbols->load_bias());
+    module_symbols.set_symbols_file_path(response_symbols->symbols_file_path());
+    for (SymbolInfo& symbol_info : *response_symbols->mutable_symbol_infos()) {
+      *module_symbols.add_symbol_infos() = std::move(symbol_info);
+    }
+  }
+
+  grpc::Status status = reader->Finish();
+  if (!status.ok()) {
+    ERROR("gRPC call to GetModuleSymbols failed: %s", status.error_message());
+    return ErrorMessage(status.error_message());
+  }
+
+  return module_symbols;
+}
+
 void ProcessManagerImpl::Start() {
   CHECK(!worker_thread_.joinable());
   worker_thread_ = std::thread([this] { WorkerFunction(); });
@@ -125,6 +233,9 @@ void ProcessManagerImpl::Start() {
 void ProcessManagerImpl::Shutdown() {
   shutdown_mutex_.Lock();
   shutdown_initiated_ = true;
+  if (watch_context_ != nullptr) {
+    watch_context_->TryCancel();
+  }
   shutdown_mutex_.Unlock();
   if (worker_thread_.joinable()) {
     worker_thread_.join();
@@ -146,7 +257,20 @@ std::unique_ptr<grpc::ClientContext> ProcessManagerImpl::CreateContext(
 bool IsTrue(bool* var) { return *var; }
 
 void ProcessManagerImpl::WorkerFunction() {
+  // Services that don't implement WatchProcessList yet are polled instead.
+  bool is_watch_implemented = true;
   while (true) {
+    if (is_watch_implemented) {
+      grpc::Status status = WatchProcessList();
+      if (status.error_code() == grpc::StatusCode::UNIMPLEMENTED) {
+        is_watch_implemented = false;
+      } else if (!status.ok() &&
+                 status.error_code() != grpc::StatusCode::CANCELLED) {
+        ERROR("gRPC call to WatchProcessList failed: %s",
+              status.error_message());
+      }
+    }
+
     if (shutdown_mutex_.LockWhenWithTimeout(
             absl::Condition(IsTrue, &shutdown_initiated_), refresh_timeout_)) {
       // Shutdown was initiated we need to exit
@@ -154,27 +278,87 @@ void ProcessManagerImpl::WorkerFunction() {
       return;
     }
     shutdown_mutex_.Unlock();
-    // Timeout expired - refresh the list
-
-    GetProcessListRequest request;
-    GetProcessListResponse response;
-    std::unique_ptr<grpc::ClientContext> context =
-        CreateContext(kGrpcDefaultTimeoutMilliseconds);
-
-    grpc::Status status =
-        process_service_->GetProcessList(context.get(), request, &response);
-    if (!status.ok()) {
-      ERROR("gRPC call to GetProcessList failed: %s", status.error_message());
-      continue;
+    // Timeout expired - refresh the list, or watch it again
+
+    if (!is_watch_implemented) {
+      RefreshProcessList();
+    }
+  }
+}
+
+grpc::Status ProcessManagerImpl::WatchProcessList() {
+  WatchProcessListRequest request;
+  request.set_refresh_interval_ms(absl::ToInt64Milliseconds(refresh_timeout_));
+  // No deadline, as the call lasts until shutdown.
+  grpc::ClientContext context;
+  {
+    absl::MutexLock lock(&shutdown_mutex_);
+    if (shutdown_initiated_) {
+      return grpc::Status::CANCELLED;
+    }
+    watch_context_ = &context;
+  }
+
+  std::unique_ptr<grpc::ClientReader<WatchProcessListResponse>> reader =
+      process_service_->WatchProcessList(&context, request);
+  absl::flat_hash_map<int32_t, ProcessInfo> processes;
+  WatchProcessListResponse response;
+  while (reader->Read(&response)) {
+    for (int32_t pid : response.removed_pids()) {
+      processes.erase(pid);
+    }
+    for (const ProcessInfo& process : response.added_processes()) {
+      processes.insert_or_assign(process.pid(), process);
+    }
+    for (const ProcessCpuUsage& update : response.cpu_usage_updates()) {
+      auto it = processes.find(update.pid());
+      if (it != processes.end()) {
+        it->second.set_cpu_usage(update.cpu_usage());
+      }
     }
 
+    std::vector<ProcessInfo> process_list;
+    process_list.reserve(processes.size());
+    for (const auto& [pid, process] : processes) {
+      process_list.push_back(process);
+    }
+    std::sort(process_list.begin(), process_list.end(),
+              [](const ProcessInfo& a, const ProcessInfo& b) {
+                return a.pid() < b.pid();
+              });
+
     absl::MutexLock callback_lock(&mutex_);
-    const auto& processes = response.processes();
-    process_list_.assign(processes.begin(), processes.end());
+    process_list_ = std::move(process_list);
     if (process_list_update_listener_) {
       process_list_update_listener_(this);
     }
   }
+  grpc::Status status = reader->Finish();
+
+  absl::MutexLock lock(&shutdown_mutex_);
+  watch_context_ = nullptr;
+  return status;
+}
+
+void ProcessManagerImpl::RefreshProcessList() {
+  GetProcessListRequest request;
+  GetProcessListResponse response;
+  std::unique_ptr<grpc::ClientContext> context =
+      CreateContext(kGrpcDefaultTimeoutMilliseconds);
+
+  grpc::Status status =
+      process_service_->GetProcessList(context.get(), request, &response);
+  if (!status.ok()) {
+    ERROR("gRPC call to GetProcessList failed: %s", status.error_message());
+    return;
+  }
+
+  absl::MutexLock callback_lock(&mutex_);
+  const auto& processes = response.processes();
+  process_list_.assign(processes.begin(), processes.end());
+  if (process_list_update_listener_) {
+    process_list_update_listener_(this);
+  }
 }
 
 ErrorMessageOr<std::string> ProcessManagerImpl::LoadProcessMemory(
@@ -199,13 +383,55 @@ ErrorMessageOr<std::string> ProcessManagerImpl::LoadProcessMemory(
   return std::move(*response.mutable_memory());
 }
 
+ErrorMessageOr<std::vector<std::string>>
+ProcessManagerImpl::LoadProcessMemoryRanges(
+    int32_t pid, const std::vector<MemoryRange>& ranges) {
+  ReadProcessMemoryRangesRequest request;
+  request.set_pid(pid);
+  uint64_t total_size = 0;
+  for (const MemoryRange& range : ranges) {
+    ::MemoryRange* request_range = request.add_ranges();
+    request_range->set_address(range.address);
+    request_range->set_size(range.size);
+    total_size += range.size;
+  }
+
+  std::unique_ptr<grpc::ClientContext> context =
+      CreateContext(kGrpcDefaultTimeoutMilliseconds *
+                    (1 + total_size / kBytesPerGrpcDefaultTimeout));
+  std::unique_ptr<grpc::ClientReader<ReadProcessMemoryRangesResponse>> reader =
+      bulk_process_service_->ReadProcessMemoryRanges(context.get(), request);
+
+  std::vector<std::string> memories(ranges.size());
+  ReadProcessMemoryRangesResponse response;
+  while (reader->Read(&response)) {
+    for (RangeMemory& range_memory : *response.mutable_ranges()) {
+      if (range_memory.range_index() < memories.size()) {
+        memories[range_memory.range_index()] =
+            std::move(*range_memory.mutable_memory());
+      }
+    }
+  }
+
+  grpc::Status status = reader->Finish();
+  if (!status.ok()) {
+    ERROR("gRPC call to ReadProcessMemoryRanges failed: %s",
+          status.error_message());
+    return ErrorMessage(status.error_message());
+  }
+
+  return memories;
+}
+
 }  // namespace
 
 std::unique_ptr<ProcessManager> ProcessManager::Create(
     const std::shared_ptr<grpc::Channel>& channel,
-    absl::Duration refresh_timeout) {
+    absl::Duration refresh_timeout,
+    const std::shared_ptr<grpc::Channel>& bulk_channel) {
   std::unique_ptr<ProcessManagerImpl> impl =
-      std::make_unique<ProcessManagerImpl>(channel, refresh_timeout);
+      std::make_unique<ProcessManagerImpl>(channel, refresh_timeout,
+                                           bulk_channel);
   impl->Start();
   return impl;
 }
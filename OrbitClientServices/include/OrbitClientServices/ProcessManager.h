@@ -8,6 +8,7 @@
 #include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "OrbitBase/Result.h"
 #include "absl/synchronization/mutex.h"
@@ -17,7 +18,9 @@
 #include "symbol.pb.h"
 
 // This class is responsible for maintaining
-// process list. It periodically updates it
+// process list. It applies the changes that
+// the service streams every refresh_timeout,
+// or polls services that don't stream them,
 // and calls callback to notify listeners when
 // the list is updated.
 //
@@ -44,6 +47,20 @@ class ProcessManager {
   virtual ErrorMessageOr<std::vector<ModuleInfo>> LoadModuleList(
       int32_t pid) = 0;
 
+  struct ModuleListChanges {
+    // Otherwise changed_modules is the whole list.
+    bool is_incremental = false;
+    // The modules that were added or changed since the previous call for the
+    // process.
+    std::vector<ModuleInfo> changed_modules;
+    std::vector<uint64_t> removed_module_address_starts;
+  };
+  // Like LoadModuleList, but only transfers the modules that changed since
+  // the previous call for the process, when the service still has the list it
+  // sent then.
+  virtual ErrorMessageOr<ModuleListChanges> LoadModuleListChanges(
+      int32_t pid) = 0;
+
   // Get a copy of process list.
   virtual std::vector<ProcessInfo> GetProcessList() const = 0;
 
@@ -51,17 +68,36 @@ class ProcessManager {
                                                         uint64_t address,
                                                         uint64_t size) = 0;
 
+  struct MemoryRange {
+    uint64_t address;
+    uint64_t size;
+  };
+  // Reads all ranges with a single call, which saves the round trips of
+  // LoadProcessMemory for each, e.g., when disassembling many functions. The
+  // memory of a range that could only partly be read holds the bytes from its
+  // start that could, and is empty if none could.
+  virtual ErrorMessageOr<std::vector<std::string>> LoadProcessMemoryRanges(
+      int32_t pid, const std::vector<MemoryRange>& ranges) = 0;
+
   virtual ErrorMessageOr<std::string> FindDebugInfoFile(
       const std::string& module_path, const std::string& build_id) = 0;
 
+  // Loads the symbols of a module on the remote, which only transfers them
+  // rather than the debug info file, often much larger.
+  virtual ErrorMessageOr<ModuleSymbols> LoadModuleSymbols(
+      const std::string& module_path, const std::string& build_id) = 0;
+
   // Note that this method waits for the worker thread to stop, which could
   // take up to refresh_timeout.
   virtual void Shutdown() = 0;
 
-  // Create ProcessManager with specified duration
+  // Create ProcessManager with specified duration. The symbols and the
+  // memory ranges, which can be large, are loaded through bulk_channel if it
+  // isn't nullptr, so that they don't hold up the other calls.
   static std::unique_ptr<ProcessManager> Create(
       const std::shared_ptr<grpc::Channel>& channel,
-      absl::Duration refresh_timeout);
+      absl::Duration refresh_timeout,
+      const std::shared_ptr<grpc::Channel>& bulk_channel = nullptr);
 };
 
 #endif  // ORBIT_CLIENT_SERVICES_PROCESS_MANAGER_H_
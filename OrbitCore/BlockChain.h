@@ -5,226 +5,219 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "OrbitBase/Logging.h"
 
 //-----------------------------------------------------------------------------
-template <class T, uint32_t BlockSize>
-struct BlockChain;
-
-//-----------------------------------------------------------------------------
-template <class T, uint32_t Size>
-struct Block {
-  Block(BlockChain<T, Size>* a_Chain, Block<T, Size>* a_Prev)
-      : m_Prev(a_Prev), m_Next(nullptr), m_Chain(a_Chain), m_Size(0) {}
-
-  ~Block() {}
-
-  void Add(const T& a_Item) {
-    if (m_Size == Size) {
-      if (m_Next == nullptr) {
-        m_Next = new Block<T, Size>(m_Chain, this);
-      }
-
-      m_Chain->m_Current = m_Next;
-      ++m_Chain->m_NumBlocks;
-      m_Next->Add(a_Item);
-      return;
-    }
-
-    CHECK(m_Size < Size);
-    m_Data[m_Size] = a_Item;
-    ++m_Size;
-    ++m_Chain->m_NumItems;
+// Iterates over the elements of a BlockChain. It only holds an index, hence it
+// stays valid when elements are added to the chain. Chain is const for const
+// iterators.
+template <class Chain, class T>
+class BlockIterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = std::remove_const_t<T>;
+  using difference_type = std::ptrdiff_t;
+  using pointer = T*;
+  using reference = T&;
+
+  BlockIterator(Chain* chain, uint32_t index) : chain_(chain), index_(index) {}
+
+  T& operator*() const { return (*chain_)[index_]; }
+  T* operator->() const { return &(*chain_)[index_]; }
+
+  bool operator==(const BlockIterator& other) const {
+    return index_ == other.index_;
   }
-
-  Block<T, Size>* m_Prev;
-  Block<T, Size>* m_Next;
-  BlockChain<T, Size>* m_Chain;
-  uint32_t m_Size;
-  T m_Data[Size];
-};
-
-//-----------------------------------------------------------------------------
-template <class T, uint32_t BlockSize>
-struct BlockIterator {
-  BlockIterator(Block<T, BlockSize>* a_Block) : m_Block(a_Block) {
-    m_Index = (m_Block && (m_Block->m_Size > 0)) ? 0 : -1;
-  }
-
-  T& operator*() { return m_Block->m_Data[m_Index]; }
-
   bool operator!=(const BlockIterator& other) const {
-    bool returnValue = m_Index != other.m_Index;
-    return returnValue;
+    return index_ != other.index_;
   }
 
   BlockIterator& operator++() {
-    if (++m_Index == m_Block->m_Size) {
-      if (m_Block->m_Next && m_Block->m_Next->m_Size > 0) {
-        m_Index = 0;
-        m_Block = m_Block->m_Next;
-      } else {
-        m_Index = -1;
-      }
-    }
-
+    ++index_;
     return *this;
   }
 
-  Block<T, BlockSize>* m_Block;
-  uint32_t m_Index;
+ private:
+  Chain* chain_;
+  uint32_t index_;
 };
 
 //-----------------------------------------------------------------------------
+// BlockChain stores its elements in blocks of BlockSize elements. A block is
+// never moved or freed while elements are added, so that pointers to elements
+// stay valid, and adding an element never copies the others. A directory of
+// the blocks gives constant-time access by index. The blocks are also sorted
+// by address, so that the index of an element, and hence its neighbors, is
+// found from its address in logarithmic time.
+// Elements are contiguous within a block, e.g., for them to be passed to
+// OpenGL one block at a time.
 template <class T, uint32_t BlockSize>
-struct BlockChain {
-  BlockChain() : m_NumBlocks(1), m_NumItems(0) {
-    m_Root = m_Current = new Block<T, BlockSize>(this, nullptr);
-  }
+class BlockChain {
+ public:
+  using iterator = BlockIterator<BlockChain, T>;
+  using const_iterator = BlockIterator<const BlockChain, const T>;
 
-  ~BlockChain() {
-    // Find last block in chain
-    while (m_Current->m_Next) m_Current = m_Current->m_Next;
+  BlockChain() = default;
 
-    Block<T, BlockSize>* prev = m_Current;
-    while (prev) {
-      prev = m_Current->m_Prev;
-      delete m_Current;
-      m_Current = prev;
+  void push_back(const T& item) {
+    const uint32_t block_index = num_items_ / BlockSize;
+    if (block_index == blocks_.size()) {
+      AddBlock();
     }
+    blocks_[block_index][num_items_ % BlockSize] = item;
+    ++num_items_;
   }
 
-  void push_back(const T& a_Item) { m_Current->Add(a_Item); }
-
-  void push_back(const T* a_Array, uint32_t a_Num) {
-    for (uint32_t i = 0; i < a_Num; ++i) m_Current->Add(a_Array[i]);
+  void push_back(const T* array, uint32_t num) {
+    for (uint32_t i = 0; i < num; ++i) push_back(array[i]);
   }
 
-  void push_back_n(const T& a_Item, uint32_t a_Num) {
-    for (uint32_t i = 0; i < a_Num; ++i) m_Current->Add(a_Item);
+  void push_back_n(const T& item, uint32_t num) {
+    for (uint32_t i = 0; i < num; ++i) push_back(item);
   }
 
+  // Frees all blocks.
   void clear() {
-    m_Root->m_Size = 0;
-    m_Root->m_Next = nullptr;
-    m_NumItems = 0;
-    m_NumBlocks = 1;
-
-    Block<T, BlockSize>* prev = m_Current;
-    while (prev != m_Root) {
-      prev = m_Current->m_Prev;
-      delete m_Current;
-      m_Current = prev;
-    }
-
-    m_Current = m_Root;
+    blocks_.clear();
+    blocks_by_address_.clear();
+    num_items_ = 0;
   }
 
-  void Reset() {
-    Block<T, BlockSize>* blockPtr = m_Root;
-    while (blockPtr) {
-      blockPtr->m_Size = 0;
-      blockPtr = blockPtr->m_Next;
+  // Like clear, but keeps the blocks to reuse them for the next elements.
+  void Reset() { num_items_ = 0; }
+
+  // Frees the oldest full blocks until at most max_elems elements are left,
+  // but always keeps at least BlockSize + 1 elements. Returns true if some
+  // elements were removed.
+  bool keep(uint32_t max_elems) {
+    max_elems = std::max(BlockSize + 1, max_elems);
+    if (num_items_ <= max_elems) {
+      return false;
     }
 
-    m_NumItems = 0;
-    m_NumBlocks = 1;
-    m_Current = m_Root;
+    const uint32_t num_removed_blocks =
+        (num_items_ - max_elems - 1) / BlockSize + 1;
+    CHECK(num_removed_blocks < GetNumBlocks());
+    RemoveFirstBlocks(num_removed_blocks);
+    return true;
+  }
+
+  // Frees the oldest blocks that only hold elements before index. Unlike
+  // keep, never removes an element at or after index. The elements left move
+  // to the front, i.e., their indices decrease by the number of elements
+  // removed, which is returned.
+  uint32_t DropBlocksBefore(uint32_t index) {
+    const uint32_t num_removed_blocks = std::min(index, num_items_) / BlockSize;
+    if (num_removed_blocks == 0) {
+      return 0;
+    }
+    RemoveFirstBlocks(num_removed_blocks);
+    return num_removed_blocks * BlockSize;
   }
 
-  bool keep(uint32_t a_MaxElems) {
-    bool hasDeleted = false;
-    a_MaxElems = std::max(BlockSize + 1, a_MaxElems);
-
-    while (m_NumItems > a_MaxElems) {
-      --m_NumBlocks;
-      m_NumItems -= BlockSize;
+  uint32_t size() const { return num_items_; }
+  bool empty() const { return num_items_ == 0; }
 
-      m_Root = m_Root->m_Next;
+  T& operator[](uint32_t index) {
+    return blocks_[index / BlockSize][index % BlockSize];
+  }
+  const T& operator[](uint32_t index) const {
+    return blocks_[index / BlockSize][index % BlockSize];
+  }
 
-      CHECK(m_Root->m_Prev);
-      CHECK(m_Root->m_Prev != m_Current);
+  // Returns nullptr if index is out of range.
+  T* at(uint32_t index) {
+    return index < num_items_ ? &(*this)[index] : nullptr;
+  }
 
-      delete m_Root->m_Prev;
-      m_Root->m_Prev = nullptr;
-      hasDeleted = true;
+  T* GetElementAfter(const T* element) {
+    std::optional<uint32_t> index = GetIndexOf(element);
+    if (!index.has_value() || index.value() + 1 >= num_items_) {
+      return nullptr;
     }
-
-    return hasDeleted;
+    return &(*this)[index.value() + 1];
   }
 
-  uint32_t size() const { return m_NumItems; }
-
-  T* SlowAt(uint32_t a_Index) {
-    if (a_Index < m_NumItems && a_Index >= 0) {
-      uint32_t count = 1;
-      Block<T, BlockSize>* block = m_Root;
-      while (count * BlockSize < a_Index && block && block->m_Next) {
-        block = block->m_Next;
-        ++count;
-      }
-
-      uint32_t index = a_Index % BlockSize;
-      return &block->m_Data[index];
+  T* GetElementBefore(const T* element) {
+    std::optional<uint32_t> index = GetIndexOf(element);
+    if (!index.has_value() || index.value() == 0) {
+      return nullptr;
     }
-
-    return nullptr;
-  }
-
-  Block<T, BlockSize>* GetBlockContaining(const T* a_Element) {
-    Block<T, BlockSize>* block = m_Root;
-    while (block) {
-      uint32_t size = block->m_Size;
-      if (size) {
-        T* begin = &block->m_Data[0];
-        T* end = &block->m_Data[size - 1];
-        if (begin <= a_Element && end >= a_Element) {
-          return block;
-        }
-      }
-      block = block->m_Next;
+    return &(*this)[index.value() - 1];
+  }
+
+  // Returns the index of element, if it is an element of this chain.
+  std::optional<uint32_t> GetIndexOf(const T* element) const {
+    auto it = std::upper_bound(
+        blocks_by_address_.begin(), blocks_by_address_.end(), element,
+        [](const T* address, const std::pair<const T*, uint32_t>& block) {
+          return std::less<const T*>{}(address, block.first);
+        });
+    if (it == blocks_by_address_.begin()) {
+      return std::nullopt;
     }
+    --it;
+    const T* block_begin = it->first;
+    if (!std::less<const T*>{}(element, block_begin + BlockSize)) {
+      return std::nullopt;
+    }
+    const uint32_t index = it->second * BlockSize + (element - block_begin);
+    if (index >= num_items_) {
+      return std::nullopt;
+    }
+    return index;
+  }
 
-    return nullptr;
+  // Blocks that contain elements, all full except for the last one.
+  uint32_t GetNumBlocks() const {
+    return (num_items_ + BlockSize - 1) / BlockSize;
+  }
+  const T* GetBlockData(uint32_t block_index) const {
+    return blocks_[block_index].get();
+  }
+  uint32_t GetBlockSize(uint32_t block_index) const {
+    return std::min(BlockSize, num_items_ - block_index * BlockSize);
   }
 
-  T* GetElementAfter(const T* a_Element) {
-    auto block = GetBlockContaining(a_Element);
-    if (block) {
-      T* begin = &block->m_Data[0];
-      uint32_t index = a_Element - begin;
-      if (index < block->m_Size - 1)
-        return &block->m_Data[++index];
-      else if (block->m_Next && block->m_Next->m_Size)
-        return &block->m_Next->m_Data[0];
-    }
-    return nullptr;
-  }
-
-  T* GetElementBefore(const T* a_Element) {
-    auto block = GetBlockContaining(a_Element);
-    if (block) {
-      T* begin = &block->m_Data[0];
-      uint32_t index = a_Element - begin;
-      if (index > 0)
-        return &block->m_Data[--index];
-      else if (block->m_Prev)
-        return &block->m_Prev->m_Data[block->m_Prev->m_Size - 1];
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, num_items_); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, num_items_); }
+
+ private:
+  void RemoveFirstBlocks(uint32_t num_blocks) {
+    blocks_.erase(blocks_.begin(), blocks_.begin() + num_blocks);
+    num_items_ -= num_blocks * BlockSize;
+
+    blocks_by_address_.clear();
+    for (uint32_t i = 0; i < blocks_.size(); ++i) {
+      blocks_by_address_.emplace_back(blocks_[i].get(), i);
     }
-    return nullptr;
+    std::sort(blocks_by_address_.begin(), blocks_by_address_.end());
   }
 
-  BlockIterator<T, BlockSize> begin() {
-    return BlockIterator<T, BlockSize>(m_Root);
-  }
-  BlockIterator<T, BlockSize> end() {
-    return BlockIterator<T, BlockSize>(nullptr);
+  void AddBlock() {
+    blocks_.push_back(std::make_unique<T[]>(BlockSize));
+    std::pair<const T*, uint32_t> block{
+        blocks_.back().get(), static_cast<uint32_t>(blocks_.size() - 1)};
+    blocks_by_address_.insert(
+        std::upper_bound(blocks_by_address_.begin(), blocks_by_address_.end(),
+                         block),
+        block);
   }
 
-  Block<T, BlockSize>* m_Root;
-  Block<T, BlockSize>* m_Current;
-  uint32_t m_NumBlocks;
-  uint32_t m_NumItems;
+  std::vector<std::unique_ptr<T[]>> blocks_;
+  // Pairs of the first element of a block and the index of the block.
+  std::vector<std::pair<const T*, uint32_t>> blocks_by_address_;
+  uint32_t num_items_ = 0;
 };
@@ -5,7 +5,11 @@
 #include <BlockChain.h>
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <iostream>
+#include <optional>
 #include <string>
+#include <vector>
 
 TEST(BlockChain, AddCopyableTypes) {
   const std::string v1 = "hello world";
@@ -36,7 +40,7 @@ TEST(BlockChain, Clear) {
 
   chain.push_back(v2);
   EXPECT_GT(chain.size(), 0);
-  EXPECT_EQ(*chain.SlowAt(0), v2);
+  EXPECT_EQ(*chain.at(0), v2);
 
   // Multi-block test
   for (int i = 0; i < 2000; ++i) {
@@ -53,12 +57,12 @@ TEST(BlockChain, RetrieveCopyableTypes) {
   BlockChain<std::string, 1024> chain;
   chain.push_back(v1);
   chain.push_back(v2);
-  EXPECT_EQ(*chain.SlowAt(0), v1);
-  EXPECT_EQ(*chain.SlowAt(1), v2);
+  EXPECT_EQ(*chain.at(0), v1);
+  EXPECT_EQ(*chain.at(1), v2);
 
   // Expect those types to be copied
-  EXPECT_NE(chain.SlowAt(0), &v1);
-  EXPECT_NE(chain.SlowAt(1), &v2);
+  EXPECT_NE(chain.at(0), &v1);
+  EXPECT_NE(chain.at(1), &v2);
 
   // Multi-block test
   chain.clear();
@@ -66,7 +70,7 @@ TEST(BlockChain, RetrieveCopyableTypes) {
     chain.push_back(i % 2 == 0 ? v1 : v2);
   }
   for (int i = 0; i < 2000; ++i) {
-    EXPECT_EQ(*chain.SlowAt(i), i % 2 == 0 ? v1 : v2);
+    EXPECT_EQ(*chain.at(i), i % 2 == 0 ? v1 : v2);
   }
 }
 
@@ -83,7 +87,7 @@ TEST(BlockChain, ElementIteration) {
   // The original element can't be found - BlockChain manages copies!
   EXPECT_EQ(chain.GetElementAfter(&v1), nullptr);
 
-  int* el = chain.GetElementAfter(chain.SlowAt(0));
+  int* el = chain.GetElementAfter(chain.at(0));
   EXPECT_NE(el, nullptr);
   EXPECT_EQ(*el, v2);
 
@@ -95,7 +99,6 @@ TEST(BlockChain, ElementIteration) {
   ++it;
   EXPECT_EQ(*it, v3);
   ++it;
-  // ... and also only !=, not ==
   EXPECT_FALSE(it != chain.end());
 
   // Test the complete "typical pattern"
@@ -129,40 +132,65 @@ TEST(BlockChain, AddCopyableTypesN) {
 }
 
 // "Reset" works like "clear", except that it does not actually free
-// any memory - it keeps the block's memory, just setting their
-// size to 0
+// any memory - it keeps the blocks and reuses them for the next elements.
 TEST(BlockChain, Reset) {
   BlockChain<int, 1024> chain;
   chain.push_back_n(5, 1024 * 3);
-  EXPECT_GT(chain.size(), 0);
-  Block<int, 1024>* blockPtr[] = {chain.GetBlockContaining(chain.SlowAt(0)),
-                                  nullptr, nullptr};
-  blockPtr[1] = blockPtr[0]->m_Next;
-  blockPtr[2] = blockPtr[1]->m_Next;
+  EXPECT_EQ(chain.GetNumBlocks(), 3);
+  const int* block_data[] = {chain.GetBlockData(0), chain.GetBlockData(1),
+                             chain.GetBlockData(2)};
 
-  // Tests below rely quite a lot on the internals of BlockChain, but this
-  // seems the easiest way to actually test re-usage of the block pointers
   chain.Reset();
   EXPECT_EQ(chain.size(), 0);
-  EXPECT_EQ(blockPtr[0]->m_Size, 0);
-  EXPECT_EQ(blockPtr[1]->m_Size, 0);
-  EXPECT_EQ(blockPtr[2]->m_Size, 0);
+  EXPECT_EQ(chain.GetNumBlocks(), 0);
+  EXPECT_EQ(chain.begin(), chain.end());
 
   chain.push_back_n(10, 1024);
-  EXPECT_GT(chain.size(), 0);
-  EXPECT_EQ(*chain.SlowAt(0), 10);
-  EXPECT_EQ(chain.m_Root, blockPtr[0]);
-  EXPECT_EQ(chain.m_Root->m_Next, blockPtr[1]);
-  EXPECT_EQ(blockPtr[1]->m_Size, 0);
+  EXPECT_EQ(*chain.at(0), 10);
+  EXPECT_EQ(chain.GetNumBlocks(), 1);
+  EXPECT_EQ(chain.GetBlockData(0), block_data[0]);
 
-  chain.push_back_n(10, 1024);
-  EXPECT_EQ(chain.m_Root->m_Next, blockPtr[1]);
-  EXPECT_EQ(blockPtr[1]->m_Size, 1024);
-  EXPECT_EQ(blockPtr[2]->m_Size, 0);
+  chain.push_back_n(10, 1024 + 1);
+  EXPECT_EQ(chain.GetNumBlocks(), 3);
+  EXPECT_EQ(chain.GetBlockData(1), block_data[1]);
+  EXPECT_EQ(chain.GetBlockData(2), block_data[2]);
+  EXPECT_EQ(chain.GetBlockSize(1), 1024);
+  EXPECT_EQ(chain.GetBlockSize(2), 1);
+}
 
-  chain.push_back_n(10, 1024);
-  EXPECT_EQ(chain.m_Root->m_Next->m_Next, blockPtr[2]);
-  EXPECT_EQ(blockPtr[2]->m_Size, 1024);
+TEST(BlockChain, ElementsDontMove) {
+  BlockChain<int, 16> chain;
+  chain.push_back(0);
+  const int* first = chain.at(0);
+  for (int i = 1; i < 1000; ++i) {
+    chain.push_back(i);
+  }
+  EXPECT_EQ(chain.at(0), first);
+  EXPECT_EQ(chain.at(1000), nullptr);
+  for (uint32_t i = 0; i < chain.size(); ++i) {
+    EXPECT_EQ(chain[i], i);
+  }
+}
+
+TEST(BlockChain, NeighborsAcrossBlocks) {
+  BlockChain<int, 16> chain;
+  for (int i = 0; i < 100; ++i) {
+    chain.push_back(i);
+  }
+
+  for (uint32_t i = 0; i < chain.size(); ++i) {
+    EXPECT_EQ(chain.GetIndexOf(chain.at(i)), i);
+  }
+  for (uint32_t i = 0; i + 1 < chain.size(); ++i) {
+    EXPECT_EQ(chain.GetElementAfter(chain.at(i)), chain.at(i + 1));
+    EXPECT_EQ(chain.GetElementBefore(chain.at(i + 1)), chain.at(i));
+  }
+  EXPECT_EQ(chain.GetElementAfter(chain.at(99)), nullptr);
+  EXPECT_EQ(chain.GetElementBefore(chain.at(0)), nullptr);
+
+  // Elements of the last block that are not in use are not found either.
+  const int* unused = chain.at(99) + 1;
+  EXPECT_EQ(chain.GetIndexOf(unused), std::nullopt);
 }
 
 TEST(BlockChain, keep) {
@@ -183,6 +211,99 @@ TEST(BlockChain, keep) {
   chain.keep(10);
   EXPECT_EQ(chain.size(), 2000 - 1024);
   for (int i = 0; i < chain.size(); ++i) {
-    EXPECT_EQ(*chain.SlowAt(i), i + 1024);
+    EXPECT_EQ(*chain.at(i), i + 1024);
+  }
+}
+
+TEST(BlockChain, DropBlocksBefore) {
+  BlockChain<int, 16> chain;
+  for (int i = 0; i < 100; ++i) {
+    chain.push_back(i);
+  }
+  // Only the blocks entirely before the index are removed.
+  EXPECT_EQ(chain.DropBlocksBefore(15), 0);
+  EXPECT_EQ(chain.DropBlocksBefore(40), 32);
+  EXPECT_EQ(chain.size(), 68);
+  for (uint32_t i = 0; i < chain.size(); ++i) {
+    EXPECT_EQ(*chain.at(i), i + 32);
+  }
+  EXPECT_EQ(chain.GetIndexOf(chain.at(20)), 20);
+
+  // All blocks can be removed, the chain is then filled again.
+  EXPECT_EQ(chain.DropBlocksBefore(1000), 64);
+  EXPECT_EQ(chain.size(), 4);
+  chain.clear();
+  EXPECT_EQ(chain.DropBlocksBefore(16), 0);
+  for (int i = 0; i < 32; ++i) {
+    chain.push_back(i);
+  }
+  EXPECT_EQ(chain.DropBlocksBefore(32), 32);
+  EXPECT_TRUE(chain.empty());
+  chain.push_back(7);
+  EXPECT_EQ(*chain.at(0), 7);
+}
+
+TEST(BlockChain, ConstIteration) {
+  BlockChain<int, 16> chain;
+  for (int i = 0; i < 100; ++i) {
+    chain.push_back(i);
+  }
+  const BlockChain<int, 16>& const_chain = chain;
+  int sum = 0;
+  for (const int& value : const_chain) {
+    sum += value;
+  }
+  EXPECT_EQ(sum, 99 * 100 / 2);
+}
+
+namespace {
+
+template <typename F>
+void PrintDuration(const std::string& name, F&& function) {
+  auto start = std::chrono::steady_clock::now();
+  function();
+  auto duration = std::chrono::steady_clock::now() - start;
+  std::cout << name << " in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+                   .count()
+            << " ms" << std::endl;
+}
+
+}  // namespace
+
+TEST(BlockChain, DISABLED_Benchmark) {
+  constexpr uint32_t kElementCount = 10'000'000;
+  constexpr uint32_t kLookupCount = 1'000'000;
+  BlockChain<uint64_t, 16 * 1024> chain;
+
+  PrintDuration("Appended " + std::to_string(kElementCount) + " elements",
+                [&] {
+                  for (uint64_t i = 0; i < kElementCount; ++i) {
+                    chain.push_back(i);
+                  }
+                });
+
+  uint64_t sum = 0;
+  PrintDuration("Iterated over " + std::to_string(kElementCount) + " elements",
+                [&] {
+                  for (uint64_t value : chain) {
+                    sum += value;
+                  }
+                });
+  EXPECT_EQ(sum, uint64_t{kElementCount} * (kElementCount - 1) / 2);
+
+  std::vector<const uint64_t*> elements;
+  for (uint32_t i = 0; i < kLookupCount; ++i) {
+    elements.push_back(chain.at((i * 7919ULL) % kElementCount));
   }
+  uint32_t found = 0;
+  PrintDuration("Looked up the neighbors of " + std::to_string(kLookupCount) +
+                    " elements",
+                [&] {
+                  for (const uint64_t* element : elements) {
+                    found += chain.GetElementAfter(element) != nullptr;
+                    found += chain.GetElementBefore(element) != nullptr;
+                  }
+                });
+  EXPECT_GT(found, kLookupCount);
 }
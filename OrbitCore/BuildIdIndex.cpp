@@ -0,0 +1,186 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "BuildIdIndex.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <system_error>
+
+#include "ElfUtils/ElfFile.h"
+#include "OrbitBase/Logging.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+
+namespace {
+
+using ::ElfUtils::ElfFile;
+
+// Empty for the files that are not ELF files, or have no symbols.
+std::string ReadBuildIdIfHasSymbols(const std::string& file_path) {
+  ErrorMessageOr<std::unique_ptr<ElfFile>> elf_file =
+      ElfFile::Create(file_path);
+  if (!elf_file || !elf_file.value()->HasSymtab()) return "";
+  return elf_file.value()->GetBuildId();
+}
+
+}  // namespace
+
+bool BuildIdIndex::Refresh() {
+  bool changed = false;
+  for (const std::string& directory : directories_) {
+    changed |= RefreshDirectory(directory);
+  }
+  if (changed) UpdatePathsByBuildId();
+  return changed;
+}
+
+bool BuildIdIndex::RefreshDirectory(const std::string& directory) {
+  std::error_code error;
+  const int64_t modification_time =
+      std::filesystem::last_write_time(directory, error)
+          .time_since_epoch()
+          .count();
+  if (error) {
+    directory_modification_times_.erase(directory);
+    return files_by_directory_.erase(directory) > 0;
+  }
+  auto time_it = directory_modification_times_.find(directory);
+  if (time_it != directory_modification_times_.end() &&
+      time_it->second == modification_time) {
+    return false;
+  }
+
+  // The modification time is read before listing, so that a file added
+  // meanwhile is found on the next refresh.
+  std::map<std::string, File>& files = files_by_directory_[directory];
+  std::map<std::string, File> listed_files;
+  bool changed = false;
+  for (std::filesystem::directory_iterator it(directory, error), end;
+       !error && it != end; it.increment(error)) {
+    std::error_code file_error;
+    if (!it->is_regular_file(file_error)) continue;
+    File file;
+    file.size = it->file_size(file_error);
+    file.modification_time =
+        it->last_write_time(file_error).time_since_epoch().count();
+    if (file_error) continue;
+
+    std::string file_path = it->path().string();
+    auto file_it = files.find(file_path);
+    if (file_it != files.end() && file_it->second.size == file.size &&
+        file_it->second.modification_time == file.modification_time) {
+      file.build_id = std::move(file_it->second.build_id);
+    } else {
+      file.build_id = ReadBuildIdIfHasSymbols(file_path);
+      changed = true;
+    }
+    listed_files.emplace(std::move(file_path), std::move(file));
+  }
+  if (error) {
+    ERROR("Listing symbols directory \"%s\": %s", directory, error.message());
+    return false;
+  }
+
+  // Without new or changed files, a different count means removed files.
+  changed |= listed_files.size() != files.size();
+  files = std::move(listed_files);
+  directory_modification_times_[directory] = modification_time;
+  return changed;
+}
+
+void BuildIdIndex::Invalidate(const std::string& file_path) {
+  for (auto& [directory, files] : files_by_directory_) {
+    if (files.erase(file_path) > 0) {
+      directory_modification_times_.erase(directory);
+      UpdatePathsByBuildId();
+      return;
+    }
+  }
+}
+
+void BuildIdIndex::UpdatePathsByBuildId() {
+  paths_by_build_id_.clear();
+  for (const std::string& directory : directories_) {
+    auto files_it = files_by_directory_.find(directory);
+    if (files_it == files_by_directory_.end()) continue;
+    for (const auto& [file_path, file] : files_it->second) {
+      if (file.build_id.empty()) continue;
+      paths_by_build_id_.try_emplace(file.build_id, file_path);
+    }
+  }
+}
+
+std::optional<std::string> BuildIdIndex::Find(
+    const std::string& build_id) const {
+  auto it = paths_by_build_id_.find(build_id);
+  if (it == paths_by_build_id_.end()) return std::nullopt;
+  return it->second;
+}
+
+size_t BuildIdIndex::GetFileCount() const {
+  size_t count = 0;
+  for (const auto& [directory, files] : files_by_directory_) {
+    count += files.size();
+  }
+  return count;
+}
+
+// One line per file: directory, path, size, modification time and build id,
+// separated by tabs.
+ErrorMessageOr<void> BuildIdIndex::Save(const std::string& file_path) const {
+  std::ofstream file(file_path, std::ios::trunc);
+  if (file.fail()) {
+    return ErrorMessage(absl::StrFormat(
+        "Unable to open build id index \"%s\" for writing", file_path));
+  }
+  for (const auto& [directory, files] : files_by_directory_) {
+    for (const auto& [path, indexed_file] : files) {
+      file << absl::StrFormat("%s\t%s\t%u\t%d\t%s\n", directory, path,
+                              indexed_file.size, indexed_file.modification_time,
+                              indexed_file.build_id);
+    }
+  }
+  file.close();
+  if (file.fail()) {
+    return ErrorMessage(
+        absl::StrFormat("Unable to write build id index \"%s\"", file_path));
+  }
+  return outcome::success();
+}
+
+ErrorMessageOr<void> BuildIdIndex::Load(const std::string& file_path) {
+  std::ifstream file(file_path);
+  if (file.fail()) {
+    return ErrorMessage(absl::StrFormat(
+        "Unable to open build id index \"%s\" for reading", file_path));
+  }
+  directory_modification_times_.clear();
+  files_by_directory_.clear();
+  std::string line;
+  while (std::getline(file, line)) {
+    std::vector<std::string> fields = absl::StrSplit(line, '\t');
+    File indexed_file;
+    if (fields.size() != 5 ||
+        !absl::SimpleAtoi(fields[2], &indexed_file.size) ||
+        !absl::SimpleAtoi(fields[3], &indexed_file.modification_time)) {
+      files_by_directory_.clear();
+      return ErrorMessage(
+          absl::StrFormat("Invalid build id index \"%s\"", file_path));
+    }
+    // The directories that are no longer configured are dropped.
+    if (std::find(directories_.begin(), directories_.end(), fields[0]) ==
+        directories_.end()) {
+      continue;
+    }
+    indexed_file.build_id = std::move(fields[4]);
+    files_by_directory_[fields[0]].emplace(std::move(fields[1]),
+                                           std::move(indexed_file));
+  }
+  UpdatePathsByBuildId();
+  return outcome::success();
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_BUILD_ID_INDEX_H_
+#define ORBIT_CORE_BUILD_ID_INDEX_H_
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "OrbitBase/Result.h"
+#include "absl/container/flat_hash_map.h"
+
+// The paths of the ELF files with symbols in a list of directories, not
+// recursively, by build id, so that finding the symbols file of a module is
+// one lookup instead of opening the candidate files.
+//
+// Refresh is incremental: a directory is only listed again when its
+// modification time changed, and a file is only opened again when its size or
+// modification time changed. The index can be saved and loaded, so that a new
+// session only opens the files that changed since the previous one.
+class BuildIdIndex {
+ public:
+  explicit BuildIdIndex(std::vector<std::string> directories)
+      : directories_(std::move(directories)) {}
+
+  // Returns whether any file was added, changed or removed.
+  bool Refresh();
+  // To call when the file found for a build id turned out not to match it:
+  // the directory of the file is listed again on the next Refresh.
+  void Invalidate(const std::string& file_path);
+
+  [[nodiscard]] std::optional<std::string> Find(
+      const std::string& build_id) const;
+  [[nodiscard]] size_t GetFileCount() const;
+
+  // The directories are listed again on the first Refresh after Load, but the
+  // files that didn't change are not opened.
+  [[nodiscard]] ErrorMessageOr<void> Save(const std::string& file_path) const;
+  [[nodiscard]] ErrorMessageOr<void> Load(const std::string& file_path);
+
+ private:
+  struct File {
+    uint64_t size = 0;
+    int64_t modification_time = 0;
+    // Empty for the files without symbols or without build id, which are
+    // kept so that they are not opened again.
+    std::string build_id;
+  };
+
+  // Returns whether any file was added, changed or removed.
+  bool RefreshDirectory(const std::string& directory);
+  void UpdatePathsByBuildId();
+
+  const std::vector<std::string> directories_;
+  // Only for the directories listed since the last Load.
+  absl::flat_hash_map<std::string, int64_t> directory_modification_times_;
+  // By directory, then by file path.
+  absl::flat_hash_map<std::string, std::map<std::string, File>>
+      files_by_directory_;
+  // The first file in the order of directories_ and then of the paths, as
+  // the build id of a module can be in several of them.
+  absl::flat_hash_map<std::string, std::string> paths_by_build_id_;
+};
+
+#endif  // ORBIT_CORE_BUILD_ID_INDEX_H_
@@ -0,0 +1,104 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include "BuildIdIndex.h"
+#include "Path.h"
+
+namespace {
+
+const std::string kHelloWorldBuildId =
+    "d12d54bc5b72ccce54a408bdeda65e2530740ac8";
+const std::string kNoSymbolsBuildId =
+    "b5413574bbacec6eacb3b89b1012d0e2cd92ec6b";
+
+// A copy of some of the test data, which the tests modify.
+std::string CreateSymbolsDirectory(const std::string& name) {
+  const std::string testdata_directory =
+      Path::JoinPath({Path::GetExecutablePath(), "testdata"});
+  const std::string directory =
+      (std::filesystem::temp_directory_path() / name).string();
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directory(directory);
+  for (const char* file_name :
+       {"hello_world_elf", "no_symbols_elf", "no_symbols_elf.debug"}) {
+    std::filesystem::copy_file(Path::JoinPath({testdata_directory, file_name}),
+                               Path::JoinPath({directory, file_name}));
+  }
+  return directory;
+}
+
+}  // namespace
+
+TEST(BuildIdIndex, FindsFilesWithSymbols) {
+  const std::string directory = CreateSymbolsDirectory("BuildIdIndexTest");
+  BuildIdIndex index({directory});
+  EXPECT_FALSE(index.Find(kHelloWorldBuildId).has_value());
+
+  EXPECT_TRUE(index.Refresh());
+  EXPECT_EQ(index.GetFileCount(), 3);
+  EXPECT_EQ(index.Find(kHelloWorldBuildId),
+            Path::JoinPath({directory, "hello_world_elf"}));
+  // no_symbols_elf has the same build id, but no symbols.
+  EXPECT_EQ(index.Find(kNoSymbolsBuildId),
+            Path::JoinPath({directory, "no_symbols_elf.debug"}));
+  EXPECT_FALSE(index.Find("invalid_build_id").has_value());
+  EXPECT_FALSE(index.Refresh());
+
+  std::filesystem::remove(Path::JoinPath({directory, "hello_world_elf"}));
+  EXPECT_TRUE(index.Refresh());
+  EXPECT_FALSE(index.Find(kHelloWorldBuildId).has_value());
+  EXPECT_EQ(index.GetFileCount(), 2);
+
+  std::filesystem::remove_all(directory);
+}
+
+TEST(BuildIdIndex, SaveAndLoad) {
+  const std::string directory = CreateSymbolsDirectory("BuildIdIndexSaveTest");
+  const std::string index_file_path =
+      (std::filesystem::temp_directory_path() / "BuildIdIndexSaveTest.txt")
+          .string();
+  BuildIdIndex index({directory});
+  EXPECT_TRUE(index.Refresh());
+  auto save_result = index.Save(index_file_path);
+  ASSERT_TRUE(save_result) << save_result.error().message();
+
+  BuildIdIndex loaded_index({directory});
+  auto load_result = loaded_index.Load(index_file_path);
+  ASSERT_TRUE(load_result) << load_result.error().message();
+  EXPECT_EQ(loaded_index.GetFileCount(), 3);
+  EXPECT_EQ(loaded_index.Find(kNoSymbolsBuildId),
+            Path::JoinPath({directory, "no_symbols_elf.debug"}));
+  // The files didn't change since the index was saved.
+  EXPECT_FALSE(loaded_index.Refresh());
+
+  // The files of the directories that are no longer configured are dropped.
+  BuildIdIndex other_index({"/some/other/directory"});
+  load_result = other_index.Load(index_file_path);
+  ASSERT_TRUE(load_result) << load_result.error().message();
+  EXPECT_EQ(other_index.GetFileCount(), 0);
+
+  std::filesystem::remove(index_file_path);
+  std::filesystem::remove_all(directory);
+}
+
+TEST(BuildIdIndex, Invalidate) {
+  const std::string directory =
+      CreateSymbolsDirectory("BuildIdIndexInvalidateTest");
+  BuildIdIndex index({directory});
+  EXPECT_TRUE(index.Refresh());
+
+  const std::string file_path = Path::JoinPath({directory, "hello_world_elf"});
+  index.Invalidate(file_path);
+  EXPECT_FALSE(index.Find(kHelloWorldBuildId).has_value());
+  EXPECT_TRUE(index.Refresh());
+  EXPECT_EQ(index.Find(kHelloWorldBuildId), file_path);
+
+  std::filesystem::remove_all(directory);
+}
@@ -16,9 +16,14 @@ struct CallStack {
   CallStack() = default;
   inline CallstackID Hash() {
     if (m_Hash != 0) return m_Hash;
-    m_Hash = XXH64(m_Data.data(), m_Data.size() * sizeof(uint64_t), 0xca1157ac);
+    m_Hash = ComputeHash(m_Data.data(), m_Data.size());
     return m_Hash;
   }
+  // What Hash returns for the callstack of these pcs, without creating it.
+  [[nodiscard]] static inline CallstackID ComputeHash(const uint64_t* pcs,
+                                                      size_t size) {
+    return XXH64(pcs, size * sizeof(uint64_t), 0xca1157ac);
+  }
 
   CallstackID m_Hash = 0;
   std::vector<uint64_t> m_Data;
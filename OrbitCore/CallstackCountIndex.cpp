@@ -0,0 +1,165 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "CallstackCountIndex.h"
+
+#include <algorithm>
+
+using orbit_client_protos::CallstackEvent;
+
+namespace {
+
+constexpr size_t kMinCheckpointInterval = 1024;
+
+size_t RoundUpToPowerOfTwo(size_t value) {
+  size_t result = 1;
+  while (result < value) {
+    result *= 2;
+  }
+  return result;
+}
+
+}  // namespace
+
+void CallstackCountIndex::AddCallstackEvent(const CallstackEvent& event) {
+  AddSample(&threads_[kAllThreadsId], event.time(), event.callstack_hash());
+  if (event.thread_id() != kAllThreadsId) {
+    AddSample(&threads_[event.thread_id()], event.time(),
+              event.callstack_hash());
+  }
+}
+
+std::vector<ThreadID> CallstackCountIndex::GetThreadIds() const {
+  std::vector<ThreadID> thread_ids;
+  for (const auto& thread : threads_) {
+    if (thread.first != kAllThreadsId) {
+      thread_ids.push_back(thread.first);
+    }
+  }
+  std::sort(thread_ids.begin(), thread_ids.end());
+  return thread_ids;
+}
+
+absl::flat_hash_map<CallstackID, uint32_t>
+CallstackCountIndex::GetCallstackCounts(ThreadID thread_id, uint64_t min_time,
+                                        uint64_t max_time) {
+  absl::flat_hash_map<CallstackID, uint32_t> counts;
+  auto thread_it = threads_.find(thread_id);
+  if (thread_it == threads_.end() || min_time >= max_time) {
+    return counts;
+  }
+  ThreadIndex& thread_index = thread_it->second;
+  UpdateCheckpoints(&thread_index);
+
+  const std::vector<Sample>& samples = thread_index.samples;
+  auto is_before = [](const Sample& sample, uint64_t time) {
+    return sample.time < time;
+  };
+  const size_t begin =
+      std::lower_bound(samples.begin(), samples.end(), min_time, is_before) -
+      samples.begin();
+  const size_t end =
+      std::lower_bound(samples.begin() + begin, samples.end(), max_time,
+                       is_before) -
+      samples.begin();
+  auto count_samples = [&](size_t from, size_t to) {
+    for (size_t i = from; i < to; ++i) {
+      ++counts[thread_index.callstack_ids[samples[i].callstack_index]];
+    }
+  };
+
+  const size_t interval = thread_index.checkpoint_interval;
+  const size_t first_checkpoint = (begin + interval - 1) / interval;
+  const size_t last_checkpoint = end / interval;
+  if (first_checkpoint >= last_checkpoint) {
+    count_samples(begin, end);
+    return counts;
+  }
+
+  auto get_checkpoint = [&thread_index](size_t checkpoint) {
+    const std::vector<size_t>& offsets = thread_index.checkpoint_offsets;
+    const size_t checkpoint_end = checkpoint + 1 < offsets.size()
+                                      ? offsets[checkpoint + 1]
+                                      : thread_index.checkpoint_counts.size();
+    return std::make_pair(
+        thread_index.checkpoint_counts.data() + offsets[checkpoint],
+        checkpoint_end - offsets[checkpoint]);
+  };
+  const auto [first_counts, first_size] = get_checkpoint(first_checkpoint);
+  const auto [last_counts, last_size] = get_checkpoint(last_checkpoint);
+  for (size_t i = 0; i < last_size; ++i) {
+    const uint32_t count =
+        last_counts[i] - (i < first_size ? first_counts[i] : 0);
+    if (count > 0) {
+      counts[thread_index.callstack_ids[i]] = count;
+    }
+  }
+  count_samples(begin, first_checkpoint * interval);
+  count_samples(last_checkpoint * interval, end);
+  return counts;
+}
+
+void CallstackCountIndex::AddSample(ThreadIndex* thread_index, uint64_t time,
+                                    CallstackID callstack_id) {
+  auto [it, inserted] = thread_index->callstack_indices.try_emplace(
+      callstack_id, thread_index->callstack_ids.size());
+  if (inserted) {
+    thread_index->callstack_ids.push_back(callstack_id);
+  }
+  if (!thread_index->samples.empty() &&
+      time < thread_index->samples.back().time) {
+    thread_index->samples_sorted = false;
+  }
+  thread_index->samples.push_back({time, it->second});
+}
+
+void CallstackCountIndex::UpdateCheckpoints(ThreadIndex* thread_index) {
+  std::vector<size_t>& offsets = thread_index->checkpoint_offsets;
+  std::vector<uint32_t>& checkpoint_counts = thread_index->checkpoint_counts;
+  std::vector<Sample>& samples = thread_index->samples;
+
+  if (!thread_index->samples_sorted) {
+    std::stable_sort(samples.begin(), samples.end(),
+                     [](const Sample& a, const Sample& b) {
+                       return a.time < b.time;
+                     });
+    thread_index->samples_sorted = true;
+    offsets.clear();
+    checkpoint_counts.clear();
+  }
+
+  // With at least as many samples between checkpoints as there are
+  // callstacks, the checkpoints don't take more memory than the samples.
+  const size_t interval = std::max(
+      kMinCheckpointInterval,
+      RoundUpToPowerOfTwo(thread_index->callstack_ids.size()));
+  if (interval != thread_index->checkpoint_interval) {
+    thread_index->checkpoint_interval = interval;
+    offsets.clear();
+    checkpoint_counts.clear();
+  }
+  if (offsets.empty()) {
+    offsets.push_back(0);
+  }
+
+  // Continue from the last checkpoint made, which might be of fewer
+  // callstacks.
+  const size_t checkpoint_count = samples.size() / interval + 1;
+  if (offsets.size() == checkpoint_count) {
+    return;
+  }
+  std::vector<uint32_t> counts(checkpoint_counts.begin() + offsets.back(),
+                               checkpoint_counts.end());
+  counts.resize(thread_index->callstack_ids.size(), 0);
+  for (size_t checkpoint = offsets.size(); checkpoint < checkpoint_count;
+       ++checkpoint) {
+    for (size_t i = (checkpoint - 1) * interval; i < checkpoint * interval;
+         ++i) {
+      ++counts[samples[i].callstack_index];
+    }
+    offsets.push_back(checkpoint_counts.size());
+    checkpoint_counts.insert(checkpoint_counts.end(), counts.begin(),
+                             counts.end());
+  }
+}
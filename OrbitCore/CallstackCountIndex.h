@@ -0,0 +1,69 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_CALLSTACK_COUNT_INDEX_H_
+#define ORBIT_CORE_CALLSTACK_COUNT_INDEX_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "Callstack.h"
+#include "absl/container/flat_hash_map.h"
+#include "capture_data.pb.h"
+
+// Counts the samples of each callstack of a thread in any time range, in time
+// proportional to the number of different callstacks of the thread rather
+// than to the number of samples in the range, so that the report of a
+// selection can follow the mouse.
+//
+// The samples of each thread are kept sorted by time, with checkpoints of the
+// cumulative count of each callstack every so many samples. The counts of a
+// range are the difference of the checkpoints inside it, plus the few samples
+// between the checkpoints and the ends of the range.
+//
+// As in EventBuffer, the samples of all threads are also indexed together as
+// those of thread 0.
+class CallstackCountIndex {
+ public:
+  static constexpr ThreadID kAllThreadsId = 0;
+
+  void AddCallstackEvent(const orbit_client_protos::CallstackEvent& event);
+  void Clear() { threads_.clear(); }
+
+  // The ids of the threads with samples, without kAllThreadsId.
+  [[nodiscard]] std::vector<ThreadID> GetThreadIds() const;
+
+  // The number of samples of each callstack of the thread between min_time
+  // included and max_time excluded.
+  [[nodiscard]] absl::flat_hash_map<CallstackID, uint32_t> GetCallstackCounts(
+      ThreadID thread_id, uint64_t min_time, uint64_t max_time);
+
+ private:
+  struct Sample {
+    uint64_t time;
+    uint32_t callstack_index;
+  };
+
+  struct ThreadIndex {
+    std::vector<CallstackID> callstack_ids;
+    absl::flat_hash_map<CallstackID, uint32_t> callstack_indices;
+    std::vector<Sample> samples;
+    bool samples_sorted = true;
+
+    // Checkpoint i holds the counts of samples [0, i * checkpoint_interval)
+    // of the callstacks known when it was made, from
+    // checkpoint_offsets[i] in checkpoint_counts.
+    size_t checkpoint_interval = 0;
+    std::vector<size_t> checkpoint_offsets;
+    std::vector<uint32_t> checkpoint_counts;
+  };
+
+  static void AddSample(ThreadIndex* thread_index, uint64_t time,
+                        CallstackID callstack_id);
+  static void UpdateCheckpoints(ThreadIndex* thread_index);
+
+  absl::flat_hash_map<ThreadID, ThreadIndex> threads_;
+};
+
+#endif  // ORBIT_CORE_CALLSTACK_COUNT_INDEX_H_
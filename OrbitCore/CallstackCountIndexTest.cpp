@@ -0,0 +1,107 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "CallstackCountIndex.h"
+#include "capture_data.pb.h"
+
+using orbit_client_protos::CallstackEvent;
+
+namespace {
+
+CallstackEvent CreateEvent(uint64_t time, CallstackID callstack_id,
+                           ThreadID thread_id) {
+  CallstackEvent event;
+  event.set_time(time);
+  event.set_callstack_hash(callstack_id);
+  event.set_thread_id(thread_id);
+  return event;
+}
+
+absl::flat_hash_map<CallstackID, uint32_t> CountEvents(
+    const std::vector<CallstackEvent>& events, ThreadID thread_id,
+    uint64_t min_time, uint64_t max_time) {
+  absl::flat_hash_map<CallstackID, uint32_t> counts;
+  for (const CallstackEvent& event : events) {
+    if ((thread_id == CallstackCountIndex::kAllThreadsId ||
+         event.thread_id() == thread_id) &&
+        event.time() >= min_time && event.time() < max_time) {
+      ++counts[event.callstack_hash()];
+    }
+  }
+  return counts;
+}
+
+}  // namespace
+
+TEST(CallstackCountIndex, Empty) {
+  CallstackCountIndex index;
+  EXPECT_TRUE(index.GetThreadIds().empty());
+  EXPECT_TRUE(index.GetCallstackCounts(0, 0, 100).empty());
+}
+
+TEST(CallstackCountIndex, SmallRanges) {
+  CallstackCountIndex index;
+  index.AddCallstackEvent(CreateEvent(10, 1, 42));
+  index.AddCallstackEvent(CreateEvent(20, 2, 42));
+  index.AddCallstackEvent(CreateEvent(30, 1, 43));
+  index.AddCallstackEvent(CreateEvent(40, 1, 42));
+
+  EXPECT_EQ(index.GetThreadIds(), (std::vector<ThreadID>{42, 43}));
+
+  auto counts = index.GetCallstackCounts(42, 10, 40);
+  EXPECT_EQ(counts.size(), 2);
+  EXPECT_EQ(counts[1], 1);
+  EXPECT_EQ(counts[2], 1);
+
+  counts = index.GetCallstackCounts(CallstackCountIndex::kAllThreadsId, 0,
+                                    100);
+  EXPECT_EQ(counts.size(), 2);
+  EXPECT_EQ(counts[1], 3);
+  EXPECT_EQ(counts[2], 1);
+
+  EXPECT_TRUE(index.GetCallstackCounts(43, 31, 100).empty());
+  EXPECT_TRUE(index.GetCallstackCounts(44, 0, 100).empty());
+  EXPECT_TRUE(index.GetCallstackCounts(42, 40, 40).empty());
+}
+
+TEST(CallstackCountIndex, MatchesCountingEvents) {
+  std::mt19937_64 random(42);
+  std::vector<CallstackEvent> events;
+  CallstackCountIndex index;
+  uint64_t time = 1000;
+  auto add_events = [&](size_t count, size_t callstack_count) {
+    for (size_t i = 0; i < count; ++i) {
+      // Mostly, but not always, in order of time.
+      time += random() % 100;
+      const uint64_t event_time = random() % 50 == 0 ? time - 500 : time;
+      events.push_back(CreateEvent(event_time, random() % callstack_count,
+                                   static_cast<ThreadID>(1 + random() % 3)));
+      index.AddCallstackEvent(events.back());
+    }
+  };
+  auto check_ranges = [&] {
+    for (int i = 0; i < 50; ++i) {
+      uint64_t min_time = random() % (time + 1000);
+      uint64_t max_time = random() % (time + 1000);
+      if (min_time > max_time) {
+        std::swap(min_time, max_time);
+      }
+      for (ThreadID thread_id : {0, 1, 2, 3}) {
+        EXPECT_EQ(index.GetCallstackCounts(thread_id, min_time, max_time),
+                  CountEvents(events, thread_id, min_time, max_time));
+      }
+    }
+  };
+
+  add_events(20'000, 100);
+  check_ranges();
+  // New callstacks and more samples after the checkpoints were made.
+  add_events(10'000, 3'000);
+  check_ranges();
+}
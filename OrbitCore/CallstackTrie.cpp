@@ -0,0 +1,33 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "CallstackTrie.h"
+
+CallstackTrie::NodeId CallstackTrie::Insert(const uint64_t* pcs,
+                                            size_t size) {
+  NodeId id = kRootId;
+  for (size_t i = size; i > 0; --i) {
+    const uint64_t pc = pcs[i - 1];
+    auto [it, inserted] = children_.try_emplace(
+        std::make_pair(id, pc), static_cast<NodeId>(nodes_.size()));
+    if (inserted) {
+      nodes_.push_back({pc, id, nodes_[id].depth + 1});
+    }
+    id = it->second;
+  }
+  return id;
+}
+
+std::vector<uint64_t> CallstackTrie::GetPcs(NodeId id) const {
+  std::vector<uint64_t> pcs;
+  pcs.reserve(nodes_[id].depth);
+  ForEachPc(id, [&pcs](uint64_t pc) { pcs.push_back(pc); });
+  return pcs;
+}
+
+void CallstackTrie::Clear() {
+  nodes_.clear();
+  children_.clear();
+  nodes_.push_back({0, kRootId, 0});
+}
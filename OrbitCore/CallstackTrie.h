@@ -0,0 +1,68 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_CALLSTACK_TRIE_H_
+#define ORBIT_CORE_CALLSTACK_TRIE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "OrbitBase/Logging.h"
+#include "absl/container/flat_hash_map.h"
+
+// Stores callstacks as the paths from the root of a trie of frames, so that
+// callstacks sharing their outermost frames, e.g., from main through the
+// engine loop, share the nodes of these frames. Each node is only a pc and
+// the id of the node of its caller, a callstack is the id of the node of its
+// innermost frame.
+class CallstackTrie {
+ public:
+  using NodeId = uint32_t;
+  // The empty callstack.
+  static constexpr NodeId kRootId = 0;
+
+  CallstackTrie() { Clear(); }
+
+  // pcs are innermost first, as in CallStack::m_Data. Returns the same id for
+  // the same pcs.
+  NodeId Insert(const uint64_t* pcs, size_t size);
+
+  [[nodiscard]] uint64_t GetPc(NodeId id) const {
+    CHECK(id != kRootId);
+    return nodes_[id].pc;
+  }
+  [[nodiscard]] NodeId GetParent(NodeId id) const {
+    CHECK(id != kRootId);
+    return nodes_[id].parent;
+  }
+  [[nodiscard]] uint32_t GetDepth(NodeId id) const { return nodes_[id].depth; }
+  // Innermost first.
+  [[nodiscard]] std::vector<uint64_t> GetPcs(NodeId id) const;
+  // Calls on_pc with the pcs of the callstack, innermost first.
+  template <typename F>
+  void ForEachPc(NodeId id, F&& on_pc) const {
+    for (; id != kRootId; id = nodes_[id].parent) {
+      on_pc(nodes_[id].pc);
+    }
+  }
+
+  // With the root.
+  [[nodiscard]] size_t GetNodeCount() const { return nodes_.size(); }
+  void Clear();
+
+ private:
+  struct Node {
+    uint64_t pc;
+    NodeId parent;
+    uint32_t depth;
+  };
+
+  std::vector<Node> nodes_;
+  // The child of each node by pc.
+  absl::flat_hash_map<std::pair<NodeId, uint64_t>, NodeId> children_;
+};
+
+#endif  // ORBIT_CORE_CALLSTACK_TRIE_H_
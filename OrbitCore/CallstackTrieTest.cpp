@@ -0,0 +1,46 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "CallstackTrie.h"
+
+TEST(CallstackTrie, SharesOutermostFrames) {
+  CallstackTrie trie;
+  const std::vector<uint64_t> first{3, 2, 1};
+  const std::vector<uint64_t> second{4, 2, 1};
+  CallstackTrie::NodeId first_id = trie.Insert(first.data(), first.size());
+  CallstackTrie::NodeId second_id = trie.Insert(second.data(), second.size());
+  EXPECT_NE(first_id, second_id);
+  EXPECT_EQ(trie.GetParent(first_id), trie.GetParent(second_id));
+  // The root, 1, 2, 3 and 4.
+  EXPECT_EQ(trie.GetNodeCount(), 5);
+
+  EXPECT_EQ(trie.Insert(first.data(), first.size()), first_id);
+  EXPECT_EQ(trie.GetNodeCount(), 5);
+
+  EXPECT_EQ(trie.GetPcs(first_id), first);
+  EXPECT_EQ(trie.GetPcs(second_id), second);
+  EXPECT_EQ(trie.GetPc(second_id), 4);
+  EXPECT_EQ(trie.GetDepth(second_id), 3);
+
+  std::vector<uint64_t> pcs;
+  trie.ForEachPc(second_id, [&pcs](uint64_t pc) { pcs.push_back(pc); });
+  EXPECT_EQ(pcs, second);
+}
+
+TEST(CallstackTrie, InsertsPrefixesAndEmptyCallstacks) {
+  CallstackTrie trie;
+  const std::vector<uint64_t> callstack{3, 2, 1};
+  const std::vector<uint64_t> caller{2, 1};
+  CallstackTrie::NodeId id = trie.Insert(callstack.data(), callstack.size());
+  EXPECT_EQ(trie.Insert(caller.data(), caller.size()), trie.GetParent(id));
+  EXPECT_EQ(trie.Insert(nullptr, 0), CallstackTrie::kRootId);
+  EXPECT_TRUE(trie.GetPcs(CallstackTrie::kRootId).empty());
+
+  trie.Clear();
+  EXPECT_EQ(trie.GetNodeCount(), 1);
+}
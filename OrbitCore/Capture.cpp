@@ -16,7 +16,6 @@
 #include "absl/strings/str_format.h"
 
 using orbit_client_protos::FunctionInfo;
-using orbit_client_protos::LinuxAddressInfo;
 using orbit_client_protos::PresetFile;
 using orbit_client_protos::PresetInfo;
 
@@ -27,8 +26,7 @@ std::map<uint64_t, FunctionInfo*> Capture::GSelectedFunctionsMap;
 std::map<uint64_t, FunctionInfo*> Capture::GVisibleFunctionsMap;
 int32_t Capture::GProcessId = -1;
 std::string Capture::GProcessName;
-std::unordered_map<int32_t, std::string> Capture::GThreadNames;
-std::unordered_map<uint64_t, LinuxAddressInfo> Capture::GAddressInfos;
+CaptureData Capture::GCaptureData;
 std::unordered_map<uint64_t, std::string> Capture::GAddressToFunctionName;
 std::unordered_map<uint64_t, std::string> Capture::GAddressToModuleName;
 TextBox* Capture::GSelectedTextBox = nullptr;
@@ -83,10 +81,7 @@ void Capture::StopCapture() {
 
 //-----------------------------------------------------------------------------
 void Capture::FinalizeCapture() {
-  if (Capture::GSamplingProfiler != nullptr) {
-    Capture::GSamplingProfiler->ProcessSamples();
-  }
-
+  // The samples are processed in the background by OrbitApp.
   GState = State::kDone;
 }
 
@@ -94,8 +89,7 @@ void Capture::FinalizeCapture() {
 void Capture::ClearCaptureData() {
   GProcessId = -1;
   GProcessName = "";
-  GThreadNames.clear();
-  GAddressInfos.clear();
+  GCaptureData.Clear();
   GAddressToFunctionName.clear();
   GAddressToModuleName.clear();
   GSelectedTextBox = nullptr;
@@ -186,15 +180,6 @@ void Capture::NewSamplingProfiler() {
       std::make_shared<SamplingProfiler>(Capture::GTargetProcess);
 }
 
-//-----------------------------------------------------------------------------
-LinuxAddressInfo* Capture::GetAddressInfo(uint64_t address) {
-  auto address_info_it = GAddressInfos.find(address);
-  if (address_info_it == GAddressInfos.end()) {
-    return nullptr;
-  }
-  return &address_info_it->second;
-}
-
 //-----------------------------------------------------------------------------
 void Capture::PreSave() {
   // Add selected functions' exact address to sampling profiler
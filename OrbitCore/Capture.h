@@ -10,6 +10,7 @@
 #include <string>
 
 #include "CallstackTypes.h"
+#include "CaptureData.h"
 #include "OrbitBase/Result.h"
 #include "OrbitProcess.h"
 #include "Threading.h"
@@ -23,7 +24,9 @@ struct CallStack;
 
 class Capture {
  public:
-  enum class State { kEmpty = 0, kStarted, kStopping, kDone };
+  // kLoading is while the chunks of a capture file are loaded in the
+  // background.
+  enum class State { kEmpty = 0, kStarted, kStopping, kDone, kLoading };
 
   static void Init();
   static void SetTargetProcess(const std::shared_ptr<Process>& a_Process);
@@ -38,8 +41,6 @@ class Capture {
   static void DisplayStats();
   static ErrorMessageOr<void> SavePreset(const std::string& filename);
   static void NewSamplingProfiler();
-  static orbit_client_protos::LinuxAddressInfo* GetAddressInfo(
-      uint64_t address);
   static void PreSave();
 
   static State GState;
@@ -56,9 +57,8 @@ class Capture {
       GVisibleFunctionsMap;
   static int32_t GProcessId;
   static std::string GProcessName;
-  static std::unordered_map<int32_t, std::string> GThreadNames;
-  static std::unordered_map<uint64_t, orbit_client_protos::LinuxAddressInfo>
-      GAddressInfos;
+  // The thread names and address infos, written while capturing.
+  static CaptureData GCaptureData;
   static std::unordered_map<uint64_t, std::string> GAddressToFunctionName;
   static std::unordered_map<uint64_t, std::string> GAddressToModuleName;
   static class TextBox* GSelectedTextBox;
@@ -0,0 +1,104 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "CaptureData.h"
+
+#include <utility>
+
+#include "absl/hash/hash.h"
+
+using orbit_client_protos::LinuxAddressInfo;
+
+void CaptureData::AddThreadName(int32_t thread_id, std::string thread_name) {
+  absl::MutexLock lock(&thread_names_mutex_);
+  auto thread_names = std::make_shared<ThreadNames>(*thread_names_);
+  thread_names->insert_or_assign(thread_id, std::move(thread_name));
+  thread_names_ = std::move(thread_names);
+}
+
+void CaptureData::SetThreadNames(ThreadNames thread_names) {
+  auto new_thread_names =
+      std::make_shared<const ThreadNames>(std::move(thread_names));
+  absl::MutexLock lock(&thread_names_mutex_);
+  thread_names_ = std::move(new_thread_names);
+}
+
+std::shared_ptr<const CaptureData::ThreadNames> CaptureData::GetThreadNames()
+    const {
+  absl::MutexLock lock(&thread_names_mutex_);
+  return thread_names_;
+}
+
+std::string CaptureData::GetThreadName(int32_t thread_id) const {
+  std::shared_ptr<const ThreadNames> thread_names = GetThreadNames();
+  auto it = thread_names->find(thread_id);
+  return it != thread_names->end() ? it->second : "";
+}
+
+void CaptureData::AddAddressInfo(LinuxAddressInfo address_info) {
+  const uint64_t address = address_info.absolute_address();
+  AddressInfoShard& shard = GetShard(address);
+  absl::MutexLock lock(&shard.mutex);
+  shard.address_infos.try_emplace(address, std::move(address_info));
+}
+
+std::optional<LinuxAddressInfo> CaptureData::GetAddressInfo(
+    uint64_t absolute_address) const {
+  const AddressInfoShard& shard = GetShard(absolute_address);
+  absl::ReaderMutexLock lock(&shard.mutex);
+  auto it = shard.address_infos.find(absolute_address);
+  if (it == shard.address_infos.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+void CaptureData::SetAddressInfoFunctionName(uint64_t absolute_address,
+                                             std::string function_name) {
+  AddressInfoShard& shard = GetShard(absolute_address);
+  absl::MutexLock lock(&shard.mutex);
+  auto it = shard.address_infos.find(absolute_address);
+  if (it != shard.address_infos.end()) {
+    it->second.set_function_name(std::move(function_name));
+  }
+}
+
+size_t CaptureData::GetAddressInfoCount() const {
+  size_t count = 0;
+  for (const AddressInfoShard& shard : address_info_shards_) {
+    absl::ReaderMutexLock lock(&shard.mutex);
+    count += shard.address_infos.size();
+  }
+  return count;
+}
+
+void CaptureData::ForEachAddressInfo(
+    const std::function<void(const LinuxAddressInfo&)>& action) const {
+  for (const AddressInfoShard& shard : address_info_shards_) {
+    absl::ReaderMutexLock lock(&shard.mutex);
+    for (const auto& [address, address_info] : shard.address_infos) {
+      action(address_info);
+    }
+  }
+}
+
+void CaptureData::Clear() {
+  SetThreadNames({});
+  for (AddressInfoShard& shard : address_info_shards_) {
+    absl::MutexLock lock(&shard.mutex);
+    shard.address_infos.clear();
+  }
+}
+
+CaptureData::AddressInfoShard& CaptureData::GetShard(
+    uint64_t absolute_address) {
+  return address_info_shards_[absl::Hash<uint64_t>{}(absolute_address) %
+                              kAddressInfoShardCount];
+}
+
+const CaptureData::AddressInfoShard& CaptureData::GetShard(
+    uint64_t absolute_address) const {
+  return address_info_shards_[absl::Hash<uint64_t>{}(absolute_address) %
+                              kAddressInfoShardCount];
+}
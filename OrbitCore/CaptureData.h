@@ -0,0 +1,76 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_CAPTURE_DATA_H_
+#define ORBIT_CORE_CAPTURE_DATA_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "capture_data.pb.h"
+
+// The data of a capture that the thread reading the capture from the service
+// adds to while the UI reads it, safe to access from any thread.
+//
+// Thread names are only added a few times per thread, but read for every
+// track and tooltip: readers get an immutable snapshot, writers replace it by
+// a modified copy. Address infos are added for every new address in a
+// callstack: they are sharded by address, each shard with its own mutex, so
+// that adding them seldom waits for the readers.
+class CaptureData {
+ public:
+  using ThreadNames = std::unordered_map<int32_t, std::string>;
+
+  CaptureData() : thread_names_{std::make_shared<const ThreadNames>()} {}
+
+  void AddThreadName(int32_t thread_id, std::string thread_name);
+  void SetThreadNames(ThreadNames thread_names);
+  // Not affected by the names added later.
+  [[nodiscard]] std::shared_ptr<const ThreadNames> GetThreadNames() const;
+  // Empty if unknown.
+  [[nodiscard]] std::string GetThreadName(int32_t thread_id) const;
+
+  // The first address info added for an address is kept.
+  void AddAddressInfo(orbit_client_protos::LinuxAddressInfo address_info);
+  [[nodiscard]] std::optional<orbit_client_protos::LinuxAddressInfo>
+  GetAddressInfo(uint64_t absolute_address) const;
+  void SetAddressInfoFunctionName(uint64_t absolute_address,
+                                  std::string function_name);
+  [[nodiscard]] size_t GetAddressInfoCount() const;
+  // Shard by shard, the address infos added meanwhile might be skipped.
+  void ForEachAddressInfo(
+      const std::function<void(const orbit_client_protos::LinuxAddressInfo&)>&
+          action) const;
+
+  void Clear();
+
+ private:
+  static constexpr size_t kAddressInfoShardCount = 16;
+
+  struct AddressInfoShard {
+    mutable absl::Mutex mutex;
+    absl::flat_hash_map<uint64_t, orbit_client_protos::LinuxAddressInfo>
+        address_infos ABSL_GUARDED_BY(mutex);
+  };
+
+  [[nodiscard]] AddressInfoShard& GetShard(uint64_t absolute_address);
+  [[nodiscard]] const AddressInfoShard& GetShard(
+      uint64_t absolute_address) const;
+
+  mutable absl::Mutex thread_names_mutex_;
+  std::shared_ptr<const ThreadNames> thread_names_
+      ABSL_GUARDED_BY(thread_names_mutex_);
+  std::array<AddressInfoShard, kAddressInfoShardCount> address_info_shards_;
+};
+
+#endif  // ORBIT_CORE_CAPTURE_DATA_H_
@@ -0,0 +1,77 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+
+#include "CaptureData.h"
+
+using orbit_client_protos::LinuxAddressInfo;
+
+TEST(CaptureData, ThreadNameSnapshotsAreNotModified) {
+  CaptureData capture_data;
+  capture_data.AddThreadName(1, "main");
+  std::shared_ptr<const CaptureData::ThreadNames> snapshot =
+      capture_data.GetThreadNames();
+  capture_data.AddThreadName(2, "worker");
+  capture_data.AddThreadName(1, "renamed");
+
+  EXPECT_EQ(snapshot->size(), 1);
+  EXPECT_EQ(snapshot->at(1), "main");
+  EXPECT_EQ(capture_data.GetThreadName(1), "renamed");
+  EXPECT_EQ(capture_data.GetThreadName(2), "worker");
+  EXPECT_EQ(capture_data.GetThreadName(3), "");
+
+  capture_data.Clear();
+  EXPECT_TRUE(capture_data.GetThreadNames()->empty());
+  EXPECT_EQ(snapshot->size(), 1);
+}
+
+TEST(CaptureData, AddressInfos) {
+  CaptureData capture_data;
+  LinuxAddressInfo address_info;
+  address_info.set_absolute_address(0x1234);
+  address_info.set_module_name("module");
+  capture_data.AddAddressInfo(address_info);
+  address_info.set_module_name("other");
+  capture_data.AddAddressInfo(address_info);
+
+  ASSERT_TRUE(capture_data.GetAddressInfo(0x1234).has_value());
+  EXPECT_EQ(capture_data.GetAddressInfo(0x1234)->module_name(), "module");
+  EXPECT_FALSE(capture_data.GetAddressInfo(0x5678).has_value());
+
+  capture_data.SetAddressInfoFunctionName(0x1234, "function");
+  capture_data.SetAddressInfoFunctionName(0x5678, "function");
+  EXPECT_EQ(capture_data.GetAddressInfo(0x1234)->function_name(), "function");
+  EXPECT_EQ(capture_data.GetAddressInfoCount(), 1);
+
+  capture_data.Clear();
+  EXPECT_EQ(capture_data.GetAddressInfoCount(), 0);
+}
+
+TEST(CaptureData, AddsAddressInfosWhileReading) {
+  CaptureData capture_data;
+  constexpr uint64_t kCount = 10000;
+  std::thread writer([&capture_data] {
+    for (uint64_t address = 0; address < kCount; ++address) {
+      LinuxAddressInfo address_info;
+      address_info.set_absolute_address(address);
+      capture_data.AddAddressInfo(std::move(address_info));
+    }
+  });
+  while (capture_data.GetAddressInfoCount() < kCount) {
+    size_t count = 0;
+    capture_data.ForEachAddressInfo(
+        [&count](const LinuxAddressInfo&) { ++count; });
+    EXPECT_LE(count, kCount);
+  }
+  writer.join();
+
+  size_t count = 0;
+  capture_data.ForEachAddressInfo(
+      [&count](const LinuxAddressInfo&) { ++count; });
+  EXPECT_EQ(count, kCount);
+}
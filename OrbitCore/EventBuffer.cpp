@@ -4,6 +4,8 @@
 
 #include "EventBuffer.h"
 
+#include <algorithm>
+
 #include "Capture.h"
 #include "EventTracer.h"
 #include "Params.h"
@@ -13,46 +15,148 @@ using orbit_client_protos::CallstackEvent;
 
 EventTracer GEventTracer;
 
+//-----------------------------------------------------------------------------
+void CallstackEventsByTime::Add(const CallstackEvent& event) {
+  const uint32_t size = events_.size();
+  if (size == 0 || events_[size - 1].time() < event.time()) {
+    events_.push_back(event);
+    return;
+  }
+
+  const uint32_t index = LowerBound(event.time());
+  if (events_[index].time() == event.time()) {
+    events_[index] = event;
+    return;
+  }
+  // Shift the later events, usually few, by one.
+  const CallstackEvent last_event = events_[size - 1];
+  events_.push_back(last_event);
+  for (uint32_t i = size - 1; i > index; --i) {
+    events_[i] = events_[i - 1];
+  }
+  events_[index] = event;
+}
+
+//-----------------------------------------------------------------------------
+uint32_t CallstackEventsByTime::LowerBound(uint64_t time) const {
+  uint32_t begin = 0;
+  uint32_t count = events_.size();
+  while (count > 0) {
+    const uint32_t half = count / 2;
+    if (events_[begin + half].time() < time) {
+      begin += half + 1;
+      count -= half + 1;
+    } else {
+      count = half;
+    }
+  }
+  return begin;
+}
+
+//-----------------------------------------------------------------------------
+uint32_t CallstackEventsByTime::UpperBound(uint64_t time) const {
+  uint32_t begin = 0;
+  uint32_t count = events_.size();
+  while (count > 0) {
+    const uint32_t half = count / 2;
+    if (events_[begin + half].time() <= time) {
+      begin += half + 1;
+      count -= half + 1;
+    } else {
+      count = half;
+    }
+  }
+  return begin;
+}
+
+//-----------------------------------------------------------------------------
+CallstackEventsByTime::Range CallstackEventsByTime::GetRange(
+    uint64_t time_begin, uint64_t time_end) const {
+  if (time_end <= time_begin) {
+    return Range();
+  }
+  return Range(&events_, LowerBound(time_begin), LowerBound(time_end));
+}
+
 //-----------------------------------------------------------------------------
 std::vector<CallstackEvent> EventBuffer::GetCallstackEvents(
     uint64_t a_TimeBegin, uint64_t a_TimeEnd, ThreadID a_ThreadId /*= 0*/) {
+  ScopeLock lock(m_Mutex);
   std::vector<CallstackEvent> callstackEvents;
-  for (auto& pair : m_CallstackEvents) {
-    ThreadID threadID = pair.first;
-    std::map<uint64_t, CallstackEvent>& callstacks = pair.second;
-
+  ForEachThread([&](ThreadID threadID,
+                    const CallstackEventsByTime& callstacks) {
     if (a_ThreadId == 0 || threadID == a_ThreadId) {
-      for (auto it = callstacks.lower_bound(a_TimeBegin);
-           it != callstacks.end(); ++it) {
-        uint64_t time = it->first;
-        if (time < a_TimeEnd) {
-          callstackEvents.push_back(it->second);
-        }
+      for (uint32_t i = callstacks.LowerBound(a_TimeBegin);
+           i < callstacks.size() && callstacks[i].time() < a_TimeEnd; ++i) {
+        callstackEvents.push_back(callstacks[i]);
       }
     }
-  }
+  });
 
   return callstackEvents;
 }
 
+//-----------------------------------------------------------------------------
+uint32_t EventBuffer::GetCallstackEventCount(uint64_t time_begin,
+                                             uint64_t time_end,
+                                             ThreadID thread_id) {
+  ScopeLock lock(m_Mutex);
+  if (time_end <= time_begin) {
+    return 0;
+  }
+  const CallstackEventsByTime& callstacks =
+      GetCallstackEventsOfThread(thread_id);
+  return callstacks.LowerBound(time_end) - callstacks.LowerBound(time_begin);
+}
+
+//-----------------------------------------------------------------------------
+void EventBuffer::DropCallstackEventsBefore(uint64_t time) {
+  ScopeLock lock(m_Mutex);
+  uint64_t min_time = LLONG_MAX;
+  for (std::unique_ptr<CallstackEventsByTime>& callstacks :
+       m_CallstackEvents) {
+    callstacks->DropEventsBefore(time);
+    if (!callstacks->empty()) {
+      min_time = std::min<uint64_t>(min_time, (*callstacks)[0].time());
+    }
+  }
+  m_MinTime = min_time;
+}
+
+//-----------------------------------------------------------------------------
+const CallstackEventsByTime& EventBuffer::GetCallstackEventsOfThread(
+    ThreadID thread_id) const {
+  std::optional<uint32_t> index = thread_index_.Find(thread_id);
+  return index.has_value() ? *m_CallstackEvents[index.value()]
+                           : empty_callstack_events_;
+}
+
+//-----------------------------------------------------------------------------
+CallstackEventsByTime& EventBuffer::GetOrCreateCallstackEventsOfThread(
+    ThreadID thread_id) {
+  const uint32_t index = thread_index_.GetOrAssign(thread_id);
+  if (index == m_CallstackEvents.size()) {
+    m_CallstackEvents.push_back(std::make_unique<CallstackEventsByTime>());
+  }
+  return *m_CallstackEvents[index];
+}
+
 //-----------------------------------------------------------------------------
 void EventBuffer::AddCallstackEvent(uint64_t time, CallstackID cs_hash,
                                     ThreadID thread_id) {
   ScopeLock lock(m_Mutex);
-  std::map<uint64_t, CallstackEvent>& event_map = m_CallstackEvents[thread_id];
   CallstackEvent event;
   event.set_time(time);
   event.set_callstack_hash(cs_hash);
   event.set_thread_id(thread_id);
-  event_map[time] = event;
+  GetOrCreateCallstackEventsOfThread(thread_id).Add(event);
 
   // Add all callstack events to "thread 0".
-  std::map<uint64_t, CallstackEvent>& event_map_0 = m_CallstackEvents[0];
   CallstackEvent event0;
   event0.set_time(time);
   event0.set_callstack_hash(cs_hash);
   event0.set_thread_id(0);
-  event_map_0[time] = event0;
+  m_CallstackEvents[0]->Add(event0);
 
   RegisterTime(time);
 }
@@ -61,8 +165,9 @@ void EventBuffer::AddCallstackEvent(uint64_t time, CallstackID cs_hash,
 //-----------------------------------------------------------------------------
 size_t EventBuffer::GetNumEvents() const {
   size_t numEvents = 0;
-  for (auto& pair : m_CallstackEvents) {
-    numEvents += pair.second.size();
+  for (const std::unique_ptr<CallstackEventsByTime>& callstacks :
+       m_CallstackEvents) {
+    numEvents += callstacks->size();
   }
 
   return numEvents;
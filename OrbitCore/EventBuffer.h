@@ -5,39 +5,121 @@
 #ifndef ORBIT_CORE_EVENT_BUFFER_H_
 #define ORBIT_CORE_EVENT_BUFFER_H_
 
-#include <set>
+#include <memory>
+#include <vector>
 
 #include "BlockChain.h"
 #include "Callstack.h"
 #include "Core.h"
+#include "ThreadIndex.h"
 #include "capture_data.pb.h"
 
 #ifdef __linux
 #include "LinuxUtils.h"
 #endif
 
+//-----------------------------------------------------------------------------
+// The callstack events of a thread, by time, with at most one event of each
+// time. The events are stored in blocks, so that they are never moved or
+// copied when more are added at the end, and binary searched by time. Events
+// mostly arrive in order of time: those that don't are moved into place.
+class CallstackEventsByTime {
+ public:
+  using const_iterator = BlockChain<orbit_client_protos::CallstackEvent,
+                                    1024>::const_iterator;
+
+  // Consecutive events, by index, without copying them. Only valid while the
+  // events are not modified, i.e., with the mutex of the EventBuffer held.
+  class Range {
+   public:
+    Range() = default;
+
+    [[nodiscard]] uint32_t size() const { return end_ - begin_; }
+    [[nodiscard]] bool empty() const { return begin_ == end_; }
+    [[nodiscard]] const_iterator begin() const { return {events_, begin_}; }
+    [[nodiscard]] const_iterator end() const { return {events_, end_}; }
+
+   private:
+    friend class CallstackEventsByTime;
+    Range(const BlockChain<orbit_client_protos::CallstackEvent, 1024>* events,
+          uint32_t begin, uint32_t end)
+        : events_(events), begin_(begin), end_(end) {}
+
+    const BlockChain<orbit_client_protos::CallstackEvent, 1024>* events_ =
+        nullptr;
+    uint32_t begin_ = 0;
+    uint32_t end_ = 0;
+  };
+
+  void Add(const orbit_client_protos::CallstackEvent& event);
+  // Frees the oldest blocks of events that are all before time.
+  void DropEventsBefore(uint64_t time) {
+    events_.DropBlocksBefore(LowerBound(time));
+  }
+
+  [[nodiscard]] uint32_t size() const { return events_.size(); }
+  [[nodiscard]] bool empty() const { return events_.empty(); }
+  const orbit_client_protos::CallstackEvent& operator[](uint32_t index) const {
+    return events_[index];
+  }
+  [[nodiscard]] const_iterator begin() const { return events_.begin(); }
+  [[nodiscard]] const_iterator end() const { return events_.end(); }
+
+  // The index of the first event at or after time, or size().
+  [[nodiscard]] uint32_t LowerBound(uint64_t time) const;
+  // The index of the first event after time, or size().
+  [[nodiscard]] uint32_t UpperBound(uint64_t time) const;
+  // The events in [time_begin, time_end).
+  [[nodiscard]] Range GetRange(uint64_t time_begin, uint64_t time_end) const;
+
+ private:
+  BlockChain<orbit_client_protos::CallstackEvent, 1024> events_;
+};
+
 //-----------------------------------------------------------------------------
 class EventBuffer {
  public:
-  EventBuffer() : m_MaxTime(0), m_MinTime(LLONG_MAX) {}
+  EventBuffer() : m_MaxTime(0), m_MinTime(LLONG_MAX) { Reset(); }
 
   void Reset() {
+    thread_index_.Clear();
     m_CallstackEvents.clear();
+    // The events of all threads are those of "thread 0", at index 0.
+    GetOrCreateCallstackEventsOfThread(0);
     m_MinTime = LLONG_MAX;
     m_MaxTime = 0;
   }
-  std::map<ThreadID, std::map<uint64_t, orbit_client_protos::CallstackEvent> >&
-  GetCallstacks() {
-    return m_CallstackEvents;
+  // The events of the thread, of all threads for 0. Empty if it has none.
+  // The mutex must be held.
+  [[nodiscard]] const CallstackEventsByTime& GetCallstackEventsOfThread(
+      ThreadID thread_id) const;
+  // Calls visitor(ThreadID, const CallstackEventsByTime&) for each thread
+  // with events, and for 0. The mutex must be held.
+  template <typename Visitor>
+  void ForEachThread(Visitor visitor) const {
+    for (uint32_t index = 0; index < thread_index_.size(); ++index) {
+      visitor(thread_index_.GetThreadId(index), *m_CallstackEvents[index]);
+    }
+  }
+  // Including 0.
+  [[nodiscard]] uint32_t GetThreadCount() const {
+    return thread_index_.size();
   }
   Mutex& GetMutex() { return m_Mutex; }
   std::vector<orbit_client_protos::CallstackEvent> GetCallstackEvents(
       uint64_t a_TimeBegin, uint64_t a_TimeEnd, ThreadID a_ThreadId = 0);
+  // The number of events in [time_begin, time_end), of all threads by default.
+  uint32_t GetCallstackEventCount(uint64_t time_begin, uint64_t time_end,
+                                  ThreadID thread_id = 0);
+  // Frees the oldest callstack events before time, by whole blocks, to keep
+  // only the end of a long capture. The min time becomes the time of the
+  // first event left.
+  void DropCallstackEventsBefore(uint64_t time);
   uint64_t GetMaxTime() const { return m_MaxTime; }
   uint64_t GetMinTime() const { return m_MinTime; }
   bool HasEvent() {
     ScopeLock lock(m_Mutex);
-    return !m_CallstackEvents.empty();
+    return !m_CallstackEvents[0]->empty();
   }
 
 #ifdef __linux__
@@ -55,9 +137,16 @@ class EventBuffer {
                          ThreadID thread_id);
 
  private:
+  CallstackEventsByTime& GetOrCreateCallstackEventsOfThread(
+      ThreadID thread_id);
+
   Mutex m_Mutex;
-  std::map<ThreadID, std::map<uint64_t, orbit_client_protos::CallstackEvent> >
-      m_CallstackEvents;
+  // By thread index, which takes the one lookup of the thread of an event.
+  // The events of each thread are allocated apart, so that growing the
+  // vector doesn't move them.
+  ThreadIndex thread_index_;
+  std::vector<std::unique_ptr<CallstackEventsByTime>> m_CallstackEvents;
+  const CallstackEventsByTime empty_callstack_events_{};
   std::atomic<uint64_t> m_MaxTime;
   std::atomic<uint64_t> m_MinTime;
 };
@@ -0,0 +1,128 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "EventBuffer.h"
+#include "capture_data.pb.h"
+
+using orbit_client_protos::CallstackEvent;
+
+TEST(CallstackEventsByTime, MatchesMap) {
+  std::mt19937_64 random(42);
+  CallstackEventsByTime events;
+  std::map<uint64_t, uint64_t> callstacks_by_time;
+  uint64_t time = 1000;
+  for (uint64_t i = 0; i < 10'000; ++i) {
+    time += random() % 10;
+    // Mostly in order of time, sometimes earlier or at the same time.
+    const uint64_t event_time =
+        random() % 20 == 0 ? time - random() % 50 : time;
+    CallstackEvent event;
+    event.set_time(event_time);
+    event.set_callstack_hash(i);
+    events.Add(event);
+    callstacks_by_time[event_time] = i;
+  }
+
+  ASSERT_EQ(events.size(), callstacks_by_time.size());
+  uint32_t index = 0;
+  for (const auto& [event_time, callstack_id] : callstacks_by_time) {
+    EXPECT_EQ(events[index].time(), event_time);
+    EXPECT_EQ(events[index].callstack_hash(), callstack_id);
+    ++index;
+  }
+
+  for (uint64_t query_time = 900; query_time < time + 10; query_time += 7) {
+    EXPECT_EQ(events.LowerBound(query_time),
+              std::distance(callstacks_by_time.begin(),
+                            callstacks_by_time.lower_bound(query_time)));
+    EXPECT_EQ(events.UpperBound(query_time),
+              std::distance(callstacks_by_time.begin(),
+                            callstacks_by_time.upper_bound(query_time)));
+  }
+}
+
+TEST(EventBuffer, GetCallstackEvents) {
+  EventBuffer event_buffer;
+  event_buffer.AddCallstackEvent(30, 3, 42);
+  event_buffer.AddCallstackEvent(10, 1, 42);
+  event_buffer.AddCallstackEvent(20, 2, 43);
+
+  std::vector<CallstackEvent> events =
+      event_buffer.GetCallstackEvents(10, 30, 42);
+  ASSERT_EQ(events.size(), 1);
+  EXPECT_EQ(events[0].callstack_hash(), 1);
+
+  // Thread 0 holds the events of all threads.
+  const CallstackEventsByTime& all_events =
+      event_buffer.GetCallstackEventsOfThread(0);
+  ASSERT_EQ(all_events.size(), 3);
+  EXPECT_EQ(all_events[0].time(), 10);
+  EXPECT_EQ(all_events[1].time(), 20);
+  EXPECT_EQ(all_events[2].time(), 30);
+  EXPECT_EQ(event_buffer.GetMinTime(), 10);
+  EXPECT_EQ(event_buffer.GetMaxTime(), 30);
+}
+
+TEST(EventBuffer, GetCallstackEventCount) {
+  EventBuffer event_buffer;
+  event_buffer.AddCallstackEvent(10, 1, 42);
+  event_buffer.AddCallstackEvent(20, 2, 43);
+  event_buffer.AddCallstackEvent(30, 3, 42);
+
+  EXPECT_EQ(event_buffer.GetCallstackEventCount(10, 30), 2);
+  EXPECT_EQ(event_buffer.GetCallstackEventCount(10, 31), 3);
+  EXPECT_EQ(event_buffer.GetCallstackEventCount(10, 31, 42), 2);
+  EXPECT_EQ(event_buffer.GetCallstackEventCount(30, 10), 0);
+  EXPECT_EQ(event_buffer.GetCallstackEventCount(0, 100, 44), 0);
+}
+
+TEST(CallstackEventsByTime, GetRange) {
+  CallstackEventsByTime events;
+  for (uint64_t time = 10; time <= 3000; time += 10) {
+    CallstackEvent event;
+    event.set_time(time);
+    events.Add(event);
+  }
+
+  CallstackEventsByTime::Range range = events.GetRange(1015, 2000);
+  ASSERT_EQ(range.size(), 98);
+  std::vector<uint64_t> times;
+  for (const CallstackEvent& event : range) {
+    times.push_back(event.time());
+  }
+  ASSERT_EQ(times.size(), 98);
+  EXPECT_EQ(times.front(), 1020);
+  EXPECT_EQ(times.back(), 1990);
+
+  EXPECT_TRUE(events.GetRange(2000, 1015).empty());
+  EXPECT_TRUE(events.GetRange(5000, 6000).empty());
+  EXPECT_TRUE(CallstackEventsByTime::Range().empty());
+}
+
+TEST(EventBuffer, DropCallstackEventsBefore) {
+  EventBuffer event_buffer;
+  for (uint64_t time = 1; time <= 3000; ++time) {
+    event_buffer.AddCallstackEvent(time, time, time % 2 == 0 ? 42 : 43);
+  }
+
+  // Only whole blocks of 1024 events are freed.
+  event_buffer.DropCallstackEventsBefore(2500);
+  const CallstackEventsByTime& all_events =
+      event_buffer.GetCallstackEventsOfThread(0);
+  ASSERT_EQ(all_events.size(), 3000 - 2048);
+  EXPECT_EQ(all_events[0].time(), 2049);
+  // Per thread as well.
+  EXPECT_EQ(event_buffer.GetCallstackEventsOfThread(42).size(), 1500 - 1024);
+  EXPECT_EQ(event_buffer.GetCallstackEventsOfThread(42)[0].time(), 2050);
+  EXPECT_EQ(event_buffer.GetMinTime(), 2049);
+  EXPECT_EQ(event_buffer.GetMaxTime(), 3000);
+  EXPECT_EQ(event_buffer.GetCallstackEventCount(2049, 2059), 10);
+}
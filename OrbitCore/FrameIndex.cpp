@@ -0,0 +1,85 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "FrameIndex.h"
+
+#include <algorithm>
+
+namespace {
+// The first frame that ends after timestamp_ns.
+template <typename Frames>
+auto FindFirstFrameEndingAfter(Frames& frames, uint64_t timestamp_ns) {
+  return std::upper_bound(frames.begin(), frames.end(), timestamp_ns,
+                          [](uint64_t timestamp_ns,
+                             const FrameIndex::Frame& frame) {
+                            return timestamp_ns < frame.end_ns;
+                          });
+}
+}  // namespace
+
+void FrameIndex::AddFrame(uint64_t begin_ns, uint64_t end_ns) {
+  if (end_ns <= begin_ns) return;
+  // Frames are mostly added in order, at the end.
+  auto it = frames_.end();
+  if (!frames_.empty() && begin_ns < frames_.back().end_ns) {
+    it = FindFirstFrameEndingAfter(frames_, begin_ns);
+    if (it != frames_.end() && it->begin_ns < end_ns) return;
+  }
+
+  Frame frame;
+  frame.begin_ns = begin_ns;
+  frame.end_ns = end_ns;
+  auto pending_begin = pending_function_calls_.lower_bound(begin_ns);
+  auto pending_end = pending_function_calls_.lower_bound(end_ns);
+  for (auto pending_it = pending_begin; pending_it != pending_end;
+       ++pending_it) {
+    ++frame.function_call_count;
+    frame.function_time_ns += pending_it->second;
+  }
+  pending_function_calls_.erase(pending_begin, pending_end);
+  frames_.insert(it, frame);
+  total_duration_ns_ += frame.GetDurationNs();
+}
+
+void FrameIndex::AddFunctionCall(uint64_t start_ns, uint64_t end_ns) {
+  const uint64_t duration_ns = end_ns > start_ns ? end_ns - start_ns : 0;
+  int64_t frame_index = FindFrame(start_ns);
+  if (frame_index < 0) {
+    pending_function_calls_.emplace(start_ns, duration_ns);
+    return;
+  }
+  Frame& frame = frames_[frame_index];
+  ++frame.function_call_count;
+  frame.function_time_ns += duration_ns;
+}
+
+void FrameIndex::Clear() {
+  frames_.clear();
+  total_duration_ns_ = 0;
+  pending_function_calls_.clear();
+}
+
+int64_t FrameIndex::FindFrame(uint64_t timestamp_ns) const {
+  auto it = FindFirstFrameEndingAfter(frames_, timestamp_ns);
+  if (it == frames_.end() || it->begin_ns > timestamp_ns) return -1;
+  return it - frames_.begin();
+}
+
+std::vector<size_t> FrameIndex::GetLongestFrames(size_t count) const {
+  std::vector<size_t> indices(frames_.size());
+  for (size_t i = 0; i < indices.size(); ++i) {
+    indices[i] = i;
+  }
+  count = std::min(count, indices.size());
+  // The earlier of frames of the same duration first.
+  std::partial_sort(indices.begin(), indices.begin() + count, indices.end(),
+                    [this](size_t a, size_t b) {
+                      uint64_t duration_a = frames_[a].GetDurationNs();
+                      uint64_t duration_b = frames_[b].GetDurationNs();
+                      return duration_a > duration_b ||
+                             (duration_a == duration_b && a < b);
+                    });
+  indices.resize(count);
+  return indices;
+}
@@ -0,0 +1,56 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_FRAME_INDEX_H_
+#define ORBIT_CORE_FRAME_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// The frames between the consecutive frame markers of a name, with the time
+// spent in instrumented functions during each. Frames and function calls can
+// be added in any order, as they arrive while capturing or loading a capture:
+// a call is attributed to the frame it starts in as soon as both are known.
+class FrameIndex {
+ public:
+  struct Frame {
+    uint64_t begin_ns = 0;
+    uint64_t end_ns = 0;
+    uint64_t function_call_count = 0;
+    // The sum of the durations of the calls, nested ones included.
+    uint64_t function_time_ns = 0;
+
+    [[nodiscard]] uint64_t GetDurationNs() const { return end_ns - begin_ns; }
+  };
+
+  // Frames of the same name don't overlap: a frame that overlaps a frame
+  // already added is ignored.
+  void AddFrame(uint64_t begin_ns, uint64_t end_ns);
+  void AddFunctionCall(uint64_t start_ns, uint64_t end_ns);
+  void Clear();
+
+  // Sorted by time, hence a frame is numbered by its position.
+  [[nodiscard]] const std::vector<Frame>& GetFrames() const { return frames_; }
+  // The position of the frame that timestamp_ns is in, or -1.
+  [[nodiscard]] int64_t FindFrame(uint64_t timestamp_ns) const;
+  // The positions of the count longest frames, longest first.
+  [[nodiscard]] std::vector<size_t> GetLongestFrames(size_t count) const;
+  [[nodiscard]] uint64_t GetAverageFrameDurationNs() const {
+    return frames_.empty() ? 0 : total_duration_ns_ / frames_.size();
+  }
+  // The calls not in any of the frames so far, kept for a frame to come.
+  [[nodiscard]] size_t GetPendingFunctionCallCount() const {
+    return pending_function_calls_.size();
+  }
+
+ private:
+  std::vector<Frame> frames_;
+  uint64_t total_duration_ns_ = 0;
+  // Durations by start.
+  std::multimap<uint64_t, uint64_t> pending_function_calls_;
+};
+
+#endif  // ORBIT_CORE_FRAME_INDEX_H_
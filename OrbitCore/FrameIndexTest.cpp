@@ -0,0 +1,77 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "FrameIndex.h"
+
+TEST(FrameIndex, AttributesFunctionCallsToFrames) {
+  FrameIndex frame_index;
+  frame_index.AddFrame(100, 200);
+  frame_index.AddFrame(200, 350);
+  frame_index.AddFunctionCall(110, 150);
+  frame_index.AddFunctionCall(120, 130);
+  frame_index.AddFunctionCall(200, 400);
+  // Before the first frame.
+  frame_index.AddFunctionCall(50, 60);
+
+  const std::vector<FrameIndex::Frame>& frames = frame_index.GetFrames();
+  ASSERT_EQ(frames.size(), 2);
+  EXPECT_EQ(frames[0].function_call_count, 2);
+  EXPECT_EQ(frames[0].function_time_ns, 50);
+  EXPECT_EQ(frames[1].function_call_count, 1);
+  EXPECT_EQ(frames[1].function_time_ns, 200);
+  EXPECT_EQ(frame_index.GetPendingFunctionCallCount(), 1);
+  EXPECT_EQ(frame_index.GetAverageFrameDurationNs(), 125);
+}
+
+TEST(FrameIndex, KeepsFunctionCallsUntilTheirFrame) {
+  FrameIndex frame_index;
+  frame_index.AddFunctionCall(210, 220);
+  frame_index.AddFunctionCall(110, 150);
+  frame_index.AddFrame(100, 200);
+  EXPECT_EQ(frame_index.GetFrames()[0].function_call_count, 1);
+  EXPECT_EQ(frame_index.GetPendingFunctionCallCount(), 1);
+
+  frame_index.AddFrame(200, 300);
+  EXPECT_EQ(frame_index.GetFrames()[1].function_call_count, 1);
+  EXPECT_EQ(frame_index.GetFrames()[1].function_time_ns, 10);
+  EXPECT_EQ(frame_index.GetPendingFunctionCallCount(), 0);
+}
+
+TEST(FrameIndex, AddsFramesInAnyOrder) {
+  FrameIndex frame_index;
+  frame_index.AddFrame(300, 400);
+  frame_index.AddFrame(100, 200);
+  frame_index.AddFrame(200, 300);
+  // Overlaps the first two.
+  frame_index.AddFrame(150, 250);
+
+  const std::vector<FrameIndex::Frame>& frames = frame_index.GetFrames();
+  ASSERT_EQ(frames.size(), 3);
+  EXPECT_EQ(frames[0].begin_ns, 100);
+  EXPECT_EQ(frames[1].begin_ns, 200);
+  EXPECT_EQ(frames[2].begin_ns, 300);
+
+  EXPECT_EQ(frame_index.FindFrame(99), -1);
+  EXPECT_EQ(frame_index.FindFrame(100), 0);
+  EXPECT_EQ(frame_index.FindFrame(250), 1);
+  EXPECT_EQ(frame_index.FindFrame(399), 2);
+  EXPECT_EQ(frame_index.FindFrame(400), -1);
+}
+
+TEST(FrameIndex, GetLongestFrames) {
+  FrameIndex frame_index;
+  frame_index.AddFrame(0, 10);
+  frame_index.AddFrame(10, 40);
+  frame_index.AddFrame(40, 60);
+  frame_index.AddFrame(60, 90);
+
+  EXPECT_EQ(frame_index.GetLongestFrames(3), (std::vector<size_t>{1, 3, 2}));
+  EXPECT_EQ(frame_index.GetLongestFrames(10).size(), 4);
+
+  frame_index.Clear();
+  EXPECT_TRUE(frame_index.GetFrames().empty());
+  EXPECT_TRUE(frame_index.GetLongestFrames(3).empty());
+}
@@ -0,0 +1,90 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "FunctionTimeIndex.h"
+
+#include <algorithm>
+
+void FunctionTimeIndex::AddCall(uint64_t function_address, ThreadID thread_id,
+                                uint32_t depth, uint64_t start_ns,
+                                uint64_t end_ns, uint64_t call_count) {
+  const uint32_t thread_index = thread_index_.GetOrAssign(thread_id);
+  if (thread_index >= returned_calls_.size()) {
+    returned_calls_.resize(thread_index + 1);
+  }
+  std::vector<ReturnedCalls>& returned_calls = returned_calls_[thread_index];
+  if (returned_calls.size() < depth + 2) {
+    returned_calls.resize(depth + 2);
+  }
+
+  // The calls that returned before this one started are not its children,
+  // their parent was lost, e.g., with sampled calls or dropped events.
+  const uint64_t duration_ns = end_ns > start_ns ? end_ns - start_ns : 0;
+  ReturnedCalls& children = returned_calls[depth + 1];
+  uint64_t children_duration_ns = 0;
+  if (children.duration_ns > 0 && children.begin_ns >= start_ns) {
+    children_duration_ns = std::min(children.duration_ns, duration_ns);
+  }
+  children = {};
+  ReturnedCalls& siblings = returned_calls[depth];
+  siblings.begin_ns = siblings.duration_ns == 0
+                          ? start_ns
+                          : std::min(siblings.begin_ns, start_ns);
+  siblings.duration_ns += duration_ns;
+
+  auto [it, inserted] = function_indices_.try_emplace(
+      function_address, static_cast<uint32_t>(functions_.size()));
+  if (inserted) {
+    functions_.emplace_back();
+  }
+  Function& function = functions_[it->second];
+  if (thread_index >= function.stats_by_thread.size()) {
+    function.stats_by_thread.resize(thread_index + 1);
+  }
+  for (Stats* stats :
+       {&function.total, &function.stats_by_thread[thread_index]}) {
+    stats->count += call_count;
+    stats->inclusive_time_ns += duration_ns * call_count;
+    stats->exclusive_time_ns +=
+        (duration_ns - children_duration_ns) * call_count;
+  }
+}
+
+const FunctionTimeIndex::Stats* FunctionTimeIndex::GetStats(
+    uint64_t function_address) const {
+  auto it = function_indices_.find(function_address);
+  if (it == function_indices_.end()) {
+    return nullptr;
+  }
+  return &functions_[it->second].total;
+}
+
+std::vector<std::pair<ThreadID, FunctionTimeIndex::Stats>>
+FunctionTimeIndex::GetStatsByThread(uint64_t function_address) const {
+  std::vector<std::pair<ThreadID, Stats>> stats_by_thread;
+  auto it = function_indices_.find(function_address);
+  if (it == function_indices_.end()) {
+    return stats_by_thread;
+  }
+  const std::vector<Stats>& stats = functions_[it->second].stats_by_thread;
+  for (uint32_t thread_index = 0; thread_index < stats.size();
+       ++thread_index) {
+    if (stats[thread_index].count > 0) {
+      stats_by_thread.emplace_back(thread_index_.GetThreadId(thread_index),
+                                   stats[thread_index]);
+    }
+  }
+  std::sort(stats_by_thread.begin(), stats_by_thread.end(),
+            [](const auto& a, const auto& b) {
+              return a.second.inclusive_time_ns > b.second.inclusive_time_ns;
+            });
+  return stats_by_thread;
+}
+
+void FunctionTimeIndex::Clear() {
+  thread_index_.Clear();
+  function_indices_.clear();
+  functions_.clear();
+  returned_calls_.clear();
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_FUNCTION_TIME_INDEX_H_
+#define ORBIT_CORE_FUNCTION_TIME_INDEX_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "CallstackTypes.h"
+#include "ThreadIndex.h"
+#include "absl/container/flat_hash_map.h"
+
+// The inclusive and exclusive time of the instrumented functions, in total
+// and per thread, computed as the calls are added rather than by scanning the
+// nested timers. A call is added when it returns, hence after the calls it
+// made: the calls at depth d + 1 added since the last call at depth d of a
+// thread are the children of the next call at depth d of the thread, whose
+// exclusive time is its duration minus theirs.
+//
+// The functions and the threads are numbered densely, so that the stats are
+// kept in vectors: adding a call costs two hash lookups.
+class FunctionTimeIndex {
+ public:
+  struct Stats {
+    uint64_t count = 0;
+    uint64_t inclusive_time_ns = 0;
+    uint64_t exclusive_time_ns = 0;
+  };
+
+  // call_count is the number of calls this one stands for, with sampled
+  // calls.
+  void AddCall(uint64_t function_address, ThreadID thread_id, uint32_t depth,
+               uint64_t start_ns, uint64_t end_ns, uint64_t call_count = 1);
+
+  // Null if the function wasn't called.
+  [[nodiscard]] const Stats* GetStats(uint64_t function_address) const;
+  // The threads the function was called in, by decreasing inclusive time.
+  [[nodiscard]] std::vector<std::pair<ThreadID, Stats>> GetStatsByThread(
+      uint64_t function_address) const;
+
+  void Clear();
+
+ private:
+  struct Function {
+    Stats total;
+    // By thread index.
+    std::vector<Stats> stats_by_thread;
+  };
+  // The calls at a depth of a thread that returned since the last call at
+  // the depth above, i.e., the children of the next one.
+  struct ReturnedCalls {
+    uint64_t duration_ns = 0;
+    uint64_t begin_ns = 0;
+  };
+
+  ThreadIndex thread_index_;
+  absl::flat_hash_map<uint64_t, uint32_t> function_indices_;
+  std::vector<Function> functions_;
+  // By thread index, by depth.
+  std::vector<std::vector<ReturnedCalls>> returned_calls_;
+};
+
+#endif  // ORBIT_CORE_FUNCTION_TIME_INDEX_H_
@@ -0,0 +1,78 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "FunctionTimeIndex.h"
+
+namespace {
+constexpr uint64_t kParent = 0x1000;
+constexpr uint64_t kChild = 0x2000;
+constexpr uint64_t kGrandchild = 0x3000;
+}  // namespace
+
+TEST(FunctionTimeIndex, SubtractsTheTimeOfTheChildren) {
+  FunctionTimeIndex index;
+  EXPECT_EQ(index.GetStats(kParent), nullptr);
+
+  // parent [0, 100) calls child [10, 30), which calls grandchild [15, 20),
+  // and child [40, 60). The calls are added as they return.
+  index.AddCall(kGrandchild, 1, 2, 15, 20);
+  index.AddCall(kChild, 1, 1, 10, 30);
+  index.AddCall(kChild, 1, 1, 40, 60);
+  index.AddCall(kParent, 1, 0, 0, 100);
+
+  const FunctionTimeIndex::Stats* parent = index.GetStats(kParent);
+  ASSERT_NE(parent, nullptr);
+  EXPECT_EQ(parent->count, 1);
+  EXPECT_EQ(parent->inclusive_time_ns, 100);
+  EXPECT_EQ(parent->exclusive_time_ns, 60);
+  const FunctionTimeIndex::Stats* child = index.GetStats(kChild);
+  ASSERT_NE(child, nullptr);
+  EXPECT_EQ(child->count, 2);
+  EXPECT_EQ(child->inclusive_time_ns, 40);
+  EXPECT_EQ(child->exclusive_time_ns, 35);
+  EXPECT_EQ(index.GetStats(kGrandchild)->exclusive_time_ns, 5);
+
+  // The next call of parent has no children.
+  index.AddCall(kParent, 1, 0, 200, 250);
+  EXPECT_EQ(parent->inclusive_time_ns, 150);
+  EXPECT_EQ(parent->exclusive_time_ns, 110);
+
+  index.Clear();
+  EXPECT_EQ(index.GetStats(kParent), nullptr);
+}
+
+TEST(FunctionTimeIndex, SplitsTheStatsByThread) {
+  FunctionTimeIndex index;
+  // The calls of two threads interleave.
+  index.AddCall(kChild, 1, 1, 10, 20);
+  index.AddCall(kChild, 2, 1, 10, 40);
+  index.AddCall(kParent, 1, 0, 0, 50);
+  index.AddCall(kParent, 2, 0, 5, 200, /*call_count=*/2);
+
+  const FunctionTimeIndex::Stats* parent = index.GetStats(kParent);
+  ASSERT_NE(parent, nullptr);
+  EXPECT_EQ(parent->count, 3);
+  EXPECT_EQ(parent->inclusive_time_ns, 50 + 2 * 195);
+  EXPECT_EQ(parent->exclusive_time_ns, 40 + 2 * 165);
+
+  std::vector<std::pair<ThreadID, FunctionTimeIndex::Stats>> by_thread =
+      index.GetStatsByThread(kParent);
+  ASSERT_EQ(by_thread.size(), 2);
+  EXPECT_EQ(by_thread[0].first, 2);
+  EXPECT_EQ(by_thread[0].second.count, 2);
+  EXPECT_EQ(by_thread[0].second.exclusive_time_ns, 2 * 165);
+  EXPECT_EQ(by_thread[1].first, 1);
+  EXPECT_EQ(by_thread[1].second.exclusive_time_ns, 40);
+  EXPECT_TRUE(index.GetStatsByThread(kGrandchild).empty());
+}
+
+TEST(FunctionTimeIndex, IgnoresCallsWithoutTheirParent) {
+  FunctionTimeIndex index;
+  // The parent of this call was lost.
+  index.AddCall(kChild, 1, 1, 10, 20);
+  index.AddCall(kParent, 1, 0, 30, 100);
+  EXPECT_EQ(index.GetStats(kParent)->exclusive_time_ns, 70);
+}
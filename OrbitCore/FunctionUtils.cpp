@@ -4,10 +4,12 @@
 
 #include "FunctionUtils.h"
 
+#include <algorithm>
 #include <map>
 
 #include "Capture.h"
 #include "Log.h"
+#include "OrbitBase/LogLinearHistogram.h"
 #include "OrbitBase/Logging.h"
 #include "Profiling.h"
 #include "Utils.h"
@@ -62,6 +64,15 @@ void Select(FunctionInfo* func) {
   Capture::GSelectedFunctionsMap[GetAbsoluteAddress(*func)] = func;
 }
 
+void SelectFunctions(const std::vector<FunctionInfo*>& functions) {
+  if (functions.empty()) return;
+  for (FunctionInfo* func : functions) {
+    Capture::GSelectedFunctionsMap[GetAbsoluteAddress(*func)] = func;
+  }
+  LOG("Selected %lu functions of \"%s\"", functions.size(),
+      functions[0]->loaded_module_path());
+}
+
 void UnSelect(FunctionInfo* func) {
   Capture::GSelectedFunctionsMap.erase(GetAbsoluteAddress(*func));
 }
@@ -85,6 +96,7 @@ GetFunctionNameToOrbitTypeMap() {
           {"Stop(", FunctionInfo::kOrbitTimerStop},
           {"StartAsync(", FunctionInfo::kOrbitTimerStartAsync},
           {"StopAsync(", FunctionInfo::kOrbitTimerStopAsync},
+          {"FrameMarker(", FunctionInfo::kOrbitFrameMarker},
           {"TrackInt(", FunctionInfo::kOrbitTrackInt},
           {"TrackInt64(", FunctionInfo::kOrbitTrackInt64},
           {"TrackUint(", FunctionInfo::kOrbitTrackUint},
@@ -114,10 +126,13 @@ bool SetOrbitTypeFromName(FunctionInfo* func) {
 
 void UpdateStats(FunctionInfo* func, const TimerInfo& timer_info) {
   FunctionStats* stats = func->mutable_stats();
-  stats->set_count(stats->count() + 1);
+  // With sampled calls, each call recorded stands for sampling_ratio calls.
+  const uint64_t call_count = std::max(func->sampling_ratio(), 1u);
+  stats->set_count(stats->count() + call_count);
   uint64_t elapsed_nanos =
       TicksToNanoseconds(timer_info.start(), timer_info.end());
-  stats->set_total_time_ns(stats->total_time_ns() + elapsed_nanos);
+  stats->set_total_time_ns(stats->total_time_ns() +
+                           elapsed_nanos * call_count);
   stats->set_average_time_ns(stats->total_time_ns() / stats->count());
 
   if (elapsed_nanos > stats->max_ns()) {
@@ -127,6 +142,17 @@ void UpdateStats(FunctionInfo* func, const TimerInfo& timer_info) {
   if (stats->min_ns() == 0 || elapsed_nanos < stats->min_ns()) {
     stats->set_min_ns(elapsed_nanos);
   }
+
+  // The histogram only grows up to the bucket of the longest call, so updating
+  // it is constant time and its size is bounded by BUCKET_COUNT.
+  google::protobuf::RepeatedField<uint64_t>* histogram =
+      stats->mutable_duration_histogram();
+  const int bucket_index = static_cast<int>(
+      OrbitBase::LogLinearHistogram::GetBucketIndex(elapsed_nanos));
+  if (histogram->size() <= bucket_index) {
+    histogram->Resize(bucket_index + 1, 0);
+  }
+  *histogram->Mutable(bucket_index) += call_count;
 }
 
 bool IsSelected(const SampledFunction& func) {
@@ -7,6 +7,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "SamplingProfiler.h"
 #include "ScopeTimer.h"
@@ -37,6 +38,10 @@ std::shared_ptr<orbit_client_protos::FunctionInfo> CreateFunctionInfo(
     std::string loaded_module_path, uint64_t module_base_address);
 
 void Select(orbit_client_protos::FunctionInfo* func);
+// Like Select, with one log line for all the functions, e.g., for the
+// thousands of functions of a preset.
+void SelectFunctions(
+    const std::vector<orbit_client_protos::FunctionInfo*>& functions);
 void UnSelect(orbit_client_protos::FunctionInfo* func);
 bool IsSelected(const orbit_client_protos::FunctionInfo& func);
 
@@ -0,0 +1,84 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "FunctionUtils.h"
+#include "OrbitBase/LogLinearHistogram.h"
+#include "capture_data.pb.h"
+
+using orbit_client_protos::FunctionInfo;
+using orbit_client_protos::FunctionStats;
+using orbit_client_protos::TimerInfo;
+using OrbitBase::LogLinearHistogram;
+
+namespace {
+
+TimerInfo CreateTimer(uint64_t start, uint64_t duration) {
+  TimerInfo timer_info;
+  timer_info.set_start(start);
+  timer_info.set_end(start + duration);
+  return timer_info;
+}
+
+}  // namespace
+
+TEST(FunctionUtils, UpdateStats) {
+  FunctionInfo function;
+  FunctionUtils::UpdateStats(&function, CreateTimer(100, 30));
+  FunctionUtils::UpdateStats(&function, CreateTimer(200, 10));
+  FunctionUtils::UpdateStats(&function, CreateTimer(300, 20));
+
+  const FunctionStats& stats = function.stats();
+  EXPECT_EQ(stats.count(), 3u);
+  EXPECT_EQ(stats.total_time_ns(), 60u);
+  EXPECT_EQ(stats.average_time_ns(), 20u);
+  EXPECT_EQ(stats.min_ns(), 10u);
+  EXPECT_EQ(stats.max_ns(), 30u);
+}
+
+TEST(FunctionUtils, UpdateStatsScalesSampledCalls) {
+  FunctionInfo function;
+  function.set_sampling_ratio(10);
+  FunctionUtils::UpdateStats(&function, CreateTimer(100, 30));
+  FunctionUtils::UpdateStats(&function, CreateTimer(200, 10));
+
+  const FunctionStats& stats = function.stats();
+  EXPECT_EQ(stats.count(), 20u);
+  EXPECT_EQ(stats.total_time_ns(), 400u);
+  EXPECT_EQ(stats.average_time_ns(), 20u);
+  EXPECT_EQ(stats.min_ns(), 10u);
+  EXPECT_EQ(stats.max_ns(), 30u);
+  EXPECT_EQ(stats.duration_histogram(LogLinearHistogram::GetBucketIndex(30)),
+            10u);
+}
+
+TEST(FunctionUtils, UpdateStatsFillsDurationHistogram) {
+  FunctionInfo function;
+  for (uint64_t i = 0; i < 98; ++i) {
+    FunctionUtils::UpdateStats(&function, CreateTimer(i * 10'000, 1'000));
+  }
+  FunctionUtils::UpdateStats(&function, CreateTimer(1'000'000, 50'000));
+  FunctionUtils::UpdateStats(&function, CreateTimer(2'000'000, 50'000));
+
+  const auto& histogram = function.stats().duration_histogram();
+  // The histogram ends with the bucket of the longest call.
+  ASSERT_EQ(static_cast<size_t>(histogram.size()),
+            LogLinearHistogram::GetBucketIndex(50'000) + 1);
+  EXPECT_EQ(histogram[LogLinearHistogram::GetBucketIndex(1'000)], 98u);
+  EXPECT_EQ(histogram[LogLinearHistogram::GetBucketIndex(50'000)], 2u);
+
+  const uint64_t p50 = LogLinearHistogram::ComputeQuantile(histogram, 0.5)
+                           .value();
+  EXPECT_GE(p50, LogLinearHistogram::GetBucketLowerBound(
+                     LogLinearHistogram::GetBucketIndex(1'000)));
+  EXPECT_LE(p50, LogLinearHistogram::GetBucketUpperBound(
+                     LogLinearHistogram::GetBucketIndex(1'000)));
+  const uint64_t p99 = LogLinearHistogram::ComputeQuantile(histogram, 0.99)
+                           .value();
+  EXPECT_GE(p99, LogLinearHistogram::GetBucketLowerBound(
+                     LogLinearHistogram::GetBucketIndex(50'000)));
+  EXPECT_LE(p99, LogLinearHistogram::GetBucketUpperBound(
+                     LogLinearHistogram::GetBucketIndex(50'000)));
+}
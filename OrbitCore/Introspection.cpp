@@ -17,7 +17,7 @@
 namespace orbit::tracing {
 
 // Instantiate tracing handler. On Linux, see OrbitTracing.cpp.
-std::unique_ptr<Handler> GHandler;
+std::atomic<Handler*> GHandler = nullptr;
 
 }  // namespace orbit::tracing
 #endif
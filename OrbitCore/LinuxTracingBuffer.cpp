@@ -4,6 +4,7 @@
 
 #include "LinuxTracingBuffer.h"
 
+#include <iterator>
 #include <utility>
 
 #include "KeyAndString.h"
@@ -11,30 +12,30 @@
 using orbit_client_protos::CallstackEvent;
 using orbit_client_protos::LinuxAddressInfo;
 
+namespace {
+// The records dequeued at once by ReadAll and Clear.
+constexpr size_t kDequeueBulkSize = 1024;
+}  // namespace
+
 void LinuxTracingBuffer::RecordTimer(Timer&& timer) {
-  absl::MutexLock lock(&timer_buffer_mutex_);
-  timer_buffer_.emplace_back(std::move(timer));
+  timer_buffer_.enqueue(std::move(timer));
 }
 
 void LinuxTracingBuffer::RecordCallstack(LinuxCallstackEvent&& callstack) {
-  absl::MutexLock lock(&callstack_buffer_mutex_);
-  callstack_buffer_.emplace_back(std::move(callstack));
+  callstack_buffer_.enqueue(std::move(callstack));
 }
 
 void LinuxTracingBuffer::RecordHashedCallstack(
     CallstackEvent&& hashed_callstack) {
-  absl::MutexLock lock(&hashed_callstack_buffer_mutex_);
-  hashed_callstack_buffer_.emplace_back(std::move(hashed_callstack));
+  hashed_callstack_buffer_.enqueue(std::move(hashed_callstack));
 }
 
 void LinuxTracingBuffer::RecordAddressInfo(LinuxAddressInfo&& address_info) {
-  absl::MutexLock lock(&address_info_buffer_mutex_);
-  address_info_buffer_.emplace_back(std::move(address_info));
+  address_info_buffer_.enqueue(std::move(address_info));
 }
 
 void LinuxTracingBuffer::RecordKeyAndString(KeyAndString&& key_and_string) {
-  absl::MutexLock lock(&key_and_string_buffer_mutex_);
-  key_and_string_buffer_.emplace_back(std::move(key_and_string));
+  key_and_string_buffer_.enqueue(std::move(key_and_string));
 }
 
 void LinuxTracingBuffer::RecordKeyAndString(uint64_t key, std::string str) {
@@ -42,108 +43,70 @@ void LinuxTracingBuffer::RecordKeyAndString(uint64_t key, std::string str) {
 }
 
 void LinuxTracingBuffer::RecordThreadName(TidAndThreadName&& tid_and_name) {
-  absl::MutexLock lock(&thread_name_buffer_mutex_);
-  thread_name_buffer_.emplace_back(std::move(tid_and_name));
+  thread_name_buffer_.enqueue(std::move(tid_and_name));
 }
 
 void LinuxTracingBuffer::RecordThreadName(int32_t tid, std::string name) {
   RecordThreadName({tid, std::move(name)});
 }
 
-bool LinuxTracingBuffer::ReadAllTimers(std::vector<Timer>* out_buffer) {
-  absl::MutexLock lock(&timer_buffer_mutex_);
-  if (timer_buffer_.empty()) {
+template <typename T>
+bool LinuxTracingBuffer::ReadAll(LockFreeQueue<T>* queue,
+                                 std::vector<T>* out_buffer) {
+  std::vector<T> buffer;
+  buffer.reserve(queue->size_approx());
+  while (queue->try_dequeue_bulk(std::back_inserter(buffer),
+                                 kDequeueBulkSize) > 0) {
+  }
+  if (buffer.empty()) {
     return false;
   }
 
-  *out_buffer = std::move(timer_buffer_);
-  timer_buffer_.clear();
+  *out_buffer = std::move(buffer);
   return true;
 }
 
-bool LinuxTracingBuffer::ReadAllCallstacks(
-    std::vector<LinuxCallstackEvent>* out_buffer) {
-  absl::MutexLock lock(&callstack_buffer_mutex_);
-  if (callstack_buffer_.empty()) {
-    return false;
+template <typename T>
+void LinuxTracingBuffer::Clear(LockFreeQueue<T>* queue) {
+  std::vector<T> discarded(kDequeueBulkSize);
+  while (queue->try_dequeue_bulk(discarded.begin(), kDequeueBulkSize) > 0) {
   }
+}
 
-  *out_buffer = std::move(callstack_buffer_);
-  callstack_buffer_.clear();
-  return true;
+bool LinuxTracingBuffer::ReadAllTimers(std::vector<Timer>* out_buffer) {
+  return ReadAll(&timer_buffer_, out_buffer);
+}
+
+bool LinuxTracingBuffer::ReadAllCallstacks(
+    std::vector<LinuxCallstackEvent>* out_buffer) {
+  return ReadAll(&callstack_buffer_, out_buffer);
 }
 
 bool LinuxTracingBuffer::ReadAllHashedCallstacks(
     std::vector<CallstackEvent>* out_buffer) {
-  absl::MutexLock lock(&hashed_callstack_buffer_mutex_);
-  if (hashed_callstack_buffer_.empty()) {
-    return false;
-  }
-
-  *out_buffer = std::move(hashed_callstack_buffer_);
-  hashed_callstack_buffer_.clear();
-  return true;
+  return ReadAll(&hashed_callstack_buffer_, out_buffer);
 }
 
 bool LinuxTracingBuffer::ReadAllAddressInfos(
     std::vector<LinuxAddressInfo>* out_buffer) {
-  absl::MutexLock lock(&address_info_buffer_mutex_);
-  if (address_info_buffer_.empty()) {
-    return false;
-  }
-
-  *out_buffer = std::move(address_info_buffer_);
-  address_info_buffer_.clear();
-  return true;
+  return ReadAll(&address_info_buffer_, out_buffer);
 }
 
 bool LinuxTracingBuffer::ReadAllKeysAndStrings(
     std::vector<KeyAndString>* out_buffer) {
-  absl::MutexLock lock(&key_and_string_buffer_mutex_);
-  if (key_and_string_buffer_.empty()) {
-    return false;
-  }
-
-  *out_buffer = std::move(key_and_string_buffer_);
-  key_and_string_buffer_.clear();
-  return true;
+  return ReadAll(&key_and_string_buffer_, out_buffer);
 }
 
 bool LinuxTracingBuffer::ReadAllThreadNames(
     std::vector<TidAndThreadName>* out_buffer) {
-  absl::MutexLock lock(&thread_name_buffer_mutex_);
-  if (thread_name_buffer_.empty()) {
-    return false;
-  }
-
-  *out_buffer = std::move(thread_name_buffer_);
-  thread_name_buffer_.clear();
-  return true;
+  return ReadAll(&thread_name_buffer_, out_buffer);
 }
 
 void LinuxTracingBuffer::Reset() {
-  {
-    absl::MutexLock lock(&timer_buffer_mutex_);
-    timer_buffer_.clear();
-  }
-  {
-    absl::MutexLock lock(&callstack_buffer_mutex_);
-    callstack_buffer_.clear();
-  }
-  {
-    absl::MutexLock lock(&hashed_callstack_buffer_mutex_);
-    hashed_callstack_buffer_.clear();
-  }
-  {
-    absl::MutexLock lock(&address_info_buffer_mutex_);
-    address_info_buffer_.clear();
-  }
-  {
-    absl::MutexLock lock(&key_and_string_buffer_mutex_);
-    key_and_string_buffer_.clear();
-  }
-  {
-    absl::MutexLock lock(&thread_name_buffer_mutex_);
-    thread_name_buffer_.clear();
-  }
+  Clear(&timer_buffer_);
+  Clear(&callstack_buffer_);
+  Clear(&hashed_callstack_buffer_);
+  Clear(&address_info_buffer_);
+  Clear(&key_and_string_buffer_);
+  Clear(&thread_name_buffer_);
 }
@@ -11,12 +11,17 @@
 #include "LinuxCallstackEvent.h"
 #include "ScopeTimer.h"
 #include "StringManager.h"
+#include "Threading.h"
 #include "TidAndThreadName.h"
-#include "absl/synchronization/mutex.h"
 #include "capture_data.pb.h"
 
 // This class buffers tracing data to be sent to the client
 // and provides thread-safe access and record functions.
+//
+// The buffers are lock-free queues, which keep a sub-queue per producer
+// thread, so that the threads recording, e.g., all the instrumented threads
+// for introspection, don't wait for each other. The records of a thread are
+// read in order, those of different threads in no particular order.
 class LinuxTracingBuffer {
  public:
   LinuxTracingBuffer() = default;
@@ -36,8 +41,8 @@ class LinuxTracingBuffer {
   void RecordThreadName(TidAndThreadName&& tid_and_name);
   void RecordThreadName(int32_t tid, std::string name);
 
-  // These move the content of the corresponding buffer to the output vector.
-  // They return true if the buffer was not empty.
+  // These move the content of the corresponding buffer to the output vector,
+  // replacing its content. They return true if the buffer was not empty.
   bool ReadAllTimers(std::vector<Timer>* out_buffer);
   bool ReadAllCallstacks(std::vector<LinuxCallstackEvent>* out_buffer);
   bool ReadAllHashedCallstacks(
@@ -50,24 +55,18 @@ class LinuxTracingBuffer {
   void Reset();
 
  private:
-  // Buffering data to send large messages instead of small ones.
-  absl::Mutex timer_buffer_mutex_;
-  std::vector<Timer> timer_buffer_;
-
-  absl::Mutex callstack_buffer_mutex_;
-  std::vector<LinuxCallstackEvent> callstack_buffer_;
-
-  absl::Mutex hashed_callstack_buffer_mutex_;
-  std::vector<orbit_client_protos::CallstackEvent> hashed_callstack_buffer_;
+  template <typename T>
+  static bool ReadAll(LockFreeQueue<T>* queue, std::vector<T>* out_buffer);
+  template <typename T>
+  static void Clear(LockFreeQueue<T>* queue);
 
-  absl::Mutex address_info_buffer_mutex_;
-  std::vector<orbit_client_protos::LinuxAddressInfo> address_info_buffer_;
-
-  absl::Mutex key_and_string_buffer_mutex_;
-  std::vector<KeyAndString> key_and_string_buffer_;
-
-  absl::Mutex thread_name_buffer_mutex_;
-  std::vector<TidAndThreadName> thread_name_buffer_;
+  // Buffering data to send large messages instead of small ones.
+  LockFreeQueue<Timer> timer_buffer_;
+  LockFreeQueue<LinuxCallstackEvent> callstack_buffer_;
+  LockFreeQueue<orbit_client_protos::CallstackEvent> hashed_callstack_buffer_;
+  LockFreeQueue<orbit_client_protos::LinuxAddressInfo> address_info_buffer_;
+  LockFreeQueue<KeyAndString> key_and_string_buffer_;
+  LockFreeQueue<TidAndThreadName> thread_name_buffer_;
 };
 
 #endif  // ORBIT_CORE_LINUX_TRACING_BUFFER_H_
@@ -5,7 +5,9 @@
 #include <gmock/gmock-matchers.h>
 #include <gtest/gtest.h>
 
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include "LinuxTracingBuffer.h"
 
@@ -427,3 +429,35 @@ TEST(LinuxTracingBuffer, Reset) {
   std::vector<TidAndThreadName> thread_names;
   EXPECT_FALSE(buffer.ReadAllThreadNames(&thread_names));
 }
+
+TEST(LinuxTracingBuffer, ConcurrentProducers) {
+  LinuxTracingBuffer buffer;
+  constexpr int32_t kThreadCount = 8;
+  constexpr uint64_t kTimerCountPerThread = 10'000;
+
+  std::vector<std::thread> threads;
+  for (int32_t tid = 0; tid < kThreadCount; ++tid) {
+    threads.emplace_back([&buffer, tid] {
+      for (uint64_t i = 0; i < kTimerCountPerThread; ++i) {
+        Timer timer;
+        timer.m_TID = tid;
+        timer.m_Start = i;
+        buffer.RecordTimer(std::move(timer));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<Timer> timers;
+  EXPECT_TRUE(buffer.ReadAllTimers(&timers));
+  ASSERT_EQ(timers.size(), kThreadCount * kTimerCountPerThread);
+  // The timers of each thread are in order.
+  std::vector<uint64_t> next_start_by_thread(kThreadCount, 0);
+  for (const Timer& timer : timers) {
+    ASSERT_EQ(timer.m_Start, next_start_by_thread[timer.m_TID]);
+    ++next_start_by_thread[timer.m_TID];
+  }
+  EXPECT_FALSE(buffer.ReadAllTimers(&timers));
+}
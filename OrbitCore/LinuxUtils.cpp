@@ -8,6 +8,8 @@
 #include <asm/unistd.h>
 #include <cxxabi.h>
 #include <dirent.h>
+#include <elf.h>
+#include <fcntl.h>
 #include <linux/limits.h>
 #include <linux/perf_event.h>
 #include <linux/types.h>
@@ -23,6 +25,7 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <array>
 #include <charconv>
 #include <cstdlib>
 #include <fstream>
@@ -45,6 +48,43 @@ namespace LinuxUtils {
 
 using ::ElfUtils::ElfFile;
 
+namespace {
+ErrorMessageOr<std::string> ReadBuildId(const std::string& file_path) {
+  ErrorMessageOr<std::unique_ptr<ElfFile>> elf_file =
+      ElfFile::Create(file_path);
+  if (!elf_file) return elf_file.error();
+  return elf_file.value()->GetBuildId();
+}
+}  // namespace
+
+//-----------------------------------------------------------------------------
+ErrorMessageOr<std::string> ModuleBuildIdCache::GetBuildId(
+    const std::string& file_path, const struct stat& file_stat) {
+  const int64_t modification_time_ns =
+      static_cast<int64_t>(file_stat.st_mtim.tv_sec) * 1'000'000'000 +
+      file_stat.st_mtim.tv_nsec;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = entries_.find(file_path);
+    if (it != entries_.end() && it->second.inode == file_stat.st_ino &&
+        it->second.size == file_stat.st_size &&
+        it->second.modification_time_ns == modification_time_ns) {
+      return it->second.build_id;
+    }
+  }
+
+  // Not holding the lock while the file is read.
+  Entry entry;
+  entry.inode = file_stat.st_ino;
+  entry.size = file_stat.st_size;
+  entry.modification_time_ns = modification_time_ns;
+  entry.build_id = ReadBuildId(file_path);
+  ErrorMessageOr<std::string> build_id = entry.build_id;
+  absl::MutexLock lock(&mutex_);
+  entries_.insert_or_assign(file_path, std::move(entry));
+  return build_id;
+}
+
 //-----------------------------------------------------------------------------
 outcome::result<std::vector<std::string>> ReadProcMaps(pid_t pid) {
   std::filesystem::path maps_path{absl::StrFormat("/proc/%d/maps", pid)};
@@ -71,7 +111,8 @@ outcome::result<std::string> ExecuteCommand(const std::string& cmd) {
   return outcome::success(result);
 }
 
-ErrorMessageOr<std::vector<ModuleInfo>> ListModules(int32_t pid) {
+ErrorMessageOr<std::vector<ModuleInfo>> ListModules(
+    int32_t pid, ModuleBuildIdCache* build_id_cache) {
   struct AddressRange {
     uint64_t start_address;
     uint64_t end_address;
@@ -118,26 +159,28 @@ ErrorMessageOr<std::vector<ModuleInfo>> ListModules(int32_t pid) {
   for (const auto& [module_path, address_range] : address_map) {
     // Filter out entries which are not executable
     if (!address_range.is_executable) continue;
-    if (!Path::FileExists(module_path)) continue;
-    uint64_t file_size = Path::FileSize(module_path);
-    if (file_size == 0) continue;
-
-    ErrorMessageOr<std::unique_ptr<ElfFile>> elf_file =
-        ElfFile::Create(module_path);
-    if (!elf_file) {
+    struct stat file_stat;
+    if (stat(module_path.c_str(), &file_stat) != 0) continue;
+    if (file_stat.st_size == 0) continue;
+
+    ErrorMessageOr<std::string> build_id =
+        build_id_cache != nullptr
+            ? build_id_cache->GetBuildId(module_path, file_stat)
+            : ReadBuildId(module_path);
+    if (!build_id) {
       // TODO: Shouldn't this result in ErrorMessage?
       ERROR("Unable to load module \"%s\": %s - will ignore.", module_path,
-            elf_file.error().message());
+            build_id.error().message());
       continue;
     }
 
     ModuleInfo module_info;
     module_info.set_name(Path::GetFileName(module_path));
     module_info.set_file_path(module_path);
-    module_info.set_file_size(file_size);
+    module_info.set_file_size(file_stat.st_size);
     module_info.set_address_start(address_range.start_address);
     module_info.set_address_end(address_range.end_address);
-    module_info.set_build_id(elf_file.value()->GetBuildId());
+    module_info.set_build_id(std::move(build_id.value()));
 
     result.push_back(module_info);
   }
@@ -167,11 +210,25 @@ outcome::result<std::unordered_map<pid_t, double>> GetCpuUtilization() {
 
 //-----------------------------------------------------------------------------
 outcome::result<bool> Is64Bit(pid_t pid) {
-  // TODO(161196904) Do this in a more reliable way. It does not work for a lot
-  // of processes
-  OUTCOME_TRY(result,
-              ExecuteCommand(absl::StrFormat("file -L /proc/%d/exe", pid)));
-  return absl::StrContains(result, "64-bit");
+  // Only the identification bytes of the ELF header of the executable are
+  // read. The processes without an executable, e.g., kernel threads, are not
+  // 64-bit.
+  std::string exe_path = absl::StrFormat("/proc/%d/exe", pid);
+  int fd = open(exe_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  std::array<unsigned char, EI_NIDENT> ident{};
+  ssize_t read_size = pread(fd, ident.data(), ident.size(), 0);
+  int read_errno = errno;
+  close(fd);
+  if (read_size < 0) {
+    return outcome::failure(static_cast<std::errc>(read_errno));
+  }
+  if (read_size < EI_NIDENT || memcmp(ident.data(), ELFMAG, SELFMAG) != 0) {
+    return false;
+  }
+  return ident[EI_CLASS] == ELFCLASS64;
 }
 
 //-----------------------------------------------------------------------------
@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include <sys/stat.h>
+
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <memory>
@@ -14,13 +17,42 @@
 
 #include "BaseTypes.h"
 #include "OrbitBase/Result.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
 #include "module.pb.h"
 
 //-----------------------------------------------------------------------------
 namespace LinuxUtils {
+
+// The build ids of module files by path, so that ListModules only opens the
+// ELF file of a module again once its inode, size or modification time
+// changed. Thread-safe.
+class ModuleBuildIdCache {
+ public:
+  // An empty build id for an ELF file without one, an error for a file that
+  // is not an ELF file.
+  [[nodiscard]] ErrorMessageOr<std::string> GetBuildId(
+      const std::string& file_path, const struct stat& file_stat);
+
+ private:
+  struct Entry {
+    uint64_t inode = 0;
+    int64_t size = 0;
+    int64_t modification_time_ns = 0;
+    ErrorMessageOr<std::string> build_id = std::string{};
+  };
+
+  absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, Entry> entries_ ABSL_GUARDED_BY(mutex_);
+};
+
 outcome::result<std::string> ExecuteCommand(const std::string& cmd);
 outcome::result<std::vector<std::string>> ReadProcMaps(pid_t pid);
-ErrorMessageOr<std::vector<ModuleInfo>> ListModules(int32_t pid);
+// The executable file mappings of the process. With a build_id_cache, the ELF
+// files that didn't change since a previous call are not opened again.
+ErrorMessageOr<std::vector<ModuleInfo>> ListModules(
+    int32_t pid, ModuleBuildIdCache* build_id_cache = nullptr);
 outcome::result<std::unordered_map<pid_t, double>> GetCpuUtilization();
 outcome::result<bool> Is64Bit(pid_t pid);
 ErrorMessageOr<std::string> GetExecutablePath(int32_t pid);
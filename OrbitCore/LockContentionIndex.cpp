@@ -0,0 +1,58 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "LockContentionIndex.h"
+
+#include <algorithm>
+
+void LockContentionIndex::AddStats(uint64_t lock_address,
+                                   CallstackID callstack_id,
+                                   uint64_t wait_count,
+                                   uint64_t total_wait_duration_ns,
+                                   uint64_t max_wait_duration_ns) {
+  stats_.insert_or_assign(
+      std::make_pair(lock_address, callstack_id),
+      Stats{wait_count, total_wait_duration_ns, max_wait_duration_ns});
+}
+
+std::vector<LockContentionIndex::Lock>
+LockContentionIndex::GetMostContendedLocks(size_t max_count) const {
+  absl::flat_hash_map<uint64_t, Lock> locks;
+  for (const auto& [key, stats] : stats_) {
+    const auto& [lock_address, callstack_id] = key;
+    Lock& lock = locks[lock_address];
+    lock.lock_address = lock_address;
+    lock.wait_count += stats.wait_count;
+    lock.total_wait_duration_ns += stats.total_wait_duration_ns;
+    lock.max_wait_duration_ns =
+        std::max(lock.max_wait_duration_ns, stats.max_wait_duration_ns);
+    if (stats.total_wait_duration_ns > lock.top_callstack_wait_duration_ns ||
+        (stats.total_wait_duration_ns == lock.top_callstack_wait_duration_ns &&
+         callstack_id < lock.top_callstack_id)) {
+      lock.top_callstack_id = callstack_id;
+      lock.top_callstack_wait_duration_ns = stats.total_wait_duration_ns;
+    }
+  }
+
+  std::vector<Lock> sorted_locks;
+  sorted_locks.reserve(locks.size());
+  for (const auto& [unused_lock_address, lock] : locks) {
+    sorted_locks.push_back(lock);
+  }
+  // Ties by address, so that the order doesn't depend on the hash map.
+  auto by_wait = [](const Lock& lhs, const Lock& rhs) {
+    if (lhs.total_wait_duration_ns != rhs.total_wait_duration_ns) {
+      return lhs.total_wait_duration_ns > rhs.total_wait_duration_ns;
+    }
+    return lhs.lock_address < rhs.lock_address;
+  };
+  if (sorted_locks.size() > max_count) {
+    std::partial_sort(sorted_locks.begin(), sorted_locks.begin() + max_count,
+                      sorted_locks.end(), by_wait);
+    sorted_locks.resize(max_count);
+  } else {
+    std::sort(sorted_locks.begin(), sorted_locks.end(), by_wait);
+  }
+  return sorted_locks;
+}
@@ -0,0 +1,52 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_LOCK_CONTENTION_INDEX_H_
+#define ORBIT_CORE_LOCK_CONTENTION_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "CallstackTypes.h"
+#include "absl/container/flat_hash_map.h"
+
+// The futex waits of the target process per lock, from the stats that the
+// service aggregates per lock and callstack. As the service sends the totals
+// since the beginning of the capture, the latest stats of a lock and
+// callstack replace the previous ones.
+class LockContentionIndex {
+ public:
+  struct Lock {
+    uint64_t lock_address = 0;
+    uint64_t wait_count = 0;
+    uint64_t total_wait_duration_ns = 0;
+    uint64_t max_wait_duration_ns = 0;
+    // The callstack with the longest total wait on the lock.
+    CallstackID top_callstack_id = 0;
+    uint64_t top_callstack_wait_duration_ns = 0;
+  };
+
+  void AddStats(uint64_t lock_address, CallstackID callstack_id,
+                uint64_t wait_count, uint64_t total_wait_duration_ns,
+                uint64_t max_wait_duration_ns);
+  void Clear() { stats_.clear(); }
+  [[nodiscard]] bool IsEmpty() const { return stats_.empty(); }
+
+  // The locks with the longest total wait first, at most max_count of them.
+  [[nodiscard]] std::vector<Lock> GetMostContendedLocks(
+      size_t max_count) const;
+
+ private:
+  struct Stats {
+    uint64_t wait_count = 0;
+    uint64_t total_wait_duration_ns = 0;
+    uint64_t max_wait_duration_ns = 0;
+  };
+
+  absl::flat_hash_map<std::pair<uint64_t, CallstackID>, Stats> stats_;
+};
+
+#endif  // ORBIT_CORE_LOCK_CONTENTION_INDEX_H_
@@ -0,0 +1,47 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "LockContentionIndex.h"
+
+TEST(LockContentionIndex, AggregatesCallstacksPerLock) {
+  LockContentionIndex index;
+  EXPECT_TRUE(index.IsEmpty());
+  index.AddStats(0x1000, 1, 2, 300, 200);
+  index.AddStats(0x1000, 2, 1, 500, 500);
+  index.AddStats(0x2000, 1, 10, 1000, 150);
+
+  std::vector<LockContentionIndex::Lock> locks =
+      index.GetMostContendedLocks(10);
+  ASSERT_EQ(locks.size(), 2);
+  EXPECT_EQ(locks[0].lock_address, 0x2000);
+  EXPECT_EQ(locks[0].wait_count, 10);
+  EXPECT_EQ(locks[0].top_callstack_id, 1);
+  EXPECT_EQ(locks[1].lock_address, 0x1000);
+  EXPECT_EQ(locks[1].wait_count, 3);
+  EXPECT_EQ(locks[1].total_wait_duration_ns, 800);
+  EXPECT_EQ(locks[1].max_wait_duration_ns, 500);
+  EXPECT_EQ(locks[1].top_callstack_id, 2);
+  EXPECT_EQ(locks[1].top_callstack_wait_duration_ns, 500);
+}
+
+TEST(LockContentionIndex, LatestStatsReplacePreviousOnes) {
+  LockContentionIndex index;
+  index.AddStats(0x1000, 1, 1, 100, 100);
+  index.AddStats(0x2000, 1, 1, 150, 150);
+  index.AddStats(0x1000, 1, 2, 300, 200);
+
+  std::vector<LockContentionIndex::Lock> locks = index.GetMostContendedLocks(1);
+  ASSERT_EQ(locks.size(), 1);
+  EXPECT_EQ(locks[0].lock_address, 0x1000);
+  EXPECT_EQ(locks[0].wait_count, 2);
+  EXPECT_EQ(locks[0].total_wait_duration_ns, 300);
+
+  index.Clear();
+  EXPECT_TRUE(index.IsEmpty());
+  EXPECT_TRUE(index.GetMostContendedLocks(1).empty());
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "OrbitBase/Logging.h"
+#include "OrbitBase/SafeStrerror.h"
+#include "absl/strings/str_format.h"
+
+ErrorMessageOr<std::unique_ptr<MappedFile>> MappedFile::Open(
+    const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return ErrorMessage(absl::StrFormat("Unable to open \"%s\": %s", path,
+                                        SafeStrerror(errno)));
+  }
+
+  struct stat file_stat {};
+  if (fstat(fd, &file_stat) != 0) {
+    std::string error = SafeStrerror(errno);
+    close(fd);
+    return ErrorMessage(
+        absl::StrFormat("Unable to stat \"%s\": %s", path, error));
+  }
+  const uint64_t size = file_stat.st_size;
+  if (size == 0) {
+    close(fd);
+    return std::unique_ptr<MappedFile>(new MappedFile(nullptr, 0));
+  }
+
+  // The mapping stays valid after the file descriptor is closed.
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  std::string error = data == MAP_FAILED ? SafeStrerror(errno) : "";
+  close(fd);
+  if (data == MAP_FAILED) {
+    return ErrorMessage(
+        absl::StrFormat("Unable to map \"%s\": %s", path, error));
+  }
+  return std::unique_ptr<MappedFile>(
+      new MappedFile(static_cast<const char*>(data), size));
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr && munmap(const_cast<char*>(data_), size_) != 0) {
+    ERROR("Unmapping file: %s", SafeStrerror(errno));
+  }
+}
+
+void MappedFile::Release(uint64_t offset, uint64_t size) const {
+  static const uint64_t page_size = sysconf(_SC_PAGESIZE);
+  const uint64_t end = std::min(offset + size, size_);
+  // Only the pages entirely in the range, which the caller is done with.
+  const uint64_t first_page_offset =
+      (offset + page_size - 1) / page_size * page_size;
+  const uint64_t last_page_end =
+      end == size_ ? end : end / page_size * page_size;
+  if (first_page_offset >= last_page_end) {
+    return;
+  }
+  madvise(const_cast<char*>(data_) + first_page_offset,
+          last_page_end - first_page_offset, MADV_DONTNEED);
+}
@@ -0,0 +1,41 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_MAPPED_FILE_H_
+#define ORBIT_CORE_MAPPED_FILE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "OrbitBase/Result.h"
+
+// A file mapped read-only into memory. The pages of the file are only read
+// when they are accessed, and, as they are never dirty, they cost no memory
+// once released: the kernel reads them again if they are accessed again.
+class MappedFile {
+ public:
+  static ErrorMessageOr<std::unique_ptr<MappedFile>> Open(
+      const std::string& path);
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+
+  [[nodiscard]] const char* data() const { return data_; }
+  [[nodiscard]] uint64_t size() const { return size_; }
+
+  // Releases the pages that are entirely in [offset, offset + size), which
+  // stop counting towards the memory of the process. They can still be
+  // accessed.
+  void Release(uint64_t offset, uint64_t size) const;
+
+ private:
+  MappedFile(const char* data, uint64_t size) : data_(data), size_(size) {}
+
+  const char* data_;
+  uint64_t size_;
+};
+
+#endif  // ORBIT_CORE_MAPPED_FILE_H_
@@ -0,0 +1,63 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+
+#include "MappedFile.h"
+
+namespace {
+
+std::string WriteTemporaryFile(const std::string& contents) {
+  char path[] = "/tmp/MappedFileTestXXXXXX";
+  int fd = mkstemp(path);
+  EXPECT_NE(fd, -1);
+  close(fd);
+  std::ofstream file(path, std::ios::binary);
+  file << contents;
+  return path;
+}
+
+}  // namespace
+
+TEST(MappedFile, MapsContents) {
+  const std::string contents(3 * 4096 + 17, 'a');
+  std::string path = WriteTemporaryFile(contents);
+
+  auto mapped_file = MappedFile::Open(path);
+  ASSERT_TRUE(mapped_file) << mapped_file.error().message();
+  ASSERT_EQ(mapped_file.value()->size(), contents.size());
+  EXPECT_EQ(std::string(mapped_file.value()->data(),
+                        mapped_file.value()->size()),
+            contents);
+
+  // Released pages are read again from the file when accessed.
+  mapped_file.value()->Release(0, contents.size());
+  EXPECT_EQ(std::string(mapped_file.value()->data(),
+                        mapped_file.value()->size()),
+            contents);
+
+  unlink(path.c_str());
+}
+
+TEST(MappedFile, EmptyFile) {
+  std::string path = WriteTemporaryFile("");
+
+  auto mapped_file = MappedFile::Open(path);
+  ASSERT_TRUE(mapped_file) << mapped_file.error().message();
+  EXPECT_EQ(mapped_file.value()->size(), 0);
+
+  unlink(path.c_str());
+}
+
+TEST(MappedFile, MissingFile) {
+  auto mapped_file = MappedFile::Open("/non/existing/file");
+  ASSERT_FALSE(mapped_file);
+  EXPECT_NE(mapped_file.error().message().find("/non/existing/file"),
+            std::string::npos);
+}
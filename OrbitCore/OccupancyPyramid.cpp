@@ -0,0 +1,86 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "OccupancyPyramid.h"
+
+#include <algorithm>
+
+OccupancyPyramid::OccupancyPyramid(uint64_t base_bucket_ns) {
+  uint64_t bucket_ns = std::max<uint64_t>(base_bucket_ns, 1);
+  for (uint64_t& level_bucket_ns : bucket_ns_by_level_) {
+    level_bucket_ns = bucket_ns;
+    bucket_ns *= LEVEL_FAN_OUT;
+  }
+}
+
+void OccupancyPyramid::AddSlice(uint64_t begin_ns, uint64_t end_ns) {
+  if (end_ns <= begin_ns) return;
+  for (size_t level_index = 0; level_index < LEVEL_COUNT; ++level_index) {
+    const uint64_t bucket_ns = bucket_ns_by_level_[level_index];
+    const uint64_t first_index = begin_ns / bucket_ns;
+    const uint64_t last_index = (end_ns - 1) / bucket_ns;
+
+    // Extends the buckets of the level to [first_index, last_index].
+    Level& level = levels_[level_index];
+    if (level.busy_ns.empty()) {
+      level.first_bucket_index = first_index;
+    } else if (first_index < level.first_bucket_index) {
+      level.busy_ns.insert(level.busy_ns.begin(),
+                           level.first_bucket_index - first_index, 0);
+      level.first_bucket_index = first_index;
+    }
+    const uint64_t bucket_count = last_index - level.first_bucket_index + 1;
+    if (level.busy_ns.size() < bucket_count) {
+      level.busy_ns.resize(bucket_count, 0);
+    }
+
+    for (uint64_t index = first_index; index <= last_index; ++index) {
+      const uint64_t bucket_begin_ns = index * bucket_ns;
+      const uint64_t overlap_ns =
+          std::min(end_ns, bucket_begin_ns + bucket_ns) -
+          std::max(begin_ns, bucket_begin_ns);
+      level.busy_ns[index - level.first_bucket_index] += overlap_ns;
+    }
+  }
+}
+
+void OccupancyPyramid::Clear() {
+  for (Level& level : levels_) {
+    level.first_bucket_index = 0;
+    level.busy_ns.clear();
+  }
+}
+
+uint64_t OccupancyPyramid::GetBusyNs(size_t level,
+                                     uint64_t bucket_index) const {
+  const Level& level_buckets = levels_[level];
+  if (bucket_index < level_buckets.first_bucket_index) return 0;
+  const uint64_t offset = bucket_index - level_buckets.first_bucket_index;
+  if (offset >= level_buckets.busy_ns.size()) return 0;
+  return level_buckets.busy_ns[offset];
+}
+
+double OccupancyPyramid::GetOccupancy(uint64_t begin_ns,
+                                      uint64_t end_ns) const {
+  if (end_ns <= begin_ns) return 0;
+  const uint64_t duration_ns = end_ns - begin_ns;
+  size_t level = 0;
+  while (level + 1 < LEVEL_COUNT &&
+         2 * bucket_ns_by_level_[level + 1] <= duration_ns) {
+    ++level;
+  }
+
+  const uint64_t bucket_ns = bucket_ns_by_level_[level];
+  const uint64_t first_index = begin_ns / bucket_ns;
+  const uint64_t last_index = (end_ns - 1) / bucket_ns;
+  double busy_ns = 0;
+  for (uint64_t index = first_index; index <= last_index; ++index) {
+    const uint64_t bucket_begin_ns = index * bucket_ns;
+    const uint64_t overlap_ns = std::min(end_ns, bucket_begin_ns + bucket_ns) -
+                                std::max(begin_ns, bucket_begin_ns);
+    busy_ns += static_cast<double>(GetBusyNs(level, index)) * overlap_ns /
+               bucket_ns;
+  }
+  return std::min(busy_ns / duration_ns, 1.0);
+}
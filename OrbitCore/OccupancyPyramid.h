@@ -0,0 +1,49 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_OCCUPANCY_PYRAMID_H_
+#define ORBIT_CORE_OCCUPANCY_PYRAMID_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// The time a core or a thread is busy, summed in buckets of time at several
+// resolutions, so that the occupancy of a range is computed from a few
+// buckets however many slices it contains. Level l splits time into buckets
+// of base_bucket_ns * LEVEL_FAN_OUT^l nanoseconds. Slices can be added in any
+// order, but those of the same core or thread are not expected to overlap.
+class OccupancyPyramid {
+ public:
+  static constexpr size_t LEVEL_COUNT = 8;
+  static constexpr uint64_t LEVEL_FAN_OUT = 4;
+
+  explicit OccupancyPyramid(uint64_t base_bucket_ns);
+
+  void AddSlice(uint64_t begin_ns, uint64_t end_ns);
+  void Clear();
+
+  [[nodiscard]] uint64_t GetBucketNs(size_t level) const {
+    return bucket_ns_by_level_[level];
+  }
+  // The time spent in slices during the bucket of level that starts at
+  // bucket_index * GetBucketNs(level).
+  [[nodiscard]] uint64_t GetBusyNs(size_t level, uint64_t bucket_index) const;
+  // The fraction of [begin_ns, end_ns) spent in slices, from the coarsest
+  // level whose buckets fit in the range at least twice. The time in the
+  // buckets partly in the range is counted in proportion to the overlap.
+  [[nodiscard]] double GetOccupancy(uint64_t begin_ns, uint64_t end_ns) const;
+
+ private:
+  struct Level {
+    uint64_t first_bucket_index = 0;
+    std::deque<uint64_t> busy_ns;
+  };
+
+  std::array<uint64_t, LEVEL_COUNT> bucket_ns_by_level_;
+  std::array<Level, LEVEL_COUNT> levels_;
+};
+
+#endif  // ORBIT_CORE_OCCUPANCY_PYRAMID_H_
@@ -0,0 +1,42 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "OccupancyPyramid.h"
+
+TEST(OccupancyPyramid, SumsSlicesInBucketsOfEachLevel) {
+  OccupancyPyramid pyramid(10);
+  EXPECT_EQ(pyramid.GetBucketNs(0), 10);
+  EXPECT_EQ(pyramid.GetBucketNs(1), 40);
+
+  pyramid.AddSlice(15, 35);
+  // Before the first slice.
+  pyramid.AddSlice(2, 4);
+
+  EXPECT_EQ(pyramid.GetBusyNs(0, 0), 2);
+  EXPECT_EQ(pyramid.GetBusyNs(0, 1), 5);
+  EXPECT_EQ(pyramid.GetBusyNs(0, 2), 10);
+  EXPECT_EQ(pyramid.GetBusyNs(0, 3), 5);
+  EXPECT_EQ(pyramid.GetBusyNs(0, 4), 0);
+  EXPECT_EQ(pyramid.GetBusyNs(1, 0), 22);
+  EXPECT_EQ(pyramid.GetBusyNs(OccupancyPyramid::LEVEL_COUNT - 1, 0), 22);
+
+  pyramid.Clear();
+  EXPECT_EQ(pyramid.GetBusyNs(0, 2), 0);
+  EXPECT_EQ(pyramid.GetOccupancy(0, 100), 0);
+}
+
+TEST(OccupancyPyramid, GetOccupancy) {
+  OccupancyPyramid pyramid(10);
+  pyramid.AddSlice(0, 40);
+  pyramid.AddSlice(80, 160);
+
+  EXPECT_DOUBLE_EQ(pyramid.GetOccupancy(0, 40), 1.0);
+  EXPECT_DOUBLE_EQ(pyramid.GetOccupancy(40, 80), 0.0);
+  EXPECT_DOUBLE_EQ(pyramid.GetOccupancy(0, 160), 0.75);
+  // Half of the bucket [40, 50) of level 0 and all of [80, 90).
+  EXPECT_DOUBLE_EQ(pyramid.GetOccupancy(45, 85), 0.125);
+  EXPECT_DOUBLE_EQ(pyramid.GetOccupancy(100, 100), 0.0);
+}
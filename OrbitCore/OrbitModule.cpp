@@ -45,13 +45,15 @@ Module::Module(const std::string& file_name, uint64_t address_start,
 
 //-----------------------------------------------------------------------------
 void Module::LoadSymbols(const ModuleSymbols& module_symbols) {
-  if (m_Pdb != nullptr) {
-    LOG("Warning: Module %s already contained symbols, will override now.",
-        m_Name);
-  }
+  SetPdb(CreatePdb(module_symbols));
+}
 
-  m_Pdb = std::make_shared<Pdb>(m_AddressStart, module_symbols.load_bias(),
-                                module_symbols.symbols_file_path(), m_FullName);
+//-----------------------------------------------------------------------------
+std::shared_ptr<Pdb> Module::CreatePdb(
+    const ModuleSymbols& module_symbols) const {
+  auto pdb = std::make_shared<Pdb>(m_AddressStart, module_symbols.load_bias(),
+                                   module_symbols.symbols_file_path(),
+                                   m_FullName);
 
   for (const SymbolInfo& symbol_info : module_symbols.symbol_infos()) {
     std::shared_ptr<FunctionInfo> function = FunctionUtils::CreateFunctionInfo(
@@ -59,9 +61,22 @@ void Module::LoadSymbols(const ModuleSymbols& module_symbols) {
         module_symbols.load_bias(), symbol_info.size(),
         symbol_info.source_file(), symbol_info.source_line(), m_FullName,
         m_AddressStart);
-    m_Pdb->AddFunction(function);
+    pdb->AddFunction(function);
+  }
+
+  pdb->PopulateFunctionMap();
+  pdb->PopulateStringFunctionMap();
+  return pdb;
+}
+
+//-----------------------------------------------------------------------------
+void Module::SetPdb(std::shared_ptr<Pdb> pdb) {
+  if (m_Pdb != nullptr) {
+    LOG("Warning: Module %s already contained symbols, will override now.",
+        m_Name);
   }
 
-  m_Pdb->ProcessData();
+  m_Pdb = std::move(pdb);
+  m_Pdb->AddFunctionsToProcess();
   SetLoaded(true);
 }
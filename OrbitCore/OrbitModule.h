@@ -7,6 +7,7 @@
 
 #include <memory.h>
 
+#include <memory>
 #include <string>
 
 #include "BaseTypes.h"
@@ -21,6 +22,12 @@ struct Module {
          uint64_t address_end);
 
   void LoadSymbols(const ModuleSymbols& module_symbols);
+  // LoadSymbols in two steps: CreatePdb builds the functions and their maps
+  // without modifying the module, so that it can run off the main thread,
+  // and SetPdb publishes the result.
+  [[nodiscard]] std::shared_ptr<Pdb> CreatePdb(
+      const ModuleSymbols& module_symbols) const;
+  void SetPdb(std::shared_ptr<Pdb> pdb);
   bool ContainsAddress(uint64_t a_Address) {
     return m_AddressStart <= a_Address && m_AddressEnd > a_Address;
   }
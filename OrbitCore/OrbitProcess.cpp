@@ -29,17 +29,13 @@ Process::Process() {
 //-----------------------------------------------------------------------------
 FunctionInfo* Process::GetFunctionFromAddress(uint64_t address,
                                               bool a_IsExact) {
-  if (m_Modules.empty()) {
+  const std::shared_ptr<Module>* module_ptr =
+      modules_by_address_.FindLastAtOrBefore(address);
+  if (module_ptr == nullptr) {
     return nullptr;
   }
 
-  auto it = m_Modules.upper_bound(address);
-  if (it == m_Modules.begin()) {
-    return nullptr;
-  }
-
-  --it;
-  std::shared_ptr<Module>& module = it->second;
+  const std::shared_ptr<Module>& module = *module_ptr;
   if (address >= module->m_AddressEnd) {
     return nullptr;
   }
@@ -57,17 +53,13 @@ FunctionInfo* Process::GetFunctionFromAddress(uint64_t address,
 
 //-----------------------------------------------------------------------------
 std::shared_ptr<Module> Process::GetModuleFromAddress(uint64_t a_Address) {
-  if (m_Modules.empty()) {
-    return nullptr;
-  }
-
-  auto module_it = m_Modules.upper_bound(a_Address);
-  if (module_it == m_Modules.begin()) {
+  const std::shared_ptr<Module>* module_ptr =
+      modules_by_address_.FindLastAtOrBefore(a_Address);
+  if (module_ptr == nullptr) {
     return nullptr;
   }
 
-  --module_it;
-  std::shared_ptr<Module> module = module_it->second;
+  std::shared_ptr<Module> module = *module_ptr;
   CHECK(a_Address >= module->m_AddressStart);
   if (a_Address >= module->m_AddressEnd) {
     return nullptr;
@@ -100,6 +92,7 @@ std::shared_ptr<Module> Process::GetModuleFromPath(
 //-----------------------------------------------------------------------------
 void Process::AddModule(std::shared_ptr<Module>& a_Module) {
   m_Modules[a_Module->m_AddressStart] = a_Module;
+  modules_by_address_.Assign({m_Modules.begin(), m_Modules.end()});
   m_NameToModuleMap[absl::AsciiStrToLower(a_Module->m_Name)] = a_Module;
   path_to_module_map_[a_Module->m_FullName] = a_Module;
 }
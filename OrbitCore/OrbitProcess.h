@@ -15,6 +15,7 @@
 #include "BaseTypes.h"
 #include "OrbitModule.h"
 #include "ScopeTimer.h"
+#include "SortedAddressMap.h"
 #include "Threading.h"
 #include "absl/container/flat_hash_map.h"
 #include "capture_data.pb.h"
@@ -29,6 +30,10 @@ class Process {
   std::map<std::string, std::shared_ptr<Module>>& GetNameToModulesMap() {
     return m_NameToModuleMap;
   }
+  // By start address.
+  const std::map<uint64_t, std::shared_ptr<Module>>& GetModules() const {
+    return m_Modules;
+  }
 
   void SetName(std::string_view name) { m_Name = name; }
   const std::string& GetName() const { return m_Name; }
@@ -68,6 +73,9 @@ class Process {
   Mutex m_DataMutex;
 
   std::map<uint64_t, std::shared_ptr<Module>> m_Modules;
+  // m_Modules for the lookups by address, which are made for every frame of
+  // every callstack.
+  SortedAddressMap<std::shared_ptr<Module>> modules_by_address_;
   // TODO(antonrohr) change the usage of m_NameToModuleMap to
   // path_to_module_map_, since the name of a module is not unique
   // (/usr/lib/libbase.so and /opt/somedir/libbase.so)
@@ -29,83 +29,70 @@ void Pdb::AddFunction(const std::shared_ptr<FunctionInfo>& function) {
 }
 
 //-----------------------------------------------------------------------------
-void Pdb::ProcessData() {
+void Pdb::AddFunctionsToProcess() {
   std::shared_ptr<Process> process = Capture::GTargetProcess;
   if (process == nullptr) return;
 
-  SCOPE_TIMER_LOG("ProcessData");
   ScopeLock lock(process->GetDataMutex());
-
   for (auto& func : functions_) {
     process->AddFunction(func);
   }
-
-  PopulateFunctionMap();
-  PopulateStringFunctionMap();
 }
 
 //-----------------------------------------------------------------------------
 void Pdb::PopulateFunctionMap() {
   SCOPE_TIMER_LOG("Pdb::PopulateFunctionMap");
+  std::vector<std::pair<uint64_t, FunctionInfo*>> entries;
+  entries.reserve(functions_.size());
   for (auto& function : functions_) {
-    m_FunctionMap.insert(std::make_pair(function->address(), function.get()));
+    entries.emplace_back(function->address(), function.get());
   }
+  m_FunctionMap.Assign(std::move(entries));
 }
 
 //-----------------------------------------------------------------------------
 void Pdb::PopulateStringFunctionMap() {
-  {
-    // SCOPE_TIMER_LOG("Reserving map");
-    m_StringFunctionMap.reserve(static_cast<size_t>(1.5f * functions_.size()));
-  }
-
-  {
-    // SCOPE_TIMER_LOG("Map inserts");
-    for (auto& function : functions_) {
-      m_StringFunctionMap[FunctionUtils::GetHash(*function)] = function.get();
-    }
+  m_StringFunctionMap.clear();
+  m_StringFunctionMap.reserve(functions_.size());
+  for (auto& function : functions_) {
+    m_StringFunctionMap[FunctionUtils::GetHash(*function)] = function.get();
   }
 }
 
 //-----------------------------------------------------------------------------
 FunctionInfo* Pdb::GetFunctionFromExactAddress(uint64_t a_Address) {
   uint64_t function_address = a_Address - GetHModule() + load_bias_;
-  auto it = m_FunctionMap.find(function_address);
-  return (it != m_FunctionMap.end()) ? it->second : nullptr;
+  FunctionInfo* const* function = m_FunctionMap.Find(function_address);
+  return (function != nullptr) ? *function : nullptr;
 }
 
 //-----------------------------------------------------------------------------
 FunctionInfo* Pdb::GetFunctionFromProgramCounter(uint64_t a_Address) {
-  if (m_FunctionMap.empty()) {
-    return nullptr;
-  }
-
   uint64_t relative_address = a_Address - GetHModule() + load_bias_;
-  auto it = m_FunctionMap.upper_bound(relative_address);
+  FunctionInfo* const* function =
+      m_FunctionMap.FindLastAtOrBefore(relative_address);
+  return (function != nullptr) ? *function : nullptr;
+}
 
-  if (it == m_FunctionMap.begin()) {
-    return nullptr;
+//-----------------------------------------------------------------------------
+std::vector<FunctionInfo*> Pdb::GetPresetFunctions(
+    const PresetFile& preset) const {
+  std::vector<FunctionInfo*> functions;
+  auto it = preset.preset_info().path_to_module().find(m_LoadedModuleName);
+  if (it == preset.preset_info().path_to_module().end()) return functions;
+
+  const PresetModule& preset_module = it->second;
+  functions.reserve(preset_module.function_hashes_size());
+  for (uint64_t hash : preset_module.function_hashes()) {
+    auto function_it = m_StringFunctionMap.find(hash);
+    if (function_it != m_StringFunctionMap.end()) {
+      functions.push_back(function_it->second);
+    }
   }
-
-  --it;
-  return it->second;
+  return functions;
 }
 
 //-----------------------------------------------------------------------------
 void Pdb::ApplyPreset(const PresetFile& preset) {
-  SCOPE_TIMER_LOG(absl::StrFormat("Pdb::ApplyPreset - %s", m_Name.c_str()));
-
-  std::string module_name = m_LoadedModuleName;
-  auto it = preset.preset_info().path_to_module().find(module_name);
-  if (it != preset.preset_info().path_to_module().end()) {
-    const PresetModule& preset_module = it->second;
-
-    for (uint64_t hash : preset_module.function_hashes()) {
-      auto fit = m_StringFunctionMap.find(hash);
-      if (fit != m_StringFunctionMap.end()) {
-        FunctionInfo* function = fit->second;
-        FunctionUtils::Select(function);
-      }
-    }
-  }
+  FunctionUtils::SelectFunctions(GetPresetFunctions(preset));
 }
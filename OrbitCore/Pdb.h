@@ -10,6 +10,8 @@
 #include <thread>
 #include <vector>
 
+#include "SortedAddressMap.h"
+#include "absl/container/flat_hash_map.h"
 #include "capture_data.pb.h"
 #include "preset.pb.h"
 
@@ -33,7 +35,13 @@ class Pdb {
   uint64_t GetLoadBias() const { return load_bias_; }
 
   void PopulateFunctionMap();
+  // Indexes the functions by the hash of their names, for the presets. Done
+  // once, when the symbols are loaded.
   void PopulateStringFunctionMap();
+  // The functions of this module that preset selects. Only reads the Pdb, so
+  // that the presets can be resolved on the threads loading the symbols.
+  [[nodiscard]] std::vector<orbit_client_protos::FunctionInfo*>
+  GetPresetFunctions(const orbit_client_protos::PresetFile& preset) const;
   void ApplyPreset(const orbit_client_protos::PresetFile& preset);
 
   orbit_client_protos::FunctionInfo* GetFunctionFromExactAddress(
@@ -41,7 +49,9 @@ class Pdb {
   orbit_client_protos::FunctionInfo* GetFunctionFromProgramCounter(
       uint64_t a_Address);
 
-  void ProcessData();
+  // Adds the functions to Capture::GTargetProcess. Unlike the maps, which
+  // only belong to this Pdb, this is done once the Pdb is set on its module.
+  void AddFunctionsToProcess();
 
  private:
   uint64_t m_MainModule = 0;
@@ -50,8 +60,8 @@ class Pdb {
   std::string m_FileName;          // full path of file containing the symbols
   std::string m_LoadedModuleName;  // full path of the module
   std::vector<std::shared_ptr<orbit_client_protos::FunctionInfo>> functions_;
-  std::map<uint64_t, orbit_client_protos::FunctionInfo*> m_FunctionMap;
-  std::unordered_map<unsigned long long, orbit_client_protos::FunctionInfo*>
+  SortedAddressMap<orbit_client_protos::FunctionInfo*> m_FunctionMap;
+  absl::flat_hash_map<uint64_t, orbit_client_protos::FunctionInfo*>
       m_StringFunctionMap;
 
   void SetModulePathAndAddress(orbit_client_protos::FunctionInfo* func);
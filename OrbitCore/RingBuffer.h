@@ -5,6 +5,7 @@
 #pragma once
 
 #include <cstddef>
+#include <utility>
 
 //-----------------------------------------------------------------------------
 template <class T, size_t BUFFER_SIZE>
@@ -26,6 +27,13 @@ class RingBuffer {
     ++m_CurrentSize;
   }
 
+  //-------------------------------------------------------------------------
+  inline void Add(T&& a_Item) {
+    m_Data[m_CurrentIndex++] = std::move(a_Item);
+    m_CurrentIndex %= BUFFER_SIZE;
+    ++m_CurrentSize;
+  }
+
   //-------------------------------------------------------------------------
   inline void Fill(const T& a_Item) {
     for (size_t i = 0; i < BUFFER_SIZE; ++i) {
@@ -5,6 +5,7 @@
 #include <gtest/gtest.h>
 
 #include <cstdint>
+#include <string>
 #include <utility>
 
 #include "RingBuffer.h"
@@ -48,3 +49,15 @@ TEST(RingBuffer, Contains) {
   EXPECT_TRUE(ring_buffer.Contains(2));
   EXPECT_FALSE(ring_buffer.Contains(0));
 }
+
+TEST(RingBuffer, MovesItems) {
+  RingBuffer<std::string, 2> ring_buffer;
+  std::string first = "first";
+  ring_buffer.Add(std::move(first));
+  ring_buffer.Add("second");
+  ring_buffer.Add("third");
+
+  EXPECT_EQ(ring_buffer.Size(), 2);
+  EXPECT_EQ(ring_buffer[0], "second");
+  EXPECT_EQ(ring_buffer[1], "third");
+}
@@ -0,0 +1,59 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "SamplingDiff.h"
+
+#include <string_view>
+#include <tuple>
+
+#include "absl/container/flat_hash_map.h"
+
+namespace {
+
+using FunctionKey = std::tuple<std::string_view, std::string_view, uint64_t>;
+
+FunctionKey GetFunctionKey(const SampledFunction& function) {
+  if (function.m_Name == SamplingProfiler::kUnknownFunctionOrModuleName) {
+    return {function.m_Module, function.m_Name, function.m_Address};
+  }
+  return {function.m_Module, function.m_Name, 0};
+}
+
+}  // namespace
+
+std::vector<SampledFunctionDiff> DiffSampledFunctions(
+    const std::vector<SampledFunction>& baseline,
+    const std::vector<SampledFunction>& functions) {
+  std::vector<SampledFunctionDiff> diffs;
+  diffs.reserve(baseline.size() + functions.size());
+  absl::flat_hash_map<FunctionKey, size_t> diff_indices;
+  diff_indices.reserve(baseline.size() + functions.size());
+
+  // A function might be in a report more than once, e.g., when the symbols of
+  // its module were loaded during the capture, then its percentages add up.
+  auto get_diff = [&](const SampledFunction& function) -> SampledFunctionDiff& {
+    auto [it, inserted] =
+        diff_indices.try_emplace(GetFunctionKey(function), diffs.size());
+    if (inserted) {
+      SampledFunctionDiff& diff = diffs.emplace_back();
+      diff.name = function.m_Name;
+      diff.module = function.m_Module;
+    }
+    return diffs[it->second];
+  };
+
+  for (const SampledFunction& function : baseline) {
+    SampledFunctionDiff& diff = get_diff(function);
+    diff.address = function.m_Address;
+    diff.baseline_inclusive += function.m_Inclusive;
+    diff.baseline_exclusive += function.m_Exclusive;
+  }
+  for (const SampledFunction& function : functions) {
+    SampledFunctionDiff& diff = get_diff(function);
+    diff.address = function.m_Address;
+    diff.inclusive += function.m_Inclusive;
+    diff.exclusive += function.m_Exclusive;
+  }
+  return diffs;
+}
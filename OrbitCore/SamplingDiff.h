@@ -0,0 +1,47 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_SAMPLING_DIFF_H_
+#define ORBIT_CORE_SAMPLING_DIFF_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SamplingProfiler.h"
+
+// A function of either or both of two sampling reports, with its inclusive and
+// exclusive percentages, zero in the report it isn't part of.
+struct SampledFunctionDiff {
+  std::string name;
+  std::string module;
+  // The address in the report compared to the baseline, unless the function
+  // is only part of the baseline.
+  uint64_t address = 0;
+  float baseline_inclusive = 0;
+  float inclusive = 0;
+  float baseline_exclusive = 0;
+  float exclusive = 0;
+
+  [[nodiscard]] float inclusive_delta() const {
+    return inclusive - baseline_inclusive;
+  }
+  [[nodiscard]] float exclusive_delta() const {
+    return exclusive - baseline_exclusive;
+  }
+};
+
+// Matches the functions of the two reports, e.g., of a thread in two
+// selections or in two captures, in one pass over each. Percentages rather
+// than sample counts are compared, as the two reports usually don't have the
+// same number of samples.
+//
+// Functions are matched by module and name, so that the reports of two
+// captures, in which a function usually isn't at the same address, can be
+// compared. Functions of which the name is unknown are matched by address.
+[[nodiscard]] std::vector<SampledFunctionDiff> DiffSampledFunctions(
+    const std::vector<SampledFunction>& baseline,
+    const std::vector<SampledFunction>& functions);
+
+#endif  // ORBIT_CORE_SAMPLING_DIFF_H_
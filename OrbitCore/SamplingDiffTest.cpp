@@ -0,0 +1,107 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "SamplingDiff.h"
+
+namespace {
+
+SampledFunction CreateFunction(std::string name, uint64_t address,
+                               float inclusive, float exclusive) {
+  SampledFunction function;
+  function.m_Name = std::move(name);
+  function.m_Module = "module";
+  function.m_Address = address;
+  function.m_Inclusive = inclusive;
+  function.m_Exclusive = exclusive;
+  return function;
+}
+
+const SampledFunctionDiff& FindDiff(
+    const std::vector<SampledFunctionDiff>& diffs, const std::string& name,
+    uint64_t address) {
+  auto it = std::find_if(diffs.begin(), diffs.end(),
+                         [&](const SampledFunctionDiff& diff) {
+                           return diff.name == name && diff.address == address;
+                         });
+  EXPECT_NE(it, diffs.end());
+  return *it;
+}
+
+}  // namespace
+
+TEST(SamplingDiff, MatchesFunctionsByName) {
+  const std::vector<SampledFunction> baseline = {
+      CreateFunction("main", 0x100, 100, 0),
+      CreateFunction("foo", 0x200, 60, 50),
+      CreateFunction("removed", 0x300, 10, 10),
+  };
+  // Another capture, in which the functions are at other addresses.
+  const std::vector<SampledFunction> functions = {
+      CreateFunction("main", 0x1100, 100, 0),
+      CreateFunction("foo", 0x1200, 80, 70),
+      CreateFunction("added", 0x1400, 5, 5),
+  };
+
+  const std::vector<SampledFunctionDiff> diffs =
+      DiffSampledFunctions(baseline, functions);
+  ASSERT_EQ(diffs.size(), 4);
+
+  const SampledFunctionDiff& main_diff = FindDiff(diffs, "main", 0x1100);
+  EXPECT_EQ(main_diff.inclusive_delta(), 0);
+
+  const SampledFunctionDiff& foo_diff = FindDiff(diffs, "foo", 0x1200);
+  EXPECT_EQ(foo_diff.baseline_inclusive, 60);
+  EXPECT_EQ(foo_diff.inclusive, 80);
+  EXPECT_EQ(foo_diff.inclusive_delta(), 20);
+  EXPECT_EQ(foo_diff.exclusive_delta(), 20);
+
+  const SampledFunctionDiff& removed_diff = FindDiff(diffs, "removed", 0x300);
+  EXPECT_EQ(removed_diff.inclusive_delta(), -10);
+  EXPECT_EQ(removed_diff.exclusive, 0);
+
+  const SampledFunctionDiff& added_diff = FindDiff(diffs, "added", 0x1400);
+  EXPECT_EQ(added_diff.baseline_inclusive, 0);
+  EXPECT_EQ(added_diff.inclusive_delta(), 5);
+  EXPECT_EQ(added_diff.module, "module");
+}
+
+TEST(SamplingDiff, MatchesUnknownFunctionsByAddress) {
+  const std::string& unknown = SamplingProfiler::kUnknownFunctionOrModuleName;
+  const std::vector<SampledFunction> baseline = {
+      CreateFunction(unknown, 0x100, 20, 20),
+      CreateFunction(unknown, 0x200, 30, 30),
+  };
+  const std::vector<SampledFunction> functions = {
+      CreateFunction(unknown, 0x200, 40, 40),
+  };
+
+  const std::vector<SampledFunctionDiff> diffs =
+      DiffSampledFunctions(baseline, functions);
+  ASSERT_EQ(diffs.size(), 2);
+  EXPECT_EQ(FindDiff(diffs, unknown, 0x100).inclusive_delta(), -20);
+  EXPECT_EQ(FindDiff(diffs, unknown, 0x200).inclusive_delta(), 10);
+}
+
+TEST(SamplingDiff, AddsUpFunctionsListedTwice) {
+  const std::vector<SampledFunction> baseline = {
+      CreateFunction("foo", 0x100, 10, 5),
+      CreateFunction("foo", 0x180, 20, 5),
+  };
+  const std::vector<SampledFunction> functions = {
+      CreateFunction("foo", 0x100, 40, 20),
+  };
+
+  const std::vector<SampledFunctionDiff> diffs =
+      DiffSampledFunctions(baseline, functions);
+  ASSERT_EQ(diffs.size(), 1);
+  EXPECT_EQ(diffs[0].baseline_inclusive, 30);
+  EXPECT_EQ(diffs[0].inclusive_delta(), 10);
+  EXPECT_EQ(diffs[0].exclusive_delta(), 10);
+}
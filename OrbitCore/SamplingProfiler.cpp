@@ -4,16 +4,24 @@
 
 #include "SamplingProfiler.h"
 
+#include <algorithm>
+#include <atomic>
+#include <iterator>
 #include <map>
 #include <memory>
-#include <set>
+#include <optional>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "Capture.h"
 #include "FunctionUtils.h"
 #include "Injection.h"
 #include "Log.h"
+#include "OrbitBase/ParallelFor.h"
+#include "OrbitBase/ThreadPool.h"
 #include "OrbitModule.h"
+#include "absl/container/flat_hash_map.h"
 
 using orbit_client_protos::CallstackEvent;
 using orbit_client_protos::FunctionInfo;
@@ -21,23 +29,8 @@ using orbit_client_protos::LinuxAddressInfo;
 
 namespace {
 
-std::multimap<int, CallstackID> SortCallstacks(
-    const ThreadSampleData& data, const std::set<CallstackID>& a_CallStacks,
-    int* o_TotalCallStacks) {
-  std::multimap<int, CallstackID> sortedCallstacks;
-  int numCallstacks = 0;
-  for (CallstackID id : a_CallStacks) {
-    auto it = data.m_CallstackCount.find(id);
-    if (it != data.m_CallstackCount.end()) {
-      int count = it->second;
-      sortedCallstacks.insert(std::make_pair(count, id));
-      numCallstacks += count;
-    }
-  }
-
-  *o_TotalCallStacks = numCallstacks;
-  return sortedCallstacks;
-}
+// Below this, counting the events isn't worth starting more threads.
+constexpr uint32_t kMinCallstackEventsPerChunk = 256 * 1024;
 
 void ComputeAverageThreadUsage(ThreadSampleData* data) {
   data->m_AverageThreadUsage = 0.f;
@@ -53,30 +46,158 @@ void ComputeAverageThreadUsage(ThreadSampleData* data) {
 
 }  // namespace
 
-//-----------------------------------------------------------------------------
-std::multimap<int, CallstackID> SamplingProfiler::GetCallstacksFromAddress(
-    uint64_t a_Addr, ThreadID a_TID, int* o_NumCallstacks) {
-  std::set<CallstackID>& callstacks = m_FunctionToCallstacks[a_Addr];
-  return SortCallstacks(m_ThreadSampleData[a_TID], callstacks, o_NumCallstacks);
-}
-
 //-----------------------------------------------------------------------------
 void SamplingProfiler::AddCallStack(CallstackEvent& callstack_event) {
   CallstackID hash = callstack_event.callstack_hash();
   if (!HasCallStack(hash)) {
     std::shared_ptr<CallStack> callstack =
         Capture::GSamplingProfiler->GetCallStack(hash);
-    AddUniqueCallStack(*callstack);
+    if (callstack != nullptr) {
+      absl::MutexLock lock(&unique_callstacks_mutex_);
+      AddUniqueCallStackLocked(hash, callstack->m_Data.data(),
+                               callstack->m_Data.size());
+    }
   }
 
+  absl::MutexLock lock(&unique_callstacks_mutex_);
   m_Callstacks.push_back(callstack_event);
 }
 
 //-----------------------------------------------------------------------------
-void SamplingProfiler::AddUniqueCallStack(CallStack& a_CallStack) {
+uint32_t SamplingProfiler::DropCallstackEventsBefore(uint64_t time) {
+  uint32_t num_dropped_events = 0;
+  {
+    absl::MutexLock lock(&unique_callstacks_mutex_);
+    // Events arrive mostly in order of time: those before the first one at or
+    // after time are dropped, as far as they fill whole blocks.
+    uint32_t end = 0;
+    while (end < m_Callstacks.size() && m_Callstacks[end].time() < time) {
+      ++end;
+    }
+    end -= end % kCallstackEventBlockSize;
+    if (end == 0) {
+      return 0;
+    }
+
+    absl::flat_hash_map<ThreadID, absl::flat_hash_map<CallstackID, uint32_t>>
+        dropped_counts;
+    for (uint32_t i = 0; i < end; ++i) {
+      const CallstackEvent& callstack = m_Callstacks[i];
+      ++dropped_counts[callstack.thread_id()][callstack.callstack_hash()];
+    }
+    for (auto& [thread_id, counts] : dropped_counts) {
+      callstack_counts_.emplace_back(thread_id, std::move(counts));
+    }
+    num_samples_of_callstack_counts_ += end;
+
+    num_dropped_events = m_Callstacks.DropBlocksBefore(end);
+    CHECK(num_dropped_events == end);
+    callstack_count_index_.Clear();
+    num_indexed_callstack_events_ = 0;
+  }
+
+  // The events already counted are now counted a second time, in
+  // callstack_counts_: start over.
+  absl::MutexLock lock(&thread_sample_data_mutex_);
+  ClearProcessedSamples();
+  return num_dropped_events;
+}
+
+//-----------------------------------------------------------------------------
+void SamplingProfiler::AddUniqueCallStack(CallStack callstack) {
+  const CallstackID hash = callstack.Hash();
   absl::MutexLock lock(&unique_callstacks_mutex_);
-  unique_callstacks_[a_CallStack.Hash()] =
-      std::make_shared<CallStack>(a_CallStack);
+  AddUniqueCallStackLocked(hash, callstack.m_Data.data(),
+                           callstack.m_Data.size());
+}
+
+void SamplingProfiler::AddUniqueCallStackLocked(CallstackID id,
+                                                const uint64_t* pcs,
+                                                size_t size) {
+  if (unique_callstacks_.contains(id)) return;
+  unique_callstacks_.emplace(id, callstack_trie_.Insert(pcs, size));
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<CallStack> SamplingProfiler::GetCallStack(CallstackID a_ID) {
+  absl::MutexLock lock(&unique_callstacks_mutex_);
+  auto it = unique_callstacks_.find(a_ID);
+  if (it == unique_callstacks_.end()) {
+    return nullptr;
+  }
+  auto callstack = std::make_shared<CallStack>();
+  callstack->m_Data = callstack_trie_.GetPcs(it->second);
+  callstack->m_Hash = a_ID;
+  return callstack;
+}
+
+void SamplingProfiler::ForEachUniqueCallstack(
+    const std::function<void(const CallStack&)>& action) {
+  absl::MutexLock lock(&unique_callstacks_mutex_);
+  CallStack callstack;
+  for (const auto& [callstack_id, node_id] : unique_callstacks_) {
+    callstack.m_Data = callstack_trie_.GetPcs(node_id);
+    callstack.m_Hash = callstack_id;
+    action(callstack);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void SamplingProfiler::AddCallstackCounts(
+    ThreadID thread_id,
+    const absl::flat_hash_map<CallstackID, uint32_t>& callstack_counts) {
+  absl::flat_hash_map<CallstackID, uint32_t> known_callstack_counts;
+  for (const auto& [callstack_id, count] : callstack_counts) {
+    if (!Capture::GSamplingProfiler->HasCallStack(callstack_id)) {
+      continue;
+    }
+    if (!HasCallStack(callstack_id)) {
+      std::shared_ptr<CallStack> callstack =
+          Capture::GSamplingProfiler->GetCallStack(callstack_id);
+      absl::MutexLock lock(&unique_callstacks_mutex_);
+      AddUniqueCallStackLocked(callstack_id, callstack->m_Data.data(),
+                               callstack->m_Data.size());
+    }
+    known_callstack_counts.emplace(callstack_id, count);
+    num_samples_of_callstack_counts_ += count;
+  }
+  if (!known_callstack_counts.empty()) {
+    callstack_counts_.emplace_back(thread_id,
+                                   std::move(known_callstack_counts));
+  }
+}
+
+//-----------------------------------------------------------------------------
+void SamplingProfiler::AddCallstackSampleCounts(
+    ThreadID thread_id,
+    const absl::flat_hash_map<CallstackID, uint32_t>& callstack_counts) {
+  absl::MutexLock lock(&unique_callstacks_mutex_);
+  auto [index_it, inserted] = unprocessed_callstack_counts_indices_.try_emplace(
+      thread_id, callstack_counts_.size());
+  if (inserted) {
+    callstack_counts_.emplace_back(
+        thread_id, absl::flat_hash_map<CallstackID, uint32_t>{});
+  }
+  absl::flat_hash_map<CallstackID, uint32_t>& thread_counts =
+      callstack_counts_[index_it->second].second;
+  for (const auto& [callstack_id, count] : callstack_counts) {
+    thread_counts[callstack_id] += count;
+    num_samples_of_callstack_counts_ += count;
+  }
+}
+
+//-----------------------------------------------------------------------------
+CallstackCountIndex* SamplingProfiler::GetCallstackCountIndex() {
+  if (m_Callstacks.size() < num_indexed_callstack_events_) {
+    callstack_count_index_.Clear();
+    num_indexed_callstack_events_ = 0;
+  }
+  for (uint32_t i = num_indexed_callstack_events_; i < m_Callstacks.size();
+       ++i) {
+    callstack_count_index_.AddCallstackEvent(m_Callstacks[i]);
+  }
+  num_indexed_callstack_events_ = m_Callstacks.size();
+  return &callstack_count_index_;
 }
 
 const CallStack& SamplingProfiler::GetResolvedCallstack(
@@ -97,17 +218,29 @@ SamplingProfiler::GetSortedCallstacksFromAddress(uint64_t a_Addr,
                                                  ThreadID a_TID) {
   std::shared_ptr<SortedCallstackReport> report =
       std::make_shared<SortedCallstackReport>();
-  std::multimap<int, CallstackID> multiMap =
-      GetCallstacksFromAddress(a_Addr, a_TID, &report->m_NumCallStacksTotal);
-  size_t numUniqueCallstacks = multiMap.size();
-  report->m_CallStacks.resize(numUniqueCallstacks);
-  size_t index = numUniqueCallstacks;
+  auto callstacks_it = m_FunctionToCallstacks.find(a_Addr);
+  auto data_it = m_ThreadSampleData.find(a_TID);
+  if (callstacks_it == m_FunctionToCallstacks.end() ||
+      data_it == m_ThreadSampleData.end()) {
+    return report;
+  }
 
-  for (auto& pair : multiMap) {
-    CallstackCount& callstack = report->m_CallStacks[--index];
-    callstack.m_Count = pair.first;
-    callstack.m_CallstackId = pair.second;
+  const ThreadSampleData& data = data_it->second;
+  for (CallstackID id : callstacks_it->second) {
+    auto count_it = data.m_CallstackCount.find(id);
+    if (count_it != data.m_CallstackCount.end()) {
+      CallstackCount callstack;
+      callstack.m_Count = count_it->second;
+      callstack.m_CallstackId = id;
+      report->m_CallStacks.push_back(callstack);
+      report->m_NumCallStacksTotal += callstack.m_Count;
+    }
   }
+  std::sort(report->m_CallStacks.begin(), report->m_CallStacks.end(),
+            [](const CallstackCount& a, const CallstackCount& b) {
+              return a.m_Count != b.m_Count ? a.m_Count > b.m_Count
+                                            : a.m_CallstackId < b.m_CallstackId;
+            });
 
   return report;
 }
@@ -136,108 +269,376 @@ void SamplingProfiler::SortByThreadUsage() {
 
 //-----------------------------------------------------------------------------
 void SamplingProfiler::ProcessSamples() {
-  // Clear the result of a previous call to ProcessSamples.
-  m_ThreadSampleData.clear();
-  m_UniqueResolvedCallstacks.clear();
-  m_OriginalCallstackToResolvedCallstack.clear();
-  m_FunctionToCallstacks.clear();
-  m_ExactAddressToFunctionAddress.clear();
-  m_FunctionAddressToExactAddresses.clear();
-  m_SortedThreadSampleData.clear();
+  absl::MutexLock lock(&thread_sample_data_mutex_);
+  CountSamplesLocked();
+  ResolveAddressesLocked();
+  AggregateSamplesLocked();
+
+  // With many threads, computing the reports of all of them takes a while,
+  // while only a few of them are looked at: only the summary's is computed
+  // now, the others by GetThreadReport.
+  if (m_GenerateSummary) {
+    FillSampleReport(&m_ThreadSampleData[kAllThreadsFakeTid]);
+  }
 
-  // Unique call stacks and per thread data
-  for (const CallstackEvent& callstack : m_Callstacks) {
-    if (!HasCallStack(callstack.callstack_hash())) {
-      ERROR("Processed unknown callstack!");
-      continue;
-    }
+  // Don't clear m_Callstacks, so that ProcessSamples can be called again, e.g.
+  // when new callstacks have been added or after a module has been loaded.
+}
 
-    ThreadSampleData& threadSampleData =
-        m_ThreadSampleData[callstack.thread_id()];
-    threadSampleData.m_NumSamples++;
-    threadSampleData.m_CallstackCount[callstack.callstack_hash()]++;
+//-----------------------------------------------------------------------------
+void SamplingProfiler::CountSamples() {
+  absl::MutexLock lock(&thread_sample_data_mutex_);
+  CountSamplesLocked();
+}
 
-    absl::MutexLock lock(&unique_callstacks_mutex_);
-    for (uint64_t address :
-         unique_callstacks_[callstack.callstack_hash()]->m_Data) {
-      threadSampleData.m_RawAddressCount[address]++;
-    }
-
-    if (m_GenerateSummary) {
-      ThreadSampleData& threadSampleDataAll =
-          m_ThreadSampleData[kAllThreadsFakeTid];
-      threadSampleDataAll.m_NumSamples++;
-      threadSampleDataAll.m_CallstackCount[callstack.callstack_hash()]++;
-      for (uint64_t address :
-           unique_callstacks_[callstack.callstack_hash()]->m_Data) {
-        threadSampleDataAll.m_RawAddressCount[address]++;
-      }
+//-----------------------------------------------------------------------------
+void SamplingProfiler::ResolveAddresses() {
+  absl::MutexLock lock(&thread_sample_data_mutex_);
+  ResolveAddressesLocked();
+}
+
+//-----------------------------------------------------------------------------
+void SamplingProfiler::AggregateSamples() {
+  absl::MutexLock lock(&thread_sample_data_mutex_);
+  AggregateSamplesLocked();
+}
+
+//-----------------------------------------------------------------------------
+void SamplingProfiler::CountSamplesLocked() {
+  // Callstack events are only added to m_Callstacks, unless it is cleared.
+  // Then, or when the summary is switched, start over.
+  if (m_Callstacks.size() < num_processed_callstack_events_ ||
+      m_GenerateSummary != processed_with_summary_) {
+    ClearProcessedSamples();
+    processed_with_summary_ = m_GenerateSummary;
+  }
+
+  CountNewCallstackEvents();
+}
+
+//-----------------------------------------------------------------------------
+void SamplingProfiler::ResolveAddressesLocked() {
+  absl::flat_hash_set<uint64_t> changed_addresses = UpdateDirtyAddresses();
+  changed_addresses_.insert(changed_addresses.begin(),
+                            changed_addresses.end());
+
+  // The addresses of the callstacks not resolved yet, so that
+  // ResolveCallstacks doesn't have to look up their functions.
+  absl::MutexLock lock(&unique_callstacks_mutex_);
+  for (const auto& [callstack_id, node_id] : unique_callstacks_) {
+    if (m_OriginalCallstackToResolvedCallstack.contains(callstack_id)) {
+      continue;
     }
+    callstack_trie_.ForEachPc(node_id, [this](uint64_t address) {
+      if (!m_ExactAddressToFunctionAddress.contains(address)) {
+        UpdateAddressInfo(address);
+      }
+    });
   }
+}
 
-  ResolveCallstacks();
+//-----------------------------------------------------------------------------
+void SamplingProfiler::AggregateSamplesLocked() {
+  ResolveCallstacks(changed_addresses_);
+  changed_addresses_.clear();
 
   for (auto& dataIt : m_ThreadSampleData) {
     ThreadSampleData& threadSampleData = dataIt.second;
 
+    // Unlike the counts of callstacks, these depend on how the callstacks are
+    // resolved, which might have changed.
+    threadSampleData.m_AddressCount.clear();
+    threadSampleData.m_ExclusiveCount.clear();
+    threadSampleData.m_AddressCountSorted.clear();
+    threadSampleData.m_SampleReport.clear();
+    threadSampleData.m_HasAddressCounts = false;
+    threadSampleData.m_HasSampleReport = false;
+
     ComputeAverageThreadUsage(&threadSampleData);
+  }
 
-    // Address count per sample per thread
-    for (auto& stackCountIt : threadSampleData.m_CallstackCount) {
-      const CallstackID callstackID = stackCountIt.first;
-      const uint32_t callstackCount = stackCountIt.second;
+  SortByThreadUsage();
+  ++processed_samples_generation_;
 
-      CallstackID resolvedCallstackID =
-          m_OriginalCallstackToResolvedCallstack[callstackID];
-      std::shared_ptr<CallStack>& resolvedCallstack =
-          m_UniqueResolvedCallstacks[resolvedCallstackID];
+  // The names of the functions are only looked up by FillSampleReport, on the
+  // main thread.
+  if (m_GenerateSummary) {
+    ComputeAddressCounts(&m_ThreadSampleData[kAllThreadsFakeTid]);
+  }
 
-      // exclusive stat
-      threadSampleData.m_ExclusiveCount[resolvedCallstack->m_Data[0]] +=
-          callstackCount;
+  m_NumSamples = m_Callstacks.size() + num_samples_of_callstack_counts_;
+}
 
-      std::set<uint64_t> uniqueAddresses;
-      for (uint32_t i = 0; i < resolvedCallstack->m_Data.size(); ++i) {
-        uniqueAddresses.insert(resolvedCallstack->m_Data[i]);
-      }
+//-----------------------------------------------------------------------------
+void SamplingProfiler::ClearProcessedSamples() {
+  m_ThreadSampleData.clear();
+  m_UniqueResolvedCallstacks.clear();
+  m_OriginalCallstackToResolvedCallstack.clear();
+  m_FunctionToCallstacks.clear();
+  m_ExactAddressToFunctionAddress.clear();
+  m_FunctionAddressToExactAddresses.clear();
+  m_SortedThreadSampleData.clear();
+  ++processed_samples_generation_;
+  num_processed_callstack_events_ = 0;
+  num_processed_callstack_counts_ = 0;
+  resolved_modules_.clear();
+  changed_addresses_.clear();
+}
+
+//-----------------------------------------------------------------------------
+void SamplingProfiler::CountNewCallstackEvents() {
+  const uint32_t begin = num_processed_callstack_events_;
+  const uint32_t end = m_Callstacks.size();
+  num_processed_callstack_events_ = end;
+  const size_t counts_begin = num_processed_callstack_counts_;
+  size_t counts_end;
+  {
+    absl::MutexLock lock(&unique_callstacks_mutex_);
+    counts_end = callstack_counts_.size();
+    // The counts added from now on go to new entries of callstack_counts_.
+    unprocessed_callstack_counts_indices_.clear();
+  }
+  num_processed_callstack_counts_ = counts_end;
+  if (begin == end && counts_begin == counts_end) {
+    return;
+  }
 
-      for (uint64_t address : uniqueAddresses) {
-        threadSampleData.m_AddressCount[address] += callstackCount;
+  // The events are counted on all cores in chunks, each into counts of its
+  // own, which are then merged thread by thread. Only the number of samples of
+  // each unique callstack is counted per event, the addresses are counted per
+  // unique callstack once merged.
+  const size_t chunk_count = std::clamp<size_t>(
+      (end - begin) / kMinCallstackEventsPerChunk, 1,
+      std::max(std::thread::hardware_concurrency(), 1u));
+  std::unique_ptr<ThreadPool> thread_pool;
+  if (chunk_count > 1) {
+    thread_pool = ThreadPool::CreateWorkStealing(chunk_count - 1);
+  }
+  auto parallel_for = [&thread_pool](size_t count, const auto& body) {
+    if (thread_pool == nullptr) {
+      for (size_t i = 0; i < count; ++i) {
+        body(i);
+      }
+    } else {
+      ParallelFor(thread_pool.get(), 0, count, body);
+    }
+  };
+
+  using CallstackCounts = absl::flat_hash_map<CallstackID, uint32_t>;
+  std::vector<absl::flat_hash_map<ThreadID, CallstackCounts>> chunk_counts(
+      chunk_count);
+  parallel_for(chunk_count, [&](size_t chunk) {
+    const uint32_t chunk_begin = begin + (end - begin) * chunk / chunk_count;
+    const uint32_t chunk_end =
+        begin + (end - begin) * (chunk + 1) / chunk_count;
+    absl::flat_hash_map<ThreadID, CallstackCounts>& counts =
+        chunk_counts[chunk];
+    // Consecutive events are mostly of the same thread.
+    ThreadID last_thread_id = 0;
+    CallstackCounts* last_thread_counts = nullptr;
+    for (uint32_t i = chunk_begin; i < chunk_end; ++i) {
+      const CallstackEvent& callstack = m_Callstacks[i];
+      if (last_thread_counts == nullptr ||
+          callstack.thread_id() != last_thread_id) {
+        last_thread_id = callstack.thread_id();
+        last_thread_counts = &counts[last_thread_id];
       }
+      ++(*last_thread_counts)[callstack.callstack_hash()];
     }
+  });
+  // The samples counted beforehand are merged like those of a chunk.
+  {
+    absl::MutexLock lock(&unique_callstacks_mutex_);
+    for (size_t i = counts_begin; i < counts_end; ++i) {
+      chunk_counts.emplace_back();
+      chunk_counts.back().emplace(callstack_counts_[i].first,
+                                  callstack_counts_[i].second);
+    }
+  }
 
-    // sort thread addresses by count
-    for (auto& addressCountIt : threadSampleData.m_AddressCount) {
-      const uint64_t address = addressCountIt.first;
-      const uint32_t count = addressCountIt.second;
-      threadSampleData.m_AddressCountSorted.insert(
-          std::make_pair(count, address));
+  // ThreadSampleData are created here, as m_ThreadSampleData can't be
+  // modified concurrently.
+  absl::flat_hash_set<ThreadID> thread_ids;
+  for (const auto& counts : chunk_counts) {
+    for (const auto& thread_counts : counts) {
+      thread_ids.insert(thread_counts.first);
     }
   }
+  std::vector<std::pair<ThreadID, ThreadSampleData*>> threads;
+  for (ThreadID thread_id : thread_ids) {
+    threads.emplace_back(thread_id, &m_ThreadSampleData[thread_id]);
+  }
 
-  SortByThreadUsage();
+  absl::MutexLock lock(&unique_callstacks_mutex_);
+  std::vector<CallstackCounts> new_counts(threads.size());
+  std::atomic<bool> has_unknown_callstacks = false;
+  parallel_for(threads.size(), [&](size_t thread) {
+    const ThreadID thread_id = threads[thread].first;
+    CallstackCounts& thread_counts = new_counts[thread];
+    for (const auto& counts : chunk_counts) {
+      auto it = counts.find(thread_id);
+      if (it == counts.end()) {
+        continue;
+      }
+      for (const auto& [callstack_id, count] : it->second) {
+        thread_counts[callstack_id] += count;
+      }
+    }
+    ThreadSampleData& threadSampleData = *threads[thread].second;
+    for (const auto& [callstack_id, count] : thread_counts) {
+      auto unique_callstack_it = unique_callstacks_.find(callstack_id);
+      if (unique_callstack_it == unique_callstacks_.end()) {
+        has_unknown_callstacks = true;
+        continue;
+      }
+      threadSampleData.m_NumSamples += count;
+      threadSampleData.m_CallstackCount[callstack_id] += count;
+      callstack_trie_.ForEachPc(
+          unique_callstack_it->second, [&](uint64_t address) {
+            threadSampleData.m_RawAddressCount[address] += count;
+          });
+    }
+  });
+  if (has_unknown_callstacks) {
+    ERROR("Processed unknown callstack!");
+  }
+  if (thread_pool != nullptr) {
+    thread_pool->ShutdownAndWait();
+  }
 
-  FillThreadSampleDataSampleReports();
+  if (!m_GenerateSummary) {
+    return;
+  }
+  CallstackCounts summary_counts;
+  for (const CallstackCounts& thread_counts : new_counts) {
+    for (const auto& [callstack_id, count] : thread_counts) {
+      summary_counts[callstack_id] += count;
+    }
+  }
+  ThreadSampleData& threadSampleDataAll =
+      m_ThreadSampleData[kAllThreadsFakeTid];
+  for (const auto& [callstack_id, count] : summary_counts) {
+    auto unique_callstack_it = unique_callstacks_.find(callstack_id);
+    if (unique_callstack_it == unique_callstacks_.end()) {
+      continue;
+    }
+    threadSampleDataAll.m_NumSamples += count;
+    threadSampleDataAll.m_CallstackCount[callstack_id] += count;
+    callstack_trie_.ForEachPc(
+        unique_callstack_it->second, [&](uint64_t address) {
+          threadSampleDataAll.m_RawAddressCount[address] += count;
+        });
+  }
+}
 
-  m_NumSamples = m_Callstacks.size();
+//-----------------------------------------------------------------------------
+absl::flat_hash_set<uint64_t> SamplingProfiler::UpdateDirtyAddresses() {
+  // The address ranges of the modules that were added, removed, or that got
+  // other symbols since the addresses were resolved.
+  std::vector<std::pair<uint64_t, uint64_t>> dirty_ranges;
+  std::map<uint64_t, ResolvedModule> modules;
+  for (const auto& [address_start, module] : m_Process->GetModules()) {
+    ResolvedModule resolved_module{module->m_AddressEnd, module->m_Pdb};
+    auto it = resolved_modules_.find(address_start);
+    if (it == resolved_modules_.end()) {
+      dirty_ranges.emplace_back(address_start, module->m_AddressEnd);
+    } else {
+      if (it->second.address_end != resolved_module.address_end ||
+          it->second.pdb != resolved_module.pdb) {
+        dirty_ranges.emplace_back(address_start, it->second.address_end);
+        dirty_ranges.emplace_back(address_start, module->m_AddressEnd);
+      }
+      resolved_modules_.erase(it);
+    }
+    modules.emplace(address_start, std::move(resolved_module));
+  }
+  for (const auto& [address_start, resolved_module] : resolved_modules_) {
+    dirty_ranges.emplace_back(address_start, resolved_module.address_end);
+  }
+  resolved_modules_ = std::move(modules);
+
+  // Merge the ranges, so that at most the last one starting at or before an
+  // address can contain it.
+  std::sort(dirty_ranges.begin(), dirty_ranges.end());
+  std::vector<std::pair<uint64_t, uint64_t>> merged_ranges;
+  for (const auto& range : dirty_ranges) {
+    if (!merged_ranges.empty() && range.first <= merged_ranges.back().second) {
+      merged_ranges.back().second =
+          std::max(merged_ranges.back().second, range.second);
+    } else {
+      merged_ranges.push_back(range);
+    }
+  }
+  auto is_in_dirty_range = [&merged_ranges](uint64_t address) {
+    auto it = std::upper_bound(
+        merged_ranges.begin(), merged_ranges.end(), address,
+        [](uint64_t address, const std::pair<uint64_t, uint64_t>& range) {
+          return address < range.first;
+        });
+    return it != merged_ranges.begin() && address < std::prev(it)->second;
+  };
+
+  // The names are cleared with the rest of the capture data, independently
+  // of this SamplingProfiler.
+  std::vector<uint64_t> dirty_addresses;
+  for (const auto& [address, function_address] :
+       m_ExactAddressToFunctionAddress) {
+    if (is_in_dirty_range(address) ||
+        Capture::GAddressToFunctionName.count(function_address) == 0 ||
+        Capture::GAddressToModuleName.count(function_address) == 0) {
+      dirty_addresses.push_back(address);
+    }
+  }
 
-  // Don't clear m_Callstacks, so that ProcessSamples can be called again, e.g.
-  // when new callstacks have been added or after a module has been loaded.
+  absl::flat_hash_set<uint64_t> changed_addresses;
+  for (uint64_t address : dirty_addresses) {
+    const uint64_t previous_function_address =
+        m_ExactAddressToFunctionAddress.at(address);
+    UpdateAddressInfo(address);
+    if (m_ExactAddressToFunctionAddress.at(address) !=
+        previous_function_address) {
+      changed_addresses.insert(address);
+    }
+  }
+  return changed_addresses;
 }
 
 //-----------------------------------------------------------------------------
-void SamplingProfiler::ResolveCallstacks() {
+void SamplingProfiler::ResolveCallstacks(
+    const absl::flat_hash_set<uint64_t>& changed_addresses) {
   absl::MutexLock lock(&unique_callstacks_mutex_);
 
   for (const auto& it : unique_callstacks_) {
     CallstackID rawCallstackId = it.first;
-    const std::shared_ptr<CallStack> callstack = it.second;
+
+    // A callstack resolved by a previous call is only resolved again when one
+    // of its addresses now falls in another function.
+    auto previous_it =
+        m_OriginalCallstackToResolvedCallstack.find(rawCallstackId);
+    if (previous_it != m_OriginalCallstackToResolvedCallstack.end()) {
+      bool has_changed_address = false;
+      callstack_trie_.ForEachPc(it.second, [&](uint64_t address) {
+        has_changed_address |= changed_addresses.contains(address);
+      });
+      if (!has_changed_address) {
+        continue;
+      }
+      for (uint64_t functionAddr :
+           m_UniqueResolvedCallstacks.at(previous_it->second)->m_Data) {
+        auto callstacks_it = m_FunctionToCallstacks.find(functionAddr);
+        if (callstacks_it != m_FunctionToCallstacks.end()) {
+          callstacks_it->second.erase(rawCallstackId);
+        }
+      }
+    }
+
     // A "resolved callstack" is a callstack where every address is replaced by
     // the start address of the function (if known).
-    CallStack resolved_callstack = *callstack;
+    CallStack resolved_callstack;
+    resolved_callstack.m_Data = callstack_trie_.GetPcs(it.second);
 
-    for (uint32_t i = 0; i < callstack->m_Data.size(); ++i) {
-      uint64_t addr = callstack->m_Data[i];
+    for (uint32_t i = 0; i < resolved_callstack.m_Data.size(); ++i) {
+      uint64_t addr = resolved_callstack.m_Data[i];
 
       if (m_ExactAddressToFunctionAddress.find(addr) ==
           m_ExactAddressToFunctionAddress.end()) {
@@ -295,10 +696,34 @@ uint32_t SamplingProfiler::GetCountOfFunction(uint64_t function_address) const {
   return result;
 }
 
+//-----------------------------------------------------------------------------
+std::vector<std::pair<uint64_t, uint32_t>>
+SamplingProfiler::GetSampledAddressCountsOfFunction(
+    uint64_t function_address) const {
+  std::vector<std::pair<uint64_t, uint32_t>> address_counts;
+  auto addresses_of_functions_itr =
+      m_FunctionAddressToExactAddresses.find(function_address);
+  const ThreadSampleData* summary = GetSummary();
+  if (addresses_of_functions_itr == m_FunctionAddressToExactAddresses.end() ||
+      summary == nullptr) {
+    return address_counts;
+  }
+  address_counts.reserve(addresses_of_functions_itr->second.size());
+  for (uint64_t address : addresses_of_functions_itr->second) {
+    auto count_itr = summary->m_RawAddressCount.find(address);
+    if (count_itr != summary->m_RawAddressCount.end()) {
+      address_counts.emplace_back(address, count_itr->second);
+    }
+  }
+  std::sort(address_counts.begin(), address_counts.end());
+  return address_counts;
+}
+
 const std::string SamplingProfiler::kUnknownFunctionOrModuleName = "???";
 
 void SamplingProfiler::UpdateAddressInfo(uint64_t address) {
-  LinuxAddressInfo* address_info = Capture::GetAddressInfo(address);
+  std::optional<LinuxAddressInfo> address_info =
+      Capture::GCaptureData.GetAddressInfo(address);
   FunctionInfo* function = m_Process->GetFunctionFromAddress(address, false);
 
   // Find the start address of the function this address falls inside.
@@ -314,7 +739,7 @@ void SamplingProfiler::UpdateAddressInfo(uint64_t address) {
   if (function != nullptr) {
     function_address = FunctionUtils::GetAbsoluteAddress(*function);
     function_name = FunctionUtils::GetDisplayName(*function);
-  } else if (address_info != nullptr) {
+  } else if (address_info.has_value()) {
     function_address = address - address_info->offset_in_function();
     if (!address_info->function_name().empty()) {
       function_name = address_info->function_name();
@@ -323,10 +748,24 @@ void SamplingProfiler::UpdateAddressInfo(uint64_t address) {
     function_address = address;
   }
 
-  if (function != nullptr && address_info != nullptr) {
-    address_info->set_function_name(FunctionUtils::GetDisplayName(*function));
+  if (function != nullptr && address_info.has_value()) {
+    Capture::GCaptureData.SetAddressInfoFunctionName(address, function_name);
   }
 
+  // When resolved again, e.g., after the symbols of the module were loaded,
+  // the address might now fall in another function.
+  auto previous_it = m_ExactAddressToFunctionAddress.find(address);
+  if (previous_it != m_ExactAddressToFunctionAddress.end() &&
+      previous_it->second != function_address) {
+    auto exact_addresses_it =
+        m_FunctionAddressToExactAddresses.find(previous_it->second);
+    if (exact_addresses_it != m_FunctionAddressToExactAddresses.end()) {
+      exact_addresses_it->second.erase(address);
+      if (exact_addresses_it->second.empty()) {
+        m_FunctionAddressToExactAddresses.erase(exact_addresses_it);
+      }
+    }
+  }
   m_ExactAddressToFunctionAddress[address] = function_address;
   m_FunctionAddressToExactAddresses[function_address].insert(address);
 
@@ -337,7 +776,7 @@ void SamplingProfiler::UpdateAddressInfo(uint64_t address) {
   std::shared_ptr<Module> module = m_Process->GetModuleFromAddress(address);
   if (module != nullptr) {
     module_name = module->m_Name;
-  } else if (address_info != nullptr) {
+  } else if (address_info.has_value()) {
     module_name = Path::GetFileName(address_info->module_name());
   }
   Capture::GAddressToModuleName[address] = module_name;
@@ -345,40 +784,140 @@ void SamplingProfiler::UpdateAddressInfo(uint64_t address) {
 }
 
 //-----------------------------------------------------------------------------
-void SamplingProfiler::FillThreadSampleDataSampleReports() {
-  for (auto& data : m_ThreadSampleData) {
-    ThreadID threadID = data.first;
-    ThreadSampleData& threadSampleData = data.second;
-    std::vector<SampledFunction>& sampleReport =
-        threadSampleData.m_SampleReport;
-
-    ORBIT_LOGV(threadID);
-    ORBIT_LOGV(threadSampleData.m_NumSamples);
-
-    for (auto sortedIt = threadSampleData.m_AddressCountSorted.rbegin();
-         sortedIt != threadSampleData.m_AddressCountSorted.rend(); ++sortedIt) {
-      uint32_t numOccurences = sortedIt->first;
-      uint64_t address = sortedIt->second;
-      float inclusive_percent =
-          100.f * numOccurences / threadSampleData.m_NumSamples;
-
-      SampledFunction function;
-      // GAddressToFunctionName and GAddressToModuleName should be filled in
-      // UpdateAddressInfo()
-      CHECK(Capture::GAddressToFunctionName.count(address) > 0);
-      function.m_Name = Capture::GAddressToFunctionName.at(address);
-      function.m_Inclusive = inclusive_percent;
-      function.m_Exclusive = 0.f;
-      auto it = threadSampleData.m_ExclusiveCount.find(address);
-      if (it != threadSampleData.m_ExclusiveCount.end()) {
-        function.m_Exclusive =
-            100.f * it->second / threadSampleData.m_NumSamples;
-      }
-      function.m_Address = address;
-      CHECK(Capture::GAddressToModuleName.count(address) > 0);
-      function.m_Module = Capture::GAddressToModuleName.at(address);
+void SamplingProfiler::ComputeAddressCounts(
+    ThreadSampleData* thread_sample_data) const {
+  if (thread_sample_data->m_HasAddressCounts) {
+    return;
+  }
+  thread_sample_data->m_HasAddressCounts = true;
+
+  // Address count per sample per thread
+  std::vector<uint64_t> unique_addresses;
+  for (auto& stackCountIt : thread_sample_data->m_CallstackCount) {
+    const CallstackID callstackID = stackCountIt.first;
+    const uint32_t callstackCount = stackCountIt.second;
+
+    auto resolved_id_it =
+        m_OriginalCallstackToResolvedCallstack.find(callstackID);
+    CHECK(resolved_id_it != m_OriginalCallstackToResolvedCallstack.end());
+    auto resolved_callstack_it =
+        m_UniqueResolvedCallstacks.find(resolved_id_it->second);
+    CHECK(resolved_callstack_it != m_UniqueResolvedCallstacks.end());
+    const CallStack& resolvedCallstack = *resolved_callstack_it->second;
+
+    // exclusive stat
+    thread_sample_data->m_ExclusiveCount[resolvedCallstack.m_Data[0]] +=
+        callstackCount;
+
+    unique_addresses.assign(resolvedCallstack.m_Data.begin(),
+                            resolvedCallstack.m_Data.end());
+    std::sort(unique_addresses.begin(), unique_addresses.end());
+    unique_addresses.erase(
+        std::unique(unique_addresses.begin(), unique_addresses.end()),
+        unique_addresses.end());
+
+    for (uint64_t address : unique_addresses) {
+      thread_sample_data->m_AddressCount[address] += callstackCount;
+    }
+  }
+
+  // sort thread addresses by count
+  std::vector<std::pair<uint32_t, uint64_t>>& address_count_sorted =
+      thread_sample_data->m_AddressCountSorted;
+  address_count_sorted.reserve(thread_sample_data->m_AddressCount.size());
+  for (auto& addressCountIt : thread_sample_data->m_AddressCount) {
+    const uint64_t address = addressCountIt.first;
+    const uint32_t count = addressCountIt.second;
+    address_count_sorted.emplace_back(count, address);
+  }
+  std::sort(address_count_sorted.begin(), address_count_sorted.end(),
+            [](const std::pair<uint32_t, uint64_t>& a,
+               const std::pair<uint32_t, uint64_t>& b) {
+              return a.first != b.first ? a.first > b.first
+                                        : a.second < b.second;
+            });
+}
+
+//-----------------------------------------------------------------------------
+void SamplingProfiler::FillSampleReport(
+    ThreadSampleData* thread_sample_data) const {
+  if (thread_sample_data->m_HasSampleReport) {
+    return;
+  }
+  thread_sample_data->m_HasSampleReport = true;
+  CHECK(thread_sample_data->m_HasAddressCounts);
+
+  std::vector<SampledFunction>& sampleReport =
+      thread_sample_data->m_SampleReport;
+
+  ORBIT_LOGV(thread_sample_data->m_TID);
+  ORBIT_LOGV(thread_sample_data->m_NumSamples);
+
+  sampleReport.reserve(thread_sample_data->m_AddressCountSorted.size());
+  for (const auto& countAndAddress : thread_sample_data->m_AddressCountSorted) {
+    uint32_t numOccurences = countAndAddress.first;
+    uint64_t address = countAndAddress.second;
+    float inclusive_percent =
+        100.f * numOccurences / thread_sample_data->m_NumSamples;
+
+    SampledFunction function;
+    // GAddressToFunctionName and GAddressToModuleName should be filled in
+    // UpdateAddressInfo()
+    CHECK(Capture::GAddressToFunctionName.count(address) > 0);
+    function.m_Name = Capture::GAddressToFunctionName.at(address);
+    function.m_Inclusive = inclusive_percent;
+    function.m_Exclusive = 0.f;
+    auto it = thread_sample_data->m_ExclusiveCount.find(address);
+    if (it != thread_sample_data->m_ExclusiveCount.end()) {
+      function.m_Exclusive =
+          100.f * it->second / thread_sample_data->m_NumSamples;
+    }
+    function.m_Address = address;
+    CHECK(Capture::GAddressToModuleName.count(address) > 0);
+    function.m_Module = Capture::GAddressToModuleName.at(address);
 
-      sampleReport.push_back(function);
+    sampleReport.push_back(function);
+  }
+}
+
+//-----------------------------------------------------------------------------
+std::vector<SampledFunction> SamplingProfiler::GetThreadReport(
+    ThreadID thread_id) {
+  absl::MutexLock lock(&thread_sample_data_mutex_);
+  auto data_it = m_ThreadSampleData.find(thread_id);
+  if (data_it == m_ThreadSampleData.end()) {
+    return {};
+  }
+  ComputeAddressCounts(&data_it->second);
+  FillSampleReport(&data_it->second);
+  return data_it->second.m_SampleReport;
+}
+
+//-----------------------------------------------------------------------------
+void SamplingProfiler::PrecomputeThreadReports() {
+  // The names of the functions are only looked up by GetThreadReport, as
+  // Capture::GAddressToFunctionName is only accessed from the main thread.
+  uint64_t generation;
+  std::vector<ThreadID> thread_ids;
+  {
+    absl::MutexLock lock(&thread_sample_data_mutex_);
+    generation = processed_samples_generation_;
+    thread_ids.reserve(m_SortedThreadSampleData.size());
+    for (const ThreadSampleData* thread_sample_data :
+         m_SortedThreadSampleData) {
+      thread_ids.push_back(thread_sample_data->m_TID);
+    }
+  }
+
+  // One thread at a time, not to hold up ProcessSamples and GetThreadReport.
+  for (ThreadID thread_id : thread_ids) {
+    absl::MutexLock lock(&thread_sample_data_mutex_);
+    if (processed_samples_generation_ != generation) {
+      return;
+    }
+    auto data_it = m_ThreadSampleData.find(thread_id);
+    if (data_it != m_ThreadSampleData.end()) {
+      ComputeAddressCounts(&data_it->second);
     }
   }
 }
@@ -5,14 +5,22 @@
 #ifndef ORBIT_CORE_SAMPLING_PROFILER_H_
 #define ORBIT_CORE_SAMPLING_PROFILER_H_
 
+#include <map>
+#include <memory>
 #include <utility>
+#include <vector>
 
 #include "BlockChain.h"
 #include "Callstack.h"
+#include "CallstackCountIndex.h"
+#include "CallstackTrie.h"
 #include "Capture.h"
 #include "Core.h"
 #include "EventBuffer.h"
 #include "Pdb.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
 #include "capture_data.pb.h"
 
 class Process;
@@ -34,13 +42,19 @@ struct SampledFunction {
 //-----------------------------------------------------------------------------
 struct ThreadSampleData {
   ThreadSampleData() { m_ThreadUsage.push_back(0); }
-  std::unordered_map<CallstackID, uint32_t> m_CallstackCount;
-  std::unordered_map<uint64_t, uint32_t> m_AddressCount;
-  std::unordered_map<uint64_t, uint32_t> m_RawAddressCount;
-  std::unordered_map<uint64_t, uint32_t> m_ExclusiveCount;
-  std::multimap<uint32_t, uint64_t> m_AddressCountSorted;
+  absl::flat_hash_map<CallstackID, uint32_t> m_CallstackCount;
+  absl::flat_hash_map<uint64_t, uint32_t> m_AddressCount;
+  absl::flat_hash_map<uint64_t, uint32_t> m_RawAddressCount;
+  absl::flat_hash_map<uint64_t, uint32_t> m_ExclusiveCount;
+  // Pairs of count and address, by decreasing count.
+  std::vector<std::pair<uint32_t, uint64_t>> m_AddressCountSorted;
   uint32_t m_NumSamples = 0;
   std::vector<SampledFunction> m_SampleReport;
+  // Only the summary's m_AddressCount, m_ExclusiveCount, m_AddressCountSorted
+  // and m_SampleReport are computed by ProcessSamples, those of the other
+  // threads on first request, see SamplingProfiler::GetThreadReport.
+  bool m_HasAddressCounts = false;
+  bool m_HasSampleReport = false;
   std::vector<float> m_ThreadUsage;
   float m_AverageThreadUsage = 0;
   ThreadID m_TID = 0;
@@ -64,6 +78,8 @@ struct SortedCallstackReport {
 //-----------------------------------------------------------------------------
 class SamplingProfiler {
  public:
+  static constexpr uint32_t kCallstackEventBlockSize = 16 * 1024;
+
   explicit SamplingProfiler(std::shared_ptr<Process> a_Process)
       : m_Process{std::move(a_Process)} {}
   SamplingProfiler() : SamplingProfiler{std::make_shared<Process>()} {}
@@ -71,12 +87,27 @@ class SamplingProfiler {
   int GetNumSamples() const { return m_NumSamples; }
 
   void AddCallStack(orbit_client_protos::CallstackEvent& callstack_event);
-  void AddUniqueCallStack(CallStack& a_CallStack);
+  // Callstacks are never modified once added, the first one added for a hash
+  // is kept.
+  void AddUniqueCallStack(CallStack callstack);
+  // Adds the samples of a thread counted beforehand, e.g., in a selection,
+  // by callstack. Like AddCallStack, takes the callstacks from
+  // Capture::GSamplingProfiler.
+  void AddCallstackCounts(
+      ThreadID thread_id,
+      const absl::flat_hash_map<CallstackID, uint32_t>& callstack_counts);
+  // Adds samples of a thread that the service counted by callstack instead of
+  // sending them, the callstacks being added with AddUniqueCallStack. Unlike
+  // with AddCallstackCounts, the counts added between two ProcessSamples are
+  // merged by thread, so that they take memory by callstack, not by call. Can
+  // be called while the samples are processed.
+  void AddCallstackSampleCounts(
+      ThreadID thread_id,
+      const absl::flat_hash_map<CallstackID, uint32_t>& callstack_counts);
 
-  std::shared_ptr<CallStack> GetCallStack(CallstackID a_ID) {
-    absl::MutexLock lock(&unique_callstacks_mutex_);
-    return unique_callstacks_.at(a_ID);
-  }
+  // Created from the trie the callstacks are stored in, or nullptr if the
+  // callstack is unknown.
+  std::shared_ptr<CallStack> GetCallStack(CallstackID a_ID);
   bool HasCallStack(CallstackID a_ID) {
     absl::MutexLock lock(&unique_callstacks_mutex_);
     return unique_callstacks_.count(a_ID) > 0;
@@ -85,22 +116,26 @@ class SamplingProfiler {
   const CallStack& GetResolvedCallstack(
       CallstackID raw_callstack_id) const;
 
-  std::multimap<int, CallstackID> GetCallstacksFromAddress(
-      uint64_t a_Addr, ThreadID a_TID, int* o_NumCallstacks);
   std::shared_ptr<SortedCallstackReport> GetSortedCallstacksFromAddress(
       uint64_t a_Addr, ThreadID a_TID);
 
-  BlockChain<orbit_client_protos::CallstackEvent, 16 * 1024>* GetCallstacks() {
+  BlockChain<orbit_client_protos::CallstackEvent, kCallstackEventBlockSize>*
+  GetCallstacks() {
     return &m_Callstacks;
   }
+  // Frees the oldest callstack events before time, by whole blocks, to keep
+  // only the end of a long capture. Their samples are still counted, by
+  // thread and callstack as if added with AddCallstackCounts, so that the
+  // reports still cover the whole capture, but they are no longer in
+  // GetCallstacks and GetCallstackCountIndex. Returns the number of events
+  // freed.
+  uint32_t DropCallstackEventsBefore(uint64_t time);
+  // The callstack events added so far, indexed to count the samples of any
+  // time range.
+  CallstackCountIndex* GetCallstackCountIndex();
 
   void ForEachUniqueCallstack(
-      const std::function<void(const CallStack&)>& action) {
-    absl::MutexLock lock(&unique_callstacks_mutex_);
-    for (const auto& it : unique_callstacks_) {
-      action(*it.second);
-    }
-  }
+      const std::function<void(const CallStack&)>& action);
 
   const std::vector<ThreadSampleData*>& GetThreadSampleData() const {
     return m_SortedThreadSampleData;
@@ -114,26 +149,71 @@ class SamplingProfiler {
     return &it->second;
   }
 
+  // The functions sampled in the thread, by decreasing count, computed on
+  // first request after ProcessSamples, but for the summary.
+  [[nodiscard]] std::vector<SampledFunction> GetThreadReport(
+      ThreadID thread_id);
+  // Computes what GetThreadReport is based on for all the threads, by
+  // decreasing usage, so that it only has to look up the names. Meant to run
+  // in the background: it can run concurrently with the other methods, and
+  // returns early when the samples are processed again.
+  void PrecomputeThreadReports();
+
   void SetGenerateSummary(bool a_Value) { m_GenerateSummary = a_Value; }
   bool GetGenerateSummary() const { return m_GenerateSummary; }
   void SortByThreadUsage();
   void ProcessSamples();
+  // ProcessSamples in three steps, each to be called after the previous one,
+  // for the costly ones to run in the background: CountSamples and
+  // AggregateSamples can run on any thread, while ResolveAddresses runs on
+  // the main thread, as it looks up the functions of the new addresses in
+  // m_Process and updates Capture::GAddressToFunctionName. The report of the
+  // summary is then computed on first request, as those of the threads.
+  void CountSamples();
+  void ResolveAddresses();
+  void AggregateSamples();
   void UpdateAddressInfo(uint64_t address);
   [[nodiscard]] const ThreadSampleData* GetSummary() const;
   [[nodiscard]] uint32_t GetCountOfFunction(uint64_t function_address) const;
+  // The exact addresses sampled in the function, sorted, with their counts.
+  [[nodiscard]] std::vector<std::pair<uint64_t, uint32_t>>
+  GetSampledAddressCountsOfFunction(uint64_t function_address) const;
 
   void ClearCallstacks() {
-    absl::MutexLock lock(&unique_callstacks_mutex_);
-    unique_callstacks_.clear();
-    m_Callstacks.clear();
+    {
+      absl::MutexLock lock(&unique_callstacks_mutex_);
+      unique_callstacks_.clear();
+      callstack_trie_.Clear();
+      m_Callstacks.clear();
+      callstack_counts_.clear();
+      unprocessed_callstack_counts_indices_.clear();
+      num_samples_of_callstack_counts_ = 0;
+      callstack_count_index_.Clear();
+      num_indexed_callstack_events_ = 0;
+    }
+    absl::MutexLock lock(&thread_sample_data_mutex_);
+    ClearProcessedSamples();
   }
 
   static const int32_t kAllThreadsFakeTid;
   static const std::string kUnknownFunctionOrModuleName;
 
  protected:
-  void ResolveCallstacks();
-  void FillThreadSampleDataSampleReports();
+  // With thread_sample_data_mutex_ held.
+  void ClearProcessedSamples();
+  void CountSamplesLocked();
+  void ResolveAddressesLocked();
+  void AggregateSamplesLocked();
+  // With unique_callstacks_mutex_ held.
+  void AddUniqueCallStackLocked(CallstackID id, const uint64_t* pcs,
+                                size_t size);
+  void CountNewCallstackEvents();
+  [[nodiscard]] absl::flat_hash_set<uint64_t> UpdateDirtyAddresses();
+  void ResolveCallstacks(
+      const absl::flat_hash_set<uint64_t>& changed_addresses);
+  // Both return right away if already done since ProcessSamples.
+  void ComputeAddressCounts(ThreadSampleData* thread_sample_data) const;
+  void FillSampleReport(ThreadSampleData* thread_sample_data) const;
 
  protected:
   std::shared_ptr<Process> m_Process;
@@ -141,22 +221,63 @@ class SamplingProfiler {
   int m_NumSamples = 0;
 
   // Filled before ProcessSamples by AddCallstack, AddHashedCallstack.
-  BlockChain<orbit_client_protos::CallstackEvent, 16 * 1024> m_Callstacks;
+  BlockChain<orbit_client_protos::CallstackEvent, kCallstackEventBlockSize>
+      m_Callstacks;
+  // Also held while events are added to or dropped from m_Callstacks, which
+  // happens on different threads.
   absl::Mutex unique_callstacks_mutex_;
-  std::unordered_map<CallstackID, std::shared_ptr<CallStack>>
-      unique_callstacks_;
+  // The node of the innermost frame of each unique callstack in
+  // callstack_trie_.
+  absl::flat_hash_map<CallstackID, CallstackTrie::NodeId> unique_callstacks_;
+  CallstackTrie callstack_trie_;
+  // Filled by AddCallstackCounts.
+  std::vector<
+      std::pair<ThreadID, absl::flat_hash_map<CallstackID, uint32_t>>>
+      callstack_counts_;
+  uint32_t num_samples_of_callstack_counts_ = 0;
+  // The index in callstack_counts_ that AddCallstackSampleCounts merges the
+  // counts of each thread into, until they are processed.
+  absl::flat_hash_map<ThreadID, size_t> unprocessed_callstack_counts_indices_;
 
-  // Filled by ProcessSamples.
+  // Filled from m_Callstacks by GetCallstackCountIndex.
+  CallstackCountIndex callstack_count_index_;
+  uint32_t num_indexed_callstack_events_ = 0;
+
+  // Held by ProcessSamples and while the address counts and reports of the
+  // threads are computed, which PrecomputeThreadReports does from another
+  // thread.
+  absl::Mutex thread_sample_data_mutex_;
+  uint64_t processed_samples_generation_ = 0;
+
+  // Filled by ProcessSamples. m_ThreadSampleData is node based, as
+  // m_SortedThreadSampleData points into it.
   std::unordered_map<ThreadID, ThreadSampleData> m_ThreadSampleData;
-  std::unordered_map<CallstackID, std::shared_ptr<CallStack>>
+  absl::flat_hash_map<CallstackID, std::shared_ptr<CallStack>>
       m_UniqueResolvedCallstacks;
-  std::unordered_map<CallstackID, CallstackID>
+  absl::flat_hash_map<CallstackID, CallstackID>
       m_OriginalCallstackToResolvedCallstack;
-  std::unordered_map<uint64_t, std::set<CallstackID>> m_FunctionToCallstacks;
-  std::unordered_map<uint64_t, uint64_t> m_ExactAddressToFunctionAddress;
-  std::unordered_map<uint64_t, std::unordered_set<uint64_t>>
+  absl::flat_hash_map<uint64_t, absl::flat_hash_set<CallstackID>>
+      m_FunctionToCallstacks;
+  absl::flat_hash_map<uint64_t, uint64_t> m_ExactAddressToFunctionAddress;
+  absl::flat_hash_map<uint64_t, absl::flat_hash_set<uint64_t>>
       m_FunctionAddressToExactAddresses;
   std::vector<ThreadSampleData*> m_SortedThreadSampleData;
+
+  // What the previous calls to ProcessSamples are based on, so that the next
+  // one only processes what changed since: the callstack events and counts
+  // already counted, and the modules, with their symbols, that the addresses
+  // in m_ExactAddressToFunctionAddress were resolved with.
+  struct ResolvedModule {
+    uint64_t address_end = 0;
+    std::shared_ptr<Pdb> pdb;
+  };
+  uint32_t num_processed_callstack_events_ = 0;
+  size_t num_processed_callstack_counts_ = 0;
+  bool processed_with_summary_ = false;
+  std::map<uint64_t, ResolvedModule> resolved_modules_;
+  // The addresses that ResolveAddresses found in other functions than
+  // before, whose callstacks AggregateSamples resolves again.
+  absl::flat_hash_set<uint64_t> changed_addresses_;
 };
 
 #endif  // ORBIT_CORE_SAMPLING_PROFILER_H_
@@ -0,0 +1,87 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Fills a SamplingProfiler with a capture's worth of generated callstack
+// events and measures SamplingProfiler::ProcessSamples, once on all the
+// events and once more after a few more events have been added.
+//
+// Usage: SamplingProfilerBenchmark [<event count> [<thread count>]]
+
+#include <absl/strings/str_format.h>
+#include <absl/time/clock.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "Callstack.h"
+#include "SamplingProfiler.h"
+#include "capture_data.pb.h"
+
+using orbit_client_protos::CallstackEvent;
+
+namespace {
+
+constexpr size_t kUniqueCallstackCount = 20'000;
+constexpr size_t kCallstackDepth = 20;
+constexpr size_t kFunctionCount = 200'000;
+// Consecutive samples are mostly of the same thread.
+constexpr size_t kEventsPerThreadSwitch = 50;
+
+void AddCallstackEvents(const std::vector<CallstackID>& callstack_ids,
+                        size_t event_count, int32_t thread_count,
+                        std::mt19937_64* random,
+                        SamplingProfiler* sampling_profiler) {
+  auto* callstacks = sampling_profiler->GetCallstacks();
+  for (size_t i = 0; i < event_count; ++i) {
+    CallstackEvent event;
+    event.set_time(callstacks->size());
+    event.set_thread_id(
+        1 + static_cast<int32_t>(i / kEventsPerThreadSwitch % thread_count));
+    event.set_callstack_hash(callstack_ids[(*random)() % callstack_ids.size()]);
+    callstacks->push_back(event);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const size_t event_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10)
+                                      : 10'000'000;
+  const int32_t thread_count = argc > 2 ? std::atoi(argv[2]) : 64;
+  if (event_count == 0 || thread_count <= 0) {
+    absl::PrintF("Usage: %s [<event count> [<thread count>]]\n", argv[0]);
+    return 1;
+  }
+
+  std::mt19937_64 random(42);
+  SamplingProfiler sampling_profiler;
+  std::vector<CallstackID> callstack_ids;
+  for (size_t i = 0; i < kUniqueCallstackCount; ++i) {
+    CallStack callstack;
+    for (size_t depth = 0; depth < kCallstackDepth; ++depth) {
+      callstack.m_Data.push_back(0x7f0000000000 +
+                                 16 * (random() % kFunctionCount));
+    }
+    callstack_ids.push_back(callstack.Hash());
+    sampling_profiler.AddUniqueCallStack(callstack);
+  }
+  AddCallstackEvents(callstack_ids, event_count, thread_count, &random,
+                     &sampling_profiler);
+
+  absl::Time start = absl::Now();
+  sampling_profiler.ProcessSamples();
+  absl::PrintF("%lu events of %d threads: %.1f ms\n", event_count,
+               thread_count, absl::ToDoubleMilliseconds(absl::Now() - start));
+
+  const size_t more_event_count = event_count / 100;
+  AddCallstackEvents(callstack_ids, more_event_count, thread_count, &random,
+                     &sampling_profiler);
+  start = absl::Now();
+  sampling_profiler.ProcessSamples();
+  absl::PrintF("%lu more events: %.1f ms\n", more_event_count,
+               absl::ToDoubleMilliseconds(absl::Now() - start));
+  return 0;
+}
@@ -0,0 +1,131 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_SORTED_ADDRESS_MAP_H_
+#define ORBIT_CORE_SORTED_ADDRESS_MAP_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// A map from addresses to values, built once, to find the entry containing
+// an address, i.e., the last entry at or before it, like upper_bound and
+// decrementing the iterator on a std::map. The addresses are stored in one
+// contiguous array, apart from the values, and searched without branches, so
+// that a lookup only touches the few cache lines of the addresses it compares
+// instead of the scattered nodes of a tree.
+//
+// As consecutive lookups (the frames of the callstacks of a thread, samples
+// of the same loop) mostly hit the same few entries, each thread also keeps
+// the last entries it found, with the address ranges they cover.
+//
+// Lookups can run in parallel, Assign must not run concurrently with them.
+template <typename T>
+class SortedAddressMap {
+ public:
+  // Replaces the entries. For equal addresses, the first entry is kept, like
+  // std::map::insert does.
+  void Assign(std::vector<std::pair<uint64_t, T>> entries) {
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const auto& a, const auto& b) {
+                       return a.first < b.first;
+                     });
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                              [](const auto& a, const auto& b) {
+                                return a.first == b.first;
+                              }),
+                  entries.end());
+    addresses_.clear();
+    values_.clear();
+    addresses_.reserve(entries.size());
+    values_.reserve(entries.size());
+    for (auto& entry : entries) {
+      addresses_.push_back(entry.first);
+      values_.push_back(std::move(entry.second));
+    }
+    // Entries cached for the previous contents never match the new id.
+    id_ = next_id_.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+
+  [[nodiscard]] bool empty() const { return addresses_.empty(); }
+  [[nodiscard]] size_t size() const { return addresses_.size(); }
+
+  // The value at exactly address, or nullptr.
+  [[nodiscard]] const T* Find(uint64_t address) const {
+    const size_t index = FindIndex(address);
+    if (index == kNotFound || addresses_[index] != address) {
+      return nullptr;
+    }
+    return &values_[index];
+  }
+
+  // The value of the last entry at or before address, or nullptr if there is
+  // none.
+  [[nodiscard]] const T* FindLastAtOrBefore(uint64_t address) const {
+    thread_local std::array<CacheEntry, kCacheSize> cache;
+    thread_local size_t next_cache_entry = 0;
+    for (const CacheEntry& entry : cache) {
+      if (entry.id == id_ && address >= entry.begin && address < entry.end &&
+          entry.index < values_.size()) {
+        return &values_[entry.index];
+      }
+    }
+
+    const size_t index = FindIndex(address);
+    if (index == kNotFound) {
+      return nullptr;
+    }
+    CacheEntry& entry = cache[next_cache_entry];
+    next_cache_entry = (next_cache_entry + 1) % kCacheSize;
+    entry.id = id_;
+    entry.begin = addresses_[index];
+    entry.end = index + 1 < addresses_.size()
+                    ? addresses_[index + 1]
+                    : std::numeric_limits<uint64_t>::max();
+    entry.index = index;
+    return &values_[index];
+  }
+
+ private:
+  static constexpr size_t kNotFound = std::numeric_limits<size_t>::max();
+  static constexpr size_t kCacheSize = 4;
+
+  struct CacheEntry {
+    uint64_t id = 0;
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    size_t index = 0;
+  };
+
+  // The index of the last address at or before address, or kNotFound.
+  [[nodiscard]] size_t FindIndex(uint64_t address) const {
+    if (addresses_.empty() || address < addresses_[0]) {
+      return kNotFound;
+    }
+    // Halves the range in each step, with a conditional move instead of a
+    // branch that the processor can't predict.
+    const uint64_t* base = addresses_.data();
+    size_t count = addresses_.size();
+    while (count > 1) {
+      const size_t half = count / 2;
+      base = base[half] <= address ? base + half : base;
+      count -= half;
+    }
+    return base - addresses_.data();
+  }
+
+  inline static std::atomic<uint64_t> next_id_ = 0;
+
+  // 0 until the first Assign, as ids start at 1.
+  uint64_t id_ = 0;
+  std::vector<uint64_t> addresses_;
+  std::vector<T> values_;
+};
+
+#endif  // ORBIT_CORE_SORTED_ADDRESS_MAP_H_
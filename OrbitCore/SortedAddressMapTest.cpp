@@ -0,0 +1,112 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SortedAddressMap.h"
+
+TEST(SortedAddressMap, Empty) {
+  SortedAddressMap<int> map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.Find(0), nullptr);
+  EXPECT_EQ(map.FindLastAtOrBefore(0), nullptr);
+  EXPECT_EQ(map.FindLastAtOrBefore(100), nullptr);
+
+  map.Assign({});
+  EXPECT_EQ(map.FindLastAtOrBefore(100), nullptr);
+}
+
+TEST(SortedAddressMap, Find) {
+  SortedAddressMap<std::string> map;
+  map.Assign({{30, "c"}, {10, "a"}, {20, "b"}});
+  ASSERT_EQ(map.size(), 3);
+
+  ASSERT_NE(map.Find(20), nullptr);
+  EXPECT_EQ(*map.Find(20), "b");
+  EXPECT_EQ(map.Find(21), nullptr);
+  EXPECT_EQ(map.Find(5), nullptr);
+  EXPECT_EQ(map.Find(31), nullptr);
+}
+
+TEST(SortedAddressMap, FindLastAtOrBefore) {
+  SortedAddressMap<std::string> map;
+  map.Assign({{30, "c"}, {10, "a"}, {20, "b"}});
+
+  EXPECT_EQ(map.FindLastAtOrBefore(9), nullptr);
+  EXPECT_EQ(*map.FindLastAtOrBefore(10), "a");
+  EXPECT_EQ(*map.FindLastAtOrBefore(19), "a");
+  EXPECT_EQ(*map.FindLastAtOrBefore(20), "b");
+  // Hits the cached range of "a" again.
+  EXPECT_EQ(*map.FindLastAtOrBefore(15), "a");
+  EXPECT_EQ(*map.FindLastAtOrBefore(29), "b");
+  EXPECT_EQ(*map.FindLastAtOrBefore(30), "c");
+  EXPECT_EQ(*map.FindLastAtOrBefore(~0ull), "c");
+  EXPECT_EQ(map.FindLastAtOrBefore(0), nullptr);
+}
+
+TEST(SortedAddressMap, KeepsFirstOfEqualAddresses) {
+  SortedAddressMap<std::string> map;
+  map.Assign({{10, "first"}, {20, "b"}, {10, "second"}});
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_EQ(*map.Find(10), "first");
+}
+
+TEST(SortedAddressMap, AssignInvalidatesCachedEntries) {
+  SortedAddressMap<int> map;
+  map.Assign({{10, 1}, {20, 2}});
+  EXPECT_EQ(*map.FindLastAtOrBefore(15), 1);
+
+  map.Assign({{10, 3}, {12, 4}});
+  EXPECT_EQ(*map.FindLastAtOrBefore(15), 4);
+
+  // Another map doesn't see the entries cached for this one.
+  SortedAddressMap<int> other_map;
+  other_map.Assign({{10, 5}});
+  EXPECT_EQ(*other_map.FindLastAtOrBefore(11), 5);
+  EXPECT_EQ(*map.FindLastAtOrBefore(11), 3);
+}
+
+TEST(SortedAddressMap, MatchesStdMap) {
+  std::mt19937_64 random(42);
+  std::map<uint64_t, uint64_t> std_map;
+  std::vector<std::pair<uint64_t, uint64_t>> entries;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    const uint64_t address = random() % 100000;
+    std_map.insert({address, i});
+    entries.emplace_back(address, i);
+  }
+  SortedAddressMap<uint64_t> map;
+  map.Assign(entries);
+  ASSERT_EQ(map.size(), std_map.size());
+
+  auto check = [&](uint64_t seed) {
+    std::mt19937_64 thread_random(seed);
+    for (int i = 0; i < 10000; ++i) {
+      // Nearby addresses, so that the cached entries are hit too.
+      const uint64_t address =
+          i % 2 == 0 ? thread_random() % 110000 : (i * 37) % 110000;
+      auto it = std_map.upper_bound(address);
+      const uint64_t* value = map.FindLastAtOrBefore(address);
+      if (it == std_map.begin()) {
+        EXPECT_EQ(value, nullptr);
+      } else {
+        ASSERT_NE(value, nullptr);
+        EXPECT_EQ(*value, std::prev(it)->second);
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (uint64_t seed = 0; seed < 4; ++seed) {
+    threads.emplace_back(check, seed);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
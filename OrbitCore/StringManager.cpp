@@ -4,31 +4,103 @@
 
 #include "StringManager.h"
 
+#include "absl/hash/hash.h"
+
+StringManager::Table::Table(size_t capacity)
+    : capacity{capacity},
+      slots{std::make_unique<std::atomic<const Entry*>[]>(capacity)} {
+  for (size_t i = 0; i < capacity; ++i) {
+    slots[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+StringManager::StringManager() {
+  absl::MutexLock lock{&mutex_};
+  tables_.push_back(std::make_unique<Table>(kInitialCapacity));
+  table_.store(tables_.back().get(), std::memory_order_release);
+}
+
 bool StringManager::AddIfNotPresent(uint64_t key, std::string_view str) {
   absl::MutexLock lock{&mutex_};
-  if (key_to_string_.contains(key)) {
+  if (Find(key) != nullptr) {
     return false;
   }
-  key_to_string_.emplace(key, str);
+  const Entry* entry = &entries_.emplace_back(Entry{key, std::string(str)});
+
+  // At most half full, so that probes stay short.
+  Table* table = tables_.back().get();
+  if (2 * entries_.size() > table->capacity) {
+    auto larger_table = std::make_unique<Table>(2 * table->capacity);
+    for (const Entry& existing_entry : entries_) {
+      InsertIntoTable(larger_table.get(), &existing_entry);
+    }
+    tables_.push_back(std::move(larger_table));
+    table_.store(tables_.back().get(), std::memory_order_release);
+  } else {
+    InsertIntoTable(table, entry);
+  }
   return true;
 }
 
-std::optional<std::string> StringManager::Get(uint64_t key) {
-  absl::MutexLock lock{&mutex_};
-  auto it = key_to_string_.find(key);
-  if (it != key_to_string_.end()) {
-    return it->second;
-  } else {
-    return std::optional<std::string>{};
+std::optional<std::string> StringManager::Get(uint64_t key) const {
+  std::optional<std::string_view> view = GetView(key);
+  if (!view.has_value()) {
+    return std::nullopt;
   }
+  return std::string(*view);
 }
 
-bool StringManager::Contains(uint64_t key) {
-  absl::MutexLock lock{&mutex_};
-  return key_to_string_.contains(key);
+std::optional<std::string_view> StringManager::GetView(uint64_t key) const {
+  const Entry* entry = Find(key);
+  if (entry == nullptr) {
+    return std::nullopt;
+  }
+  return entry->str;
+}
+
+bool StringManager::Contains(uint64_t key) const {
+  return Find(key) != nullptr;
 }
 
 void StringManager::Clear() {
   absl::MutexLock lock{&mutex_};
-  key_to_string_.clear();
+  auto table = std::make_unique<Table>(kInitialCapacity);
+  table_.store(table.get(), std::memory_order_release);
+  tables_.clear();
+  tables_.push_back(std::move(table));
+  entries_.clear();
+}
+
+absl::flat_hash_map<uint64_t, std::string> StringManager::GetKeyToStringMap()
+    const {
+  absl::MutexLock lock{&mutex_};
+  absl::flat_hash_map<uint64_t, std::string> key_to_string;
+  key_to_string.reserve(entries_.size());
+  for (const Entry& entry : entries_) {
+    key_to_string.emplace(entry.key, entry.str);
+  }
+  return key_to_string;
+}
+
+const StringManager::Entry* StringManager::Find(uint64_t key) const {
+  const Table* table = table_.load(std::memory_order_acquire);
+  const size_t mask = table->capacity - 1;
+  for (size_t i = absl::Hash<uint64_t>{}(key) & mask;; i = (i + 1) & mask) {
+    const Entry* entry = table->slots[i].load(std::memory_order_acquire);
+    if (entry == nullptr) {
+      return nullptr;
+    }
+    if (entry->key == key) {
+      return entry;
+    }
+  }
+}
+
+void StringManager::InsertIntoTable(Table* table, const Entry* entry) {
+  const size_t mask = table->capacity - 1;
+  size_t i = absl::Hash<uint64_t>{}(entry->key) & mask;
+  while (table->slots[i].load(std::memory_order_relaxed) != nullptr) {
+    i = (i + 1) & mask;
+  }
+  table->slots[i].store(entry, std::memory_order_release);
 }
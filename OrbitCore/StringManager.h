@@ -5,28 +5,65 @@
 #ifndef ORBIT_CORE_STRING_MANAGER_H_
 #define ORBIT_CORE_STRING_MANAGER_H_
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
 
+// The strings of a capture by key, e.g., for the user data keys of timers.
+// Strings are only added while capturing, but looked up for the visible
+// timers every frame: the strings are stored in an append-only arena, and
+// lookups go through an open-addressing table of pointers into it that
+// writers only publish fully initialized entries to, without taking a lock.
+// When the table gets too full, writers publish a larger copy of it and keep
+// the previous one alive for the readers still probing it.
 class StringManager {
  public:
-  StringManager() = default;
+  StringManager();
 
   bool AddIfNotPresent(uint64_t key, std::string_view str);
-  std::optional<std::string> Get(uint64_t key);
-  bool Contains(uint64_t key);
+  std::optional<std::string> Get(uint64_t key) const;
+  // Doesn't lock nor copy. The view is valid until Clear.
+  std::optional<std::string_view> GetView(uint64_t key) const;
+  bool Contains(uint64_t key) const;
+  // Invalidates the views returned by GetView, hence not to be called while
+  // strings are looked up on other threads.
   void Clear();
 
-  const absl::flat_hash_map<uint64_t, std::string>& GetKeyToStringMap() const {
-    return key_to_string_;
-  }
+  absl::flat_hash_map<uint64_t, std::string> GetKeyToStringMap() const;
 
  private:
-  absl::flat_hash_map<uint64_t, std::string> key_to_string_;
-  absl::Mutex mutex_;
+  struct Entry {
+    uint64_t key;
+    std::string str;
+  };
+
+  struct Table {
+    explicit Table(size_t capacity);
+    // A power of two.
+    size_t capacity;
+    std::unique_ptr<std::atomic<const Entry*>[]> slots;
+  };
+
+  static constexpr size_t kInitialCapacity = 1024;
+
+  [[nodiscard]] const Entry* Find(uint64_t key) const;
+  static void InsertIntoTable(Table* table, const Entry* entry);
+
+  mutable absl::Mutex mutex_;
+  std::deque<Entry> entries_ ABSL_GUARDED_BY(mutex_);
+  // The last one is the current table.
+  std::vector<std::unique_ptr<Table>> tables_ ABSL_GUARDED_BY(mutex_);
+  std::atomic<const Table*> table_;
 };
 
 #endif  // ORBIT_CORE_STRING_MANAGER_H_
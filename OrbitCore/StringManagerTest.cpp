@@ -4,7 +4,12 @@
 
 #include <gtest/gtest.h>
 
+#include <optional>
+#include <string_view>
+#include <thread>
+
 #include "StringManager.h"
+#include "absl/strings/str_format.h"
 
 TEST(StringManager, Contains) {
   StringManager string_manager;
@@ -27,3 +32,41 @@ TEST(StringManager, Get) {
   EXPECT_EQ("test1", string_manager.Get(0).value_or(""));
   EXPECT_FALSE(string_manager.Get(1).has_value());
 }
+
+TEST(StringManager, GetViewIsStableWhileAdding) {
+  StringManager string_manager;
+  string_manager.AddIfNotPresent(0, "test0");
+  std::string_view view = string_manager.GetView(0).value();
+  // Makes the lookup table grow a few times.
+  for (uint64_t key = 1; key < 10000; ++key) {
+    string_manager.AddIfNotPresent(key, absl::StrFormat("test%u", key));
+  }
+  EXPECT_EQ(view, "test0");
+  EXPECT_EQ(string_manager.GetView(9999).value_or(""), "test9999");
+  EXPECT_FALSE(string_manager.GetView(10000).has_value());
+  EXPECT_EQ(string_manager.GetKeyToStringMap().size(), 10000);
+
+  string_manager.Clear();
+  EXPECT_FALSE(string_manager.Contains(0));
+  EXPECT_TRUE(string_manager.AddIfNotPresent(0, "test1"));
+  EXPECT_EQ(string_manager.GetView(0).value_or(""), "test1");
+}
+
+TEST(StringManager, GetViewWhileAddingOnAnotherThread) {
+  StringManager string_manager;
+  constexpr uint64_t kCount = 100000;
+  std::thread writer([&string_manager] {
+    for (uint64_t key = 0; key < kCount; ++key) {
+      string_manager.AddIfNotPresent(key, absl::StrFormat("%u", key));
+    }
+  });
+  while (!string_manager.Contains(kCount - 1)) {
+    for (uint64_t key = 0; key < kCount; key += 997) {
+      std::optional<std::string_view> view = string_manager.GetView(key);
+      if (view.has_value()) {
+        EXPECT_EQ(*view, absl::StrFormat("%u", key));
+      }
+    }
+  }
+  writer.join();
+}
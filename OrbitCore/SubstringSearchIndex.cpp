@@ -0,0 +1,181 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "SubstringSearchIndex.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+#include "OrbitBase/Logging.h"
+#include "OrbitBase/ParallelFor.h"
+#include "absl/strings/ascii.h"
+
+namespace {
+// Verifying a text is short, so each action of ParallelFor verifies many.
+constexpr size_t kVerificationGrainSize = 4096;
+
+bool ContainsAll(std::string_view text,
+                 const std::vector<std::string_view>& tokens) {
+  for (std::string_view token : tokens) {
+    if (text.find(token) == std::string_view::npos) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+SubstringSearchIndex::SubstringSearchIndex(
+    const std::vector<std::string>& texts) {
+  CHECK(texts.size() <= std::numeric_limits<uint32_t>::max());
+  size_t arena_size = 0;
+  for (const std::string& text : texts) {
+    arena_size += text.size();
+  }
+  arena_.reserve(arena_size);
+  text_offsets_.reserve(texts.size() + 1);
+  for (const std::string& text : texts) {
+    for (char c : text) {
+      arena_.push_back(absl::ascii_tolower(c));
+    }
+    text_offsets_.push_back(arena_.size());
+  }
+
+  // The lists are laid out by counting the texts of each bucket first, and
+  // then filled in the order of the texts, which sorts them.
+  std::vector<uint32_t> buckets;
+  bucket_offsets_.assign(kBucketCount + 1, 0);
+  for (uint32_t i = 0; i < size(); ++i) {
+    GetBuckets(GetLowerCaseText(i), &buckets);
+    for (uint32_t bucket : buckets) {
+      ++bucket_offsets_[bucket + 1];
+    }
+  }
+  for (uint32_t bucket = 0; bucket < kBucketCount; ++bucket) {
+    bucket_offsets_[bucket + 1] += bucket_offsets_[bucket];
+  }
+  postings_.resize(bucket_offsets_[kBucketCount]);
+  std::vector<uint32_t> next_postings(bucket_offsets_.begin(),
+                                      bucket_offsets_.end() - 1);
+  for (uint32_t i = 0; i < size(); ++i) {
+    GetBuckets(GetLowerCaseText(i), &buckets);
+    for (uint32_t bucket : buckets) {
+      postings_[next_postings[bucket]++] = i;
+    }
+  }
+}
+
+void SubstringSearchIndex::GetBuckets(std::string_view text,
+                                      std::vector<uint32_t>* buckets) {
+  buckets->clear();
+  for (size_t i = 0; i + 3 <= text.size(); ++i) {
+    const uint32_t trigram = static_cast<uint8_t>(text[i]) << 16 |
+                             static_cast<uint8_t>(text[i + 1]) << 8 |
+                             static_cast<uint8_t>(text[i + 2]);
+    // Fibonacci hashing spreads the trigrams of similar names.
+    buckets->push_back((trigram * 2654435761u) >> (32 - kBucketBits));
+  }
+  std::sort(buckets->begin(), buckets->end());
+  buckets->erase(std::unique(buckets->begin(), buckets->end()),
+                 buckets->end());
+}
+
+std::vector<uint32_t> SubstringSearchIndex::Find(
+    const std::vector<std::string>& tokens, ThreadPool* thread_pool) const {
+  return Find(tokens, nullptr, thread_pool);
+}
+
+std::vector<uint32_t> SubstringSearchIndex::FindAmong(
+    const std::vector<std::string>& tokens,
+    const std::vector<uint32_t>& candidates, ThreadPool* thread_pool) const {
+  return Find(tokens, &candidates, thread_pool);
+}
+
+std::vector<uint32_t> SubstringSearchIndex::Find(
+    const std::vector<std::string>& tokens,
+    const std::vector<uint32_t>* candidates, ThreadPool* thread_pool) const {
+  if (size() == 0) {
+    return {};
+  }
+  std::vector<std::string_view> non_empty_tokens;
+  std::vector<uint32_t> buckets;
+  std::vector<uint32_t> token_buckets;
+  for (const std::string& token : tokens) {
+    if (token.empty()) continue;
+    non_empty_tokens.push_back(token);
+    GetBuckets(token, &token_buckets);
+    buckets.insert(buckets.end(), token_buckets.begin(), token_buckets.end());
+  }
+  std::sort(buckets.begin(), buckets.end());
+  buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+
+  // The texts in the lists of all buckets, starting from the shortest list, so
+  // that each intersection is at most as long as it.
+  std::sort(buckets.begin(), buckets.end(), [this](uint32_t a, uint32_t b) {
+    return bucket_offsets_[a + 1] - bucket_offsets_[a] <
+           bucket_offsets_[b + 1] - bucket_offsets_[b];
+  });
+  std::vector<uint32_t> to_verify;
+  bool is_restricted = false;
+  if (candidates != nullptr) {
+    to_verify = *candidates;
+    is_restricted = true;
+  }
+  std::vector<uint32_t> intersection;
+  for (uint32_t bucket : buckets) {
+    auto bucket_begin = postings_.begin() + bucket_offsets_[bucket];
+    auto bucket_end = postings_.begin() + bucket_offsets_[bucket + 1];
+    if (!is_restricted) {
+      to_verify.assign(bucket_begin, bucket_end);
+      is_restricted = true;
+      continue;
+    }
+    intersection.clear();
+    std::set_intersection(to_verify.begin(), to_verify.end(), bucket_begin,
+                          bucket_end, std::back_inserter(intersection));
+    to_verify.swap(intersection);
+    if (to_verify.empty()) {
+      return {};
+    }
+  }
+  if (!is_restricted) {
+    to_verify.resize(size());
+    for (uint32_t i = 0; i < size(); ++i) {
+      to_verify[i] = i;
+    }
+  }
+  if (non_empty_tokens.empty()) {
+    return to_verify;
+  }
+
+  // Each chunk is verified into its own list, and the lists concatenated in
+  // order, so that the result stays sorted.
+  const size_t chunk_count =
+      (to_verify.size() + kVerificationGrainSize - 1) / kVerificationGrainSize;
+  std::vector<std::vector<uint32_t>> chunk_matches(chunk_count);
+  auto verify_chunk = [&](size_t chunk) {
+    const size_t chunk_begin = chunk * kVerificationGrainSize;
+    const size_t chunk_end =
+        std::min(to_verify.size(), chunk_begin + kVerificationGrainSize);
+    for (size_t i = chunk_begin; i < chunk_end; ++i) {
+      if (ContainsAll(GetLowerCaseText(to_verify[i]), non_empty_tokens)) {
+        chunk_matches[chunk].push_back(to_verify[i]);
+      }
+    }
+  };
+  if (thread_pool != nullptr && chunk_count > 1) {
+    ParallelFor(thread_pool, 0, chunk_count, verify_chunk);
+  } else {
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+      verify_chunk(chunk);
+    }
+  }
+
+  std::vector<uint32_t> matches;
+  for (const std::vector<uint32_t>& chunk : chunk_matches) {
+    matches.insert(matches.end(), chunk.begin(), chunk.end());
+  }
+  return matches;
+}
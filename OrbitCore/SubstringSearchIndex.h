@@ -0,0 +1,75 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_SUBSTRING_SEARCH_INDEX_H_
+#define ORBIT_CORE_SUBSTRING_SEARCH_INDEX_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "OrbitBase/ThreadPool.h"
+
+// Finds the texts that contain all of a list of tokens, ignoring case, among a
+// large number of texts, e.g., the names of all functions of a process.
+//
+// The texts are copied in lower case into one contiguous arena, once. For each
+// trigram of a text, the index of the text is added to the list of the bucket
+// of the trigram, the trigrams being hashed to kBucketCount buckets. A search
+// intersects the lists of the buckets of the trigrams of the tokens, the
+// shortest list first, and only verifies the texts that are in all of them.
+// Collisions of trigrams only add texts to verify, and tokens shorter than a
+// trigram don't restrict the candidates. Texts are verified in parallel when
+// there are many.
+//
+// Each list is sorted, as texts are added in order, and stored in one array,
+// so that the index costs four bytes per distinct bucket of each text.
+class SubstringSearchIndex {
+ public:
+  SubstringSearchIndex() = default;
+  explicit SubstringSearchIndex(const std::vector<std::string>& texts);
+
+  [[nodiscard]] size_t size() const { return text_offsets_.size() - 1; }
+  [[nodiscard]] std::string_view GetLowerCaseText(uint32_t index) const {
+    return std::string_view(arena_).substr(
+        text_offsets_[index], text_offsets_[index + 1] - text_offsets_[index]);
+  }
+
+  // Returns the indices, in increasing order, of the texts that contain every
+  // token. Tokens must be in lower case, empty tokens are ignored. Texts are
+  // verified on thread_pool and on the calling thread, or only on the calling
+  // thread if thread_pool is nullptr.
+  [[nodiscard]] std::vector<uint32_t> Find(
+      const std::vector<std::string>& tokens,
+      ThreadPool* thread_pool = nullptr) const;
+  // Same as Find, but only for the texts with the indices in candidates, in
+  // increasing order: to refine the result of a previous search as a token
+  // gets longer or more tokens are added.
+  [[nodiscard]] std::vector<uint32_t> FindAmong(
+      const std::vector<std::string>& tokens,
+      const std::vector<uint32_t>& candidates,
+      ThreadPool* thread_pool = nullptr) const;
+
+ private:
+  static constexpr uint32_t kBucketBits = 16;
+  static constexpr uint32_t kBucketCount = 1u << kBucketBits;
+
+  // The distinct buckets of the trigrams of text, sorted.
+  static void GetBuckets(std::string_view text, std::vector<uint32_t>* buckets);
+
+  [[nodiscard]] std::vector<uint32_t> Find(
+      const std::vector<std::string>& tokens,
+      const std::vector<uint32_t>* candidates, ThreadPool* thread_pool) const;
+
+  std::string arena_;
+  // Text i is arena_[text_offsets_[i], text_offsets_[i + 1]).
+  std::vector<uint64_t> text_offsets_ = {0};
+  // The texts of bucket b are postings_[bucket_offsets_[b],
+  // bucket_offsets_[b + 1]).
+  std::vector<uint32_t> bucket_offsets_;
+  std::vector<uint32_t> postings_;
+};
+
+#endif  // ORBIT_CORE_SUBSTRING_SEARCH_INDEX_H_
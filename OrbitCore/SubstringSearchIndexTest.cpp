@@ -0,0 +1,77 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "OrbitBase/ThreadPool.h"
+#include "SubstringSearchIndex.h"
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+namespace {
+
+const std::vector<std::string> kTexts = {
+    "TimeGraph::Draw() OrbitGl", "TimeGraph::ProcessTimer() OrbitGl",
+    "main libc.so", "DrawText() OrbitGl", "a"};
+
+}  // namespace
+
+TEST(SubstringSearchIndex, FindsTextsContainingAllTokens) {
+  SubstringSearchIndex index(kTexts);
+  ASSERT_EQ(index.size(), kTexts.size());
+  EXPECT_EQ(index.GetLowerCaseText(2), "main libc.so");
+
+  EXPECT_THAT(index.Find({"draw"}), ElementsAre(0, 3));
+  EXPECT_THAT(index.Find({"timegraph", "draw"}), ElementsAre(0));
+  EXPECT_THAT(index.Find({"orbitgl"}), ElementsAre(0, 1, 3));
+  EXPECT_THAT(index.Find({"libc", "draw"}), IsEmpty());
+  EXPECT_THAT(index.Find({"nothing"}), IsEmpty());
+}
+
+TEST(SubstringSearchIndex, ShortAndEmptyTokens) {
+  SubstringSearchIndex index(kTexts);
+  // Tokens shorter than a trigram are verified on all texts.
+  EXPECT_THAT(index.Find({"b"}), ElementsAre(0, 1, 2, 3));
+  EXPECT_THAT(index.Find({"()", "ph"}), ElementsAre(0, 1));
+  EXPECT_THAT(index.Find({}), ElementsAre(0, 1, 2, 3, 4));
+  EXPECT_THAT(index.Find({"", "main", ""}), ElementsAre(2));
+}
+
+TEST(SubstringSearchIndex, FindAmong) {
+  SubstringSearchIndex index(kTexts);
+  std::vector<uint32_t> draw = index.Find({"dra"});
+  EXPECT_THAT(draw, ElementsAre(0, 3));
+  EXPECT_THAT(index.FindAmong({"draw", "time"}, draw), ElementsAre(0));
+  EXPECT_THAT(index.FindAmong({"orbitgl"}, {1, 2}), ElementsAre(1));
+  EXPECT_THAT(index.FindAmong({}, {2, 4}), ElementsAre(2, 4));
+}
+
+TEST(SubstringSearchIndex, Empty) {
+  SubstringSearchIndex index;
+  EXPECT_EQ(index.size(), 0u);
+  EXPECT_THAT(index.Find({"draw"}), IsEmpty());
+  EXPECT_THAT(SubstringSearchIndex(std::vector<std::string>{}).Find({"draw"}),
+              IsEmpty());
+}
+
+TEST(SubstringSearchIndex, FindsInParallelInOrder) {
+  std::vector<std::string> texts;
+  std::vector<uint32_t> expected;
+  for (uint32_t i = 0; i < 100'000; ++i) {
+    texts.push_back("Function" + std::to_string(i));
+    if (std::to_string(i).find("42") != std::string::npos) {
+      expected.push_back(i);
+    }
+  }
+  SubstringSearchIndex index(texts);
+  std::unique_ptr<ThreadPool> thread_pool = ThreadPool::CreateWorkStealing(3);
+  EXPECT_EQ(index.Find({"function", "42"}, thread_pool.get()), expected);
+  EXPECT_EQ(index.Find({"function", "42"}), expected);
+  thread_pool->ShutdownAndWait();
+}
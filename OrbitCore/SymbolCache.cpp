@@ -0,0 +1,402 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "SymbolCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#ifndef _WIN32
+#include "MappedFile.h"
+#endif
+#include "Path.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_format.h"
+
+namespace {
+
+constexpr char kMagic[8] = {'O', 'R', 'B', 'S', 'Y', 'M', 'B', 'S'};
+constexpr char kLineTableMagic[8] = {'O', 'R', 'B', 'L', 'I', 'N', 'E', 'S'};
+constexpr uint32_t kFormatVersion = 1;
+
+// The files are only read on the machine that wrote them, hence everything
+// is stored in the byte order of the machine.
+struct StringRef {
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct Header {
+  char magic[sizeof(kMagic)];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t load_bias;
+  uint64_t symbol_count;
+  uint64_t strings_size;
+  StringRef build_id;
+  StringRef symbols_file_path;
+};
+
+struct SymbolRecord {
+  uint64_t address;
+  uint64_t size;
+  StringRef name;
+  StringRef demangled_name;
+  StringRef source_file;
+  uint32_t source_line;
+  uint32_t reserved;
+};
+
+struct LineTableHeader {
+  char magic[sizeof(kLineTableMagic)];
+  uint32_t version;
+  uint32_t row_size;
+  uint64_t row_count;
+  uint64_t file_count;
+  uint64_t strings_size;
+  StringRef build_id;
+};
+
+using LineTableRow = ElfUtils::LineTable::Row;
+
+static_assert(std::is_trivially_copyable_v<Header>);
+static_assert(std::is_trivially_copyable_v<SymbolRecord>);
+static_assert(std::is_trivially_copyable_v<LineTableHeader>);
+static_assert(std::is_trivially_copyable_v<LineTableRow>);
+
+bool IsValid(const StringRef& string_ref, uint64_t strings_size) {
+  return string_ref.offset <= strings_size &&
+         string_ref.size <= strings_size - string_ref.offset;
+}
+
+std::string ToString(const StringRef& string_ref, const char* strings) {
+  return std::string(strings + string_ref.offset, string_ref.size);
+}
+
+// Calls deserialize with the content of file_name.
+template <typename T, typename Deserialize>
+ErrorMessageOr<T> ReadFile(const std::string& file_name,
+                           Deserialize&& deserialize) {
+#ifndef _WIN32
+  OUTCOME_TRY(mapped_file, MappedFile::Open(file_name));
+  return deserialize(mapped_file->data(), mapped_file->size());
+#else
+  std::ifstream file(file_name, std::ios::binary);
+  if (file.fail()) {
+    return ErrorMessage(absl::StrFormat("Unable to open \"%s\"", file_name));
+  }
+  std::string data{std::istreambuf_iterator<char>(file),
+                   std::istreambuf_iterator<char>()};
+  return deserialize(data.data(), data.size());
+#endif
+}
+
+}  // namespace
+
+std::string SymbolCache::Serialize(const std::string& build_id,
+                                   const ModuleSymbols& module_symbols) {
+  std::string strings;
+  auto add_string = [&strings](const std::string& string) {
+    StringRef string_ref{strings.size(), string.size()};
+    strings.append(string);
+    return string_ref;
+  };
+  // Many symbols are in the same source file.
+  absl::flat_hash_map<std::string, StringRef> source_files;
+  auto add_source_file = [&](const std::string& source_file) {
+    auto it = source_files.find(source_file);
+    if (it == source_files.end()) {
+      it = source_files.emplace(source_file, add_string(source_file)).first;
+    }
+    return it->second;
+  };
+
+  Header header{};
+  std::copy(std::begin(kMagic), std::end(kMagic), header.magic);
+  header.version = kFormatVersion;
+  header.record_size = sizeof(SymbolRecord);
+  header.load_bias = module_symbols.load_bias();
+  header.symbol_count = module_symbols.symbol_infos_size();
+  header.build_id = add_string(build_id);
+  header.symbols_file_path = add_string(module_symbols.symbols_file_path());
+
+  std::vector<const SymbolInfo*> symbol_infos;
+  symbol_infos.reserve(module_symbols.symbol_infos_size());
+  for (const SymbolInfo& symbol_info : module_symbols.symbol_infos()) {
+    symbol_infos.push_back(&symbol_info);
+  }
+  std::stable_sort(symbol_infos.begin(), symbol_infos.end(),
+                   [](const SymbolInfo* a, const SymbolInfo* b) {
+                     return a->address() < b->address();
+                   });
+
+  std::vector<SymbolRecord> records(symbol_infos.size());
+  for (size_t i = 0; i < symbol_infos.size(); ++i) {
+    const SymbolInfo& symbol_info = *symbol_infos[i];
+    SymbolRecord& record = records[i];
+    record.address = symbol_info.address();
+    record.size = symbol_info.size();
+    record.name = add_string(symbol_info.name());
+    record.demangled_name = add_string(symbol_info.demangled_name());
+    record.source_file = add_source_file(symbol_info.source_file());
+    record.source_line = symbol_info.source_line();
+    record.reserved = 0;
+  }
+  header.strings_size = strings.size();
+
+  std::string data(sizeof(header) + records.size() * sizeof(SymbolRecord) +
+                       strings.size(),
+                   '\0');
+  char* position = data.data();
+  std::memcpy(position, &header, sizeof(header));
+  position += sizeof(header);
+  if (!records.empty()) {
+    std::memcpy(position, records.data(),
+                records.size() * sizeof(SymbolRecord));
+    position += records.size() * sizeof(SymbolRecord);
+  }
+  std::memcpy(position, strings.data(), strings.size());
+  return data;
+}
+
+ErrorMessageOr<ModuleSymbols> SymbolCache::Deserialize(
+    const std::string& build_id, const char* data, uint64_t size) {
+  Header header;
+  if (size < sizeof(header)) {
+    return ErrorMessage("The symbol cache file is truncated");
+  }
+  std::memcpy(&header, data, sizeof(header));
+  if (!std::equal(std::begin(kMagic), std::end(kMagic), header.magic) ||
+      header.version != kFormatVersion ||
+      header.record_size != sizeof(SymbolRecord)) {
+    return ErrorMessage("The symbol cache file has an unsupported format");
+  }
+  const uint64_t records_size_limit = size - sizeof(header);
+  if (header.symbol_count > records_size_limit / sizeof(SymbolRecord) ||
+      header.strings_size !=
+          records_size_limit - header.symbol_count * sizeof(SymbolRecord)) {
+    return ErrorMessage("The symbol cache file is truncated");
+  }
+  const char* records = data + sizeof(header);
+  const char* strings = records + header.symbol_count * sizeof(SymbolRecord);
+  if (!IsValid(header.build_id, header.strings_size) ||
+      !IsValid(header.symbols_file_path, header.strings_size)) {
+    return ErrorMessage("The symbol cache file is corrupted");
+  }
+  if (ToString(header.build_id, strings) != build_id) {
+    return ErrorMessage(absl::StrFormat(
+        "The symbol cache file is of build id \"%s\" instead of \"%s\"",
+        ToString(header.build_id, strings), build_id));
+  }
+
+  ModuleSymbols module_symbols;
+  module_symbols.set_load_bias(header.load_bias);
+  module_symbols.set_symbols_file_path(
+      ToString(header.symbols_file_path, strings));
+  module_symbols.mutable_symbol_infos()->Reserve(header.symbol_count);
+  for (uint64_t i = 0; i < header.symbol_count; ++i) {
+    SymbolRecord record;
+    std::memcpy(&record, records + i * sizeof(SymbolRecord), sizeof(record));
+    if (!IsValid(record.name, header.strings_size) ||
+        !IsValid(record.demangled_name, header.strings_size) ||
+        !IsValid(record.source_file, header.strings_size)) {
+      return ErrorMessage("The symbol cache file is corrupted");
+    }
+    SymbolInfo* symbol_info = module_symbols.add_symbol_infos();
+    symbol_info->set_address(record.address);
+    symbol_info->set_size(record.size);
+    symbol_info->set_name(ToString(record.name, strings));
+    symbol_info->set_demangled_name(ToString(record.demangled_name, strings));
+    symbol_info->set_source_file(ToString(record.source_file, strings));
+    symbol_info->set_source_line(record.source_line);
+  }
+  return module_symbols;
+}
+
+std::string SymbolCache::SerializeLineTable(
+    const std::string& build_id, const ElfUtils::LineTable& line_table) {
+  std::string strings;
+  auto add_string = [&strings](const std::string& string) {
+    StringRef string_ref{strings.size(), string.size()};
+    strings.append(string);
+    return string_ref;
+  };
+
+  LineTableHeader header{};
+  std::copy(std::begin(kLineTableMagic), std::end(kLineTableMagic),
+            header.magic);
+  header.version = kFormatVersion;
+  header.row_size = sizeof(LineTableRow);
+  header.row_count = line_table.GetRows().size();
+  header.file_count = line_table.GetFileNames().size();
+  header.build_id = add_string(build_id);
+  std::vector<StringRef> file_names;
+  file_names.reserve(line_table.GetFileNames().size());
+  for (const std::string& file_name : line_table.GetFileNames()) {
+    file_names.push_back(add_string(file_name));
+  }
+  header.strings_size = strings.size();
+
+  const size_t rows_size = header.row_count * sizeof(LineTableRow);
+  const size_t file_names_size = header.file_count * sizeof(StringRef);
+  std::string data(sizeof(header) + rows_size + file_names_size +
+                       strings.size(),
+                   '\0');
+  char* position = data.data();
+  std::memcpy(position, &header, sizeof(header));
+  position += sizeof(header);
+  if (rows_size > 0) {
+    std::memcpy(position, line_table.GetRows().data(), rows_size);
+    position += rows_size;
+  }
+  if (file_names_size > 0) {
+    std::memcpy(position, file_names.data(), file_names_size);
+    position += file_names_size;
+  }
+  std::memcpy(position, strings.data(), strings.size());
+  return data;
+}
+
+ErrorMessageOr<ElfUtils::LineTable> SymbolCache::DeserializeLineTable(
+    const std::string& build_id, const char* data, uint64_t size) {
+  LineTableHeader header;
+  if (size < sizeof(header)) {
+    return ErrorMessage("The line table cache file is truncated");
+  }
+  std::memcpy(&header, data, sizeof(header));
+  if (!std::equal(std::begin(kLineTableMagic), std::end(kLineTableMagic),
+                  header.magic) ||
+      header.version != kFormatVersion ||
+      header.row_size != sizeof(LineTableRow)) {
+    return ErrorMessage("The line table cache file has an unsupported format");
+  }
+  const uint64_t size_limit = size - sizeof(header);
+  if (header.row_count > size_limit / sizeof(LineTableRow) ||
+      header.file_count >
+          (size_limit - header.row_count * sizeof(LineTableRow)) /
+              sizeof(StringRef) ||
+      header.strings_size !=
+          size_limit - header.row_count * sizeof(LineTableRow) -
+              header.file_count * sizeof(StringRef)) {
+    return ErrorMessage("The line table cache file is truncated");
+  }
+  const char* rows = data + sizeof(header);
+  const char* file_names = rows + header.row_count * sizeof(LineTableRow);
+  const char* strings = file_names + header.file_count * sizeof(StringRef);
+  if (!IsValid(header.build_id, header.strings_size)) {
+    return ErrorMessage("The line table cache file is corrupted");
+  }
+  if (ToString(header.build_id, strings) != build_id) {
+    return ErrorMessage(absl::StrFormat(
+        "The line table cache file is of build id \"%s\" instead of \"%s\"",
+        ToString(header.build_id, strings), build_id));
+  }
+
+  std::vector<std::string> file_name_strings(header.file_count);
+  for (uint64_t i = 0; i < header.file_count; ++i) {
+    StringRef file_name;
+    std::memcpy(&file_name, file_names + i * sizeof(StringRef),
+                sizeof(file_name));
+    if (!IsValid(file_name, header.strings_size)) {
+      return ErrorMessage("The line table cache file is corrupted");
+    }
+    file_name_strings[i] = ToString(file_name, strings);
+  }
+  std::vector<LineTableRow> row_records(header.row_count);
+  if (header.row_count > 0) {
+    std::memcpy(row_records.data(), rows,
+                header.row_count * sizeof(LineTableRow));
+  }
+  // The rows were sorted when saved, sorting them again is cheap.
+  return ElfUtils::LineTable(std::move(file_name_strings),
+                             std::move(row_records));
+}
+
+ErrorMessageOr<std::string> SymbolCache::GetFileName(
+    const std::string& build_id, const std::string& extension) const {
+  // The build id is the name of the file.
+  if (build_id.empty() ||
+      !std::all_of(build_id.begin(), build_id.end(), absl::ascii_isxdigit)) {
+    return ErrorMessage(
+        absl::StrFormat("Invalid build id \"%s\" for the symbol cache",
+                        build_id));
+  }
+  return Path::JoinPath({directory_, build_id + extension});
+}
+
+ErrorMessageOr<std::string> SymbolCache::GetFileName(
+    const std::string& build_id) const {
+  return GetFileName(build_id, ".symbols");
+}
+
+ErrorMessageOr<std::string> SymbolCache::GetLineTableFileName(
+    const std::string& build_id) const {
+  return GetFileName(build_id, ".lines");
+}
+
+ErrorMessageOr<ModuleSymbols> SymbolCache::Load(
+    const std::string& build_id) const {
+  OUTCOME_TRY(file_name, GetFileName(build_id));
+  return ReadFile<ModuleSymbols>(
+      file_name, [&build_id](const char* data, uint64_t size) {
+        return Deserialize(build_id, data, size);
+      });
+}
+
+ErrorMessageOr<void> SymbolCache::Save(
+    const std::string& build_id, const ModuleSymbols& module_symbols) const {
+  OUTCOME_TRY(file_name, GetFileName(build_id));
+  return WriteFile(file_name, Serialize(build_id, module_symbols));
+}
+
+ErrorMessageOr<ElfUtils::LineTable> SymbolCache::LoadLineTable(
+    const std::string& build_id) const {
+  OUTCOME_TRY(file_name, GetLineTableFileName(build_id));
+  return ReadFile<ElfUtils::LineTable>(
+      file_name, [&build_id](const char* data, uint64_t size) {
+        return DeserializeLineTable(build_id, data, size);
+      });
+}
+
+ErrorMessageOr<void> SymbolCache::SaveLineTable(
+    const std::string& build_id, const ElfUtils::LineTable& line_table) const {
+  OUTCOME_TRY(file_name, GetLineTableFileName(build_id));
+  return WriteFile(file_name, SerializeLineTable(build_id, line_table));
+}
+
+ErrorMessageOr<void> SymbolCache::WriteFile(const std::string& file_name,
+                                            const std::string& data) const {
+  std::error_code error;
+  std::filesystem::create_directories(directory_, error);
+  if (error) {
+    return ErrorMessage(absl::StrFormat("Unable to create \"%s\": %s",
+                                        directory_, error.message()));
+  }
+
+  const std::string temporary_file_name = file_name + ".tmp";
+  {
+    std::ofstream file(temporary_file_name, std::ios::binary);
+    file.write(data.data(), data.size());
+    file.close();
+    if (file.fail()) {
+      std::filesystem::remove(temporary_file_name, error);
+      return ErrorMessage(
+          absl::StrFormat("Unable to write \"%s\"", temporary_file_name));
+    }
+  }
+  std::filesystem::rename(temporary_file_name, file_name, error);
+  if (error) {
+    std::string error_message = error.message();
+    std::filesystem::remove(temporary_file_name, error);
+    return ErrorMessage(absl::StrFormat("Unable to rename \"%s\": %s",
+                                        temporary_file_name, error_message));
+  }
+  return outcome::success();
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_SYMBOL_CACHE_H_
+#define ORBIT_CORE_SYMBOL_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "ElfUtils/LineTable.h"
+#include "OrbitBase/Result.h"
+#include "symbol.pb.h"
+
+// The symbols of the modules loaded before, by build id, so that loading
+// the same module again doesn't parse its debug info again. Each module has
+// one file in directory, in a flat format that is read by mapping it into
+// memory: a header, the symbols as records of fixed size sorted by address,
+// and the strings the records refer to. The line tables of the modules are
+// stored the same way, in a second file.
+class SymbolCache {
+ public:
+  explicit SymbolCache(std::string directory)
+      : directory_(std::move(directory)) {}
+
+  [[nodiscard]] ErrorMessageOr<ModuleSymbols> Load(
+      const std::string& build_id) const;
+  // Replaces the symbols of build_id, if any. The file is written next to
+  // the one it replaces and renamed, so that it is never read partially.
+  [[nodiscard]] ErrorMessageOr<void> Save(
+      const std::string& build_id, const ModuleSymbols& module_symbols) const;
+
+  [[nodiscard]] ErrorMessageOr<ElfUtils::LineTable> LoadLineTable(
+      const std::string& build_id) const;
+  [[nodiscard]] ErrorMessageOr<void> SaveLineTable(
+      const std::string& build_id, const ElfUtils::LineTable& line_table) const;
+
+  [[nodiscard]] ErrorMessageOr<std::string> GetFileName(
+      const std::string& build_id) const;
+  [[nodiscard]] ErrorMessageOr<std::string> GetLineTableFileName(
+      const std::string& build_id) const;
+
+  // The format of the files.
+  [[nodiscard]] static std::string Serialize(
+      const std::string& build_id, const ModuleSymbols& module_symbols);
+  [[nodiscard]] static ErrorMessageOr<ModuleSymbols> Deserialize(
+      const std::string& build_id, const char* data, uint64_t size);
+  [[nodiscard]] static std::string SerializeLineTable(
+      const std::string& build_id, const ElfUtils::LineTable& line_table);
+  [[nodiscard]] static ErrorMessageOr<ElfUtils::LineTable>
+  DeserializeLineTable(const std::string& build_id, const char* data,
+                       uint64_t size);
+
+ private:
+  [[nodiscard]] ErrorMessageOr<std::string> GetFileName(
+      const std::string& build_id, const std::string& extension) const;
+  [[nodiscard]] ErrorMessageOr<void> WriteFile(const std::string& file_name,
+                                               const std::string& data) const;
+
+  const std::string directory_;
+};
+
+#endif  // ORBIT_CORE_SYMBOL_CACHE_H_
@@ -0,0 +1,151 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gmock/gmock-matchers.h>
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+
+#include "SymbolCache.h"
+#include "symbol.pb.h"
+
+namespace {
+
+const std::string kBuildId = "d12d54bc5b72ccce54a408bdeda65e2530740ac8";
+
+ModuleSymbols CreateModuleSymbols() {
+  ModuleSymbols module_symbols;
+  module_symbols.set_load_bias(0x400000);
+  module_symbols.set_symbols_file_path("/path/to/symbols");
+  const uint64_t addresses[] = {0x1300, 0x1100, 0x1200};
+  for (uint64_t address : addresses) {
+    SymbolInfo* symbol_info = module_symbols.add_symbol_infos();
+    symbol_info->set_name("_ZN3Foo3BarEv" + std::to_string(address));
+    symbol_info->set_demangled_name("Foo::Bar()" + std::to_string(address));
+    symbol_info->set_address(address);
+    symbol_info->set_size(0x80);
+    symbol_info->set_source_file("foo.cpp");
+    symbol_info->set_source_line(static_cast<uint32_t>(address / 0x100));
+  }
+  return module_symbols;
+}
+
+}  // namespace
+
+TEST(SymbolCache, SerializeSortsByAddress) {
+  const ModuleSymbols module_symbols = CreateModuleSymbols();
+  const std::string data = SymbolCache::Serialize(kBuildId, module_symbols);
+
+  auto result = SymbolCache::Deserialize(kBuildId, data.data(), data.size());
+  ASSERT_TRUE(result) << result.error().message();
+  const ModuleSymbols& loaded = result.value();
+  EXPECT_EQ(loaded.load_bias(), module_symbols.load_bias());
+  EXPECT_EQ(loaded.symbols_file_path(), module_symbols.symbols_file_path());
+  ASSERT_EQ(loaded.symbol_infos_size(), 3);
+  EXPECT_EQ(loaded.symbol_infos(0).address(), 0x1100);
+  EXPECT_EQ(loaded.symbol_infos(1).address(), 0x1200);
+  EXPECT_EQ(loaded.symbol_infos(2).address(), 0x1300);
+  for (const SymbolInfo& symbol_info : loaded.symbol_infos()) {
+    const std::string address = std::to_string(symbol_info.address());
+    EXPECT_EQ(symbol_info.name(), "_ZN3Foo3BarEv" + address);
+    EXPECT_EQ(symbol_info.demangled_name(), "Foo::Bar()" + address);
+    EXPECT_EQ(symbol_info.size(), 0x80);
+    EXPECT_EQ(symbol_info.source_file(), "foo.cpp");
+    EXPECT_EQ(symbol_info.source_line(), symbol_info.address() / 0x100);
+  }
+}
+
+TEST(SymbolCache, DeserializeRejectsInvalidData) {
+  const std::string data =
+      SymbolCache::Serialize(kBuildId, CreateModuleSymbols());
+
+  EXPECT_FALSE(SymbolCache::Deserialize(kBuildId, data.data(), 10));
+  EXPECT_FALSE(
+      SymbolCache::Deserialize(kBuildId, data.data(), data.size() - 1));
+
+  std::string wrong_magic = data;
+  wrong_magic[0] = 'X';
+  EXPECT_FALSE(SymbolCache::Deserialize(kBuildId, wrong_magic.data(),
+                                        wrong_magic.size()));
+
+  const auto wrong_build_id =
+      SymbolCache::Deserialize("abcdef", data.data(), data.size());
+  ASSERT_FALSE(wrong_build_id);
+  EXPECT_THAT(wrong_build_id.error().message(),
+              testing::HasSubstr("build id"));
+}
+
+TEST(SymbolCache, SaveAndLoad) {
+  const std::string directory =
+      (std::filesystem::temp_directory_path() / "SymbolCacheTest").string();
+  std::filesystem::remove_all(directory);
+  SymbolCache symbol_cache(directory);
+
+  EXPECT_FALSE(symbol_cache.Load(kBuildId));
+
+  const ModuleSymbols module_symbols = CreateModuleSymbols();
+  auto save_result = symbol_cache.Save(kBuildId, module_symbols);
+  ASSERT_TRUE(save_result) << save_result.error().message();
+
+  auto load_result = symbol_cache.Load(kBuildId);
+  ASSERT_TRUE(load_result) << load_result.error().message();
+  EXPECT_EQ(load_result.value().symbol_infos_size(), 3);
+  EXPECT_EQ(load_result.value().symbols_file_path(),
+            module_symbols.symbols_file_path());
+
+  std::filesystem::remove_all(directory);
+}
+
+TEST(SymbolCache, InvalidBuildId) {
+  SymbolCache symbol_cache(std::filesystem::temp_directory_path().string());
+  EXPECT_FALSE(symbol_cache.GetFileName(""));
+  EXPECT_FALSE(symbol_cache.GetFileName("../../etc/passwd"));
+  EXPECT_FALSE(symbol_cache.Save("", CreateModuleSymbols()));
+}
+
+TEST(SymbolCache, SerializeLineTable) {
+  using ElfUtils::LineTable;
+  const LineTable line_table({"a.cpp", "b.cpp"},
+                             {{0x100, 0, 3},
+                              {0x108, 1, 4},
+                              {0x110, LineTable::kNoFile, 0}});
+  const std::string data =
+      SymbolCache::SerializeLineTable(kBuildId, line_table);
+
+  auto result =
+      SymbolCache::DeserializeLineTable(kBuildId, data.data(), data.size());
+  ASSERT_TRUE(result) << result.error().message();
+  EXPECT_EQ(result.value().GetFileNames(), line_table.GetFileNames());
+  ASSERT_EQ(result.value().GetRows().size(), 3);
+  EXPECT_EQ(*result.value().FindLine(0x10a)->file, "b.cpp");
+  EXPECT_FALSE(result.value().FindLine(0x110));
+
+  EXPECT_FALSE(SymbolCache::DeserializeLineTable(
+      "0000000000000000000000000000000000000000", data.data(), data.size()));
+  EXPECT_FALSE(
+      SymbolCache::DeserializeLineTable(kBuildId, data.data(), data.size() - 1));
+  EXPECT_FALSE(SymbolCache::Deserialize(kBuildId, data.data(), data.size()));
+}
+
+TEST(SymbolCache, SaveAndLoadLineTable) {
+  const std::string directory =
+      (std::filesystem::temp_directory_path() / "SymbolCacheLineTableTest")
+          .string();
+  std::filesystem::remove_all(directory);
+  SymbolCache symbol_cache(directory);
+
+  EXPECT_FALSE(symbol_cache.LoadLineTable(kBuildId));
+  auto save_result = symbol_cache.SaveLineTable(
+      kBuildId, ElfUtils::LineTable({"a.cpp"}, {{0x100, 0, 3}}));
+  ASSERT_TRUE(save_result) << save_result.error().message();
+
+  auto load_result = symbol_cache.LoadLineTable(kBuildId);
+  ASSERT_TRUE(load_result) << load_result.error().message();
+  EXPECT_EQ(load_result.value().FindLine(0x104)->line, 3);
+  // The symbols of the same build id are in another file.
+  EXPECT_FALSE(symbol_cache.Load(kBuildId));
+
+  std::filesystem::remove_all(directory);
+}
@@ -11,12 +11,14 @@
 #include <fstream>
 
 #include "ElfUtils/ElfFile.h"
+#include "ElfUtils/ElfSymbols.h"
 #include "OrbitBase/Logging.h"
 #include "Path.h"
 
 namespace {
 
 using ::ElfUtils::ElfFile;
+using ::ElfUtils::ElfSymbols;
 
 std::vector<std::string> ReadSymbolsFile() {
   std::string file_name = Path::GetSymbolsFileName();
@@ -104,6 +106,30 @@ ErrorMessageOr<std::string> FindSymbolsFile(
       module_path));
 }
 
+// Whether file_path has symbols and, unless build_id is empty, that build id.
+bool IsSymbolsFile(const std::string& file_path, const std::string& build_id) {
+  if (!Path::FileExists(file_path)) return false;
+  ErrorMessageOr<std::unique_ptr<ElfFile>> symbols_file =
+      ElfFile::Create(file_path);
+  if (!symbols_file) return false;
+  if (!symbols_file.value()->HasSymtab()) return false;
+  return build_id.empty() || symbols_file.value()->GetBuildId() == build_id;
+}
+
+ErrorMessageOr<ModuleSymbols> LoadSymbolsFromDebugInfoFile(
+    const std::string& module_path, const std::string& debug_info_file_path) {
+  ErrorMessageOr<std::unique_ptr<ElfSymbols>> elf_symbols_result =
+      ElfSymbols::Load(debug_info_file_path);
+
+  if (!elf_symbols_result) {
+    return ErrorMessage(absl::StrFormat(
+        "Failed to load debug symbols for \"%s\" from \"%s\": %s", module_path,
+        debug_info_file_path, elf_symbols_result.error().message()));
+  }
+
+  return elf_symbols_result.value()->ToModuleSymbols();
+}
+
 ErrorMessageOr<ModuleSymbols> FindSymbols(
     const std::string& module_path, const std::string& build_id,
     const std::vector<std::string>& search_paths) {
@@ -114,16 +140,8 @@ ErrorMessageOr<ModuleSymbols> FindSymbols(
     return debug_info_file_path.error();
   }
 
-  ErrorMessageOr<std::unique_ptr<ElfFile>> elf_file_result =
-      ElfFile::Create(debug_info_file_path.value());
-
-  if (!elf_file_result) {
-    return ErrorMessage(absl::StrFormat(
-        "Failed to load debug symbols for \"%s\" from \"%s\": %s", module_path,
-        debug_info_file_path.value(), elf_file_result.error().message()));
-  }
-
-  return elf_file_result.value()->LoadSymbols();
+  return LoadSymbolsFromDebugInfoFile(module_path,
+                                      debug_info_file_path.value());
 }
 
 }  // namespace
@@ -135,7 +153,10 @@ SymbolHelper::SymbolHelper()
                                     "/mnt/developer/debug_symbols/",
                                     "/srv/game/assets/",
                                     "/srv/game/assets/debug_symbols/"},
-      symbols_file_directories_(ReadSymbolsFile()) {}
+      symbols_file_directories_(ReadSymbolsFile()),
+      build_id_index_file_path_(
+          Path::JoinPath({Path::GetCachePath(), "build_id_index.txt"})),
+      build_id_index_(symbols_file_directories_) {}
 
 ErrorMessageOr<ModuleSymbols> SymbolHelper::LoadSymbolsCollector(
     const std::string& module_path) const {
@@ -154,23 +175,98 @@ ErrorMessageOr<ModuleSymbols> SymbolHelper::LoadSymbolsCollector(
     return elf_file->LoadSymbols();
   }
 
-  if (elf_file->GetBuildId().empty()) {
-    return ErrorMessage(absl::StrFormat(
-        "No symbols are contained in the module \"%s\". Symbols cannot be "
-        "loaded from a separate symbols file, because module does not "
-        "contain a build_id,",
-        module_path));
+  ErrorMessageOr<ModuleSymbols> symbols_result = ErrorMessage(absl::StrFormat(
+      "No symbols are contained in the module \"%s\". Symbols cannot be "
+      "loaded from a separate symbols file, because module does not "
+      "contain a build_id,",
+      module_path));
+  if (!elf_file->GetBuildId().empty()) {
+    std::vector<std::string> search_directories =
+        collector_symbol_directories_;
+    search_directories.emplace_back(Path::GetDirectory(module_path));
+    symbols_result =
+        FindSymbols(module_path, elf_file->GetBuildId(), search_directories);
+    if (symbols_result) return symbols_result;
   }
 
-  std::vector<std::string> search_directories = collector_symbol_directories_;
-  search_directories.emplace_back(Path::GetDirectory(module_path));
-
-  return FindSymbols(module_path, elf_file->GetBuildId(), search_directories);
+  // Without a separate symbols file, fall back to .dynsym and .gnu_debugdata.
+  ErrorMessageOr<ModuleSymbols> fallback_symbols_result =
+      elf_file->LoadSymbols();
+  if (fallback_symbols_result) {
+    LOG("Loaded symbols of \"%s\" from its .dynsym or .gnu_debugdata",
+        module_path);
+    return fallback_symbols_result;
+  }
+  return symbols_result;
 }
 
 ErrorMessageOr<ModuleSymbols> SymbolHelper::LoadUsingSymbolsPathFile(
     const std::string& module_path, const std::string& build_id) const {
-  return FindSymbols(module_path, build_id, symbols_file_directories_);
+  ErrorMessageOr<std::string> debug_info_file_path =
+      FindSymbolsFileInSymbolsPath(module_path, build_id);
+  if (!debug_info_file_path) {
+    return debug_info_file_path.error();
+  }
+  return LoadSymbolsFromDebugInfoFile(module_path,
+                                      debug_info_file_path.value());
+}
+
+ErrorMessageOr<std::string> SymbolHelper::FindSymbolsFileInSymbolsPath(
+    const std::string& module_path, const std::string& build_id) const {
+  // As in FindSymbolsFile, the build id of module_path itself is only checked
+  // if one is requested.
+  if (IsSymbolsFile(module_path, build_id)) return module_path;
+
+  if (!build_id.empty()) {
+    absl::MutexLock lock(&build_id_index_mutex_);
+    if (!build_id_index_initialized_) {
+      if (!build_id_index_file_path_.empty() &&
+          Path::FileExists(build_id_index_file_path_)) {
+        ErrorMessageOr<void> result =
+            build_id_index_.Load(build_id_index_file_path_);
+        if (!result) ERROR("%s", result.error().message());
+      }
+      RefreshBuildIdIndex();
+      build_id_index_initialized_ = true;
+    }
+
+    // A miss is retried once after listing the directories that changed.
+    std::optional<std::string> file_path = FindInBuildIdIndex(build_id);
+    if (!file_path.has_value() && RefreshBuildIdIndex()) {
+      file_path = FindInBuildIdIndex(build_id);
+    }
+    if (file_path.has_value()) {
+      LOG("Found debug info for module \"%s\" -> \"%s\"", module_path,
+          file_path.value());
+      return file_path.value();
+    }
+  }
+
+  return ErrorMessage(absl::StrFormat(
+      "Could not find a file with debug symbols for module \"%s\"",
+      module_path));
+}
+
+std::optional<std::string> SymbolHelper::FindInBuildIdIndex(
+    const std::string& build_id) const {
+  std::optional<std::string> file_path = build_id_index_.Find(build_id);
+  if (!file_path.has_value()) return std::nullopt;
+  // The file may have changed since its directory was last listed.
+  if (!IsSymbolsFile(file_path.value(), build_id)) {
+    build_id_index_.Invalidate(file_path.value());
+    return std::nullopt;
+  }
+  return file_path;
+}
+
+bool SymbolHelper::RefreshBuildIdIndex() const {
+  if (!build_id_index_.Refresh()) return false;
+  if (!build_id_index_file_path_.empty()) {
+    ErrorMessageOr<void> result =
+        build_id_index_.Save(build_id_index_file_path_);
+    if (!result) ERROR("%s", result.error().message());
+  }
+  return true;
 }
 
 ErrorMessageOr<std::string> SymbolHelper::FindDebugSymbolsFile(
@@ -180,16 +276,16 @@ ErrorMessageOr<std::string> SymbolHelper::FindDebugSymbolsFile(
 
 ErrorMessageOr<ModuleSymbols> SymbolHelper::LoadSymbolsFromFile(
     const std::string& file_path, const std::string& build_id) const {
-  ErrorMessageOr<std::unique_ptr<ElfFile>> elf_file_result =
-      ElfFile::Create(file_path);
+  ErrorMessageOr<std::unique_ptr<ElfSymbols>> elf_symbols_result =
+      ElfSymbols::Load(file_path);
 
-  if (!elf_file_result) {
+  if (!elf_symbols_result) {
     return ErrorMessage(
         absl::StrFormat("Failed to load debug symbols from \"%s\": %s",
-                        file_path, elf_file_result.error().message()));
+                        file_path, elf_symbols_result.error().message()));
   }
 
-  const std::string& target_build_id = elf_file_result.value()->GetBuildId();
+  const std::string& target_build_id = elf_symbols_result.value()->GetBuildId();
   if (target_build_id != build_id) {
     return ErrorMessage(
         absl::StrFormat("Failed to load debug symbols from \"%s\": invalid "
@@ -197,7 +293,34 @@ ErrorMessageOr<ModuleSymbols> SymbolHelper::LoadSymbolsFromFile(
                         file_path, target_build_id, build_id));
   }
 
-  return elf_file_result.value()->LoadSymbols();
+  return elf_symbols_result.value()->ToModuleSymbols();
+}
+
+ErrorMessageOr<ElfUtils::LineTable> SymbolHelper::LoadLineTable(
+    const std::string& module_path, const std::string& build_id) const {
+  ErrorMessageOr<std::string> file_path =
+      FindSymbolsFileInSymbolsPath(module_path, build_id);
+  if (!file_path) {
+    const std::string cached_file_name = GenerateCachedFileName(module_path);
+    if (!Path::FileExists(cached_file_name)) return file_path.error();
+    file_path = cached_file_name;
+  }
+
+  ErrorMessageOr<std::unique_ptr<ElfFile>> elf_file_result =
+      ElfFile::Create(file_path.value());
+  if (!elf_file_result) {
+    return ErrorMessage(
+        absl::StrFormat("Failed to load line table from \"%s\": %s",
+                        file_path.value(), elf_file_result.error().message()));
+  }
+  const std::string target_build_id = elf_file_result.value()->GetBuildId();
+  if (target_build_id != build_id) {
+    return ErrorMessage(
+        absl::StrFormat("Failed to load line table from \"%s\": invalid "
+                        "build id \"%s\", expected: \"%s\"",
+                        file_path.value(), target_build_id, build_id));
+  }
+  return elf_file_result.value()->LoadLineTable();
 }
 
 std::string SymbolHelper::GenerateCachedFileName(
@@ -4,10 +4,15 @@
 
 #ifndef SYMBOL_HELPER_H_
 #define SYMBOL_HELPER_H_
+#include <optional>
 #include <string>
 #include <vector>
 
+#include "BuildIdIndex.h"
+#include "ElfUtils/LineTable.h"
 #include "OrbitBase/Result.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
 #include "symbol.pb.h"
 
 class SymbolHelper {
@@ -16,15 +21,24 @@ class SymbolHelper {
   SymbolHelper(std::vector<std::string> collector_symbol_directories,
                std::vector<std::string> symbols_file_directories)
       : collector_symbol_directories_(std::move(collector_symbol_directories)),
-        symbols_file_directories_(std::move(symbols_file_directories)){};
+        symbols_file_directories_(std::move(symbols_file_directories)),
+        build_id_index_(symbols_file_directories_){};
 
   [[nodiscard]] ErrorMessageOr<ModuleSymbols> LoadSymbolsCollector(
       const std::string& module_path) const;
+  // Looks for the symbols file in the directories of the symbols path file
+  // by build id, with an index of their files that is refreshed when the
+  // build id is not found, see BuildIdIndex.
   [[nodiscard]] ErrorMessageOr<ModuleSymbols> LoadUsingSymbolsPathFile(
       const std::string& module_path, const std::string& build_id) const;
   [[nodiscard]] ErrorMessageOr<ModuleSymbols> LoadSymbolsFromFile(
       const std::string& file_path, const std::string& build_id) const;
 
+  // Indexes the line tables of the debug symbols of module_path, found as by
+  // LoadUsingSymbolsPathFile or else in the cached copy of the file.
+  [[nodiscard]] ErrorMessageOr<ElfUtils::LineTable> LoadLineTable(
+      const std::string& module_path, const std::string& build_id) const;
+
   [[nodiscard]] ErrorMessageOr<std::string> FindDebugSymbolsFile(
       const std::string& module_path, const std::string& build_id) const;
 
@@ -32,8 +46,26 @@ class SymbolHelper {
       const std::string& file_path) const;
 
  private:
+  // module_path itself if it has symbols, or else the file with build_id in
+  // symbols_file_directories_.
+  [[nodiscard]] ErrorMessageOr<std::string> FindSymbolsFileInSymbolsPath(
+      const std::string& module_path, const std::string& build_id) const;
+  [[nodiscard]] std::optional<std::string> FindInBuildIdIndex(
+      const std::string& build_id) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(build_id_index_mutex_);
+  // Also saves the index if it changed. Returns whether it changed.
+  bool RefreshBuildIdIndex() const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(build_id_index_mutex_);
+
   const std::vector<std::string> collector_symbol_directories_;
   const std::vector<std::string> symbols_file_directories_;
+  // Where the index is saved across sessions, empty for not saving it.
+  const std::string build_id_index_file_path_;
+  mutable absl::Mutex build_id_index_mutex_;
+  // Loaded and refreshed on the first lookup.
+  mutable BuildIdIndex build_id_index_ ABSL_GUARDED_BY(build_id_index_mutex_);
+  mutable bool build_id_index_initialized_
+      ABSL_GUARDED_BY(build_id_index_mutex_) = false;
 };
 
 #endif  // SYMBOL_HELPER_H_
@@ -0,0 +1,137 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Loads the symbols of the given ELF files and compares the lookups of
+// functions by program counter, as made for every frame of every callstack,
+// through Pdb and through the std::map that Pdb used before. Lookups are
+// made at random addresses and in callstack-like streams, where the same
+// few functions are hit again and again.
+//
+// Usage: SymbolLookupBenchmark <elf file>...
+
+#include <absl/strings/str_format.h>
+#include <absl/time/clock.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ElfUtils/ElfFile.h"
+#include "OrbitBase/Logging.h"
+#include "OrbitModule.h"
+#include "Pdb.h"
+#include "capture_data.pb.h"
+#include "symbol.pb.h"
+
+using ElfUtils::ElfFile;
+using orbit_client_protos::FunctionInfo;
+
+namespace {
+
+constexpr uint64_t kModuleAddress = 0x7f0000000000;
+constexpr size_t kLookupCount = 10'000'000;
+
+// As Pdb::GetFunctionFromProgramCounter was implemented on the std::map.
+FunctionInfo* FindInStdMap(const std::map<uint64_t, FunctionInfo*>& map,
+                           uint64_t relative_address) {
+  auto it = map.upper_bound(relative_address);
+  if (it == map.begin()) {
+    return nullptr;
+  }
+  --it;
+  return it->second;
+}
+
+// Addresses of random functions, in random order or in groups of a few
+// functions that repeat, like the frames of the samples of the same loop.
+std::vector<uint64_t> CreateAddresses(const std::vector<uint64_t>& functions,
+                                      bool callstack_like) {
+  std::mt19937_64 random(42);
+  std::vector<uint64_t> addresses;
+  addresses.reserve(kLookupCount);
+  while (addresses.size() < kLookupCount) {
+    if (!callstack_like) {
+      addresses.push_back(functions[random() % functions.size()] + 4);
+      continue;
+    }
+    uint64_t frames[3];
+    for (uint64_t& frame : frames) {
+      frame = functions[random() % functions.size()] + 4;
+    }
+    for (int i = 0; i < 100 && addresses.size() < kLookupCount; ++i) {
+      addresses.push_back(frames[i % 3]);
+    }
+  }
+  return addresses;
+}
+
+void Benchmark(const std::string& path) {
+  auto elf_file = ElfFile::Create(path);
+  if (!elf_file) {
+    ERROR("%s", elf_file.error().message());
+    return;
+  }
+  auto symbols = elf_file.value()->LoadSymbols();
+  if (!symbols) {
+    ERROR("%s", symbols.error().message());
+    return;
+  }
+  Module module(path, kModuleAddress, kModuleAddress + (1ull << 32));
+  std::shared_ptr<Pdb> pdb = module.CreatePdb(symbols.value());
+  if (pdb->GetFunctions().empty()) {
+    ERROR("No functions in \"%s\"", path);
+    return;
+  }
+
+  std::map<uint64_t, FunctionInfo*> std_map;
+  std::vector<uint64_t> function_addresses;
+  for (const auto& function : pdb->GetFunctions()) {
+    std_map.insert({function->address(), function.get()});
+    function_addresses.push_back(function->address());
+  }
+  absl::PrintF("%s: %lu functions\n", path, std_map.size());
+
+  const uint64_t load_bias = pdb->GetLoadBias();
+  for (bool callstack_like : {false, true}) {
+    std::vector<uint64_t> addresses =
+        CreateAddresses(function_addresses, callstack_like);
+    uint64_t checksum = 0;
+
+    absl::Time start = absl::Now();
+    for (uint64_t address : addresses) {
+      checksum += reinterpret_cast<uintptr_t>(FindInStdMap(std_map, address));
+    }
+    const absl::Duration std_map_duration = absl::Now() - start;
+
+    start = absl::Now();
+    for (uint64_t address : addresses) {
+      checksum -= reinterpret_cast<uintptr_t>(
+          pdb->GetFunctionFromProgramCounter(address - load_bias +
+                                             kModuleAddress));
+    }
+    const absl::Duration pdb_duration = absl::Now() - start;
+
+    CHECK(checksum == 0);
+    absl::PrintF("  %-15s std::map %6.1f ns, Pdb %6.1f ns per lookup\n",
+                 callstack_like ? "callstack-like" : "random",
+                 absl::ToDoubleNanoseconds(std_map_duration) / kLookupCount,
+                 absl::ToDoubleNanoseconds(pdb_duration) / kLookupCount);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    absl::PrintF("Usage: %s <elf file>...\n", argv[0]);
+    return 1;
+  }
+  for (int i = 1; i < argc; ++i) {
+    Benchmark(argv[i]);
+  }
+  return 0;
+}
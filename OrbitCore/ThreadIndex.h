@@ -0,0 +1,58 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_THREAD_INDEX_H_
+#define ORBIT_CORE_THREAD_INDEX_H_
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "CallstackTypes.h"
+#include "absl/container/flat_hash_map.h"
+
+// Numbers the threads of a capture densely, from 0, in the order they are
+// first seen, so that the per-thread state can be kept in vectors indexed by
+// thread index: adding an event then costs one hash lookup of its tid rather
+// than one map lookup per per-thread structure.
+class ThreadIndex {
+ public:
+  // The index of thread_id, assigned if it has none yet.
+  uint32_t GetOrAssign(ThreadID thread_id) {
+    auto [it, inserted] = indices_by_thread_id_.try_emplace(
+        thread_id, static_cast<uint32_t>(thread_ids_.size()));
+    if (inserted) {
+      thread_ids_.push_back(thread_id);
+    }
+    return it->second;
+  }
+
+  [[nodiscard]] std::optional<uint32_t> Find(ThreadID thread_id) const {
+    auto it = indices_by_thread_id_.find(thread_id);
+    if (it == indices_by_thread_id_.end()) {
+      return std::nullopt;
+    }
+    return it->second;
+  }
+
+  [[nodiscard]] ThreadID GetThreadId(uint32_t index) const {
+    return thread_ids_[index];
+  }
+  // By index.
+  [[nodiscard]] const std::vector<ThreadID>& GetThreadIds() const {
+    return thread_ids_;
+  }
+  [[nodiscard]] uint32_t size() const { return thread_ids_.size(); }
+
+  void Clear() {
+    indices_by_thread_id_.clear();
+    thread_ids_.clear();
+  }
+
+ private:
+  absl::flat_hash_map<ThreadID, uint32_t> indices_by_thread_id_;
+  std::vector<ThreadID> thread_ids_;
+};
+
+#endif  // ORBIT_CORE_THREAD_INDEX_H_
@@ -0,0 +1,26 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "ThreadIndex.h"
+
+TEST(ThreadIndex, AssignsIndicesInOrderOfFirstSight) {
+  ThreadIndex thread_index;
+  EXPECT_EQ(thread_index.GetOrAssign(42), 0);
+  EXPECT_EQ(thread_index.GetOrAssign(7), 1);
+  EXPECT_EQ(thread_index.GetOrAssign(42), 0);
+  EXPECT_EQ(thread_index.GetOrAssign(0), 2);
+  EXPECT_EQ(thread_index.size(), 3);
+
+  EXPECT_EQ(thread_index.Find(7), 1);
+  EXPECT_FALSE(thread_index.Find(8).has_value());
+  EXPECT_EQ(thread_index.GetThreadId(2), 0);
+  EXPECT_EQ(thread_index.GetThreadIds(), (std::vector<ThreadID>{42, 7, 0}));
+
+  thread_index.Clear();
+  EXPECT_EQ(thread_index.size(), 0);
+  EXPECT_FALSE(thread_index.Find(42).has_value());
+  EXPECT_EQ(thread_index.GetOrAssign(7), 0);
+}
@@ -0,0 +1,113 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ThreadStates.h"
+
+void ThreadStates::AddSchedulingSlice(uint64_t in_ns, uint64_t out_ns) {
+  if (out_ns <= in_ns) return;
+  IntervalIterator previous_it = FindRunningAtOrBefore(in_ns);
+  IntervalIterator next_it = FindRunningAfter(in_ns);
+  if (previous_it != intervals_.end() &&
+      previous_it->second.end_ns > in_ns) {
+    return;
+  }
+  if (next_it != intervals_.end() && next_it->first < out_ns) return;
+
+  // The slice splits the gap it is in, if any, in two.
+  const bool has_previous = previous_it != intervals_.end();
+  const bool has_next = next_it != intervals_.end();
+  const uint64_t previous_end_ns =
+      has_previous ? previous_it->second.end_ns : in_ns;
+  const uint64_t next_begin_ns = has_next ? next_it->first : out_ns;
+  EraseIntervals(previous_end_ns, next_begin_ns);
+  AddInterval(in_ns, out_ns, State::kRunning);
+  if (has_previous) UpdateGap(previous_end_ns, in_ns);
+  if (has_next) UpdateGap(out_ns, next_begin_ns);
+}
+
+void ThreadStates::AddWakeup(uint64_t timestamp_ns, int32_t waker_tid) {
+  wakeups_.emplace(timestamp_ns, waker_tid);
+  IntervalIterator previous_it = FindRunningAtOrBefore(timestamp_ns);
+  IntervalIterator next_it = FindRunningAfter(timestamp_ns);
+  if (previous_it == intervals_.end() || next_it == intervals_.end()) return;
+  const uint64_t previous_end_ns = previous_it->second.end_ns;
+  // Woken up while running.
+  if (previous_end_ns > timestamp_ns) return;
+  UpdateGap(previous_end_ns, next_it->first);
+}
+
+void ThreadStates::Clear() {
+  intervals_.clear();
+  wakeups_.clear();
+}
+
+void ThreadStates::DropIntervalsBefore(uint64_t timestamp_ns) {
+  auto it = intervals_.begin();
+  while (it != intervals_.end() && (it->second.end_ns <= timestamp_ns ||
+                                    it->second.state != State::kRunning)) {
+    ++it;
+  }
+  intervals_.erase(intervals_.begin(), it);
+  wakeups_.erase(wakeups_.begin(), wakeups_.lower_bound(timestamp_ns));
+}
+
+const ThreadStates::Interval* ThreadStates::FindInterval(
+    uint64_t timestamp_ns) const {
+  auto it = intervals_.upper_bound(timestamp_ns);
+  if (it == intervals_.begin()) return nullptr;
+  --it;
+  return timestamp_ns < it->second.end_ns ? &it->second : nullptr;
+}
+
+// There are at most two intervals between two running ones.
+ThreadStates::IntervalIterator ThreadStates::FindRunningAtOrBefore(
+    uint64_t timestamp_ns) const {
+  auto it = intervals_.upper_bound(timestamp_ns);
+  while (it != intervals_.begin()) {
+    --it;
+    if (it->second.state == State::kRunning) return it;
+  }
+  return intervals_.end();
+}
+
+ThreadStates::IntervalIterator ThreadStates::FindRunningAfter(
+    uint64_t timestamp_ns) const {
+  auto it = intervals_.upper_bound(timestamp_ns);
+  while (it != intervals_.end() && it->second.state != State::kRunning) {
+    ++it;
+  }
+  return it;
+}
+
+void ThreadStates::UpdateGap(uint64_t begin_ns, uint64_t end_ns) {
+  EraseIntervals(begin_ns, end_ns);
+  if (end_ns <= begin_ns) return;
+  auto wakeup_it = wakeups_.lower_bound(begin_ns);
+  if (wakeup_it == wakeups_.end() || wakeup_it->first >= end_ns) {
+    AddInterval(begin_ns, end_ns, State::kRunnable);
+    return;
+  }
+  const uint64_t wakeup_ns = wakeup_it->first;
+  if (wakeup_ns > begin_ns) {
+    AddInterval(begin_ns, wakeup_ns, State::kBlocked);
+  }
+  AddInterval(wakeup_ns, end_ns, State::kRunnable, /*has_waker=*/true,
+              wakeup_it->second);
+}
+
+void ThreadStates::EraseIntervals(uint64_t begin_ns, uint64_t end_ns) {
+  intervals_.erase(intervals_.lower_bound(begin_ns),
+                   intervals_.lower_bound(end_ns));
+}
+
+void ThreadStates::AddInterval(uint64_t begin_ns, uint64_t end_ns,
+                               State state, bool has_waker,
+                               int32_t waker_tid) {
+  Interval& interval = intervals_[begin_ns];
+  interval.begin_ns = begin_ns;
+  interval.end_ns = end_ns;
+  interval.state = state;
+  interval.has_waker = has_waker;
+  interval.waker_tid = waker_tid;
+}
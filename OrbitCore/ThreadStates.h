@@ -0,0 +1,100 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_THREAD_STATES_H_
+#define ORBIT_CORE_THREAD_STATES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+
+// The states of a thread over time, derived from its scheduling slices and
+// its wakeups as they arrive, in any order. Between two slices, the thread is
+// blocked until the first wakeup in between, and then runnable until the
+// second slice. A thread that is switched out and runs again without a wakeup
+// in between was preempted, hence runnable all along. The states before the
+// first slice and after the last one are unknown.
+class ThreadStates {
+ public:
+  enum class State { kRunning, kRunnable, kBlocked };
+
+  struct Interval {
+    uint64_t begin_ns = 0;
+    uint64_t end_ns = 0;
+    State state = State::kRunning;
+    // For the kRunnable intervals that begin with a wakeup.
+    bool has_waker = false;
+    int32_t waker_tid = 0;
+  };
+
+  // Slices don't overlap: a slice that overlaps one already added is ignored.
+  void AddSchedulingSlice(uint64_t in_ns, uint64_t out_ns);
+  void AddWakeup(uint64_t timestamp_ns, int32_t waker_tid);
+  void Clear();
+  // Forgets the states of the thread before timestamp_ns, up to the first
+  // slice that ends after it, which is then the first slice.
+  void DropIntervalsBefore(uint64_t timestamp_ns);
+
+  [[nodiscard]] bool IsEmpty() const { return intervals_.empty(); }
+  [[nodiscard]] size_t GetIntervalCount() const { return intervals_.size(); }
+  // The interval timestamp_ns is in, or nullptr.
+  [[nodiscard]] const Interval* FindInterval(uint64_t timestamp_ns) const;
+
+  // Calls on_interval, in order, for the intervals that intersect
+  // [min_ns, max_ns], but skips the ones that begin and end less than
+  // resolution_ns after the beginning of the previous one called with, e.g.,
+  // as they would be drawn in the same pixel.
+  template <typename F>
+  void ForEachInterval(uint64_t min_ns, uint64_t max_ns,
+                       uint64_t resolution_ns, F&& on_interval) const;
+
+ private:
+  using IntervalIterator = std::map<uint64_t, Interval>::const_iterator;
+
+  // The last running interval that begins at or before timestamp_ns, and the
+  // first one that begins after it, or intervals_.end().
+  [[nodiscard]] IntervalIterator FindRunningAtOrBefore(
+      uint64_t timestamp_ns) const;
+  [[nodiscard]] IntervalIterator FindRunningAfter(uint64_t timestamp_ns) const;
+  // Derives the states from the end of a slice to the beginning of the next.
+  void UpdateGap(uint64_t begin_ns, uint64_t end_ns);
+  void EraseIntervals(uint64_t begin_ns, uint64_t end_ns);
+  void AddInterval(uint64_t begin_ns, uint64_t end_ns, State state,
+                   bool has_waker = false, int32_t waker_tid = 0);
+
+  // By begin_ns.
+  std::map<uint64_t, Interval> intervals_;
+  // The tid of the waker by timestamp.
+  std::map<uint64_t, int32_t> wakeups_;
+};
+
+template <typename F>
+void ThreadStates::ForEachInterval(uint64_t min_ns, uint64_t max_ns,
+                                   uint64_t resolution_ns,
+                                   F&& on_interval) const {
+  auto it = intervals_.upper_bound(min_ns);
+  if (it != intervals_.begin() && std::prev(it)->second.end_ns > min_ns) {
+    --it;
+  }
+  while (it != intervals_.end() && it->first <= max_ns) {
+    const Interval& interval = it->second;
+    on_interval(interval);
+    const uint64_t next_ns = interval.begin_ns + resolution_ns;
+    if (interval.end_ns >= next_ns) {
+      ++it;
+      continue;
+    }
+    // The interval that next_ns is in, if it begins after this one, or else
+    // the first one that begins after next_ns.
+    auto next_it = intervals_.upper_bound(next_ns);
+    auto containing_it = std::prev(next_it);
+    if (containing_it != it && containing_it->second.end_ns > next_ns) {
+      next_it = containing_it;
+    }
+    it = next_it;
+  }
+}
+
+#endif  // ORBIT_CORE_THREAD_STATES_H_
@@ -0,0 +1,122 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "ThreadStates.h"
+
+namespace {
+std::vector<ThreadStates::Interval> GetIntervals(
+    const ThreadStates& thread_states) {
+  std::vector<ThreadStates::Interval> intervals;
+  thread_states.ForEachInterval(
+      0, 1000, 1, [&](const ThreadStates::Interval& interval) {
+        intervals.push_back(interval);
+      });
+  return intervals;
+}
+}  // namespace
+
+TEST(ThreadStates, DerivesStatesBetweenSlices) {
+  ThreadStates thread_states;
+  thread_states.AddSchedulingSlice(100, 200);
+  thread_states.AddWakeup(250, 42);
+  thread_states.AddSchedulingSlice(300, 400);
+  // Preempted.
+  thread_states.AddSchedulingSlice(450, 500);
+
+  std::vector<ThreadStates::Interval> intervals = GetIntervals(thread_states);
+  ASSERT_EQ(intervals.size(), 6);
+  EXPECT_EQ(intervals[0].state, ThreadStates::State::kRunning);
+  EXPECT_EQ(intervals[1].state, ThreadStates::State::kBlocked);
+  EXPECT_EQ(intervals[1].begin_ns, 200);
+  EXPECT_EQ(intervals[1].end_ns, 250);
+  EXPECT_EQ(intervals[2].state, ThreadStates::State::kRunnable);
+  EXPECT_EQ(intervals[2].end_ns, 300);
+  EXPECT_TRUE(intervals[2].has_waker);
+  EXPECT_EQ(intervals[2].waker_tid, 42);
+  EXPECT_EQ(intervals[3].state, ThreadStates::State::kRunning);
+  EXPECT_EQ(intervals[4].state, ThreadStates::State::kRunnable);
+  EXPECT_FALSE(intervals[4].has_waker);
+  EXPECT_EQ(intervals[5].begin_ns, 450);
+
+  EXPECT_EQ(thread_states.FindInterval(99), nullptr);
+  EXPECT_EQ(thread_states.FindInterval(260)->state,
+            ThreadStates::State::kRunnable);
+  EXPECT_EQ(thread_states.FindInterval(500), nullptr);
+}
+
+TEST(ThreadStates, UpdatesStatesWithLateEvents) {
+  ThreadStates thread_states;
+  thread_states.AddSchedulingSlice(300, 400);
+  thread_states.AddWakeup(150, 7);
+  EXPECT_EQ(thread_states.GetIntervalCount(), 1);
+
+  thread_states.AddSchedulingSlice(100, 120);
+  EXPECT_EQ(thread_states.FindInterval(130)->state,
+            ThreadStates::State::kBlocked);
+  EXPECT_EQ(thread_states.FindInterval(150)->waker_tid, 7);
+
+  // Splits the gap, the new second one was preempted.
+  thread_states.AddSchedulingSlice(200, 250);
+  EXPECT_EQ(thread_states.FindInterval(180)->state,
+            ThreadStates::State::kRunnable);
+  EXPECT_EQ(thread_states.FindInterval(280)->state,
+            ThreadStates::State::kRunnable);
+  EXPECT_FALSE(thread_states.FindInterval(280)->has_waker);
+  EXPECT_EQ(thread_states.GetIntervalCount(), 6);
+
+  // Overlaps a slice.
+  thread_states.AddSchedulingSlice(240, 260);
+  EXPECT_EQ(thread_states.GetIntervalCount(), 6);
+
+  thread_states.Clear();
+  EXPECT_TRUE(thread_states.IsEmpty());
+}
+
+TEST(ThreadStates, DropsIntervalsBefore) {
+  ThreadStates thread_states;
+  thread_states.AddSchedulingSlice(100, 200);
+  thread_states.AddWakeup(250, 42);
+  thread_states.AddSchedulingSlice(300, 400);
+  thread_states.AddSchedulingSlice(450, 500);
+  EXPECT_EQ(thread_states.GetIntervalCount(), 6);
+
+  // The gap is dropped with the slice before it.
+  thread_states.DropIntervalsBefore(220);
+  EXPECT_EQ(thread_states.GetIntervalCount(), 3);
+  EXPECT_EQ(thread_states.FindInterval(260), nullptr);
+  EXPECT_EQ(thread_states.FindInterval(300)->state,
+            ThreadStates::State::kRunning);
+
+  // The slice that ends after the timestamp is kept.
+  thread_states.DropIntervalsBefore(350);
+  EXPECT_EQ(thread_states.GetIntervalCount(), 3);
+  thread_states.DropIntervalsBefore(1000);
+  EXPECT_TRUE(thread_states.IsEmpty());
+}
+
+TEST(ThreadStates, ForEachIntervalSkipsIntervalsWithinResolution) {
+  ThreadStates thread_states;
+  for (uint64_t i = 0; i < 10; ++i) {
+    thread_states.AddSchedulingSlice(i * 10, i * 10 + 5);
+  }
+  thread_states.AddSchedulingSlice(200, 300);
+
+  std::vector<uint64_t> begins;
+  thread_states.ForEachInterval(
+      0, 1000, 20, [&](const ThreadStates::Interval& interval) {
+        begins.push_back(interval.begin_ns);
+      });
+  EXPECT_EQ(begins, (std::vector<uint64_t>{0, 20, 40, 60, 80, 95, 200}));
+
+  begins.clear();
+  thread_states.ForEachInterval(
+      22, 40, 1, [&](const ThreadStates::Interval& interval) {
+        begins.push_back(interval.begin_ns);
+      });
+  EXPECT_EQ(begins, (std::vector<uint64_t>{20, 25, 30, 35, 40}));
+}
@@ -0,0 +1,189 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "TimerColumnsCodec.h"
+
+#include "absl/container/flat_hash_map.h"
+
+using orbit_client_protos::TimerColumns;
+using orbit_client_protos::TimerInfo;
+
+namespace {
+
+// Adds value to values, if not there yet, and its index to indices.
+template <typename T>
+void AddToDictionary(T value, absl::flat_hash_map<T, uint32_t>* value_indices,
+                     google::protobuf::RepeatedField<T>* values,
+                     google::protobuf::RepeatedField<uint32_t>* indices) {
+  auto [it, inserted] = value_indices->try_emplace(value, values->size());
+  if (inserted) {
+    values->Add(value);
+  }
+  indices->Add(it->second);
+}
+
+// Drops what is implied: the indices with a single value, the value with a
+// single 0.
+template <typename T>
+void TrimDictionary(google::protobuf::RepeatedField<T>* values,
+                    google::protobuf::RepeatedField<uint32_t>* indices) {
+  if (values->size() == 1) {
+    indices->Clear();
+    if (values->Get(0) == 0) {
+      values->Clear();
+    }
+  }
+}
+
+// Clears column if all its values are 0.
+template <typename T>
+void TrimColumn(google::protobuf::RepeatedField<T>* column) {
+  for (const T& value : *column) {
+    if (value != 0) {
+      return;
+    }
+  }
+  column->Clear();
+}
+
+template <typename T>
+bool IsValidColumn(const google::protobuf::RepeatedField<T>& column,
+                   uint32_t count) {
+  return column.empty() || static_cast<uint32_t>(column.size()) == count;
+}
+
+template <typename T>
+bool IsValidDictionary(const google::protobuf::RepeatedField<T>& values,
+                       const google::protobuf::RepeatedField<uint32_t>& indices,
+                       uint32_t count) {
+  if (indices.empty()) {
+    return values.size() <= 1;
+  }
+  if (static_cast<uint32_t>(indices.size()) != count) {
+    return false;
+  }
+  for (uint32_t index : indices) {
+    if (index >= static_cast<uint32_t>(values.size())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T>
+T GetColumnValue(const google::protobuf::RepeatedField<T>& column,
+                 uint32_t i) {
+  return column.empty() ? T{} : column.Get(i);
+}
+
+template <typename T>
+T GetDictionaryValue(const google::protobuf::RepeatedField<T>& values,
+                     const google::protobuf::RepeatedField<uint32_t>& indices,
+                     uint32_t i) {
+  if (values.empty()) {
+    return T{};
+  }
+  return values.Get(indices.empty() ? 0 : indices.Get(i));
+}
+
+}  // namespace
+
+namespace TimerColumnsCodec {
+
+void Encode(const google::protobuf::RepeatedPtrField<TimerInfo>& timers,
+            TimerColumns* columns) {
+  columns->Clear();
+  columns->set_count(timers.size());
+  absl::flat_hash_map<int32_t, uint32_t> process_id_indices;
+  absl::flat_hash_map<int32_t, uint32_t> thread_id_indices;
+  absl::flat_hash_map<uint64_t, uint32_t> function_address_indices;
+  uint64_t previous_start = 0;
+  for (const TimerInfo& timer : timers) {
+    // Differences modulo 2^64, so that any timestamps are kept as they are.
+    columns->add_start_deltas(
+        static_cast<int64_t>(timer.start() - previous_start));
+    columns->add_durations(static_cast<int64_t>(timer.end() - timer.start()));
+    previous_start = timer.start();
+    AddToDictionary(timer.process_id(), &process_id_indices,
+                    columns->mutable_process_id_values(),
+                    columns->mutable_process_id_indices());
+    AddToDictionary(timer.thread_id(), &thread_id_indices,
+                    columns->mutable_thread_id_values(),
+                    columns->mutable_thread_id_indices());
+    AddToDictionary(timer.function_address(), &function_address_indices,
+                    columns->mutable_function_address_values(),
+                    columns->mutable_function_address_indices());
+    columns->add_depths(timer.depth());
+    columns->add_types(timer.type());
+    columns->add_processors(timer.processor());
+    columns->add_callstack_ids(timer.callstack_id());
+    columns->add_user_data_keys(timer.user_data_key());
+    columns->add_timeline_hashes(timer.timeline_hash());
+  }
+
+  TrimDictionary(columns->mutable_process_id_values(),
+                 columns->mutable_process_id_indices());
+  TrimDictionary(columns->mutable_thread_id_values(),
+                 columns->mutable_thread_id_indices());
+  TrimDictionary(columns->mutable_function_address_values(),
+                 columns->mutable_function_address_indices());
+  TrimColumn(columns->mutable_start_deltas());
+  TrimColumn(columns->mutable_durations());
+  TrimColumn(columns->mutable_depths());
+  TrimColumn(columns->mutable_types());
+  TrimColumn(columns->mutable_processors());
+  TrimColumn(columns->mutable_callstack_ids());
+  TrimColumn(columns->mutable_user_data_keys());
+  TrimColumn(columns->mutable_timeline_hashes());
+}
+
+ErrorMessageOr<void> Decode(const TimerColumns& columns,
+                            std::vector<TimerInfo>* timers) {
+  const uint32_t count = columns.count();
+  if (!IsValidColumn(columns.start_deltas(), count) ||
+      !IsValidColumn(columns.durations(), count) ||
+      !IsValidDictionary(columns.process_id_values(),
+                         columns.process_id_indices(), count) ||
+      !IsValidDictionary(columns.thread_id_values(),
+                         columns.thread_id_indices(), count) ||
+      !IsValidColumn(columns.depths(), count) ||
+      !IsValidColumn(columns.types(), count) ||
+      !IsValidColumn(columns.processors(), count) ||
+      !IsValidColumn(columns.callstack_ids(), count) ||
+      !IsValidDictionary(columns.function_address_values(),
+                         columns.function_address_indices(), count) ||
+      !IsValidColumn(columns.user_data_keys(), count) ||
+      !IsValidColumn(columns.timeline_hashes(), count)) {
+    return ErrorMessage("Inconsistent timer columns");
+  }
+
+  timers->reserve(timers->size() + count);
+  uint64_t start = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    TimerInfo& timer = timers->emplace_back();
+    start += static_cast<uint64_t>(GetColumnValue(columns.start_deltas(), i));
+    timer.set_start(start);
+    timer.set_end(
+        start + static_cast<uint64_t>(GetColumnValue(columns.durations(), i)));
+    timer.set_process_id(GetDictionaryValue(columns.process_id_values(),
+                                            columns.process_id_indices(), i));
+    timer.set_thread_id(GetDictionaryValue(columns.thread_id_values(),
+                                           columns.thread_id_indices(), i));
+    timer.set_depth(GetColumnValue(columns.depths(), i));
+    const int type = GetColumnValue(columns.types(), i);
+    timer.set_type(TimerInfo::Type_IsValid(type)
+                       ? static_cast<TimerInfo::Type>(type)
+                       : TimerInfo::kNone);
+    timer.set_processor(GetColumnValue(columns.processors(), i));
+    timer.set_callstack_id(GetColumnValue(columns.callstack_ids(), i));
+    timer.set_function_address(
+        GetDictionaryValue(columns.function_address_values(),
+                           columns.function_address_indices(), i));
+    timer.set_user_data_key(GetColumnValue(columns.user_data_keys(), i));
+    timer.set_timeline_hash(GetColumnValue(columns.timeline_hashes(), i));
+  }
+  return outcome::success();
+}
+
+}  // namespace TimerColumnsCodec
@@ -0,0 +1,30 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_TIMER_COLUMNS_CODEC_H_
+#define ORBIT_CORE_TIMER_COLUMNS_CODEC_H_
+
+#include <vector>
+
+#include "OrbitBase/Result.h"
+#include "capture_data.pb.h"
+
+// Converts between TimerInfos and the TimerColumns that captures store them
+// as, see capture_data.proto.
+namespace TimerColumnsCodec {
+
+void Encode(
+    const google::protobuf::RepeatedPtrField<orbit_client_protos::TimerInfo>&
+        timers,
+    orbit_client_protos::TimerColumns* columns);
+
+// Appends the timers to timers. Fails, leaving timers unchanged, if the
+// columns are inconsistent, as they come from a file.
+ErrorMessageOr<void> Decode(
+    const orbit_client_protos::TimerColumns& columns,
+    std::vector<orbit_client_protos::TimerInfo>* timers);
+
+}  // namespace TimerColumnsCodec
+
+#endif  // ORBIT_CORE_TIMER_COLUMNS_CODEC_H_
@@ -0,0 +1,104 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <google/protobuf/util/message_differencer.h>
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <vector>
+
+#include "TimerColumnsCodec.h"
+
+using orbit_client_protos::TimerColumns;
+using orbit_client_protos::TimerInfo;
+
+namespace {
+
+void ExpectRoundTrip(
+    const google::protobuf::RepeatedPtrField<TimerInfo>& timers) {
+  TimerColumns columns;
+  TimerColumnsCodec::Encode(timers, &columns);
+  std::vector<TimerInfo> decoded_timers;
+  ASSERT_TRUE(TimerColumnsCodec::Decode(columns, &decoded_timers));
+  ASSERT_EQ(decoded_timers.size(), timers.size());
+  for (int i = 0; i < timers.size(); ++i) {
+    EXPECT_TRUE(google::protobuf::util::MessageDifferencer::Equals(
+        decoded_timers[i], timers[i]))
+        << decoded_timers[i].DebugString() << timers[i].DebugString();
+  }
+}
+
+}  // namespace
+
+TEST(TimerColumnsCodec, Empty) {
+  google::protobuf::RepeatedPtrField<TimerInfo> timers;
+  ExpectRoundTrip(timers);
+}
+
+TEST(TimerColumnsCodec, SingleThread) {
+  google::protobuf::RepeatedPtrField<TimerInfo> timers;
+  for (uint64_t i = 0; i < 100; ++i) {
+    TimerInfo* timer = timers.Add();
+    timer->set_start(1000000 + 10 * i);
+    timer->set_end(1000000 + 10 * i + 5);
+    timer->set_process_id(42);
+    timer->set_thread_id(43);
+    timer->set_depth(2);
+    timer->set_function_address(0x1000 + 0x100 * (i % 3));
+  }
+  ExpectRoundTrip(timers);
+
+  TimerColumns columns;
+  TimerColumnsCodec::Encode(timers, &columns);
+  EXPECT_EQ(columns.count(), 100);
+  EXPECT_EQ(columns.thread_id_values_size(), 1);
+  EXPECT_TRUE(columns.thread_id_indices().empty());
+  EXPECT_EQ(columns.function_address_values_size(), 3);
+  EXPECT_EQ(columns.function_address_indices_size(), 100);
+  EXPECT_TRUE(columns.processors().empty());
+  EXPECT_TRUE(columns.timeline_hashes().empty());
+}
+
+TEST(TimerColumnsCodec, AllFields) {
+  google::protobuf::RepeatedPtrField<TimerInfo> timers;
+  for (uint64_t i = 0; i < 10; ++i) {
+    TimerInfo* timer = timers.Add();
+    // Unsorted, and with ends before starts, as they can be in a file.
+    timer->set_start(i % 2 == 0 ? std::numeric_limits<uint64_t>::max() - i
+                                : i);
+    timer->set_end(i * 7);
+    timer->set_process_id(-static_cast<int32_t>(i % 2));
+    timer->set_thread_id(static_cast<int32_t>(i % 4));
+    timer->set_depth(i);
+    timer->set_type(TimerInfo::kGpuActivity);
+    timer->set_processor(static_cast<int32_t>(i) - 5);
+    timer->set_callstack_id(i * 11);
+    timer->set_function_address(i);
+    timer->set_user_data_key(i * 13);
+    timer->set_timeline_hash(i * 17);
+  }
+  ExpectRoundTrip(timers);
+}
+
+TEST(TimerColumnsCodec, InconsistentColumns) {
+  TimerColumns columns;
+  columns.set_count(2);
+  columns.add_start_deltas(1);
+  std::vector<TimerInfo> timers(1);
+  EXPECT_FALSE(TimerColumnsCodec::Decode(columns, &timers));
+  EXPECT_EQ(timers.size(), 1);
+
+  columns.add_start_deltas(1);
+  columns.add_thread_id_values(5);
+  columns.add_thread_id_values(6);
+  columns.add_thread_id_indices(0);
+  columns.add_thread_id_indices(2);
+  EXPECT_FALSE(TimerColumnsCodec::Decode(columns, &timers));
+
+  columns.set_thread_id_indices(1, 1);
+  ASSERT_TRUE(TimerColumnsCodec::Decode(columns, &timers));
+  ASSERT_EQ(timers.size(), 3);
+  EXPECT_EQ(timers[2].start(), 2);
+  EXPECT_EQ(timers[2].thread_id(), 6);
+}
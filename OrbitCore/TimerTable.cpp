@@ -0,0 +1,335 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "TimerTable.h"
+
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/time/time.h"
+
+using orbit_client_protos::TimerInfo;
+
+namespace {
+
+// ANDs mask with whether each value is one of values. Small sets are compared
+// against one by one, which compiles to vector compares, larger ones are
+// looked up.
+template <typename T>
+void FilterByValues(const std::vector<T>& column, const std::vector<T>& values,
+                    std::vector<uint8_t>* mask) {
+  const size_t size = column.size();
+  uint8_t* mask_data = mask->data();
+  const T* column_data = column.data();
+  constexpr size_t kMaxComparedValueCount = 8;
+  if (values.size() <= kMaxComparedValueCount) {
+    std::vector<uint8_t> any(size, 0);
+    uint8_t* any_data = any.data();
+    for (T value : values) {
+      for (size_t i = 0; i < size; ++i) {
+        any_data[i] |= static_cast<uint8_t>(column_data[i] == value);
+      }
+    }
+    for (size_t i = 0; i < size; ++i) {
+      mask_data[i] &= any_data[i];
+    }
+    return;
+  }
+  absl::flat_hash_set<T> value_set(values.begin(), values.end());
+  for (size_t i = 0; i < size; ++i) {
+    if (mask_data[i] != 0 && !value_set.contains(column_data[i])) {
+      mask_data[i] = 0;
+    }
+  }
+}
+
+ErrorMessageOr<uint64_t> ParseDurationNs(std::string_view text) {
+  absl::Duration duration;
+  if (!absl::ParseDuration(std::string(text), &duration) ||
+      duration < absl::ZeroDuration()) {
+    return ErrorMessage(absl::StrFormat("Invalid duration \"%s\"", text));
+  }
+  return absl::ToInt64Nanoseconds(duration);
+}
+
+}  // namespace
+
+void TimerTable::Add(const TimerInfo& timer) {
+  starts_.push_back(timer.start());
+  ends_.push_back(timer.end());
+  function_addresses_.push_back(timer.function_address());
+  thread_ids_.push_back(timer.thread_id());
+  depths_.push_back(timer.depth());
+  types_.push_back(static_cast<uint8_t>(timer.type()));
+  callers_.clear();
+}
+
+void TimerTable::Reserve(size_t size) {
+  starts_.reserve(size);
+  ends_.reserve(size);
+  function_addresses_.reserve(size);
+  thread_ids_.reserve(size);
+  depths_.reserve(size);
+  types_.reserve(size);
+}
+
+void TimerTable::Clear() {
+  starts_.clear();
+  ends_.clear();
+  function_addresses_.clear();
+  thread_ids_.clear();
+  depths_.clear();
+  types_.clear();
+  callers_.clear();
+}
+
+uint64_t TimerTable::GetMinStartNs() const {
+  if (starts_.empty()) {
+    return 0;
+  }
+  return *std::min_element(starts_.begin(), starts_.end());
+}
+
+std::vector<uint8_t> TimerTable::Filter(const TimerQuery& query) const {
+  const size_t size = starts_.size();
+  std::vector<uint8_t> mask(size);
+  // Raw pointers and no branches, so that the loops are vectorized.
+  uint8_t* mask_data = mask.data();
+  const uint64_t* starts = starts_.data();
+  const uint64_t* ends = ends_.data();
+  for (size_t i = 0; i < size; ++i) {
+    mask_data[i] = static_cast<uint8_t>(starts[i] <= query.max_ns) &
+                   static_cast<uint8_t>(ends[i] >= query.min_ns);
+  }
+  if (query.min_depth > 0 ||
+      query.max_depth < std::numeric_limits<uint32_t>::max()) {
+    const uint32_t* depths = depths_.data();
+    for (size_t i = 0; i < size; ++i) {
+      mask_data[i] &= static_cast<uint8_t>(depths[i] >= query.min_depth) &
+                      static_cast<uint8_t>(depths[i] <= query.max_depth);
+    }
+  }
+  if (query.min_duration_ns > 0) {
+    for (size_t i = 0; i < size; ++i) {
+      mask_data[i] &=
+          static_cast<uint8_t>(ends[i] - starts[i] >= query.min_duration_ns);
+    }
+  }
+  if (!query.function_addresses.empty()) {
+    FilterByValues(function_addresses_, query.function_addresses, &mask);
+  }
+  if (!query.thread_ids.empty()) {
+    FilterByValues(thread_ids_, query.thread_ids, &mask);
+  }
+  return mask;
+}
+
+const std::vector<uint64_t>& TimerTable::GetCallers() const {
+  const size_t size = starts_.size();
+  if (callers_.size() == size) {
+    return callers_;
+  }
+  callers_.assign(size, 0);
+  std::vector<uint32_t> order(size);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+    return std::tie(types_[a], thread_ids_[a], starts_[a], depths_[a]) <
+           std::tie(types_[b], thread_ids_[b], starts_[b], depths_[b]);
+  });
+  // The latest timer at each depth of the current thread and type: a timer is
+  // nested in the latest one a level up if it started before it ended.
+  constexpr uint32_t kNoTimer = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> latest_by_depth;
+  for (size_t k = 0; k < size; ++k) {
+    const uint32_t i = order[k];
+    if (k == 0 || types_[i] != types_[order[k - 1]] ||
+        thread_ids_[i] != thread_ids_[order[k - 1]]) {
+      latest_by_depth.clear();
+    }
+    const uint32_t depth = depths_[i];
+    if (depth > 0 && depth <= latest_by_depth.size()) {
+      const uint32_t parent = latest_by_depth[depth - 1];
+      if (parent != kNoTimer && ends_[parent] >= starts_[i]) {
+        callers_[i] = function_addresses_[parent];
+      }
+    }
+    if (latest_by_depth.size() <= depth) {
+      latest_by_depth.resize(depth + 1, kNoTimer);
+    }
+    latest_by_depth[depth] = i;
+  }
+  return callers_;
+}
+
+TimerQueryResult TimerTable::Run(const TimerQuery& query) const {
+  const std::vector<uint8_t> mask = Filter(query);
+  const size_t size = mask.size();
+
+  const uint64_t* keys = nullptr;
+  std::vector<uint64_t> widened_keys;
+  switch (query.group_by) {
+    case TimerQuery::GroupBy::kNone:
+      break;
+    case TimerQuery::GroupBy::kFunction:
+      keys = function_addresses_.data();
+      break;
+    case TimerQuery::GroupBy::kThread:
+      widened_keys.assign(thread_ids_.begin(), thread_ids_.end());
+      keys = widened_keys.data();
+      break;
+    case TimerQuery::GroupBy::kCaller:
+      keys = GetCallers().data();
+      break;
+    case TimerQuery::GroupBy::kDepth:
+      widened_keys.assign(depths_.begin(), depths_.end());
+      keys = widened_keys.data();
+      break;
+  }
+
+  TimerQueryResult result;
+  absl::flat_hash_map<uint64_t, TimerQueryResult::Group> groups;
+  uint64_t first_ns = std::numeric_limits<uint64_t>::max();
+  uint64_t last_ns = 0;
+  for (size_t i = 0; i < size; ++i) {
+    if (mask[i] == 0) {
+      continue;
+    }
+    const uint64_t start_ns = std::max(starts_[i], query.min_ns);
+    const uint64_t end_ns = std::min(ends_[i], query.max_ns);
+    const uint64_t duration_ns = end_ns - start_ns;
+    const uint64_t key = keys != nullptr ? keys[i] : 0;
+    TimerQueryResult::Group& group = groups[key];
+    if (group.count == 0 || duration_ns < group.min_ns) {
+      group.min_ns = duration_ns;
+    }
+    group.key = key;
+    group.max_ns = std::max(group.max_ns, duration_ns);
+    group.total_ns += duration_ns;
+    ++group.count;
+    ++result.match_count;
+    first_ns = std::min(first_ns, start_ns);
+    last_ns = std::max(last_ns, end_ns);
+  }
+
+  result.groups.reserve(groups.size());
+  for (auto& [key, group] : groups) {
+    result.groups.push_back(group);
+  }
+  std::sort(result.groups.begin(), result.groups.end(),
+            [](const TimerQueryResult::Group& a,
+               const TimerQueryResult::Group& b) {
+              return std::tie(a.total_ns, b.key) > std::tie(b.total_ns, a.key);
+            });
+
+  if (query.bucket_count == 0 || result.match_count == 0) {
+    return result;
+  }
+  result.bucket_begin_ns = first_ns;
+  result.bucket_width_ns =
+      std::max<uint64_t>((last_ns - first_ns + query.bucket_count - 1) /
+                             query.bucket_count,
+                         1);
+  result.bucket_total_ns.assign(query.bucket_count, 0);
+  for (size_t i = 0; i < size; ++i) {
+    if (mask[i] == 0) {
+      continue;
+    }
+    const uint64_t start_ns = std::max(starts_[i], query.min_ns) - first_ns;
+    const uint64_t end_ns = std::min(ends_[i], query.max_ns) - first_ns;
+    const uint64_t width_ns = result.bucket_width_ns;
+    size_t bucket = std::min<uint64_t>(start_ns / width_ns,
+                                       query.bucket_count - 1);
+    uint64_t time_ns = start_ns;
+    while (time_ns < end_ns && bucket < query.bucket_count) {
+      const uint64_t bucket_end_ns = (bucket + 1) * width_ns;
+      const uint64_t next_ns = std::min(end_ns, bucket_end_ns);
+      result.bucket_total_ns[bucket] += next_ns - time_ns;
+      time_ns = next_ns;
+      ++bucket;
+    }
+  }
+  return result;
+}
+
+ErrorMessageOr<TimerQuery> ParseTimerQuery(
+    std::string_view text, uint64_t time_origin_ns,
+    const std::function<std::vector<uint64_t>(const std::string&)>&
+        find_functions) {
+  static const absl::flat_hash_map<std::string, TimerQuery::GroupBy>
+      kGroupBys = {{"none", TimerQuery::GroupBy::kNone},
+                   {"function", TimerQuery::GroupBy::kFunction},
+                   {"thread", TimerQuery::GroupBy::kThread},
+                   {"caller", TimerQuery::GroupBy::kCaller},
+                   {"depth", TimerQuery::GroupBy::kDepth}};
+
+  TimerQuery query;
+  for (std::string_view term :
+       absl::StrSplit(text, absl::ByAnyChar(" \t\n"), absl::SkipEmpty())) {
+    std::pair<std::string_view, std::string_view> key_value =
+        absl::StrSplit(term, absl::MaxSplits('=', 1));
+    const std::string_view key = key_value.first;
+    const std::string_view value = key_value.second;
+    const ErrorMessage invalid_value(
+        absl::StrFormat("Invalid value \"%s\" of \"%s\"", value, key));
+
+    if (key == "function") {
+      for (std::string_view name : absl::StrSplit(value, ',')) {
+        std::vector<uint64_t> addresses = find_functions(std::string(name));
+        if (addresses.empty()) {
+          return ErrorMessage(
+              absl::StrFormat("No function \"%s\" in the capture", name));
+        }
+        query.function_addresses.insert(query.function_addresses.end(),
+                                        addresses.begin(), addresses.end());
+      }
+    } else if (key == "thread") {
+      for (std::string_view thread : absl::StrSplit(value, ',')) {
+        int32_t thread_id;
+        if (!absl::SimpleAtoi(thread, &thread_id)) {
+          return invalid_value;
+        }
+        query.thread_ids.push_back(thread_id);
+      }
+    } else if (key == "from" || key == "to") {
+      OUTCOME_TRY(time_ns, ParseDurationNs(value));
+      (key == "from" ? query.min_ns : query.max_ns) = time_origin_ns + time_ns;
+    } else if (key == "depth") {
+      std::pair<std::string_view, std::string_view> range =
+          absl::StrSplit(value, absl::MaxSplits('-', 1));
+      if (range.second.empty()) {
+        range.second = range.first;
+      }
+      if (!absl::SimpleAtoi(range.first, &query.min_depth) ||
+          !absl::SimpleAtoi(range.second, &query.max_depth)) {
+        return invalid_value;
+      }
+    } else if (key == "min_duration") {
+      OUTCOME_TRY(duration_ns, ParseDurationNs(value));
+      query.min_duration_ns = duration_ns;
+    } else if (key == "group") {
+      auto group_by_it = kGroupBys.find(value);
+      if (group_by_it == kGroupBys.end()) {
+        return invalid_value;
+      }
+      query.group_by = group_by_it->second;
+    } else if (key == "buckets") {
+      if (!absl::SimpleAtoi(value, &query.bucket_count)) {
+        return invalid_value;
+      }
+    } else {
+      return ErrorMessage(absl::StrFormat("Unknown query term \"%s\"", term));
+    }
+  }
+  if (query.min_ns > query.max_ns || query.min_depth > query.max_depth) {
+    return ErrorMessage("Empty range in the query");
+  }
+  return query;
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_TIMER_TABLE_H_
+#define ORBIT_CORE_TIMER_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "OrbitBase/Result.h"
+#include "capture_data.pb.h"
+
+// What TimerTable::Run computes: the statistics of the timers that match all
+// of the filters, by group, and optionally the time they take in each of
+// bucket_count buckets of equal width.
+struct TimerQuery {
+  enum class GroupBy { kNone, kFunction, kThread, kCaller, kDepth };
+
+  // Timers overlapping [min_ns, max_ns] match, with their durations clipped
+  // to the range.
+  uint64_t min_ns = 0;
+  uint64_t max_ns = std::numeric_limits<uint64_t>::max();
+  // Empty for any.
+  std::vector<uint64_t> function_addresses;
+  std::vector<int32_t> thread_ids;
+  uint32_t min_depth = 0;
+  uint32_t max_depth = std::numeric_limits<uint32_t>::max();
+  // Of the whole timer, before clipping.
+  uint64_t min_duration_ns = 0;
+
+  GroupBy group_by = GroupBy::kFunction;
+  uint32_t bucket_count = 0;
+};
+
+struct TimerQueryResult {
+  struct Group {
+    // The function address, thread id, caller function address (0 for the
+    // outermost timers) or depth, by TimerQuery::group_by, else 0.
+    uint64_t key = 0;
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t min_ns = 0;
+    uint64_t max_ns = 0;
+  };
+
+  uint64_t match_count = 0;
+  // By total_ns, largest first.
+  std::vector<Group> groups;
+
+  // The time the matching timers take in each bucket, nested timers counted
+  // each. The buckets cover the matching timers within the range of the
+  // query.
+  uint64_t bucket_begin_ns = 0;
+  uint64_t bucket_width_ns = 0;
+  std::vector<uint64_t> bucket_total_ns;
+};
+
+// The timers of a capture as one column per field, for queries to filter and
+// aggregate large captures in a few tight loops over contiguous arrays rather
+// than by walking the TimerInfos one by one. Only the fields queries use are
+// kept, which also makes the table much smaller than the TimerInfos.
+//
+// Not thread-safe, Run included: callers are computed on first use.
+class TimerTable {
+ public:
+  void Add(const orbit_client_protos::TimerInfo& timer);
+  void Reserve(size_t size);
+  void Clear();
+
+  [[nodiscard]] size_t size() const { return starts_.size(); }
+  // The earliest start, or 0 if empty, which the times of text queries are
+  // relative to.
+  [[nodiscard]] uint64_t GetMinStartNs() const;
+
+  [[nodiscard]] TimerQueryResult Run(const TimerQuery& query) const;
+
+ private:
+  [[nodiscard]] std::vector<uint8_t> Filter(const TimerQuery& query) const;
+  [[nodiscard]] const std::vector<uint64_t>& GetCallers() const;
+
+  std::vector<uint64_t> starts_;
+  std::vector<uint64_t> ends_;
+  std::vector<uint64_t> function_addresses_;
+  std::vector<int32_t> thread_ids_;
+  std::vector<uint32_t> depths_;
+  std::vector<uint8_t> types_;
+
+  // The function address of the timer each timer is nested in, 0 for none,
+  // from the depths of the timers of the same thread and type.
+  mutable std::vector<uint64_t> callers_;
+};
+
+// Parses a query of whitespace-separated key=value terms, e.g.,
+// "function=Foo,Bar from=1.5s to=2s group=caller buckets=50", with keys:
+//   function, thread: comma-separated names or thread ids to match;
+//   from, to: times relative to time_origin_ns, e.g., 250ms;
+//   depth: a depth or a range of depths, e.g., 0-2;
+//   min_duration: e.g., 10us;
+//   group: none, function, thread, caller or depth;
+//   buckets: the number of buckets of the histogram.
+// find_functions returns the addresses of the functions of a name, which
+// fails the query if there are none.
+[[nodiscard]] ErrorMessageOr<TimerQuery> ParseTimerQuery(
+    std::string_view text, uint64_t time_origin_ns,
+    const std::function<std::vector<uint64_t>(const std::string&)>&
+        find_functions);
+
+#endif  // ORBIT_CORE_TIMER_TABLE_H_
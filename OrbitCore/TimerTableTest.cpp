@@ -0,0 +1,164 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "TimerTable.h"
+
+using orbit_client_protos::TimerInfo;
+
+namespace {
+
+void AddTimer(TimerTable* table, uint64_t start, uint64_t end,
+              uint64_t function_address, int32_t thread_id, uint32_t depth) {
+  TimerInfo timer;
+  timer.set_start(start);
+  timer.set_end(end);
+  timer.set_function_address(function_address);
+  timer.set_thread_id(thread_id);
+  timer.set_depth(depth);
+  table->Add(timer);
+}
+
+// Thread 1: A(100, 200) calling B(110, 150) and C(160, 190), thread 2:
+// B(120, 320) calling C(130, 140).
+TimerTable CreateTable() {
+  TimerTable table;
+  AddTimer(&table, 160, 190, 0xc, 1, 1);
+  AddTimer(&table, 100, 200, 0xa, 1, 0);
+  AddTimer(&table, 110, 150, 0xb, 1, 1);
+  AddTimer(&table, 120, 320, 0xb, 2, 0);
+  AddTimer(&table, 130, 140, 0xc, 2, 1);
+  return table;
+}
+
+std::vector<uint64_t> FindFunctions(const std::string& name) {
+  if (name == "A") return {0xa};
+  if (name == "B") return {0xb};
+  return {};
+}
+
+}  // namespace
+
+TEST(TimerTable, GroupsByFunction) {
+  TimerTable table = CreateTable();
+  EXPECT_EQ(table.GetMinStartNs(), 100);
+
+  TimerQueryResult result = table.Run(TimerQuery{});
+  EXPECT_EQ(result.match_count, 5);
+  ASSERT_EQ(result.groups.size(), 3);
+  EXPECT_EQ(result.groups[0].key, 0xb);
+  EXPECT_EQ(result.groups[0].count, 2);
+  EXPECT_EQ(result.groups[0].total_ns, 240);
+  EXPECT_EQ(result.groups[0].min_ns, 40);
+  EXPECT_EQ(result.groups[0].max_ns, 200);
+  EXPECT_EQ(result.groups[1].key, 0xa);
+  EXPECT_EQ(result.groups[2].key, 0xc);
+  EXPECT_EQ(result.groups[2].total_ns, 40);
+}
+
+TEST(TimerTable, FiltersAndClipsToTimeRange) {
+  TimerTable table = CreateTable();
+  TimerQuery query;
+  query.min_ns = 180;
+  query.max_ns = 250;
+  query.group_by = TimerQuery::GroupBy::kThread;
+  TimerQueryResult result = table.Run(query);
+  EXPECT_EQ(result.match_count, 3);
+  ASSERT_EQ(result.groups.size(), 2);
+  EXPECT_EQ(result.groups[0].key, 2);
+  EXPECT_EQ(result.groups[0].total_ns, 70);
+  EXPECT_EQ(result.groups[1].key, 1);
+  EXPECT_EQ(result.groups[1].count, 2);
+  EXPECT_EQ(result.groups[1].total_ns, 30);
+}
+
+TEST(TimerTable, FiltersByColumns) {
+  TimerTable table = CreateTable();
+  TimerQuery query;
+  query.function_addresses = {0xb, 0xc};
+  query.thread_ids = {1};
+  query.group_by = TimerQuery::GroupBy::kNone;
+  TimerQueryResult result = table.Run(query);
+  ASSERT_EQ(result.groups.size(), 1);
+  EXPECT_EQ(result.groups[0].count, 2);
+  EXPECT_EQ(result.groups[0].total_ns, 70);
+
+  query = TimerQuery{};
+  query.min_depth = 1;
+  query.min_duration_ns = 30;
+  query.group_by = TimerQuery::GroupBy::kDepth;
+  result = table.Run(query);
+  ASSERT_EQ(result.groups.size(), 1);
+  EXPECT_EQ(result.groups[0].key, 1);
+  EXPECT_EQ(result.groups[0].count, 2);
+}
+
+TEST(TimerTable, GroupsByCaller) {
+  TimerTable table = CreateTable();
+  TimerQuery query;
+  query.function_addresses = {0xc};
+  query.group_by = TimerQuery::GroupBy::kCaller;
+  TimerQueryResult result = table.Run(query);
+  ASSERT_EQ(result.groups.size(), 2);
+  EXPECT_EQ(result.groups[0].key, 0xa);
+  EXPECT_EQ(result.groups[0].total_ns, 30);
+  EXPECT_EQ(result.groups[1].key, 0xb);
+  EXPECT_EQ(result.groups[1].total_ns, 10);
+
+  // Callers are recomputed for the timers added since.
+  AddTimer(&table, 210, 220, 0xc, 1, 0);
+  result = table.Run(query);
+  ASSERT_EQ(result.groups.size(), 3);
+  EXPECT_EQ(result.groups[1].key, 0);
+  EXPECT_EQ(result.groups[1].total_ns, 10);
+}
+
+TEST(TimerTable, ComputesTimeBuckets) {
+  TimerTable table = CreateTable();
+  TimerQuery query;
+  query.thread_ids = {2};
+  query.bucket_count = 4;
+  TimerQueryResult result = table.Run(query);
+  EXPECT_EQ(result.bucket_begin_ns, 120);
+  EXPECT_EQ(result.bucket_width_ns, 50);
+  EXPECT_EQ(result.bucket_total_ns,
+            (std::vector<uint64_t>{60, 50, 50, 50}));
+}
+
+TEST(TimerTable, ParsesQueries) {
+  ErrorMessageOr<TimerQuery> query = ParseTimerQuery(
+      "function=A,B thread=2 from=10ns to=1us depth=1-3 min_duration=5ns "
+      "group=caller buckets=7",
+      100, FindFunctions);
+  ASSERT_FALSE(query.has_error()) << query.error().message();
+  EXPECT_EQ(query.value().function_addresses,
+            (std::vector<uint64_t>{0xa, 0xb}));
+  EXPECT_EQ(query.value().thread_ids, std::vector<int32_t>{2});
+  EXPECT_EQ(query.value().min_ns, 110);
+  EXPECT_EQ(query.value().max_ns, 1100);
+  EXPECT_EQ(query.value().min_depth, 1);
+  EXPECT_EQ(query.value().max_depth, 3);
+  EXPECT_EQ(query.value().min_duration_ns, 5);
+  EXPECT_EQ(query.value().group_by, TimerQuery::GroupBy::kCaller);
+  EXPECT_EQ(query.value().bucket_count, 7);
+
+  query = ParseTimerQuery("", 100, FindFunctions);
+  ASSERT_FALSE(query.has_error());
+  EXPECT_EQ(query.value().group_by, TimerQuery::GroupBy::kFunction);
+
+  query = ParseTimerQuery("depth=2", 0, FindFunctions);
+  ASSERT_FALSE(query.has_error());
+  EXPECT_EQ(query.value().min_depth, 2);
+  EXPECT_EQ(query.value().max_depth, 2);
+
+  EXPECT_TRUE(ParseTimerQuery("function=D", 0, FindFunctions).has_error());
+  EXPECT_TRUE(ParseTimerQuery("thread=x", 0, FindFunctions).has_error());
+  EXPECT_TRUE(ParseTimerQuery("group=module", 0, FindFunctions).has_error());
+  EXPECT_TRUE(ParseTimerQuery("from=2s to=1s", 0, FindFunctions).has_error());
+  EXPECT_TRUE(ParseTimerQuery("color=red", 0, FindFunctions).has_error());
+}
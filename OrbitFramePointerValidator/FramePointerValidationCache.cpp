@@ -0,0 +1,73 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "include/OrbitFramePointerValidator/FramePointerValidationCache.h"
+
+#include "absl/container/flat_hash_set.h"
+
+std::optional<bool> FramePointerValidationCache::HasFramePointers(
+    const std::string& build_id, const CodeBlock& function) const {
+  absl::MutexLock lock(&mutex_);
+  auto module_it = validated_functions_.find(build_id);
+  if (module_it == validated_functions_.end()) {
+    return std::nullopt;
+  }
+  auto function_it = module_it->second.find(function.offset());
+  if (function_it == module_it->second.end() ||
+      function_it->second.size != function.size()) {
+    return std::nullopt;
+  }
+  return function_it->second.has_frame_pointers;
+}
+
+std::vector<CodeBlock> FramePointerValidationCache::GetUnvalidatedFunctions(
+    const std::string& build_id,
+    const std::vector<CodeBlock>& functions) const {
+  absl::MutexLock lock(&mutex_);
+  auto module_it = validated_functions_.find(build_id);
+  if (module_it == validated_functions_.end()) {
+    return functions;
+  }
+  std::vector<CodeBlock> unvalidated_functions;
+  for (const CodeBlock& function : functions) {
+    auto function_it = module_it->second.find(function.offset());
+    if (function_it == module_it->second.end() ||
+        function_it->second.size != function.size()) {
+      unvalidated_functions.push_back(function);
+    }
+  }
+  return unvalidated_functions;
+}
+
+void FramePointerValidationCache::AddValidatedFunctions(
+    const std::string& build_id, const std::vector<CodeBlock>& functions,
+    const std::vector<CodeBlock>& fpo_functions) {
+  absl::flat_hash_set<uint64_t> fpo_function_offsets;
+  for (const CodeBlock& function : fpo_functions) {
+    fpo_function_offsets.insert(function.offset());
+  }
+
+  absl::MutexLock lock(&mutex_);
+  absl::flat_hash_map<uint64_t, ValidatedFunction>& module_functions =
+      validated_functions_[build_id];
+  for (const CodeBlock& function : functions) {
+    ValidatedFunction& validated_function = module_functions[function.offset()];
+    validated_function.size = function.size();
+    validated_function.has_frame_pointers =
+        !fpo_function_offsets.contains(function.offset());
+  }
+}
+
+void FramePointerValidationCache::AddValidatedModule(
+    const std::string& build_id, bool is_frame_pointer_safe) {
+  absl::MutexLock lock(&mutex_);
+  is_frame_pointer_safe_by_build_id_[build_id] = is_frame_pointer_safe;
+}
+
+bool FramePointerValidationCache::IsFramePointerSafe(
+    const std::string& build_id) const {
+  absl::MutexLock lock(&mutex_);
+  auto it = is_frame_pointer_safe_by_build_id_.find(build_id);
+  return it != is_frame_pointer_safe_by_build_id_.end() && it->second;
+}
@@ -0,0 +1,51 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "include/OrbitFramePointerValidator/FramePointerValidationCache.h"
+
+namespace {
+CodeBlock MakeCodeBlock(uint64_t offset, uint64_t size) {
+  CodeBlock code_block;
+  code_block.set_offset(offset);
+  code_block.set_size(size);
+  return code_block;
+}
+}  // namespace
+
+TEST(FramePointerValidationCache, CachesResultsByBuildIdAndOffset) {
+  FramePointerValidationCache cache;
+  const std::vector<CodeBlock> functions{MakeCodeBlock(0x100, 0x10),
+                                         MakeCodeBlock(0x200, 0x20)};
+  EXPECT_EQ(cache.GetUnvalidatedFunctions("build_id", functions).size(), 2);
+  EXPECT_FALSE(cache.HasFramePointers("build_id", functions[0]).has_value());
+
+  cache.AddValidatedFunctions("build_id", functions, {functions[1]});
+  EXPECT_EQ(cache.HasFramePointers("build_id", functions[0]), true);
+  EXPECT_EQ(cache.HasFramePointers("build_id", functions[1]), false);
+  EXPECT_FALSE(
+      cache.HasFramePointers("other_build_id", functions[0]).has_value());
+  // Another size at the same offset.
+  EXPECT_FALSE(cache.HasFramePointers("build_id", MakeCodeBlock(0x100, 0x8))
+                   .has_value());
+
+  const std::vector<CodeBlock> unvalidated_functions =
+      cache.GetUnvalidatedFunctions(
+          "build_id",
+          {functions[1], MakeCodeBlock(0x300, 0x30), functions[0]});
+  ASSERT_EQ(unvalidated_functions.size(), 1);
+  EXPECT_EQ(unvalidated_functions[0].offset(), 0x300);
+}
+
+TEST(FramePointerValidationCache, IsFramePointerSafe) {
+  FramePointerValidationCache cache;
+  EXPECT_FALSE(cache.IsFramePointerSafe("build_id"));
+  cache.AddValidatedModule("build_id", true);
+  cache.AddValidatedModule("other_build_id", false);
+  EXPECT_TRUE(cache.IsFramePointerSafe("build_id"));
+  EXPECT_FALSE(cache.IsFramePointerSafe("other_build_id"));
+}
@@ -6,42 +6,82 @@
 
 #include <capstone/capstone.h>
 
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+
 #include "OrbitBase/Logging.h"
+#include "OrbitBase/ParallelFor.h"
 #include "OrbitBase/UniqueResource.h"
 #include "include/OrbitFramePointerValidator/FunctionFramePointerValidator.h"
 
+namespace {
+// A capstone handle is not shared between threads, hence the functions are
+// validated in chunks, each with its own handle.
+constexpr size_t kFunctionsPerChunk = 256;
+}  // namespace
+
 std::optional<std::vector<CodeBlock>> FramePointerValidator::GetFpoFunctions(
     const std::vector<CodeBlock>& functions, const std::string& file_name,
-    bool is_64_bit) {
-  std::vector<CodeBlock> result;
+    bool is_64_bit, ThreadPool* thread_pool) {
+  std::ifstream instream(file_name, std::ios::in | std::ios::binary);
+  std::vector<uint8_t> binary((std::istreambuf_iterator<char>(instream)),
+                              std::istreambuf_iterator<char>());
 
   cs_mode mode = is_64_bit ? CS_MODE_64 : CS_MODE_32;
-  csh temp_handle;
-  if (cs_open(CS_ARCH_X86, mode, &temp_handle) != CS_ERR_OK) {
-    ERROR("Unable to open capstone.");
-    return {};
-  }
-  OrbitBase::unique_resource handle{std::move(temp_handle),
-                                    [](csh handle) { cs_close(&handle); }};
+  std::vector<uint8_t> is_fpo_function(functions.size(), 0);
+  std::atomic<bool> capstone_failed = false;
+  auto validate_chunk = [&](size_t chunk) {
+    csh temp_handle;
+    if (cs_open(CS_ARCH_X86, mode, &temp_handle) != CS_ERR_OK) {
+      capstone_failed = true;
+      return;
+    }
+    OrbitBase::unique_resource handle{std::move(temp_handle),
+                                      [](csh handle) { cs_close(&handle); }};
 
-  cs_option(handle, CS_OPT_DETAIL, CS_OPT_ON);
+    cs_option(handle, CS_OPT_DETAIL, CS_OPT_ON);
 
-  std::ifstream instream(file_name, std::ios::in | std::ios::binary);
-  std::vector<uint8_t> binary((std::istreambuf_iterator<char>(instream)),
-                              std::istreambuf_iterator<char>());
+    const size_t chunk_begin = chunk * kFunctionsPerChunk;
+    const size_t chunk_end =
+        std::min(functions.size(), chunk_begin + kFunctionsPerChunk);
+    for (size_t i = chunk_begin; i < chunk_end; ++i) {
+      const CodeBlock& function = functions[i];
+      uint64_t function_size = function.size();
+      if (function_size == 0) {
+        continue;
+      }
+
+      FunctionFramePointerValidator validator{
+          handle, binary.data() + function.offset(),
+          static_cast<size_t>(function.size())};
+
+      if (!validator.Validate()) {
+        is_fpo_function[i] = 1;
+      }
+    }
+  };
 
-  for (const auto& function : functions) {
-    uint64_t function_size = function.size();
-    if (function_size == 0) {
-      continue;
+  const size_t chunk_count =
+      (functions.size() + kFunctionsPerChunk - 1) / kFunctionsPerChunk;
+  if (thread_pool != nullptr) {
+    ParallelFor(thread_pool, 0, chunk_count, validate_chunk);
+  } else {
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+      validate_chunk(chunk);
     }
+  }
 
-    FunctionFramePointerValidator validator{
-        handle, binary.data() + function.offset(), static_cast<size_t>(function.size())};
+  if (capstone_failed) {
+    ERROR("Unable to open capstone.");
+    return {};
+  }
 
-    if (!validator.Validate()) {
-      result.push_back(function);
+  std::vector<CodeBlock> result;
+  for (size_t i = 0; i < functions.size(); ++i) {
+    if (is_fpo_function[i]) {
+      result.push_back(functions[i]);
     }
   }
   return result;
-}
\ No newline at end of file
+}
@@ -65,4 +65,17 @@ TEST(FramePointerValidator, GetFpoFunctions) {
 
   EXPECT_THAT(fpo_function_names, testing::UnorderedElementsAre(
                                       "_start", "main", "__libc_csu_init"));
+
+  std::unique_ptr<ThreadPool> thread_pool = ThreadPool::CreateWorkStealing(2);
+  std::optional<std::vector<CodeBlock>> parallel_fpo_functions =
+      FramePointerValidator::GetFpoFunctions(function_infos, test_elf_file,
+                                             true, thread_pool.get());
+  thread_pool->ShutdownAndWait();
+
+  ASSERT_TRUE(parallel_fpo_functions.has_value());
+  ASSERT_EQ(parallel_fpo_functions->size(), fpo_functions->size());
+  for (size_t i = 0; i < fpo_functions->size(); ++i) {
+    EXPECT_EQ((*parallel_fpo_functions)[i].offset(),
+              (*fpo_functions)[i].offset());
+  }
 }
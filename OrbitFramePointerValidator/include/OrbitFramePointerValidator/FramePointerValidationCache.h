@@ -0,0 +1,59 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_FRAME_POINTER_VALIDATION_CACHE_H_
+#define ORBIT_CORE_FRAME_POINTER_VALIDATION_CACHE_H_
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "code_block.pb.h"
+
+// The results of the validations of functions with FramePointerValidator, by
+// build-id of the module and by offset of the function, so that a function is
+// only validated once per module even across captures. Thread-safe.
+class FramePointerValidationCache {
+ public:
+  // Whether the function was validated as having frame pointers, or nullopt if
+  // it was not validated yet. A function of the same offset but of another
+  // size is not considered validated.
+  [[nodiscard]] std::optional<bool> HasFramePointers(
+      const std::string& build_id, const CodeBlock& function) const;
+  // The functions that were not validated yet, in the order they were given.
+  [[nodiscard]] std::vector<CodeBlock> GetUnvalidatedFunctions(
+      const std::string& build_id,
+      const std::vector<CodeBlock>& functions) const;
+
+  // Adds the results of the validation of functions, where fpo_functions are
+  // the ones that failed it, as returned by GetFpoFunctions.
+  void AddValidatedFunctions(const std::string& build_id,
+                             const std::vector<CodeBlock>& functions,
+                             const std::vector<CodeBlock>& fpo_functions);
+
+  // For when all the functions of the module were validated: the module is
+  // frame-pointer-safe if all of them have frame pointers.
+  void AddValidatedModule(const std::string& build_id,
+                          bool is_frame_pointer_safe);
+  // False if the module was never validated as a whole.
+  [[nodiscard]] bool IsFramePointerSafe(const std::string& build_id) const;
+
+ private:
+  struct ValidatedFunction {
+    uint64_t size = 0;
+    bool has_frame_pointers = false;
+  };
+
+  mutable absl::Mutex mutex_;
+  // By build-id, then by offset of the function.
+  absl::flat_hash_map<std::string,
+                      absl::flat_hash_map<uint64_t, ValidatedFunction>>
+      validated_functions_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::string, bool> is_frame_pointer_safe_by_build_id_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+#endif  // ORBIT_CORE_FRAME_POINTER_VALIDATION_CACHE_H_
@@ -6,8 +6,10 @@
 #define ORBIT_CORE_FRAME_POINTER_VALIDATOR_H_
 
 #include <optional>
+#include <string>
 #include <vector>
 
+#include "OrbitBase/ThreadPool.h"
 #include "code_block.pb.h"
 
 class FramePointerValidator {
@@ -15,9 +17,12 @@ class FramePointerValidator {
   // Checks all given functions if they were compiled with frame pointers and
   // returns the functions, where validation failed. If there was an error
   // during validation, nullopt will be return.
+  // The functions are validated in parallel on thread_pool and on the calling
+  // thread, or only on the calling thread if thread_pool is nullptr. The
+  // functions returned are in the order they were given in either way.
   static std::optional<std::vector<CodeBlock>> GetFpoFunctions(
       const std::vector<CodeBlock>& functions, const std::string& file_name,
-      bool is_64_bit);
+      bool is_64_bit, ThreadPool* thread_pool = nullptr);
 };
 
 #endif  // ORBIT_CORE_FRAME_POINTER_VALIDATOR_H_
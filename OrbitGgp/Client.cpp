@@ -7,7 +7,10 @@
 #include <QEventLoop>
 #include <QPointer>
 #include <QProcess>
+#include <QSettings>
 #include <QTimer>
+#include <algorithm>
+#include <utility>
 
 #include "OrbitBase/Logging.h"
 #include "OrbitGgp/Error.h"
@@ -19,6 +22,17 @@ namespace OrbitGgp {
 namespace {
 
 constexpr int kDefaultTimeoutInMs = 10'000;
+// The ssh info of an instance is fetched again after this long.
+constexpr qint64 kSshInfoMaxAgeInS = 10 * 60;
+// The number of instances whose ssh info is prefetched on each listing.
+constexpr int kMaxSshInfoPrefetches = 3;
+
+constexpr const char* kInstanceListSettingsKey = "ggp/instance_list";
+constexpr const char* kLastUsedInstanceSettingsKey = "ggp/last_used_instance";
+
+QSettings CreateSettings() {
+  return QSettings{"The Orbit Authors", "Orbit Profiler"};
+}
 
 void RunProcessWithTimeout(
     const QString& program, const QStringList& arguments, QObject* parent,
@@ -93,18 +107,62 @@ outcome::result<QPointer<Client>> Client::Create(QObject* parent) {
   return QPointer<Client>(new Client{parent});
 }
 
+QVector<Instance> Client::GetCachedInstances() const {
+  const QByteArray json =
+      CreateSettings().value(kInstanceListSettingsKey).toByteArray();
+  if (json.isEmpty()) return {};
+  outcome::result<QVector<Instance>> instances =
+      Instance::GetListFromJson(json);
+  if (!instances) return {};
+  return std::move(instances.value());
+}
+
+std::optional<Instance> Client::GetLastUsedInstance(
+    const QVector<Instance>& instances) const {
+  const QString id =
+      CreateSettings().value(kLastUsedInstanceSettingsKey).toString();
+  if (id.isEmpty()) return std::nullopt;
+  auto it = std::find_if(
+      instances.begin(), instances.end(),
+      [&id](const Instance& instance) { return instance.id == id; });
+  if (it == instances.end()) return std::nullopt;
+  return *it;
+}
+
 void Client::GetInstancesAsync(
     const std::function<void(outcome::result<QVector<Instance>>)>& callback) {
   CHECK(callback);
 
-  RunProcessWithTimeout("ggp", {"instance", "list", "-s"}, this,
-                        [callback](outcome::result<QByteArray> result) {
-                          if (!result) {
-                            callback(result.error());
-                          } else {
-                            callback(Instance::GetListFromJson(result.value()));
-                          }
-                        });
+  RunProcessWithTimeout(
+      "ggp", {"instance", "list", "-s"}, this,
+      [this, callback](outcome::result<QByteArray> result) {
+        if (!result) {
+          callback(result.error());
+          return;
+        }
+        outcome::result<QVector<Instance>> instances =
+            Instance::GetListFromJson(result.value());
+        if (instances) {
+          CreateSettings().setValue(kInstanceListSettingsKey, result.value());
+
+          std::optional<Instance> last_used_instance =
+              GetLastUsedInstance(instances.value());
+          int prefetch_count = 0;
+          if (last_used_instance) {
+            PrefetchSshInfo(last_used_instance.value());
+            ++prefetch_count;
+          }
+          for (const Instance& instance : instances.value()) {
+            if (prefetch_count == kMaxSshInfoPrefetches) break;
+            if (last_used_instance && instance.id == last_used_instance->id) {
+              continue;
+            }
+            PrefetchSshInfo(instance);
+            ++prefetch_count;
+          }
+        }
+        callback(std::move(instances));
+      });
 }
 
 void Client::GetSshInfoAsync(
@@ -112,16 +170,71 @@ void Client::GetSshInfoAsync(
     const std::function<void(outcome::result<SshInfo>)>& callback) {
   CHECK(callback);
 
+  CreateSettings().setValue(kLastUsedInstanceSettingsKey, ggp_instance.id);
+  FetchSshInfo(ggp_instance, callback);
+}
+
+void Client::PrefetchSshInfo(const Instance& ggp_instance) {
+  FetchSshInfo(ggp_instance, nullptr);
+}
+
+void Client::FetchSshInfo(
+    const Instance& ggp_instance,
+    const std::function<void(outcome::result<SshInfo>)>& callback) {
+  auto it = ssh_info_fetches_.find(ggp_instance.id);
+  if (it != ssh_info_fetches_.end() &&
+      it->ip_address == ggp_instance.ip_address) {
+    if (!it->ssh_info) {
+      if (callback) it->callbacks.push_back(callback);
+      return;
+    }
+    if (it->fetch_time.secsTo(QDateTime::currentDateTimeUtc()) <
+        kSshInfoMaxAgeInS) {
+      if (callback) callback(it->ssh_info.value());
+      return;
+    }
+  }
+
+  SshInfoFetch& fetch = ssh_info_fetches_[ggp_instance.id];
+  // The callbacks of a fetch for a previous address get the new ssh info.
+  std::vector<std::function<void(outcome::result<SshInfo>)>> callbacks =
+      std::move(fetch.callbacks);
+  fetch = SshInfoFetch{};
+  fetch.fetch_id = next_fetch_id_++;
+  fetch.ip_address = ggp_instance.ip_address;
+  fetch.callbacks = std::move(callbacks);
+  if (callback) fetch.callbacks.push_back(callback);
+
   const QStringList arguments{"ssh", "init", "-s", "--instance",
                               ggp_instance.id};
-  RunProcessWithTimeout("ggp", arguments, this,
-                        [callback](outcome::result<QByteArray> result) {
-                          if (!result) {
-                            callback(result.error());
-                          } else {
-                            callback(SshInfo::CreateFromJson(result.value()));
-                          }
-                        });
+  RunProcessWithTimeout(
+      "ggp", arguments, this,
+      [this, id = ggp_instance.id,
+       fetch_id = fetch.fetch_id](outcome::result<QByteArray> result) {
+        auto it = ssh_info_fetches_.find(id);
+        if (it == ssh_info_fetches_.end() || it->fetch_id != fetch_id ||
+            it->ssh_info) {
+          return;
+        }
+
+        outcome::result<SshInfo> ssh_info =
+            result ? SshInfo::CreateFromJson(result.value())
+                   : outcome::result<SshInfo>{result.error()};
+        // The callbacks can start other fetches.
+        std::vector<std::function<void(outcome::result<SshInfo>)>>
+            callbacks = std::move(it->callbacks);
+        if (ssh_info) {
+          it->ssh_info = ssh_info.value();
+          it->fetch_time = QDateTime::currentDateTimeUtc();
+          it->callbacks.clear();
+        } else {
+          // Failures are not cached.
+          ssh_info_fetches_.erase(it);
+        }
+        for (const auto& callback : callbacks) {
+          callback(ssh_info);
+        }
+      });
 }
 
 }  // namespace OrbitGgp
@@ -5,11 +5,17 @@
 #ifndef ORBIT_GGP_CLIENT_H_
 #define ORBIT_GGP_CLIENT_H_
 
+#include <QDateTime>
+#include <QHash>
 #include <QObject>
+#include <QString>
 #include <QVector>
+#include <cstdint>
 #include <functional>
+#include <optional>
 #include <outcome.hpp>
 #include <string>
+#include <vector>
 
 #include "Instance.h"
 #include "SshInfo.h"
@@ -22,14 +28,47 @@ class Client : public QObject {
  public:
   static outcome::result<QPointer<Client>> Create(QObject* parent);
 
+  // The list of the last successful GetInstancesAsync, also of a previous
+  // session, to show while the list is loaded again. Empty if there is none.
+  [[nodiscard]] QVector<Instance> GetCachedInstances() const;
+  // The instance of the last GetSshInfoAsync, also of a previous session, if
+  // it is in instances.
+  [[nodiscard]] std::optional<Instance> GetLastUsedInstance(
+      const QVector<Instance>& instances) const;
+
+  // Also prefetches the ssh info of the last used instance and of the first
+  // few other listed ones, in parallel.
   void GetInstancesAsync(
       const std::function<void(outcome::result<QVector<Instance>>)>& callback);
+  // Calls callback right away when the ssh info of the instance was fetched
+  // recently, and shares a fetch that is already running.
   void GetSshInfoAsync(
       const Instance& ggp_instance,
       const std::function<void(outcome::result<SshInfo>)>& callback);
+  // Fetches the ssh info of the instance for a later GetSshInfoAsync.
+  void PrefetchSshInfo(const Instance& ggp_instance);
 
  private:
   explicit Client(QObject* parent) : QObject(parent) {}
+
+  // callback can be empty.
+  void FetchSshInfo(
+      const Instance& ggp_instance,
+      const std::function<void(outcome::result<SshInfo>)>& callback);
+
+  struct SshInfoFetch {
+    // To ignore the result of a fetch that was replaced by another one.
+    uint64_t fetch_id = 0;
+    // The ssh info is fetched again when the address of the instance changed.
+    QString ip_address;
+    std::optional<SshInfo> ssh_info;
+    QDateTime fetch_time;
+    // While the fetch is running.
+    std::vector<std::function<void(outcome::result<SshInfo>)>> callbacks;
+  };
+  // By instance id.
+  QHash<QString, SshInfoFetch> ssh_info_fetches_;
+  uint64_t next_fetch_id_ = 1;
 };
 
 }  // namespace OrbitGgp
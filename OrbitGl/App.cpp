@@ -7,9 +7,13 @@
 #include <absl/flags/flag.h>
 #include <absl/strings/str_format.h>
 #include <absl/strings/str_join.h>
+#include <absl/time/clock.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <cstdio>
 #include <fstream>
 #include <outcome.hpp>
 #include <thread>
@@ -23,6 +27,7 @@
 #include "Disassembler.h"
 #include "DisassemblyReport.h"
 #include "EventTracer.h"
+#include "FlameGraphWindow.h"
 #include "FunctionUtils.h"
 #include "FunctionsDataView.h"
 #include "GlCanvas.h"
@@ -35,6 +40,7 @@
 #include "Log.h"
 #include "ModulesDataView.h"
 #include "OrbitBase/Logging.h"
+#include "OrbitBase/ParallelFor.h"
 #include "OrbitBase/Tracing.h"
 #include "OrbitVersion.h"
 #include "Params.h"
@@ -55,14 +61,24 @@
 #endif
 
 ABSL_DECLARE_FLAG(bool, devmode);
+ABSL_DECLARE_FLAG(bool, auto_save_captures);
+ABSL_DECLARE_FLAG(uint32_t, live_capture_window_minutes);
+ABSL_DECLARE_FLAG(uint32_t, instrumented_function_sampling_ratio);
 
 using orbit_client_protos::CallstackEvent;
 using orbit_client_protos::FunctionInfo;
+using orbit_client_protos::FunctionStats;
 using orbit_client_protos::LinuxAddressInfo;
 using orbit_client_protos::PresetFile;
 using orbit_client_protos::PresetInfo;
 using orbit_client_protos::TimerInfo;
 
+namespace {
+// Refreshing the views more often would make them hard to read while the
+// counts change, and take time from the main thread for little benefit.
+constexpr absl::Duration kLiveCallTreeUpdateInterval = absl::Seconds(1);
+}  // namespace
+
 std::unique_ptr<OrbitApp> GOrbitApp;
 float GFontSize;
 bool DoZoom = false;
@@ -70,10 +86,12 @@ bool DoZoom = false;
 OrbitApp::OrbitApp(ApplicationOptions&& options,
                    std::unique_ptr<MainThreadExecutor> main_thread_executor)
     : options_(std::move(options)),
-      main_thread_executor_(std::move(main_thread_executor)) {
+      main_thread_executor_(std::move(main_thread_executor)),
+      symbol_cache_(Path::JoinPath({Path::GetCachePath(), "symbols"})) {
   thread_pool_ =
       ThreadPool::Create(4 /*min_size*/, 256 /*max_size*/, absl::Seconds(1));
   data_manager_ = std::make_unique<DataManager>(std::this_thread::get_id());
+  string_manager_ = std::make_shared<StringManager>();
 }
 
 //-----------------------------------------------------------------------------
@@ -94,36 +112,185 @@ std::string OrbitApp::FindFile(const std::string& caption,
   return std::string();
 }
 
-void OrbitApp::OnTimer(const TimerInfo& timer_info) {
-  GCurrentTimeGraph->ProcessTimer(timer_info);
+void OrbitApp::OnTimers(absl::Span<TimerInfo> timers) {
+  if (capture_stream_writer_ != nullptr) {
+    capture_stream_writer_->AddTimers(timers);
+  }
+  GCurrentTimeGraph->EnqueueTimers(timers);
 }
 
 void OrbitApp::OnKeyAndString(uint64_t key, std::string str) {
+  if (capture_stream_writer_ != nullptr) {
+    capture_stream_writer_->AddKeyAndString(key, str);
+  }
   string_manager_->AddIfNotPresent(key, std::move(str));
 }
 
 void OrbitApp::OnCallstack(CallStack callstack) {
-  Capture::GSamplingProfiler->AddUniqueCallStack(callstack);
+  if (capture_stream_writer_ != nullptr) {
+    capture_stream_writer_->AddCallstack(callstack);
+  }
+  live_call_tree_samples_.AddCallstack(callstack);
+  off_cpu_call_tree_samples_.AddCallstack(callstack);
+  allocation_call_tree_samples_.AddCallstack(callstack);
+  Capture::GSamplingProfiler->AddUniqueCallStack(std::move(callstack));
 }
 
 void OrbitApp::OnCallstackEvent(CallstackEvent callstack_event) {
+  if (capture_stream_writer_ != nullptr) {
+    capture_stream_writer_->AddCallstackEvent(callstack_event);
+  }
   if (Capture::GSamplingProfiler == nullptr) {
     ERROR("GSamplingProfiler is null, ignoring callstack event.");
     return;
   }
+  live_call_tree_samples_.AddCallstackEvent(callstack_event);
   Capture::GSamplingProfiler->AddCallStack(callstack_event);
   GEventTracer.GetEventBuffer().AddCallstackEvent(
       callstack_event.time(), callstack_event.callstack_hash(),
       callstack_event.thread_id());
 }
 
+void OrbitApp::OnCallstackSampleCounts(
+    int32_t thread_id, uint64_t begin_timestamp_ns,
+    const absl::flat_hash_map<uint64_t, uint32_t>& counts_by_callstack_hash) {
+  if (Capture::GSamplingProfiler == nullptr) {
+    ERROR("GSamplingProfiler is null, ignoring callstack sample counts.");
+    return;
+  }
+  // There are no events for the time graph nor for saving the capture, only
+  // the counts for the reports.
+  CallstackEvent callstack_event;
+  callstack_event.set_time(begin_timestamp_ns);
+  callstack_event.set_thread_id(thread_id);
+  for (const auto& [callstack_hash, count] : counts_by_callstack_hash) {
+    callstack_event.set_callstack_hash(callstack_hash);
+    live_call_tree_samples_.AddCallstackEvent(callstack_event, count);
+  }
+  Capture::GSamplingProfiler->AddCallstackSampleCounts(
+      thread_id, counts_by_callstack_hash);
+}
+
+void OrbitApp::OnOffCpuCallstackEvent(CallstackEvent callstack_event,
+                                      uint64_t off_cpu_duration_ns) {
+  // In microseconds, rounded up so that no sample is lost.
+  off_cpu_call_tree_samples_.AddCallstackEvent(
+      callstack_event, (off_cpu_duration_ns + 999) / 1000);
+}
+
+void OrbitApp::OnAllocationEvent(CallstackEvent callstack_event,
+                                 uint64_t sampled_bytes) {
+  GCurrentTimeGraph->EnqueueAllocation(
+      callstack_event.thread_id(), callstack_event.time(), sampled_bytes);
+  // In KiB, rounded up as for the off-CPU samples.
+  allocation_call_tree_samples_.AddCallstackEvent(
+      callstack_event, (sampled_bytes + 1023) / 1024);
+}
+
+void OrbitApp::OnPageFaultEvent(CallstackEvent callstack_event, bool major) {
+  GCurrentTimeGraph->EnqueuePageFault(callstack_event.thread_id(),
+                                      callstack_event.time(), major);
+}
+
+void OrbitApp::OnPageFaultStats(const PageFaultStats& page_fault_stats) {
+  GCurrentTimeGraph->EnqueuePageFaultStats(page_fault_stats);
+}
+
 void OrbitApp::OnThreadName(int32_t thread_id, std::string thread_name) {
-  Capture::GThreadNames.insert_or_assign(thread_id, std::move(thread_name));
+  if (capture_stream_writer_ != nullptr) {
+    capture_stream_writer_->AddThreadName(thread_id, thread_name);
+  }
+  live_call_tree_samples_.AddThreadName(thread_id, thread_name);
+  off_cpu_call_tree_samples_.AddThreadName(thread_id, thread_name);
+  allocation_call_tree_samples_.AddThreadName(thread_id, thread_name);
+  Capture::GCaptureData.AddThreadName(thread_id, std::move(thread_name));
 }
 
 void OrbitApp::OnAddressInfo(LinuxAddressInfo address_info) {
-  uint64_t address = address_info.absolute_address();
-  Capture::GAddressInfos.emplace(address, std::move(address_info));
+  if (capture_stream_writer_ != nullptr) {
+    capture_stream_writer_->AddAddressInfo(address_info);
+  }
+  Capture::GCaptureData.AddAddressInfo(std::move(address_info));
+}
+
+void OrbitApp::OnDroppedEvents(uint64_t begin_timestamp_ns,
+                               uint64_t end_timestamp_ns,
+                               uint64_t dropped_event_count) {
+  ERROR("The service dropped %lu events between %lu and %lu ns",
+        dropped_event_count, begin_timestamp_ns, end_timestamp_ns);
+}
+
+void OrbitApp::OnFunctionCallStats(uint64_t function_address,
+                                   const FunctionStats& function_stats) {
+  FunctionInfo* function =
+      Capture::GTargetProcess->GetFunctionFromAddress(function_address);
+  if (function != nullptr) {
+    *function->mutable_stats() = function_stats;
+  }
+}
+
+void OrbitApp::OnLockContentionStats(
+    uint64_t callstack_hash, const LockContentionStats& lock_contention_stats) {
+  absl::MutexLock lock(&lock_contention_mutex_);
+  lock_contention_index_.AddStats(
+      lock_contention_stats.lock_address(), callstack_hash,
+      lock_contention_stats.wait_count(),
+      lock_contention_stats.total_wait_duration_ns(),
+      lock_contention_stats.max_wait_duration_ns());
+}
+
+std::vector<LockContentionIndex::Lock> OrbitApp::GetMostContendedLocks(
+    size_t max_count) {
+  absl::MutexLock lock(&lock_contention_mutex_);
+  return lock_contention_index_.GetMostContendedLocks(max_count);
+}
+
+void OrbitApp::OnSchedulingSliceCounters(
+    const SchedulingSliceCounters& scheduling_slice_counters) {
+  GCurrentTimeGraph->EnqueueSchedulingSliceCounters(scheduling_slice_counters);
+}
+
+void OrbitApp::OnThreadWakeup(const ThreadWakeup& thread_wakeup) {
+  GCurrentTimeGraph->EnqueueThreadWakeup(thread_wakeup);
+}
+
+void OrbitApp::OnCpuPowerEvent(const CpuPowerEvent& cpu_power_event) {
+  GCurrentTimeGraph->EnqueueCpuPowerEvent(cpu_power_event);
+}
+
+void OrbitApp::OnModuleMap(const ModuleMap& module_map) {
+  absl::MutexLock lock(&module_maps_mutex_);
+  module_maps_per_pid_[module_map.pid()].push_back(module_map);
+}
+
+void OrbitApp::OnDisabledInstrumentedFunctions(
+    const DisabledInstrumentedFunctions& disabled_instrumented_functions) {
+  std::string text =
+      "These functions were called so often that instrumenting them distorted "
+      "the capture, so they are no longer instrumented:\n";
+  for (const DisabledInstrumentedFunctions::DisabledFunction&
+           disabled_function : disabled_instrumented_functions.functions()) {
+    const FunctionInfo* function =
+        Capture::GTargetProcess->GetFunctionFromAddress(
+            disabled_function.absolute_address());
+    std::string name =
+        function != nullptr
+            ? FunctionUtils::GetDisplayName(*function)
+            : absl::StrFormat("%#lx", disabled_function.absolute_address());
+    absl::StrAppendFormat(&text, "\n%s (%lu calls per second)", name,
+                          disabled_function.calls_per_second());
+  }
+  LOG("%s", text);
+  SendInfoToUi("Instrumented functions disabled", text);
+}
+
+std::vector<ModuleMap> OrbitApp::GetModuleMapsOfProcess(int32_t pid) {
+  absl::MutexLock lock(&module_maps_mutex_);
+  auto it = module_maps_per_pid_.find(pid);
+  if (it == module_maps_per_pid_.end()) {
+    return {};
+  }
+  return it->second;
 }
 
 //-----------------------------------------------------------------------------
@@ -165,24 +332,46 @@ void OrbitApp::PostInit() {
     // .debug symbols file results in a message size of 88mb.
     channel_arguments.SetMaxReceiveMessageSize(
         std::numeric_limits<int32_t>::max());
-    grpc_channel_ = grpc::CreateCustomChannel(
-        options_.grpc_server_address, grpc::InsecureChannelCredentials(),
-        channel_arguments);
-    if (!grpc_channel_) {
-      ERROR("Unable to create GRPC channel to %s",
-            options_.grpc_server_address);
+    auto create_channel = [&](const std::string& address) {
+      std::shared_ptr<grpc::Channel> channel = grpc::CreateCustomChannel(
+          address, grpc::InsecureChannelCredentials(), channel_arguments);
+      if (!channel) {
+        ERROR("Unable to create GRPC channel to %s", address);
+      }
+      return channel;
+    };
+    grpc_channel_ = create_channel(options_.grpc_server_address);
+    // The capture stream and the symbols can keep a connection busy for a
+    // while, with their own one the other calls don't wait behind them.
+    bulk_grpc_channel_ = grpc_channel_;
+    if (!options_.bulk_grpc_server_address.empty()) {
+      bulk_grpc_channel_ = create_channel(options_.bulk_grpc_server_address);
+    }
+    // Channels connect lazily, on their first call: start connecting now,
+    // while the rest of the UI is being set up.
+    if (grpc_channel_ != nullptr) {
+      grpc_channel_->GetState(/*try_to_connect=*/true);
+    }
+    if (bulk_grpc_channel_ != nullptr && bulk_grpc_channel_ != grpc_channel_) {
+      bulk_grpc_channel_->GetState(/*try_to_connect=*/true);
     }
+    post_init_time_ = absl::Now();
 
-    capture_client_ = std::make_unique<CaptureClient>(grpc_channel_, this);
+    capture_client_ = std::make_unique<CaptureClient>(bulk_grpc_channel_, this);
 
     // TODO: Replace refresh_timeout with config option. Let users to modify it.
-    process_manager_ =
-        ProcessManager::Create(grpc_channel_, absl::Milliseconds(1000));
+    process_manager_ = ProcessManager::Create(
+        grpc_channel_, absl::Milliseconds(1000), bulk_grpc_channel_);
 
     auto callback = [this](ProcessManager* process_manager) {
       main_thread_executor_->Schedule([this, process_manager]() {
         const std::vector<ProcessInfo>& process_infos =
             process_manager->GetProcessList();
+        if (!received_process_list_) {
+          received_process_list_ = true;
+          LOG("First process list received %.1f ms after startup",
+              absl::ToDoubleMilliseconds(absl::Now() - post_init_time_));
+        }
         data_manager_->UpdateProcessInfos(process_infos);
         m_ProcessesDataView->SetProcessList(process_infos);
         {
@@ -226,7 +415,6 @@ void OrbitApp::PostInit() {
 
   ListPresets();
 
-  string_manager_ = std::make_shared<StringManager>();
   GCurrentTimeGraph->SetStringManager(string_manager_);
 }
 
@@ -312,9 +500,19 @@ void OrbitApp::RefreshCaptureView() {
 
 //-----------------------------------------------------------------------------
 void OrbitApp::Disassemble(int32_t pid, const FunctionInfo& function) {
-  thread_pool_->Schedule([this, pid, function] {
-    auto result = process_manager_->LoadProcessMemory(
-        pid, FunctionUtils::GetAbsoluteAddress(function), function.size());
+  Disassemble(pid, std::vector<FunctionInfo>{function});
+}
+
+//-----------------------------------------------------------------------------
+void OrbitApp::Disassemble(int32_t pid, std::vector<FunctionInfo> functions) {
+  thread_pool_->Schedule([this, pid, functions = std::move(functions)] {
+    std::vector<ProcessManager::MemoryRange> ranges;
+    ranges.reserve(functions.size());
+    for (const FunctionInfo& function : functions) {
+      ranges.push_back(
+          {FunctionUtils::GetAbsoluteAddress(function), function.size()});
+    }
+    auto result = process_manager_->LoadProcessMemoryRanges(pid, ranges);
     if (!result.has_value()) {
       SendErrorToUi("Error reading memory",
                     absl::StrFormat("Could not read process memory: %s.",
@@ -322,28 +520,85 @@ void OrbitApp::Disassemble(int32_t pid, const FunctionInfo& function) {
       return;
     }
 
-    const std::string& memory = result.value();
-    Disassembler disasm;
-    disasm.LOGF(absl::StrFormat("asm: /* %s */\n",
-                                FunctionUtils::GetDisplayName(function)));
-    disasm.Disassemble(reinterpret_cast<const uint8_t*>(memory.data()),
-                       memory.size(),
-                       FunctionUtils::GetAbsoluteAddress(function),
-                       Capture::GTargetProcess->GetIs64Bit());
-    if (!sampling_report_ || !sampling_report_->GetProfiler()) {
-      DisassemblyReport empty_report(disasm);
-      SendDisassemblyToUi(disasm.GetResult(), std::move(empty_report));
-      return;
-    }
     std::shared_ptr<SamplingProfiler> profiler =
-        sampling_report_->GetProfiler();
+        sampling_report_ != nullptr ? sampling_report_->GetProfiler()
+                                    : nullptr;
+    // By module path, for the functions of the same module.
+    absl::flat_hash_map<std::string, std::optional<ElfUtils::LineTable>>
+        line_tables;
+    for (size_t i = 0; i < functions.size(); ++i) {
+      const FunctionInfo& function = functions[i];
+      const std::string& memory = result.value()[i];
+      if (memory.size() < function.size()) {
+        SendErrorToUi(
+            "Error reading memory",
+            absl::StrFormat("Could not read the process memory of %s.",
+                            FunctionUtils::GetDisplayName(function)));
+        continue;
+      }
 
-    DisassemblyReport report(
-        disasm, FunctionUtils::GetAbsoluteAddress(function), profiler);
-    SendDisassemblyToUi(disasm.GetResult(), std::move(report));
+      Disassembler disasm;
+      disasm.LOGF(absl::StrFormat("asm: /* %s */\n",
+                                  FunctionUtils::GetDisplayName(function)));
+      const std::string& module_path = function.loaded_module_path();
+      auto line_table_it = line_tables.find(module_path);
+      if (line_table_it == line_tables.end()) {
+        std::shared_ptr<Module> module =
+            Capture::GTargetProcess->GetModuleFromPath(module_path);
+        std::optional<ElfUtils::LineTable> line_table;
+        if (module != nullptr) {
+          auto line_table_result =
+              LoadLineTable(module_path, module->m_DebugSignature);
+          if (line_table_result) {
+            line_table = std::move(line_table_result.value());
+          } else {
+            LOG("No source lines for the disassembly of \"%s\": %s",
+                module_path, line_table_result.error().message());
+          }
+        }
+        line_table_it =
+            line_tables.emplace(module_path, std::move(line_table)).first;
+      }
+      const std::optional<ElfUtils::LineTable>& line_table =
+          line_table_it->second;
+      disasm.Disassemble(reinterpret_cast<const uint8_t*>(memory.data()),
+                         memory.size(),
+                         FunctionUtils::GetAbsoluteAddress(function),
+                         Capture::GTargetProcess->GetIs64Bit(),
+                         line_table.has_value() ? &line_table.value() : nullptr,
+                         function.module_base_address() - function.load_bias());
+      if (profiler == nullptr) {
+        DisassemblyReport empty_report(disasm);
+        SendDisassemblyToUi(disasm.GetResult(), std::move(empty_report));
+        continue;
+      }
+
+      DisassemblyReport report(
+          disasm, FunctionUtils::GetAbsoluteAddress(function), profiler);
+      std::string annotated_result = report.GetAnnotatedResult();
+      SendDisassemblyToUi(std::move(annotated_result), std::move(report));
+    }
   });
 }
 
+//-----------------------------------------------------------------------------
+ErrorMessageOr<ElfUtils::LineTable> OrbitApp::LoadLineTable(
+    const std::string& module_path, const std::string& build_id) const {
+  auto line_table = symbol_cache_.LoadLineTable(build_id);
+  if (line_table) return line_table;
+
+  line_table = symbol_helper_.LoadLineTable(module_path, build_id);
+  if (line_table && !build_id.empty()) {
+    auto save_result =
+        symbol_cache_.SaveLineTable(build_id, line_table.value());
+    if (!save_result) {
+      ERROR("Saving the line table of \"%s\" in the symbol cache: %s",
+            module_path, save_result.error().message());
+    }
+  }
+  return line_table;
+}
+
 //-----------------------------------------------------------------------------
 void OrbitApp::OnExit() {
   if (Capture::GState == Capture::State::kStarted) {
@@ -370,6 +625,11 @@ void OrbitApp::MainTick() {
 
   ++GOrbitApp->m_NumTicks;
 
+  if (Capture::IsCapturing()) {
+    GOrbitApp->DropDataOutsideLiveCaptureWindow();
+    GOrbitApp->UpdateLiveCallTreeViews();
+  }
+
   if (DoZoom) {
     GCurrentTimeGraph->SortTracks();
     GOrbitApp->m_CaptureWindow->ZoomAll();
@@ -384,6 +644,12 @@ void OrbitApp::RegisterCaptureWindow(CaptureWindow* a_Capture) {
   m_CaptureWindow = a_Capture;
 }
 
+//-----------------------------------------------------------------------------
+void OrbitApp::RegisterFlameGraphWindow(FlameGraphWindow* flame_graph_window) {
+  CHECK(flame_graph_window_ == nullptr);
+  flame_graph_window_ = flame_graph_window;
+}
+
 //-----------------------------------------------------------------------------
 void OrbitApp::NeedsRedraw() {
   if (m_CaptureWindow != nullptr) {
@@ -394,6 +660,8 @@ void OrbitApp::NeedsRedraw() {
 //-----------------------------------------------------------------------------
 void OrbitApp::AddSamplingReport(
     std::shared_ptr<SamplingProfiler> sampling_profiler) {
+  UpdateSamplingDiff(sampling_profiler.get(), "Capture");
+  ScheduleThreadReportsPrecomputation(sampling_profiler);
   auto report = std::make_shared<SamplingReport>(std::move(sampling_profiler));
 
   if (sampling_reports_callback_) {
@@ -408,6 +676,8 @@ void OrbitApp::AddSamplingReport(
 //-----------------------------------------------------------------------------
 void OrbitApp::AddSelectionReport(
     std::shared_ptr<SamplingProfiler> a_SamplingProfiler) {
+  UpdateSamplingDiff(a_SamplingProfiler.get(), "Selection");
+  ScheduleThreadReportsPrecomputation(a_SamplingProfiler);
   auto report = std::make_shared<SamplingReport>(std::move(a_SamplingProfiler));
 
   if (selection_report_callback_) {
@@ -419,15 +689,153 @@ void OrbitApp::AddSelectionReport(
   selection_report_ = report;
 }
 
+//-----------------------------------------------------------------------------
+void OrbitApp::ScheduleThreadReportsPrecomputation(
+    std::shared_ptr<SamplingProfiler> sampling_profiler) {
+  // The reports of the threads are computed when their tab is first shown,
+  // and mostly in the background by then.
+  thread_pool_->Schedule(
+      [sampling_profiler = std::move(sampling_profiler)] {
+        sampling_profiler->PrecomputeThreadReports();
+      });
+}
+
+//-----------------------------------------------------------------------------
+static std::string GetSamplingDiffThreadDescription(ThreadID thread_id) {
+  return thread_id == 0 ? "all threads"
+                        : absl::StrFormat("thread %d", thread_id);
+}
+
+//-----------------------------------------------------------------------------
+void OrbitApp::SetSamplingDiffBaseline(
+    const std::vector<SampledFunction>& functions, ThreadID thread_id) {
+  std::vector<SampledFunction> baseline = functions;
+  // The functions of the baseline may be gone once the capture is cleared.
+  for (SampledFunction& function : baseline) {
+    function.m_Function = nullptr;
+  }
+  sampling_diff_baseline_ = std::move(baseline);
+  sampling_diff_baseline_thread_id_ = thread_id;
+
+  GetOrCreateDataView(DataViewType::SAMPLING_DIFF);
+  m_SamplingDiffDataView->SetDiffs(
+      DiffSampledFunctions(*sampling_diff_baseline_, *sampling_diff_baseline_),
+      absl::StrFormat("Baseline (%s): select a time range or take a capture "
+                      "to compare",
+                      GetSamplingDiffThreadDescription(thread_id)));
+  FireRefreshCallbacks(DataViewType::SAMPLING_DIFF);
+}
+
+//-----------------------------------------------------------------------------
+void OrbitApp::UpdateSamplingDiff(SamplingProfiler* sampling_profiler,
+                                  const std::string& description) {
+  if (!sampling_diff_baseline_.has_value()) {
+    return;
+  }
+
+  const std::vector<SampledFunction> functions =
+      sampling_profiler->GetThreadReport(sampling_diff_baseline_thread_id_);
+
+  GetOrCreateDataView(DataViewType::SAMPLING_DIFF);
+  m_SamplingDiffDataView->SetDiffs(
+      DiffSampledFunctions(*sampling_diff_baseline_, functions),
+      absl::StrFormat(
+          "%s (%s) vs. baseline", description,
+          GetSamplingDiffThreadDescription(sampling_diff_baseline_thread_id_)));
+  FireRefreshCallbacks(DataViewType::SAMPLING_DIFF);
+}
+
 void OrbitApp::AddTopDownView(const SamplingProfiler& sampling_profiler) {
-  if (!top_down_view_callback_) {
+  if (!top_down_view_callback_ && !bottom_up_view_callback_ &&
+      flame_graph_window_ == nullptr) {
+    return;
+  }
+  SetTopDownViews(CreateTopDownAndBottomUpViews(
+      sampling_profiler, Capture::GProcessName,
+      *Capture::GCaptureData.GetThreadNames(),
+      Capture::GAddressToFunctionName));
+}
+
+void OrbitApp::SetTopDownViews(TopDownAndBottomUpViews views) {
+  std::shared_ptr<TopDownView> top_down_view = std::move(views.top_down_view);
+  if (flame_graph_window_ != nullptr) {
+    flame_graph_window_->SetTopDownView(top_down_view);
+  }
+  if (top_down_view_callback_) {
+    top_down_view_callback_(std::move(top_down_view));
+  }
+  if (bottom_up_view_callback_) {
+    bottom_up_view_callback_(std::move(views.bottom_up_view));
+  }
+}
+
+void OrbitApp::UpdateLiveCallTreeViews() {
+  const absl::Time now = absl::Now();
+  if (now - last_live_call_tree_update_ < kLiveCallTreeUpdateInterval) {
+    return;
+  }
+  last_live_call_tree_update_ = now;
+  UpdateOffCpuView();
+  UpdateAllocationView();
+
+  std::vector<CallstackSamples> samples =
+      live_call_tree_samples_.TakeNewSamples(Capture::GTargetProcess.get());
+  if (samples.empty() || !callstack_samples_callback_) {
+    return;
+  }
+  callstack_samples_callback_(samples, Capture::GProcessName,
+                              live_call_tree_samples_.thread_names(),
+                              live_call_tree_samples_.function_names());
+  if (flame_graph_window_ != nullptr) {
+    flame_graph_window_->NeedsRedraw();
+  }
+}
+
+void OrbitApp::DropDataOutsideLiveCaptureWindow() {
+  const uint32_t window_minutes =
+      absl::GetFlag(FLAGS_live_capture_window_minutes);
+  if (window_minutes == 0 || GCurrentTimeGraph == nullptr) {
+    return;
+  }
+  const uint64_t window_ns =
+      absl::ToInt64Nanoseconds(absl::Minutes(window_minutes));
+  GCurrentTimeGraph->UpdateCaptureMinMaxTimestamps();
+  const TickType min_timestamp = GCurrentTimeGraph->GetCaptureMin();
+  const TickType max_timestamp = GCurrentTimeGraph->GetCaptureMax();
+  if (max_timestamp <= min_timestamp ||
+      max_timestamp - min_timestamp < window_ns + window_ns / 8) {
+    return;
+  }
+
+  const TickType cutoff = max_timestamp - window_ns;
+  GCurrentTimeGraph->DropDataBefore(cutoff);
+  if (Capture::GSamplingProfiler != nullptr) {
+    Capture::GSamplingProfiler->DropCallstackEventsBefore(cutoff);
+  }
+}
+
+void OrbitApp::UpdateOffCpuView() {
+  std::vector<CallstackSamples> samples =
+      off_cpu_call_tree_samples_.TakeNewSamples(Capture::GTargetProcess.get());
+  if (samples.empty() || !off_cpu_callstack_samples_callback_) {
+    return;
+  }
+  off_cpu_callstack_samples_callback_(
+      samples, Capture::GProcessName, off_cpu_call_tree_samples_.thread_names(),
+      off_cpu_call_tree_samples_.function_names());
+}
+
+void OrbitApp::UpdateAllocationView() {
+  std::vector<CallstackSamples> samples =
+      allocation_call_tree_samples_.TakeNewSamples(
+          Capture::GTargetProcess.get());
+  if (samples.empty() || !allocation_callstack_samples_callback_) {
     return;
   }
-  std::unique_ptr<TopDownView> top_down_view =
-      TopDownView::CreateFromSamplingProfiler(
-          sampling_profiler, Capture::GProcessName, Capture::GThreadNames,
-          Capture::GAddressToFunctionName);
-  top_down_view_callback_(std::move(top_down_view));
+  allocation_callstack_samples_callback_(
+      samples, Capture::GProcessName,
+      allocation_call_tree_samples_.thread_names(),
+      allocation_call_tree_samples_.function_names());
 }
 
 //-----------------------------------------------------------------------------
@@ -525,6 +933,18 @@ void OrbitApp::LoadPreset(const std::shared_ptr<PresetFile>& preset) {
 
 //-----------------------------------------------------------------------------
 ErrorMessageOr<void> OrbitApp::OnSaveCapture(const std::string& file_name) {
+  if (!auto_saved_capture_file_name_.empty()) {
+    // This fails across file systems, in which case the capture is written
+    // again.
+    if (std::rename(auto_saved_capture_file_name_.c_str(),
+                    file_name.c_str()) == 0) {
+      auto_saved_capture_file_name_.clear();
+      return outcome::success();
+    }
+    LOG("Could not move \"%s\" to \"%s\", saving the capture instead",
+        auto_saved_capture_file_name_, file_name);
+  }
+
   CaptureSerializer ar;
   ar.time_graph_ = GCurrentTimeGraph;
   return ar.Save(file_name);
@@ -532,13 +952,47 @@ ErrorMessageOr<void> OrbitApp::OnSaveCapture(const std::string& file_name) {
 
 //-----------------------------------------------------------------------------
 ErrorMessageOr<void> OrbitApp::OnLoadCapture(const std::string& file_name) {
+  if (Capture::GState == Capture::State::kLoading) {
+    return ErrorMessage("Another capture is still being loaded.");
+  }
   ClearCapture();
 
-  CaptureSerializer ar;
-  ar.time_graph_ = GCurrentTimeGraph;
-  OUTCOME_TRY(ar.Load(file_name));
+  std::ifstream file(file_name, std::ios::binary);
+  if (file.fail()) {
+    ERROR("Loading capture from \"%s\": %s", file_name, "file.fail()");
+    return ErrorMessage("Error opening the file for reading");
+  }
 
+  auto serializer = std::make_shared<CaptureSerializer>();
+  serializer->time_graph_ = GCurrentTimeGraph;
+  OUTCOME_TRY(chunks, serializer->LoadWithoutChunks(file));
   DoZoom = true;  // TODO: remove global, review logic
+  if (chunks.empty()) {
+    serializer->FinishLoading();
+    return outcome::success();
+  }
+
+  // The chunks are loaded in the background, like the events of a live
+  // capture, while the timers loaded so far are already shown.
+  Capture::GState = Capture::State::kLoading;
+  thread_pool_->Schedule([this, serializer, file_name,
+                          chunks = std::move(chunks)] {
+    SCOPE_TIMER_LOG(absl::StrFormat("Loading the chunks of capture \"%s\"",
+                                    file_name));
+    ErrorMessageOr<void> result = CaptureSerializer::LoadChunks(
+        file_name, chunks, serializer->time_graph_);
+    main_thread_executor_->Schedule([this, serializer, file_name,
+                                     result = std::move(result)] {
+      serializer->time_graph_->ProcessEnqueuedEvents();
+      serializer->FinishLoading();
+      DoZoom = true;
+      if (result.has_error()) {
+        SendErrorToUi("Error loading capture",
+                      absl::StrFormat("Could not load all of \"%s\":\n%s",
+                                      file_name, result.error().message()));
+      }
+    });
+  });
   return outcome::success();
 }
 
@@ -557,6 +1011,11 @@ void OrbitApp::FireRefreshCallbacks(DataViewType type) {
 
 bool OrbitApp::StartCapture() {
   CHECK(!Capture::IsCapturing());
+  if (Capture::GState == Capture::State::kLoading) {
+    SendErrorToUi("Error starting capture",
+                  "A capture is still being loaded.");
+    return false;
+  }
 
   ClearCapture();
 
@@ -566,11 +1025,73 @@ bool OrbitApp::StartCapture() {
     return false;
   }
 
+  // The stats of sampled functions are scaled by their sampling ratio. The
+  // calls of manual instrumentation functions are all needed.
+  const uint32_t sampling_ratio =
+      absl::GetFlag(FLAGS_instrumented_function_sampling_ratio);
+  instrumented_functions_.clear();
+  for (auto& [address, function] : Capture::GSelectedFunctionsMap) {
+    if (function != nullptr) {
+      function->set_sampling_ratio(
+          FunctionUtils::IsOrbitFunc(*function) ? 1 : sampling_ratio);
+      instrumented_functions_.emplace(address, function);
+    }
+  }
+
+  if (absl::GetFlag(FLAGS_auto_save_captures)) {
+    std::string file_name =
+        Path::JoinPath({Path::GetCapturePath(), GetCaptureFileName()});
+    auto writer = CaptureStreamWriter::Create(file_name);
+    if (writer) {
+      capture_stream_writer_ = std::move(writer.value());
+    } else {
+      SendErrorToUi("Error saving capture",
+                    absl::StrFormat("Could not save the capture in \"%s\":\n%s",
+                                    file_name, writer.error().message()));
+    }
+  }
+
+  // The views are filled while capturing, by UpdateLiveCallTreeViews.
+  live_call_tree_samples_.Clear();
+  off_cpu_call_tree_samples_.Clear();
+  allocation_call_tree_samples_.Clear();
+  last_live_call_tree_update_ = absl::Now();
+  {
+    absl::MutexLock lock(&lock_contention_mutex_);
+    lock_contention_index_.Clear();
+  }
+  if (off_cpu_top_down_view_callback_) {
+    off_cpu_top_down_view_callback_(std::make_shared<TopDownView>());
+  }
+  if (allocation_top_down_view_callback_) {
+    allocation_top_down_view_callback_(std::make_shared<TopDownView>());
+  }
+  auto top_down_view = std::make_shared<TopDownView>();
+  if (flame_graph_window_ != nullptr) {
+    flame_graph_window_->SetTopDownView(top_down_view);
+  }
+  if (top_down_view_callback_) {
+    top_down_view_callback_(std::move(top_down_view));
+  }
+  if (bottom_up_view_callback_) {
+    bottom_up_view_callback_(std::make_unique<BottomUpView>());
+  }
+
   int32_t pid = Capture::GProcessId;
   std::map<uint64_t, FunctionInfo*> selected_functions =
       Capture::GSelectedFunctionsMap;
-  thread_pool_->Schedule([this, pid, selected_functions] {
-    capture_client_->Capture(pid, selected_functions);
+  // The names of the functions of these modules come from the service.
+  std::vector<std::string> unsymbolized_module_paths;
+  for (const auto& [unused_address, module] :
+       Capture::GTargetProcess->GetModules()) {
+    if (module->m_Pdb == nullptr) {
+      unsymbolized_module_paths.push_back(module->m_FullName);
+    }
+  }
+  thread_pool_->Schedule([this, pid, selected_functions,
+                          unsymbolized_module_paths] {
+    capture_client_->Capture(pid, selected_functions,
+                             unsymbolized_module_paths);
     main_thread_executor_->Schedule([this] { OnCaptureStopped(); });
   });
 
@@ -596,11 +1117,81 @@ void OrbitApp::StopCapture() {
   FireRefreshCallbacks();
 }
 
+void OrbitApp::UpdateInstrumentedFunctions() {
+  if (Capture::GState != Capture::State::kStarted) {
+    return;
+  }
+
+  // The manual instrumentation functions are instrumented for the whole
+  // capture.
+  std::vector<const FunctionInfo*> added_functions;
+  const uint32_t sampling_ratio =
+      absl::GetFlag(FLAGS_instrumented_function_sampling_ratio);
+  for (auto& [address, function] : Capture::GSelectedFunctionsMap) {
+    if (function == nullptr || FunctionUtils::IsOrbitFunc(*function) ||
+        instrumented_functions_.count(address) > 0) {
+      continue;
+    }
+    function->clear_stats();
+    function->set_sampling_ratio(sampling_ratio);
+    added_functions.push_back(function);
+  }
+  // The calls already recorded of the removed functions stay in the capture.
+  std::vector<const FunctionInfo*> removed_functions;
+  for (const auto& [address, function] : instrumented_functions_) {
+    if (!FunctionUtils::IsOrbitFunc(*function) &&
+        Capture::GSelectedFunctionsMap.count(address) == 0) {
+      removed_functions.push_back(function);
+    }
+  }
+  if (added_functions.empty() && removed_functions.empty()) {
+    return;
+  }
+  if (!capture_client_->UpdateInstrumentedFunctions(added_functions,
+                                                    removed_functions)) {
+    SendErrorToUi("Error updating the instrumented functions",
+                  "The instrumented functions of the capture could not be "
+                  "changed.");
+    return;
+  }
+
+  for (const FunctionInfo* function : removed_functions) {
+    instrumented_functions_.erase(FunctionUtils::GetAbsoluteAddress(*function));
+  }
+  // The live functions and the saved capture show the functions of
+  // GSelectedInCaptureFunctions.
+  absl::flat_hash_set<uint64_t> added_addresses;
+  for (const FunctionInfo* function : added_functions) {
+    added_addresses.insert(FunctionUtils::GetAbsoluteAddress(*function));
+  }
+  for (const std::shared_ptr<FunctionInfo>& function :
+       Capture::GTargetProcess->GetFunctions()) {
+    uint64_t address = FunctionUtils::GetAbsoluteAddress(*function);
+    if (!added_addresses.contains(address)) {
+      continue;
+    }
+    instrumented_functions_.emplace(address, function.get());
+    Capture::GVisibleFunctionsMap[address] = function.get();
+    if (std::find(Capture::GSelectedInCaptureFunctions.begin(),
+                  Capture::GSelectedInCaptureFunctions.end(),
+                  function) == Capture::GSelectedInCaptureFunctions.end()) {
+      Capture::GSelectedInCaptureFunctions.push_back(function);
+    }
+  }
+  FireRefreshCallbacks(DataViewType::LIVE_FUNCTIONS);
+}
+
 void OrbitApp::ClearCapture() {
   CHECK(!Capture::IsCapturing());
   Capture::ClearCaptureData();
   Capture::GClearCaptureDataFunc();
+  auto_saved_capture_file_name_.clear();
   GCurrentTimeGraph->Clear();
+  resolved_callstack_cache_.Clear();
+  {
+    absl::MutexLock lock(&module_maps_mutex_);
+    module_maps_per_pid_.clear();
+  }
   if (capture_cleared_callback_) {
     capture_cleared_callback_();
   }
@@ -613,17 +1204,128 @@ void OrbitApp::ToggleDrawHelp() {
 }
 
 void OrbitApp::OnCaptureStopped() {
+  GCurrentTimeGraph->ProcessEnqueuedEvents();
   Capture::FinalizeCapture();
 
+  if (capture_stream_writer_ != nullptr) {
+    ErrorMessageOr<void> result = capture_stream_writer_->Finish();
+    if (result) {
+      auto_saved_capture_file_name_ = capture_stream_writer_->GetFileName();
+    } else {
+      SendErrorToUi("Error saving capture", result.error().message());
+    }
+    capture_stream_writer_.reset();
+  }
+
   RefreshCaptureView();
 
-  AddSamplingReport(Capture::GSamplingProfiler);
-  AddTopDownView(*Capture::GSamplingProfiler);
+  // The live top-down and bottom-up views are replaced once the samples are
+  // processed.
+  live_call_tree_samples_.Clear();
+  UpdateOffCpuView();
+  off_cpu_call_tree_samples_.Clear();
+  UpdateAllocationView();
+  allocation_call_tree_samples_.Clear();
+  FireRefreshCallbacks();
+
+  FinalizeSamples(Capture::GSamplingProfiler);
+}
 
+namespace {
+constexpr size_t kCaptureFinalizationStepCount = 4;
+}  // namespace
+
+void OrbitApp::ReportCaptureFinalizationProgress(const std::string& step,
+                                                 size_t step_index) {
+  if (capture_finalization_progress_callback_) {
+    capture_finalization_progress_callback_(step, step_index,
+                                            kCaptureFinalizationStepCount);
+  }
+}
+
+// Counting the samples, aggregating them by function and building the
+// top-down and bottom-up views take time with many samples: they run on
+// thread_pool_, one after the other as each depends on the previous one. The
+// addresses are resolved on the main thread in between, as their names are
+// only accessed from the main thread, which also publishes the sampling
+// report while the top-down view is built.
+void OrbitApp::FinalizeSamples(
+    std::shared_ptr<SamplingProfiler> sampling_profiler) {
+  if (sampling_profiler == nullptr) {
+    OnCaptureFinalized();
+    return;
+  }
+  capture_finalization_in_progress_ = true;
+  ReportCaptureFinalizationProgress("Counting the samples...", 0);
+  thread_pool_->Schedule([this, sampling_profiler] {
+    sampling_profiler->CountSamples();
+    main_thread_executor_->Schedule(
+        [this, sampling_profiler] { ResolveSamples(sampling_profiler); });
+  });
+}
+
+void OrbitApp::ResolveSamples(
+    std::shared_ptr<SamplingProfiler> sampling_profiler) {
+  // The capture was cleared in the meantime.
+  if (sampling_profiler != Capture::GSamplingProfiler) {
+    OnCaptureFinalized();
+    return;
+  }
+  ReportCaptureFinalizationProgress("Resolving the sampled addresses...", 1);
+  sampling_profiler->ResolveAddresses();
+  ReportCaptureFinalizationProgress("Aggregating the samples...", 2);
+  thread_pool_->Schedule([this, sampling_profiler] {
+    sampling_profiler->AggregateSamples();
+    main_thread_executor_->Schedule(
+        [this, sampling_profiler] { PublishSamples(sampling_profiler); });
+  });
+}
+
+void OrbitApp::PublishSamples(
+    std::shared_ptr<SamplingProfiler> sampling_profiler) {
+  if (sampling_profiler != Capture::GSamplingProfiler) {
+    OnCaptureFinalized();
+    return;
+  }
+  AddSamplingReport(sampling_profiler);
+  FireRefreshCallbacks();
+  if (!top_down_view_callback_ && !bottom_up_view_callback_ &&
+      flame_graph_window_ == nullptr) {
+    OnCaptureFinalized();
+    return;
+  }
+
+  // Replaces the live views with ones of all the samples, with the callstacks
+  // resolved with all the symbols now loaded. The names are copied, as the
+  // main thread keeps using them.
+  ReportCaptureFinalizationProgress("Building the top-down view...", 3);
+  thread_pool_->Schedule([this, sampling_profiler,
+                          process_name = Capture::GProcessName,
+                          thread_names = Capture::GCaptureData.GetThreadNames(),
+                          function_names = Capture::GAddressToFunctionName] {
+    auto views = std::make_shared<TopDownAndBottomUpViews>(
+        CreateTopDownAndBottomUpViews(*sampling_profiler, process_name,
+                                      *thread_names, function_names));
+    main_thread_executor_->Schedule([this, sampling_profiler, views] {
+      if (sampling_profiler == Capture::GSamplingProfiler) {
+        SetTopDownViews(std::move(*views));
+      }
+      OnCaptureFinalized();
+    });
+  });
+}
+
+void OrbitApp::OnCaptureFinalized() {
+  capture_finalization_in_progress_ = false;
   if (capture_stopped_callback_) {
     capture_stopped_callback_();
   }
-  FireRefreshCallbacks();
+  if (symbols_loaded_during_capture_finalization_) {
+    symbols_loaded_during_capture_finalization_ = false;
+    UpdateAfterSymbolLoading();
+  } else {
+    FireRefreshCallbacks();
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -705,6 +1407,32 @@ void OrbitApp::LoadModuleOnRemote(int32_t process_id,
     const std::string& module_path = module->m_FullName;
     const std::string& build_id = module->m_DebugSignature;
 
+    // The service loads the symbols from the debug info file and only sends
+    // them. Services that can't are asked for the path of the file, which is
+    // then copied.
+    auto symbols = process_manager_->LoadModuleSymbols(module_path, build_id);
+    if (symbols) {
+      if (!build_id.empty()) {
+        auto save_result = symbol_cache_.Save(build_id, symbols.value());
+        if (!save_result) {
+          ERROR("Saving the symbols of \"%s\" in the symbol cache: %s",
+                module_path, save_result.error().message());
+        }
+      }
+      std::shared_ptr<Pdb> pdb = module->CreatePdb(symbols.value());
+      LOG("Received and loaded %lu function symbols from remote service "
+          "for module %s",
+          symbols.value().symbol_infos().size(), module->m_Name.c_str());
+      main_thread_executor_->Schedule([this, process_id, module, preset, pdb] {
+        module->SetPdb(pdb);
+        SymbolLoadingFinished(process_id, module, preset);
+      });
+      return;
+    }
+    LOG("Could not load the symbols of \"%s\" on the remote, copying its "
+        "debug info file instead: %s",
+        module_path, symbols.error().message());
+
     const auto result =
         process_manager_->FindDebugInfoFile(module_path, build_id);
 
@@ -765,6 +1493,13 @@ void OrbitApp::LoadModuleOnRemote(int32_t process_id,
 void OrbitApp::SymbolLoadingFinished(
     uint32_t process_id, const std::shared_ptr<Module>& module,
     const std::shared_ptr<PresetFile>& preset) {
+  SetModuleLoaded(process_id, module, preset);
+  UpdateAfterSymbolLoading();
+}
+
+void OrbitApp::SetModuleLoaded(uint32_t process_id,
+                               const std::shared_ptr<Module>& module,
+                               const std::shared_ptr<PresetFile>& preset) {
   if (preset != nullptr) {
     auto it = preset->preset_info().path_to_module().find(module->m_FullName);
     if (it != preset->preset_info().path_to_module().end()) {
@@ -776,7 +1511,15 @@ void OrbitApp::SymbolLoadingFinished(
       ->set_loaded(true);
 
   modules_currently_loading_.erase(module->m_FullName);
+}
 
+void OrbitApp::UpdateAfterSymbolLoading() {
+  resolved_callstack_cache_.Clear();
+  // The samples being processed in the background are updated once done.
+  if (capture_finalization_in_progress_) {
+    symbols_loaded_during_capture_finalization_ = true;
+    return;
+  }
   UpdateSamplingReport();
   AddTopDownView(*Capture::GSamplingProfiler);
   GOrbitApp->FireRefreshCallbacks();
@@ -787,37 +1530,122 @@ void OrbitApp::LoadModules(int32_t process_id,
                            const std::vector<std::shared_ptr<Module>>& modules,
                            const std::shared_ptr<PresetFile>& preset) {
   // TODO(159868905) use ModuleData instead of Module
+  std::vector<std::shared_ptr<Module>> modules_to_load;
   for (const auto& module : modules) {
     if (modules_currently_loading_.contains(module->m_FullName)) {
       continue;
     }
     modules_currently_loading_.insert(module->m_FullName);
+    modules_to_load.push_back(module);
+  }
+  if (modules_to_load.empty()) {
+    return;
+  }
 
-    // TODO (159889010) Move symbol loading off the main thread.
-    const std::string& module_path = module->m_FullName;
-    const std::string& build_id = module->m_DebugSignature;
-    auto symbols =
-        symbol_helper_.LoadUsingSymbolsPathFile(module_path, build_id);
+  // Modules are independent: the ELF files are parsed, and the functions of
+  // the modules created, on all cores. The modules are only modified once
+  // all of them are done, on the main thread.
+  const uint64_t generation = symbol_loading_generation_;
+  thread_pool_->Schedule([this, process_id, modules_to_load, preset,
+                          generation] {
+    SCOPE_TIMER_LOG(absl::StrFormat("Loading symbols of %lu modules",
+                                    modules_to_load.size()));
+    std::vector<std::shared_ptr<Pdb>> pdbs(modules_to_load.size());
+    // The functions the preset selects in each module are looked up here
+    // too, which leaves only their selection to the main thread.
+    std::vector<std::vector<FunctionInfo*>> preset_functions(
+        modules_to_load.size());
+    std::atomic<size_t> loaded_count = 0;
+    std::unique_ptr<ThreadPool> symbol_thread_pool =
+        ThreadPool::CreateWorkStealing(
+            std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    ParallelFor(
+        symbol_thread_pool.get(), 0, modules_to_load.size(), [&](size_t i) {
+          if (symbol_loading_generation_ != generation) {
+            return;
+          }
+          const Module& module = *modules_to_load[i];
+          const std::string& module_path = module.m_FullName;
+          const std::string& build_id = module.m_DebugSignature;
+          // The symbols of the modules loaded before are in the symbol
+          // cache, which is much faster than parsing the debug info again.
+          auto symbols = symbol_cache_.Load(build_id);
+          const bool found_in_symbol_cache = symbols.has_value();
+          if (!symbols) {
+            symbols =
+                symbol_helper_.LoadUsingSymbolsPathFile(module_path, build_id);
+          }
 
-    // Try loading from the cache
-    if (!symbols) {
-      const std::string cached_file_name =
-          symbol_helper_.GenerateCachedFileName(module_path);
-      symbols = symbol_helper_.LoadSymbolsFromFile(cached_file_name, build_id);
-    }
+          // Try loading from the cache
+          if (!symbols) {
+            const std::string cached_file_name =
+                symbol_helper_.GenerateCachedFileName(module_path);
+            symbols =
+                symbol_helper_.LoadSymbolsFromFile(cached_file_name, build_id);
+          }
 
-    if (symbols) {
-      module->LoadSymbols(symbols.value());
-      LOG("Loaded %lu function symbols locally for module \"%s\"",
-          symbols.value().symbol_infos().size(), module->m_FullName);
-      SymbolLoadingFinished(process_id, module, preset);
-    } else {
-      LOG("Did not find local symbols for module: %s", module->m_Name);
-      LoadModuleOnRemote(process_id, module, preset);
-    }
-  }
+          if (symbols && !found_in_symbol_cache && !build_id.empty()) {
+            auto save_result = symbol_cache_.Save(build_id, symbols.value());
+            if (!save_result) {
+              ERROR("Saving the symbols of \"%s\" in the symbol cache: %s",
+                    module_path, save_result.error().message());
+            }
+          }
+
+          if (symbols) {
+            pdbs[i] = module.CreatePdb(symbols.value());
+            if (preset != nullptr) {
+              preset_functions[i] = pdbs[i]->GetPresetFunctions(*preset);
+            }
+            LOG("Loaded %lu function symbols locally for module \"%s\"",
+                symbols.value().symbol_infos().size(), module_path);
+          } else {
+            LOG("Did not find local symbols for module: %s", module.m_Name);
+          }
+
+          const size_t count = ++loaded_count;
+          main_thread_executor_->Schedule(
+              [this, count, module_count = modules_to_load.size()] {
+                if (symbol_loading_progress_callback_) {
+                  symbol_loading_progress_callback_(count, module_count);
+                }
+              });
+        });
+    symbol_thread_pool->ShutdownAndWait();
+
+    main_thread_executor_->Schedule([this, process_id, modules_to_load,
+                                     pdbs = std::move(pdbs),
+                                     preset_functions =
+                                         std::move(preset_functions),
+                                     preset, generation] {
+      if (symbol_loading_generation_ != generation) {
+        for (const auto& module : modules_to_load) {
+          modules_currently_loading_.erase(module->m_FullName);
+        }
+        return;
+      }
+
+      bool any_loaded = false;
+      for (size_t i = 0; i < modules_to_load.size(); ++i) {
+        const std::shared_ptr<Module>& module = modules_to_load[i];
+        if (pdbs[i] != nullptr) {
+          module->SetPdb(pdbs[i]);
+          FunctionUtils::SelectFunctions(preset_functions[i]);
+          SetModuleLoaded(process_id, module, /*preset=*/nullptr);
+          any_loaded = true;
+        } else {
+          LoadModuleOnRemote(process_id, module, preset);
+        }
+      }
+      if (any_loaded) {
+        UpdateAfterSymbolLoading();
+      }
+    });
+  });
 }
 
+void OrbitApp::CancelSymbolLoading() { ++symbol_loading_generation_; }
+
 //-----------------------------------------------------------------------------
 void OrbitApp::LoadModulesFromPreset(
     const std::shared_ptr<Process>& process,
@@ -853,8 +1681,8 @@ void OrbitApp::LoadModulesFromPreset(
 
 void OrbitApp::UpdateModuleList(int32_t pid) {
   thread_pool_->Schedule([pid, this] {
-    ErrorMessageOr<std::vector<ModuleInfo>> result =
-        process_manager_->LoadModuleList(pid);
+    ErrorMessageOr<ProcessManager::ModuleListChanges> result =
+        process_manager_->LoadModuleListChanges(pid);
 
     if (result.has_error()) {
       ERROR("Error retrieving modules: %s", result.error().message());
@@ -865,8 +1693,14 @@ void OrbitApp::UpdateModuleList(int32_t pid) {
     main_thread_executor_->Schedule([pid, result, this] {
       // Make sure that pid is actually what user has selected at
       // the moment we arrive here. If not - ignore the result.
-      const std::vector<ModuleInfo>& module_infos = result.value();
-      data_manager_->UpdateModuleInfos(pid, module_infos);
+      const ProcessManager::ModuleListChanges& changes = result.value();
+      const std::vector<ModuleInfo>& module_infos = changes.changed_modules;
+      if (changes.is_incremental) {
+        data_manager_->UpdateModuleInfos(
+            pid, module_infos, changes.removed_module_address_starts);
+      } else {
+        data_manager_->UpdateModuleInfos(pid, module_infos);
+      }
       if (pid != m_ProcessesDataView->GetSelectedProcessId()) {
         return;
       }
@@ -977,6 +1811,34 @@ DataView* OrbitApp::GetOrCreateDataView(DataViewType type) {
       }
       return m_PresetsDataView.get();
 
+    case DataViewType::SAMPLING_DIFF:
+      if (!m_SamplingDiffDataView) {
+        m_SamplingDiffDataView = std::make_unique<SamplingDiffDataView>();
+        m_Panels.push_back(m_SamplingDiffDataView.get());
+      }
+      return m_SamplingDiffDataView.get();
+
+    case DataViewType::FRAMES:
+      if (!m_FramesDataView) {
+        m_FramesDataView = std::make_unique<FramesDataView>();
+        m_Panels.push_back(m_FramesDataView.get());
+      }
+      return m_FramesDataView.get();
+
+    case DataViewType::LOCKS:
+      if (!m_LocksDataView) {
+        m_LocksDataView = std::make_unique<LocksDataView>();
+        m_Panels.push_back(m_LocksDataView.get());
+      }
+      return m_LocksDataView.get();
+
+    case DataViewType::QUERY:
+      if (!m_QueryDataView) {
+        m_QueryDataView = std::make_unique<QueryDataView>();
+        m_Panels.push_back(m_QueryDataView.get());
+      }
+      return m_QueryDataView.get();
+
     case DataViewType::SAMPLING:
       FATAL(
           "DataViewType::SAMPLING Data View construction is not supported by"
@@ -1000,6 +1862,23 @@ void OrbitApp::FilterTracks(const std::string& filter) {
   GCurrentTimeGraph->SetThreadFilter(filter);
 }
 
+//-----------------------------------------------------------------------------
+void OrbitApp::SearchTimers(const std::string& search) {
+  GCurrentTimeGraph->SetTimerSearch(search);
+}
+
+//-----------------------------------------------------------------------------
+void OrbitApp::JumpToNextTimerSearchMatch() {
+  GCurrentTimeGraph->JumpToTimerSearchMatch(TimeGraph::JumpDirection::kNext);
+}
+
+//-----------------------------------------------------------------------------
+void OrbitApp::SearchFlameGraph(const std::string& search) {
+  if (flame_graph_window_ != nullptr) {
+    flame_graph_window_->SetSearch(search);
+  }
+}
+
 //-----------------------------------------------------------------------------
 void OrbitApp::CrashOrbitService(
     CrashOrbitServiceRequest_CrashType crash_type) {
@@ -4,9 +4,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <map>
 #include <memory>
+#include <optional>
 #include <outcome.hpp>
 #include <queue>
 #include <string>
@@ -14,15 +16,20 @@
 
 #include "ApplicationOptions.h"
 #include "CallStackDataView.h"
+#include "CaptureStreamWriter.h"
 #include "ContextSwitch.h"
 #include "DataManager.h"
 #include "DataViewFactory.h"
 #include "DataViewTypes.h"
 #include "DisassemblyReport.h"
 #include "FramePointerValidatorClient.h"
+#include "FramesDataView.h"
 #include "FunctionsDataView.h"
 #include "LinuxCallstackEvent.h"
+#include "LiveCallTreeSamples.h"
 #include "LiveFunctionsDataView.h"
+#include "LockContentionIndex.h"
+#include "LocksDataView.h"
 #include "MainThreadExecutor.h"
 #include "ModulesDataView.h"
 #include "OrbitBase/Result.h"
@@ -33,13 +40,19 @@
 #include "OrbitClientServices/ProcessManager.h"
 #include "PresetsDataView.h"
 #include "ProcessesDataView.h"
+#include "QueryDataView.h"
+#include "ResolvedCallstackCache.h"
+#include "SamplingDiffDataView.h"
 #include "SamplingReportDataView.h"
 #include "StringManager.h"
+#include "SymbolCache.h"
 #include "SymbolHelper.h"
 #include "Threading.h"
 #include "TopDownView.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "capture_data.pb.h"
 #include "grpcpp/grpcpp.h"
 #include "preset.pb.h"
@@ -72,36 +85,101 @@ class OrbitApp final : public DataViewFactory, public CaptureListener {
   ErrorMessageOr<void> OnLoadCapture(const std::string& file_name);
   bool StartCapture();
   void StopCapture();
+  // While capturing, instruments the functions selected since the capture
+  // started and stops instrumenting the ones unselected.
+  void UpdateInstrumentedFunctions();
   void ClearCapture();
   void ToggleDrawHelp();
   void OnCaptureStopped();
   void ToggleCapture();
   void SetCallStack(std::shared_ptr<CallStack> a_CallStack);
+  // Shared by the callstack views of the app and of the sampling reports.
+  ResolvedCallstackCache& GetResolvedCallstackCache() {
+    return resolved_callstack_cache_;
+  }
   void LoadFileMapping();
   void ListPresets();
   void RefreshCaptureView();
   void Disassemble(int32_t pid,
                    const orbit_client_protos::FunctionInfo& function);
+  // Reads the code of all functions at once, and shows a disassembly of each.
+  void Disassemble(int32_t pid,
+                   std::vector<orbit_client_protos::FunctionInfo> functions);
 
-  void OnTimer(const orbit_client_protos::TimerInfo& timer_info) override;
+  void OnTimers(absl::Span<orbit_client_protos::TimerInfo> timers) override;
   void OnKeyAndString(uint64_t key, std::string str) override;
   void OnCallstack(CallStack callstack) override;
   void OnCallstackEvent(
       orbit_client_protos::CallstackEvent callstack_event) override;
+  void OnCallstackSampleCounts(
+      int32_t thread_id, uint64_t begin_timestamp_ns,
+      const absl::flat_hash_map<uint64_t, uint32_t>& counts_by_callstack_hash)
+      override;
+  void OnOffCpuCallstackEvent(
+      orbit_client_protos::CallstackEvent callstack_event,
+      uint64_t off_cpu_duration_ns) override;
+  void OnAllocationEvent(orbit_client_protos::CallstackEvent callstack_event,
+                         uint64_t sampled_bytes) override;
+  void OnPageFaultEvent(orbit_client_protos::CallstackEvent callstack_event,
+                        bool major) override;
+  void OnPageFaultStats(const PageFaultStats& page_fault_stats) override;
   void OnThreadName(int32_t thread_id, std::string thread_name) override;
   void OnAddressInfo(
       orbit_client_protos::LinuxAddressInfo address_info) override;
+  void OnDroppedEvents(uint64_t begin_timestamp_ns, uint64_t end_timestamp_ns,
+                       uint64_t dropped_event_count) override;
+  void OnFunctionCallStats(
+      uint64_t function_address,
+      const orbit_client_protos::FunctionStats& function_stats) override;
+  void OnLockContentionStats(
+      uint64_t callstack_hash,
+      const LockContentionStats& lock_contention_stats) override;
+  void OnSchedulingSliceCounters(
+      const SchedulingSliceCounters& scheduling_slice_counters) override;
+  void OnThreadWakeup(const ThreadWakeup& thread_wakeup) override;
+  void OnCpuPowerEvent(const CpuPowerEvent& cpu_power_event) override;
+  void OnModuleMap(const ModuleMap& module_map) override;
+  void OnDisabledInstrumentedFunctions(
+      const DisabledInstrumentedFunctions& disabled_instrumented_functions)
+      override;
+  // The executable maps received for the processes that are only sampled, to
+  // symbolize their samples on demand.
+  [[nodiscard]] std::vector<ModuleMap> GetModuleMapsOfProcess(int32_t pid);
+  // The locks the target process waited on the longest in the capture being
+  // taken, or the last one, when the capture traces lock contention.
+  [[nodiscard]] std::vector<LockContentionIndex::Lock> GetMostContendedLocks(
+      size_t max_count);
 
   void OnValidateFramePointers(
       std::vector<std::shared_ptr<Module>> modules_to_validate);
 
   void RegisterCaptureWindow(class CaptureWindow* a_Capture);
+  void RegisterFlameGraphWindow(class FlameGraphWindow* flame_graph_window);
 
   void OnProcessSelected(int32_t pid);
 
   void AddSamplingReport(std::shared_ptr<SamplingProfiler> sampling_profiler);
   void AddSelectionReport(std::shared_ptr<SamplingProfiler> a_SamplingProfiler);
+  // The sampling reports added from now on, of the whole capture or of a
+  // selection, are compared to the functions of this thread, in the
+  // DataViewType::SAMPLING_DIFF view. The baseline is kept when the capture is
+  // cleared, so that two captures can be compared.
+  void SetSamplingDiffBaseline(const std::vector<SampledFunction>& functions,
+                               ThreadID thread_id);
+  // Builds both the top-down and the bottom-up view.
   void AddTopDownView(const SamplingProfiler& sampling_profiler);
+  void SetTopDownViews(TopDownAndBottomUpViews views);
+  // While capturing, adds the samples received since the last update to the
+  // top-down and the bottom-up view, at most every
+  // kLiveCallTreeUpdateInterval.
+  void UpdateLiveCallTreeViews();
+  // While capturing with --live_capture_window_minutes, frees the data older
+  // than the window, once there is an eighth of a window more.
+  void DropDataOutsideLiveCaptureWindow();
+  // Adds the new off-CPU samples to the off-CPU top-down view.
+  void UpdateOffCpuView();
+  // Adds the new allocation samples to the allocations top-down view.
+  void UpdateAllocationView();
 
   bool SelectProcess(const std::string& a_Process);
   bool SelectProcess(int32_t a_ProcessID);
@@ -115,10 +193,20 @@ class OrbitApp final : public DataViewFactory, public CaptureListener {
   void SetCaptureStopRequestedCallback(CaptureStopRequestedCallback callback) {
     capture_stop_requested_callback_ = std::move(callback);
   }
+  // Called once the capture is finalized, i.e., once its samples have been
+  // processed and their views built.
   using CaptureStoppedCallback = std::function<void()>;
   void SetCaptureStoppedCallback(CaptureStoppedCallback callback) {
     capture_stopped_callback_ = std::move(callback);
   }
+  // Called on the main thread as each step of the finalization of the capture
+  // starts, until step_index reaches step_count.
+  using CaptureFinalizationProgressCallback = std::function<void(
+      const std::string& step, size_t step_index, size_t step_count)>;
+  void SetCaptureFinalizationProgressCallback(
+      CaptureFinalizationProgressCallback callback) {
+    capture_finalization_progress_callback_ = std::move(callback);
+  }
 
   using CaptureClearedCallback = std::function<void()>;
   void SetCaptureClearedCallback(CaptureClearedCallback callback) {
@@ -173,16 +261,51 @@ class OrbitApp final : public DataViewFactory, public CaptureListener {
   void SetSelectionReportCallback(SamplingReportCallback callback) {
     selection_report_callback_ = std::move(callback);
   }
-  using TopDownViewCallback = std::function<void(std::unique_ptr<TopDownView>)>;
+  // The top-down view is shared with the flame graph.
+  using TopDownViewCallback = std::function<void(std::shared_ptr<TopDownView>)>;
   void SetTopDownViewCallback(TopDownViewCallback callback) {
     top_down_view_callback_ = std::move(callback);
   }
+  using BottomUpViewCallback =
+      std::function<void(std::unique_ptr<BottomUpView>)>;
+  void SetBottomUpViewCallback(BottomUpViewCallback callback) {
+    bottom_up_view_callback_ = std::move(callback);
+  }
+  // Called with samples to add to the last views passed to the two callbacks
+  // above. The flame graph is redrawn afterwards.
+  using CallstackSamplesCallback = std::function<void(
+      absl::Span<const CallstackSamples> samples,
+      const std::string& process_name,
+      const std::unordered_map<int32_t, std::string>& thread_names,
+      const std::unordered_map<uint64_t, std::string>& function_names)>;
+  void SetCallstackSamplesCallback(CallstackSamplesCallback callback) {
+    callstack_samples_callback_ = std::move(callback);
+  }
+  // The same for the off-CPU top-down view, of which the samples are weighted
+  // by the microseconds the threads were blocked. It is only built live.
+  void SetOffCpuTopDownViewCallback(TopDownViewCallback callback) {
+    off_cpu_top_down_view_callback_ = std::move(callback);
+  }
+  void SetOffCpuCallstackSamplesCallback(CallstackSamplesCallback callback) {
+    off_cpu_callstack_samples_callback_ = std::move(callback);
+  }
+  // The same for the allocations top-down view, weighted by the KiB allocated.
+  void SetAllocationTopDownViewCallback(TopDownViewCallback callback) {
+    allocation_top_down_view_callback_ = std::move(callback);
+  }
+  void SetAllocationCallstackSamplesCallback(
+      CallstackSamplesCallback callback) {
+    allocation_callstack_samples_callback_ = std::move(callback);
+  }
   using SaveFileCallback =
       std::function<std::string(const std::string& extension)>;
   void SetSaveFileCallback(SaveFileCallback callback) {
     save_file_callback_ = std::move(callback);
   }
   void FireRefreshCallbacks(DataViewType type = DataViewType::ALL);
+  [[nodiscard]] MainThreadExecutor* GetMainThreadExecutor() const {
+    return main_thread_executor_.get();
+  }
   void Refresh(DataViewType a_Type = DataViewType::ALL) {
     FireRefreshCallbacks(a_Type);
   }
@@ -199,6 +322,14 @@ class OrbitApp final : public DataViewFactory, public CaptureListener {
   void SetClipboardCallback(ClipboardCallback callback) {
     clipboard_callback_ = std::move(callback);
   }
+  // Called on the main thread as LoadModules looks for the symbols of the
+  // modules of a batch locally, until loaded_count reaches module_count.
+  using SymbolLoadingProgressCallback =
+      std::function<void(size_t loaded_count, size_t module_count)>;
+  void SetSymbolLoadingProgressCallback(
+      SymbolLoadingProgressCallback callback) {
+    symbol_loading_progress_callback_ = std::move(callback);
+  }
 
   using SecureCopyCallback =
       std::function<ErrorMessageOr<void>(std::string_view, std::string_view)>;
@@ -216,9 +347,15 @@ class OrbitApp final : public DataViewFactory, public CaptureListener {
     return m_FileMapping;
   }
 
+  // Loads the symbols found locally for all modules in parallel, off the
+  // main thread, and publishes them on the main thread at once. The symbols
+  // of the other modules are then loaded from the remote.
   void LoadModules(
       int32_t process_id, const std::vector<std::shared_ptr<Module>>& modules,
       const std::shared_ptr<orbit_client_protos::PresetFile>& preset = nullptr);
+  // Drops the symbols of all the batches of LoadModules that are still being
+  // loaded locally.
+  void CancelSymbolLoading();
   void LoadModulesFromPreset(
       const std::shared_ptr<Process>& process,
       const std::shared_ptr<orbit_client_protos::PresetFile>& preset);
@@ -228,19 +365,45 @@ class OrbitApp final : public DataViewFactory, public CaptureListener {
   void LoadPreset(
       const std::shared_ptr<orbit_client_protos::PresetFile>& session);
   void FilterTracks(const std::string& filter);
+  void SearchFlameGraph(const std::string& search);
+  void SearchTimers(const std::string& search);
+  void JumpToNextTimerSearchMatch();
 
   void CrashOrbitService(CrashOrbitServiceRequest_CrashType crash_type);
 
   DataView* GetOrCreateDataView(DataViewType type) override;
 
  private:
+  // From the symbol cache or else indexed from the debug symbols, and then
+  // saved in the symbol cache.
+  [[nodiscard]] ErrorMessageOr<ElfUtils::LineTable> LoadLineTable(
+      const std::string& module_path, const std::string& build_id) const;
   void LoadModuleOnRemote(
       int32_t process_id, const std::shared_ptr<Module>& module,
       const std::shared_ptr<orbit_client_protos::PresetFile>& preset);
   void SymbolLoadingFinished(
       uint32_t process_id, const std::shared_ptr<Module>& module,
       const std::shared_ptr<orbit_client_protos::PresetFile>& preset);
+  // SymbolLoadingFinished without updating the views, for batches of modules.
+  void SetModuleLoaded(
+      uint32_t process_id, const std::shared_ptr<Module>& module,
+      const std::shared_ptr<orbit_client_protos::PresetFile>& preset);
+  void UpdateAfterSymbolLoading();
+  // The steps of the finalization of a capture, each scheduling the next
+  // ones. The costly ones run on thread_pool_, the others on the main thread,
+  // which publishes each result as soon as it is ready.
+  void FinalizeSamples(std::shared_ptr<SamplingProfiler> sampling_profiler);
+  void ResolveSamples(std::shared_ptr<SamplingProfiler> sampling_profiler);
+  void PublishSamples(std::shared_ptr<SamplingProfiler> sampling_profiler);
+  void OnCaptureFinalized();
+  void ReportCaptureFinalizationProgress(const std::string& step,
+                                         size_t step_index);
   std::shared_ptr<Process> FindProcessByPid(int32_t pid);
+  void ScheduleThreadReportsPrecomputation(
+      std::shared_ptr<SamplingProfiler> sampling_profiler);
+  // Compares the report of sampling_profiler to the diff baseline, if any.
+  void UpdateSamplingDiff(SamplingProfiler* sampling_profiler,
+                          const std::string& description);
 
   ErrorMessageOr<orbit_client_protos::PresetInfo> ReadPresetFromFile(
       const std::string& filename);
@@ -250,9 +413,16 @@ class OrbitApp final : public DataViewFactory, public CaptureListener {
   absl::Mutex process_map_mutex_;
   absl::flat_hash_map<uint32_t, std::shared_ptr<Process>> process_map_;
 
+  absl::Mutex module_maps_mutex_;
+  absl::flat_hash_map<int32_t, std::vector<ModuleMap>> module_maps_per_pid_;
+
+  absl::Mutex lock_contention_mutex_;
+  LockContentionIndex lock_contention_index_;
+
   CaptureStartedCallback capture_started_callback_;
   CaptureStopRequestedCallback capture_stop_requested_callback_;
   CaptureStoppedCallback capture_stopped_callback_;
+  CaptureFinalizationProgressCallback capture_finalization_progress_callback_;
   CaptureClearedCallback capture_cleared_callback_;
   OpenCaptureCallback open_capture_callback_;
   SaveCaptureCallback save_capture_callback_;
@@ -266,11 +436,18 @@ class OrbitApp final : public DataViewFactory, public CaptureListener {
   SamplingReportCallback sampling_reports_callback_;
   SamplingReportCallback selection_report_callback_;
   TopDownViewCallback top_down_view_callback_;
+  BottomUpViewCallback bottom_up_view_callback_;
+  CallstackSamplesCallback callstack_samples_callback_;
+  TopDownViewCallback off_cpu_top_down_view_callback_;
+  CallstackSamplesCallback off_cpu_callstack_samples_callback_;
+  TopDownViewCallback allocation_top_down_view_callback_;
+  CallstackSamplesCallback allocation_callstack_samples_callback_;
   std::vector<class DataView*> m_Panels;
   FindFileCallback find_file_callback_;
   SaveFileCallback save_file_callback_;
   ClipboardCallback clipboard_callback_;
   SecureCopyCallback secure_copy_callback_;
+  SymbolLoadingProgressCallback symbol_loading_progress_callback_;
 
   std::unique_ptr<ProcessesDataView> m_ProcessesDataView;
   std::unique_ptr<ModulesDataView> m_ModulesDataView;
@@ -278,28 +455,62 @@ class OrbitApp final : public DataViewFactory, public CaptureListener {
   std::unique_ptr<LiveFunctionsDataView> m_LiveFunctionsDataView;
   std::unique_ptr<CallStackDataView> m_CallStackDataView;
   std::unique_ptr<PresetsDataView> m_PresetsDataView;
+  std::unique_ptr<SamplingDiffDataView> m_SamplingDiffDataView;
+  std::unique_ptr<FramesDataView> m_FramesDataView;
+  std::unique_ptr<LocksDataView> m_LocksDataView;
+  std::unique_ptr<QueryDataView> m_QueryDataView;
+  ResolvedCallstackCache resolved_callstack_cache_;
 
   CaptureWindow* m_CaptureWindow = nullptr;
+  FlameGraphWindow* flame_graph_window_ = nullptr;
 
   std::shared_ptr<class SamplingReport> sampling_report_;
   std::shared_ptr<class SamplingReport> selection_report_;
+  std::optional<std::vector<SampledFunction>> sampling_diff_baseline_;
+  ThreadID sampling_diff_baseline_thread_id_ = 0;
   std::map<std::string, std::string> m_FileMapping;
 
   int m_NumTicks = 0;
 
   absl::flat_hash_set<std::string> modules_currently_loading_;
+  // Incremented by CancelSymbolLoading. A batch of LoadModules is cancelled
+  // when this changed since it started.
+  std::atomic<uint64_t> symbol_loading_generation_ = 0;
+  // While the capture is finalized, the samples are processed in the
+  // background: the views are only updated after symbol loading once done.
+  bool capture_finalization_in_progress_ = false;
+  bool symbols_loaded_during_capture_finalization_ = false;
 
   std::shared_ptr<StringManager> string_manager_;
   std::shared_ptr<grpc::Channel> grpc_channel_;
+  // The same as grpc_channel_ without a bulk_grpc_server_address.
+  std::shared_ptr<grpc::Channel> bulk_grpc_channel_;
 
   std::unique_ptr<MainThreadExecutor> main_thread_executor_;
   std::unique_ptr<ThreadPool> thread_pool_;
   std::unique_ptr<CaptureClient> capture_client_;
+  // The functions instrumented in the capture being taken, by address.
+  std::map<uint64_t, orbit_client_protos::FunctionInfo*>
+      instrumented_functions_;
+  // With --auto_save_captures, writes the capture being taken, and then the
+  // name of the file, for OnSaveCapture to only have to move it.
+  std::unique_ptr<CaptureStreamWriter> capture_stream_writer_;
+  std::string auto_saved_capture_file_name_;
+  // The samples of the capture being taken, for the live call tree views.
+  LiveCallTreeSamples live_call_tree_samples_;
+  // As callstacks are shared with the samples, all of them are added to both.
+  LiveCallTreeSamples off_cpu_call_tree_samples_;
+  LiveCallTreeSamples allocation_call_tree_samples_;
+  absl::Time last_live_call_tree_update_ = absl::InfinitePast();
+  // For the log of how long the first process list takes to arrive.
+  absl::Time post_init_time_;
+  bool received_process_list_ = false;
   std::unique_ptr<ProcessManager> process_manager_;
   std::unique_ptr<DataManager> data_manager_;
   std::unique_ptr<CrashManager> crash_manager_;
 
   const SymbolHelper symbol_helper_;
+  const SymbolCache symbol_cache_;
 
   std::unique_ptr<FramePointerValidatorClient> frame_pointer_validator_client_;
 };
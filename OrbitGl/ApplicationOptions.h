@@ -12,6 +12,9 @@
 struct ApplicationOptions {
   // GRPC connection string
   std::string grpc_server_address;
+  // GRPC connection string for the capture stream and other large transfers,
+  // which go through grpc_server_address as well if this is empty.
+  std::string bulk_grpc_server_address;
 };
 
 #endif  // ORBIT_GL_APPLICATION_OPTIONS_H_
@@ -0,0 +1,121 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "AsyncTrack.h"
+
+#include "GlCanvas.h"
+#include "Profiling.h"
+#include "TimeGraph.h"
+#include "absl/strings/str_format.h"
+
+using orbit_client_protos::TimerInfo;
+
+AsyncTrack::AsyncTrack(TimeGraph* time_graph) : TimerTrack(time_graph) {}
+
+const TextBox* AsyncTrack::OnAsyncTimer(TimerInfo timer_info) {
+  uint32_t lane = 0;
+  while (lane < lane_ends_.size() && lane_ends_[lane] > timer_info.start()) {
+    ++lane;
+  }
+  if (lane == lane_ends_.size()) {
+    lane_ends_.push_back(timer_info.end());
+  } else {
+    lane_ends_[lane] = timer_info.end();
+  }
+  timer_info.set_depth(lane);
+  return OnTimer(std::move(timer_info));
+}
+
+std::string AsyncTrack::GetTooltip() const {
+  return "Shows the spans of ORBIT_START_ASYNC and ORBIT_STOP_ASYNC with this "
+         "name, possibly across threads";
+}
+
+float AsyncTrack::GetHeight() const {
+  TimeGraphLayout& layout = time_graph_->GetLayout();
+  uint32_t depth = collapse_toggle_->IsCollapsed() ? 1 : GetDepth();
+  return layout.GetTextBoxHeight() * depth + layout.GetTrackBottomMargin();
+}
+
+const TextBox* AsyncTrack::GetLeft(TextBox* text_box) const {
+  std::shared_ptr<TimerChain> timers =
+      GetTimers(text_box->GetTimerInfo().depth());
+  if (timers) return timers->GetElementBefore(text_box);
+  return nullptr;
+}
+
+const TextBox* AsyncTrack::GetRight(TextBox* text_box) const {
+  std::shared_ptr<TimerChain> timers =
+      GetTimers(text_box->GetTimerInfo().depth());
+  if (timers) return timers->GetElementAfter(text_box);
+  return nullptr;
+}
+
+float AsyncTrack::GetYFromDepth(uint32_t depth) const {
+  float adjusted_depth = static_cast<float>(depth);
+  if (collapse_toggle_->IsCollapsed()) {
+    adjusted_depth = 0.f;
+  }
+  return m_Pos[1] -
+         time_graph_->GetLayout().GetTextBoxHeight() * (adjusted_depth + 1.f);
+}
+
+std::string AsyncTrack::GetBoxTooltip(const TextBox* text_box) const {
+  if (text_box == nullptr) {
+    return "";
+  }
+  const TimerInfo& timer_info = text_box->GetTimerInfo();
+  return absl::StrFormat(
+      "<b>%s</b><br/>"
+      "<i>Async span, started on thread %d</i>"
+      "<br/><br/>"
+      "<b>Time:</b> %s",
+      time_graph_->GetStringManager()
+          ->GetView(timer_info.user_data_key())
+          .value_or(""),
+      timer_info.thread_id(),
+      GetPrettyTime(TicksToDuration(timer_info.start(), timer_info.end())));
+}
+
+Color AsyncTrack::GetTimerColor(const TimerInfo& timer_info,
+                                bool is_selected) const {
+  const Color kSelectionColor(0, 128, 255, 255);
+  if (is_selected) {
+    return kSelectionColor;
+  }
+
+  // The color of the thread that started the span.
+  Color color = time_graph_->GetThreadColor(timer_info.thread_id());
+  constexpr uint8_t kOddAlpha = 210;
+  if (!(timer_info.depth() & 0x1)) {
+    color[3] = kOddAlpha;
+  }
+  return color;
+}
+
+void AsyncTrack::SetTimesliceText(const TimerInfo& timer_info,
+                                  double elapsed_us, float min_x,
+                                  TextBox* text_box) {
+  TimeGraphLayout layout = time_graph_->GetLayout();
+  if (text_box->GetText().empty()) {
+    std::string time = GetPrettyTime(absl::Microseconds(elapsed_us));
+    text_box->SetElapsedTimeTextLength(time.length());
+    std::string text = absl::StrFormat("%s  %s",
+                                       time_graph_->GetStringManager()
+                                           ->GetView(timer_info.user_data_key())
+                                           .value_or(""),
+                                       time.c_str());
+    text_box->SetText(text);
+  }
+
+  const Color kTextWhite(255, 255, 255, 255);
+  const Vec2& box_pos = text_box->GetPos();
+  const Vec2& box_size = text_box->GetSize();
+  float pos_x = std::max(box_pos[0], min_x);
+  float max_size = box_pos[0] + box_size[0] - pos_x;
+  primitives_text_->AddTextTrailingCharsPrioritized(
+      text_box->GetText().c_str(), pos_x,
+      text_box->GetPosY() + layout.GetTextOffset(), GlCanvas::Z_VALUE_TEXT,
+      kTextWhite, text_box->GetElapsedTimeTextLength(), max_size);
+}
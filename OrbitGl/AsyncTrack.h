@@ -0,0 +1,50 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_ASYNC_TRACK_H_
+#define ORBIT_GL_ASYNC_TRACK_H_
+
+#include <string>
+#include <vector>
+
+#include "TextBox.h"
+#include "TimerTrack.h"
+#include "capture_data.pb.h"
+
+// The spans of the ORBIT_START_ASYNC and ORBIT_STOP_ASYNC with the same name,
+// which can overlap and cross threads. Each span is put on the first of the
+// lanes (the depths of the track) where it doesn't overlap the last span, as
+// it is added, hence the spans of a lane stay sorted.
+class AsyncTrack : public TimerTrack {
+ public:
+  explicit AsyncTrack(TimeGraph* time_graph);
+  ~AsyncTrack() override = default;
+
+  // Assigns the lane of the span as its depth.
+  const TextBox* OnAsyncTimer(orbit_client_protos::TimerInfo timer_info);
+
+  [[nodiscard]] std::string GetTooltip() const override;
+  [[nodiscard]] Type GetType() const override { return kAsyncTrack; }
+  [[nodiscard]] float GetHeight() const override;
+
+  [[nodiscard]] const TextBox* GetLeft(TextBox* text_box) const override;
+  [[nodiscard]] const TextBox* GetRight(TextBox* text_box) const override;
+
+  [[nodiscard]] float GetYFromDepth(uint32_t depth) const override;
+  [[nodiscard]] std::string GetBoxTooltip(
+      const TextBox* text_box) const override;
+
+ protected:
+  [[nodiscard]] Color GetTimerColor(const orbit_client_protos::TimerInfo& timer,
+                                    bool is_selected) const override;
+  void SetTimesliceText(const orbit_client_protos::TimerInfo& timer,
+                        double elapsed_us, float min_x,
+                        TextBox* text_box) override;
+
+ private:
+  // The end of the last span of each lane.
+  std::vector<uint64_t> lane_ends_;
+};
+
+#endif  // ORBIT_GL_ASYNC_TRACK_H_
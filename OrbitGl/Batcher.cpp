@@ -4,87 +4,257 @@
 
 #include "Batcher.h"
 
+#include <algorithm>
+#include <type_traits>
+
 #include "Core.h"
 #include "OpenGl.h"
 
-void Batcher::AddLine(const Line& line, const Color* colors,
-                      PickingID::Type picking_type,
-                      std::unique_ptr<PickingUserData> user_data) {
-  Color picking_color = PickingID::GetColor(
-      picking_type, line_buffer_.m_Lines.size(), batcher_id_);
-  line_buffer_.m_Lines.push_back(line);
-  line_buffer_.m_Colors.push_back(colors, 2);
-  line_buffer_.m_PickingColors.push_back_n(picking_color, 2);
-  line_buffer_.m_UserData.push_back(std::move(user_data));
+namespace {
+
+void DeleteGpuBuffer(GpuBuffer* gpu_buffer) {
+  if (gpu_buffer->vertex_buffer_id == 0) {
+    return;
+  }
+  GLuint ids[] = {gpu_buffer->vertex_buffer_id, gpu_buffer->color_buffer_id,
+                  gpu_buffer->picking_color_buffer_id};
+  glDeleteBuffers(3, ids);
+  *gpu_buffer = GpuBuffer();
+}
+
+void UploadToBuffer(GLuint buffer_id, size_t offset, size_t size,
+                    const void* data) {
+  glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
+  glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+}
+
+void ExpandPrimitive(const LinePrimitive& line, Vec3* vertices,
+                     Color* colors) {
+  vertices[0] = line.line.m_Beg;
+  vertices[1] = line.line.m_End;
+  std::fill_n(colors, LinePrimitive::kVertexCount, line.color);
+}
+
+void ExpandPrimitive(const BoxPrimitive& box, Vec3* vertices, Color* colors) {
+  vertices[0] = Vec3(box.x, box.y, box.z);
+  vertices[1] = Vec3(box.x, box.y + box.height, box.z);
+  vertices[2] = Vec3(box.x + box.width, box.y + box.height, box.z);
+  vertices[3] = Vec3(box.x + box.width, box.y, box.z);
+  if (box.shaded) {
+    Batcher::GetBoxGradientColors(box.color, colors);
+  } else {
+    std::fill_n(colors, BoxPrimitive::kVertexCount, box.color);
+  }
+}
+
+void ExpandPrimitive(const TrianglePrimitive& triangle, Vec3* vertices,
+                     Color* colors) {
+  std::copy_n(triangle.triangle.vertices_, TrianglePrimitive::kVertexCount,
+              vertices);
+  std::fill_n(colors, TrianglePrimitive::kVertexCount, triangle.color);
+}
+
+// Generates, in staging, and uploads the vertices, colors and picking colors
+// of the primitives that are not in gpu_buffer yet. Primitives are lines,
+// boxes or triangles. When everything has to be uploaded again, the storage
+// is orphaned instead of being overwritten, so that we don't wait for the GPU
+// to be done drawing the previous frame from it.
+template <class Primitives>
+void UploadToGpuBuffer(const Primitives& primitives,
+                       PickingID::BatcherId batcher_id,
+                       VertexStaging* staging, GpuBuffer* gpu_buffer) {
+  using Primitive = std::remove_cv_t<std::remove_reference_t<decltype(
+      *primitives.GetBlockData(0))>>;
+  constexpr uint32_t kVerticesPerPrimitive = Primitive::kVertexCount;
+  const uint32_t vertex_count = primitives.size() * kVerticesPerPrimitive;
+  if (vertex_count == gpu_buffer->uploaded_vertex_count) {
+    return;
+  }
+
+  if (gpu_buffer->vertex_buffer_id == 0) {
+    GLuint ids[3];
+    glGenBuffers(3, ids);
+    gpu_buffer->vertex_buffer_id = ids[0];
+    gpu_buffer->color_buffer_id = ids[1];
+    gpu_buffer->picking_color_buffer_id = ids[2];
+  }
+  if (vertex_count > gpu_buffer->vertex_capacity) {
+    gpu_buffer->vertex_capacity =
+        std::max(vertex_count, 2 * gpu_buffer->vertex_capacity);
+    gpu_buffer->uploaded_vertex_count = 0;
+  }
+  if (gpu_buffer->uploaded_vertex_count == 0) {
+    const GLsizeiptr capacity = gpu_buffer->vertex_capacity;
+    glBindBuffer(GL_ARRAY_BUFFER, gpu_buffer->vertex_buffer_id);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Vec3), nullptr,
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, gpu_buffer->color_buffer_id);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Color), nullptr,
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, gpu_buffer->picking_color_buffer_id);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Color), nullptr,
+                 GL_DYNAMIC_DRAW);
+  }
+
+  // Block by block, so that staging holds at most the vertices of a block.
+  const uint32_t first_primitive =
+      gpu_buffer->uploaded_vertex_count / kVerticesPerPrimitive;
+  uint32_t block_begin = 0;
+  for (uint32_t i = 0; i < primitives.GetNumBlocks(); ++i) {
+    const uint32_t block_size = primitives.GetBlockSize(i);
+    const uint32_t block_end = block_begin + block_size;
+    if (block_end > first_primitive) {
+      const uint32_t offset =
+          std::max(first_primitive, block_begin) - block_begin;
+      const uint32_t count = block_size - offset;
+      const size_t count_vertices = count * size_t{kVerticesPerPrimitive};
+      staging->vertices.resize(count_vertices);
+      staging->colors.resize(count_vertices);
+      staging->picking_colors.resize(count_vertices);
+      const Primitive* block = primitives.GetBlockData(i);
+      for (uint32_t j = 0; j < count; ++j) {
+        const Primitive& primitive = block[offset + j];
+        const size_t first_vertex = j * size_t{kVerticesPerPrimitive};
+        ExpandPrimitive(primitive, &staging->vertices[first_vertex],
+                        &staging->colors[first_vertex]);
+        std::fill_n(&staging->picking_colors[first_vertex],
+                    kVerticesPerPrimitive,
+                    PickingID::GetColor(
+                        static_cast<PickingID::Type>(primitive.picking_type),
+                        block_begin + offset + j, batcher_id));
+      }
+
+      const size_t first_vertex =
+          (block_begin + offset) * size_t{kVerticesPerPrimitive};
+      UploadToBuffer(gpu_buffer->vertex_buffer_id,
+                     first_vertex * sizeof(Vec3), count_vertices * sizeof(Vec3),
+                     staging->vertices.data());
+      UploadToBuffer(gpu_buffer->color_buffer_id, first_vertex * sizeof(Color),
+                     count_vertices * sizeof(Color), staging->colors.data());
+      UploadToBuffer(gpu_buffer->picking_color_buffer_id,
+                     first_vertex * sizeof(Color),
+                     count_vertices * sizeof(Color),
+                     staging->picking_colors.data());
+    }
+    block_begin = block_end;
+  }
+  gpu_buffer->uploaded_vertex_count = vertex_count;
+}
+
+void AddUserData(UserDataByIndex* user_data, uint32_t index,
+                 std::unique_ptr<PickingUserData> primitive_user_data) {
+  if (primitive_user_data != nullptr) {
+    user_data->emplace_back(index, std::move(primitive_user_data));
+  }
+}
+
+PickingUserData* FindUserData(const UserDataByIndex& user_data,
+                              uint32_t index) {
+  auto it = std::lower_bound(
+      user_data.begin(), user_data.end(), index,
+      [](const auto& entry, uint32_t value) { return entry.first < value; });
+  if (it == user_data.end() || it->first != index) {
+    return nullptr;
+  }
+  return it->second.get();
+}
+
+// Appends the primitives of other to primitives and moves its user data,
+// which is then indexed from the first primitive appended.
+template <class Primitives>
+void AppendPrimitives(Primitives* primitives, UserDataByIndex* user_data,
+                      const Primitives& other_primitives,
+                      UserDataByIndex* other_user_data) {
+  const uint32_t index_offset = primitives->size();
+  for (uint32_t i = 0; i < other_primitives.GetNumBlocks(); ++i) {
+    primitives->push_back(other_primitives.GetBlockData(i),
+                          other_primitives.GetBlockSize(i));
+  }
+  for (auto& [index, data] : *other_user_data) {
+    user_data->emplace_back(index_offset + index, std::move(data));
+  }
+}
+
+void DrawGpuBuffer(const GpuBuffer& gpu_buffer, bool picking, GLenum mode) {
+  if (gpu_buffer.uploaded_vertex_count == 0) {
+    return;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, gpu_buffer.vertex_buffer_id);
+  glVertexPointer(3, GL_FLOAT, sizeof(Vec3), nullptr);
+  glBindBuffer(GL_ARRAY_BUFFER, !picking ? gpu_buffer.color_buffer_id
+                                         : gpu_buffer.picking_color_buffer_id);
+  glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Color), nullptr);
+  glDrawArrays(mode, 0, gpu_buffer.uploaded_vertex_count);
+}
+
+}  // namespace
+
+Batcher::~Batcher() {
+  DeleteGpuBuffer(&line_gpu_buffer_);
+  DeleteGpuBuffer(&box_gpu_buffer_);
+  DeleteGpuBuffer(&triangle_gpu_buffer_);
 }
 
 void Batcher::AddLine(const Line& line, Color color,
                       PickingID::Type picking_type,
                       std::unique_ptr<PickingUserData> user_data) {
-  Color colors[2];
-  Fill(colors, color);
-  AddLine(line, colors, picking_type, std::move(user_data));
+  AddUserData(&line_buffer_.m_UserData, line_buffer_.m_Lines.size(),
+              std::move(user_data));
+  line_buffer_.m_Lines.push_back(
+      LinePrimitive{line, color, static_cast<uint8_t>(picking_type)});
 }
 
 void Batcher::AddLine(Vec2 from, Vec2 to, float z, Color color,
                       PickingID::Type picking_type,
                       std::unique_ptr<PickingUserData> user_data) {
   Line line;
-  Color colors[2];
-  Fill(colors, color);
   line.m_Beg = Vec3(from[0], from[1], z);
   line.m_End = Vec3(to[0], to[1], z);
-  AddLine(line, colors, picking_type, std::move(user_data));
+  AddLine(line, color, picking_type, std::move(user_data));
 }
 
 void Batcher::AddVerticalLine(Vec2 pos, float size, float z, Color color,
                               PickingID::Type picking_type,
                               std::unique_ptr<PickingUserData> user_data) {
   Line line;
-  Color colors[2];
-  Fill(colors, color);
   line.m_Beg = Vec3(pos[0], pos[1], z);
   line.m_End = Vec3(pos[0], pos[1] + size, z);
-  AddLine(line, colors, picking_type, std::move(user_data));
+  AddLine(line, color, picking_type, std::move(user_data));
 }
 
-void Batcher::AddBox(const Box& a_Box, const Color* colors,
+void Batcher::AddBox(const Box& box, Color color, bool shaded,
                      PickingID::Type picking_type,
                      std::unique_ptr<PickingUserData> user_data) {
-  Color picking_color = PickingID::GetColor(
-      picking_type, box_buffer_.m_Boxes.size(), batcher_id_);
-  box_buffer_.m_Boxes.push_back(a_Box);
-  box_buffer_.m_Colors.push_back(colors, 4);
-  box_buffer_.m_PickingColors.push_back_n(picking_color, 4);
-  box_buffer_.m_UserData.push_back(std::move(user_data));
+  // Boxes are axis-aligned, see the constructor of Box.
+  const Vec3& min = box.vertices_[0];
+  const Vec3& max = box.vertices_[2];
+  AddUserData(&box_buffer_.m_UserData, box_buffer_.m_Boxes.size(),
+              std::move(user_data));
+  box_buffer_.m_Boxes.push_back(
+      BoxPrimitive{min[0], min[1], max[0] - min[0], max[1] - min[1], min[2],
+                   color, static_cast<uint8_t>(picking_type), shaded});
 }
 
 void Batcher::AddBox(const Box& a_Box, Color color,
                      PickingID::Type picking_type,
                      std::unique_ptr<PickingUserData> user_data) {
-  Color colors[4];
-  Fill(colors, color);
-  AddBox(a_Box, colors, picking_type, std::move(user_data));
+  AddBox(a_Box, color, /*shaded=*/false, picking_type, std::move(user_data));
 }
 
 void Batcher::AddShadedBox(Vec2 pos, Vec2 size, float z, Color color,
                            PickingID::Type picking_type,
                            std::unique_ptr<PickingUserData> user_data) {
-  Color colors[4];
-  GetBoxGradientColors(color, colors);
   Box box(pos, size, z);
-  AddBox(box, colors, picking_type, std::move(user_data));
+  AddBox(box, color, /*shaded=*/true, picking_type, std::move(user_data));
 }
 
 void Batcher::AddTriangle(const Triangle& triangle, Color color,
                           PickingID::Type picking_type,
                           std::unique_ptr<PickingUserData> user_data) {
-  Color picking_color = PickingID::GetColor(
-      picking_type, triangle_buffer_.triangles_.size(), batcher_id_);
-  triangle_buffer_.triangles_.push_back(triangle);
-  triangle_buffer_.colors_.push_back_n(color, 3);
-  triangle_buffer_.picking_colors_.push_back_n(picking_color, 3);
-  triangle_buffer_.user_data_.push_back(std::move(user_data));
+  AddUserData(&triangle_buffer_.user_data_, triangle_buffer_.triangles_.size(),
+              std::move(user_data));
+  triangle_buffer_.triangles_.push_back(
+      TrianglePrimitive{triangle, color, static_cast<uint8_t>(picking_type)});
 }
 
 void Batcher::AddTriangle(Vec3 v0, Vec3 v1, Vec3 v2, Color color,
@@ -98,18 +268,17 @@ PickingUserData* Batcher::GetUserData(PickingID a_ID) {
 
   switch (a_ID.m_Type) {
     case PickingID::BOX:
-      CHECK(a_ID.m_Id < box_buffer_.m_UserData.size());
-      return box_buffer_.m_UserData[a_ID.m_Id].get();
+      CHECK(a_ID.m_Id < box_buffer_.m_Boxes.size());
+      return FindUserData(box_buffer_.m_UserData, a_ID.m_Id);
     case PickingID::LINE:
-      CHECK(a_ID.m_Id < line_buffer_.m_UserData.size());
-      return line_buffer_.m_UserData[a_ID.m_Id].get();
+      CHECK(a_ID.m_Id < line_buffer_.m_Lines.size());
+      return FindUserData(line_buffer_.m_UserData, a_ID.m_Id);
     case PickingID::TRIANGLE:
-      CHECK(a_ID.m_Id < triangle_buffer_.user_data_.size());
-      return triangle_buffer_.user_data_[a_ID.m_Id].get();
+      CHECK(a_ID.m_Id < triangle_buffer_.triangles_.size());
+      return FindUserData(triangle_buffer_.user_data_, a_ID.m_Id);
   }
 
   return nullptr;
- ;
 }
 
 TextBox* Batcher::GetTextBox(PickingID a_ID) {
@@ -133,10 +302,29 @@ void Batcher::GetBoxGradientColors(Color color, Color* colors) {
   colors[3] = color;
 }
 
+void Batcher::Append(Batcher* other) {
+  // The picking colors are derived from the indices in this batcher when the
+  // primitives are uploaded.
+  AppendPrimitives(&line_buffer_.m_Lines, &line_buffer_.m_UserData,
+                   other->line_buffer_.m_Lines,
+                   &other->line_buffer_.m_UserData);
+  AppendPrimitives(&box_buffer_.m_Boxes, &box_buffer_.m_UserData,
+                   other->box_buffer_.m_Boxes, &other->box_buffer_.m_UserData);
+  AppendPrimitives(&triangle_buffer_.triangles_, &triangle_buffer_.user_data_,
+                   other->triangle_buffer_.triangles_,
+                   &other->triangle_buffer_.user_data_);
+
+  other->Reset();
+}
+
 void Batcher::Reset() {
   line_buffer_.Reset();
   box_buffer_.Reset();
   triangle_buffer_.Reset();
+  // The next elements are uploaded again from the start of the buffers.
+  line_gpu_buffer_.uploaded_vertex_count = 0;
+  box_gpu_buffer_.uploaded_vertex_count = 0;
+  triangle_gpu_buffer_.uploaded_vertex_count = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -151,6 +339,7 @@ void Batcher::Draw(bool picking) {
   DrawBoxBuffer(picking);
   DrawLineBuffer(picking);
   DrawTriangleBuffer(picking);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 
   glDisableClientState(GL_COLOR_ARRAY);
   glDisableClientState(GL_VERTEX_ARRAY);
@@ -159,63 +348,21 @@ void Batcher::Draw(bool picking) {
 
 //----------------------------------------------------------------------------
 void Batcher::DrawBoxBuffer(bool picking) {
-  Block<Box, BoxBuffer::NUM_BOXES_PER_BLOCK>* box_block =
-      GetBoxBuffer().m_Boxes.m_Root;
-  Block<Color, BoxBuffer::NUM_BOXES_PER_BLOCK * 4>* color_block;
-
-  color_block = !picking ? GetBoxBuffer().m_Colors.m_Root
-                         : GetBoxBuffer().m_PickingColors.m_Root;
-
-  while (box_block) {
-    if (int num_elems = box_block->m_Size) {
-      glVertexPointer(3, GL_FLOAT, sizeof(Vec3), box_block->m_Data);
-      glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Color), color_block->m_Data);
-      glDrawArrays(GL_QUADS, 0, num_elems * 4);
-    }
-
-    box_block = box_block->m_Next;
-    color_block = color_block->m_Next;
-  }
+  UploadToGpuBuffer(box_buffer_.m_Boxes, batcher_id_, &vertex_staging_,
+                    &box_gpu_buffer_);
+  DrawGpuBuffer(box_gpu_buffer_, picking, GL_QUADS);
 }
 
 //----------------------------------------------------------------------------
 void Batcher::DrawLineBuffer(bool picking) {
-  Block<Line, LineBuffer::NUM_LINES_PER_BLOCK>* line_block =
-      GetLineBuffer().m_Lines.m_Root;
-  Block<Color, LineBuffer::NUM_LINES_PER_BLOCK * 2>* color_block;
-
-  color_block = !picking ? GetLineBuffer().m_Colors.m_Root
-                         : GetLineBuffer().m_PickingColors.m_Root;
-
-  while (line_block) {
-    if (int num_elems = line_block->m_Size) {
-      glVertexPointer(3, GL_FLOAT, sizeof(Vec3), line_block->m_Data);
-      glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Color), color_block->m_Data);
-      glDrawArrays(GL_LINES, 0, num_elems * 2);
-    }
-
-    line_block = line_block->m_Next;
-    color_block = color_block->m_Next;
-  }
+  UploadToGpuBuffer(line_buffer_.m_Lines, batcher_id_, &vertex_staging_,
+                    &line_gpu_buffer_);
+  DrawGpuBuffer(line_gpu_buffer_, picking, GL_LINES);
 }
 
 //----------------------------------------------------------------------------
 void Batcher::DrawTriangleBuffer(bool picking) {
-  Block<Triangle, TriangleBuffer::NUM_TRIANGLES_PER_BLOCK>* triangle_block =
-      GetTriangleBuffer().triangles_.m_Root;
-  Block<Color, TriangleBuffer::NUM_TRIANGLES_PER_BLOCK * 3>* color_block;
-
-  color_block = !picking ? GetTriangleBuffer().colors_.m_Root
-                         : GetTriangleBuffer().picking_colors_.m_Root;
-
-  while (triangle_block) {
-    if (int num_elems = triangle_block->m_Size) {
-      glVertexPointer(3, GL_FLOAT, sizeof(Vec3), triangle_block->m_Data);
-      glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Color), color_block->m_Data);
-      glDrawArrays(GL_TRIANGLES, 0, num_elems * 3);
-    }
-
-    triangle_block = triangle_block->m_Next;
-    color_block = color_block->m_Next;
-  }
+  UploadToGpuBuffer(triangle_buffer_.triangles_, batcher_id_,
+                    &vertex_staging_, &triangle_gpu_buffer_);
+  DrawGpuBuffer(triangle_gpu_buffer_, picking, GL_TRIANGLES);
 }
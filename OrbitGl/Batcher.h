@@ -3,6 +3,9 @@
 // found in the LICENSE file.
 
 #pragma once
+#include <cstdint>
+#include <memory>
+#include <utility>
 #include <vector>
 
 #include "BlockChain.h"
@@ -15,7 +18,7 @@ using TooltipCallback = std::function<std::string(PickingID)>;
 struct PickingUserData {
   TextBox* text_box_;
   TooltipCallback generate_tooltip_;
-  void* custom_data_ = nullptr;
+  const void* custom_data_ = nullptr;
 
   PickingUserData(
     TextBox* text_box = nullptr,
@@ -23,52 +26,97 @@ struct PickingUserData {
     : text_box_(text_box), generate_tooltip_(generate_tooltip) {}
 };
 
+//-----------------------------------------------------------------------------
+// The buffers below hold one record per primitive. Vertices, colors and
+// picking colors, which derive from the type and the index of the primitive,
+// are only generated when the primitives are uploaded to the GPU. The user
+// data is only kept for the primitives that have some, by increasing index.
+using UserDataByIndex =
+    std::vector<std::pair<uint32_t, std::unique_ptr<PickingUserData>>>;
+
+struct LinePrimitive {
+  static constexpr uint32_t kVertexCount = 2;
+  Line line;
+  Color color;
+  uint8_t picking_type;
+};
+
+// Axis-aligned, the gradient of shaded boxes is the one of
+// Batcher::GetBoxGradientColors.
+struct BoxPrimitive {
+  static constexpr uint32_t kVertexCount = 4;
+  float x;
+  float y;
+  float width;
+  float height;
+  float z;
+  Color color;
+  uint8_t picking_type;
+  bool shaded;
+};
+
+struct TrianglePrimitive {
+  static constexpr uint32_t kVertexCount = 3;
+  Triangle triangle;
+  Color color;
+  uint8_t picking_type;
+};
+
 //-----------------------------------------------------------------------------
 struct LineBuffer {
   void Reset() {
     m_Lines.Reset();
-    m_Colors.Reset();
-    m_PickingColors.Reset();
     m_UserData.clear();
   }
 
   static const int NUM_LINES_PER_BLOCK = 64 * 1024;
-  BlockChain<Line, NUM_LINES_PER_BLOCK> m_Lines;
-  BlockChain<Color, 2 * NUM_LINES_PER_BLOCK> m_Colors;
-  BlockChain<Color, 2 * NUM_LINES_PER_BLOCK> m_PickingColors;
-  std::vector<std::unique_ptr<PickingUserData>> m_UserData;
+  BlockChain<LinePrimitive, NUM_LINES_PER_BLOCK> m_Lines;
+  UserDataByIndex m_UserData;
 };
 
 //-----------------------------------------------------------------------------
 struct BoxBuffer {
   void Reset() {
     m_Boxes.Reset();
-    m_Colors.Reset();
-    m_PickingColors.Reset();
     m_UserData.clear();
   }
 
   static const int NUM_BOXES_PER_BLOCK = 64 * 1024;
-  BlockChain<Box, NUM_BOXES_PER_BLOCK> m_Boxes;
-  BlockChain<Color, 4 * NUM_BOXES_PER_BLOCK> m_Colors;
-  BlockChain<Color, 4 * NUM_BOXES_PER_BLOCK> m_PickingColors;
-  std::vector<std::unique_ptr<PickingUserData>> m_UserData;
+  BlockChain<BoxPrimitive, NUM_BOXES_PER_BLOCK> m_Boxes;
+  UserDataByIndex m_UserData;
 };
 
 //-----------------------------------------------------------------------------
 struct TriangleBuffer {
   void Reset() {
     triangles_.Reset();
-    colors_.Reset();
-    picking_colors_.Reset();
     user_data_.clear();
   }
 
   static const int NUM_TRIANGLES_PER_BLOCK = 64 * 1024;
-  BlockChain<Triangle, NUM_TRIANGLES_PER_BLOCK> triangles_;
-  BlockChain<Color, 3 * NUM_TRIANGLES_PER_BLOCK> colors_;
-  BlockChain<Color, 3 * NUM_TRIANGLES_PER_BLOCK> picking_colors_;
-  std::vector<std::unique_ptr<PickingUserData>> user_data_;
+  BlockChain<TrianglePrimitive, NUM_TRIANGLES_PER_BLOCK> triangles_;
+  UserDataByIndex user_data_;
+};
+
+//-----------------------------------------------------------------------------
+// Vertex buffer objects holding the vertices and colors of one of the buffers
+// above on the GPU. Only the primitives added since the last upload are
+// uploaded, so that drawing the same primitives again, e.g., when only the
+// overlay changes, doesn't transfer any geometry.
+struct GpuBuffer {
+  uint32_t vertex_buffer_id = 0;
+  uint32_t color_buffer_id = 0;
+  uint32_t picking_color_buffer_id = 0;
+  uint32_t uploaded_vertex_count = 0;
+  uint32_t vertex_capacity = 0;
+};
+
+// Where the vertices of the primitives being uploaded are generated, kept
+// from one upload to the next.
+struct VertexStaging {
+  std::vector<Vec3> vertices;
+  std::vector<Color> colors;
+  std::vector<Color> picking_colors;
 };
 
 //-----------------------------------------------------------------------------
@@ -76,10 +124,9 @@ class Batcher {
  public:
   explicit Batcher(PickingID::BatcherId batcher_id) : batcher_id_(batcher_id) {}
   Batcher() : batcher_id_(PickingID::BatcherId::TIME_GRAPH) {}
+  // Must be destroyed with the OpenGL context it was drawn with current.
+  ~Batcher();
 
-  void AddLine(const Line& line, const Color* colors,
-               PickingID::Type picking_type, 
-               std::unique_ptr<PickingUserData> user_data = nullptr);
   void AddLine(const Line& line, Color color, PickingID::Type picking_type,
                std::unique_ptr<PickingUserData> user_data = nullptr);
   void AddLine(Vec2 from, Vec2 to, float z, Color color,
@@ -89,9 +136,6 @@ class Batcher {
                        PickingID::Type picking_type,
                        std::unique_ptr<PickingUserData> user_data = nullptr);
 
-  void AddBox(const Box& a_Box, const Color* colors,
-              PickingID::Type picking_type,
-              std::unique_ptr<PickingUserData> user_data = nullptr);
   void AddBox(const Box& a_Box, Color color, PickingID::Type picking_type,
               std::unique_ptr<PickingUserData> user_data = nullptr);
   void AddShadedBox(Vec2 pos, Vec2 size, float z, Color color,
@@ -105,7 +149,11 @@ class Batcher {
                    PickingID::Type picking_type,
                    std::unique_ptr<PickingUserData> user_data = nullptr);
 
-  void GetBoxGradientColors(Color color, Color* colors);
+  static void GetBoxGradientColors(Color color, Color* colors);
+
+  // Moves all primitives of other after the ones of this batcher, as if they
+  // had been added to it in the same order, and resets other.
+  void Append(Batcher* other);
 
   void Draw(bool picking = false);
 
@@ -121,8 +169,15 @@ class Batcher {
   void DrawLineBuffer(bool picking);
   void DrawBoxBuffer(bool picking);
   void DrawTriangleBuffer(bool picking);
+  void AddBox(const Box& box, Color color, bool shaded,
+              PickingID::Type picking_type,
+              std::unique_ptr<PickingUserData> user_data);
   LineBuffer line_buffer_;
   BoxBuffer box_buffer_;
   TriangleBuffer triangle_buffer_;
+  GpuBuffer line_gpu_buffer_;
+  GpuBuffer box_gpu_buffer_;
+  GpuBuffer triangle_gpu_buffer_;
+  VertexStaging vertex_staging_;
   PickingID::BatcherId batcher_id_;
 };
\ No newline at end of file
@@ -9,6 +9,7 @@
 #include "Capture.h"
 #include "Core.h"
 #include "FunctionUtils.h"
+#include "ResolvedCallstackCache.h"
 #include "absl/flags/flag.h"
 #include "absl/strings/str_format.h"
 
@@ -139,6 +140,7 @@ void CallStackDataView::OnContextMenu(const std::string& a_Action,
       FunctionInfo* function = frame.function;
       FunctionUtils::Select(function);
     }
+    GOrbitApp->UpdateInstrumentedFunctions();
 
   } else if (a_Action == MENU_ACTION_UNSELECT) {
     for (int i : a_ItemIndices) {
@@ -146,12 +148,15 @@ void CallStackDataView::OnContextMenu(const std::string& a_Action,
       FunctionInfo* function = frame.function;
       FunctionUtils::UnSelect(function);
     }
+    GOrbitApp->UpdateInstrumentedFunctions();
 
   } else if (a_Action == MENU_ACTION_DISASSEMBLY) {
     int32_t pid = Capture::GTargetProcess->GetID();
+    std::vector<FunctionInfo> functions;
     for (int i : a_ItemIndices) {
-      GOrbitApp->Disassemble(pid, *GetFrameFromRow(i).function);
+      functions.push_back(*GetFrameFromRow(i).function);
     }
+    GOrbitApp->Disassemble(pid, std::move(functions));
 
   } else {
     DataView::OnContextMenu(a_Action, a_MenuIndex, a_ItemIndices);
@@ -213,23 +218,21 @@ CallStackDataView::CallStackDataViewFrame CallStackDataView::GetFrameFromIndex(
     return CallStackDataViewFrame();
   }
 
-  uint64_t address = m_CallStack->m_Data[index_in_callstack];
-  FunctionInfo* function = nullptr;
-  std::shared_ptr<Module> module = nullptr;
+  // Resolved once per callstack, as this is called for every cell.
+  const ResolvedCallstackCache::Frame& frame =
+      GOrbitApp->GetResolvedCallstackCache().Resolve(
+          m_CallStack.get(),
+          Capture::GTargetProcess.get())[index_in_callstack];
 
-  if (Capture::GTargetProcess != nullptr) {
-    ScopeLock lock(Capture::GTargetProcess->GetDataMutex());
-    function = Capture::GTargetProcess->GetFunctionFromAddress(address, false);
-    module = Capture::GTargetProcess->GetModuleFromAddress(address);
-  }
-
-  if (function != nullptr) {
-    return CallStackDataViewFrame(address, function, module);
+  if (frame.function != nullptr) {
+    return CallStackDataViewFrame(frame.address, frame.function, frame.module);
   } else {
+    // The names of the addresses without symbols are only known once the
+    // samples are processed, hence not cached.
     std::string fallback_name;
     if (Capture::GSamplingProfiler != nullptr) {
-      fallback_name = Capture::GAddressToFunctionName[address];
+      fallback_name = Capture::GAddressToFunctionName[frame.address];
     }
-    return CallStackDataViewFrame(address, fallback_name, module);
+    return CallStackDataViewFrame(frame.address, fallback_name, frame.module);
   }
 }
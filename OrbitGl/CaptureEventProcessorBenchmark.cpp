@@ -0,0 +1,319 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Replays the CaptureResponses recorded with --record_capture_responses
+// through CaptureEventProcessor, the CaptureListener methods of OrbitApp and
+// TimeGraph, without any window, and reports the throughput, the peak RSS and
+// the allocations of the client-side ingestion of the events.
+//
+// Usage: CaptureEventProcessorBenchmark [flags] <recording>...
+
+#include <absl/flags/flag.h>
+#include <absl/flags/parse.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/util/delimited_message_util.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "App.h"
+#include "Capture.h"
+#include "OrbitBase/Logging.h"
+#include "OrbitCaptureClient/CaptureEventProcessor.h"
+#include "SamplingProfiler.h"
+#include "TimeGraph.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "services.pb.h"
+
+// Hack: This is declared in a header we include here
+// and the definition needs to take place somewhere.
+ABSL_FLAG(bool, enable_stale_features, false,
+          "Enable obsolete features that are not working or are not "
+          "implemented in the client's UI");
+ABSL_FLAG(bool, devmode, false, "Enable developer mode in the client's UI");
+ABSL_FLAG(bool, auto_save_captures, false,
+          "Write each capture to the capture directory while it is taken");
+ABSL_FLAG(uint32_t, live_capture_window_minutes, 0,
+          "Keep only the last minutes of a live capture in memory, 0 keeps "
+          "all of it. Saving the capture then only saves the window kept");
+ABSL_FLAG(uint16_t, sampling_rate, 1000,
+          "Frequency of callstack sampling in samples per second");
+ABSL_FLAG(bool, frame_pointer_unwinding, false,
+          "Use frame pointers for unwinding");
+ABSL_FLAG(bool, ring_buffer_wakeups, false,
+          "Let the service wait for ring buffers to fill up instead of "
+          "polling them");
+ABSL_FLAG(uint32_t, ring_buffer_reader_threads, 1,
+          "Number of threads of the service reading from the ring buffers");
+ABSL_FLAG(bool, pin_ring_buffer_reader_threads, false,
+          "Pin the threads of the service reading from the ring buffers to "
+          "the CPUs whose ring buffers they read");
+ABSL_FLAG(uint32_t, unwinding_threads, 0,
+          "Number of threads of the service unwinding stack samples, or 0 to "
+          "unwind them while processing them in order");
+ABSL_FLAG(uint32_t, stack_dump_size, 65000,
+          "Number of bytes of the stack copied for each sample with dwarf "
+          "unwinding, at most 65000");
+ABSL_FLAG(bool, adaptive_stack_dump, false,
+          "Only copy the part of the stack of each thread that was needed to "
+          "unwind its previous samples");
+ABSL_FLAG(bool, compress_capture_stream, false,
+          "Compress the capture data sent by the service, for slow "
+          "connections");
+ABSL_FLAG(bool, compact_event_encoding, true,
+          "Delta-encode the timestamps and callstacks sent by the service");
+ABSL_FLAG(bool, client_side_symbolization, false,
+          "Only get the names of the sampled functions from the service for "
+          "the modules without symbols on the client");
+ABSL_FLAG(uint32_t, callstack_sample_counts_interval_ms, 0,
+          "Have the service count the samples by thread and callstack over "
+          "intervals of that many ms instead of sending each of them, for "
+          "the reports only (0 to send them all)");
+ABSL_FLAG(uint64_t, max_buffered_event_bytes, 1024 * 1024 * 1024,
+          "Maximum bytes of capture data buffered by the service (0: no "
+          "limit)");
+ABSL_FLAG(bool, block_when_buffer_full, false,
+          "When max_buffered_event_bytes is reached, block instead of "
+          "dropping samples");
+ABSL_FLAG(bool, join_running_capture, false,
+          "Join the running capture of the process, if any, instead of "
+          "starting one");
+ABSL_FLAG(uint32_t, recorded_argument_count, 0,
+          "Number of integer arguments of each instrumented function to "
+          "record (at most 6)");
+ABSL_FLAG(bool, record_return_values, true,
+          "Record the integer return value of each instrumented function");
+ABSL_FLAG(bool, aggregate_function_calls, false,
+          "Only collect the number and durations of the calls of the "
+          "instrumented functions instead of every call");
+ABSL_FLAG(bool, hybrid_unwinding, false,
+          "Use frame pointers and DWARF-unwind only the innermost frames of "
+          "each sample");
+ABSL_FLAG(bool, lbr_unwinding, false,
+          "Use frame pointers and take the innermost frames of each sample "
+          "from the last branch records of the CPU");
+ABSL_FLAG(bool, kernel_callchains, false,
+          "Also sample the kernel frames, symbolized by the service, of the "
+          "samples taken in the kernel");
+ABSL_FLAG(bool, trace_performance_counters, false,
+          "Count cycles, instructions, cache misses and branch misses in each "
+          "scheduling slice of the target process");
+ABSL_FLAG(std::string, additional_pids, "",
+          "Comma-separated pids of other processes to capture together with "
+          "the selected one");
+ABSL_FLAG(bool, sample_all_processes, false,
+          "Sample all the processes on all cores, not only the target (frame "
+          "pointers only)");
+ABSL_FLAG(bool, auto_ring_buffer_sizes, false,
+          "Start with small ring buffers and grow the ones that lose events "
+          "for the following captures");
+ABSL_FLAG(std::string, ring_buffer_sizes_kb, "",
+          "Comma-separated sizes of the ring buffers per cpu by kind, e.g., "
+          "sampling=4096,uprobes=2048. Kinds: context_switches, uprobes, "
+          "mmap_task, sampling, tracepoints, gpu_tracing, "
+          "sched_switch_counters");
+ABSL_FLAG(bool, capture_statistics, false,
+          "Periodically receive statistics about the service during the "
+          "capture");
+ABSL_FLAG(bool, introspection, false,
+          "Also show the scopes of the threads of the service during the "
+          "capture");
+ABSL_FLAG(bool, manual_instrumentation_shared_memory, false,
+          "Read the scopes of the threads of the target built with "
+          "ORBIT_API_SHARED_MEMORY from shared memory");
+ABSL_FLAG(uint64_t, max_instrumented_function_call_rate, 0,
+          "Disable the instrumented functions called more often than this "
+          "per second at the beginning of the capture (0: no limit)");
+ABSL_FLAG(uint32_t, instrumented_function_sampling_ratio, 1,
+          "Only record one in this many calls of each instrumented function, "
+          "and scale the function statistics to match");
+ABSL_FLAG(bool, thread_state, false,
+          "Trace the wakeups of threads, to show when the threads of the "
+          "target were running, runnable or blocked");
+ABSL_FLAG(bool, off_cpu, false,
+          "Record the callstacks of the threads of the target when they block, "
+          "weighted by how long they are off-CPU");
+ABSL_FLAG(bool, lock_contention, false,
+          "Trace the futex waits of the target, for the locks tab and the "
+          "long waits on the thread tracks");
+ABSL_FLAG(bool, allocations, false,
+          "Sample the malloc calls of the target by bytes allocated, for the "
+          "allocations tab and the allocation rate tracks");
+ABSL_FLAG(bool, syscalls, false,
+          "Trace the syscalls of the target, for the long syscalls on the "
+          "thread tracks");
+ABSL_FLAG(std::string, syscall_filter, "",
+          "With --syscalls, only trace the syscalls with these numbers, e.g., "
+          "\"0,1,17\"");
+ABSL_FLAG(bool, block_io, false,
+          "Trace the block I/O requests of the target, for the thread tracks");
+ABSL_FLAG(bool, cpu_power_states, false,
+          "Show the frequency of each core, 0 while idle, next to the "
+          "scheduler track");
+ABSL_FLAG(bool, page_faults, false,
+          "Show the page faults of the target as markers on the thread "
+          "tracks, and its page fault and mmap counts in their tooltips");
+ABSL_FLAG(uint64_t, minor_page_fault_sampling_period, 1000,
+          "With --page_faults, sample one minor page fault out of this many, "
+          "0 to only trace the major ones");
+ABSL_FLAG(bool, vulkan_layer, false,
+          "Show the GPU times of the command buffers and debug labels of a "
+          "target that loaded OrbitVulkanLayer, in the GPU tracks");
+ABSL_FLAG(std::string, capture_triggers, "",
+          "Only receive the events around the moments these triggers fire, "
+          "separated by commas, e.g., Render>20,frame:Frame>33: the calls of "
+          "the instrumented functions of which the name contains Render "
+          "lasting more than 20 ms, and the intervals between the frame "
+          "markers named Frame longer than 33 ms");
+ABSL_FLAG(uint64_t, capture_trigger_window_ms, 1000,
+          "With --capture_triggers, receive the events of this many ms before "
+          "and after a trigger fires");
+ABSL_FLAG(std::string, record_capture_responses, "",
+          "Also write the CaptureResponses received during a capture to this "
+          "file, to replay them with CaptureEventProcessorBenchmark");
+
+ABSL_FLAG(uint32_t, responses_per_frame, 16,
+          "Number of CaptureResponses processed between two calls of "
+          "TimeGraph::ProcessEnqueuedEvents, which the client makes once per "
+          "frame");
+
+namespace {
+std::atomic<uint64_t> allocation_count = 0;
+std::atomic<uint64_t> allocated_bytes = 0;
+}  // namespace
+
+// Counts all allocations of the process. The array and sized variants of new
+// and delete end up in these.
+void* operator new(size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  void* ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t /*size*/) noexcept { std::free(ptr); }
+
+namespace {
+std::vector<CaptureResponse> ReadRecording(const std::string& path) {
+  std::vector<CaptureResponse> responses;
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    ERROR("Opening recording \"%s\"", path);
+    return responses;
+  }
+  google::protobuf::io::IstreamInputStream input(&file);
+  bool clean_eof = false;
+  CaptureResponse response;
+  while (google::protobuf::util::ParseDelimitedFromZeroCopyStream(
+      &response, &input, &clean_eof)) {
+    responses.push_back(std::move(response));
+    response.Clear();
+  }
+  if (!clean_eof) {
+    ERROR("Recording \"%s\" is truncated after %lu responses", path,
+          responses.size());
+  }
+  return responses;
+}
+
+uint64_t GetPeakRssKb() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+void PrintEventMix(const std::vector<CaptureResponse>& responses) {
+  std::map<int, uint64_t> counts_by_event_case;
+  for (const CaptureResponse& response : responses) {
+    for (const CaptureEvent& event : response.capture_events()) {
+      ++counts_by_event_case[event.event_case()];
+    }
+  }
+  for (const auto& [event_case, count] : counts_by_event_case) {
+    const google::protobuf::FieldDescriptor* field =
+        CaptureEvent::descriptor()->FindFieldByNumber(event_case);
+    absl::PrintF("  %-28s %12lu\n",
+                 field != nullptr ? field->name() : "unknown", count);
+  }
+}
+
+void ReplayRecording(const std::string& path, TimeGraph* time_graph) {
+  std::vector<CaptureResponse> responses = ReadRecording(path);
+  uint64_t event_count = 0;
+  for (const CaptureResponse& response : responses) {
+    event_count += response.capture_events_size();
+  }
+  absl::PrintF("%s: %lu responses, %lu events\n", path, responses.size(),
+               event_count);
+  PrintEventMix(responses);
+
+  // What OrbitApp::StartCapture and ClearCapture reset.
+  Capture::ClearCaptureData();
+  Capture::GSamplingProfiler =
+      std::make_shared<SamplingProfiler>(Capture::GTargetProcess);
+  time_graph->Clear();
+  CaptureEventProcessor event_processor{GOrbitApp.get()};
+
+  const uint32_t responses_per_frame =
+      std::max(absl::GetFlag(FLAGS_responses_per_frame), 1u);
+  const uint64_t allocation_count_before = allocation_count;
+  const uint64_t allocated_bytes_before = allocated_bytes;
+  absl::Duration time_graph_duration;
+  const absl::Time start = absl::Now();
+  for (size_t i = 0; i < responses.size(); ++i) {
+    event_processor.ProcessEvents(responses[i].capture_events());
+    if ((i + 1) % responses_per_frame == 0 || i + 1 == responses.size()) {
+      const absl::Time time_graph_start = absl::Now();
+      time_graph->ProcessEnqueuedEvents();
+      time_graph_duration += absl::Now() - time_graph_start;
+    }
+  }
+  const absl::Duration duration = absl::Now() - start;
+  const uint64_t allocations = allocation_count - allocation_count_before;
+  const uint64_t bytes = allocated_bytes - allocated_bytes_before;
+
+  const double seconds = absl::ToDoubleSeconds(duration);
+  absl::PrintF("  %.3f s, %.0f events/s, of which %.3f s in TimeGraph\n",
+               seconds, seconds > 0 ? event_count / seconds : 0,
+               absl::ToDoubleSeconds(time_graph_duration));
+  absl::PrintF("  %lu allocations (%.2f per event), %lu bytes allocated\n",
+               allocations,
+               event_count > 0 ? static_cast<double>(allocations) / event_count
+                               : 0,
+               bytes);
+  absl::PrintF("  peak RSS so far %lu KB, %lu timers\n", GetPeakRssKb(),
+               time_graph->GetNumTimers());
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<char*> recordings = absl::ParseCommandLine(argc, argv);
+  if (recordings.size() < 2) {
+    absl::PrintF("Usage: %s [flags] <recording>...\n", argv[0]);
+    return 1;
+  }
+
+  OrbitApp::Init({}, nullptr);
+  TimeGraph time_graph;
+  GCurrentTimeGraph = &time_graph;
+  absl::PrintF("Peak RSS before replaying: %lu KB\n", GetPeakRssKb());
+  for (size_t i = 1; i < recordings.size(); ++i) {
+    ReplayRecording(recordings[i], &time_graph);
+  }
+  GCurrentTimeGraph = nullptr;
+  return 0;
+}
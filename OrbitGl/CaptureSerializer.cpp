@@ -4,11 +4,18 @@
 
 #include "CaptureSerializer.h"
 
+#include <algorithm>
 #include <fstream>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <optional>
+#include <thread>
 
 #include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/gzip_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include <google/protobuf/message.h>
 
 #include "App.h"
@@ -17,20 +24,32 @@
 #include "Core.h"
 #include "EventTracer.h"
 #include "FunctionUtils.h"
+#ifndef _WIN32
+#include "MappedFile.h"
+#endif
 #include "OrbitBase/MakeUniqueForOverwrite.h"
+#include "OrbitBase/ParallelFor.h"
+#include "OrbitBase/ThreadPool.h"
 #include "OrbitModule.h"
 #include "OrbitProcess.h"
 #include "SamplingProfiler.h"
 #include "TextBox.h"
 #include "TimeGraph.h"
 #include "TimerChain.h"
+#include "TimerColumnsCodec.h"
 #include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "capture_data.pb.h"
 
 using orbit_client_protos::CallstackEvent;
 using orbit_client_protos::CallstackInfo;
+using orbit_client_protos::CaptureChunk;
+using orbit_client_protos::CaptureChunkInfo;
+using orbit_client_protos::CaptureIndex;
 using orbit_client_protos::CaptureInfo;
 using orbit_client_protos::FunctionInfo;
+using orbit_client_protos::LinuxAddressInfo;
 using orbit_client_protos::TimerInfo;
 
 //-----------------------------------------------------------------------------
@@ -53,11 +72,13 @@ ErrorMessageOr<void> CaptureSerializer::Save(const std::string& filename) {
   return outcome::success();
 }
 
-void WriteMessage(const google::protobuf::Message* message,
-                  google::protobuf::io::CodedOutputStream* output) {
+uint64_t CaptureSerializer::WriteMessage(
+    const google::protobuf::Message* message,
+    google::protobuf::io::CodedOutputStream* output) {
   uint32_t message_size = message->ByteSizeLong();
   output->WriteLittleEndian32(message_size);
   message->SerializeToCodedStream(output);
+  return sizeof(message_size) + message_size;
 }
 
 void CaptureSerializer::FillCaptureData(CaptureInfo* capture_info) {
@@ -70,13 +91,17 @@ void CaptureSerializer::FillCaptureData(CaptureInfo* capture_info) {
   capture_info->set_process_id(Capture::GProcessId);
   capture_info->set_process_name(Capture::GProcessName);
 
-  capture_info->mutable_thread_names()->insert(Capture::GThreadNames.begin(),
-                                               Capture::GThreadNames.end());
+  std::shared_ptr<const CaptureData::ThreadNames> thread_names =
+      Capture::GCaptureData.GetThreadNames();
+  capture_info->mutable_thread_names()->insert(thread_names->begin(),
+                                               thread_names->end());
 
-  capture_info->mutable_address_infos()->Reserve(Capture::GAddressInfos.size());
-  for (const auto& address_info : Capture::GAddressInfos) {
-    capture_info->add_address_infos()->CopyFrom(address_info.second);
-  }
+  capture_info->mutable_address_infos()->Reserve(
+      Capture::GCaptureData.GetAddressInfoCount());
+  Capture::GCaptureData.ForEachAddressInfo(
+      [&capture_info](const LinuxAddressInfo& address_info) {
+        capture_info->add_address_infos()->CopyFrom(address_info);
+      });
 
   // TODO: this is not really synchronized, since GetCallstacks processing below
   // is not under the same mutex lock we could end up having list of callstacks
@@ -89,32 +114,116 @@ void CaptureSerializer::FillCaptureData(CaptureInfo* capture_info) {
                                       call_stack.m_Data.end()};
       });
 
-  auto callstacks = Capture::GSamplingProfiler->GetCallstacks();
-  capture_info->mutable_callstack_events()->Reserve(callstacks->size());
-  for (const auto& callstack : *callstacks) {
-    capture_info->add_callstack_events()->CopyFrom(callstack);
-  }
-
   const auto& key_to_string_map =
       time_graph_->GetStringManager()->GetKeyToStringMap();
   capture_info->mutable_key_to_string()->insert(key_to_string_map.begin(),
                                                 key_to_string_map.end());
 }
 
-void CaptureSerializer::Save(std::ostream& stream) {
-  google::protobuf::io::OstreamOutputStream out_stream(&stream);
-  google::protobuf::io::CodedOutputStream coded_output(&out_stream);
+namespace {
+// Moves the timers of chunk into its timer columns, before compressing it.
+std::string CompressChunk(CaptureChunk* chunk) {
+  TimerColumnsCodec::Encode(chunk->timers(), chunk->mutable_timer_columns());
+  chunk->clear_timers();
+  std::string compressed_chunk;
+  {
+    google::protobuf::io::StringOutputStream string_stream(&compressed_chunk);
+    google::protobuf::io::GzipOutputStream gzip_stream(&string_stream);
+    chunk->SerializeToZeroCopyStream(&gzip_stream);
+  }
+  return compressed_chunk;
+}
 
-  CHECK(time_graph_ != nullptr);
-  int timers_count = time_graph_->GetNumTimers();
+// Decompresses a chunk and appends its timers, in either format, to timers.
+ErrorMessageOr<void> ParseChunk(const char* data, uint64_t size,
+                                CaptureChunk* chunk,
+                                std::vector<TimerInfo>* timers) {
+  {
+    google::protobuf::io::ArrayInputStream array_stream(data, size);
+    google::protobuf::io::GzipInputStream gzip_stream(&array_stream);
+    if (!chunk->ParseFromZeroCopyStream(&gzip_stream)) {
+      return ErrorMessage("Error parsing a chunk of the capture");
+    }
+  }
+  timers->insert(timers->end(),
+                 std::make_move_iterator(chunk->mutable_timers()->begin()),
+                 std::make_move_iterator(chunk->mutable_timers()->end()));
+  chunk->clear_timers();
+  return TimerColumnsCodec::Decode(chunk->timer_columns(), timers);
+}
+
+// Chunks are compressed and decompressed on all cores, as this is what most
+// of the time of saving and loading goes to.
+std::unique_ptr<ThreadPool> CreateChunkThreadPool() {
+  return ThreadPool::CreateWorkStealing(
+      std::max(std::thread::hardware_concurrency(), 2u) - 1);
+}
+}  // namespace
+
+void CaptureSerializer::WriteChunk(
+    CaptureChunk* chunk, uint64_t min_timestamp_ns, uint64_t max_timestamp_ns,
+    google::protobuf::io::CodedOutputStream* output, uint64_t* offset,
+    CaptureIndex* index) {
+  const std::string compressed_chunk = CompressChunk(chunk);
+  WriteCompressedChunk(*chunk, compressed_chunk, min_timestamp_ns,
+                       max_timestamp_ns, output, offset, index);
+}
 
-  WriteMessage(&header, &coded_output);
+void CaptureSerializer::WriteCompressedChunk(
+    const CaptureChunk& chunk, const std::string& compressed_chunk,
+    uint64_t min_timestamp_ns, uint64_t max_timestamp_ns,
+    google::protobuf::io::CodedOutputStream* output, uint64_t* offset,
+    CaptureIndex* index) {
+  CaptureChunkInfo* chunk_info = index->add_chunks();
+  chunk_info->set_offset(*offset);
+  chunk_info->set_size(compressed_chunk.size());
+  chunk_info->set_min_timestamp_ns(min_timestamp_ns);
+  chunk_info->set_max_timestamp_ns(max_timestamp_ns);
+  chunk_info->set_timer_count(chunk.timer_columns().count());
+  chunk_info->set_callstack_event_count(chunk.callstack_events_size());
+  output->WriteRaw(compressed_chunk.data(), compressed_chunk.size());
+  *offset += compressed_chunk.size();
+}
 
-  CaptureInfo capture_info;
-  FillCaptureData(&capture_info);
-  WriteMessage(&capture_info, &coded_output);
+void CaptureSerializer::SaveChunks(
+    google::protobuf::io::CodedOutputStream* output, uint64_t* offset,
+    CaptureIndex* index) {
+  struct PendingChunk {
+    CaptureChunk chunk;
+    uint64_t min_timestamp_ns = std::numeric_limits<uint64_t>::max();
+    uint64_t max_timestamp_ns = 0;
+    std::string compressed_chunk;
+  };
+
+  // The chunks are filled here, then compressed in batches in parallel, and
+  // written in order. Batches keep the memory used bounded.
+  std::unique_ptr<ThreadPool> thread_pool = CreateChunkThreadPool();
+  const size_t max_batch_size = 4 * (thread_pool->GetPoolSize() + 1);
+  std::vector<PendingChunk> batch;
+  PendingChunk pending;
+  auto write_batch = [&] {
+    ParallelFor(thread_pool.get(), 0, batch.size(), [&batch](size_t i) {
+      batch[i].compressed_chunk = CompressChunk(&batch[i].chunk);
+    });
+    for (const PendingChunk& batch_chunk : batch) {
+      WriteCompressedChunk(batch_chunk.chunk, batch_chunk.compressed_chunk,
+                           batch_chunk.min_timestamp_ns,
+                           batch_chunk.max_timestamp_ns, output, offset, index);
+    }
+    batch.clear();
+  };
+  auto end_chunk = [&] {
+    batch.push_back(std::move(pending));
+    pending = PendingChunk();
+    if (batch.size() == max_batch_size) {
+      write_batch();
+    }
+  };
 
-  // Timers
+  // The timers of each chain are added in chunks of consecutive blocks, hence
+  // each chunk is of one depth of one track, and covers the time range of its
+  // blocks.
+  int timers_count = time_graph_->GetNumTimers();
   int writes_count = 0;
   std::vector<std::shared_ptr<TimerChain>> chains =
       time_graph_->GetAllTimerChains();
@@ -123,13 +232,62 @@ void CaptureSerializer::Save(std::ostream& stream) {
     for (TimerChainIterator it = chain->begin(); it != chain->end(); ++it) {
       TimerBlock& block = *it;
       for (uint32_t k = 0; k < block.size(); ++k) {
-        WriteMessage(&block[k].GetTimerInfo(), &coded_output);
-        if (++writes_count > timers_count) {
-          return;
+        if (writes_count++ >= timers_count) {
+          break;
+        }
+        const TimerInfo& timer_info = block[k].GetTimerInfo();
+        *pending.chunk.add_timers() = timer_info;
+        pending.min_timestamp_ns =
+            std::min(pending.min_timestamp_ns, timer_info.start());
+        pending.max_timestamp_ns =
+            std::max(pending.max_timestamp_ns, timer_info.end());
+        if (pending.chunk.timers_size() == kMaxTimersPerChunk) {
+          end_chunk();
         }
       }
     }
+    if (pending.chunk.timers_size() > 0) {
+      end_chunk();
+    }
   }
+
+  for (const CallstackEvent& callstack_event :
+       *Capture::GSamplingProfiler->GetCallstacks()) {
+    *pending.chunk.add_callstack_events() = callstack_event;
+    pending.min_timestamp_ns =
+        std::min(pending.min_timestamp_ns, callstack_event.time());
+    pending.max_timestamp_ns =
+        std::max(pending.max_timestamp_ns, callstack_event.time());
+    if (pending.chunk.callstack_events_size() ==
+        kMaxCallstackEventsPerChunk) {
+      end_chunk();
+    }
+  }
+  if (pending.chunk.callstack_events_size() > 0) {
+    end_chunk();
+  }
+  write_batch();
+  thread_pool->ShutdownAndWait();
+}
+
+void CaptureSerializer::Save(std::ostream& stream) {
+  google::protobuf::io::OstreamOutputStream out_stream(&stream);
+  google::protobuf::io::CodedOutputStream coded_output(&out_stream);
+
+  CHECK(time_graph_ != nullptr);
+
+  uint64_t offset = WriteMessage(&header, &coded_output);
+
+  CaptureInfo capture_info;
+  FillCaptureData(&capture_info);
+  offset += WriteMessage(&capture_info, &coded_output);
+
+  CaptureIndex index;
+  SaveChunks(&coded_output, &offset, &index);
+
+  const uint64_t index_offset = offset;
+  WriteMessage(&index, &coded_output);
+  coded_output.WriteLittleEndian64(index_offset);
 }
 
 ErrorMessageOr<void> CaptureSerializer::Load(const std::string& filename) {
@@ -187,13 +345,11 @@ void CaptureSerializer::ProcessCaptureData(const CaptureInfo& capture_info) {
   Capture::GProcessId = capture_info.process_id();
   Capture::GProcessName = capture_info.process_name();
 
-  Capture::GThreadNames = {capture_info.thread_names().begin(),
-                           capture_info.thread_names().end()};
-
-  Capture::GAddressInfos.clear();
-  Capture::GAddressInfos.reserve(capture_info.address_infos_size());
+  Capture::GCaptureData.Clear();
+  Capture::GCaptureData.SetThreadNames({capture_info.thread_names().begin(),
+                                        capture_info.thread_names().end()});
   for (const auto& address_info : capture_info.address_infos()) {
-    Capture::GAddressInfos[address_info.absolute_address()] = address_info;
+    Capture::GCaptureData.AddAddressInfo(address_info);
   }
 
   if (Capture::GSamplingProfiler == nullptr) {
@@ -204,12 +360,11 @@ void CaptureSerializer::ProcessCaptureData(const CaptureInfo& capture_info) {
     CallStack unique_callstack;
     unique_callstack.m_Data = {callstack.data().begin(),
                                callstack.data().end()};
-    Capture::GSamplingProfiler->AddUniqueCallStack(unique_callstack);
+    Capture::GSamplingProfiler->AddUniqueCallStack(std::move(unique_callstack));
   }
   for (CallstackEvent callstack_event : capture_info.callstack_events()) {
     Capture::GSamplingProfiler->AddCallStack(callstack_event);
   }
-  Capture::GSamplingProfiler->ProcessSamples();
 
   time_graph_->Clear();
   StringManager* string_manager = time_graph_->GetStringManager();
@@ -217,49 +372,426 @@ void CaptureSerializer::ProcessCaptureData(const CaptureInfo& capture_info) {
   for (const auto& entry : capture_info.key_to_string()) {
     string_manager->AddIfNotPresent(entry.first, entry.second);
   }
-
-  FillEventBuffer();
 }
 
 ErrorMessageOr<void> CaptureSerializer::Load(std::istream& stream) {
-  google::protobuf::io::IstreamInputStream input_stream(&stream);
-  google::protobuf::io::CodedInputStream coded_input(&input_stream);
+  const std::streampos capture_start = stream.tellg();
+  OUTCOME_TRY(chunks, LoadWithoutChunks(stream));
+  stream.clear();
+  stream.seekg(capture_start);
+  OUTCOME_TRY(LoadChunks(stream, chunks, time_graph_));
+  time_graph_->ProcessEnqueuedEvents();
+  FinishLoading();
+  return outcome::success();
+}
 
+ErrorMessageOr<std::vector<CaptureChunkInfo>>
+CaptureSerializer::LoadWithoutChunks(std::istream& stream) {
+  const std::streampos capture_start = stream.tellg();
   std::string error_message =
       "Error parsing the capture.\nNote: If the capture "
       "was taken with a previous Orbit version, it could be incompatible. "
       "Please check release notes for more information.";
 
-  if (!ReadMessage(&header, &coded_input) || header.version().empty()) {
-    ERROR("%s", error_message);
+  CaptureInfo capture_info;
+  {
+    google::protobuf::io::IstreamInputStream input_stream(&stream);
+    google::protobuf::io::CodedInputStream coded_input(&input_stream);
+
+    if (!ReadMessage(&header, &coded_input) || header.version().empty()) {
+      ERROR("%s", error_message);
+      return ErrorMessage(error_message);
+    }
+    if (header.version() != kRequiredCaptureVersion &&
+        header.version() != kTimerInfoChunksCaptureVersion &&
+        header.version() != kUnchunkedCaptureVersion) {
+      std::string incompatible_version_error_message = absl::StrFormat(
+          "This capture format is no longer supported but could be opened "
+          "with Orbit version %s.",
+          header.version());
+      ERROR("%s", incompatible_version_error_message);
+      return ErrorMessage(incompatible_version_error_message);
+    }
+
+    if (!ReadMessage(&capture_info, &coded_input)) {
+      ERROR("%s", error_message);
+      return ErrorMessage(error_message);
+    }
+
+    if (header.version() == kUnchunkedCaptureVersion) {
+      ProcessCaptureData(capture_info);
+      TimerInfo timer_info;
+      while (ReadMessage(&timer_info, &coded_input)) {
+        time_graph_->ProcessTimer(std::move(timer_info));
+      }
+      return std::vector<CaptureChunkInfo>{};
+    }
+  }
+
+  auto chunks = ReadChunkIndex(stream, capture_start, &capture_info);
+  if (chunks.has_error()) {
+    ERROR("%s: %s", error_message, chunks.error().message());
     return ErrorMessage(error_message);
   }
-  if (header.version() != kRequiredCaptureVersion) {
-    std::string incompatible_version_error_message = absl::StrFormat(
-        "This capture format is no longer supported but could be opened with "
-        "Orbit version %s.",
-        header.version());
-    ERROR("%s", incompatible_version_error_message);
-    return ErrorMessage(incompatible_version_error_message);
+  ProcessCaptureData(capture_info);
+
+  // The capture fills in from its start.
+  std::stable_sort(chunks.value().begin(), chunks.value().end(),
+                   [](const CaptureChunkInfo& a, const CaptureChunkInfo& b) {
+                     return a.min_timestamp_ns() < b.min_timestamp_ns();
+                   });
+  return chunks;
+}
+
+ErrorMessageOr<std::vector<CaptureChunkInfo>>
+CaptureSerializer::ReadChunkIndex(std::istream& stream,
+                                  std::streampos capture_start,
+                                  CaptureInfo* capture_info) {
+  // The last index is found through the offset at the very end of the file.
+  uint8_t index_offset_bytes[sizeof(uint64_t)];
+  stream.clear();
+  stream.seekg(-static_cast<std::streamoff>(sizeof(index_offset_bytes)),
+               std::ios::end);
+  const std::streampos index_offset_position = stream.tellg();
+  if (!stream.read(reinterpret_cast<char*>(index_offset_bytes),
+                   sizeof(index_offset_bytes))) {
+    return ErrorMessage("Invalid offset of the capture index");
   }
+  uint64_t index_offset;
+  google::protobuf::io::CodedInputStream::ReadLittleEndian64FromArray(
+      index_offset_bytes, &index_offset);
+  if (index_offset_position < capture_start ||
+      index_offset >
+          static_cast<uint64_t>(index_offset_position - capture_start)) {
+    return ErrorMessage("Invalid offset of the capture index");
+  }
+
+  // Captures written while they were taken have a chain of indices, from the
+  // last to the first, each with the capture data received before it.
+  std::vector<CaptureChunkInfo> chunks;
+  std::vector<CaptureInfo> capture_info_updates;
+  while (true) {
+    CaptureIndex index;
+    stream.clear();
+    stream.seekg(capture_start + static_cast<std::streamoff>(index_offset));
+    {
+      google::protobuf::io::IstreamInputStream input_stream(&stream);
+      google::protobuf::io::CodedInputStream coded_input(&input_stream);
+      if (!ReadMessage(&index, &coded_input)) {
+        return ErrorMessage("Error reading a capture index");
+      }
+    }
+    chunks.insert(chunks.end(), index.chunks().begin(), index.chunks().end());
+    capture_info_updates.push_back(std::move(*index.mutable_capture_info()));
 
+    if (index.previous_index_offset() == 0) {
+      break;
+    }
+    if (index.previous_index_offset() >= index_offset) {
+      return ErrorMessage("Invalid offset of a capture index");
+    }
+    index_offset = index.previous_index_offset();
+  }
+  for (auto it = capture_info_updates.rbegin();
+       it != capture_info_updates.rend(); ++it) {
+    capture_info->MergeFrom(*it);
+  }
+  return chunks;
+}
+
+ErrorMessageOr<void> CaptureSerializer::LoadChunks(
+    std::istream& stream, const std::vector<CaptureChunkInfo>& chunks,
+    TimeGraph* time_graph) {
+  const std::streampos capture_start = stream.tellg();
+  // The chunks are read in turn, and decompressed and parsed in parallel.
+  std::unique_ptr<ThreadPool> thread_pool = CreateChunkThreadPool();
+  absl::Mutex stream_mutex;
+  absl::Mutex sampling_profiler_mutex;
+  absl::Mutex error_mutex;
+  std::optional<ErrorMessage> error;
+  ParallelFor(thread_pool.get(), 0, chunks.size(), [&](size_t i) {
+    const CaptureChunkInfo& chunk_info = chunks[i];
+    std::string compressed_chunk(chunk_info.size(), '\0');
+    bool read = false;
+    {
+      absl::MutexLock lock(&stream_mutex);
+      stream.seekg(capture_start +
+                   static_cast<std::streamoff>(chunk_info.offset()));
+      read = static_cast<bool>(
+          stream.read(compressed_chunk.data(), compressed_chunk.size()));
+    }
+    if (!read) {
+      absl::MutexLock lock(&error_mutex);
+      error = ErrorMessage("Error reading a chunk of the capture");
+      return;
+    }
+    ErrorMessageOr<void> result =
+        LoadChunk(compressed_chunk.data(), compressed_chunk.size(), time_graph,
+                  &sampling_profiler_mutex);
+    if (result.has_error()) {
+      absl::MutexLock lock(&error_mutex);
+      error = result.error();
+    }
+  });
+  thread_pool->ShutdownAndWait();
+  if (error.has_value()) {
+    return *error;
+  }
+  return outcome::success();
+}
+
+ErrorMessageOr<void> CaptureSerializer::LoadChunks(
+    const std::string& filename, const std::vector<CaptureChunkInfo>& chunks,
+    TimeGraph* time_graph) {
+#ifdef _WIN32
+  std::ifstream file(filename, std::ios::binary);
+  if (file.fail()) {
+    return ErrorMessage("Error opening the file for reading");
+  }
+  return LoadChunks(file, chunks, time_graph);
+#else
+  OUTCOME_TRY(mapped_file, MappedFile::Open(filename));
+  for (const CaptureChunkInfo& chunk_info : chunks) {
+    if (chunk_info.offset() > mapped_file->size() ||
+        chunk_info.size() > mapped_file->size() - chunk_info.offset()) {
+      return ErrorMessage("Error reading a chunk of the capture");
+    }
+  }
+
+  // The chunks are decompressed and parsed in parallel.
+  std::unique_ptr<ThreadPool> thread_pool = CreateChunkThreadPool();
+  absl::Mutex sampling_profiler_mutex;
+  absl::Mutex error_mutex;
+  std::optional<ErrorMessage> error;
+  ParallelFor(thread_pool.get(), 0, chunks.size(), [&](size_t i) {
+    const CaptureChunkInfo& chunk_info = chunks[i];
+    ErrorMessageOr<void> result =
+        LoadChunk(mapped_file->data() + chunk_info.offset(), chunk_info.size(),
+                  time_graph, &sampling_profiler_mutex);
+    mapped_file->Release(chunk_info.offset(), chunk_info.size());
+    if (result.has_error()) {
+      absl::MutexLock lock(&error_mutex);
+      error = result.error();
+    }
+  });
+  thread_pool->ShutdownAndWait();
+  if (error.has_value()) {
+    return *error;
+  }
+  return outcome::success();
+#endif
+}
+
+ErrorMessageOr<void> CaptureSerializer::LoadChunk(
+    const char* data, uint64_t size, TimeGraph* time_graph,
+    absl::Mutex* sampling_profiler_mutex) {
+  CaptureChunk chunk;
+  std::vector<TimerInfo> timers;
+  OUTCOME_TRY(ParseChunk(data, size, &chunk, &timers));
+  time_graph->EnqueueTimers(absl::MakeSpan(timers));
+  if (chunk.callstack_events_size() > 0) {
+    absl::MutexLock lock(sampling_profiler_mutex);
+    for (CallstackEvent& callstack_event : *chunk.mutable_callstack_events()) {
+      Capture::GSamplingProfiler->AddCallStack(callstack_event);
+    }
+  }
+  return outcome::success();
+}
+
+namespace {
+bool IsKeptByFilter(const TimerInfo& timer_info,
+                    const CaptureExportFilter& filter) {
+  return timer_info.end() >= filter.min_timestamp_ns &&
+         timer_info.start() <= filter.max_timestamp_ns &&
+         (filter.thread_ids.empty() ||
+          filter.thread_ids.contains(timer_info.thread_id()));
+}
+
+bool IsKeptByFilter(const CallstackEvent& callstack_event,
+                    const CaptureExportFilter& filter) {
+  return callstack_event.time() >= filter.min_timestamp_ns &&
+         callstack_event.time() <= filter.max_timestamp_ns &&
+         (filter.thread_ids.empty() ||
+          filter.thread_ids.contains(callstack_event.thread_id()));
+}
+}  // namespace
+
+ErrorMessageOr<void> CaptureSerializer::Export(
+    std::istream& input, std::ostream& output,
+    const CaptureExportFilter& relative_filter) {
+  const std::streampos capture_start = input.tellg();
+  orbit_client_protos::CaptureHeader input_header;
   CaptureInfo capture_info;
-  if (!ReadMessage(&capture_info, &coded_input)) {
-    ERROR("%s", error_message);
-    return ErrorMessage(error_message);
+  std::vector<CaptureChunkInfo> chunks;
+  // Captures that are not chunked are exported as they are read, their
+  // timers following the capture info.
+  std::optional<google::protobuf::io::IstreamInputStream> input_stream;
+  std::optional<google::protobuf::io::CodedInputStream> coded_input;
+  input_stream.emplace(&input);
+  coded_input.emplace(&input_stream.value());
+  if (!ReadMessage(&input_header, &coded_input.value()) ||
+      !ReadMessage(&capture_info, &coded_input.value())) {
+    return ErrorMessage("Error parsing the capture");
   }
-  ProcessCaptureData(capture_info);
+  const bool is_chunked = input_header.version() != kUnchunkedCaptureVersion;
+  if (is_chunked) {
+    if (input_header.version() != kRequiredCaptureVersion &&
+        input_header.version() != kTimerInfoChunksCaptureVersion) {
+      return ErrorMessage(absl::StrFormat(
+          "Capture version %s is not supported", input_header.version()));
+    }
+    coded_input.reset();
+    input_stream.reset();
+    OUTCOME_TRY(read_chunks,
+                ReadChunkIndex(input, capture_start, &capture_info));
+    chunks = std::move(read_chunks);
+  }
+
+  CaptureExportFilter filter = relative_filter;
+  if (filter.relative_to_capture_start) {
+    if (!is_chunked) {
+      return ErrorMessage(
+          "Time ranges of captures that are not chunked must be absolute");
+    }
+    uint64_t capture_start_ns = std::numeric_limits<uint64_t>::max();
+    for (const CaptureChunkInfo& chunk_info : chunks) {
+      capture_start_ns =
+          std::min(capture_start_ns, chunk_info.min_timestamp_ns());
+    }
+    if (chunks.empty()) capture_start_ns = 0;
+    auto to_absolute = [capture_start_ns](uint64_t timestamp_ns) {
+      return timestamp_ns > std::numeric_limits<uint64_t>::max() -
+                                capture_start_ns
+                 ? std::numeric_limits<uint64_t>::max()
+                 : capture_start_ns + timestamp_ns;
+    };
+    filter.min_timestamp_ns = to_absolute(filter.min_timestamp_ns);
+    filter.max_timestamp_ns = to_absolute(filter.max_timestamp_ns);
+    filter.relative_to_capture_start = false;
+  }
+
+  // Callstack events are only in the capture info for unchunked captures.
+  google::protobuf::RepeatedPtrField<CallstackEvent> kept_callstack_events;
+  for (CallstackEvent& callstack_event :
+       *capture_info.mutable_callstack_events()) {
+    if (IsKeptByFilter(callstack_event, filter)) {
+      *kept_callstack_events.Add() = std::move(callstack_event);
+    }
+  }
+  capture_info.mutable_callstack_events()->Swap(&kept_callstack_events);
 
-  // Timers
-  TimerInfo timer_info;
-  while (ReadMessage(&timer_info, &coded_input)) {
-    time_graph_->ProcessTimer(timer_info);
+  google::protobuf::io::OstreamOutputStream out_stream(&output);
+  google::protobuf::io::CodedOutputStream coded_output(&out_stream);
+  orbit_client_protos::CaptureHeader output_header;
+  output_header.set_version(kRequiredCaptureVersion);
+  uint64_t offset = WriteMessage(&output_header, &coded_output);
+  offset += WriteMessage(&capture_info, &coded_output);
+
+  CaptureIndex index;
+  CaptureChunk output_chunk;
+  uint64_t min_timestamp_ns = std::numeric_limits<uint64_t>::max();
+  uint64_t max_timestamp_ns = 0;
+  auto add_timer = [&](TimerInfo timer_info) {
+    if (!IsKeptByFilter(timer_info, filter)) return;
+    min_timestamp_ns = std::min(min_timestamp_ns, timer_info.start());
+    max_timestamp_ns = std::max(max_timestamp_ns, timer_info.end());
+    *output_chunk.add_timers() = std::move(timer_info);
+  };
+  auto add_callstack_event = [&](CallstackEvent callstack_event) {
+    if (!IsKeptByFilter(callstack_event, filter)) return;
+    min_timestamp_ns = std::min(min_timestamp_ns, callstack_event.time());
+    max_timestamp_ns = std::max(max_timestamp_ns, callstack_event.time());
+    *output_chunk.add_callstack_events() = std::move(callstack_event);
+  };
+  auto end_chunk = [&] {
+    if (output_chunk.timers_size() > 0 ||
+        output_chunk.callstack_events_size() > 0) {
+      WriteChunk(&output_chunk, min_timestamp_ns, max_timestamp_ns,
+                 &coded_output, &offset, &index);
+    }
+    output_chunk.Clear();
+    min_timestamp_ns = std::numeric_limits<uint64_t>::max();
+    max_timestamp_ns = 0;
+  };
+
+  if (!is_chunked) {
+    TimerInfo timer_info;
+    while (ReadMessage(&timer_info, &coded_input.value())) {
+      add_timer(std::move(timer_info));
+      if (output_chunk.timers_size() == kMaxTimersPerChunk) {
+        end_chunk();
+      }
+    }
+    end_chunk();
   }
 
+  // Each chunk that is kept, in part, is written as a chunk of its own, so
+  // that the chunks still cover short time ranges.
+  std::string compressed_chunk;
+  std::vector<TimerInfo> timers;
+  for (const CaptureChunkInfo& chunk_info : chunks) {
+    if (chunk_info.max_timestamp_ns() < filter.min_timestamp_ns ||
+        chunk_info.min_timestamp_ns() > filter.max_timestamp_ns) {
+      continue;
+    }
+    compressed_chunk.resize(chunk_info.size());
+    input.clear();
+    input.seekg(capture_start +
+                static_cast<std::streamoff>(chunk_info.offset()));
+    if (!input.read(compressed_chunk.data(), compressed_chunk.size())) {
+      return ErrorMessage("Error reading a chunk of the capture");
+    }
+    CaptureChunk chunk;
+    timers.clear();
+    OUTCOME_TRY(ParseChunk(compressed_chunk.data(), compressed_chunk.size(),
+                           &chunk, &timers));
+    for (TimerInfo& timer_info : timers) {
+      add_timer(std::move(timer_info));
+    }
+    for (CallstackEvent& callstack_event : *chunk.mutable_callstack_events()) {
+      add_callstack_event(std::move(callstack_event));
+    }
+    end_chunk();
+  }
+
+  const uint64_t index_offset = offset;
+  WriteMessage(&index, &coded_output);
+  coded_output.WriteLittleEndian64(index_offset);
+  if (coded_output.HadError()) {
+    return ErrorMessage("Error writing the capture");
+  }
+  return outcome::success();
+}
+
+ErrorMessageOr<void> CaptureSerializer::Export(
+    const std::string& input_filename, const std::string& output_filename,
+    const CaptureExportFilter& filter) {
+  if (input_filename == output_filename) {
+    return ErrorMessage("Cannot export a capture to the file it is read from");
+  }
+  std::ifstream input(input_filename, std::ios::binary);
+  if (input.fail()) {
+    ERROR("Exporting capture from \"%s\": %s", input_filename, "file.fail()");
+    return ErrorMessage("Error opening the file for reading");
+  }
+  std::ofstream output(output_filename, std::ios::binary);
+  if (output.fail()) {
+    ERROR("Exporting capture to \"%s\": %s", output_filename, "file.fail()");
+    return ErrorMessage("Error opening the file for writing");
+  }
+
+  SCOPE_TIMER_LOG(absl::StrFormat("Exporting capture from \"%s\" to \"%s\"",
+                                  input_filename, output_filename));
+  return Export(input, output, filter);
+}
+
+void CaptureSerializer::FinishLoading() {
+  Capture::GSamplingProfiler->ProcessSamples();
+  FillEventBuffer();
+
   Capture::GState = Capture::State::kDone;
 
   GOrbitApp->AddSamplingReport(Capture::GSamplingProfiler);
   GOrbitApp->AddTopDownView(*Capture::GSamplingProfiler);
   GOrbitApp->FireRefreshCallbacks();
-  return outcome::success();
 }
@@ -5,13 +5,32 @@
 #ifndef ORBIT_GL_CAPTURE_SERIALIZER_H_
 #define ORBIT_GL_CAPTURE_SERIALIZER_H_
 
+#include <google/protobuf/io/coded_stream.h>
+
+#include <cstdint>
 #include <iosfwd>
+#include <limits>
 #include <outcome.hpp>
 #include <string>
+#include <vector>
 
 #include "OrbitBase/Result.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
 #include "capture_data.pb.h"
 
+// The timers and callstack events kept when exporting a part of a capture.
+// Timers are kept if they intersect [min_timestamp_ns, max_timestamp_ns], and
+// callstack events if they are in it. With relative_to_capture_start, the
+// timestamps are relative to the earliest one of the capture, which is only
+// known for chunked captures. An empty thread_ids keeps all threads.
+struct CaptureExportFilter {
+  uint64_t min_timestamp_ns = 0;
+  uint64_t max_timestamp_ns = std::numeric_limits<uint64_t>::max();
+  bool relative_to_capture_start = false;
+  absl::flat_hash_set<int32_t> thread_ids;
+};
+
 class CaptureSerializer {
  public:
   void Save(std::ostream& stream);
@@ -20,15 +39,97 @@ class CaptureSerializer {
   ErrorMessageOr<void> Load(std::istream& stream);
   ErrorMessageOr<void> Load(const std::string& filename);
 
+  // Loading in steps, so that the chunks of a chunked capture can be loaded
+  // off the main thread while the capture is already shown. LoadWithoutChunks
+  // loads everything but the chunks, and returns them in the order in which
+  // to load them. It loads captures that are not chunked entirely.
+  ErrorMessageOr<std::vector<orbit_client_protos::CaptureChunkInfo>>
+  LoadWithoutChunks(std::istream& stream);
+  // Loads the chunks like the events of a live capture: the timers are
+  // enqueued into time_graph and the callstack events are added to
+  // Capture::GSamplingProfiler. This can run on any thread, and stream must
+  // be positioned at the start of the capture, as it was for
+  // LoadWithoutChunks. The chunks are decompressed and parsed in parallel,
+  // taken in the order of chunks.
+  static ErrorMessageOr<void> LoadChunks(
+      std::istream& stream,
+      const std::vector<orbit_client_protos::CaptureChunkInfo>& chunks,
+      class TimeGraph* time_graph);
+  // Like the above, reading the capture from filename. On Linux the file is
+  // mapped into memory, so that the chunks are decompressed in place instead
+  // of being copied first, and the pages of the chunks already loaded are
+  // released.
+  static ErrorMessageOr<void> LoadChunks(
+      const std::string& filename,
+      const std::vector<orbit_client_protos::CaptureChunkInfo>& chunks,
+      class TimeGraph* time_graph);
+  // Processes the callstack events loaded, on the main thread, once all
+  // chunks have been loaded.
+  void FinishLoading();
+
+  // Writes the part of the capture in input that filter keeps to output, in
+  // the current format, without loading the capture: the chunks are read
+  // and filtered one at a time, and chunks outside of the time range are
+  // skipped entirely. All of the other capture data is kept.
+  static ErrorMessageOr<void> Export(std::istream& input, std::ostream& output,
+                                     const CaptureExportFilter& filter);
+  static ErrorMessageOr<void> Export(const std::string& input_filename,
+                                     const std::string& output_filename,
+                                     const CaptureExportFilter& filter);
+
   class TimeGraph* time_graph_;
 
  private:
+  // CaptureStreamWriter writes the same format, a chunk at a time.
+  friend class CaptureStreamWriter;
+
+  // Timers and callstack events per chunk, which are compressed well enough
+  // while a chunk still covers a short time range.
+  static constexpr int kMaxTimersPerChunk = 16 * 1024;
+  static constexpr int kMaxCallstackEventsPerChunk = 16 * 1024;
+
+  // Returns the number of bytes written.
+  static uint64_t WriteMessage(const google::protobuf::Message* message,
+                               google::protobuf::io::CodedOutputStream* output);
+  // Compresses chunk, after moving its timers into its timer columns, writes
+  // it at offset, which it advances, and adds it to index. Offsets are
+  // relative to the start of the capture. They are counted here, as
+  // CodedOutputStream::ByteCount is an int.
+  static void WriteChunk(orbit_client_protos::CaptureChunk* chunk,
+                         uint64_t min_timestamp_ns, uint64_t max_timestamp_ns,
+                         google::protobuf::io::CodedOutputStream* output,
+                         uint64_t* offset,
+                         orbit_client_protos::CaptureIndex* index);
+  static void WriteCompressedChunk(
+      const orbit_client_protos::CaptureChunk& chunk,
+      const std::string& compressed_chunk, uint64_t min_timestamp_ns,
+      uint64_t max_timestamp_ns,
+      google::protobuf::io::CodedOutputStream* output, uint64_t* offset,
+      orbit_client_protos::CaptureIndex* index);
+
+  // Reads the chain of indices of a chunked capture, whose trailer is at the
+  // end of stream, and merges the capture data of the indices into
+  // capture_info. Returns the chunks in the order in which they are stored.
+  static ErrorMessageOr<std::vector<orbit_client_protos::CaptureChunkInfo>>
+  ReadChunkIndex(std::istream& stream, std::streampos capture_start,
+                 orbit_client_protos::CaptureInfo* capture_info);
+
   void FillCaptureData(orbit_client_protos::CaptureInfo* capture_info);
   void ProcessCaptureData(const orbit_client_protos::CaptureInfo& capture_info);
+  // Can be called in parallel, with the same sampling_profiler_mutex.
+  static ErrorMessageOr<void> LoadChunk(const char* data, uint64_t size,
+                                        class TimeGraph* time_graph,
+                                        absl::Mutex* sampling_profiler_mutex);
+  void SaveChunks(google::protobuf::io::CodedOutputStream* output,
+                  uint64_t* offset, orbit_client_protos::CaptureIndex* index);
 
   orbit_client_protos::CaptureHeader header;
 
-  const std::string kRequiredCaptureVersion = "1.51";
+  static inline const std::string kRequiredCaptureVersion = "1.53";
+  // The last version whose chunks hold TimerInfos instead of TimerColumns.
+  static inline const std::string kTimerInfoChunksCaptureVersion = "1.52";
+  // The last version whose timers and callstack events are not chunked.
+  static inline const std::string kUnchunkedCaptureVersion = "1.51";
 };
 
 #endif  // ORBIT_GL_CAPTURE_SERIALIZER_H_
@@ -0,0 +1,189 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "CaptureStreamWriter.h"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+
+#include "Capture.h"
+#include "CaptureSerializer.h"
+#include "OrbitBase/Logging.h"
+#include "absl/strings/str_format.h"
+
+using orbit_client_protos::CallstackEvent;
+using orbit_client_protos::CallstackInfo;
+using orbit_client_protos::CaptureHeader;
+using orbit_client_protos::CaptureIndex;
+using orbit_client_protos::CaptureInfo;
+using orbit_client_protos::LinuxAddressInfo;
+using orbit_client_protos::TimerInfo;
+
+namespace {
+constexpr std::chrono::seconds kMaxChunkDuration{1};
+}  // namespace
+
+ErrorMessageOr<std::unique_ptr<CaptureStreamWriter>>
+CaptureStreamWriter::Create(const std::string& filename) {
+  std::unique_ptr<CaptureStreamWriter> writer(
+      new CaptureStreamWriter(filename));
+  writer->file_.open(filename, std::ios::binary);
+  if (writer->file_.fail()) {
+    ERROR("Saving capture in \"%s\": %s", filename, "file.fail()");
+    return ErrorMessage("Error opening the file for writing");
+  }
+
+  CaptureHeader header;
+  header.set_version(CaptureSerializer::kRequiredCaptureVersion);
+
+  CaptureInfo capture_info;
+  for (const auto& function : Capture::GSelectedInCaptureFunctions) {
+    if (function != nullptr) {
+      *capture_info.add_selected_functions() = *function;
+    }
+  }
+  capture_info.set_process_id(Capture::GProcessId);
+  capture_info.set_process_name(Capture::GProcessName);
+
+  std::string buffer;
+  {
+    google::protobuf::io::StringOutputStream string_stream(&buffer);
+    google::protobuf::io::CodedOutputStream output(&string_stream);
+    writer->offset_ += CaptureSerializer::WriteMessage(&header, &output);
+    writer->offset_ += CaptureSerializer::WriteMessage(&capture_info, &output);
+  }
+  writer->Write(buffer);
+  // The file is a valid, empty capture from the start.
+  writer->WriteChunkAndIndex();
+  if (writer->failed_) {
+    return ErrorMessage("Error writing the file");
+  }
+  return writer;
+}
+
+void CaptureStreamWriter::AddTimers(absl::Span<const TimerInfo> timers) {
+  if (finished_) return;
+  for (const TimerInfo& timer_info : timers) {
+    *chunk_.add_timers() = timer_info;
+    min_timestamp_ns_ = std::min(min_timestamp_ns_, timer_info.start());
+    max_timestamp_ns_ = std::max(max_timestamp_ns_, timer_info.end());
+    if (chunk_.timers_size() == CaptureSerializer::kMaxTimersPerChunk) {
+      WriteChunkAndIndex();
+    }
+  }
+  WriteChunkIfFull();
+}
+
+void CaptureStreamWriter::AddCallstackEvent(
+    const CallstackEvent& callstack_event) {
+  if (finished_) return;
+  *chunk_.add_callstack_events() = callstack_event;
+  min_timestamp_ns_ = std::min(min_timestamp_ns_, callstack_event.time());
+  max_timestamp_ns_ = std::max(max_timestamp_ns_, callstack_event.time());
+  WriteChunkIfFull();
+}
+
+void CaptureStreamWriter::AddCallstack(const CallStack& callstack) {
+  if (finished_) return;
+  CallstackInfo* callstack_info = capture_info_.add_callstacks();
+  *callstack_info->mutable_data() = {callstack.m_Data.begin(),
+                                     callstack.m_Data.end()};
+}
+
+void CaptureStreamWriter::AddKeyAndString(uint64_t key,
+                                          const std::string& str) {
+  if (finished_) return;
+  (*capture_info_.mutable_key_to_string())[key] = str;
+}
+
+void CaptureStreamWriter::AddThreadName(int32_t thread_id,
+                                        const std::string& thread_name) {
+  if (finished_) return;
+  (*capture_info_.mutable_thread_names())[thread_id] = thread_name;
+}
+
+void CaptureStreamWriter::AddAddressInfo(
+    const LinuxAddressInfo& address_info) {
+  if (finished_) return;
+  *capture_info_.add_address_infos() = address_info;
+}
+
+ErrorMessageOr<void> CaptureStreamWriter::Finish() {
+  CHECK(!finished_);
+  // The function names of the selected functions are only added to their
+  // address infos when saving, as in CaptureSerializer::Save. Address infos
+  // written later replace those written before.
+  Capture::PreSave();
+  for (const auto& selected_function : Capture::GSelectedFunctionsMap) {
+    std::optional<LinuxAddressInfo> address_info =
+        Capture::GCaptureData.GetAddressInfo(selected_function.first);
+    if (address_info.has_value()) {
+      *capture_info_.add_address_infos() = std::move(*address_info);
+    }
+  }
+
+  WriteChunkAndIndex();
+  finished_ = true;
+  file_.close();
+  if (failed_ || file_.fail()) {
+    return ErrorMessage(
+        absl::StrFormat("Error writing the capture to \"%s\"", filename_));
+  }
+  return outcome::success();
+}
+
+void CaptureStreamWriter::WriteChunkIfFull() {
+  if (chunk_.callstack_events_size() >=
+          CaptureSerializer::kMaxCallstackEventsPerChunk ||
+      std::chrono::steady_clock::now() - chunk_start_time_ >=
+          kMaxChunkDuration) {
+    WriteChunkAndIndex();
+  }
+}
+
+void CaptureStreamWriter::WriteChunkAndIndex() {
+  // The chunk, the index and the offset of the index are written at once, so
+  // that the file always ends with an index, unless writing fails.
+  std::string buffer;
+  {
+    google::protobuf::io::StringOutputStream string_stream(&buffer);
+    google::protobuf::io::CodedOutputStream output(&string_stream);
+
+    CaptureIndex index;
+    if (chunk_.timers_size() > 0 || chunk_.callstack_events_size() > 0) {
+      CaptureSerializer::WriteChunk(&chunk_, min_timestamp_ns_,
+                                    max_timestamp_ns_, &output, &offset_,
+                                    &index);
+    }
+    index.set_previous_index_offset(previous_index_offset_);
+    index.mutable_capture_info()->Swap(&capture_info_);
+
+    const uint64_t index_offset = offset_;
+    offset_ += CaptureSerializer::WriteMessage(&index, &output);
+    output.WriteLittleEndian64(index_offset);
+    offset_ += sizeof(index_offset);
+    previous_index_offset_ = index_offset;
+  }
+  Write(buffer);
+
+  chunk_.Clear();
+  capture_info_.Clear();
+  min_timestamp_ns_ = std::numeric_limits<uint64_t>::max();
+  max_timestamp_ns_ = 0;
+  chunk_start_time_ = std::chrono::steady_clock::now();
+}
+
+void CaptureStreamWriter::Write(const std::string& data) {
+  if (failed_) return;
+  file_.write(data.data(), data.size());
+  file_.flush();
+  if (file_.fail()) {
+    ERROR("Writing capture to \"%s\"", filename_);
+    failed_ = true;
+  }
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_CAPTURE_STREAM_WRITER_H_
+#define ORBIT_GL_CAPTURE_STREAM_WRITER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <string>
+
+#include "Callstack.h"
+#include "OrbitBase/Result.h"
+#include "absl/types/span.h"
+#include "capture_data.pb.h"
+
+// Writes a capture to a file while it is taken, in the chunked format of
+// CaptureSerializer. The file is only ever appended to: each chunk is
+// written together with an index of it and of the data of the capture
+// received since the previous index, and with the offset of that index.
+// Hence, after each chunk the file is a complete capture, and if the client
+// crashes only the events of one chunk are lost.
+//
+// All methods but Create must be called from the same thread, or
+// synchronized.
+class CaptureStreamWriter {
+ public:
+  // Creates filename and writes the start of the capture: the selected
+  // functions and the process, from Capture, which must have been started.
+  static ErrorMessageOr<std::unique_ptr<CaptureStreamWriter>> Create(
+      const std::string& filename);
+
+  CaptureStreamWriter(const CaptureStreamWriter&) = delete;
+  CaptureStreamWriter& operator=(const CaptureStreamWriter&) = delete;
+
+  void AddTimers(absl::Span<const orbit_client_protos::TimerInfo> timers);
+  void AddCallstackEvent(
+      const orbit_client_protos::CallstackEvent& callstack_event);
+  void AddCallstack(const CallStack& callstack);
+  void AddKeyAndString(uint64_t key, const std::string& str);
+  void AddThreadName(int32_t thread_id, const std::string& thread_name);
+  void AddAddressInfo(
+      const orbit_client_protos::LinuxAddressInfo& address_info);
+
+  // Writes what is left of the capture, once it has been stopped. The writer
+  // doesn't accept anything after this.
+  ErrorMessageOr<void> Finish();
+
+  [[nodiscard]] const std::string& GetFileName() const { return filename_; }
+
+ private:
+  explicit CaptureStreamWriter(std::string filename)
+      : filename_(std::move(filename)) {}
+
+  // Writes the chunk, if not empty, and the index.
+  void WriteChunkAndIndex();
+  // Also writes the chunk when it has been filling for a while, so that little
+  // is lost when events are rare.
+  void WriteChunkIfFull();
+  void Write(const std::string& data);
+
+  std::string filename_;
+  std::ofstream file_;
+  bool failed_ = false;
+  bool finished_ = false;
+  uint64_t offset_ = 0;
+  uint64_t previous_index_offset_ = 0;
+
+  orbit_client_protos::CaptureChunk chunk_;
+  uint64_t min_timestamp_ns_ = std::numeric_limits<uint64_t>::max();
+  uint64_t max_timestamp_ns_ = 0;
+  std::chrono::steady_clock::time_point chunk_start_time_ =
+      std::chrono::steady_clock::now();
+  // The data received since the last index was written.
+  orbit_client_protos::CaptureInfo capture_info_;
+};
+
+#endif  // ORBIT_GL_CAPTURE_STREAM_WRITER_H_
@@ -24,6 +24,7 @@ CaptureWindow::CaptureWindow() {
   m_DrawFilter = false;
   m_FirstHelpDraw = true;
   m_DrawStats = false;
+  m_DrawRenderTimes = false;
   m_Picking = false;
   m_WorldTopLeftX = 0;
   m_WorldTopLeftY = 0;
@@ -140,7 +141,9 @@ void CaptureWindow::LeftDown(int a_X, int a_Y) {
 
   Orbit_ImGui_MouseButtonCallback(this, 0, true);
 
-  m_Picking = true;
+  if (!SelectTimerAt(a_X, a_Y)) {
+    m_Picking = true;
+  }
   NeedsRedraw();
 }
 
@@ -154,7 +157,9 @@ void CaptureWindow::LeftUp() {
 void CaptureWindow::LeftDoubleClick() {
   GlCanvas::LeftDoubleClick();
   m_DoubleClicking = true;
-  m_Picking = true;
+  if (!SelectTimerAt(m_ScreenClickX, m_ScreenClickY)) {
+    m_Picking = true;
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -209,6 +214,35 @@ void CaptureWindow::SelectTextBox(class TextBox* text_box) {
   }
 }
 
+//-----------------------------------------------------------------------------
+std::optional<TimeGraph::PickedTimer> CaptureWindow::PickTimer(int x, int y) {
+  // The sliders, and the time bar, are drawn over the time graph along the
+  // borders of the canvas.
+  const int border = static_cast<int>(slider_->GetPixelHeight());
+  if (x >= getWidth() - border || y < border || y >= getHeight() - border) {
+    return std::nullopt;
+  }
+
+  float world_x;
+  float world_y;
+  ScreenToWorld(x, y, world_x, world_y);
+  return time_graph_.PickTimer(world_x, world_y);
+}
+
+//-----------------------------------------------------------------------------
+bool CaptureWindow::SelectTimerAt(int x, int y) {
+  std::optional<TimeGraph::PickedTimer> picked_timer = PickTimer(x, y);
+  if (!picked_timer.has_value()) {
+    return false;
+  }
+
+  Capture::GSelectedTextBox = nullptr;
+  Capture::GSelectedThreadId = 0;
+  SelectTextBox(picked_timer->text_box);
+  NeedsUpdate();
+  return true;
+}
+
 //-----------------------------------------------------------------------------
 void CaptureWindow::Hover(int a_X, int a_Y) {
   // 4 bytes per pixel (RGBA), 1x1 bitmap
@@ -242,11 +276,22 @@ void CaptureWindow::FindCode(DWORD64 /*address*/) {}
 
 //-----------------------------------------------------------------------------
 void CaptureWindow::PreRender() {
-  if (is_mouse_over_ && m_CanHover &&
+  // Can be called again before the render, which does the hover.
+  if (is_mouse_over_ && m_CanHover && !m_IsHovering &&
       m_HoverTimer.QueryMillis() > m_HoverDelayMs) {
-    m_IsHovering = true;
-    m_Picking = true;
-    NeedsRedraw();
+    // Hovering a timer doesn't need a picking pass.
+    std::optional<TimeGraph::PickedTimer> picked_timer =
+        PickTimer(m_MousePosX, m_MousePosY);
+    if (picked_timer.has_value()) {
+      m_CanHover = false;
+      m_HoverTimer.Reset();
+      GOrbitApp->SendTooltipToUi(
+          picked_timer->track->GetBoxTooltip(picked_timer->text_box));
+    } else {
+      m_IsHovering = true;
+      m_Picking = true;
+      NeedsRedraw();
+    }
   }
 
   m_NeedsRedraw = m_NeedsRedraw || time_graph_.IsRedrawNeeded();
@@ -285,7 +330,9 @@ void CaptureWindow::RightDown(int a_X, int a_Y) {
   ScreenToWorld(a_X, a_Y, m_WorldClickX, m_WorldClickY);
   m_ScreenClickX = a_X;
   m_ScreenClickY = a_Y;
-  Pick();
+  if (!SelectTimerAt(a_X, a_Y)) {
+    Pick();
+  }
 
   m_IsSelecting = true;
   m_SelectStart = Vec2(m_WorldClickX, m_WorldClickY);
@@ -456,6 +503,9 @@ void CaptureWindow::KeyPressed(unsigned int a_KeyCode, bool a_Ctrl,
       case 'H':
         m_DrawHelp = !m_DrawHelp;
         break;
+      case 'R':
+        m_DrawRenderTimes = !m_DrawRenderTimes;
+        break;
       case 'X':
         GOrbitApp->ToggleCapture();
         m_DrawHelp = false;
@@ -469,7 +519,10 @@ void CaptureWindow::KeyPressed(unsigned int a_KeyCode, bool a_Ctrl,
         }
         break;
       case 18:  // Left
-        if (a_Shift) {
+        if (a_Ctrl) {
+          time_graph_.JumpToTimerSearchMatch(
+              TimeGraph::JumpDirection::kPrevious);
+        } else if (a_Shift) {
           time_graph_.JumpToNeighborBox(Capture::GSelectedTextBox,
                                         TimeGraph::JumpDirection::kPrevious,
                                         TimeGraph::JumpScope::kSameFunction);
@@ -484,7 +537,10 @@ void CaptureWindow::KeyPressed(unsigned int a_KeyCode, bool a_Ctrl,
         }
         break;
       case 20:  // Right
-        if (a_Shift) {
+        if (a_Ctrl) {
+          time_graph_.JumpToTimerSearchMatch(
+              TimeGraph::JumpDirection::kNext);
+        } else if (a_Shift) {
           time_graph_.JumpToNeighborBox(Capture::GSelectedTextBox,
                                         TimeGraph::JumpDirection::kNext,
                                         TimeGraph::JumpScope::kSameFunction);
@@ -547,6 +603,8 @@ void CaptureWindow::Draw() {
   m_WorldMaxY =
       1.5f * ScreenToWorldHeight(static_cast<int>(slider_->GetPixelHeight()));
 
+  // Also after the capture has stopped, for the last events of the capture.
+  time_graph_.ProcessEnqueuedEvents();
   if (Capture::IsCapturing()) {
     ZoomAll();
   }
@@ -729,7 +787,7 @@ void CaptureWindow::RenderUI() {
 
 #ifndef WIN32
     m_StatsWindow.AddLine(
-        VAR_TO_STR(GEventTracer.GetEventBuffer().GetCallstacks().size()));
+        VAR_TO_STR(GEventTracer.GetEventBuffer().GetThreadCount()));
     m_StatsWindow.AddLine(
         VAR_TO_STR(GEventTracer.GetEventBuffer().GetNumEvents()));
 #endif
@@ -748,11 +806,36 @@ void CaptureWindow::RenderUI() {
     }
   }
 
+  if (m_DrawRenderTimes) {
+    RenderRenderTimesUi();
+  }
+
   // Rendering
   glViewport(0, 0, getWidth(), getHeight());
   ImGui::Render();
 }
 
+//-----------------------------------------------------------------------------
+void CaptureWindow::RenderRenderTimesUi() {
+  // Only updated when the capture window is redrawn anyway: redrawing for
+  // the overlay would make it measure itself.
+  const RenderStats stats = GetRenderStats();
+  constexpr float kYOffset = 8.f;
+  ImGui::SetNextWindowPos(ImVec2(getWidth(), kYOffset), ImGuiCond_Always,
+                          ImVec2(1.f, 0.f));
+  if (!ImGui::Begin("Render Times", &m_DrawRenderTimes, ImVec2(0, 0), 0.6f,
+                    ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize |
+                        ImGuiWindowFlags_NoMove |
+                        ImGuiWindowFlags_NoSavedSettings)) {
+    ImGui::End();
+    return;
+  }
+  ImGui::Text("Render: %.2f ms average, %.2f ms max", stats.average_render_ms,
+              stats.max_render_ms);
+  ImGui::Text("Redraws in the last second: %u", stats.renders_in_last_second);
+  ImGui::End();
+}
+
 //-----------------------------------------------------------------------------
 void CaptureWindow::RenderText() {
   if (!m_Picking) {
@@ -790,7 +873,9 @@ void CaptureWindow::RenderHelpUi() {
   ImGui::Text("Zoom: 'W', 'S', Scroll or \"Ctrl + Right Click + Drag\"");
   ImGui::Text("Select: Left Click");
   ImGui::Text("Measure: \"Right Click + Drag\"");
+  ImGui::Text("Previous/Next Timer Search Match: \"Ctrl + Left/Right\"");
   ImGui::Text("Toggle Help: 'H'");
+  ImGui::Text("Toggle Render Times: 'R'");
 
   ImGui::End();
 
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <optional>
+
 #include "Batcher.h"
 #include "GlCanvas.h"
 #include "GlSlider.h"
@@ -50,9 +52,14 @@ class CaptureWindow : public GlCanvas {
   void PostRender() override;
   void Resize(int a_Width, int a_Height) override;
   void RenderHelpUi();
+  void RenderRenderTimesUi();
   void RenderTimeBar();
   void ResetHoverTimer();
   void SelectTextBox(TextBox* text_box);
+  // Selects the timer at the screen position without a picking pass, if
+  // there is one and nothing else can be drawn over it there.
+  bool SelectTimerAt(int x, int y);
+  [[nodiscard]] std::optional<TimeGraph::PickedTimer> PickTimer(int x, int y);
   void OnDrag(float a_Ratio);
   void OnVerticalDrag(float a_Ratio);
   void NeedsUpdate();
@@ -79,6 +86,7 @@ class CaptureWindow : public GlCanvas {
   bool m_DrawFilter;
   bool m_FirstHelpDraw;
   bool m_DrawStats;
+  bool m_DrawRenderTimes;
   std::shared_ptr<GlSlider> slider_;
   std::shared_ptr<GlSlider> vertical_slider_;
 
@@ -36,6 +36,17 @@ void DataManager::UpdateModuleInfos(
   it->second->UpdateModuleInfos(module_infos);
 }
 
+void DataManager::UpdateModuleInfos(
+    int32_t process_id, const std::vector<ModuleInfo>& changed_module_infos,
+    const std::vector<uint64_t>& removed_address_starts) {
+  CHECK(std::this_thread::get_id() == main_thread_id_);
+
+  auto it = process_map_.find(process_id);
+  CHECK(it != process_map_.end());
+
+  it->second->UpdateModuleInfos(changed_module_infos, removed_address_starts);
+}
+
 ProcessData* DataManager::GetProcessByPid(int32_t process_id) {
   CHECK(std::this_thread::get_id() == main_thread_id_);
 
@@ -22,6 +22,9 @@ class DataManager final {
   void UpdateProcessInfos(const std::vector<ProcessInfo>& process_infos);
   void UpdateModuleInfos(int32_t process_id,
                          const std::vector<ModuleInfo>& module_infos);
+  void UpdateModuleInfos(int32_t process_id,
+                         const std::vector<ModuleInfo>& changed_module_infos,
+                         const std::vector<uint64_t>& removed_address_starts);
 
   ProcessData* GetProcessByPid(int32_t process_id);
   const std::vector<ModuleData*>& GetModules(int32_t process_id);
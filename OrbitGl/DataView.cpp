@@ -8,6 +8,21 @@
 
 #include "App.h"
 
+//-----------------------------------------------------------------------------
+DataView::~DataView() { CancelAndWaitForJobs(); }
+
+//-----------------------------------------------------------------------------
+void DataView::CancelAndWaitForJobs() {
+  if (job_state_ == nullptr) {
+    return;
+  }
+  job_state_->data_view = nullptr;
+  ++job_state_->generation;
+  job_thread_pool_->ShutdownAndWait();
+  job_state_ = nullptr;
+  job_thread_pool_ = nullptr;
+}
+
 //-----------------------------------------------------------------------------
 void DataView::InitSortingOrders() {
   m_SortingOrders.clear();
@@ -20,6 +35,9 @@ void DataView::InitSortingOrders() {
 
 //-----------------------------------------------------------------------------
 void DataView::OnSort(int column, std::optional<SortingOrder> new_order) {
+  // Views also sort when their values change, e.g., on each timer tick of a
+  // capture.
+  ++update_count_;
   if (column < 0) {
     return;
   }
@@ -37,13 +55,82 @@ void DataView::OnSort(int column, std::optional<SortingOrder> new_order) {
     m_SortingOrders[column] = new_order.value();
   }
 
-  DoSort();
+  IndicesJob sort_job = CreateSortJob();
+  if (sort_job == nullptr || GOrbitApp == nullptr) {
+    DoSort();
+    return;
+  }
+  // A filter that is still running is started again, as its result needs this
+  // sort rather than the one it was started with.
+  StartJob(is_filter_job_pending_ ? CreateFilterJob() : nullptr,
+           std::move(sort_job));
 }
 
 //-----------------------------------------------------------------------------
 void DataView::OnFilter(const std::string& filter) {
   m_Filter = filter;
-  DoFilter();
+  ++update_count_;
+
+  IndicesJob filter_job = CreateFilterJob();
+  if (filter_job == nullptr || GOrbitApp == nullptr) {
+    DoFilter();
+    return;
+  }
+  IndicesJob sort_job = nullptr;
+  if (IsSortingAllowed() && m_SortingColumn >= 0) {
+    if (m_SortingOrders.empty()) {
+      InitSortingOrders();
+    }
+    sort_job = CreateSortJob();
+  }
+  StartJob(std::move(filter_job), std::move(sort_job));
+}
+
+//-----------------------------------------------------------------------------
+void DataView::StartJob(IndicesJob filter_job, IndicesJob sort_job) {
+  if (job_state_ == nullptr) {
+    job_state_ = std::make_shared<JobState>();
+    job_state_->data_view = this;
+    job_thread_pool_ = ThreadPool::Create(1, 1, absl::Seconds(1));
+  }
+  is_filter_job_pending_ = filter_job != nullptr;
+  const uint64_t generation = ++job_state_->generation;
+
+  job_thread_pool_->Schedule([job_state = job_state_, generation,
+                              indices = indices_,
+                              filter_job = std::move(filter_job),
+                              sort_job = std::move(sort_job)]() mutable {
+    auto is_canceled = [&job_state, generation] {
+      return job_state->generation != generation;
+    };
+    std::optional<std::vector<uint32_t>> new_indices = std::move(indices);
+    for (const IndicesJob* job : {&filter_job, &sort_job}) {
+      if (is_canceled()) {
+        return;
+      }
+      if (*job != nullptr) {
+        new_indices = (*job)(std::move(new_indices.value()), is_canceled);
+        if (!new_indices.has_value()) {
+          return;
+        }
+      }
+    }
+
+    GOrbitApp->GetMainThreadExecutor()->Schedule(
+        [job_state, generation,
+         new_indices = std::move(new_indices)]() mutable {
+          DataView* data_view = job_state->data_view;
+          if (data_view == nullptr || job_state->generation != generation) {
+            return;
+          }
+          data_view->indices_ = std::move(new_indices.value());
+          ++data_view->update_count_;
+          data_view->is_filter_job_pending_ = false;
+          if (data_view->refresh_callback_) {
+            data_view->refresh_callback_();
+          }
+        });
+  });
 }
 
 //-----------------------------------------------------------------------------
@@ -55,6 +142,7 @@ void DataView::SetUiFilterString(const std::string& filter) {
 
 //-----------------------------------------------------------------------------
 void DataView::OnDataChanged() {
+  ++update_count_;
   OnSort(m_SortingColumn, std::optional<SortingOrder>{});
   OnFilter(m_Filter);
 }
@@ -5,12 +5,15 @@
 #pragma once
 
 #include <OrbitBase/Logging.h>
+#include <OrbitBase/ThreadPool.h>
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <optional>
 #include <string>
 #include <utility>
+#include <variant>
 #include <vector>
 
 #include "DataViewTypes.h"
@@ -36,7 +39,7 @@ class DataView {
   explicit DataView(DataViewType type)
       : m_UpdatePeriodMs(-1), m_SelectedIndex(-1), m_Type(type) {}
 
-  virtual ~DataView() = default;
+  virtual ~DataView();
 
   virtual void SetAsMainInstance() {}
   virtual const std::vector<Column>& GetColumns() = 0;
@@ -47,6 +50,16 @@ class DataView {
   virtual size_t GetNumElements() { return indices_.size(); }
   virtual std::string GetValue(int /*a_Row*/, int /*a_Column*/) { return ""; }
   virtual std::string GetToolTip(int /*a_Row*/, int /*a_Column*/) { return ""; }
+  // The value of a cell as a number, for the columns that hold one, so that
+  // the UI doesn't need to parse the string of GetValue to use it. monostate
+  // for the other columns.
+  using NumericValue = std::variant<std::monostate, uint64_t, int64_t, double>;
+  virtual NumericValue GetNumericValue(int /*a_Row*/, int /*a_Column*/) {
+    return std::monostate{};
+  }
+  // Changes whenever the rows or their values may have changed, so that the
+  // UI can keep the values it got until then.
+  uint64_t GetUpdateCount() const { return update_count_; }
 
   // Called from UI layer.
   void OnFilter(const std::string& filter);
@@ -57,6 +70,10 @@ class DataView {
   void SetUiFilterCallback(FilterCallback callback) {
     filter_callback_ = callback;
   }
+  // Called when a sort or a filter that ran in the background is done.
+  void SetUiRefreshCallback(std::function<void()> callback) {
+    refresh_callback_ = std::move(callback);
+  }
 
   void OnSort(int column, std::optional<SortingOrder> new_order);
   virtual void OnContextMenu(const std::string& a_Action, int a_MenuIndex,
@@ -89,9 +106,31 @@ class DataView {
   void InitSortingOrders();
   virtual void DoSort() {}
   virtual void DoFilter() {}
+
+  // A sort or a filter that can run on a worker thread: it returns the new
+  // indices_ computed from indices, or nullopt if it stopped early because
+  // is_canceled returned true, after a newer job was started.
+  using IndicesJob = std::function<std::optional<std::vector<uint32_t>>(
+      std::vector<uint32_t> indices, const std::function<bool()>& is_canceled)>;
+  // Views whose sorting or filtering is slow on large data return the job
+  // that sorts by the current column, or that filters by the current filter,
+  // instead of implementing DoSort or DoFilter. The job is created on the main
+  // thread, and must only read data that it owns or that doesn't change until
+  // it is done. For a filter, the sort is applied to its result in the same
+  // job. The indices_ are only replaced, on the main thread, once a job is
+  // done and no newer one has been started since. The views that return a
+  // job can still implement DoSort and DoFilter by running it, for when there
+  // is no main thread to return to.
+  virtual IndicesJob CreateSortJob() { return nullptr; }
+  virtual IndicesJob CreateFilterJob() { return nullptr; }
+  // For the destructors of the views whose jobs use data that the view owns.
+  void CancelAndWaitForJobs();
+
   FilterCallback filter_callback_;
+  std::function<void()> refresh_callback_;
 
   std::vector<uint32_t> indices_;
+  uint64_t update_count_ = 0;
   std::vector<SortingOrder> m_SortingOrders;
   int m_SortingColumn = 0;
   std::string m_Filter;
@@ -101,4 +140,24 @@ class DataView {
 
   static const std::string MENU_ACTION_COPY_SELECTION;
   static const std::string MENU_ACTION_EXPORT_TO_CSV;
+
+ private:
+  // Shared with the jobs, which can outlive the view.
+  struct JobState {
+    std::atomic<uint64_t> generation = 0;
+    // Only accessed from the main thread, reset when the view is destroyed.
+    DataView* data_view = nullptr;
+  };
+
+  // Runs the filter job if filter_job is set, the sort job if sort_job is set,
+  // on the current indices_.
+  void StartJob(IndicesJob filter_job, IndicesJob sort_job);
+
+  std::shared_ptr<JobState> job_state_;
+  // Runs one job at a time, so that a job that is canceled while it waits
+  // doesn't run at all.
+  std::unique_ptr<ThreadPool> job_thread_pool_;
+  // Whether the filter of the job that is running needs to be applied again
+  // by a sort started before it is done.
+  bool is_filter_job_pending_ = false;
 };
@@ -13,6 +13,10 @@ enum class DataViewType {
   MODULES,
   SAMPLING,
   PRESETS,
+  SAMPLING_DIFF,
+  FRAMES,
+  LOCKS,
+  QUERY,
   ALL,
   INVALID
 };
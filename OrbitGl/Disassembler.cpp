@@ -29,7 +29,9 @@ void Disassembler::LogHex(const uint8_t* str, size_t len) {
 
 //-----------------------------------------------------------------------------
 void Disassembler::Disassemble(const uint8_t* machine_code, size_t size,
-                               uint64_t address, bool is_64bit) {
+                               uint64_t address, bool is_64bit,
+                               const ElfUtils::LineTable* line_table,
+                               uint64_t line_table_offset) {
   csh handle = 0;
   cs_arch arch = CS_ARCH_X86;
   cs_insn* insn = nullptr;
@@ -53,7 +55,30 @@ void Disassembler::Disassemble(const uint8_t* machine_code, size_t size,
   if (count) {
     size_t j;
 
+    std::optional<size_t> source_line_index;
     for (j = 0; j < count; j++) {
+      std::optional<ElfUtils::LineTable::LineInfo> line_info;
+      if (line_table != nullptr) {
+        line_info = line_table->FindLine(insn[j].address - line_table_offset);
+      }
+      if (line_info.has_value()) {
+        const std::pair<uint32_t, uint32_t> key{
+            static_cast<uint32_t>(line_info->file -
+                                  line_table->GetFileNames().data()),
+            line_info->line};
+        auto it =
+            source_line_indices_.try_emplace(key, source_line_indices_.size())
+                .first;
+        if (source_line_index != it->second) {
+          source_line_index = it->second;
+          line_to_source_line_index_[line_to_address_.size()] = it->second;
+          LOGF("%s:%u\n", *line_info->file, line_info->line);
+          line_to_address_.push_back(0);
+        }
+        line_to_source_line_index_[line_to_address_.size()] = it->second;
+      } else {
+        source_line_index.reset();
+      }
       LOGF("0x%" PRIx64 ":\t%-12s %s\n", insn[j].address, insn[j].mnemonic,
            insn[j].op_str);
       line_to_address_.push_back(insn[j].address);
@@ -78,4 +103,12 @@ void Disassembler::Disassemble(const uint8_t* machine_code, size_t size,
 uint64_t Disassembler::GetAddressAtLine(size_t line) const {
   if (line >= line_to_address_.size()) return 0;
   return line_to_address_[line];
+}
+
+//-----------------------------------------------------------------------------
+std::optional<size_t> Disassembler::GetSourceLineIndexAtLine(
+    size_t line) const {
+  auto it = line_to_source_line_index_.find(line);
+  if (it == line_to_source_line_index_.end()) return std::nullopt;
+  return it->second;
 }
\ No newline at end of file
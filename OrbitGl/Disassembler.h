@@ -4,18 +4,35 @@
 
 #pragma once
 
+#include <optional>
 #include <string>
+#include <vector>
 
 #include "BaseTypes.h"
+#include "ElfUtils/LineTable.h"
 #include "Utils.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_format.h"
 
 class Disassembler {
  public:
+  // With a line_table, the instructions are preceded by their source line
+  // whenever it changes. The addresses of the line table are the ones of the
+  // instructions minus line_table_offset.
   void Disassemble(const uint8_t* machine_code, size_t size, uint64_t address,
-                   bool is_64bit);
+                   bool is_64bit,
+                   const ElfUtils::LineTable* line_table = nullptr,
+                   uint64_t line_table_offset = 0);
   [[nodiscard]] const std::string& GetResult() const { return result_; }
   [[nodiscard]] uint64_t GetAddressAtLine(size_t line) const;
+  [[nodiscard]] size_t GetNumLines() const { return line_to_address_.size(); }
+  // The index of the source line of the instruction, or of the source line
+  // itself, at line, if any.
+  [[nodiscard]] std::optional<size_t> GetSourceLineIndexAtLine(
+      size_t line) const;
+  [[nodiscard]] size_t GetNumSourceLines() const {
+    return source_line_indices_.size();
+  }
 
   void LOGF(const std::string& format) {
     result_ += format;
@@ -27,4 +44,8 @@ class Disassembler {
  private:
   std::string result_;
   std::vector<uint64_t> line_to_address_;
+  // By (file index, line) in the line table.
+  absl::flat_hash_map<std::pair<uint32_t, uint32_t>, size_t>
+      source_line_indices_;
+  absl::flat_hash_map<size_t, size_t> line_to_source_line_index_;
 };
@@ -1,34 +1,95 @@
 #include "DisassemblyReport.h"
 
-#include "SamplingUtils.h"
+#include <algorithm>
 
-uint32_t DisassemblyReport::GetNumSamplesAtLine(size_t line) const {
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+
+void DisassemblyReport::InitLineCounts(uint64_t function_address) {
   if (function_count_ == 0 || profiler_ == nullptr) {
-    return 0;
-  }
-  uint64_t address = disasm_.GetAddressAtLine(line);
-  if (address == 0) {
-    return 0;
+    return;
   }
+  const std::vector<std::pair<uint64_t, uint32_t>> address_counts =
+      profiler_->GetSampledAddressCountsOfFunction(function_address);
+  auto address_less = [](const std::pair<uint64_t, uint32_t>& address_count,
+                         uint64_t address) {
+    return address_count.first < address;
+  };
+
+  line_counts_.resize(disasm_.GetNumLines());
+  source_line_counts_.resize(disasm_.GetNumSourceLines());
+  for (size_t line = 0; line < disasm_.GetNumLines(); ++line) {
+    const uint64_t address = disasm_.GetAddressAtLine(line);
+    if (address == 0) {
+      continue;
+    }
 
-  // On calls the address sampled might not be the address of the
-  // beginning of the instruction, but instead at the end. Thus, we
-  // iterate over all addresses that fall into this instruction.
-  uint64_t next_address = disasm_.GetAddressAtLine(line + 1);
+    // On calls the address sampled might not be the address of the
+    // beginning of the instruction, but instead at the end. Thus, we
+    // count all addresses that fall into this instruction. The source
+    // lines in between don't count.
+    size_t next_line = line + 1;
+    while (disasm_.GetAddressAtLine(next_line) == 0 &&
+           disasm_.GetSourceLineIndexAtLine(next_line).has_value()) {
+      ++next_line;
+    }
+    uint64_t next_address = disasm_.GetAddressAtLine(next_line);
 
-  // If the current instruction is the last one (next address is 0), it
-  // can not be a call, thus we can only consider this address.
-  if (next_address == 0) {
-    next_address = address + 1;
+    // If the current instruction is the last one (next address is 0), it
+    // can not be a call, thus we can only consider this address.
+    if (next_address == 0) {
+      next_address = address + 1;
+    }
+
+    uint32_t count = 0;
+    for (auto it = std::lower_bound(address_counts.begin(),
+                                    address_counts.end(), address,
+                                    address_less);
+         it != address_counts.end() && it->first < next_address; ++it) {
+      count += it->second;
+    }
+    line_counts_[line] = count;
+    std::optional<size_t> source_line_index =
+        disasm_.GetSourceLineIndexAtLine(line);
+    if (source_line_index.has_value()) {
+      source_line_counts_[source_line_index.value()] += count;
+    }
   }
-  const ThreadSampleData* data = profiler_->GetSummary();
-  if (data == nullptr) {
-    return 0.0;
+}
+
+uint32_t DisassemblyReport::GetNumSamplesAtLine(size_t line) const {
+  if (line >= line_counts_.size()) {
+    return 0;
+  }
+  if (disasm_.GetAddressAtLine(line) == 0) {
+    std::optional<size_t> source_line_index =
+        disasm_.GetSourceLineIndexAtLine(line);
+    if (!source_line_index.has_value()) {
+      return 0;
+    }
+    return source_line_counts_[source_line_index.value()];
+  }
+  return line_counts_[line];
+}
+
+std::string DisassemblyReport::GetAnnotatedResult() const {
+  if (line_counts_.empty()) {
+    return disasm_.GetResult();
   }
-  uint32_t count = 0;
-  while (address < next_address) {
-    count += SamplingUtils::GetCountForAddress(*data, address);
-    address++;
+  std::string result;
+  result.reserve(disasm_.GetResult().size());
+  size_t line = 0;
+  for (absl::string_view text : absl::StrSplit(disasm_.GetResult(), '\n')) {
+    if (line > 0) {
+      result.push_back('\n');
+    }
+    result.append(text.data(), text.size());
+    const uint32_t count = GetNumSamplesAtLine(line);
+    if (count > 0) {
+      absl::StrAppendFormat(&result, "\t; %u samples (%.2f%%)", count,
+                            100.0 * count / function_count_);
+    }
+    ++line;
   }
-  return count;
+  return result;
 }
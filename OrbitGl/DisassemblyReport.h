@@ -5,7 +5,9 @@
 #ifndef ORBIT_GL_DISASSEMBLY_REPORT_H_
 #define ORBIT_GL_DISASSEMBLY_REPORT_H_
 
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "CodeReport.h"
 #include "Disassembler.h"
@@ -20,6 +22,7 @@ class DisassemblyReport : public CodeReport {
         function_count_{(profiler_ == nullptr)
                             ? 0
                             : profiler_->GetCountOfFunction(function_address)} {
+    InitLineCounts(function_address);
   }
 
   explicit DisassemblyReport(Disassembler disasm)
@@ -34,12 +37,26 @@ class DisassemblyReport : public CodeReport {
     }
     return profiler_->GetNumSamples();
   }
+  // The samples of the instruction at line or, for the source lines, of all
+  // the instructions of the function that are of the same source line.
   [[nodiscard]] uint32_t GetNumSamplesAtLine(size_t line) const override;
 
+  // The result of the disassembler, with the sample count and percentage of
+  // the function's samples at the end of the lines that have samples.
+  [[nodiscard]] std::string GetAnnotatedResult() const;
+
  private:
+  // Counts the samples at each line once, from the exact addresses sampled
+  // in the function, so that the lines don't look up each address.
+  void InitLineCounts(uint64_t function_address);
+
   const Disassembler disasm_;
   const std::shared_ptr<SamplingProfiler> profiler_;
   const uint32_t function_count_;
+  // By line, for the instructions.
+  std::vector<uint32_t> line_counts_;
+  // By source line index.
+  std::vector<uint32_t> source_line_counts_;
 };
 
 #endif  // ORBIT_GL_DISASSEMBLY_REPORT_H_
@@ -4,6 +4,10 @@
 
 #include "EventTrack.h"
 
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
 #include "Capture.h"
 #include "EventTracer.h"
 #include "GlCanvas.h"
@@ -12,6 +16,17 @@
 
 using orbit_client_protos::CallstackEvent;
 
+namespace {
+
+// Above this many samples per pixel, on average over the visible range, the
+// density of the samples is drawn instead of a tick for each of them.
+constexpr double kMaxSamplesPerPixelForTicks = 1.0;
+// The heights of the density bars are rounded to these steps, so that runs of
+// columns of the same height are drawn as one box.
+constexpr float kDensityHeightSteps = 16.f;
+
+}  // namespace
+
 //-----------------------------------------------------------------------------
 EventTrack::EventTrack(TimeGraph* a_TimeGraph) : Track(a_TimeGraph) {
   m_MousePos[0] = m_MousePos[1] = Vec2(0, 0);
@@ -80,28 +95,45 @@ void EventTrack::Draw(GlCanvas* canvas, PickingMode picking_mode) {
 //-----------------------------------------------------------------------------
 void EventTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
                                   PickingMode picking_mode) {
-  Batcher* batcher = &time_graph_->GetBatcher();
+  CHECK(primitives_batcher_ != nullptr);
+  Batcher* batcher = primitives_batcher_;
   const TimeGraphLayout& layout = time_graph_->GetLayout();
   float z = GlCanvas::Z_VALUE_EVENT;
   float track_height = layout.GetEventTrackHeight();
   const bool picking = picking_mode != PickingMode::kNone;
 
   ScopeLock lock(GEventTracer.GetEventBuffer().GetMutex());
-  std::map<uint64_t, CallstackEvent>& callstacks =
-      GEventTracer.GetEventBuffer().GetCallstacks()[m_ThreadId];
+  const CallstackEventsByTime& callstacks =
+      GEventTracer.GetEventBuffer().GetCallstackEventsOfThread(m_ThreadId);
 
   const Color kWhite(255, 255, 255, 255);
   const Color kGreenSelection(0, 255, 0, 255);
 
+  GlCanvas* canvas = time_graph_->GetCanvas();
+  const int width = canvas != nullptr ? canvas->getWidth() : 0;
+  const uint32_t begin = callstacks.UpperBound(min_tick);
+  const uint32_t end = std::max(begin, callstacks.LowerBound(max_tick));
+  draws_sample_density_ =
+      width > 0 && max_tick > min_tick &&
+      end - begin > kMaxSamplesPerPixelForTicks * static_cast<double>(width);
+  if (draws_sample_density_) {
+    density_min_tick_ = min_tick;
+    density_ticks_per_column_ =
+        std::max<uint64_t>((max_tick - min_tick) / width, 1);
+    const std::vector<uint32_t> counts =
+        CountSamplesPerColumn(callstacks, 0, max_tick);
+    density_max_count_ = 1;
+    for (uint32_t count : counts) {
+      density_max_count_ = std::max(density_max_count_, count);
+    }
+    AddSampleDensity(batcher, 0, counts, picking);
+  }
+
   if (!picking) {
     // Sampling Events
-    for (auto& pair : callstacks) {
-      uint64_t time = pair.first;
-      if (time > min_tick && time < max_tick) {
-        Vec2 pos(time_graph_->GetWorldFromTick(time), m_Pos[1]);
-        batcher->AddVerticalLine(pos, -track_height, z, kWhite,
-                                 PickingID::LINE);
-      }
+    for (uint32_t i = begin; !draws_sample_density_ && i < end; ++i) {
+      Vec2 pos(time_graph_->GetWorldFromTick(callstacks[i].time()), m_Pos[1]);
+      batcher->AddVerticalLine(pos, -track_height, z, kWhite, PickingID::LINE);
     }
 
     // Draw selected events
@@ -113,27 +145,141 @@ void EventTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
       batcher->AddVerticalLine(pos, -track_height, z, kGreenSelection,
                                PickingID::LINE);
     }
-  } else {
+  } else if (!draws_sample_density_) {
     // Draw boxes instead of lines to make picking easier, even if this may
     // cause samples to overlap
     constexpr const float kPickingBoxWidth = 9.0f;
     constexpr const float kPickingBoxOffset = (kPickingBoxWidth - 1.0f) / 2.0f;
 
-    for (auto& pair : callstacks) {
-      uint64_t time = pair.first;
-      if (time > min_tick && time < max_tick) {
-        Vec2 pos(time_graph_->GetWorldFromTick(time) - kPickingBoxOffset,
-                 m_Pos[1] - track_height + 1);
-        Vec2 size(kPickingBoxWidth, track_height);
-        auto user_data = std::make_unique<PickingUserData>(
-            nullptr,
-            [&](PickingID id) -> std::string { return GetSampleTooltip(id); });
-        user_data->custom_data_ = &pair.second;
-        batcher->AddShadedBox(pos, size, z, kGreenSelection, PickingID::BOX,
-                              std::move(user_data));
-      }
+    for (uint32_t i = callstacks.UpperBound(min_tick);
+         i < callstacks.size() && callstacks[i].time() < max_tick; ++i) {
+      const CallstackEvent& event = callstacks[i];
+      Vec2 pos(time_graph_->GetWorldFromTick(event.time()) - kPickingBoxOffset,
+               m_Pos[1] - track_height + 1);
+      Vec2 size(kPickingBoxWidth, track_height);
+      auto user_data = std::make_unique<PickingUserData>(
+          nullptr,
+          [&](PickingID id) -> std::string { return GetSampleTooltip(id); });
+      user_data->custom_data_ = &event;
+      batcher->AddShadedBox(pos, size, z, kGreenSelection, PickingID::BOX,
+                            std::move(user_data));
+    }
+  }
+  primitives_max_tick_ = max_tick;
+}
+
+//-----------------------------------------------------------------------------
+void EventTrack::UpdateNewPrimitives(uint64_t min_tick, uint64_t max_tick) {
+  CHECK(primitives_batcher_ != nullptr);
+  const TimeGraphLayout& layout = time_graph_->GetLayout();
+  float z = GlCanvas::Z_VALUE_EVENT;
+  float track_height = layout.GetEventTrackHeight();
+  const Color kWhite(255, 255, 255, 255);
+
+  ScopeLock lock(GEventTracer.GetEventBuffer().GetMutex());
+  const CallstackEventsByTime& callstacks =
+      GEventTracer.GetEventBuffer().GetCallstackEventsOfThread(m_ThreadId);
+  if (draws_sample_density_) {
+    // The column the previous update ended in is drawn again, over the bar it
+    // got then, with the samples added since.
+    const uint64_t first_tick =
+        std::max({min_tick, primitives_max_tick_, density_min_tick_});
+    const uint64_t first_column =
+        (first_tick - density_min_tick_) / density_ticks_per_column_;
+    AddSampleDensity(primitives_batcher_, first_column,
+                     CountSamplesPerColumn(callstacks, first_column, max_tick),
+                     /*picking=*/false);
+    primitives_max_tick_ = std::max(primitives_max_tick_, max_tick);
+    return;
+  }
+
+  for (uint32_t i =
+           callstacks.UpperBound(std::max(min_tick, primitives_max_tick_));
+       i < callstacks.size() && callstacks[i].time() < max_tick; ++i) {
+    Vec2 pos(time_graph_->GetWorldFromTick(callstacks[i].time()), m_Pos[1]);
+    primitives_batcher_->AddVerticalLine(pos, -track_height, z, kWhite,
+                                         PickingID::LINE);
+  }
+  primitives_max_tick_ = std::max(primitives_max_tick_, max_tick);
+}
+
+//-----------------------------------------------------------------------------
+std::vector<uint32_t> EventTrack::CountSamplesPerColumn(
+    const CallstackEventsByTime& callstacks, uint64_t first_column,
+    uint64_t max_tick) const {
+  // Two binary searches per column, however many samples there are.
+  std::vector<uint32_t> counts;
+  uint64_t column_begin =
+      density_min_tick_ + first_column * density_ticks_per_column_;
+  uint32_t index = callstacks.UpperBound(column_begin);
+  while (column_begin < max_tick) {
+    const uint64_t column_end =
+        std::min(column_begin + density_ticks_per_column_, max_tick);
+    const uint32_t next_index = callstacks.UpperBound(column_end);
+    counts.push_back(next_index - index);
+    index = next_index;
+    column_begin = column_end;
+  }
+  return counts;
+}
+
+//-----------------------------------------------------------------------------
+void EventTrack::AddSampleDensity(Batcher* batcher, uint64_t first_column,
+                                  const std::vector<uint32_t>& counts,
+                                  bool picking) {
+  const Color kWhite(255, 255, 255, 255);
+  const Color kGreenSelection(0, 255, 0, 255);
+  const float z = GlCanvas::Z_VALUE_EVENT;
+  const float track_height = time_graph_->GetLayout().GetEventTrackHeight();
+  const float bottom_y = m_Pos[1] - track_height;
+
+  auto get_column_x = [this, first_column](size_t column) {
+    return time_graph_->GetWorldFromTick(
+        density_min_tick_ +
+        (first_column + column) * density_ticks_per_column_);
+  };
+  auto get_height = [this, track_height](uint32_t count) {
+    if (count == 0) return 0.f;
+    const float fraction =
+        std::min(1.f, static_cast<float>(count) /
+                          static_cast<float>(density_max_count_));
+    // Columns with samples stay visible.
+    return std::max(1.f, std::round(fraction * kDensityHeightSteps)) /
+           kDensityHeightSteps * track_height;
+  };
+
+  size_t run_begin = 0;
+  float run_height = 0;
+  auto add_run = [&](size_t run_end) {
+    if (run_height <= 0) return;
+    const float x = get_column_x(run_begin);
+    Box box(Vec2(x, bottom_y), Vec2(get_column_x(run_end) - x, run_height), z);
+    if (!picking) {
+      batcher->AddBox(box, kWhite, PickingID::BOX);
+      return;
+    }
+    const uint32_t count = counts[run_begin];
+    auto user_data = std::make_unique<PickingUserData>(
+        nullptr, [count](PickingID /*id*/) -> std::string {
+          return absl::StrFormat(
+              "<b>%u samples</b><br/><br/><i>Zoom in to see the callstacks "
+              "of the samples</i>",
+              count);
+        });
+    batcher->AddBox(box, kGreenSelection, PickingID::BOX, std::move(user_data));
+  };
+
+  // For picking, each column is a box of its own, with its count in the
+  // tooltip.
+  for (size_t column = 0; column < counts.size(); ++column) {
+    const float height = get_height(counts[column]);
+    if (picking || height != run_height) {
+      add_run(column);
+      run_begin = column;
+      run_height = height;
     }
   }
+  add_run(counts.size());
 }
 
 //-----------------------------------------------------------------------------
@@ -170,6 +316,8 @@ void EventTrack::OnRelease() {
 void EventTrack::OnDrag(int a_X, int a_Y) {
   Vec2& to = m_MousePos[1];
   m_Canvas->ScreenToWorld(a_X, a_Y, to[0], to[1]);
+  // The selection report follows the mouse.
+  SelectEvents();
 }
 
 //-----------------------------------------------------------------------------
@@ -183,8 +331,8 @@ void EventTrack::SelectEvents() {
 //-----------------------------------------------------------------------------
 bool EventTrack::IsEmpty() const {
   ScopeLock lock(GEventTracer.GetEventBuffer().GetMutex());
-  const std::map<uint64_t, CallstackEvent>& callstacks =
-      GEventTracer.GetEventBuffer().GetCallstacks()[m_ThreadId];
+  const CallstackEventsByTime& callstacks =
+      GEventTracer.GetEventBuffer().GetCallstackEventsOfThread(m_ThreadId);
   return callstacks.empty();
 }
 
@@ -247,8 +395,8 @@ std::string EventTrack::GetSampleTooltip(PickingID id) const {
     return unknown_return_text;
   }
 
-  CallstackEvent* callstack_event =
-      static_cast<CallstackEvent*>(user_data->custom_data_);
+  const CallstackEvent* callstack_event =
+      static_cast<const CallstackEvent*>(user_data->custom_data_);
   auto callstack = Capture::GSamplingProfiler->GetCallStack(
       callstack_event->callstack_hash());
 
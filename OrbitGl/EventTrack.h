@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "CallstackTypes.h"
 #include "EventBuffer.h"
 #include "Track.h"
@@ -21,6 +23,7 @@ class EventTrack : public Track {
   void Draw(GlCanvas* canvas, PickingMode picking_mode) override;
   void UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
                         PickingMode picking_mode) override;
+  void UpdateNewPrimitives(uint64_t min_tick, uint64_t max_tick) override;
 
   void OnPick(int a_X, int a_Y) override;
   void OnRelease() override;
@@ -38,6 +41,13 @@ class EventTrack : public Track {
  protected:
   void SelectEvents();
   std::string GetSampleTooltip(PickingID id) const;
+  // The number of samples in each pixel column from first_column on, up to
+  // max_tick, for the columns of the last UpdatePrimitives.
+  [[nodiscard]] std::vector<uint32_t> CountSamplesPerColumn(
+      const CallstackEventsByTime& callstacks, uint64_t first_column,
+      uint64_t max_tick) const;
+  void AddSampleDensity(Batcher* batcher, uint64_t first_column,
+                        const std::vector<uint32_t>& counts, bool picking);
 
  protected:
   TextBox m_ThreadName;
@@ -48,4 +58,15 @@ class EventTrack : public Track {
   Vec2 m_MousePos[2];
   bool m_Picked;
   Color m_Color;
+  // The samples up to this tick are drawn by the previous update, if they
+  // were in its range.
+  uint64_t primitives_max_tick_ = 0;
+  // Zoomed out, with more samples in the visible range than pixels, the
+  // number of samples in each pixel column is drawn instead of the samples.
+  // The columns start at density_min_tick_, at the time of the last
+  // UpdatePrimitives, and the bars are relative to the largest count then.
+  bool draws_sample_density_ = false;
+  uint64_t density_min_tick_ = 0;
+  uint64_t density_ticks_per_column_ = 1;
+  uint32_t density_max_count_ = 1;
 };
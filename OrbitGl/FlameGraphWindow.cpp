@@ -0,0 +1,423 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "FlameGraphWindow.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <string_view>
+
+#include "App.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_format.h"
+
+namespace {
+
+constexpr float kRowHeight = 20.f;
+constexpr float kTextOffsetX = 4.f;
+constexpr float kTextOffsetY = 6.f;
+constexpr float kInfoBarHeight = 22.f;
+// Frames narrower than this, in pixels, are skipped with their subtrees.
+constexpr double kMinFrameWidth = 1.0;
+constexpr int kDragThreshold = 3;
+constexpr double kWheelZoomFactor = 0.8;
+constexpr double kMinVisibleWidth = 1e-9;
+constexpr int kRowsPerWheelStep = 3;
+
+const Color kThreadColor(120, 130, 160, 255);
+const Color kSearchMatchColor(230, 0, 230, 255);
+const Color kTextColor(0, 0, 0, 255);
+const Color kInfoBarColor(50, 50, 50, 255);
+const Color kInfoTextColor(255, 255, 255, 255);
+
+[[nodiscard]] const TopDownNode* GetAllThreadsNode(const TopDownView& view) {
+  for (const TopDownNode* child : view.children()) {
+    auto thread_node = dynamic_cast<const TopDownThread*>(child);
+    if (thread_node != nullptr &&
+        thread_node->thread_id() == SamplingProfiler::kAllThreadsFakeTid) {
+      return thread_node;
+    }
+  }
+  return nullptr;
+}
+
+[[nodiscard]] unsigned char Brighten(unsigned char value) {
+  return static_cast<unsigned char>(std::min(255, value + 40));
+}
+
+}  // namespace
+
+//-----------------------------------------------------------------------------
+FlameGraphWindow::FlameGraphWindow() {
+  m_WorldTopLeftX = 0;
+  m_WorldTopLeftY = 0;
+  GOrbitApp->RegisterFlameGraphWindow(this);
+}
+
+//-----------------------------------------------------------------------------
+FlameGraphWindow::~FlameGraphWindow() = default;
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::SetTopDownView(
+    std::shared_ptr<const TopDownView> top_down_view) {
+  top_down_view_ = std::move(top_down_view);
+  zoom_node_ = nullptr;
+  visible_begin_ = 0.0;
+  visible_width_ = 1.0;
+  first_visible_row_ = 0;
+  drawn_frames_.clear();
+  hovered_node_ = nullptr;
+  search_matches_.clear();
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::SetSearch(const std::string& search) {
+  std::string lower_case_search = absl::AsciiStrToLower(search);
+  if (lower_case_search == search_) {
+    return;
+  }
+  search_ = std::move(lower_case_search);
+  search_matches_.clear();
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::ZoomAll() {
+  zoom_node_ = nullptr;
+  visible_begin_ = 0.0;
+  visible_width_ = 1.0;
+  first_visible_row_ = 0;
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+const TopDownNode* FlameGraphWindow::GetTopNode() const {
+  if (!show_threads_) {
+    const TopDownNode* all_threads_node = GetAllThreadsNode(*top_down_view_);
+    if (all_threads_node != nullptr) {
+      return all_threads_node;
+    }
+  }
+  return top_down_view_.get();
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::ZoomInto(const TopDownNode* node) {
+  const TopDownNode* top_node = GetTopNode();
+  int row = 0;
+  for (const TopDownNode* caller = node;
+       caller != top_node && caller != nullptr; caller = caller->parent()) {
+    ++row;
+  }
+  zoom_node_ = node;
+  visible_begin_ = 0.0;
+  visible_width_ = 1.0;
+  // Keep the frame zoomed into in the window, below some of its callers.
+  first_visible_row_ = std::max(0, row - GetVisibleRowCount() / 2);
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+int FlameGraphWindow::GetVisibleRowCount() const {
+  return static_cast<int>((getHeight() - kInfoBarHeight) / kRowHeight) + 1;
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::Draw() {
+  drawn_frames_.clear();
+  if (top_down_view_ == nullptr) {
+    return;
+  }
+
+  // The top node changes when the first samples are added to an empty view,
+  // which leaves the frame zoomed into outside of the graph.
+  const TopDownNode* top_node = GetTopNode();
+  std::vector<const TopDownNode*> callers;
+  if (zoom_node_ != nullptr) {
+    const TopDownNode* node = zoom_node_;
+    while (node != top_node && node != nullptr) {
+      node = node->parent();
+      callers.push_back(node);
+    }
+    if (node == nullptr) {
+      callers.clear();
+      ZoomAll();
+    }
+  }
+  if (zoom_node_ == nullptr) {
+    zoom_node_ = top_node;
+  }
+
+  const auto window_width = static_cast<float>(getWidth());
+  int row = 0;
+  for (auto caller_it = callers.rbegin(); caller_it != callers.rend();
+       ++caller_it, ++row) {
+    if (row >= first_visible_row_) {
+      DrawFrame(**caller_it, 0.f, window_width, row);
+    }
+  }
+
+  DrawSubtree(*zoom_node_, -visible_begin_ / visible_width_ * window_width,
+              window_width / visible_width_, row);
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::DrawSubtree(const TopDownNode& node, double x,
+                                   double width, int row) {
+  const double window_width = getWidth();
+  if (width < kMinFrameWidth || x + width < 0.0 || x > window_width ||
+      row - first_visible_row_ >= GetVisibleRowCount()) {
+    return;
+  }
+
+  if (row >= first_visible_row_) {
+    const double visible_x = std::max(x, 0.0);
+    const double visible_width = std::min(x + width, window_width) - visible_x;
+    DrawFrame(node, static_cast<float>(visible_x),
+              static_cast<float>(visible_width), row);
+  }
+
+  // The all-threads node holds the samples of all other threads again.
+  const TopDownNode* skipped_child = &node == top_down_view_.get()
+                                         ? GetAllThreadsNode(*top_down_view_)
+                                         : nullptr;
+  double child_x = x;
+  for (const TopDownNode* child : node.children()) {
+    if (child_x > window_width) {
+      break;
+    }
+    if (child == skipped_child) {
+      continue;
+    }
+    const double child_width =
+        width * child->sample_count() / node.sample_count();
+    DrawSubtree(*child, child_x, child_width, row + 1);
+    child_x += child_width;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::DrawFrame(const TopDownNode& node, float x, float width,
+                                 int row) {
+  const float top = -(row - first_visible_row_) * kRowHeight;
+  // Leave a pixel between frames.
+  Box box(Vec2(x, top - kRowHeight + 1.f), Vec2(std::max(width - 1.f, 1.f),
+                                                kRowHeight - 1.f),
+          GlCanvas::Z_VALUE_BOX_ACTIVE);
+  ui_batcher_.AddBox(box, GetFrameColor(node), PickingID::BOX);
+  drawn_frames_.push_back({x, width, row, &node});
+
+  const float text_width = width - 2 * kTextOffsetX;
+  auto function_node = dynamic_cast<const TopDownFunction*>(&node);
+  std::string label;
+  const char* text;
+  if (function_node != nullptr) {
+    // The interned function names are null-terminated.
+    text = function_node->function_name().data();
+  } else {
+    label = GetFrameLabel(node);
+    text = label.c_str();
+  }
+  m_TextRenderer.AddTextTrailingCharsPrioritized(
+      text, x + kTextOffsetX, top - kRowHeight + kTextOffsetY,
+      GlCanvas::Z_VALUE_TEXT, kTextColor, 0, text_width);
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::DrawScreenSpace() {
+  const auto window_width = static_cast<float>(getWidth());
+  Box box(Vec2(0.f, 0.f), Vec2(window_width, kInfoBarHeight),
+          GlCanvas::Z_VALUE_TEXT_UI_BG);
+  ui_batcher_.AddBox(box, kInfoBarColor, PickingID::BOX);
+
+  std::string info;
+  if (hovered_node_ != nullptr) {
+    const uint64_t top_sample_count = GetTopNode()->sample_count();
+    info = absl::StrFormat(
+        "%s: %.2f%% (%llu samples)", GetFrameLabel(*hovered_node_),
+        top_sample_count == 0
+            ? 0.f
+            : hovered_node_->GetInclusivePercent(top_sample_count),
+        hovered_node_->sample_count());
+  } else {
+    info = absl::StrFormat(
+        "Click to zoom in, space to zoom out, T to show %s",
+        show_threads_ ? "all threads merged" : "one tree per thread");
+  }
+  m_TextRenderer.AddText2D(info.c_str(), static_cast<int>(kTextOffsetX),
+                           getHeight() - static_cast<int>(kTextOffsetY),
+                           GlCanvas::Z_VALUE_TEXT_UI, kInfoTextColor,
+                           window_width - 2 * kTextOffsetX);
+}
+
+//-----------------------------------------------------------------------------
+const TopDownNode* FlameGraphWindow::GetFrameAt(int x, int y) const {
+  const int row = static_cast<int>(y / kRowHeight) + first_visible_row_;
+  const auto frame_x = static_cast<float>(x);
+  for (const DrawnFrame& frame : drawn_frames_) {
+    if (frame.row == row && frame_x >= frame.x &&
+        frame_x < frame.x + frame.width) {
+      return frame.node;
+    }
+  }
+  return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+std::string FlameGraphWindow::GetFrameLabel(const TopDownNode& node) const {
+  if (auto function_node = dynamic_cast<const TopDownFunction*>(&node)) {
+    return std::string(function_node->function_name());
+  }
+  if (auto thread_node = dynamic_cast<const TopDownThread*>(&node)) {
+    if (thread_node->thread_id() == SamplingProfiler::kAllThreadsFakeTid) {
+      return thread_node->thread_name().empty()
+                 ? "(all threads)"
+                 : absl::StrFormat("%s (all threads)",
+                                   thread_node->thread_name());
+    }
+    return thread_node->thread_name().empty()
+               ? std::to_string(thread_node->thread_id())
+               : absl::StrFormat("%s [%d]", thread_node->thread_name(),
+                                 thread_node->thread_id());
+  }
+  return "(all threads)";
+}
+
+//-----------------------------------------------------------------------------
+bool FlameGraphWindow::IsSearchMatch(const TopDownFunction& function) {
+  auto [it, inserted] =
+      search_matches_.try_emplace(function.function_absolute_address(), false);
+  if (inserted) {
+    std::string name(function.function_name());
+    absl::AsciiStrToLower(&name);
+    it->second = absl::StrContains(name, search_);
+  }
+  return it->second;
+}
+
+//-----------------------------------------------------------------------------
+Color FlameGraphWindow::GetFrameColor(const TopDownNode& node) {
+  Color color = kThreadColor;
+  auto function_node = dynamic_cast<const TopDownFunction*>(&node);
+  if (function_node != nullptr) {
+    // Warm colors from the name, so that a function keeps its color in other
+    // captures.
+    const size_t hash =
+        std::hash<std::string_view>{}(function_node->function_name());
+    color = Color(static_cast<unsigned char>(205 + hash % 50),
+                  static_cast<unsigned char>((hash >> 8) % 230),
+                  static_cast<unsigned char>((hash >> 16) % 55), 255);
+  }
+
+  if (!search_.empty()) {
+    if (function_node != nullptr && IsSearchMatch(*function_node)) {
+      color = kSearchMatchColor;
+    } else {
+      const auto gray =
+          static_cast<unsigned char>((color[0] + color[1] + color[2]) / 6);
+      color = Color(gray, gray, gray, 255);
+    }
+  }
+
+  if (&node == hovered_node_) {
+    color = Color(Brighten(color[0]), Brighten(color[1]), Brighten(color[2]),
+                  255);
+  }
+  return color;
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::MouseMoved(int a_X, int a_Y, bool a_Left,
+                                  bool /*a_Right*/, bool /*a_Middle*/) {
+  m_MousePosX = a_X;
+  m_MousePosY = a_Y;
+
+  if (a_Left) {
+    const int delta_x = a_X - m_ScreenClickX;
+    is_dragging_ |= std::abs(delta_x) > kDragThreshold;
+    if (is_dragging_ && getWidth() > 0) {
+      visible_begin_ = std::clamp(
+          drag_visible_begin_ - visible_width_ * delta_x / getWidth(), 0.0,
+          1.0 - visible_width_);
+    }
+  }
+
+  hovered_node_ = GetFrameAt(a_X, a_Y);
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::LeftDown(int a_X, int a_Y) {
+  m_ScreenClickX = a_X;
+  m_ScreenClickY = a_Y;
+  is_dragging_ = false;
+  drag_visible_begin_ = visible_begin_;
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::LeftUp() {
+  if (!is_dragging_) {
+    const TopDownNode* node = GetFrameAt(m_ScreenClickX, m_ScreenClickY);
+    if (node != nullptr) {
+      ZoomInto(node);
+    }
+  }
+  is_dragging_ = false;
+  GlCanvas::LeftUp();
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::MouseWheelMoved(int a_X, int /*a_Y*/, int a_Delta,
+                                       bool a_Ctrl) {
+  if (a_Delta == 0) {
+    return;
+  }
+
+  if (a_Ctrl) {
+    first_visible_row_ = std::max(
+        0, first_visible_row_ + (a_Delta > 0 ? -1 : 1) * kRowsPerWheelStep);
+  } else if (getWidth() > 0) {
+    // Keep the point under the mouse where it is.
+    const double mouse_ratio = static_cast<double>(a_X) / getWidth();
+    const double mouse_position = visible_begin_ + mouse_ratio * visible_width_;
+    const double zoom_factor =
+        a_Delta > 0 ? kWheelZoomFactor : 1.0 / kWheelZoomFactor;
+    visible_width_ =
+        std::clamp(visible_width_ * zoom_factor, kMinVisibleWidth, 1.0);
+    visible_begin_ = std::clamp(mouse_position - mouse_ratio * visible_width_,
+                                0.0, 1.0 - visible_width_);
+  }
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::KeyPressed(unsigned int a_KeyCode, bool a_Ctrl,
+                                  bool a_Shift, bool a_Alt) {
+  UpdateSpecialKeys(a_Ctrl, a_Shift, a_Alt);
+
+  if (top_down_view_ != nullptr) {
+    switch (a_KeyCode) {
+      case ' ':
+        ZoomAll();
+        break;
+      case 3:  // Backspace
+        if (zoom_node_ != nullptr && zoom_node_ != GetTopNode()) {
+          ZoomInto(zoom_node_->parent());
+        }
+        break;
+      case 'T':
+        show_threads_ = !show_threads_;
+        drawn_frames_.clear();
+        hovered_node_ = nullptr;
+        ZoomAll();
+        break;
+    }
+  }
+
+  NeedsRedraw();
+}
@@ -0,0 +1,94 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_FLAME_GRAPH_WINDOW_H_
+#define ORBIT_GL_FLAME_GRAPH_WINDOW_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GlCanvas.h"
+#include "TopDownView.h"
+#include "absl/container/flat_hash_map.h"
+
+// Draws the top-down view of the samples as an icicle graph: each frame is
+// drawn below its caller, as wide as its share of the samples of the frame at
+// the top. The layout is computed again for each draw, from the tree of the
+// view, so that samples added during a capture show up without any other
+// update. Frames narrower than a pixel aren't drawn, nor their descendants,
+// and neither are frames outside of the window, so the cost of a draw only
+// depends on the size of the window, not on that of the tree.
+//
+// Clicking a frame zooms into it, the wheel zooms around the mouse and
+// dragging pans. Space zooms out completely and backspace by one level. "T"
+// switches between the samples of all threads merged and a tree per thread.
+class FlameGraphWindow : public GlCanvas {
+ public:
+  FlameGraphWindow();
+  ~FlameGraphWindow() override;
+
+  // The view is shared with the top-down tree view, which adds the samples
+  // received during a capture to it, after which this window needs a redraw.
+  void SetTopDownView(std::shared_ptr<const TopDownView> top_down_view);
+  // Highlights the frames of the functions of which the name contains search,
+  // ignoring case. Everything is drawn normally if search is empty.
+  void SetSearch(const std::string& search);
+  void ZoomAll();
+
+  void Draw() override;
+  void DrawScreenSpace() override;
+  void MouseMoved(int a_X, int a_Y, bool a_Left, bool a_Right,
+                  bool a_Middle) override;
+  void LeftDown(int a_X, int a_Y) override;
+  void LeftUp() override;
+  void MouseWheelMoved(int a_X, int a_Y, int a_Delta, bool a_Ctrl) override;
+  void KeyPressed(unsigned int a_KeyCode, bool a_Ctrl, bool a_Shift,
+                  bool a_Alt) override;
+
+ private:
+  struct DrawnFrame {
+    float x;
+    float width;
+    int row;
+    const TopDownNode* node;
+  };
+
+  [[nodiscard]] const TopDownNode* GetTopNode() const;
+  void ZoomInto(const TopDownNode* node);
+  void DrawFrame(const TopDownNode& node, float x, float width, int row);
+  // x and width are in pixels, and can extend beyond the window.
+  void DrawSubtree(const TopDownNode& node, double x, double width, int row);
+  [[nodiscard]] const TopDownNode* GetFrameAt(int x, int y) const;
+  [[nodiscard]] std::string GetFrameLabel(const TopDownNode& node) const;
+  [[nodiscard]] Color GetFrameColor(const TopDownNode& node);
+  [[nodiscard]] bool IsSearchMatch(const TopDownFunction& function);
+  [[nodiscard]] int GetVisibleRowCount() const;
+
+  std::shared_ptr<const TopDownView> top_down_view_;
+  bool show_threads_ = false;
+
+  // The frame that spans the whole window when not zoomed in with the wheel.
+  // Its callers are drawn above it, as wide as the window.
+  const TopDownNode* zoom_node_ = nullptr;
+  // The part of zoom_node_ in the window, as a fraction of its width.
+  double visible_begin_ = 0.0;
+  double visible_width_ = 1.0;
+  int first_visible_row_ = 0;
+
+  bool is_dragging_ = false;
+  double drag_visible_begin_ = 0.0;
+
+  // The search in lower case, and whether it matches the function at each
+  // address, filled as the functions are drawn.
+  std::string search_;
+  absl::flat_hash_map<uint64_t, bool> search_matches_;
+
+  // The frames of the last draw, for hovering and clicking without a picking
+  // pass.
+  std::vector<DrawnFrame> drawn_frames_;
+  const TopDownNode* hovered_node_ = nullptr;
+};
+
+#endif  // ORBIT_GL_FLAME_GRAPH_WINDOW_H_
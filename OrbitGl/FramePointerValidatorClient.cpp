@@ -42,6 +42,7 @@ void FramePointerValidatorClient::AnalyzeModules(
       function_info->set_offset(FunctionUtils::Offset(*function));
       function_info->set_size(function->size());
     }
+    request.set_contains_all_functions(true);
     grpc::ClientContext context;
     std::chrono::time_point deadline =
         std::chrono::system_clock::now() + std::chrono::minutes(1);
@@ -0,0 +1,149 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "FrameTrack.h"
+
+#include "EventTracer.h"
+#include "GlCanvas.h"
+#include "Profiling.h"
+#include "TimeGraph.h"
+#include "absl/strings/str_format.h"
+
+using orbit_client_protos::TimerInfo;
+
+FrameTrack::FrameTrack(TimeGraph* time_graph) : TimerTrack(time_graph) {}
+
+void FrameTrack::OnFrameTimer(TimerInfo timer_info) {
+  ScopeLock lock(mutex_);
+  frame_index_.AddFrame(timer_info.start(), timer_info.end());
+  timer_info.set_depth(0);
+  OnTimer(std::move(timer_info));
+}
+
+void FrameTrack::AddFunctionCall(uint64_t start_ns, uint64_t end_ns) {
+  ScopeLock lock(mutex_);
+  frame_index_.AddFunctionCall(start_ns, end_ns);
+}
+
+std::vector<FrameTrack::FrameInfo> FrameTrack::GetLongestFrames(
+    size_t count) const {
+  std::vector<FrameInfo> frames;
+  {
+    ScopeLock lock(mutex_);
+    for (size_t index : frame_index_.GetLongestFrames(count)) {
+      frames.push_back(
+          FrameInfo{GetName(), index, frame_index_.GetFrames()[index], 0});
+    }
+  }
+  // Samples are counted from the event buffer, which has them all, whichever
+  // order they arrived in.
+  for (FrameInfo& frame_info : frames) {
+    frame_info.sample_count =
+        GEventTracer.GetEventBuffer().GetCallstackEventCount(
+            frame_info.frame.begin_ns, frame_info.frame.end_ns);
+  }
+  return frames;
+}
+
+std::string FrameTrack::GetTooltip() const {
+  return "Shows the frames between the ORBIT_FRAME_MARKERs with this name";
+}
+
+float FrameTrack::GetHeight() const {
+  TimeGraphLayout& layout = time_graph_->GetLayout();
+  return layout.GetTextBoxHeight() + layout.GetTrackBottomMargin();
+}
+
+const TextBox* FrameTrack::GetLeft(TextBox* text_box) const {
+  std::shared_ptr<TimerChain> timers = GetTimers(0);
+  if (timers) return timers->GetElementBefore(text_box);
+  return nullptr;
+}
+
+const TextBox* FrameTrack::GetRight(TextBox* text_box) const {
+  std::shared_ptr<TimerChain> timers = GetTimers(0);
+  if (timers) return timers->GetElementAfter(text_box);
+  return nullptr;
+}
+
+float FrameTrack::GetYFromDepth(uint32_t /*depth*/) const {
+  return m_Pos[1] - time_graph_->GetLayout().GetTextBoxHeight();
+}
+
+std::string FrameTrack::GetBoxTooltip(const TextBox* text_box) const {
+  if (text_box == nullptr) {
+    return "";
+  }
+  const TimerInfo& timer_info = text_box->GetTimerInfo();
+  int64_t index;
+  FrameIndex::Frame frame;
+  {
+    ScopeLock lock(mutex_);
+    index = frame_index_.FindFrame(timer_info.start());
+    if (index < 0) {
+      return "";
+    }
+    frame = frame_index_.GetFrames()[index];
+  }
+  uint32_t sample_count = GEventTracer.GetEventBuffer().GetCallstackEventCount(
+      frame.begin_ns, frame.end_ns);
+  return absl::StrFormat(
+      "<b>%s, frame %d</b>"
+      "<br/><br/>"
+      "<b>Time:</b> %s<br/>"
+      "<b>Time in instrumented functions:</b> %s (%u calls)<br/>"
+      "<b>Samples:</b> %u",
+      time_graph_->GetStringManager()
+          ->GetView(timer_info.user_data_key())
+          .value_or(""),
+      index, GetPrettyTime(TicksToDuration(frame.begin_ns, frame.end_ns)),
+      GetPrettyTime(absl::Nanoseconds(frame.function_time_ns)),
+      frame.function_call_count, sample_count);
+}
+
+Color FrameTrack::GetTimerColor(const TimerInfo& timer_info,
+                                bool is_selected) const {
+  const Color kSelectionColor(0, 128, 255, 255);
+  const Color kFrameColor(87, 166, 74, 255);
+  const Color kSlowFrameColor(200, 64, 64, 255);
+  if (is_selected) {
+    return kSelectionColor;
+  }
+
+  uint64_t average_duration_ns;
+  {
+    ScopeLock lock(mutex_);
+    average_duration_ns = frame_index_.GetAverageFrameDurationNs();
+  }
+  uint64_t duration_ns = timer_info.end() - timer_info.start();
+  return duration_ns > SLOW_FRAME_FACTOR * average_duration_ns
+             ? kSlowFrameColor
+             : kFrameColor;
+}
+
+void FrameTrack::SetTimesliceText(const TimerInfo& timer_info,
+                                  double elapsed_us, float min_x,
+                                  TextBox* text_box) {
+  TimeGraphLayout layout = time_graph_->GetLayout();
+  if (text_box->GetText().empty()) {
+    std::string time = GetPrettyTime(absl::Microseconds(elapsed_us));
+    text_box->SetElapsedTimeTextLength(time.length());
+    int64_t index;
+    {
+      ScopeLock lock(mutex_);
+      index = frame_index_.FindFrame(timer_info.start());
+    }
+    text_box->SetText(absl::StrFormat("Frame %d  %s", index, time));
+  }
+
+  const Color kTextWhite(255, 255, 255, 255);
+  const Vec2& box_pos = text_box->GetPos();
+  const Vec2& box_size = text_box->GetSize();
+  float pos_x = std::max(box_pos[0], min_x);
+  float max_size = box_pos[0] + box_size[0] - pos_x;
+  primitives_text_->AddTextTrailingCharsPrioritized(
+      text_box->GetText().c_str(), pos_x,
+      text_box->GetPosY() + layout.GetTextOffset(), GlCanvas::Z_VALUE_TEXT,
+      kTextWhite, text_box->GetElapsedTimeTextLength(), max_size);
+}
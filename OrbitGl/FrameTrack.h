@@ -0,0 +1,63 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_FRAME_TRACK_H_
+#define ORBIT_GL_FRAME_TRACK_H_
+
+#include <string>
+#include <vector>
+
+#include "FrameIndex.h"
+#include "TextBox.h"
+#include "TimerTrack.h"
+#include "capture_data.pb.h"
+
+// The frames between the ORBIT_FRAME_MARKERs of a name, one box per frame,
+// with the time spent in the instrumented functions during each frame kept up
+// to date in a FrameIndex as the timers arrive.
+class FrameTrack : public TimerTrack {
+ public:
+  // A frame of GetLongestFrames, with the number of samples taken during it.
+  struct FrameInfo {
+    std::string name;
+    size_t index;
+    FrameIndex::Frame frame;
+    uint32_t sample_count;
+  };
+
+  explicit FrameTrack(TimeGraph* time_graph);
+  ~FrameTrack() override = default;
+
+  void OnFrameTimer(orbit_client_protos::TimerInfo timer_info);
+  void AddFunctionCall(uint64_t start_ns, uint64_t end_ns);
+  // The count longest frames so far, longest first.
+  [[nodiscard]] std::vector<FrameInfo> GetLongestFrames(size_t count) const;
+
+  [[nodiscard]] std::string GetTooltip() const override;
+  [[nodiscard]] Type GetType() const override { return kFrameTrack; }
+  [[nodiscard]] float GetHeight() const override;
+
+  [[nodiscard]] const TextBox* GetLeft(TextBox* text_box) const override;
+  [[nodiscard]] const TextBox* GetRight(TextBox* text_box) const override;
+
+  [[nodiscard]] float GetYFromDepth(uint32_t depth) const override;
+  [[nodiscard]] std::string GetBoxTooltip(
+      const TextBox* text_box) const override;
+
+ protected:
+  [[nodiscard]] Color GetTimerColor(const orbit_client_protos::TimerInfo& timer,
+                                    bool is_selected) const override;
+  void SetTimesliceText(const orbit_client_protos::TimerInfo& timer,
+                        double elapsed_us, float min_x,
+                        TextBox* text_box) override;
+
+ private:
+  // Frames longer than this many times the average one stand out.
+  static constexpr double SLOW_FRAME_FACTOR = 1.5;
+
+  // Guarded by mutex_, as the timers.
+  FrameIndex frame_index_;
+};
+
+#endif  // ORBIT_GL_FRAME_TRACK_H_
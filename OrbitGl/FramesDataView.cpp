@@ -0,0 +1,200 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "FramesDataView.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include "Capture.h"
+#include "Log.h"
+#include "Profiling.h"
+#include "TimeGraph.h"
+#include "Utils.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+
+//-----------------------------------------------------------------------------
+FramesDataView::FramesDataView() : DataView(DataViewType::FRAMES) {
+  m_UpdatePeriodMs = 500;
+}
+
+//-----------------------------------------------------------------------------
+const std::vector<DataView::Column>& FramesDataView::GetColumns() {
+  static const std::vector<Column> columns = [] {
+    std::vector<Column> columns;
+    columns.resize(COLUMN_NUM);
+    columns[COLUMN_NAME] = {"Marker", .3f, SortingOrder::Ascending};
+    columns[COLUMN_INDEX] = {"Frame", .0f, SortingOrder::Ascending};
+    columns[COLUMN_START] = {"Start", .0f, SortingOrder::Ascending};
+    columns[COLUMN_DURATION] = {"Duration", .0f, SortingOrder::Descending};
+    columns[COLUMN_FUNCTION_TIME] = {"Function Time", .0f,
+                                     SortingOrder::Descending};
+    columns[COLUMN_FUNCTION_CALLS] = {"Function Calls", .0f,
+                                      SortingOrder::Descending};
+    columns[COLUMN_SAMPLES] = {"Samples", .0f, SortingOrder::Descending};
+    return columns;
+  }();
+  return columns;
+}
+
+//-----------------------------------------------------------------------------
+std::string FramesDataView::GetValue(int a_Row, int a_Column) {
+  const FrameTrack::FrameInfo& frame_info = GetFrame(a_Row);
+  const FrameIndex::Frame& frame = frame_info.frame;
+
+  switch (a_Column) {
+    case COLUMN_NAME:
+      return frame_info.name;
+    case COLUMN_INDEX:
+      return absl::StrFormat("%u", frame_info.index);
+    case COLUMN_START: {
+      TickType capture_min = GCurrentTimeGraph != nullptr
+                                 ? GCurrentTimeGraph->GetCaptureMin()
+                                 : frame.begin_ns;
+      return GetPrettyTime(TicksToDuration(capture_min, frame.begin_ns));
+    }
+    case COLUMN_DURATION:
+      return GetPrettyTime(absl::Nanoseconds(frame.GetDurationNs()));
+    case COLUMN_FUNCTION_TIME:
+      return GetPrettyTime(absl::Nanoseconds(frame.function_time_ns));
+    case COLUMN_FUNCTION_CALLS:
+      return absl::StrFormat("%u", frame.function_call_count);
+    case COLUMN_SAMPLES:
+      return absl::StrFormat("%u", frame_info.sample_count);
+    default:
+      return "";
+  }
+}
+
+//-----------------------------------------------------------------------------
+#define ORBIT_FRAME_SORT(Member)                                    \
+  [&](int a, int b) {                                               \
+    return OrbitUtils::Compare(frames[a].Member, frames[b].Member, \
+                               ascending);                          \
+  }
+
+//-----------------------------------------------------------------------------
+void FramesDataView::DoSort() {
+  bool ascending = m_SortingOrders[m_SortingColumn] == SortingOrder::Ascending;
+  std::function<bool(int a, int b)> sorter = nullptr;
+
+  const std::vector<FrameTrack::FrameInfo>& frames = frames_;
+
+  switch (m_SortingColumn) {
+    case COLUMN_NAME:
+      sorter = ORBIT_FRAME_SORT(name);
+      break;
+    case COLUMN_INDEX:
+      sorter = ORBIT_FRAME_SORT(index);
+      break;
+    case COLUMN_START:
+      sorter = ORBIT_FRAME_SORT(frame.begin_ns);
+      break;
+    case COLUMN_DURATION:
+      sorter = ORBIT_FRAME_SORT(frame.GetDurationNs());
+      break;
+    case COLUMN_FUNCTION_TIME:
+      sorter = ORBIT_FRAME_SORT(frame.function_time_ns);
+      break;
+    case COLUMN_FUNCTION_CALLS:
+      sorter = ORBIT_FRAME_SORT(frame.function_call_count);
+      break;
+    case COLUMN_SAMPLES:
+      sorter = ORBIT_FRAME_SORT(sample_count);
+      break;
+    default:
+      break;
+  }
+
+  if (sorter) {
+    std::stable_sort(indices_.begin(), indices_.end(), sorter);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void FramesDataView::DoFilter() {
+  std::vector<uint32_t> indices;
+
+  std::vector<std::string> tokens = absl::StrSplit(ToLower(m_Filter), ' ');
+
+  for (size_t i = 0; i < frames_.size(); ++i) {
+    std::string name = ToLower(frames_[i].name);
+
+    bool match = true;
+
+    for (std::string& filter_token : tokens) {
+      if (name.find(filter_token) == std::string::npos) {
+        match = false;
+        break;
+      }
+    }
+
+    if (match) {
+      indices.push_back(i);
+    }
+  }
+
+  indices_ = indices;
+
+  OnSort(m_SortingColumn, {});
+}
+
+//-----------------------------------------------------------------------------
+const std::string FramesDataView::MENU_ACTION_JUMP_TO_FRAME = "Jump to frame";
+
+//-----------------------------------------------------------------------------
+std::vector<std::string> FramesDataView::GetContextMenu(
+    int a_ClickedIndex, const std::vector<int>& a_SelectedIndices) {
+  std::vector<std::string> menu;
+  if (a_SelectedIndices.size() == 1) {
+    menu.emplace_back(MENU_ACTION_JUMP_TO_FRAME);
+  }
+  Append(menu, DataView::GetContextMenu(a_ClickedIndex, a_SelectedIndices));
+  return menu;
+}
+
+//-----------------------------------------------------------------------------
+void FramesDataView::OnContextMenu(const std::string& a_Action,
+                                   int a_MenuIndex,
+                                   const std::vector<int>& a_ItemIndices) {
+  if (a_Action == MENU_ACTION_JUMP_TO_FRAME) {
+    CHECK(a_ItemIndices.size() == 1);
+    const FrameIndex::Frame& frame = GetFrame(a_ItemIndices[0]).frame;
+    if (GCurrentTimeGraph != nullptr) {
+      GCurrentTimeGraph->Zoom(frame.begin_ns, frame.end_ns);
+    }
+  } else {
+    DataView::OnContextMenu(a_Action, a_MenuIndex, a_ItemIndices);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void FramesDataView::OnDataChanged() {
+  frames_.clear();
+  if (GCurrentTimeGraph != nullptr) {
+    frames_ = GCurrentTimeGraph->GetLongestFrames(MAX_FRAME_COUNT);
+  }
+
+  indices_.resize(frames_.size());
+  for (size_t i = 0; i < frames_.size(); ++i) {
+    indices_[i] = i;
+  }
+
+  DataView::OnDataChanged();
+}
+
+//-----------------------------------------------------------------------------
+void FramesDataView::OnTimer() {
+  if (Capture::IsCapturing()) {
+    OnDataChanged();
+  }
+}
+
+//-----------------------------------------------------------------------------
+const FrameTrack::FrameInfo& FramesDataView::GetFrame(
+    unsigned int a_Row) const {
+  return frames_[indices_[a_Row]];
+}
@@ -0,0 +1,56 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_FRAMES_DATA_VIEW_H_
+#define ORBIT_GL_FRAMES_DATA_VIEW_H_
+
+#include <string>
+#include <vector>
+
+#include "DataView.h"
+#include "FrameTrack.h"
+
+// The longest frames of the frame tracks of GCurrentTimeGraph, refreshed while
+// capturing, from which the time graph can be zoomed to one of them.
+class FramesDataView : public DataView {
+ public:
+  FramesDataView();
+
+  const std::vector<Column>& GetColumns() override;
+  int GetDefaultSortingColumn() override { return COLUMN_DURATION; }
+  std::vector<std::string> GetContextMenu(
+      int a_ClickedIndex, const std::vector<int>& a_SelectedIndices) override;
+  std::string GetValue(int a_Row, int a_Column) override;
+
+  void OnContextMenu(const std::string& a_Action, int a_MenuIndex,
+                     const std::vector<int>& a_ItemIndices) override;
+  void OnDataChanged() override;
+  void OnTimer() override;
+
+ protected:
+  void DoSort() override;
+  void DoFilter() override;
+  const FrameTrack::FrameInfo& GetFrame(unsigned int a_Row) const;
+
+ private:
+  // The number of frames shown, the longest ones.
+  static constexpr size_t MAX_FRAME_COUNT = 100;
+
+  std::vector<FrameTrack::FrameInfo> frames_;
+
+  enum ColumnIndex {
+    COLUMN_NAME,
+    COLUMN_INDEX,
+    COLUMN_START,
+    COLUMN_DURATION,
+    COLUMN_FUNCTION_TIME,
+    COLUMN_FUNCTION_CALLS,
+    COLUMN_SAMPLES,
+    COLUMN_NUM
+  };
+
+  static const std::string MENU_ACTION_JUMP_TO_FRAME;
+};
+
+#endif  // ORBIT_GL_FRAMES_DATA_VIEW_H_
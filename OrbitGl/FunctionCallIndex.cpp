@@ -0,0 +1,136 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "FunctionCallIndex.h"
+
+#include <algorithm>
+
+void FunctionCallIndex::Add(const TextBox* text_box) {
+  const orbit_client_protos::TimerInfo& timer_info = text_box->GetTimerInfo();
+  Calls& calls = calls_by_function_[timer_info.function_address()];
+  const bool is_in_order = calls.sorted_count == calls.calls.size() &&
+                           (calls.calls.empty() ||
+                            calls.calls.back().end <= timer_info.end());
+  calls.calls.push_back({timer_info.end(), text_box});
+  if (is_in_order) {
+    calls.sorted_count = calls.calls.size();
+  }
+}
+
+void FunctionCallIndex::Clear() { calls_by_function_.clear(); }
+
+void FunctionCallIndex::RemoveCallsEndingBefore(TickType timestamp) {
+  auto ends_before = [timestamp](const Call& call) {
+    return call.end < timestamp;
+  };
+  for (auto& [unused_function_address, calls] : calls_by_function_) {
+    // Those of the sorted calls are the first ones, and the calls left keep
+    // their order.
+    auto sorted_end = calls.calls.begin() + calls.sorted_count;
+    const size_t num_sorted_removed =
+        std::partition_point(calls.calls.begin(), sorted_end, ends_before) -
+        calls.calls.begin();
+    calls.calls.erase(
+        std::remove_if(calls.calls.begin(), calls.calls.end(), ends_before),
+        calls.calls.end());
+    calls.sorted_count -= num_sorted_removed;
+  }
+}
+
+const std::vector<FunctionCallIndex::Call>* FunctionCallIndex::GetSortedCalls(
+    uint64_t function_address) const {
+  auto calls_it = calls_by_function_.find(function_address);
+  if (calls_it == calls_by_function_.end()) {
+    return nullptr;
+  }
+  Calls& calls = calls_it->second;
+  if (calls.sorted_count < calls.calls.size()) {
+    auto by_end = [](const Call& a, const Call& b) { return a.end < b.end; };
+    auto unsorted_begin = calls.calls.begin() + calls.sorted_count;
+    std::stable_sort(unsorted_begin, calls.calls.end(), by_end);
+    std::inplace_merge(calls.calls.begin(), unsorted_begin, calls.calls.end(),
+                       by_end);
+    calls.sorted_count = calls.calls.size();
+  }
+  return &calls.calls;
+}
+
+const TextBox* FunctionCallIndex::FindPrevious(
+    uint64_t function_address, TickType timestamp,
+    std::optional<int32_t> thread_id) const {
+  const std::vector<Call>* calls = GetSortedCalls(function_address);
+  if (calls == nullptr) {
+    return nullptr;
+  }
+  // The first call that doesn't end before timestamp.
+  auto call_it = std::lower_bound(calls->begin(), calls->end(), timestamp,
+                                  [](const Call& call, TickType timestamp) {
+                                    return call.end < timestamp;
+                                  });
+  while (call_it != calls->begin()) {
+    --call_it;
+    if (!thread_id.has_value() ||
+        call_it->text_box->GetTimerInfo().thread_id() == thread_id.value()) {
+      return call_it->text_box;
+    }
+  }
+  return nullptr;
+}
+
+const TextBox* FunctionCallIndex::FindNext(
+    uint64_t function_address, TickType timestamp,
+    std::optional<int32_t> thread_id) const {
+  const std::vector<Call>* calls = GetSortedCalls(function_address);
+  if (calls == nullptr) {
+    return nullptr;
+  }
+  // The first call that ends after timestamp.
+  auto call_it = std::upper_bound(calls->begin(), calls->end(), timestamp,
+                                  [](TickType timestamp, const Call& call) {
+                                    return timestamp < call.end;
+                                  });
+  for (; call_it != calls->end(); ++call_it) {
+    if (!thread_id.has_value() ||
+        call_it->text_box->GetTimerInfo().thread_id() == thread_id.value()) {
+      return call_it->text_box;
+    }
+  }
+  return nullptr;
+}
+
+const TextBox* FunctionCallIndex::FindPreviousOfAny(
+    const std::vector<uint64_t>& function_addresses,
+    TickType timestamp) const {
+  const TextBox* previous = nullptr;
+  for (uint64_t function_address : function_addresses) {
+    const TextBox* text_box = FindPrevious(function_address, timestamp);
+    if (text_box != nullptr &&
+        (previous == nullptr ||
+         text_box->GetTimerInfo().end() > previous->GetTimerInfo().end())) {
+      previous = text_box;
+    }
+  }
+  return previous;
+}
+
+const TextBox* FunctionCallIndex::FindNextOfAny(
+    const std::vector<uint64_t>& function_addresses,
+    TickType timestamp) const {
+  const TextBox* next = nullptr;
+  for (uint64_t function_address : function_addresses) {
+    const TextBox* text_box = FindNext(function_address, timestamp);
+    if (text_box != nullptr &&
+        (next == nullptr ||
+         text_box->GetTimerInfo().end() < next->GetTimerInfo().end())) {
+      next = text_box;
+    }
+  }
+  return next;
+}
+
+size_t FunctionCallIndex::GetCallCount(uint64_t function_address) const {
+  auto calls_it = calls_by_function_.find(function_address);
+  return calls_it != calls_by_function_.end() ? calls_it->second.calls.size()
+                                              : 0;
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_FUNCTION_CALL_INDEX_H_
+#define ORBIT_GL_FUNCTION_CALL_INDEX_H_
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "Profiling.h"
+#include "TextBox.h"
+#include "absl/container/flat_hash_map.h"
+
+// The calls of each function, sorted by end timestamp, so that the call of a
+// function before or after a timestamp is found by binary search instead of by
+// visiting all timers of all threads.
+//
+// Calls are added as the timers are added to their track, of which the text
+// boxes never move. Timers mostly arrive in order of end timestamp, so the
+// calls are appended, and the calls appended out of order are only sorted, and
+// merged with the others, when the function is searched next. This is why the
+// searches, although const, can modify the index: like the time graph, the
+// index is only used from the main thread.
+class FunctionCallIndex {
+ public:
+  void Add(const TextBox* text_box);
+  void Clear();
+  // Forgets the calls that end before timestamp, e.g., before their text
+  // boxes are freed.
+  void RemoveCallsEndingBefore(TickType timestamp);
+
+  // The call of the function with the latest end before timestamp, or nullptr
+  // if there is none. Only calls on thread_id are considered if it is set.
+  [[nodiscard]] const TextBox* FindPrevious(
+      uint64_t function_address, TickType timestamp,
+      std::optional<int32_t> thread_id = std::nullopt) const;
+  // The call of the function with the earliest end after timestamp, or nullptr
+  // if there is none. Only calls on thread_id are considered if it is set.
+  [[nodiscard]] const TextBox* FindNext(
+      uint64_t function_address, TickType timestamp,
+      std::optional<int32_t> thread_id = std::nullopt) const;
+
+  // The same for the calls of any of the functions, e.g., of all the
+  // functions matching a search, by one binary search per function.
+  [[nodiscard]] const TextBox* FindPreviousOfAny(
+      const std::vector<uint64_t>& function_addresses,
+      TickType timestamp) const;
+  [[nodiscard]] const TextBox* FindNextOfAny(
+      const std::vector<uint64_t>& function_addresses,
+      TickType timestamp) const;
+  [[nodiscard]] size_t GetCallCount(uint64_t function_address) const;
+
+ private:
+  struct Call {
+    // Copied from the timer, so that the binary search doesn't touch the text
+    // boxes.
+    TickType end;
+    const TextBox* text_box;
+  };
+  struct Calls {
+    std::vector<Call> calls;
+    // calls[0, sorted_count) is sorted by end.
+    size_t sorted_count = 0;
+  };
+
+  // The calls of the function sorted by end, or nullptr if it has no calls.
+  [[nodiscard]] const std::vector<Call>* GetSortedCalls(
+      uint64_t function_address) const;
+
+  mutable absl::flat_hash_map<uint64_t, Calls> calls_by_function_;
+};
+
+#endif  // ORBIT_GL_FUNCTION_CALL_INDEX_H_
@@ -4,20 +4,59 @@
 
 #include "FunctionsDataView.h"
 
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
 #include "App.h"
 #include "Capture.h"
 #include "Core.h"
 #include "FunctionUtils.h"
 #include "Log.h"
+#include "OrbitBase/ParallelSort.h"
 #include "OrbitProcess.h"
 #include "Pdb.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/flags/flag.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 
 using orbit_client_protos::FunctionInfo;
 
+namespace {
+// Returns the rank of each of count values among the distinct values, given
+// less(a, b) that compares the values with indices a and b.
+template <typename Less>
+std::vector<uint32_t> ComputeRanks(size_t count, const Less& less,
+                                   ThreadPool* thread_pool) {
+  std::vector<uint32_t> order(count);
+  std::iota(order.begin(), order.end(), 0);
+  ParallelStableSort(thread_pool, order.begin(), order.end(), less);
+  std::vector<uint32_t> ranks(count);
+  uint32_t rank = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (i > 0 && less(order[i - 1], order[i])) {
+      ++rank;
+    }
+    ranks[order[i]] = rank;
+  }
+  return ranks;
+}
+}  // namespace
+
 //-----------------------------------------------------------------------------
-FunctionsDataView::FunctionsDataView() : DataView(DataViewType::FUNCTIONS) {}
+FunctionsDataView::FunctionsDataView()
+    : DataView(DataViewType::FUNCTIONS),
+      filter_thread_pool_(ThreadPool::CreateWorkStealing(
+          std::max(std::thread::hardware_concurrency(), 2u) - 1)) {}
+
+//-----------------------------------------------------------------------------
+FunctionsDataView::~FunctionsDataView() {
+  // The jobs use the filter thread pool.
+  CancelAndWaitForJobs();
+  filter_thread_pool_->ShutdownAndWait();
+}
 
 //-----------------------------------------------------------------------------
 const std::vector<DataView::Column>& FunctionsDataView::GetColumns() {
@@ -68,63 +107,98 @@ std::string FunctionsDataView::GetValue(int a_Row, int a_Column) {
 }
 
 //-----------------------------------------------------------------------------
-#define ORBIT_FUNC_SORT(Member)                                            \
-  [&](int a, int b) {                                                      \
-    return OrbitUtils::Compare(functions[a]->Member, functions[b]->Member, \
-                               ascending);                                 \
-  }
+DataView::NumericValue FunctionsDataView::GetNumericValue(int row,
+                                                          int column) {
+  ScopeLock lock(Capture::GTargetProcess->GetDataMutex());
 
-//-----------------------------------------------------------------------------
-#define ORBIT_CUSTOM_FUNC_SORT(Func)                                     \
-  [&](int a, int b) {                                                    \
-    return OrbitUtils::Compare(Func(*functions[a]), Func(*functions[b]), \
-                               ascending);                               \
+  if (row >= static_cast<int>(GetNumElements())) {
+    return std::monostate{};
   }
 
-//-----------------------------------------------------------------------------
-void FunctionsDataView::DoSort() {
-  // TODO(antonrohr) This sorting function can take a lot of time when a large
-  // number of functions is used (several seconds). This function is currently
-  // executed on the main thread and therefore freezes the UI and interrupts the
-  // ssh watchdog signals that are sent to the service. Therefore this should
-  // not be called on the main thread and as soon as this is done the watchdog
-  // timeout should be rolled back from 25 seconds to 10 seconds in
-  // OrbitService.h
-  bool ascending = m_SortingOrders[m_SortingColumn] == SortingOrder::Ascending;
-  std::function<bool(int a, int b)> sorter = nullptr;
+  const FunctionInfo& function = GetFunction(row);
 
-  const std::vector<std::shared_ptr<FunctionInfo>>& functions =
-      Capture::GTargetProcess->GetFunctions();
-
-  switch (m_SortingColumn) {
-    case COLUMN_SELECTED:
-      sorter = ORBIT_CUSTOM_FUNC_SORT(FunctionUtils::IsSelected);
-      break;
-    case COLUMN_NAME:
-      sorter = ORBIT_CUSTOM_FUNC_SORT(FunctionUtils::GetDisplayName);
-      break;
+  switch (column) {
     case COLUMN_SIZE:
-      sorter = ORBIT_FUNC_SORT(size());
-      break;
-    case COLUMN_FILE:
-      sorter = ORBIT_FUNC_SORT(file());
-      break;
+      return function.size();
     case COLUMN_LINE:
-      sorter = ORBIT_FUNC_SORT(line());
-      break;
-    case COLUMN_MODULE:
-      sorter = ORBIT_CUSTOM_FUNC_SORT(FunctionUtils::GetLoadedModuleName);
-      break;
+      return uint64_t{function.line()};
     case COLUMN_ADDRESS:
-      sorter = ORBIT_FUNC_SORT(address());
-      break;
+      return FunctionUtils::GetAbsoluteAddress(function);
     default:
-      break;
+      return std::monostate{};
   }
+}
 
-  if (sorter) {
-    std::stable_sort(indices_.begin(), indices_.end(), sorter);
+//-----------------------------------------------------------------------------
+void FunctionsDataView::DoSort() {
+  // Sorting can take seconds with many functions, hence it runs in the
+  // background through CreateSortJob, except when there is no main thread to
+  // return to.
+  indices_ = CreateSortJob()(std::move(indices_), [] { return false; }).value();
+}
+
+//-----------------------------------------------------------------------------
+DataView::IndicesJob FunctionsDataView::CreateSortJob() {
+  std::vector<bool> is_selected;
+  {
+    ScopeLock lock(Capture::GTargetProcess->GetDataMutex());
+    const std::vector<std::shared_ptr<FunctionInfo>>& functions =
+        Capture::GTargetProcess->GetFunctions();
+    if (sort_keys_ == nullptr || sort_keys_->sizes.size() != functions.size()) {
+      UpdateSortKeys();
+    }
+    // Whether functions are hooked changes without the data changing, and
+    // while the job runs, hence it gets a copy.
+    if (m_SortingColumn == COLUMN_SELECTED) {
+      is_selected.reserve(functions.size());
+      for (const std::shared_ptr<FunctionInfo>& function : functions) {
+        is_selected.push_back(FunctionUtils::IsSelected(*function));
+      }
+    }
   }
+  const bool ascending =
+      m_SortingOrders[m_SortingColumn] == SortingOrder::Ascending;
+
+  return [sort_keys = sort_keys_, is_selected = std::move(is_selected),
+          column = m_SortingColumn, ascending,
+          thread_pool = filter_thread_pool_.get()](
+             std::vector<uint32_t> indices,
+             const std::function<bool()>& /*is_canceled*/)
+             -> std::optional<std::vector<uint32_t>> {
+    auto sort_by = [&](const auto& keys) {
+      ParallelStableSort(thread_pool, indices.begin(), indices.end(),
+                         [&](uint32_t a, uint32_t b) {
+                           return OrbitUtils::Compare(keys[a], keys[b],
+                                                      ascending);
+                         });
+    };
+    switch (column) {
+      case COLUMN_SELECTED:
+        sort_by(is_selected);
+        break;
+      case COLUMN_NAME:
+        sort_by(sort_keys->name_ranks);
+        break;
+      case COLUMN_SIZE:
+        sort_by(sort_keys->sizes);
+        break;
+      case COLUMN_FILE:
+        sort_by(sort_keys->file_ranks);
+        break;
+      case COLUMN_LINE:
+        sort_by(sort_keys->lines);
+        break;
+      case COLUMN_MODULE:
+        sort_by(sort_keys->module_ranks);
+        break;
+      case COLUMN_ADDRESS:
+        sort_by(sort_keys->addresses);
+        break;
+      default:
+        break;
+    }
+    return indices;
+  };
 }
 
 //-----------------------------------------------------------------------------
@@ -160,15 +234,19 @@ void FunctionsDataView::OnContextMenu(const std::string& a_Action,
     for (int i : a_ItemIndices) {
       FunctionUtils::Select(&GetFunction(i));
     }
+    GOrbitApp->UpdateInstrumentedFunctions();
   } else if (a_Action == MENU_ACTION_UNSELECT) {
     for (int i : a_ItemIndices) {
       FunctionUtils::UnSelect(&GetFunction(i));
     }
+    GOrbitApp->UpdateInstrumentedFunctions();
   } else if (a_Action == MENU_ACTION_DISASSEMBLY) {
     int32_t pid = Capture::GTargetProcess->GetID();
+    std::vector<FunctionInfo> functions;
     for (int i : a_ItemIndices) {
-      GOrbitApp->Disassemble(pid, GetFunction(i));
+      functions.push_back(GetFunction(i));
     }
+    GOrbitApp->Disassemble(pid, std::move(functions));
   } else {
     DataView::OnContextMenu(a_Action, a_MenuIndex, a_ItemIndices);
   }
@@ -176,44 +254,63 @@ void FunctionsDataView::OnContextMenu(const std::string& a_Action,
 
 //-----------------------------------------------------------------------------
 void FunctionsDataView::DoFilter() {
-  // TODO(antonrohr) This filter function can take a lot of time when a large
-  // number of functions is used (several seconds). This function is currently
-  // executed on the main thread and therefore freezes the UI and interrupts the
-  // ssh watchdog signals that are sent to the service. Therefore this should
-  // not be called on the main thread and as soon as this is done the watchdog
-  // timeout should be rolled back from 25 seconds to 10 seconds in
-  // OrbitService.h
+  // TODO(antonrohr) On Windows, this filter function can take a lot of time
+  // when a large number of functions is used (several seconds). It is executed
+  // on the main thread and therefore freezes the UI. Elsewhere, filtering runs
+  // in the background through CreateFilterJob, except when there is no main
+  // thread to return to.
   m_FilterTokens = absl::StrSplit(ToLower(m_Filter), ' ');
 
 #ifdef WIN32
   ParallelFilter();
 #else
-  // TODO: port parallel filtering
-  std::vector<uint32_t> indices;
-  const std::vector<std::shared_ptr<FunctionInfo>>& functions =
-      Capture::GTargetProcess->GetFunctions();
-  for (size_t i = 0; i < functions.size(); ++i) {
-    auto& function = functions[i];
-    std::string name = ToLower(FunctionUtils::GetDisplayName(*function)) +
-                       FunctionUtils::GetLoadedModuleName(*function);
+  indices_ = CreateFilterJob()({}, [] { return false; }).value();
 
-    bool match = true;
-
-    for (std::string& filterToken : m_FilterTokens) {
-      if (name.find(filterToken) == std::string::npos) {
-        match = false;
-        break;
-      }
-    }
+  OnSort(m_SortingColumn, {});
+#endif
+}
 
-    if (match) {
-      indices.push_back(i);
-    }
+//-----------------------------------------------------------------------------
+DataView::IndicesJob FunctionsDataView::CreateFilterJob() {
+#ifdef WIN32
+  return nullptr;
+#else
+  if (filter_index_ == nullptr ||
+      filter_index_->search_index.size() !=
+          Capture::GTargetProcess->GetFunctions().size()) {
+    UpdateFilterIndex();
   }
-
-  indices_ = indices;
-
-  OnSort(m_SortingColumn, {});
+  std::vector<std::string> tokens = absl::StrSplit(ToLower(m_Filter), ' ');
+
+  return [filter_index = filter_index_, tokens = std::move(tokens),
+          thread_pool = filter_thread_pool_.get()](
+             std::vector<uint32_t> /*indices*/,
+             const std::function<bool()>& /*is_canceled*/)
+             -> std::optional<std::vector<uint32_t>> {
+    // While the filter is being typed, each filter only keeps some of the
+    // functions that matched the previous one, if it contains all of its
+    // tokens.
+    const std::vector<std::string>& filtered_tokens =
+        filter_index->filtered_tokens;
+    const bool is_refinement =
+        filter_index->filtered_indices.has_value() &&
+        std::all_of(filtered_tokens.begin(), filtered_tokens.end(),
+                    [&](const std::string& filtered_token) {
+                      return std::any_of(
+                          tokens.begin(), tokens.end(),
+                          [&](const std::string& token) {
+                            return absl::StrContains(token, filtered_token);
+                          });
+                    });
+    std::vector<uint32_t> indices =
+        is_refinement ? filter_index->search_index.FindAmong(
+                            tokens, filter_index->filtered_indices.value(),
+                            thread_pool)
+                      : filter_index->search_index.Find(tokens, thread_pool);
+    filter_index->filtered_tokens = tokens;
+    filter_index->filtered_indices = indices;
+    return indices;
+  };
 #endif
 }
 
@@ -270,9 +367,87 @@ void FunctionsDataView::OnDataChanged() {
     indices_[i] = i;
   }
 
+  UpdateSortKeys();
+#ifndef WIN32
+  UpdateFilterIndex();
+#endif
+
   DataView::OnDataChanged();
 }
 
+//-----------------------------------------------------------------------------
+void FunctionsDataView::UpdateFilterIndex() {
+  // The names are only lowered and indexed when the functions change, e.g.,
+  // when symbols are loaded, rather than on each change of the filter.
+  const std::vector<std::shared_ptr<FunctionInfo>>& functions =
+      Capture::GTargetProcess->GetFunctions();
+  std::vector<std::string> names;
+  names.reserve(functions.size());
+  for (const std::shared_ptr<FunctionInfo>& function : functions) {
+    names.push_back(
+        absl::StrCat(FunctionUtils::GetDisplayName(*function), " ",
+                     FunctionUtils::GetLoadedModuleName(*function)));
+  }
+  // A new index, as the filter that is running can still be using the old one.
+  filter_index_ = std::make_shared<FilterIndex>();
+  filter_index_->search_index = SubstringSearchIndex(names);
+}
+
+//-----------------------------------------------------------------------------
+void FunctionsDataView::UpdateSortKeys() {
+  const std::vector<std::shared_ptr<FunctionInfo>>& functions =
+      Capture::GTargetProcess->GetFunctions();
+  auto sort_keys = std::make_shared<SortKeys>();
+  sort_keys->sizes.reserve(functions.size());
+  sort_keys->lines.reserve(functions.size());
+  sort_keys->addresses.reserve(functions.size());
+  for (const std::shared_ptr<FunctionInfo>& function : functions) {
+    sort_keys->sizes.push_back(function->size());
+    sort_keys->lines.push_back(function->line());
+    sort_keys->addresses.push_back(function->address());
+  }
+
+  sort_keys->name_ranks = ComputeRanks(
+      functions.size(),
+      [&](uint32_t a, uint32_t b) {
+        return FunctionUtils::GetDisplayName(*functions[a]) <
+               FunctionUtils::GetDisplayName(*functions[b]);
+      },
+      filter_thread_pool_.get());
+  sort_keys->file_ranks = ComputeRanks(
+      functions.size(),
+      [&](uint32_t a, uint32_t b) {
+        return functions[a]->file() < functions[b]->file();
+      },
+      filter_thread_pool_.get());
+
+  // Functions share few modules, hence the name of each module is only
+  // computed once.
+  absl::flat_hash_map<std::string, uint32_t> module_path_indices;
+  std::vector<uint32_t> function_module_indices;
+  function_module_indices.reserve(functions.size());
+  std::vector<std::string> module_names;
+  for (const std::shared_ptr<FunctionInfo>& function : functions) {
+    auto [it, inserted] = module_path_indices.try_emplace(
+        function->loaded_module_path(), module_names.size());
+    if (inserted) {
+      module_names.push_back(FunctionUtils::GetLoadedModuleName(*function));
+    }
+    function_module_indices.push_back(it->second);
+  }
+  const std::vector<uint32_t> module_name_ranks = ComputeRanks(
+      module_names.size(),
+      [&](uint32_t a, uint32_t b) { return module_names[a] < module_names[b]; },
+      filter_thread_pool_.get());
+  sort_keys->module_ranks.reserve(functions.size());
+  for (uint32_t module_index : function_module_indices) {
+    sort_keys->module_ranks.push_back(module_name_ranks[module_index]);
+  }
+
+  // A new instance, as a sort that is running can still be using the old one.
+  sort_keys_ = std::move(sort_keys);
+}
+
 //-----------------------------------------------------------------------------
 FunctionInfo& FunctionsDataView::GetFunction(int a_Row) const {
   ScopeLock lock(Capture::GTargetProcess->GetDataMutex());
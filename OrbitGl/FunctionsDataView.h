@@ -5,18 +5,27 @@
 #ifndef ORBIT_GL_FUNCTIONS_DATA_VIEW_H_
 #define ORBIT_GL_FUNCTIONS_DATA_VIEW_H_
 
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
 #include "DataView.h"
+#include "OrbitBase/ThreadPool.h"
+#include "SubstringSearchIndex.h"
 #include "capture_data.pb.h"
 
 class FunctionsDataView : public DataView {
  public:
   FunctionsDataView();
+  ~FunctionsDataView() override;
 
   const std::vector<Column>& GetColumns() override;
   int GetDefaultSortingColumn() override { return COLUMN_ADDRESS; }
   std::vector<std::string> GetContextMenu(
       int a_ClickedIndex, const std::vector<int>& a_SelectedIndices) override;
   std::string GetValue(int a_Row, int a_Column) override;
+  NumericValue GetNumericValue(int row, int column) override;
 
   void OnContextMenu(const std::string& a_Action, int a_MenuIndex,
                      const std::vector<int>& a_ItemIndices) override;
@@ -25,11 +34,40 @@ class FunctionsDataView : public DataView {
  protected:
   void DoSort() override;
   void DoFilter() override;
+  IndicesJob CreateSortJob() override;
+  IndicesJob CreateFilterJob() override;
   void ParallelFilter();
+  void UpdateFilterIndex();
+  void UpdateSortKeys();
   orbit_client_protos::FunctionInfo& GetFunction(int a_Row) const;
 
   std::vector<std::string> m_FilterTokens;
 
+  struct FilterIndex {
+    // The names and modules of the functions of the process, in lower case.
+    SubstringSearchIndex search_index;
+    // The tokens of the last filter and the functions that matched it, which
+    // the next filter starts from if it only adds to these tokens. Only one
+    // filter runs at a time.
+    std::vector<std::string> filtered_tokens;
+    std::optional<std::vector<uint32_t>> filtered_indices;
+  };
+  std::shared_ptr<FilterIndex> filter_index_;
+
+  // The value of each column for each function, as an integer, so that
+  // sorting only compares integers. Columns of strings hold the rank of the
+  // value of the function among the distinct values of all functions.
+  struct SortKeys {
+    std::vector<uint32_t> name_ranks;
+    std::vector<uint64_t> sizes;
+    std::vector<uint32_t> file_ranks;
+    std::vector<uint32_t> lines;
+    std::vector<uint32_t> module_ranks;
+    std::vector<uint64_t> addresses;
+  };
+  std::shared_ptr<const SortKeys> sort_keys_;
+  std::unique_ptr<ThreadPool> filter_thread_pool_;
+
   enum ColumnIndex {
     COLUMN_SELECTED,
     COLUMN_NAME,
@@ -4,6 +4,7 @@
 
 #include "GlCanvas.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -473,6 +474,9 @@ void GlCanvas::Render(int a_Width, int a_Height) {
   glFlush();
 
   timer.Stop();
+  render_start_ticks_[render_count_ % kRenderTimeCount] = timer.m_Start;
+  render_times_ms_[render_count_ % kRenderTimeCount] = timer.ElapsedMillis();
+  ++render_count_;
 
   m_ImguiActive = ImGui::IsAnyItemActive();
 
@@ -482,6 +486,25 @@ void GlCanvas::Render(int a_Width, int a_Height) {
   m_DoubleClicking = false;
 }
 
+//-----------------------------------------------------------------------------
+GlCanvas::RenderStats GlCanvas::GetRenderStats() const {
+  RenderStats stats;
+  const size_t count = std::min(render_count_, kRenderTimeCount);
+  if (count == 0) {
+    return stats;
+  }
+  const TickType now = OrbitTicks();
+  for (size_t i = 0; i < count; ++i) {
+    stats.average_render_ms += render_times_ms_[i];
+    stats.max_render_ms = std::max(stats.max_render_ms, render_times_ms_[i]);
+    if (TicksToDuration(render_start_ticks_[i], now) <= absl::Seconds(1)) {
+      ++stats.renders_in_last_second;
+    }
+  }
+  stats.average_render_ms /= count;
+  return stats;
+}
+
 //-----------------------------------------------------------------------------
 void GlCanvas::Resize(int a_Width, int a_Height) {
   m_Width = a_Width;
@@ -5,6 +5,10 @@
 #ifndef ORBIT_GL_GL_CANVAS_H_
 #define ORBIT_GL_GL_CANVAS_H_
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
 #include "GlPanel.h"
 #include "GlUtils.h"
 #include "ImGuiOrbit.h"
@@ -103,6 +107,14 @@ class GlCanvas : public GlPanel {
 
   PickingManager& GetPickingManager() { return m_PickingManager; }
 
+  // Over the last kRenderTimeCount renders.
+  struct RenderStats {
+    double average_render_ms = 0;
+    double max_render_ms = 0;
+    uint32_t renders_in_last_second = 0;
+  };
+  [[nodiscard]] RenderStats GetRenderStats() const;
+
   static float Z_VALUE_UI;
   static float Z_VALUE_TEXT;
   static float Z_VALUE_TEXT_UI;
@@ -165,6 +177,12 @@ class GlCanvas : public GlPanel {
 
   // Batcher to draw elements in the UI.
   Batcher ui_batcher_;
+
+ private:
+  static constexpr size_t kRenderTimeCount = 64;
+  std::array<TickType, kRenderTimeCount> render_start_ticks_{};
+  std::array<double, kRenderTimeCount> render_times_ms_{};
+  size_t render_count_ = 0;
 };
 
 #endif  // ORBIT_GL_GL_CANVAS_H_
@@ -5,6 +5,7 @@
 #include "GlPanel.h"
 
 #include "CaptureWindow.h"
+#include "FlameGraphWindow.h"
 #include "GlCanvas.h"
 #include "HomeWindow.h"
 
@@ -19,6 +20,9 @@ GlPanel* GlPanel::Create(Type a_Type) {
     case DEBUG:
       panel = new HomeWindow();
       break;
+    case FLAME_GRAPH:
+      panel = new FlameGraphWindow();
+      break;
   }
 
   panel->m_Type = a_Type;
@@ -11,7 +11,7 @@ class GlPanel {
   GlPanel();
   virtual ~GlPanel();
 
-  enum Type { CAPTURE, DEBUG };
+  enum Type { CAPTURE, DEBUG, FLAME_GRAPH };
 
   static GlPanel* Create(Type a_Type);
 
@@ -4,6 +4,8 @@
 
 #include "GpuTrack.h"
 
+#include <algorithm>
+
 #include "Capture.h"
 #include "GlCanvas.h"
 #include "Profiling.h"
@@ -42,7 +44,6 @@ GpuTrack::GpuTrack(TimeGraph* time_graph,
                    std::shared_ptr<StringManager> string_manager,
                    uint64_t timeline_hash)
     : TimerTrack(time_graph) {
-  text_renderer_ = time_graph->GetTextRenderer();
   timeline_hash_ = timeline_hash;
 
   num_timers_ = 0;
@@ -57,6 +58,21 @@ GpuTrack::GpuTrack(TimeGraph* time_graph,
       TriangleToggle::InitialStateUpdate::kReplaceInitialState);
 }
 
+const TextBox* GpuTrack::OnGpuTimer(TimerInfo timer_info) {
+  if (timer_info.type() == TimerInfo::kGpuCommandBuffer) {
+    // Already moved if the timer was saved from a GpuTrack.
+    if (timer_info.depth() < kCommandBufferFirstDepth) {
+      timer_info.set_depth(kCommandBufferFirstDepth + timer_info.depth());
+    }
+    command_buffer_depth_ =
+        std::max(command_buffer_depth_,
+                 timer_info.depth() - kCommandBufferFirstDepth + 1);
+  } else {
+    job_depth_ = std::max(job_depth_, timer_info.depth() + 1);
+  }
+  return OnTimer(std::move(timer_info));
+}
+
 bool GpuTrack::IsTimerActive(const TimerInfo& timer_info) const {
   bool is_same_tid_as_selected = timer_info.thread_id() == Capture::GSelectedThreadId;
   // We do not properly track the PID for GPU jobs and we still want to show
@@ -84,8 +100,17 @@ Color GpuTrack::GetTimerColor(const TimerInfo& timer_info, bool is_selected) con
   // We disambiguate the different types of GPU activity based on the
   // string that is displayed on their timeslice.
   float coeff = 1.0f;
-  std::string gpu_stage =
-      string_manager_->Get(timer_info.user_data_key()).value_or("");
+  if (timer_info.type() == TimerInfo::kGpuCommandBuffer) {
+    // Lighter with each nested label region.
+    const float lightness =
+        std::min(0.15f * (timer_info.depth() - kCommandBufferFirstDepth), 0.6f);
+    for (size_t i = 0; i < 3; ++i) {
+      color[i] = static_cast<uint8_t>(color[i] + lightness * (255 - color[i]));
+    }
+    return color;
+  }
+  std::string_view gpu_stage =
+      string_manager_->GetView(timer_info.user_data_key()).value_or("");
   if (gpu_stage == kSwQueueString) {
     coeff = 0.5f;
   } else if (gpu_stage == kHwQueueString) {
@@ -109,6 +134,10 @@ Color GpuTrack::GetTimerColor(const TimerInfo& timer_info, bool is_selected) con
 //-----------------------------------------------------------------------------
 float GpuTrack::GetYFromDepth(uint32_t depth) const {
   float adjusted_depth = static_cast<float>(depth);
+  if (depth >= kCommandBufferFirstDepth) {
+    adjusted_depth = static_cast<float>(job_depth_ + depth -
+                                        kCommandBufferFirstDepth);
+  }
   if (collapse_toggle_->IsCollapsed()) {
     adjusted_depth = 0.f;
   }
@@ -119,8 +148,8 @@ float GpuTrack::GetYFromDepth(uint32_t depth) const {
 // When track is collapsed, only draw "hardware execution" timers.
 bool GpuTrack::TimerFilter(const TimerInfo& timer_info) const {
   if (collapse_toggle_->IsCollapsed()) {
-    std::string gpu_stage =
-        string_manager_->Get(timer_info.user_data_key()).value_or("");
+    std::string_view gpu_stage =
+        string_manager_->GetView(timer_info.user_data_key()).value_or("");
     if (gpu_stage != kHwExecutionString) {
       return false;
     }
@@ -128,6 +157,15 @@ bool GpuTrack::TimerFilter(const TimerInfo& timer_info) const {
   return true;
 }
 
+bool GpuTrack::IsTimerFilterActive() const {
+  return collapse_toggle_->IsCollapsed();
+}
+
+// The instances need the y of the timers to be linear in their depth.
+bool GpuTrack::DrawsTimerInstances() const {
+  return command_buffer_depth_ == 0 && TimerTrack::DrawsTimerInstances();
+}
+
 //-----------------------------------------------------------------------------
 void GpuTrack::SetTimesliceText(const TimerInfo& timer_info, double elapsed_us,
                                 float min_x, TextBox* text_box) {
@@ -137,11 +175,12 @@ void GpuTrack::SetTimesliceText(const TimerInfo& timer_info, double elapsed_us,
 
     text_box->SetElapsedTimeTextLength(time.length());
 
-    CHECK(timer_info.type() == TimerInfo::kGpuActivity);
+    CHECK(timer_info.type() == TimerInfo::kGpuActivity ||
+          timer_info.type() == TimerInfo::kGpuCommandBuffer);
 
     std::string text = absl::StrFormat("%s  %s",
                                        time_graph_->GetStringManager()
-                                           ->Get(timer_info.user_data_key())
+                                           ->GetView(timer_info.user_data_key())
                                            .value_or(""),
                                        time.c_str());
     text_box->SetText(text);
@@ -152,7 +191,7 @@ void GpuTrack::SetTimesliceText(const TimerInfo& timer_info, double elapsed_us,
   const Vec2& box_size = text_box->GetSize();
   float pos_x = std::max(box_pos[0], min_x);
   float max_size = box_pos[0] + box_size[0] - pos_x;
-  text_renderer_->AddTextTrailingCharsPrioritized(
+  primitives_text_->AddTextTrailingCharsPrioritized(
       text_box->GetText().c_str(), pos_x,
       text_box->GetPosY() + layout.GetTextOffset(), GlCanvas::Z_VALUE_TEXT,
       kTextWhite, text_box->GetElapsedTimeTextLength(), max_size);
@@ -167,7 +206,7 @@ std::string GpuTrack::GetTooltip() const {
 float GpuTrack::GetHeight() const {
   TimeGraphLayout& layout = time_graph_->GetLayout();
   bool collapsed = collapse_toggle_->IsCollapsed();
-  uint32_t depth = collapsed ? 1 : GetDepth();
+  uint32_t depth = collapsed ? 1 : job_depth_ + command_buffer_depth_;
   return layout.GetTextBoxHeight() * depth + layout.GetTrackBottomMargin();
 }
 
@@ -194,15 +233,17 @@ const TextBox* GpuTrack::GetRight(TextBox* text_box) const {
 }
 
 //-----------------------------------------------------------------------------
-std::string GpuTrack::GetBoxTooltip(PickingID id) const {
-  TextBox* text_box = time_graph_->GetBatcher().GetTextBox(id);
+std::string GpuTrack::GetBoxTooltip(const TextBox* text_box) const {
   if (!text_box ||
       text_box->GetTimerInfo().type() == TimerInfo::kCoreActivity) {
     return "";
   }
+  if (text_box->GetTimerInfo().type() == TimerInfo::kGpuCommandBuffer) {
+    return GetCommandBufferTooltip(text_box->GetTimerInfo());
+  }
 
-  std::string gpu_stage =
-      string_manager_->Get(text_box->GetTimerInfo().user_data_key())
+  std::string_view gpu_stage =
+      string_manager_->GetView(text_box->GetTimerInfo().user_data_key())
           .value_or("");
   if (gpu_stage == kSwQueueString) {
     return GetSwQueueTooltip(text_box->GetTimerInfo());
@@ -224,7 +265,7 @@ std::string GpuTrack::GetSwQueueTooltip(const TimerInfo& timer_info) const {
       "<br/>"
       "<b>Submitted from thread:</b> %s [%d]<br/>"
       "<b>Time:</b> %s",
-      Capture::GThreadNames[timer_info.thread_id()].c_str(),
+      Capture::GCaptureData.GetThreadName(timer_info.thread_id()),
       timer_info.thread_id(),
       GetPrettyTime(TicksToDuration(timer_info.start(), timer_info.end()))
           .c_str());
@@ -238,7 +279,7 @@ std::string GpuTrack::GetHwQueueTooltip(const TimerInfo& timer_info) const {
       "<br/>"
       "<b>Submitted from thread:</b> %s [%d]<br/>"
       "<b>Time:</b> %s",
-      Capture::GThreadNames[timer_info.thread_id()].c_str(),
+      Capture::GCaptureData.GetThreadName(timer_info.thread_id()),
       timer_info.thread_id(),
       GetPrettyTime(TicksToDuration(timer_info.start(), timer_info.end()))
           .c_str());
@@ -253,7 +294,30 @@ std::string GpuTrack::GetHwExecutionTooltip(const TimerInfo& timer_info) const {
       "<br/>"
       "<b>Submitted from thread:</b> %s [%d]<br/>"
       "<b>Time:</b> %s",
-      Capture::GThreadNames[timer_info.thread_id()].c_str(),
+      Capture::GCaptureData.GetThreadName(timer_info.thread_id()),
+      timer_info.thread_id(),
+      GetPrettyTime(TicksToDuration(timer_info.start(), timer_info.end()))
+          .c_str());
+}
+
+std::string GpuTrack::GetCommandBufferTooltip(
+    const TimerInfo& timer_info) const {
+  const bool is_label = timer_info.depth() > kCommandBufferFirstDepth;
+  return absl::StrFormat(
+      "<b>%s</b><br/>"
+      "<i>Measured on the GPU with timestamp queries by OrbitVulkanLayer</i>"
+      "<br/>"
+      "<br/>"
+      "%s"
+      "<b>Submitted from thread:</b> %s [%d]<br/>"
+      "<b>Time:</b> %s",
+      is_label ? "Debug Label" : "Command Buffer",
+      is_label
+          ? absl::StrFormat(
+                "<b>Label:</b> %s<br/>",
+                string_manager_->Get(timer_info.user_data_key()).value_or(""))
+          : "",
+      Capture::GCaptureData.GetThreadName(timer_info.thread_id()),
       timer_info.thread_id(),
       GetPrettyTime(TicksToDuration(timer_info.start(), timer_info.end()))
           .c_str());
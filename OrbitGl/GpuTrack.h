@@ -32,6 +32,10 @@ class GpuTrack : public TimerTrack {
   [[nodiscard]] Type GetType() const override { return kGpuTrack; }
   [[nodiscard]] float GetHeight() const override;
 
+  // The timers of the GPU jobs, and of the command buffers and debug label
+  // regions of their submissions, drawn below the jobs.
+  const TextBox* OnGpuTimer(orbit_client_protos::TimerInfo timer_info);
+
   [[nodiscard]] const TextBox* GetLeft(TextBox* text_box) const override;
   [[nodiscard]] const TextBox* GetRight(TextBox* text_box) const override;
 
@@ -40,6 +44,8 @@ class GpuTrack : public TimerTrack {
  protected:
   [[nodiscard]] bool IsTimerActive(
       const orbit_client_protos::TimerInfo& timer) const override;
+  [[nodiscard]] bool IsTimerFilterActive() const override;
+  [[nodiscard]] bool DrawsTimerInstances() const override;
   [[nodiscard]] Color GetTimerColor(const orbit_client_protos::TimerInfo& timer,
                                     bool is_selected) const override;
   [[nodiscard]] bool TimerFilter(
@@ -47,11 +53,20 @@ class GpuTrack : public TimerTrack {
   void SetTimesliceText(
       const orbit_client_protos::TimerInfo& timer, double elapsed_us,
       float min_x, TextBox* text_box) override;
-  [[nodiscard]] std::string GetBoxTooltip(PickingID id) const override;
+  [[nodiscard]] std::string GetBoxTooltip(
+      const TextBox* text_box) const override;
 
  private:
+  // The command buffer timers are kept at their depth plus this, as the jobs
+  // can still get deeper.
+  static constexpr uint32_t kCommandBufferFirstDepth = 1u << 16;
+
   uint64_t timeline_hash_;
   std::shared_ptr<StringManager> string_manager_;
+  uint32_t job_depth_ = 0;
+  uint32_t command_buffer_depth_ = 0;
+  [[nodiscard]] std::string GetCommandBufferTooltip(
+      const orbit_client_protos::TimerInfo& timer_info) const;
   [[nodiscard]] std::string GetSwQueueTooltip(
       const orbit_client_protos::TimerInfo& timer_info) const;
   [[nodiscard]] std::string GetHwQueueTooltip(
@@ -4,6 +4,9 @@
 
 #include "GraphTrack.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "GlCanvas.h"
 
 GraphTrack::GraphTrack(TimeGraph* time_graph) : Track(time_graph) {}
@@ -30,7 +33,6 @@ void GraphTrack::Draw(GlCanvas* canvas, PickingMode /*picking_mode*/) {
   }
 
   float track_z = layout.GetTrackZ();
-  float text_z = layout.GetTextZ();
 
   Box box(m_Pos, Vec2(m_Size[0], -m_Size[1]), track_z);
   batcher->AddBox(box, color, PickingID::PICKABLE);
@@ -43,32 +45,240 @@ void GraphTrack::Draw(GlCanvas* canvas, PickingMode /*picking_mode*/) {
   batcher->AddLine(Vec2(x1, y1), Vec2(x0, y1), track_z, color,
                    PickingID::PICKABLE);
 
-  const Color kLineColor(0, 128, 255, 128);
-
   // Current time window
   uint64_t min_ns = time_graph_->GetTickFromUs(time_graph_->GetMinTimeUs());
   uint64_t max_ns = time_graph_->GetTickFromUs(time_graph_->GetMaxTimeUs());
-  double time_range = static_cast<float>(max_ns - min_ns);
-  if (values_.size() < 2 || time_range == 0) return;
-
-  auto it = values_.lower_bound(min_ns);
-  if (it == values_.end()) return;
-  uint64_t previous_time = it->first;
-  double last_normalized_value = (it->second - min_) * inv_value_range_;
-  for (++it; it != values_.end(); ++it) {
-    if (previous_time > max_ns) break;
-    uint64_t time = it->first;
-    double normalized_value = (it->second - min_) * inv_value_range_;
-    float base_y = m_Pos[1] - m_Size[1];
-    float x0 = time_graph_->GetWorldFromTick(previous_time);
-    float x1 = time_graph_->GetWorldFromTick(time);
-    float y0 = base_y + static_cast<float>(last_normalized_value) * m_Size[1];
-    float y1 = base_y + static_cast<float>(normalized_value) * m_Size[1];
-    time_graph_->GetBatcher().AddLine(Vec2(x0, y0), Vec2(x1, y1), text_z,
-                                      kLineColor, PickingID::LINE);
-
-    previous_time = time;
-    last_normalized_value = normalized_value;
+  ScopeLock lock(mutex_);
+  if (sample_count_ < 2 || max_ns <= min_ns) return;
+  DrawSamples(canvas, min_ns, max_ns);
+}
+
+namespace {
+// The samples that fall in the same pixel.
+struct Column {
+  uint64_t first_time;
+  uint64_t last_time;
+  double min;
+  double max;
+  double sum;
+  size_t count;
+};
+}  // namespace
+
+// Each pixel wide column of samples is drawn as a vertical line from their
+// minimum to their maximum, and the line of the track joins the averages of
+// the columns. Zoomed in enough, the columns hold one sample each and the
+// line joins the samples.
+void GraphTrack::DrawSamples(GlCanvas* canvas, uint64_t min_ns,
+                             uint64_t max_ns) {
+  Batcher* batcher = canvas->GetBatcher();
+  float text_z = time_graph_->GetLayout().GetTextZ();
+  const Color kLineColor(0, 128, 255, 128);
+  const Color kEnvelopeColor(0, 128, 255, 64);
+  float base_y = m_Pos[1] - m_Size[1];
+  auto get_y = [&](double value) {
+    return base_y + static_cast<float>((value - min_) * inv_value_range_) *
+                        m_Size[1];
+  };
+
+  // Start from the last sample before the window, so that the line enters it.
+  auto chunk_it = std::upper_bound(
+      chunks_.begin(), chunks_.end(), min_ns,
+      [](uint64_t time, const Chunk& chunk) {
+        return time < chunk.samples.front().time;
+      });
+  if (chunk_it != chunks_.begin()) {
+    --chunk_it;
+  }
+  size_t index =
+      std::lower_bound(chunk_it->samples.begin(), chunk_it->samples.end(),
+                       min_ns,
+                       [](const Sample& sample, uint64_t time) {
+                         return sample.time < time;
+                       }) -
+      chunk_it->samples.begin();
+  if (index > 0) {
+    --index;
+  } else if (chunk_it != chunks_.begin()) {
+    --chunk_it;
+    index = chunk_it->samples.size() - 1;
+  }
+
+  const double ns_per_column =
+      static_cast<double>(max_ns - min_ns) / std::max(canvas->getWidth(), 1);
+  Column column{};
+  bool has_column = false;
+  double column_end = 0;
+  Vec2 previous_point;
+  bool has_previous_point = false;
+  auto draw_column = [&]() {
+    double mean = column.sum / column.count;
+    uint64_t time =
+        column.first_time + (column.last_time - column.first_time) / 2;
+    Vec2 point(time_graph_->GetWorldFromTick(time), get_y(mean));
+    if (column.count > 1) {
+      float min_y = get_y(column.min);
+      batcher->AddVerticalLine(Vec2(point[0], min_y), get_y(column.max) - min_y,
+                               text_z, kEnvelopeColor, PickingID::LINE);
+    }
+    if (has_previous_point) {
+      batcher->AddLine(previous_point, point, text_z, kLineColor,
+                       PickingID::LINE);
+    }
+    previous_point = point;
+    has_previous_point = true;
+  };
+
+  for (; chunk_it != chunks_.end(); ++chunk_it, index = 0) {
+    Chunk& chunk = *chunk_it;
+    UpdateBuckets(&chunk);
+    const std::vector<Sample>& samples = chunk.samples;
+    while (index < samples.size()) {
+      const Sample& sample = samples[index];
+      double offset = static_cast<double>(static_cast<int64_t>(sample.time) -
+                                          static_cast<int64_t>(min_ns));
+      if (!has_column || offset >= column_end) {
+        if (has_column) {
+          draw_column();
+          // The line has left the window.
+          if (column.last_time > max_ns) return;
+        }
+        column_end = (std::floor(offset / ns_per_column) + 1) * ns_per_column;
+        column = Column{sample.time, sample.time, sample.value, sample.value,
+                        0, 0};
+        has_column = true;
+      }
+
+      // The largest bucket that starts at this sample and ends in the column.
+      size_t end = index + 1;
+      const Bucket* bucket = nullptr;
+      for (size_t level = BUCKET_SIZES.size(); level-- > 0;) {
+        size_t bucket_size = BUCKET_SIZES[level];
+        if (index % bucket_size != 0) continue;
+        size_t bucket_end = std::min(index + bucket_size, samples.size());
+        double end_offset = static_cast<double>(
+            static_cast<int64_t>(samples[bucket_end - 1].time) -
+            static_cast<int64_t>(min_ns));
+        if (end_offset >= column_end) continue;
+        bucket = &chunk.buckets_by_level[level][index / bucket_size];
+        end = bucket_end;
+        break;
+      }
+
+      if (bucket != nullptr) {
+        column.min = std::min(column.min, bucket->min);
+        column.max = std::max(column.max, bucket->max);
+        column.sum += bucket->sum;
+      } else {
+        column.min = std::min(column.min, sample.value);
+        column.max = std::max(column.max, sample.value);
+        column.sum += sample.value;
+      }
+      column.count += end - index;
+      column.last_time = samples[end - 1].time;
+      index = end;
+    }
+  }
+  if (has_column) {
+    draw_column();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void GraphTrack::UpdateBuckets(Chunk* chunk) {
+  if (!chunk->buckets_outdated) return;
+  const std::vector<Sample>& samples = chunk->samples;
+  size_t lower_bucket_size = 1;
+  for (size_t level = 0; level < BUCKET_SIZES.size(); ++level) {
+    // Each bucket is made of the buckets of the level below.
+    size_t fan_out = BUCKET_SIZES[level] / lower_bucket_size;
+    std::vector<Bucket>& buckets = chunk->buckets_by_level[level];
+    buckets.clear();
+    size_t lower_bucket_count =
+        level == 0 ? samples.size() : chunk->buckets_by_level[level - 1].size();
+    for (size_t begin = 0; begin < lower_bucket_count; begin += fan_out) {
+      Bucket bucket{std::numeric_limits<double>::max(),
+                    std::numeric_limits<double>::lowest(), 0};
+      size_t end = std::min(begin + fan_out, lower_bucket_count);
+      for (size_t i = begin; i < end; ++i) {
+        if (level == 0) {
+          bucket.min = std::min(bucket.min, samples[i].value);
+          bucket.max = std::max(bucket.max, samples[i].value);
+          bucket.sum += samples[i].value;
+        } else {
+          const Bucket& lower = chunk->buckets_by_level[level - 1][i];
+          bucket.min = std::min(bucket.min, lower.min);
+          bucket.max = std::max(bucket.max, lower.max);
+          bucket.sum += lower.sum;
+        }
+      }
+      buckets.push_back(bucket);
+    }
+    lower_bucket_size = BUCKET_SIZES[level];
+  }
+  chunk->buckets_outdated = false;
+}
+
+//-----------------------------------------------------------------------------
+void GraphTrack::AddValue(uint64_t time, double value) {
+  ScopeLock lock(mutex_);
+  if (chunks_.empty() || time > chunks_.back().samples.back().time) {
+    if (chunks_.empty() || chunks_.back().samples.size() >= CHUNK_SIZE) {
+      chunks_.emplace_back();
+    }
+    chunks_.back().samples.push_back(Sample{time, value});
+    chunks_.back().buckets_outdated = true;
+    ++sample_count_;
+  } else {
+    InsertValue(time, value);
+  }
+  min_ = std::min(min_, value);
+  max_ = std::max(max_, value);
+  value_range_ = max_ - min_;
+  inv_value_range_ = value_range_ == 0 ? 0 : 1.0 / value_range_;
+}
+
+//-----------------------------------------------------------------------------
+void GraphTrack::DropValuesBefore(uint64_t time) {
+  ScopeLock lock(mutex_);
+  size_t num_dropped_chunks = 0;
+  while (num_dropped_chunks + 1 < chunks_.size() &&
+         chunks_[num_dropped_chunks].samples.back().time < time) {
+    sample_count_ -= chunks_[num_dropped_chunks].samples.size();
+    ++num_dropped_chunks;
+  }
+  chunks_.erase(chunks_.begin(), chunks_.begin() + num_dropped_chunks);
+}
+
+//-----------------------------------------------------------------------------
+void GraphTrack::InsertValue(uint64_t time, double value) {
+  // The last chunk that starts before the sample, or the first one.
+  auto chunk_it = std::upper_bound(
+      chunks_.begin(), chunks_.end(), time,
+      [](uint64_t time, const Chunk& chunk) {
+        return time < chunk.samples.front().time;
+      });
+  if (chunk_it != chunks_.begin()) {
+    --chunk_it;
+  }
+  std::vector<Sample>& samples = chunk_it->samples;
+  auto sample_it = std::lower_bound(samples.begin(), samples.end(), time,
+                                    [](const Sample& sample, uint64_t time) {
+                                      return sample.time < time;
+                                    });
+  chunk_it->buckets_outdated = true;
+  if (sample_it != samples.end() && sample_it->time == time) {
+    sample_it->value = value;
+    return;
+  }
+  samples.insert(sample_it, Sample{time, value});
+  ++sample_count_;
+
+  if (samples.size() >= 2 * CHUNK_SIZE) {
+    Chunk second_half;
+    second_half.samples.assign(samples.begin() + CHUNK_SIZE, samples.end());
+    samples.resize(CHUNK_SIZE);
+    chunks_.insert(chunk_it + 1, std::move(second_half));
   }
 }
 
@@ -5,9 +5,13 @@
 #ifndef ORBIT_GL_GRAPH_TRACK_H
 #define ORBIT_GL_GRAPH_TRACK_H
 
+#include <array>
+#include <cstdint>
 #include <limits>
+#include <vector>
 
 #include "ScopeTimer.h"
+#include "Threading.h"
 #include "Track.h"
 
 class TimeGraph;
@@ -18,9 +22,54 @@ class GraphTrack : public Track {
   [[nodiscard]] Type GetType() const override { return kGraphTrack; }
   void Draw(GlCanvas* canvas, PickingMode /*picking_mode*/) override;
   [[nodiscard]] float GetHeight() const override;
+  [[nodiscard]] bool IsEmpty() const {
+    ScopeLock lock(mutex_);
+    return sample_count_ == 0;
+  }
+
+  // Values can be added from the capture thread while the track is drawn.
+  // A value at the time of an earlier one replaces it.
+  void AddValue(uint64_t time, double value);
+  // Frees the oldest chunks of samples, but the last one, that are all before
+  // time. The range of the values, hence the scale of the graph, stays the
+  // same.
+  void DropValuesBefore(uint64_t time);
 
  protected:
-  std::map<uint64_t, double> values_;
+  struct Sample {
+    uint64_t time;
+    double value;
+  };
+
+  struct Bucket {
+    double min;
+    double max;
+    double sum;
+  };
+
+  static constexpr std::array<size_t, 3> BUCKET_SIZES = {16, 256, 4096};
+  // Chunks are appended with this many samples, and split in two when
+  // out-of-order samples make them twice as large.
+  static constexpr size_t CHUNK_SIZE = 4096;
+
+  // The samples are kept in time-sorted chunks that don't overlap. For each
+  // chunk, the minimum, maximum and sum of every BUCKET_SIZES[level] samples
+  // are kept at each level, so that the samples of a pixel are summed up
+  // without visiting them all when zoomed out.
+  struct Chunk {
+    std::vector<Sample> samples;
+    std::array<std::vector<Bucket>, BUCKET_SIZES.size()> buckets_by_level;
+    bool buckets_outdated = true;
+  };
+
+  // Adds a sample before the last one, with mutex_ held.
+  void InsertValue(uint64_t time, double value);
+  static void UpdateBuckets(Chunk* chunk);
+  void DrawSamples(GlCanvas* canvas, uint64_t min_ns, uint64_t max_ns);
+
+  mutable Mutex mutex_;
+  std::vector<Chunk> chunks_;
+  size_t sample_count_ = 0;
   double min_ = std::numeric_limits<double>::max();
   double max_ = std::numeric_limits<double>::lowest();
   double value_range_ = 0;
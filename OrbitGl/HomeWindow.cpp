@@ -85,11 +85,11 @@ void HomeWindow::RenderUI() {
     m_DebugWindow.Draw("Debug", &m_DrawDebugDisplay);
   }
 
+  // Taken even while the window is hidden, as the log window keeps a bounded
+  // number of lines but the global log doesn't.
+  m_LogWindow.AddEntries(GLogger.ConsumeEntries(OrbitLog::Global));
   if (m_DrawLog) {
-    GLogger.GetLockedLog(
-        OrbitLog::Global, [&](const std::vector<std::string>& a_Entries) {
-          m_LogWindow.Draw("Log", a_Entries, &m_LogWindow.m_Open);
-        });
+    m_LogWindow.Draw("Log", &m_LogWindow.m_Open);
   }
 
   // Rendering
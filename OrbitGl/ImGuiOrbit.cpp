@@ -22,6 +22,7 @@
 #include "Params.h"
 #include "Pdb.h"
 #include "OrbitBase/Logging.h"
+#include "absl/strings/str_split.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -35,11 +36,8 @@ namespace {
 static bool g_MousePressed[3] = {false, false, false};
 static float g_MouseWheel = 0.0f;
 static GLuint g_FontTexture = 0;
-
-GLuint GTextureInjected = 0;
-GLuint GTextureTimer = 0;
-GLuint GTextureHelp = 0;
-GLuint GTextureRecord = 0;
+// Uploaded on first use by GetOrbitImageTexture, indexed by OrbitImage.
+static GLuint g_ImageTextures[4] = {0, 0, 0, 0};
 
 static const char g_GlslVersionString[32] = "#version 100\n";
 static unsigned int g_VboHandle = 0, g_ElementsHandle = 0;
@@ -71,6 +69,11 @@ void Orbit_ImGui_InvalidateDeviceObjects() {
 		ImGui::GetIO().Fonts->TexID = 0;
 		g_FontTexture = 0;
 	}
+
+	for (GLuint& texture : g_ImageTextures) {
+		if (texture) glDeleteTextures(1, &texture);
+		texture = 0;
+	}
 }
 
 // If you get an error please report on github. You may try different GL context
@@ -133,49 +136,6 @@ bool Orbit_ImGui_CreateTextures() {
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
                GL_UNSIGNED_BYTE, pixels);
 
-  glGenTextures(1, &GTextureInjected);
-  glBindTexture(GL_TEXTURE_2D, GTextureInjected);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-#ifdef GL_UNPACK_ROW_LENGTH
-  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-#endif
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, inject_image.width,
-               inject_image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-               inject_image.pixel_data);
-
-  glGenTextures(1, &GTextureTimer);
-  glBindTexture(GL_TEXTURE_2D, GTextureTimer);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-#ifdef GL_UNPACK_ROW_LENGTH
-  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-#endif
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, inject_image.width,
-               inject_image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-               timer_image.pixel_data);
-
-  glGenTextures(1, &GTextureHelp);
-  glBindTexture(GL_TEXTURE_2D, GTextureHelp);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-#ifdef GL_UNPACK_ROW_LENGTH
-  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-#endif
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, help_image.width, help_image.height,
-               0, GL_RGBA, GL_UNSIGNED_BYTE, help_image.pixel_data);
-
-  glGenTextures(1, &GTextureRecord);
-  glBindTexture(GL_TEXTURE_2D, GTextureRecord);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-#ifdef GL_UNPACK_ROW_LENGTH
-  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-#endif
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, record_image.width,
-               record_image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-               record_image.pixel_data);
-
   // Store our identifier
   io.Fonts->TexID =
       reinterpret_cast<ImTextureID>(static_cast<intptr_t>(g_FontTexture));
@@ -615,6 +575,24 @@ void Orbit_ImGui_RenderDrawLists(ImDrawData* draw_data) {
             static_cast<GLsizei>(last_scissor_box[3]));
 }
 
+GLuint CreateImageTexture(unsigned int width, unsigned int height,
+                          const unsigned char* pixel_data) {
+  GLint last_texture;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+#ifdef GL_UNPACK_ROW_LENGTH
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, pixel_data);
+  glBindTexture(GL_TEXTURE_2D, last_texture);
+  return texture;
+}
+
 ImFont* AddOrbitFont(float pixel_size) {
   const auto exe_path = Path::GetExecutablePath();
   const auto font_file_name = exe_path + "fonts/Vera.ttf";
@@ -625,6 +603,32 @@ ImFont* AddOrbitFont(float pixel_size) {
 }  // namespace
 
 
+uint32_t GetOrbitImageTexture(OrbitImage image) {
+  GLuint& texture = g_ImageTextures[static_cast<size_t>(image)];
+  if (texture != 0) {
+    return texture;
+  }
+  switch (image) {
+    case OrbitImage::kInject:
+      texture = CreateImageTexture(inject_image.width, inject_image.height,
+                                   inject_image.pixel_data);
+      break;
+    case OrbitImage::kTimer:
+      texture = CreateImageTexture(timer_image.width, timer_image.height,
+                                   timer_image.pixel_data);
+      break;
+    case OrbitImage::kHelp:
+      texture = CreateImageTexture(help_image.width, help_image.height,
+                                   help_image.pixel_data);
+      break;
+    case OrbitImage::kRecord:
+      texture = CreateImageTexture(record_image.width, record_image.height,
+                                   record_image.pixel_data);
+      break;
+  }
+  return texture;
+}
+
 void Orbit_ImGui_MouseButtonCallback(GlCanvas* a_GlCanvas, int button,
                                      bool down) {
   ScopeImguiContext state(a_GlCanvas->GetImGuiContext());
@@ -746,6 +750,71 @@ void Orbit_ImGui_NewFrame(GlCanvas* a_Canvas) {
   ImGui::NewFrame();
 }
 
+void LogWindow::AddEntries(std::vector<std::string> entries) {
+  if (entries.empty()) {
+    return;
+  }
+  for (std::string& entry : entries) {
+    if (entry.find('\n') == std::string::npos) {
+      lines_.Add(std::move(entry));
+      continue;
+    }
+    for (absl::string_view line :
+         absl::StrSplit(entry, '\n', absl::SkipEmpty())) {
+      lines_.Add(std::string(line));
+    }
+  }
+  // Follow the new lines unless scrolled up.
+  ScrollToBottom |= scrolled_to_bottom_;
+}
+
+void LogWindow::Draw(const char* title, bool* p_opened) {
+  ImGui::SetNextWindowSize(ImVec2(500, 400), ImGuiCond_FirstUseEver);
+  ImGui::Begin(title, p_opened);
+
+  if (ImGui::Button("Clear")) Clear();
+  ImGui::SameLine();
+  bool copy = ImGui::Button("Copy");
+  ImGui::SameLine();
+  Filter.Draw("Filter", -100.0f);
+  ImGui::Separator();
+  ImGui::BeginChild("scrolling", ImVec2(0, 0), false,
+                    ImGuiWindowFlags_HorizontalScrollbar);
+  if (copy) ImGui::LogToClipboard();
+
+  const int line_count = static_cast<int>(lines_.Size());
+  filtered_lines_.clear();
+  if (Filter.IsActive()) {
+    for (int i = 0; i < line_count; ++i) {
+      if (Filter.PassFilter(lines_[i].c_str())) filtered_lines_.push_back(i);
+    }
+  }
+  const bool filtered = Filter.IsActive();
+  const int shown_count =
+      filtered ? static_cast<int>(filtered_lines_.size()) : line_count;
+  auto draw_line = [&](int i) {
+    ImGui::TextUnformatted(
+        lines_[filtered ? filtered_lines_[i] : i].c_str());
+  };
+  if (copy) {
+    // All the lines, as only the ones drawn are copied.
+    for (int i = 0; i < shown_count; ++i) draw_line(i);
+  } else {
+    ImGuiListClipper clipper(shown_count);
+    while (clipper.Step()) {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+        draw_line(i);
+      }
+    }
+  }
+
+  if (ScrollToBottom) ImGui::SetScrollHere(1.0f);
+  ScrollToBottom = false;
+  scrolled_to_bottom_ = ImGui::GetScrollY() >= ImGui::GetScrollMaxY();
+  ImGui::EndChild();
+  ImGui::End();
+}
+
 void OutputWindow::AddLine(const std::string& a_String) {
   int old_size = Buf.size();
   Buf.append(a_String.c_str());
@@ -16,6 +16,7 @@
 #include <string>
 #include <vector>
 
+#include "RingBuffer.h"
 #include "imgui.h"
 #include "imgui_internal.h"
 
@@ -39,6 +40,12 @@ IMGUI_API void Orbit_ImGui_CharCallback(GlCanvas* a_Canvas, unsigned int c);
 // Returns OpenGL texture id or 0 in case of an error.
 uint32_t LoadTextureFromFile(const char* filename);
 
+// The images embedded in Images.h.
+enum class OrbitImage { kInject, kTimer, kHelp, kRecord };
+// Returns the OpenGL texture of image, which is only uploaded on first use,
+// in the current context.
+uint32_t GetOrbitImageTexture(OrbitImage image);
+
 
 struct ScopeImguiContext {
   explicit ScopeImguiContext(ImGuiContext* a_State) : m_ImGuiContext(nullptr) {
@@ -118,42 +125,28 @@ struct DebugWindow {
 };
 
 //-----------------------------------------------------------------------------
+// Keeps the last kMaxLines lines, and only lays out and draws the visible ones,
+// so that its cost doesn't grow with the number of lines logged.
 class LogWindow {
  public:
+  static constexpr size_t kMaxLines = 8192;
+
   LogWindow() {}
   ImGuiTextFilter Filter;
   bool ScrollToBottom = false;
   bool m_Open = false;
 
-  void Draw(const char* title, const std::vector<std::string>& lines,
-            bool* p_opened = nullptr) {
-    ImGui::SetNextWindowSize(ImVec2(500, 400), ImGuiCond_FirstUseEver);
-    ImGui::Begin(title, p_opened);
-
-    bool copy = ImGui::Button("Copy");
-    ImGui::SameLine();
-    Filter.Draw("Filter", -100.0f);
-    ImGui::Separator();
-    ImGui::BeginChild("scrolling", ImVec2(0, 0), false,
-                      ImGuiWindowFlags_HorizontalScrollbar);
-    if (copy) ImGui::LogToClipboard();
-
-    if (Filter.IsActive()) {
-      for (const std::string& line : lines) {
-        if (Filter.PassFilter(line.c_str()))
-          ImGui::TextUnformatted(line.c_str());
-      }
-    } else {
-      for (const std::string& line : lines) {
-        ImGui::TextUnformatted(line.c_str());
-      }
-    }
-
-    if (ScrollToBottom) ImGui::SetScrollHere(1.0f);
-    ScrollToBottom = false;
-    ImGui::EndChild();
-    ImGui::End();
-  }
+  // Entries with several lines are split, as all lines must have the same
+  // height to be clipped.
+  void AddEntries(std::vector<std::string> entries);
+  void Clear() { lines_.Clear(); }
+  void Draw(const char* title, bool* p_opened = nullptr);
+
+ private:
+  RingBuffer<std::string, kMaxLines> lines_;
+  // Reused by Draw while filtering.
+  std::vector<int> filtered_lines_;
+  bool scrolled_to_bottom_ = true;
 };
 
 struct VizWindow {
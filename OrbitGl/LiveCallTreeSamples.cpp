@@ -0,0 +1,120 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "LiveCallTreeSamples.h"
+
+#include "FunctionUtils.h"
+
+using orbit_client_protos::CallstackEvent;
+using orbit_client_protos::FunctionInfo;
+
+void LiveCallTreeSamples::AddCallstack(CallStack callstack) {
+  absl::MutexLock lock(&mutex_);
+  new_callstacks_.push_back(std::move(callstack));
+}
+
+void LiveCallTreeSamples::AddCallstackEvent(
+    const CallstackEvent& callstack_event, uint64_t weight) {
+  absl::MutexLock lock(&mutex_);
+  new_samples_.push_back(
+      {callstack_event.thread_id(), callstack_event.callstack_hash(), weight});
+}
+
+void LiveCallTreeSamples::AddThreadName(int32_t thread_id,
+                                        std::string thread_name) {
+  absl::MutexLock lock(&mutex_);
+  new_thread_names_.emplace_back(thread_id, std::move(thread_name));
+}
+
+void LiveCallTreeSamples::Clear() {
+  {
+    absl::MutexLock lock(&mutex_);
+    new_callstacks_.clear();
+    new_samples_.clear();
+    new_thread_names_.clear();
+  }
+  resolved_callstacks_.clear();
+  function_addresses_.clear();
+  function_names_.clear();
+  thread_names_.clear();
+  samples_without_callstack_.clear();
+}
+
+std::vector<CallstackSamples> LiveCallTreeSamples::TakeNewSamples(
+    Process* process) {
+  std::vector<CallStack> new_callstacks;
+  std::vector<Sample> new_samples;
+  std::vector<std::pair<int32_t, std::string>> new_thread_names;
+  {
+    absl::MutexLock lock(&mutex_);
+    new_callstacks.swap(new_callstacks_);
+    new_samples.swap(new_samples_);
+    new_thread_names.swap(new_thread_names_);
+  }
+
+  for (auto& [thread_id, thread_name] : new_thread_names) {
+    thread_names_.insert_or_assign(thread_id, std::move(thread_name));
+  }
+
+  for (CallStack& callstack : new_callstacks) {
+    auto function_addresses = std::make_shared<std::vector<uint64_t>>();
+    function_addresses->reserve(callstack.m_Data.size());
+    for (uint64_t address : callstack.m_Data) {
+      function_addresses->push_back(GetFunctionAddress(address, process));
+    }
+    resolved_callstacks_.insert_or_assign(callstack.Hash(),
+                                          std::move(function_addresses));
+  }
+
+  // Count the samples per thread and callstack, as consecutive samples are
+  // often of the same callstack.
+  absl::flat_hash_map<std::pair<int32_t, CallstackID>, uint64_t> counts;
+  std::vector<Sample> samples_without_callstack;
+  auto count_sample = [&](const Sample& sample) {
+    if (!resolved_callstacks_.contains(sample.callstack_id)) {
+      samples_without_callstack.push_back(sample);
+      return;
+    }
+    counts[std::make_pair(sample.thread_id, sample.callstack_id)] +=
+        sample.weight;
+  };
+  for (const Sample& sample : samples_without_callstack_) {
+    count_sample(sample);
+  }
+  for (const Sample& sample : new_samples) {
+    count_sample(sample);
+  }
+  samples_without_callstack_ = std::move(samples_without_callstack);
+
+  std::vector<CallstackSamples> callstack_samples;
+  callstack_samples.reserve(counts.size());
+  for (const auto& [thread_and_callstack_id, count] : counts) {
+    callstack_samples.push_back(
+        {thread_and_callstack_id.first,
+         resolved_callstacks_.at(thread_and_callstack_id.second), count});
+  }
+  return callstack_samples;
+}
+
+uint64_t LiveCallTreeSamples::GetFunctionAddress(uint64_t address,
+                                                 Process* process) {
+  auto function_address_it = function_addresses_.find(address);
+  if (function_address_it != function_addresses_.end()) {
+    return function_address_it->second;
+  }
+
+  // Addresses that aren't in a function with symbols loaded yet stay on their
+  // own, the view shows them as unknown.
+  uint64_t function_address = address;
+  FunctionInfo* function =
+      process != nullptr ? process->GetFunctionFromAddress(address, false)
+                         : nullptr;
+  if (function != nullptr) {
+    function_address = FunctionUtils::GetAbsoluteAddress(*function);
+    function_names_.emplace(function_address,
+                            FunctionUtils::GetDisplayName(*function));
+  }
+  function_addresses_.emplace(address, function_address);
+  return function_address;
+}
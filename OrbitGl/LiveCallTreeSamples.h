@@ -0,0 +1,80 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_LIVE_CALL_TREE_SAMPLES_H_
+#define ORBIT_GL_LIVE_CALL_TREE_SAMPLES_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Callstack.h"
+#include "OrbitProcess.h"
+#include "TopDownView.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "capture_data.pb.h"
+
+// Collects the samples of a capture while it is being taken, so that the
+// top-down and the bottom-up view can show them before the capture ends.
+//
+// Callstacks, callstack events and thread names are added from the thread
+// that receives the capture, and only queued. The new samples are taken from
+// the main thread, which resolves each callstack once. As callstacks aren't
+// resolved again when more symbols are loaded, the views are built again from
+// the SamplingProfiler once the capture ends.
+class LiveCallTreeSamples {
+ public:
+  void AddCallstack(CallStack callstack);
+  // A sample counts as weight samples, e.g., the microseconds a thread was
+  // off-CPU.
+  void AddCallstackEvent(
+      const orbit_client_protos::CallstackEvent& callstack_event,
+      uint64_t weight = 1);
+  void AddThreadName(int32_t thread_id, std::string thread_name);
+  void Clear();
+
+  // The samples added since the last call counted per thread and callstack,
+  // with their callstacks resolved to the functions of process. The samples
+  // of which the callstack hasn't been added yet are kept for the next call.
+  [[nodiscard]] std::vector<CallstackSamples> TakeNewSamples(Process* process);
+
+  // The names of the functions of the samples taken, and of their threads.
+  [[nodiscard]] const std::unordered_map<uint64_t, std::string>&
+  function_names() const {
+    return function_names_;
+  }
+  [[nodiscard]] const std::unordered_map<int32_t, std::string>& thread_names()
+      const {
+    return thread_names_;
+  }
+
+ private:
+  struct Sample {
+    int32_t thread_id;
+    CallstackID callstack_id;
+    uint64_t weight;
+  };
+
+  [[nodiscard]] uint64_t GetFunctionAddress(uint64_t address,
+                                            Process* process);
+
+  absl::Mutex mutex_;
+  std::vector<CallStack> new_callstacks_ ABSL_GUARDED_BY(mutex_);
+  std::vector<Sample> new_samples_ ABSL_GUARDED_BY(mutex_);
+  std::vector<std::pair<int32_t, std::string>> new_thread_names_
+      ABSL_GUARDED_BY(mutex_);
+
+  // Only accessed from the main thread.
+  absl::flat_hash_map<CallstackID, std::shared_ptr<const std::vector<uint64_t>>>
+      resolved_callstacks_;
+  absl::flat_hash_map<uint64_t, uint64_t> function_addresses_;
+  std::unordered_map<uint64_t, std::string> function_names_;
+  std::unordered_map<int32_t, std::string> thread_names_;
+  std::vector<Sample> samples_without_callstack_;
+};
+
+#endif  // ORBIT_GL_LIVE_CALL_TREE_SAMPLES_H_
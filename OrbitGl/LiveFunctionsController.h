@@ -6,6 +6,7 @@
 #define LIVE_FUNCTIONS_H_
 
 #include <functional>
+#include <memory>
 
 #include "absl/container/flat_hash_map.h"
 
@@ -36,6 +37,20 @@ class LiveFunctionsController {
     add_iterator_callback_ = callback;
   }
 
+  // Called with the function selected in the data view.
+  void SetSelectFunctionCallback(
+      std::function<
+          void(std::shared_ptr<const orbit_client_protos::FunctionInfo>)>
+          callback) {
+    select_function_callback_ = callback;
+  }
+  void OnSelectFunction(
+      std::shared_ptr<const orbit_client_protos::FunctionInfo> function) {
+    if (select_function_callback_) {
+      select_function_callback_(std::move(function));
+    }
+  }
+
   TickType GetCaptureMin();
   TickType GetCaptureMax();
   TickType GetStartTime(uint64_t index);
@@ -53,6 +68,8 @@ class LiveFunctionsController {
 
   std::function<void(uint64_t, orbit_client_protos::FunctionInfo*)>
       add_iterator_callback_;
+  std::function<void(std::shared_ptr<const orbit_client_protos::FunctionInfo>)>
+      select_function_callback_;
 
   uint64_t next_iterator_id_ = 0;
 
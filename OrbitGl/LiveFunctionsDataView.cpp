@@ -10,6 +10,7 @@
 #include "FunctionUtils.h"
 #include "LiveFunctionsController.h"
 #include "Log.h"
+#include "OrbitBase/LogLinearHistogram.h"
 #include "Pdb.h"
 #include "Profiling.h"
 #include "TextBox.h"
@@ -20,6 +21,52 @@
 using orbit_client_protos::FunctionInfo;
 using orbit_client_protos::FunctionStats;
 
+namespace {
+// Percentiles are computed from the histogram of the durations of the calls,
+// which is either updated for each timer or aggregated by the service.
+std::optional<uint64_t> GetPercentileNs(const FunctionInfo& function,
+                                        double percentile) {
+  return OrbitBase::LogLinearHistogram::ComputeQuantile(
+      function.stats().duration_histogram(), percentile / 100);
+}
+
+std::string GetPrettyPercentile(const FunctionInfo& function,
+                                double percentile) {
+  std::optional<uint64_t> percentile_ns =
+      GetPercentileNs(function, percentile);
+  if (!percentile_ns.has_value()) {
+    return "";
+  }
+  return GetPrettyTime(absl::Nanoseconds(percentile_ns.value()));
+}
+
+// The time in the function itself, i.e., not in the functions it called, from
+// the timers of its calls.
+uint64_t GetExclusiveTimeNs(const FunctionInfo& function) {
+  if (GCurrentTimeGraph == nullptr) {
+    return 0;
+  }
+  const FunctionTimeIndex::Stats* stats =
+      GCurrentTimeGraph->GetFunctionTimeIndex().GetStats(
+          FunctionUtils::GetAbsoluteAddress(function));
+  return stats != nullptr ? stats->exclusive_time_ns : 0;
+}
+
+std::vector<uint64_t> GetPercentilesNs(
+    const std::vector<std::shared_ptr<FunctionInfo>>& functions,
+    double percentile) {
+  std::vector<uint64_t> percentiles_ns;
+  percentiles_ns.reserve(functions.size());
+  for (const std::shared_ptr<FunctionInfo>& function : functions) {
+    percentiles_ns.push_back(
+        function != nullptr
+            ? GetPercentileNs(*function, percentile).value_or(0)
+            : 0);
+  }
+  return percentiles_ns;
+}
+}  // namespace
+
 //-----------------------------------------------------------------------------
 LiveFunctionsDataView::LiveFunctionsDataView(
     LiveFunctionsController* live_functions)
@@ -34,12 +81,17 @@ const std::vector<DataView::Column>& LiveFunctionsDataView::GetColumns() {
     std::vector<Column> columns;
     columns.resize(COLUMN_NUM);
     columns[COLUMN_SELECTED] = {"Hooked", .0f, SortingOrder::Descending};
-    columns[COLUMN_NAME] = {"Function", .4f, SortingOrder::Ascending};
+    columns[COLUMN_NAME] = {"Function", .35f, SortingOrder::Ascending};
     columns[COLUMN_COUNT] = {"Count", .0f, SortingOrder::Descending};
     columns[COLUMN_TIME_TOTAL] = {"Total", .075f, SortingOrder::Descending};
+    columns[COLUMN_TIME_EXCLUSIVE] = {"Exclusive", .075f,
+                                      SortingOrder::Descending};
     columns[COLUMN_TIME_AVG] = {"Avg", .075f, SortingOrder::Descending};
     columns[COLUMN_TIME_MIN] = {"Min", .075f, SortingOrder::Descending};
     columns[COLUMN_TIME_MAX] = {"Max", .075f, SortingOrder::Descending};
+    columns[COLUMN_TIME_P50] = {"P50", .05f, SortingOrder::Descending};
+    columns[COLUMN_TIME_P95] = {"P95", .05f, SortingOrder::Descending};
+    columns[COLUMN_TIME_P99] = {"P99", .05f, SortingOrder::Descending};
     columns[COLUMN_MODULE] = {"Module", .1f, SortingOrder::Ascending};
     columns[COLUMN_ADDRESS] = {"Address", .0f, SortingOrder::Ascending};
     return columns;
@@ -65,12 +117,20 @@ std::string LiveFunctionsDataView::GetValue(int a_Row, int a_Column) {
       return absl::StrFormat("%lu", stats.count());
     case COLUMN_TIME_TOTAL:
       return GetPrettyTime(absl::Nanoseconds(stats.total_time_ns()));
+    case COLUMN_TIME_EXCLUSIVE:
+      return GetPrettyTime(absl::Nanoseconds(GetExclusiveTimeNs(function)));
     case COLUMN_TIME_AVG:
       return GetPrettyTime(absl::Nanoseconds(stats.average_time_ns()));
     case COLUMN_TIME_MIN:
       return GetPrettyTime(absl::Nanoseconds(stats.min_ns()));
     case COLUMN_TIME_MAX:
       return GetPrettyTime(absl::Nanoseconds(stats.max_ns()));
+    case COLUMN_TIME_P50:
+      return GetPrettyPercentile(function, 50);
+    case COLUMN_TIME_P95:
+      return GetPrettyPercentile(function, 95);
+    case COLUMN_TIME_P99:
+      return GetPrettyPercentile(function, 99);
     case COLUMN_MODULE:
       return function.loaded_module_path();
     case COLUMN_ADDRESS:
@@ -81,6 +141,91 @@ std::string LiveFunctionsDataView::GetValue(int a_Row, int a_Column) {
   }
 }
 
+//-----------------------------------------------------------------------------
+DataView::NumericValue LiveFunctionsDataView::GetNumericValue(int row,
+                                                              int column) {
+  if (row >= static_cast<int>(GetNumElements())) {
+    return std::monostate{};
+  }
+
+  const FunctionInfo& function = *GetFunction(row);
+  const FunctionStats& stats = function.stats();
+
+  // Durations are in nanoseconds.
+  auto get_percentile = [&](double percentile) -> NumericValue {
+    std::optional<uint64_t> percentile_ns =
+        GetPercentileNs(function, percentile);
+    if (!percentile_ns.has_value()) {
+      return std::monostate{};
+    }
+    return percentile_ns.value();
+  };
+  switch (column) {
+    case COLUMN_COUNT:
+      return stats.count();
+    case COLUMN_TIME_TOTAL:
+      return stats.total_time_ns();
+    case COLUMN_TIME_EXCLUSIVE:
+      return GetExclusiveTimeNs(function);
+    case COLUMN_TIME_AVG:
+      return stats.average_time_ns();
+    case COLUMN_TIME_MIN:
+      return stats.min_ns();
+    case COLUMN_TIME_MAX:
+      return stats.max_ns();
+    case COLUMN_TIME_P50:
+      return get_percentile(50);
+    case COLUMN_TIME_P95:
+      return get_percentile(95);
+    case COLUMN_TIME_P99:
+      return get_percentile(99);
+    case COLUMN_ADDRESS:
+      return FunctionUtils::GetAbsoluteAddress(function);
+    default:
+      return std::monostate{};
+  }
+}
+
+//-----------------------------------------------------------------------------
+std::string LiveFunctionsDataView::GetToolTip(int row, int column) {
+  if ((column != COLUMN_TIME_TOTAL && column != COLUMN_TIME_EXCLUSIVE) ||
+      row >= static_cast<int>(GetNumElements()) ||
+      GCurrentTimeGraph == nullptr) {
+    return "";
+  }
+  const std::vector<std::pair<ThreadID, FunctionTimeIndex::Stats>>
+      stats_by_thread =
+          GCurrentTimeGraph->GetFunctionTimeIndex().GetStatsByThread(
+              FunctionUtils::GetAbsoluteAddress(*GetFunction(row)));
+  if (stats_by_thread.empty()) {
+    return "";
+  }
+
+  constexpr size_t kMaxThreadCount = 10;
+  std::shared_ptr<const CaptureData::ThreadNames> thread_names =
+      Capture::GCaptureData.GetThreadNames();
+  std::string tooltip = "Inclusive / exclusive time per thread:";
+  for (size_t i = 0; i < std::min(stats_by_thread.size(), kMaxThreadCount);
+       ++i) {
+    const auto& [thread_id, stats] = stats_by_thread[i];
+    auto name_it = thread_names->find(thread_id);
+    absl::StrAppend(
+        &tooltip, "\n",
+        absl::StrFormat(
+            "%s [%d]: %s / %s in %lu calls",
+            name_it != thread_names->end() ? name_it->second : "", thread_id,
+            GetPrettyTime(absl::Nanoseconds(stats.inclusive_time_ns)),
+            GetPrettyTime(absl::Nanoseconds(stats.exclusive_time_ns)),
+            stats.count));
+  }
+  if (stats_by_thread.size() > kMaxThreadCount) {
+    absl::StrAppend(&tooltip, "\n",
+                    absl::StrFormat("... and %lu other threads",
+                                    stats_by_thread.size() - kMaxThreadCount));
+  }
+  return tooltip;
+}
+
 //-----------------------------------------------------------------------------
 #define ORBIT_FUNC_SORT(Member)                                            \
   [&](int a, int b) {                                                      \
@@ -97,6 +242,12 @@ std::string LiveFunctionsDataView::GetValue(int a_Row, int a_Column) {
     return OrbitUtils::Compare(Func(*functions[a]), Func(*functions[b]), \
                                ascending);                               \
   }
+// Computing a percentile walks the histogram, so they are computed once per
+// function rather than for each comparison.
+#define ORBIT_PERCENTILE_SORT(Percentile)                                 \
+  [&, percentiles = GetPercentilesNs(functions, Percentile)](int a, int b) { \
+    return OrbitUtils::Compare(percentiles[a], percentiles[b], ascending); \
+  }
 
 //-----------------------------------------------------------------------------
 void LiveFunctionsDataView::DoSort() {
@@ -118,6 +269,9 @@ void LiveFunctionsDataView::DoSort() {
     case COLUMN_TIME_TOTAL:
       sorter = ORBIT_STAT_SORT(total_time_ns());
       break;
+    case COLUMN_TIME_EXCLUSIVE:
+      sorter = ORBIT_CUSTOM_FUNC_SORT(GetExclusiveTimeNs);
+      break;
     case COLUMN_TIME_AVG:
       sorter = ORBIT_STAT_SORT(average_time_ns());
       break;
@@ -127,6 +281,15 @@ void LiveFunctionsDataView::DoSort() {
     case COLUMN_TIME_MAX:
       sorter = ORBIT_STAT_SORT(max_ns());
       break;
+    case COLUMN_TIME_P50:
+      sorter = ORBIT_PERCENTILE_SORT(50);
+      break;
+    case COLUMN_TIME_P95:
+      sorter = ORBIT_PERCENTILE_SORT(95);
+      break;
+    case COLUMN_TIME_P99:
+      sorter = ORBIT_PERCENTILE_SORT(99);
+      break;
     case COLUMN_MODULE:
       sorter = ORBIT_CUSTOM_FUNC_SORT(FunctionUtils::GetLoadedModuleName);
       break;
@@ -204,17 +367,20 @@ void LiveFunctionsDataView::OnContextMenu(
       FunctionInfo* function = GetFunction(i);
       FunctionUtils::Select(function);
     }
+    GOrbitApp->UpdateInstrumentedFunctions();
   } else if (a_Action == MENU_ACTION_UNSELECT) {
     for (int i : a_ItemIndices) {
       FunctionInfo* function = GetFunction(i);
       FunctionUtils::UnSelect(function);
     }
+    GOrbitApp->UpdateInstrumentedFunctions();
   } else if (a_Action == MENU_ACTION_DISASSEMBLY) {
     int32_t pid = Capture::GTargetProcess->GetID();
+    std::vector<FunctionInfo> functions;
     for (int i : a_ItemIndices) {
-      const FunctionInfo& function = *GetFunction(i);
-      GOrbitApp->Disassemble(pid, function);
+      functions.push_back(*GetFunction(i));
     }
+    GOrbitApp->Disassemble(pid, std::move(functions));
   } else if (a_Action == MENU_ACTION_JUMP_TO_FIRST) {
     CHECK(a_ItemIndices.size() == 1);
     auto function_address =
@@ -259,6 +425,11 @@ void LiveFunctionsDataView::OnContextMenu(
   }
 }
 
+//-----------------------------------------------------------------------------
+void LiveFunctionsDataView::OnSelect(int a_Index) {
+  live_functions_->OnSelectFunction(functions_[indices_[a_Index]]);
+}
+
 //-----------------------------------------------------------------------------
 void LiveFunctionsDataView::DoFilter() {
   std::vector<uint32_t> indices;
@@ -338,8 +509,8 @@ std::pair<TextBox*, TextBox*> LiveFunctionsDataView::GetMinMax(
     for (TimerChainIterator it = chain->begin(); it != chain->end(); ++it) {
       TimerBlock& block = *it;
       for (size_t i = 0; i < block.size(); i++) {
-        TextBox& box = block[i];
-        if (box.GetTimerInfo().function_address() == function_address) {
+        if (block.GetFunctionAddress(i) == function_address) {
+          TextBox& box = block[i];
           uint64_t elapsed_nanos = TicksToNanoseconds(
               box.GetTimerInfo().start(), box.GetTimerInfo().end());
           if (!min_box || elapsed_nanos < TicksToNanoseconds(
@@ -21,9 +21,13 @@ class LiveFunctionsDataView : public DataView {
   std::vector<std::string> GetContextMenu(
       int a_ClickedIndex, const std::vector<int>& a_SelectedIndices) override;
   std::string GetValue(int a_Row, int a_Column) override;
+  NumericValue GetNumericValue(int row, int column) override;
+  // The split by thread of the inclusive and exclusive time.
+  std::string GetToolTip(int row, int column) override;
 
   void OnContextMenu(const std::string& a_Action, int a_MenuIndex,
                      const std::vector<int>& a_ItemIndices) override;
+  void OnSelect(int a_Index) override;
   void OnDataChanged() override;
   void OnTimer() override;
 
@@ -43,9 +47,13 @@ class LiveFunctionsDataView : public DataView {
     COLUMN_NAME,
     COLUMN_COUNT,
     COLUMN_TIME_TOTAL,
+    COLUMN_TIME_EXCLUSIVE,
     COLUMN_TIME_AVG,
     COLUMN_TIME_MIN,
     COLUMN_TIME_MAX,
+    COLUMN_TIME_P50,
+    COLUMN_TIME_P95,
+    COLUMN_TIME_P99,
     COLUMN_MODULE,
     COLUMN_ADDRESS,
     COLUMN_NUM
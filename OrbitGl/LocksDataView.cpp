@@ -0,0 +1,194 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "LocksDataView.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+#include "App.h"
+#include "Callstack.h"
+#include "Capture.h"
+#include "FunctionUtils.h"
+#include "OrbitModule.h"
+#include "OrbitProcess.h"
+#include "SamplingProfiler.h"
+#include "Utils.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+
+using orbit_client_protos::FunctionInfo;
+
+//-----------------------------------------------------------------------------
+LocksDataView::LocksDataView() : DataView(DataViewType::LOCKS) {
+  m_UpdatePeriodMs = 500;
+}
+
+//-----------------------------------------------------------------------------
+const std::vector<DataView::Column>& LocksDataView::GetColumns() {
+  static const std::vector<Column> columns = [] {
+    std::vector<Column> columns;
+    columns.resize(COLUMN_NUM);
+    columns[COLUMN_ADDRESS] = {"Lock", .0f, SortingOrder::Ascending};
+    columns[COLUMN_WAITS] = {"Waits", .0f, SortingOrder::Descending};
+    columns[COLUMN_TOTAL_WAIT] = {"Total Wait", .0f, SortingOrder::Descending};
+    columns[COLUMN_MAX_WAIT] = {"Max Wait", .0f, SortingOrder::Descending};
+    columns[COLUMN_CALL_SITE] = {"Call Site", .5f, SortingOrder::Ascending};
+    return columns;
+  }();
+  return columns;
+}
+
+//-----------------------------------------------------------------------------
+std::string LocksDataView::GetValue(int a_Row, int a_Column) {
+  const LockRow& row = GetLock(a_Row);
+
+  switch (a_Column) {
+    case COLUMN_ADDRESS:
+      return absl::StrFormat("0x%llx", row.lock.lock_address);
+    case COLUMN_WAITS:
+      return absl::StrFormat("%u", row.lock.wait_count);
+    case COLUMN_TOTAL_WAIT:
+      return GetPrettyTime(absl::Nanoseconds(row.lock.total_wait_duration_ns));
+    case COLUMN_MAX_WAIT:
+      return GetPrettyTime(absl::Nanoseconds(row.lock.max_wait_duration_ns));
+    case COLUMN_CALL_SITE:
+      return row.call_site;
+    default:
+      return "";
+  }
+}
+
+//-----------------------------------------------------------------------------
+#define ORBIT_LOCK_SORT(Member)                                   \
+  [&](int a, int b) {                                             \
+    return OrbitUtils::Compare(locks[a].Member, locks[b].Member, \
+                               ascending);                        \
+  }
+
+//-----------------------------------------------------------------------------
+void LocksDataView::DoSort() {
+  bool ascending = m_SortingOrders[m_SortingColumn] == SortingOrder::Ascending;
+  std::function<bool(int a, int b)> sorter = nullptr;
+
+  const std::vector<LockRow>& locks = locks_;
+
+  switch (m_SortingColumn) {
+    case COLUMN_ADDRESS:
+      sorter = ORBIT_LOCK_SORT(lock.lock_address);
+      break;
+    case COLUMN_WAITS:
+      sorter = ORBIT_LOCK_SORT(lock.wait_count);
+      break;
+    case COLUMN_TOTAL_WAIT:
+      sorter = ORBIT_LOCK_SORT(lock.total_wait_duration_ns);
+      break;
+    case COLUMN_MAX_WAIT:
+      sorter = ORBIT_LOCK_SORT(lock.max_wait_duration_ns);
+      break;
+    case COLUMN_CALL_SITE:
+      sorter = ORBIT_LOCK_SORT(call_site);
+      break;
+    default:
+      break;
+  }
+
+  if (sorter) {
+    std::stable_sort(indices_.begin(), indices_.end(), sorter);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void LocksDataView::DoFilter() {
+  std::vector<uint32_t> indices;
+
+  std::vector<std::string> tokens = absl::StrSplit(ToLower(m_Filter), ' ');
+
+  for (size_t i = 0; i < locks_.size(); ++i) {
+    std::string call_site = ToLower(locks_[i].call_site);
+
+    bool match = true;
+
+    for (std::string& filter_token : tokens) {
+      if (call_site.find(filter_token) == std::string::npos) {
+        match = false;
+        break;
+      }
+    }
+
+    if (match) {
+      indices.push_back(i);
+    }
+  }
+
+  indices_ = indices;
+
+  OnSort(m_SortingColumn, {});
+}
+
+//-----------------------------------------------------------------------------
+void LocksDataView::OnDataChanged() {
+  locks_.clear();
+  for (const LockContentionIndex::Lock& lock :
+       GOrbitApp->GetMostContendedLocks(MAX_LOCK_COUNT)) {
+    locks_.push_back({lock, GetCallSite(lock.top_callstack_id)});
+  }
+
+  indices_.resize(locks_.size());
+  for (size_t i = 0; i < locks_.size(); ++i) {
+    indices_[i] = i;
+  }
+
+  DataView::OnDataChanged();
+}
+
+//-----------------------------------------------------------------------------
+void LocksDataView::OnTimer() {
+  if (Capture::IsCapturing()) {
+    OnDataChanged();
+  }
+}
+
+//-----------------------------------------------------------------------------
+std::string LocksDataView::GetCallSite(CallstackID callstack_id) {
+  if (Capture::GSamplingProfiler == nullptr) {
+    return "";
+  }
+  std::shared_ptr<CallStack> callstack =
+      Capture::GSamplingProfiler->GetCallStack(callstack_id);
+  if (callstack == nullptr || callstack->m_Data.empty()) {
+    return "";
+  }
+
+  // The first frame outside of the module of the wait, or else the innermost.
+  uint64_t address = callstack->m_Data[0];
+  FunctionInfo* function = nullptr;
+  if (Capture::GTargetProcess != nullptr) {
+    ScopeLock lock(Capture::GTargetProcess->GetDataMutex());
+    std::shared_ptr<Module> wait_module =
+        Capture::GTargetProcess->GetModuleFromAddress(address);
+    for (uint64_t pc : callstack->m_Data) {
+      if (Capture::GTargetProcess->GetModuleFromAddress(pc) != wait_module) {
+        address = pc;
+        break;
+      }
+    }
+    function = Capture::GTargetProcess->GetFunctionFromAddress(address, false);
+  }
+
+  if (function != nullptr) {
+    return FunctionUtils::GetDisplayName(*function);
+  }
+  auto name_it = Capture::GAddressToFunctionName.find(address);
+  if (name_it != Capture::GAddressToFunctionName.end()) {
+    return name_it->second;
+  }
+  return absl::StrFormat("0x%llx", address);
+}
+
+//-----------------------------------------------------------------------------
+const LocksDataView::LockRow& LocksDataView::GetLock(unsigned int a_Row) const {
+  return locks_[indices_[a_Row]];
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_LOCKS_DATA_VIEW_H_
+#define ORBIT_GL_LOCKS_DATA_VIEW_H_
+
+#include <string>
+#include <vector>
+
+#include "DataView.h"
+#include "LockContentionIndex.h"
+
+// The locks the target process waited on the longest, from the lock
+// contention stats of the capture, refreshed while capturing.
+class LocksDataView : public DataView {
+ public:
+  LocksDataView();
+
+  const std::vector<Column>& GetColumns() override;
+  int GetDefaultSortingColumn() override { return COLUMN_TOTAL_WAIT; }
+  std::string GetValue(int a_Row, int a_Column) override;
+
+  void OnDataChanged() override;
+  void OnTimer() override;
+
+ protected:
+  void DoSort() override;
+  void DoFilter() override;
+
+ private:
+  struct LockRow {
+    LockContentionIndex::Lock lock;
+    // The function of the callstack with the longest wait on the lock that
+    // called into the module of the innermost frame, e.g., of libpthread.
+    std::string call_site;
+  };
+
+  const LockRow& GetLock(unsigned int a_Row) const;
+  [[nodiscard]] static std::string GetCallSite(CallstackID callstack_id);
+
+  // The number of locks shown, the most contended ones.
+  static constexpr size_t MAX_LOCK_COUNT = 100;
+
+  std::vector<LockRow> locks_;
+
+  enum ColumnIndex {
+    COLUMN_ADDRESS,
+    COLUMN_WAITS,
+    COLUMN_TOTAL_WAIT,
+    COLUMN_MAX_WAIT,
+    COLUMN_CALL_SITE,
+    COLUMN_NUM
+  };
+};
+
+#endif  // ORBIT_GL_LOCKS_DATA_VIEW_H_
@@ -5,6 +5,7 @@
 #ifndef ORBIT_GL_PROCESS_DATA_H_
 #define ORBIT_GL_PROCESS_DATA_H_
 
+#include <algorithm>
 #include <utility>
 
 #include "ModuleData.h"
@@ -54,6 +55,41 @@ class ProcessData final {
     }
   }
 
+  // Applies the changes since the previous update instead of the whole list.
+  void UpdateModuleInfos(const std::vector<ModuleInfo>& changed_module_infos,
+                         const std::vector<uint64_t>& removed_address_starts) {
+    for (uint64_t address_start : removed_address_starts) {
+      current_module_list_.erase(
+          std::remove_if(current_module_list_.begin(),
+                         current_module_list_.end(),
+                         [address_start](const ModuleData* module) {
+                           return module->address_start() == address_start;
+                         }),
+          current_module_list_.end());
+    }
+    for (const ModuleInfo& info : changed_module_infos) {
+      uint64_t module_id = info.address_start();
+      auto it = modules_.find(module_id);
+      if (it == modules_.end()) {
+        auto [inserted_it, success] =
+            modules_.try_emplace(module_id, std::make_unique<ModuleData>(info));
+        CHECK(success);
+        current_module_list_.push_back(inserted_it->second.get());
+        continue;
+      }
+      it->second->SetModuleInfo(info);
+      if (std::find(current_module_list_.begin(), current_module_list_.end(),
+                    it->second.get()) == current_module_list_.end()) {
+        current_module_list_.push_back(it->second.get());
+      }
+    }
+    // In the order of the whole list.
+    std::sort(current_module_list_.begin(), current_module_list_.end(),
+              [](const ModuleData* a, const ModuleData* b) {
+                return a->address_start() < b->address_start();
+              });
+  }
+
   const std::vector<ModuleData*>& GetModules() const {
     return current_module_list_;
   }
@@ -0,0 +1,253 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "QueryDataView.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+#include "Capture.h"
+#include "FunctionUtils.h"
+#include "Profiling.h"
+#include "TimeGraph.h"
+#include "TimerChain.h"
+#include "Utils.h"
+#include "absl/strings/str_format.h"
+
+using orbit_client_protos::TimerInfo;
+
+//-----------------------------------------------------------------------------
+QueryDataView::QueryDataView() : DataView(DataViewType::QUERY) {}
+
+//-----------------------------------------------------------------------------
+const std::vector<DataView::Column>& QueryDataView::GetColumns() {
+  static const std::vector<Column> columns = [] {
+    std::vector<Column> columns;
+    columns.resize(COLUMN_NUM);
+    columns[COLUMN_KEY] = {"Group", .4f, SortingOrder::Ascending};
+    columns[COLUMN_COUNT] = {"Count", .0f, SortingOrder::Descending};
+    columns[COLUMN_TOTAL] = {"Total", .0f, SortingOrder::Descending};
+    columns[COLUMN_AVERAGE] = {"Average", .0f, SortingOrder::Descending};
+    columns[COLUMN_MIN] = {"Min", .0f, SortingOrder::Descending};
+    columns[COLUMN_MAX] = {"Max", .0f, SortingOrder::Descending};
+    return columns;
+  }();
+  return columns;
+}
+
+//-----------------------------------------------------------------------------
+std::string QueryDataView::GetValue(int a_Row, int a_Column) {
+  const QueryRow& row = GetRow(a_Row);
+  if (row.is_bucket && a_Column != COLUMN_KEY && a_Column != COLUMN_TOTAL) {
+    return "";
+  }
+
+  switch (a_Column) {
+    case COLUMN_KEY:
+      return row.key;
+    case COLUMN_COUNT:
+      return absl::StrFormat("%u", row.count);
+    case COLUMN_TOTAL:
+      return GetPrettyTime(absl::Nanoseconds(row.total_ns));
+    case COLUMN_AVERAGE:
+      return row.count == 0
+                 ? ""
+                 : GetPrettyTime(absl::Nanoseconds(row.total_ns / row.count));
+    case COLUMN_MIN:
+      return GetPrettyTime(absl::Nanoseconds(row.min_ns));
+    case COLUMN_MAX:
+      return GetPrettyTime(absl::Nanoseconds(row.max_ns));
+    default:
+      return "";
+  }
+}
+
+//-----------------------------------------------------------------------------
+#define ORBIT_QUERY_SORT(Member)                                \
+  [&](int a, int b) {                                           \
+    return OrbitUtils::Compare(rows[a].Member, rows[b].Member, \
+                               ascending);                      \
+  }
+
+//-----------------------------------------------------------------------------
+void QueryDataView::DoSort() {
+  bool ascending = m_SortingOrders[m_SortingColumn] == SortingOrder::Ascending;
+  std::function<bool(int a, int b)> sorter = nullptr;
+
+  const std::vector<QueryRow>& rows = rows_;
+
+  switch (m_SortingColumn) {
+    case COLUMN_KEY:
+      // The buckets of a histogram are sorted by time.
+      sorter = [&](int a, int b) {
+        if (rows[a].is_bucket) {
+          return OrbitUtils::Compare(rows[a].begin_ns, rows[b].begin_ns,
+                                     ascending);
+        }
+        return OrbitUtils::Compare(rows[a].key, rows[b].key, ascending);
+      };
+      break;
+    case COLUMN_COUNT:
+      sorter = ORBIT_QUERY_SORT(count);
+      break;
+    case COLUMN_TOTAL:
+      sorter = ORBIT_QUERY_SORT(total_ns);
+      break;
+    case COLUMN_AVERAGE:
+      sorter = [&](int a, int b) {
+        return OrbitUtils::Compare(
+            rows[a].count == 0 ? 0 : rows[a].total_ns / rows[a].count,
+            rows[b].count == 0 ? 0 : rows[b].total_ns / rows[b].count,
+            ascending);
+      };
+      break;
+    case COLUMN_MIN:
+      sorter = ORBIT_QUERY_SORT(min_ns);
+      break;
+    case COLUMN_MAX:
+      sorter = ORBIT_QUERY_SORT(max_ns);
+      break;
+    default:
+      break;
+  }
+
+  if (sorter) {
+    std::stable_sort(indices_.begin(), indices_.end(), sorter);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void QueryDataView::DoFilter() {
+  rows_.clear();
+
+  ErrorMessageOr<TimerQuery> query =
+      ParseTimerQuery(m_Filter, time_origin_ns_, &FindFunctions);
+  if (query.has_error()) {
+    QueryRow row;
+    row.key = query.error().message();
+    rows_.push_back(std::move(row));
+  } else {
+    const TimerQueryResult result = timer_table_.Run(query.value());
+    if (query.value().bucket_count > 0) {
+      for (size_t i = 0; i < result.bucket_total_ns.size(); ++i) {
+        QueryRow row;
+        row.is_bucket = true;
+        row.begin_ns = result.bucket_begin_ns + i * result.bucket_width_ns;
+        row.key =
+            GetPrettyTime(TicksToDuration(time_origin_ns_, row.begin_ns));
+        row.total_ns = result.bucket_total_ns[i];
+        rows_.push_back(std::move(row));
+      }
+    } else {
+      for (const TimerQueryResult::Group& group : result.groups) {
+        QueryRow row;
+        switch (query.value().group_by) {
+          case TimerQuery::GroupBy::kNone:
+            row.key = "All";
+            break;
+          case TimerQuery::GroupBy::kFunction:
+            row.key = GetFunctionName(group.key);
+            break;
+          case TimerQuery::GroupBy::kCaller:
+            row.key = group.key == 0 ? "None" : GetFunctionName(group.key);
+            break;
+          case TimerQuery::GroupBy::kThread:
+            row.key = absl::StrFormat("%d", static_cast<int32_t>(group.key));
+            break;
+          case TimerQuery::GroupBy::kDepth:
+            row.key = absl::StrFormat("%u", group.key);
+            break;
+        }
+        row.count = group.count;
+        row.total_ns = group.total_ns;
+        row.min_ns = group.min_ns;
+        row.max_ns = group.max_ns;
+        rows_.push_back(std::move(row));
+      }
+    }
+  }
+
+  indices_.resize(rows_.size());
+  for (size_t i = 0; i < rows_.size(); ++i) {
+    indices_[i] = i;
+  }
+
+  OnSort(m_SortingColumn, {});
+}
+
+//-----------------------------------------------------------------------------
+void QueryDataView::OnDataChanged() {
+  // Copying the timers of a long capture takes a moment: while capturing,
+  // only on refresh.
+  if (!Capture::IsCapturing()) {
+    UpdateTimerTable();
+  }
+  DoFilter();
+  DataView::OnDataChanged();
+}
+
+//-----------------------------------------------------------------------------
+void QueryDataView::OnRefreshButtonClicked() {
+  UpdateTimerTable();
+  DoFilter();
+  DataView::OnDataChanged();
+}
+
+//-----------------------------------------------------------------------------
+void QueryDataView::UpdateTimerTable() {
+  timer_table_.Clear();
+  if (GCurrentTimeGraph == nullptr) {
+    return;
+  }
+  time_origin_ns_ = GCurrentTimeGraph->GetCaptureMin();
+  timer_table_.Reserve(GCurrentTimeGraph->GetNumTimers());
+  for (const std::shared_ptr<TimerChain>& chain :
+       GCurrentTimeGraph->GetAllThreadTrackTimerChains()) {
+    if (!chain) continue;
+    for (TimerChainIterator it = chain->begin(); it != chain->end(); ++it) {
+      TimerBlock& block = *it;
+      for (size_t i = 0; i < block.size(); ++i) {
+        const TimerInfo& timer_info = block[i].GetTimerInfo();
+        if (timer_info.type() == TimerInfo::kNone &&
+            timer_info.function_address() != 0) {
+          timer_table_.Add(timer_info);
+        }
+      }
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+std::string QueryDataView::GetFunctionName(uint64_t absolute_address) {
+  auto function_it = Capture::GSelectedFunctionsMap.find(absolute_address);
+  if (function_it != Capture::GSelectedFunctionsMap.end()) {
+    return FunctionUtils::GetDisplayName(*function_it->second);
+  }
+  auto name_it = Capture::GAddressToFunctionName.find(absolute_address);
+  if (name_it != Capture::GAddressToFunctionName.end()) {
+    return name_it->second;
+  }
+  return absl::StrFormat("0x%llx", absolute_address);
+}
+
+//-----------------------------------------------------------------------------
+std::vector<uint64_t> QueryDataView::FindFunctions(const std::string& name) {
+  std::vector<uint64_t> addresses;
+  for (const auto& [absolute_address, function] :
+       Capture::GSelectedFunctionsMap) {
+    const std::string display_name = FunctionUtils::GetDisplayName(*function);
+    if (display_name == name || function->name() == name ||
+        display_name.substr(0, display_name.find('(')) == name) {
+      addresses.push_back(absolute_address);
+    }
+  }
+  return addresses;
+}
+
+//-----------------------------------------------------------------------------
+const QueryDataView::QueryRow& QueryDataView::GetRow(
+    unsigned int a_Row) const {
+  return rows_[indices_[a_Row]];
+}
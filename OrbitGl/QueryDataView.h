@@ -0,0 +1,70 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_QUERY_DATA_VIEW_H_
+#define ORBIT_GL_QUERY_DATA_VIEW_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DataView.h"
+#include "TimerTable.h"
+
+// The result of a query over the calls of the instrumented functions of the
+// capture: the filter is the query, in the syntax of ParseTimerQuery with
+// times relative to the start of the capture, and each row is a group of
+// calls, or a bucket of the histogram for a query with buckets. The calls are
+// copied into a TimerTable when the capture changes, or on refresh while
+// capturing.
+class QueryDataView : public DataView {
+ public:
+  QueryDataView();
+
+  const std::vector<Column>& GetColumns() override;
+  int GetDefaultSortingColumn() override { return COLUMN_TOTAL; }
+  std::string GetValue(int a_Row, int a_Column) override;
+
+  void OnDataChanged() override;
+  bool HasRefreshButton() const override { return true; }
+  void OnRefreshButtonClicked() override;
+
+ protected:
+  void DoSort() override;
+  void DoFilter() override;
+
+ private:
+  struct QueryRow {
+    std::string key;
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t min_ns = 0;
+    uint64_t max_ns = 0;
+    // For the buckets of a histogram, which have no count, min and max.
+    bool is_bucket = false;
+    uint64_t begin_ns = 0;
+  };
+
+  const QueryRow& GetRow(unsigned int a_Row) const;
+  void UpdateTimerTable();
+  [[nodiscard]] static std::string GetFunctionName(uint64_t absolute_address);
+  [[nodiscard]] static std::vector<uint64_t> FindFunctions(
+      const std::string& name);
+
+  TimerTable timer_table_;
+  uint64_t time_origin_ns_ = 0;
+  std::vector<QueryRow> rows_;
+
+  enum ColumnIndex {
+    COLUMN_KEY,
+    COLUMN_COUNT,
+    COLUMN_TOTAL,
+    COLUMN_AVERAGE,
+    COLUMN_MIN,
+    COLUMN_MAX,
+    COLUMN_NUM
+  };
+};
+
+#endif  // ORBIT_GL_QUERY_DATA_VIEW_H_
@@ -0,0 +1,38 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ResolvedCallstackCache.h"
+
+const std::vector<ResolvedCallstackCache::Frame>&
+ResolvedCallstackCache::Resolve(CallStack* callstack, Process* process) {
+  const size_t module_count =
+      process != nullptr ? process->GetModules().size() : 0;
+  if (process != process_ || module_count != module_count_ ||
+      frames_by_callstack_.size() >= kMaxCallstackCount) {
+    frames_by_callstack_.clear();
+    process_ = process;
+    module_count_ = module_count;
+  }
+
+  auto [it, inserted] = frames_by_callstack_.try_emplace(callstack->Hash());
+  std::vector<Frame>& frames = it->second;
+  if (!inserted) {
+    return frames;
+  }
+
+  frames.resize(callstack->m_Data.size());
+  for (size_t i = 0; i < frames.size(); ++i) {
+    frames[i].address = callstack->m_Data[i];
+  }
+  if (process == nullptr) {
+    return frames;
+  }
+  // One lock for all the frames.
+  ScopeLock lock(process->GetDataMutex());
+  for (Frame& frame : frames) {
+    frame.function = process->GetFunctionFromAddress(frame.address, false);
+    frame.module = process->GetModuleFromAddress(frame.address);
+  }
+  return frames;
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_RESOLVED_CALLSTACK_CACHE_H_
+#define ORBIT_GL_RESOLVED_CALLSTACK_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Callstack.h"
+#include "OrbitModule.h"
+#include "OrbitProcess.h"
+#include "absl/container/flat_hash_map.h"
+#include "capture_data.pb.h"
+
+// The frames of the callstacks shown by the data views, resolved to their
+// function and module once per unique callstack instead of for every cell,
+// and shared by all the views. Only used from the main thread.
+//
+// The entries are for a process and its modules: they are dropped when the
+// process or its number of modules changes. Clear is to be called when
+// symbols are loaded, as the functions of the frames then change.
+class ResolvedCallstackCache {
+ public:
+  struct Frame {
+    uint64_t address = 0;
+    // Null if the module of the address has no symbols loaded.
+    orbit_client_protos::FunctionInfo* function = nullptr;
+    std::shared_ptr<Module> module;
+  };
+
+  // Resolves the frames of callstack the first time. The result is valid
+  // until the next call.
+  const std::vector<Frame>& Resolve(CallStack* callstack, Process* process);
+  void Clear() { frames_by_callstack_.clear(); }
+
+ private:
+  // Bounds the memory of the cache while browsing many callstacks.
+  static constexpr size_t kMaxCallstackCount = 4096;
+
+  const Process* process_ = nullptr;
+  size_t module_count_ = 0;
+  absl::flat_hash_map<CallstackID, std::vector<Frame>> frames_by_callstack_;
+};
+
+#endif  // ORBIT_GL_RESOLVED_CALLSTACK_CACHE_H_
@@ -0,0 +1,170 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "SamplingDiffDataView.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include "Utils.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+
+//-----------------------------------------------------------------------------
+SamplingDiffDataView::SamplingDiffDataView()
+    : DataView(DataViewType::SAMPLING_DIFF) {}
+
+//-----------------------------------------------------------------------------
+const std::vector<DataView::Column>& SamplingDiffDataView::GetColumns() {
+  static const std::vector<Column> columns = [] {
+    std::vector<Column> columns;
+    columns.resize(COLUMN_NUM);
+    columns[COLUMN_FUNCTION_NAME] = {"Name", .5f, SortingOrder::Ascending};
+    columns[COLUMN_INCLUSIVE_DELTA] = {"Inclusive Delta", .0f,
+                                       SortingOrder::Descending};
+    columns[COLUMN_EXCLUSIVE_DELTA] = {"Exclusive Delta", .0f,
+                                       SortingOrder::Descending};
+    columns[COLUMN_BASELINE_INCLUSIVE] = {"Baseline Inclusive", .0f,
+                                          SortingOrder::Descending};
+    columns[COLUMN_INCLUSIVE] = {"Inclusive", .0f, SortingOrder::Descending};
+    columns[COLUMN_BASELINE_EXCLUSIVE] = {"Baseline Exclusive", .0f,
+                                          SortingOrder::Descending};
+    columns[COLUMN_EXCLUSIVE] = {"Exclusive", .0f, SortingOrder::Descending};
+    columns[COLUMN_MODULE_NAME] = {"Module", .0f, SortingOrder::Ascending};
+    columns[COLUMN_ADDRESS] = {"Address", .0f, SortingOrder::Ascending};
+    return columns;
+  }();
+  return columns;
+}
+
+//-----------------------------------------------------------------------------
+std::string SamplingDiffDataView::GetValue(int a_Row, int a_Column) {
+  const SampledFunctionDiff& diff = GetDiff(a_Row);
+
+  switch (a_Column) {
+    case COLUMN_FUNCTION_NAME:
+      return diff.name;
+    case COLUMN_INCLUSIVE_DELTA:
+      return absl::StrFormat("%+.2f", diff.inclusive_delta());
+    case COLUMN_EXCLUSIVE_DELTA:
+      return absl::StrFormat("%+.2f", diff.exclusive_delta());
+    case COLUMN_BASELINE_INCLUSIVE:
+      return absl::StrFormat("%.2f", diff.baseline_inclusive);
+    case COLUMN_INCLUSIVE:
+      return absl::StrFormat("%.2f", diff.inclusive);
+    case COLUMN_BASELINE_EXCLUSIVE:
+      return absl::StrFormat("%.2f", diff.baseline_exclusive);
+    case COLUMN_EXCLUSIVE:
+      return absl::StrFormat("%.2f", diff.exclusive);
+    case COLUMN_MODULE_NAME:
+      return diff.module;
+    case COLUMN_ADDRESS:
+      return absl::StrFormat("%#llx", diff.address);
+    default:
+      return "";
+  }
+}
+
+//-----------------------------------------------------------------------------
+#define ORBIT_DIFF_SORT(Member)                                   \
+  [&](int a, int b) {                                             \
+    return OrbitUtils::Compare(diffs[a].Member, diffs[b].Member, \
+                               ascending);                        \
+  }
+
+//-----------------------------------------------------------------------------
+void SamplingDiffDataView::DoSort() {
+  bool ascending = m_SortingOrders[m_SortingColumn] == SortingOrder::Ascending;
+  std::function<bool(int a, int b)> sorter = nullptr;
+
+  const std::vector<SampledFunctionDiff>& diffs = diffs_;
+
+  switch (m_SortingColumn) {
+    case COLUMN_FUNCTION_NAME:
+      sorter = ORBIT_DIFF_SORT(name);
+      break;
+    case COLUMN_INCLUSIVE_DELTA:
+      sorter = ORBIT_DIFF_SORT(inclusive_delta());
+      break;
+    case COLUMN_EXCLUSIVE_DELTA:
+      sorter = ORBIT_DIFF_SORT(exclusive_delta());
+      break;
+    case COLUMN_BASELINE_INCLUSIVE:
+      sorter = ORBIT_DIFF_SORT(baseline_inclusive);
+      break;
+    case COLUMN_INCLUSIVE:
+      sorter = ORBIT_DIFF_SORT(inclusive);
+      break;
+    case COLUMN_BASELINE_EXCLUSIVE:
+      sorter = ORBIT_DIFF_SORT(baseline_exclusive);
+      break;
+    case COLUMN_EXCLUSIVE:
+      sorter = ORBIT_DIFF_SORT(exclusive);
+      break;
+    case COLUMN_MODULE_NAME:
+      sorter = ORBIT_DIFF_SORT(module);
+      break;
+    case COLUMN_ADDRESS:
+      sorter = ORBIT_DIFF_SORT(address);
+      break;
+    default:
+      break;
+  }
+
+  if (sorter) {
+    std::stable_sort(indices_.begin(), indices_.end(), sorter);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void SamplingDiffDataView::DoFilter() {
+  std::vector<uint32_t> indices;
+
+  std::vector<std::string> tokens = absl::StrSplit(ToLower(m_Filter), ' ');
+
+  for (size_t i = 0; i < diffs_.size(); ++i) {
+    const SampledFunctionDiff& diff = diffs_[i];
+    std::string name = ToLower(diff.name);
+    std::string module = ToLower(diff.module);
+
+    bool match = true;
+
+    for (std::string& filter_token : tokens) {
+      if (!(name.find(filter_token) != std::string::npos ||
+            module.find(filter_token) != std::string::npos)) {
+        match = false;
+        break;
+      }
+    }
+
+    if (match) {
+      indices.push_back(i);
+    }
+  }
+
+  indices_ = indices;
+
+  OnSort(m_SortingColumn, {});
+}
+
+//-----------------------------------------------------------------------------
+void SamplingDiffDataView::SetDiffs(std::vector<SampledFunctionDiff> diffs,
+                                    std::string label) {
+  diffs_ = std::move(diffs);
+  label_ = std::move(label);
+
+  indices_.resize(diffs_.size());
+  for (size_t i = 0; i < diffs_.size(); ++i) {
+    indices_[i] = i;
+  }
+
+  OnDataChanged();
+}
+
+//-----------------------------------------------------------------------------
+const SampledFunctionDiff& SamplingDiffDataView::GetDiff(
+    unsigned int a_Row) const {
+  return diffs_[indices_[a_Row]];
+}
@@ -0,0 +1,51 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_SAMPLING_DIFF_DATA_VIEW_H_
+#define ORBIT_GL_SAMPLING_DIFF_DATA_VIEW_H_
+
+#include <string>
+#include <vector>
+
+#include "DataView.h"
+#include "SamplingDiff.h"
+
+// Shows how the inclusive and exclusive percentages of the functions of a
+// sampling report differ from those of a baseline report, see
+// OrbitApp::SetSamplingDiffBaseline.
+class SamplingDiffDataView : public DataView {
+ public:
+  SamplingDiffDataView();
+
+  const std::vector<Column>& GetColumns() override;
+  int GetDefaultSortingColumn() override { return COLUMN_INCLUSIVE_DELTA; }
+  std::string GetValue(int a_Row, int a_Column) override;
+  std::string GetLabel() override { return label_; }
+
+  void SetDiffs(std::vector<SampledFunctionDiff> diffs, std::string label);
+
+ protected:
+  void DoSort() override;
+  void DoFilter() override;
+  const SampledFunctionDiff& GetDiff(unsigned int a_Row) const;
+
+ private:
+  std::vector<SampledFunctionDiff> diffs_;
+  std::string label_;
+
+  enum ColumnIndex {
+    COLUMN_FUNCTION_NAME,
+    COLUMN_INCLUSIVE_DELTA,
+    COLUMN_EXCLUSIVE_DELTA,
+    COLUMN_BASELINE_INCLUSIVE,
+    COLUMN_INCLUSIVE,
+    COLUMN_BASELINE_EXCLUSIVE,
+    COLUMN_EXCLUSIVE,
+    COLUMN_MODULE_NAME,
+    COLUMN_ADDRESS,
+    COLUMN_NUM
+  };
+};
+
+#endif  // ORBIT_GL_SAMPLING_DIFF_DATA_VIEW_H_
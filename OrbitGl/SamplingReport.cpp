@@ -35,21 +35,33 @@ void SamplingReport::FillReport() {
       continue;
 
     SamplingReportDataView threadReport;
-    threadReport.SetSampledFunctions(threadSampleData->m_SampleReport);
     threadReport.SetThreadID(tid);
     threadReport.SetSamplingReport(this);
     m_ThreadReports.push_back(std::move(threadReport));
   }
+
+  // By decreasing thread usage, the summary first.
+  thread_report_filled_.assign(m_ThreadReports.size(), false);
+  if (!m_ThreadReports.empty()) {
+    FillThreadReport(0);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void SamplingReport::FillThreadReport(size_t index) {
+  CHECK(index < m_ThreadReports.size());
+  SamplingReportDataView& thread_report = m_ThreadReports[index];
+  thread_report.SetSampledFunctions(
+      m_Profiler->GetThreadReport(thread_report.GetThreadID()));
+  thread_report_filled_[index] = true;
 }
 
+//-----------------------------------------------------------------------------
 void SamplingReport::UpdateReport() {
   m_Profiler->ProcessSamples();
-  for (SamplingReportDataView& thread_report : m_ThreadReports) {
-    int32_t thread_id = thread_report.GetThreadID();
-    const ThreadSampleData* thread_sample_data =
-        m_Profiler->GetThreadSampleDataByThreadId(thread_id);
-    if (thread_sample_data != nullptr) {
-      thread_report.SetSampledFunctions(thread_sample_data->m_SampleReport);
+  for (size_t i = 0; i < m_ThreadReports.size(); ++i) {
+    if (thread_report_filled_[i]) {
+      FillThreadReport(i);
     }
   }
 
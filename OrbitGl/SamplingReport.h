@@ -19,6 +19,12 @@ class SamplingReport {
 
   void FillReport();
   void UpdateReport();
+  // The reports of the threads are only filled when first shown, but the
+  // first one, the summary if there is one, which FillReport fills.
+  void FillThreadReport(size_t index);
+  [[nodiscard]] bool IsThreadReportFilled(size_t index) const {
+    return thread_report_filled_[index];
+  }
   std::shared_ptr<SamplingProfiler> GetProfiler() const { return m_Profiler; }
   std::vector<SamplingReportDataView>& GetThreadReports() {
     return m_ThreadReports;
@@ -41,6 +47,7 @@ class SamplingReport {
  protected:
   std::shared_ptr<SamplingProfiler> m_Profiler;
   std::vector<SamplingReportDataView> m_ThreadReports;
+  std::vector<bool> thread_report_filled_;
   CallStackDataView* m_CallstackDataView;
 
   uint64_t m_SelectedAddress;
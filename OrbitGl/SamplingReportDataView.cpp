@@ -66,6 +66,28 @@ std::string SamplingReportDataView::GetValue(int a_Row, int a_Column) {
   }
 }
 
+//-----------------------------------------------------------------------------
+DataView::NumericValue SamplingReportDataView::GetNumericValue(int row,
+                                                               int column) {
+  const SampledFunction& func = GetSampledFunction(row);
+
+  switch (column) {
+    case COLUMN_EXCLUSIVE:
+      return static_cast<double>(func.m_Exclusive);
+    case COLUMN_INCLUSIVE:
+      return static_cast<double>(func.m_Inclusive);
+    case COLUMN_LINE:
+      if (func.m_Line <= 0) {
+        return std::monostate{};
+      }
+      return int64_t{func.m_Line};
+    case COLUMN_ADDRESS:
+      return func.m_Address;
+    default:
+      return std::monostate{};
+  }
+}
+
 //-----------------------------------------------------------------------------
 #define ORBIT_PROC_SORT(Member)                                          \
   [&](int a, int b) {                                                    \
@@ -174,6 +196,8 @@ const std::string SamplingReportDataView::MENU_ACTION_MODULES_LOAD =
     "Load Symbols";
 const std::string SamplingReportDataView::MENU_ACTION_DISASSEMBLY =
     "Go to Disassembly";
+const std::string SamplingReportDataView::MENU_ACTION_SET_DIFF_BASELINE =
+    "Use as Diff Baseline";
 
 //-----------------------------------------------------------------------------
 std::vector<std::string> SamplingReportDataView::GetContextMenu(
@@ -203,6 +227,7 @@ std::vector<std::string> SamplingReportDataView::GetContextMenu(
   if (enable_unselect) menu.emplace_back(MENU_ACTION_UNSELECT);
   if (enable_load) menu.emplace_back(MENU_ACTION_MODULES_LOAD);
   if (enable_disassembly) menu.emplace_back(MENU_ACTION_DISASSEMBLY);
+  menu.emplace_back(MENU_ACTION_SET_DIFF_BASELINE);
   Append(menu, DataView::GetContextMenu(a_ClickedIndex, a_SelectedIndices));
   return menu;
 }
@@ -215,10 +240,12 @@ void SamplingReportDataView::OnContextMenu(
     for (FunctionInfo* function : GetFunctionsFromIndices(a_ItemIndices)) {
       FunctionUtils::Select(function);
     }
+    GOrbitApp->UpdateInstrumentedFunctions();
   } else if (a_Action == MENU_ACTION_UNSELECT) {
     for (FunctionInfo* function : GetFunctionsFromIndices(a_ItemIndices)) {
       FunctionUtils::UnSelect(function);
     }
+    GOrbitApp->UpdateInstrumentedFunctions();
   } else if (a_Action == MENU_ACTION_MODULES_LOAD) {
     std::vector<std::shared_ptr<Module>> modules;
     for (const auto& module : GetModulesFromIndices(a_ItemIndices)) {
@@ -229,9 +256,13 @@ void SamplingReportDataView::OnContextMenu(
     GOrbitApp->LoadModules(Capture::GTargetProcess->GetID(), modules);
   } else if (a_Action == MENU_ACTION_DISASSEMBLY) {
     int32_t pid = Capture::GTargetProcess->GetID();
+    std::vector<FunctionInfo> functions;
     for (FunctionInfo* function : GetFunctionsFromIndices(a_ItemIndices)) {
-      GOrbitApp->Disassemble(pid, *function);
+      functions.push_back(*function);
     }
+    GOrbitApp->Disassemble(pid, std::move(functions));
+  } else if (a_Action == MENU_ACTION_SET_DIFF_BASELINE) {
+    GOrbitApp->SetSamplingDiffBaseline(m_Functions, m_TID);
   } else {
     DataView::OnContextMenu(a_Action, a_MenuIndex, a_ItemIndices);
   }
@@ -17,6 +17,7 @@ class SamplingReportDataView : public DataView {
   std::vector<std::string> GetContextMenu(
       int a_ClickedIndex, const std::vector<int>& a_SelectedIndices) override;
   std::string GetValue(int a_Row, int a_Column) override;
+  NumericValue GetNumericValue(int row, int column) override;
   const std::string& GetName() { return m_Name; }
 
   void OnContextMenu(const std::string& a_Action, int a_MenuIndex,
@@ -64,4 +65,5 @@ class SamplingReportDataView : public DataView {
   static const std::string MENU_ACTION_UNSELECT;
   static const std::string MENU_ACTION_MODULES_LOAD;
   static const std::string MENU_ACTION_DISASSEMBLY;
+  static const std::string MENU_ACTION_SET_DIFF_BASELINE;
 };
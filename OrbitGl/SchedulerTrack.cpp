@@ -4,6 +4,8 @@
 
 #include "SchedulerTrack.h"
 
+#include <cmath>
+
 #include "Capture.h"
 #include "EventTrack.h"
 #include "FunctionUtils.h"
@@ -19,6 +21,104 @@ const Color kSelectionColor(0, 128, 255, 255);
 SchedulerTrack::SchedulerTrack(TimeGraph* time_graph)
     : TimerTrack(time_graph) {}
 
+void SchedulerTrack::Draw(GlCanvas* canvas, PickingMode picking_mode) {
+  TimerTrack::Draw(canvas, picking_mode);
+  if (picking_mode == PickingMode::kNone && DrawsOccupancy()) {
+    DrawOccupancy(canvas);
+  }
+}
+
+const TextBox* SchedulerTrack::OnCoreActivityTimer(TimerInfo timer_info) {
+  {
+    ScopeLock lock(mutex_);
+    auto it = occupancy_by_core_
+                  .try_emplace(timer_info.processor(), CORE_OCCUPANCY_BUCKET_NS)
+                  .first;
+    it->second.AddSlice(timer_info.start(), timer_info.end());
+  }
+  return OnTimer(std::move(timer_info));
+}
+
+void SchedulerTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
+                                      PickingMode picking_mode) {
+  // The occupancy is drawn on each frame instead.
+  if (DrawsOccupancy()) return;
+  TimerTrack::UpdatePrimitives(min_tick, max_tick, picking_mode);
+}
+
+void SchedulerTrack::UpdateNewPrimitives(uint64_t min_tick,
+                                         uint64_t max_tick) {
+  if (DrawsOccupancy()) return;
+  TimerTrack::UpdateNewPrimitives(min_tick, max_tick);
+}
+
+bool SchedulerTrack::DrawsTimerInstances() const {
+  return !DrawsOccupancy() && TimerTrack::DrawsTimerInstances();
+}
+
+bool SchedulerTrack::DrawsOccupancy() const {
+  GlCanvas* canvas = time_graph_->GetCanvas();
+  if (canvas == nullptr || canvas->getWidth() <= 0) return false;
+  const uint64_t pixel_delta_in_ticks =
+      static_cast<uint64_t>(
+          MicrosecondsToTicks(time_graph_->GetTimeWindowUs())) /
+      canvas->getWidth();
+  return pixel_delta_in_ticks >= CORE_OCCUPANCY_BUCKET_NS;
+}
+
+// Each core is drawn as a bar whose height in each pixel is the fraction of
+// the pixel the core was busy. The heights are rounded to a few steps, so that
+// runs of pixels of the same height are drawn as one box.
+void SchedulerTrack::DrawOccupancy(GlCanvas* canvas) {
+  const Color kOccupancyColor(100, 181, 246, 255);
+  Batcher* batcher = canvas->GetBatcher();
+  UpdateBoxHeight();
+
+  const uint64_t min_tick =
+      time_graph_->GetTickFromUs(time_graph_->GetMinTimeUs());
+  const uint64_t max_tick =
+      time_graph_->GetTickFromUs(time_graph_->GetMaxTimeUs());
+  const int width = canvas->getWidth();
+  if (max_tick <= min_tick || width <= 0) return;
+  const double ticks_per_pixel =
+      static_cast<double>(max_tick - min_tick) / width;
+  const float world_per_pixel = canvas->GetWorldWidth() / width;
+  const float world_start_x = canvas->GetWorldTopLeftX();
+  constexpr float kHeightSteps = 16.f;
+
+  ScopeLock lock(mutex_);
+  for (const auto& [core, occupancy] : occupancy_by_core_) {
+    const float y = GetYFromDepth(core);
+    int run_begin = 0;
+    float run_height = 0;
+    auto draw_run = [&](int run_end) {
+      if (run_height <= 0) return;
+      const float x = world_start_x + run_begin * world_per_pixel;
+      Box box(Vec2(x, y), Vec2((run_end - run_begin) * world_per_pixel,
+                               run_height),
+              GlCanvas::Z_VALUE_BOX_ACTIVE);
+      batcher->AddBox(box, kOccupancyColor, PickingID::BOX);
+    };
+
+    for (int pixel = 0; pixel < width; ++pixel) {
+      const uint64_t begin =
+          min_tick + static_cast<uint64_t>(pixel * ticks_per_pixel);
+      const uint64_t end =
+          min_tick + static_cast<uint64_t>((pixel + 1) * ticks_per_pixel);
+      const double value = occupancy.GetOccupancy(begin, end);
+      const float height =
+          std::round(static_cast<float>(value) * kHeightSteps) /
+          kHeightSteps * box_height_;
+      if (height != run_height) {
+        draw_run(pixel);
+        run_begin = pixel;
+        run_height = height;
+      }
+    }
+    draw_run(width);
+  }
+}
+
 float SchedulerTrack::GetHeight() const {
   TimeGraphLayout& layout = time_graph_->GetLayout();
   uint32_t num_gaps = depth_ > 0 ? depth_ - 1 : 0;
@@ -60,8 +160,7 @@ void SchedulerTrack::UpdateBoxHeight() {
   box_height_ = time_graph_->GetLayout().GetTextCoresHeight();
 }
 
-std::string SchedulerTrack::GetBoxTooltip(PickingID id) const {
-  TextBox* text_box = time_graph_->GetBatcher().GetTextBox(id);
+std::string SchedulerTrack::GetBoxTooltip(const TextBox* text_box) const {
   if (!text_box) {
     return "";
   }
@@ -72,6 +171,6 @@ std::string SchedulerTrack::GetBoxTooltip(PickingID id) const {
       "<b>Core:</b> %d<br/>"
       "<b>Thread:</b> %s [%d]<br/>",
       text_box->GetTimerInfo().processor(),
-      Capture::GThreadNames[text_box->GetTimerInfo().thread_id()],
+      Capture::GCaptureData.GetThreadName(text_box->GetTimerInfo().thread_id()),
       text_box->GetTimerInfo().thread_id());
 }
@@ -5,14 +5,29 @@
 #ifndef ORBIT_GL_SCHEDULER_TRACK_H_
 #define ORBIT_GL_SCHEDULER_TRACK_H_
 
+#include <map>
+
+#include "OccupancyPyramid.h"
 #include "TimerTrack.h"
 #include "capture_data.pb.h"
 
+// The scheduling slices of each core, at the depth of the core. When a pixel
+// spans at least a bucket of the occupancy pyramids of the cores, the track
+// shows how busy each core is instead of the slices, as there are too many of
+// them to draw.
 class SchedulerTrack : public TimerTrack {
  public:
   explicit SchedulerTrack(TimeGraph* time_graph);
   ~SchedulerTrack() override = default;
 
+  void Draw(GlCanvas* canvas, PickingMode picking_mode) override;
+  // Also adds the slice to the occupancy of its core.
+  const TextBox* OnCoreActivityTimer(
+      orbit_client_protos::TimerInfo timer_info);
+  void UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
+                        PickingMode picking_mode) override;
+  void UpdateNewPrimitives(uint64_t min_tick, uint64_t max_tick) override;
+
   [[nodiscard]] Type GetType() const override { return kSchedulerTrack; }
   [[nodiscard]] std::string GetTooltip() const override;
 
@@ -27,7 +42,17 @@ class SchedulerTrack : public TimerTrack {
       const orbit_client_protos::TimerInfo& timer_info) const override;
   [[nodiscard]] Color GetTimerColor(const orbit_client_protos::TimerInfo& timer_info,
                       bool is_selected) const override;
-  [[nodiscard]] std::string GetBoxTooltip(PickingID id) const override;
+  [[nodiscard]] std::string GetBoxTooltip(
+      const TextBox* text_box) const override;
+  [[nodiscard]] bool DrawsTimerInstances() const override;
+
+ private:
+  static constexpr uint64_t CORE_OCCUPANCY_BUCKET_NS = 1'000'000;
+
+  [[nodiscard]] bool DrawsOccupancy() const;
+  void DrawOccupancy(GlCanvas* canvas);
+
+  std::map<int32_t, OccupancyPyramid> occupancy_by_core_;
 };
 
 #endif  // ORBIT_GL_SCHEDULER_TRACK_H_
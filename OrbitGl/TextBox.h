@@ -5,6 +5,8 @@
 #ifndef ORBIT_GL_TEXT_BOX_H_
 #define ORBIT_GL_TEXT_BOX_H_
 
+#include <utility>
+
 #include "BaseTypes.h"
 #include "Batcher.h"
 #include "CoreMath.h"
@@ -73,8 +75,8 @@ class TextBox {
   const std::string& GetText() const { return m_Text; }
   void SetText(const std::string& a_Text) { m_Text = a_Text; }
 
-  void SetTimerInfo(const orbit_client_protos::TimerInfo& timer_info) {
-    timer_info_ = timer_info;
+  void SetTimerInfo(orbit_client_protos::TimerInfo timer_info) {
+    timer_info_ = std::move(timer_info);
   }
   const orbit_client_protos::TimerInfo& GetTimerInfo() const {
     return timer_info_;
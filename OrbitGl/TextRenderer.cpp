@@ -44,24 +44,8 @@ TextRenderer::~TextRenderer() {
 void TextRenderer::Init() {
   if (m_Initialized) return;
 
-  m_Font = NULL;
-  int atlasSize = 2 * 1024;
-  m_Atlas = texture_atlas_new(atlasSize, atlasSize, 1);
-
+  InitFonts();
   const auto exePath = Path::GetExecutablePath();
-  const auto fontFileName = exePath + "fonts/Vera.ttf";
-
-  static float fsize = GParams.font_size;
-  m_Buffer = vertex_buffer_new("vertex:3f,tex_coord:2f,color:4f");
-  m_Font = texture_font_new_from_file(m_Atlas, fsize, fontFileName.c_str());
-  current_font_size_ = static_cast<int>(fsize);
-  for (int i = 10; i <= 100; i += 1) {
-    m_FontsBySize[i] =
-        texture_font_new_from_file(m_Atlas, i, fontFileName.c_str());
-  }
-
-  m_Pen.x = 0;
-  m_Pen.y = 0;
 
   glGenTextures(1, &m_Atlas->id);
 
@@ -77,9 +61,41 @@ void TextRenderer::Init() {
   m_Initialized = true;
 }
 
+//-----------------------------------------------------------------------------
+bool TextRenderer::InitFonts() {
+  if (m_Atlas != NULL) return m_Font != NULL;
+
+  int atlasSize = 2 * 1024;
+  m_Atlas = texture_atlas_new(atlasSize, atlasSize, 1);
+
+  const auto exePath = Path::GetExecutablePath();
+  font_file_name_ = exePath + "fonts/Vera.ttf";
+
+  static float fsize = GParams.font_size;
+  m_Buffer = vertex_buffer_new("vertex:3f,tex_coord:2f,color:4f");
+  m_Font = texture_font_new_from_file(m_Atlas, fsize, font_file_name_.c_str());
+  current_font_size_ = static_cast<int>(fsize);
+
+  m_Pen.x = 0;
+  m_Pen.y = 0;
+  return m_Font != NULL;
+}
+
 //-----------------------------------------------------------------------------
 void TextRenderer::SetFontSize(int size) {
-  texture_font_t* font = m_FontsBySize[size];
+  // Loading a font parses the font file, so the other sizes are only loaded
+  // when they are first used.
+  auto font_it = m_FontsBySize.find(size);
+  if (font_it == m_FontsBySize.end()) {
+    if (m_Atlas == NULL || size < kMinFontSize || size > kMaxFontSize) {
+      return;
+    }
+    font_it = m_FontsBySize
+                  .emplace(size, texture_font_new_from_file(
+                                     m_Atlas, size, font_file_name_.c_str()))
+                  .first;
+  }
+  texture_font_t* font = font_it->second;
   if (font) {
     m_Font = font;
     current_font_size_ = size;
@@ -120,6 +136,7 @@ void TextRenderer::Display(Batcher* batcher) {
 
   mat4_set_orthographic(&m_Proj, 0, m_Canvas->getWidth(), 0,
                         m_Canvas->getHeight(), -1, 1);
+  mat4_set_translation(&m_View, ToScreenSpace(world_offset_x_), 0, 0);
 
   glUseProgram(m_Shader);
   {
@@ -171,56 +188,117 @@ void TextRenderer::DrawOutline(Batcher* batcher, vertex_buffer_t* a_Buffer) {
 }
 
 //-----------------------------------------------------------------------------
-void TextRenderer::AddTextInternal(texture_font_t* font, const char* text,
-                                   const vec4& color, vec2* pen,
-                                   float a_MaxSize, float a_Z, bool) {
-  size_t i;
-  float r = color.red, g = color.green, b = color.blue, a = color.alpha;
-  float textZ = a_Z;
-
-  float maxWidth = a_MaxSize == -1.f ? FLT_MAX : ToScreenSpace(a_MaxSize);
-  float strWidth = 0.f;
-  int minX = INT_MAX;
-  int maxX = -INT_MAX;
-
-  for (i = 0; i < strlen(text); ++i) {
+void TextRenderer::LayOutText(texture_font_t* font, const char* text,
+                              TextLayout* layout) {
+  layout->glyphs.clear();
+  float pen_x = 0.f;
+  const size_t text_length = strlen(text);
+  for (size_t i = 0; i < text_length; ++i) {
     if (!texture_font_find_glyph(font, text + i)) {
       texture_font_load_glyph(font, text + i);
     }
 
     texture_glyph_t* glyph = texture_font_get_glyph(font, text + i);
     if (glyph != NULL) {
-      float kerning = 0.0f;
       if (i > 0) {
-        kerning = texture_glyph_get_kerning(glyph, text + i - 1);
-      }
-      pen->x += kerning;
-      float x0 = static_cast<int>(pen->x + glyph->offset_x);
-      float y0 = static_cast<int>(pen->y + glyph->offset_y);
-      float x1 = static_cast<int>(x0 + glyph->width);
-      float y1 = static_cast<int>(y0 - glyph->height);
-      float s0 = glyph->s0;
-      float t0 = glyph->t0;
-      float s1 = glyph->s1;
-      float t1 = glyph->t1;
-      GLuint indices[6] = {0, 1, 2, 0, 2, 3};
-      vertex_t vertices[4] = {{x0, y0, textZ, s0, t0, r, g, b, a},
-                              {x0, y1, textZ, s0, t1, r, g, b, a},
-                              {x1, y1, textZ, s1, t1, r, g, b, a},
-                              {x1, y0, textZ, s1, t0, r, g, b, a}};
-
-      minX = std::min(minX, static_cast<int>(x0));
-      maxX = std::max(maxX, static_cast<int>(x1));
-      strWidth = maxX - minX;
-
-      if (strWidth > maxWidth) {
-        break;
+        pen_x += texture_glyph_get_kerning(glyph, text + i - 1);
       }
+      layout->glyphs.push_back({glyph, pen_x, i});
+      pen_x += glyph->advance_x;
+    }
+  }
+  layout->advance_x = pen_x;
+}
 
-      vertex_buffer_push_back(m_Buffer, vertices, 4, indices, 6);
-      pen->x += glyph->advance_x;
+//-----------------------------------------------------------------------------
+const TextRenderer::TextLayout& TextRenderer::GetTextLayout(
+    texture_font_t* font, const char* text) {
+  // Labels contain durations, so the cache is bounded rather than growing
+  // with every label ever drawn.
+  constexpr size_t kMaxTextLayoutCount = 64 * 1024;
+
+  absl::flat_hash_map<std::string, TextLayout>& layouts = text_layouts_[font];
+  auto it = layouts.find(absl::string_view(text));
+  if (it != layouts.end()) {
+    return it->second;
+  }
+
+  if (text_layout_count_ >= kMaxTextLayoutCount) {
+    for (auto& pair : text_layouts_) {
+      pair.second.clear();
     }
+    text_layout_count_ = 0;
   }
+  ++text_layout_count_;
+  TextLayout& layout = layouts[text];
+  LayOutText(font, text, &layout);
+  return layout;
+}
+
+//-----------------------------------------------------------------------------
+size_t TextRenderer::GetFittingCharsCount(const TextLayout& layout,
+                                          float pen_x, float max_width,
+                                          size_t text_length) {
+  int min_x = INT_MAX;
+  int max_x = -INT_MAX;
+  for (const GlyphPosition& position : layout.glyphs) {
+    const texture_glyph_t* glyph = position.glyph;
+    int x0 = static_cast<int>(pen_x + position.pen_x + glyph->offset_x);
+    int x1 = static_cast<int>(x0 + glyph->width);
+    min_x = std::min(min_x, x0);
+    max_x = std::max(max_x, x1);
+    if (static_cast<float>(max_x - min_x) > max_width) {
+      return position.char_index;
+    }
+  }
+  return text_length;
+}
+
+//-----------------------------------------------------------------------------
+size_t TextRenderer::AddTextLayout(const TextLayout& layout, const vec4& color,
+                                   vec2* pen, float max_width, float z,
+                                   size_t text_length) {
+  float r = color.red, g = color.green, b = color.blue, a = color.alpha;
+  int min_x = INT_MAX;
+  int max_x = -INT_MAX;
+
+  for (const GlyphPosition& position : layout.glyphs) {
+    const texture_glyph_t* glyph = position.glyph;
+    float x0 = static_cast<int>(pen->x + position.pen_x + glyph->offset_x);
+    float y0 = static_cast<int>(pen->y + glyph->offset_y);
+    float x1 = static_cast<int>(x0 + glyph->width);
+    float y1 = static_cast<int>(y0 - glyph->height);
+
+    min_x = std::min(min_x, static_cast<int>(x0));
+    max_x = std::max(max_x, static_cast<int>(x1));
+    if (static_cast<float>(max_x - min_x) > max_width) {
+      pen->x += position.pen_x;
+      return position.char_index;
+    }
+
+    float s0 = glyph->s0;
+    float t0 = glyph->t0;
+    float s1 = glyph->s1;
+    float t1 = glyph->t1;
+    GLuint indices[6] = {0, 1, 2, 0, 2, 3};
+    vertex_t vertices[4] = {{x0, y0, z, s0, t0, r, g, b, a},
+                            {x0, y1, z, s0, t1, r, g, b, a},
+                            {x1, y1, z, s1, t1, r, g, b, a},
+                            {x1, y0, z, s1, t0, r, g, b, a}};
+    vertex_buffer_push_back(m_Buffer, vertices, 4, indices, 6);
+  }
+
+  pen->x += layout.advance_x;
+  return text_length;
+}
+
+//-----------------------------------------------------------------------------
+void TextRenderer::AddTextInternal(texture_font_t* font, const char* text,
+                                   const vec4& color, vec2* pen,
+                                   float a_MaxSize, float a_Z, bool) {
+  float maxWidth = a_MaxSize == -1.f ? FLT_MAX : ToScreenSpace(a_MaxSize);
+  AddTextLayout(GetTextLayout(font, text), color, pen, maxWidth, a_Z,
+                strlen(text));
 }
 
 //-----------------------------------------------------------------------------
@@ -247,47 +325,21 @@ void TextRenderer::AddTextTrailingCharsPrioritized(
     Init();
   }
 
-  float tempPenX = ToScreenSpace(a_X);
   float maxWidth = a_MaxSize == -1.f ? FLT_MAX : ToScreenSpace(a_MaxSize);
-  float strWidth = 0.f;
-  int minX = INT_MAX;
-  int maxX = -INT_MAX;
+  // Boxes narrower than the font size can't show more than a couple of
+  // characters, which aren't worth drawing, nor measuring.
+  if (maxWidth < m_Font->size) {
+    return;
+  }
 
   const size_t textLen = strlen(a_Text);
-
-  size_t i;
-  for (i = 0; i < textLen; ++i) {
-    if (!texture_font_find_glyph(m_Font, a_Text + i)) {
-      texture_font_load_glyph(m_Font, a_Text + i);
-    }
-
-    texture_glyph_t* glyph = texture_font_get_glyph(m_Font, a_Text + i);
-    if (glyph != NULL) {
-      float kerning = 0.0f;
-      if (i > 0) {
-        kerning = texture_glyph_get_kerning(glyph, a_Text + i - 1);
-      }
-      tempPenX += kerning;
-      int x0 = static_cast<int>(tempPenX + glyph->offset_x);
-      int x1 = static_cast<int>(x0 + glyph->width);
-
-      minX = std::min(minX, x0);
-      maxX = std::max(maxX, x1);
-      strWidth = float(maxX - minX);
-
-      if (strWidth > maxWidth) {
-        break;
-      }
-
-      tempPenX += glyph->advance_x;
-    }
-  }
+  const TextLayout& layout = GetTextLayout(m_Font, a_Text);
+  auto fittingCharsCount =
+      GetFittingCharsCount(layout, ToScreenSpace(a_X), maxWidth, textLen);
 
   // TODO: Technically, we'd want the size of "... <TIME>" + remaining
   // characters
 
-  auto fittingCharsCount = i;
-
   static const char* ELLIPSIS_TEXT = "... ";
   static const size_t ELLIPSIS_TEXT_LEN = strlen(ELLIPSIS_TEXT);
   static const size_t LEADING_CHARS_COUNT = 1;
@@ -298,8 +350,10 @@ void TextRenderer::AddTextTrailingCharsPrioritized(
       (fittingCharsCount < textLen) &&
       (fittingCharsCount > (a_TrailingCharsLength + ELLIPSIS_BUFFER_SIZE));
 
+  ToScreenSpace(a_X, a_Y, m_Pen.x, m_Pen.y);
   if (!useEllipsisText) {
-    AddText(a_Text, a_X, a_Y, a_Z, a_Color, a_MaxSize);
+    AddTextLayout(layout, ColorToVec4(a_Color), &m_Pen, maxWidth, a_Z,
+                  textLen);
   } else {
     auto leadingCharCount =
         fittingCharsCount - (a_TrailingCharsLength + ELLIPSIS_TEXT_LEN);
@@ -310,7 +364,24 @@ void TextRenderer::AddTextTrailingCharsPrioritized(
     auto timePosition = textLen - a_TrailingCharsLength;
     modifiedText.append(&a_Text[timePosition], a_TrailingCharsLength);
 
-    AddText(modifiedText.c_str(), a_X, a_Y, a_Z, a_Color, a_MaxSize);
+    LayOutText(m_Font, modifiedText.c_str(), &elided_text_layout_);
+    AddTextLayout(elided_text_layout_, ColorToVec4(a_Color), &m_Pen, maxWidth,
+                  a_Z, modifiedText.size());
+  }
+}
+
+//-----------------------------------------------------------------------------
+void TextRecorder::AddTextTrailingCharsPrioritized(
+    const char* text, float x, float y, float z, const Color& color,
+    size_t trailing_chars_length, float max_size) {
+  texts_.push_back({text, x, y, z, color, trailing_chars_length, max_size});
+}
+
+void TextRecorder::AddTo(TextRenderer* text_renderer) const {
+  for (const Text& text : texts_) {
+    text_renderer->AddTextTrailingCharsPrioritized(
+        text.text.c_str(), text.x, text.y, text.z, text.color,
+        text.trailing_chars_length, text.max_size);
   }
 }
 
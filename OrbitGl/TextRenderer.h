@@ -7,8 +7,11 @@
 #include <freetype-gl/mat4.h>
 
 #include <map>
+#include <string>
+#include <vector>
 
 #include "Batcher.h"
+#include "absl/container/flat_hash_map.h"
 #include "OpenGl.h"
 #include "Platform.h"
 #include "TextBox.h"
@@ -24,6 +27,9 @@ class TextRenderer {
   ~TextRenderer();
 
   void Init();
+  // Loads the fonts, which is all that adding text needs, without an OpenGL
+  // context. Also done by Init. Returns false if the fonts can't be loaded.
+  bool InitFonts();
   void Display(Batcher* batcher);
   void AddText(const char* a_Text, float a_X, float a_Y, float a_Z,
                const Color& a_Color, float a_MaxSize = -1.f,
@@ -39,6 +45,8 @@ class TextRenderer {
   void GetStringSize(const char* a_Text, int& a_Width, int& a_Height);
   int GetStringHeight(const char* a_Text);
   void Clear();
+  // Translates all text by offset, in world coordinates, when displayed.
+  void SetWorldOffsetX(float offset) { world_offset_x_ = offset; }
   void SetCanvas(class GlCanvas* a_Canvas) { m_Canvas = a_Canvas; }
   const GlCanvas* GetCanvas() const { return m_Canvas; }
   GlCanvas* GetCanvas() { return m_Canvas; }
@@ -57,9 +65,44 @@ class TextRenderer {
   void DrawOutline(Batcher* batcher, vertex_buffer_t* a_Buffer);
 
  private:
+  // The glyphs of a string, with the position of the pen before each of them
+  // relative to the start of the string, kerning included.
+  struct GlyphPosition {
+    texture_glyph_t* glyph;
+    float pen_x;
+    size_t char_index;
+  };
+  struct TextLayout {
+    std::vector<GlyphPosition> glyphs;
+    float advance_x = 0.f;
+  };
+
+  // Labels mostly repeat from one update to the next, so layouts are cached
+  // per font and string, instead of looking up glyphs and kerning again.
+  const TextLayout& GetTextLayout(texture_font_t* font, const char* text);
+  static void LayOutText(texture_font_t* font, const char* text,
+                         TextLayout* layout);
+  // Adds the glyphs that fit in max_width, in screen space, and returns the
+  // number of characters they span.
+  size_t AddTextLayout(const TextLayout& layout, const vec4& color, vec2* pen,
+                       float max_width, float z, size_t text_length);
+  // Returns the number of characters of layout that fit in max_width.
+  static size_t GetFittingCharsCount(const TextLayout& layout, float pen_x,
+                                     float max_width, size_t text_length);
+
+  absl::flat_hash_map<texture_font_t*,
+                      absl::flat_hash_map<std::string, TextLayout>>
+      text_layouts_;
+  size_t text_layout_count_ = 0;
+  // Elided labels depend on the width of their box, hence are not cached.
+  TextLayout elided_text_layout_;
+
   texture_atlas_t* m_Atlas;
   vertex_buffer_t* m_Buffer;
   texture_font_t* m_Font;
+  static constexpr int kMinFontSize = 10;
+  static constexpr int kMaxFontSize = 100;
+  std::string font_file_name_;
   std::map<int, texture_font_t*> m_FontsBySize;
   int current_font_size_;
   GlCanvas* m_Canvas;
@@ -70,6 +113,33 @@ class TextRenderer {
   vec2 m_Pen;
   bool m_Initialized;
   bool m_DrawOutline;
+  float world_offset_x_ = 0.f;
+};
+
+//-----------------------------------------------------------------------------
+// Records text to be added to a TextRenderer later, in the same order. Used by
+// tracks updating their primitives in parallel, as adding text to a
+// TextRenderer loads glyphs into its shared atlas.
+class TextRecorder {
+ public:
+  void AddTextTrailingCharsPrioritized(const char* text, float x, float y,
+                                       float z, const Color& color,
+                                       size_t trailing_chars_length,
+                                       float max_size);
+  void AddTo(TextRenderer* text_renderer) const;
+  void Clear() { texts_.clear(); }
+
+ private:
+  struct Text {
+    std::string text;
+    float x;
+    float y;
+    float z;
+    Color color;
+    size_t trailing_chars_length;
+    float max_size;
+  };
+  std::vector<Text> texts_;
 };
 
 //-----------------------------------------------------------------------------
@@ -4,15 +4,66 @@
 
 #include "ThreadTrack.h"
 
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
 #include "FunctionUtils.h"
 #include "GlCanvas.h"
 #include "Profiling.h"
 #include "TextBox.h"
 #include "TimeGraph.h"
+#include "absl/strings/str_format.h"
 
 using orbit_client_protos::FunctionInfo;
 using orbit_client_protos::TimerInfo;
 
+namespace {
+// The names of the x86_64 syscalls that usually block, by number.
+const char* GetSyscallName(uint64_t syscall_nr) {
+  switch (syscall_nr) {
+    case 0:
+      return "read";
+    case 1:
+      return "write";
+    case 2:
+      return "open";
+    case 3:
+      return "close";
+    case 7:
+      return "poll";
+    case 16:
+      return "ioctl";
+    case 17:
+      return "pread64";
+    case 18:
+      return "pwrite64";
+    case 19:
+      return "readv";
+    case 20:
+      return "writev";
+    case 23:
+      return "select";
+    case 35:
+      return "nanosleep";
+    case 74:
+      return "fsync";
+    case 75:
+      return "fdatasync";
+    case 202:
+      return "futex";
+    case 232:
+      return "epoll_wait";
+    case 257:
+      return "openat";
+    case 281:
+      return "epoll_pwait";
+    default:
+      return nullptr;
+  }
+}
+}  // namespace
+
 //-----------------------------------------------------------------------------
 ThreadTrack::ThreadTrack(TimeGraph* time_graph, int32_t thread_id)
     : TimerTrack(time_graph), thread_id_(thread_id) {
@@ -41,8 +92,7 @@ const TextBox* ThreadTrack::GetRight(TextBox* text_box) const {
 }
 
 //-----------------------------------------------------------------------------
-std::string ThreadTrack::GetBoxTooltip(PickingID id) const {
-  TextBox* text_box = time_graph_->GetBatcher().GetTextBox(id);
+std::string ThreadTrack::GetBoxTooltip(const TextBox* text_box) const {
   if (!text_box ||
       text_box->GetTimerInfo().type() == TimerInfo::kCoreActivity) {
     return "";
@@ -75,8 +125,21 @@ bool ThreadTrack::IsTimerActive(const TimerInfo& timer_info) const {
 Color ThreadTrack::GetTimerColor(const TimerInfo& timer_info, bool is_selected) const {
   const Color kInactiveColor(100, 100, 100, 255);
   const Color kSelectionColor(0, 128, 255, 255);
+  const Color kLockWaitColor(200, 50, 50, 255);
+  const Color kSyscallColor(220, 140, 40, 255);
+  const Color kBlockIoColor(40, 150, 200, 255);
+  const Color kSearchMatchColor(230, 0, 230, 255);
   if (is_selected) {
     return kSelectionColor;
+  } else if (time_graph_->IsTimerSearchMatch(timer_info.function_address())) {
+    return kSearchMatchColor;
+  } else if (timer_info.type() == TimerInfo::kLockWait) {
+    return kLockWaitColor;
+  } else if (timer_info.type() == TimerInfo::kSyscall) {
+    return kSyscallColor;
+  } else if (timer_info.type() == TimerInfo::kBlockIoRead ||
+             timer_info.type() == TimerInfo::kBlockIoWrite) {
+    return kBlockIoColor;
   } else if (!IsTimerActive(timer_info)) {
     return kInactiveColor;
   }
@@ -99,7 +162,73 @@ void ThreadTrack::UpdateBoxHeight() {
 }
 
 bool ThreadTrack::IsEmpty() const {
-  return (GetNumTimers() == 0) && (event_track_->IsEmpty());
+  ScopeLock lock(mutex_);
+  return (GetNumTimers() == 0) && (event_track_->IsEmpty()) &&
+         thread_states_.IsEmpty();
+}
+
+float ThreadTrack::GetHeight() const {
+  return TimerTrack::GetHeight() + GetThreadStatesHeight();
+}
+
+float ThreadTrack::GetYFromDepth(uint32_t depth) const {
+  return TimerTrack::GetYFromDepth(depth) - GetThreadStatesHeight();
+}
+
+float ThreadTrack::GetThreadStatesHeight() const {
+  ScopeLock lock(mutex_);
+  return thread_states_.IsEmpty()
+             ? 0.f
+             : time_graph_->GetLayout().GetThreadStateTrackHeight();
+}
+
+float ThreadTrack::GetThreadStatesY() const {
+  const TimeGraphLayout& layout = time_graph_->GetLayout();
+  return m_Pos[1] - layout.GetEventTrackHeight() -
+         layout.GetThreadStateTrackHeight() / 2;
+}
+
+//-----------------------------------------------------------------------------
+void ThreadTrack::OnSchedulingSlice(uint64_t in_ns, uint64_t out_ns) {
+  ScopeLock lock(mutex_);
+  thread_states_.AddSchedulingSlice(in_ns, out_ns);
+}
+
+//-----------------------------------------------------------------------------
+void ThreadTrack::OnThreadWakeup(uint64_t timestamp_ns, int32_t waker_tid) {
+  ScopeLock lock(mutex_);
+  thread_states_.AddWakeup(timestamp_ns, waker_tid);
+}
+
+//-----------------------------------------------------------------------------
+void ThreadTrack::OnPageFault(uint64_t timestamp_ns, bool major) {
+  ScopeLock lock(mutex_);
+  // The page faults arrive almost in order: the insertion is at the end.
+  auto it = std::upper_bound(page_faults_.begin(), page_faults_.end(),
+                             timestamp_ns,
+                             [](uint64_t timestamp_ns, const auto& marker) {
+                               return timestamp_ns < marker.timestamp_ns;
+                             });
+  page_faults_.insert(it, PageFaultMarker{timestamp_ns, major});
+}
+
+//-----------------------------------------------------------------------------
+void ThreadTrack::SetPageFaultStats(const PageFaultStats& page_fault_stats) {
+  ScopeLock lock(mutex_);
+  page_fault_stats_ = page_fault_stats;
+}
+
+//-----------------------------------------------------------------------------
+void ThreadTrack::DropTimersEndingBefore(uint64_t timestamp) {
+  TimerTrack::DropTimersEndingBefore(timestamp);
+  ScopeLock lock(mutex_);
+  thread_states_.DropIntervalsBefore(timestamp);
+  auto it = std::lower_bound(page_faults_.begin(), page_faults_.end(),
+                             timestamp,
+                             [](const auto& marker, uint64_t timestamp) {
+                               return marker.timestamp_ns < timestamp;
+                             });
+  page_faults_.erase(page_faults_.begin(), it);
 }
 
 //-----------------------------------------------------------------------------
@@ -110,16 +239,170 @@ void ThreadTrack::Draw(GlCanvas* canvas, PickingMode picking_mode) {
   event_track_->SetPos(m_Pos[0], m_Pos[1]);
   event_track_->SetSize(canvas->GetWorldWidth(), event_track_height);
   event_track_->Draw(canvas, picking_mode);
+
+  DrawThreadStates(canvas, picking_mode);
+  if (picking_mode == PickingMode::kNone) {
+    DrawPageFaults(canvas);
+    DrawWakeupLink(canvas);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void ThreadTrack::DrawThreadStates(GlCanvas* canvas, PickingMode picking_mode) {
+  const Color kRunningColor(76, 175, 80, 255);
+  const Color kRunnableColor(255, 152, 0, 255);
+  const Color kBlockedColor(128, 128, 128, 255);
+  const uint64_t min_tick =
+      time_graph_->GetTickFromUs(time_graph_->GetMinTimeUs());
+  const uint64_t max_tick =
+      time_graph_->GetTickFromUs(time_graph_->GetMaxTimeUs());
+  const int width = canvas->getWidth();
+  if (max_tick <= min_tick || width <= 0) return;
+  // Intervals shorter than a pixel are drawn one pixel wide, over the ones
+  // skipped in that pixel.
+  const uint64_t resolution_ns =
+      std::max<uint64_t>((max_tick - min_tick) / width, 1);
+  const float height = time_graph_->GetLayout().GetThreadStateTrackHeight();
+  const float y = GetThreadStatesY() - height / 2;
+  Batcher* batcher = canvas->GetBatcher();
+
+  ScopeLock lock(mutex_);
+  thread_states_.ForEachInterval(
+      min_tick, max_tick, resolution_ns,
+      [&](const ThreadStates::Interval& interval) {
+        const uint64_t end_ns =
+            std::max(interval.end_ns, interval.begin_ns + resolution_ns);
+        const float x = time_graph_->GetWorldFromTick(interval.begin_ns);
+        Box box(Vec2(x, y),
+                Vec2(time_graph_->GetWorldFromTick(end_ns) - x, height),
+                GlCanvas::Z_VALUE_EVENT);
+        Color color = kRunningColor;
+        if (interval.state == ThreadStates::State::kRunnable) {
+          color = kRunnableColor;
+        } else if (interval.state == ThreadStates::State::kBlocked) {
+          color = kBlockedColor;
+        }
+        if (picking_mode == PickingMode::kNone) {
+          batcher->AddBox(box, color, PickingID::BOX);
+          return;
+        }
+        auto user_data = std::make_unique<PickingUserData>(
+            nullptr, [this, interval](PickingID /*id*/) {
+              return GetThreadStateTooltip(interval);
+            });
+        batcher->AddBox(box, color, PickingID::BOX, std::move(user_data));
+      });
+}
+
+//-----------------------------------------------------------------------------
+void ThreadTrack::DrawPageFaults(GlCanvas* canvas) {
+  const Color kMajorPageFaultColor(244, 67, 54, 255);
+  const Color kMinorPageFaultColor(255, 235, 59, 255);
+  const uint64_t min_tick =
+      time_graph_->GetTickFromUs(time_graph_->GetMinTimeUs());
+  const uint64_t max_tick =
+      time_graph_->GetTickFromUs(time_graph_->GetMaxTimeUs());
+  const int width = canvas->getWidth();
+  if (max_tick <= min_tick || width <= 0) return;
+  const uint64_t resolution_ns =
+      std::max<uint64_t>((max_tick - min_tick) / width, 1);
+  const float height = time_graph_->GetLayout().GetEventTrackHeight();
+  Batcher* batcher = canvas->GetBatcher();
+
+  ScopeLock lock(mutex_);
+  auto it = std::lower_bound(page_faults_.begin(), page_faults_.end(),
+                             min_tick,
+                             [](const auto& marker, uint64_t timestamp) {
+                               return marker.timestamp_ns < timestamp;
+                             });
+  while (it != page_faults_.end() && it->timestamp_ns <= max_tick) {
+    // The pixel of the marker, and whether it has a major page fault.
+    const uint64_t pixel_end_ns = it->timestamp_ns + resolution_ns;
+    const uint64_t timestamp_ns = it->timestamp_ns;
+    bool major = false;
+    for (; it != page_faults_.end() && it->timestamp_ns < pixel_end_ns; ++it) {
+      major |= it->major;
+    }
+    const float x = time_graph_->GetWorldFromTick(timestamp_ns);
+    batcher->AddVerticalLine(
+        Vec2(x, m_Pos[1] - height), height, GlCanvas::Z_VALUE_TEXT,
+        major ? kMajorPageFaultColor : kMinorPageFaultColor, PickingID::LINE);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void ThreadTrack::DrawWakeupLink(GlCanvas* canvas) {
+  const float half_height =
+      time_graph_->GetLayout().GetThreadStateTrackHeight() / 2;
+  const float y = GetThreadStatesY();
+  if (std::abs(canvas->GetMouseY() - y) > half_height) return;
+
+  ThreadStates::Interval interval;
+  {
+    ScopeLock lock(mutex_);
+    const ThreadStates::Interval* hovered_interval =
+        thread_states_.FindInterval(
+            time_graph_->GetTickFromWorld(canvas->GetMouseX()));
+    if (hovered_interval == nullptr || !hovered_interval->has_waker) return;
+    interval = *hovered_interval;
+  }
+
+  // The waker may be of another process, or have no visible track.
+  std::shared_ptr<ThreadTrack> waker_track =
+      time_graph_->FindThreadTrack(interval.waker_tid);
+  if (waker_track == nullptr || !waker_track->GetVisible() ||
+      waker_track->IsEmpty()) {
+    return;
+  }
+  const Color kWakeupLinkColor(255, 255, 255, 255);
+  const float x = time_graph_->GetWorldFromTick(interval.begin_ns);
+  canvas->GetBatcher()->AddLine(Vec2(x, waker_track->GetThreadStatesY()),
+                                Vec2(x, y), GlCanvas::Z_VALUE_TEXT,
+                                kWakeupLinkColor, PickingID::LINE);
+}
+
+//-----------------------------------------------------------------------------
+std::string ThreadTrack::GetThreadStateTooltip(
+    const ThreadStates::Interval& interval) const {
+  std::string state = "Running";
+  if (interval.state == ThreadStates::State::kRunnable) {
+    state = "Runnable";
+  } else if (interval.state == ThreadStates::State::kBlocked) {
+    state = "Blocked";
+  }
+  std::string tooltip = absl::StrFormat(
+      "<b>%s</b><br/><b>Time:</b> %s", state,
+      GetPrettyTime(TicksToDuration(interval.begin_ns, interval.end_ns)));
+  if (interval.has_waker && interval.waker_tid == 0) {
+    tooltip += "<br/><b>Woken up by:</b> an interrupt";
+  } else if (interval.has_waker) {
+    std::string waker_name =
+        Capture::GCaptureData.GetThreadName(interval.waker_tid);
+    if (waker_name.empty()) {
+      waker_name = "unknown";
+    }
+    absl::StrAppendFormat(&tooltip, "<br/><b>Woken up by:</b> %s [%d]",
+                          waker_name, interval.waker_tid);
+  }
+  return tooltip;
 }
 
 //-----------------------------------------------------------------------------
 void ThreadTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
                                    PickingMode picking_mode) {
   event_track_->SetPos(m_Pos[0], m_Pos[1]);
+  event_track_->SetPrimitivesTarget(primitives_batcher_, primitives_text_);
   event_track_->UpdatePrimitives(min_tick, max_tick, picking_mode);
   TimerTrack::UpdatePrimitives(min_tick, max_tick, picking_mode);
 }
 
+//-----------------------------------------------------------------------------
+void ThreadTrack::UpdateNewPrimitives(uint64_t min_tick, uint64_t max_tick) {
+  event_track_->SetPrimitivesTarget(primitives_batcher_, primitives_text_);
+  event_track_->UpdateNewPrimitives(min_tick, max_tick);
+  TimerTrack::UpdateNewPrimitives(min_tick, max_tick);
+}
+
 //-----------------------------------------------------------------------------
 void ThreadTrack::SetEventTrackColor(Color color) {
   ScopeLock lock(mutex_);
@@ -133,8 +416,12 @@ void ThreadTrack::SetTimesliceText(const TimerInfo& timer_info,
   TimeGraphLayout layout = time_graph_->GetLayout();
   if (text_box->GetText().empty()) {
     std::string time = GetPrettyTime(absl::Microseconds(elapsed_us));
-    FunctionInfo* func =
-        Capture::GSelectedFunctionsMap[timer_info.function_address()];
+    // Tracks are updated in parallel, hence the map must not be modified.
+    auto func_it =
+        Capture::GSelectedFunctionsMap.find(timer_info.function_address());
+    FunctionInfo* func = func_it != Capture::GSelectedFunctionsMap.end()
+                             ? func_it->second
+                             : nullptr;
 
     text_box->SetElapsedTimeTextLength(time.length());
 
@@ -146,12 +433,33 @@ void ThreadTrack::SetTimesliceText(const TimerInfo& timer_info,
           absl::StrFormat("%s %s %s", name, extra_info.c_str(), time.c_str());
 
       text_box->SetText(text);
-    } else if (timer_info.type() == TimerInfo::kIntrospection) {
-      std::string text = absl::StrFormat("%s %s",
-                                         time_graph_->GetStringManager()
-                                             ->Get(timer_info.user_data_key())
-                                             .value_or(""),
-                                         time.c_str());
+    } else if (timer_info.type() == TimerInfo::kIntrospection ||
+               timer_info.type() == TimerInfo::kManualInstrumentation) {
+      std::string text = absl::StrFormat(
+          "%s %s",
+          time_graph_->GetStringManager()
+              ->GetView(timer_info.user_data_key())
+              .value_or(""),
+          time.c_str());
+      text_box->SetText(text);
+    } else if (timer_info.type() == TimerInfo::kLockWait) {
+      std::string text = absl::StrFormat(
+          "lock 0x%llx %s", timer_info.user_data_key(), time.c_str());
+      text_box->SetText(text);
+    } else if (timer_info.type() == TimerInfo::kSyscall) {
+      const char* syscall_name = GetSyscallName(timer_info.user_data_key());
+      std::string text =
+          syscall_name != nullptr
+              ? absl::StrFormat("%s %s", syscall_name, time.c_str())
+              : absl::StrFormat("syscall %llu %s", timer_info.user_data_key(),
+                                time.c_str());
+      text_box->SetText(text);
+    } else if (timer_info.type() == TimerInfo::kBlockIoRead ||
+               timer_info.type() == TimerInfo::kBlockIoWrite) {
+      std::string text = absl::StrFormat(
+          "block %s %llu KiB %s",
+          timer_info.type() == TimerInfo::kBlockIoRead ? "read" : "write",
+          timer_info.user_data_key() / 1024, time.c_str());
       text_box->SetText(text);
     } else {
       ERROR("Unexpected case in ThreadTrack::SetTimesliceText");
@@ -165,13 +473,25 @@ void ThreadTrack::SetTimesliceText(const TimerInfo& timer_info,
   const Vec2& box_size = text_box->GetSize();
   float pos_x = std::max(box_pos[0], min_x);
   float max_size = box_pos[0] + box_size[0] - pos_x;
-  text_renderer_->AddTextTrailingCharsPrioritized(
+  primitives_text_->AddTextTrailingCharsPrioritized(
       text_box->GetText().c_str(), pos_x,
       text_box->GetPosY() + layout.GetTextOffset(), GlCanvas::Z_VALUE_TEXT,
       kTextWhite, text_box->GetElapsedTimeTextLength(), max_size);
 }
 
 std::string ThreadTrack::GetTooltip() const {
-  return "Shows collected samples and timings from dynamically instrumented "
-         "functions";
+  std::string tooltip =
+      "Shows collected samples and timings from dynamically instrumented "
+      "functions";
+  ScopeLock lock(mutex_);
+  if (page_fault_stats_.has_value()) {
+    absl::StrAppendFormat(
+        &tooltip,
+        "<br/><br/>Page faults: %lu major, %lu minor<br/>mmap: %lu, "
+        "munmap: %lu",
+        page_fault_stats_->major_page_fault_count(),
+        page_fault_stats_->minor_page_fault_count(),
+        page_fault_stats_->mmap_count(), page_fault_stats_->munmap_count());
+  }
+  return tooltip;
 }
@@ -7,8 +7,12 @@
 
 #include <map>
 #include <memory>
+#include <optional>
+#include <vector>
 
+#include "ThreadStates.h"
 #include "TimerTrack.h"
+#include "capture.pb.h"
 #include "capture_data.pb.h"
 
 class ThreadTrack : public TimerTrack {
@@ -28,9 +32,22 @@ class ThreadTrack : public TimerTrack {
   void UpdateBoxHeight() override;
   void SetEventTrackColor(Color color);
   [[nodiscard]] bool IsEmpty() const override;
+  [[nodiscard]] float GetHeight() const override;
+
+  // The scheduling slices and the wakeups of the thread, from which its states
+  // are derived and shown in a band below the event track.
+  void OnSchedulingSlice(uint64_t in_ns, uint64_t out_ns);
+  void OnThreadWakeup(uint64_t timestamp_ns, int32_t waker_tid);
+  // The page faults of the thread, shown as markers over the event track, and
+  // its page fault stats so far, shown in the tooltip.
+  void OnPageFault(uint64_t timestamp_ns, bool major);
+  void SetPageFaultStats(const PageFaultStats& page_fault_stats);
+  // Also drops the states and the page faults before timestamp.
+  void DropTimersEndingBefore(uint64_t timestamp) override;
 
   void UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
                         PickingMode picking_mode) override;
+  void UpdateNewPrimitives(uint64_t min_tick, uint64_t max_tick) override;
 
  protected:
   [[nodiscard]] bool IsTimerActive(
@@ -40,10 +57,34 @@ class ThreadTrack : public TimerTrack {
   void SetTimesliceText(const orbit_client_protos::TimerInfo& timer,
                         double elapsed_us, float min_x,
                         TextBox* text_box) override;
-  [[nodiscard]] std::string GetBoxTooltip(PickingID id) const override;
+  [[nodiscard]] std::string GetBoxTooltip(
+      const TextBox* text_box) const override;
+  [[nodiscard]] float GetYFromDepth(uint32_t depth) const override;
+
+  // The states are drawn on each frame, like the graphs, as events arriving
+  // late can change them anywhere in the capture.
+  void DrawThreadStates(GlCanvas* canvas, PickingMode picking_mode);
+  // From the waker to the runnable interval under the mouse, if any.
+  void DrawWakeupLink(GlCanvas* canvas);
+  [[nodiscard]] float GetThreadStatesHeight() const;
+  // The vertical middle of the band.
+  [[nodiscard]] float GetThreadStatesY() const;
+  [[nodiscard]] std::string GetThreadStateTooltip(
+      const ThreadStates::Interval& interval) const;
+  // At most one marker per pixel, the major page faults over the minor ones.
+  void DrawPageFaults(GlCanvas* canvas);
 
   std::shared_ptr<EventTrack> event_track_;
   int32_t thread_id_;
+  ThreadStates thread_states_;
+
+  struct PageFaultMarker {
+    uint64_t timestamp_ns = 0;
+    bool major = false;
+  };
+  // Sorted by timestamp.
+  std::vector<PageFaultMarker> page_faults_;
+  std::optional<PageFaultStats> page_fault_stats_;
 };
 
 #endif  // ORBIT_GL_THREAD_TRACK_H_
@@ -7,6 +7,8 @@
 #include <OrbitBase/Logging.h>
 
 #include <algorithm>
+#include <cmath>
+#include <thread>
 #include <utility>
 
 #include "App.h"
@@ -20,17 +22,24 @@
 #include "GpuTrack.h"
 #include "GraphTrack.h"
 #include "Log.h"
+#include "OrbitBase/ParallelFor.h"
 #include "Params.h"
 #include "PickingManager.h"
 #include "SamplingProfiler.h"
 #include "SchedulerTrack.h"
 #include "StringManager.h"
+#include "SubstringSearchIndex.h"
 #include "TextBox.h"
 #include "TextRenderer.h"
 #include "ThreadTrack.h"
 #include "Utils.h"
 #include "absl/flags/flag.h"
+#include "absl/strings/match.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+
+ABSL_DECLARE_FLAG(bool, instanced_timers);
+ABSL_DECLARE_FLAG(bool, thread_state);
 
 using orbit_client_protos::CallstackEvent;
 using orbit_client_protos::FunctionInfo;
@@ -38,8 +47,18 @@ using orbit_client_protos::TimerInfo;
 
 TimeGraph* GCurrentTimeGraph = nullptr;
 
+namespace {
+// Each group of tracks keeps the blocks of its batcher from one update to the
+// next, hence the number of groups is bounded.
+constexpr size_t kMaxTrackGroupCount = 8;
+}  // namespace
+
 //-----------------------------------------------------------------------------
 TimeGraph::TimeGraph() {
+  const size_t thread_count = std::clamp<size_t>(
+      std::thread::hardware_concurrency(), 2, kMaxTrackGroupCount) - 1;
+  update_thread_pool_ = ThreadPool::CreateWorkStealing(thread_count);
+
   m_LastThreadReorder.Start();
   scheduler_track_ = GetOrCreateSchedulerTrack();
 
@@ -47,6 +66,9 @@ TimeGraph::TimeGraph() {
   process_track_ = GetOrCreateThreadTrack(0);
 }
 
+//-----------------------------------------------------------------------------
+TimeGraph::~TimeGraph() { update_thread_pool_->ShutdownAndWait(); }
+
 //-----------------------------------------------------------------------------
 Color TimeGraph::GetThreadColor(ThreadID tid) const {
   static unsigned char a = 255;
@@ -84,14 +106,60 @@ void TimeGraph::Clear() {
   m_Batcher.Reset();
   capture_min_timestamp_ = std::numeric_limits<TickType>::max();
   capture_max_timestamp_ = 0;
-  m_ThreadCountMap.clear();
   GEventTracer.GetEventBuffer().Reset();
 
   ScopeLock lock(m_Mutex);
   tracks_.clear();
   scheduler_track_ = nullptr;
+  thread_index_.Clear();
   thread_tracks_.clear();
+  thread_timer_counts_.clear();
+  thread_event_counts_.clear();
   gpu_tracks_.clear();
+  async_tracks_.clear();
+  frame_tracks_.clear();
+  counter_tracks_.clear();
+  cpu_frequency_tracks_.clear();
+  cpu_power_states_.clear();
+  sorted_thread_ids_.clear();
+  sorted_thread_id_set_.clear();
+  lowercase_track_names_.clear();
+  sorted_event_max_time_ = 0;
+  tracks_need_sorting_ = true;
+  thread_cpu_usages_.clear();
+  thread_allocated_bytes_.clear();
+  function_call_index_.Clear();
+  function_time_index_.Clear();
+  functions_by_address_.clear();
+  resolved_function_count_ = 0;
+  timer_search_function_count_.reset();
+  selected_thread_id_ = 0;
+  selection_min_tick_ = 0;
+  selection_max_tick_ = 0;
+
+  // Events of a previous capture that were never processed.
+  TimerInfo timer_info;
+  while (enqueued_timers_.try_dequeue(timer_info)) {
+  }
+  SchedulingSliceCounters scheduling_slice_counters;
+  while (enqueued_scheduling_slice_counters_.try_dequeue(
+      scheduling_slice_counters)) {
+  }
+  ThreadWakeup thread_wakeup;
+  while (enqueued_thread_wakeups_.try_dequeue(thread_wakeup)) {
+  }
+  Allocation allocation;
+  while (enqueued_allocations_.try_dequeue(allocation)) {
+  }
+  CpuPowerEvent cpu_power_event;
+  while (enqueued_cpu_power_events_.try_dequeue(cpu_power_event)) {
+  }
+  PageFault page_fault;
+  while (enqueued_page_faults_.try_dequeue(page_fault)) {
+  }
+  PageFaultStats page_fault_stats;
+  while (enqueued_page_fault_stats_.try_dequeue(page_fault_stats)) {
+  }
 
   cores_seen_.clear();
   scheduler_track_ = GetOrCreateSchedulerTrack();
@@ -104,6 +172,64 @@ void TimeGraph::Clear() {
   NeedsUpdate();
 }
 
+//-----------------------------------------------------------------------------
+void TimeGraph::DropDataBefore(TickType timestamp) {
+  // The text boxes referenced from outside the tracks must stay valid.
+  TickType cutoff = timestamp;
+  if (Capture::GSelectedTextBox != nullptr) {
+    cutoff = std::min<TickType>(
+        cutoff, Capture::GSelectedTextBox->GetTimerInfo().start());
+  }
+  for (const auto& [unused_function_address, text_box] :
+       iterator_text_boxes_) {
+    if (text_box != nullptr) {
+      cutoff = std::min<TickType>(cutoff, text_box->GetTimerInfo().start());
+    }
+  }
+
+  // The primitives refer to the text boxes too.
+  m_Batcher.Reset();
+
+  {
+    ScopeLock lock(m_Mutex);
+    // The frame tracks have few timers, and are kept whole.
+    for (auto& track : thread_tracks_) {
+      track->DropTimersEndingBefore(cutoff);
+    }
+    for (auto& [unused_timeline_hash, track] : gpu_tracks_) {
+      track->DropTimersEndingBefore(cutoff);
+    }
+    for (auto& [unused_name_hash, track] : async_tracks_) {
+      track->DropTimersEndingBefore(cutoff);
+    }
+    if (scheduler_track_ != nullptr) {
+      scheduler_track_->DropTimersEndingBefore(cutoff);
+    }
+    for (auto& [unused_tid, tracks] : counter_tracks_) {
+      for (auto& [unused_counter_name, track] : tracks) {
+        track->DropValuesBefore(cutoff);
+      }
+    }
+    for (auto& [unused_cpu, track] : cpu_frequency_tracks_) {
+      track->DropValuesBefore(cutoff);
+    }
+    function_call_index_.RemoveCallsEndingBefore(cutoff);
+    tracks_need_sorting_ = true;
+  }
+  GEventTracer.GetEventBuffer().DropCallstackEventsBefore(cutoff);
+
+  // The times of the view are relative to the start of the capture, which
+  // moved: the view is kept on the same timestamps.
+  const TickType previous_capture_min_timestamp = capture_min_timestamp_;
+  if (UpdateCaptureMinMaxTimestamps() &&
+      capture_min_timestamp_ > previous_capture_min_timestamp) {
+    const double shift_us = TicksToMicroseconds(previous_capture_min_timestamp,
+                                                capture_min_timestamp_);
+    SetMinMax(m_MinTimeUs - shift_us, m_MaxTimeUs - shift_us);
+  }
+  NeedsUpdate();
+}
+
 //-----------------------------------------------------------------------------
 double GNumHistorySeconds = 2.f;
 
@@ -140,7 +266,9 @@ void TimeGraph::ZoomAll() {
     m_MinTimeUs = m_MaxTimeUs - (GNumHistorySeconds * 1000 * 1000);
     if (m_MinTimeUs < 0) m_MinTimeUs = 0;
 
-    NeedsUpdate();
+    // UpdatePrimitives only keeps the previous primitives if the view was
+    // merely scrolled, as it is while following a live capture.
+    NeedsIncrementalUpdate();
   }
 }
 
@@ -331,41 +459,302 @@ double TimeGraph::GetTimeIntervalMicro(double a_Ratio) {
 }
 
 //-----------------------------------------------------------------------------
-void TimeGraph::ProcessTimer(const TimerInfo& timer_info) {
+void TimeGraph::ProcessTimer(TimerInfo timer_info) {
   if (timer_info.end() > capture_max_timestamp_) {
     capture_max_timestamp_ = timer_info.end();
   }
 
   if (timer_info.function_address() > 0) {
-    FunctionInfo* func = Capture::GTargetProcess->GetFunctionFromAddress(
-        timer_info.function_address());
+    FunctionInfo*& func = functions_by_address_[timer_info.function_address()];
+    // Looked up again until found, as the symbols can be loaded later.
+    if (func == nullptr) {
+      func = Capture::GTargetProcess->GetFunctionFromAddress(
+          timer_info.function_address());
+      if (func != nullptr) ++resolved_function_count_;
+    }
     if (func != nullptr) {
       FunctionUtils::UpdateStats(func, timer_info);
     }
+    // Ticks are nanoseconds.
+    if (timer_info.type() == TimerInfo::kNone) {
+      function_time_index_.AddCall(
+          timer_info.function_address(), timer_info.thread_id(),
+          timer_info.depth(), timer_info.start(), timer_info.end(),
+          func != nullptr ? std::max(func->sampling_ratio(), 1u) : 1);
+    }
+    for (const auto& [unused_name_hash, track] : frame_tracks_) {
+      track->AddFunctionCall(timer_info.start(), timer_info.end());
+    }
   }
 
-  if (timer_info.type() == TimerInfo::kGpuActivity) {
+  if (timer_info.type() == TimerInfo::kGpuActivity ||
+      timer_info.type() == TimerInfo::kGpuCommandBuffer) {
     uint64_t timeline_hash = timer_info.timeline_hash();
     std::shared_ptr<GpuTrack> track = GetOrCreateGpuTrack(timeline_hash);
-    track->OnTimer(timer_info);
+    track->OnGpuTimer(std::move(timer_info));
+  } else if (timer_info.type() == TimerInfo::kAsync) {
+    std::shared_ptr<AsyncTrack> track =
+        GetOrCreateAsyncTrack(timer_info.user_data_key());
+    track->OnAsyncTimer(std::move(timer_info));
+  } else if (timer_info.type() == TimerInfo::kFrame) {
+    std::shared_ptr<FrameTrack> track =
+        GetOrCreateFrameTrack(timer_info.user_data_key());
+    track->OnFrameTimer(std::move(timer_info));
   } else {
-    std::shared_ptr<ThreadTrack> track =
-        GetOrCreateThreadTrack(timer_info.thread_id());
+    uint32_t thread_index;
+    std::shared_ptr<ThreadTrack> track;
+    {
+      ScopeLock lock(m_Mutex);
+      thread_index = GetOrCreateThreadIndex(timer_info.thread_id());
+      track = thread_tracks_[thread_index];
+    }
     if (timer_info.type() == TimerInfo::kIntrospection) {
       const Color kGreenIntrospection(87, 166, 74, 255);
       track->SetColor(kGreenIntrospection);
     }
 
     if (timer_info.type() != TimerInfo::kCoreActivity) {
-      track->OnTimer(timer_info);
-      ++m_ThreadCountMap[timer_info.thread_id()];
+      ++thread_timer_counts_[thread_index];
+      const bool is_function_call = timer_info.function_address() > 0;
+      const TextBox* text_box = track->OnTimer(std::move(timer_info));
+      if (is_function_call) {
+        function_call_index_.Add(text_box);
+      }
     } else {
-      scheduler_track_->OnTimer(timer_info);
       cores_seen_.insert(timer_info.processor());
+      if (timer_info.process_id() == Capture::GProcessId) {
+        UpdateThreadCpuUsage(timer_info.thread_id(), timer_info.start(),
+                             timer_info.end());
+        if (absl::GetFlag(FLAGS_thread_state)) {
+          track->OnSchedulingSlice(timer_info.start(), timer_info.end());
+        }
+      }
+      scheduler_track_->OnCoreActivityTimer(std::move(timer_info));
     }
   }
 
-  NeedsUpdate();
+  tracks_need_sorting_ = true;
+  NeedsIncrementalUpdate();
+}
+
+void TimeGraph::ProcessSchedulingSliceCounters(
+    const SchedulingSliceCounters& scheduling_slice_counters) {
+  uint64_t cycles = scheduling_slice_counters.cycles();
+  uint64_t instructions = scheduling_slice_counters.instructions();
+  if (cycles == 0 || instructions == 0) {
+    return;
+  }
+
+  // Each value covers the whole slice, so it is added at both ends of it.
+  ThreadID thread_id = scheduling_slice_counters.tid();
+  uint64_t in_ns = scheduling_slice_counters.in_timestamp_ns();
+  uint64_t out_ns = scheduling_slice_counters.out_timestamp_ns();
+  auto add_value = [&](const std::string& counter_name, double value) {
+    std::shared_ptr<GraphTrack> track =
+        GetOrCreateCounterTrack(thread_id, counter_name);
+    track->AddValue(in_ns, value);
+    track->AddValue(out_ns, value);
+  };
+  add_value("IPC", static_cast<double>(instructions) / cycles);
+  // Misses per thousand instructions.
+  add_value("LLC MPKI",
+            1000.0 * scheduling_slice_counters.cache_misses() / instructions);
+  add_value("Branch MPKI",
+            1000.0 * scheduling_slice_counters.branch_misses() / instructions);
+
+  tracks_need_sorting_ = true;
+  NeedsIncrementalUpdate();
+}
+
+void TimeGraph::ProcessThreadWakeup(const ThreadWakeup& thread_wakeup) {
+  std::shared_ptr<ThreadTrack> track =
+      FindThreadTrack(thread_wakeup.wakee_tid());
+  if (track == nullptr) {
+    return;
+  }
+  track->OnThreadWakeup(thread_wakeup.timestamp_ns(),
+                        thread_wakeup.waker_tid());
+  NeedsRedraw();
+}
+
+void TimeGraph::ProcessAllocation(ThreadID thread_id, uint64_t timestamp_ns,
+                                  uint64_t sampled_bytes) {
+  absl::flat_hash_map<uint64_t, uint64_t>& allocated_bytes =
+      thread_allocated_bytes_[thread_id];
+  const uint64_t index = timestamp_ns / ALLOCATION_RATE_BUCKET_NS;
+  allocated_bytes[index] += sampled_bytes;
+
+  // As for the CPU usage, the empty buckets around are set to zero.
+  std::shared_ptr<GraphTrack> track =
+      GetOrCreateCounterTrack(thread_id, "Alloc MB/s");
+  constexpr double kBucketsPerSecond = 1e9 / ALLOCATION_RATE_BUCKET_NS;
+  track->AddValue(index * ALLOCATION_RATE_BUCKET_NS,
+                  allocated_bytes[index] * kBucketsPerSecond / 1e6);
+  if (index > 0 && !allocated_bytes.contains(index - 1)) {
+    track->AddValue((index - 1) * ALLOCATION_RATE_BUCKET_NS, 0);
+  }
+  if (!allocated_bytes.contains(index + 1)) {
+    track->AddValue((index + 1) * ALLOCATION_RATE_BUCKET_NS, 0);
+  }
+  tracks_need_sorting_ = true;
+  NeedsIncrementalUpdate();
+}
+
+void TimeGraph::ProcessCpuPowerEvent(const CpuPowerEvent& cpu_power_event) {
+  CpuPowerState& state = cpu_power_states_[cpu_power_event.cpu()];
+  auto get_mhz = [&state] {
+    return state.idle ? 0.0 : state.frequency_khz / 1000.0;
+  };
+  const double previous_mhz = get_mhz();
+  if (cpu_power_event.has_frequency_khz()) {
+    state.frequency_khz = cpu_power_event.frequency_khz();
+  } else {
+    state.idle = cpu_power_event.idle_state() >= 0;
+  }
+  // Nothing to show before the frequency of the core is known.
+  if (state.frequency_khz == 0) {
+    return;
+  }
+
+  // The frequency holds until the next event: the previous value is repeated
+  // just before this one, so that the graph is a step.
+  std::shared_ptr<GraphTrack> track =
+      GetOrCreateCpuFrequencyTrack(cpu_power_event.cpu());
+  uint64_t timestamp_ns = cpu_power_event.timestamp_ns();
+  if (!track->IsEmpty() && timestamp_ns > 0) {
+    track->AddValue(timestamp_ns - 1, previous_mhz);
+  }
+  track->AddValue(timestamp_ns, get_mhz());
+  tracks_need_sorting_ = true;
+  NeedsIncrementalUpdate();
+}
+
+void TimeGraph::ProcessPageFault(ThreadID thread_id, uint64_t timestamp_ns,
+                                 bool major) {
+  GetOrCreateThreadTrack(thread_id)->OnPageFault(timestamp_ns, major);
+  tracks_need_sorting_ = true;
+  NeedsRedraw();
+}
+
+void TimeGraph::ProcessPageFaultStats(const PageFaultStats& page_fault_stats) {
+  GetOrCreateThreadTrack(page_fault_stats.tid())
+      ->SetPageFaultStats(page_fault_stats);
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::EnqueueTimers(absl::Span<TimerInfo> timers) {
+  enqueued_timers_.enqueue_bulk(std::make_move_iterator(timers.begin()),
+                                timers.size());
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::EnqueueSchedulingSliceCounters(
+    SchedulingSliceCounters scheduling_slice_counters) {
+  enqueued_scheduling_slice_counters_.enqueue(
+      std::move(scheduling_slice_counters));
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::EnqueueThreadWakeup(ThreadWakeup thread_wakeup) {
+  enqueued_thread_wakeups_.enqueue(std::move(thread_wakeup));
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::EnqueueAllocation(ThreadID thread_id, uint64_t timestamp_ns,
+                                  uint64_t sampled_bytes) {
+  enqueued_allocations_.enqueue(
+      Allocation{thread_id, timestamp_ns, sampled_bytes});
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::EnqueueCpuPowerEvent(CpuPowerEvent cpu_power_event) {
+  enqueued_cpu_power_events_.enqueue(std::move(cpu_power_event));
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::EnqueuePageFault(ThreadID thread_id, uint64_t timestamp_ns,
+                                 bool major) {
+  enqueued_page_faults_.enqueue(PageFault{thread_id, timestamp_ns, major});
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::EnqueuePageFaultStats(PageFaultStats page_fault_stats) {
+  enqueued_page_fault_stats_.enqueue(std::move(page_fault_stats));
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::ProcessEnqueuedEvents() {
+  constexpr size_t kMaxDequeuedEvents = 4096;
+  // m_Mutex is recursive: taking it once here makes the locking of each event
+  // uncontended.
+  ScopeLock lock(m_Mutex);
+  dequeued_timers_.resize(kMaxDequeuedEvents);
+  size_t dequeued_count;
+  while ((dequeued_count = enqueued_timers_.try_dequeue_bulk(
+              dequeued_timers_.begin(), kMaxDequeuedEvents)) > 0) {
+    for (size_t i = 0; i < dequeued_count; ++i) {
+      ProcessTimer(std::move(dequeued_timers_[i]));
+    }
+  }
+
+  dequeued_scheduling_slice_counters_.resize(kMaxDequeuedEvents);
+  while ((dequeued_count = enqueued_scheduling_slice_counters_.try_dequeue_bulk(
+              dequeued_scheduling_slice_counters_.begin(),
+              kMaxDequeuedEvents)) > 0) {
+    for (size_t i = 0; i < dequeued_count; ++i) {
+      ProcessSchedulingSliceCounters(dequeued_scheduling_slice_counters_[i]);
+    }
+  }
+
+  dequeued_thread_wakeups_.resize(kMaxDequeuedEvents);
+  while ((dequeued_count = enqueued_thread_wakeups_.try_dequeue_bulk(
+              dequeued_thread_wakeups_.begin(), kMaxDequeuedEvents)) > 0) {
+    for (size_t i = 0; i < dequeued_count; ++i) {
+      ProcessThreadWakeup(dequeued_thread_wakeups_[i]);
+    }
+  }
+
+  dequeued_allocations_.resize(kMaxDequeuedEvents);
+  while ((dequeued_count = enqueued_allocations_.try_dequeue_bulk(
+              dequeued_allocations_.begin(), kMaxDequeuedEvents)) > 0) {
+    for (size_t i = 0; i < dequeued_count; ++i) {
+      const Allocation& allocation = dequeued_allocations_[i];
+      ProcessAllocation(allocation.thread_id, allocation.timestamp_ns,
+                        allocation.sampled_bytes);
+    }
+  }
+
+  dequeued_cpu_power_events_.resize(kMaxDequeuedEvents);
+  while ((dequeued_count = enqueued_cpu_power_events_.try_dequeue_bulk(
+              dequeued_cpu_power_events_.begin(), kMaxDequeuedEvents)) > 0) {
+    for (size_t i = 0; i < dequeued_count; ++i) {
+      ProcessCpuPowerEvent(dequeued_cpu_power_events_[i]);
+    }
+  }
+
+  dequeued_page_faults_.resize(kMaxDequeuedEvents);
+  while ((dequeued_count = enqueued_page_faults_.try_dequeue_bulk(
+              dequeued_page_faults_.begin(), kMaxDequeuedEvents)) > 0) {
+    for (size_t i = 0; i < dequeued_count; ++i) {
+      const PageFault& page_fault = dequeued_page_faults_[i];
+      ProcessPageFault(page_fault.thread_id, page_fault.timestamp_ns,
+                       page_fault.major);
+    }
+  }
+
+  dequeued_page_fault_stats_.resize(kMaxDequeuedEvents);
+  while ((dequeued_count = enqueued_page_fault_stats_.try_dequeue_bulk(
+              dequeued_page_fault_stats_.begin(), kMaxDequeuedEvents)) > 0) {
+    for (size_t i = 0; i < dequeued_count; ++i) {
+      ProcessPageFaultStats(dequeued_page_fault_stats_[i]);
+    }
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -397,7 +786,7 @@ std::vector<std::shared_ptr<TimerChain>> TimeGraph::GetAllTimerChains() const {
 std::vector<std::shared_ptr<TimerChain>>
 TimeGraph::GetAllThreadTrackTimerChains() const {
   std::vector<std::shared_ptr<TimerChain>> chains;
-  for (const auto& [_, track] : thread_tracks_) {
+  for (const auto& track : thread_tracks_) {
     Append(chains, track->GetAllChains());
   }
   return chains;
@@ -468,73 +857,65 @@ void TimeGraph::Select(const TextBox* a_TextBox) {
 const TextBox* TimeGraph::FindPreviousFunctionCall(
     uint64_t function_address, TickType current_time,
     std::optional<int32_t> thread_ID) const {
-  TextBox* previous_box = nullptr;
-  TickType previous_box_time = std::numeric_limits<TickType>::lowest();
-  std::vector<std::shared_ptr<TimerChain>> chains =
-      GetAllThreadTrackTimerChains();
-  for (auto& chain : chains) {
-    if (!chain) continue;
-    for (TimerChainIterator it = chain->begin(); it != chain->end(); ++it) {
-      TimerBlock& block = *it;
-      if (!block.Intersects(previous_box_time, current_time)) continue;
-      for (uint64_t i = 0; i < block.size(); i++) {
-        TextBox& box = block[i];
-        auto box_time = box.GetTimerInfo().end();
-        if ((box.GetTimerInfo().function_address() == function_address) &&
-            (!thread_ID ||
-             thread_ID.value() == box.GetTimerInfo().thread_id()) &&
-            (box_time < current_time) && (previous_box_time < box_time)) {
-          previous_box = &box;
-          previous_box_time = box_time;
-        }
-      }
-    }
-  }
-  return previous_box;
+  return function_call_index_.FindPrevious(function_address, current_time,
+                                           thread_ID);
 }
 
 const TextBox* TimeGraph::FindNextFunctionCall(
     uint64_t function_address, TickType current_time,
     std::optional<int32_t> thread_ID) const {
-  TextBox* next_box = nullptr;
-  TickType next_box_time = std::numeric_limits<TickType>::max();
-  std::vector<std::shared_ptr<TimerChain>> chains =
-      GetAllThreadTrackTimerChains();
-  for (auto& chain : chains) {
-    if (!chain) continue;
-    for (TimerChainIterator it = chain->begin(); it != chain->end(); ++it) {
-      TimerBlock& block = *it;
-      if (!block.Intersects(current_time, next_box_time)) continue;
-      for (uint64_t i = 0; i < block.size(); i++) {
-        TextBox& box = block[i];
-        auto box_time = box.GetTimerInfo().end();
-        if ((box.GetTimerInfo().function_address() == function_address) &&
-            (!thread_ID ||
-             thread_ID.value() == box.GetTimerInfo().thread_id()) &&
-            (box_time > current_time) && (next_box_time > box_time)) {
-          next_box = &box;
-          next_box_time = box_time;
-        }
-      }
-    }
-  }
-  return next_box;
+  return function_call_index_.FindNext(function_address, current_time,
+                                       thread_ID);
 }
 
 //-----------------------------------------------------------------------------
 void TimeGraph::NeedsUpdate() {
+  needs_full_update_ = true;
+  NeedsIncrementalUpdate();
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::NeedsIncrementalUpdate() {
   m_NeedsUpdatePrimitives = true;
   // If the primitives need to be updated, we also have to redraw.
   m_NeedsRedraw = true;
 }
 
+//-----------------------------------------------------------------------------
+bool TimeGraph::CanUpdateIncrementally(
+    PickingMode picking_mode, const std::vector<float>& track_heights) const {
+  const PrimitivesView& view = primitives_view_;
+  // The time window of a scrolling view still varies by rounding errors.
+  constexpr double kMaxTimeWindowError = 1e-9;
+  if (needs_full_update_ || picking_mode != PickingMode::kNone ||
+      capture_min_timestamp_ != view.capture_min_timestamp ||
+      std::abs(m_TimeWindowUs - view.time_window_us) >
+          kMaxTimeWindowError * view.time_window_us ||
+      m_WorldStartX != view.world_start_x || m_WorldWidth != view.world_width ||
+      timer_colors_key_ != view.timer_colors_key ||
+      track_heights != view.track_heights) {
+    return false;
+  }
+
+  // Once the view has scrolled by its width, all the kept primitives are out
+  // of it, so they are rebuilt rather than accumulated further.
+  if (m_MinTimeUs < view.min_time_us ||
+      m_MinTimeUs - view.min_time_us >= m_TimeWindowUs) {
+    return false;
+  }
+
+  return std::equal(sorted_tracks_.begin(), sorted_tracks_.end(),
+                    view.tracks.begin(), view.tracks.end(),
+                    [](const std::shared_ptr<Track>& track,
+                       const Track* view_track) {
+                      return track.get() == view_track;
+                    });
+}
+
 //-----------------------------------------------------------------------------
 void TimeGraph::UpdatePrimitives(PickingMode picking_mode) {
   CHECK(string_manager_);
 
-  m_Batcher.Reset();
-  m_TextRendererStatic.Clear();
-
   UpdateMaxTimeStamp(GEventTracer.GetEventBuffer().GetMaxTime());
 
   m_SceneBox = m_Canvas->GetSceneBox();
@@ -544,24 +925,113 @@ void TimeGraph::UpdatePrimitives(PickingMode picking_mode) {
   TickType min_tick = GetTickFromUs(m_MinTimeUs);
   TickType max_tick = GetTickFromUs(m_MaxTimeUs);
 
+  // Tracks compare this to the key their timer instances were colored with.
+  uint64_t colors_key = Capture::GSelectedThreadId;
+  colors_key = colors_key * 31 + static_cast<uint32_t>(Capture::GProcessId);
+  for (const auto& pair : Capture::GVisibleFunctionsMap) {
+    colors_key = colors_key * 31 + pair.first;
+  }
+  UpdateTimerSearchMatches();
+  colors_key = colors_key * 31 + timer_search_generation_;
+  timer_colors_key_ = colors_key;
+
   SortTracks();
+  // The instance renderer builds its shaders on first use, which must happen
+  // on this thread, with the OpenGL context current.
+  if (absl::GetFlag(FLAGS_instanced_timers)) {
+    (void)timer_instance_renderer_.IsAvailable();
+  }
 
+  // The position of a track only depends on the heights of the tracks above
+  // it, so all positions are set before the tracks are updated.
+  std::vector<float> track_heights;
+  track_heights.reserve(sorted_tracks_.size());
   float current_y = -m_Layout.GetSchedulerTrackOffset();
-
   for (auto& track : sorted_tracks_) {
     track->SetY(current_y);
-    track->UpdatePrimitives(min_tick, max_tick, picking_mode);
-    current_y -= (track->GetHeight() + m_Layout.GetSpaceBetweenTracks());
+    track_heights.push_back(track->GetHeight());
+    current_y -= (track_heights.back() + m_Layout.GetSpaceBetweenTracks());
+  }
+
+  const bool incremental = CanUpdateIncrementally(picking_mode, track_heights);
+  const double min_time_us = m_MinTimeUs;
+  if (incremental) {
+    // The new primitives are added in the coordinates of the kept ones.
+    m_MinTimeUs = primitives_view_.min_time_us;
+    primitives_offset_x_ = static_cast<float>(
+        (primitives_view_.min_time_us - min_time_us) / m_TimeWindowUs *
+        m_WorldWidth);
+  } else {
+    m_Batcher.Reset();
+    m_TextRendererStatic.Clear();
+    primitives_offset_x_ = 0.f;
+    PrimitivesView& view = primitives_view_;
+    view.capture_min_timestamp = capture_min_timestamp_;
+    view.min_time_us = m_MinTimeUs;
+    view.time_window_us = m_TimeWindowUs;
+    view.world_start_x = m_WorldStartX;
+    view.world_width = m_WorldWidth;
+    view.timer_colors_key = timer_colors_key_;
+    view.tracks.clear();
+    for (const auto& track : sorted_tracks_) {
+      view.tracks.push_back(track.get());
+    }
+    view.track_heights = track_heights;
+  }
+  m_TextRendererStatic.SetWorldOffsetX(primitives_offset_x_);
+  // The primitives of picking don't have the colors of the regular ones.
+  needs_full_update_ = picking_mode != PickingMode::kNone;
+
+  // As the groups are appended in order, the primitives, and thus their
+  // picking ids, are the same as if the tracks were updated one by one.
+  const size_t track_count = sorted_tracks_.size();
+  const size_t group_count = std::min(track_count, kMaxTrackGroupCount);
+  while (track_group_batchers_.size() < group_count) {
+    track_group_batchers_.push_back(
+        std::make_unique<Batcher>(PickingID::BatcherId::TIME_GRAPH));
+  }
+  track_group_texts_.resize(track_group_batchers_.size());
+  ParallelFor(update_thread_pool_.get(), 0, group_count, [&](size_t group) {
+    const size_t begin = group * track_count / group_count;
+    const size_t end = (group + 1) * track_count / group_count;
+    for (size_t i = begin; i < end; ++i) {
+      sorted_tracks_[i]->SetPrimitivesTarget(
+          track_group_batchers_[group].get(), &track_group_texts_[group]);
+      if (incremental) {
+        sorted_tracks_[i]->UpdateNewPrimitives(min_tick, max_tick);
+      } else {
+        sorted_tracks_[i]->UpdatePrimitives(min_tick, max_tick, picking_mode);
+      }
+    }
+  });
+  m_MinTimeUs = min_time_us;
+  for (size_t group = 0; group < group_count; ++group) {
+    m_Batcher.Append(track_group_batchers_[group].get());
+    track_group_texts_[group].AddTo(&m_TextRendererStatic);
+    track_group_texts_[group].Clear();
+  }
+
+  // Updating a track can increase its depth, and thus its height. The tracks
+  // below it are then moved by the next update.
+  bool track_heights_changed = false;
+  current_y = -m_Layout.GetSchedulerTrackOffset();
+  for (size_t i = 0; i < track_count; ++i) {
+    const float track_height = sorted_tracks_[i]->GetHeight();
+    track_heights_changed |= track_height != track_heights[i];
+    current_y -= (track_height + m_Layout.GetSpaceBetweenTracks());
   }
 
   min_y_ = current_y;
+  if (track_heights_changed) {
+    NeedsUpdate();
+    return;
+  }
   m_NeedsUpdatePrimitives = false;
 }
 
 //-----------------------------------------------------------------------------
-std::vector<CallstackEvent> TimeGraph::SelectEvents(float a_WorldStart,
-                                                    float a_WorldEnd,
-                                                    ThreadID a_TID) {
+void TimeGraph::SelectEvents(float a_WorldStart, float a_WorldEnd,
+                             ThreadID a_TID) {
   if (a_WorldStart > a_WorldEnd) {
     std::swap(a_WorldEnd, a_WorldStart);
   }
@@ -569,15 +1039,11 @@ std::vector<CallstackEvent> TimeGraph::SelectEvents(float a_WorldStart,
   TickType t0 = GetTickFromWorld(a_WorldStart);
   TickType t1 = GetTickFromWorld(a_WorldEnd);
 
-  std::vector<CallstackEvent> selected_callstack_events =
-      GEventTracer.GetEventBuffer().GetCallstackEvents(t0, t1, a_TID);
-
-  selected_callstack_events_per_thread_.clear();
-  for (CallstackEvent& event : selected_callstack_events) {
-    selected_callstack_events_per_thread_[event.thread_id()].emplace_back(
-        event);
-    selected_callstack_events_per_thread_[0].emplace_back(event);
-  }
+  // The event tracks draw the selected events from the EventBuffer, which
+  // they are sorted by time in, so this doesn't copy them.
+  selected_thread_id_ = a_TID;
+  selection_min_tick_ = t0;
+  selection_max_tick_ = t1;
 
   // Generate selection report.
   std::shared_ptr<SamplingProfiler> samplingProfiler =
@@ -585,10 +1051,17 @@ std::vector<CallstackEvent> TimeGraph::SelectEvents(float a_WorldStart,
 
   samplingProfiler->SetGenerateSummary(a_TID == 0);
 
-  for (CallstackEvent& event : selected_callstack_events) {
-    if (Capture::GSamplingProfiler->GetCallStack(event.callstack_hash())) {
-      samplingProfiler->AddCallStack(event);
-    }
+  // Counting the samples from the index, rather than adding every selected
+  // sample, keeps this fast enough to follow the mouse.
+  CallstackCountIndex* callstack_count_index =
+      Capture::GSamplingProfiler->GetCallstackCountIndex();
+  const std::vector<ThreadID> thread_ids =
+      a_TID == 0 ? callstack_count_index->GetThreadIds()
+                 : std::vector<ThreadID>{a_TID};
+  for (ThreadID thread_id : thread_ids) {
+    samplingProfiler->AddCallstackCounts(
+        thread_id,
+        callstack_count_index->GetCallstackCounts(thread_id, t0, t1));
   }
   samplingProfiler->ProcessSamples();
 
@@ -597,13 +1070,19 @@ std::vector<CallstackEvent> TimeGraph::SelectEvents(float a_WorldStart,
   }
 
   NeedsUpdate();
-
-  return selected_callstack_events;
 }
 
-const std::vector<CallstackEvent>& TimeGraph::GetSelectedCallstackEvents(
-    ThreadID tid) {
-  return selected_callstack_events_per_thread_[tid];
+CallstackEventsByTime::Range TimeGraph::GetSelectedCallstackEvents(
+    ThreadID tid) const {
+  // Called while tracks are updated in parallel, which only read the
+  // selection.
+  if (tid != 0 && selected_thread_id_ != 0 && tid != selected_thread_id_) {
+    return CallstackEventsByTime::Range();
+  }
+  const ThreadID thread_id = tid == 0 ? selected_thread_id_ : tid;
+  return GEventTracer.GetEventBuffer()
+      .GetCallstackEventsOfThread(thread_id)
+      .GetRange(selection_min_tick_, selection_max_tick_);
 }
 
 //-----------------------------------------------------------------------------
@@ -615,7 +1094,10 @@ void TimeGraph::Draw(GlCanvas* canvas, PickingMode picking_mode) {
 
   DrawTracks(canvas, picking_mode);
   DrawOverlay(canvas, picking_mode);
+  glPushMatrix();
+  glTranslatef(primitives_offset_x_, 0.f, 0.f);
   m_Batcher.Draw(picking);
+  glPopMatrix();
 
   m_NeedsRedraw = false;
 }
@@ -771,6 +1253,41 @@ void TimeGraph::DrawOverlay(GlCanvas* canvas, PickingMode picking_mode) {
   }
 }
 
+//-----------------------------------------------------------------------------
+std::optional<TimeGraph::PickedTimer> TimeGraph::PickTimer(float world_x,
+                                                           float world_y) {
+  if (m_Canvas == nullptr || m_Canvas->getWidth() <= 0 ||
+      m_TimeWindowUs <= 0) {
+    return std::nullopt;
+  }
+  const TickType tick = GetTickFromWorld(world_x);
+  // Timers narrower than a pixel are drawn as one pixel wide lines.
+  const uint64_t tick_tolerance =
+      static_cast<uint64_t>(MicrosecondsToTicks(m_TimeWindowUs)) /
+      m_Canvas->getWidth();
+
+  for (auto& track : sorted_tracks_) {
+    const Vec2 pos = track->GetPos();
+    if (world_y > pos[1] || world_y < pos[1] - track->GetHeight()) continue;
+    const Track::Type type = track->GetType();
+    if (track->IsMoving() ||
+        (type != Track::kTimerTrack && type != Track::kThreadTrack &&
+         type != Track::kGpuTrack && type != Track::kAsyncTrack &&
+         type != Track::kFrameTrack && type != Track::kSchedulerTrack)) {
+      return std::nullopt;
+    }
+
+    auto timer_track = std::static_pointer_cast<TimerTrack>(track);
+    TextBox* text_box =
+        timer_track->GetTimerAt(world_y, tick, tick_tolerance);
+    if (text_box == nullptr) {
+      return std::nullopt;
+    }
+    return PickedTimer{timer_track.get(), text_box};
+  }
+  return std::nullopt;
+}
+
 //-----------------------------------------------------------------------------
 void TimeGraph::DrawTracks(GlCanvas* canvas, PickingMode picking_mode) {
   uint32_t num_cores = GetNumCores();
@@ -787,7 +1304,8 @@ void TimeGraph::DrawTracks(GlCanvas* canvas, PickingMode picking_mode) {
         thread_track->SetName(process_name);
         thread_track->SetLabel(process_name + " (all threads)");
       } else {
-        const std::string& thread_name = Capture::GThreadNames[tid];
+        const std::string thread_name =
+            Capture::GCaptureData.GetThreadName(tid);
         track->SetName(thread_name);
         std::string track_label = absl::StrFormat("%s [%u]", thread_name, tid);
         track->SetLabel(track_label);
@@ -812,14 +1330,28 @@ std::shared_ptr<SchedulerTrack> TimeGraph::GetOrCreateSchedulerTrack() {
 
 std::shared_ptr<ThreadTrack> TimeGraph::GetOrCreateThreadTrack(ThreadID a_TID) {
   ScopeLock lock(m_Mutex);
-  std::shared_ptr<ThreadTrack> track = thread_tracks_[a_TID];
-  if (track == nullptr) {
-    track = std::make_shared<ThreadTrack>(this, a_TID);
+  return thread_tracks_[GetOrCreateThreadIndex(a_TID)];
+}
+
+uint32_t TimeGraph::GetOrCreateThreadIndex(ThreadID thread_id) {
+  const uint32_t thread_index = thread_index_.GetOrAssign(thread_id);
+  if (thread_index == thread_tracks_.size()) {
+    auto track = std::make_shared<ThreadTrack>(this, thread_id);
     tracks_.emplace_back(track);
-    thread_tracks_[a_TID] = track;
-    track->SetEventTrackColor(GetThreadColor(a_TID));
+    thread_tracks_.push_back(track);
+    thread_timer_counts_.push_back(0);
+    thread_event_counts_.push_back(0);
+    track->SetEventTrackColor(GetThreadColor(thread_id));
   }
-  return track;
+  return thread_index;
+}
+
+std::shared_ptr<ThreadTrack> TimeGraph::FindThreadTrack(
+    ThreadID thread_id) const {
+  ScopeLock lock(m_Mutex);
+  std::optional<uint32_t> thread_index = thread_index_.Find(thread_id);
+  return thread_index.has_value() ? thread_tracks_[thread_index.value()]
+                                  : nullptr;
 }
 
 std::shared_ptr<GpuTrack> TimeGraph::GetOrCreateGpuTrack(
@@ -839,95 +1371,341 @@ std::shared_ptr<GpuTrack> TimeGraph::GetOrCreateGpuTrack(
   return track;
 }
 
+std::shared_ptr<AsyncTrack> TimeGraph::GetOrCreateAsyncTrack(
+    uint64_t name_hash) {
+  ScopeLock lock(m_Mutex);
+  std::shared_ptr<AsyncTrack>& track = async_tracks_[name_hash];
+  if (track == nullptr) {
+    track = std::make_shared<AsyncTrack>(this);
+    std::string name = string_manager_->Get(name_hash).value_or("");
+    track->SetName(name);
+    track->SetLabel(absl::StrFormat("%s (async)", name));
+    tracks_.emplace_back(track);
+  }
+
+  return track;
+}
+
+std::shared_ptr<FrameTrack> TimeGraph::GetOrCreateFrameTrack(
+    uint64_t name_hash) {
+  ScopeLock lock(m_Mutex);
+  std::shared_ptr<FrameTrack>& track = frame_tracks_[name_hash];
+  if (track == nullptr) {
+    track = std::make_shared<FrameTrack>(this);
+    std::string name = string_manager_->Get(name_hash).value_or("");
+    track->SetName(name);
+    track->SetLabel(absl::StrFormat("%s (frames)", name));
+    tracks_.emplace_back(track);
+
+    // The function calls so far, e.g., those of the chunks of a capture
+    // loaded before the first frame.
+    for (const std::shared_ptr<TimerChain>& chain :
+         GetAllThreadTrackTimerChains()) {
+      if (!chain) continue;
+      for (TimerChainIterator it = chain->begin(); it != chain->end(); ++it) {
+        const TimerBlock& block = *it;
+        for (uint64_t i = 0; i < block.size(); ++i) {
+          const TimerInfo& timer_info = block[i].GetTimerInfo();
+          if (timer_info.function_address() > 0) {
+            track->AddFunctionCall(timer_info.start(), timer_info.end());
+          }
+        }
+      }
+    }
+  }
+
+  return track;
+}
+
+std::vector<FrameTrack::FrameInfo> TimeGraph::GetLongestFrames(
+    size_t count) const {
+  ScopeLock lock(m_Mutex);
+  std::vector<FrameTrack::FrameInfo> frames;
+  for (const auto& [unused_name_hash, track] : frame_tracks_) {
+    Append(frames, track->GetLongestFrames(count));
+  }
+  std::stable_sort(frames.begin(), frames.end(),
+                   [](const FrameTrack::FrameInfo& a,
+                      const FrameTrack::FrameInfo& b) {
+                     return a.frame.GetDurationNs() > b.frame.GetDurationNs();
+                   });
+  if (frames.size() > count) {
+    frames.resize(count);
+  }
+  return frames;
+}
+
+std::shared_ptr<GraphTrack> TimeGraph::GetOrCreateCounterTrack(
+    ThreadID thread_id, const std::string& counter_name) {
+  ScopeLock lock(m_Mutex);
+  std::shared_ptr<GraphTrack>& track =
+      counter_tracks_[thread_id][counter_name];
+  if (track == nullptr) {
+    track = std::make_shared<GraphTrack>(this);
+    track->SetName(absl::StrFormat("%s [%d]", counter_name, thread_id));
+    track->SetLabel(counter_name);
+    tracks_.emplace_back(track);
+  }
+  return track;
+}
+
+std::shared_ptr<GraphTrack> TimeGraph::GetOrCreateCpuFrequencyTrack(
+    int32_t cpu) {
+  ScopeLock lock(m_Mutex);
+  std::shared_ptr<GraphTrack>& track = cpu_frequency_tracks_[cpu];
+  if (track == nullptr) {
+    track = std::make_shared<GraphTrack>(this);
+    track->SetName(absl::StrFormat("CPU %d MHz", cpu));
+    track->SetLabel(absl::StrFormat("CPU %d MHz", cpu));
+    tracks_.emplace_back(track);
+  }
+  return track;
+}
+
+void TimeGraph::UpdateThreadCpuUsage(ThreadID thread_id, uint64_t start_ns,
+                                     uint64_t end_ns) {
+  if (end_ns <= start_ns) return;
+  OccupancyPyramid& cpu_usage =
+      thread_cpu_usages_.try_emplace(thread_id, THREAD_CPU_USAGE_BUCKET_NS)
+          .first->second;
+  cpu_usage.AddSlice(start_ns, end_ns);
+
+  // The empty buckets around the slice are set too, so that the graph drops
+  // to zero while the thread doesn't run. A later slice can fill them.
+  std::shared_ptr<GraphTrack> track =
+      GetOrCreateCounterTrack(thread_id, "CPU usage");
+  const uint64_t first_index = start_ns / THREAD_CPU_USAGE_BUCKET_NS;
+  const uint64_t last_index = (end_ns - 1) / THREAD_CPU_USAGE_BUCKET_NS;
+  auto set_bucket_value = [&](uint64_t index) {
+    const uint64_t busy_ns = cpu_usage.GetBusyNs(0, index);
+    track->AddValue(index * THREAD_CPU_USAGE_BUCKET_NS,
+                    100.0 * busy_ns / THREAD_CPU_USAGE_BUCKET_NS);
+  };
+  if (first_index > 0 && cpu_usage.GetBusyNs(0, first_index - 1) == 0) {
+    set_bucket_value(first_index - 1);
+  }
+  for (uint64_t index = first_index; index <= last_index; ++index) {
+    set_bucket_value(index);
+  }
+  if (cpu_usage.GetBusyNs(0, last_index + 1) == 0) {
+    set_bucket_value(last_index + 1);
+  }
+  tracks_need_sorting_ = true;
+}
+
 //-----------------------------------------------------------------------------
 void TimeGraph::SetThreadFilter(const std::string& a_Filter) {
   m_ThreadFilter = a_Filter;
+  thread_filters_ = absl::StrSplit(ToLower(a_Filter), ' ', absl::SkipEmpty());
+  tracks_need_sorting_ = true;
   NeedsUpdate();
 }
 
+//-----------------------------------------------------------------------------
+void TimeGraph::SetTimerSearch(const std::string& search) {
+  std::vector<std::string> tokens =
+      absl::StrSplit(ToLower(search), ' ', absl::SkipEmpty());
+  if (tokens == timer_search_tokens_) {
+    return;
+  }
+  timer_search_tokens_ = std::move(tokens);
+  timer_search_function_count_.reset();
+  NeedsUpdate();
+}
+
+void TimeGraph::UpdateTimerSearchMatches() {
+  if (timer_search_function_count_ == resolved_function_count_) {
+    return;
+  }
+  timer_search_function_count_ = resolved_function_count_;
+  timer_search_addresses_.clear();
+  timer_search_matches_.clear();
+  ++timer_search_generation_;
+  if (timer_search_tokens_.empty()) {
+    return;
+  }
+
+  // The names of the functions of the timers are searched with the index of
+  // the functions view, built for the few functions that have timers.
+  std::vector<uint64_t> addresses;
+  std::vector<std::string> names;
+  for (const auto& [address, function] : functions_by_address_) {
+    if (function == nullptr) continue;
+    addresses.push_back(address);
+    names.push_back(FunctionUtils::GetDisplayName(*function));
+  }
+  SubstringSearchIndex search_index(names);
+  for (uint32_t index : search_index.Find(timer_search_tokens_)) {
+    timer_search_addresses_.push_back(addresses[index]);
+  }
+  timer_search_matches_.insert(timer_search_addresses_.begin(),
+                               timer_search_addresses_.end());
+}
+
+uint64_t TimeGraph::GetTimerSearchMatchCount() {
+  UpdateTimerSearchMatches();
+  uint64_t count = 0;
+  for (uint64_t address : timer_search_addresses_) {
+    count += function_call_index_.GetCallCount(address);
+  }
+  return count;
+}
+
+void TimeGraph::JumpToTimerSearchMatch(JumpDirection jump_direction) {
+  CHECK(jump_direction == JumpDirection::kPrevious ||
+        jump_direction == JumpDirection::kNext);
+  UpdateTimerSearchMatches();
+  const TextBox* selected = Capture::GSelectedTextBox;
+  const TextBox* goal = nullptr;
+  if (jump_direction == JumpDirection::kPrevious) {
+    const TickType timestamp = selected != nullptr
+                                   ? selected->GetTimerInfo().end()
+                                   : GetTickFromUs(m_MaxTimeUs) + 1;
+    goal = function_call_index_.FindPreviousOfAny(timer_search_addresses_,
+                                                  timestamp);
+  } else {
+    const TickType timestamp = selected != nullptr
+                                   ? selected->GetTimerInfo().end()
+                                   : GetTickFromUs(m_MinTimeUs);
+    goal =
+        function_call_index_.FindNextOfAny(timer_search_addresses_, timestamp);
+  }
+  if (goal != nullptr) {
+    Select(goal);
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool TimeGraph::MatchesThreadFilter(const Track& track) {
+  auto& [name, lowercase_name] = lowercase_track_names_[&track];
+  if (name != track.GetName()) {
+    name = track.GetName();
+    lowercase_name = ToLower(name);
+  }
+  return std::any_of(thread_filters_.begin(), thread_filters_.end(),
+                     [&lowercase_name](const std::string& filter) {
+                       return absl::StrContains(lowercase_name, filter);
+                     });
+}
+
 //-----------------------------------------------------------------------------
 void TimeGraph::SortTracks() {
+  const uint64_t event_max_time = GEventTracer.GetEventBuffer().GetMaxTime();
+  if (event_max_time != sorted_event_max_time_) {
+    tracks_need_sorting_ = true;
+  }
+  if (!tracks_need_sorting_) {
+    return;
+  }
+  // Reorder threads once every second when capturing
+  if (Capture::IsCapturing() && m_LastThreadReorder.QueryMillis() <= 1000.0) {
+    return;
+  }
+  // Cleared first, so that the events added meanwhile set it again.
+  tracks_need_sorting_ = false;
+  sorted_event_max_time_ = event_max_time;
+
   // Get or create thread track from events' thread id.
   {
-    ScopeLock lock(GEventTracer.GetEventBuffer().GetMutex());
-    m_EventCount.clear();
-
-    for (auto& pair : GEventTracer.GetEventBuffer().GetCallstacks()) {
-      ThreadID threadID = pair.first;
-      std::map<uint64_t, CallstackEvent>& callstacks = pair.second;
-      m_EventCount[threadID] = callstacks.size();
-      GetOrCreateThreadTrack(threadID);
-    }
+    ScopeLock event_lock(GEventTracer.GetEventBuffer().GetMutex());
+    ScopeLock lock(m_Mutex);
+    GEventTracer.GetEventBuffer().ForEachThread(
+        [this](ThreadID thread_id, const CallstackEventsByTime& callstacks) {
+          thread_event_counts_[GetOrCreateThreadIndex(thread_id)] =
+              callstacks.size();
+        });
   }
 
-  // Reorder threads once every second when capturing
-  if (!Capture::IsCapturing() || m_LastThreadReorder.QueryMillis() > 1000.0) {
-    std::vector<ThreadID> sortedThreadIds;
-
-    // Show threads with instrumented functions first
-    std::vector<std::pair<ThreadID, uint32_t>> sortedThreads =
-        OrbitUtils::ReverseValueSort(m_ThreadCountMap);
-    for (auto& pair : sortedThreads) {
-      // Track "0" holds all target process sampling info, it is handled
-      // separately.
-      if (pair.first != 0) sortedThreadIds.push_back(pair.first);
+  // Track "0" holds all target process sampling info, it is handled
+  // separately. Only the threads with timers or events get a track.
+  for (uint32_t thread_index = 0; thread_index < thread_index_.size();
+       ++thread_index) {
+    const ThreadID thread_id = thread_index_.GetThreadId(thread_index);
+    if (thread_id != 0 &&
+        (thread_timer_counts_[thread_index] > 0 ||
+         thread_event_counts_[thread_index] > 0) &&
+        sorted_thread_id_set_.insert(thread_id).second) {
+      sorted_thread_ids_.push_back(thread_id);
     }
+  }
 
-    // Then show threads sorted by number of events
-    std::vector<std::pair<ThreadID, uint32_t>> sortedByEvents =
-        OrbitUtils::ReverseValueSort(m_EventCount);
-    for (auto& pair : sortedByEvents) {
-      // Track "0" holds all target process sampling info, it is handled
-      // separately.
-      if (pair.first == 0) continue;
-      if (m_ThreadCountMap.find(pair.first) == m_ThreadCountMap.end()) {
-        sortedThreadIds.push_back(pair.first);
-      }
+  // Show threads with instrumented functions first, by number of timers, then
+  // the others by number of events. The sort is stable, so that the tracks
+  // only move when their rank changed.
+  std::vector<std::pair<std::pair<bool, uint32_t>, ThreadID>> ranked_threads;
+  ranked_threads.reserve(sorted_thread_ids_.size());
+  for (ThreadID thread_id : sorted_thread_ids_) {
+    const uint32_t thread_index = thread_index_.Find(thread_id).value();
+    const uint32_t timer_count = thread_timer_counts_[thread_index];
+    if (timer_count > 0) {
+      ranked_threads.push_back({{true, timer_count}, thread_id});
+    } else {
+      ranked_threads.push_back(
+          {{false, thread_event_counts_[thread_index]}, thread_id});
     }
+  }
+  std::stable_sort(
+      ranked_threads.begin(), ranked_threads.end(),
+      [](const auto& a, const auto& b) { return a.first > b.first; });
+  for (size_t i = 0; i < ranked_threads.size(); ++i) {
+    sorted_thread_ids_[i] = ranked_threads[i].second;
+  }
 
-    // Filter thread ids if needed
-    if (!m_ThreadFilter.empty()) {
-      std::vector<std::string> filters = absl::StrSplit(m_ThreadFilter, ' ');
-      std::vector<ThreadID> filteredThreadIds;
-      for (ThreadID tid : sortedThreadIds) {
-        std::shared_ptr<ThreadTrack> track = GetOrCreateThreadTrack(tid);
+  sorted_tracks_.clear();
 
-        for (auto& filter : filters) {
-          if (track && absl::StrContains(track->GetName(), filter)) {
-            filteredThreadIds.push_back(tid);
-          }
-        }
-      }
-      sortedThreadIds = filteredThreadIds;
+  // Scheduler Track.
+  if (!scheduler_track_->IsEmpty()) {
+    sorted_tracks_.emplace_back(scheduler_track_);
+  }
+
+  // CPU Frequency Tracks.
+  for (const auto& [unused_cpu, track] : cpu_frequency_tracks_) {
+    if (!track->IsEmpty()) {
+      sorted_tracks_.emplace_back(track);
     }
+  }
 
-    sorted_tracks_.clear();
+  // Frame Tracks.
+  for (const auto& [unused_name_hash, track] : frame_tracks_) {
+    sorted_tracks_.emplace_back(track);
+  }
 
-    // Scheduler Track.
-    if (!scheduler_track_->IsEmpty()) {
-      sorted_tracks_.emplace_back(scheduler_track_);
-    }
+  // Gpu Tracks.
+  for (const auto& timeline_and_track : gpu_tracks_) {
+    sorted_tracks_.emplace_back(timeline_and_track.second);
+  }
 
-    // Gpu Tracks.
-    for (const auto& timeline_and_track : gpu_tracks_) {
-      sorted_tracks_.emplace_back(timeline_and_track.second);
-    }
+  // Async Tracks.
+  for (const auto& [unused_name_hash, track] : async_tracks_) {
+    sorted_tracks_.emplace_back(track);
+  }
 
-    // Process Track.
-    if (!process_track_->IsEmpty()) {
-      sorted_tracks_.emplace_back(process_track_);
-    }
+  // Process Track.
+  if (!process_track_->IsEmpty()) {
+    sorted_tracks_.emplace_back(process_track_);
+  }
 
-    // Thread Tracks.
-    for (auto thread_id : sortedThreadIds) {
-      std::shared_ptr<ThreadTrack> track = GetOrCreateThreadTrack(thread_id);
-      if (!track->IsEmpty()) {
-        sorted_tracks_.emplace_back(track);
+  // Thread Tracks, filtered by name if needed.
+  for (ThreadID thread_id : sorted_thread_ids_) {
+    std::shared_ptr<ThreadTrack> track = GetOrCreateThreadTrack(thread_id);
+    if (!thread_filters_.empty() && !MatchesThreadFilter(*track)) {
+      continue;
+    }
+    if (!track->IsEmpty()) {
+      sorted_tracks_.emplace_back(track);
+    }
+    auto counter_tracks_it = counter_tracks_.find(thread_id);
+    if (counter_tracks_it != counter_tracks_.end()) {
+      for (const auto& [unused_name, counter_track] :
+           counter_tracks_it->second) {
+        if (!counter_track->IsEmpty()) {
+          sorted_tracks_.emplace_back(counter_track);
+        }
       }
     }
-
-    m_LastThreadReorder.Reset();
   }
+
+  m_LastThreadReorder.Reset();
 }
 
 void TimeGraph::SelectAndZoom(const TextBox* text_box) {
@@ -993,8 +1771,13 @@ void TimeGraph::JumpToNeighborBox(TextBox* from, JumpDirection jump_direction,
 const TextBox* TimeGraph::FindPrevious(TextBox* from) {
   CHECK(from);
   const TimerInfo& timer_info = from->GetTimerInfo();
-  if (timer_info.type() == TimerInfo::kGpuActivity) {
+  if (timer_info.type() == TimerInfo::kGpuActivity ||
+      timer_info.type() == TimerInfo::kGpuCommandBuffer) {
     return GetOrCreateGpuTrack(timer_info.timeline_hash())->GetLeft(from);
+  } else if (timer_info.type() == TimerInfo::kAsync) {
+    return GetOrCreateAsyncTrack(timer_info.user_data_key())->GetLeft(from);
+  } else if (timer_info.type() == TimerInfo::kFrame) {
+    return GetOrCreateFrameTrack(timer_info.user_data_key())->GetLeft(from);
   } else {
     return GetOrCreateThreadTrack(timer_info.thread_id())->GetLeft(from);
   }
@@ -1004,8 +1787,13 @@ const TextBox* TimeGraph::FindPrevious(TextBox* from) {
 const TextBox* TimeGraph::FindNext(TextBox* from) {
   CHECK(from);
   const TimerInfo& timer_info = from->GetTimerInfo();
-  if (timer_info.type() == TimerInfo::kGpuActivity) {
+  if (timer_info.type() == TimerInfo::kGpuActivity ||
+      timer_info.type() == TimerInfo::kGpuCommandBuffer) {
     return GetOrCreateGpuTrack(timer_info.timeline_hash())->GetRight(from);
+  } else if (timer_info.type() == TimerInfo::kAsync) {
+    return GetOrCreateAsyncTrack(timer_info.user_data_key())->GetRight(from);
+  } else if (timer_info.type() == TimerInfo::kFrame) {
+    return GetOrCreateFrameTrack(timer_info.user_data_key())->GetRight(from);
   } else {
     return GetOrCreateThreadTrack(timer_info.thread_id())->GetRight(from);
   }
@@ -1015,8 +1803,13 @@ const TextBox* TimeGraph::FindNext(TextBox* from) {
 const TextBox* TimeGraph::FindTop(TextBox* from) {
   CHECK(from);
   const TimerInfo& timer_info = from->GetTimerInfo();
-  if (timer_info.type() == TimerInfo::kGpuActivity) {
+  if (timer_info.type() == TimerInfo::kGpuActivity ||
+      timer_info.type() == TimerInfo::kGpuCommandBuffer) {
     return GetOrCreateGpuTrack(timer_info.timeline_hash())->GetUp(from);
+  } else if (timer_info.type() == TimerInfo::kAsync) {
+    return GetOrCreateAsyncTrack(timer_info.user_data_key())->GetUp(from);
+  } else if (timer_info.type() == TimerInfo::kFrame) {
+    return GetOrCreateFrameTrack(timer_info.user_data_key())->GetUp(from);
   } else {
     return GetOrCreateThreadTrack(timer_info.thread_id())->GetUp(from);
   }
@@ -1026,8 +1819,13 @@ const TextBox* TimeGraph::FindTop(TextBox* from) {
 const TextBox* TimeGraph::FindDown(TextBox* from) {
   CHECK(from);
   const TimerInfo& timer_info = from->GetTimerInfo();
-  if (timer_info.type() == TimerInfo::kGpuActivity) {
+  if (timer_info.type() == TimerInfo::kGpuActivity ||
+      timer_info.type() == TimerInfo::kGpuCommandBuffer) {
     return GetOrCreateGpuTrack(timer_info.timeline_hash())->GetDown(from);
+  } else if (timer_info.type() == TimerInfo::kAsync) {
+    return GetOrCreateAsyncTrack(timer_info.user_data_key())->GetDown(from);
+  } else if (timer_info.type() == TimerInfo::kFrame) {
+    return GetOrCreateFrameTrack(timer_info.user_data_key())->GetDown(from);
   } else {
     return GetOrCreateThreadTrack(timer_info.thread_id())->GetDown(from);
   }
@@ -5,30 +5,47 @@
 #ifndef ORBIT_GL_TIME_GRAPH_H_
 #define ORBIT_GL_TIME_GRAPH_H_
 
+#include <atomic>
+#include <map>
+#include <optional>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
+#include "AsyncTrack.h"
 #include "Batcher.h"
 #include "BlockChain.h"
 #include "ContextSwitch.h"
 #include "Core.h"
 #include "EventBuffer.h"
+#include "FrameTrack.h"
+#include "FunctionCallIndex.h"
+#include "FunctionTimeIndex.h"
 #include "Geometry.h"
 #include "GpuTrack.h"
+#include "GraphTrack.h"
+#include "OccupancyPyramid.h"
+#include "OrbitBase/ThreadPool.h"
 #include "SchedulerTrack.h"
 #include "ScopeTimer.h"
 #include "StringManager.h"
 #include "TextBox.h"
 #include "TextRenderer.h"
+#include "ThreadIndex.h"
 #include "ThreadTrack.h"
 #include "TimeGraphLayout.h"
 #include "TimerChain.h"
+#include "TimerInstanceRenderer.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/types/span.h"
+#include "capture.pb.h"
 #include "capture_data.pb.h"
 
 class TimeGraph {
  public:
   TimeGraph();
+  ~TimeGraph();
 
   void Draw(GlCanvas* canvas, PickingMode picking_mode = PickingMode::kNone);
   void DrawTracks(GlCanvas* canvas,
@@ -37,14 +54,52 @@ class TimeGraph {
   void DrawText(GlCanvas* canvas);
 
   void NeedsUpdate();
+  // Like NeedsUpdate, for when data was only added, or the view only moved
+  // along the time axis, like during a live capture. The primitives of the
+  // previous update are then kept if possible, and only those of the data
+  // added since are added to them.
+  void NeedsIncrementalUpdate();
   void UpdatePrimitives(PickingMode picking_mode);
+  // Orders the tracks and applies the thread filter again, if anything they
+  // depend on changed since the last call, at most once per second while
+  // capturing.
   void SortTracks();
-  std::vector<orbit_client_protos::CallstackEvent> SelectEvents(
-      float a_WorldStart, float a_WorldEnd, ThreadID a_TID);
-  const std::vector<orbit_client_protos::CallstackEvent>&
-  GetSelectedCallstackEvents(ThreadID tid);
-
-  void ProcessTimer(const orbit_client_protos::TimerInfo& timer_info);
+  void SelectEvents(float a_WorldStart, float a_WorldEnd, ThreadID a_TID);
+  // The selected events of the thread, of the selected thread for 0. The
+  // selection is kept as a time range, which this looks up in the EventBuffer,
+  // whose mutex must be held while the range is used.
+  [[nodiscard]] CallstackEventsByTime::Range GetSelectedCallstackEvents(
+      ThreadID tid) const;
+
+  void ProcessTimer(orbit_client_protos::TimerInfo timer_info);
+  void ProcessSchedulingSliceCounters(
+      const SchedulingSliceCounters& scheduling_slice_counters);
+  // Only for the threads that already have a track: the wakeups of all threads
+  // are sent, as the process of the wakee is unknown.
+  void ProcessThreadWakeup(const ThreadWakeup& thread_wakeup);
+  // Adds the bytes a sampled allocation stands for to the allocation rate of
+  // the thread.
+  void ProcessAllocation(ThreadID thread_id, uint64_t timestamp_ns,
+                         uint64_t sampled_bytes);
+  void ProcessCpuPowerEvent(const CpuPowerEvent& cpu_power_event);
+  void ProcessPageFault(ThreadID thread_id, uint64_t timestamp_ns, bool major);
+  void ProcessPageFaultStats(const PageFaultStats& page_fault_stats);
+  // For the events of a live capture, which arrive on the capture thread: they
+  // are only enqueued there, without taking m_Mutex or touching any track, and
+  // ProcessEnqueuedEvents processes them on the main thread.
+  // The timers are moved into the queue.
+  void EnqueueTimers(absl::Span<orbit_client_protos::TimerInfo> timers);
+  void EnqueueSchedulingSliceCounters(
+      SchedulingSliceCounters scheduling_slice_counters);
+  void EnqueueThreadWakeup(ThreadWakeup thread_wakeup);
+  void EnqueueAllocation(ThreadID thread_id, uint64_t timestamp_ns,
+                         uint64_t sampled_bytes);
+  void EnqueueCpuPowerEvent(CpuPowerEvent cpu_power_event);
+  void EnqueuePageFault(ThreadID thread_id, uint64_t timestamp_ns, bool major);
+  void EnqueuePageFaultStats(PageFaultStats page_fault_stats);
+  // Processes all events enqueued so far. Called once per frame, before the
+  // view is updated, and when the capture stops.
+  void ProcessEnqueuedEvents();
   void UpdateMaxTimeStamp(TickType a_Time);
 
   float GetThreadTotalHeight();
@@ -60,6 +115,10 @@ class TimeGraph {
   bool UpdateCaptureMinMaxTimestamps();
 
   void Clear();
+  // Frees the timers, values and callstack events of the capture that end
+  // before timestamp, to keep the memory of a long live capture bounded. The
+  // selected text box and those of the iterators are kept.
+  void DropDataBefore(TickType timestamp);
   void ZoomAll();
   void Zoom(const TextBox* a_TextBox);
   void Zoom(TickType min, TickType max);
@@ -96,6 +155,11 @@ class TimeGraph {
   const TextBox* FindNextFunctionCall(
       uint64_t function_address, TickType current_time,
       std::optional<int32_t> thread_ID = std::nullopt) const;
+  // The inclusive and exclusive time of the functions, per thread, updated as
+  // the timers are processed.
+  [[nodiscard]] const FunctionTimeIndex& GetFunctionTimeIndex() const {
+    return function_time_index_;
+  }
   void SelectAndZoom(const TextBox* a_TextBox);
   double GetCaptureTimeSpanUs();
   double GetCurrentTimeSpanUs();
@@ -103,6 +167,18 @@ class TimeGraph {
   bool IsRedrawNeeded() const { return m_NeedsRedraw; }
   void ToggleDrawText() { m_DrawText = !m_DrawText; }
   void SetThreadFilter(const std::string& a_Filter);
+  // Highlights, on all tracks, the timers of the functions of which the name
+  // contains all the words of search, ignoring case. Nothing is highlighted
+  // if search is empty.
+  void SetTimerSearch(const std::string& search);
+  [[nodiscard]] bool IsTimerSearchMatch(uint64_t function_address) const {
+    return timer_search_matches_.contains(function_address);
+  }
+  [[nodiscard]] uint64_t GetTimerSearchMatchCount();
+  // Selects the match ending before or after the selected timer, or before
+  // the end or after the start of the view if no timer is selected. Only
+  // kPrevious and kNext are supported.
+  void JumpToTimerSearchMatch(JumpDirection jump_direction);
 
   bool IsFullyVisible(TickType min, TickType max) const;
   bool IsPartlyVisible(TickType min, TickType max) const;
@@ -122,6 +198,13 @@ class TimeGraph {
   GlCanvas* GetCanvas() { return m_Canvas; }
   void SetFontSize(int a_FontSize);
   Batcher& GetBatcher() { return m_Batcher; }
+  TimerInstanceRenderer& GetTimerInstanceRenderer() {
+    return timer_instance_renderer_;
+  }
+  // Changes whenever the global state that GetTimerColor depends on, like the
+  // selected thread or the visible functions, changes. Updated by
+  // UpdatePrimitives.
+  uint64_t GetTimerColorsKey() const { return timer_colors_key_; }
   uint32_t GetNumTimers() const;
   uint32_t GetNumCores() const;
   std::vector<std::shared_ptr<TimerChain>> GetAllTimerChains() const;
@@ -137,6 +220,14 @@ class TimeGraph {
 
   const TextBox* FindPrevious(TextBox* from);
   const TextBox* FindNext(TextBox* from);
+  // The timer drawn at a world position, found from the timers of the track
+  // at that position rather than from a picking pass.
+  struct PickedTimer {
+    TimerTrack* track;
+    TextBox* text_box;
+  };
+  [[nodiscard]] std::optional<PickedTimer> PickTimer(float world_x,
+                                                     float world_y);
   const TextBox* FindTop(TextBox* from);
   const TextBox* FindDown(TextBox* from);
 
@@ -150,21 +241,91 @@ class TimeGraph {
     NeedsRedraw();
   }
 
+  // The count longest frames of all the frame tracks, longest first.
+  [[nodiscard]] std::vector<FrameTrack::FrameInfo> GetLongestFrames(
+      size_t count) const;
+
   TickType GetCaptureMin() { return capture_min_timestamp_; }
   TickType GetCaptureMax() { return capture_max_timestamp_; }
+  // The track of the thread, or nullptr if it has none.
+  [[nodiscard]] std::shared_ptr<ThreadTrack> FindThreadTrack(
+      ThreadID thread_id) const;
 
  protected:
   std::shared_ptr<SchedulerTrack> GetOrCreateSchedulerTrack();
   std::shared_ptr<ThreadTrack> GetOrCreateThreadTrack(ThreadID a_TID);
+  // The thread index of the thread, whose track is created if it has none.
+  // m_Mutex must be held.
+  uint32_t GetOrCreateThreadIndex(ThreadID thread_id);
   std::shared_ptr<GpuTrack> GetOrCreateGpuTrack(uint64_t timeline_hash);
+  std::shared_ptr<AsyncTrack> GetOrCreateAsyncTrack(uint64_t name_hash);
+  std::shared_ptr<FrameTrack> GetOrCreateFrameTrack(uint64_t name_hash);
+  std::shared_ptr<GraphTrack> GetOrCreateCounterTrack(
+      ThreadID thread_id, const std::string& counter_name);
+  std::shared_ptr<GraphTrack> GetOrCreateCpuFrequencyTrack(int32_t cpu);
+  // Adds a scheduling slice of a thread of the target process to the CPU
+  // usage of the thread, and updates the buckets of its graph it is in.
+  void UpdateThreadCpuUsage(ThreadID thread_id, uint64_t start_ns,
+                            uint64_t end_ns);
 
  private:
+  // The buckets of the CPU usage graphs of the threads.
+  static constexpr uint64_t THREAD_CPU_USAGE_BUCKET_NS = 10'000'000;
+  // The same for the allocation rate graphs.
+  static constexpr uint64_t ALLOCATION_RATE_BUCKET_NS = 10'000'000;
+
+  struct Allocation {
+    ThreadID thread_id = 0;
+    uint64_t timestamp_ns = 0;
+    uint64_t sampled_bytes = 0;
+  };
+
+  struct PageFault {
+    ThreadID thread_id = 0;
+    uint64_t timestamp_ns = 0;
+    bool major = false;
+  };
+
+  // The last events of a core, from which the value of its frequency track is
+  // computed: 0 while idle.
+  struct CpuPowerState {
+    uint32_t frequency_khz = 0;
+    bool idle = false;
+  };
+
+  // Whether the name of the track contains any of thread_filters_.
+  [[nodiscard]] bool MatchesThreadFilter(const Track& track);
+
   TextRenderer m_TextRendererStatic;
   TextRenderer* m_TextRenderer = nullptr;
   GlCanvas* m_Canvas = nullptr;
   TextBox m_SceneBox;
   int m_NumDrawnTextBoxes = 0;
 
+  // The calls of the functions on the thread tracks, for finding the call
+  // before or after a timestamp without visiting all timers.
+  FunctionCallIndex function_call_index_;
+  FunctionTimeIndex function_time_index_;
+  // The function of the timers of each address, instead of a lookup through
+  // the modules of the process for each timer.
+  absl::flat_hash_map<uint64_t, orbit_client_protos::FunctionInfo*>
+      functions_by_address_;
+  // The number of non-null entries of functions_by_address_.
+  size_t resolved_function_count_ = 0;
+
+  // Finds the functions of the timers matching the search among those of
+  // functions_by_address_, when functions were resolved since the last time.
+  void UpdateTimerSearchMatches();
+  // The lowercase words of the search, all of which a function name must
+  // contain.
+  std::vector<std::string> timer_search_tokens_;
+  // The value of resolved_function_count_ the matches were found for.
+  std::optional<size_t> timer_search_function_count_;
+  std::vector<uint64_t> timer_search_addresses_;
+  absl::flat_hash_set<uint64_t> timer_search_matches_;
+  // Changes with the matches, which change the colors of the timers.
+  uint64_t timer_search_generation_ = 0;
+
   // First member is id.
   absl::flat_hash_map<uint64_t, const TextBox*> iterator_text_boxes_;
   absl::flat_hash_map<uint64_t, const orbit_client_protos::FunctionInfo*> iterator_functions_;
@@ -174,7 +335,6 @@ class TimeGraph {
   double m_MaxTimeUs = 0;
   TickType capture_min_timestamp_ = 0;
   TickType capture_max_timestamp_ = 0;
-  std::map<ThreadID, uint32_t> m_EventCount;
   double m_TimeWindowUs = 0;
   float m_WorldStartX = 0;
   float m_WorldWidth = 0;
@@ -187,8 +347,6 @@ class TimeGraph {
 
   TimeGraphLayout m_Layout;
 
-  std::map<ThreadID, uint32_t> m_ThreadCountMap;
-
   // Be careful when directly changing these members without using the
   // methods NeedsRedraw() or NeedsUpdate():
   // m_NeedsUpdatePrimitives should always imply m_NeedsRedraw, that is
@@ -198,28 +356,118 @@ class TimeGraph {
   // timeline.
   bool m_NeedsUpdatePrimitives = false;
   bool m_NeedsRedraw = false;
+  // Set by NeedsUpdate: the primitives can't be kept by the next update.
+  bool needs_full_update_ = true;
 
   bool m_DrawText = true;
 
   Batcher m_Batcher;
+  // Groups of consecutive tracks are updated in parallel on this pool, each
+  // into its own batcher and text, which are then appended in order to
+  // m_Batcher and m_TextRendererStatic.
+  std::unique_ptr<ThreadPool> update_thread_pool_;
+  std::vector<std::unique_ptr<Batcher>> track_group_batchers_;
+  std::vector<TextRecorder> track_group_texts_;
+
+  // The view that the primitives in m_Batcher and m_TextRendererStatic were
+  // built for by the last full update. Incremental updates add primitives in
+  // the coordinates of that view, and all of them are drawn translated by
+  // primitives_offset_x_ to the current one.
+  struct PrimitivesView {
+    TickType capture_min_timestamp = 0;
+    double min_time_us = 0;
+    double time_window_us = 0;
+    float world_start_x = 0;
+    float world_width = 0;
+    uint64_t timer_colors_key = 0;
+    std::vector<const Track*> tracks;
+    std::vector<float> track_heights;
+  };
+  [[nodiscard]] bool CanUpdateIncrementally(
+      PickingMode picking_mode, const std::vector<float>& track_heights) const;
+  PrimitivesView primitives_view_;
+  float primitives_offset_x_ = 0.f;
+  TimerInstanceRenderer timer_instance_renderer_;
+  uint64_t timer_colors_key_ = 0;
   PickingManager* m_PickingManager = nullptr;
   Timer m_LastThreadReorder;
 
+  // The events enqueued by the capture thread. LockFreeQueue keeps a separate
+  // queue per producer, hence the order of the timers is preserved.
+  LockFreeQueue<orbit_client_protos::TimerInfo> enqueued_timers_;
+  LockFreeQueue<SchedulingSliceCounters> enqueued_scheduling_slice_counters_;
+  LockFreeQueue<ThreadWakeup> enqueued_thread_wakeups_;
+  LockFreeQueue<Allocation> enqueued_allocations_;
+  LockFreeQueue<CpuPowerEvent> enqueued_cpu_power_events_;
+  LockFreeQueue<PageFault> enqueued_page_faults_;
+  LockFreeQueue<PageFaultStats> enqueued_page_fault_stats_;
+  // Reused by ProcessEnqueuedEvents, which dequeues the events in bulk.
+  std::vector<orbit_client_protos::TimerInfo> dequeued_timers_;
+  std::vector<SchedulingSliceCounters> dequeued_scheduling_slice_counters_;
+  std::vector<ThreadWakeup> dequeued_thread_wakeups_;
+  std::vector<Allocation> dequeued_allocations_;
+  std::vector<CpuPowerEvent> dequeued_cpu_power_events_;
+  std::vector<PageFault> dequeued_page_faults_;
+  std::vector<PageFaultStats> dequeued_page_fault_stats_;
+
   mutable Mutex m_Mutex;
   std::vector<std::shared_ptr<Track>> tracks_;
-  std::unordered_map<ThreadID, std::shared_ptr<ThreadTrack>> thread_tracks_;
+  // The per-thread state is indexed by the ThreadIndex of the thread, which
+  // takes one lookup per timer.
+  ThreadIndex thread_index_;
+  std::vector<std::shared_ptr<ThreadTrack>> thread_tracks_;
+  // The number of timers and of callstack events of each thread, by thread
+  // index too, to sort the tracks.
+  std::vector<uint32_t> thread_timer_counts_;
+  std::vector<uint32_t> thread_event_counts_;
   // Mapping from timeline hash to GPU tracks.
   std::unordered_map<uint64_t, std::shared_ptr<GpuTrack>> gpu_tracks_;
+  // By name hash, sorted so that their order doesn't change while capturing.
+  std::map<uint64_t, std::shared_ptr<AsyncTrack>> async_tracks_;
+  // By name hash too. All function calls are added to each of them.
+  std::map<uint64_t, std::shared_ptr<FrameTrack>> frame_tracks_;
+  // Graph tracks of the performance counters of a thread, by counter name,
+  // shown after the ThreadTrack.
+  std::unordered_map<ThreadID,
+                     std::map<std::string, std::shared_ptr<GraphTrack>>>
+      counter_tracks_;
+  // Graph tracks of the frequency of each core, in MHz, shown after the
+  // SchedulerTrack.
+  std::map<int32_t, std::shared_ptr<GraphTrack>> cpu_frequency_tracks_;
+  absl::flat_hash_map<int32_t, CpuPowerState> cpu_power_states_;
+  std::unordered_map<ThreadID, OccupancyPyramid> thread_cpu_usages_;
+  // The bytes allocated by each thread, by bucket index.
+  std::unordered_map<ThreadID, absl::flat_hash_map<uint64_t, uint64_t>>
+      thread_allocated_bytes_;
   std::vector<std::shared_ptr<Track>> sorted_tracks_;
   std::string m_ThreadFilter;
+  // The lowercase words of m_ThreadFilter, any of which a thread's track name
+  // must contain.
+  std::vector<std::string> thread_filters_;
+
+  // Set when events were added or the filter changed since the last
+  // SortTracks, which does nothing otherwise.
+  std::atomic<bool> tracks_need_sorting_ = true;
+  // The callstack events are only seen through the EventBuffer.
+  uint64_t sorted_event_max_time_ = 0;
+  // The sampled and instrumented threads, by order of their tracks before
+  // filtering. Kept from one SortTracks to the next, so that the threads of
+  // equal rank keep their order.
+  std::vector<ThreadID> sorted_thread_ids_;
+  absl::flat_hash_set<ThreadID> sorted_thread_id_set_;
+  // By track, the name its lowercase name for filtering was made from, and
+  // that lowercase name.
+  absl::flat_hash_map<const Track*, std::pair<std::string, std::string>>
+      lowercase_track_names_;
 
   std::set<uint32_t> cores_seen_;
   std::shared_ptr<SchedulerTrack> scheduler_track_;
   std::shared_ptr<ThreadTrack> process_track_;
 
-  absl::flat_hash_map<ThreadID,
-                      std::vector<orbit_client_protos::CallstackEvent>>
-      selected_callstack_events_per_thread_;
+  // Of all threads for 0. Empty without a selection.
+  ThreadID selected_thread_id_ = 0;
+  TickType selection_min_tick_ = 0;
+  TickType selection_max_tick_ = 0;
 
   std::shared_ptr<StringManager> string_manager_;
 };
@@ -13,6 +13,7 @@ TimeGraphLayout::TimeGraphLayout() {
   m_TextBoxHeight = 20.f;
   m_CoresHeight = 10.f;
   m_EventTrackHeight = 10.f;
+  m_ThreadStateTrackHeight = 4.f;
   m_GraphTrackHeight = 20.f;
   m_TrackBottomMargin = 5.f;
   m_TrackTopMargin = 5.f;
@@ -60,6 +61,7 @@ bool TimeGraphLayout::DrawProperties() {
   FLOAT_SLIDER(m_TextBoxHeight);
   FLOAT_SLIDER(m_CoresHeight);
   FLOAT_SLIDER(m_EventTrackHeight);
+  FLOAT_SLIDER(m_ThreadStateTrackHeight);
   FLOAT_SLIDER(m_GraphTrackHeight);
   FLOAT_SLIDER(m_SpaceBetweenCores);
   FLOAT_SLIDER(m_SpaceBetweenTracks);
@@ -13,6 +13,9 @@ class TimeGraphLayout {
   float GetTextBoxHeight() const { return m_TextBoxHeight * scale_; }
   float GetTextCoresHeight() const { return m_CoresHeight * scale_; }
   float GetEventTrackHeight() const { return m_EventTrackHeight * scale_; }
+  float GetThreadStateTrackHeight() const {
+    return m_ThreadStateTrackHeight * scale_;
+  }
   float GetGraphTrackHeight() const { return m_GraphTrackHeight * scale_; }
   float GetTrackBottomMargin() const { return m_TrackBottomMargin * scale_; }
   float GetTrackTopMargin() const { return m_TrackTopMargin * scale_; }
@@ -54,6 +57,7 @@ class TimeGraphLayout {
   float m_TextBoxHeight;
   float m_CoresHeight;
   float m_EventTrackHeight;
+  float m_ThreadStateTrackHeight;
   float m_GraphTrackHeight;
   float m_TrackBottomMargin;
   float m_TrackTopMargin;
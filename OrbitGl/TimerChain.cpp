@@ -1,25 +1,42 @@
 #include "TimerChain.h"
 
 #include <algorithm>
+#include <functional>
 
-void TimerBlock::Add(const TextBox& item) {
+TextBox* TimerBlock::Add(orbit_client_protos::TimerInfo timer_info) {
   if (size_ == kBlockSize) {
     if (next_ == nullptr) {
       next_ = new TimerBlock(chain_, this);
+      chain_->AddToIndex(next_);
     }
 
     chain_->current_ = next_;
     ++chain_->num_blocks_;
-    next_->Add(item);
-    return;
+    return next_->Add(std::move(timer_info));
   }
 
   CHECK(size_ < kBlockSize);
-  data_[size_] = item;
+  const uint64_t start = timer_info.start();
+  const uint64_t end = timer_info.end();
+  starts_[size_] = start;
+  ends_[size_] = end;
+  function_addresses_[size_] = timer_info.function_address();
+  data_[size_].SetTimerInfo(std::move(timer_info));
   ++size_;
   ++chain_->num_items_;
-  min_timestamp_ = std::min(item.GetTimerInfo().start(), min_timestamp_);
-  max_timestamp_ = std::max(item.GetTimerInfo().end(), max_timestamp_);
+  min_timestamp_ = std::min(start, min_timestamp_);
+  max_timestamp_ = std::max(end, max_timestamp_);
+  max_timestamp_until_here_ = std::max(end, max_timestamp_until_here_);
+
+  if (start < chain_->last_start_timestamp_) {
+    chain_->is_sorted_by_start_ = false;
+    chain_->summary_ = TimerSummary();
+  }
+  chain_->last_start_timestamp_ = start;
+  if (chain_->is_sorted_by_start_) {
+    chain_->summary_.Add(&data_[size_ - 1]);
+  }
+  return &data_[size_ - 1];
 }
 
 bool TimerBlock::Intersects(uint64_t min, uint64_t max) {
@@ -27,32 +44,35 @@ bool TimerBlock::Intersects(uint64_t min, uint64_t max) {
 }
 
 TimerChain::~TimerChain() {
-  // Find last block in chain
-  while (current_->next_) current_ = current_->next_;
-
-  TimerBlock* prev = current_;
-  while (prev) {
-    prev = current_->prev_;
-    delete current_;
-    current_ = prev;
+  for (TimerBlock* block : blocks_) {
+    delete block;
   }
 }
 
+void TimerChain::AddToIndex(TimerBlock* block) {
+  blocks_.push_back(block);
+  blocks_by_address_.insert(
+      std::upper_bound(blocks_by_address_.begin(), blocks_by_address_.end(),
+                       block, std::less<TimerBlock*>{}),
+      block);
+}
+
 TimerBlock* TimerChain::GetBlockContaining(const TextBox* element) {
-  TimerBlock* block = root_;
-  while (block) {
-    uint32_t size = block->size_;
-    if (size) {
-      TextBox* begin = &block->data_[0];
-      TextBox* end = &block->data_[size - 1];
-      if (begin <= element && end >= element) {
-        return block;
-      }
-    }
-    block = block->next_;
+  // The last block whose data starts at or before element.
+  auto it = std::upper_bound(
+      blocks_by_address_.begin(), blocks_by_address_.end(), element,
+      [](const TextBox* address, const TimerBlock* block) {
+        return std::less<const TextBox*>{}(address, &block->data_[0]);
+      });
+  if (it == blocks_by_address_.begin()) {
+    return nullptr;
   }
-
-  return nullptr;
+  TimerBlock* block = *(it - 1);
+  if (block->size_ == 0 ||
+      std::less<const TextBox*>{}(&block->data_[block->size_ - 1], element)) {
+    return nullptr;
+  }
+  return block;
 }
 
 TextBox* TimerChain::GetElementAfter(const TextBox* element) {
@@ -80,3 +100,120 @@ TextBox* TimerChain::GetElementBefore(const TextBox* element) {
   }
   return nullptr;
 }
+
+const TextBox* TimerChain::GetFirstStartingAtOrAfter(uint64_t timestamp) const {
+  auto starts_before = [timestamp](uint64_t start) {
+    return start < timestamp;
+  };
+
+  if (!is_sorted_by_start_) {
+    for (const TimerBlock* block : blocks_) {
+      const uint64_t* end = block->starts_ + block->size_;
+      const uint64_t* it = std::find_if_not(block->starts_, end, starts_before);
+      if (it != end) return &block->data_[it - block->starts_];
+    }
+    return nullptr;
+  }
+
+  // The first block that ends with a timer starting at or after timestamp,
+  // which then contains the timer we are looking for.
+  auto block_it = std::partition_point(
+      blocks_.begin(), blocks_.end(), [&](const TimerBlock* block) {
+        return block->size_ > 0 &&
+               starts_before(block->starts_[block->size_ - 1]);
+      });
+  if (block_it == blocks_.end() || (*block_it)->size_ == 0) {
+    return nullptr;
+  }
+  const TimerBlock* block = *block_it;
+  const uint64_t* it = std::partition_point(
+      block->starts_, block->starts_ + block->size_, starts_before);
+  return &block->data_[it - block->starts_];
+}
+
+TimerChainIterator TimerChain::GetFirstBlockEndingAtOrAfter(
+    uint64_t timestamp) {
+  auto block_it = std::partition_point(
+      blocks_.begin(), blocks_.end(), [timestamp](const TimerBlock* block) {
+        return block->size_ > 0 &&
+               block->max_timestamp_until_here_ < timestamp;
+      });
+  return TimerChainIterator(block_it != blocks_.end() ? *block_it : nullptr);
+}
+
+uint64_t TimerChain::DropBlocksEndingBefore(uint64_t timestamp) {
+  size_t num_dropped_blocks = 0;
+  while (num_dropped_blocks < blocks_.size() &&
+         blocks_[num_dropped_blocks] != current_ &&
+         blocks_[num_dropped_blocks]->max_timestamp_until_here_ < timestamp) {
+    ++num_dropped_blocks;
+  }
+  if (num_dropped_blocks == 0) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < num_dropped_blocks; ++i) {
+    TimerBlock* block = blocks_[i];
+    blocks_by_address_.erase(
+        std::lower_bound(blocks_by_address_.begin(), blocks_by_address_.end(),
+                         block, std::less<TimerBlock*>{}));
+    delete block;
+  }
+  blocks_.erase(blocks_.begin(), blocks_.begin() + num_dropped_blocks);
+  root_ = blocks_[0];
+  root_->prev_ = nullptr;
+  const uint64_t num_dropped_timers = num_dropped_blocks * kBlockSize;
+  num_blocks_ -= num_dropped_blocks;
+  num_items_ -= num_dropped_timers;
+
+  // Both point into the blocks freed.
+  start_index_.clear();
+  if (is_sorted_by_start_) {
+    summary_ = TimerSummary();
+    for (TimerBlock* block : blocks_) {
+      for (uint64_t k = 0; k < block->size_; ++k) {
+        summary_.Add(&block->data_[k]);
+      }
+    }
+  }
+  return num_dropped_timers;
+}
+
+void TimerChain::UpdateStartIndex() {
+  const size_t indexed_count = start_index_.size();
+  const uint64_t unindexed_count = num_items_ - indexed_count;
+  // Merging is a pass over the whole index, so it waits until that is
+  // proportional to the number of timers added since.
+  if (unindexed_count == 0 ||
+      unindexed_count < std::max<uint64_t>(kBlockSize, indexed_count / 8)) {
+    return;
+  }
+
+  start_index_.reserve(num_items_);
+  for (uint64_t i = indexed_count; i < num_items_; ++i) {
+    TimerBlock* block = blocks_[i / kBlockSize];
+    const size_t k = i % kBlockSize;
+    start_index_.push_back(
+        {block->starts_[k], block->ends_[k], 0, &block->data_[k]});
+  }
+
+  auto by_start = [](const StartIndexEntry& a, const StartIndexEntry& b) {
+    return a.start < b.start;
+  };
+  auto middle = start_index_.begin() + indexed_count;
+  std::sort(middle, start_index_.end(), by_start);
+  // The maximum ends before the first timer merged in stay the same.
+  const size_t first_changed =
+      std::upper_bound(start_index_.begin(), middle, *middle, by_start) -
+      start_index_.begin();
+  std::inplace_merge(start_index_.begin(), middle, start_index_.end(),
+                     by_start);
+
+  uint64_t max_end = first_changed > 0
+                         ? start_index_[first_changed - 1].max_end_until_here
+                         : std::numeric_limits<uint64_t>::min();
+  for (size_t i = first_changed; i < start_index_.size(); ++i) {
+    max_end = std::max(max_end, start_index_[i].end);
+    start_index_[i].max_end_until_here = max_end;
+  }
+}
@@ -9,18 +9,20 @@
 #include <atomic>
 #include <cstdint>
 #include <limits>
+#include <utility>
+#include <vector>
 
 #include "TextBox.h"
+#include "TimerSummary.h"
 
 static constexpr int kBlockSize = 1024;
 class TimerChain;
 
-// TimerBlock is a straightforward specialization of Block (see BlockChain.h)
-// with the added bonus that it keeps track of the minimum and maximum
-// timestamps of all timers added to it. This allows trivial rejection of an
-// entire block by using the Intersects(t_min, t_max) method. This effectively
-// tests if any of the timers stored in this block intersects with the [t_min,
-// t_max] interval.
+// TimerBlock is a block of kBlockSize timers of a TimerChain, which keeps track
+// of the minimum and maximum timestamps of all timers added to it. This allows
+// trivial rejection of an entire block by using the Intersects(t_min, t_max)
+// method. This effectively tests if any of the timers stored in this block
+// intersects with the [t_min, t_max] interval.
 class TimerBlock {
   friend class TimerChain;
   friend class TimerChainIterator;
@@ -32,11 +34,17 @@ class TimerBlock {
         chain_(chain),
         size_(0),
         min_timestamp_(std::numeric_limits<uint64_t>::max()),
-        max_timestamp_(std::numeric_limits<uint64_t>::min()) {}
+        max_timestamp_(std::numeric_limits<uint64_t>::min()),
+        max_timestamp_until_here_(
+            prev != nullptr ? prev->max_timestamp_until_here_
+                            : std::numeric_limits<uint64_t>::min()) {}
 
-  // Adds an item to the block. If capacity of this block is reached, a new
-  // blocked is allocated and the item is added to the new block.
-  void Add(const TextBox& item);
+  // Adds a timer to the block. If capacity of this block is reached, a new
+  // blocked is allocated and the timer is added to the new block. The timer
+  // is moved into the TextBox that the block already holds for it, whose
+  // position and size are only set when the timer is drawn. Returns that
+  // TextBox, which stays at the same address for the lifetime of the chain.
+  TextBox* Add(orbit_client_protos::TimerInfo timer_info);
 
   // Tests if [min, max] intersects with [min_timestamp, max_timestamp], where
   // {min, max}_timestamp are the minimum and maximum timestamp of the timers
@@ -45,6 +53,18 @@ class TimerBlock {
 
   uint64_t size() const { return size_; }
 
+  uint64_t GetMinTimestamp() const { return min_timestamp_; }
+  uint64_t GetMaxTimestamp() const { return max_timestamp_; }
+
+  // The fields of the timers that culling and searches look at, stored as
+  // columns, so that skipping a timer doesn't touch its TextBox and so that
+  // these loops run over contiguous integers.
+  uint64_t GetStart(std::size_t idx) const { return starts_[idx]; }
+  uint64_t GetEnd(std::size_t idx) const { return ends_[idx]; }
+  uint64_t GetFunctionAddress(std::size_t idx) const {
+    return function_addresses_[idx];
+  }
+
   TextBox& operator[](std::size_t idx) { return data_[idx]; }
 
   const TextBox& operator[](std::size_t idx) const { return data_[idx]; }
@@ -55,9 +75,15 @@ class TimerBlock {
   TimerChain* chain_;
   uint64_t size_;
   TextBox data_[kBlockSize];
+  uint64_t starts_[kBlockSize];
+  uint64_t ends_[kBlockSize];
+  uint64_t function_addresses_[kBlockSize];
 
   uint64_t min_timestamp_;
   uint64_t max_timestamp_;
+  // The maximum timestamp of this block and all blocks before it, which,
+  // unlike max_timestamp_, never decreases along the chain.
+  uint64_t max_timestamp_until_here_;
 };
 
 // TimerChainIterator iterates over all *blocks* of the chain, not the
@@ -90,35 +116,146 @@ class TimerChainIterator {
 // is a difference compared with BlockChain in how the iterators work: Here,
 // the iterator runs over blocks, in BlockChain the iterator runs over the
 // individually stored elements.
+//
+// Timers are usually added in order of start timestamp, as they are produced
+// for each depth of a thread, but this is not guaranteed. The blocks are kept
+// in a directory, so that the block containing a timer, and the first timer
+// starting at or after a timestamp (for chains that are sorted), are found by
+// binary search instead of by visiting every block.
 class TimerChain {
   friend class TimerBlock;
 
  public:
   TimerChain() : num_blocks_(1), num_items_(0) {
     root_ = current_ = new TimerBlock(this, nullptr);
+    AddToIndex(root_);
   }
 
   ~TimerChain();
 
-  void push_back(const TextBox& item) { current_->Add(item); }
+  const TextBox* emplace_back(orbit_client_protos::TimerInfo timer_info) {
+    return current_->Add(std::move(timer_info));
+  }
   bool empty() const { return num_items_ == 0; }
   uint64_t size() const { return num_items_; }
 
   TimerBlock* GetBlockContaining(const TextBox* element);
 
+  // Returns the iterator to the block containing the timer with this index,
+  // in the order in which timers were added, or end() if there is none. As
+  // blocks are filled one after the other, the timer is at index % kBlockSize
+  // in that block.
+  TimerChainIterator GetBlockContainingIndex(uint64_t index) {
+    const uint64_t block_index = index / kBlockSize;
+    return TimerChainIterator(index < num_items_ ? blocks_[block_index]
+                                                 : nullptr);
+  }
+
   TextBox* GetElementAfter(const TextBox* element);
 
   TextBox* GetElementBefore(const TextBox* element);
 
+  // Returns the first timer, in the order in which they were added, that
+  // starts at or after timestamp, or nullptr if there is none.
+  const TextBox* GetFirstStartingAtOrAfter(uint64_t timestamp) const;
+
+  // Returns the iterator to the first block that contains timers ending at or
+  // after timestamp: all the blocks before it can be skipped when looking for
+  // timers intersecting an interval that starts at timestamp.
+  TimerChainIterator GetFirstBlockEndingAtOrAfter(uint64_t timestamp);
+
+  // Calls visitor(TextBox*, start, end) for each timer intersecting
+  // [min, max]. The blocks of a chain that is not sorted by start can each
+  // span most of the capture, so that culling them rejects nothing: for these
+  // chains, the timers are looked up in an index sorted by start instead,
+  // into which the timers added since are merged once there are enough of
+  // them. Until then, those are culled by block.
+  template <typename Visitor>
+  void ForEachTimerIntersecting(uint64_t min, uint64_t max, Visitor visitor);
+
+  // Frees the oldest full blocks whose timers, like those of all blocks
+  // before, end before timestamp. The TextBoxes of the timers freed must no
+  // longer be referenced. The indices of the timers left decrease by the
+  // number of timers freed, which is returned.
+  uint64_t DropBlocksEndingBefore(uint64_t timestamp);
+
+  // True if every timer starts at or after the one added before it. Then the
+  // blocks that follow a block starting after some timestamp start after it
+  // as well.
+  bool IsSortedByStart() const { return is_sorted_by_start_; }
+
+  // The summary of all timers, for drawing them zoomed out, or nullptr if the
+  // chain is not sorted by start.
+  const TimerSummary* GetSummary() const {
+    return is_sorted_by_start_ ? &summary_ : nullptr;
+  }
+
   TimerChainIterator begin() { return TimerChainIterator(root_); }
 
   TimerChainIterator end() { return TimerChainIterator(nullptr); }
 
  private:
+  struct StartIndexEntry {
+    uint64_t start;
+    uint64_t end;
+    // The maximum end of this timer and all timers before it in the index.
+    uint64_t max_end_until_here;
+    TextBox* text_box;
+  };
+
+  void AddToIndex(TimerBlock* block);
+  void UpdateStartIndex();
+
   TimerBlock* root_;
   TimerBlock* current_;
   uint64_t num_blocks_;
   uint64_t num_items_;
+
+  // All blocks in chain order, and sorted by address.
+  std::vector<TimerBlock*> blocks_;
+  std::vector<TimerBlock*> blocks_by_address_;
+  bool is_sorted_by_start_ = true;
+  uint64_t last_start_timestamp_ = std::numeric_limits<uint64_t>::min();
+  TimerSummary summary_;
+  // The first start_index_.size() timers, in order of start, once the chain
+  // is not sorted by start.
+  std::vector<StartIndexEntry> start_index_;
 };
 
+template <typename Visitor>
+void TimerChain::ForEachTimerIntersecting(uint64_t min, uint64_t max,
+                                          Visitor visitor) {
+  TimerChainIterator it = GetFirstBlockEndingAtOrAfter(min);
+  size_t begin = 0;
+  if (!is_sorted_by_start_) {
+    UpdateStartIndex();
+    auto entry_it = std::partition_point(
+        start_index_.begin(), start_index_.end(),
+        [min](const StartIndexEntry& entry) {
+          return entry.max_end_until_here < min;
+        });
+    for (; entry_it != start_index_.end() && entry_it->start <= max;
+         ++entry_it) {
+      if (entry_it->end < min) continue;
+      visitor(entry_it->text_box, entry_it->start, entry_it->end);
+    }
+    it = GetBlockContainingIndex(start_index_.size());
+    begin = start_index_.size() % kBlockSize;
+  }
+
+  for (; it != end(); ++it) {
+    TimerBlock& block = *it;
+    if (is_sorted_by_start_ && block.min_timestamp_ > max) break;
+    if (block.Intersects(min, max)) {
+      for (size_t k = begin; k < block.size_; ++k) {
+        const uint64_t start = block.starts_[k];
+        const uint64_t end = block.ends_[k];
+        if (min > end || max < start) continue;
+        visitor(&block.data_[k], start, end);
+      }
+    }
+    begin = 0;
+  }
+}
+
 #endif
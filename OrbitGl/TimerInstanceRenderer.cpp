@@ -0,0 +1,282 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "TimerInstanceRenderer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+#include "OpenGl.h"
+#include "OrbitBase/Logging.h"
+
+namespace {
+
+// Attribute locations, as declared in kVertexShader.
+constexpr GLuint kStartTickLocation = 0;
+constexpr GLuint kEndTickLocation = 1;
+constexpr GLuint kDepthLocation = 2;
+constexpr GLuint kColorLocation = 3;
+
+// Ticks are converted relative to min_tick, with 64-bit subtraction emulated on
+// the two halves, so that single precision only has to hold the offset from
+// the visible range. The four vertices of the triangle strip are the corners
+// of the box, with the same gradient as Batcher::GetBoxGradientColors.
+constexpr const char* kVertexShader = R"(
+#version 330 compatibility
+layout(location = 0) in uvec2 start_tick;
+layout(location = 1) in uvec2 end_tick;
+layout(location = 2) in float depth;
+layout(location = 3) in vec4 color;
+
+uniform uvec2 min_tick;
+uniform float world_min_x;
+uniform float world_per_tick;
+uniform float min_world_width;
+uniform float depth_0_y;
+uniform float depth_step_y;
+uniform float box_height;
+uniform float z;
+
+out vec4 vertex_color;
+
+float TicksSinceMinTick(uvec2 tick) {
+  uint low = tick.x - min_tick.x;
+  uint borrow = tick.x < min_tick.x ? 1u : 0u;
+  int high = int(tick.y - min_tick.y - borrow);
+  return float(high) * 4294967296.0 + float(low);
+}
+
+void main() {
+  float start_x = world_min_x + TicksSinceMinTick(start_tick) * world_per_tick;
+  float end_x = world_min_x + TicksSinceMinTick(end_tick) * world_per_tick;
+  end_x = max(end_x, start_x + min_world_width);
+
+  float corner_x = float(gl_VertexID & 1);
+  float corner_y = float(gl_VertexID >> 1);
+  float y = depth_0_y + depth * depth_step_y + corner_y * box_height;
+  vec2 position = vec2(mix(start_x, end_x, corner_x), y);
+  gl_Position = gl_ModelViewProjectionMatrix * vec4(position, z, 1.0);
+
+  const float kGradientCoeff = 0.94;
+  vertex_color = corner_x > 0.5 ? color
+                                : vec4(color.rgb * kGradientCoeff, color.a);
+}
+)";
+
+constexpr const char* kFragmentShader = R"(
+#version 330 compatibility
+in vec4 vertex_color;
+out vec4 fragment_color;
+
+void main() { fragment_color = vertex_color; }
+)";
+
+bool CheckShader(GLuint shader_id, const char* description) {
+  GLint status = 0;
+  glGetShaderiv(shader_id, GL_COMPILE_STATUS, &status);
+  if (status == GL_TRUE) {
+    return true;
+  }
+  GLint log_length = 0;
+  glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &log_length);
+  std::string log(std::max(log_length, 1), '\0');
+  glGetShaderInfoLog(shader_id, log_length, nullptr, log.data());
+  ERROR("Compiling timer instance %s: %s", description, log);
+  return false;
+}
+
+GLuint CompileShader(GLenum type, const char* source, const char* description) {
+  GLuint shader_id = glCreateShader(type);
+  glShaderSource(shader_id, 1, &source, nullptr);
+  glCompileShader(shader_id);
+  if (!CheckShader(shader_id, description)) {
+    glDeleteShader(shader_id);
+    return 0;
+  }
+  return shader_id;
+}
+
+const void* GetOffsetPointer(size_t offset) {
+  return reinterpret_cast<const void*>(offset);
+}
+
+}  // namespace
+
+TimerInstanceBuffer::~TimerInstanceBuffer() {
+  if (vertex_array_id_ != 0) {
+    glDeleteVertexArrays(1, &vertex_array_id_);
+  }
+  if (buffer_id_ != 0) {
+    glDeleteBuffers(1, &buffer_id_);
+  }
+}
+
+void TimerInstanceBuffer::Add(const orbit_client_protos::TimerInfo& timer_info,
+                              Color color) {
+  Instance instance;
+  instance.start_tick[0] = static_cast<uint32_t>(timer_info.start());
+  instance.start_tick[1] = static_cast<uint32_t>(timer_info.start() >> 32);
+  instance.end_tick[0] = static_cast<uint32_t>(timer_info.end());
+  instance.end_tick[1] = static_cast<uint32_t>(timer_info.end() >> 32);
+  instance.depth = static_cast<float>(timer_info.depth());
+  instance.color = color;
+  pending_instances_.push_back(instance);
+}
+
+void TimerInstanceBuffer::Clear() {
+  // The buffer is kept, to be filled again from the start.
+  pending_instances_.clear();
+  uploaded_count_ = 0;
+}
+
+void TimerInstanceBuffer::Upload() {
+  if (pending_instances_.empty()) {
+    return;
+  }
+
+  const size_t count = size();
+  if (count > capacity_) {
+    // The instances that are already on the GPU are copied there, instead of
+    // keeping a copy of all of them in memory.
+    const size_t new_capacity = std::max(count, 2 * capacity_);
+    GLuint new_buffer_id = 0;
+    glGenBuffers(1, &new_buffer_id);
+    glBindBuffer(GL_ARRAY_BUFFER, new_buffer_id);
+    glBufferData(GL_ARRAY_BUFFER, new_capacity * sizeof(Instance), nullptr,
+                 GL_STATIC_DRAW);
+    if (buffer_id_ != 0) {
+      glBindBuffer(GL_COPY_READ_BUFFER, buffer_id_);
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, 0,
+                          uploaded_count_ * sizeof(Instance));
+      glBindBuffer(GL_COPY_READ_BUFFER, 0);
+      glDeleteBuffers(1, &buffer_id_);
+    }
+    buffer_id_ = new_buffer_id;
+    capacity_ = new_capacity;
+
+    if (vertex_array_id_ == 0) {
+      glGenVertexArrays(1, &vertex_array_id_);
+    }
+    glBindVertexArray(vertex_array_id_);
+    glEnableVertexAttribArray(kStartTickLocation);
+    glVertexAttribIPointer(kStartTickLocation, 2, GL_UNSIGNED_INT,
+                           sizeof(Instance),
+                           GetOffsetPointer(offsetof(Instance, start_tick)));
+    glVertexAttribDivisor(kStartTickLocation, 1);
+    glEnableVertexAttribArray(kEndTickLocation);
+    glVertexAttribIPointer(kEndTickLocation, 2, GL_UNSIGNED_INT,
+                           sizeof(Instance),
+                           GetOffsetPointer(offsetof(Instance, end_tick)));
+    glVertexAttribDivisor(kEndTickLocation, 1);
+    glEnableVertexAttribArray(kDepthLocation);
+    glVertexAttribPointer(kDepthLocation, 1, GL_FLOAT, GL_FALSE,
+                          sizeof(Instance),
+                          GetOffsetPointer(offsetof(Instance, depth)));
+    glVertexAttribDivisor(kDepthLocation, 1);
+    glEnableVertexAttribArray(kColorLocation);
+    glVertexAttribPointer(kColorLocation, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                          sizeof(Instance),
+                          GetOffsetPointer(offsetof(Instance, color)));
+    glVertexAttribDivisor(kColorLocation, 1);
+    glBindVertexArray(0);
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, buffer_id_);
+  glBufferSubData(GL_ARRAY_BUFFER, uploaded_count_ * sizeof(Instance),
+                  pending_instances_.size() * sizeof(Instance),
+                  pending_instances_.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  uploaded_count_ = count;
+  pending_instances_.clear();
+}
+
+TimerInstanceRenderer::~TimerInstanceRenderer() {
+  if (program_id_ != 0) {
+    glDeleteProgram(program_id_);
+  }
+}
+
+bool TimerInstanceRenderer::IsAvailable() {
+  if (!initialized_) {
+    initialized_ = true;
+    available_ = GLEW_VERSION_3_3 && BuildProgram();
+    if (!available_) {
+      LOG("Instanced timer rendering is not available");
+    }
+  }
+  return available_;
+}
+
+bool TimerInstanceRenderer::BuildProgram() {
+  GLuint vertex_shader_id =
+      CompileShader(GL_VERTEX_SHADER, kVertexShader, "vertex shader");
+  GLuint fragment_shader_id =
+      CompileShader(GL_FRAGMENT_SHADER, kFragmentShader, "fragment shader");
+  if (vertex_shader_id == 0 || fragment_shader_id == 0) {
+    glDeleteShader(vertex_shader_id);
+    glDeleteShader(fragment_shader_id);
+    return false;
+  }
+
+  program_id_ = glCreateProgram();
+  glAttachShader(program_id_, vertex_shader_id);
+  glAttachShader(program_id_, fragment_shader_id);
+  glLinkProgram(program_id_);
+  // The shaders are freed with the program.
+  glDeleteShader(vertex_shader_id);
+  glDeleteShader(fragment_shader_id);
+
+  GLint status = 0;
+  glGetProgramiv(program_id_, GL_LINK_STATUS, &status);
+  if (status != GL_TRUE) {
+    GLint log_length = 0;
+    glGetProgramiv(program_id_, GL_INFO_LOG_LENGTH, &log_length);
+    std::string log(std::max(log_length, 1), '\0');
+    glGetProgramInfoLog(program_id_, log_length, nullptr, log.data());
+    ERROR("Linking timer instance shaders: %s", log);
+    glDeleteProgram(program_id_);
+    program_id_ = 0;
+    return false;
+  }
+
+  min_tick_location_ = glGetUniformLocation(program_id_, "min_tick");
+  world_min_x_location_ = glGetUniformLocation(program_id_, "world_min_x");
+  world_per_tick_location_ =
+      glGetUniformLocation(program_id_, "world_per_tick");
+  min_world_width_location_ =
+      glGetUniformLocation(program_id_, "min_world_width");
+  depth_0_y_location_ = glGetUniformLocation(program_id_, "depth_0_y");
+  depth_step_y_location_ = glGetUniformLocation(program_id_, "depth_step_y");
+  box_height_location_ = glGetUniformLocation(program_id_, "box_height");
+  z_location_ = glGetUniformLocation(program_id_, "z");
+  return true;
+}
+
+void TimerInstanceRenderer::Draw(TimerInstanceBuffer* buffer,
+                                 const View& view) {
+  CHECK(available_);
+  buffer->Upload();
+  if (buffer->uploaded_count_ == 0) {
+    return;
+  }
+
+  glUseProgram(program_id_);
+  glUniform2ui(min_tick_location_, static_cast<uint32_t>(view.min_tick),
+               static_cast<uint32_t>(view.min_tick >> 32));
+  glUniform1f(world_min_x_location_, view.world_min_x);
+  glUniform1f(world_per_tick_location_,
+              static_cast<float>(view.world_per_tick));
+  glUniform1f(min_world_width_location_, view.min_world_width);
+  glUniform1f(depth_0_y_location_, view.depth_0_y);
+  glUniform1f(depth_step_y_location_, view.depth_step_y);
+  glUniform1f(box_height_location_, view.box_height);
+  glUniform1f(z_location_, view.z);
+
+  glBindVertexArray(buffer->vertex_array_id_);
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4,
+                        static_cast<GLsizei>(buffer->uploaded_count_));
+  glBindVertexArray(0);
+  glUseProgram(0);
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_TIMER_INSTANCE_RENDERER_
+#define ORBIT_GL_TIMER_INSTANCE_RENDERER_
+
+#include <cstdint>
+#include <vector>
+
+#include "CoreMath.h"
+#include "capture_data.pb.h"
+
+// The timers of a track as instances for TimerInstanceRenderer. Each timer is
+// stored once, in ticks, in a buffer on the GPU, so that the instances don't
+// need to change when the visible time range does. Timers added since the
+// last draw are uploaded by the next one.
+//
+// Must be used, and destroyed, with the OpenGL context it is drawn with
+// current.
+class TimerInstanceBuffer {
+ public:
+  TimerInstanceBuffer() = default;
+  TimerInstanceBuffer(const TimerInstanceBuffer&) = delete;
+  TimerInstanceBuffer& operator=(const TimerInstanceBuffer&) = delete;
+  ~TimerInstanceBuffer();
+
+  void Add(const orbit_client_protos::TimerInfo& timer_info, Color color);
+  void Clear();
+
+  [[nodiscard]] bool empty() const { return size() == 0; }
+  [[nodiscard]] size_t size() const {
+    return uploaded_count_ + pending_instances_.size();
+  }
+
+ private:
+  friend class TimerInstanceRenderer;
+
+  // Ticks are split in two 32-bit halves, as GLSL has no 64-bit integers.
+  struct Instance {
+    uint32_t start_tick[2];
+    uint32_t end_tick[2];
+    float depth;
+    Color color;
+  };
+
+  void Upload();
+
+  std::vector<Instance> pending_instances_;
+  uint32_t buffer_id_ = 0;
+  uint32_t vertex_array_id_ = 0;
+  size_t uploaded_count_ = 0;
+  size_t capacity_ = 0;
+};
+
+// Draws timer boxes with instanced rendering: a vertex shader converts the
+// ticks of each instance to world coordinates for the visible time range, so
+// that panning and zooming only change uniforms. Timers narrower than a pixel
+// are widened to one pixel, like the lines drawn for them by TimerTrack.
+// Requires OpenGL 3.3.
+class TimerInstanceRenderer {
+ public:
+  // Maps ticks, and depths, to world coordinates.
+  struct View {
+    uint64_t min_tick;
+    float world_min_x;
+    double world_per_tick;
+    float min_world_width;
+    // The y coordinate of depth 0, and the offset between consecutive depths.
+    float depth_0_y;
+    float depth_step_y;
+    float box_height;
+    float z;
+  };
+
+  TimerInstanceRenderer() = default;
+  TimerInstanceRenderer(const TimerInstanceRenderer&) = delete;
+  TimerInstanceRenderer& operator=(const TimerInstanceRenderer&) = delete;
+  ~TimerInstanceRenderer();
+
+  // Returns false if the current OpenGL context doesn't support instanced
+  // rendering, or if the shaders could not be built. Compiles them on the
+  // first call.
+  [[nodiscard]] bool IsAvailable();
+
+  void Draw(TimerInstanceBuffer* buffer, const View& view);
+
+ private:
+  bool BuildProgram();
+
+  bool initialized_ = false;
+  bool available_ = false;
+  uint32_t program_id_ = 0;
+  int min_tick_location_ = -1;
+  int world_min_x_location_ = -1;
+  int world_per_tick_location_ = -1;
+  int min_world_width_location_ = -1;
+  int depth_0_y_location_ = -1;
+  int depth_step_y_location_ = -1;
+  int box_height_location_ = -1;
+  int z_location_ = -1;
+};
+
+#endif  // ORBIT_GL_TIMER_INSTANCE_RENDERER_
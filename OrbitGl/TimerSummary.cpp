@@ -0,0 +1,49 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "TimerSummary.h"
+
+void TimerSummary::Add(TextBox* timer) {
+  const orbit_client_protos::TimerInfo& timer_info = timer->GetTimerInfo();
+  const uint64_t start = timer_info.start();
+  const uint64_t duration =
+      timer_info.end() > start ? timer_info.end() - start : 0;
+  // The level of the largest buckets that are not longer than the timer.
+  const int duration_level =
+      duration == 0 ? -1 : 63 - __builtin_clzll(duration);
+
+  for (int level = MIN_LEVEL; level <= MAX_LEVEL; ++level) {
+    const size_t level_index = level - MIN_LEVEL;
+    if (duration_level == level ||
+        (level == MAX_LEVEL && duration_level > MAX_LEVEL)) {
+      LongTimers& long_timers = long_timers_[level_index];
+      long_timers.timers.push_back(timer);
+      long_timers.max_duration = std::max(long_timers.max_duration, duration);
+    }
+    if (duration_level >= level) {
+      continue;
+    }
+
+    std::vector<Bucket>& buckets = buckets_[level_index];
+    const uint64_t bucket_start_tick = start >> level << level;
+    if (buckets.empty() || buckets.back().start_tick != bucket_start_tick) {
+      buckets.push_back({bucket_start_tick, timer, 1});
+      continue;
+    }
+    Bucket& bucket = buckets.back();
+    ++bucket.timer_count;
+    const orbit_client_protos::TimerInfo& representative =
+        bucket.representative->GetTimerInfo();
+    if (duration > representative.end() - representative.start()) {
+      bucket.representative = timer;
+    }
+  }
+}
+
+std::optional<int> TimerSummary::GetLevel(uint64_t pixel_delta_in_ticks) {
+  if (pixel_delta_in_ticks < (uint64_t{1} << MIN_LEVEL)) {
+    return std::nullopt;
+  }
+  return std::min(63 - __builtin_clzll(pixel_delta_in_ticks), MAX_LEVEL);
+}
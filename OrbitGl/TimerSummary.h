@@ -0,0 +1,111 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_TIMER_SUMMARY_
+#define ORBIT_GL_TIMER_SUMMARY_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "TextBox.h"
+
+// TimerSummary is a multi-resolution summary of the timers of a TimerChain,
+// so that drawing a zoomed-out timeline costs in the order of the number of
+// pixels rather than of the number of timers.
+//
+// Level l splits time into buckets of 2^l ticks. For each level, the timers
+// that are shorter than a bucket are only kept as occupied buckets, each with
+// the number of timers starting in it and the longest of them as
+// representative. When a pixel spans at least a bucket, such timers would be
+// drawn as overlapping lines anyway, so drawing one line per bucket suffices.
+// Each timer that is at least as long as the buckets of a level is kept in a
+// list of timers of similar duration, so that it is still drawn on its own.
+// As the timers of a depth don't overlap, there are at most as many of them
+// in the visible range as there are buckets.
+//
+// Timers must be added in order of start timestamp.
+class TimerSummary {
+ public:
+  // Finer levels would not be used in practice: when a pixel spans less than
+  // 2^20 ticks (about a millisecond), few enough timers are visible.
+  static constexpr int MIN_LEVEL = 20;
+  static constexpr int MAX_LEVEL = 40;
+
+  struct Bucket {
+    uint64_t start_tick;
+    TextBox* representative;
+    uint32_t timer_count;
+  };
+
+  // timer must stay valid as long as this summary.
+  void Add(TextBox* timer);
+
+  // The coarsest level whose buckets are at most pixel_delta_in_ticks wide,
+  // if pixels are wide enough for the summary to be used.
+  [[nodiscard]] static std::optional<int> GetLevel(
+      uint64_t pixel_delta_in_ticks);
+
+  // Calls on_timer for every timer intersecting [min_tick, max_tick] that is
+  // at least as long as the buckets of level, and for the representative of
+  // every bucket of level that can contain timers intersecting that range.
+  template <typename F>
+  void ForEachTimerToDraw(int level, uint64_t min_tick, uint64_t max_tick,
+                          F&& on_timer) const;
+
+ private:
+  static constexpr int LEVEL_COUNT = MAX_LEVEL - MIN_LEVEL + 1;
+
+  struct LongTimers {
+    std::vector<TextBox*> timers;
+    uint64_t max_duration = 0;
+  };
+
+  // Buckets of level MIN_LEVEL + i, and timers at least 2^(MIN_LEVEL + i)
+  // ticks long, but shorter than the next level unless this is the last one.
+  std::array<std::vector<Bucket>, LEVEL_COUNT> buckets_;
+  std::array<LongTimers, LEVEL_COUNT> long_timers_;
+};
+
+template <typename F>
+void TimerSummary::ForEachTimerToDraw(int level, uint64_t min_tick,
+                                      uint64_t max_tick, F&& on_timer) const {
+  const size_t level_index = level - MIN_LEVEL;
+  auto saturating_sub = [](uint64_t a, uint64_t b) {
+    return a > b ? a - b : uint64_t{0};
+  };
+
+  for (size_t i = level_index; i < LEVEL_COUNT; ++i) {
+    const LongTimers& long_timers = long_timers_[i];
+    // A timer that starts before this cannot end in the range.
+    const uint64_t min_start =
+        saturating_sub(min_tick, long_timers.max_duration);
+    auto it = std::partition_point(
+        long_timers.timers.begin(), long_timers.timers.end(),
+        [min_start](const TextBox* timer) {
+          return timer->GetTimerInfo().start() < min_start;
+        });
+    for (; it != long_timers.timers.end(); ++it) {
+      const orbit_client_protos::TimerInfo& timer_info = (*it)->GetTimerInfo();
+      if (timer_info.start() > max_tick) break;
+      if (timer_info.end() < min_tick) continue;
+      on_timer(*it);
+    }
+  }
+
+  // The timers of a bucket start in it and are shorter than it.
+  const std::vector<Bucket>& buckets = buckets_[level_index];
+  const uint64_t min_start = saturating_sub(min_tick, uint64_t{2} << level);
+  auto it = std::partition_point(
+      buckets.begin(), buckets.end(), [min_start](const Bucket& bucket) {
+        return bucket.start_tick < min_start;
+      });
+  for (; it != buckets.end() && it->start_tick <= max_tick; ++it) {
+    on_timer(it->representative);
+  }
+}
+
+#endif  // ORBIT_GL_TIMER_SUMMARY_
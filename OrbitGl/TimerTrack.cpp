@@ -4,7 +4,9 @@
 
 #include "TimerTrack.h"
 
+#include <algorithm>
 #include <limits>
+#include <optional>
 
 #include "Capture.h"
 #include "EventTrack.h"
@@ -12,6 +14,7 @@
 #include "GlCanvas.h"
 #include "TextBox.h"
 #include "TimeGraph.h"
+#include "TimerSummary.h"
 #include "absl/flags/flag.h"
 #include "absl/strings/str_format.h"
 
@@ -20,11 +23,12 @@ using orbit_client_protos::TimerInfo;
 
 // TODO: Remove this flag once we have a way to toggle the display return values
 ABSL_FLAG(bool, show_return_values, false, "Show return values on time slices");
+ABSL_FLAG(bool, instanced_timers, false,
+          "Draw timer boxes with instanced rendering, so that panning and "
+          "zooming don't rebuild their geometry (requires OpenGL 3.3)");
 
 //-----------------------------------------------------------------------------
 TimerTrack::TimerTrack(TimeGraph* time_graph) : Track(time_graph) {
-  text_renderer_ = time_graph->GetTextRenderer();
-
   num_timers_ = 0;
   min_time_ = std::numeric_limits<TickType>::max();
   max_time_ = std::numeric_limits<TickType>::min();
@@ -39,6 +43,69 @@ void TimerTrack::Draw(GlCanvas* canvas, PickingMode picking_mode) {
   SetSize(track_width, track_height);
 
   Track::Draw(canvas, picking_mode);
+
+  if (picking_mode == PickingMode::kNone && DrawsTimerInstances()) {
+    DrawTimerInstances(canvas);
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool TimerTrack::DrawsTimerInstances() const {
+  // The instances don't depend on the collapsed state, hence tracks that
+  // filter timers while collapsed are drawn the regular way.
+  return absl::GetFlag(FLAGS_instanced_timers) && !IsTimerFilterActive() &&
+         time_graph_->GetTimerInstanceRenderer().IsAvailable();
+}
+
+void TimerTrack::UpdateTimerInstances(
+    const std::vector<std::shared_ptr<TimerChain>>& chains) {
+  const uint64_t colors_key = time_graph_->GetTimerColorsKey();
+  if (colors_key != timer_instances_colors_key_) {
+    timer_instances_.Clear();
+    instanced_timer_counts_.clear();
+    timer_instances_colors_key_ = colors_key;
+  }
+
+  // Only the timers added since the last update are appended.
+  for (const std::shared_ptr<TimerChain>& chain : chains) {
+    if (!chain) continue;
+    uint64_t& instanced_count = instanced_timer_counts_[chain.get()];
+    uint64_t block_begin = 0;
+    for (TimerBlock& block : *chain) {
+      const uint64_t block_end = block_begin + block.size();
+      for (uint64_t i = std::max(instanced_count, block_begin); i < block_end;
+           ++i) {
+        const TimerInfo& timer_info = block[i - block_begin].GetTimerInfo();
+        timer_instances_.Add(timer_info,
+                             GetTimerColor(timer_info, /*is_selected=*/false));
+      }
+      block_begin = block_end;
+    }
+    instanced_count = block_begin;
+  }
+}
+
+void TimerTrack::DrawTimerInstances(GlCanvas* canvas) {
+  const double time_window_us = time_graph_->GetTimeWindowUs();
+  if (timer_instances_.empty() || time_window_us <= 0) {
+    return;
+  }
+
+  TimerInstanceRenderer::View view;
+  view.min_tick = time_graph_->GetTickFromUs(time_graph_->GetMinTimeUs());
+  const double world_per_us = canvas->GetWorldWidth() / time_window_us;
+  view.world_min_x = static_cast<float>(
+      canvas->GetWorldTopLeftX() +
+      time_graph_->GetUsFromTick(view.min_tick) * world_per_us);
+  view.world_per_tick = world_per_us * TicksToMicroseconds(0, 1);
+  view.min_world_width = canvas->GetWorldWidth() / canvas->getWidth();
+  // GetYFromDepth is linear in the depth for all tracks.
+  view.depth_0_y = GetYFromDepth(0);
+  view.depth_step_y = GetYFromDepth(1) - view.depth_0_y;
+  view.box_height = box_height_;
+  // Behind the selected timer, which is still drawn by the batcher.
+  view.z = GlCanvas::Z_VALUE_BOX_INACTIVE;
+  time_graph_->GetTimerInstanceRenderer().Draw(&timer_instances_, view);
 }
 
 //-----------------------------------------------------------------------------
@@ -67,10 +134,26 @@ void TimerTrack::UpdateBoxHeight() {
 }
 
 //-----------------------------------------------------------------------------
-void TimerTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick, PickingMode /*picking_mode*/) {
+void TimerTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
+                                  PickingMode picking_mode) {
+  AddTimerPrimitives(min_tick, max_tick, picking_mode,
+                     /*new_timers_only=*/false);
+}
+
+//-----------------------------------------------------------------------------
+void TimerTrack::UpdateNewPrimitives(uint64_t min_tick, uint64_t max_tick) {
+  AddTimerPrimitives(min_tick, max_tick, PickingMode::kNone,
+                     /*new_timers_only=*/true);
+}
+
+//-----------------------------------------------------------------------------
+void TimerTrack::AddTimerPrimitives(uint64_t min_tick, uint64_t max_tick,
+                                    PickingMode picking_mode,
+                                    bool new_timers_only) {
   UpdateBoxHeight();
 
-  Batcher* batcher = &time_graph_->GetBatcher();
+  CHECK(primitives_batcher_ != nullptr);
+  Batcher* batcher = primitives_batcher_;
   GlCanvas* canvas = time_graph_->GetCanvas();
   const TextBox& scene_box = canvas->GetSceneBox();
 
@@ -82,6 +165,14 @@ void TimerTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick, PickingM
 
   std::vector<std::shared_ptr<TimerChain>> chains_by_depth = GetTimers();
 
+  // The boxes of the timers are then drawn from the instances: only the
+  // labels, the selected timer and the picking primitives are added here.
+  const bool draw_instances =
+      picking_mode == PickingMode::kNone && DrawsTimerInstances();
+  if (draw_instances) {
+    UpdateTimerInstances(chains_by_depth);
+  }
+
   // We minimize overdraw when drawing lines for small events by discarding
   // events that would just draw over an already drawn line. When zoomed in
   // enough that all events are drawn as boxes, this has no effect. When zoomed
@@ -95,95 +186,208 @@ void TimerTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick, PickingM
   uint64_t min_timegraph_tick =
       time_graph_->GetTickFromUs(time_graph_->GetMinTimeUs());
 
+  auto draw_timer = [&](TextBox* text_box) {
+    const TimerInfo& timer_info = text_box->GetTimerInfo();
+    UpdateDepth(timer_info.depth() + 1);
+    double start_us = time_graph_->GetUsFromTick(timer_info.start());
+    double end_us = time_graph_->GetUsFromTick(timer_info.end());
+    double elapsed_us = end_us - start_us;
+    double normalized_start = start_us * inv_time_window;
+    double normalized_length = elapsed_us * inv_time_window;
+    float world_timer_width =
+        static_cast<float>(normalized_length * world_width);
+    float world_timer_x =
+        static_cast<float>(world_start_x + normalized_start * world_width);
+    float world_timer_y = GetYFromDepth(timer_info.depth());
+
+    bool is_visible_width = normalized_length * canvas->getWidth() > 1;
+    bool is_selected = text_box == Capture::GSelectedTextBox;
+
+    Vec2 pos(world_timer_x, world_timer_y);
+    Vec2 size(world_timer_width, box_height_);
+    float z = GlCanvas::Z_VALUE_BOX_ACTIVE;
+    Color color = GetTimerColor(timer_info, is_selected);
+    text_box->SetPos(pos);
+    text_box->SetSize(size);
+
+    if (draw_instances && !is_selected) {
+      if (is_visible_width && !is_collapsed) {
+        SetTimesliceText(timer_info, elapsed_us, min_x, text_box);
+      }
+      return;
+    }
+
+    auto user_data = std::make_unique<PickingUserData>(
+        text_box,
+        [this, text_box](PickingID) { return GetBoxTooltip(text_box); });
+
+    if (is_visible_width) {
+      if (!is_collapsed) {
+        SetTimesliceText(timer_info, elapsed_us, min_x, text_box);
+      }
+      batcher->AddShadedBox(pos, size, z, color, PickingID::BOX,
+                            std::move(user_data));
+    } else {
+      auto type = PickingID::LINE;
+      batcher->AddVerticalLine(pos, size[1], z, color, type,
+                               std::move(user_data));
+      // For lines, we can ignore the entire pixel into which this event
+      // falls. We align this precisely on the pixel x-coordinate of the
+      // current line being drawn (in ticks). If pixel_delta_in_ticks is
+      // zero, we need to avoid dividing by zero, but we also wouldn't
+      // gain anything here.
+      if (pixel_delta_in_ticks != 0) {
+        min_ignore =
+            min_timegraph_tick +
+            ((timer_info.start() - min_timegraph_tick) / pixel_delta_in_ticks) *
+                pixel_delta_in_ticks;
+        max_ignore = min_ignore + pixel_delta_in_ticks;
+      }
+    }
+  };
+
+  // When zoomed out, draw from the summaries of the chains, so that the cost
+  // depends on the number of pixels instead of the number of timers. The
+  // representative of a group of short timers might be filtered out while
+  // others are not, so this is not used while a filter is active.
+  std::optional<int> summary_level =
+      TimerSummary::GetLevel(pixel_delta_in_ticks);
+  if (IsTimerFilterActive()) summary_level.reset();
+
+  auto draw_block_timers = [&](TimerBlock* block, size_t begin, size_t end) {
+    // We have to reset this when we go to the next depth, as otherwise we
+    // would miss drawing events that should be drawn.
+    min_ignore = std::numeric_limits<uint64_t>::max();
+    max_ignore = std::numeric_limits<uint64_t>::min();
+
+    for (size_t k = begin; k < end; ++k) {
+      // Only the timestamp columns are read for the timers that are culled.
+      const uint64_t start = block->GetStart(k);
+      const uint64_t end = block->GetEnd(k);
+      if (min_tick > end || max_tick < start) continue;
+      if (start >= min_ignore && end <= max_ignore) continue;
+
+      TextBox& text_box = (*block)[k];
+      if (!TimerFilter(text_box.GetTimerInfo())) continue;
+      draw_timer(&text_box);
+    }
+  };
+
   for (auto& chain : chains_by_depth) {
     if (!chain) continue;
-    for (TimerChainIterator it = chain->begin(); it != chain->end(); ++it) {
-      TimerBlock& block = *it;
-      if (!block.Intersects(min_tick, max_tick)) continue;
-
-      // We have to reset this when we go to the next depth, as otherwise we
-      // would miss drawing events that should be drawn.
-      min_ignore = std::numeric_limits<uint64_t>::max();
-      max_ignore = std::numeric_limits<uint64_t>::min();
-
-      for (size_t k = 0; k < block.size(); ++k) {
-        TextBox& text_box = block[k];
-        const TimerInfo& timer_info = text_box.GetTimerInfo();
-        if (min_tick > timer_info.end() || max_tick < timer_info.start()) continue;
-        if (timer_info.start() >= min_ignore && timer_info.end() <= max_ignore) continue;
-        if (!TimerFilter(timer_info)) continue;
-
-        UpdateDepth(timer_info.depth() + 1);
-        double start_us = time_graph_->GetUsFromTick(timer_info.start());
-        double end_us = time_graph_->GetUsFromTick(timer_info.end());
-        double elapsed_us = end_us - start_us;
-        double normalized_start = start_us * inv_time_window;
-        double normalized_length = elapsed_us * inv_time_window;
-        float world_timer_width =
-            static_cast<float>(normalized_length * world_width);
-        float world_timer_x =
-            static_cast<float>(world_start_x + normalized_start * world_width);
-        float world_timer_y = GetYFromDepth(timer_info.depth());
-
-        bool is_visible_width = normalized_length * canvas->getWidth() > 1;
-        bool is_selected = &text_box == Capture::GSelectedTextBox;
-
-        Vec2 pos(world_timer_x, world_timer_y);
-        Vec2 size(world_timer_width, box_height_);
-        float z = GlCanvas::Z_VALUE_BOX_ACTIVE;
-        Color color = GetTimerColor(timer_info, is_selected);
-        text_box.SetPos(pos);
-        text_box.SetSize(size);
-
-        auto user_data = std::make_unique<PickingUserData>(
-            &text_box, [&](PickingID id) { return this->GetBoxTooltip(id); });
-
-        if (is_visible_width) {
-          if (!is_collapsed) {
-            SetTimesliceText(timer_info, elapsed_us, min_x, &text_box);
-          }
-          batcher->AddShadedBox(pos, size, z, color, PickingID::BOX,
-                                std::move(user_data));
-        } else {
-          auto type = PickingID::LINE;
-          batcher->AddVerticalLine(pos, size[1], z, color, type,
-                                   std::move(user_data));
-          // For lines, we can ignore the entire pixel into which this event
-          // falls. We align this precisely on the pixel x-coordinate of the
-          // current line being drawn (in ticks). If pixel_delta_in_ticks is
-          // zero, we need to avoid dividing by zero, but we also wouldn't
-          // gain anything here.
-          if (pixel_delta_in_ticks != 0) {
-            min_ignore =
-                min_timegraph_tick +
-                ((timer_info.start() - min_timegraph_tick) / pixel_delta_in_ticks) *
-                    pixel_delta_in_ticks;
-            max_ignore = min_ignore + pixel_delta_in_ticks;
+    // Timers added while this runs are left to the next update.
+    uint64_t& timer_count = primitives_timer_counts_[chain.get()];
+    const uint64_t previous_timer_count = timer_count;
+    timer_count = chain->size();
+
+    if (new_timers_only) {
+      for (uint64_t i = previous_timer_count; i < timer_count;) {
+        TimerBlock& block = *chain->GetBlockContainingIndex(i);
+        const size_t begin = i % kBlockSize;
+        const size_t end = std::min<uint64_t>(block.size(),
+                                              begin + (timer_count - i));
+        draw_block_timers(&block, begin, end);
+        i += end - begin;
+      }
+      continue;
+    }
+
+    const TimerSummary* summary = chain->GetSummary();
+    if (summary != nullptr && summary_level.has_value()) {
+      summary->ForEachTimerToDraw(summary_level.value(), min_tick, max_tick,
+                                  draw_timer);
+      continue;
+    }
+
+    min_ignore = std::numeric_limits<uint64_t>::max();
+    max_ignore = std::numeric_limits<uint64_t>::min();
+    chain->ForEachTimerIntersecting(
+        min_tick, max_tick,
+        [&](TextBox* text_box, uint64_t start, uint64_t end) {
+          if (start >= min_ignore && end <= max_ignore) return;
+          if (!TimerFilter(text_box->GetTimerInfo())) return;
+          draw_timer(text_box);
+        });
+  }
+}
+
+//-----------------------------------------------------------------------------
+TextBox* TimerTrack::GetTimerAt(float world_y, uint64_t tick,
+                                uint64_t tick_tolerance) {
+  UpdateBoxHeight();
+  const uint64_t min_tick = tick > tick_tolerance ? tick - tick_tolerance : 0;
+  const uint64_t max_tick = tick + tick_tolerance;
+
+  ScopeLock lock(mutex_);
+  for (auto& [depth, chain] : timers_) {
+    // Collapsed tracks draw several depths at the same y.
+    const float depth_y = GetYFromDepth(depth);
+    if (!chain || world_y < depth_y || world_y > depth_y + box_height_) {
+      continue;
+    }
+
+    TextBox* closest_timer = nullptr;
+    uint64_t closest_distance = std::numeric_limits<uint64_t>::max();
+    chain->ForEachTimerIntersecting(
+        min_tick, max_tick,
+        [&](TextBox* text_box, uint64_t start, uint64_t end) {
+          if (!TimerFilter(text_box->GetTimerInfo())) return;
+          const uint64_t distance =
+              tick < start ? start - tick : (tick > end ? tick - end : 0);
+          if (distance < closest_distance) {
+            closest_timer = text_box;
+            closest_distance = distance;
           }
+        });
+    if (closest_timer != nullptr) {
+      return closest_timer;
+    }
+  }
+  return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+void TimerTrack::DropTimersEndingBefore(uint64_t timestamp) {
+  uint64_t num_dropped_timers = 0;
+  {
+    ScopeLock lock(mutex_);
+    for (auto& [unused_depth, chain] : timers_) {
+      if (chain) num_dropped_timers += chain->DropBlocksEndingBefore(timestamp);
+    }
+    if (num_dropped_timers == 0) return;
+    min_time_ = std::numeric_limits<TickType>::max();
+    for (auto& [unused_depth, chain] : timers_) {
+      if (!chain) continue;
+      for (TimerBlock& block : *chain) {
+        if (block.size() > 0 && block.GetMinTimestamp() < min_time_) {
+          min_time_ = block.GetMinTimestamp();
         }
       }
     }
   }
+  num_timers_ -= num_dropped_timers;
+
+  // The instances are copies of the timers, and the watermarks indices into
+  // the chains: both start over.
+  timer_instances_.Clear();
+  instanced_timer_counts_.clear();
+  primitives_timer_counts_.clear();
 }
 
 //-----------------------------------------------------------------------------
-void TimerTrack::OnTimer(const TimerInfo& timer_info) {
+const TextBox* TimerTrack::OnTimer(TimerInfo timer_info) {
   if (timer_info.type() != TimerInfo::kCoreActivity) {
     UpdateDepth(timer_info.depth() + 1);
   }
+  ++num_timers_;
+  if (timer_info.start() < min_time_) min_time_ = timer_info.start();
+  if (timer_info.end() > max_time_) max_time_ = timer_info.end();
 
-  TextBox text_box(Vec2(0, 0), Vec2(0, 0), "", Color(255, 0, 0, 255));
-  text_box.SetTimerInfo(timer_info);
-
-  std::shared_ptr<TimerChain> timer_chain = timers_[timer_info.depth()];
+  std::shared_ptr<TimerChain>& timer_chain = timers_[timer_info.depth()];
   if (timer_chain == nullptr) {
     timer_chain = std::make_shared<TimerChain>();
-    timers_[timer_info.depth()] = timer_chain;
   }
-  timer_chain->push_back(text_box);
-  ++num_timers_;
-  if (timer_info.start() < min_time_) min_time_ = timer_info.start();
-  if (timer_info.end() > max_time_) max_time_ = timer_info.end();
+  return timer_chain->emplace_back(std::move(timer_info));
 }
 
 std::string TimerTrack::GetTooltip() const {
@@ -218,16 +422,8 @@ const TextBox* TimerTrack::GetFirstAfterTime(TickType time,
   std::shared_ptr<TimerChain> chain = GetTimers(depth);
   if (chain == nullptr) return nullptr;
 
-  // TODO: do better than linear search...
-  for (TimerChainIterator it = chain->begin(); it != chain->end(); ++it) {
-    for (size_t k = 0; k < it->size(); ++k) {
-      const TextBox& text_box = (*it)[k];
-      if (text_box.GetTimerInfo().start() > time) {
-        return &text_box;
-      }
-    }
-  }
-  return nullptr;
+  if (time == std::numeric_limits<TickType>::max()) return nullptr;
+  return chain->GetFirstStartingAtOrAfter(time + 1);
 }
 
 //-----------------------------------------------------------------------------
@@ -236,20 +432,11 @@ const TextBox* TimerTrack::GetFirstBeforeTime(TickType time,
   std::shared_ptr<TimerChain> chain = GetTimers(depth);
   if (chain == nullptr) return nullptr;
 
-  const TextBox* text_box = nullptr;
-
-  // TODO: do better than linear search...
-  for (TimerChainIterator it = chain->begin(); it != chain->end(); ++it) {
-    for (size_t k = 0; k < it->size(); ++k) {
-      const TextBox& box = (*it)[k];
-      if (box.GetTimerInfo().start() > time) {
-        return text_box;
-      }
-      text_box = &box;
-    }
-  }
-
-  return nullptr;
+  // The timer before the first one that starts after time, if there is one.
+  if (time == std::numeric_limits<TickType>::max()) return nullptr;
+  const TextBox* next_text_box = chain->GetFirstStartingAtOrAfter(time + 1);
+  if (next_text_box == nullptr) return nullptr;
+  return chain->GetElementBefore(next_text_box);
 }
 
 //-----------------------------------------------------------------------------
@@ -285,4 +472,6 @@ std::vector<std::shared_ptr<TimerChain>> TimerTrack::GetAllChains() {
 bool TimerTrack::IsEmpty() const { return GetNumTimers() == 0; }
 
 //-----------------------------------------------------------------------------
-std::string TimerTrack::GetBoxTooltip(PickingID /*id*/) const { return ""; }
+std::string TimerTrack::GetBoxTooltip(const TextBox* /*text_box*/) const {
+  return "";
+}
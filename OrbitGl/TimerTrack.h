@@ -14,11 +14,10 @@
 #include "TextBox.h"
 #include "Threading.h"
 #include "TimerChain.h"
+#include "TimerInstanceRenderer.h"
 #include "Track.h"
 #include "capture_data.pb.h"
 
-class TextRenderer;
-
 class TimerTrack : public Track {
  public:
   explicit TimerTrack(TimeGraph* time_graph);
@@ -26,12 +25,14 @@ class TimerTrack : public Track {
 
   // Pickable
   void Draw(GlCanvas* canvas, PickingMode picking_mode) override;
-  void OnTimer(const orbit_client_protos::TimerInfo& timer_info);
+  // Returns the TextBox the timer is stored in.
+  const TextBox* OnTimer(orbit_client_protos::TimerInfo timer_info);
   [[nodiscard]] std::string GetTooltip() const override;
 
   // Track
   void UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
                         PickingMode /*picking_mode*/) override;
+  void UpdateNewPrimitives(uint64_t min_tick, uint64_t max_tick) override;
   [[nodiscard]] Type GetType() const override { return kTimerTrack; }
   [[nodiscard]] float GetHeight() const override;
 
@@ -74,6 +75,20 @@ class TimerTrack : public Track {
   virtual void UpdateBoxHeight();
   [[nodiscard]] virtual float GetYFromDepth(uint32_t depth) const;
 
+  // Returns the timer whose box is drawn at world_y and at tick, or within
+  // tick_tolerance of tick, as timers narrower than a pixel are drawn a pixel
+  // wide. Returns nullptr if there is none. Finds the depth from world_y and
+  // then the timer from the blocks of its chain, so that hovering timers
+  // doesn't require a picking pass.
+  [[nodiscard]] TextBox* GetTimerAt(float world_y, uint64_t tick,
+                                    uint64_t tick_tolerance);
+
+  // Frees the oldest timers, by whole blocks of their chains, that end before
+  // timestamp, to keep only the end of a long capture.
+  virtual void DropTimersEndingBefore(uint64_t timestamp);
+  [[nodiscard]] virtual std::string GetBoxTooltip(
+      const TextBox* /*text_box*/) const;
+
  protected:
   [[nodiscard]] virtual bool IsTimerActive(
       const orbit_client_protos::TimerInfo& /*timer_info*/) const {
@@ -86,22 +101,42 @@ class TimerTrack : public Track {
       const orbit_client_protos::TimerInfo& /*timer_info*/) const {
     return true;
   }
+  // Whether TimerFilter currently filters out any timer.
+  [[nodiscard]] virtual bool IsTimerFilterActive() const { return false; }
 
   void UpdateDepth(uint32_t depth) {
     if (depth > depth_) depth_ = depth;
   }
   [[nodiscard]] std::shared_ptr<TimerChain> GetTimers(uint32_t depth) const;
 
+  // Whether the timer boxes are drawn from timer_instances_ instead of being
+  // added to the batcher, when not picking.
+  [[nodiscard]] virtual bool DrawsTimerInstances() const;
+  void UpdateTimerInstances(
+      const std::vector<std::shared_ptr<TimerChain>>& chains);
+  void DrawTimerInstances(GlCanvas* canvas);
+  // Adds the primitives of all the timers in [min_tick, max_tick], or, if
+  // new_timers_only, of the timers added to the chains since the last update.
+  void AddTimerPrimitives(uint64_t min_tick, uint64_t max_tick,
+                          PickingMode picking_mode, bool new_timers_only);
+
   virtual void SetTimesliceText(const orbit_client_protos::TimerInfo& /*timer*/,
                                 double /*elapsed_us*/, float /*min_x*/,
                                 TextBox* /*text_box*/) {}
-  TextRenderer* text_renderer_ = nullptr;
   uint32_t depth_ = 0;
   mutable Mutex mutex_;
   std::map<int, std::shared_ptr<TimerChain>> timers_;
 
-  [[nodiscard]] virtual std::string GetBoxTooltip(PickingID /*id*/) const;
   float box_height_;
+
+  TimerInstanceBuffer timer_instances_;
+  // The key of TimeGraph::GetTimerColorsKey the instances were colored with,
+  // and how many timers of each chain they contain.
+  uint64_t timer_instances_colors_key_ = 0;
+  std::map<const TimerChain*, uint64_t> instanced_timer_counts_;
+  // The watermark of each chain: how many of its timers the last update
+  // considered. Incremental updates start from there.
+  std::map<const TimerChain*, uint64_t> primitives_timer_counts_;
 };
 
 #endif  // ORBIT_GL_TIMER_TRACK_H_
@@ -4,117 +4,389 @@
 
 #include "TopDownView.h"
 
-TopDownFunction* TopDownInternalNode::GetFunctionOrNull(
-    uint64_t function_absolute_address) {
-  auto top_down_function_it = function_nodes_.find(function_absolute_address);
-  if (top_down_function_it == function_nodes_.end()) {
-    return nullptr;
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+#include "OrbitBase/ParallelFor.h"
+#include "OrbitBase/ThreadPool.h"
+#include "absl/strings/str_format.h"
+
+[[nodiscard]] static std::string GetThreadName(
+    int32_t tid, const std::string& process_name,
+    const std::unordered_map<int32_t, std::string>& thread_names) {
+  if (tid == SamplingProfiler::kAllThreadsFakeTid) {
+    return process_name;
   }
-  return &top_down_function_it->second;
+  if (auto thread_name_it = thread_names.find(tid);
+      thread_name_it != thread_names.end()) {
+    return thread_name_it->second;
+  }
+  return "";
 }
 
-TopDownFunction* TopDownInternalNode::AddAndGetFunction(
-    uint64_t function_absolute_address, std::string function_name) {
-  function_nodes_.insert_or_assign(
-      function_absolute_address,
-      TopDownFunction{function_absolute_address, std::move(function_name),
-                      this});
-  return &function_nodes_.at(function_absolute_address);
-}
+// Accumulates the callstacks of one thread into a tree of plain indices, then
+// lays the tree out into the TopDownThread.
+class CallTreeBuilder {
+ public:
+  CallTreeBuilder() { nodes_.push_back({}); }
 
-TopDownThread* TopDownView::GetThreadOrNull(int32_t thread_id) {
-  auto top_down_thread_it = thread_nodes_.find(thread_id);
-  if (top_down_thread_it == thread_nodes_.end()) {
-    return nullptr;
+  // The frames in [frames_begin, frames_end) go from the root of the tree
+  // down.
+  template <typename FrameIterator>
+  void AddCallstack(FrameIterator frames_begin, FrameIterator frames_end,
+                    uint64_t sample_count) {
+    uint32_t node_index = 0;
+    nodes_[0].sample_count += sample_count;
+    for (FrameIterator frame_it = frames_begin; frame_it != frames_end;
+         ++frame_it) {
+      auto [child_it, inserted] = child_indices_.try_emplace(
+          std::make_pair(node_index, *frame_it), nodes_.size());
+      if (inserted) {
+        nodes_.push_back({*frame_it, node_index});
+      }
+      node_index = child_it->second;
+      nodes_[node_index].sample_count += sample_count;
+    }
+    if (node_index != 0) {
+      nodes_[node_index].exclusive_sample_count += sample_count;
+    }
   }
-  return &top_down_thread_it->second;
-}
 
-TopDownThread* TopDownView::AddAndGetThread(int32_t thread_id,
-                                            std::string thread_name) {
-  thread_nodes_.insert_or_assign(
-      thread_id, TopDownThread{thread_id, std::move(thread_name), this});
-  return &thread_nodes_.at(thread_id);
-}
+  void InternFunctionNames(
+      const std::unordered_map<uint64_t, std::string>& function_names,
+      TopDownView::FunctionNames* interned_function_names) const {
+    for (size_t i = 1; i < nodes_.size(); ++i) {
+      InternFunctionName(nodes_[i].address, function_names,
+                         interned_function_names);
+    }
+  }
 
-[[nodiscard]] static TopDownFunction* GetOrCreateFunctionNode(
-    TopDownInternalNode* current_thread_or_function, uint64_t frame,
-    const std::unordered_map<uint64_t, std::string>& function_names) {
-  TopDownFunction* function_node =
-      current_thread_or_function->GetFunctionOrNull(frame);
-  if (function_node == nullptr) {
-    std::string function_name;
-    auto function_name_it = function_names.find(frame);
+  // Moves the tree into thread_node, as its function nodes in breadth-first
+  // order.
+  void Build(const TopDownView::FunctionNames& function_names,
+             TopDownThread* thread_node) {
+    // Group the children by parent, sorted by decreasing sample count.
+    std::vector<uint32_t> children_begin(nodes_.size() + 1, 0);
+    for (size_t i = 1; i < nodes_.size(); ++i) {
+      ++children_begin[nodes_[i].parent + 1];
+    }
+    for (size_t i = 1; i < children_begin.size(); ++i) {
+      children_begin[i] += children_begin[i - 1];
+    }
+    std::vector<uint32_t> children(nodes_.size() - 1);
+    std::vector<uint32_t> child_positions = children_begin;
+    for (size_t i = 1; i < nodes_.size(); ++i) {
+      children[child_positions[nodes_[i].parent]++] = i;
+    }
+    auto is_before = [this](uint32_t lhs, uint32_t rhs) {
+      if (nodes_[lhs].sample_count != nodes_[rhs].sample_count) {
+        return nodes_[lhs].sample_count > nodes_[rhs].sample_count;
+      }
+      return nodes_[lhs].address < nodes_[rhs].address;
+    };
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+      std::sort(children.begin() + children_begin[i],
+                children.begin() + children_begin[i + 1], is_before);
+    }
+
+    // Position 0 is the thread, position i > 0 is function node i - 1.
+    std::vector<uint32_t> order(nodes_.size());
+    std::vector<uint32_t> positions(nodes_.size());
+    order[0] = 0;
+    size_t order_size = 1;
+    for (size_t position = 0; position < order_size; ++position) {
+      const uint32_t node_index = order[position];
+      positions[node_index] = position;
+      for (uint32_t i = children_begin[node_index];
+           i < children_begin[node_index + 1]; ++i) {
+        order[order_size++] = children[i];
+      }
+    }
+
+    std::deque<TopDownFunction>& function_nodes = thread_node->function_nodes_;
+    function_nodes.resize(nodes_.size() - 1);
+    auto get_node = [&](uint32_t position) -> TopDownNode* {
+      return position == 0 ? static_cast<TopDownNode*>(thread_node)
+                           : &function_nodes[position - 1];
+    };
+    for (uint32_t position = 0; position < nodes_.size(); ++position) {
+      const Node& node = nodes_[order[position]];
+      TopDownNode* top_down_node = get_node(position);
+      top_down_node->sample_count_ = node.sample_count;
+      const uint32_t node_children_begin = children_begin[order[position]];
+      const uint32_t child_count =
+          children_begin[order[position] + 1] - node_children_begin;
+      if (child_count > 0) {
+        const uint32_t first_child_position =
+            positions[children[node_children_begin]];
+        top_down_node->children_.reserve(child_count);
+        for (uint32_t i = 0; i < child_count; ++i) {
+          top_down_node->children_.push_back(
+              &function_nodes[first_child_position + i - 1]);
+        }
+      }
+      if (position == 0) {
+        continue;
+      }
+      const uint32_t parent_position = positions[node.parent];
+      top_down_node->parent_ = get_node(parent_position);
+      top_down_node->index_in_parent_ =
+          position - positions[children[children_begin[node.parent]]];
+      TopDownFunction& function_node = function_nodes[position - 1];
+      function_node.function_absolute_address_ = node.address;
+      function_node.function_name_ = function_names.at(node.address);
+      function_node.exclusive_sample_count_ = node.exclusive_sample_count;
+    }
+
+    nodes_.clear();
+    nodes_.shrink_to_fit();
+    child_indices_.clear();
+  }
+
+  static void SetThread(int32_t thread_id, std::string thread_name,
+                        const TopDownView* view, TopDownThread* thread_node) {
+    thread_node->thread_id_ = thread_id;
+    thread_node->thread_name_ = std::move(thread_name);
+    thread_node->parent_ = view;
+  }
+
+  // Sorts the threads of view like the children of any node, counts the
+  // samples of all threads as those of the view, but for the all-threads
+  // node.
+  static void SetThreads(
+      std::vector<std::unique_ptr<TopDownThread>> thread_nodes,
+      std::shared_ptr<TopDownView::FunctionNames> function_names,
+      TopDownView* view) {
+    std::sort(thread_nodes.begin(), thread_nodes.end(),
+              [](const std::unique_ptr<TopDownThread>& lhs,
+                 const std::unique_ptr<TopDownThread>& rhs) {
+                if (lhs->sample_count() != rhs->sample_count()) {
+                  return lhs->sample_count() > rhs->sample_count();
+                }
+                return lhs->thread_id() < rhs->thread_id();
+              });
+    view->function_names_ = std::move(function_names);
+    view->thread_nodes_ = std::move(thread_nodes);
+    view->thread_nodes_by_id_.clear();
+    view->children_.clear();
+    view->sample_count_ = 0;
+    for (const std::unique_ptr<TopDownThread>& thread_node :
+         view->thread_nodes_) {
+      thread_node->index_in_parent_ = view->children_.size();
+      view->children_.push_back(thread_node.get());
+      view->thread_nodes_by_id_.emplace(thread_node->thread_id(),
+                                        thread_node.get());
+      // Don't count samples from the all-thread case again.
+      if (thread_node->thread_id() != SamplingProfiler::kAllThreadsFakeTid) {
+        view->sample_count_ += thread_node->sample_count();
+      }
+    }
+  }
+
+  static void AddCallstackSamples(
+      const CallstackSamples& samples, const std::string& process_name,
+      const std::unordered_map<int32_t, std::string>& thread_names,
+      const std::unordered_map<uint64_t, std::string>& function_names,
+      TopDownView* view) {
+    if (samples.thread_id != SamplingProfiler::kAllThreadsFakeTid) {
+      view->sample_count_ += samples.sample_count;
+      AddCallstackSamplesToThread(samples, samples.thread_id, process_name,
+                                  thread_names, function_names, view);
+    }
+    AddCallstackSamplesToThread(samples, SamplingProfiler::kAllThreadsFakeTid,
+                                process_name, thread_names, function_names,
+                                view);
+  }
+
+ private:
+  struct Node {
+    uint64_t address = 0;
+    uint32_t parent = 0;
+    uint64_t sample_count = 0;
+    uint64_t exclusive_sample_count = 0;
+  };
+
+  static void InternFunctionName(
+      uint64_t address,
+      const std::unordered_map<uint64_t, std::string>& function_names,
+      TopDownView::FunctionNames* interned_function_names) {
+    if (interned_function_names->contains(address)) {
+      return;
+    }
+    auto function_name_it = function_names.find(address);
     if (function_name_it != function_names.end() &&
         function_name_it->second !=
             SamplingProfiler::kUnknownFunctionOrModuleName) {
-      function_name = function_name_it->second;
+      interned_function_names->emplace(address, function_name_it->second);
     } else {
-      function_name = absl::StrFormat("[unknown@%#llx]", frame);
+      interned_function_names->emplace(
+          address, absl::StrFormat("[unknown@%#llx]", address));
     }
-    function_node = current_thread_or_function->AddAndGetFunction(
-        frame, std::move(function_name));
   }
-  return function_node;
-}
 
-static void AddCallstackToTopDownThread(
-    TopDownThread* thread_node, const CallStack& resolved_callstack,
-    uint64_t callstack_sample_count,
-    const std::unordered_map<uint64_t, std::string>& function_names) {
-  TopDownInternalNode* current_thread_or_function = thread_node;
-  for (auto frame_it = resolved_callstack.m_Data.crbegin();
-       frame_it != resolved_callstack.m_Data.crend(); ++frame_it) {
-    uint64_t frame = *frame_it;
-    TopDownFunction* function_node = GetOrCreateFunctionNode(
-        current_thread_or_function, frame, function_names);
-    function_node->IncreaseSampleCount(callstack_sample_count);
-    current_thread_or_function = function_node;
+  static void AddCallstackSamplesToThread(
+      const CallstackSamples& samples, int32_t thread_id,
+      const std::string& process_name,
+      const std::unordered_map<int32_t, std::string>& thread_names,
+      const std::unordered_map<uint64_t, std::string>& function_names,
+      TopDownView* view) {
+    TopDownThread*& thread_node = view->thread_nodes_by_id_[thread_id];
+    if (thread_node == nullptr) {
+      view->thread_nodes_.push_back(std::make_unique<TopDownThread>());
+      thread_node = view->thread_nodes_.back().get();
+      SetThread(thread_id, GetThreadName(thread_id, process_name, thread_names),
+                view, thread_node);
+      thread_node->index_in_parent_ = view->children_.size();
+      view->children_.push_back(thread_node);
+    }
+
+    // The nodes of a thread built from a SamplingProfiler are only indexed
+    // once callstacks are added to it.
+    auto& function_nodes_by_parent_and_address =
+        thread_node->function_nodes_by_parent_and_address_;
+    if (function_nodes_by_parent_and_address.size() !=
+        thread_node->function_nodes_.size()) {
+      function_nodes_by_parent_and_address.clear();
+      for (TopDownFunction& function_node : thread_node->function_nodes_) {
+        function_nodes_by_parent_and_address.emplace(
+            std::make_pair(function_node.parent(),
+                           function_node.function_absolute_address()),
+            &function_node);
+      }
+    }
+
+    const std::vector<uint64_t>& function_addresses =
+        *samples.function_addresses;
+    auto add_frames = [&](auto frames_begin, auto frames_end) {
+      TopDownNode* node = thread_node;
+      node->sample_count_ += samples.sample_count;
+      for (auto frame_it = frames_begin; frame_it != frames_end; ++frame_it) {
+        TopDownFunction*& function_node =
+            function_nodes_by_parent_and_address[std::make_pair(node,
+                                                                *frame_it)];
+        if (function_node == nullptr) {
+          InternFunctionName(*frame_it, function_names,
+                             view->function_names_.get());
+          function_node = &thread_node->function_nodes_.emplace_back();
+          function_node->parent_ = node;
+          function_node->index_in_parent_ = node->children_.size();
+          function_node->function_absolute_address_ = *frame_it;
+          function_node->function_name_ =
+              view->function_names_->at(*frame_it);
+          node->children_.push_back(function_node);
+        }
+        function_node->sample_count_ += samples.sample_count;
+        node = function_node;
+      }
+      if (node != thread_node) {
+        static_cast<TopDownFunction*>(node)->exclusive_sample_count_ +=
+            samples.sample_count;
+      }
+    };
+    if (view->is_bottom_up()) {
+      add_frames(function_addresses.cbegin(), function_addresses.cend());
+    } else {
+      add_frames(function_addresses.crbegin(), function_addresses.crend());
+    }
   }
-}
 
-[[nodiscard]] static TopDownThread* GetOrCreateThreadNode(
-    TopDownView* top_down_view, int32_t tid, const std::string& process_name,
-    const std::unordered_map<int32_t, std::string>& thread_names) {
-  TopDownThread* thread_node = top_down_view->GetThreadOrNull(tid);
-  if (thread_node == nullptr) {
-    std::string thread_name;
-    if (tid == SamplingProfiler::kAllThreadsFakeTid) {
-      thread_name = process_name;
-    } else if (auto thread_name_it = thread_names.find(tid);
-               thread_name_it != thread_names.end()) {
-      thread_name = thread_name_it->second;
-    }
-    thread_node = top_down_view->AddAndGetThread(tid, std::move(thread_name));
+  std::vector<Node> nodes_;
+  absl::flat_hash_map<std::pair<uint32_t, uint64_t>, uint32_t> child_indices_;
+};
+
+void TopDownView::AddCallstackSamples(
+    absl::Span<const CallstackSamples> samples,
+    const std::string& process_name,
+    const std::unordered_map<int32_t, std::string>& thread_names,
+    const std::unordered_map<uint64_t, std::string>& function_names) {
+  if (function_names_ == nullptr) {
+    function_names_ = std::make_shared<FunctionNames>();
+  }
+  for (const CallstackSamples& callstack_samples : samples) {
+    CallTreeBuilder::AddCallstackSamples(callstack_samples, process_name,
+                                         thread_names, function_names, this);
   }
-  return thread_node;
 }
 
-std::unique_ptr<TopDownView> TopDownView::CreateFromSamplingProfiler(
+TopDownAndBottomUpViews CreateTopDownAndBottomUpViews(
     const SamplingProfiler& sampling_profiler, const std::string& process_name,
     const std::unordered_map<int32_t, std::string>& thread_names,
     const std::unordered_map<uint64_t, std::string>& function_names) {
-  auto top_down_view = std::make_unique<TopDownView>();
-  for (const ThreadSampleData* thread_sample_data :
-       sampling_profiler.GetThreadSampleData()) {
-    const int32_t tid = thread_sample_data->m_TID;
-    TopDownThread* thread_node = GetOrCreateThreadNode(
-        top_down_view.get(), tid, process_name, thread_names);
-
-    for (const auto& callstack_id_and_count :
-         thread_sample_data->m_CallstackCount) {
-      const CallStack& resolved_callstack =
-          sampling_profiler.GetResolvedCallstack(callstack_id_and_count.first);
-      const uint64_t sample_count = callstack_id_and_count.second;
-      // Don't count samples from the all-thread case again.
-      if (tid != SamplingProfiler::kAllThreadsFakeTid) {
-        top_down_view->IncreaseSampleCount(sample_count);
+  const std::vector<ThreadSampleData*>& thread_sample_data =
+      sampling_profiler.GetThreadSampleData();
+  const size_t thread_count = thread_sample_data.size();
+
+  const size_t worker_count = std::min<size_t>(
+      thread_count, std::max(std::thread::hardware_concurrency(), 1u));
+  std::unique_ptr<ThreadPool> thread_pool;
+  if (worker_count > 1) {
+    thread_pool = ThreadPool::CreateWorkStealing(worker_count - 1);
+  }
+  auto parallel_for = [&thread_pool](size_t count, const auto& body) {
+    if (thread_pool == nullptr) {
+      for (size_t i = 0; i < count; ++i) {
+        body(i);
       }
-      thread_node->IncreaseSampleCount(sample_count);
+    } else {
+      ParallelFor(thread_pool.get(), 0, count, body);
+    }
+  };
 
-      AddCallstackToTopDownThread(thread_node, resolved_callstack,
-                                  sample_count, function_names);
+  // The two trees of each thread are built while walking its callstacks
+  // once: the top-down tree from the outermost frame, the bottom-up tree from
+  // the innermost one.
+  std::vector<CallTreeBuilder> top_down_builders(thread_count);
+  std::vector<CallTreeBuilder> bottom_up_builders(thread_count);
+  parallel_for(thread_count, [&](size_t thread_index) {
+    for (const auto& [callstack_id, sample_count] :
+         thread_sample_data[thread_index]->m_CallstackCount) {
+      const std::vector<uint64_t>& frames =
+          sampling_profiler.GetResolvedCallstack(callstack_id).m_Data;
+      top_down_builders[thread_index].AddCallstack(
+          frames.crbegin(), frames.crend(), sample_count);
+      bottom_up_builders[thread_index].AddCallstack(
+          frames.cbegin(), frames.cend(), sample_count);
     }
+  });
+
+  // Both trees of a thread hold the same functions.
+  auto interned_function_names =
+      std::make_shared<TopDownView::FunctionNames>();
+  for (const CallTreeBuilder& builder : top_down_builders) {
+    builder.InternFunctionNames(function_names,
+                                interned_function_names.get());
+  }
+
+  TopDownAndBottomUpViews views;
+  views.top_down_view = std::make_unique<TopDownView>();
+  views.bottom_up_view = std::make_unique<BottomUpView>();
+  std::vector<std::unique_ptr<TopDownThread>> top_down_threads(thread_count);
+  std::vector<std::unique_ptr<TopDownThread>> bottom_up_threads(thread_count);
+  parallel_for(2 * thread_count, [&](size_t i) {
+    const size_t thread_index = i / 2;
+    const int32_t tid = thread_sample_data[thread_index]->m_TID;
+    const bool is_top_down = i % 2 == 0;
+    auto thread_node = std::make_unique<TopDownThread>();
+    CallTreeBuilder::SetThread(
+        tid, GetThreadName(tid, process_name, thread_names),
+        is_top_down ? views.top_down_view.get() : views.bottom_up_view.get(),
+        thread_node.get());
+    CallTreeBuilder& builder = is_top_down ? top_down_builders[thread_index]
+                                           : bottom_up_builders[thread_index];
+    builder.Build(*interned_function_names, thread_node.get());
+    (is_top_down ? top_down_threads : bottom_up_threads)[thread_index] =
+        std::move(thread_node);
+  });
+  if (thread_pool != nullptr) {
+    thread_pool->ShutdownAndWait();
   }
-  return top_down_view;
+
+  CallTreeBuilder::SetThreads(std::move(top_down_threads),
+                              interned_function_names,
+                              views.top_down_view.get());
+  CallTreeBuilder::SetThreads(std::move(bottom_up_threads),
+                              std::move(interned_function_names),
+                              views.bottom_up_view.get());
+  return views;
 }
@@ -5,47 +5,44 @@
 #ifndef ORBIT_GL_TOP_DOWN_VIEW_H_
 #define ORBIT_GL_TOP_DOWN_VIEW_H_
 
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "SamplingProfiler.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/node_hash_map.h"
+#include "absl/types/span.h"
 
+class CallTreeBuilder;
+
+// The children of each node are kept in a list, so that TopDownViewItemModel
+// can access them by row without building any. They are sorted by decreasing
+// sample count when the TopDownView is built. Children added later with
+// TopDownView::AddCallstackSamples come after the existing ones, so that the
+// rows of existing nodes don't change.
 class [[nodiscard]] TopDownNode {
  public:
-  explicit TopDownNode(TopDownNode* parent) : parent_{parent} {}
   virtual ~TopDownNode() = default;
 
   [[nodiscard]] uint64_t sample_count() const { return sample_count_; }
 
-  void IncreaseSampleCount(uint64_t sample_count_increase) {
-    sample_count_ += sample_count_increase;
-  }
-
-  // parent(), child_count(), children() are needed by TopDownViewItemModel.
+  // parent(), child_count(), children(), index_in_parent() are needed by
+  // TopDownViewItemModel.
   [[nodiscard]] const TopDownNode* parent() const { return parent_; }
 
-  [[nodiscard]] virtual uint64_t child_count() const = 0;
+  [[nodiscard]] uint64_t child_count() const { return children_.size(); }
 
-  [[nodiscard]] virtual std::vector<const TopDownNode*> children() const = 0;
-
- private:
-  TopDownNode* parent_;
-  uint64_t sample_count_ = 0;
-};
-
-class TopDownFunction;
-
-class [[nodiscard]] TopDownInternalNode : public TopDownNode {
- public:
-  explicit TopDownInternalNode(TopDownNode* parent) : TopDownNode{parent} {
-    CHECK(parent != nullptr);
+  [[nodiscard]] absl::Span<const TopDownNode* const> children() const {
+    return children_;
   }
 
-  [[nodiscard]] TopDownFunction* GetFunctionOrNull(
-      uint64_t function_absolute_address);
-
-  [[nodiscard]] TopDownFunction* AddAndGetFunction(
-      uint64_t function_absolute_address, std::string function_name);
+  // The position of this node in parent()->children().
+  [[nodiscard]] uint32_t index_in_parent() const { return index_in_parent_; }
 
   [[nodiscard]] float GetInclusivePercent(uint64_t total_sample_count) const {
     return 100.0f * sample_count() / total_sample_count;
@@ -56,114 +53,139 @@ class [[nodiscard]] TopDownInternalNode : public TopDownNode {
   }
 
  protected:
-  // node_hash_map instead of flat_hash_map as pointer stability is needed for
-  // the TopDownNode::parent_ field.
-  absl::node_hash_map<uint64_t, TopDownFunction> function_nodes_;
+  TopDownNode() = default;
+  TopDownNode(const TopDownNode&) = default;
+  TopDownNode& operator=(const TopDownNode&) = default;
+
+ private:
+  friend class CallTreeBuilder;
+
+  const TopDownNode* parent_ = nullptr;
+  uint64_t sample_count_ = 0;
+  std::vector<const TopDownNode*> children_;
+  uint32_t index_in_parent_ = 0;
 };
 
-class [[nodiscard]] TopDownFunction : public TopDownInternalNode {
+class [[nodiscard]] TopDownFunction : public TopDownNode {
  public:
-  explicit TopDownFunction(uint64_t function_absolute_address,
-                           std::string function_name, TopDownNode* parent)
-      : TopDownInternalNode{parent},
-        function_absolute_address_{function_absolute_address},
-        function_name_{std::move(function_name)} {}
-
   [[nodiscard]] uint64_t function_absolute_address() const {
     return function_absolute_address_;
   }
 
-  [[nodiscard]] const std::string& function_name() const {
+  // The name is interned in the TopDownView that holds this node.
+  [[nodiscard]] std::string_view function_name() const {
     return function_name_;
   }
 
+  // The samples of which the callstack ends with this node, i.e., for which
+  // this node has no child.
   [[nodiscard]] uint64_t GetExclusiveSampleCount() const {
-    uint64_t children_sample_count = 0;
-    for (const auto& child_address_and_node : function_nodes_) {
-      children_sample_count += child_address_and_node.second.sample_count();
-    }
-    return sample_count() - children_sample_count;
+    return exclusive_sample_count_;
   }
 
   [[nodiscard]] float GetExclusivePercent(uint64_t total_sample_count) const {
     return 100.0f * GetExclusiveSampleCount() / total_sample_count;
   }
 
-  [[nodiscard]] uint64_t child_count() const override {
-    return function_nodes_.size();
-  }
-
-  [[nodiscard]] std::vector<const TopDownNode*> children() const override {
-    std::vector<const TopDownNode*> ret;
-    for (auto& address_and_node : function_nodes_) {
-      ret.push_back(&address_and_node.second);
-    }
-    return ret;
-  }
-
  private:
-  uint64_t function_absolute_address_;
-  std::string function_name_;
+  friend class CallTreeBuilder;
+
+  uint64_t function_absolute_address_ = 0;
+  std::string_view function_name_;
+  uint64_t exclusive_sample_count_ = 0;
 };
 
-class [[nodiscard]] TopDownThread : public TopDownInternalNode {
+// A TopDownThread owns the nodes of all the functions below it. When built
+// from a SamplingProfiler, they are in breadth-first order, so the children of
+// each node are also next to each other in memory.
+class [[nodiscard]] TopDownThread : public TopDownNode {
  public:
-  explicit TopDownThread(int32_t thread_id, std::string thread_name,
-                         TopDownNode* parent)
-      : TopDownInternalNode{parent},
-        thread_id_{thread_id},
-        thread_name_{std::move(thread_name)} {}
-
   [[nodiscard]] int32_t thread_id() const { return thread_id_; }
 
   [[nodiscard]] const std::string& thread_name() const { return thread_name_; }
 
-  [[nodiscard]] uint64_t child_count() const override {
+  // The number of function nodes in the subtree of this thread.
+  [[nodiscard]] size_t function_node_count() const {
     return function_nodes_.size();
   }
 
-  [[nodiscard]] std::vector<const TopDownNode*> children() const override {
-    std::vector<const TopDownNode*> ret;
-    for (auto& address_and_node : function_nodes_) {
-      ret.push_back(&address_and_node.second);
-    }
-    return ret;
-  }
-
  private:
-  int32_t thread_id_;
+  friend class CallTreeBuilder;
+
+  int32_t thread_id_ = 0;
   std::string thread_name_;
+  // A deque, as the nodes can't move when more are added.
+  std::deque<TopDownFunction> function_nodes_;
+  // Only filled when callstacks are added to an existing thread.
+  absl::flat_hash_map<std::pair<const TopDownNode*, uint64_t>, TopDownFunction*>
+      function_nodes_by_parent_and_address_;
 };
 
+// The samples of one callstack of one thread, to be added to a view.
+struct CallstackSamples {
+  int32_t thread_id = 0;
+  // The absolute addresses of the functions of the frames, innermost first.
+  std::shared_ptr<const std::vector<uint64_t>> function_addresses;
+  uint64_t sample_count = 0;
+};
+
+// The call tree of the samples of a capture, of which the children of the root
+// are the threads. In a top-down view the children of a function are the
+// functions it calls, in a bottom-up view (see BottomUpView) they are the
+// functions that call it.
 class [[nodiscard]] TopDownView : public TopDownNode {
  public:
-  [[nodiscard]] static std::unique_ptr<TopDownView> CreateFromSamplingProfiler(
-      const SamplingProfiler& sampling_profiler,
+  // The nodes keep views of the names, which hence can't move.
+  using FunctionNames = absl::node_hash_map<uint64_t, std::string>;
+
+  TopDownView() : TopDownView{/*is_bottom_up=*/false} {}
+  TopDownView(const TopDownView&) = delete;
+  TopDownView& operator=(const TopDownView&) = delete;
+
+  [[nodiscard]] bool is_bottom_up() const { return is_bottom_up_; }
+
+  // Adds the samples to the nodes of their threads and to the all-threads
+  // node, e.g., while the capture is still being taken. The cost only depends
+  // on the number and the depth of the callstacks added.
+  void AddCallstackSamples(
+      absl::Span<const CallstackSamples> samples,
       const std::string& process_name,
       const std::unordered_map<int32_t, std::string>& thread_names,
       const std::unordered_map<uint64_t, std::string>& function_names);
 
-  TopDownView() : TopDownNode{nullptr} {}
-
-  [[nodiscard]] TopDownThread* GetThreadOrNull(int32_t thread_id);
+ protected:
+  explicit TopDownView(bool is_bottom_up) : is_bottom_up_{is_bottom_up} {}
 
-  [[nodiscard]] TopDownThread* AddAndGetThread(int32_t thread_id,
-                                               std::string thread_name);
+ private:
+  friend class CallTreeBuilder;
 
-  [[nodiscard]] uint64_t child_count() const override {
-    return thread_nodes_.size();
-  }
+  bool is_bottom_up_;
+  // Shared with the other view built from the same samples.
+  std::shared_ptr<FunctionNames> function_names_;
+  std::vector<std::unique_ptr<TopDownThread>> thread_nodes_;
+  absl::flat_hash_map<int32_t, TopDownThread*> thread_nodes_by_id_;
+};
 
-  [[nodiscard]] std::vector<const TopDownNode*> children() const override {
-    std::vector<const TopDownNode*> ret;
-    for (const auto& tid_and_node : thread_nodes_) {
-      ret.push_back(&tid_and_node.second);
-    }
-    return ret;
-  }
+// The bottom-up view has the same structure as the top-down view, but the
+// children of each thread are the innermost frames of its callstacks, and the
+// children of a function are its callers. The sample count of a child of a
+// thread is the exclusive sample count of the function in that thread.
+class [[nodiscard]] BottomUpView : public TopDownView {
+ public:
+  BottomUpView() : TopDownView{/*is_bottom_up=*/true} {}
+};
 
- private:
-  absl::node_hash_map<int32_t, TopDownThread> thread_nodes_;
+struct TopDownAndBottomUpViews {
+  std::unique_ptr<TopDownView> top_down_view;
+  std::unique_ptr<BottomUpView> bottom_up_view;
 };
 
+// Builds both views in a single pass over the callstack counts of
+// sampling_profiler, the threads in parallel. The two views share the
+// function names, which are copied out of function_names once.
+[[nodiscard]] TopDownAndBottomUpViews CreateTopDownAndBottomUpViews(
+    const SamplingProfiler& sampling_profiler, const std::string& process_name,
+    const std::unordered_map<int32_t, std::string>& thread_names,
+    const std::unordered_map<uint64_t, std::string>& function_names);
+
 #endif  // ORBIT_GL_TOP_DOWN_VIEW_H_
@@ -31,6 +31,8 @@ class Track : public Pickable, public std::enable_shared_from_this<Track> {
     kEventTrack,
     kGraphTrack,
     kGpuTrack,
+    kAsyncTrack,
+    kFrameTrack,
     kSchedulerTrack,
     kUnknown,
   };
@@ -42,6 +44,18 @@ class Track : public Pickable, public std::enable_shared_from_this<Track> {
   void Draw(GlCanvas* a_Canvas, PickingMode a_PickingMode) override;
   virtual void UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
                                 PickingMode picking_mode);
+  // Adds the primitives of what was added to the track since the last update,
+  // while the primitives of that update are kept. Only called when the view
+  // was just scrolled since, and not when picking.
+  virtual void UpdateNewPrimitives(uint64_t /*min_tick*/,
+                                   uint64_t /*max_tick*/) {}
+  // Where UpdatePrimitives adds primitives and text to. Tracks are updated in
+  // parallel, each group of them into its own batcher and text, which are
+  // then appended in the order of the tracks.
+  void SetPrimitivesTarget(Batcher* batcher, TextRecorder* text) {
+    primitives_batcher_ = batcher;
+    primitives_text_ = text;
+  }
   void OnPick(int a_X, int a_Y) override;
   void OnRelease() override;
   void OnDrag(int a_X, int a_Y) override;
@@ -106,4 +120,6 @@ class Track : public Pickable, public std::enable_shared_from_this<Track> {
   Type type_ = kUnknown;
   std::vector<std::shared_ptr<Track>> children_;
   std::shared_ptr<TriangleToggle> collapse_toggle_;
+  Batcher* primitives_batcher_ = nullptr;
+  TextRecorder* primitives_text_ = nullptr;
 };
@@ -0,0 +1,304 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "CaptureSummary.h"
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+
+using orbit_client_protos::CallstackEvent;
+using orbit_client_protos::FunctionStats;
+using orbit_client_protos::LinuxAddressInfo;
+using orbit_client_protos::TimerInfo;
+
+namespace {
+std::string ToJsonString(const std::string& str) {
+  std::string json = "\"";
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      json += '\\';
+      json += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      json += absl::StrFormat("\\u%04x", static_cast<int>(c));
+    } else {
+      json += c;
+    }
+  }
+  json += '"';
+  return json;
+}
+}  // namespace
+
+void CaptureSummary::AddInstrumentedFunction(uint64_t absolute_address,
+                                             std::string name) {
+  functions_[absolute_address].name = std::move(name);
+}
+
+void CaptureSummary::AddQuery(std::string query) {
+  queries_.push_back(std::move(query));
+}
+
+void CaptureSummary::OnTimers(absl::Span<TimerInfo> timers) {
+  for (const TimerInfo& timer : timers) {
+    if (timer.type() != TimerInfo::kNone) {
+      continue;
+    }
+    auto function_it = functions_.find(timer.function_address());
+    if (function_it == functions_.end()) {
+      continue;
+    }
+    if (!queries_.empty()) {
+      timer_table_.Add(timer);
+    }
+    FunctionSummary& function = function_it->second;
+    const uint64_t duration_ns = timer.end() - timer.start();
+    if (function.count == 0 || duration_ns < function.min_duration_ns) {
+      function.min_duration_ns = duration_ns;
+    }
+    function.max_duration_ns = std::max(function.max_duration_ns, duration_ns);
+    ++function.count;
+    function.total_duration_ns += duration_ns;
+    const size_t bucket_index =
+        OrbitBase::LogLinearHistogram::GetBucketIndex(duration_ns);
+    if (function.duration_histogram.size() <= bucket_index) {
+      function.duration_histogram.resize(bucket_index + 1);
+    }
+    ++function.duration_histogram[bucket_index];
+  }
+}
+
+void CaptureSummary::OnCallstack(CallStack callstack) {
+  if (callstack.m_Data.empty()) {
+    return;
+  }
+  innermost_pcs_.try_emplace(callstack.Hash(), callstack.m_Data[0]);
+}
+
+void CaptureSummary::OnCallstackEvent(CallstackEvent callstack_event) {
+  ++sample_counts_by_callstack_hash_[callstack_event.callstack_hash()];
+  ++sample_count_;
+}
+
+void CaptureSummary::OnCallstackSampleCounts(
+    int32_t /*thread_id*/, uint64_t /*begin_timestamp_ns*/,
+    const absl::flat_hash_map<uint64_t, uint32_t>& counts_by_callstack_hash) {
+  for (const auto& [callstack_hash, count] : counts_by_callstack_hash) {
+    sample_counts_by_callstack_hash_[callstack_hash] += count;
+    sample_count_ += count;
+  }
+}
+
+void CaptureSummary::OnAddressInfo(LinuxAddressInfo address_info) {
+  address_names_.insert_or_assign(
+      address_info.absolute_address(),
+      AddressName{std::move(*address_info.mutable_module_name()),
+                  std::move(*address_info.mutable_function_name())});
+}
+
+void CaptureSummary::OnDroppedEvents(uint64_t /*begin_timestamp_ns*/,
+                                     uint64_t /*end_timestamp_ns*/,
+                                     uint64_t dropped_event_count) {
+  dropped_event_count_ += dropped_event_count;
+}
+
+void CaptureSummary::OnFunctionCallStats(uint64_t function_address,
+                                         const FunctionStats& function_stats) {
+  auto function_it = functions_.find(function_address);
+  if (function_it == functions_.end()) {
+    return;
+  }
+  // The stats of all the calls so far, and there are no timers for the
+  // calls of such a function.
+  FunctionSummary& function = function_it->second;
+  function.count = function_stats.count();
+  function.total_duration_ns = function_stats.total_time_ns();
+  function.min_duration_ns = function_stats.min_ns();
+  function.max_duration_ns = function_stats.max_ns();
+  function.duration_histogram.assign(
+      function_stats.duration_histogram().begin(),
+      function_stats.duration_histogram().end());
+}
+
+void CaptureSummary::OnDisabledInstrumentedFunctions(
+    const DisabledInstrumentedFunctions& disabled_instrumented_functions) {
+  for (const auto& disabled_function :
+       disabled_instrumented_functions.functions()) {
+    auto function_it = functions_.find(disabled_function.absolute_address());
+    if (function_it != functions_.end()) {
+      function_it->second.disabled = true;
+    }
+  }
+}
+
+std::vector<CaptureSummary::Hotspot> CaptureSummary::ComputeHotspots() const {
+  absl::flat_hash_map<std::pair<std::string, std::string>, uint64_t>
+      sample_counts_by_name;
+  for (const auto& [callstack_hash, sample_count] :
+       sample_counts_by_callstack_hash_) {
+    auto pc_it = innermost_pcs_.find(callstack_hash);
+    if (pc_it == innermost_pcs_.end()) {
+      continue;
+    }
+    const uint64_t pc = pc_it->second;
+    std::string module_name;
+    std::string function_name;
+    auto name_it = address_names_.find(pc);
+    if (name_it != address_names_.end()) {
+      module_name = name_it->second.module_name;
+      function_name = name_it->second.function_name;
+    }
+    if (function_name.empty()) {
+      function_name = absl::StrFormat("0x%x", pc);
+    }
+    sample_counts_by_name[{std::move(module_name),
+                           std::move(function_name)}] += sample_count;
+  }
+
+  std::vector<Hotspot> hotspots;
+  hotspots.reserve(sample_counts_by_name.size());
+  for (const auto& [name, sample_count] : sample_counts_by_name) {
+    hotspots.push_back(Hotspot{name.first, name.second, sample_count});
+  }
+  std::sort(hotspots.begin(), hotspots.end(),
+            [](const Hotspot& lhs, const Hotspot& rhs) {
+              if (lhs.sample_count != rhs.sample_count) {
+                return lhs.sample_count > rhs.sample_count;
+              }
+              return lhs.function_name < rhs.function_name;
+            });
+  return hotspots;
+}
+
+std::string CaptureSummary::GetFunctionName(uint64_t absolute_address) const {
+  auto function_it = functions_.find(absolute_address);
+  if (function_it == functions_.end()) {
+    return absl::StrFormat("0x%x", absolute_address);
+  }
+  return function_it->second.name;
+}
+
+std::string CaptureSummary::RunQueryToJson(const std::string& query) const {
+  auto find_functions = [this](const std::string& name) {
+    std::vector<uint64_t> addresses;
+    for (const auto& [absolute_address, function] : functions_) {
+      if (function.name == name ||
+          function.name.substr(0, function.name.find('(')) == name) {
+        addresses.push_back(absolute_address);
+      }
+    }
+    return addresses;
+  };
+  ErrorMessageOr<TimerQuery> timer_query =
+      ParseTimerQuery(query, timer_table_.GetMinStartNs(), find_functions);
+  if (timer_query.has_error()) {
+    return absl::StrFormat("    {\"query\": %s, \"error\": %s}",
+                           ToJsonString(query),
+                           ToJsonString(timer_query.error().message()));
+  }
+  const TimerQuery::GroupBy group_by = timer_query.value().group_by;
+  const TimerQueryResult result = timer_table_.Run(timer_query.value());
+
+  std::vector<std::string> group_jsons;
+  for (const TimerQueryResult::Group& group : result.groups) {
+    std::string key;
+    switch (group_by) {
+      case TimerQuery::GroupBy::kNone:
+        key = "all";
+        break;
+      case TimerQuery::GroupBy::kFunction:
+        key = GetFunctionName(group.key);
+        break;
+      case TimerQuery::GroupBy::kCaller:
+        key = group.key == 0 ? "none" : GetFunctionName(group.key);
+        break;
+      case TimerQuery::GroupBy::kThread:
+        key = absl::StrFormat("%d", static_cast<int32_t>(group.key));
+        break;
+      case TimerQuery::GroupBy::kDepth:
+        key = absl::StrFormat("%u", group.key);
+        break;
+    }
+    group_jsons.push_back(absl::StrFormat(
+        "        {\"key\": %s, \"count\": %u, \"total_ns\": %u, "
+        "\"min_ns\": %u, \"max_ns\": %u}",
+        ToJsonString(key), group.count, group.total_ns, group.min_ns,
+        group.max_ns));
+  }
+  // The beginning of the buckets relative to the first call, like the times
+  // of the query.
+  return absl::StrFormat(
+      "    {\"query\": %s, \"match_count\": %u,\n      \"groups\": [\n%s\n"
+      "      ],\n      \"bucket_begin_ns\": %u, \"bucket_width_ns\": %u, "
+      "\"bucket_total_ns\": [%s]}",
+      ToJsonString(query), result.match_count,
+      absl::StrJoin(group_jsons, ",\n"),
+      result.match_count > 0
+          ? result.bucket_begin_ns - timer_table_.GetMinStartNs()
+          : 0,
+      result.bucket_width_ns, absl::StrJoin(result.bucket_total_ns, ", "));
+}
+
+std::string CaptureSummary::ToJson(uint32_t hotspot_count) const {
+  std::vector<const FunctionSummary*> functions;
+  functions.reserve(functions_.size());
+  for (const auto& [absolute_address, function] : functions_) {
+    functions.push_back(&function);
+  }
+  std::sort(functions.begin(), functions.end(),
+            [](const FunctionSummary* lhs, const FunctionSummary* rhs) {
+              return lhs->name < rhs->name;
+            });
+
+  std::vector<std::string> function_jsons;
+  for (const FunctionSummary* function : functions) {
+    auto quantile = [function](double fraction) {
+      std::optional<uint64_t> quantile_ns =
+          OrbitBase::LogLinearHistogram::ComputeQuantile(
+              function->duration_histogram, fraction);
+      return quantile_ns.has_value() ? absl::StrFormat("%u", *quantile_ns)
+                                     : std::string{"null"};
+    };
+    function_jsons.push_back(absl::StrFormat(
+        "    {\"name\": %s, \"count\": %u, \"total_ns\": %u, \"min_ns\": %u, "
+        "\"max_ns\": %u, \"p50_ns\": %s, \"p90_ns\": %s, \"p95_ns\": %s, "
+        "\"p99_ns\": %s, \"disabled\": %s}",
+        ToJsonString(function->name), function->count,
+        function->total_duration_ns, function->min_duration_ns,
+        function->max_duration_ns, quantile(0.5), quantile(0.9),
+        quantile(0.95), quantile(0.99),
+        function->disabled ? "true" : "false"));
+  }
+
+  std::vector<Hotspot> hotspots = ComputeHotspots();
+  if (hotspots.size() > hotspot_count) {
+    hotspots.resize(hotspot_count);
+  }
+  std::vector<std::string> hotspot_jsons;
+  for (const Hotspot& hotspot : hotspots) {
+    hotspot_jsons.push_back(absl::StrFormat(
+        "    {\"function\": %s, \"module\": %s, \"samples\": %u, "
+        "\"fraction\": %.4f}",
+        ToJsonString(hotspot.function_name), ToJsonString(hotspot.module_name),
+        hotspot.sample_count,
+        static_cast<double>(hotspot.sample_count) /
+            static_cast<double>(sample_count_)));
+  }
+
+  std::vector<std::string> query_jsons;
+  for (const std::string& query : queries_) {
+    query_jsons.push_back(RunQueryToJson(query));
+  }
+
+  return absl::StrFormat(
+      "{\n  \"sample_count\": %u,\n  \"dropped_event_count\": %u,\n"
+      "  \"functions\": [\n%s\n  ],\n  \"hotspots\": [\n%s\n  ],\n"
+      "  \"queries\": [\n%s\n  ]\n}\n",
+      sample_count_, dropped_event_count_,
+      absl::StrJoin(function_jsons, ",\n"),
+      absl::StrJoin(hotspot_jsons, ",\n"), absl::StrJoin(query_jsons, ",\n"));
+}
@@ -0,0 +1,122 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_HEADLESS_CAPTURE_CAPTURE_SUMMARY_H_
+#define ORBIT_HEADLESS_CAPTURE_CAPTURE_SUMMARY_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "OrbitBase/LogLinearHistogram.h"
+#include "OrbitCaptureClient/CaptureListener.h"
+#include "TimerTable.h"
+#include "absl/container/flat_hash_map.h"
+
+// A CaptureListener that only keeps the statistics of a capture, not its
+// events: the durations of the calls of each instrumented function, in a
+// OrbitBase::LogLinearHistogram, and the number of samples in each function.
+// Memory is hence bounded by the number of instrumented functions and of
+// distinct callstacks and code addresses, not by the length of the capture,
+// unless queries are added: the calls are then kept in a TimerTable, at
+// about 40 bytes each, to run the queries on in the end.
+//
+// All methods must be called from the same thread, or synchronized.
+class CaptureSummary : public CaptureListener {
+ public:
+  // The instrumented function at each absolute address.
+  void AddInstrumentedFunction(uint64_t absolute_address, std::string name);
+  // A query in the syntax of ParseTimerQuery, with the instrumented functions
+  // by name, and times relative to the first call.
+  void AddQuery(std::string query);
+
+  void OnTimers(absl::Span<orbit_client_protos::TimerInfo> timers) override;
+  void OnKeyAndString(uint64_t /*key*/, std::string /*str*/) override {}
+  void OnCallstack(CallStack callstack) override;
+  void OnCallstackEvent(
+      orbit_client_protos::CallstackEvent callstack_event) override;
+  void OnCallstackSampleCounts(
+      int32_t thread_id, uint64_t begin_timestamp_ns,
+      const absl::flat_hash_map<uint64_t, uint32_t>& counts_by_callstack_hash)
+      override;
+  void OnOffCpuCallstackEvent(
+      orbit_client_protos::CallstackEvent /*callstack_event*/,
+      uint64_t /*off_cpu_duration_ns*/) override {}
+  void OnAllocationEvent(
+      orbit_client_protos::CallstackEvent /*callstack_event*/,
+      uint64_t /*sampled_bytes*/) override {}
+  void OnPageFaultEvent(orbit_client_protos::CallstackEvent /*callstack_event*/,
+                        bool /*major*/) override {}
+  void OnPageFaultStats(const PageFaultStats& /*page_fault_stats*/) override {}
+  void OnThreadName(int32_t /*thread_id*/,
+                    std::string /*thread_name*/) override {}
+  void OnAddressInfo(
+      orbit_client_protos::LinuxAddressInfo address_info) override;
+  void OnDroppedEvents(uint64_t begin_timestamp_ns, uint64_t end_timestamp_ns,
+                       uint64_t dropped_event_count) override;
+  void OnFunctionCallStats(
+      uint64_t function_address,
+      const orbit_client_protos::FunctionStats& function_stats) override;
+  void OnLockContentionStats(
+      uint64_t /*callstack_hash*/,
+      const LockContentionStats& /*lock_contention_stats*/) override {}
+  void OnSchedulingSliceCounters(
+      const SchedulingSliceCounters& /*scheduling_slice_counters*/) override {}
+  void OnThreadWakeup(const ThreadWakeup& /*thread_wakeup*/) override {}
+  void OnCpuPowerEvent(const CpuPowerEvent& /*cpu_power_event*/) override {}
+  void OnModuleMap(const ModuleMap& /*module_map*/) override {}
+  void OnDisabledInstrumentedFunctions(
+      const DisabledInstrumentedFunctions& disabled_instrumented_functions)
+      override;
+
+  // The statistics as a JSON object: the count, total, min, max and
+  // percentiles of the calls of each instrumented function, in nanoseconds,
+  // and the hotspot_count functions with the most samples, innermost frame
+  // only. Followed by the result of each query, or its error.
+  [[nodiscard]] std::string ToJson(uint32_t hotspot_count) const;
+
+ private:
+  struct FunctionSummary {
+    std::string name;
+    uint64_t count = 0;
+    uint64_t total_duration_ns = 0;
+    uint64_t min_duration_ns = 0;
+    uint64_t max_duration_ns = 0;
+    std::vector<uint64_t> duration_histogram;
+    bool disabled = false;
+  };
+
+  struct Hotspot {
+    std::string module_name;
+    std::string function_name;
+    uint64_t sample_count;
+  };
+  [[nodiscard]] std::vector<Hotspot> ComputeHotspots() const;
+  [[nodiscard]] std::string RunQueryToJson(const std::string& query) const;
+  [[nodiscard]] std::string GetFunctionName(uint64_t absolute_address) const;
+
+  // By absolute address.
+  absl::flat_hash_map<uint64_t, FunctionSummary> functions_;
+
+  // The samples and the innermost pc of each callstack, by hash, only
+  // combined in the end, as callstack events can arrive before their
+  // callstack.
+  absl::flat_hash_map<uint64_t, uint64_t> sample_counts_by_callstack_hash_;
+  absl::flat_hash_map<uint64_t, uint64_t> innermost_pcs_;
+  uint64_t sample_count_ = 0;
+
+  struct AddressName {
+    std::string module_name;
+    std::string function_name;
+  };
+  // By absolute address.
+  absl::flat_hash_map<uint64_t, AddressName> address_names_;
+
+  uint64_t dropped_event_count_ = 0;
+
+  std::vector<std::string> queries_;
+  TimerTable timer_table_;
+};
+
+#endif  // ORBIT_HEADLESS_CAPTURE_CAPTURE_SUMMARY_H_
@@ -0,0 +1,347 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Takes a capture of a process without the UI, for instance for automated
+// performance regression runs: the functions are instrumented by name, the
+// capture stops after a duration, and the statistics of the capture are
+// printed as JSON to stdout. The CaptureResponses are written to a file as
+// they are received, if one is given, and the events are not kept, so memory
+// stays bounded however long the capture, except for the calls of the
+// instrumented functions with --query.
+//
+// Usage: OrbitHeadlessCapture --pid=<pid> [flags] [<output>]
+
+#include <absl/flags/flag.h>
+#include <absl/flags/parse.h>
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CaptureSummary.h"
+#include "FunctionUtils.h"
+#include "OrbitBase/Logging.h"
+#include "OrbitCaptureClient/CaptureClient.h"
+#include "OrbitClientServices/ProcessManager.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "grpcpp/grpcpp.h"
+
+ABSL_FLAG(uint16_t, sampling_rate, 1000,
+          "Frequency of callstack sampling in samples per second");
+ABSL_FLAG(bool, frame_pointer_unwinding, false,
+          "Use frame pointers for unwinding");
+ABSL_FLAG(bool, ring_buffer_wakeups, false,
+          "Let the service wait for ring buffers to fill up instead of "
+          "polling them");
+ABSL_FLAG(uint32_t, ring_buffer_reader_threads, 1,
+          "Number of threads of the service reading from the ring buffers");
+ABSL_FLAG(bool, pin_ring_buffer_reader_threads, false,
+          "Pin the threads of the service reading from the ring buffers to "
+          "the CPUs whose ring buffers they read");
+ABSL_FLAG(uint32_t, unwinding_threads, 0,
+          "Number of threads of the service unwinding stack samples, or 0 to "
+          "unwind them while processing them in order");
+ABSL_FLAG(uint32_t, stack_dump_size, 65000,
+          "Number of bytes of the stack copied for each sample with dwarf "
+          "unwinding, at most 65000");
+ABSL_FLAG(bool, adaptive_stack_dump, false,
+          "Only copy the part of the stack of each thread that was needed to "
+          "unwind its previous samples");
+ABSL_FLAG(bool, compress_capture_stream, false,
+          "Compress the capture data sent by the service, for slow "
+          "connections");
+ABSL_FLAG(bool, compact_event_encoding, true,
+          "Delta-encode the timestamps and callstacks sent by the service");
+ABSL_FLAG(bool, client_side_symbolization, false,
+          "Only get the names of the sampled functions from the service for "
+          "the modules without symbols on the client");
+ABSL_FLAG(uint32_t, callstack_sample_counts_interval_ms, 0,
+          "Have the service count the samples by thread and callstack over "
+          "intervals of that many ms instead of sending each of them, for "
+          "the reports only (0 to send them all)");
+ABSL_FLAG(uint64_t, max_buffered_event_bytes, 1024 * 1024 * 1024,
+          "Maximum bytes of capture data buffered by the service (0: no "
+          "limit)");
+ABSL_FLAG(bool, block_when_buffer_full, false,
+          "When max_buffered_event_bytes is reached, block instead of "
+          "dropping samples");
+ABSL_FLAG(bool, join_running_capture, false,
+          "Join the running capture of the process, if any, instead of "
+          "starting one");
+ABSL_FLAG(uint32_t, recorded_argument_count, 0,
+          "Number of integer arguments of each instrumented function to "
+          "record (at most 6)");
+ABSL_FLAG(bool, record_return_values, true,
+          "Record the integer return value of each instrumented function");
+ABSL_FLAG(bool, aggregate_function_calls, false,
+          "Only collect the number and durations of the calls of the "
+          "instrumented functions instead of every call");
+ABSL_FLAG(bool, hybrid_unwinding, false,
+          "Use frame pointers and DWARF-unwind only the innermost frames of "
+          "each sample");
+ABSL_FLAG(bool, lbr_unwinding, false,
+          "Use frame pointers and take the innermost frames of each sample "
+          "from the last branch records of the CPU");
+ABSL_FLAG(bool, kernel_callchains, false,
+          "Also sample the kernel frames, symbolized by the service, of the "
+          "samples taken in the kernel");
+ABSL_FLAG(bool, trace_performance_counters, false,
+          "Count cycles, instructions, cache misses and branch misses in each "
+          "scheduling slice of the target process");
+ABSL_FLAG(std::string, additional_pids, "",
+          "Comma-separated pids of other processes to capture together with "
+          "the selected one");
+ABSL_FLAG(bool, sample_all_processes, false,
+          "Sample all the processes on all cores, not only the target (frame "
+          "pointers only)");
+ABSL_FLAG(bool, auto_ring_buffer_sizes, false,
+          "Start with small ring buffers and grow the ones that lose events "
+          "for the following captures");
+ABSL_FLAG(std::string, ring_buffer_sizes_kb, "",
+          "Comma-separated sizes of the ring buffers per cpu by kind, e.g., "
+          "sampling=4096,uprobes=2048. Kinds: context_switches, uprobes, "
+          "mmap_task, sampling, tracepoints, gpu_tracing, "
+          "sched_switch_counters");
+ABSL_FLAG(bool, capture_statistics, false,
+          "Periodically receive statistics about the service during the "
+          "capture");
+ABSL_FLAG(bool, introspection, false,
+          "Also show the scopes of the threads of the service during the "
+          "capture");
+ABSL_FLAG(bool, manual_instrumentation_shared_memory, false,
+          "Read the scopes of the threads of the target built with "
+          "ORBIT_API_SHARED_MEMORY from shared memory");
+ABSL_FLAG(uint64_t, max_instrumented_function_call_rate, 0,
+          "Disable the instrumented functions called more often than this "
+          "per second at the beginning of the capture (0: no limit)");
+ABSL_FLAG(bool, thread_state, false,
+          "Trace the wakeups of threads, to show when the threads of the "
+          "target were running, runnable or blocked");
+ABSL_FLAG(bool, off_cpu, false,
+          "Record the callstacks of the threads of the target when they block, "
+          "weighted by how long they are off-CPU");
+ABSL_FLAG(bool, lock_contention, false,
+          "Trace the futex waits of the target, for the locks tab and the "
+          "long waits on the thread tracks");
+ABSL_FLAG(bool, allocations, false,
+          "Sample the malloc calls of the target by bytes allocated, for the "
+          "allocations tab and the allocation rate tracks");
+ABSL_FLAG(bool, syscalls, false,
+          "Trace the syscalls of the target, for the long syscalls on the "
+          "thread tracks");
+ABSL_FLAG(std::string, syscall_filter, "",
+          "With --syscalls, only trace the syscalls with these numbers, e.g., "
+          "\"0,1,17\"");
+ABSL_FLAG(bool, block_io, false,
+          "Trace the block I/O requests of the target, for the thread tracks");
+ABSL_FLAG(bool, cpu_power_states, false,
+          "Show the frequency of each core, 0 while idle, next to the "
+          "scheduler track");
+ABSL_FLAG(bool, page_faults, false,
+          "Show the page faults of the target as markers on the thread "
+          "tracks, and its page fault and mmap counts in their tooltips");
+ABSL_FLAG(uint64_t, minor_page_fault_sampling_period, 1000,
+          "With --page_faults, sample one minor page fault out of this many, "
+          "0 to only trace the major ones");
+ABSL_FLAG(bool, vulkan_layer, false,
+          "Show the GPU times of the command buffers and debug labels of a "
+          "target that loaded OrbitVulkanLayer, in the GPU tracks");
+ABSL_FLAG(std::string, capture_triggers, "",
+          "Only receive the events around the moments these triggers fire, "
+          "separated by commas, e.g., Render>20,frame:Frame>33: the calls of "
+          "the instrumented functions of which the name contains Render "
+          "lasting more than 20 ms, and the intervals between the frame "
+          "markers named Frame longer than 33 ms");
+ABSL_FLAG(uint64_t, capture_trigger_window_ms, 1000,
+          "With --capture_triggers, receive the events of this many ms before "
+          "and after a trigger fires");
+ABSL_FLAG(std::string, record_capture_responses, "",
+          "Also write the CaptureResponses received during a capture to this "
+          "file, to replay them with CaptureEventProcessorBenchmark");
+
+ABSL_FLAG(uint16_t, grpc_port, 44765,
+          "The service's GRPC server port (use default value if unsure)");
+ABSL_FLAG(int32_t, pid, 0, "The pid of the process to capture");
+ABSL_FLAG(std::string, functions, "",
+          "Comma-separated names of the functions to instrument, mangled or "
+          "demangled without their parameters");
+ABSL_FLAG(std::string, modules, "",
+          "Only look for the functions in the modules whose path contains one "
+          "of these comma-separated strings, or empty for all modules");
+ABSL_FLAG(double, duration_s, 10, "Duration of the capture in seconds");
+ABSL_FLAG(uint32_t, hotspot_count, 20,
+          "Number of functions with the most samples in the summary");
+ABSL_FLAG(std::string, query, "",
+          "Semicolon-separated queries over the calls of the instrumented "
+          "functions, e.g., \"function=Foo group=caller;buckets=100\", "
+          "with the results in the summary. Keeps the calls in memory");
+
+using orbit_client_protos::FunctionInfo;
+
+namespace {
+bool IsFunctionNamed(const SymbolInfo& symbol_info,
+                     const absl::flat_hash_set<std::string>& names) {
+  if (names.contains(symbol_info.name()) ||
+      names.contains(symbol_info.demangled_name())) {
+    return true;
+  }
+  // The demangled names of functions end with their parameters.
+  const std::string& demangled_name = symbol_info.demangled_name();
+  size_t parameters_begin = demangled_name.find('(');
+  return parameters_begin != std::string::npos &&
+         names.contains(demangled_name.substr(0, parameters_begin));
+}
+
+// Loads the symbols of the modules of the process and returns the functions
+// with these names.
+ErrorMessageOr<std::vector<std::shared_ptr<FunctionInfo>>> FindFunctions(
+    ProcessManager* process_manager, int32_t pid,
+    const absl::flat_hash_set<std::string>& names,
+    const std::vector<std::string>& module_filters) {
+  OUTCOME_TRY(modules, process_manager->LoadModuleList(pid));
+
+  std::vector<std::shared_ptr<FunctionInfo>> functions;
+  for (const ModuleInfo& module : modules) {
+    bool module_matches = module_filters.empty();
+    for (const std::string& module_filter : module_filters) {
+      if (absl::StrContains(module.file_path(), module_filter)) {
+        module_matches = true;
+        break;
+      }
+    }
+    if (!module_matches) {
+      continue;
+    }
+
+    ErrorMessageOr<ModuleSymbols> module_symbols =
+        process_manager->LoadModuleSymbols(module.file_path(),
+                                           module.build_id());
+    if (module_symbols.has_error()) {
+      LOG("No symbols for \"%s\": %s", module.file_path(),
+          module_symbols.error().message());
+      continue;
+    }
+    for (const SymbolInfo& symbol_info :
+         module_symbols.value().symbol_infos()) {
+      if (!IsFunctionNamed(symbol_info, names)) {
+        continue;
+      }
+      functions.push_back(FunctionUtils::CreateFunctionInfo(
+          symbol_info.name(), symbol_info.demangled_name(),
+          symbol_info.address(), module_symbols.value().load_bias(),
+          symbol_info.size(), symbol_info.source_file(),
+          symbol_info.source_line(), module.file_path(),
+          module.address_start()));
+    }
+  }
+  return functions;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<char*> arguments = absl::ParseCommandLine(argc, argv);
+  if (arguments.size() > 2 || absl::GetFlag(FLAGS_pid) == 0) {
+    absl::PrintF("Usage: %s --pid=<pid> [flags] [<output>]\n", argv[0]);
+    return 1;
+  }
+  const int32_t pid = absl::GetFlag(FLAGS_pid);
+  const double duration_s = absl::GetFlag(FLAGS_duration_s);
+  if (duration_s <= 0) {
+    ERROR("Invalid duration %f s", duration_s);
+    return 1;
+  }
+  // The CaptureResponses are written as they are received, in the format of
+  // --record_capture_responses.
+  if (arguments.size() == 2) {
+    absl::SetFlag(&FLAGS_record_capture_responses, arguments[1]);
+  }
+
+  grpc::ChannelArguments channel_arguments;
+  // The symbols of a module can be much larger than the default maximum
+  // message size of 4mb, see OrbitApp::PostInit.
+  channel_arguments.SetMaxReceiveMessageSize(
+      std::numeric_limits<int32_t>::max());
+  const std::string address =
+      absl::StrFormat("127.0.0.1:%d", absl::GetFlag(FLAGS_grpc_port));
+  std::shared_ptr<grpc::Channel> channel = grpc::CreateCustomChannel(
+      address, grpc::InsecureChannelCredentials(), channel_arguments);
+  if (!channel) {
+    ERROR("Unable to create GRPC channel to %s", address);
+    return 1;
+  }
+
+  absl::flat_hash_set<std::string> function_names;
+  for (absl::string_view name : absl::StrSplit(
+           absl::GetFlag(FLAGS_functions), ',', absl::SkipWhitespace())) {
+    function_names.emplace(name);
+  }
+  std::vector<std::string> module_filters = absl::StrSplit(
+      absl::GetFlag(FLAGS_modules), ',', absl::SkipWhitespace());
+
+  std::vector<std::shared_ptr<FunctionInfo>> functions;
+  if (!function_names.empty()) {
+    std::unique_ptr<ProcessManager> process_manager =
+        ProcessManager::Create(channel, absl::Seconds(1));
+    ErrorMessageOr<std::vector<std::shared_ptr<FunctionInfo>>> result =
+        FindFunctions(process_manager.get(), pid, function_names,
+                      module_filters);
+    process_manager->Shutdown();
+    if (result.has_error()) {
+      ERROR("Finding the functions to instrument: %s",
+            result.error().message());
+      return 1;
+    }
+    functions = std::move(result.value());
+  }
+
+  CaptureSummary capture_summary;
+  for (absl::string_view query : absl::StrSplit(
+           absl::GetFlag(FLAGS_query), ';', absl::SkipWhitespace())) {
+    capture_summary.AddQuery(std::string(query));
+  }
+  std::map<uint64_t, FunctionInfo*> selected_functions;
+  absl::flat_hash_set<std::string> found_names;
+  for (const std::shared_ptr<FunctionInfo>& function : functions) {
+    const uint64_t absolute_address =
+        FunctionUtils::GetAbsoluteAddress(*function);
+    selected_functions.emplace(absolute_address, function.get());
+    capture_summary.AddInstrumentedFunction(
+        absolute_address, FunctionUtils::GetDisplayName(*function));
+    found_names.insert(function->name());
+    found_names.insert(function->pretty_name());
+    found_names.insert(
+        function->pretty_name().substr(0, function->pretty_name().find('(')));
+  }
+  for (const std::string& name : function_names) {
+    if (!found_names.contains(name)) {
+      ERROR("Function \"%s\" not found", name);
+    }
+  }
+
+  CaptureClient capture_client{channel, &capture_summary};
+  absl::Notification capture_finished;
+  std::thread capture_thread{[&] {
+    capture_client.Capture(pid, selected_functions);
+    capture_finished.Notify();
+  }};
+  // The capture ends earlier if the service stops it, e.g., on an error.
+  if (!capture_finished.WaitForNotificationWithTimeout(
+          absl::Seconds(duration_s))) {
+    capture_client.StopCapture();
+  }
+  capture_thread.join();
+
+  absl::PrintF("%s",
+               capture_summary.ToJson(absl::GetFlag(FLAGS_hotspot_count)));
+  return 0;
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_ALLOCATION_SAMPLER_H_
+#define ORBIT_LINUX_TRACING_ALLOCATION_SAMPLER_H_
+
+#include <sys/types.h>
+
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <random>
+
+#include "absl/container/flat_hash_map.h"
+
+namespace LinuxTracing {
+
+// Samples allocations by bytes allocated, as the heap profiler of tcmalloc:
+// each byte is sampled with probability 1 / sampling_interval_bytes, hence the
+// distance between two sampled bytes of a thread follows an exponential
+// distribution, which is drawn once per sample rather than per allocation.
+// An allocation is sampled when it contains a sampled byte, so that large
+// allocations are more likely to be, and its sampled bytes are the unbiased
+// estimate of the bytes allocated it stands for.
+class AllocationSampler {
+ public:
+  explicit AllocationSampler(uint64_t sampling_interval_bytes,
+                             uint64_t seed = std::random_device{}())
+      : sampling_interval_bytes_{sampling_interval_bytes},
+        bytes_until_sample_distribution_{
+            1.0 / static_cast<double>(sampling_interval_bytes)},
+        random_engine_{seed} {}
+
+  // The sampled bytes if the allocation is sampled.
+  std::optional<uint64_t> ProcessAllocation(pid_t tid, uint64_t size) {
+    auto [bytes_until_sample_it, inserted] =
+        bytes_until_sample_per_tid_.try_emplace(tid, 0);
+    int64_t& bytes_until_sample = bytes_until_sample_it->second;
+    if (inserted) {
+      bytes_until_sample = DrawBytesUntilSample();
+    }
+    bytes_until_sample -= static_cast<int64_t>(size);
+    if (bytes_until_sample > 0) {
+      return std::nullopt;
+    }
+    // The distribution is memoryless: the next sampled byte is drawn from the
+    // end of this allocation.
+    bytes_until_sample = DrawBytesUntilSample();
+    return GetSampledBytes(size);
+  }
+
+  // size / P(an allocation of size bytes is sampled).
+  [[nodiscard]] uint64_t GetSampledBytes(uint64_t size) const {
+    if (size == 0) {
+      return 0;
+    }
+    const double probability = -std::expm1(
+        -static_cast<double>(size) / sampling_interval_bytes_);
+    return static_cast<uint64_t>(std::llround(size / probability));
+  }
+
+ private:
+  int64_t DrawBytesUntilSample() {
+    return static_cast<int64_t>(
+               bytes_until_sample_distribution_(random_engine_)) +
+           1;
+  }
+
+  uint64_t sampling_interval_bytes_;
+  std::exponential_distribution<double> bytes_until_sample_distribution_;
+  std::mt19937_64 random_engine_;
+  absl::flat_hash_map<pid_t, int64_t> bytes_until_sample_per_tid_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_ALLOCATION_SAMPLER_H_
@@ -0,0 +1,44 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "AllocationSampler.h"
+
+namespace LinuxTracing {
+
+TEST(AllocationSampler, EstimatesTheBytesAllocated) {
+  constexpr uint64_t kSamplingIntervalBytes = 4096;
+  AllocationSampler sampler{kSamplingIntervalBytes, /*seed=*/42};
+  constexpr uint64_t kAllocationCount = 1'000'000;
+  constexpr uint64_t kSize = 64;
+  uint64_t sample_count = 0;
+  uint64_t sampled_bytes = 0;
+  for (uint64_t i = 0; i < kAllocationCount; ++i) {
+    std::optional<uint64_t> bytes = sampler.ProcessAllocation(1, kSize);
+    if (bytes.has_value()) {
+      ++sample_count;
+      sampled_bytes += bytes.value();
+    }
+  }
+
+  const double allocated_bytes = kAllocationCount * kSize;
+  EXPECT_NEAR(sample_count, allocated_bytes / kSamplingIntervalBytes,
+              0.05 * allocated_bytes / kSamplingIntervalBytes);
+  EXPECT_NEAR(sampled_bytes, allocated_bytes, 0.05 * allocated_bytes);
+}
+
+TEST(AllocationSampler, SamplesLargeAllocationsAlmostAlways) {
+  AllocationSampler sampler{4096, /*seed=*/42};
+  for (pid_t tid = 1; tid <= 100; ++tid) {
+    std::optional<uint64_t> bytes = sampler.ProcessAllocation(tid, 1 << 20);
+    ASSERT_TRUE(bytes.has_value());
+    EXPECT_EQ(bytes.value(), 1 << 20);
+  }
+  EXPECT_EQ(sampler.GetSampledBytes(0), 0);
+  // Sampled with probability 1 - e^-1.
+  EXPECT_EQ(sampler.GetSampledBytes(4096), 6480);
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,102 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_ASYNC_SPAN_MANAGER_H_
+#define ORBIT_LINUX_TRACING_ASYNC_SPAN_MANAGER_H_
+
+#include <OrbitBase/Logging.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+
+namespace LinuxTracing {
+
+// Matches the ORBIT_START_ASYNC and ORBIT_STOP_ASYNC of a process by their id,
+// which can be on different threads. At most max_open_span_count spans are
+// open at a time: when a span starts while the table is full, the span that
+// started first is forgotten, and so is a span whose start is followed by
+// another start with the same id.
+class AsyncSpanManager {
+ public:
+  struct AsyncSpan {
+    pid_t pid;
+    pid_t begin_tid;
+    pid_t end_tid;
+    uint64_t begin_timestamp_ns;
+    uint64_t end_timestamp_ns;
+    uint64_t name_address;
+    uint64_t id;
+  };
+
+  explicit AsyncSpanManager(
+      size_t max_open_span_count = DEFAULT_MAX_OPEN_SPAN_COUNT)
+      : max_open_span_count_{max_open_span_count} {
+    CHECK(max_open_span_count_ > 0);
+  }
+
+  void ProcessStart(pid_t pid, pid_t tid, uint64_t timestamp_ns,
+                    uint64_t name_address, uint64_t id) {
+    auto open_span_it = open_spans_by_key_.find(std::make_pair(pid, id));
+    if (open_span_it != open_spans_by_key_.end()) {
+      open_spans_.erase(open_span_it->second);
+      open_spans_by_key_.erase(open_span_it);
+      ++forgotten_span_count_;
+    } else if (open_spans_.size() == max_open_span_count_) {
+      const OpenSpan& oldest = open_spans_.front();
+      open_spans_by_key_.erase(std::make_pair(oldest.pid, oldest.id));
+      open_spans_.pop_front();
+      ++forgotten_span_count_;
+    }
+    open_spans_.push_back(OpenSpan{pid, tid, timestamp_ns, name_address, id});
+    open_spans_by_key_.emplace(std::make_pair(pid, id),
+                               std::prev(open_spans_.end()));
+  }
+
+  // Returns the span, unless no span with this id is open.
+  std::optional<AsyncSpan> ProcessStop(pid_t pid, pid_t tid,
+                                       uint64_t timestamp_ns, uint64_t id) {
+    auto open_span_it = open_spans_by_key_.find(std::make_pair(pid, id));
+    if (open_span_it == open_spans_by_key_.end()) {
+      return std::nullopt;
+    }
+    const OpenSpan& open_span = *open_span_it->second;
+    AsyncSpan span{pid, open_span.tid, tid, open_span.timestamp_ns,
+                   timestamp_ns, open_span.name_address, id};
+    open_spans_.erase(open_span_it->second);
+    open_spans_by_key_.erase(open_span_it);
+    return span;
+  }
+
+  [[nodiscard]] size_t GetOpenSpanCount() const { return open_spans_.size(); }
+  [[nodiscard]] uint64_t GetForgottenSpanCount() const {
+    return forgotten_span_count_;
+  }
+
+  static constexpr size_t DEFAULT_MAX_OPEN_SPAN_COUNT = 64 * 1024;
+
+ private:
+  struct OpenSpan {
+    pid_t pid;
+    pid_t tid;
+    uint64_t timestamp_ns;
+    uint64_t name_address;
+    uint64_t id;
+  };
+
+  size_t max_open_span_count_;
+  // Oldest first, for eviction.
+  std::list<OpenSpan> open_spans_;
+  absl::flat_hash_map<std::pair<pid_t, uint64_t>, std::list<OpenSpan>::iterator>
+      open_spans_by_key_;
+  uint64_t forgotten_span_count_ = 0;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_ASYNC_SPAN_MANAGER_H_
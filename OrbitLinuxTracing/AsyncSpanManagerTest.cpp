@@ -0,0 +1,81 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "AsyncSpanManager.h"
+
+namespace LinuxTracing {
+
+TEST(AsyncSpanManager, MatchesStartAndStopAcrossThreads) {
+  AsyncSpanManager manager;
+  manager.ProcessStart(10, 11, 100, 0x1000, 1);
+  manager.ProcessStart(10, 12, 150, 0x2000, 2);
+  EXPECT_EQ(manager.GetOpenSpanCount(), 2);
+
+  std::optional<AsyncSpanManager::AsyncSpan> span =
+      manager.ProcessStop(10, 13, 200, 1);
+  ASSERT_TRUE(span.has_value());
+  EXPECT_EQ(span->pid, 10);
+  EXPECT_EQ(span->begin_tid, 11);
+  EXPECT_EQ(span->end_tid, 13);
+  EXPECT_EQ(span->begin_timestamp_ns, 100);
+  EXPECT_EQ(span->end_timestamp_ns, 200);
+  EXPECT_EQ(span->name_address, 0x1000);
+  EXPECT_EQ(span->id, 1);
+
+  EXPECT_FALSE(manager.ProcessStop(10, 13, 250, 1).has_value());
+  span = manager.ProcessStop(10, 11, 300, 2);
+  ASSERT_TRUE(span.has_value());
+  EXPECT_EQ(span->name_address, 0x2000);
+  EXPECT_EQ(manager.GetOpenSpanCount(), 0);
+  EXPECT_EQ(manager.GetForgottenSpanCount(), 0);
+}
+
+TEST(AsyncSpanManager, KeepsIdsOfProcessesApart) {
+  AsyncSpanManager manager;
+  manager.ProcessStart(10, 10, 100, 0x1000, 1);
+  EXPECT_FALSE(manager.ProcessStop(20, 20, 200, 1).has_value());
+  manager.ProcessStart(20, 20, 300, 0x2000, 1);
+
+  std::optional<AsyncSpanManager::AsyncSpan> span =
+      manager.ProcessStop(20, 20, 400, 1);
+  ASSERT_TRUE(span.has_value());
+  EXPECT_EQ(span->begin_timestamp_ns, 300);
+  span = manager.ProcessStop(10, 10, 500, 1);
+  ASSERT_TRUE(span.has_value());
+  EXPECT_EQ(span->begin_timestamp_ns, 100);
+}
+
+TEST(AsyncSpanManager, RestartForgetsTheOpenSpan) {
+  AsyncSpanManager manager;
+  manager.ProcessStart(10, 10, 100, 0x1000, 1);
+  manager.ProcessStart(10, 10, 200, 0x2000, 1);
+  EXPECT_EQ(manager.GetOpenSpanCount(), 1);
+  EXPECT_EQ(manager.GetForgottenSpanCount(), 1);
+
+  std::optional<AsyncSpanManager::AsyncSpan> span =
+      manager.ProcessStop(10, 10, 300, 1);
+  ASSERT_TRUE(span.has_value());
+  EXPECT_EQ(span->begin_timestamp_ns, 200);
+  EXPECT_EQ(span->name_address, 0x2000);
+}
+
+TEST(AsyncSpanManager, FullTableForgetsTheOldestSpan) {
+  AsyncSpanManager manager{2};
+  manager.ProcessStart(10, 10, 100, 0x1000, 1);
+  manager.ProcessStart(10, 10, 200, 0x1000, 2);
+  // The oldest span left is 1 once 2 stopped, as 3 started.
+  EXPECT_TRUE(manager.ProcessStop(10, 10, 250, 2).has_value());
+  manager.ProcessStart(10, 10, 300, 0x1000, 3);
+  manager.ProcessStart(10, 10, 400, 0x1000, 4);
+  EXPECT_EQ(manager.GetOpenSpanCount(), 2);
+  EXPECT_EQ(manager.GetForgottenSpanCount(), 1);
+
+  EXPECT_FALSE(manager.ProcessStop(10, 10, 500, 1).has_value());
+  EXPECT_TRUE(manager.ProcessStop(10, 10, 500, 3).has_value());
+  EXPECT_TRUE(manager.ProcessStop(10, 10, 500, 4).has_value());
+}
+
+}  // namespace LinuxTracing
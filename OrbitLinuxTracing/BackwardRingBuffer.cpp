@@ -0,0 +1,84 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "BackwardRingBuffer.h"
+
+#include <OrbitBase/Logging.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+#include "PerfEventRecords.h"
+
+namespace LinuxTracing {
+
+uint64_t GetRecordTimestampNs(const perf_event_header& header,
+                              const char* record) {
+  // PERF_RECORD_SAMPLE starts with the fields selected by sample_type, while
+  // the other records end with them.
+  uint64_t time_offset;
+  if (header.type == PERF_RECORD_SAMPLE) {
+    time_offset = sizeof(perf_event_header) + 2 * sizeof(uint32_t);
+  } else {
+    time_offset = header.size -
+                  sizeof(perf_event_sample_id_tid_time_streamid_cpu) +
+                  offsetof(perf_event_sample_id_tid_time_streamid_cpu, time);
+  }
+  uint64_t timestamp_ns;
+  memcpy(&timestamp_ns, record + time_offset, sizeof(timestamp_ns));
+  return timestamp_ns;
+}
+
+std::vector<char> LinearizeBackwardRingBuffer(const char* ring_buffer,
+                                              uint64_t ring_buffer_size,
+                                              uint64_t head,
+                                              uint64_t min_timestamp_ns) {
+  CHECK(__builtin_popcountl(ring_buffer_size) == 1);
+
+  // data_head starts at zero and decreases, so -head bytes have been written.
+  const uint64_t written_size = std::min(ring_buffer_size, -head);
+  const uint64_t head_mod_size = head & (ring_buffer_size - 1);
+  std::vector<char> newest_first(written_size);
+  const uint64_t first_copy_size =
+      std::min(written_size, ring_buffer_size - head_mod_size);
+  memcpy(newest_first.data(), ring_buffer + head_mod_size, first_copy_size);
+  memcpy(newest_first.data() + first_copy_size, ring_buffer,
+         written_size - first_copy_size);
+
+  // Every record contains the fields selected by sample_type, which include
+  // the timestamp.
+  constexpr uint64_t kMinRecordSize =
+      sizeof(perf_event_header) +
+      sizeof(perf_event_sample_id_tid_time_streamid_cpu);
+  std::vector<std::pair<uint64_t, uint16_t>> records;
+  uint64_t offset = 0;
+  uint64_t kept_size = 0;
+  while (offset + sizeof(perf_event_header) <= written_size) {
+    perf_event_header header;
+    memcpy(&header, newest_first.data() + offset, sizeof(header));
+    if (header.size < kMinRecordSize || offset + header.size > written_size) {
+      break;
+    }
+    const char* record = newest_first.data() + offset;
+    if (GetRecordTimestampNs(header, record) < min_timestamp_ns) {
+      break;
+    }
+    records.emplace_back(offset, header.size);
+    kept_size += header.size;
+    offset += header.size;
+  }
+
+  std::vector<char> oldest_first;
+  oldest_first.reserve(kept_size);
+  for (auto record_it = records.rbegin(); record_it != records.rend();
+       ++record_it) {
+    const char* record = newest_first.data() + record_it->first;
+    oldest_first.insert(oldest_first.end(), record, record + record_it->second);
+  }
+  return oldest_first;
+}
+
+}  // namespace LinuxTracing
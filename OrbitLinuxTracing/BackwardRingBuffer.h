@@ -0,0 +1,37 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_BACKWARD_RING_BUFFER_H_
+#define ORBIT_LINUX_TRACING_BACKWARD_RING_BUFFER_H_
+
+#include <linux/perf_event.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace LinuxTracing {
+
+// Returns the timestamp of a record of an event opened with
+// SAMPLE_TYPE_TID_TIME_STREAMID_CPU and sample_id_all, whose header.size bytes
+// (including the header) are in record.
+uint64_t GetRecordTimestampNs(const perf_event_header& header,
+                              const char* record);
+
+// Extracts the records from a ring buffer written by events opened with
+// write_backward and mmapped without PROT_WRITE, i.e., in overwrite mode. The
+// kernel writes such a ring buffer downwards from data_head, which is head,
+// overwriting the oldest records when it wraps around, so that the records
+// following head are the most recent ones.
+// ring_buffer_size has to be a power of two. Only the records with a timestamp
+// not lower than min_timestamp_ns are returned, oldest first and one after the
+// other, as they would be in a ring buffer written forward. The record that was
+// partially overwritten, if any, is ignored.
+std::vector<char> LinearizeBackwardRingBuffer(const char* ring_buffer,
+                                              uint64_t ring_buffer_size,
+                                              uint64_t head,
+                                              uint64_t min_timestamp_ns);
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_BACKWARD_RING_BUFFER_H_
@@ -0,0 +1,107 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "BackwardRingBuffer.h"
+#include "PerfEventRecords.h"
+
+namespace LinuxTracing {
+
+namespace {
+
+constexpr uint64_t kRingBufferSize = 256;
+
+// Writes records like the kernel does for events opened with write_backward.
+class FakeBackwardRingBuffer {
+ public:
+  void WriteContextSwitch(uint64_t timestamp_ns) {
+    perf_event_context_switch_cpu_wide record{};
+    record.header.type = PERF_RECORD_SWITCH_CPU_WIDE;
+    record.header.size = sizeof(record);
+    record.sample_id.time = timestamp_ns;
+    Write(&record, sizeof(record));
+  }
+
+  void WriteSample(uint64_t timestamp_ns) {
+    perf_event_empty_sample record{};
+    record.header.type = PERF_RECORD_SAMPLE;
+    record.header.size = sizeof(record);
+    record.sample_id.time = timestamp_ns;
+    Write(&record, sizeof(record));
+  }
+
+  [[nodiscard]] std::vector<char> Linearize(uint64_t min_timestamp_ns) const {
+    return LinearizeBackwardRingBuffer(data_.data(), kRingBufferSize, head_,
+                                       min_timestamp_ns);
+  }
+
+ private:
+  void Write(const void* record, uint64_t size) {
+    head_ -= size;
+    for (uint64_t i = 0; i < size; ++i) {
+      data_[(head_ + i) % kRingBufferSize] =
+          static_cast<const char*>(record)[i];
+    }
+  }
+
+  std::vector<char> data_ = std::vector<char>(kRingBufferSize);
+  uint64_t head_ = 0;
+};
+
+std::vector<uint64_t> GetTimestamps(const std::vector<char>& records) {
+  std::vector<uint64_t> timestamps;
+  uint64_t offset = 0;
+  while (offset < records.size()) {
+    perf_event_header header;
+    memcpy(&header, records.data() + offset, sizeof(header));
+    timestamps.push_back(GetRecordTimestampNs(header, records.data() + offset));
+    offset += header.size;
+  }
+  EXPECT_EQ(offset, records.size());
+  return timestamps;
+}
+
+}  // namespace
+
+TEST(BackwardRingBuffer, Empty) {
+  FakeBackwardRingBuffer ring_buffer;
+  EXPECT_TRUE(ring_buffer.Linearize(0).empty());
+}
+
+TEST(BackwardRingBuffer, ReturnsRecordsOldestFirst) {
+  FakeBackwardRingBuffer ring_buffer;
+  ring_buffer.WriteContextSwitch(100);
+  ring_buffer.WriteSample(200);
+  ring_buffer.WriteContextSwitch(300);
+  EXPECT_EQ(GetTimestamps(ring_buffer.Linearize(0)),
+            (std::vector<uint64_t>{100, 200, 300}));
+}
+
+TEST(BackwardRingBuffer, IgnoresOverwrittenRecords) {
+  FakeBackwardRingBuffer ring_buffer;
+  // 48 bytes each, so that the oldest record kept is partially overwritten.
+  static_assert(sizeof(perf_event_context_switch_cpu_wide) == 48);
+  for (uint64_t timestamp_ns = 1; timestamp_ns <= 10; ++timestamp_ns) {
+    ring_buffer.WriteContextSwitch(timestamp_ns);
+  }
+  EXPECT_EQ(GetTimestamps(ring_buffer.Linearize(0)),
+            (std::vector<uint64_t>{6, 7, 8, 9, 10}));
+}
+
+TEST(BackwardRingBuffer, KeepsOnlyRecentRecords) {
+  FakeBackwardRingBuffer ring_buffer;
+  ring_buffer.WriteContextSwitch(100);
+  ring_buffer.WriteSample(200);
+  ring_buffer.WriteContextSwitch(300);
+  EXPECT_EQ(GetTimestamps(ring_buffer.Linearize(200)),
+            (std::vector<uint64_t>{200, 300}));
+  EXPECT_TRUE(ring_buffer.Linearize(301).empty());
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,75 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_BATCH_QUEUE_H_
+#define ORBIT_LINUX_TRACING_BATCH_QUEUE_H_
+
+#include <OrbitBase/Logging.h>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace LinuxTracing {
+
+// BatchQueue passes values from several producer threads to a single consumer,
+// which takes all the queued values at once. The values of each producer keep
+// their order.
+// Push blocks while the queue holds capacity values, so that a consumer that
+// can't keep up slows the producers down instead of the queue growing without
+// bounds. PopAll blocks until there are values, the queue is closed, or a
+// timeout expires, so that the consumer neither polls nor delays the values.
+template <typename T>
+class BatchQueue {
+ public:
+  explicit BatchQueue(size_t capacity) : capacity_{capacity} {
+    CHECK(capacity_ > 0);
+  }
+
+  BatchQueue(const BatchQueue&) = delete;
+  BatchQueue& operator=(const BatchQueue&) = delete;
+  BatchQueue(BatchQueue&&) = delete;
+  BatchQueue& operator=(BatchQueue&&) = delete;
+
+  void Push(T value) {
+    absl::MutexLock lock{&mutex_};
+    CHECK(!closed_);
+    mutex_.Await(absl::Condition(this, &BatchQueue::HasRoom));
+    values_.emplace_back(std::move(value));
+  }
+
+  // Signals that no more values will be pushed.
+  void Close() {
+    absl::MutexLock lock{&mutex_};
+    closed_ = true;
+  }
+
+  // Replaces *values with the queued values, waiting up to timeout for some.
+  // Returns false once the queue is closed and all its values have been
+  // returned, i.e., when there is nothing left to wait for.
+  bool PopAll(std::vector<T>* values, absl::Duration timeout) {
+    absl::MutexLock lock{&mutex_};
+    mutex_.AwaitWithTimeout(absl::Condition(this, &BatchQueue::CanPop),
+                            timeout);
+    values->clear();
+    std::swap(*values, values_);
+    return !closed_;
+  }
+
+ private:
+  [[nodiscard]] bool HasRoom() const { return values_.size() < capacity_; }
+  [[nodiscard]] bool CanPop() const { return !values_.empty() || closed_; }
+
+  const size_t capacity_;
+  absl::Mutex mutex_;
+  std::vector<T> values_;
+  bool closed_ = false;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_BATCH_QUEUE_H_
@@ -0,0 +1,72 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "BatchQueue.h"
+
+namespace LinuxTracing {
+
+TEST(BatchQueue, PopsAllValuesInOrder) {
+  BatchQueue<int> queue{10};
+  queue.Push(1);
+  queue.Push(2);
+  queue.Push(3);
+  std::vector<int> values{42};
+  EXPECT_TRUE(queue.PopAll(&values, absl::ZeroDuration()));
+  EXPECT_EQ(values, (std::vector<int>{1, 2, 3}));
+
+  EXPECT_TRUE(queue.PopAll(&values, absl::Milliseconds(1)));
+  EXPECT_TRUE(values.empty());
+}
+
+TEST(BatchQueue, PopAllReturnsFalseOnceClosed) {
+  BatchQueue<int> queue{10};
+  queue.Push(1);
+  queue.Close();
+  std::vector<int> values;
+  EXPECT_FALSE(queue.PopAll(&values, absl::InfiniteDuration()));
+  EXPECT_EQ(values, (std::vector<int>{1}));
+  EXPECT_FALSE(queue.PopAll(&values, absl::InfiniteDuration()));
+  EXPECT_TRUE(values.empty());
+}
+
+TEST(BatchQueue, PopAllWaitsForValues) {
+  BatchQueue<int> queue{10};
+  std::thread producer{[&queue] {
+    absl::SleepFor(absl::Milliseconds(10));
+    queue.Push(1);
+  }};
+  std::vector<int> values;
+  EXPECT_TRUE(queue.PopAll(&values, absl::InfiniteDuration()));
+  EXPECT_EQ(values, (std::vector<int>{1}));
+  producer.join();
+}
+
+TEST(BatchQueue, PushBlocksWhileFull) {
+  BatchQueue<int> queue{2};
+  queue.Push(1);
+  queue.Push(2);
+  std::atomic<bool> pushed = false;
+  std::thread producer{[&queue, &pushed] {
+    queue.Push(3);
+    pushed = true;
+  }};
+  absl::SleepFor(absl::Milliseconds(10));
+  EXPECT_FALSE(pushed);
+
+  std::vector<int> values;
+  EXPECT_TRUE(queue.PopAll(&values, absl::ZeroDuration()));
+  EXPECT_EQ(values, (std::vector<int>{1, 2}));
+  producer.join();
+  EXPECT_TRUE(pushed);
+  EXPECT_TRUE(queue.PopAll(&values, absl::ZeroDuration()));
+  EXPECT_EQ(values, (std::vector<int>{3}));
+}
+
+}  // namespace LinuxTracing
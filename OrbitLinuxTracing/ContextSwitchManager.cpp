@@ -9,28 +9,32 @@ namespace LinuxTracing {
 void ContextSwitchManager::ProcessContextSwitchIn(pid_t pid, pid_t tid,
                                                   uint16_t core,
                                                   uint64_t timestamp_ns) {
+  if (core >= open_switches_by_core_.size()) {
+    open_switches_by_core_.resize(core + 1);
+  }
   // In case of lost out switches, a previous OpenSwitchIn for this core can
   // be present. Simply overwrite it.
-  open_switches_by_core_.emplace(core, OpenSwitchIn{pid, tid, timestamp_ns});
+  open_switches_by_core_[core].emplace(pid, tid, timestamp_ns);
 }
 
 std::optional<SchedulingSlice> ContextSwitchManager::ProcessContextSwitchOut(
     pid_t pid, pid_t tid, uint16_t core, uint64_t timestamp_ns) {
-  auto open_switch_it = open_switches_by_core_.find(core);
   // This can happen at the beginning or in case of lost in switches.
-  if (open_switch_it == open_switches_by_core_.end()) {
+  if (core >= open_switches_by_core_.size() ||
+      !open_switches_by_core_[core].has_value()) {
     return std::nullopt;
   }
 
-  pid_t open_pid = open_switch_it->second.pid;
-  pid_t open_tid = open_switch_it->second.tid;
-  uint64_t open_timestamp_ns = open_switch_it->second.timestamp_ns;
+  std::optional<OpenSwitchIn>& open_switch = open_switches_by_core_[core];
+  pid_t open_pid = open_switch->pid;
+  pid_t open_tid = open_switch->tid;
+  uint64_t open_timestamp_ns = open_switch->timestamp_ns;
 
   CHECK(timestamp_ns >= open_timestamp_ns);
 
   // Remove the OpenSwitchIn for this core before returning,
   // as it will have been processed.
-  open_switches_by_core_.erase(core);
+  open_switch.reset();
 
   // When a context switch out is caused by a thread exiting, the
   // perf_event_open event has pid and tid set to -1:
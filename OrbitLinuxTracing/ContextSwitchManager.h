@@ -7,7 +7,9 @@
 
 #include <OrbitBase/Logging.h>
 
-#include "absl/container/flat_hash_map.h"
+#include <optional>
+#include <vector>
+
 #include "capture.pb.h"
 
 namespace LinuxTracing {
@@ -15,6 +17,9 @@ namespace LinuxTracing {
 // For each core, keeps the last context switch into a process and matches it
 // with the next context switch away from a process to produce SchedulingSlice
 // events. It assumes that context switches for the same core come in order.
+// The state of each core is in a dense array indexed by core. Calls for
+// different cores lower than the core_count passed to Reset don't share any
+// state, hence they can be made concurrently without synchronization.
 class ContextSwitchManager {
  public:
   ContextSwitchManager() = default;
@@ -32,7 +37,9 @@ class ContextSwitchManager {
                                                          uint16_t core,
                                                          uint64_t timestamp_ns);
 
-  void Clear() { open_switches_by_core_.clear(); }
+  void Reset(size_t core_count) {
+    open_switches_by_core_.assign(core_count, std::nullopt);
+  }
 
  private:
   struct OpenSwitchIn {
@@ -43,7 +50,7 @@ class ContextSwitchManager {
     uint64_t timestamp_ns;
   };
 
-  absl::flat_hash_map<uint16_t, OpenSwitchIn> open_switches_by_core_;
+  std::vector<std::optional<OpenSwitchIn>> open_switches_by_core_;
 };
 
 }  // namespace LinuxTracing
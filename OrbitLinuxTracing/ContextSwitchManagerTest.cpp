@@ -175,6 +175,27 @@ TEST(ContextSwitchManager, TwoCoresOutOnDifferentCore) {
       context_switch_manager.ProcessContextSwitchOut(kPid, kTid, 2, 101);
 }
 
+TEST(ContextSwitchManager, OneCoreLostOutOverwritesIn) {
+  constexpr pid_t kPid = 42;
+  constexpr pid_t kTid = 43;
+  constexpr pid_t kTid2 = 44;
+  constexpr uint16_t kCore = 1;
+  std::optional<SchedulingSlice> processed_scheduling_slice;
+  ContextSwitchManager context_switch_manager;
+  context_switch_manager.Reset(4);
+
+  context_switch_manager.ProcessContextSwitchIn(kPid, kTid, kCore, 100);
+  // The switch out of kTid was lost.
+  context_switch_manager.ProcessContextSwitchIn(kPid, kTid2, kCore, 102);
+
+  processed_scheduling_slice =
+      context_switch_manager.ProcessContextSwitchOut(kPid, kTid2, kCore, 103);
+  ASSERT_TRUE(processed_scheduling_slice.has_value());
+  EXPECT_EQ(processed_scheduling_slice.value().tid(), kTid2);
+  EXPECT_EQ(processed_scheduling_slice.value().in_timestamp_ns(), 102);
+  EXPECT_EQ(processed_scheduling_slice.value().out_timestamp_ns(), 103);
+}
+
 TEST(ContextSwitchManager, OneCoreOutOfOrder) {
   constexpr pid_t kPid = 42;
   constexpr pid_t kTid = 43;
@@ -0,0 +1,45 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "CpuBudgetGovernor.h"
+
+namespace LinuxTracing {
+
+CpuBudgetGovernor::CpuBudgetGovernor(double max_cpu_usage, bool samples,
+                                     bool unwinds_with_dwarf,
+                                     bool has_instrumented_functions)
+    : max_cpu_usage_{max_cpu_usage},
+      samples_{samples},
+      unwinds_with_dwarf_{samples && unwinds_with_dwarf},
+      has_instrumented_functions_{has_instrumented_functions} {}
+
+CpuBudgetGovernor::Step CpuBudgetGovernor::OnWindow(
+    uint64_t window_duration_ns, uint64_t cpu_time_ns) {
+  if (window_duration_ns == 0) {
+    return Step::kNone;
+  }
+  last_cpu_usage_ = static_cast<double>(cpu_time_ns) / window_duration_ns;
+  if (skip_next_window_) {
+    skip_next_window_ = false;
+    return Step::kNone;
+  }
+  if (last_cpu_usage_ <= max_cpu_usage_) {
+    return Step::kNone;
+  }
+
+  Step step = Step::kNone;
+  if (samples_ && sampling_rate_halving_count_ < MAX_SAMPLING_RATE_HALVINGS) {
+    ++sampling_rate_halving_count_;
+    step = Step::kHalveSamplingRate;
+  } else if (unwinds_with_dwarf_) {
+    unwinds_with_dwarf_ = false;
+    step = Step::kFramePointerUnwinding;
+  } else if (has_instrumented_functions_) {
+    step = Step::kDisableHotFunctions;
+  }
+  skip_next_window_ = step != Step::kNone;
+  return step;
+}
+
+}  // namespace LinuxTracing
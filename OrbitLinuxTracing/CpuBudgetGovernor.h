@@ -0,0 +1,60 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_CPU_BUDGET_GOVERNOR_H_
+#define ORBIT_LINUX_TRACING_CPU_BUDGET_GOVERNOR_H_
+
+#include <cstdint>
+
+namespace LinuxTracing {
+
+// CpuBudgetGovernor keeps the CPU usage of the service within a fraction of
+// one core, as measured over successive windows, by deciding which fidelity
+// the capture gives up next when a window exceeds it: first the sampling rate
+// is halved, up to MAX_SAMPLING_RATE_HALVINGS times, then the stacks are
+// unwound with frame pointers instead of DWARF, then the hottest instrumented
+// functions are disabled, window after window. The steps that don't apply to
+// the capture are skipped. The window after a step is not judged, as the
+// events queued before the step are still being processed. Only used by a
+// single thread.
+class CpuBudgetGovernor {
+ public:
+  enum class Step {
+    kNone,
+    kHalveSamplingRate,
+    kFramePointerUnwinding,
+    kDisableHotFunctions
+  };
+
+  CpuBudgetGovernor(double max_cpu_usage, bool samples,
+                    bool unwinds_with_dwarf, bool has_instrumented_functions);
+
+  // Returns the step to take after a window of window_duration_ns in which the
+  // service used cpu_time_ns, kNone if it stayed within the budget or if there
+  // is no step left.
+  [[nodiscard]] Step OnWindow(uint64_t window_duration_ns,
+                              uint64_t cpu_time_ns);
+  // Called when kDisableHotFunctions found no function left to disable.
+  void OnNoHotFunctionLeft() { has_instrumented_functions_ = false; }
+
+  // CPU usage over the last window, as a fraction of one core.
+  [[nodiscard]] double GetLastCpuUsage() const { return last_cpu_usage_; }
+  [[nodiscard]] double GetMaxCpuUsage() const { return max_cpu_usage_; }
+
+  static constexpr uint32_t MAX_SAMPLING_RATE_HALVINGS = 2;
+  static constexpr uint64_t WINDOW_DURATION_NS = 1'000'000'000;
+
+ private:
+  double max_cpu_usage_;
+  bool samples_;
+  bool unwinds_with_dwarf_;
+  bool has_instrumented_functions_;
+  uint32_t sampling_rate_halving_count_ = 0;
+  bool skip_next_window_ = false;
+  double last_cpu_usage_ = 0.0;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_CPU_BUDGET_GOVERNOR_H_
@@ -0,0 +1,68 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "CpuBudgetGovernor.h"
+
+namespace LinuxTracing {
+
+namespace {
+constexpr uint64_t kWindowNs = CpuBudgetGovernor::WINDOW_DURATION_NS;
+constexpr uint64_t kOverBudgetNs = kWindowNs / 10;
+constexpr uint64_t kWithinBudgetNs = kWindowNs / 50;
+}  // namespace
+
+TEST(CpuBudgetGovernor, DegradesStepByStep) {
+  CpuBudgetGovernor governor{0.05, true, true, true};
+  EXPECT_EQ(governor.OnWindow(kWindowNs, kWithinBudgetNs),
+            CpuBudgetGovernor::Step::kNone);
+  EXPECT_DOUBLE_EQ(governor.GetLastCpuUsage(), 0.02);
+
+  for (uint32_t i = 0; i < CpuBudgetGovernor::MAX_SAMPLING_RATE_HALVINGS;
+       ++i) {
+    EXPECT_EQ(governor.OnWindow(kWindowNs, kOverBudgetNs),
+              CpuBudgetGovernor::Step::kHalveSamplingRate);
+    // The window after a step is not judged.
+    EXPECT_EQ(governor.OnWindow(kWindowNs, kOverBudgetNs),
+              CpuBudgetGovernor::Step::kNone);
+  }
+  EXPECT_EQ(governor.OnWindow(kWindowNs, kOverBudgetNs),
+            CpuBudgetGovernor::Step::kFramePointerUnwinding);
+  EXPECT_EQ(governor.OnWindow(kWindowNs, kOverBudgetNs),
+            CpuBudgetGovernor::Step::kNone);
+  EXPECT_EQ(governor.OnWindow(kWindowNs, kWithinBudgetNs),
+            CpuBudgetGovernor::Step::kNone);
+  EXPECT_EQ(governor.OnWindow(kWindowNs, kOverBudgetNs),
+            CpuBudgetGovernor::Step::kDisableHotFunctions);
+  EXPECT_EQ(governor.OnWindow(kWindowNs, kOverBudgetNs),
+            CpuBudgetGovernor::Step::kNone);
+  EXPECT_EQ(governor.OnWindow(kWindowNs, kOverBudgetNs),
+            CpuBudgetGovernor::Step::kDisableHotFunctions);
+
+  governor.OnNoHotFunctionLeft();
+  EXPECT_EQ(governor.OnWindow(kWindowNs, kOverBudgetNs),
+            CpuBudgetGovernor::Step::kNone);
+  EXPECT_EQ(governor.OnWindow(kWindowNs, kOverBudgetNs),
+            CpuBudgetGovernor::Step::kNone);
+}
+
+TEST(CpuBudgetGovernor, SkipsStepsThatDontApply) {
+  CpuBudgetGovernor without_sampling{0.05, false, true, true};
+  EXPECT_EQ(without_sampling.OnWindow(kWindowNs, kOverBudgetNs),
+            CpuBudgetGovernor::Step::kDisableHotFunctions);
+
+  CpuBudgetGovernor with_frame_pointers{0.05, true, false, false};
+  for (uint32_t i = 0; i < CpuBudgetGovernor::MAX_SAMPLING_RATE_HALVINGS;
+       ++i) {
+    EXPECT_EQ(with_frame_pointers.OnWindow(kWindowNs, kOverBudgetNs),
+              CpuBudgetGovernor::Step::kHalveSamplingRate);
+    EXPECT_EQ(with_frame_pointers.OnWindow(kWindowNs, kOverBudgetNs),
+              CpuBudgetGovernor::Step::kNone);
+  }
+  EXPECT_EQ(with_frame_pointers.OnWindow(kWindowNs, kOverBudgetNs),
+            CpuBudgetGovernor::Step::kNone);
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,100 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <ElfUtils/ElfFile.h>
+#include <OrbitBase/Logging.h>
+#include <OrbitLinuxTracing/ElfCache.h>
+#include <sys/stat.h>
+
+#include <mutex>
+
+namespace LinuxTracing {
+
+bool ElfCache::Lookup(unwindstack::MapInfo* map_info) {
+  CHECK(map_info->elf == nullptr);
+  std::optional<Key> key = ComputeKey(map_info->name, map_info->offset);
+  if (!key.has_value()) {
+    return false;
+  }
+
+  absl::MutexLock lock{&mutex_};
+  auto entry_it = entries_by_key_.find(key.value());
+  if (entry_it == entries_by_key_.end()) {
+    ++miss_count_;
+    return false;
+  }
+  ++hit_count_;
+  entries_.splice(entries_.begin(), entries_, entry_it->second);
+  const Entry& entry = *entry_it->second;
+
+  std::lock_guard<std::mutex> map_info_lock{map_info->mutex_};
+  map_info->elf = entry.elf;
+  map_info->elf_offset = entry.elf_offset;
+  map_info->elf_start_offset = entry.elf_start_offset;
+  map_info->memory_backed_elf = false;
+  return true;
+}
+
+void ElfCache::Insert(unwindstack::MapInfo* map_info) {
+  Entry entry;
+  {
+    std::lock_guard<std::mutex> map_info_lock{map_info->mutex_};
+    // An Elf backed by process memory rather than by the file is not valid for
+    // other processes.
+    if (map_info->elf == nullptr || map_info->memory_backed_elf) {
+      return;
+    }
+    entry.elf = map_info->elf;
+    entry.elf_offset = map_info->elf_offset;
+    entry.elf_start_offset = map_info->elf_start_offset;
+  }
+
+  std::optional<Key> key = ComputeKey(map_info->name, map_info->offset);
+  if (!key.has_value()) {
+    return;
+  }
+  entry.key = std::move(key.value());
+
+  absl::MutexLock lock{&mutex_};
+  auto entry_it = entries_by_key_.find(entry.key);
+  if (entry_it != entries_by_key_.end()) {
+    entries_.erase(entry_it->second);
+    entries_by_key_.erase(entry_it);
+  }
+  entries_.push_front(std::move(entry));
+  entries_by_key_.emplace(entries_.front().key, entries_.begin());
+
+  while (entries_.size() > max_size_) {
+    entries_by_key_.erase(entries_.back().key);
+    entries_.pop_back();
+  }
+}
+
+size_t ElfCache::GetSize() {
+  absl::MutexLock lock{&mutex_};
+  return entries_.size();
+}
+
+std::optional<ElfCache::Key> ElfCache::ComputeKey(const std::string& path,
+                                                  uint64_t offset) {
+  // This also excludes anonymous maps and special maps like [vdso].
+  struct stat file_stat {};
+  if (stat(path.c_str(), &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+    return std::nullopt;
+  }
+
+  ErrorMessageOr<std::unique_ptr<ElfUtils::ElfFile>> elf_file =
+      ElfUtils::ElfFile::Create(path);
+  if (!elf_file) {
+    return std::nullopt;
+  }
+
+  int64_t modification_time_ns =
+      file_stat.st_mtim.tv_sec * 1'000'000'000 + file_stat.st_mtim.tv_nsec;
+  return Key{path, offset, modification_time_ns,
+             static_cast<uint64_t>(file_stat.st_size),
+             elf_file.value()->GetBuildId()};
+}
+
+}  // namespace LinuxTracing
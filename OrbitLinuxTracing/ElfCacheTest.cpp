@@ -0,0 +1,119 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <OrbitLinuxTracing/ElfCache.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <unwindstack/Maps.h>
+
+#include <climits>
+#include <memory>
+#include <string>
+
+namespace LinuxTracing {
+
+namespace {
+std::string GetTestExecutablePath() {
+  char path[PATH_MAX] = {};
+  EXPECT_GT(readlink("/proc/self/exe", path, sizeof(path) - 1), 0);
+  return path;
+}
+
+unwindstack::MapInfo* AddMapInfo(unwindstack::Maps* maps,
+                                 const std::string& name, uint64_t offset) {
+  maps->Add(0x1000, 0x2000, offset, PROT_READ | PROT_EXEC, name, INT64_MAX);
+  return (maps->end() - 1)->get();
+}
+
+unwindstack::MapInfo* AddMapInfoWithElf(unwindstack::Maps* maps,
+                                        const std::string& name,
+                                        uint64_t offset) {
+  unwindstack::MapInfo* map_info = AddMapInfo(maps, name, offset);
+  map_info->elf = std::make_shared<unwindstack::Elf>(nullptr);
+  map_info->elf_offset = offset;
+  return map_info;
+}
+}  // namespace
+
+TEST(ElfCache, MissThenHit) {
+  ElfCache elf_cache;
+  unwindstack::Maps maps;
+  const std::string path = GetTestExecutablePath();
+
+  unwindstack::MapInfo* first = AddMapInfo(&maps, path, 0);
+  EXPECT_FALSE(elf_cache.Lookup(first));
+  EXPECT_EQ(elf_cache.GetMissCount(), 1);
+
+  unwindstack::MapInfo* with_elf = AddMapInfoWithElf(&maps, path, 0x1000);
+  elf_cache.Insert(with_elf);
+  EXPECT_EQ(elf_cache.GetSize(), 1);
+
+  unwindstack::MapInfo* second = AddMapInfo(&maps, path, 0x1000);
+  EXPECT_TRUE(elf_cache.Lookup(second));
+  EXPECT_EQ(second->elf, with_elf->elf);
+  EXPECT_EQ(second->elf_offset, 0x1000);
+  EXPECT_EQ(elf_cache.GetHitCount(), 1);
+  EXPECT_EQ(elf_cache.GetMissCount(), 1);
+}
+
+TEST(ElfCache, DifferentOffsetMisses) {
+  ElfCache elf_cache;
+  unwindstack::Maps maps;
+  const std::string path = GetTestExecutablePath();
+
+  unwindstack::MapInfo* with_elf = AddMapInfoWithElf(&maps, path, 0);
+  elf_cache.Insert(with_elf);
+
+  unwindstack::MapInfo* map_info = AddMapInfo(&maps, path, 0x1000);
+  EXPECT_FALSE(elf_cache.Lookup(map_info));
+  EXPECT_EQ(map_info->elf, nullptr);
+}
+
+TEST(ElfCache, IgnoresMapsNotBackedByFiles) {
+  ElfCache elf_cache;
+  unwindstack::Maps maps;
+
+  unwindstack::MapInfo* anonymous = AddMapInfoWithElf(&maps, "", 0);
+  elf_cache.Insert(anonymous);
+  unwindstack::MapInfo* vdso = AddMapInfoWithElf(&maps, "[vdso]", 0);
+  elf_cache.Insert(vdso);
+  unwindstack::MapInfo* memory_backed =
+      AddMapInfoWithElf(&maps, GetTestExecutablePath(), 0);
+  memory_backed->memory_backed_elf = true;
+  elf_cache.Insert(memory_backed);
+  EXPECT_EQ(elf_cache.GetSize(), 0);
+
+  unwindstack::MapInfo* map_info = AddMapInfo(&maps, "[vdso]", 0);
+  EXPECT_FALSE(elf_cache.Lookup(map_info));
+  EXPECT_EQ(elf_cache.GetMissCount(), 0);
+}
+
+TEST(ElfCache, EvictsLeastRecentlyUsed) {
+  ElfCache elf_cache{2};
+  unwindstack::Maps maps;
+  const std::string path = GetTestExecutablePath();
+
+  unwindstack::MapInfo* first = AddMapInfoWithElf(&maps, path, 0);
+  elf_cache.Insert(first);
+  unwindstack::MapInfo* second = AddMapInfoWithElf(&maps, path, 0x1000);
+  elf_cache.Insert(second);
+
+  // Using the first Elf makes the second the least recently used.
+  unwindstack::MapInfo* lookup = AddMapInfo(&maps, path, 0);
+  EXPECT_TRUE(elf_cache.Lookup(lookup));
+
+  unwindstack::MapInfo* third = AddMapInfoWithElf(&maps, path, 0x2000);
+  elf_cache.Insert(third);
+  EXPECT_EQ(elf_cache.GetSize(), 2);
+
+  lookup = AddMapInfo(&maps, path, 0x1000);
+  EXPECT_FALSE(elf_cache.Lookup(lookup));
+  lookup = AddMapInfo(&maps, path, 0);
+  EXPECT_TRUE(elf_cache.Lookup(lookup));
+  lookup = AddMapInfo(&maps, path, 0x2000);
+  EXPECT_TRUE(elf_cache.Lookup(lookup));
+}
+
+}  // namespace LinuxTracing
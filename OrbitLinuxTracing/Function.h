@@ -5,17 +5,30 @@
 #ifndef ORBIT_LINUX_TRACING_FUNCTION_H_
 #define ORBIT_LINUX_TRACING_FUNCTION_H_
 
+#include <sys/types.h>
+
 #include <cstdint>
 #include <string>
 
 namespace LinuxTracing {
 class Function {
  public:
-  Function(std::string binary_path, uint64_t file_offset,
-           uint64_t virtual_address)
-      : binary_path_{std::move(binary_path)},
+  Function(pid_t pid, std::string binary_path, uint64_t file_offset,
+           uint64_t virtual_address, uint32_t recorded_argument_count,
+           bool record_return_value, bool aggregate_calls,
+           uint32_t sampling_ratio = 1)
+      : pid_{pid},
+        binary_path_{std::move(binary_path)},
         file_offset_{file_offset},
-        virtual_address_{virtual_address} {}
+        virtual_address_{virtual_address},
+        recorded_argument_count_{recorded_argument_count},
+        record_return_value_{record_return_value},
+        aggregate_calls_{aggregate_calls},
+        sampling_ratio_{sampling_ratio} {}
+
+  // The uprobes of the function fire in all the processes that map the binary:
+  // only the calls in this process, where VirtualAddress is valid, are kept.
+  pid_t Pid() const { return pid_; }
 
   const std::string& BinaryPath() const { return binary_path_; }
 
@@ -23,10 +36,24 @@ class Function {
 
   uint64_t VirtualAddress() const { return virtual_address_; }
 
+  uint32_t RecordedArgumentCount() const { return recorded_argument_count_; }
+
+  bool RecordReturnValue() const { return record_return_value_; }
+
+  bool AggregateCalls() const { return aggregate_calls_; }
+
+  // Only one in SamplingRatio calls of the function is reported.
+  uint32_t SamplingRatio() const { return sampling_ratio_; }
+
  private:
+  pid_t pid_;
   std::string binary_path_;
   uint64_t file_offset_;
   uint64_t virtual_address_;
+  uint32_t recorded_argument_count_;
+  bool record_return_value_;
+  bool aggregate_calls_;
+  uint32_t sampling_ratio_;
 };
 }  // namespace LinuxTracing
 
@@ -0,0 +1,83 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_GPU_JOB_DEPTH_ASSIGNER_H_
+#define ORBIT_LINUX_TRACING_GPU_JOB_DEPTH_ASSIGNER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace LinuxTracing {
+
+// Assigns to each GPU job of a timeline the lowest depth (row of the GPU track)
+// whose last job ended at least slack_ns before the start of the new job, or a
+// new depth if there is none.
+// Instead of scanning all the depths for every job, the end timestamps of the
+// last jobs are the leaves of a binary tree in which each node holds the
+// minimum of its children, so that the lowest available depth is found, and
+// its end timestamp updated, in time logarithmic in the number of depths.
+class GpuJobDepthAssigner {
+ public:
+  explicit GpuJobDepthAssigner(uint64_t slack_ns) : slack_ns_{slack_ns} {}
+
+  int AssignDepth(uint64_t start_timestamp_ns, uint64_t end_timestamp_ns) {
+    size_t depth;
+    if (depth_count_ > 0 && start_timestamp_ns >= slack_ns_ &&
+        tree_[1] <= start_timestamp_ns - slack_ns_) {
+      const uint64_t max_end_timestamp_ns = start_timestamp_ns - slack_ns_;
+      size_t node = 1;
+      while (node < leaf_count_) {
+        node *= 2;
+        if (tree_[node] > max_end_timestamp_ns) {
+          ++node;
+        }
+      }
+      depth = node - leaf_count_;
+    } else {
+      if (depth_count_ == leaf_count_) {
+        Grow();
+      }
+      depth = depth_count_++;
+    }
+
+    size_t node = leaf_count_ + depth;
+    tree_[node] = end_timestamp_ns;
+    for (node /= 2; node >= 1; node /= 2) {
+      tree_[node] = std::min(tree_[2 * node], tree_[2 * node + 1]);
+    }
+    return static_cast<int>(depth);
+  }
+
+  [[nodiscard]] size_t GetDepthCount() const { return depth_count_; }
+
+ private:
+  // The leaves that are not depths yet are never available.
+  static constexpr uint64_t UNUSED_LEAF = std::numeric_limits<uint64_t>::max();
+
+  void Grow() {
+    const size_t new_leaf_count = std::max<size_t>(2 * leaf_count_, 1);
+    std::vector<uint64_t> new_tree(2 * new_leaf_count, UNUSED_LEAF);
+    std::copy(tree_.begin() + leaf_count_, tree_.begin() + 2 * leaf_count_,
+              new_tree.begin() + new_leaf_count);
+    for (size_t node = new_leaf_count - 1; node >= 1; --node) {
+      new_tree[node] = std::min(new_tree[2 * node], new_tree[2 * node + 1]);
+    }
+    tree_ = std::move(new_tree);
+    leaf_count_ = new_leaf_count;
+  }
+
+  uint64_t slack_ns_;
+  // Node 1 is the root and the children of node n are nodes 2n and 2n + 1.
+  // Nodes from leaf_count_ on are the leaves, i.e., the depths.
+  std::vector<uint64_t> tree_;
+  size_t leaf_count_ = 0;
+  size_t depth_count_ = 0;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_GPU_JOB_DEPTH_ASSIGNER_H_
@@ -0,0 +1,67 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "GpuJobDepthAssigner.h"
+
+namespace LinuxTracing {
+
+TEST(GpuJobDepthAssigner, ReusesLowestAvailableDepth) {
+  GpuJobDepthAssigner assigner{10};
+  EXPECT_EQ(assigner.AssignDepth(0, 100), 0);
+  EXPECT_EQ(assigner.AssignDepth(50, 200), 1);
+  EXPECT_EQ(assigner.AssignDepth(60, 300), 2);
+  // Depth 0 ends at 100, but the slack is not over yet.
+  EXPECT_EQ(assigner.AssignDepth(105, 400), 3);
+  EXPECT_EQ(assigner.AssignDepth(250, 500), 0);
+  // Depths 1 and 2 are both available: the lowest is used.
+  EXPECT_EQ(assigner.AssignDepth(310, 600), 1);
+  EXPECT_EQ(assigner.AssignDepth(311, 700), 2);
+  EXPECT_EQ(assigner.GetDepthCount(), 4);
+}
+
+TEST(GpuJobDepthAssigner, StartBeforeSlack) {
+  GpuJobDepthAssigner assigner{10};
+  EXPECT_EQ(assigner.AssignDepth(5, 6), 0);
+  EXPECT_EQ(assigner.AssignDepth(7, 8), 1);
+  EXPECT_EQ(assigner.AssignDepth(16, 20), 0);
+}
+
+TEST(GpuJobDepthAssigner, SameAsScanningAllDepths) {
+  constexpr uint64_t kSlackNs = 3;
+  GpuJobDepthAssigner assigner{kSlackNs};
+  std::vector<uint64_t> end_timestamp_per_depth;
+  std::mt19937 generator{42};
+  std::uniform_int_distribution<uint64_t> start_distribution{0, 1000};
+  std::uniform_int_distribution<uint64_t> duration_distribution{0, 50};
+  for (int i = 0; i < 10'000; ++i) {
+    uint64_t start_timestamp_ns = start_distribution(generator);
+    uint64_t end_timestamp_ns =
+        start_timestamp_ns + duration_distribution(generator);
+
+    int expected_depth = static_cast<int>(end_timestamp_per_depth.size());
+    for (size_t depth = 0; depth < end_timestamp_per_depth.size(); ++depth) {
+      if (start_timestamp_ns >= end_timestamp_per_depth[depth] + kSlackNs) {
+        expected_depth = static_cast<int>(depth);
+        break;
+      }
+    }
+    if (expected_depth == static_cast<int>(end_timestamp_per_depth.size())) {
+      end_timestamp_per_depth.push_back(end_timestamp_ns);
+    } else {
+      end_timestamp_per_depth[expected_depth] = end_timestamp_ns;
+    }
+
+    ASSERT_EQ(assigner.AssignDepth(start_timestamp_ns, end_timestamp_ns),
+              expected_depth);
+  }
+  EXPECT_EQ(assigner.GetDepthCount(), end_timestamp_per_depth.size());
+}
+
+}  // namespace LinuxTracing
@@ -4,56 +4,59 @@
 
 #include "GpuTracepointEventProcessor.h"
 
+#include <algorithm>
 #include <string>
 #include <tuple>
-#include <vector>
+#include <utility>
 
 namespace LinuxTracing {
 
-int GpuTracepointEventProcessor::ComputeDepthForEvent(
-    const std::string& timeline, uint64_t start_timestamp,
-    uint64_t end_timestamp) {
-  if (timeline_to_latest_timestamp_per_depth_.count(timeline) == 0) {
-    std::vector<uint64_t> vec;
-    timeline_to_latest_timestamp_per_depth_.emplace(timeline, vec);
+GpuTracepointEventProcessor::PendingJobMap::iterator
+GpuTracepointEventProcessor::GetPendingJob(Key key, uint64_t timestamp_ns) {
+  ExpirePendingJobs(timestamp_ns);
+  auto [pending_job_it, inserted] =
+      pending_jobs_.try_emplace(key, PendingJob{timestamp_ns});
+  if (inserted) {
+    pending_job_keys_.emplace_back(timestamp_ns, std::move(key));
   }
-  auto it = timeline_to_latest_timestamp_per_depth_.find(timeline);
-  std::vector<uint64_t>& vec = it->second;
-
-  for (size_t d = 0; d < vec.size(); ++d) {
-    // We add a small amount of slack on each row of the GPU track timeline to
-    // make sure events don't get too crowded.
-    constexpr uint64_t slack_ns = 1 * 1000000;
-    if (start_timestamp >= (vec[d] + slack_ns)) {
-      vec[d] = end_timestamp;
-      return d;
+  return pending_job_it;
+}
+
+void GpuTracepointEventProcessor::ExpirePendingJobs(uint64_t timestamp_ns) {
+  while (!pending_job_keys_.empty() &&
+         pending_job_keys_.front().first + PENDING_JOB_EXPIRY_NS <
+             timestamp_ns) {
+    const auto& [first_event_timestamp_ns, key] = pending_job_keys_.front();
+    auto pending_job_it = pending_jobs_.find(key);
+    if (pending_job_it != pending_jobs_.end() &&
+        pending_job_it->second.first_event_timestamp_ns ==
+            first_event_timestamp_ns) {
+      pending_jobs_.erase(pending_job_it);
+      ++expired_job_count_;
     }
+    pending_job_keys_.pop_front();
   }
-
-  // Note that this vector only grows in size until a certain maximum depth is
-  // reached. Since there are only O(10) events per frame created, the depth
-  // is not likely to grow to a very large size.
-  vec.push_back(end_timestamp);
-  return static_cast<int>(vec.size() - 1);
 }
 
 void GpuTracepointEventProcessor::CreateGpuExecutionEventIfComplete(
-    const Key& key) {
-  auto cs_it = amdgpu_cs_ioctl_events_.find(key);
-  auto sched_it = amdgpu_sched_run_job_events_.find(key);
-  auto dma_it = dma_fence_signaled_events_.find(key);
-
+    PendingJobMap::iterator pending_job_it) {
+  const PendingJob& pending_job = pending_job_it->second;
   // First check if we have received all three events that are needed
   // to complete a full GPU execution event. Otherwise, we need to
   // keep waiting for events for this context, seqno, and timeline.
-  if (cs_it == amdgpu_cs_ioctl_events_.end() ||
-      sched_it == amdgpu_sched_run_job_events_.end() ||
-      dma_it == dma_fence_signaled_events_.end()) {
+  if (!pending_job.amdgpu_cs_ioctl.has_value() ||
+      !pending_job.amdgpu_sched_run_job_timestamp_ns.has_value() ||
+      !pending_job.dma_fence_signaled_timestamp_ns.has_value()) {
     return;
   }
 
-  std::string timeline = cs_it->second.timeline;
-  pid_t tid = cs_it->second.tid;
+  const auto& [context, seqno, timeline] = pending_job_it->first;
+  const uint64_t amdgpu_cs_ioctl_timestamp_ns =
+      pending_job.amdgpu_cs_ioctl->timestamp_ns;
+  const uint64_t amdgpu_sched_run_job_timestamp_ns =
+      pending_job.amdgpu_sched_run_job_timestamp_ns.value();
+  const uint64_t dma_fence_signaled_timestamp_ns =
+      pending_job.dma_fence_signaled_timestamp_ns.value();
 
   // We assume that GPU jobs (command buffer submissions) immediately
   // start running on the hardware when they are scheduled by the
@@ -62,90 +65,82 @@ void GpuTracepointEventProcessor::CreateGpuExecutionEventIfComplete(
   // timeline_to_latest_dma_signal_. If a previous job is still running
   // at the timestamp of scheduling the current job, we push the start
   // time for starting on the hardware back.
-  if (timeline_to_latest_dma_signal_.count(timeline) == 0) {
-    timeline_to_latest_dma_signal_.emplace(timeline,
-                                           dma_it->second.timestamp_ns);
-  }
-  auto it = timeline_to_latest_dma_signal_.find(timeline);
+  auto it = timeline_to_latest_dma_signal_
+                .try_emplace(timeline, dma_fence_signaled_timestamp_ns)
+                .first;
   // We do not have an explicit event for the following timestamp. We
   // assume that, when the GPU queue corresponding to timeline is
   // not executing a job, that this job starts exactly when it is
   // scheduled by the driver. Otherwise, we assume it starts exactly
   // when the previous job has signaled that it is done. Since we do
   // not have an explicit signal here, this is the best we can do.
-  uint64_t hw_start_time = sched_it->second.timestamp_ns;
+  uint64_t hw_start_time = amdgpu_sched_run_job_timestamp_ns;
   if (hw_start_time < it->second) {
     hw_start_time = it->second;
   }
 
-  int depth = ComputeDepthForEvent(timeline, cs_it->second.timestamp_ns,
-                                   dma_it->second.timestamp_ns);
+  int depth = timeline_to_depth_assigner_
+                  .try_emplace(timeline, DEPTH_SLACK_NS)
+                  .first->second.AssignDepth(amdgpu_cs_ioctl_timestamp_ns,
+                                             dma_fence_signaled_timestamp_ns);
   GpuJob gpu_job;
-  gpu_job.set_tid(tid);
-  gpu_job.set_context(cs_it->second.context);
-  gpu_job.set_seqno(cs_it->second.seqno);
-  gpu_job.set_timeline(cs_it->second.timeline);
+  gpu_job.set_tid(pending_job.amdgpu_cs_ioctl->tid);
+  gpu_job.set_context(context);
+  gpu_job.set_seqno(seqno);
+  gpu_job.set_timeline(timeline);
   gpu_job.set_depth(depth);
-  gpu_job.set_amdgpu_cs_ioctl_time_ns(cs_it->second.timestamp_ns);
-  gpu_job.set_amdgpu_sched_run_job_time_ns(sched_it->second.timestamp_ns);
+  gpu_job.set_amdgpu_cs_ioctl_time_ns(amdgpu_cs_ioctl_timestamp_ns);
+  gpu_job.set_amdgpu_sched_run_job_time_ns(amdgpu_sched_run_job_timestamp_ns);
   gpu_job.set_gpu_hardware_start_time_ns(hw_start_time);
-  gpu_job.set_dma_fence_signaled_time_ns(dma_it->second.timestamp_ns);
+  gpu_job.set_dma_fence_signaled_time_ns(dma_fence_signaled_timestamp_ns);
 
   listener_->OnGpuJob(std::move(gpu_job));
+  ++complete_job_count_;
 
   // We need to update the timestamp when the last GPU job so far seen
   // finishes on this timeline.
-  it->second = std::max(it->second, dma_it->second.timestamp_ns);
+  it->second = std::max(it->second, dma_fence_signaled_timestamp_ns);
 
-  amdgpu_cs_ioctl_events_.erase(key);
-  amdgpu_sched_run_job_events_.erase(key);
-  dma_fence_signaled_events_.erase(key);
+  pending_jobs_.erase(pending_job_it);
 }
 
 // The following three overloaded PushEvent methods handle the three different
 // types of events that we can get from the GPU driver tracepoints we are
 // tracing.
-// We allow for the possibility that these events arrive out-of-order
-// (which is something we have actually observed) with the following approach:
-// We record all three types of events in different maps. Whenever a new event
-// arrives, we add it to the corresponding map and then try to create a complete
-// GPU execution event. This event is only created when all three types of GPU
-// events have been received.
+// The three events of a job are collected in the same PendingJob, whenever a
+// new event arrives we add it there and then check whether the job is
+// complete. The events of a job can arrive in any order, however the job is
+// expired PENDING_JOB_EXPIRY_NS after its first event if it's still missing
+// some.
 
 void GpuTracepointEventProcessor::PushEvent(
     const AmdgpuCsIoctlPerfEvent& sample) {
-  AmdgpuCsIoctlEvent event{sample.GetTid(), sample.GetTimestamp(),
-                           sample.GetContext(), sample.GetSeqno(),
-                           sample.ExtractTimelineString()};
   Key key = std::make_tuple(sample.GetContext(), sample.GetSeqno(),
                             sample.ExtractTimelineString());
-
-  amdgpu_cs_ioctl_events_.emplace(key, std::move(event));
-  CreateGpuExecutionEventIfComplete(key);
+  auto pending_job_it = GetPendingJob(std::move(key), sample.GetTimestamp());
+  pending_job_it->second.amdgpu_cs_ioctl =
+      AmdgpuCsIoctlEvent{sample.GetTid(), sample.GetTimestamp()};
+  CreateGpuExecutionEventIfComplete(pending_job_it);
 }
 
 void GpuTracepointEventProcessor::PushEvent(
     const AmdgpuSchedRunJobPerfEvent& sample) {
-  AmdgpuSchedRunJobEvent event{sample.GetTimestamp(), sample.GetContext(),
-                               sample.GetSeqno(),
-                               sample.ExtractTimelineString()};
   Key key = std::make_tuple(sample.GetContext(), sample.GetSeqno(),
                             sample.ExtractTimelineString());
-
-  amdgpu_sched_run_job_events_.emplace(key, std::move(event));
-  CreateGpuExecutionEventIfComplete(key);
+  auto pending_job_it = GetPendingJob(std::move(key), sample.GetTimestamp());
+  pending_job_it->second.amdgpu_sched_run_job_timestamp_ns =
+      sample.GetTimestamp();
+  CreateGpuExecutionEventIfComplete(pending_job_it);
 }
 
 void GpuTracepointEventProcessor::PushEvent(
     const DmaFenceSignaledPerfEvent& sample) {
-  DmaFenceSignaledEvent event{sample.GetTimestamp(), sample.GetContext(),
-                              sample.GetSeqno(),
-                              sample.ExtractTimelineString()};
   Key key = std::make_tuple(sample.GetContext(), sample.GetSeqno(),
                             sample.ExtractTimelineString());
-
-  dma_fence_signaled_events_.emplace(key, std::move(event));
-  CreateGpuExecutionEventIfComplete(key);
+  auto pending_job_it = GetPendingJob(std::move(key), sample.GetTimestamp());
+  pending_job_it->second.dma_fence_signaled_timestamp_ns =
+      sample.GetTimestamp();
+  CreateGpuExecutionEventIfComplete(pending_job_it);
 }
 
 void GpuTracepointEventProcessor::SetListener(TracerListener* listener) {
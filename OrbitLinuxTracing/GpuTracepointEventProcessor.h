@@ -5,62 +5,97 @@
 #ifndef ORBIT_LINUX_TRACING_GPU_TRACEPOINT_EVENT_PROCESSOR
 #define ORBIT_LINUX_TRACING_GPU_TRACEPOINT_EVENT_PROCESSOR
 
+#include <deque>
+#include <optional>
+#include <string>
 #include <tuple>
+#include <utility>
 
+#include "GpuJobDepthAssigner.h"
 #include "OrbitLinuxTracing/TracerListener.h"
 #include "PerfEvent.h"
+#include "PerfEventVisitor.h"
 #include "absl/container/flat_hash_map.h"
 
 namespace LinuxTracing {
 
-class GpuTracepointEventProcessor {
+// Combines the three GPU driver tracepoints of each GPU job into a GpuJob.
+// The events are meant to be visited in timestamp order, e.g., by
+// PerfEventProcessor2, so that the jobs of a timeline are processed in order.
+// This also allows to expire the jobs for which some event is still missing
+// after PENDING_JOB_EXPIRY_NS, e.g., because it was lost, so that they don't
+// accumulate during long captures.
+class GpuTracepointEventProcessor : public PerfEventVisitor {
  public:
   void PushEvent(const AmdgpuCsIoctlPerfEvent& sample);
   void PushEvent(const AmdgpuSchedRunJobPerfEvent& sample);
   void PushEvent(const DmaFenceSignaledPerfEvent& sample);
 
+  void visit(AmdgpuCsIoctlPerfEvent* event) override { PushEvent(*event); }
+  void visit(AmdgpuSchedRunJobPerfEvent* event) override { PushEvent(*event); }
+  void visit(DmaFenceSignaledPerfEvent* event) override { PushEvent(*event); }
+
   void SetListener(TracerListener* listener);
 
+  [[nodiscard]] uint64_t GetCompleteJobCount() const {
+    return complete_job_count_;
+  }
+  // Jobs that were discarded because some of their events never arrived.
+  [[nodiscard]] uint64_t GetExpiredJobCount() const {
+    return expired_job_count_;
+  }
+  // Jobs that are still waiting for some of their events.
+  [[nodiscard]] size_t GetPendingJobCount() const {
+    return pending_jobs_.size();
+  }
+
+  static constexpr uint64_t PENDING_JOB_EXPIRY_NS = 10'000'000'000;
+
  private:
   // Keys are context, seqno, and timeline
   typedef std::tuple<uint32_t, uint32_t, std::string> Key;
 
-  int ComputeDepthForEvent(const std::string& timeline,
-                           uint64_t start_timestamp, uint64_t end_timestamp);
-
-  void CreateGpuExecutionEventIfComplete(const Key& key);
-
-  TracerListener* listener_ = nullptr;
-
   struct AmdgpuCsIoctlEvent {
     pid_t tid;
     uint64_t timestamp_ns;
-    uint32_t context;
-    uint32_t seqno;
-    std::string timeline;
   };
-  absl::flat_hash_map<Key, AmdgpuCsIoctlEvent> amdgpu_cs_ioctl_events_;
-
-  struct AmdgpuSchedRunJobEvent {
-    uint64_t timestamp_ns;
-    uint32_t context;
-    uint32_t seqno;
-    std::string timeline;
+  // All three events of a job share the same key, hence only the tid and the
+  // timestamps need to be kept.
+  struct PendingJob {
+    uint64_t first_event_timestamp_ns;
+    std::optional<AmdgpuCsIoctlEvent> amdgpu_cs_ioctl;
+    std::optional<uint64_t> amdgpu_sched_run_job_timestamp_ns;
+    std::optional<uint64_t> dma_fence_signaled_timestamp_ns;
   };
-  absl::flat_hash_map<Key, AmdgpuSchedRunJobEvent> amdgpu_sched_run_job_events_;
 
-  struct DmaFenceSignaledEvent {
-    uint64_t timestamp_ns;
-    uint32_t context;
-    uint32_t seqno;
-    std::string timeline;
-  };
-  absl::flat_hash_map<Key, DmaFenceSignaledEvent> dma_fence_signaled_events_;
+  using PendingJobMap = absl::flat_hash_map<Key, PendingJob>;
+
+  // Returns the pending job of key, created if necessary, after expiring the
+  // pending jobs that are too old compared to timestamp_ns. This is the only
+  // lookup for each event.
+  PendingJobMap::iterator GetPendingJob(Key key, uint64_t timestamp_ns);
+  void ExpirePendingJobs(uint64_t timestamp_ns);
+  void CreateGpuExecutionEventIfComplete(
+      PendingJobMap::iterator pending_job_it);
+
+  TracerListener* listener_ = nullptr;
+
+  PendingJobMap pending_jobs_;
+  // The keys of pending_jobs_ in the order in which they were created, to
+  // expire them. Entries for jobs that have completed in the meantime, or
+  // whose key has been reused by a later job, are skipped.
+  std::deque<std::pair<uint64_t, Key>> pending_job_keys_;
 
   absl::flat_hash_map<std::string, uint64_t> timeline_to_latest_dma_signal_;
 
-  absl::flat_hash_map<std::string, std::vector<uint64_t>>
-      timeline_to_latest_timestamp_per_depth_;
+  // We add a small amount of slack on each row of the GPU track timeline to
+  // make sure events don't get too crowded.
+  static constexpr uint64_t DEPTH_SLACK_NS = 1 * 1000000;
+  absl::flat_hash_map<std::string, GpuJobDepthAssigner>
+      timeline_to_depth_assigner_;
+
+  uint64_t complete_job_count_ = 0;
+  uint64_t expired_job_count_ = 0;
 };
 
 }  // namespace LinuxTracing
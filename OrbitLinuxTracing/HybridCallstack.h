@@ -0,0 +1,59 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_HYBRID_CALLSTACK_H_
+#define ORBIT_LINUX_TRACING_HYBRID_CALLSTACK_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace LinuxTracing {
+
+// Combines the callstack of a hybrid sample unwound with frame pointers with
+// the innermost frames of the same sample unwound with DWARF from the top of
+// the stack. Both have the address of the sampled instruction as first pc and
+// return addresses minus 1 as the following pcs.
+// In a function that doesn't set up its frame pointer, e.g., a leaf function
+// in a library built without frame pointers, the frame pointer chain misses
+// the caller, or is broken altogether if the frame pointer register is used
+// for something else. The DWARF frames are used until the first one whose pc
+// also occurs in the frame pointer callstack, from which that callstack is
+// used. This way the decision is made for every sample, without having to know
+// in advance which functions don't have frame pointers.
+// As long as frame pointers and DWARF don't agree, the frame pointer callstack
+// is returned unchanged, so that the result is never worse than with frame
+// pointers only.
+inline std::vector<uint64_t> MergeHybridCallstack(
+    const std::vector<uint64_t>& frame_pointer_pcs,
+    const std::vector<uint64_t>& dwarf_pcs) {
+  if (frame_pointer_pcs.empty() || dwarf_pcs.empty() ||
+      dwarf_pcs[0] != frame_pointer_pcs[0]) {
+    return frame_pointer_pcs;
+  }
+
+  for (size_t dwarf_index = 1; dwarf_index < dwarf_pcs.size(); ++dwarf_index) {
+    auto frame_pointer_it =
+        std::find(frame_pointer_pcs.begin() + 1, frame_pointer_pcs.end(),
+                  dwarf_pcs[dwarf_index]);
+    if (frame_pointer_it == frame_pointer_pcs.end()) {
+      continue;
+    }
+
+    std::vector<uint64_t> merged_pcs;
+    merged_pcs.reserve(dwarf_index +
+                       (frame_pointer_pcs.end() - frame_pointer_it));
+    merged_pcs.insert(merged_pcs.end(), dwarf_pcs.begin(),
+                      dwarf_pcs.begin() + dwarf_index);
+    merged_pcs.insert(merged_pcs.end(), frame_pointer_it,
+                      frame_pointer_pcs.end());
+    return merged_pcs;
+  }
+
+  return frame_pointer_pcs;
+}
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_HYBRID_CALLSTACK_H_
@@ -0,0 +1,56 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "HybridCallstack.h"
+
+namespace LinuxTracing {
+
+TEST(MergeHybridCallstack, AgreeingCallstacksAreUnchanged) {
+  std::vector<uint64_t> frame_pointer_pcs{0x10, 0x20, 0x30, 0x40};
+  std::vector<uint64_t> dwarf_pcs{0x10, 0x20};
+  EXPECT_THAT(MergeHybridCallstack(frame_pointer_pcs, dwarf_pcs),
+              testing::ElementsAre(0x10, 0x20, 0x30, 0x40));
+}
+
+TEST(MergeHybridCallstack, AddsCallerMissedByFramePointers) {
+  // The leaf function doesn't set up its frame pointer, so the frame pointer
+  // chain misses its caller 0x15.
+  std::vector<uint64_t> frame_pointer_pcs{0x10, 0x20, 0x30, 0x40};
+  std::vector<uint64_t> dwarf_pcs{0x10, 0x15, 0x20, 0x30};
+  EXPECT_THAT(MergeHybridCallstack(frame_pointer_pcs, dwarf_pcs),
+              testing::ElementsAre(0x10, 0x15, 0x20, 0x30, 0x40));
+}
+
+TEST(MergeHybridCallstack, ReplacesBrokenFramePointerFrames) {
+  // The frame pointer register was used for something else in the leaf
+  // function, so the first frames of the frame pointer chain are garbage.
+  std::vector<uint64_t> frame_pointer_pcs{0x10, 0xBAD, 0x30, 0x40};
+  std::vector<uint64_t> dwarf_pcs{0x10, 0x15, 0x20, 0x30};
+  EXPECT_THAT(MergeHybridCallstack(frame_pointer_pcs, dwarf_pcs),
+              testing::ElementsAre(0x10, 0x15, 0x20, 0x30, 0x40));
+}
+
+TEST(MergeHybridCallstack, UsesInnermostOccurrenceOfRecursiveFrame) {
+  std::vector<uint64_t> frame_pointer_pcs{0x10, 0x20, 0x20, 0x20, 0x40};
+  std::vector<uint64_t> dwarf_pcs{0x10, 0x15, 0x20};
+  EXPECT_THAT(MergeHybridCallstack(frame_pointer_pcs, dwarf_pcs),
+              testing::ElementsAre(0x10, 0x15, 0x20, 0x20, 0x20, 0x40));
+}
+
+TEST(MergeHybridCallstack, KeepsFramePointersWithoutCommonFrame) {
+  std::vector<uint64_t> frame_pointer_pcs{0x10, 0x20, 0x30};
+  EXPECT_THAT(MergeHybridCallstack(frame_pointer_pcs, {0x10, 0x15, 0x16}),
+              testing::ElementsAre(0x10, 0x20, 0x30));
+  EXPECT_THAT(MergeHybridCallstack(frame_pointer_pcs, {0x11, 0x20}),
+              testing::ElementsAre(0x10, 0x20, 0x30));
+  EXPECT_THAT(MergeHybridCallstack(frame_pointer_pcs, {}),
+              testing::ElementsAre(0x10, 0x20, 0x30));
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,52 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "InstrumentationGovernor.h"
+
+#include <algorithm>
+
+namespace LinuxTracing {
+
+InstrumentationGovernor::InstrumentationGovernor(size_t function_count,
+                                                 uint64_t max_calls_per_second)
+    : function_count_{function_count},
+      max_calls_per_second_{max_calls_per_second},
+      call_counts_{std::make_unique<std::atomic<uint64_t>[]>(function_count)} {
+  for (size_t i = 0; i < function_count_; ++i) {
+    call_counts_[i] = 0;
+  }
+}
+
+void InstrumentationGovernor::StartMeasuring(uint64_t timestamp_ns) {
+  for (size_t i = 0; i < function_count_; ++i) {
+    call_counts_[i] = 0;
+  }
+  begin_timestamp_ns_ = timestamp_ns;
+  measuring_ = true;
+}
+
+std::vector<InstrumentationGovernor::HotFunction>
+InstrumentationGovernor::StopMeasuring(uint64_t timestamp_ns) {
+  measuring_ = false;
+  std::vector<HotFunction> hot_functions;
+  if (timestamp_ns <= begin_timestamp_ns_) {
+    return hot_functions;
+  }
+  const double duration_s =
+      static_cast<double>(timestamp_ns - begin_timestamp_ns_) / 1'000'000'000;
+  for (size_t i = 0; i < function_count_; ++i) {
+    auto calls_per_second = static_cast<uint64_t>(
+        static_cast<double>(call_counts_[i].load()) / duration_s);
+    if (calls_per_second > max_calls_per_second_) {
+      hot_functions.push_back(HotFunction{i, calls_per_second});
+    }
+  }
+  std::sort(hot_functions.begin(), hot_functions.end(),
+            [](const HotFunction& a, const HotFunction& b) {
+              return a.calls_per_second > b.calls_per_second;
+            });
+  return hot_functions;
+}
+
+}  // namespace LinuxTracing
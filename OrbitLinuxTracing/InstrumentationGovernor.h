@@ -0,0 +1,57 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_INSTRUMENTATION_GOVERNOR_H_
+#define ORBIT_LINUX_TRACING_INSTRUMENTATION_GOVERNOR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace LinuxTracing {
+
+// InstrumentationGovernor counts the calls to each instrumented function at the
+// beginning of a capture, to find the functions called so often that their
+// uprobes and uretprobes distort what is being measured, e.g., the trivial
+// leaf functions of a module instrumented as a whole. TracerThread disables
+// the probes of these functions once the measurement is over.
+// CountCall is called by the ring buffer readers concurrently, the other
+// methods by a single thread.
+class InstrumentationGovernor {
+ public:
+  struct HotFunction {
+    size_t function_index;
+    uint64_t calls_per_second;
+  };
+
+  InstrumentationGovernor(size_t function_count,
+                          uint64_t max_calls_per_second);
+
+  void StartMeasuring(uint64_t timestamp_ns);
+  void CountCall(size_t function_index) {
+    if (!measuring_.load(std::memory_order_relaxed)) return;
+    call_counts_[function_index].fetch_add(1, std::memory_order_relaxed);
+  }
+  // Stops counting, and returns the functions called more than
+  // max_calls_per_second on average since StartMeasuring, hottest first.
+  [[nodiscard]] std::vector<HotFunction> StopMeasuring(uint64_t timestamp_ns);
+  [[nodiscard]] uint64_t GetMaxCallsPerSecond() const {
+    return max_calls_per_second_;
+  }
+
+  static constexpr uint64_t MEASUREMENT_DURATION_NS = 1'000'000'000;
+
+ private:
+  size_t function_count_;
+  uint64_t max_calls_per_second_;
+  std::unique_ptr<std::atomic<uint64_t>[]> call_counts_;
+  std::atomic<bool> measuring_ = false;
+  uint64_t begin_timestamp_ns_ = 0;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_INSTRUMENTATION_GOVERNOR_H_
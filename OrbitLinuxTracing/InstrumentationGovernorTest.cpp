@@ -0,0 +1,56 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "InstrumentationGovernor.h"
+
+namespace LinuxTracing {
+
+TEST(InstrumentationGovernor, FindsHotFunctions) {
+  InstrumentationGovernor governor{3, 1000};
+  // Not counted before the measurement starts.
+  for (int i = 0; i < 5000; ++i) {
+    governor.CountCall(0);
+  }
+
+  governor.StartMeasuring(1'000'000'000);
+  for (int i = 0; i < 1500; ++i) {
+    governor.CountCall(0);
+  }
+  for (int i = 0; i < 3000; ++i) {
+    governor.CountCall(2);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    governor.CountCall(1);
+  }
+  std::vector<InstrumentationGovernor::HotFunction> hot_functions =
+      governor.StopMeasuring(2'000'000'000);
+
+  ASSERT_EQ(hot_functions.size(), 2);
+  EXPECT_EQ(hot_functions[0].function_index, 2);
+  EXPECT_EQ(hot_functions[0].calls_per_second, 3000);
+  EXPECT_EQ(hot_functions[1].function_index, 0);
+  EXPECT_EQ(hot_functions[1].calls_per_second, 1500);
+}
+
+TEST(InstrumentationGovernor, ComputesRatesOverTheMeasurement) {
+  InstrumentationGovernor governor{1, 1000};
+  governor.StartMeasuring(0);
+  for (int i = 0; i < 600; ++i) {
+    governor.CountCall(0);
+  }
+  std::vector<InstrumentationGovernor::HotFunction> hot_functions =
+      governor.StopMeasuring(500'000'000);
+  ASSERT_EQ(hot_functions.size(), 1);
+  EXPECT_EQ(hot_functions[0].calls_per_second, 1200);
+
+  // Not counted after the measurement.
+  governor.CountCall(0);
+  hot_functions = governor.StopMeasuring(500'000'000);
+  ASSERT_EQ(hot_functions.size(), 1);
+  EXPECT_EQ(hot_functions[0].calls_per_second, 1200);
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,137 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_IO_LATENCY_MANAGER_H_
+#define ORBIT_LINUX_TRACING_IO_LATENCY_MANAGER_H_
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "capture.pb.h"
+
+namespace LinuxTracing {
+
+// Matches the entries of the syscalls of each thread with their exits, and
+// the issues of block I/O requests with their completions, into
+// SyscallLatencies and BlockIoLatencies. The events must be processed in
+// order, as the exit of a syscall of a thread that migrated, or the
+// completion of a request, can be recorded on another cpu.
+class IoLatencyManager {
+ public:
+  void ProcessSyscallEnter(pid_t pid, pid_t tid, int64_t syscall_nr,
+                           uint64_t timestamp_ns, uint32_t depth) {
+    // A syscall without an exit, e.g., an execve, is replaced.
+    open_syscalls_.insert_or_assign(
+        tid, OpenSyscall{pid, syscall_nr, timestamp_ns, depth});
+  }
+
+  // Returns the syscall of tid that the exit ends, if any.
+  std::optional<SyscallLatency> ProcessSyscallExit(pid_t tid,
+                                                   int64_t syscall_nr,
+                                                   uint64_t timestamp_ns,
+                                                   int64_t ret) {
+    auto open_syscall_it = open_syscalls_.find(tid);
+    if (open_syscall_it == open_syscalls_.end()) {
+      return std::nullopt;
+    }
+    OpenSyscall open_syscall = open_syscall_it->second;
+    open_syscalls_.erase(open_syscall_it);
+    if (open_syscall.syscall_nr != syscall_nr ||
+        timestamp_ns < open_syscall.begin_timestamp_ns) {
+      return std::nullopt;
+    }
+
+    SyscallLatency syscall_latency;
+    syscall_latency.set_pid(open_syscall.pid);
+    syscall_latency.set_tid(tid);
+    syscall_latency.set_syscall_nr(static_cast<int32_t>(syscall_nr));
+    syscall_latency.set_begin_timestamp_ns(open_syscall.begin_timestamp_ns);
+    syscall_latency.set_end_timestamp_ns(timestamp_ns);
+    syscall_latency.set_ret(ret);
+    syscall_latency.set_depth(open_syscall.depth);
+    return syscall_latency;
+  }
+
+  void ProcessBlockRqIssue(pid_t pid, pid_t tid, uint32_t dev, uint64_t sector,
+                           uint32_t nr_sectors, bool write,
+                           uint64_t timestamp_ns, uint32_t depth) {
+    // Below the syscall that issued it, if any, e.g., a synchronous read.
+    if (open_syscalls_.contains(tid)) {
+      ++depth;
+    }
+    // A request that is issued again, e.g., after a requeue, restarts.
+    open_block_requests_.insert_or_assign(
+        std::make_pair(dev, sector),
+        OpenBlockRequest{pid, tid, nr_sectors, write, timestamp_ns, depth});
+  }
+
+  // Returns the request issued by a captured thread that the completion
+  // ends, if any.
+  std::optional<BlockIoLatency> ProcessBlockRqComplete(uint32_t dev,
+                                                       uint64_t sector,
+                                                       uint64_t timestamp_ns,
+                                                       int32_t error) {
+    auto open_request_it =
+        open_block_requests_.find(std::make_pair(dev, sector));
+    if (open_request_it == open_block_requests_.end()) {
+      return std::nullopt;
+    }
+    OpenBlockRequest open_request = open_request_it->second;
+    open_block_requests_.erase(open_request_it);
+    if (timestamp_ns < open_request.issue_timestamp_ns) {
+      return std::nullopt;
+    }
+
+    BlockIoLatency block_io_latency;
+    block_io_latency.set_pid(open_request.pid);
+    block_io_latency.set_tid(open_request.tid);
+    block_io_latency.set_dev(dev);
+    block_io_latency.set_sector(sector);
+    block_io_latency.set_nr_sectors(open_request.nr_sectors);
+    block_io_latency.set_write(open_request.write);
+    block_io_latency.set_issue_timestamp_ns(open_request.issue_timestamp_ns);
+    block_io_latency.set_complete_timestamp_ns(timestamp_ns);
+    block_io_latency.set_error(error);
+    block_io_latency.set_depth(open_request.depth);
+    return block_io_latency;
+  }
+
+  [[nodiscard]] size_t GetOpenSyscallCount() const {
+    return open_syscalls_.size();
+  }
+  [[nodiscard]] size_t GetOpenBlockRequestCount() const {
+    return open_block_requests_.size();
+  }
+
+ private:
+  struct OpenSyscall {
+    pid_t pid;
+    int64_t syscall_nr;
+    uint64_t begin_timestamp_ns;
+    uint32_t depth;
+  };
+
+  struct OpenBlockRequest {
+    pid_t pid;
+    pid_t tid;
+    uint32_t nr_sectors;
+    bool write;
+    uint64_t issue_timestamp_ns;
+    uint32_t depth;
+  };
+
+  // By tid.
+  absl::flat_hash_map<pid_t, OpenSyscall> open_syscalls_;
+  // By device and sector.
+  absl::flat_hash_map<std::pair<uint32_t, uint64_t>, OpenBlockRequest>
+      open_block_requests_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_IO_LATENCY_MANAGER_H_
@@ -0,0 +1,87 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "IoLatencyManager.h"
+
+namespace LinuxTracing {
+
+TEST(IoLatencyManager, MatchesSyscallEntersWithExitsPerThread) {
+  IoLatencyManager manager;
+  manager.ProcessSyscallEnter(10, 11, 0, 100, 1);
+  manager.ProcessSyscallEnter(10, 12, 202, 150, 0);
+  EXPECT_EQ(manager.GetOpenSyscallCount(), 2);
+
+  EXPECT_FALSE(manager.ProcessSyscallExit(13, 0, 200, 0).has_value());
+  std::optional<SyscallLatency> syscall_latency =
+      manager.ProcessSyscallExit(12, 202, 300, -4);
+  ASSERT_TRUE(syscall_latency.has_value());
+  EXPECT_EQ(syscall_latency->pid(), 10);
+  EXPECT_EQ(syscall_latency->tid(), 12);
+  EXPECT_EQ(syscall_latency->syscall_nr(), 202);
+  EXPECT_EQ(syscall_latency->begin_timestamp_ns(), 150);
+  EXPECT_EQ(syscall_latency->end_timestamp_ns(), 300);
+  EXPECT_EQ(syscall_latency->ret(), -4);
+  EXPECT_EQ(syscall_latency->depth(), 0);
+
+  // The exit of another syscall than the one entered.
+  EXPECT_FALSE(manager.ProcessSyscallExit(11, 1, 400, 0).has_value());
+  EXPECT_EQ(manager.GetOpenSyscallCount(), 0);
+
+  // A new syscall of the thread replaces one without exit.
+  manager.ProcessSyscallEnter(10, 11, 59, 500, 0);
+  manager.ProcessSyscallEnter(10, 11, 0, 600, 2);
+  syscall_latency = manager.ProcessSyscallExit(11, 0, 700, 8);
+  ASSERT_TRUE(syscall_latency.has_value());
+  EXPECT_EQ(syscall_latency->begin_timestamp_ns(), 600);
+  EXPECT_EQ(syscall_latency->depth(), 2);
+}
+
+TEST(IoLatencyManager, MatchesBlockRequestsByDeviceAndSector) {
+  IoLatencyManager manager;
+  manager.ProcessBlockRqIssue(10, 11, 0x800001, 2048, 8, false, 100, 1);
+  manager.ProcessBlockRqIssue(10, 12, 0x800002, 2048, 16, true, 150, 0);
+  EXPECT_EQ(manager.GetOpenBlockRequestCount(), 2);
+
+  // The completion of a request that no captured thread issued.
+  EXPECT_FALSE(
+      manager.ProcessBlockRqComplete(0x800001, 4096, 200, 0).has_value());
+  std::optional<BlockIoLatency> block_io_latency =
+      manager.ProcessBlockRqComplete(0x800002, 2048, 400, -5);
+  ASSERT_TRUE(block_io_latency.has_value());
+  EXPECT_EQ(block_io_latency->pid(), 10);
+  EXPECT_EQ(block_io_latency->tid(), 12);
+  EXPECT_EQ(block_io_latency->dev(), 0x800002);
+  EXPECT_EQ(block_io_latency->sector(), 2048);
+  EXPECT_EQ(block_io_latency->nr_sectors(), 16);
+  EXPECT_TRUE(block_io_latency->write());
+  EXPECT_EQ(block_io_latency->issue_timestamp_ns(), 150);
+  EXPECT_EQ(block_io_latency->complete_timestamp_ns(), 400);
+  EXPECT_EQ(block_io_latency->error(), -5);
+  EXPECT_EQ(block_io_latency->depth(), 0);
+
+  block_io_latency = manager.ProcessBlockRqComplete(0x800001, 2048, 500, 0);
+  ASSERT_TRUE(block_io_latency.has_value());
+  EXPECT_EQ(block_io_latency->tid(), 11);
+  EXPECT_FALSE(block_io_latency->write());
+  EXPECT_EQ(block_io_latency->depth(), 1);
+  EXPECT_EQ(manager.GetOpenBlockRequestCount(), 0);
+}
+
+TEST(IoLatencyManager, NestsBlockRequestsInTheSyscallThatIssuedThem) {
+  IoLatencyManager manager;
+  manager.ProcessSyscallEnter(10, 11, 0, 100, 1);
+  manager.ProcessBlockRqIssue(10, 11, 0x800001, 2048, 8, false, 150, 1);
+  std::optional<BlockIoLatency> block_io_latency =
+      manager.ProcessBlockRqComplete(0x800001, 2048, 300, 0);
+  ASSERT_TRUE(block_io_latency.has_value());
+  EXPECT_EQ(block_io_latency->depth(), 2);
+  std::optional<SyscallLatency> syscall_latency =
+      manager.ProcessSyscallExit(11, 0, 350, 4096);
+  ASSERT_TRUE(syscall_latency.has_value());
+  EXPECT_EQ(syscall_latency->depth(), 1);
+}
+
+}  // namespace LinuxTracing
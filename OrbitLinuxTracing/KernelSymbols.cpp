@@ -0,0 +1,91 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <OrbitBase/Logging.h>
+#include <OrbitLinuxTracing/KernelSymbols.h>
+
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <optional>
+
+#include "Utils.h"
+#include "absl/strings/str_split.h"
+
+namespace LinuxTracing {
+
+KernelSymbols::KernelSymbols(std::string_view kallsyms) {
+  absl::call_once(load_once_, [this, kallsyms] { Parse(kallsyms); });
+}
+
+void KernelSymbols::Load() {
+  absl::call_once(load_once_, [this] {
+    std::optional<std::string> kallsyms = ReadFile("/proc/kallsyms");
+    if (!kallsyms.has_value()) {
+      ERROR("Reading /proc/kallsyms: kernel frames are not symbolized");
+      return;
+    }
+    Parse(kallsyms.value());
+    if (symbols_.empty()) {
+      ERROR("No kernel symbols with an address in /proc/kallsyms "
+            "(kptr_restrict?): kernel frames are not symbolized");
+      return;
+    }
+    LOG("Read %lu kernel symbols from /proc/kallsyms", symbols_.size());
+  });
+}
+
+void KernelSymbols::Parse(std::string_view kallsyms) {
+  // Each line is "<address> <type> <name>", followed by "\t[<module>]" for the
+  // symbols of modules.
+  for (std::string_view line : absl::StrSplit(kallsyms, '\n')) {
+    std::vector<std::string_view> fields =
+        absl::StrSplit(line, absl::ByAnyChar(" \t"), absl::SkipEmpty());
+    if (fields.size() < 3 || fields[1].size() != 1) {
+      continue;
+    }
+    // Only the functions, of the text section.
+    char type = fields[1][0];
+    if (type != 't' && type != 'T' && type != 'w' && type != 'W') {
+      continue;
+    }
+    uint64_t address = 0;
+    const char* address_end = fields[0].data() + fields[0].size();
+    std::from_chars_result result =
+        std::from_chars(fields[0].data(), address_end, address, 16);
+    // Without the privileges to see them, all addresses are zero.
+    if (result.ec != std::errc{} || result.ptr != address_end ||
+        address == 0) {
+      continue;
+    }
+    Symbol& symbol = symbols_.emplace_back();
+    symbol.address = address;
+    symbol.name = std::string{fields[2]};
+    symbol.map_name = fields.size() > 3 ? std::string{fields[3]} : "[kernel]";
+  }
+  std::stable_sort(symbols_.begin(), symbols_.end(),
+                   [](const Symbol& lhs, const Symbol& rhs) {
+                     return lhs.address < rhs.address;
+                   });
+}
+
+const KernelSymbols::Symbol* KernelSymbols::Find(uint64_t address) {
+  Load();
+  auto it = std::upper_bound(
+      symbols_.begin(), symbols_.end(), address,
+      [](uint64_t address, const Symbol& symbol) {
+        return address < symbol.address;
+      });
+  if (it == symbols_.begin()) {
+    return nullptr;
+  }
+  return &*std::prev(it);
+}
+
+size_t KernelSymbols::GetSize() {
+  Load();
+  return symbols_.size();
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,52 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <OrbitLinuxTracing/KernelSymbols.h>
+#include <gtest/gtest.h>
+
+namespace LinuxTracing {
+
+TEST(KernelSymbols, FindsFunctionContainingAddress) {
+  KernelSymbols kernel_symbols{
+      "ffffffff81000000 T _stext\n"
+      "ffffffff81001000 t do_one_initcall\n"
+      "ffffffff82000000 D some_data\n"
+      "ffffffffc0002000 t nvme_poll\t[nvme]\n"
+      "ffffffff81000800 T schedule\n"
+      "malformed line\n"};
+  EXPECT_EQ(kernel_symbols.GetSize(), 4);
+
+  EXPECT_EQ(kernel_symbols.Find(0xffffffff80000000), nullptr);
+
+  const KernelSymbols::Symbol* symbol = kernel_symbols.Find(0xffffffff81000810);
+  ASSERT_NE(symbol, nullptr);
+  EXPECT_EQ(symbol->address, 0xffffffff81000800);
+  EXPECT_EQ(symbol->name, "schedule");
+  EXPECT_EQ(symbol->map_name, "[kernel]");
+
+  // Data symbols are skipped.
+  symbol = kernel_symbols.Find(0xffffffff82000010);
+  ASSERT_NE(symbol, nullptr);
+  EXPECT_EQ(symbol->name, "do_one_initcall");
+
+  symbol = kernel_symbols.Find(0xffffffffc0002040);
+  ASSERT_NE(symbol, nullptr);
+  EXPECT_EQ(symbol->name, "nvme_poll");
+  EXPECT_EQ(symbol->map_name, "[nvme]");
+}
+
+TEST(KernelSymbols, SkipsHiddenAddresses) {
+  KernelSymbols kernel_symbols{
+      "0000000000000000 T _stext\n"
+      "0000000000000000 t schedule\n"};
+  EXPECT_EQ(kernel_symbols.GetSize(), 0);
+  EXPECT_EQ(kernel_symbols.Find(0xffffffff81000000), nullptr);
+}
+
+TEST(KernelSymbols, IsKernelAddress) {
+  EXPECT_TRUE(KernelSymbols::IsKernelAddress(0xffffffff81000000));
+  EXPECT_FALSE(KernelSymbols::IsKernelAddress(0x7fffffffe000));
+}
+
+}  // namespace LinuxTracing
@@ -33,6 +33,91 @@ struct __attribute__((__packed__)) task_rename_tracepoint {
   int16_t oom_score_adj;
 };
 
+// Also the format of sched_waking.
+struct __attribute__((__packed__)) sched_wakeup_tracepoint {
+  tracepoint_common common;
+  char comm[16];
+  int32_t pid;
+  int32_t prio;
+  int32_t target_cpu;
+};
+
+struct __attribute__((__packed__)) sched_switch_tracepoint {
+  tracepoint_common common;
+  char prev_comm[16];
+  int32_t prev_pid;
+  int32_t prev_prio;
+  // 0 (TASK_RUNNING) when the thread was preempted, in the lower byte.
+  int64_t prev_state;
+  char next_comm[16];
+  int32_t next_pid;
+  int32_t next_prio;
+};
+
+// The arguments of syscalls are all 8 bytes.
+struct __attribute__((__packed__)) sys_enter_futex_tracepoint {
+  tracepoint_common common;
+  int32_t syscall_nr;
+  int32_t padding;
+  uint64_t uaddr;  // This is an address.
+  uint64_t op;
+  uint64_t val;
+  uint64_t utime;   // This is an address.
+  uint64_t uaddr2;  // This is an address.
+  uint64_t val3;
+};
+
+struct __attribute__((__packed__)) sys_exit_futex_tracepoint {
+  tracepoint_common common;
+  int32_t syscall_nr;
+  int32_t padding;
+  int64_t ret;
+};
+
+struct __attribute__((__packed__)) raw_syscalls_sys_enter_tracepoint {
+  tracepoint_common common;
+  int64_t id;
+  uint64_t args[6];
+};
+
+struct __attribute__((__packed__)) raw_syscalls_sys_exit_tracepoint {
+  tracepoint_common common;
+  int64_t id;
+  int64_t ret;
+};
+
+struct __attribute__((__packed__)) block_rq_issue_tracepoint {
+  tracepoint_common common;
+  uint32_t dev;
+  uint32_t padding;
+  uint64_t sector;
+  uint32_t nr_sector;
+  uint32_t bytes;
+  // E.g., "WS" for a synchronous write, "R" for a read.
+  char rwbs[8];
+  char comm[16];
+  uint32_t cmd;  // __data_loc char[].
+};
+
+struct __attribute__((__packed__)) block_rq_complete_tracepoint {
+  tracepoint_common common;
+  uint32_t dev;
+  uint32_t padding;
+  uint64_t sector;
+  uint32_t nr_sector;
+  int32_t error;
+  char rwbs[8];
+  uint32_t cmd;  // __data_loc char[].
+};
+
+// The format of both power:cpu_frequency and power:cpu_idle. state is the new
+// frequency in kHz, or the idle state entered, (uint32_t)-1 when leaving idle.
+struct __attribute__((__packed__)) cpu_power_tracepoint {
+  tracepoint_common common;
+  uint32_t state;
+  uint32_t cpu_id;
+};
+
 struct __attribute__((__packed__)) amdgpu_cs_ioctl_tracepoint {
   tracepoint_common common;
   uint64_t sched_job_id;
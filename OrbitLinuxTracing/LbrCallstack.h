@@ -0,0 +1,76 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_LBR_CALLSTACK_H_
+#define ORBIT_LINUX_TRACING_LBR_CALLSTACK_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace LinuxTracing {
+
+// The longest x86-64 instruction.
+static constexpr uint64_t MAX_CALL_INSTRUCTION_SIZE = 15;
+
+// Combines the callstack of a sample unwound with frame pointers with the call
+// stack recorded in the last branch records, which gives the address of the
+// call instruction of each of the innermost frames, whether or not the
+// functions set up their frame pointer. frame_pointer_pcs has the address of
+// the sampled instruction as first pc and return addresses minus 1 as the
+// following pcs, call_addresses the address of the call instructions,
+// innermost first.
+// The last branch records only hold a few calls (16 or 32 depending on the
+// CPU): above the outermost of them that the frame pointer callstack also has,
+// i.e., a frame pointer pc inside the same call instruction, the frame pointer
+// callstack is used. If they share no frame, the frame pointer callstack is
+// returned unchanged, unless it's not longer than the callstack from the branch
+// records.
+inline std::vector<uint64_t> MergeLbrCallstack(
+    const std::vector<uint64_t>& frame_pointer_pcs,
+    const std::vector<uint64_t>& call_addresses) {
+  if (frame_pointer_pcs.empty() || call_addresses.empty()) {
+    return frame_pointer_pcs;
+  }
+
+  for (size_t lbr_index = call_addresses.size(); lbr_index > 0; --lbr_index) {
+    const uint64_t call_address = call_addresses[lbr_index - 1];
+    // The frame pointer callstack can miss frames, but not have more inner
+    // frames than the branch records: of a recursive call, use the outermost
+    // occurrence that fits.
+    size_t max_frame_pointer_index =
+        std::min(lbr_index, frame_pointer_pcs.size() - 1);
+    for (size_t frame_pointer_index = max_frame_pointer_index;
+         frame_pointer_index > 0; --frame_pointer_index) {
+      const uint64_t pc = frame_pointer_pcs[frame_pointer_index];
+      if (pc < call_address || pc - call_address >= MAX_CALL_INSTRUCTION_SIZE) {
+        continue;
+      }
+
+      std::vector<uint64_t> merged_pcs;
+      merged_pcs.reserve(lbr_index + frame_pointer_pcs.size() -
+                         frame_pointer_index);
+      merged_pcs.push_back(frame_pointer_pcs[0]);
+      merged_pcs.insert(merged_pcs.end(), call_addresses.begin(),
+                        call_addresses.begin() + lbr_index);
+      merged_pcs.insert(merged_pcs.end(),
+                        frame_pointer_pcs.begin() + frame_pointer_index + 1,
+                        frame_pointer_pcs.end());
+      return merged_pcs;
+    }
+  }
+
+  if (frame_pointer_pcs.size() > call_addresses.size() + 1) {
+    return frame_pointer_pcs;
+  }
+  std::vector<uint64_t> lbr_pcs;
+  lbr_pcs.reserve(call_addresses.size() + 1);
+  lbr_pcs.push_back(frame_pointer_pcs[0]);
+  lbr_pcs.insert(lbr_pcs.end(), call_addresses.begin(), call_addresses.end());
+  return lbr_pcs;
+}
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_LBR_CALLSTACK_H_
@@ -0,0 +1,68 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "LbrCallstack.h"
+
+namespace LinuxTracing {
+
+// The frame pointer pcs are return addresses minus 1, hence the last byte of
+// 5-byte call instructions at 0x20, 0x30, ...: 0x24, 0x34, ...
+
+TEST(MergeLbrCallstack, AgreeingCallstacksAreUnchanged) {
+  std::vector<uint64_t> frame_pointer_pcs{0x10, 0x24, 0x34, 0x44};
+  std::vector<uint64_t> call_addresses{0x20, 0x30, 0x40};
+  EXPECT_THAT(MergeLbrCallstack(frame_pointer_pcs, call_addresses),
+              testing::ElementsAre(0x10, 0x20, 0x30, 0x40));
+}
+
+TEST(MergeLbrCallstack, UsesFramePointersAboveBranchRecords) {
+  std::vector<uint64_t> frame_pointer_pcs{0x10, 0x24, 0x34, 0x44, 0x54};
+  std::vector<uint64_t> call_addresses{0x20, 0x30};
+  EXPECT_THAT(MergeLbrCallstack(frame_pointer_pcs, call_addresses),
+              testing::ElementsAre(0x10, 0x20, 0x30, 0x44, 0x54));
+}
+
+TEST(MergeLbrCallstack, AddsCallerMissedByFramePointers) {
+  // The leaf function doesn't set up its frame pointer, so the frame pointer
+  // chain misses its caller at 0x20.
+  std::vector<uint64_t> frame_pointer_pcs{0x10, 0x34, 0x44, 0x54};
+  std::vector<uint64_t> call_addresses{0x20, 0x30, 0x40};
+  EXPECT_THAT(MergeLbrCallstack(frame_pointer_pcs, call_addresses),
+              testing::ElementsAre(0x10, 0x20, 0x30, 0x40, 0x54));
+}
+
+TEST(MergeLbrCallstack, ReplacesBrokenFramePointerFrames) {
+  std::vector<uint64_t> frame_pointer_pcs{0x10, 0xBAD, 0x34, 0x44};
+  std::vector<uint64_t> call_addresses{0x20, 0x30};
+  EXPECT_THAT(MergeLbrCallstack(frame_pointer_pcs, call_addresses),
+              testing::ElementsAre(0x10, 0x20, 0x30, 0x44));
+}
+
+TEST(MergeLbrCallstack, UsesOutermostFittingOccurrenceOfRecursiveFrame) {
+  std::vector<uint64_t> frame_pointer_pcs{0x10, 0x24, 0x24, 0x24, 0x44};
+  std::vector<uint64_t> call_addresses{0x20, 0x20};
+  EXPECT_THAT(MergeLbrCallstack(frame_pointer_pcs, call_addresses),
+              testing::ElementsAre(0x10, 0x20, 0x20, 0x24, 0x44));
+}
+
+TEST(MergeLbrCallstack, WithoutSharedFrameUsesLongerCallstack) {
+  std::vector<uint64_t> frame_pointer_pcs{0x10, 0xBAD, 0xBAD};
+  EXPECT_THAT(MergeLbrCallstack(frame_pointer_pcs, {0x20}),
+              testing::ElementsAre(0x10, 0xBAD, 0xBAD));
+  EXPECT_THAT(MergeLbrCallstack(frame_pointer_pcs, {0x20, 0x30}),
+              testing::ElementsAre(0x10, 0x20, 0x30));
+}
+
+TEST(MergeLbrCallstack, WithoutBranchRecordsUsesFramePointers) {
+  std::vector<uint64_t> frame_pointer_pcs{0x10, 0x24};
+  EXPECT_THAT(MergeLbrCallstack(frame_pointer_pcs, {}),
+              testing::ElementsAre(0x10, 0x24));
+}
+
+}  // namespace LinuxTracing
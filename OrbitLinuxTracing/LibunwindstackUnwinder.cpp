@@ -6,10 +6,40 @@
 
 #include <OrbitBase/Logging.h>
 
+#include <algorithm>
 #include <array>
+#include <climits>
+#include <mutex>
+#include <string_view>
+
+#include "absl/hash/hash.h"
 
 namespace LinuxTracing {
 
+namespace {
+// Forwards the reads to memory, recording the end of the highest one.
+class ReadRecordingMemory : public unwindstack::Memory {
+ public:
+  explicit ReadRecordingMemory(std::shared_ptr<unwindstack::Memory> memory)
+      : memory_{std::move(memory)} {}
+
+  size_t Read(uint64_t addr, void* dst, size_t size) override {
+    read_end_ = std::max(read_end_, addr + size);
+    return memory_->Read(addr, dst, size);
+  }
+
+  [[nodiscard]] uint64_t GetReadEnd() const { return read_end_; }
+
+ private:
+  std::shared_ptr<unwindstack::Memory> memory_;
+  uint64_t read_end_ = 0;
+};
+
+uint64_t HashStackBytes(const char* stack_dump, uint64_t size) {
+  return absl::Hash<std::string_view>{}(std::string_view{stack_dump, size});
+}
+}  // namespace
+
 std::unique_ptr<unwindstack::BufferMaps> LibunwindstackUnwinder::ParseMaps(
     const std::string& maps_buffer) {
   auto maps = std::make_unique<unwindstack::BufferMaps>(maps_buffer.c_str());
@@ -19,6 +49,68 @@ std::unique_ptr<unwindstack::BufferMaps> LibunwindstackUnwinder::ParseMaps(
   return maps;
 }
 
+std::unique_ptr<unwindstack::Maps> LibunwindstackUnwinder::AddMap(
+    unwindstack::Maps* maps, uint64_t start, uint64_t end, uint64_t offset,
+    uint16_t flags, const std::string& name) {
+  struct MapPiece {
+    uint64_t start;
+    uint64_t end;
+    uint64_t offset;
+    uint16_t flags;
+    std::string name;
+    // The MapInfo this piece is an unchanged copy of, if any.
+    unwindstack::MapInfo* original;
+  };
+  std::vector<MapPiece> pieces;
+  for (const std::unique_ptr<unwindstack::MapInfo>& map_info : *maps) {
+    if (map_info->end <= start || map_info->start >= end) {
+      pieces.push_back(MapPiece{map_info->start, map_info->end,
+                                map_info->offset, map_info->flags,
+                                map_info->name, map_info.get()});
+      continue;
+    }
+    // Keep what is left of an existing map before and after the new one.
+    if (map_info->start < start) {
+      pieces.push_back(MapPiece{map_info->start, start, map_info->offset,
+                                map_info->flags, map_info->name, nullptr});
+    }
+    if (map_info->end > end) {
+      pieces.push_back(MapPiece{end, map_info->end,
+                                map_info->offset + (end - map_info->start),
+                                map_info->flags, map_info->name, nullptr});
+    }
+  }
+  pieces.push_back(MapPiece{start, end, offset, flags, name, nullptr});
+  std::sort(pieces.begin(), pieces.end(),
+            [](const MapPiece& lhs, const MapPiece& rhs) {
+              return lhs.start < rhs.start;
+            });
+
+  // Maps::Add sets MapInfo::prev_map, hence add the maps in order.
+  auto new_maps = std::make_unique<unwindstack::Maps>();
+  for (const MapPiece& piece : pieces) {
+    if (piece.original == nullptr) {
+      // Like in the constructor of MapInfo, INT64_MAX means that the load bias
+      // hasn't been computed yet.
+      new_maps->Add(piece.start, piece.end, piece.offset, piece.flags,
+                    piece.name, INT64_MAX);
+      continue;
+    }
+
+    unwindstack::MapInfo* original = piece.original;
+    new_maps->Add(piece.start, piece.end, piece.offset, piece.flags, piece.name,
+                  original->load_bias);
+    unwindstack::MapInfo* copy = (new_maps->end() - 1)->get();
+    // MapInfo::GetElf creates the Elf while holding this mutex.
+    std::lock_guard<std::mutex> lock{original->mutex_};
+    copy->elf = original->elf;
+    copy->elf_offset = original->elf_offset;
+    copy->elf_start_offset = original->elf_start_offset;
+    copy->memory_backed_elf = original->memory_backed_elf;
+  }
+  return new_maps;
+}
+
 const std::array<size_t, unwindstack::X86_64_REG_LAST>
     LibunwindstackUnwinder::UNWINDSTACK_REGS_TO_PERF_REGS{
         PERF_REG_X86_AX,  PERF_REG_X86_DX,  PERF_REG_X86_CX,  PERF_REG_X86_BX,
@@ -32,6 +124,22 @@ std::vector<unwindstack::FrameData> LibunwindstackUnwinder::Unwind(
     unwindstack::Maps* maps,
     const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
     const char* stack_dump, uint64_t stack_dump_size) {
+  return Unwind(maps, perf_regs, stack_dump, stack_dump_size, false);
+}
+
+std::vector<unwindstack::FrameData>
+LibunwindstackUnwinder::UnwindInnermostFrames(
+    unwindstack::Maps* maps,
+    const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
+    const char* stack_dump, uint64_t stack_dump_size) {
+  return Unwind(maps, perf_regs, stack_dump, stack_dump_size, true);
+}
+
+std::vector<unwindstack::FrameData> LibunwindstackUnwinder::Unwind(
+    unwindstack::Maps* maps,
+    const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
+    const char* stack_dump, uint64_t stack_dump_size,
+    bool keep_frames_on_error, uint64_t* stack_read_end) {
   unwindstack::RegsX86_64 regs{};
   for (size_t perf_reg = 0; perf_reg < unwindstack::X86_64_REG_LAST;
        ++perf_reg) {
@@ -44,21 +152,31 @@ std::vector<unwindstack::FrameData> LibunwindstackUnwinder::Unwind(
           regs[unwindstack::X86_64_REG_RSP],
           regs[unwindstack::X86_64_REG_RSP] + stack_dump_size);
 
+  std::shared_ptr<ReadRecordingMemory> read_recording_memory;
+  if (stack_read_end != nullptr) {
+    read_recording_memory = std::make_shared<ReadRecordingMemory>(memory);
+    memory = read_recording_memory;
+  }
+
   unwindstack::Unwinder unwinder{MAX_FRAMES, maps, &regs, memory};
   // Careful: regs are modified. Use regs.Clone() if you need to reuse regs
   // later.
   unwinder.Unwind();
+  if (stack_read_end != nullptr) {
+    *stack_read_end = read_recording_memory->GetReadEnd();
+  }
 
   // Samples that fall inside a function dynamically-instrumented with
   // uretprobes often result in unwinding errors when hitting the trampoline
   // inserted by the uretprobe. Do not treat them as errors as we might want
   // those callstacks.
-  if (unwinder.LastErrorCode() != 0 &&
+  if (!keep_frames_on_error && unwinder.LastErrorCode() != 0 &&
       unwinder.frames().back().map_name != "[uprobes]") {
 #ifndef NDEBUG
-    ERROR("%s at %#016lx",
-          LibunwindstackErrorString(unwinder.LastErrorCode()).c_str(),
-          unwinder.LastErrorAddress());
+    ERROR_RATE_LIMITED(
+        "%s at %#016lx",
+        LibunwindstackErrorString(unwinder.LastErrorCode()).c_str(),
+        unwinder.LastErrorAddress());
 #endif
     return {};
   }
@@ -66,6 +184,58 @@ std::vector<unwindstack::FrameData> LibunwindstackUnwinder::Unwind(
   return unwinder.frames();
 }
 
+std::vector<unwindstack::FrameData> LibunwindstackUnwinder::UnwindWithMemo(
+    pid_t tid, const std::shared_ptr<unwindstack::Maps>& maps,
+    const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
+    const char* stack_dump, uint64_t stack_dump_size, bool* memo_hit) {
+  const uint64_t ip = perf_regs[PERF_REG_X86_IP];
+  const uint64_t sp = perf_regs[PERF_REG_X86_SP];
+  const uint64_t bp = perf_regs[PERF_REG_X86_BP];
+  {
+    absl::MutexLock lock{&memo_mutex_};
+    auto entry_it = memo_entries_by_tid_.find(tid);
+    if (entry_it != memo_entries_by_tid_.end()) {
+      const MemoEntry& entry = entry_it->second;
+      if (entry.maps.lock() == maps && entry.ip == ip && entry.sp == sp &&
+          entry.bp == bp && entry.read_stack_size <= stack_dump_size &&
+          (!entry.read_past_stack_dump ||
+           entry.stack_dump_size == stack_dump_size) &&
+          HashStackBytes(stack_dump, entry.read_stack_size) ==
+              entry.read_stack_hash) {
+        *memo_hit = true;
+        return entry.frames;
+      }
+    }
+  }
+
+  *memo_hit = false;
+  uint64_t stack_read_end = 0;
+  std::vector<unwindstack::FrameData> frames =
+      Unwind(maps.get(), perf_regs, stack_dump, stack_dump_size,
+             /*keep_frames_on_error=*/false, &stack_read_end);
+
+  MemoEntry entry;
+  entry.maps = maps;
+  entry.ip = ip;
+  entry.sp = sp;
+  entry.bp = bp;
+  // The reads below the stack pointer fail whatever the stack dump.
+  const uint64_t read_size = stack_read_end > sp ? stack_read_end - sp : 0;
+  entry.read_past_stack_dump = read_size > stack_dump_size;
+  entry.read_stack_size = std::min(read_size, stack_dump_size);
+  entry.read_stack_hash = HashStackBytes(stack_dump, entry.read_stack_size);
+  entry.stack_dump_size = stack_dump_size;
+  entry.frames = frames;
+
+  absl::MutexLock lock{&memo_mutex_};
+  if (memo_entries_by_tid_.size() >= MAX_MEMO_ENTRIES &&
+      !memo_entries_by_tid_.contains(tid)) {
+    memo_entries_by_tid_.clear();
+  }
+  memo_entries_by_tid_.insert_or_assign(tid, std::move(entry));
+  return frames;
+}
+
 std::vector<unwindstack::FrameData> LibunwindstackUnwinder::Unwind(
     const std::string& maps_buffer,
     const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
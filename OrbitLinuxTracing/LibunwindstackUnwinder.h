@@ -6,13 +6,18 @@
 #define ORBIT_LINUX_TRACING_LIBUNWINDSTACK_UNWINDER_H_
 
 #include <asm/perf_regs.h>
+#include <sys/types.h>
 #include <unwindstack/MachineX86_64.h>
 #include <unwindstack/RegsX86_64.h>
 #include <unwindstack/Unwinder.h>
 
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
 namespace LinuxTracing {
 
 class LibunwindstackUnwinder {
@@ -20,19 +25,77 @@ class LibunwindstackUnwinder {
   static std::unique_ptr<unwindstack::BufferMaps> ParseMaps(
       const std::string& maps_buffer);
 
+  // Returns a copy of maps in which the new map replaces the parts of the
+  // existing maps it overlaps with, like mmap does. The maps that are copied
+  // unchanged share their Elf objects with the original ones, so that the
+  // information cached in them is not lost. The original maps are not modified,
+  // as they might still be in use for unwinding on other threads.
+  static std::unique_ptr<unwindstack::Maps> AddMap(
+      unwindstack::Maps* maps, uint64_t start, uint64_t end, uint64_t offset,
+      uint16_t flags, const std::string& name);
+
   std::vector<unwindstack::FrameData> Unwind(
       unwindstack::Maps* maps,
       const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
       const char* stack_dump, uint64_t stack_dump_size);
 
+  // Like Unwind, but when unwinding fails, e.g., because the stack dump only
+  // contains the top of the stack, returns the frames unwound until then
+  // instead of no frames.
+  std::vector<unwindstack::FrameData> UnwindInnermostFrames(
+      unwindstack::Maps* maps,
+      const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
+      const char* stack_dump, uint64_t stack_dump_size);
+
   std::vector<unwindstack::FrameData> Unwind(
       const std::string& maps_buffer,
       const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
       const char* stack_dump, uint64_t stack_dump_size);
 
+  // Like Unwind, for a stack sample of thread tid, but returns the frames of
+  // the previous sample of tid, without unwinding, if the sample is the same
+  // for unwinding: same maps, same instruction, stack and frame pointers, and
+  // same bytes in the part of the stack dump that unwinding read. This is
+  // typical of a thread that keeps waiting in the same place. Other registers
+  // are not compared, as they only matter for unusual CFI. Sets *memo_hit to
+  // whether the frames were reused. Can be called from several threads.
+  std::vector<unwindstack::FrameData> UnwindWithMemo(
+      pid_t tid, const std::shared_ptr<unwindstack::Maps>& maps,
+      const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
+      const char* stack_dump, uint64_t stack_dump_size, bool* memo_hit);
+
  private:
   static constexpr size_t MAX_FRAMES = 1024;  // This is arbitrary.
 
+  // If stack_read_end is not nullptr, it is set to the end of the highest
+  // read of the stack that unwinding attempted, successful or not.
+  std::vector<unwindstack::FrameData> Unwind(
+      unwindstack::Maps* maps,
+      const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
+      const char* stack_dump, uint64_t stack_dump_size,
+      bool keep_frames_on_error, uint64_t* stack_read_end = nullptr);
+
+  // The last sample of a thread unwound by UnwindWithMemo. Only the hash of
+  // the bytes of the stack dump that were read is kept, from the stack
+  // pointer on. When unwinding read past the end of the stack dump, the
+  // frames also depend on its size.
+  struct MemoEntry {
+    std::weak_ptr<unwindstack::Maps> maps;
+    uint64_t ip = 0;
+    uint64_t sp = 0;
+    uint64_t bp = 0;
+    uint64_t read_stack_size = 0;
+    uint64_t read_stack_hash = 0;
+    bool read_past_stack_dump = false;
+    uint64_t stack_dump_size = 0;
+    std::vector<unwindstack::FrameData> frames;
+  };
+  // The entries of the threads that exited are only removed when there are
+  // too many.
+  static constexpr size_t MAX_MEMO_ENTRIES = 4096;
+  absl::Mutex memo_mutex_;
+  absl::flat_hash_map<pid_t, MemoEntry> memo_entries_by_tid_;
+
   static const std::array<size_t, unwindstack::X86_64_REG_LAST>
       UNWINDSTACK_REGS_TO_PERF_REGS;
 
@@ -0,0 +1,139 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+
+#include <array>
+#include <climits>
+#include <memory>
+
+#include "LibunwindstackUnwinder.h"
+
+namespace LinuxTracing {
+
+namespace {
+void ExpectMapInfo(unwindstack::MapInfo* map_info, uint64_t start,
+                   uint64_t end, uint64_t offset, uint16_t flags,
+                   const std::string& name) {
+  EXPECT_EQ(map_info->start, start);
+  EXPECT_EQ(map_info->end, end);
+  EXPECT_EQ(map_info->offset, offset);
+  EXPECT_EQ(map_info->flags, flags);
+  EXPECT_EQ(map_info->name, name);
+}
+
+std::unique_ptr<unwindstack::Maps> CreateMaps() {
+  auto maps = std::make_unique<unwindstack::Maps>();
+  maps->Add(0x1000, 0x2000, 0, PROT_READ, "/path/to/a", INT64_MAX);
+  maps->Add(0x2000, 0x4000, 0x1000, PROT_READ | PROT_EXEC, "/path/to/a",
+            INT64_MAX);
+  maps->Add(0x8000, 0x9000, 0, PROT_READ | PROT_WRITE, "", INT64_MAX);
+  return maps;
+}
+}  // namespace
+
+TEST(LibunwindstackUnwinder, AddMapWithoutOverlap) {
+  std::unique_ptr<unwindstack::Maps> maps = CreateMaps();
+  std::unique_ptr<unwindstack::Maps> new_maps = LibunwindstackUnwinder::AddMap(
+      maps.get(), 0x5000, 0x6000, 0x2000, PROT_READ | PROT_EXEC, "/path/to/b");
+
+  ASSERT_EQ(new_maps->Total(), 4);
+  auto it = new_maps->begin();
+  ExpectMapInfo((it++)->get(), 0x1000, 0x2000, 0, PROT_READ, "/path/to/a");
+  ExpectMapInfo((it++)->get(), 0x2000, 0x4000, 0x1000, PROT_READ | PROT_EXEC,
+                "/path/to/a");
+  ExpectMapInfo((it++)->get(), 0x5000, 0x6000, 0x2000, PROT_READ | PROT_EXEC,
+                "/path/to/b");
+  ExpectMapInfo((it++)->get(), 0x8000, 0x9000, 0, PROT_READ | PROT_WRITE, "");
+
+  // The original maps are left untouched.
+  EXPECT_EQ(maps->Total(), 3);
+}
+
+TEST(LibunwindstackUnwinder, AddMapAtTheBeginningAndAtTheEnd) {
+  std::unique_ptr<unwindstack::Maps> maps = CreateMaps();
+  maps = LibunwindstackUnwinder::AddMap(maps.get(), 0x0, 0x1000, 0,
+                                        PROT_EXEC, "/path/to/b");
+  maps = LibunwindstackUnwinder::AddMap(maps.get(), 0x9000, 0xa000, 0,
+                                        PROT_EXEC, "/path/to/c");
+
+  ASSERT_EQ(maps->Total(), 5);
+  EXPECT_EQ(maps->begin()->get()->name, "/path/to/b");
+  EXPECT_EQ((maps->end() - 1)->get()->name, "/path/to/c");
+  EXPECT_EQ((maps->end() - 1)->get()->prev_map, (maps->end() - 2)->get());
+}
+
+TEST(LibunwindstackUnwinder, AddMapSplitsOverlappingMap) {
+  std::unique_ptr<unwindstack::Maps> maps = CreateMaps();
+  std::unique_ptr<unwindstack::Maps> new_maps = LibunwindstackUnwinder::AddMap(
+      maps.get(), 0x2800, 0x3000, 0, PROT_READ | PROT_EXEC, "");
+
+  ASSERT_EQ(new_maps->Total(), 5);
+  auto it = new_maps->begin();
+  ExpectMapInfo((it++)->get(), 0x1000, 0x2000, 0, PROT_READ, "/path/to/a");
+  ExpectMapInfo((it++)->get(), 0x2000, 0x2800, 0x1000, PROT_READ | PROT_EXEC,
+                "/path/to/a");
+  ExpectMapInfo((it++)->get(), 0x2800, 0x3000, 0, PROT_READ | PROT_EXEC, "");
+  ExpectMapInfo((it++)->get(), 0x3000, 0x4000, 0x2000, PROT_READ | PROT_EXEC,
+                "/path/to/a");
+  ExpectMapInfo((it++)->get(), 0x8000, 0x9000, 0, PROT_READ | PROT_WRITE, "");
+}
+
+TEST(LibunwindstackUnwinder, AddMapReplacesCoveredMaps) {
+  std::unique_ptr<unwindstack::Maps> maps = CreateMaps();
+  std::unique_ptr<unwindstack::Maps> new_maps = LibunwindstackUnwinder::AddMap(
+      maps.get(), 0x1800, 0x8800, 0x800, PROT_READ | PROT_EXEC, "/path/to/b");
+
+  ASSERT_EQ(new_maps->Total(), 3);
+  auto it = new_maps->begin();
+  ExpectMapInfo((it++)->get(), 0x1000, 0x1800, 0, PROT_READ, "/path/to/a");
+  ExpectMapInfo((it++)->get(), 0x1800, 0x8800, 0x800, PROT_READ | PROT_EXEC,
+                "/path/to/b");
+  ExpectMapInfo((it++)->get(), 0x8800, 0x9000, 0x800, PROT_READ | PROT_WRITE,
+                "");
+
+  EXPECT_EQ(new_maps->Find(0x2000)->name, "/path/to/b");
+}
+
+TEST(LibunwindstackUnwinder, UnwindWithMemoReusesFramesOfSameSample) {
+  LibunwindstackUnwinder unwinder;
+  std::shared_ptr<unwindstack::Maps> maps = CreateMaps();
+  std::array<uint64_t, PERF_REG_X86_64_MAX> registers{};
+  // Not in any map, hence unwinding stops without reading the stack.
+  registers[PERF_REG_X86_IP] = 0xa000;
+  registers[PERF_REG_X86_SP] = 0x7f00;
+  std::array<char, 64> stack{};
+
+  bool memo_hit = true;
+  unwinder.UnwindWithMemo(1, maps, registers, stack.data(), stack.size(),
+                          &memo_hit);
+  EXPECT_FALSE(memo_hit);
+  unwinder.UnwindWithMemo(1, maps, registers, stack.data(), stack.size(),
+                          &memo_hit);
+  EXPECT_TRUE(memo_hit);
+
+  // The bytes of the stack that were not read don't matter.
+  stack[8] = 1;
+  unwinder.UnwindWithMemo(1, maps, registers, stack.data(), stack.size(),
+                          &memo_hit);
+  EXPECT_TRUE(memo_hit);
+
+  unwinder.UnwindWithMemo(2, maps, registers, stack.data(), stack.size(),
+                          &memo_hit);
+  EXPECT_FALSE(memo_hit);
+
+  registers[PERF_REG_X86_SP] = 0x7f08;
+  unwinder.UnwindWithMemo(1, maps, registers, stack.data(), stack.size(),
+                          &memo_hit);
+  EXPECT_FALSE(memo_hit);
+
+  std::shared_ptr<unwindstack::Maps> new_maps = LibunwindstackUnwinder::AddMap(
+      maps.get(), 0x5000, 0x6000, 0, PROT_READ | PROT_EXEC, "/path/to/b");
+  unwinder.UnwindWithMemo(1, new_maps, registers, stack.data(), stack.size(),
+                          &memo_hit);
+  EXPECT_FALSE(memo_hit);
+}
+
+}  // namespace LinuxTracing
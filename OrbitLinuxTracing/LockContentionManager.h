@@ -0,0 +1,116 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_LOCK_CONTENTION_MANAGER_H_
+#define ORBIT_LINUX_TRACING_LOCK_CONTENTION_MANAGER_H_
+
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/container/node_hash_map.h"
+#include "capture.pb.h"
+
+namespace LinuxTracing {
+
+// Matches the futex waits of each thread with the return of their syscall,
+// and aggregates the waits in LockContentionStats per process, lock and
+// callstack, so that only the long waits need to be sent one by one. The
+// events of a thread must be processed in order.
+class LockContentionManager {
+ public:
+  void ProcessWaitBegin(pid_t pid, pid_t tid, uint64_t lock_address,
+                        uint64_t timestamp_ns, uint32_t depth,
+                        Callstack callstack) {
+    // A wait without a return, e.g., of a thread that was killed, is replaced.
+    open_waits_.insert_or_assign(
+        tid, OpenWait{pid, lock_address, timestamp_ns, depth,
+                      std::move(callstack)});
+  }
+
+  // Returns the wait ended by the return of a futex syscall of tid, if any.
+  // Waits that timed out, e.g., of condition variables, are neither returned
+  // nor aggregated.
+  std::optional<LockWait> ProcessFutexExit(pid_t tid, uint64_t timestamp_ns,
+                                           int64_t ret) {
+    auto open_wait_it = open_waits_.find(tid);
+    if (open_wait_it == open_waits_.end()) {
+      return std::nullopt;
+    }
+    OpenWait open_wait = std::move(open_wait_it->second);
+    open_waits_.erase(open_wait_it);
+    if (ret == -ETIMEDOUT || timestamp_ns < open_wait.begin_timestamp_ns) {
+      return std::nullopt;
+    }
+
+    const uint64_t duration_ns = timestamp_ns - open_wait.begin_timestamp_ns;
+    StatsKey key{open_wait.pid, open_wait.lock_address,
+                 {open_wait.callstack.pcs().begin(),
+                  open_wait.callstack.pcs().end()}};
+    auto [stats_it, inserted] = stats_.try_emplace(std::move(key));
+    LockContentionStats& stats = stats_it->second;
+    if (inserted) {
+      stats.set_pid(open_wait.pid);
+      stats.set_lock_address(open_wait.lock_address);
+      *stats.mutable_callstack() = std::move(open_wait.callstack);
+    }
+    stats.set_wait_count(stats.wait_count() + 1);
+    stats.set_total_wait_duration_ns(stats.total_wait_duration_ns() +
+                                     duration_ns);
+    stats.set_max_wait_duration_ns(
+        std::max(stats.max_wait_duration_ns(), duration_ns));
+    changed_stats_.insert(&stats);
+
+    LockWait lock_wait;
+    lock_wait.set_pid(open_wait.pid);
+    lock_wait.set_tid(tid);
+    lock_wait.set_lock_address(open_wait.lock_address);
+    lock_wait.set_begin_timestamp_ns(open_wait.begin_timestamp_ns);
+    lock_wait.set_end_timestamp_ns(timestamp_ns);
+    lock_wait.set_depth(open_wait.depth);
+    return lock_wait;
+  }
+
+  // The stats of the locks and callstacks waited on since the last call.
+  [[nodiscard]] std::vector<LockContentionStats> TakeChangedStats() {
+    std::vector<LockContentionStats> changed_stats;
+    changed_stats.reserve(changed_stats_.size());
+    for (const LockContentionStats* stats : changed_stats_) {
+      changed_stats.push_back(*stats);
+    }
+    changed_stats_.clear();
+    return changed_stats;
+  }
+
+  [[nodiscard]] size_t GetOpenWaitCount() const { return open_waits_.size(); }
+
+ private:
+  struct OpenWait {
+    pid_t pid;
+    uint64_t lock_address;
+    uint64_t begin_timestamp_ns;
+    uint32_t depth;
+    Callstack callstack;
+  };
+
+  using StatsKey = std::tuple<pid_t, uint64_t, std::vector<uint64_t>>;
+
+  // By tid.
+  absl::flat_hash_map<pid_t, OpenWait> open_waits_;
+  // A node_hash_map, as changed_stats_ points into it.
+  absl::node_hash_map<StatsKey, LockContentionStats> stats_;
+  absl::flat_hash_set<const LockContentionStats*> changed_stats_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_LOCK_CONTENTION_MANAGER_H_
@@ -0,0 +1,93 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "LockContentionManager.h"
+
+namespace LinuxTracing {
+
+namespace {
+Callstack MakeCallstack(std::vector<uint64_t> pcs) {
+  Callstack callstack;
+  for (uint64_t pc : pcs) {
+    callstack.add_pcs(pc);
+  }
+  return callstack;
+}
+}  // namespace
+
+TEST(LockContentionManager, MatchesWaitsWithExitsPerThread) {
+  LockContentionManager manager;
+  manager.ProcessWaitBegin(10, 11, 0x1000, 100, 2, MakeCallstack({1, 2}));
+  manager.ProcessWaitBegin(10, 12, 0x1000, 150, 0, MakeCallstack({1, 2}));
+  EXPECT_EQ(manager.GetOpenWaitCount(), 2);
+
+  EXPECT_FALSE(manager.ProcessFutexExit(13, 200, 0).has_value());
+  std::optional<LockWait> lock_wait = manager.ProcessFutexExit(12, 300, 0);
+  ASSERT_TRUE(lock_wait.has_value());
+  EXPECT_EQ(lock_wait->pid(), 10);
+  EXPECT_EQ(lock_wait->tid(), 12);
+  EXPECT_EQ(lock_wait->lock_address(), 0x1000);
+  EXPECT_EQ(lock_wait->begin_timestamp_ns(), 150);
+  EXPECT_EQ(lock_wait->end_timestamp_ns(), 300);
+  EXPECT_EQ(lock_wait->depth(), 0);
+
+  lock_wait = manager.ProcessFutexExit(11, 400, 0);
+  ASSERT_TRUE(lock_wait.has_value());
+  EXPECT_EQ(lock_wait->depth(), 2);
+  EXPECT_EQ(manager.GetOpenWaitCount(), 0);
+  // The exit of a futex wake.
+  EXPECT_FALSE(manager.ProcessFutexExit(11, 500, 1).has_value());
+
+  std::vector<LockContentionStats> stats = manager.TakeChangedStats();
+  ASSERT_EQ(stats.size(), 1);
+  EXPECT_EQ(stats[0].pid(), 10);
+  EXPECT_EQ(stats[0].lock_address(), 0x1000);
+  EXPECT_EQ(stats[0].callstack().pcs_size(), 2);
+  EXPECT_EQ(stats[0].wait_count(), 2);
+  EXPECT_EQ(stats[0].total_wait_duration_ns(), 450);
+  EXPECT_EQ(stats[0].max_wait_duration_ns(), 300);
+}
+
+TEST(LockContentionManager, AggregatesPerLockAndCallstack) {
+  LockContentionManager manager;
+  manager.ProcessWaitBegin(10, 11, 0x1000, 100, 0, MakeCallstack({1, 2}));
+  ASSERT_TRUE(manager.ProcessFutexExit(11, 200, 0).has_value());
+  manager.ProcessWaitBegin(10, 11, 0x1000, 300, 0, MakeCallstack({1, 3}));
+  ASSERT_TRUE(manager.ProcessFutexExit(11, 350, 0).has_value());
+  manager.ProcessWaitBegin(10, 11, 0x2000, 400, 0, MakeCallstack({1, 2}));
+  ASSERT_TRUE(manager.ProcessFutexExit(11, 410, 0).has_value());
+  EXPECT_EQ(manager.TakeChangedStats().size(), 3);
+  EXPECT_TRUE(manager.TakeChangedStats().empty());
+
+  // Only the stats that changed, with the totals from the start.
+  manager.ProcessWaitBegin(10, 11, 0x1000, 500, 0, MakeCallstack({1, 2}));
+  ASSERT_TRUE(manager.ProcessFutexExit(11, 520, 0).has_value());
+  std::vector<LockContentionStats> stats = manager.TakeChangedStats();
+  ASSERT_EQ(stats.size(), 1);
+  EXPECT_EQ(stats[0].lock_address(), 0x1000);
+  EXPECT_EQ(stats[0].callstack().pcs(1), 2);
+  EXPECT_EQ(stats[0].wait_count(), 2);
+  EXPECT_EQ(stats[0].total_wait_duration_ns(), 120);
+  EXPECT_EQ(stats[0].max_wait_duration_ns(), 100);
+}
+
+TEST(LockContentionManager, IgnoresWaitsThatTimedOut) {
+  LockContentionManager manager;
+  manager.ProcessWaitBegin(10, 11, 0x1000, 100, 0, MakeCallstack({1}));
+  EXPECT_FALSE(manager.ProcessFutexExit(11, 200, -ETIMEDOUT).has_value());
+  EXPECT_EQ(manager.GetOpenWaitCount(), 0);
+  EXPECT_TRUE(manager.TakeChangedStats().empty());
+
+  // A new wait of the thread replaces one without exit.
+  manager.ProcessWaitBegin(10, 11, 0x1000, 300, 0, MakeCallstack({1}));
+  manager.ProcessWaitBegin(10, 11, 0x2000, 400, 0, MakeCallstack({1}));
+  std::optional<LockWait> lock_wait = manager.ProcessFutexExit(11, 450, 0);
+  ASSERT_TRUE(lock_wait.has_value());
+  EXPECT_EQ(lock_wait->lock_address(), 0x2000);
+  EXPECT_EQ(lock_wait->begin_timestamp_ns(), 400);
+}
+
+}  // namespace LinuxTracing
@@ -19,6 +19,18 @@ class ManualInstrumentationConfig {
     timer_stop_addresses_.insert(address);
   }
 
+  void AddTimerStartAsyncAddress(uint64_t address) {
+    timer_start_async_addresses_.insert(address);
+  }
+
+  void AddTimerStopAsyncAddress(uint64_t address) {
+    timer_stop_async_addresses_.insert(address);
+  }
+
+  void AddFrameMarkerAddress(uint64_t address) {
+    frame_marker_addresses_.insert(address);
+  }
+
   bool IsTimerStartAddress(uint64_t address) const {
     return timer_start_addresses_.contains(address);
   }
@@ -27,9 +39,35 @@ class ManualInstrumentationConfig {
     return timer_stop_addresses_.contains(address);
   }
 
+  bool IsTimerStartAsyncAddress(uint64_t address) const {
+    return timer_start_async_addresses_.contains(address);
+  }
+
+  bool IsTimerStopAsyncAddress(uint64_t address) const {
+    return timer_stop_async_addresses_.contains(address);
+  }
+
+  bool IsFrameMarkerAddress(uint64_t address) const {
+    return frame_marker_addresses_.contains(address);
+  }
+
+  // Whether the function only needs uprobes, as what happens on return
+  // doesn't matter.
+  bool IsUprobesOnlyAddress(uint64_t address) const {
+    return IsTimerStartAddress(address) || IsTimerStartAsyncAddress(address) ||
+           IsTimerStopAsyncAddress(address) || IsFrameMarkerAddress(address);
+  }
+
+  bool IsManualInstrumentationAddress(uint64_t address) const {
+    return IsUprobesOnlyAddress(address) || IsTimerStopAddress(address);
+  }
+
  private:
   absl::flat_hash_set<uint64_t> timer_start_addresses_;
   absl::flat_hash_set<uint64_t> timer_stop_addresses_;
+  absl::flat_hash_set<uint64_t> timer_start_async_addresses_;
+  absl::flat_hash_set<uint64_t> timer_stop_async_addresses_;
+  absl::flat_hash_set<uint64_t> frame_marker_addresses_;
 };
 
 #endif
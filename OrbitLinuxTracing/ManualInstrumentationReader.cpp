@@ -0,0 +1,250 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ManualInstrumentationReader.h"
+
+#include <OrbitBase/Logging.h>
+#include <OrbitBase/SafeStrerror.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include "Utils.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+
+namespace LinuxTracing {
+
+namespace {
+// Longer names are cut.
+constexpr size_t kMaxNameLength = 256;
+// Only if the kernel doesn't publish the rate of the TSC.
+constexpr absl::Duration kTscCalibrationDuration = absl::Milliseconds(10);
+
+// Maps the buffer at path if it belongs to pid and tid, is initialized, and
+// its clock can be converted.
+orbit_api::SharedMemoryBuffer* MapBuffer(const std::string& path, pid_t pid,
+                                         pid_t tid, bool is_tsc_supported) {
+  const int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat file_stat;
+  void* memory = MAP_FAILED;
+  if (fstat(fd, &file_stat) == 0 &&
+      file_stat.st_size >=
+          static_cast<off_t>(sizeof(orbit_api::SharedMemoryBuffer))) {
+    memory = mmap(nullptr, sizeof(orbit_api::SharedMemoryBuffer),
+                  PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (memory == MAP_FAILED) {
+    return nullptr;
+  }
+
+  auto* buffer = static_cast<orbit_api::SharedMemoryBuffer*>(memory);
+  // The thread might still be initializing it, it's tried again later then.
+  if (buffer->magic.load(std::memory_order_acquire) !=
+          orbit_api::kSharedMemoryMagic ||
+      buffer->event_count != orbit_api::kSharedMemoryEventCount ||
+      buffer->pid != pid || buffer->tid != tid ||
+      (buffer->clock != orbit_api::kSharedMemoryClockMonotonic &&
+       !(buffer->clock == orbit_api::kSharedMemoryClockTsc &&
+         is_tsc_supported))) {
+    munmap(memory, sizeof(orbit_api::SharedMemoryBuffer));
+    return nullptr;
+  }
+  return buffer;
+}
+
+bool ReadMemory(pid_t pid, uint64_t address, void* data, size_t size) {
+  iovec local_iov{data, size};
+  iovec remote_iov{reinterpret_cast<void*>(address), size};
+  return process_vm_readv(pid, &local_iov, 1, &remote_iov, 1, 0) ==
+         static_cast<ssize_t>(size);
+}
+
+void UnmapBuffer(orbit_api::SharedMemoryBuffer* buffer) {
+  buffer->enabled.store(0, std::memory_order_relaxed);
+  munmap(buffer, sizeof(orbit_api::SharedMemoryBuffer));
+}
+}  // namespace
+
+ManualInstrumentationReader::ManualInstrumentationReader(
+    std::vector<pid_t> pids, TracerListener* listener)
+    : pids_(std::move(pids)),
+      listener_(listener),
+      tsc_clock_(TscClock::Create(kTscCalibrationDuration)) {}
+
+ManualInstrumentationReader::~ManualInstrumentationReader() {
+  for (auto& [path, mapped_buffer] : buffers_by_path_) {
+    UnmapBuffer(mapped_buffer.buffer);
+  }
+}
+
+void ManualInstrumentationReader::UpdateBuffers() {
+  absl::flat_hash_set<std::string> paths;
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator(
+           orbit_api::kSharedMemoryDirectory, error)) {
+    // "orbit_api.<pid>.<tid>"
+    const std::string name = entry.path().filename().string();
+    if (!absl::StartsWith(name, orbit_api::kSharedMemoryFilePrefix)) continue;
+    std::vector<std::string> parts = absl::StrSplit(
+        name.substr(std::strlen(orbit_api::kSharedMemoryFilePrefix)), '.');
+    pid_t pid;
+    pid_t tid;
+    if (parts.size() != 2 || !absl::SimpleAtoi(parts[0], &pid) ||
+        !absl::SimpleAtoi(parts[1], &tid) ||
+        std::find(pids_.begin(), pids_.end(), pid) == pids_.end()) {
+      continue;
+    }
+
+    const std::string path = entry.path().string();
+    paths.insert(path);
+    if (buffers_by_path_.contains(path)) continue;
+    orbit_api::SharedMemoryBuffer* buffer =
+        MapBuffer(path, pid, tid, tsc_clock_.has_value());
+    if (buffer == nullptr) continue;
+
+    buffer->read_index.store(
+        buffer->write_index.load(std::memory_order_acquire),
+        std::memory_order_release);
+    buffer->enabled.store(1, std::memory_order_relaxed);
+    buffers_by_path_.emplace(path, MappedBuffer{buffer, buffer->clock, {}});
+  }
+  if (error) {
+    ERROR("Listing %s: %s", orbit_api::kSharedMemoryDirectory,
+          error.message());
+  }
+
+  // A thread removes its file when it exits, after its last scope.
+  for (auto it = buffers_by_path_.begin(); it != buffers_by_path_.end();) {
+    if (paths.contains(it->first)) {
+      ++it;
+      continue;
+    }
+    ReadEvents(&it->second);
+    UnmapBuffer(it->second.buffer);
+    buffers_by_path_.erase(it++);
+  }
+}
+
+uint64_t ManualInstrumentationReader::ReadEvents() {
+  if (tsc_clock_.has_value()) {
+    tsc_clock_->Resync();
+  }
+  uint64_t event_count = 0;
+  for (auto& [path, mapped_buffer] : buffers_by_path_) {
+    event_count += ReadEvents(&mapped_buffer);
+  }
+  return event_count;
+}
+
+uint64_t ManualInstrumentationReader::ReadEvents(MappedBuffer* mapped_buffer) {
+  orbit_api::SharedMemoryBuffer* buffer = mapped_buffer->buffer;
+  const uint64_t read_index =
+      buffer->read_index.load(std::memory_order_relaxed);
+  const uint64_t write_index =
+      buffer->write_index.load(std::memory_order_acquire);
+  // A thread adds a table before it writes the events that refer to it.
+  const uint32_t name_table_count = std::min(
+      buffer->name_table_count.load(std::memory_order_acquire),
+      orbit_api::kSharedMemoryNameTableCount);
+  for (; mapped_buffer->name_table_count < name_table_count;
+       ++mapped_buffer->name_table_count) {
+    ReadNameTable(buffer->pid,
+                  buffer->name_tables[mapped_buffer->name_table_count]);
+  }
+  for (uint64_t index = read_index; index < write_index; ++index) {
+    const orbit_api::SharedMemoryEvent& event =
+        buffer->events[index % orbit_api::kSharedMemoryEventCount];
+    if (event.name_key != 0) {
+      mapped_buffer->open_scopes.push_back(
+          OpenScope{event.name_key, event.timestamp});
+      continue;
+    }
+    // The scope began before the buffer was mapped.
+    if (mapped_buffer->open_scopes.empty()) continue;
+
+    const OpenScope open_scope = mapped_buffer->open_scopes.back();
+    mapped_buffer->open_scopes.pop_back();
+    ManualInstrumentationScope scope;
+    scope.set_pid(buffer->pid);
+    scope.set_tid(buffer->tid);
+    scope.set_begin_timestamp_ns(
+        ToMonotonicNs(*mapped_buffer, open_scope.begin_timestamp));
+    scope.set_end_timestamp_ns(ToMonotonicNs(*mapped_buffer, event.timestamp));
+    scope.set_depth(mapped_buffer->open_scopes.size());
+    scope.set_name(GetName(buffer->pid, open_scope.name_key));
+    scope.set_name_hash(open_scope.name_key);
+    listener_->OnManualInstrumentationScope(std::move(scope));
+  }
+  buffer->read_index.store(write_index, std::memory_order_release);
+  return write_index - read_index;
+}
+
+uint64_t ManualInstrumentationReader::ToMonotonicNs(
+    const MappedBuffer& mapped_buffer, uint64_t timestamp) const {
+  // Only the buffers of supported clocks are mapped.
+  if (mapped_buffer.clock == orbit_api::kSharedMemoryClockTsc) {
+    return tsc_clock_->ToMonotonicNs(timestamp);
+  }
+  return timestamp;
+}
+
+uint64_t ManualInstrumentationReader::GetDroppedScopeCount() const {
+  uint64_t dropped_scope_count = 0;
+  for (const auto& [path, mapped_buffer] : buffers_by_path_) {
+    dropped_scope_count += mapped_buffer.buffer->dropped_scope_count.load(
+        std::memory_order_relaxed);
+  }
+  return dropped_scope_count;
+}
+
+void ManualInstrumentationReader::ReadNameTable(
+    pid_t pid, const orbit_api::SharedMemoryNameTable& table) {
+  if (!name_tables_read_.emplace(pid, table.begin_address).second) return;
+  if (table.end_address <= table.begin_address) return;
+  std::vector<orbit_api::SharedMemoryName> entries(
+      (table.end_address - table.begin_address) /
+      sizeof(orbit_api::SharedMemoryName));
+  if (!ReadMemory(pid, table.begin_address, entries.data(),
+                  entries.size() * sizeof(orbit_api::SharedMemoryName))) {
+    ERROR("Reading the names of the scopes of process %d at %#lx: %s", pid,
+          table.begin_address, SafeStrerror(errno));
+    return;
+  }
+
+  for (const orbit_api::SharedMemoryName& entry : entries) {
+    auto [it, inserted] = names_.try_emplace(std::make_pair(pid, entry.key));
+    if (!inserted) continue;
+    std::optional<std::string> name = ReadStringFromProcessMemory(
+        pid, reinterpret_cast<uint64_t>(entry.name), kMaxNameLength);
+    it->second = name.has_value() ? std::move(name.value())
+                                  : absl::StrFormat("%#lx", entry.key);
+  }
+}
+
+const std::string& ManualInstrumentationReader::GetName(pid_t pid,
+                                                        uint64_t name_key) {
+  auto [it, inserted] = names_.try_emplace(std::make_pair(pid, name_key));
+  // The table of the module of the scope couldn't be registered or read.
+  if (inserted) {
+    it->second = absl::StrFormat("%#lx", name_key);
+  }
+  return it->second;
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,91 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_MANUAL_INSTRUMENTATION_READER_H_
+#define ORBIT_LINUX_TRACING_MANUAL_INSTRUMENTATION_READER_H_
+
+#include <OrbitLinuxTracing/TracerListener.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../OrbitApiSharedMemory.h"
+#include "TscClock.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+
+namespace LinuxTracing {
+
+// Reads the ring buffers in shared memory through which the threads of the
+// captured processes built with ORBIT_API_SHARED_MEMORY report their scopes,
+// and reports the scopes to the listener as ManualInstrumentationScopes.
+//
+// The names of the scopes are read from the memory of the processes once, from
+// the tables of names the threads register in their buffers.
+//
+// The buffers are enabled while they are mapped, so that threads only write
+// their scopes during the capture. The events written before a buffer is
+// mapped are skipped, as are the ends of scopes that began before.
+//
+// The timestamps of the buffers in the TSC clock are converted to
+// CLOCK_MONOTONIC, with a TscClock that is resynced on each ReadEvents.
+class ManualInstrumentationReader {
+ public:
+  ManualInstrumentationReader(std::vector<pid_t> pids,
+                              TracerListener* listener);
+  ~ManualInstrumentationReader();
+
+  ManualInstrumentationReader(const ManualInstrumentationReader&) = delete;
+  ManualInstrumentationReader& operator=(const ManualInstrumentationReader&) =
+      delete;
+
+  // Maps the buffers of the threads that had their first scope since the last
+  // call, and unmaps the ones of the threads that have exited, after reading
+  // them a last time.
+  void UpdateBuffers();
+  // Reports the scopes that ended since the last call. Returns the number of
+  // events read.
+  uint64_t ReadEvents();
+  // The scopes that the threads couldn't write as their buffer was full.
+  [[nodiscard]] uint64_t GetDroppedScopeCount() const;
+
+ private:
+  struct OpenScope {
+    uint64_t name_key;
+    // In the clock of the buffer, so that the begin and the end of a scope
+    // are converted with the same TscClock.
+    uint64_t begin_timestamp;
+  };
+  struct MappedBuffer {
+    orbit_api::SharedMemoryBuffer* buffer;
+    // Read once, as the process could change it.
+    orbit_api::SharedMemoryClock clock;
+    std::vector<OpenScope> open_scopes;
+    uint32_t name_table_count = 0;
+  };
+
+  uint64_t ReadEvents(MappedBuffer* mapped_buffer);
+  // Reads the keys and names of a table of pid, unless it was already read.
+  void ReadNameTable(pid_t pid, const orbit_api::SharedMemoryNameTable& table);
+  const std::string& GetName(pid_t pid, uint64_t name_key);
+  [[nodiscard]] uint64_t ToMonotonicNs(const MappedBuffer& mapped_buffer,
+                                       uint64_t timestamp) const;
+
+  std::vector<pid_t> pids_;
+  TracerListener* listener_;
+  // Unless the TSC isn't the clock source, then the threads don't use it.
+  std::optional<TscClock> tsc_clock_;
+  absl::flat_hash_map<std::string, MappedBuffer> buffers_by_path_;
+  absl::flat_hash_set<std::pair<pid_t, uint64_t>> name_tables_read_;
+  // By pid and key.
+  absl::flat_hash_map<std::pair<pid_t, uint64_t>, std::string> names_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_MANUAL_INSTRUMENTATION_READER_H_
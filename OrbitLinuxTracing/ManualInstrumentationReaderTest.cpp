@@ -0,0 +1,217 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ManualInstrumentationReader.h"
+#include "Utils.h"
+
+#define ORBIT_API_SHARED_MEMORY 1
+#include "../Orbit.h"
+
+namespace LinuxTracing {
+
+namespace {
+
+class ManualInstrumentationScopeListener : public TracerListener {
+ public:
+  void OnSchedulingSlices(std::vector<SchedulingSlice>) override {}
+  void OnSchedulingSliceCounters(SchedulingSliceCounters) override {}
+  void OnCallstackSample(CallstackSample) override {}
+  void OnOffCpuCallstackSample(OffCpuCallstackSample) override {}
+  void OnLockWait(LockWait) override {}
+  void OnLockContentionStats(LockContentionStats) override {}
+  void OnAllocationSample(AllocationSample) override {}
+  void OnSyscallLatency(SyscallLatency) override {}
+  void OnBlockIoLatency(BlockIoLatency) override {}
+  void OnCpuPowerEvent(CpuPowerEvent) override {}
+  void OnPageFault(PageFault) override {}
+  void OnPageFaultStats(PageFaultStats) override {}
+  void OnFunctionCall(FunctionCall) override {}
+  void OnFunctionCallStats(FunctionCallStats) override {}
+  void OnGpuJob(GpuJob) override {}
+  void OnThreadName(ThreadName) override {}
+  void OnThreadWakeup(ThreadWakeup) override {}
+  void OnAddressInfo(AddressInfo) override {}
+  void OnModuleMap(ModuleMap) override {}
+  void OnCaptureSetupPhase(CaptureSetupPhase) override {}
+  void OnCaptureStatistics(CaptureStatistics) override {}
+  void OnIntrospectionScope(IntrospectionScope) override {}
+  void OnManualInstrumentationScope(
+      ManualInstrumentationScope manual_instrumentation_scope) override {
+    scopes.push_back(std::move(manual_instrumentation_scope));
+  }
+  void OnGpuQueueSubmission(GpuQueueSubmission) override {}
+  void OnAsyncSpan(AsyncSpan) override {}
+  void OnFrameMarker(FrameMarker) override {}
+  void OnDisabledInstrumentedFunctions(
+      DisabledInstrumentedFunctions) override {}
+  void OnCpuBudgetStep(CpuBudgetStep) override {}
+  void OnClockOffset(ClockOffset) override {}
+
+  std::vector<ManualInstrumentationScope> scopes;
+};
+
+}  // namespace
+
+TEST(ManualInstrumentationReader, ReportsScopesOnceMapped) {
+  ManualInstrumentationScopeListener listener;
+  ManualInstrumentationReader reader({getpid()}, &listener);
+  // Creates the buffer of the thread, before it's mapped.
+  { ORBIT_SCOPE("before"); }
+  reader.UpdateBuffers();
+  {
+    ORBIT_SCOPE("outer");
+    ORBIT_START("inner");
+    ORBIT_STOP();
+  }
+  EXPECT_EQ(reader.ReadEvents(), 4);
+  EXPECT_EQ(reader.ReadEvents(), 0);
+
+  ASSERT_EQ(listener.scopes.size(), 2);
+  const ManualInstrumentationScope& inner = listener.scopes[0];
+  const ManualInstrumentationScope& outer = listener.scopes[1];
+  EXPECT_EQ(inner.name(), "inner");
+  EXPECT_EQ(inner.depth(), 1);
+  EXPECT_EQ(outer.name(), "outer");
+  EXPECT_EQ(outer.depth(), 0);
+  EXPECT_EQ(outer.pid(), getpid());
+  EXPECT_EQ(outer.tid(), inner.tid());
+  EXPECT_LE(outer.begin_timestamp_ns(), inner.begin_timestamp_ns());
+  EXPECT_LE(inner.begin_timestamp_ns(), inner.end_timestamp_ns());
+  EXPECT_LE(inner.end_timestamp_ns(), outer.end_timestamp_ns());
+}
+
+TEST(ManualInstrumentationReader, ReportsMonotonicTimestamps) {
+  ManualInstrumentationScopeListener listener;
+  ManualInstrumentationReader reader({getpid()}, &listener);
+  { ORBIT_SCOPE("before"); }
+  reader.UpdateBuffers();
+  const uint64_t before_ns = MonotonicTimestampNs();
+  { ORBIT_SCOPE("scope"); }
+  const uint64_t after_ns = MonotonicTimestampNs();
+  reader.ReadEvents();
+
+  ASSERT_EQ(listener.scopes.size(), 1);
+  // Whether the thread used the TSC or CLOCK_MONOTONIC, with some tolerance
+  // for the conversion of the TSC.
+  constexpr uint64_t kToleranceNs = 10'000;
+  EXPECT_GE(listener.scopes[0].begin_timestamp_ns() + kToleranceNs, before_ns);
+  EXPECT_LE(listener.scopes[0].end_timestamp_ns(), after_ns + kToleranceNs);
+}
+
+TEST(ManualInstrumentationReader, ResolvesNamesByKey) {
+  static_assert(orbit_api::ComputeNameKey("") != 0);
+  static_assert(orbit_api::ComputeNameKey("a") !=
+                orbit_api::ComputeNameKey("b"));
+  const uint64_t key = ORBIT_NAME_KEY("key");
+  EXPECT_EQ(key, orbit_api::ComputeNameKey("key"));
+
+  ManualInstrumentationScopeListener listener;
+  ManualInstrumentationReader reader({getpid()}, &listener);
+  { ORBIT_SCOPE("before"); }
+  reader.UpdateBuffers();
+  { ORBIT_SCOPE("key"); }
+  { ORBIT_SCOPE("key"); }
+  reader.ReadEvents();
+
+  ASSERT_EQ(listener.scopes.size(), 2);
+  for (const ManualInstrumentationScope& scope : listener.scopes) {
+    EXPECT_EQ(scope.name(), "key");
+    EXPECT_EQ(scope.name_hash(), key);
+  }
+}
+
+TEST(ManualInstrumentationReader, SkipsScopesBegunBeforeMapping) {
+  ManualInstrumentationScopeListener listener;
+  ManualInstrumentationReader reader({getpid()}, &listener);
+  { ORBIT_SCOPE("before"); }
+  {
+    ORBIT_SCOPE("open");
+    reader.UpdateBuffers();
+    { ORBIT_SCOPE("nested"); }
+  }
+  reader.ReadEvents();
+  EXPECT_TRUE(listener.scopes.empty());
+
+  { ORBIT_SCOPE("after"); }
+  reader.ReadEvents();
+  ASSERT_EQ(listener.scopes.size(), 1);
+  EXPECT_EQ(listener.scopes[0].name(), "after");
+  EXPECT_EQ(listener.scopes[0].depth(), 0);
+}
+
+TEST(ManualInstrumentationReader, IgnoresOtherProcesses) {
+  ManualInstrumentationScopeListener listener;
+  ManualInstrumentationReader reader({getpid() + 1}, &listener);
+  { ORBIT_SCOPE("before"); }
+  reader.UpdateBuffers();
+  { ORBIT_SCOPE("scope"); }
+  EXPECT_EQ(reader.ReadEvents(), 0);
+  EXPECT_TRUE(listener.scopes.empty());
+}
+
+TEST(ManualInstrumentationReader, ReadsThreadsThatExited) {
+  ManualInstrumentationScopeListener listener;
+  ManualInstrumentationReader reader({getpid()}, &listener);
+  std::mutex mutex;
+  std::condition_variable state_changed;
+  bool created = false;
+  bool mapped = false;
+  std::thread thread([&] {
+    { ORBIT_SCOPE("before"); }
+    std::unique_lock<std::mutex> lock(mutex);
+    created = true;
+    state_changed.notify_all();
+    state_changed.wait(lock, [&] { return mapped; });
+    lock.unlock();
+    ORBIT_SCOPE("thread");
+  });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    state_changed.wait(lock, [&] { return created; });
+    reader.UpdateBuffers();
+    mapped = true;
+    state_changed.notify_all();
+  }
+  thread.join();
+
+  // The buffer of the thread is read a last time before it's unmapped.
+  reader.UpdateBuffers();
+  ASSERT_EQ(listener.scopes.size(), 1);
+  EXPECT_EQ(listener.scopes[0].name(), "thread");
+  EXPECT_NE(listener.scopes[0].tid(), getpid());
+  EXPECT_EQ(reader.ReadEvents(), 0);
+}
+
+TEST(ManualInstrumentationReader, DropsWholeScopesWhenFull) {
+  ManualInstrumentationScopeListener listener;
+  ManualInstrumentationReader reader({getpid()}, &listener);
+  { ORBIT_SCOPE("before"); }
+  reader.UpdateBuffers();
+  const uint64_t dropped_scope_count = reader.GetDroppedScopeCount();
+  {
+    ORBIT_SCOPE("outer");
+    for (uint32_t i = 0; i < orbit_api::kSharedMemoryEventCount; ++i) {
+      ORBIT_SCOPE("inner");
+    }
+  }
+  reader.ReadEvents();
+
+  // The end of outer was written, as the begins of the inner scopes left room
+  // for it.
+  ASSERT_FALSE(listener.scopes.empty());
+  EXPECT_EQ(listener.scopes.back().name(), "outer");
+  EXPECT_EQ(listener.scopes.size(), orbit_api::kSharedMemoryEventCount / 2);
+  EXPECT_EQ(reader.GetDroppedScopeCount() - dropped_scope_count,
+            orbit_api::kSharedMemoryEventCount / 2 + 1);
+}
+
+}  // namespace LinuxTracing
@@ -6,16 +6,82 @@
 
 #if ORBIT_TRACING_ENABLED
 
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <vector>
+
+#include "Utils.h"
+
 namespace orbit::tracing {
 
-std::unique_ptr<orbit::tracing::Handler> GHandler;
+std::atomic<Handler*> GHandler = nullptr;
 
 }  // namespace orbit::tracing
 
 namespace LinuxTracing {
 
-void SetOrbitTracingHandler(std::unique_ptr<orbit::tracing::Handler> handler) {
-  orbit::tracing::GHandler = std::move(handler);
+namespace {
+
+class ListenerTracingHandler : public orbit::tracing::Handler {
+ public:
+  void SetListener(TracerListener* listener) { listener_ = listener; }
+
+  void Begin(const char* name) override {
+    open_scopes_.push_back(OpenScope{name, MonotonicTimestampNs()});
+  }
+
+  void End() override {
+    // The handler might have been set after the matching ORBIT_BEGIN.
+    if (open_scopes_.empty()) {
+      return;
+    }
+    OpenScope open_scope = open_scopes_.back();
+    open_scopes_.pop_back();
+    TracerListener* listener = listener_;
+    if (listener == nullptr) {
+      return;
+    }
+
+    static thread_local pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    IntrospectionScope scope;
+    scope.set_pid(getpid());
+    scope.set_tid(tid);
+    scope.set_begin_timestamp_ns(open_scope.begin_timestamp_ns);
+    scope.set_end_timestamp_ns(MonotonicTimestampNs());
+    scope.set_depth(open_scopes_.size());
+    scope.set_name(open_scope.name);
+    listener->OnIntrospectionScope(std::move(scope));
+  }
+
+  void Track(const char*, int) override {}
+  void Track(const char*, float) override {}
+
+ private:
+  struct OpenScope {
+    const char* name;
+    uint64_t begin_timestamp_ns;
+  };
+  static thread_local std::vector<OpenScope> open_scopes_;
+
+  std::atomic<TracerListener*> listener_ = nullptr;
+};
+
+thread_local std::vector<ListenerTracingHandler::OpenScope>
+    ListenerTracingHandler::open_scopes_;
+
+}  // namespace
+
+void SetOrbitTracingHandler(orbit::tracing::Handler* handler) {
+  orbit::tracing::GHandler = handler;
+}
+
+void SetOrbitTracingListener(TracerListener* listener) {
+  // Never destroyed, as required by GHandler.
+  static auto* listener_handler = new ListenerTracingHandler();
+  listener_handler->SetListener(listener);
+  SetOrbitTracingHandler(listener != nullptr ? listener_handler : nullptr);
 }
 
 }  // namespace LinuxTracing
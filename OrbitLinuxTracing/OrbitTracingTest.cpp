@@ -0,0 +1,93 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <OrbitLinuxTracing/OrbitTracing.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <vector>
+
+namespace LinuxTracing {
+
+namespace {
+
+class IntrospectionScopeListener : public TracerListener {
+ public:
+  void OnSchedulingSlices(std::vector<SchedulingSlice>) override {}
+  void OnSchedulingSliceCounters(SchedulingSliceCounters) override {}
+  void OnCallstackSample(CallstackSample) override {}
+  void OnOffCpuCallstackSample(OffCpuCallstackSample) override {}
+  void OnLockWait(LockWait) override {}
+  void OnLockContentionStats(LockContentionStats) override {}
+  void OnAllocationSample(AllocationSample) override {}
+  void OnSyscallLatency(SyscallLatency) override {}
+  void OnBlockIoLatency(BlockIoLatency) override {}
+  void OnCpuPowerEvent(CpuPowerEvent) override {}
+  void OnPageFault(PageFault) override {}
+  void OnPageFaultStats(PageFaultStats) override {}
+  void OnFunctionCall(FunctionCall) override {}
+  void OnFunctionCallStats(FunctionCallStats) override {}
+  void OnGpuJob(GpuJob) override {}
+  void OnThreadName(ThreadName) override {}
+  void OnThreadWakeup(ThreadWakeup) override {}
+  void OnAddressInfo(AddressInfo) override {}
+  void OnModuleMap(ModuleMap) override {}
+  void OnCaptureSetupPhase(CaptureSetupPhase) override {}
+  void OnCaptureStatistics(CaptureStatistics) override {}
+  void OnIntrospectionScope(IntrospectionScope introspection_scope) override {
+    scopes.push_back(std::move(introspection_scope));
+  }
+  void OnManualInstrumentationScope(ManualInstrumentationScope) override {}
+  void OnGpuQueueSubmission(GpuQueueSubmission) override {}
+  void OnAsyncSpan(AsyncSpan) override {}
+  void OnFrameMarker(FrameMarker) override {}
+  void OnDisabledInstrumentedFunctions(
+      DisabledInstrumentedFunctions) override {}
+  void OnCpuBudgetStep(CpuBudgetStep) override {}
+  void OnClockOffset(ClockOffset) override {}
+
+  std::vector<IntrospectionScope> scopes;
+};
+
+}  // namespace
+
+TEST(OrbitTracing, ReportsScopesToListener) {
+  IntrospectionScopeListener listener;
+  SetOrbitTracingListener(&listener);
+  {
+    ORBIT_SCOPE("outer");
+    { ORBIT_SCOPE("inner"); }
+  }
+  SetOrbitTracingListener(nullptr);
+
+  ASSERT_EQ(listener.scopes.size(), 2);
+  const IntrospectionScope& inner = listener.scopes[0];
+  const IntrospectionScope& outer = listener.scopes[1];
+  EXPECT_EQ(inner.name(), "inner");
+  EXPECT_EQ(inner.depth(), 1);
+  EXPECT_EQ(outer.name(), "outer");
+  EXPECT_EQ(outer.depth(), 0);
+  EXPECT_EQ(outer.pid(), getpid());
+  EXPECT_EQ(outer.tid(), inner.tid());
+  EXPECT_LE(outer.begin_timestamp_ns(), inner.begin_timestamp_ns());
+  EXPECT_LE(inner.end_timestamp_ns(), outer.end_timestamp_ns());
+}
+
+TEST(OrbitTracing, ScopesAreOnlyReportedWithListener) {
+  IntrospectionScopeListener listener;
+  { ORBIT_SCOPE("before"); }
+  {
+    ORBIT_SCOPE("open while set");
+    SetOrbitTracingListener(&listener);
+    { ORBIT_SCOPE("while set"); }
+  }
+  SetOrbitTracingListener(nullptr);
+  { ORBIT_SCOPE("after"); }
+
+  ASSERT_EQ(listener.scopes.size(), 1);
+  EXPECT_EQ(listener.scopes[0].name(), "while set");
+  EXPECT_EQ(listener.scopes[0].depth(), 0);
+}
+
+}  // namespace LinuxTracing
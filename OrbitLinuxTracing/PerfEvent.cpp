@@ -4,10 +4,55 @@
 
 #include "PerfEvent.h"
 
+#include <array>
+
 #include "PerfEventVisitor.h"
 
 namespace LinuxTracing {
 
+namespace {
+constexpr size_t MIN_POOLED_STACK_DATA_SIZE_LOG2 = 9;
+constexpr size_t MAX_POOLED_STACK_DATA_SIZE_LOG2 = 16;
+constexpr size_t STACK_DATA_SIZES_PER_SLAB = 4;
+
+using StackDataSlabAllocators =
+    std::array<SlabAllocator*, MAX_POOLED_STACK_DATA_SIZE_LOG2 -
+                                   MIN_POOLED_STACK_DATA_SIZE_LOG2 + 1>;
+
+const StackDataSlabAllocators& GetStackDataSlabAllocators() {
+  // Intentionally leaked, like the SlabAllocators of SlabAllocated.
+  static const StackDataSlabAllocators* slab_allocators = [] {
+    auto* slab_allocators = new StackDataSlabAllocators{};
+    for (size_t i = 0; i < slab_allocators->size(); ++i) {
+      (*slab_allocators)[i] =
+          new SlabAllocator{1ul << (MIN_POOLED_STACK_DATA_SIZE_LOG2 + i),
+                            STACK_DATA_SIZES_PER_SLAB};
+    }
+    return slab_allocators;
+  }();
+  return *slab_allocators;
+}
+}  // namespace
+
+void StackDataDeleter::operator()(char* data) const {
+  if (slab_allocator != nullptr) {
+    slab_allocator->Deallocate(data);
+  } else {
+    delete[] data;
+  }
+}
+
+StackData AllocateStackData(uint64_t size) {
+  for (SlabAllocator* slab_allocator : GetStackDataSlabAllocators()) {
+    if (size <= slab_allocator->GetBlockSize()) {
+      return StackData{static_cast<char*>(slab_allocator->Allocate()),
+                       StackDataDeleter{slab_allocator}};
+    }
+  }
+  return StackData{make_unique_for_overwrite<char[]>(size).release(),
+                   StackDataDeleter{nullptr}};
+}
+
 // These cannot be implemented in the header PerfEvent.h, because there
 // PerfEventVisitor needs to be an incomplete type to avoid the circular
 // dependency between PerfEvent.h and PerfEventVisitor.h.
@@ -32,6 +77,54 @@ void CallchainSamplePerfEvent::Accept(PerfEventVisitor* visitor) {
   visitor->visit(this);
 }
 
+void OffCpuCallchainPerfEvent::Accept(PerfEventVisitor* visitor) {
+  visitor->visit(this);
+}
+
+void FutexWaitPerfEvent::Accept(PerfEventVisitor* visitor) {
+  visitor->visit(this);
+}
+
+void FutexExitPerfEvent::Accept(PerfEventVisitor* visitor) {
+  visitor->visit(this);
+}
+
+void AllocationPerfEvent::Accept(PerfEventVisitor* visitor) {
+  visitor->visit(this);
+}
+
+void PageFaultPerfEvent::Accept(PerfEventVisitor* visitor) {
+  visitor->visit(this);
+}
+
+void MemoryMapSyscallPerfEvent::Accept(PerfEventVisitor* visitor) {
+  visitor->visit(this);
+}
+
+void SyscallEnterPerfEvent::Accept(PerfEventVisitor* visitor) {
+  visitor->visit(this);
+}
+
+void SyscallExitPerfEvent::Accept(PerfEventVisitor* visitor) {
+  visitor->visit(this);
+}
+
+void BlockRqIssuePerfEvent::Accept(PerfEventVisitor* visitor) {
+  visitor->visit(this);
+}
+
+void BlockRqCompletePerfEvent::Accept(PerfEventVisitor* visitor) {
+  visitor->visit(this);
+}
+
+void HybridSamplePerfEvent::Accept(PerfEventVisitor* visitor) {
+  visitor->visit(this);
+}
+
+void LbrSamplePerfEvent::Accept(PerfEventVisitor* visitor) {
+  visitor->visit(this);
+}
+
 void UprobesPerfEvent::Accept(PerfEventVisitor* visitor) {
   visitor->visit(this);
 }
@@ -42,7 +135,7 @@ void UretprobesPerfEvent::Accept(PerfEventVisitor* visitor) {
 
 void LostPerfEvent::Accept(PerfEventVisitor* visitor) { visitor->visit(this); }
 
-void MapsPerfEvent::Accept(PerfEventVisitor* visitor) { visitor->visit(this); }
+void MmapPerfEvent::Accept(PerfEventVisitor* visitor) { visitor->visit(this); }
 
 void TaskNewtaskPerfEvent::Accept(PerfEventVisitor* visitor) {
   visitor->visit(this);
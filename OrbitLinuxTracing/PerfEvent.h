@@ -7,11 +7,13 @@
 
 #include <array>
 #include <memory>
+#include <string>
 
 #include "Function.h"
 #include "KernelTracepoints.h"
 #include "OrbitBase/MakeUniqueForOverwrite.h"
 #include "PerfEventRecords.h"
+#include "SlabAllocator.h"
 
 namespace LinuxTracing {
 
@@ -22,6 +24,8 @@ class PerfEventVisitor;
 // perf_event_open records will be copied from the ring buffer directly into the
 // concrete subclass (depending on the event type), in general into a
 // "ring_buffer_record" field.
+// The events that are created at high rates derive from SlabAllocated, so that
+// their memory is recycled instead of going through malloc and free.
 
 class PerfEvent {
  public:
@@ -35,7 +39,8 @@ class PerfEvent {
   int origin_file_descriptor_ = -1;
 };
 
-class ContextSwitchPerfEvent : public PerfEvent {
+class ContextSwitchPerfEvent : public PerfEvent,
+                               public SlabAllocated<ContextSwitchPerfEvent> {
  public:
   perf_event_context_switch ring_buffer_record;
 
@@ -61,7 +66,9 @@ class ContextSwitchPerfEvent : public PerfEvent {
   uint32_t GetCpu() const { return ring_buffer_record.sample_id.cpu; }
 };
 
-class SystemWideContextSwitchPerfEvent : public PerfEvent {
+class SystemWideContextSwitchPerfEvent
+    : public PerfEvent,
+      public SlabAllocated<SystemWideContextSwitchPerfEvent> {
  public:
   perf_event_context_switch_cpu_wide ring_buffer_record;
 
@@ -170,14 +177,27 @@ class LostPerfEvent : public PerfEvent {
   uint32_t GetCpu() const { return ring_buffer_record.sample_id.cpu; }
 };
 
-struct dynamically_sized_perf_event_stack_sample {
+// Returns the memory of a stack copied from a stack sample to the
+// SlabAllocator it was allocated from.
+struct StackDataDeleter {
+  SlabAllocator* slab_allocator;
+  void operator()(char* data) const;
+};
+using StackData = std::unique_ptr<char[], StackDataDeleter>;
+
+// The memory is allocated from a SlabAllocator for blocks of the smallest power
+// of two that fits size, up to 64 KiB, as this memory is large and allocated at
+// a high rate. Larger sizes are allocated with new.
+StackData AllocateStackData(uint64_t size);
+
+struct dynamically_sized_perf_event_stack_sample
+    : public SlabAllocated<dynamically_sized_perf_event_stack_sample> {
   struct dynamically_sized_perf_event_sample_stack_user {
     uint64_t dyn_size;
-    std::unique_ptr<char[]> data;
+    StackData data;
 
     explicit dynamically_sized_perf_event_sample_stack_user(uint64_t dyn_size)
-        : dyn_size{dyn_size},
-          data{make_unique_for_overwrite<char[]>(dyn_size)} {}
+        : dyn_size{dyn_size}, data{AllocateStackData(dyn_size)} {}
   };
 
   perf_event_header header;
@@ -189,7 +209,40 @@ struct dynamically_sized_perf_event_stack_sample {
       : stack{dyn_size} {}
 };
 
-class StackSamplePerfEvent : public PerfEvent {
+inline std::array<uint64_t, PERF_REG_X86_64_MAX>
+perf_event_sample_regs_user_all_to_register_array(
+    const perf_event_sample_regs_user_all& regs) {
+  std::array<uint64_t, PERF_REG_X86_64_MAX> registers{};
+  registers[PERF_REG_X86_AX] = regs.ax;
+  registers[PERF_REG_X86_BX] = regs.bx;
+  registers[PERF_REG_X86_CX] = regs.cx;
+  registers[PERF_REG_X86_DX] = regs.dx;
+  registers[PERF_REG_X86_SI] = regs.si;
+  registers[PERF_REG_X86_DI] = regs.di;
+  registers[PERF_REG_X86_BP] = regs.bp;
+  registers[PERF_REG_X86_SP] = regs.sp;
+  registers[PERF_REG_X86_IP] = regs.ip;
+  registers[PERF_REG_X86_FLAGS] = regs.flags;
+  registers[PERF_REG_X86_CS] = regs.cs;
+  registers[PERF_REG_X86_SS] = regs.ss;
+  // Registers ds, es, fs, gs do not actually exist.
+  registers[PERF_REG_X86_DS] = 0ul;
+  registers[PERF_REG_X86_ES] = 0ul;
+  registers[PERF_REG_X86_FS] = 0ul;
+  registers[PERF_REG_X86_GS] = 0ul;
+  registers[PERF_REG_X86_R8] = regs.r8;
+  registers[PERF_REG_X86_R9] = regs.r9;
+  registers[PERF_REG_X86_R10] = regs.r10;
+  registers[PERF_REG_X86_R11] = regs.r11;
+  registers[PERF_REG_X86_R12] = regs.r12;
+  registers[PERF_REG_X86_R13] = regs.r13;
+  registers[PERF_REG_X86_R14] = regs.r14;
+  registers[PERF_REG_X86_R15] = regs.r15;
+  return registers;
+}
+
+class StackSamplePerfEvent : public PerfEvent,
+                             public SlabAllocated<StackSamplePerfEvent> {
  public:
   std::unique_ptr<dynamically_sized_perf_event_stack_sample> ring_buffer_record;
 
@@ -223,42 +276,11 @@ class StackSamplePerfEvent : public PerfEvent {
   }
   char* GetStackData() { return ring_buffer_record->stack.data.get(); }
   uint64_t GetStackSize() const { return ring_buffer_record->stack.dyn_size; }
+};
 
- private:
-  static std::array<uint64_t, PERF_REG_X86_64_MAX>
-  perf_event_sample_regs_user_all_to_register_array(
-      const perf_event_sample_regs_user_all& regs) {
-    std::array<uint64_t, PERF_REG_X86_64_MAX> registers{};
-    registers[PERF_REG_X86_AX] = regs.ax;
-    registers[PERF_REG_X86_BX] = regs.bx;
-    registers[PERF_REG_X86_CX] = regs.cx;
-    registers[PERF_REG_X86_DX] = regs.dx;
-    registers[PERF_REG_X86_SI] = regs.si;
-    registers[PERF_REG_X86_DI] = regs.di;
-    registers[PERF_REG_X86_BP] = regs.bp;
-    registers[PERF_REG_X86_SP] = regs.sp;
-    registers[PERF_REG_X86_IP] = regs.ip;
-    registers[PERF_REG_X86_FLAGS] = regs.flags;
-    registers[PERF_REG_X86_CS] = regs.cs;
-    registers[PERF_REG_X86_SS] = regs.ss;
-    // Registers ds, es, fs, gs do not actually exist.
-    registers[PERF_REG_X86_DS] = 0ul;
-    registers[PERF_REG_X86_ES] = 0ul;
-    registers[PERF_REG_X86_FS] = 0ul;
-    registers[PERF_REG_X86_GS] = 0ul;
-    registers[PERF_REG_X86_R8] = regs.r8;
-    registers[PERF_REG_X86_R9] = regs.r9;
-    registers[PERF_REG_X86_R10] = regs.r10;
-    registers[PERF_REG_X86_R11] = regs.r11;
-    registers[PERF_REG_X86_R12] = regs.r12;
-    registers[PERF_REG_X86_R13] = regs.r13;
-    registers[PERF_REG_X86_R14] = regs.r14;
-    registers[PERF_REG_X86_R15] = regs.r15;
-    return registers;
-  }
-};
-
-class CallchainSamplePerfEvent : public PerfEvent {
+class CallchainSamplePerfEvent
+    : public PerfEvent,
+      public SlabAllocated<CallchainSamplePerfEvent> {
  public:
   perf_event_callchain_sample_fixed ring_buffer_record;
   std::vector<uint64_t> ips;
@@ -288,6 +310,317 @@ class CallchainSamplePerfEvent : public PerfEvent {
   uint64_t GetCallchainSize() const { return ring_buffer_record.nr; }
 };
 
+// A callchain sample that also has the call stack of the last branch records.
+// The ring buffer record is perf_event_callchain_sample_fixed, followed by the
+// callchain, by the number of branch records and by the perf_branch_entry
+// records, innermost call first. Only the address of each call instruction is
+// kept.
+class LbrSamplePerfEvent : public PerfEvent,
+                           public SlabAllocated<LbrSamplePerfEvent> {
+ public:
+  perf_event_callchain_sample_fixed ring_buffer_record;
+  std::vector<uint64_t> ips;
+  std::vector<uint64_t> call_addresses;
+
+  LbrSamplePerfEvent(uint64_t callchain_size, uint64_t branch_count)
+      : ips(callchain_size), call_addresses(branch_count) {
+    ring_buffer_record.nr = callchain_size;
+  }
+
+  uint64_t GetTimestamp() const override {
+    return ring_buffer_record.sample_id.time;
+  }
+
+  void Accept(PerfEventVisitor* visitor) override;
+
+  pid_t GetPid() const { return ring_buffer_record.sample_id.pid; }
+  pid_t GetTid() const { return ring_buffer_record.sample_id.tid; }
+
+  uint64_t GetStreamId() const {
+    return ring_buffer_record.sample_id.stream_id;
+  }
+
+  uint32_t GetCpu() const { return ring_buffer_record.sample_id.cpu; }
+
+  uint64_t* GetCallchain() { return ips.data(); }
+  const uint64_t* GetCallchain() const { return ips.data(); }
+
+  uint64_t GetCallchainSize() const { return ring_buffer_record.nr; }
+
+  const std::vector<uint64_t>& GetCallAddresses() const {
+    return call_addresses;
+  }
+};
+
+// The callchain of a thread of a captured process when it blocked, from the
+// sched_switch tracepoint. The ring buffer record is
+// perf_event_callchain_sample_fixed, followed by the callchain and by the
+// sched_switch_tracepoint as raw data.
+class OffCpuCallchainPerfEvent
+    : public PerfEvent,
+      public SlabAllocated<OffCpuCallchainPerfEvent> {
+ public:
+  perf_event_callchain_sample_fixed ring_buffer_record;
+  std::vector<uint64_t> ips;
+  explicit OffCpuCallchainPerfEvent(uint64_t callchain_size)
+      : ips(callchain_size) {
+    ring_buffer_record.nr = callchain_size;
+  }
+
+  uint64_t GetTimestamp() const override {
+    return ring_buffer_record.sample_id.time;
+  }
+
+  void Accept(PerfEventVisitor* visitor) override;
+
+  pid_t GetPid() const { return ring_buffer_record.sample_id.pid; }
+  pid_t GetTid() const { return ring_buffer_record.sample_id.tid; }
+
+  uint64_t* GetCallchain() { return ips.data(); }
+  const uint64_t* GetCallchain() const { return ips.data(); }
+
+  uint64_t GetCallchainSize() const { return ring_buffer_record.nr; }
+};
+
+// The beginning of a futex wait of a thread of a captured process, with its
+// callchain, from the syscalls:sys_enter_futex tracepoint. The ring buffer
+// record is perf_event_callchain_sample_fixed, followed by the callchain and
+// by the sys_enter_futex_tracepoint as raw data.
+class FutexWaitPerfEvent : public PerfEvent,
+                           public SlabAllocated<FutexWaitPerfEvent> {
+ public:
+  perf_event_callchain_sample_fixed ring_buffer_record;
+  std::vector<uint64_t> ips;
+  // uaddr of the futex.
+  uint64_t lock_address = 0;
+  explicit FutexWaitPerfEvent(uint64_t callchain_size) : ips(callchain_size) {
+    ring_buffer_record.nr = callchain_size;
+  }
+
+  uint64_t GetTimestamp() const override {
+    return ring_buffer_record.sample_id.time;
+  }
+
+  void Accept(PerfEventVisitor* visitor) override;
+
+  pid_t GetPid() const { return ring_buffer_record.sample_id.pid; }
+  pid_t GetTid() const { return ring_buffer_record.sample_id.tid; }
+
+  uint64_t* GetCallchain() { return ips.data(); }
+  const uint64_t* GetCallchain() const { return ips.data(); }
+
+  uint64_t GetCallchainSize() const { return ring_buffer_record.nr; }
+};
+
+// The return of a futex syscall of a thread of a captured process, from the
+// syscalls:sys_exit_futex tracepoint, whatever its operation.
+class FutexExitPerfEvent : public PerfEvent,
+                           public SlabAllocated<FutexExitPerfEvent> {
+ public:
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  int64_t ret = 0;
+
+  uint64_t GetTimestamp() const override { return sample_id.time; }
+
+  void Accept(PerfEventVisitor* visitor) override;
+
+  pid_t GetPid() const { return sample_id.pid; }
+  pid_t GetTid() const { return sample_id.tid; }
+};
+
+// A call to malloc of a thread of a captured process that was sampled, from a
+// uprobe opened with uprobes_callchain_event_open. The return address at the
+// top of the stack is inserted in the callchain after the address of malloc.
+class AllocationPerfEvent : public PerfEvent,
+                            public SlabAllocated<AllocationPerfEvent> {
+ public:
+  perf_event_callchain_sample_fixed ring_buffer_record;
+  std::vector<uint64_t> ips;
+  uint64_t size = 0;
+  // Set by the TracerThread, which samples the allocations.
+  uint64_t sampled_bytes = 0;
+  explicit AllocationPerfEvent(uint64_t callchain_size) : ips(callchain_size) {
+    ring_buffer_record.nr = callchain_size;
+  }
+
+  uint64_t GetTimestamp() const override {
+    return ring_buffer_record.sample_id.time;
+  }
+
+  void Accept(PerfEventVisitor* visitor) override;
+
+  pid_t GetPid() const { return ring_buffer_record.sample_id.pid; }
+  pid_t GetTid() const { return ring_buffer_record.sample_id.tid; }
+
+  uint64_t* GetCallchain() { return ips.data(); }
+  const uint64_t* GetCallchain() const { return ips.data(); }
+
+  uint64_t GetCallchainSize() const { return ring_buffer_record.nr; }
+};
+
+// A sampled page fault of a thread of a captured process, from the
+// major-faults or the minor-faults software event opened with
+// callchain_sample_event_open. The TracerThread sets major and weight, the
+// sampling period of the event, from the stream id.
+class PageFaultPerfEvent : public PerfEvent,
+                           public SlabAllocated<PageFaultPerfEvent> {
+ public:
+  perf_event_callchain_sample_fixed ring_buffer_record;
+  std::vector<uint64_t> ips;
+  bool major = false;
+  uint64_t weight = 1;
+  explicit PageFaultPerfEvent(uint64_t callchain_size) : ips(callchain_size) {
+    ring_buffer_record.nr = callchain_size;
+  }
+
+  uint64_t GetTimestamp() const override {
+    return ring_buffer_record.sample_id.time;
+  }
+
+  void Accept(PerfEventVisitor* visitor) override;
+
+  pid_t GetPid() const { return ring_buffer_record.sample_id.pid; }
+  pid_t GetTid() const { return ring_buffer_record.sample_id.tid; }
+
+  uint64_t* GetCallchain() { return ips.data(); }
+  const uint64_t* GetCallchain() const { return ips.data(); }
+
+  uint64_t GetCallchainSize() const { return ring_buffer_record.nr; }
+};
+
+// A call to mmap or munmap of a thread of a captured process, from the
+// syscalls:sys_enter_mmap and syscalls:sys_enter_munmap tracepoints. Only
+// counted, hence the arguments are not read.
+class MemoryMapSyscallPerfEvent
+    : public PerfEvent,
+      public SlabAllocated<MemoryMapSyscallPerfEvent> {
+ public:
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  bool munmap = false;
+
+  uint64_t GetTimestamp() const override { return sample_id.time; }
+
+  void Accept(PerfEventVisitor* visitor) override;
+
+  pid_t GetPid() const { return sample_id.pid; }
+  pid_t GetTid() const { return sample_id.tid; }
+};
+
+// The entry of a syscall of a thread of a captured process, from the
+// raw_syscalls:sys_enter tracepoint.
+class SyscallEnterPerfEvent : public PerfEvent,
+                              public SlabAllocated<SyscallEnterPerfEvent> {
+ public:
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  int64_t syscall_nr = 0;
+
+  uint64_t GetTimestamp() const override { return sample_id.time; }
+
+  void Accept(PerfEventVisitor* visitor) override;
+
+  pid_t GetPid() const { return sample_id.pid; }
+  pid_t GetTid() const { return sample_id.tid; }
+};
+
+// The return of a syscall, from the raw_syscalls:sys_exit tracepoint.
+class SyscallExitPerfEvent : public PerfEvent,
+                             public SlabAllocated<SyscallExitPerfEvent> {
+ public:
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  int64_t syscall_nr = 0;
+  int64_t ret = 0;
+
+  uint64_t GetTimestamp() const override { return sample_id.time; }
+
+  void Accept(PerfEventVisitor* visitor) override;
+
+  pid_t GetPid() const { return sample_id.pid; }
+  pid_t GetTid() const { return sample_id.tid; }
+};
+
+// A block I/O request issued to a device, from the block:block_rq_issue
+// tracepoint, in the context of the thread that issued it.
+class BlockRqIssuePerfEvent : public PerfEvent,
+                              public SlabAllocated<BlockRqIssuePerfEvent> {
+ public:
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  uint32_t dev = 0;
+  uint64_t sector = 0;
+  uint32_t nr_sector = 0;
+  bool write = false;
+
+  uint64_t GetTimestamp() const override { return sample_id.time; }
+
+  void Accept(PerfEventVisitor* visitor) override;
+
+  pid_t GetPid() const { return sample_id.pid; }
+  pid_t GetTid() const { return sample_id.tid; }
+};
+
+// The completion of a block I/O request, from the block:block_rq_complete
+// tracepoint, usually in an interrupt, on any cpu.
+class BlockRqCompletePerfEvent
+    : public PerfEvent,
+      public SlabAllocated<BlockRqCompletePerfEvent> {
+ public:
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  uint32_t dev = 0;
+  uint64_t sector = 0;
+  int32_t error = 0;
+
+  uint64_t GetTimestamp() const override { return sample_id.time; }
+
+  void Accept(PerfEventVisitor* visitor) override;
+};
+
+// A callchain sample that also has the registers and the top of the stack,
+// to unwind its innermost frames with DWARF. The ring buffer record is
+// perf_event_callchain_sample_fixed, followed by the callchain and then by
+// the same registers and stack as perf_event_stack_sample_fixed.
+class HybridSamplePerfEvent : public PerfEvent,
+                              public SlabAllocated<HybridSamplePerfEvent> {
+ public:
+  std::unique_ptr<dynamically_sized_perf_event_stack_sample> ring_buffer_record;
+  std::vector<uint64_t> ips;
+
+  HybridSamplePerfEvent(uint64_t callchain_size, uint64_t dyn_size)
+      : ring_buffer_record{
+            std::make_unique<dynamically_sized_perf_event_stack_sample>(
+                dyn_size)},
+        ips(callchain_size) {}
+
+  uint64_t GetTimestamp() const override {
+    return ring_buffer_record->sample_id.time;
+  }
+
+  void Accept(PerfEventVisitor* visitor) override;
+
+  pid_t GetPid() const { return ring_buffer_record->sample_id.pid; }
+  pid_t GetTid() const { return ring_buffer_record->sample_id.tid; }
+
+  uint64_t GetStreamId() const {
+    return ring_buffer_record->sample_id.stream_id;
+  }
+
+  uint32_t GetCpu() const { return ring_buffer_record->sample_id.cpu; }
+
+  uint64_t* GetCallchain() { return ips.data(); }
+  const uint64_t* GetCallchain() const { return ips.data(); }
+
+  uint64_t GetCallchainSize() const { return ips.size(); }
+
+  std::array<uint64_t, PERF_REG_X86_64_MAX> GetRegisters() const {
+    return perf_event_sample_regs_user_all_to_register_array(
+        ring_buffer_record->regs);
+  }
+
+  const char* GetStackData() const {
+    return ring_buffer_record->stack.data.get();
+  }
+  char* GetStackData() { return ring_buffer_record->stack.data.get(); }
+  uint64_t GetStackSize() const { return ring_buffer_record->stack.dyn_size; }
+};
+
 class AbstractUprobesPerfEvent {
  public:
   const Function* GetFunction() const { return function_; }
@@ -297,7 +630,9 @@ class AbstractUprobesPerfEvent {
   const Function* function_ = nullptr;
 };
 
-class UprobesPerfEvent : public PerfEvent, public AbstractUprobesPerfEvent {
+class UprobesPerfEvent : public PerfEvent,
+                         public AbstractUprobesPerfEvent,
+                         public SlabAllocated<UprobesPerfEvent> {
  public:
   perf_event_sp_ip_arguments_8bytes_sample ring_buffer_record;
 
@@ -327,7 +662,9 @@ class UprobesPerfEvent : public PerfEvent, public AbstractUprobesPerfEvent {
   }
 };
 
-class UretprobesPerfEvent : public PerfEvent, public AbstractUprobesPerfEvent {
+class UretprobesPerfEvent : public PerfEvent,
+                            public AbstractUprobesPerfEvent,
+                            public SlabAllocated<UretprobesPerfEvent> {
  public:
   perf_event_ax_sample ring_buffer_record;
 
@@ -351,22 +688,43 @@ class UretprobesPerfEvent : public PerfEvent, public AbstractUprobesPerfEvent {
   uint32_t GetCpu() const { return ring_buffer_record.sample_id.cpu; }
 };
 
-// This carries a snapshot of /proc/<pid>/maps and does not reflect a
-// perf_event_open event, but we want it to be part of the same hierarchy.
-class MapsPerfEvent : public PerfEvent {
+// A new executable memory mapping, from a PERF_RECORD_MMAP2. As the filename
+// has variable length, the fields are copied out of the ring buffer record.
+class MmapPerfEvent : public PerfEvent {
  public:
-  MapsPerfEvent(uint64_t timestamp, std::string maps)
-      : timestamp_{timestamp}, maps_{std::move(maps)} {}
+  MmapPerfEvent(uint64_t timestamp, pid_t pid, uint64_t address,
+                uint64_t length, uint64_t page_offset, uint32_t prot,
+                std::string filename)
+      : timestamp_{timestamp},
+        pid_{pid},
+        address_{address},
+        length_{length},
+        page_offset_{page_offset},
+        prot_{prot},
+        filename_{std::move(filename)} {}
 
   uint64_t GetTimestamp() const override { return timestamp_; }
 
   void Accept(PerfEventVisitor* visitor) override;
 
-  const std::string& GetMaps() const { return maps_; }
+  pid_t GetPid() const { return pid_; }
+  uint64_t GetAddress() const { return address_; }
+  uint64_t GetLength() const { return length_; }
+  uint64_t GetPageOffset() const { return page_offset_; }
+  // PROT_READ, PROT_WRITE, PROT_EXEC.
+  uint32_t GetProt() const { return prot_; }
+  // Anonymous mappings are called "//anon".
+  const std::string& GetFilename() const { return filename_; }
+  void SetFilename(std::string filename) { filename_ = std::move(filename); }
 
  private:
   uint64_t timestamp_;
-  std::string maps_;
+  pid_t pid_;
+  uint64_t address_;
+  uint64_t length_;
+  uint64_t page_offset_;
+  uint32_t prot_;
+  std::string filename_;
 };
 
 class TracepointPerfEvent : public PerfEvent {
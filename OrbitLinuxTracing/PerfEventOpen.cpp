@@ -15,7 +15,8 @@
 
 namespace LinuxTracing {
 namespace {
-perf_event_attr generic_event_attr() {
+perf_event_attr generic_event_attr(uint32_t wakeup_watermark,
+                                   bool write_backward = false) {
   perf_event_attr pe{};
   pe.size = sizeof(struct perf_event_attr);
   pe.sample_period = 1;
@@ -25,11 +26,20 @@ perf_event_attr generic_event_attr() {
   pe.disabled = 1;
   pe.sample_type = SAMPLE_TYPE_TID_TIME_STREAMID_CPU;
 
+  // A value of zero keeps the kernel's default, i.e., poll/epoll report the
+  // ring buffer as readable once it's half full.
+  if (wakeup_watermark > 0) {
+    pe.watermark = 1;
+    pe.wakeup_watermark = wakeup_watermark;
+  }
+  pe.write_backward = write_backward ? 1 : 0;
+
   return pe;
 }
 
-int generic_event_open(perf_event_attr* attr, pid_t pid, int32_t cpu) {
-  int fd = perf_event_open(attr, pid, cpu, -1, 0);
+int generic_event_open(perf_event_attr* attr, pid_t pid, int32_t cpu,
+                       int group_fd = -1) {
+  int fd = perf_event_open(attr, pid, cpu, group_fd, 0);
   if (fd == -1) {
     ERROR("perf_event_open: %s", SafeStrerror(errno));
   }
@@ -37,8 +47,9 @@ int generic_event_open(perf_event_attr* attr, pid_t pid, int32_t cpu) {
 }
 
 perf_event_attr uprobe_event_attr(const char* module,
-                                  uint64_t function_offset) {
-  perf_event_attr pe = generic_event_attr();
+                                  uint64_t function_offset,
+                                  uint32_t wakeup_watermark) {
+  perf_event_attr pe = generic_event_attr(wakeup_watermark);
 
   pe.type = 7;  // TODO: should be read from
                 //  "/sys/bus/event_source/devices/uprobe/type"
@@ -48,10 +59,26 @@ perf_event_attr uprobe_event_attr(const char* module,
 
   return pe;
 }
+
+perf_event_attr lbr_sample_event_attr(const SamplingEvent& sampling_event,
+                                      uint32_t wakeup_watermark) {
+  perf_event_attr pe = generic_event_attr(wakeup_watermark);
+  pe.type = sampling_event.type;
+  pe.config = sampling_event.config;
+  pe.sample_period = sampling_event.period;
+  pe.sample_type |= PERF_SAMPLE_CALLCHAIN | PERF_SAMPLE_BRANCH_STACK;
+  pe.sample_max_stack = SAMPLE_MAX_STACK;
+  pe.exclude_callchain_kernel = !sampling_event.kernel_callchain;
+  // The branch stack then only holds the calls that haven't returned yet.
+  pe.branch_sample_type =
+      PERF_SAMPLE_BRANCH_USER | PERF_SAMPLE_BRANCH_CALL_STACK;
+  return pe;
+}
 }  // namespace
 
-int context_switch_event_open(pid_t pid, int32_t cpu) {
-  perf_event_attr pe = generic_event_attr();
+int context_switch_event_open(pid_t pid, int32_t cpu, uint32_t wakeup_watermark,
+                              bool write_backward) {
+  perf_event_attr pe = generic_event_attr(wakeup_watermark, write_backward);
   pe.type = PERF_TYPE_SOFTWARE;
   pe.config = PERF_COUNT_SW_DUMMY;
   pe.context_switch = 1;
@@ -59,47 +86,90 @@ int context_switch_event_open(pid_t pid, int32_t cpu) {
   return generic_event_open(&pe, pid, cpu);
 }
 
-int mmap_task_event_open(pid_t pid, int32_t cpu) {
-  perf_event_attr pe = generic_event_attr();
+int mmap_task_event_open(pid_t pid, int32_t cpu, uint32_t wakeup_watermark,
+                         bool write_backward) {
+  perf_event_attr pe = generic_event_attr(wakeup_watermark, write_backward);
   pe.type = PERF_TYPE_SOFTWARE;
   pe.config = PERF_COUNT_SW_DUMMY;
   pe.mmap = 1;
+  // Report PERF_RECORD_MMAP2 instead of PERF_RECORD_MMAP, as they also contain
+  // the protection of the mapping.
+  pe.mmap2 = 1;
   pe.task = 1;
 
   return generic_event_open(&pe, pid, cpu);
 }
 
-int stack_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu) {
-  perf_event_attr pe = generic_event_attr();
-  pe.type = PERF_TYPE_SOFTWARE;
-  pe.config = PERF_COUNT_SW_CPU_CLOCK;
-  pe.sample_period = period_ns;
+int stack_sample_event_open(const SamplingEvent& sampling_event, pid_t pid,
+                            int32_t cpu, uint16_t stack_dump_size,
+                            uint32_t wakeup_watermark) {
+  perf_event_attr pe = generic_event_attr(wakeup_watermark);
+  pe.type = sampling_event.type;
+  pe.config = sampling_event.config;
+  pe.sample_period = sampling_event.period;
   pe.sample_type |= PERF_SAMPLE_REGS_USER | PERF_SAMPLE_STACK_USER;
   pe.sample_regs_user = SAMPLE_REGS_USER_ALL;
-  pe.sample_stack_user = SAMPLE_STACK_USER_SIZE;
+  pe.sample_stack_user = stack_dump_size;
 
   return generic_event_open(&pe, pid, cpu);
 }
 
-int callchain_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu) {
-  perf_event_attr pe = generic_event_attr();
-  pe.type = PERF_TYPE_SOFTWARE;
-  pe.config = PERF_COUNT_SW_CPU_CLOCK;
-  pe.sample_period = period_ns;
+int callchain_sample_event_open(const SamplingEvent& sampling_event, pid_t pid,
+                                int32_t cpu, uint32_t wakeup_watermark,
+                                bool write_backward) {
+  perf_event_attr pe = generic_event_attr(wakeup_watermark, write_backward);
+  pe.type = sampling_event.type;
+  pe.config = sampling_event.config;
+  pe.sample_period = sampling_event.period;
   pe.sample_type |= PERF_SAMPLE_CALLCHAIN;
-  // TODO(kuebler): Read this from /proc/sys/kernel/perf_event_max_stack
-  pe.sample_max_stack = 127;
-  pe.exclude_callchain_kernel = true;
+  pe.sample_max_stack = SAMPLE_MAX_STACK;
+  pe.exclude_callchain_kernel = !sampling_event.kernel_callchain;
+
+  return generic_event_open(&pe, pid, cpu);
+}
+
+int hybrid_sample_event_open(const SamplingEvent& sampling_event, pid_t pid,
+                             int32_t cpu, uint16_t stack_dump_size,
+                             uint32_t wakeup_watermark) {
+  perf_event_attr pe = generic_event_attr(wakeup_watermark);
+  pe.type = sampling_event.type;
+  pe.config = sampling_event.config;
+  pe.sample_period = sampling_event.period;
+  pe.sample_type |=
+      PERF_SAMPLE_CALLCHAIN | PERF_SAMPLE_REGS_USER | PERF_SAMPLE_STACK_USER;
+  pe.sample_max_stack = SAMPLE_MAX_STACK;
+  pe.exclude_callchain_kernel = !sampling_event.kernel_callchain;
+  pe.sample_regs_user = SAMPLE_REGS_USER_ALL;
+  pe.sample_stack_user = stack_dump_size;
 
   return generic_event_open(&pe, pid, cpu);
 }
 
+int lbr_sample_event_open(const SamplingEvent& sampling_event, pid_t pid,
+                          int32_t cpu, uint32_t wakeup_watermark) {
+  perf_event_attr pe = lbr_sample_event_attr(sampling_event, wakeup_watermark);
+  return generic_event_open(&pe, pid, cpu);
+}
+
+bool is_lbr_call_stack_supported() {
+  // Not through generic_event_open, as failing is expected on most CPUs.
+  perf_event_attr pe = lbr_sample_event_attr(SamplingEvent{}, 0);
+  pe.sample_period = 1000000;
+  int fd = perf_event_open(&pe, 0, -1, -1, 0);
+  if (fd == -1) {
+    return false;
+  }
+  close(fd);
+  return true;
+}
+
 int uprobes_retaddr_event_open(const char* module, uint64_t function_offset,
-                               pid_t pid, int32_t cpu) {
-  perf_event_attr pe = uprobe_event_attr(module, function_offset);
+                               pid_t pid, int32_t cpu, uint32_t argument_count,
+                               uint32_t wakeup_watermark) {
+  perf_event_attr pe = uprobe_event_attr(module, function_offset, wakeup_watermark);
   pe.config = 0;
   pe.sample_type |= PERF_SAMPLE_REGS_USER | PERF_SAMPLE_STACK_USER;
-  pe.sample_regs_user = SAMPLE_REGS_USER_SP_IP_ARGUMENTS;
+  pe.sample_regs_user = sample_regs_user_sp_ip_arguments(argument_count);
 
   // Only get the very top of the stack, where the return address has been
   // pushed. We record it as it is about to be hijacked by the installation of
@@ -110,8 +180,9 @@ int uprobes_retaddr_event_open(const char* module, uint64_t function_offset,
 }
 
 int uprobes_stack_event_open(const char* module, uint64_t function_offset,
-                             pid_t pid, int32_t cpu) {
-  perf_event_attr pe = uprobe_event_attr(module, function_offset);
+                             pid_t pid, int32_t cpu,
+                             uint32_t wakeup_watermark) {
+  perf_event_attr pe = uprobe_event_attr(module, function_offset, wakeup_watermark);
   pe.config = 0;
   pe.sample_type |= PERF_SAMPLE_REGS_USER | PERF_SAMPLE_STACK_USER;
   pe.sample_regs_user = SAMPLE_REGS_USER_ALL;
@@ -120,18 +191,38 @@ int uprobes_stack_event_open(const char* module, uint64_t function_offset,
   return generic_event_open(&pe, pid, cpu);
 }
 
+int uprobes_callchain_event_open(const char* module, uint64_t function_offset,
+                                 pid_t pid, int32_t cpu,
+                                 uint32_t wakeup_watermark) {
+  perf_event_attr pe =
+      uprobe_event_attr(module, function_offset, wakeup_watermark);
+  pe.config = 0;
+  pe.sample_type |=
+      PERF_SAMPLE_CALLCHAIN | PERF_SAMPLE_REGS_USER | PERF_SAMPLE_STACK_USER;
+  pe.sample_max_stack = SAMPLE_MAX_STACK;
+  pe.exclude_callchain_kernel = true;
+  pe.sample_regs_user = SAMPLE_REGS_USER_DI;
+  pe.sample_stack_user = SAMPLE_STACK_USER_SIZE_8BYTES;
+
+  return generic_event_open(&pe, pid, cpu);
+}
+
 int uretprobes_event_open(const char* module, uint64_t function_offset,
-                          pid_t pid, int32_t cpu) {
-  perf_event_attr pe = uprobe_event_attr(module, function_offset);
+                          pid_t pid, int32_t cpu, bool record_ax,
+                          uint32_t wakeup_watermark) {
+  perf_event_attr pe = uprobe_event_attr(module, function_offset, wakeup_watermark);
   pe.config = 1;  // Set bit 0 of config for uretprobe.
 
-  pe.sample_type |= PERF_SAMPLE_REGS_USER;
-  pe.sample_regs_user = SAMPLE_REGS_USER_AX;
+  if (record_ax) {
+    pe.sample_type |= PERF_SAMPLE_REGS_USER;
+    pe.sample_regs_user = SAMPLE_REGS_USER_AX;
+  }
 
   return generic_event_open(&pe, pid, cpu);
 }
 
-void* perf_event_open_mmap_ring_buffer(int fd, uint64_t mmap_length) {
+void* perf_event_open_mmap_ring_buffer(int fd, uint64_t mmap_length,
+                                       bool overwrite) {
   // The size of the ring buffer excluding the metadata page must be a power of
   // two number of pages.
   if (mmap_length < GetPageSize() ||
@@ -140,9 +231,10 @@ void* perf_event_open_mmap_ring_buffer(int fd, uint64_t mmap_length) {
     return nullptr;
   }
 
-  // Use mmap to get access to the ring buffer.
-  void* mmap_ret =
-      mmap(nullptr, mmap_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  // Use mmap to get access to the ring buffer. Without PROT_WRITE we can't
+  // write data_tail, and the kernel overwrites the oldest data when full.
+  int prot = overwrite ? PROT_READ : PROT_READ | PROT_WRITE;
+  void* mmap_ret = mmap(nullptr, mmap_length, prot, MAP_SHARED, fd, 0);
   if (mmap_ret == reinterpret_cast<void*>(-1)) {
     ERROR("mmap: %s", SafeStrerror(errno));
     return nullptr;
@@ -152,12 +244,13 @@ void* perf_event_open_mmap_ring_buffer(int fd, uint64_t mmap_length) {
 }
 
 int tracepoint_event_open(const char* tracepoint_category,
-                          const char* tracepoint_name, pid_t pid, int32_t cpu) {
+                          const char* tracepoint_name, pid_t pid, int32_t cpu,
+                          uint32_t wakeup_watermark) {
   int tp_id = GetTracepointId(tracepoint_category, tracepoint_name);
   if (tp_id == -1) {
     return -1;
   }
-  perf_event_attr pe = generic_event_attr();
+  perf_event_attr pe = generic_event_attr(wakeup_watermark);
   pe.type = PERF_TYPE_TRACEPOINT;
   pe.config = tp_id;
   pe.sample_type |= PERF_SAMPLE_RAW;
@@ -165,4 +258,51 @@ int tracepoint_event_open(const char* tracepoint_category,
   return generic_event_open(&pe, pid, cpu);
 }
 
+int sched_switch_counters_event_open(int32_t cpu, uint32_t wakeup_watermark) {
+  int tp_id = GetTracepointId("sched", "sched_switch");
+  if (tp_id == -1) {
+    return -1;
+  }
+  perf_event_attr pe = generic_event_attr(wakeup_watermark);
+  pe.type = PERF_TYPE_TRACEPOINT;
+  pe.config = tp_id;
+  pe.sample_type |= PERF_SAMPLE_READ;
+  pe.read_format = PERF_FORMAT_GROUP;
+
+  return generic_event_open(&pe, -1, cpu);
+}
+
+int tracepoint_callchain_event_open(const char* tracepoint_category,
+                                    const char* tracepoint_name, int32_t cpu,
+                                    uint32_t wakeup_watermark) {
+  int tp_id = GetTracepointId(tracepoint_category, tracepoint_name);
+  if (tp_id == -1) {
+    return -1;
+  }
+  perf_event_attr pe = generic_event_attr(wakeup_watermark);
+  pe.type = PERF_TYPE_TRACEPOINT;
+  pe.config = tp_id;
+  pe.sample_type |= PERF_SAMPLE_CALLCHAIN | PERF_SAMPLE_RAW;
+  pe.sample_max_stack = SAMPLE_MAX_STACK;
+  pe.exclude_callchain_kernel = true;
+
+  return generic_event_open(&pe, -1, cpu);
+}
+
+int sched_switch_callchain_event_open(int32_t cpu, uint32_t wakeup_watermark) {
+  return tracepoint_callchain_event_open("sched", "sched_switch", cpu,
+                                         wakeup_watermark);
+}
+
+int hardware_counter_event_open(uint64_t config, int32_t cpu, int group_fd) {
+  perf_event_attr pe{};
+  pe.size = sizeof(struct perf_event_attr);
+  pe.type = PERF_TYPE_HARDWARE;
+  pe.config = config;
+  // sample_period and disabled are left at zero: the event is counted but not
+  // sampled, and it is enabled and disabled with the group leader.
+
+  return generic_event_open(&pe, -1, cpu, group_fd);
+}
+
 }  // namespace LinuxTracing
@@ -15,6 +15,7 @@
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <array>
 #include <cerrno>
 #include <cstdint>
 #include <cstring>
@@ -53,6 +54,22 @@ inline void perf_event_disable(int file_descriptor) {
   }
 }
 
+inline void perf_event_set_period(int file_descriptor, uint64_t period) {
+  int ret = ioctl(file_descriptor, PERF_EVENT_IOC_PERIOD, &period);
+  if (ret != 0) {
+    ERROR("PERF_EVENT_IOC_PERIOD: %s", SafeStrerror(errno));
+  }
+}
+
+// Only records the events of a tracepoint that match the filter, e.g.,
+// "id == 0 || id == 1", as in the filter files of tracefs.
+inline void perf_event_set_filter(int file_descriptor, const char* filter) {
+  int ret = ioctl(file_descriptor, PERF_EVENT_IOC_SET_FILTER, filter);
+  if (ret != 0) {
+    ERROR("PERF_EVENT_IOC_SET_FILTER: %s", SafeStrerror(errno));
+  }
+}
+
 inline void perf_event_redirect(int from_fd, int to_fd) {
   int ret = ioctl(from_fd, PERF_EVENT_IOC_SET_OUTPUT, to_fd);
   if (ret != 0) {
@@ -96,6 +113,10 @@ static constexpr uint64_t SAMPLE_REGS_USER_ALL =
 // PerfEventRecords.h.
 static constexpr uint64_t SAMPLE_REGS_USER_AX = (1lu << PERF_REG_X86_AX);
 
+// The first integer argument of a function. This must be in sync with struct
+// perf_event_sample_regs_user_di in PerfEventRecords.h.
+static constexpr uint64_t SAMPLE_REGS_USER_DI = (1lu << PERF_REG_X86_DI);
+
 // This must be in sync with struct perf_event_sample_regs_user_sp_ip_arguments
 // in PerfEventRecords.h.
 static constexpr uint64_t SAMPLE_REGS_USER_SP_IP_ARGUMENTS =
@@ -104,52 +125,169 @@ static constexpr uint64_t SAMPLE_REGS_USER_SP_IP_ARGUMENTS =
     (1lu << PERF_REG_X86_SP) | (1lu << PERF_REG_X86_IP) |
     (1lu << PERF_REG_X86_R8) | (1lu << PERF_REG_X86_R9);
 
+// The registers of the integer arguments of a function, in the order of the
+// System V AMD64 calling convention.
+static constexpr std::array<int, 6> ARGUMENT_REGISTERS = {
+    PERF_REG_X86_DI, PERF_REG_X86_SI, PERF_REG_X86_DX,
+    PERF_REG_X86_CX, PERF_REG_X86_R8, PERF_REG_X86_R9};
+static constexpr uint32_t MAX_RECORDED_ARGUMENT_COUNT =
+    ARGUMENT_REGISTERS.size();
+
+// The subset of SAMPLE_REGS_USER_SP_IP_ARGUMENTS with only the registers of the
+// first argument_count arguments, in addition to sp and ip.
+constexpr uint64_t sample_regs_user_sp_ip_arguments(uint32_t argument_count) {
+  uint64_t sample_regs_user =
+      (1lu << PERF_REG_X86_SP) | (1lu << PERF_REG_X86_IP);
+  for (uint32_t i = 0;
+       i < argument_count && i < MAX_RECORDED_ARGUMENT_COUNT; ++i) {
+    sample_regs_user |= 1lu << ARGUMENT_REGISTERS[i];
+  }
+  return sample_regs_user;
+}
+
 // Max to pass to perf_event_open without getting an error is (1u << 16u) - 8,
 // because the kernel stores this in a short and because of alignment reasons.
 // But the size the kernel actually returns is smaller, because the maximum size
 // of the entire record the kernel is willing to return is (1u << 16u) - 8.
 // If we want the size we pass to coincide with the size we get, we need to pass
-// a lower value. For the current layout of perf_event_stack_sample, the maximum
-// size is 65312, but let's leave some extra room.
-// TODO: As this amount of memory has to be copied from the ring buffer for each
-//  sample, this constant should be a parameters and should be made available in
-//  some setting.
+// a lower value. For the current layout of perf_event_stack_sample_fixed, the
+// maximum size is 65312, but let's leave some extra room.
+// This is the maximum (and default) size of the stack dump of stack samples:
+// a smaller size can be passed to stack_sample_event_open.
 static constexpr uint16_t SAMPLE_STACK_USER_SIZE = 65000;
 
 static_assert(sizeof(void*) == 8);
 static constexpr uint16_t SAMPLE_STACK_USER_SIZE_8BYTES = 8;
 
+// Maximum number of frames of the callchain of callchain and hybrid samples.
+// TODO(kuebler): Read this from /proc/sys/kernel/perf_event_max_stack
+static constexpr uint16_t SAMPLE_MAX_STACK = 127;
+
+// Hybrid samples also contain the callchain, which leaves less room for the
+// stack dump in the record.
+static constexpr uint16_t SAMPLE_STACK_USER_SIZE_HYBRID_MAX =
+    SAMPLE_STACK_USER_SIZE - SAMPLE_MAX_STACK * sizeof(uint64_t);
+// The default size of the stack dump of hybrid samples: the stack frames of
+// leaf functions, the only ones unwound with DWARF, are normally small.
+static constexpr uint16_t SAMPLE_STACK_USER_SIZE_HYBRID = 4096;
+
+// The hardware events counted in the group of the sched_switch_counters events,
+// in this order. This must be in sync with struct
+// perf_event_sched_switch_counters_sample in PerfEventRecords.h.
+static constexpr std::array<uint64_t, 4> SCHED_SWITCH_HARDWARE_COUNTERS{
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+// The event that triggers samples and the number of these events between two
+// samples, e.g., nanoseconds for PERF_COUNT_SW_CPU_CLOCK.
+struct SamplingEvent {
+  uint32_t type = PERF_TYPE_SOFTWARE;
+  uint64_t config = PERF_COUNT_SW_CPU_CLOCK;
+  uint64_t period = 0;
+  // Whether the callchains of the samples start with the kernel frames, for
+  // the samples taken in the kernel.
+  bool kernel_callchain = false;
+};
+
+// All the following functions take a wakeup_watermark: the number of bytes
+// that need to be in the ring buffer (if the file descriptor is used to create
+// one) before poll/epoll report it as readable. Pass zero to use the kernel's
+// default.
+// Those that take write_backward can be used with overwrite ring buffers, see
+// PerfEventRingBuffer. Events with and without it can't share a ring buffer.
+
 // perf_event_open for context switches.
-int context_switch_event_open(pid_t pid, int32_t cpu);
+int context_switch_event_open(pid_t pid, int32_t cpu, uint32_t wakeup_watermark,
+                              bool write_backward = false);
 
 // perf_event_open for task (fork and exit) and mmap records in the same buffer.
-int mmap_task_event_open(pid_t pid, int32_t cpu);
+int mmap_task_event_open(pid_t pid, int32_t cpu, uint32_t wakeup_watermark,
+                         bool write_backward = false);
 
-// perf_event_open for stack sampling.
-int stack_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu);
+// perf_event_open for stack sampling. stack_dump_size must be a multiple of 8
+// and not larger than SAMPLE_STACK_USER_SIZE.
+int stack_sample_event_open(const SamplingEvent& sampling_event, pid_t pid,
+                            int32_t cpu, uint16_t stack_dump_size,
+                            uint32_t wakeup_watermark);
 
 // perf_event_open for stack sampling using frame pointers.
-int callchain_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu);
+int callchain_sample_event_open(const SamplingEvent& sampling_event, pid_t pid,
+                                int32_t cpu, uint32_t wakeup_watermark,
+                                bool write_backward = false);
+
+// perf_event_open for stack sampling using frame pointers, also with all the
+// registers and the top of the stack, to unwind the innermost frames with
+// DWARF. stack_dump_size must be a multiple of 8 and not larger than
+// SAMPLE_STACK_USER_SIZE_HYBRID_MAX.
+int hybrid_sample_event_open(const SamplingEvent& sampling_event, pid_t pid,
+                             int32_t cpu, uint16_t stack_dump_size,
+                             uint32_t wakeup_watermark);
+
+// perf_event_open for stack sampling using frame pointers, also with the call
+// stack of the last branch records (the call sites of the innermost frames).
+int lbr_sample_event_open(const SamplingEvent& sampling_event, pid_t pid,
+                          int32_t cpu, uint32_t wakeup_watermark);
+
+// Whether the CPU can record the call stack in its last branch records, by
+// opening an lbr_sample_event_open event on the calling thread.
+bool is_lbr_call_stack_supported();
 
 // perf_event_open for uprobes and uretprobes.
+// The uprobes only sample the registers of the first argument_count arguments,
+// see sample_regs_user_sp_ip_arguments.
 int uprobes_retaddr_event_open(const char* module, uint64_t function_offset,
-                               pid_t pid, int32_t cpu);
+                               pid_t pid, int32_t cpu, uint32_t argument_count,
+                               uint32_t wakeup_watermark);
 
 int uprobes_stack_event_open(const char* module, uint64_t function_offset,
-                             pid_t pid, int32_t cpu);
+                             pid_t pid, int32_t cpu,
+                             uint32_t wakeup_watermark);
+
+// perf_event_open for uprobes that record the user-space callchain, the first
+// argument of the function and the return address at the top of the stack,
+// which the callchain misses as the function didn't push a frame yet. The
+// record is perf_event_callchain_sample_fixed followed by the callchain, by
+// perf_event_sample_regs_user_di and by perf_event_sample_stack_user_8bytes.
+int uprobes_callchain_event_open(const char* module, uint64_t function_offset,
+                                 pid_t pid, int32_t cpu,
+                                 uint32_t wakeup_watermark);
 
+// Without record_ax, the records are perf_event_empty_sample.
 int uretprobes_event_open(const char* module, uint64_t function_offset,
-                          pid_t pid, int32_t cpu);
+                          pid_t pid, int32_t cpu, bool record_ax,
+                          uint32_t wakeup_watermark);
+
+// perf_event_open for the leader of a group of counters on cpu, for all
+// processes: a sample is recorded at every sched:sched_switch tracepoint,
+// reading the values of all the counters of the group, this tracepoint first.
+int sched_switch_counters_event_open(int32_t cpu, uint32_t wakeup_watermark);
+
+// perf_event_open for a tracepoint on cpu, for all processes, recording the
+// user-space callchain of the thread and the raw tracepoint data.
+int tracepoint_callchain_event_open(const char* tracepoint_category,
+                                    const char* tracepoint_name, int32_t cpu,
+                                    uint32_t wakeup_watermark);
+
+// tracepoint_callchain_event_open for sched:sched_switch, recorded for the
+// thread switched out.
+int sched_switch_callchain_event_open(int32_t cpu, uint32_t wakeup_watermark);
+
+// perf_event_open for a hardware event (PERF_COUNT_HW_*) counted on cpu, for
+// all processes, in the group of group_fd. The event is never sampled and is
+// enabled and disabled with the group leader.
+int hardware_counter_event_open(uint64_t config, int32_t cpu, int group_fd);
 
 // Create the ring buffer to use perf_event_open in sampled mode.
-void* perf_event_open_mmap_ring_buffer(int fd, uint64_t mmap_length);
+void* perf_event_open_mmap_ring_buffer(int fd, uint64_t mmap_length,
+                                       bool overwrite = false);
 
 // perf_event_open for tracepoint events. This opens a perf event for the
 // tracepoint given by the category (for example, "sched") and the name
 // (for example, "sched_waking"). Returns the file descriptor for the
 // perf event or -1 in case of any errors.
 int tracepoint_event_open(const char* tracepoint_category,
-                          const char* tracepoint_name, pid_t pid, int32_t cpu);
+                          const char* tracepoint_name, pid_t pid, int32_t cpu,
+                          uint32_t wakeup_watermark);
 
 }  // namespace LinuxTracing
 
@@ -18,7 +18,7 @@ void PerfEventProcessor::AddEvent(int /*origin_fd*/,
   if (last_processed_timestamp_ > 0 &&
       event->GetTimestamp() <
           last_processed_timestamp_ - PROCESSING_DELAY_MS * 1'000'000) {
-    ERROR("Processed an event out of order");
+    ERROR_RATE_LIMITED("Processed an event out of order");
   }
 #endif
 
@@ -6,8 +6,9 @@
 
 #include <OrbitBase/Logging.h>
 
+#include <algorithm>
+#include <limits>
 #include <memory>
-#include <queue>
 
 #include "PerfEvent.h"
 #include "Utils.h"
@@ -16,90 +17,170 @@ namespace LinuxTracing {
 
 void PerfEventQueue::PushEvent(int origin_fd,
                                std::unique_ptr<PerfEvent> event) {
-  if (fd_event_queues_.count(origin_fd) > 0) {
-    std::shared_ptr<std::queue<std::unique_ptr<PerfEvent>>> event_queue =
-        fd_event_queues_.at(origin_fd);
-    CHECK(!event_queue->empty());
+  size_t queue_index = GetOrAddQueue(origin_fd);
+  std::deque<TimestampedEvent>& event_queue = event_queues_[queue_index];
+  uint64_t timestamp = event->GetTimestamp();
+  watermarks_[queue_index] = std::max(watermarks_[queue_index], timestamp);
+  ++event_count_;
+
+  if (!event_queue.empty()) {
     // Fundamental assumption: events from the same file descriptor come already
     // in order.
-    CHECK(event->GetTimestamp() >= event_queue->front()->GetTimestamp());
-    event_queue->push(std::move(event));
-  } else {
-    auto event_queue =
-        std::make_shared<std::queue<std::unique_ptr<PerfEvent>>>();
-    fd_event_queues_.insert(std::make_pair(origin_fd, event_queue));
-    event_queue->push(std::move(event));
-    event_queues_queue_.push(std::make_pair(origin_fd, event_queue));
+    CHECK(timestamp >= event_queue.front().timestamp);
+    event_queue.push_back(TimestampedEvent{timestamp, std::move(event)});
+    return;
   }
+
+  event_queue.push_back(TimestampedEvent{timestamp, std::move(event)});
+  front_timestamps_[queue_index] = timestamp;
+  UpdateTournamentTree(queue_index);
 }
 
-bool PerfEventQueue::HasEvent() { return !event_queues_queue_.empty(); }
+bool PerfEventQueue::HasEvent() const {
+  // On ties the queue with the lowest index wins, hence the winner is always a
+  // queue that exists, even when all the queues are empty.
+  return leaf_count_ > 0 && !event_queues_[GetWinner(1)].empty();
+}
 
 PerfEvent* PerfEventQueue::TopEvent() {
-  return event_queues_queue_.top().second->front().get();
+  return event_queues_[GetWinner(1)].front().event.get();
 }
 
 std::unique_ptr<PerfEvent> PerfEventQueue::PopEvent() {
-  std::pair<int, std::shared_ptr<std::queue<std::unique_ptr<PerfEvent>>>>
-      top_fd_queue = event_queues_queue_.top();
-  event_queues_queue_.pop();
-  const int& top_fd = top_fd_queue.first;
-  std::shared_ptr<std::queue<std::unique_ptr<PerfEvent>>>& top_queue =
-      top_fd_queue.second;
-
-  std::unique_ptr<PerfEvent> top_event = std::move(top_queue->front());
-  top_queue->pop();
-  if (top_queue->empty()) {
-    fd_event_queues_.erase(top_fd);
-  } else {
-    // Remove and re-insert so that the queue is in the right position in the
-    // heap after the front of the queue has been removed.
-    event_queues_queue_.push(top_fd_queue);
-  }
+  size_t top_queue_index = GetWinner(1);
+  std::deque<TimestampedEvent>& top_queue = event_queues_[top_queue_index];
+
+  std::unique_ptr<PerfEvent> top_event = std::move(top_queue.front().event);
+  top_queue.pop_front();
+  --event_count_;
+  front_timestamps_[top_queue_index] =
+      top_queue.empty() ? EMPTY_QUEUE_TIMESTAMP : top_queue.front().timestamp;
+  UpdateTournamentTree(top_queue_index);
 
   return top_event;
 }
 
+void PerfEventQueue::UpdateWatermark(int origin_fd, uint64_t watermark) {
+  size_t queue_index = GetOrAddQueue(origin_fd);
+  watermarks_[queue_index] = std::max(watermarks_[queue_index], watermark);
+}
+
+uint64_t PerfEventQueue::GetMinWatermark() const {
+  // The number of queues is the number of ring buffers, so a linear scan is
+  // cheap compared to processing the events it allows to process.
+  uint64_t min_watermark = std::numeric_limits<uint64_t>::max();
+  for (uint64_t watermark : watermarks_) {
+    min_watermark = std::min(min_watermark, watermark);
+  }
+  return min_watermark;
+}
+
+size_t PerfEventQueue::GetOrAddQueue(int origin_fd) {
+  auto queue_index_it = queue_indices_by_fd_.find(origin_fd);
+  return queue_index_it != queue_indices_by_fd_.end() ? queue_index_it->second
+                                                      : AddQueue(origin_fd);
+}
+
+size_t PerfEventQueue::AddQueue(int origin_fd) {
+  size_t queue_index = event_queues_.size();
+  event_queues_.emplace_back();
+  watermarks_.push_back(0);
+  queue_indices_by_fd_.emplace(origin_fd, queue_index);
+  if (event_queues_.size() > leaf_count_) {
+    RebuildTournamentTree();
+  }
+  return queue_index;
+}
+
+size_t PerfEventQueue::GetWinner(size_t node) const {
+  return node >= leaf_count_ ? node - leaf_count_ : tournament_tree_[node];
+}
+
+void PerfEventQueue::UpdateTournamentTree(size_t queue_index) {
+  for (size_t node = (leaf_count_ + queue_index) / 2; node > 0; node /= 2) {
+    UpdateNode(node);
+  }
+}
+
+void PerfEventQueue::UpdateNode(size_t node) {
+  size_t left_winner = GetWinner(2 * node);
+  size_t right_winner = GetWinner(2 * node + 1);
+  tournament_tree_[node] =
+      front_timestamps_[left_winner] <= front_timestamps_[right_winner]
+          ? left_winner
+          : right_winner;
+}
+
+void PerfEventQueue::RebuildTournamentTree() {
+  // Keep the number of leaves a power of two, so that the tree is complete.
+  leaf_count_ = std::max<size_t>(leaf_count_, 1);
+  while (leaf_count_ < event_queues_.size()) {
+    leaf_count_ *= 2;
+  }
+  front_timestamps_.resize(leaf_count_, EMPTY_QUEUE_TIMESTAMP);
+  tournament_tree_.resize(leaf_count_);
+  for (size_t node = leaf_count_ - 1; node > 0; --node) {
+    UpdateNode(node);
+  }
+}
+
 void PerfEventProcessor2::AddEvent(int origin_fd,
                                    std::unique_ptr<PerfEvent> event) {
 #ifndef NDEBUG
-  if (last_processed_timestamp_ > 0 &&
-      event->GetTimestamp() <
-          last_processed_timestamp_ - PROCESSING_DELAY_MS * 1'000'000) {
-    ERROR("Processed an event out of order");
+  if (event->GetTimestamp() < last_processed_timestamp_) {
+    ERROR_RATE_LIMITED("Processed an event out of order");
   }
 #endif
   event_queue_.PushEvent(origin_fd, std::move(event));
 }
 
+void PerfEventProcessor2::VisitEvent(PerfEvent* event) {
+  event->Accept(visitor_.get());
+  for (PerfEventVisitor* additional_visitor : additional_visitors_) {
+    event->Accept(additional_visitor);
+  }
+}
+
 void PerfEventProcessor2::ProcessAllEvents() {
   while (event_queue_.HasEvent()) {
     std::unique_ptr<PerfEvent> event = event_queue_.PopEvent();
 #ifndef NDEBUG
     last_processed_timestamp_ = event->GetTimestamp();
 #endif
-    event->Accept(visitor_.get());
+    VisitEvent(event.get());
   }
 }
 
 void PerfEventProcessor2::ProcessOldEvents() {
   uint64_t max_timestamp = MonotonicTimestampNs();
+  uint64_t min_watermark = event_queue_.GetMinWatermark();
 
   while (event_queue_.HasEvent()) {
     PerfEvent* event = event_queue_.TopEvent();
 
-    // Do not read the most recent events as out-of-order events could arrive.
-    if (event->GetTimestamp() + PROCESSING_DELAY_MS * 1'000'000 >=
-        max_timestamp) {
+    // Do not read the most recent events as out-of-order events could arrive,
+    // unless all ring buffers have been read past them.
+    if (event->GetTimestamp() > min_watermark &&
+        event->GetTimestamp() + PROCESSING_DELAY_MS * 1'000'000 >=
+            max_timestamp) {
       break;
     }
 
 #ifndef NDEBUG
     last_processed_timestamp_ = event->GetTimestamp();
 #endif
-    event->Accept(visitor_.get());
+    VisitEvent(event);
     event_queue_.PopEvent();
   }
 }
 
+std::optional<uint64_t> PerfEventProcessor2::GetNextProcessingTimestampNs() {
+  if (!event_queue_.HasEvent()) {
+    return std::nullopt;
+  }
+  // This matches the condition in ProcessOldEvents.
+  return event_queue_.TopEvent()->GetTimestamp() +
+         PROCESSING_DELAY_MS * 1'000'000 + 1;
+}
+
 }  // namespace LinuxTracing
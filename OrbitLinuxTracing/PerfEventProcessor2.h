@@ -6,8 +6,11 @@
 #define ORBIT_LINUX_TRACING_PERF_EVENT_PROCESSOR_2_H_
 
 #include <ctime>
+#include <deque>
+#include <limits>
 #include <memory>
-#include <queue>
+#include <optional>
+#include <vector>
 
 #include "PerfEvent.h"
 #include "PerfEventVisitor.h"
@@ -21,77 +24,116 @@ namespace LinuxTracing {
 // Instead of keeping a single priority queue with all the events to process,
 // on which push/pop operations would be logarithmic in the number of events,
 // we leverage the fact that events coming from the same perf_event_open ring
-// buffer are already sorted. We then keep a priority queue of queues, where
-// the events in each queue come from the same ring buffer. Whenever an event
-// is removed from a queue, we need to move such queue down the priority
-// queue. As std::priority_queue does not support decreasing the priority of
-// an element, we achieve this by removing and re-inserting.
-// In order to be able to add an event to a queue, we also need to maintain
-// the association between a queue and its ring buffer. We use the file
-// descriptor used to read from the ring buffer as identifier for a ring
-// buffer. Keeping this association is what the pairs and the map are for.
-// TODO: Implement a custom priority queue that supports decreasing the
-//  priority.
+// buffer are already sorted. We then keep a queue of events for each ring
+// buffer, identified by the file descriptor used to read from it, and merge the
+// queues with a tournament tree: each internal node holds the index of the
+// queue with the oldest front event among the queues below it, so that the root
+// holds the queue with the oldest event overall.
+// The timestamp of each event is stored next to it, and the timestamp of the
+// front event of each queue in a contiguous array, so that comparisons in the
+// tree don't need to call the virtual PerfEvent::GetTimestamp.
+// Pushing an event to a non-empty queue doesn't change the tree, while popping
+// an event updates the path from the queue to the root, which is logarithmic in
+// the number of queues.
+// Each queue also has a watermark, the timestamp that no event pushed to it
+// later will be older than. It is the timestamp of the last event pushed, or
+// more recent if the caller knows that no older events will follow.
 class PerfEventQueue {
  public:
   void PushEvent(int origin_fd, std::unique_ptr<PerfEvent> event);
-  bool HasEvent();
+  bool HasEvent() const;
   PerfEvent* TopEvent();
   std::unique_ptr<PerfEvent> PopEvent();
+  [[nodiscard]] size_t GetEventCount() const { return event_count_; }
+
+  void UpdateWatermark(int origin_fd, uint64_t watermark);
+  // Returns the minimum watermark of all queues, which are created on the first
+  // event or watermark of their file descriptor.
+  [[nodiscard]] uint64_t GetMinWatermark() const;
 
  private:
-  // Comparator for the priority queue: pop will return the queue associated
-  // with the file descriptor from which the oldest event still to process
-  // originated.
-  struct QueueFrontTimestampReverseCompare {
-    bool operator()(
-        const std::pair<
-            int, std::shared_ptr<std::queue<std::unique_ptr<PerfEvent>>>>& lhs,
-        const std::pair<
-            int, std::shared_ptr<std::queue<std::unique_ptr<PerfEvent>>>>&
-            rhs) {
-      return lhs.second->front()->GetTimestamp() >
-             rhs.second->front()->GetTimestamp();
-    }
+  struct TimestampedEvent {
+    uint64_t timestamp;
+    std::unique_ptr<PerfEvent> event;
   };
 
-  std::priority_queue<
-      std::pair<int, std::shared_ptr<std::queue<std::unique_ptr<PerfEvent>>>>,
-      std::vector<std::pair<
-          int, std::shared_ptr<std::queue<std::unique_ptr<PerfEvent>>>>>,
-      QueueFrontTimestampReverseCompare>
-      event_queues_queue_{};
-  absl::flat_hash_map<int,
-                      std::shared_ptr<std::queue<std::unique_ptr<PerfEvent>>>>
-      fd_event_queues_{};
+  static constexpr uint64_t EMPTY_QUEUE_TIMESTAMP =
+      std::numeric_limits<uint64_t>::max();
+
+  size_t AddQueue(int origin_fd);
+  [[nodiscard]] size_t GetWinner(size_t node) const;
+  void UpdateTournamentTree(size_t queue_index);
+  void UpdateNode(size_t node);
+  void RebuildTournamentTree();
+
+  size_t GetOrAddQueue(int origin_fd);
+
+  std::vector<std::deque<TimestampedEvent>> event_queues_;
+  // Same indices as event_queues_.
+  std::vector<uint64_t> watermarks_;
+  absl::flat_hash_map<int, size_t> queue_indices_by_fd_;
+  // One entry per leaf of the tournament tree, EMPTY_QUEUE_TIMESTAMP for empty
+  // queues and for the leaves that have no queue (yet).
+  std::vector<uint64_t> front_timestamps_;
+  // Node 1 is the root and the children of node n are nodes 2n and 2n + 1.
+  // Nodes from leaf_count_ on are the leaves, i.e., the queues, and are not
+  // stored.
+  std::vector<size_t> tournament_tree_;
+  size_t leaf_count_ = 0;
+  size_t event_count_ = 0;
 };
 
 // This class receives perf_event_open events coming from several ring buffers
 // and processes them in order according to their timestamps.
-// Its implementation builds on the assumption that we never expect events with
-// a timestamp older than PROCESSING_DELAY_MS to be added. By not processing
-// events that are not older than this delay, we will never process events out
-// of order.
+// Events are processed as soon as they are not more recent than the watermark
+// of any ring buffer, i.e., as soon as no older event can be added anymore.
+// As a ring buffer that is not read, or whose reader doesn't report watermarks,
+// would hold back all the events, this falls back to the assumption that we
+// never expect events with a timestamp older than PROCESSING_DELAY_MS to be
+// added: events older than this delay are processed regardless of watermarks.
 class PerfEventProcessor2 {
  public:
-  // Do not process events that are more recent than 0.1 seconds. There could be
-  // events coming out of order as they are read from different perf_event_open
-  // ring buffers and this ensure that all events are processed in the correct
-  // order.
+  // Always process events that are older than 0.1 seconds, even if some ring
+  // buffer has an older watermark.
   static constexpr uint64_t PROCESSING_DELAY_MS = 100;
 
   explicit PerfEventProcessor2(std::unique_ptr<PerfEventVisitor> visitor)
       : visitor_(std::move(visitor)) {}
 
+  // Events are also visited by additional_visitor, after the main one. It is
+  // not owned, and has to outlive this object.
+  void AddVisitor(PerfEventVisitor* additional_visitor) {
+    additional_visitors_.push_back(additional_visitor);
+  }
+
   void AddEvent(int origin_fd, std::unique_ptr<PerfEvent> event);
 
+  // Signals that no event older than watermark will be added for origin_fd
+  // anymore. Call this with a watermark of zero before processing for the file
+  // descriptors that might not have events yet, so that they are waited for.
+  void UpdateWatermark(int origin_fd, uint64_t watermark) {
+    event_queue_.UpdateWatermark(origin_fd, watermark);
+  }
+
   void ProcessAllEvents();
 
   void ProcessOldEvents();
 
+  [[nodiscard]] size_t GetEventCount() const {
+    return event_queue_.GetEventCount();
+  }
+
+  // Returns the monotonic timestamp from which ProcessOldEvents will process
+  // the oldest event even if the watermarks don't advance, or nullopt if there
+  // are no events.
+  std::optional<uint64_t> GetNextProcessingTimestampNs();
+
  private:
   PerfEventQueue event_queue_;
   std::unique_ptr<PerfEventVisitor> visitor_;
+  std::vector<PerfEventVisitor*> additional_visitors_;
+
+  void VisitEvent(PerfEvent* event);
 
 #ifndef NDEBUG
   uint64_t last_processed_timestamp_ = 0;
@@ -4,7 +4,15 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
 #include "PerfEventProcessor2.h"
+#include "Utils.h"
 
 namespace LinuxTracing {
 
@@ -110,4 +118,135 @@ TEST(PerfEventQueue, MultipleFd) {
   EXPECT_FALSE(event_queue.HasEvent());
 }
 
+TEST(PerfEventQueue, ManyFdsInterleaved) {
+  constexpr int kFdCount = 37;
+  constexpr int kEventCountPerFd = 100;
+  PerfEventQueue event_queue;
+
+  // Each fd gets increasing timestamps, but the fds are interleaved and some of
+  // them only start later, which also grows the number of queues while events
+  // are being popped.
+  std::mt19937 random_generator{42};
+  std::vector<uint64_t> timestamps;
+  for (int fd = 0; fd < kFdCount; ++fd) {
+    uint64_t timestamp = fd * 10;
+    for (int i = 0; i < kEventCountPerFd; ++i) {
+      timestamp += 1 + random_generator() % 100;
+      timestamps.push_back(timestamp);
+      event_queue.PushEvent(fd, MakeTestEvent(timestamp));
+    }
+  }
+  std::sort(timestamps.begin(), timestamps.end());
+
+  for (uint64_t expected_timestamp : timestamps) {
+    ASSERT_TRUE(event_queue.HasEvent());
+    EXPECT_EQ(event_queue.TopEvent()->GetTimestamp(), expected_timestamp);
+    EXPECT_EQ(event_queue.PopEvent()->GetTimestamp(), expected_timestamp);
+  }
+  EXPECT_FALSE(event_queue.HasEvent());
+}
+
+TEST(PerfEventQueue, Watermarks) {
+  PerfEventQueue event_queue;
+  EXPECT_EQ(event_queue.GetMinWatermark(),
+            std::numeric_limits<uint64_t>::max());
+
+  event_queue.UpdateWatermark(11, 0);
+  event_queue.PushEvent(22, MakeTestEvent(100));
+  EXPECT_EQ(event_queue.GetMinWatermark(), 0);
+
+  event_queue.UpdateWatermark(11, 150);
+  EXPECT_EQ(event_queue.GetMinWatermark(), 100);
+
+  // Watermarks don't go back, and popping events doesn't change them.
+  event_queue.UpdateWatermark(22, 50);
+  event_queue.PopEvent();
+  EXPECT_EQ(event_queue.GetMinWatermark(), 100);
+
+  event_queue.PushEvent(22, MakeTestEvent(200));
+  EXPECT_EQ(event_queue.GetMinWatermark(), 150);
+}
+
+TEST(PerfEventProcessor2, ProcessesEventsUpToMinWatermark) {
+  constexpr int kFd1 = 11;
+  constexpr int kFd2 = 22;
+  // Recent enough that the events are not processed because of their age.
+  const uint64_t base_timestamp = MonotonicTimestampNs();
+  PerfEventProcessor2 processor{std::make_unique<PerfEventVisitor>()};
+  processor.UpdateWatermark(kFd1, 0);
+  processor.UpdateWatermark(kFd2, 0);
+
+  processor.AddEvent(kFd1, MakeTestEvent(base_timestamp + 10));
+  processor.AddEvent(kFd1, MakeTestEvent(base_timestamp + 30));
+  processor.ProcessOldEvents();
+  // kFd2 hasn't been read yet.
+  EXPECT_EQ(processor.GetNextProcessingTimestampNs(),
+            base_timestamp + 10 +
+                PerfEventProcessor2::PROCESSING_DELAY_MS * 1'000'000 + 1);
+
+  processor.UpdateWatermark(kFd2, base_timestamp + 20);
+  processor.ProcessOldEvents();
+  EXPECT_EQ(processor.GetNextProcessingTimestampNs(),
+            base_timestamp + 30 +
+                PerfEventProcessor2::PROCESSING_DELAY_MS * 1'000'000 + 1);
+
+  // The event from kFd2 is its own watermark, but kFd1 is still behind it.
+  processor.AddEvent(kFd2, MakeTestEvent(base_timestamp + 40));
+  processor.ProcessOldEvents();
+  EXPECT_EQ(processor.GetNextProcessingTimestampNs(),
+            base_timestamp + 40 +
+                PerfEventProcessor2::PROCESSING_DELAY_MS * 1'000'000 + 1);
+
+  processor.UpdateWatermark(kFd1, base_timestamp + 50);
+  processor.ProcessOldEvents();
+  EXPECT_FALSE(processor.GetNextProcessingTimestampNs().has_value());
+}
+
+TEST(PerfEventProcessor2, ProcessesOldEventsWithoutWatermarks) {
+  constexpr int kFd1 = 11;
+  constexpr int kFd2 = 22;
+  PerfEventProcessor2 processor{std::make_unique<PerfEventVisitor>()};
+  processor.UpdateWatermark(kFd2, 0);
+
+  const uint64_t processing_delay_ns =
+      PerfEventProcessor2::PROCESSING_DELAY_MS * 1'000'000;
+  const uint64_t now = MonotonicTimestampNs();
+  processor.AddEvent(kFd1, MakeTestEvent(now - 2 * processing_delay_ns));
+  processor.AddEvent(kFd1, MakeTestEvent(now));
+  processor.ProcessOldEvents();
+  EXPECT_EQ(processor.GetNextProcessingTimestampNs(),
+            now + processing_delay_ns + 1);
+}
+
+// Not run by default. Use --gtest_also_run_disabled_tests to run it.
+TEST(PerfEventQueue, DISABLED_Benchmark) {
+  constexpr int kFdCount = 64;
+  constexpr uint64_t kEventCount = 10'000'000;
+  constexpr uint64_t kEventsInQueue = 100'000;
+  PerfEventQueue event_queue;
+
+  // Like the events of per-cpu ring buffers, which are read in batches and
+  // consumed in order after a delay.
+  std::vector<uint64_t> next_timestamp_per_fd(kFdCount, 0);
+  std::mt19937 random_generator{42};
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < kEventCount; ++i) {
+    int fd = static_cast<int>(i / 16 % kFdCount);
+    next_timestamp_per_fd[fd] += 1 + random_generator() % 1000;
+    event_queue.PushEvent(fd, MakeTestEvent(next_timestamp_per_fd[fd]));
+    if (i >= kEventsInQueue) {
+      event_queue.PopEvent();
+    }
+  }
+  while (event_queue.HasEvent()) {
+    event_queue.PopEvent();
+  }
+  auto duration = std::chrono::steady_clock::now() - start;
+
+  std::cout << "Pushed and popped " << kEventCount << " events in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+                   .count()
+            << " ms" << std::endl;
+}
+
 }  // namespace LinuxTracing
@@ -5,24 +5,37 @@
 #include "PerfEventReaders.h"
 
 #include <OrbitBase/Logging.h>
+#include <linux/futex.h>
 
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "KernelTracepoints.h"
+#include "PerfEventOpen.h"
 #include "PerfEventRecords.h"
 #include "PerfEventRingBuffer.h"
 
 namespace LinuxTracing {
 
 pid_t ReadMmapRecordPid(PerfEventRingBuffer* ring_buffer) {
-  // Mmap records have the following layout:
+  // Mmap2 records have the following layout:
   // struct {
   //   struct perf_event_header header;
   //   u32    pid, tid;
   //   u64    addr;
   //   u64    len;
   //   u64    pgoff;
+  //   u32    maj;
+  //   u32    min;
+  //   u64    ino;
+  //   u64    ino_generation;
+  //   u32    prot, flags;
   //   char   filename[];
   //   struct sample_id sample_id; /* if sample_id_all */
   // };
-  // Because of filename, the layout is not fixed.
+  // Because of filename, the layout is not fixed. The pid is at the same
+  // offset as in PERF_RECORD_MMAP.
 
   pid_t pid;
   ring_buffer->ReadValueAtOffset(&pid, sizeof(perf_event_header));
@@ -41,6 +54,17 @@ uint64_t ReadSampleRecordStreamId(PerfEventRingBuffer* ring_buffer) {
   return stream_id;
 }
 
+pid_t ReadSampleRecordTid(PerfEventRingBuffer* ring_buffer) {
+  pid_t tid;
+  // All PERF_RECORD_SAMPLEs start with
+  //   perf_event_header header;
+  //   perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  ring_buffer->ReadValueAtOffset(
+      &tid, sizeof(perf_event_header) +
+                offsetof(perf_event_sample_id_tid_time_streamid_cpu, tid));
+  return tid;
+}
+
 pid_t ReadSampleRecordPid(PerfEventRingBuffer* ring_buffer) {
   pid_t pid;
   // All PERF_RECORD_SAMPLEs start with
@@ -53,25 +77,123 @@ pid_t ReadSampleRecordPid(PerfEventRingBuffer* ring_buffer) {
 }
 
 std::unique_ptr<StackSamplePerfEvent> ConsumeStackSamplePerfEvent(
-    PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
-  // Data in the ring buffer has the layout of perf_event_stack_sample, but we
-  // copy it into dynamically_sized_perf_event_stack_sample.
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header,
+    uint64_t max_stack_copy_size) {
+  // Data in the ring buffer has the layout of perf_event_stack_sample_fixed
+  // followed by the stack and dyn_size, but we copy it into
+  // dynamically_sized_perf_event_stack_sample.
+  uint64_t stack_size;
+  ring_buffer->ReadValueAtOffset(
+      &stack_size, offsetof(perf_event_stack_sample_fixed, stack_size));
   uint64_t dyn_size;
   ring_buffer->ReadValueAtOffset(
-      &dyn_size, offsetof(perf_event_stack_sample, stack.dyn_size));
-  auto event = std::make_unique<StackSamplePerfEvent>(dyn_size);
+      &dyn_size, sizeof(perf_event_stack_sample_fixed) + stack_size);
+  uint64_t copy_size = std::min(dyn_size, max_stack_copy_size);
+  auto event = std::make_unique<StackSamplePerfEvent>(copy_size);
   event->ring_buffer_record->header = header;
-  ring_buffer->ReadValueAtOffset(&event->ring_buffer_record->sample_id,
-                                 offsetof(perf_event_stack_sample, sample_id));
+  ring_buffer->ReadValueAtOffset(
+      &event->ring_buffer_record->sample_id,
+      offsetof(perf_event_stack_sample_fixed, sample_id));
   ring_buffer->ReadValueAtOffset(&event->ring_buffer_record->regs,
-                                 offsetof(perf_event_stack_sample, regs));
+                                 offsetof(perf_event_stack_sample_fixed, regs));
   ring_buffer->ReadRawAtOffset(event->ring_buffer_record->stack.data.get(),
-                               offsetof(perf_event_stack_sample, stack.data),
-                               dyn_size);
+                               sizeof(perf_event_stack_sample_fixed),
+                               copy_size);
   ring_buffer->SkipRecord(header);
   return event;
 }
 
+namespace {
+void SetSpIpArgumentsRegister(
+    perf_event_sample_regs_user_sp_ip_arguments* regs, int perf_reg,
+    uint64_t value) {
+  switch (perf_reg) {
+    case PERF_REG_X86_CX:
+      regs->cx = value;
+      break;
+    case PERF_REG_X86_DX:
+      regs->dx = value;
+      break;
+    case PERF_REG_X86_SI:
+      regs->si = value;
+      break;
+    case PERF_REG_X86_DI:
+      regs->di = value;
+      break;
+    case PERF_REG_X86_SP:
+      regs->sp = value;
+      break;
+    case PERF_REG_X86_IP:
+      regs->ip = value;
+      break;
+    case PERF_REG_X86_R8:
+      regs->r8 = value;
+      break;
+    case PERF_REG_X86_R9:
+      regs->r9 = value;
+      break;
+    default:
+      UNREACHABLE();
+  }
+}
+}  // namespace
+
+std::unique_ptr<UprobesPerfEvent> ConsumeUprobesPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header,
+    uint32_t argument_count) {
+  // The registers are in the order of their index in the sample_regs_user
+  // mask, which is the same order as in
+  // perf_event_sample_regs_user_sp_ip_arguments, but only the ones sampled.
+  const uint64_t sample_regs_user =
+      sample_regs_user_sp_ip_arguments(argument_count);
+  const size_t register_count = __builtin_popcountl(sample_regs_user);
+  using perf_event_uprobe = perf_event_sp_ip_arguments_8bytes_sample;
+  constexpr size_t kRegsOffset = offsetof(perf_event_uprobe, regs);
+  const size_t stack_offset =
+      kRegsOffset + sizeof(uint64_t) * (1 + register_count);
+  CHECK(header.size ==
+        stack_offset + sizeof(perf_event_sample_stack_user_8bytes));
+
+  // Copy the whole record out of the ring buffer at once, then rearrange it.
+  uint8_t record[sizeof(perf_event_uprobe)];
+  ring_buffer->ConsumeRecord(header, record);
+
+  auto event = make_unique_for_overwrite<UprobesPerfEvent>();
+  perf_event_uprobe& ring_buffer_record = event->ring_buffer_record;
+  std::memcpy(&ring_buffer_record, record, kRegsOffset);
+  ring_buffer_record.regs = {};
+  size_t register_offset = kRegsOffset;
+  auto read_next_register = [&record, &register_offset] {
+    uint64_t value;
+    std::memcpy(&value, record + register_offset, sizeof(uint64_t));
+    register_offset += sizeof(uint64_t);
+    return value;
+  };
+  ring_buffer_record.regs.abi = read_next_register();
+  for (int perf_reg = 0; perf_reg < 64; ++perf_reg) {
+    if ((sample_regs_user & (1lu << perf_reg)) != 0) {
+      SetSpIpArgumentsRegister(&ring_buffer_record.regs, perf_reg,
+                               read_next_register());
+    }
+  }
+  std::memcpy(&ring_buffer_record.stack, record + stack_offset,
+              sizeof(perf_event_sample_stack_user_8bytes));
+  return event;
+}
+
+std::unique_ptr<UretprobesPerfEvent> ConsumeUretprobesPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header,
+    bool has_ax) {
+  CHECK(header.size == (has_ax ? sizeof(perf_event_ax_sample)
+                               : sizeof(perf_event_empty_sample)));
+  auto event = make_unique_for_overwrite<UretprobesPerfEvent>();
+  ring_buffer->ConsumeRecord(header, &event->ring_buffer_record);
+  if (!has_ax) {
+    event->ring_buffer_record.regs = {};
+  }
+  return event;
+}
+
 std::unique_ptr<CallchainSamplePerfEvent> ConsumeCallchainSamplePerfEvent(
     PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
   uint64_t nr = 0;
@@ -94,4 +216,315 @@ std::unique_ptr<CallchainSamplePerfEvent> ConsumeCallchainSamplePerfEvent(
   return event;
 }
 
+std::unique_ptr<OffCpuCallchainPerfEvent> ConsumeOffCpuCallchainPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
+  // The raw tracepoint data follows the callchain and its uint32_t size.
+  uint64_t nr = 0;
+  ring_buffer->ReadValueAtOffset(
+      &nr, offsetof(perf_event_callchain_sample_fixed, nr));
+  uint64_t ips_offset = sizeof(perf_event_callchain_sample_fixed);
+  uint64_t raw_offset = ips_offset + nr * sizeof(uint64_t) + sizeof(uint32_t);
+  int64_t prev_state = 0;
+  ring_buffer->ReadValueAtOffset(
+      &prev_state,
+      raw_offset + offsetof(sched_switch_tracepoint, prev_state));
+  if ((prev_state & 0xff) == 0) {
+    ring_buffer->SkipRecord(header);
+    return nullptr;
+  }
+
+  auto event = std::make_unique<OffCpuCallchainPerfEvent>(nr);
+  event->ring_buffer_record.header = header;
+  ring_buffer->ReadValueAtOffset(
+      &event->ring_buffer_record.sample_id,
+      offsetof(perf_event_callchain_sample_fixed, sample_id));
+  ring_buffer->ReadRawAtOffset(reinterpret_cast<char*>(event->ips.data()),
+                               ips_offset, nr * sizeof(uint64_t));
+  ring_buffer->SkipRecord(header);
+  return event;
+}
+
+std::unique_ptr<FutexWaitPerfEvent> ConsumeFutexWaitPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
+  // As for ConsumeOffCpuCallchainPerfEvent, the raw tracepoint data follows
+  // the callchain and its uint32_t size.
+  uint64_t nr = 0;
+  ring_buffer->ReadValueAtOffset(
+      &nr, offsetof(perf_event_callchain_sample_fixed, nr));
+  uint64_t ips_offset = sizeof(perf_event_callchain_sample_fixed);
+  uint64_t raw_offset = ips_offset + nr * sizeof(uint64_t) + sizeof(uint32_t);
+  uint64_t op = 0;
+  ring_buffer->ReadValueAtOffset(
+      &op, raw_offset + offsetof(sys_enter_futex_tracepoint, op));
+  switch (op & FUTEX_CMD_MASK) {
+    case FUTEX_WAIT:
+    case FUTEX_WAIT_BITSET:
+    case FUTEX_LOCK_PI:
+    case FUTEX_WAIT_REQUEUE_PI:
+      break;
+    default:
+      ring_buffer->SkipRecord(header);
+      return nullptr;
+  }
+
+  auto event = std::make_unique<FutexWaitPerfEvent>(nr);
+  event->ring_buffer_record.header = header;
+  ring_buffer->ReadValueAtOffset(
+      &event->ring_buffer_record.sample_id,
+      offsetof(perf_event_callchain_sample_fixed, sample_id));
+  ring_buffer->ReadRawAtOffset(reinterpret_cast<char*>(event->ips.data()),
+                               ips_offset, nr * sizeof(uint64_t));
+  ring_buffer->ReadValueAtOffset(
+      &event->lock_address,
+      raw_offset + offsetof(sys_enter_futex_tracepoint, uaddr));
+  ring_buffer->SkipRecord(header);
+  return event;
+}
+
+std::unique_ptr<FutexExitPerfEvent> ConsumeFutexExitPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
+  auto event = std::make_unique<FutexExitPerfEvent>();
+  ring_buffer->ReadValueAtOffset(
+      &event->sample_id, offsetof(perf_event_raw_sample_fixed, sample_id));
+  ring_buffer->ReadValueAtOffset(
+      &event->ret, sizeof(perf_event_raw_sample_fixed) +
+                       offsetof(sys_exit_futex_tracepoint, ret));
+  ring_buffer->SkipRecord(header);
+  return event;
+}
+
+uint64_t ReadAllocationRecordSize(PerfEventRingBuffer* ring_buffer) {
+  uint64_t nr = 0;
+  ring_buffer->ReadValueAtOffset(
+      &nr, offsetof(perf_event_callchain_sample_fixed, nr));
+  uint64_t size = 0;
+  ring_buffer->ReadValueAtOffset(
+      &size, sizeof(perf_event_callchain_sample_fixed) +
+                 nr * sizeof(uint64_t) +
+                 offsetof(perf_event_sample_regs_user_di, di));
+  return size;
+}
+
+std::unique_ptr<AllocationPerfEvent> ConsumeAllocationPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
+  uint64_t nr = 0;
+  ring_buffer->ReadValueAtOffset(
+      &nr, offsetof(perf_event_callchain_sample_fixed, nr));
+  const uint64_t ips_offset = sizeof(perf_event_callchain_sample_fixed);
+  const uint64_t regs_offset = ips_offset + nr * sizeof(uint64_t);
+  const uint64_t stack_offset =
+      regs_offset + sizeof(perf_event_sample_regs_user_di);
+
+  // The first two entries are PERF_CONTEXT_USER and the address of malloc.
+  const uint64_t head_size = std::min<uint64_t>(nr, 2);
+  auto event = std::make_unique<AllocationPerfEvent>(nr + 1);
+  event->ring_buffer_record.header = header;
+  ring_buffer->ReadValueAtOffset(
+      &event->ring_buffer_record.sample_id,
+      offsetof(perf_event_callchain_sample_fixed, sample_id));
+  ring_buffer->ReadRawAtOffset(reinterpret_cast<char*>(event->ips.data()),
+                               ips_offset, head_size * sizeof(uint64_t));
+  ring_buffer->ReadValueAtOffset(
+      &event->ips[head_size],
+      stack_offset + offsetof(perf_event_sample_stack_user_8bytes, top8bytes));
+  ring_buffer->ReadRawAtOffset(
+      reinterpret_cast<char*>(event->ips.data() + head_size + 1),
+      ips_offset + head_size * sizeof(uint64_t),
+      (nr - head_size) * sizeof(uint64_t));
+  ring_buffer->ReadValueAtOffset(
+      &event->size, regs_offset + offsetof(perf_event_sample_regs_user_di, di));
+  ring_buffer->SkipRecord(header);
+  return event;
+}
+
+std::unique_ptr<PageFaultPerfEvent> ConsumePageFaultPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
+  uint64_t nr = 0;
+  ring_buffer->ReadValueAtOffset(
+      &nr, offsetof(perf_event_callchain_sample_fixed, nr));
+  auto event = std::make_unique<PageFaultPerfEvent>(nr);
+  event->ring_buffer_record.header = header;
+  ring_buffer->ReadValueAtOffset(
+      &event->ring_buffer_record.sample_id,
+      offsetof(perf_event_callchain_sample_fixed, sample_id));
+  ring_buffer->ReadRawAtOffset(reinterpret_cast<char*>(event->ips.data()),
+                               sizeof(perf_event_callchain_sample_fixed),
+                               nr * sizeof(uint64_t));
+  ring_buffer->SkipRecord(header);
+  return event;
+}
+
+std::unique_ptr<MemoryMapSyscallPerfEvent> ConsumeMemoryMapSyscallPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
+  auto event = std::make_unique<MemoryMapSyscallPerfEvent>();
+  ring_buffer->ReadValueAtOffset(
+      &event->sample_id, offsetof(perf_event_raw_sample_fixed, sample_id));
+  ring_buffer->SkipRecord(header);
+  return event;
+}
+
+std::unique_ptr<SyscallEnterPerfEvent> ConsumeSyscallEnterPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
+  auto event = std::make_unique<SyscallEnterPerfEvent>();
+  ring_buffer->ReadValueAtOffset(
+      &event->sample_id, offsetof(perf_event_raw_sample_fixed, sample_id));
+  ring_buffer->ReadValueAtOffset(
+      &event->syscall_nr, sizeof(perf_event_raw_sample_fixed) +
+                              offsetof(raw_syscalls_sys_enter_tracepoint, id));
+  ring_buffer->SkipRecord(header);
+  return event;
+}
+
+std::unique_ptr<SyscallExitPerfEvent> ConsumeSyscallExitPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
+  auto event = std::make_unique<SyscallExitPerfEvent>();
+  ring_buffer->ReadValueAtOffset(
+      &event->sample_id, offsetof(perf_event_raw_sample_fixed, sample_id));
+  ring_buffer->ReadValueAtOffset(
+      &event->syscall_nr, sizeof(perf_event_raw_sample_fixed) +
+                              offsetof(raw_syscalls_sys_exit_tracepoint, id));
+  ring_buffer->ReadValueAtOffset(
+      &event->ret, sizeof(perf_event_raw_sample_fixed) +
+                       offsetof(raw_syscalls_sys_exit_tracepoint, ret));
+  ring_buffer->SkipRecord(header);
+  return event;
+}
+
+std::unique_ptr<BlockRqIssuePerfEvent> ConsumeBlockRqIssuePerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
+  auto event = std::make_unique<BlockRqIssuePerfEvent>();
+  ring_buffer->ReadValueAtOffset(
+      &event->sample_id, offsetof(perf_event_raw_sample_fixed, sample_id));
+  block_rq_issue_tracepoint tracepoint;
+  ring_buffer->ReadValueAtOffset(&tracepoint,
+                                 sizeof(perf_event_raw_sample_fixed));
+  ring_buffer->SkipRecord(header);
+  event->dev = tracepoint.dev;
+  event->sector = tracepoint.sector;
+  event->nr_sector = tracepoint.nr_sector;
+  // As rwbs is built by blk_fill_rwbs: 'W' first for writes.
+  event->write = tracepoint.rwbs[0] == 'W';
+  return event;
+}
+
+std::unique_ptr<BlockRqCompletePerfEvent> ConsumeBlockRqCompletePerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
+  auto event = std::make_unique<BlockRqCompletePerfEvent>();
+  ring_buffer->ReadValueAtOffset(
+      &event->sample_id, offsetof(perf_event_raw_sample_fixed, sample_id));
+  block_rq_complete_tracepoint tracepoint;
+  ring_buffer->ReadValueAtOffset(&tracepoint,
+                                 sizeof(perf_event_raw_sample_fixed));
+  ring_buffer->SkipRecord(header);
+  event->dev = tracepoint.dev;
+  event->sector = tracepoint.sector;
+  event->error = tracepoint.error;
+  return event;
+}
+
+std::unique_ptr<HybridSamplePerfEvent> ConsumeHybridSamplePerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
+  // The registers and the stack follow the callchain, hence their offsets
+  // depend on the size of the callchain.
+  uint64_t nr = 0;
+  ring_buffer->ReadValueAtOffset(
+      &nr, offsetof(perf_event_callchain_sample_fixed, nr));
+  uint64_t ips_offset = sizeof(perf_event_callchain_sample_fixed);
+  uint64_t regs_offset = ips_offset + nr * sizeof(uint64_t);
+  uint64_t abi = PERF_SAMPLE_REGS_ABI_NONE;
+  ring_buffer->ReadValueAtOffset(&abi, regs_offset);
+  if (abi == PERF_SAMPLE_REGS_ABI_NONE) {
+    ring_buffer->SkipRecord(header);
+    return nullptr;
+  }
+
+  uint64_t stack_size_offset =
+      regs_offset + sizeof(perf_event_sample_regs_user_all);
+  uint64_t stack_size = 0;
+  ring_buffer->ReadValueAtOffset(&stack_size, stack_size_offset);
+  uint64_t dyn_size = 0;
+  if (stack_size != 0) {
+    ring_buffer->ReadValueAtOffset(
+        &dyn_size, stack_size_offset + sizeof(uint64_t) + stack_size);
+  }
+
+  auto event = std::make_unique<HybridSamplePerfEvent>(nr, dyn_size);
+  event->ring_buffer_record->header = header;
+  ring_buffer->ReadValueAtOffset(
+      &event->ring_buffer_record->sample_id,
+      offsetof(perf_event_callchain_sample_fixed, sample_id));
+  ring_buffer->ReadRawAtOffset(reinterpret_cast<char*>(event->ips.data()),
+                               ips_offset, nr * sizeof(uint64_t));
+  ring_buffer->ReadValueAtOffset(&event->ring_buffer_record->regs,
+                                 regs_offset);
+  ring_buffer->ReadRawAtOffset(event->ring_buffer_record->stack.data.get(),
+                               stack_size_offset + sizeof(uint64_t), dyn_size);
+  ring_buffer->SkipRecord(header);
+  return event;
+}
+
+std::unique_ptr<LbrSamplePerfEvent> ConsumeLbrSamplePerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
+  // The branch records follow the callchain.
+  uint64_t nr = 0;
+  ring_buffer->ReadValueAtOffset(
+      &nr, offsetof(perf_event_callchain_sample_fixed, nr));
+  uint64_t ips_offset = sizeof(perf_event_callchain_sample_fixed);
+  uint64_t bnr_offset = ips_offset + nr * sizeof(uint64_t);
+  uint64_t bnr = 0;
+  ring_buffer->ReadValueAtOffset(&bnr, bnr_offset);
+  uint64_t entries_offset = bnr_offset + sizeof(uint64_t);
+  if (entries_offset + bnr * sizeof(perf_branch_entry) > header.size) {
+    ERROR("Malformed branch stack in sample");
+    bnr = 0;
+  }
+
+  auto event = std::make_unique<LbrSamplePerfEvent>(nr, bnr);
+  event->ring_buffer_record.header = header;
+  ring_buffer->ReadValueAtOffset(
+      &event->ring_buffer_record.sample_id,
+      offsetof(perf_event_callchain_sample_fixed, sample_id));
+  ring_buffer->ReadRawAtOffset(reinterpret_cast<char*>(event->ips.data()),
+                               ips_offset, nr * sizeof(uint64_t));
+  for (uint64_t i = 0; i < bnr; ++i) {
+    ring_buffer->ReadValueAtOffset(
+        &event->call_addresses[i],
+        entries_offset + i * sizeof(perf_branch_entry) +
+            offsetof(perf_branch_entry, from));
+  }
+  ring_buffer->SkipRecord(header);
+  return event;
+}
+
+std::unique_ptr<MmapPerfEvent> ConsumeMmapPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
+  CHECK(header.size >= sizeof(perf_event_mmap2_fixed) +
+                           sizeof(perf_event_sample_id_tid_time_streamid_cpu));
+  perf_event_mmap2_fixed mmap_record;
+  ring_buffer->ReadValueAtOffset(&mmap_record, 0);
+
+  // sample_id is at the end of the record, as sample_id_all is set.
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  ring_buffer->ReadValueAtOffset(
+      &sample_id,
+      header.size - sizeof(perf_event_sample_id_tid_time_streamid_cpu));
+
+  uint64_t filename_buffer_size =
+      header.size - sizeof(perf_event_mmap2_fixed) -
+      sizeof(perf_event_sample_id_tid_time_streamid_cpu);
+  std::string filename(filename_buffer_size, '\0');
+  ring_buffer->ReadRawAtOffset(filename.data(), sizeof(perf_event_mmap2_fixed),
+                               filename_buffer_size);
+  // Remove the null terminator and the padding.
+  filename.resize(strnlen(filename.data(), filename_buffer_size));
+
+  ring_buffer->SkipRecord(header);
+  // Copy the packed fields, as they can't be bound to references.
+  return std::make_unique<MmapPerfEvent>(
+      uint64_t{sample_id.time}, static_cast<pid_t>(mmap_record.pid),
+      uint64_t{mmap_record.addr}, uint64_t{mmap_record.len},
+      uint64_t{mmap_record.pgoff}, uint32_t{mmap_record.prot},
+      std::move(filename));
+}
+
 }  // namespace LinuxTracing
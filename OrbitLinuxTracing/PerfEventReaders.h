@@ -5,6 +5,8 @@
 #ifndef ORBIT_LINUX_TRACING_PERF_EVENT_READERS_H_
 #define ORBIT_LINUX_TRACING_PERF_EVENT_READERS_H_
 
+#include <limits>
+
 #include "PerfEvent.h"
 #include "PerfEventRingBuffer.h"
 
@@ -18,12 +20,81 @@ uint64_t ReadSampleRecordStreamId(PerfEventRingBuffer* ring_buffer);
 
 pid_t ReadSampleRecordPid(PerfEventRingBuffer* ring_buffer);
 
+pid_t ReadSampleRecordTid(PerfEventRingBuffer* ring_buffer);
+
+// Only the first max_stack_copy_size bytes of the stack are copied, in addition
+// to the registers.
 std::unique_ptr<StackSamplePerfEvent> ConsumeStackSamplePerfEvent(
-    PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header,
+    uint64_t max_stack_copy_size = std::numeric_limits<uint64_t>::max());
+
+// The records of uprobes opened with uprobes_retaddr_event_open only contain
+// the registers of the first argument_count arguments: the registers of the
+// other arguments are set to zero in the event.
+std::unique_ptr<UprobesPerfEvent> ConsumeUprobesPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header,
+    uint32_t argument_count);
+
+// Without has_ax, the record doesn't contain registers (it is a
+// perf_event_empty_sample) and ax is set to zero in the event.
+std::unique_ptr<UretprobesPerfEvent> ConsumeUretprobesPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header,
+    bool has_ax);
 
 std::unique_ptr<CallchainSamplePerfEvent> ConsumeCallchainSamplePerfEvent(
     PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
 
+// Skips the record and returns nullptr if the thread switched out was
+// preempted rather than blocked.
+std::unique_ptr<OffCpuCallchainPerfEvent> ConsumeOffCpuCallchainPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
+
+// Skips the record and returns nullptr if the futex operation is not a wait,
+// e.g., a wake.
+std::unique_ptr<FutexWaitPerfEvent> ConsumeFutexWaitPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
+
+std::unique_ptr<FutexExitPerfEvent> ConsumeFutexExitPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
+
+// The size passed to malloc, for the records of uprobes_callchain_event_open,
+// so that the TracerThread can decide whether to sample the allocation before
+// consuming the record.
+uint64_t ReadAllocationRecordSize(PerfEventRingBuffer* ring_buffer);
+
+std::unique_ptr<AllocationPerfEvent> ConsumeAllocationPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
+
+std::unique_ptr<PageFaultPerfEvent> ConsumePageFaultPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
+
+// munmap is not in the record, which is the same for both tracepoints.
+std::unique_ptr<MemoryMapSyscallPerfEvent> ConsumeMemoryMapSyscallPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
+
+std::unique_ptr<SyscallEnterPerfEvent> ConsumeSyscallEnterPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
+
+std::unique_ptr<SyscallExitPerfEvent> ConsumeSyscallExitPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
+
+std::unique_ptr<BlockRqIssuePerfEvent> ConsumeBlockRqIssuePerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
+
+std::unique_ptr<BlockRqCompletePerfEvent> ConsumeBlockRqCompletePerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
+
+// Skips the record and returns nullptr if the sample has no registers and no
+// stack, which happens, for example, when the sampled thread is exiting.
+std::unique_ptr<HybridSamplePerfEvent> ConsumeHybridSamplePerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
+
+std::unique_ptr<LbrSamplePerfEvent> ConsumeLbrSamplePerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
+
+std::unique_ptr<MmapPerfEvent> ConsumeMmapPerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
+
 template <typename T, typename = std::enable_if_t<
                           std::is_base_of_v<TracepointPerfEvent, T>>>
 std::unique_ptr<T> ConsumeTracepointPerfEvent(PerfEventRingBuffer* ring_buffer,
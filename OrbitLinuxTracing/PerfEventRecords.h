@@ -86,10 +86,11 @@ struct __attribute__((__packed__)) perf_event_sample_regs_user_sp_ip_arguments {
   uint64_t r9;
 };
 
-struct __attribute__((__packed__)) perf_event_sample_stack_user {
-  uint64_t size;                     /* if PERF_SAMPLE_STACK_USER */
-  char data[SAMPLE_STACK_USER_SIZE]; /* if PERF_SAMPLE_STACK_USER */
-  uint64_t dyn_size; /* if PERF_SAMPLE_STACK_USER && size != 0 */
+// This struct must be in sync with the SAMPLE_REGS_USER_DI in
+// PerfEventOpen.h.
+struct __attribute__((__packed__)) perf_event_sample_regs_user_di {
+  uint64_t abi;
+  uint64_t di;
 };
 
 struct __attribute__((__packed__)) perf_event_sample_stack_user_8bytes {
@@ -103,11 +104,28 @@ struct __attribute__((__packed__)) perf_event_empty_sample {
   perf_event_sample_id_tid_time_streamid_cpu sample_id;
 };
 
-struct __attribute__((__packed__)) perf_event_stack_sample {
+// This struct must be in sync with sched_switch_counters_event_open and
+// SCHED_SWITCH_HARDWARE_COUNTERS in PerfEventOpen.h: PERF_SAMPLE_READ with
+// PERF_FORMAT_GROUP reads the values of the leader and then of the other
+// events of the group, in the order in which they were opened.
+struct __attribute__((__packed__)) perf_event_sched_switch_counters_sample {
+  perf_event_header header;
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  uint64_t nr;
+  uint64_t sched_switch_count;
+  uint64_t cycles;
+  uint64_t instructions;
+  uint64_t cache_misses;
+  uint64_t branch_misses;
+};
+
+struct __attribute__((__packed__)) perf_event_stack_sample_fixed {
   perf_event_header header;
   perf_event_sample_id_tid_time_streamid_cpu sample_id;
   perf_event_sample_regs_user_all regs;
-  perf_event_sample_stack_user stack;
+  uint64_t stack_size;
+  // The rest of the sample is a char data[stack_size], as the size of the stack
+  // dump is configurable, followed by a uint64_t dyn_size if stack_size != 0.
 };
 
 struct __attribute__((__packed__)) perf_event_callchain_sample_fixed {
@@ -117,6 +135,21 @@ struct __attribute__((__packed__)) perf_event_callchain_sample_fixed {
   // The rest of the sample is a uint64_t[nr] that we read dynamically.
 };
 
+struct __attribute__((__packed__)) perf_event_mmap2_fixed {
+  perf_event_header header;
+  uint32_t pid, tid;
+  uint64_t addr;
+  uint64_t len;
+  uint64_t pgoff;
+  uint32_t maj, min;
+  uint64_t ino;
+  uint64_t ino_generation;
+  uint32_t prot, flags;
+  // The rest of the record is a null-terminated char filename[] padded to a
+  // multiple of 8 bytes, followed by
+  // perf_event_sample_id_tid_time_streamid_cpu sample_id.
+};
+
 struct __attribute__((__packed__)) perf_event_sp_ip_arguments_8bytes_sample {
   perf_event_header header;
   perf_event_sample_id_tid_time_streamid_cpu sample_id;
@@ -9,9 +9,12 @@
 #include <linux/perf_event.h>
 #include <sys/mman.h>
 
+#include <algorithm>
 #include <utility>
 
+#include "BackwardRingBuffer.h"
 #include "PerfEventOpen.h"
+#include "PerfRecording.h"
 #include "Utils.h"
 
 namespace LinuxTracing {
@@ -36,7 +39,8 @@ static inline void WriteRingBufferTail(perf_event_mmap_page* base,
 }
 
 PerfEventRingBuffer::PerfEventRingBuffer(int perf_event_fd, uint64_t size_kb,
-                                         std::string name) {
+                                         std::string name, bool overwrite)
+    : overwrite_{overwrite} {
   if (perf_event_fd < 0) {
     return;
   }
@@ -56,7 +60,7 @@ PerfEventRingBuffer::PerfEventRingBuffer(int perf_event_fd, uint64_t size_kb,
   mmap_length_ = GetPageSize() + ring_buffer_size_;
 
   void* mmap_address =
-      perf_event_open_mmap_ring_buffer(perf_event_fd, mmap_length_);
+      perf_event_open_mmap_ring_buffer(perf_event_fd, mmap_length_, overwrite);
   if (mmap_address == nullptr) {
     return;
   }
@@ -78,6 +82,15 @@ PerfEventRingBuffer::PerfEventRingBuffer(PerfEventRingBuffer&& o) noexcept {
   std::swap(ring_buffer_size_log2_, o.ring_buffer_size_log2_);
   std::swap(file_descriptor_, o.file_descriptor_);
   std::swap(name_, o.name_);
+  std::swap(overwrite_, o.overwrite_);
+  std::swap(snapshot_metadata_page_, o.snapshot_metadata_page_);
+  std::swap(snapshot_ring_buffer_, o.snapshot_ring_buffer_);
+  std::swap(in_batch_, o.in_batch_);
+  std::swap(batch_head_, o.batch_head_);
+  std::swap(batch_tail_, o.batch_tail_);
+  std::swap(wrapped_record_, o.wrapped_record_);
+  max_fill_bytes_ = o.max_fill_bytes_.exchange(max_fill_bytes_);
+  std::swap(recording_writer_, o.recording_writer_);
 }
 
 PerfEventRingBuffer& PerfEventRingBuffer::operator=(
@@ -90,12 +103,21 @@ PerfEventRingBuffer& PerfEventRingBuffer::operator=(
     std::swap(ring_buffer_size_log2_, o.ring_buffer_size_log2_);
     std::swap(file_descriptor_, o.file_descriptor_);
     std::swap(name_, o.name_);
+    std::swap(overwrite_, o.overwrite_);
+    std::swap(snapshot_metadata_page_, o.snapshot_metadata_page_);
+    std::swap(snapshot_ring_buffer_, o.snapshot_ring_buffer_);
+    std::swap(in_batch_, o.in_batch_);
+    std::swap(batch_head_, o.batch_head_);
+    std::swap(batch_tail_, o.batch_tail_);
+    std::swap(wrapped_record_, o.wrapped_record_);
+    max_fill_bytes_ = o.max_fill_bytes_.exchange(max_fill_bytes_);
+    std::swap(recording_writer_, o.recording_writer_);
   }
   return *this;
 }
 
 PerfEventRingBuffer::~PerfEventRingBuffer() {
-  if (metadata_page_ != nullptr) {
+  if (metadata_page_ != nullptr && snapshot_metadata_page_ == nullptr) {
     int munmap_ret = munmap(metadata_page_, mmap_length_);
     if (munmap_ret != 0) {
       ERROR("munmap: %s", SafeStrerror(errno));
@@ -103,25 +125,152 @@ PerfEventRingBuffer::~PerfEventRingBuffer() {
   }
 }
 
+PerfEventRingBuffer PerfEventRingBuffer::TakeSnapshot(
+    uint64_t min_timestamp_ns) {
+  CHECK(IsOpen());
+  CHECK(overwrite_);
+  std::vector<char> records = LinearizeBackwardRingBuffer(
+      ring_buffer_, ring_buffer_size_, ReadRingBufferHead(metadata_page_),
+      min_timestamp_ns);
+
+  PerfEventRingBuffer snapshot;
+  snapshot.file_descriptor_ = file_descriptor_;
+  snapshot.name_ = name_;
+  snapshot.ring_buffer_size_ = ring_buffer_size_;
+  snapshot.ring_buffer_size_log2_ = ring_buffer_size_log2_;
+  snapshot.snapshot_metadata_page_ = std::make_unique<perf_event_mmap_page>();
+  snapshot.snapshot_metadata_page_->data_head = records.size();
+  snapshot.snapshot_metadata_page_->data_tail = 0;
+  snapshot.metadata_page_ = snapshot.snapshot_metadata_page_.get();
+  // The records never wrap around, as they fit in ring_buffer_size_.
+  snapshot.snapshot_ring_buffer_ = std::move(records);
+  snapshot.snapshot_ring_buffer_.resize(ring_buffer_size_);
+  snapshot.ring_buffer_ = snapshot.snapshot_ring_buffer_.data();
+  return snapshot;
+}
+
+PerfEventRingBuffer PerfEventRingBuffer::FromRecords(
+    int file_descriptor, std::string name, std::vector<char> records) {
+  uint64_t size = GetPageSize();
+  while (size < records.size()) {
+    size *= 2;
+  }
+
+  PerfEventRingBuffer ring_buffer;
+  ring_buffer.file_descriptor_ = file_descriptor;
+  ring_buffer.name_ = std::move(name);
+  ring_buffer.ring_buffer_size_ = size;
+  ring_buffer.ring_buffer_size_log2_ = __builtin_ffsl(size) - 1;
+  ring_buffer.snapshot_metadata_page_ =
+      std::make_unique<perf_event_mmap_page>();
+  ring_buffer.snapshot_metadata_page_->data_head = records.size();
+  ring_buffer.snapshot_metadata_page_->data_tail = 0;
+  ring_buffer.metadata_page_ = ring_buffer.snapshot_metadata_page_.get();
+  // Like a snapshot, the records never wrap around.
+  ring_buffer.snapshot_ring_buffer_ = std::move(records);
+  ring_buffer.snapshot_ring_buffer_.resize(size);
+  ring_buffer.ring_buffer_ = ring_buffer.snapshot_ring_buffer_.data();
+  return ring_buffer;
+}
+
+void PerfEventRingBuffer::BeginBatch() {
+  DCHECK(IsOpen());
+  CHECK(!in_batch_);
+  batch_head_ = ReadRingBufferHead(metadata_page_);
+  batch_tail_ = metadata_page_->data_tail;
+  in_batch_ = true;
+
+  // Only the reader of the ring buffer raises the maximum, but
+  // TakeMaxFillBytes can reset it from another thread.
+  const uint64_t fill_bytes = batch_head_ - batch_tail_;
+  uint64_t max_fill_bytes = max_fill_bytes_.load(std::memory_order_relaxed);
+  while (fill_bytes > max_fill_bytes &&
+         !max_fill_bytes_.compare_exchange_weak(max_fill_bytes, fill_bytes,
+                                                std::memory_order_relaxed)) {
+  }
+}
+
+void PerfEventRingBuffer::EndBatch() {
+  CHECK(in_batch_);
+  in_batch_ = false;
+  if (batch_tail_ != metadata_page_->data_tail) {
+    RecordUpToTail(batch_tail_);
+    WriteRingBufferTail(metadata_page_, batch_tail_);
+  }
+}
+
+uint64_t PerfEventRingBuffer::GetFillBytes() {
+  DCHECK(IsOpen());
+  return GetHead() - GetTail();
+}
+
+uint64_t PerfEventRingBuffer::GetHead() {
+  return in_batch_ ? batch_head_ : ReadRingBufferHead(metadata_page_);
+}
+
+uint64_t PerfEventRingBuffer::GetTail() {
+  return in_batch_ ? batch_tail_ : metadata_page_->data_tail;
+}
+
+void PerfEventRingBuffer::SetTail(uint64_t tail) {
+  if (in_batch_) {
+    batch_tail_ = tail;
+  } else {
+    RecordUpToTail(tail);
+    WriteRingBufferTail(metadata_page_, tail);
+  }
+}
+
+void PerfEventRingBuffer::RecordUpToTail(uint64_t new_tail) {
+  const uint64_t tail = metadata_page_->data_tail;
+  if (recording_writer_ == nullptr || new_tail == tail) {
+    return;
+  }
+  // The records are still in the ring buffer, as the kernel doesn't overwrite
+  // them before the tail is written.
+  std::string records(new_tail - tail, '\0');
+  const uint64_t tail_mod_size = tail & (ring_buffer_size_ - 1);
+  const uint64_t count_before_end =
+      std::min<uint64_t>(records.size(), ring_buffer_size_ - tail_mod_size);
+  memcpy(records.data(), ring_buffer_ + tail_mod_size, count_before_end);
+  memcpy(records.data() + count_before_end, ring_buffer_,
+         records.size() - count_before_end);
+  recording_writer_->WriteRecords(file_descriptor_, std::move(records));
+}
+
 bool PerfEventRingBuffer::HasNewData() {
   DCHECK(IsOpen());
-  uint64_t head = ReadRingBufferHead(metadata_page_);
-  DCHECK((metadata_page_->data_tail == head) ||
-         (head >= metadata_page_->data_tail + sizeof(perf_event_header)));
-  return head > metadata_page_->data_tail;
+  uint64_t head = GetHead();
+  uint64_t tail = GetTail();
+  DCHECK((tail == head) || (head >= tail + sizeof(perf_event_header)));
+  return head > tail;
 }
 
 void PerfEventRingBuffer::ReadHeader(perf_event_header* header) {
   ReadAtTail(reinterpret_cast<uint8_t*>(header), sizeof(perf_event_header));
   DCHECK(header->type != 0);
-  DCHECK(metadata_page_->data_tail + header->size <=
-         ReadRingBufferHead(metadata_page_));
+  DCHECK(GetTail() + header->size <= GetHead());
+}
+
+absl::Span<const uint8_t> PerfEventRingBuffer::GetRecordAtTail(
+    const perf_event_header& header) {
+  DCHECK(IsOpen());
+  DCHECK(GetTail() + header.size <= GetHead());
+  const uint64_t index_mod_size = GetTail() & (ring_buffer_size_ - 1);
+  if (index_mod_size + header.size <= ring_buffer_size_) {
+    return absl::MakeConstSpan(
+        reinterpret_cast<const uint8_t*>(ring_buffer_ + index_mod_size),
+        header.size);
+  }
+  wrapped_record_.resize(header.size);
+  ReadAtTail(wrapped_record_.data(), header.size);
+  return absl::MakeConstSpan(wrapped_record_);
 }
 
 void PerfEventRingBuffer::SkipRecord(const perf_event_header& header) {
-  // Write back how far we read from the buffer.
-  uint64_t new_tail = metadata_page_->data_tail + header.size;
-  WriteRingBufferTail(metadata_page_, new_tail);
+  // Write back how far we read from the buffer, or only at the end of the
+  // batch.
+  SetTail(GetTail() + header.size);
 }
 
 void PerfEventRingBuffer::ConsumeRecord(const perf_event_header& header,
@@ -135,20 +284,24 @@ void PerfEventRingBuffer::ReadAtOffsetFromTail(uint8_t* dest,
                                                uint64_t count) {
   DCHECK(IsOpen());
 
-  uint64_t head = ReadRingBufferHead(metadata_page_);
-  if (offset_from_tail + count > head - metadata_page_->data_tail) {
-    ERROR("Reading more data than it is available from ring buffer '%s'",
-          name_.c_str());
+  const uint64_t head = GetHead();
+  const uint64_t tail = GetTail();
+  if (offset_from_tail + count > head - tail) {
+    ERROR_RATE_LIMITED(
+        "Reading more data than it is available from ring buffer '%s'",
+        name_.c_str());
   } else if (offset_from_tail + count > ring_buffer_size_) {
-    ERROR("Reading more than the size of ring buffer '%s'", name_.c_str());
-  } else if (head > metadata_page_->data_tail + ring_buffer_size_) {
+    ERROR_RATE_LIMITED("Reading more than the size of ring buffer '%s'",
+                       name_.c_str());
+  } else if (head > tail + ring_buffer_size_) {
     // If mmap has been called with PROT_WRITE and
     // perf_event_mmap_page::data_tail is used properly, this should not happen,
     // as the kernel would not overwrite unread data.
-    ERROR("Too slow reading from ring buffer '%s'", name_.c_str());
+    ERROR_RATE_LIMITED("Too slow reading from ring buffer '%s'",
+                       name_.c_str());
   }
 
-  const uint64_t index = metadata_page_->data_tail + offset_from_tail;
+  const uint64_t index = tail + offset_from_tail;
   const uint32_t exponent = ring_buffer_size_log2_;
 
   // As ring_buffer_size_ is a power of two, optimize index % ring_buffer_size_:
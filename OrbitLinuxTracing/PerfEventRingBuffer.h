@@ -7,16 +7,26 @@
 
 #include <linux/perf_event.h>
 
+#include <atomic>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "PerfEventOpen.h"
+#include "absl/types/span.h"
 
 namespace LinuxTracing {
 
+class PerfRecordingWriter;
+
 class PerfEventRingBuffer {
  public:
+  // With overwrite, the ring buffer is mapped read-only, so that the kernel
+  // overwrites the oldest records instead of losing the new ones. The events
+  // have to be opened with write_backward, and the records can only be read
+  // from a snapshot.
   explicit PerfEventRingBuffer(int perf_event_fd, uint64_t size_kb,
-                               std::string name);
+                               std::string name, bool overwrite = false);
   ~PerfEventRingBuffer();
 
   PerfEventRingBuffer(PerfEventRingBuffer&&) noexcept;
@@ -29,8 +39,42 @@ class PerfEventRingBuffer {
   int GetFileDescriptor() const { return file_descriptor_; }
   const std::string& GetName() const { return name_; }
 
+  // Returns a ring buffer, not mapped to the kernel, holding a copy of the
+  // records of this overwrite ring buffer that are not older than
+  // min_timestamp_ns, oldest first. It can be read like a regular ring buffer,
+  // and has the same file descriptor and name. The events should be disabled.
+  PerfEventRingBuffer TakeSnapshot(uint64_t min_timestamp_ns);
+
+  // Returns a ring buffer, not mapped to the kernel, holding the records of a
+  // perf recording, to be read like a regular ring buffer.
+  static PerfEventRingBuffer FromRecords(int file_descriptor, std::string name,
+                                         std::vector<char> records);
+
+  // If not nullptr, the records are also written to writer as they are read,
+  // i.e., when the tail moves past them.
+  void SetRecordingWriter(PerfRecordingWriter* writer) {
+    recording_writer_ = writer;
+  }
+
+  // Between BeginBatch and EndBatch, the head is only read once, by
+  // BeginBatch, and the tail only written once, by EndBatch, instead of for
+  // every read and every record: the records written meanwhile are left for
+  // the next batch.
+  void BeginBatch();
+  void EndBatch();
+
+  // Bytes of records not read yet. Reads the head, unless in a batch.
+  uint64_t GetFillBytes();
+  uint64_t GetSizeBytes() const { return ring_buffer_size_; }
+  // The most bytes of unread records seen by BeginBatch since the previous
+  // call. Can be called from any thread.
+  uint64_t TakeMaxFillBytes() { return max_fill_bytes_.exchange(0); }
+
   bool HasNewData();
   void ReadHeader(perf_event_header* header);
+  // The record at the tail, in place, or copied if it wraps around the end of
+  // the buffer. Valid until the record is skipped.
+  absl::Span<const uint8_t> GetRecordAtTail(const perf_event_header& header);
   void SkipRecord(const perf_event_header& header);
   void ConsumeRecord(const perf_event_header& header, void* record);
 
@@ -57,6 +101,25 @@ class PerfEventRingBuffer {
   uint32_t ring_buffer_size_log2_ = 0;
   int file_descriptor_ = -1;
   std::string name_;
+  bool overwrite_ = false;
+  // Only set for snapshots, in place of the mapped memory.
+  std::unique_ptr<perf_event_mmap_page> snapshot_metadata_page_;
+  std::vector<char> snapshot_ring_buffer_;
+  bool in_batch_ = false;
+  uint64_t batch_head_ = 0;
+  uint64_t batch_tail_ = 0;
+  std::vector<uint8_t> wrapped_record_;
+  std::atomic<uint64_t> max_fill_bytes_ = 0;
+  PerfRecordingWriter* recording_writer_ = nullptr;
+
+  PerfEventRingBuffer() = default;
+
+  uint64_t GetHead();
+  uint64_t GetTail();
+  void SetTail(uint64_t tail);
+  // Writes the records from the current tail to new_tail to
+  // recording_writer_.
+  void RecordUpToTail(uint64_t new_tail);
 
   void ReadAtTail(uint8_t* dest, uint64_t count) {
     return ReadAtOffsetFromTail(dest, 0, count);
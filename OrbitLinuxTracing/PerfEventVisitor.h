@@ -19,10 +19,22 @@ class PerfEventVisitor {
   virtual void visit(SystemWideContextSwitchPerfEvent*) {}
   virtual void visit(StackSamplePerfEvent*) {}
   virtual void visit(CallchainSamplePerfEvent*) {}
+  virtual void visit(OffCpuCallchainPerfEvent*) {}
+  virtual void visit(FutexWaitPerfEvent*) {}
+  virtual void visit(FutexExitPerfEvent*) {}
+  virtual void visit(AllocationPerfEvent*) {}
+  virtual void visit(PageFaultPerfEvent*) {}
+  virtual void visit(MemoryMapSyscallPerfEvent*) {}
+  virtual void visit(SyscallEnterPerfEvent*) {}
+  virtual void visit(SyscallExitPerfEvent*) {}
+  virtual void visit(BlockRqIssuePerfEvent*) {}
+  virtual void visit(BlockRqCompletePerfEvent*) {}
+  virtual void visit(HybridSamplePerfEvent*) {}
+  virtual void visit(LbrSamplePerfEvent*) {}
   virtual void visit(UprobesPerfEvent*) {}
   virtual void visit(UretprobesPerfEvent*) {}
   virtual void visit(LostPerfEvent*) {}
-  virtual void visit(MapsPerfEvent*) {}
+  virtual void visit(MmapPerfEvent*) {}
   virtual void visit(TaskNewtaskPerfEvent*) {}
   virtual void visit(TaskRenamePerfEvent*) {}
   virtual void visit(AmdgpuCsIoctlPerfEvent*) {}
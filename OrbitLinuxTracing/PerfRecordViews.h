@@ -0,0 +1,178 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_PERF_RECORD_VIEWS_H_
+#define ORBIT_LINUX_TRACING_PERF_RECORD_VIEWS_H_
+
+#include <OrbitBase/Logging.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "KernelTracepoints.h"
+#include "PerfEventRecords.h"
+#include "absl/types/span.h"
+
+namespace LinuxTracing {
+
+// Read-only views of the records that are processed as soon as they are read:
+// the few fields needed are read straight from the ring buffer, from
+// PerfEventRingBuffer::GetRecordAtTail, instead of copying the whole record
+// into a PerfEvent. A view is only valid until its record is skipped: the
+// events deferred to a PerfEventProcessor2 still need to be consumed into an
+// owned PerfEvent.
+class PerfRecordView {
+ public:
+  explicit PerfRecordView(absl::Span<const uint8_t> record)
+      : record_{record} {}
+
+  template <typename T>
+  [[nodiscard]] T ReadValueAtOffset(size_t offset) const {
+    CHECK(offset + sizeof(T) <= record_.size());
+    T value;
+    std::memcpy(&value, record_.data() + offset, sizeof(T));
+    return value;
+  }
+
+  // The characters up to the first '\0', or size.
+  [[nodiscard]] std::string ReadStringAtOffset(size_t offset,
+                                               size_t size) const {
+    CHECK(offset + size <= record_.size());
+    const char* data = reinterpret_cast<const char*>(record_.data() + offset);
+    return std::string(data, strnlen(data, size));
+  }
+
+ private:
+  absl::Span<const uint8_t> record_;
+};
+
+// Views of records that end with a perf_event_sample_id_tid_time_streamid_cpu
+// or have one after their header, at offset SampleIdOffset.
+template <size_t SampleIdOffset>
+class SampleIdRecordView : public PerfRecordView {
+ public:
+  using PerfRecordView::PerfRecordView;
+
+  [[nodiscard]] pid_t GetPid() const {
+    return ReadValueAtOffset<uint32_t>(
+        SampleIdOffset +
+        offsetof(perf_event_sample_id_tid_time_streamid_cpu, pid));
+  }
+  [[nodiscard]] pid_t GetTid() const {
+    return ReadValueAtOffset<uint32_t>(
+        SampleIdOffset +
+        offsetof(perf_event_sample_id_tid_time_streamid_cpu, tid));
+  }
+  [[nodiscard]] uint64_t GetTimestamp() const {
+    return ReadValueAtOffset<uint64_t>(
+        SampleIdOffset +
+        offsetof(perf_event_sample_id_tid_time_streamid_cpu, time));
+  }
+  [[nodiscard]] uint16_t GetCpu() const {
+    return static_cast<uint16_t>(ReadValueAtOffset<uint32_t>(
+        SampleIdOffset +
+        offsetof(perf_event_sample_id_tid_time_streamid_cpu, cpu)));
+  }
+};
+
+using ContextSwitchCpuWideRecordView =
+    SampleIdRecordView<offsetof(perf_event_context_switch_cpu_wide, sample_id)>;
+
+// Any PERF_RECORD_SAMPLE, as for all of them the sample id comes first.
+using SampleRecordView =
+    SampleIdRecordView<offsetof(perf_event_raw_sample_fixed, sample_id)>;
+
+// PERF_RECORD_FORK and PERF_RECORD_EXIT: the pid is the one of the process
+// that forked or exited, not the one of the sample id.
+class ForkExitRecordView : public PerfRecordView {
+ public:
+  using PerfRecordView::PerfRecordView;
+
+  [[nodiscard]] pid_t GetPid() const {
+    return ReadValueAtOffset<uint32_t>(offsetof(perf_event_fork_exit, pid));
+  }
+};
+
+class LostRecordView : public PerfRecordView {
+ public:
+  using PerfRecordView::PerfRecordView;
+
+  [[nodiscard]] uint64_t GetNumLost() const {
+    return ReadValueAtOffset<uint64_t>(offsetof(perf_event_lost, lost));
+  }
+};
+
+// The data of a tracepoint sample is after the size in
+// perf_event_raw_sample_fixed.
+class TracepointRecordView : public SampleRecordView {
+ public:
+  using SampleRecordView::SampleRecordView;
+
+ protected:
+  static constexpr size_t kTracepointDataOffset =
+      offsetof(perf_event_raw_sample_fixed, size) + sizeof(uint32_t);
+};
+
+class TaskNewtaskRecordView : public TracepointRecordView {
+ public:
+  using TracepointRecordView::TracepointRecordView;
+
+  // The tracepoint format calls this "pid" but it's effectively the thread id.
+  [[nodiscard]] pid_t GetNewTid() const {
+    return ReadValueAtOffset<int32_t>(
+        kTracepointDataOffset + offsetof(task_newtask_tracepoint, pid));
+  }
+  [[nodiscard]] std::string GetComm() const {
+    return ReadStringAtOffset(
+        kTracepointDataOffset + offsetof(task_newtask_tracepoint, comm),
+        sizeof(task_newtask_tracepoint::comm));
+  }
+};
+
+class TaskRenameRecordView : public TracepointRecordView {
+ public:
+  using TracepointRecordView::TracepointRecordView;
+
+  [[nodiscard]] pid_t GetRenamedTid() const {
+    return ReadValueAtOffset<int32_t>(
+        kTracepointDataOffset + offsetof(task_rename_tracepoint, pid));
+  }
+  [[nodiscard]] std::string GetNewComm() const {
+    return ReadStringAtOffset(
+        kTracepointDataOffset + offsetof(task_rename_tracepoint, newcomm),
+        sizeof(task_rename_tracepoint::newcomm));
+  }
+};
+
+class SchedWakeupRecordView : public TracepointRecordView {
+ public:
+  using TracepointRecordView::TracepointRecordView;
+
+  [[nodiscard]] int32_t GetWakeeTid() const {
+    return ReadValueAtOffset<int32_t>(
+        kTracepointDataOffset + offsetof(sched_wakeup_tracepoint, pid));
+  }
+};
+
+// Of power:cpu_frequency and power:cpu_idle. The cpu the event is about is not
+// necessarily the one it was recorded on.
+class CpuPowerRecordView : public TracepointRecordView {
+ public:
+  using TracepointRecordView::TracepointRecordView;
+
+  [[nodiscard]] uint32_t GetState() const {
+    return ReadValueAtOffset<uint32_t>(
+        kTracepointDataOffset + offsetof(cpu_power_tracepoint, state));
+  }
+  [[nodiscard]] int32_t GetCpuId() const {
+    return ReadValueAtOffset<uint32_t>(
+        kTracepointDataOffset + offsetof(cpu_power_tracepoint, cpu_id));
+  }
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_PERF_RECORD_VIEWS_H_
@@ -0,0 +1,86 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+#include "PerfRecordViews.h"
+
+namespace LinuxTracing {
+
+namespace {
+template <typename T>
+absl::Span<const uint8_t> AsSpan(const T& value) {
+  return absl::MakeConstSpan(reinterpret_cast<const uint8_t*>(&value),
+                             sizeof(T));
+}
+}  // namespace
+
+TEST(PerfRecordViews, ContextSwitchCpuWide) {
+  perf_event_context_switch_cpu_wide record{};
+  record.sample_id.pid = 1;
+  record.sample_id.tid = 2;
+  record.sample_id.time = 3;
+  record.sample_id.cpu = 4;
+  ContextSwitchCpuWideRecordView view{AsSpan(record)};
+  EXPECT_EQ(view.GetPid(), 1);
+  EXPECT_EQ(view.GetTid(), 2);
+  EXPECT_EQ(view.GetTimestamp(), 3);
+  EXPECT_EQ(view.GetCpu(), 4);
+}
+
+TEST(PerfRecordViews, ForkExitAndLost) {
+  perf_event_fork_exit fork_exit{};
+  fork_exit.pid = 42;
+  fork_exit.sample_id.pid = 1;
+  EXPECT_EQ(ForkExitRecordView{AsSpan(fork_exit)}.GetPid(), 42);
+
+  perf_event_lost lost{};
+  lost.lost = 7;
+  EXPECT_EQ(LostRecordView{AsSpan(lost)}.GetNumLost(), 7);
+}
+
+TEST(PerfRecordViews, TaskRename) {
+  task_rename_tracepoint tracepoint{};
+  tracepoint.pid = 42;
+  std::strcpy(tracepoint.oldcomm, "old");
+  // Not null-terminated, as the kernel truncates the name to the buffer.
+  std::memcpy(tracepoint.newcomm, "0123456789abcdef", 16);
+
+  perf_event_raw_sample_fixed fixed{};
+  fixed.sample_id.tid = 2;
+  fixed.sample_id.time = 3;
+  fixed.size = sizeof(tracepoint);
+  std::vector<uint8_t> record(sizeof(fixed) + sizeof(tracepoint));
+  std::memcpy(record.data(), &fixed, sizeof(fixed));
+  std::memcpy(record.data() + sizeof(fixed), &tracepoint, sizeof(tracepoint));
+
+  TaskRenameRecordView view{absl::MakeConstSpan(record)};
+  EXPECT_EQ(view.GetRenamedTid(), 42);
+  EXPECT_EQ(view.GetNewComm(), "0123456789abcdef");
+  EXPECT_EQ(view.GetTid(), 2);
+  EXPECT_EQ(view.GetTimestamp(), 3);
+}
+
+TEST(PerfRecordViews, CpuPower) {
+  cpu_power_tracepoint tracepoint{};
+  tracepoint.state = 2400000;
+  tracepoint.cpu_id = 5;
+
+  perf_event_raw_sample_fixed fixed{};
+  fixed.sample_id.time = 3;
+  fixed.size = sizeof(tracepoint);
+  std::vector<uint8_t> record(sizeof(fixed) + sizeof(tracepoint));
+  std::memcpy(record.data(), &fixed, sizeof(fixed));
+  std::memcpy(record.data() + sizeof(fixed), &tracepoint, sizeof(tracepoint));
+
+  CpuPowerRecordView view{absl::MakeConstSpan(record)};
+  EXPECT_EQ(view.GetState(), 2400000);
+  EXPECT_EQ(view.GetCpuId(), 5);
+  EXPECT_EQ(view.GetTimestamp(), 3);
+}
+
+}  // namespace LinuxTracing
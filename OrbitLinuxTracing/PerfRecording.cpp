@@ -0,0 +1,206 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "PerfRecording.h"
+
+#include <OrbitBase/Logging.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/util/delimited_message_util.h>
+
+#include <filesystem>
+#include <system_error>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+
+namespace LinuxTracing {
+
+namespace {
+// The offset of the path in a line of /proc/<pid>/maps, e.g.,
+// "7f0a8e1c5000-7f0a8e33a000 r-xp 00025000 fe:01 1234   /lib/libc.so.6", or
+// npos for an anonymous map.
+size_t FindMapsLinePathOffset(std::string_view line) {
+  size_t offset = 0;
+  // Skip the address range, the permissions, the offset, the device and the
+  // inode.
+  for (int field = 0; field < 5; ++field) {
+    offset = line.find_first_not_of(' ', offset);
+    if (offset == std::string_view::npos) {
+      return std::string_view::npos;
+    }
+    offset = line.find(' ', offset);
+    if (offset == std::string_view::npos) {
+      return std::string_view::npos;
+    }
+  }
+  return line.find_first_not_of(' ', offset);
+}
+}  // namespace
+
+std::unique_ptr<PerfRecordingWriter> PerfRecordingWriter::Create(
+    const std::string& path) {
+  std::ofstream file{path, std::ios::out | std::ios::binary | std::ios::trunc};
+  if (!file.is_open()) {
+    ERROR("Could not create perf recording \"%s\"", path.c_str());
+    return nullptr;
+  }
+  return std::unique_ptr<PerfRecordingWriter>(
+      new PerfRecordingWriter{std::move(file), GetBundledFilesDirectory(path)});
+}
+
+void PerfRecordingWriter::WriteHeader(const PerfRecordingHeader& header) {
+  std::lock_guard<std::mutex> lock{file_mutex_};
+  if (!google::protobuf::util::SerializeDelimitedToOstream(header, &file_)) {
+    ERROR("Writing the header of the perf recording");
+  }
+}
+
+void PerfRecordingWriter::WriteRecords(int file_descriptor,
+                                       std::string records) {
+  PerfRecordingRecords message;
+  message.set_file_descriptor(file_descriptor);
+  const uint64_t size = records.size();
+  message.set_records(std::move(records));
+
+  std::lock_guard<std::mutex> lock{file_mutex_};
+  if (!google::protobuf::util::SerializeDelimitedToOstream(message, &file_)) {
+    ERROR("Writing %lu bytes of records to the perf recording", size);
+    return;
+  }
+  records_bytes_written_ += size;
+}
+
+void PerfRecordingWriter::BundleFile(const std::string& path) {
+  if (path.empty() || path[0] != '/') {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock{bundled_paths_mutex_};
+    if (!bundled_paths_.insert(path).second) {
+      return;
+    }
+  }
+
+  const std::filesystem::path bundled_path =
+      GetBundledFilePath(bundled_files_directory_, path);
+  std::error_code error;
+  std::filesystem::create_directories(bundled_path.parent_path(), error);
+  if (error) {
+    ERROR("Creating \"%s\": %s", bundled_path.parent_path().c_str(),
+          error.message().c_str());
+    return;
+  }
+  std::filesystem::copy_file(
+      path, bundled_path, std::filesystem::copy_options::overwrite_existing,
+      error);
+  if (error) {
+    ERROR("Bundling \"%s\": %s", path.c_str(), error.message().c_str());
+  }
+}
+
+void PerfRecordingWriter::BundleFilesOfMaps(std::string_view maps) {
+  for (std::string_view line : absl::StrSplit(maps, '\n')) {
+    // E.g., "r-xp", after the address range.
+    size_t permissions_offset = line.find(' ');
+    if (permissions_offset == std::string_view::npos ||
+        line.size() < permissions_offset + 4 ||
+        line[permissions_offset + 3] != 'x') {
+      continue;
+    }
+    size_t path_offset = FindMapsLinePathOffset(line);
+    if (path_offset != std::string_view::npos) {
+      BundleFile(std::string{line.substr(path_offset)});
+    }
+  }
+}
+
+std::optional<PerfRecording> ReadPerfRecording(const std::string& path) {
+  std::ifstream file{path, std::ios::in | std::ios::binary};
+  if (!file.is_open()) {
+    ERROR("Could not open perf recording \"%s\"", path.c_str());
+    return std::nullopt;
+  }
+  google::protobuf::io::IstreamInputStream input{&file};
+
+  PerfRecording recording;
+  recording.bundled_files_directory = GetBundledFilesDirectory(path);
+  bool clean_eof = false;
+  if (!google::protobuf::util::ParseDelimitedFromZeroCopyStream(
+          &recording.header, &input, &clean_eof)) {
+    ERROR("Perf recording \"%s\" has no header", path.c_str());
+    return std::nullopt;
+  }
+
+  PerfRecordingRecords records;
+  uint64_t records_message_count = 0;
+  while (google::protobuf::util::ParseDelimitedFromZeroCopyStream(
+      &records, &input, &clean_eof)) {
+    std::vector<char>& records_of_fd =
+        recording.records_by_fd[records.file_descriptor()];
+    records_of_fd.insert(records_of_fd.end(), records.records().begin(),
+                         records.records().end());
+    ++records_message_count;
+  }
+  if (!clean_eof) {
+    ERROR("Perf recording \"%s\" is truncated after %lu messages",
+          path.c_str(), records_message_count);
+  }
+  return recording;
+}
+
+std::string GetBundledFilesDirectory(std::string_view recording_path) {
+  return absl::StrCat(recording_path, ".files");
+}
+
+std::string GetBundledFilePath(std::string_view bundled_files_directory,
+                               std::string_view path) {
+  if (path.empty() || path[0] != '/') {
+    return std::string{path};
+  }
+  return absl::StrCat(bundled_files_directory, path);
+}
+
+std::optional<std::string> FindBundledFile(
+    std::string_view bundled_files_directory, std::string_view path) {
+  if (path.empty() || path[0] != '/') {
+    return std::nullopt;
+  }
+  std::string bundled_path = GetBundledFilePath(bundled_files_directory, path);
+  std::error_code error;
+  if (!std::filesystem::exists(bundled_path, error)) {
+    return std::nullopt;
+  }
+  return bundled_path;
+}
+
+std::string RemapMapsToBundledFiles(std::string_view maps,
+                                    std::string_view bundled_files_directory) {
+  std::string remapped_maps;
+  remapped_maps.reserve(maps.size());
+  bool first_line = true;
+  for (std::string_view line : absl::StrSplit(maps, '\n')) {
+    if (!first_line) {
+      remapped_maps.push_back('\n');
+    }
+    first_line = false;
+    size_t path_offset = FindMapsLinePathOffset(line);
+    if (path_offset == std::string_view::npos) {
+      absl::StrAppend(&remapped_maps, line);
+      continue;
+    }
+    // Only the files with executable maps are bundled, the other maps of
+    // these files are remapped too.
+    std::optional<std::string> bundled_path = FindBundledFile(
+        bundled_files_directory, line.substr(path_offset));
+    if (!bundled_path.has_value()) {
+      absl::StrAppend(&remapped_maps, line);
+      continue;
+    }
+    absl::StrAppend(&remapped_maps, line.substr(0, path_offset),
+                    bundled_path.value());
+  }
+  return remapped_maps;
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,88 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_PERF_RECORDING_H_
+#define ORBIT_LINUX_TRACING_PERF_RECORDING_H_
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "capture.pb.h"
+
+namespace LinuxTracing {
+
+// Writes the file of CaptureOptions.perf_recording_path: the
+// PerfRecordingHeader, then the records of the ring buffers as they are read,
+// and copies the files mapped executable to the bundled files directory.
+// Can be used from multiple threads.
+class PerfRecordingWriter {
+ public:
+  // Returns nullptr if the file can't be created.
+  static std::unique_ptr<PerfRecordingWriter> Create(const std::string& path);
+
+  PerfRecordingWriter(const PerfRecordingWriter&) = delete;
+  PerfRecordingWriter& operator=(const PerfRecordingWriter&) = delete;
+
+  // Must be called once, before the records.
+  void WriteHeader(const PerfRecordingHeader& header);
+  // Consecutive records read from the ring buffer with this file descriptor.
+  void WriteRecords(int file_descriptor, std::string records);
+  // Copies the file at this absolute path, the first time only. Other paths,
+  // e.g., "[vdso]", are ignored.
+  void BundleFile(const std::string& path);
+  // Also bundles the files of the maps, in the format of /proc/<pid>/maps.
+  void BundleFilesOfMaps(std::string_view maps);
+
+  [[nodiscard]] uint64_t GetRecordsBytesWritten() const {
+    return records_bytes_written_;
+  }
+
+ private:
+  PerfRecordingWriter(std::ofstream file, std::string bundled_files_directory)
+      : file_{std::move(file)},
+        bundled_files_directory_{std::move(bundled_files_directory)} {}
+
+  std::mutex file_mutex_;
+  std::ofstream file_;
+  uint64_t records_bytes_written_ = 0;
+  std::mutex bundled_paths_mutex_;
+  std::string bundled_files_directory_;
+  absl::flat_hash_set<std::string> bundled_paths_;
+};
+
+// A file written by PerfRecordingWriter, with all the records of each ring
+// buffer concatenated.
+struct PerfRecording {
+  PerfRecordingHeader header;
+  absl::flat_hash_map<int, std::vector<char>> records_by_fd;
+  std::string bundled_files_directory;
+};
+
+// Returns nullopt if the file can't be read, or misses its header.
+std::optional<PerfRecording> ReadPerfRecording(const std::string& path);
+
+// Where the files of the recording at recording_path are bundled.
+std::string GetBundledFilesDirectory(std::string_view recording_path);
+// The copy of the file at an absolute path. Other paths are returned as is.
+std::string GetBundledFilePath(std::string_view bundled_files_directory,
+                               std::string_view path);
+// The copy of the file at path, if it was bundled.
+std::optional<std::string> FindBundledFile(
+    std::string_view bundled_files_directory, std::string_view path);
+// Replaces the paths in maps, in the format of /proc/<pid>/maps, with the
+// ones of their copies, for the files that were bundled.
+std::string RemapMapsToBundledFiles(std::string_view maps,
+                                    std::string_view bundled_files_directory);
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_PERF_RECORDING_H_
@@ -0,0 +1,198 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Replays the perf recordings written with CaptureOptions.perf_recording_path,
+// i.e., with the --record_perf_events flag of OrbitService, through the same
+// TracerThread, PerfEventProcessor2 and UprobesUnwindingVisitor as a capture,
+// without the kernel, and reports the throughput and the number of events of
+// each kind reported to the TracerListener.
+//
+// Usage: PerfRecordingReplay <recording>...
+
+#include <OrbitLinuxTracing/TracerListener.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "PerfRecording.h"
+#include "TracerThread.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+
+namespace {
+enum EventKind : size_t {
+  kSchedulingSlices,
+  kSchedulingSliceCounters,
+  kCallstackSamples,
+  kOffCpuCallstackSamples,
+  kLockWaits,
+  kLockContentionStats,
+  kAllocationSamples,
+  kSyscallLatencies,
+  kBlockIoLatencies,
+  kCpuPowerEvents,
+  kPageFaults,
+  kFunctionCalls,
+  kFunctionCallStats,
+  kGpuJobs,
+  kThreadNames,
+  kThreadWakeups,
+  kAddressInfos,
+  kModuleMaps,
+  kAsyncSpans,
+  kFrameMarkers,
+  kEventKindCount
+};
+
+constexpr std::array<const char*, kEventKindCount> EVENT_KIND_NAMES = {
+    "scheduling_slices",   "scheduling_slice_counters",
+    "callstack_samples",   "off_cpu_callstack_samples",
+    "lock_waits",          "lock_contention_stats",
+    "allocation_samples",  "syscall_latencies",
+    "block_io_latencies",  "cpu_power_events",
+    "page_faults",         "function_calls",
+    "function_call_stats", "gpu_jobs",
+    "thread_names",        "thread_wakeups",
+    "address_infos",       "module_maps",
+    "async_spans",         "frame_markers",
+};
+
+// Only counts the events, which can be reported from multiple threads.
+class CountingTracerListener : public LinuxTracing::TracerListener {
+ public:
+  void OnSchedulingSlices(
+      std::vector<SchedulingSlice> scheduling_slices) override {
+    counts_[kSchedulingSlices] += scheduling_slices.size();
+  }
+  void OnSchedulingSliceCounters(
+      SchedulingSliceCounters /*scheduling_slice_counters*/) override {
+    ++counts_[kSchedulingSliceCounters];
+  }
+  void OnCallstackSample(CallstackSample /*callstack_sample*/) override {
+    ++counts_[kCallstackSamples];
+  }
+  void OnOffCpuCallstackSample(
+      OffCpuCallstackSample /*off_cpu_callstack_sample*/) override {
+    ++counts_[kOffCpuCallstackSamples];
+  }
+  void OnLockWait(LockWait /*lock_wait*/) override { ++counts_[kLockWaits]; }
+  void OnLockContentionStats(
+      LockContentionStats /*lock_contention_stats*/) override {
+    ++counts_[kLockContentionStats];
+  }
+  void OnAllocationSample(AllocationSample /*allocation_sample*/) override {
+    ++counts_[kAllocationSamples];
+  }
+  void OnSyscallLatency(SyscallLatency /*syscall_latency*/) override {
+    ++counts_[kSyscallLatencies];
+  }
+  void OnBlockIoLatency(BlockIoLatency /*block_io_latency*/) override {
+    ++counts_[kBlockIoLatencies];
+  }
+  void OnCpuPowerEvent(CpuPowerEvent /*cpu_power_event*/) override {
+    ++counts_[kCpuPowerEvents];
+  }
+  void OnPageFault(PageFault /*page_fault*/) override {
+    ++counts_[kPageFaults];
+  }
+  void OnPageFaultStats(PageFaultStats /*page_fault_stats*/) override {}
+  void OnFunctionCall(FunctionCall /*function_call*/) override {
+    ++counts_[kFunctionCalls];
+  }
+  void OnFunctionCallStats(
+      FunctionCallStats /*function_call_stats*/) override {
+    ++counts_[kFunctionCallStats];
+  }
+  void OnGpuJob(GpuJob /*gpu_job*/) override { ++counts_[kGpuJobs]; }
+  void OnThreadName(ThreadName /*thread_name*/) override {
+    ++counts_[kThreadNames];
+  }
+  void OnThreadWakeup(ThreadWakeup /*thread_wakeup*/) override {
+    ++counts_[kThreadWakeups];
+  }
+  void OnAddressInfo(AddressInfo /*address_info*/) override {
+    ++counts_[kAddressInfos];
+  }
+  void OnModuleMap(ModuleMap /*module_map*/) override {
+    ++counts_[kModuleMaps];
+  }
+  void OnCaptureSetupPhase(
+      CaptureSetupPhase /*capture_setup_phase*/) override {}
+  void OnCaptureStatistics(
+      CaptureStatistics /*capture_statistics*/) override {}
+  void OnIntrospectionScope(
+      IntrospectionScope /*introspection_scope*/) override {}
+  void OnManualInstrumentationScope(
+      ManualInstrumentationScope /*manual_instrumentation_scope*/) override {}
+  void OnGpuQueueSubmission(
+      GpuQueueSubmission /*gpu_queue_submission*/) override {}
+  void OnAsyncSpan(AsyncSpan /*async_span*/) override {
+    ++counts_[kAsyncSpans];
+  }
+  void OnFrameMarker(FrameMarker /*frame_marker*/) override {
+    ++counts_[kFrameMarkers];
+  }
+  void OnDisabledInstrumentedFunctions(
+      DisabledInstrumentedFunctions /*disabled_instrumented_functions*/)
+      override {}
+  void OnCpuBudgetStep(CpuBudgetStep /*cpu_budget_step*/) override {}
+  void OnClockOffset(ClockOffset /*clock_offset*/) override {}
+
+  [[nodiscard]] uint64_t GetCount(EventKind kind) const {
+    return counts_[kind];
+  }
+
+ private:
+  std::array<std::atomic<uint64_t>, kEventKindCount> counts_{};
+};
+
+bool ReplayRecording(const std::string& path) {
+  std::optional<LinuxTracing::PerfRecording> recording =
+      LinuxTracing::ReadPerfRecording(path);
+  if (!recording.has_value()) {
+    return false;
+  }
+  uint64_t records_bytes = 0;
+  for (const auto& [fd, records] : recording->records_by_fd) {
+    records_bytes += records.size();
+  }
+  absl::PrintF("%s: %d ring buffers, %lu bytes of records\n", path,
+               recording->header.ring_buffers_size(), records_bytes);
+
+  CountingTracerListener listener;
+  LinuxTracing::TracerThread tracer_thread{
+      recording->header.capture_options()};
+  tracer_thread.SetListener(&listener);
+  const absl::Time start = absl::Now();
+  tracer_thread.Replay(std::move(recording.value()));
+  const double seconds = absl::ToDoubleSeconds(absl::Now() - start);
+
+  absl::PrintF("  %.3f s, %.1f MB/s of records\n", seconds,
+               seconds > 0 ? records_bytes / seconds / 1e6 : 0);
+  for (size_t kind = 0; kind < kEventKindCount; ++kind) {
+    uint64_t count = listener.GetCount(static_cast<EventKind>(kind));
+    if (count > 0) {
+      absl::PrintF("  %-28s %12lu\n", EVENT_KIND_NAMES[kind], count);
+    }
+  }
+  return true;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    absl::PrintF("Usage: %s <recording>...\n", argv[0]);
+    return 1;
+  }
+  bool succeeded = true;
+  for (int i = 1; i < argc; ++i) {
+    succeeded = ReplayRecording(argv[i]) && succeeded;
+  }
+  return succeeded ? 0 : 1;
+}
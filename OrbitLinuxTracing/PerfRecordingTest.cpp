@@ -0,0 +1,170 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <linux/perf_event.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "PerfEventRingBuffer.h"
+#include "PerfRecording.h"
+#include "absl/strings/str_format.h"
+
+namespace LinuxTracing {
+
+namespace {
+
+std::string CreateTemporaryDirectory() {
+  std::string directory = absl::StrFormat(
+      "%s/PerfRecordingTest.%d",
+      std::filesystem::temp_directory_path().string(), getpid());
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+  return directory;
+}
+
+void AppendRecord(std::vector<char>* records, uint32_t type, uint16_t size) {
+  perf_event_header header{};
+  header.type = type;
+  header.size = size;
+  size_t offset = records->size();
+  records->resize(offset + size, 'x');
+  memcpy(records->data() + offset, &header, sizeof(header));
+}
+
+}  // namespace
+
+TEST(PerfRecording, WrittenRecordingIsReadBack) {
+  std::string directory = CreateTemporaryDirectory();
+  std::string path = directory + "/recording";
+  {
+    std::unique_ptr<PerfRecordingWriter> writer =
+        PerfRecordingWriter::Create(path);
+    ASSERT_NE(writer, nullptr);
+    PerfRecordingHeader header;
+    header.set_cpu_count(4);
+    header.add_ring_buffers()->set_file_descriptor(7);
+    writer->WriteHeader(header);
+    writer->WriteRecords(7, "abc");
+    writer->WriteRecords(8, "de");
+    writer->WriteRecords(7, "fg");
+    EXPECT_EQ(writer->GetRecordsBytesWritten(), 7);
+  }
+
+  std::optional<PerfRecording> recording = ReadPerfRecording(path);
+  ASSERT_TRUE(recording.has_value());
+  EXPECT_EQ(recording->header.cpu_count(), 4);
+  ASSERT_EQ(recording->header.ring_buffers_size(), 1);
+  EXPECT_EQ(recording->header.ring_buffers(0).file_descriptor(), 7);
+  EXPECT_EQ(recording->records_by_fd.size(), 2);
+  EXPECT_EQ(std::string(recording->records_by_fd[7].begin(),
+                        recording->records_by_fd[7].end()),
+            "abcfg");
+  EXPECT_EQ(std::string(recording->records_by_fd[8].begin(),
+                        recording->records_by_fd[8].end()),
+            "de");
+  EXPECT_EQ(recording->bundled_files_directory, path + ".files");
+
+  std::filesystem::remove_all(directory);
+}
+
+TEST(PerfRecording, MissingRecordingIsNotRead) {
+  EXPECT_FALSE(ReadPerfRecording("/nonexistent/recording").has_value());
+}
+
+TEST(PerfRecording, ExecutableMapsAreBundledAndRemapped) {
+  std::string directory = CreateTemporaryDirectory();
+  std::string library_path = directory + "/lib with space.so";
+  { std::ofstream{library_path} << "elf"; }
+  std::string data_path = directory + "/data";
+  { std::ofstream{data_path} << "data"; }
+  std::string maps = absl::StrFormat(
+      "1000-2000 r--p 00000000 fe:01 1 %s\n"
+      "2000-3000 r-xp 00001000 fe:01 1 %s\n"
+      "3000-4000 rw-p 00000000 fe:01 2 %s\n"
+      "4000-5000 rw-p 00000000 00:00 0\n"
+      "7fff0000-7fff1000 r-xp 00000000 00:00 0                  [vdso]",
+      library_path, library_path, data_path);
+
+  std::string recording_path = directory + "/recording";
+  {
+    std::unique_ptr<PerfRecordingWriter> writer =
+        PerfRecordingWriter::Create(recording_path);
+    ASSERT_NE(writer, nullptr);
+    writer->BundleFilesOfMaps(maps);
+  }
+
+  std::string bundled_files_directory =
+      GetBundledFilesDirectory(recording_path);
+  std::string bundled_library_path = bundled_files_directory + library_path;
+  std::ifstream bundled_library{bundled_library_path};
+  std::string content;
+  bundled_library >> content;
+  EXPECT_EQ(content, "elf");
+  EXPECT_FALSE(FindBundledFile(bundled_files_directory, data_path).has_value());
+
+  EXPECT_EQ(RemapMapsToBundledFiles(maps, bundled_files_directory),
+            absl::StrFormat(
+                "1000-2000 r--p 00000000 fe:01 1 %s\n"
+                "2000-3000 r-xp 00001000 fe:01 1 %s\n"
+                "3000-4000 rw-p 00000000 fe:01 2 %s\n"
+                "4000-5000 rw-p 00000000 00:00 0\n"
+                "7fff0000-7fff1000 r-xp 00000000 00:00 0                  "
+                "[vdso]",
+                bundled_library_path, bundled_library_path, data_path));
+
+  std::filesystem::remove_all(directory);
+}
+
+TEST(PerfRecording, RingBufferFromRecordsIsReadAndRecorded) {
+  std::vector<char> records;
+  AppendRecord(&records, PERF_RECORD_SAMPLE, 16);
+  AppendRecord(&records, PERF_RECORD_MMAP2, 24);
+  AppendRecord(&records, PERF_RECORD_LOST, 8);
+  const std::string expected_records(records.begin(), records.end());
+
+  std::string directory = CreateTemporaryDirectory();
+  std::string path = directory + "/recording";
+  {
+    std::unique_ptr<PerfRecordingWriter> writer =
+        PerfRecordingWriter::Create(path);
+    ASSERT_NE(writer, nullptr);
+    writer->WriteHeader(PerfRecordingHeader{});
+
+    PerfEventRingBuffer ring_buffer =
+        PerfEventRingBuffer::FromRecords(3, "test", std::move(records));
+    ASSERT_TRUE(ring_buffer.IsOpen());
+    EXPECT_EQ(ring_buffer.GetFileDescriptor(), 3);
+    ring_buffer.SetRecordingWriter(writer.get());
+
+    std::vector<uint32_t> types;
+    ring_buffer.BeginBatch();
+    while (ring_buffer.HasNewData()) {
+      perf_event_header header;
+      ring_buffer.ReadHeader(&header);
+      types.push_back(header.type);
+      ring_buffer.SkipRecord(header);
+    }
+    ring_buffer.EndBatch();
+    EXPECT_EQ(types, (std::vector<uint32_t>{PERF_RECORD_SAMPLE,
+                                            PERF_RECORD_MMAP2,
+                                            PERF_RECORD_LOST}));
+  }
+
+  std::optional<PerfRecording> recording = ReadPerfRecording(path);
+  ASSERT_TRUE(recording.has_value());
+  EXPECT_EQ(std::string(recording->records_by_fd[3].begin(),
+                        recording->records_by_fd[3].end()),
+            expected_records);
+
+  std::filesystem::remove_all(directory);
+}
+
+}  // namespace LinuxTracing
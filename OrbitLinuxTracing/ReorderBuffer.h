@@ -0,0 +1,90 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_REORDER_BUFFER_H_
+#define ORBIT_LINUX_TRACING_REORDER_BUFFER_H_
+
+#include <OrbitBase/Logging.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+
+namespace LinuxTracing {
+
+// ReorderBuffer receives results that are produced out of order, possibly by
+// multiple threads, and passes them to the consumer in the order in which their
+// sequence numbers were reserved. A sequence number can also be completed
+// without a result (e.g., on error), so that it doesn't hold back later ones.
+// The consumer is called with the internal lock held, so calls to the consumer
+// never overlap.
+template <typename T>
+class ReorderBuffer {
+ public:
+  explicit ReorderBuffer(std::function<void(T&&)> consumer)
+      : consumer_{std::move(consumer)} {}
+
+  ReorderBuffer(const ReorderBuffer&) = delete;
+  ReorderBuffer& operator=(const ReorderBuffer&) = delete;
+  ReorderBuffer(ReorderBuffer&&) = delete;
+  ReorderBuffer& operator=(ReorderBuffer&&) = delete;
+
+  // Results will be passed on in the order of the calls to this method.
+  uint64_t ReserveSequenceNumber() {
+    absl::MutexLock lock{&mutex_};
+    return next_sequence_number_++;
+  }
+
+  void Complete(uint64_t sequence_number, std::optional<T> result) {
+    absl::MutexLock lock{&mutex_};
+    CHECK(sequence_number >= next_sequence_number_to_release_);
+    CHECK(sequence_number < next_sequence_number_);
+    completed_.emplace(sequence_number, std::move(result));
+
+    while (!completed_.empty() &&
+           completed_.begin()->first == next_sequence_number_to_release_) {
+      auto completed_node = completed_.extract(completed_.begin());
+      ++next_sequence_number_to_release_;
+      if (completed_node.mapped().has_value()) {
+        consumer_(std::move(completed_node.mapped().value()));
+      }
+    }
+  }
+
+  // Number of sequence numbers that were reserved but not released yet.
+  uint64_t GetInFlightCount() {
+    absl::MutexLock lock{&mutex_};
+    return next_sequence_number_ - next_sequence_number_to_release_;
+  }
+
+  void WaitForInFlightCountAtMost(uint64_t max_in_flight_count) {
+    struct AwaitArgs {
+      ReorderBuffer* self;
+      uint64_t max_in_flight_count;
+    } await_args{this, max_in_flight_count};
+    absl::MutexLock lock{&mutex_};
+    mutex_.Await(absl::Condition(
+        +[](AwaitArgs* args) {
+          return args->self->next_sequence_number_ -
+                     args->self->next_sequence_number_to_release_ <=
+                 args->max_in_flight_count;
+        },
+        &await_args));
+  }
+
+ private:
+  std::function<void(T&&)> consumer_;
+  absl::Mutex mutex_;
+  uint64_t next_sequence_number_ = 0;
+  uint64_t next_sequence_number_to_release_ = 0;
+  std::map<uint64_t, std::optional<T>> completed_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_REORDER_BUFFER_H_
@@ -0,0 +1,122 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "ReorderBuffer.h"
+
+namespace LinuxTracing {
+
+using ::testing::ElementsAre;
+
+TEST(ReorderBuffer, InOrder) {
+  std::vector<int> consumed;
+  ReorderBuffer<int> reorder_buffer{
+      [&consumed](int&& value) { consumed.push_back(value); }};
+
+  uint64_t first = reorder_buffer.ReserveSequenceNumber();
+  uint64_t second = reorder_buffer.ReserveSequenceNumber();
+  EXPECT_EQ(reorder_buffer.GetInFlightCount(), 2);
+
+  reorder_buffer.Complete(first, 1);
+  EXPECT_THAT(consumed, ElementsAre(1));
+  reorder_buffer.Complete(second, 2);
+  EXPECT_THAT(consumed, ElementsAre(1, 2));
+  EXPECT_EQ(reorder_buffer.GetInFlightCount(), 0);
+}
+
+TEST(ReorderBuffer, OutOfOrder) {
+  std::vector<int> consumed;
+  ReorderBuffer<int> reorder_buffer{
+      [&consumed](int&& value) { consumed.push_back(value); }};
+
+  uint64_t first = reorder_buffer.ReserveSequenceNumber();
+  uint64_t second = reorder_buffer.ReserveSequenceNumber();
+  uint64_t third = reorder_buffer.ReserveSequenceNumber();
+
+  reorder_buffer.Complete(third, 3);
+  reorder_buffer.Complete(second, 2);
+  EXPECT_TRUE(consumed.empty());
+  EXPECT_EQ(reorder_buffer.GetInFlightCount(), 3);
+
+  reorder_buffer.Complete(first, 1);
+  EXPECT_THAT(consumed, ElementsAre(1, 2, 3));
+  EXPECT_EQ(reorder_buffer.GetInFlightCount(), 0);
+}
+
+TEST(ReorderBuffer, CompleteWithoutResult) {
+  std::vector<int> consumed;
+  ReorderBuffer<int> reorder_buffer{
+      [&consumed](int&& value) { consumed.push_back(value); }};
+
+  uint64_t first = reorder_buffer.ReserveSequenceNumber();
+  uint64_t second = reorder_buffer.ReserveSequenceNumber();
+  uint64_t third = reorder_buffer.ReserveSequenceNumber();
+
+  reorder_buffer.Complete(third, 3);
+  reorder_buffer.Complete(first, std::nullopt);
+  EXPECT_TRUE(consumed.empty());
+
+  reorder_buffer.Complete(second, 2);
+  EXPECT_THAT(consumed, ElementsAre(2, 3));
+  EXPECT_EQ(reorder_buffer.GetInFlightCount(), 0);
+}
+
+TEST(ReorderBuffer, MultipleThreads) {
+  constexpr int kValueCount = 1000;
+  constexpr int kThreadCount = 4;
+  std::vector<int> consumed;
+  ReorderBuffer<int> reorder_buffer{
+      [&consumed](int&& value) { consumed.push_back(value); }};
+
+  for (int i = 0; i < kValueCount; ++i) {
+    EXPECT_EQ(reorder_buffer.ReserveSequenceNumber(),
+              static_cast<uint64_t>(i));
+  }
+
+  // Each thread completes the sequence numbers congruent to its index, in
+  // reverse order.
+  std::vector<std::thread> threads;
+  for (int thread_index = 0; thread_index < kThreadCount; ++thread_index) {
+    threads.emplace_back([&reorder_buffer, thread_index] {
+      for (int i = kValueCount - kThreadCount + thread_index; i >= 0;
+           i -= kThreadCount) {
+        reorder_buffer.Complete(i, i);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(consumed.size(), kValueCount);
+  for (int i = 0; i < kValueCount; ++i) {
+    EXPECT_EQ(consumed[i], i);
+  }
+}
+
+TEST(ReorderBuffer, WaitForInFlightCountAtMost) {
+  std::vector<int> consumed;
+  ReorderBuffer<int> reorder_buffer{
+      [&consumed](int&& value) { consumed.push_back(value); }};
+
+  uint64_t first = reorder_buffer.ReserveSequenceNumber();
+  uint64_t second = reorder_buffer.ReserveSequenceNumber();
+  reorder_buffer.WaitForInFlightCountAtMost(2);
+
+  std::thread completer{[&reorder_buffer, first, second] {
+    reorder_buffer.Complete(second, 2);
+    reorder_buffer.Complete(first, 1);
+  }};
+  reorder_buffer.WaitForInFlightCountAtMost(0);
+  EXPECT_EQ(reorder_buffer.GetInFlightCount(), 0);
+  completer.join();
+  EXPECT_THAT(consumed, ElementsAre(1, 2));
+}
+
+}  // namespace LinuxTracing
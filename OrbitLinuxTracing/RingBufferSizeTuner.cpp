@@ -0,0 +1,49 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "RingBufferSizeTuner.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace LinuxTracing {
+
+uint64_t RoundUpRingBufferSizeKb(uint64_t size_kb) {
+  const uint64_t page_size_kb =
+      std::max<uint64_t>(static_cast<uint64_t>(getpagesize()) / 1024, 1);
+  uint64_t rounded_size_kb = page_size_kb;
+  while (rounded_size_kb < size_kb) {
+    rounded_size_kb *= 2;
+  }
+  return rounded_size_kb;
+}
+
+RingBufferSizeTuner::RingBufferSizeTuner(
+    const RingBufferSizesKb& default_sizes_kb) {
+  for (size_t i = 0; i < RING_BUFFER_CLASS_COUNT; ++i) {
+    sizes_kb_[i] = RoundUpRingBufferSizeKb(std::max(
+        default_sizes_kb[i] / INITIAL_SIZE_DIVISOR, MIN_SIZE_KB));
+    max_sizes_kb_[i] = std::max(
+        RoundUpRingBufferSizeKb(default_sizes_kb[i] * MAX_SIZE_MULTIPLIER),
+        sizes_kb_[i]);
+  }
+}
+
+RingBufferSizesKb RingBufferSizeTuner::GetSizesKb() {
+  absl::MutexLock lock{&mutex_};
+  return sizes_kb_;
+}
+
+void RingBufferSizeTuner::ReportLostEvents(
+    const std::array<uint64_t, RING_BUFFER_CLASS_COUNT>& lost_count_per_class) {
+  absl::MutexLock lock{&mutex_};
+  for (size_t i = 0; i < RING_BUFFER_CLASS_COUNT; ++i) {
+    if (lost_count_per_class[i] > 0) {
+      sizes_kb_[i] = std::min(2 * sizes_kb_[i], max_sizes_kb_[i]);
+    }
+  }
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,63 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_RING_BUFFER_SIZE_TUNER_H_
+#define ORBIT_LINUX_TRACING_RING_BUFFER_SIZE_TUNER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/synchronization/mutex.h"
+
+namespace LinuxTracing {
+
+// The perf_event_open ring buffers of TracerThread, grouped by the events they
+// receive. Each class has its own size, per cpu.
+enum class RingBufferClass : size_t {
+  kContextSwitches = 0,
+  kUprobes,
+  kMmapTask,
+  kSampling,
+  kTracepoints,
+  kGpuTracing,
+  kSchedSwitchCounters,
+};
+constexpr size_t RING_BUFFER_CLASS_COUNT = 7;
+
+using RingBufferSizesKb = std::array<uint64_t, RING_BUFFER_CLASS_COUNT>;
+
+// Returns the smallest valid ring buffer size, i.e., a power of two number of
+// pages, not smaller than size_kb.
+uint64_t RoundUpRingBufferSizeKb(uint64_t size_kb);
+
+// RingBufferSizeTuner chooses the ring buffer sizes when they are sized
+// automatically. All classes start at a fraction of their default size, so
+// that large machines don't lock gigabytes of memory for events they don't
+// produce. At the end of each capture, the classes that lost events are
+// doubled for the next captures, up to a multiple of their default size.
+// A ring buffer can't be resized while it is mapped, hence the sizes only
+// change between captures.
+// All methods are thread safe.
+class RingBufferSizeTuner {
+ public:
+  explicit RingBufferSizeTuner(const RingBufferSizesKb& default_sizes_kb);
+
+  [[nodiscard]] RingBufferSizesKb GetSizesKb();
+  void ReportLostEvents(const std::array<uint64_t, RING_BUFFER_CLASS_COUNT>&
+                            lost_count_per_class);
+
+  static constexpr uint64_t INITIAL_SIZE_DIVISOR = 8;
+  static constexpr uint64_t MAX_SIZE_MULTIPLIER = 4;
+  static constexpr uint64_t MIN_SIZE_KB = 16;
+
+ private:
+  RingBufferSizesKb max_sizes_kb_;
+  absl::Mutex mutex_;
+  RingBufferSizesKb sizes_kb_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_RING_BUFFER_SIZE_TUNER_H_
@@ -0,0 +1,66 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "RingBufferSizeTuner.h"
+
+namespace LinuxTracing {
+
+namespace {
+constexpr size_t kSampling = static_cast<size_t>(RingBufferClass::kSampling);
+constexpr size_t kMmapTask = static_cast<size_t>(RingBufferClass::kMmapTask);
+
+RingBufferSizesKb MakeDefaultSizesKb() {
+  RingBufferSizesKb default_sizes_kb;
+  default_sizes_kb.fill(256);
+  default_sizes_kb[kSampling] = 16 * 1024;
+  default_sizes_kb[kMmapTask] = 64;
+  return default_sizes_kb;
+}
+}  // namespace
+
+TEST(RingBufferSizeTuner, RoundUpRingBufferSizeKb) {
+  EXPECT_EQ(RoundUpRingBufferSizeKb(0), 4);
+  EXPECT_EQ(RoundUpRingBufferSizeKb(4), 4);
+  EXPECT_EQ(RoundUpRingBufferSizeKb(5), 8);
+  EXPECT_EQ(RoundUpRingBufferSizeKb(1000), 1024);
+  EXPECT_EQ(RoundUpRingBufferSizeKb(1024), 1024);
+}
+
+TEST(RingBufferSizeTuner, StartsSmall) {
+  RingBufferSizeTuner tuner{MakeDefaultSizesKb()};
+  RingBufferSizesKb sizes_kb = tuner.GetSizesKb();
+  EXPECT_EQ(sizes_kb[kSampling], 2 * 1024);
+  EXPECT_EQ(sizes_kb[kMmapTask], RingBufferSizeTuner::MIN_SIZE_KB);
+}
+
+TEST(RingBufferSizeTuner, GrowsOnlyClassesWithLosses) {
+  RingBufferSizeTuner tuner{MakeDefaultSizesKb()};
+  RingBufferSizesKb initial_sizes_kb = tuner.GetSizesKb();
+
+  std::array<uint64_t, RING_BUFFER_CLASS_COUNT> lost_count_per_class{};
+  lost_count_per_class[kSampling] = 10;
+  tuner.ReportLostEvents(lost_count_per_class);
+
+  RingBufferSizesKb sizes_kb = tuner.GetSizesKb();
+  EXPECT_EQ(sizes_kb[kSampling], 2 * initial_sizes_kb[kSampling]);
+  EXPECT_EQ(sizes_kb[kMmapTask], initial_sizes_kb[kMmapTask]);
+}
+
+TEST(RingBufferSizeTuner, GrowthIsBounded) {
+  RingBufferSizeTuner tuner{MakeDefaultSizesKb()};
+  std::array<uint64_t, RING_BUFFER_CLASS_COUNT> lost_count_per_class;
+  lost_count_per_class.fill(1);
+  for (int i = 0; i < 20; ++i) {
+    tuner.ReportLostEvents(lost_count_per_class);
+  }
+
+  RingBufferSizesKb sizes_kb = tuner.GetSizesKb();
+  EXPECT_EQ(sizes_kb[kSampling],
+            16 * 1024 * RingBufferSizeTuner::MAX_SIZE_MULTIPLIER);
+  EXPECT_EQ(sizes_kb[kMmapTask], 64 * RingBufferSizeTuner::MAX_SIZE_MULTIPLIER);
+}
+
+}  // namespace LinuxTracing
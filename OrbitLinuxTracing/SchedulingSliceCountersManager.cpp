@@ -0,0 +1,47 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "SchedulingSliceCountersManager.h"
+
+namespace LinuxTracing {
+
+std::optional<SchedulingSliceCounters>
+SchedulingSliceCountersManager::ProcessSchedSwitch(
+    pid_t pid, pid_t tid, uint16_t core, uint64_t timestamp_ns,
+    const SchedSwitchCounters& counters) {
+  if (core >= last_sched_switches_by_core_.size()) {
+    last_sched_switches_by_core_.resize(core + 1);
+  }
+
+  std::optional<LastSchedSwitch>& last_sched_switch =
+      last_sched_switches_by_core_[core];
+  std::optional<LastSchedSwitch> previous_sched_switch = last_sched_switch;
+  last_sched_switch.emplace(LastSchedSwitch{timestamp_ns, counters});
+
+  if (!previous_sched_switch.has_value() ||
+      counters.sched_switch_count !=
+          previous_sched_switch->counters.sched_switch_count + 1 ||
+      timestamp_ns < previous_sched_switch->timestamp_ns) {
+    return std::nullopt;
+  }
+
+  const SchedSwitchCounters& previous_counters =
+      previous_sched_switch->counters;
+  SchedulingSliceCounters slice_counters;
+  slice_counters.set_pid(pid);
+  slice_counters.set_tid(tid);
+  slice_counters.set_core(core);
+  slice_counters.set_in_timestamp_ns(previous_sched_switch->timestamp_ns);
+  slice_counters.set_out_timestamp_ns(timestamp_ns);
+  slice_counters.set_cycles(counters.cycles - previous_counters.cycles);
+  slice_counters.set_instructions(counters.instructions -
+                                  previous_counters.instructions);
+  slice_counters.set_cache_misses(counters.cache_misses -
+                                  previous_counters.cache_misses);
+  slice_counters.set_branch_misses(counters.branch_misses -
+                                   previous_counters.branch_misses);
+  return slice_counters;
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,71 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_SCHEDULING_SLICE_COUNTERS_MANAGER_H_
+#define ORBIT_LINUX_TRACING_SCHEDULING_SLICE_COUNTERS_MANAGER_H_
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "capture.pb.h"
+
+namespace LinuxTracing {
+
+// The values of the counters of the group opened with
+// sched_switch_counters_event_open, read at a sched_switch.
+struct SchedSwitchCounters {
+  uint64_t sched_switch_count;
+  uint64_t cycles;
+  uint64_t instructions;
+  uint64_t cache_misses;
+  uint64_t branch_misses;
+};
+
+// For each core, keeps the counters read at the last sched_switch and
+// subtracts them from the ones read at the next sched_switch on the same core,
+// to produce the SchedulingSliceCounters of the thread that is switched out,
+// i.e., the thread in whose context the sched_switch is recorded.
+// It assumes that sched_switches for the same core come in order. As for
+// ContextSwitchManager, the state of each core is in a dense array indexed by
+// core, and calls for different cores lower than the core_count passed to
+// Reset can be made concurrently without synchronization.
+class SchedulingSliceCountersManager {
+ public:
+  SchedulingSliceCountersManager() = default;
+
+  SchedulingSliceCountersManager(const SchedulingSliceCountersManager&) =
+      delete;
+  SchedulingSliceCountersManager& operator=(
+      const SchedulingSliceCountersManager&) = delete;
+
+  SchedulingSliceCountersManager(SchedulingSliceCountersManager&&) = default;
+  SchedulingSliceCountersManager& operator=(SchedulingSliceCountersManager&&) =
+      default;
+
+  // Returns nullopt for the first sched_switch on a core, and when the count
+  // of sched_switches shows that records were lost since the last one, as the
+  // counters would then span several threads.
+  std::optional<SchedulingSliceCounters> ProcessSchedSwitch(
+      pid_t pid, pid_t tid, uint16_t core, uint64_t timestamp_ns,
+      const SchedSwitchCounters& counters);
+
+  void Reset(size_t core_count) {
+    last_sched_switches_by_core_.assign(core_count, std::nullopt);
+  }
+
+ private:
+  struct LastSchedSwitch {
+    uint64_t timestamp_ns;
+    SchedSwitchCounters counters;
+  };
+
+  std::vector<std::optional<LastSchedSwitch>> last_sched_switches_by_core_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_SCHEDULING_SLICE_COUNTERS_MANAGER_H_
@@ -0,0 +1,83 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "SchedulingSliceCountersManager.h"
+
+namespace LinuxTracing {
+
+namespace {
+constexpr pid_t kPid = 42;
+constexpr pid_t kTid = 43;
+constexpr pid_t kOtherTid = 44;
+}  // namespace
+
+TEST(SchedulingSliceCountersManager, OneCore) {
+  constexpr uint16_t kCore = 1;
+  SchedulingSliceCountersManager manager;
+
+  EXPECT_FALSE(manager
+                   .ProcessSchedSwitch(kPid, kOtherTid, kCore, 100,
+                                       {10, 1000, 2000, 30, 40})
+                   .has_value());
+
+  std::optional<SchedulingSliceCounters> slice_counters =
+      manager.ProcessSchedSwitch(kPid, kTid, kCore, 150,
+                                 {11, 1500, 2750, 32, 45});
+  ASSERT_TRUE(slice_counters.has_value());
+  EXPECT_EQ(slice_counters->pid(), kPid);
+  EXPECT_EQ(slice_counters->tid(), kTid);
+  EXPECT_EQ(slice_counters->core(), kCore);
+  EXPECT_EQ(slice_counters->in_timestamp_ns(), 100);
+  EXPECT_EQ(slice_counters->out_timestamp_ns(), 150);
+  EXPECT_EQ(slice_counters->cycles(), 500);
+  EXPECT_EQ(slice_counters->instructions(), 750);
+  EXPECT_EQ(slice_counters->cache_misses(), 2);
+  EXPECT_EQ(slice_counters->branch_misses(), 5);
+
+  slice_counters = manager.ProcessSchedSwitch(kPid, kOtherTid, kCore, 170,
+                                              {12, 1600, 2800, 32, 45});
+  ASSERT_TRUE(slice_counters.has_value());
+  EXPECT_EQ(slice_counters->tid(), kOtherTid);
+  EXPECT_EQ(slice_counters->in_timestamp_ns(), 150);
+  EXPECT_EQ(slice_counters->cycles(), 100);
+}
+
+TEST(SchedulingSliceCountersManager, LostSchedSwitch) {
+  constexpr uint16_t kCore = 0;
+  SchedulingSliceCountersManager manager;
+
+  manager.ProcessSchedSwitch(kPid, kOtherTid, kCore, 100,
+                             {10, 1000, 2000, 30, 40});
+  EXPECT_FALSE(manager
+                   .ProcessSchedSwitch(kPid, kTid, kCore, 150,
+                                       {12, 1500, 2750, 32, 45})
+                   .has_value());
+  EXPECT_TRUE(manager
+                  .ProcessSchedSwitch(kPid, kTid, kCore, 200,
+                                      {13, 1600, 2800, 32, 45})
+                  .has_value());
+}
+
+TEST(SchedulingSliceCountersManager, CoresAreIndependent) {
+  SchedulingSliceCountersManager manager;
+  manager.Reset(2);
+
+  manager.ProcessSchedSwitch(kPid, kOtherTid, 0, 100, {10, 1000, 0, 0, 0});
+  EXPECT_FALSE(manager.ProcessSchedSwitch(kPid, kTid, 1, 110, {5, 0, 0, 0, 0})
+                   .has_value());
+
+  std::optional<SchedulingSliceCounters> slice_counters =
+      manager.ProcessSchedSwitch(kPid, kTid, 0, 120, {11, 1200, 0, 0, 0});
+  ASSERT_TRUE(slice_counters.has_value());
+  EXPECT_EQ(slice_counters->core(), 0);
+  EXPECT_EQ(slice_counters->cycles(), 200);
+
+  manager.Reset(2);
+  EXPECT_FALSE(manager.ProcessSchedSwitch(kPid, kTid, 0, 130, {12, 0, 0, 0, 0})
+                   .has_value());
+}
+
+}  // namespace LinuxTracing
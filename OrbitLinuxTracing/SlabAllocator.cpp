@@ -0,0 +1,124 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "SlabAllocator.h"
+
+#include <algorithm>
+
+#include "OrbitBase/MakeUniqueForOverwrite.h"
+
+namespace LinuxTracing {
+
+namespace {
+struct SlabAllocatorRegistry {
+  absl::Mutex mutex;
+  std::vector<SlabAllocator*> slab_allocators;
+};
+
+SlabAllocatorRegistry& GetSlabAllocatorRegistry() {
+  // Intentionally leaked, like the SlabAllocators of SlabAllocated.
+  static auto* registry = new SlabAllocatorRegistry{};
+  return *registry;
+}
+
+size_t ComputeBlockSize(size_t size) {
+  // Blocks need to be able to hold a pointer to the next free block, and to be
+  // aligned like memory returned by new.
+  constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+  size = std::max(size, sizeof(void*));
+  return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+}  // namespace
+
+SlabAllocator::SlabAllocator(size_t block_size, size_t blocks_per_slab)
+    : block_size_{ComputeBlockSize(block_size)},
+      blocks_per_slab_{blocks_per_slab} {
+  CHECK(blocks_per_slab_ > 0);
+  SlabAllocatorRegistry& registry = GetSlabAllocatorRegistry();
+  absl::MutexLock lock{&registry.mutex};
+  registry.slab_allocators.push_back(this);
+}
+
+SlabAllocator::~SlabAllocator() {
+  SlabAllocatorRegistry& registry = GetSlabAllocatorRegistry();
+  absl::MutexLock lock{&registry.mutex};
+  registry.slab_allocators.erase(std::find(registry.slab_allocators.begin(),
+                                           registry.slab_allocators.end(),
+                                           this));
+}
+
+void* SlabAllocator::Allocate() {
+  absl::MutexLock lock{&mutex_};
+  if (free_blocks_ == nullptr) {
+    // Allocate a new slab and thread all of its blocks into the free list.
+    auto slab =
+        make_unique_for_overwrite<char[]>(block_size_ * blocks_per_slab_);
+    for (size_t i = 0; i < blocks_per_slab_; ++i) {
+      auto* free_block = reinterpret_cast<FreeBlock*>(&slab[i * block_size_]);
+      free_block->next = free_blocks_;
+      free_blocks_ = free_block;
+    }
+    slabs_.emplace_back(std::move(slab));
+    ++slab_allocation_count_;
+  }
+  FreeBlock* block = free_blocks_;
+  free_blocks_ = block->next;
+  ++blocks_in_use_count_;
+  return block;
+}
+
+void SlabAllocator::Deallocate(void* block) {
+  if (block == nullptr) {
+    return;
+  }
+  absl::MutexLock lock{&mutex_};
+  auto* free_block = static_cast<FreeBlock*>(block);
+  free_block->next = free_blocks_;
+  free_blocks_ = free_block;
+  --blocks_in_use_count_;
+}
+
+void SlabAllocator::ReleaseMemoryIfUnused() {
+  absl::MutexLock lock{&mutex_};
+  if (blocks_in_use_count_ > 0) {
+    return;
+  }
+  free_blocks_ = nullptr;
+  slabs_.clear();
+}
+
+uint64_t SlabAllocator::GetBlocksInUseCount() {
+  absl::MutexLock lock{&mutex_};
+  return blocks_in_use_count_;
+}
+
+uint64_t SlabAllocator::GetTotalSlabAllocationCount() {
+  SlabAllocatorRegistry& registry = GetSlabAllocatorRegistry();
+  absl::MutexLock lock{&registry.mutex};
+  uint64_t total_slab_allocation_count = 0;
+  for (SlabAllocator* slab_allocator : registry.slab_allocators) {
+    total_slab_allocation_count += slab_allocator->GetSlabAllocationCount();
+  }
+  return total_slab_allocation_count;
+}
+
+uint64_t SlabAllocator::GetTotalBlocksInUseCount() {
+  SlabAllocatorRegistry& registry = GetSlabAllocatorRegistry();
+  absl::MutexLock lock{&registry.mutex};
+  uint64_t total_blocks_in_use_count = 0;
+  for (SlabAllocator* slab_allocator : registry.slab_allocators) {
+    total_blocks_in_use_count += slab_allocator->GetBlocksInUseCount();
+  }
+  return total_blocks_in_use_count;
+}
+
+void SlabAllocator::ReleaseAllMemoryIfUnused() {
+  SlabAllocatorRegistry& registry = GetSlabAllocatorRegistry();
+  absl::MutexLock lock{&registry.mutex};
+  for (SlabAllocator* slab_allocator : registry.slab_allocators) {
+    slab_allocator->ReleaseMemoryIfUnused();
+  }
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,95 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_SLAB_ALLOCATOR_H_
+#define ORBIT_LINUX_TRACING_SLAB_ALLOCATOR_H_
+
+#include <OrbitBase/Logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace LinuxTracing {
+
+// SlabAllocator hands out blocks of memory of a fixed size, carved out of
+// larger slabs. Blocks that are freed are recycled for later allocations
+// instead of being returned to malloc, so that, once the number of blocks in
+// use has reached its steady state, no more memory is allocated.
+// Slabs are only released by ReleaseMemoryIfUnused, when no block is in use.
+// All methods are thread safe.
+class SlabAllocator {
+ public:
+  SlabAllocator(size_t block_size, size_t blocks_per_slab);
+  ~SlabAllocator();
+
+  SlabAllocator(const SlabAllocator&) = delete;
+  SlabAllocator& operator=(const SlabAllocator&) = delete;
+  SlabAllocator(SlabAllocator&&) = delete;
+  SlabAllocator& operator=(SlabAllocator&&) = delete;
+
+  void* Allocate();
+  void Deallocate(void* block);
+  void ReleaseMemoryIfUnused();
+
+  [[nodiscard]] size_t GetBlockSize() const { return block_size_; }
+  // Number of slabs allocated since the creation of this allocator.
+  [[nodiscard]] uint64_t GetSlabAllocationCount() const {
+    return slab_allocation_count_;
+  }
+  [[nodiscard]] uint64_t GetBlocksInUseCount();
+
+  // The following apply to all the SlabAllocators created.
+  [[nodiscard]] static uint64_t GetTotalSlabAllocationCount();
+  [[nodiscard]] static uint64_t GetTotalBlocksInUseCount();
+  static void ReleaseAllMemoryIfUnused();
+
+ private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  const size_t block_size_;
+  const size_t blocks_per_slab_;
+
+  absl::Mutex mutex_;
+  std::vector<std::unique_ptr<char[]>> slabs_;
+  FreeBlock* free_blocks_ = nullptr;
+  uint64_t blocks_in_use_count_ = 0;
+  std::atomic<uint64_t> slab_allocation_count_ = 0;
+};
+
+// Deriving a class T from SlabAllocated<T> makes new and delete of T use a
+// SlabAllocator shared by all the objects of type T. This also applies when
+// the objects are deleted through a pointer to a base class with a virtual
+// destructor. Classes derived from T must not be allocated with new.
+template <typename T>
+class SlabAllocated {
+ public:
+  static void* operator new(size_t size) {
+    CHECK(size == sizeof(T));
+    return GetSlabAllocator().Allocate();
+  }
+
+  static void operator delete(void* ptr) { GetSlabAllocator().Deallocate(ptr); }
+
+  static SlabAllocator& GetSlabAllocator() {
+    // Intentionally leaked, so that it outlives all objects of type T.
+    static SlabAllocator* slab_allocator = new SlabAllocator{
+        sizeof(T), std::max<size_t>(SLAB_SIZE / sizeof(T), 1)};
+    return *slab_allocator;
+  }
+
+ private:
+  static constexpr size_t SLAB_SIZE = 64 * 1024;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_SLAB_ALLOCATOR_H_
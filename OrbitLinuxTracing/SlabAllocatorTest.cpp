@@ -0,0 +1,106 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "SlabAllocator.h"
+
+namespace LinuxTracing {
+
+TEST(SlabAllocator, RecyclesBlocks) {
+  SlabAllocator slab_allocator{24, 4};
+  EXPECT_EQ(slab_allocator.GetBlockSize() % alignof(std::max_align_t), 0);
+
+  void* first = slab_allocator.Allocate();
+  void* second = slab_allocator.Allocate();
+  EXPECT_NE(first, second);
+  EXPECT_EQ(slab_allocator.GetBlocksInUseCount(), 2);
+  EXPECT_EQ(slab_allocator.GetSlabAllocationCount(), 1);
+
+  slab_allocator.Deallocate(first);
+  EXPECT_EQ(slab_allocator.GetBlocksInUseCount(), 1);
+  EXPECT_EQ(slab_allocator.Allocate(), first);
+  EXPECT_EQ(slab_allocator.GetSlabAllocationCount(), 1);
+
+  slab_allocator.Deallocate(first);
+  slab_allocator.Deallocate(second);
+}
+
+TEST(SlabAllocator, AllocatesNewSlabsWhenFull) {
+  SlabAllocator slab_allocator{64, 4};
+  std::vector<void*> blocks;
+  for (int i = 0; i < 10; ++i) {
+    blocks.push_back(slab_allocator.Allocate());
+  }
+  EXPECT_EQ(slab_allocator.GetSlabAllocationCount(), 3);
+  EXPECT_EQ(std::set<void*>(blocks.begin(), blocks.end()).size(),
+            blocks.size());
+
+  // In the steady state, no more slabs are allocated.
+  for (int iteration = 0; iteration < 100; ++iteration) {
+    for (void* block : blocks) {
+      slab_allocator.Deallocate(block);
+    }
+    for (void*& block : blocks) {
+      block = slab_allocator.Allocate();
+    }
+  }
+  EXPECT_EQ(slab_allocator.GetSlabAllocationCount(), 3);
+
+  for (void* block : blocks) {
+    slab_allocator.Deallocate(block);
+  }
+}
+
+TEST(SlabAllocator, ReleaseMemoryOnlyIfUnused) {
+  SlabAllocator slab_allocator{64, 4};
+  void* block = slab_allocator.Allocate();
+  slab_allocator.ReleaseMemoryIfUnused();
+  EXPECT_EQ(slab_allocator.GetBlocksInUseCount(), 1);
+  // The slab is still there.
+  void* other_block = slab_allocator.Allocate();
+  EXPECT_EQ(slab_allocator.GetSlabAllocationCount(), 1);
+
+  slab_allocator.Deallocate(block);
+  slab_allocator.Deallocate(other_block);
+  slab_allocator.ReleaseMemoryIfUnused();
+  void* new_block = slab_allocator.Allocate();
+  EXPECT_EQ(slab_allocator.GetSlabAllocationCount(), 2);
+  slab_allocator.Deallocate(new_block);
+}
+
+namespace {
+class Base {
+ public:
+  virtual ~Base() = default;
+};
+
+class Derived : public Base, public SlabAllocated<Derived> {
+ public:
+  explicit Derived(uint64_t value) : value_{value} {}
+  [[nodiscard]] uint64_t GetValue() const { return value_; }
+
+ private:
+  uint64_t value_;
+};
+}  // namespace
+
+TEST(SlabAllocated, NewAndDeleteThroughBase) {
+  SlabAllocator& slab_allocator = SlabAllocated<Derived>::GetSlabAllocator();
+  uint64_t blocks_in_use_count = slab_allocator.GetBlocksInUseCount();
+  {
+    auto derived = std::make_unique<Derived>(42);
+    EXPECT_EQ(derived->GetValue(), 42);
+    EXPECT_EQ(slab_allocator.GetBlocksInUseCount(), blocks_in_use_count + 1);
+    std::unique_ptr<Base> base = std::move(derived);
+  }
+  EXPECT_EQ(slab_allocator.GetBlocksInUseCount(), blocks_in_use_count);
+}
+
+}  // namespace LinuxTracing
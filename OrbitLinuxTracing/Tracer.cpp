@@ -5,16 +5,43 @@
 #include <OrbitBase/Logging.h>
 #include <OrbitLinuxTracing/Tracer.h>
 
+#include "BatchQueue.h"
 #include "TracerThread.h"
 
 namespace LinuxTracing {
 
-void Tracer::Run(const CaptureOptions& capture_options,
-                 TracerListener* listener,
-                 const std::shared_ptr<std::atomic<bool>>& exit_requested) {
+void Tracer::Start() {
+  *exit_requested_ = false;
+  instrumented_functions_updates_ =
+      std::make_shared<BatchQueue<InstrumentedFunctionsUpdate>>(
+          MAX_QUEUED_INSTRUMENTED_FUNCTIONS_UPDATE_COUNT);
+  thread_ = std::make_shared<std::thread>(&Tracer::Run, capture_options_,
+                                          elf_cache_, kernel_symbols_,
+                                          listener_,
+                                          exit_requested_,
+                                          instrumented_functions_updates_);
+}
+
+void Tracer::UpdateInstrumentedFunctions(InstrumentedFunctionsUpdate update) {
+  if (instrumented_functions_updates_ == nullptr) {
+    ERROR("Updating the instrumented functions of a capture not started");
+    return;
+  }
+  instrumented_functions_updates_->Push(std::move(update));
+}
+
+void Tracer::Run(
+    const CaptureOptions& capture_options,
+    const std::shared_ptr<ElfCache>& elf_cache,
+    const std::shared_ptr<KernelSymbols>& kernel_symbols,
+    TracerListener* listener,
+    const std::shared_ptr<std::atomic<bool>>& exit_requested,
+    const std::shared_ptr<BatchQueue<InstrumentedFunctionsUpdate>>&
+        instrumented_functions_updates) {
   pthread_setname_np(pthread_self(), "Tracer::Run");
-  TracerThread session{capture_options};
+  TracerThread session{capture_options, elf_cache, kernel_symbols};
   session.SetListener(listener);
+  session.SetInstrumentedFunctionsUpdates(instrumented_functions_updates);
   session.Run(exit_requested);
 }
 
@@ -4,41 +4,181 @@
 
 #include "TracerThread.h"
 
+#include <ElfUtils/ElfFile.h>
 #include <OrbitBase/Logging.h>
+#include <OrbitBase/SafeStrerror.h>
 #include <OrbitBase/Tracing.h>
-
+#include <OrbitLinuxTracing/OrbitTracing.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <string>
 #include <thread>
 
+#include "ManualInstrumentationReader.h"
+#include "OrbitBase/ThreadPool.h"
+#include "PerfRecordViews.h"
 #include "UprobesUnwindingVisitor.h"
+#include "VulkanLayerReader.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "absl/time/time.h"
 
 namespace LinuxTracing {
 
-TracerThread::TracerThread(const CaptureOptions& capture_options)
+TracerThread::TracerThread(const CaptureOptions& capture_options,
+                           std::shared_ptr<ElfCache> elf_cache,
+                           std::shared_ptr<KernelSymbols> kernel_symbols)
     : trace_context_switches_{capture_options.trace_context_switches()},
-      pid_{capture_options.pid()},
+      trace_performance_counters_{
+          capture_options.trace_performance_counters()},
+      sample_all_processes_{capture_options.sample_all_processes()},
+      auto_ring_buffer_sizes_{capture_options.auto_ring_buffer_sizes()},
+      ring_buffer_sizes_kb_{ComputeRingBufferSizesKb(capture_options)},
+      flight_recorder_{capture_options.flight_recorder()},
+      flight_recorder_window_ms_{
+          capture_options.flight_recorder_window_ms() == 0
+              ? DEFAULT_FLIGHT_RECORDER_WINDOW_MS
+              : capture_options.flight_recorder_window_ms()},
+      capture_statistics_{capture_options.capture_statistics()},
+      introspection_{capture_options.introspection() &&
+                     !capture_options.flight_recorder()},
+      manual_instrumentation_shared_memory_{
+          capture_options.manual_instrumentation_shared_memory() &&
+          !capture_options.flight_recorder()},
+      trace_vulkan_layer_{capture_options.trace_vulkan_layer() &&
+                          !capture_options.flight_recorder()},
+      perf_recording_path_{capture_options.flight_recorder()
+                               ? ""
+                               : capture_options.perf_recording_path()},
       unwinding_method_{capture_options.unwinding_method()},
-      trace_gpu_driver_{capture_options.trace_gpu_driver()} {
+      frame_pointer_safe_module_paths_{
+          capture_options.frame_pointer_safe_module_paths().begin(),
+          capture_options.frame_pointer_safe_module_paths().end()},
+      trace_gpu_driver_{capture_options.trace_gpu_driver()},
+      trace_thread_state_{capture_options.trace_thread_state()},
+      trace_off_cpu_{capture_options.trace_off_cpu()},
+      trace_lock_contention_{capture_options.trace_lock_contention() &&
+                             !capture_options.flight_recorder()},
+      min_lock_wait_duration_ns_{capture_options.min_lock_wait_duration_ns()},
+      trace_allocations_{capture_options.trace_allocations() &&
+                         !capture_options.flight_recorder()},
+      trace_syscalls_{capture_options.trace_syscalls() &&
+                      !capture_options.flight_recorder()},
+      syscall_filter_{ComputeSyscallFilter(capture_options.syscall_filter())},
+      min_syscall_duration_ns_{capture_options.min_syscall_duration_ns()},
+      trace_block_io_{capture_options.trace_block_io() &&
+                      !capture_options.flight_recorder()},
+      trace_cpu_power_states_{capture_options.trace_cpu_power_states() &&
+                              !capture_options.flight_recorder()},
+      trace_page_faults_{capture_options.trace_page_faults() &&
+                         !capture_options.flight_recorder()},
+      minor_page_fault_sampling_period_{
+          capture_options.minor_page_fault_sampling_period()},
+      ring_buffer_wakeups_{capture_options.ring_buffer_wakeups()},
+      ring_buffer_reader_thread_count_{
+          capture_options.ring_buffer_reader_thread_count()},
+      pin_ring_buffer_reader_threads_{
+          capture_options.pin_ring_buffer_reader_threads()},
+      pin_service_threads_{capture_options.pin_service_threads()},
+      service_cpus_{capture_options.service_cpus()},
+      unwinding_thread_count_{std::min(capture_options.unwinding_thread_count(),
+                                       MAX_UNWINDING_THREAD_COUNT)},
+      elf_cache_{std::move(elf_cache)},
+      stack_dump_size_{ComputeStackDumpSize(
+          capture_options.stack_dump_size(),
+          capture_options.unwinding_method())},
+      allocation_sampler_{
+          capture_options.allocation_sampling_interval_bytes() == 0
+              ? DEFAULT_ALLOCATION_SAMPLING_INTERVAL_BYTES
+              : capture_options.allocation_sampling_interval_bytes()} {
+  pids_.push_back(capture_options.pid());
+  for (pid_t additional_pid : capture_options.additional_pids()) {
+    if (!IsCapturedPid(additional_pid)) {
+      pids_.push_back(additional_pid);
+    }
+  }
+
+  if (sample_all_processes_ &&
+      unwinding_method_ != CaptureOptions::kFramePointers) {
+    ERROR("Sampling all processes requires frame pointer unwinding");
+    sample_all_processes_ = false;
+  }
+
+  // The flight recorder only records the events that can be written backward
+  // to overwrite ring buffers and that make sense without their beginning, as
+  // opposed to, e.g., uprobes without the matching uretprobes.
+  if (flight_recorder_) {
+    if (unwinding_method_ != CaptureOptions::kUndefined &&
+        unwinding_method_ != CaptureOptions::kFramePointers) {
+      ERROR("The flight recorder only supports frame pointer unwinding");
+      unwinding_method_ = CaptureOptions::kUndefined;
+    }
+    if (trace_performance_counters_ || trace_gpu_driver_ ||
+        trace_thread_state_) {
+      ERROR("The flight recorder doesn't support performance counters, GPU "
+            "tracing and thread states");
+    }
+    trace_performance_counters_ = false;
+    trace_gpu_driver_ = false;
+    trace_thread_state_ = false;
+    ring_buffer_wakeups_ = false;
+  }
+
+  if (flight_recorder_ && !capture_options.perf_recording_path().empty()) {
+    ERROR("The flight recorder doesn't support perf recordings");
+  }
+  if (!perf_recording_path_.empty()) {
+    perf_recording_capture_options_ = capture_options;
+    perf_recording_capture_options_.clear_perf_recording_path();
+  }
+
+  if (trace_off_cpu_ && (!trace_context_switches_ || flight_recorder_)) {
+    ERROR("Off-CPU profiling requires context switches, without the flight "
+          "recorder");
+    trace_off_cpu_ = false;
+  }
+
   if (unwinding_method_ != CaptureOptions::kUndefined) {
-    std::optional<uint64_t> sampling_period_ns =
-        ComputeSamplingPeriodNs(capture_options.sampling_rate());
-    FAIL_IF(!sampling_period_ns.has_value(), "Invalid sampling rate: %.1f",
-            capture_options.sampling_rate());
-    sampling_period_ns_ = sampling_period_ns.value();
-  } else {
-    sampling_period_ns_ = 0;
+    InitSamplingConfigurations(capture_options);
+    if (capture_options.kernel_callchains() &&
+        unwinding_method_ == CaptureOptions::kDwarf) {
+      ERROR("Kernel callchains are not supported with DWARF unwinding");
+    } else if (capture_options.kernel_callchains()) {
+      for (SamplingConfiguration& configuration : sampling_configurations_) {
+        configuration.event.kernel_callchain = true;
+      }
+      kernel_symbols_ = std::move(kernel_symbols);
+    }
+    if (unwinding_method_ == CaptureOptions::kDwarf &&
+        capture_options.adaptive_stack_dump()) {
+      used_stack_size_tracker_ = std::make_shared<UsedStackSizeTracker>();
+    }
   }
 
   instrumented_functions_.clear();
+  if (flight_recorder_ && capture_options.instrumented_functions_size() > 0) {
+    ERROR("The flight recorder doesn't support dynamic instrumentation");
+    return;
+  }
   instrumented_functions_.reserve(
       capture_options.instrumented_functions_size());
 
   for (const CaptureOptions::InstrumentedFunction& instrumented_function :
        capture_options.instrumented_functions()) {
+    std::optional<Function> function = CreateFunction(instrumented_function);
+    if (!function.has_value()) {
+      continue;
+    }
+    instrumented_functions_.push_back(std::move(function.value()));
     uint64_t absolute_address = instrumented_function.absolute_address();
-    instrumented_functions_.emplace_back(instrumented_function.file_path(),
-                                         instrumented_function.file_offset(),
-                                         absolute_address);
 
     // Manual instrumentation.
     if (instrumented_function.function_type() ==
@@ -47,6 +187,187 @@ TracerThread::TracerThread(const CaptureOptions& capture_options)
     } else if (instrumented_function.function_type() ==
                CaptureOptions_InstrumentedFunction::kTimerStop) {
       manual_instrumentation_config_.AddTimerStopAddress(absolute_address);
+    } else if (instrumented_function.function_type() ==
+               CaptureOptions_InstrumentedFunction::kTimerStartAsync) {
+      manual_instrumentation_config_.AddTimerStartAsyncAddress(
+          absolute_address);
+    } else if (instrumented_function.function_type() ==
+               CaptureOptions_InstrumentedFunction::kTimerStopAsync) {
+      manual_instrumentation_config_.AddTimerStopAsyncAddress(absolute_address);
+    } else if (instrumented_function.function_type() ==
+               CaptureOptions_InstrumentedFunction::kFrameMarker) {
+      manual_instrumentation_config_.AddFrameMarkerAddress(absolute_address);
+    }
+  }
+
+  if (capture_options.max_instrumented_function_call_rate() > 0 &&
+      !instrumented_functions_.empty()) {
+    instrumentation_governor_ = std::make_unique<InstrumentationGovernor>(
+        instrumented_functions_.size(),
+        capture_options.max_instrumented_function_call_rate());
+  }
+
+  // The sampling events it opens would be missing from the header of the perf
+  // recording.
+  if (capture_options.max_service_cpu_usage() > 0 &&
+      !perf_recording_path_.empty()) {
+    ERROR("The CPU budget is not supported with perf recordings");
+  } else if (capture_options.max_service_cpu_usage() > 0) {
+    cpu_budget_governor_ = std::make_unique<CpuBudgetGovernor>(
+        capture_options.max_service_cpu_usage(),
+        !sampling_configurations_.empty(),
+        unwinding_method_ == CaptureOptions::kDwarf ||
+            unwinding_method_ == CaptureOptions::kHybrid,
+        !instrumented_functions_.empty());
+    if (!instrumented_functions_.empty()) {
+      // All the functions called during a window.
+      cpu_budget_call_counter_ = std::make_unique<InstrumentationGovernor>(
+          instrumented_functions_.size(), /*max_calls_per_second=*/0);
+    }
+  }
+}
+
+std::optional<Function> TracerThread::CreateFunction(
+    const CaptureOptions::InstrumentedFunction& instrumented_function) const {
+  uint64_t absolute_address = instrumented_function.absolute_address();
+  // Aggregated calls only need the timestamps, so don't make their uprobes
+  // and uretprobes records larger by sampling registers.
+  bool aggregate_calls = instrumented_function.aggregate_calls();
+  uint32_t recorded_argument_count =
+      std::min(instrumented_function.recorded_argument_count(),
+               MAX_RECORDED_ARGUMENT_COUNT);
+  if (aggregate_calls) {
+    recorded_argument_count = 0;
+  }
+  // The arguments of orbit_api::StartAsync(name, id), StopAsync(id) and
+  // FrameMarker(name).
+  if (instrumented_function.function_type() ==
+      CaptureOptions_InstrumentedFunction::kTimerStartAsync) {
+    aggregate_calls = false;
+    recorded_argument_count = 2;
+  } else if (instrumented_function.function_type() ==
+                 CaptureOptions_InstrumentedFunction::kTimerStopAsync ||
+             instrumented_function.function_type() ==
+                 CaptureOptions_InstrumentedFunction::kFrameMarker) {
+    aggregate_calls = false;
+    recorded_argument_count = 1;
+  }
+  bool record_return_value =
+      !aggregate_calls && instrumented_function.record_return_value();
+  // Aggregated calls are all counted anyway, and the uprobes of manual
+  // instrumentation functions must all be matched.
+  uint32_t sampling_ratio =
+      std::max(instrumented_function.sampling_ratio(), 1u);
+  if (aggregate_calls || instrumented_function.function_type() !=
+                             CaptureOptions_InstrumentedFunction::kRegular) {
+    sampling_ratio = 1;
+  }
+  pid_t function_pid =
+      instrumented_function.pid() == 0 ? pids_[0] : instrumented_function.pid();
+  if (!IsCapturedPid(function_pid)) {
+    ERROR("Ignoring function 0x%lx of process %d, which is not captured",
+          absolute_address, function_pid);
+    return std::nullopt;
+  }
+  return Function{function_pid,
+                  instrumented_function.file_path(),
+                  instrumented_function.file_offset(),
+                  absolute_address,
+                  recorded_argument_count,
+                  record_return_value,
+                  aggregate_calls,
+                  sampling_ratio};
+}
+
+RingBufferSizesKb TracerThread::ComputeRingBufferSizesKb(
+    const CaptureOptions& capture_options) {
+  if (capture_options.auto_ring_buffer_sizes()) {
+    return GetRingBufferSizeTuner().GetSizesKb();
+  }
+
+  const CaptureOptions::RingBufferSizes& requested_sizes =
+      capture_options.ring_buffer_sizes();
+  RingBufferSizesKb requested_sizes_kb;
+  requested_sizes_kb[static_cast<size_t>(RingBufferClass::kContextSwitches)] =
+      requested_sizes.context_switches_kb();
+  requested_sizes_kb[static_cast<size_t>(RingBufferClass::kUprobes)] =
+      requested_sizes.uprobes_kb();
+  requested_sizes_kb[static_cast<size_t>(RingBufferClass::kMmapTask)] =
+      requested_sizes.mmap_task_kb();
+  requested_sizes_kb[static_cast<size_t>(RingBufferClass::kSampling)] =
+      requested_sizes.sampling_kb();
+  requested_sizes_kb[static_cast<size_t>(RingBufferClass::kTracepoints)] =
+      requested_sizes.tracepoints_kb();
+  requested_sizes_kb[static_cast<size_t>(RingBufferClass::kGpuTracing)] =
+      requested_sizes.gpu_tracing_kb();
+  requested_sizes_kb[static_cast<size_t>(
+      RingBufferClass::kSchedSwitchCounters)] =
+      requested_sizes.sched_switch_counters_kb();
+
+  RingBufferSizesKb sizes_kb;
+  for (size_t i = 0; i < RING_BUFFER_CLASS_COUNT; ++i) {
+    sizes_kb[i] = requested_sizes_kb[i] == 0
+                      ? DEFAULT_RING_BUFFER_SIZES_KB[i]
+                      : RoundUpRingBufferSizeKb(requested_sizes_kb[i]);
+  }
+  return sizes_kb;
+}
+
+RingBufferSizeTuner& TracerThread::GetRingBufferSizeTuner() {
+  // Intentionally leaked, as it is shared by all the captures.
+  static RingBufferSizeTuner* tuner =
+      new RingBufferSizeTuner{DEFAULT_RING_BUFFER_SIZES_KB};
+  return *tuner;
+}
+
+void TracerThread::AddRingBufferFd(int ring_buffer_fd, int32_t cpu,
+                                   RingBufferClass ring_buffer_class) {
+  cpu_per_ring_buffer_fd_[ring_buffer_fd] = cpu;
+  ring_buffer_class_per_fd_[ring_buffer_fd] = ring_buffer_class;
+}
+
+void TracerThread::InitSamplingConfigurations(
+    const CaptureOptions& capture_options) {
+  if (capture_options.sampling_configurations().empty()) {
+    std::optional<uint64_t> sampling_period_ns =
+        ComputeSamplingPeriodNs(capture_options.sampling_rate());
+    FAIL_IF(!sampling_period_ns.has_value(), "Invalid sampling rate: %.1f",
+            capture_options.sampling_rate());
+    SamplingConfiguration& configuration =
+        sampling_configurations_.emplace_back();
+    configuration.event.period = sampling_period_ns.value();
+    return;
+  }
+
+  for (const CaptureOptions::SamplingConfiguration& requested_configuration :
+       capture_options.sampling_configurations()) {
+    std::optional<SamplingEvent> sampling_event =
+        ComputeSamplingEvent(requested_configuration);
+    if (!sampling_event.has_value()) {
+      ERROR("Ignoring sampling configuration with event type %d and period %lu",
+            requested_configuration.event_type(),
+            requested_configuration.period());
+      continue;
+    }
+    SamplingConfiguration& configuration =
+        sampling_configurations_.emplace_back();
+    configuration.event = sampling_event.value();
+    configuration.tids.assign(requested_configuration.tids().begin(),
+                              requested_configuration.tids().end());
+  }
+
+  // The threads sampled specifically on an event are not sampled again on the
+  // same event as part of all the threads.
+  for (SamplingConfiguration& all_threads : sampling_configurations_) {
+    if (!all_threads.tids.empty()) {
+      continue;
+    }
+    for (const SamplingConfiguration& some_threads : sampling_configurations_) {
+      if (some_threads.event.type == all_threads.event.type &&
+          some_threads.event.config == all_threads.event.config) {
+        all_threads.excluded_tids.insert(some_threads.tids.begin(),
+                                         some_threads.tids.end());
+      }
     }
   }
 }
@@ -64,17 +385,52 @@ void CloseFileDescriptors(
     close(pair.second);
   }
 }
+
+// Disabling and closing the file descriptors of uprobes and uretprobes is
+// slow, and with many instrumented functions there are thousands of them.
+template <typename Action>
+void RunOnFileDescriptorsInParallel(const std::vector<int>& fds,
+                                    Action action) {
+  constexpr size_t kMinFdsPerThread = 256;
+  size_t max_thread_count =
+      std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  size_t thread_count =
+      std::min<size_t>(fds.size() / kMinFdsPerThread, max_thread_count);
+  if (thread_count <= 1) {
+    for (int fd : fds) {
+      action(fd);
+    }
+    return;
+  }
+
+  std::vector<std::thread> threads;
+  for (size_t thread_index = 0; thread_index < thread_count; ++thread_index) {
+    threads.emplace_back([&fds, &action, thread_count, thread_index] {
+      for (size_t i = thread_index; i < fds.size(); i += thread_count) {
+        action(fds[i]);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
 }  // namespace
 
 bool TracerThread::OpenContextSwitches(const std::vector<int32_t>& cpus) {
+  const uint64_t ring_buffer_size_kb =
+      GetRingBufferSizeKb(RingBufferClass::kContextSwitches);
   std::vector<int> context_switch_tracing_fds;
   std::vector<PerfEventRingBuffer> context_switch_ring_buffers;
+  absl::flat_hash_map<int, int32_t> cpu_per_ring_buffer_fd;
   for (int32_t cpu : cpus) {
-    int context_switch_fd = context_switch_event_open(-1, cpu);
+    int context_switch_fd = context_switch_event_open(
+        -1, cpu, ComputeWakeupWatermark(ring_buffer_size_kb), flight_recorder_);
     std::string buffer_name = absl::StrFormat("context_switch_%d", cpu);
     PerfEventRingBuffer context_switch_ring_buffer{
-        context_switch_fd, CONTEXT_SWITCHES_RING_BUFFER_SIZE_KB, buffer_name};
+        context_switch_fd, ring_buffer_size_kb, buffer_name, flight_recorder_};
     if (context_switch_ring_buffer.IsOpen()) {
+      cpu_per_ring_buffer_fd.emplace(context_switch_fd, cpu);
       context_switch_tracing_fds.push_back(context_switch_fd);
       context_switch_ring_buffers.push_back(
           std::move(context_switch_ring_buffer));
@@ -85,61 +441,395 @@ bool TracerThread::OpenContextSwitches(const std::vector<int32_t>& cpus) {
     }
   }
 
+  std::lock_guard<std::mutex> lock(opened_events_mutex_);
   for (int fd : context_switch_tracing_fds) {
     tracing_fds_.push_back(fd);
   }
   for (PerfEventRingBuffer& buffer : context_switch_ring_buffers) {
     ring_buffers_.emplace_back(std::move(buffer));
   }
+  for (const auto [ring_buffer_fd, cpu] : cpu_per_ring_buffer_fd) {
+    AddRingBufferFd(ring_buffer_fd, cpu, RingBufferClass::kContextSwitches);
+  }
   return true;
 }
 
-void TracerThread::InitUprobesEventProcessor() {
-  auto uprobes_unwinding_visitor =
-      std::make_unique<UprobesUnwindingVisitor>(ReadMaps(pid_));
-  uprobes_unwinding_visitor->SetListener(listener_);
-  uprobes_unwinding_visitor->SetUnwindErrorsAndDiscardedSamplesCounters(
-      stats_.unwind_error_count, stats_.discarded_samples_in_uretprobes_count);
-  // Switch between PerfEventProcessor and PerfEventProcessor2 here.
-  // PerfEventProcessor2 is supposedly faster but assumes that events from the
-  // same perf_event_open ring buffer are already sorted.
-  uprobes_event_processor_ = std::make_unique<PerfEventProcessor2>(
-      std::move(uprobes_unwinding_visitor));
+bool TracerThread::OpenSchedSwitchCounters(const std::vector<int32_t>& cpus) {
+  const uint64_t ring_buffer_size_kb =
+      GetRingBufferSizeKb(RingBufferClass::kSchedSwitchCounters);
+  std::vector<int> counters_tracing_fds;
+  std::vector<PerfEventRingBuffer> counters_ring_buffers;
+  std::vector<uint64_t> counters_stream_ids;
+  absl::flat_hash_map<int, int32_t> cpu_per_ring_buffer_fd;
+  for (int32_t cpu : cpus) {
+    int leader_fd = sched_switch_counters_event_open(
+        cpu, ComputeWakeupWatermark(ring_buffer_size_kb));
+    bool counters_open = leader_fd != -1;
+    if (counters_open) {
+      counters_tracing_fds.push_back(leader_fd);
+      for (uint64_t counter : SCHED_SWITCH_HARDWARE_COUNTERS) {
+        int counter_fd = hardware_counter_event_open(counter, cpu, leader_fd);
+        if (counter_fd == -1) {
+          counters_open = false;
+          break;
+        }
+        counters_tracing_fds.push_back(counter_fd);
+      }
+    }
+    if (!counters_open) {
+      ERROR("Opening performance counters for cpu %d", cpu);
+      CloseFileDescriptors(counters_tracing_fds);
+      return false;
+    }
+
+    std::string buffer_name = absl::StrFormat("sched_switch_counters_%d", cpu);
+    PerfEventRingBuffer counters_ring_buffer{
+        leader_fd, ring_buffer_size_kb, buffer_name};
+    if (!counters_ring_buffer.IsOpen()) {
+      ERROR("Opening ring buffer for performance counters for cpu %d", cpu);
+      CloseFileDescriptors(counters_tracing_fds);
+      return false;
+    }
+    cpu_per_ring_buffer_fd.emplace(leader_fd, cpu);
+    counters_ring_buffers.push_back(std::move(counters_ring_buffer));
+    counters_stream_ids.push_back(perf_event_get_id(leader_fd));
+  }
+
+  std::lock_guard<std::mutex> lock(opened_events_mutex_);
+  for (int fd : counters_tracing_fds) {
+    tracing_fds_.push_back(fd);
+  }
+  for (PerfEventRingBuffer& buffer : counters_ring_buffers) {
+    ring_buffers_.emplace_back(std::move(buffer));
+  }
+  for (const auto [ring_buffer_fd, cpu] : cpu_per_ring_buffer_fd) {
+    AddRingBufferFd(ring_buffer_fd, cpu, RingBufferClass::kSchedSwitchCounters);
+  }
+  sched_switch_counters_ids_.insert(counters_stream_ids.begin(),
+                                    counters_stream_ids.end());
+  return true;
 }
 
-bool TracerThread::OpenUprobes(const LinuxTracing::Function& function,
-                               const std::vector<int32_t>& cpus,
-                               absl::flat_hash_map<int32_t, int>* fds_per_cpu) {
-  const char* module = function.BinaryPath().c_str();
-  const uint64_t offset = function.FileOffset();
+bool TracerThread::OpenOffCpuCallchains(const std::vector<int32_t>& cpus) {
+  const uint64_t ring_buffer_size_kb =
+      GetRingBufferSizeKb(RingBufferClass::kSampling);
+  std::vector<int> off_cpu_tracing_fds;
+  std::vector<PerfEventRingBuffer> off_cpu_ring_buffers;
+  std::vector<uint64_t> off_cpu_stream_ids;
+  absl::flat_hash_map<int, int32_t> cpu_per_ring_buffer_fd;
   for (int32_t cpu : cpus) {
-    int fd = uprobes_retaddr_event_open(module, offset, -1, cpu);
-    if (fd < 0) {
-      ERROR("Opening uprobe 0x%lx on cpu %d", function.VirtualAddress(), cpu);
+    int off_cpu_fd = sched_switch_callchain_event_open(
+        cpu, ComputeWakeupWatermark(ring_buffer_size_kb));
+    std::string buffer_name = absl::StrFormat("off_cpu_%d", cpu);
+    PerfEventRingBuffer off_cpu_ring_buffer{off_cpu_fd, ring_buffer_size_kb,
+                                            buffer_name};
+    if (!off_cpu_ring_buffer.IsOpen()) {
+      ERROR("Opening off-CPU callchain events for cpu %d", cpu);
+      if (off_cpu_fd != -1) {
+        off_cpu_tracing_fds.push_back(off_cpu_fd);
+      }
+      CloseFileDescriptors(off_cpu_tracing_fds);
       return false;
     }
-    (*fds_per_cpu)[cpu] = fd;
+    cpu_per_ring_buffer_fd.emplace(off_cpu_fd, cpu);
+    off_cpu_tracing_fds.push_back(off_cpu_fd);
+    off_cpu_ring_buffers.push_back(std::move(off_cpu_ring_buffer));
+    off_cpu_stream_ids.push_back(perf_event_get_id(off_cpu_fd));
+  }
+
+  std::lock_guard<std::mutex> lock(opened_events_mutex_);
+  for (int fd : off_cpu_tracing_fds) {
+    tracing_fds_.push_back(fd);
+  }
+  for (PerfEventRingBuffer& buffer : off_cpu_ring_buffers) {
+    ring_buffers_.emplace_back(std::move(buffer));
+  }
+  for (const auto [ring_buffer_fd, cpu] : cpu_per_ring_buffer_fd) {
+    AddRingBufferFd(ring_buffer_fd, cpu, RingBufferClass::kSampling);
   }
+  off_cpu_callchain_ids_.insert(off_cpu_stream_ids.begin(),
+                                off_cpu_stream_ids.end());
   return true;
 }
 
-bool TracerThread::OpenUretprobes(
-    const LinuxTracing::Function& function, const std::vector<int32_t>& cpus,
-    absl::flat_hash_map<int32_t, int>* fds_per_cpu) {
-  const char* module = function.BinaryPath().c_str();
-  const uint64_t offset = function.FileOffset();
+bool TracerThread::OpenLockContention(const std::vector<int32_t>& cpus) {
+  const uint64_t ring_buffer_size_kb =
+      GetRingBufferSizeKb(RingBufferClass::kTracepoints);
+  const uint32_t wakeup_watermark = ComputeWakeupWatermark(ring_buffer_size_kb);
+  std::vector<int> futex_tracing_fds;
+  std::vector<PerfEventRingBuffer> futex_ring_buffers;
+  std::vector<uint64_t> futex_wait_stream_ids;
+  std::vector<uint64_t> futex_exit_stream_ids;
+  absl::flat_hash_map<int, int32_t> cpu_per_ring_buffer_fd;
   for (int32_t cpu : cpus) {
-    int fd = uretprobes_event_open(module, offset, -1, cpu);
-    if (fd < 0) {
-      ERROR("Opening uretprobe 0x%lx on cpu %d", function.VirtualAddress(),
-            cpu);
+    int enter_fd = tracepoint_callchain_event_open(
+        "syscalls", "sys_enter_futex", cpu, wakeup_watermark);
+    int exit_fd = tracepoint_event_open("syscalls", "sys_exit_futex", -1, cpu,
+                                        wakeup_watermark);
+    for (int fd : {enter_fd, exit_fd}) {
+      if (fd != -1) {
+        futex_tracing_fds.push_back(fd);
+      }
+    }
+    std::string buffer_name = absl::StrFormat("futex_%d", cpu);
+    PerfEventRingBuffer futex_ring_buffer{enter_fd, ring_buffer_size_kb,
+                                          buffer_name};
+    if (exit_fd == -1 || !futex_ring_buffer.IsOpen()) {
+      ERROR("Opening futex tracepoints for cpu %d", cpu);
+      CloseFileDescriptors(futex_tracing_fds);
+      return false;
+    }
+    perf_event_redirect(exit_fd, enter_fd);
+    cpu_per_ring_buffer_fd.emplace(enter_fd, cpu);
+    futex_ring_buffers.push_back(std::move(futex_ring_buffer));
+    futex_wait_stream_ids.push_back(perf_event_get_id(enter_fd));
+    futex_exit_stream_ids.push_back(perf_event_get_id(exit_fd));
+  }
+
+  std::lock_guard<std::mutex> lock(opened_events_mutex_);
+  for (int fd : futex_tracing_fds) {
+    tracing_fds_.push_back(fd);
+  }
+  for (PerfEventRingBuffer& buffer : futex_ring_buffers) {
+    ring_buffers_.emplace_back(std::move(buffer));
+  }
+  for (const auto [ring_buffer_fd, cpu] : cpu_per_ring_buffer_fd) {
+    AddRingBufferFd(ring_buffer_fd, cpu, RingBufferClass::kTracepoints);
+  }
+  futex_wait_ids_.insert(futex_wait_stream_ids.begin(),
+                         futex_wait_stream_ids.end());
+  futex_exit_ids_.insert(futex_exit_stream_ids.begin(),
+                         futex_exit_stream_ids.end());
+  return true;
+}
+
+bool TracerThread::OpenAllocationUprobes(const std::vector<int32_t>& cpus) {
+  std::optional<std::string> module_path;
+  for (pid_t pid : pids_) {
+    module_path = FindMallocModulePath(ReadMaps(pid));
+    if (module_path.has_value()) {
+      break;
+    }
+  }
+  if (!module_path.has_value()) {
+    ERROR("Finding the module of malloc in the target");
+    return false;
+  }
+  auto elf_file = ElfUtils::ElfFile::Create(module_path.value());
+  if (!elf_file) {
+    ERROR("%s", elf_file.error().message());
+    return false;
+  }
+  auto module_symbols = elf_file.value()->LoadSymbols();
+  if (!module_symbols) {
+    ERROR("%s", module_symbols.error().message());
+    return false;
+  }
+  std::optional<uint64_t> malloc_offset;
+  for (const SymbolInfo& symbol_info :
+       module_symbols.value().symbol_infos()) {
+    if (symbol_info.name() == "malloc") {
+      malloc_offset =
+          symbol_info.address() - module_symbols.value().load_bias();
+      break;
+    }
+  }
+  if (!malloc_offset.has_value()) {
+    ERROR("No malloc in \"%s\"", module_path.value());
+    return false;
+  }
+  LOG("Sampling the allocations of malloc in \"%s\"", module_path.value());
+
+  const uint64_t ring_buffer_size_kb =
+      GetRingBufferSizeKb(RingBufferClass::kUprobes);
+  std::vector<int> allocation_tracing_fds;
+  std::vector<PerfEventRingBuffer> allocation_ring_buffers;
+  std::vector<uint64_t> allocation_stream_ids;
+  absl::flat_hash_map<int, int32_t> cpu_per_ring_buffer_fd;
+  for (int32_t cpu : cpus) {
+    int allocation_fd = uprobes_callchain_event_open(
+        module_path.value().c_str(), malloc_offset.value(), -1, cpu,
+        ComputeWakeupWatermark(ring_buffer_size_kb));
+    std::string buffer_name = absl::StrFormat("allocations_%d", cpu);
+    PerfEventRingBuffer allocation_ring_buffer{
+        allocation_fd, ring_buffer_size_kb, buffer_name};
+    if (!allocation_ring_buffer.IsOpen()) {
+      ERROR("Opening the uprobes of malloc for cpu %d", cpu);
+      if (allocation_fd != -1) {
+        allocation_tracing_fds.push_back(allocation_fd);
+      }
+      CloseFileDescriptors(allocation_tracing_fds);
+      return false;
+    }
+    cpu_per_ring_buffer_fd.emplace(allocation_fd, cpu);
+    allocation_tracing_fds.push_back(allocation_fd);
+    allocation_ring_buffers.push_back(std::move(allocation_ring_buffer));
+    allocation_stream_ids.push_back(perf_event_get_id(allocation_fd));
+  }
+
+  std::lock_guard<std::mutex> lock(opened_events_mutex_);
+  for (int fd : allocation_tracing_fds) {
+    tracing_fds_.push_back(fd);
+  }
+  for (PerfEventRingBuffer& buffer : allocation_ring_buffers) {
+    ring_buffers_.emplace_back(std::move(buffer));
+  }
+  for (const auto [ring_buffer_fd, cpu] : cpu_per_ring_buffer_fd) {
+    AddRingBufferFd(ring_buffer_fd, cpu, RingBufferClass::kUprobes);
+  }
+  allocation_ids_.insert(allocation_stream_ids.begin(),
+                         allocation_stream_ids.end());
+  return true;
+}
+
+bool TracerThread::OpenPageFaults(const std::vector<int32_t>& cpus) {
+  const uint64_t ring_buffer_size_kb =
+      GetRingBufferSizeKb(RingBufferClass::kSampling);
+  const uint32_t wakeup_watermark = ComputeWakeupWatermark(ring_buffer_size_kb);
+  SamplingEvent major_fault_event;
+  major_fault_event.config = PERF_COUNT_SW_PAGE_FAULTS_MAJ;
+  major_fault_event.period = 1;
+  SamplingEvent minor_fault_event;
+  minor_fault_event.config = PERF_COUNT_SW_PAGE_FAULTS_MIN;
+  minor_fault_event.period = minor_page_fault_sampling_period_;
+  std::vector<int> page_fault_tracing_fds;
+  std::vector<PerfEventRingBuffer> page_fault_ring_buffers;
+  std::vector<uint64_t> major_stream_ids;
+  std::vector<uint64_t> minor_stream_ids;
+  std::vector<uint64_t> mmap_stream_ids;
+  std::vector<uint64_t> munmap_stream_ids;
+  absl::flat_hash_map<int, int32_t> cpu_per_ring_buffer_fd;
+  for (int32_t cpu : cpus) {
+    int major_fd = callchain_sample_event_open(major_fault_event, -1, cpu,
+                                               wakeup_watermark);
+    int minor_fd = -1;
+    if (minor_page_fault_sampling_period_ > 0) {
+      minor_fd = callchain_sample_event_open(minor_fault_event, -1, cpu,
+                                             wakeup_watermark);
+    }
+    int mmap_fd = tracepoint_event_open("syscalls", "sys_enter_mmap", -1, cpu,
+                                        wakeup_watermark);
+    int munmap_fd = tracepoint_event_open("syscalls", "sys_enter_munmap", -1,
+                                          cpu, wakeup_watermark);
+    for (int fd : {major_fd, minor_fd, mmap_fd, munmap_fd}) {
+      if (fd != -1) {
+        page_fault_tracing_fds.push_back(fd);
+      }
+    }
+    std::string buffer_name = absl::StrFormat("page_faults_%d", cpu);
+    PerfEventRingBuffer page_fault_ring_buffer{major_fd, ring_buffer_size_kb,
+                                               buffer_name};
+    if ((minor_page_fault_sampling_period_ > 0 && minor_fd == -1) ||
+        mmap_fd == -1 || munmap_fd == -1 ||
+        !page_fault_ring_buffer.IsOpen()) {
+      ERROR("Opening page fault events for cpu %d", cpu);
+      CloseFileDescriptors(page_fault_tracing_fds);
       return false;
     }
-    (*fds_per_cpu)[cpu] = fd;
+    for (int fd : {minor_fd, mmap_fd, munmap_fd}) {
+      if (fd != -1) {
+        perf_event_redirect(fd, major_fd);
+      }
+    }
+    cpu_per_ring_buffer_fd.emplace(major_fd, cpu);
+    page_fault_ring_buffers.push_back(std::move(page_fault_ring_buffer));
+    major_stream_ids.push_back(perf_event_get_id(major_fd));
+    if (minor_fd != -1) {
+      minor_stream_ids.push_back(perf_event_get_id(minor_fd));
+    }
+    mmap_stream_ids.push_back(perf_event_get_id(mmap_fd));
+    munmap_stream_ids.push_back(perf_event_get_id(munmap_fd));
+  }
+
+  std::lock_guard<std::mutex> lock(opened_events_mutex_);
+  for (int fd : page_fault_tracing_fds) {
+    tracing_fds_.push_back(fd);
+  }
+  for (PerfEventRingBuffer& buffer : page_fault_ring_buffers) {
+    ring_buffers_.emplace_back(std::move(buffer));
+  }
+  for (const auto [ring_buffer_fd, cpu] : cpu_per_ring_buffer_fd) {
+    AddRingBufferFd(ring_buffer_fd, cpu, RingBufferClass::kSampling);
   }
+  major_page_fault_ids_.insert(major_stream_ids.begin(),
+                               major_stream_ids.end());
+  minor_page_fault_ids_.insert(minor_stream_ids.begin(),
+                               minor_stream_ids.end());
+  mmap_syscall_ids_.insert(mmap_stream_ids.begin(), mmap_stream_ids.end());
+  munmap_syscall_ids_.insert(munmap_stream_ids.begin(),
+                             munmap_stream_ids.end());
   return true;
 }
 
+void TracerThread::InitUprobesEventProcessor(
+    const absl::flat_hash_map<pid_t, std::string>& initial_maps_per_pid) {
+  auto uprobes_unwinding_visitor = std::make_unique<UprobesUnwindingVisitor>(
+      initial_maps_per_pid, unwinding_thread_count_, elf_cache_);
+  uprobes_unwinding_visitor->SetListener(listener_);
+  uprobes_unwinding_visitor->SetUnwindErrorsAndDiscardedSamplesCounters(
+      stats_.unwind_error_count, stats_.discarded_samples_in_uretprobes_count);
+  uprobes_unwinding_visitor->SetUnwindMemoHitCounter(
+      stats_.unwind_memo_hit_count);
+  uprobes_unwinding_visitor->SetUsedStackSizeTracker(used_stack_size_tracker_);
+  uprobes_unwinding_visitor->SetManualInstrumentationConfig(
+      &manual_instrumentation_config_);
+  if (capture_statistics_) {
+    stats_.unwind_duration_histogram =
+        std::make_shared<UnwindDurationHistogram>();
+    uprobes_unwinding_visitor->SetUnwindDurationHistogram(
+        stats_.unwind_duration_histogram);
+  }
+  if (unwinding_method_ == CaptureOptions::kHybrid &&
+      !frame_pointer_safe_module_paths_.empty()) {
+    uprobes_unwinding_visitor->SetFramePointerSafeModules(
+        frame_pointer_safe_module_paths_);
+  }
+  if (kernel_symbols_ != nullptr) {
+    // Only the first capture of the service reads /proc/kallsyms, before
+    // the first sample rather than while processing it.
+    kernel_symbols_->Load();
+    uprobes_unwinding_visitor->SetKernelSymbols(kernel_symbols_);
+  }
+  // The maps of the processes that aren't captured are read from /proc when
+  // they are first sampled, which a replay can't do.
+  if (sample_all_processes_ && !replaying_) {
+    uprobes_unwinding_visitor->EnableOnDemandProcesses(
+        MAX_ON_DEMAND_PROCESS_COUNT);
+  }
+  uprobes_unwinding_visitor->SetMinLockWaitDuration(min_lock_wait_duration_ns_);
+  uprobes_unwinding_visitor->SetMinSyscallDuration(min_syscall_duration_ns_);
+  // Switch between PerfEventProcessor and PerfEventProcessor2 here.
+  // PerfEventProcessor2 is supposedly faster but assumes that events from the
+  // same perf_event_open ring buffer are already sorted.
+  uprobes_event_processor_ = std::make_unique<PerfEventProcessor2>(
+      std::move(uprobes_unwinding_visitor));
+  if (gpu_event_processor_ != nullptr) {
+    uprobes_event_processor_->AddVisitor(gpu_event_processor_.get());
+  }
+}
+
+int TracerThread::OpenUprobes(const LinuxTracing::Function& function,
+                              int32_t cpu, uint32_t wakeup_watermark) {
+  int fd = uprobes_retaddr_event_open(
+      function.BinaryPath().c_str(), function.FileOffset(), -1, cpu,
+      function.RecordedArgumentCount(), wakeup_watermark);
+  if (fd < 0) {
+    ERROR("Opening uprobe 0x%lx on cpu %d", function.VirtualAddress(), cpu);
+  }
+  return fd;
+}
+
+int TracerThread::OpenUretprobes(const LinuxTracing::Function& function,
+                                 int32_t cpu, uint32_t wakeup_watermark) {
+  int fd = uretprobes_event_open(
+      function.BinaryPath().c_str(), function.FileOffset(), -1, cpu,
+      function.RecordReturnValue(), wakeup_watermark);
+  if (fd < 0) {
+    ERROR("Opening uretprobe 0x%lx on cpu %d", function.VirtualAddress(), cpu);
+  }
+  return fd;
+}
+
 void TracerThread::AddUprobesFileDescriptors(
     const absl::flat_hash_map<int32_t, int>& uprobes_fds_per_cpu,
     const LinuxTracing::Function& function) {
@@ -149,6 +839,8 @@ void TracerThread::AddUprobesFileDescriptors(
     uprobes_ids_.insert(stream_id);
     tracing_fds_.push_back(fd);
     fds_per_cpu_[cpu].push_back(fd);
+    uprobes_fds_per_function_[&function - instrumented_functions_.data()]
+        .push_back(fd);
   }
 }
 
@@ -161,43 +853,106 @@ void TracerThread::AddUretprobesFileDescriptors(
     uretprobes_ids_.insert(stream_id);
     tracing_fds_.push_back(fd);
     fds_per_cpu_[cpu].push_back(fd);
+    uretprobes_fds_per_function_[&function - instrumented_functions_.data()]
+        .push_back(fd);
   }
 }
 
 bool TracerThread::OpenUserSpaceProbes(const std::vector<int32_t>& cpus) {
+  const uint32_t wakeup_watermark =
+      ComputeWakeupWatermark(GetRingBufferSizeKb(RingBufferClass::kUprobes));
+  const size_t function_count = instrumented_functions_.size();
+
+  // Each perf_event_open for a uprobe or a uretprobe is slow, and with
+  // thousands of functions and tens of cpus it can take tens of seconds to
+  // open all of them sequentially. Open them with one thread per cpu instead.
+  // fds[cpu_index][function_index] is -1 for probes not opened.
+  struct ProbeFds {
+    int uprobes_fd = -1;
+    int uretprobes_fd = -1;
+  };
+  std::vector<std::vector<ProbeFds>> fds(cpus.size(),
+                                         std::vector<ProbeFds>(function_count));
+  std::atomic<uint64_t> processed_count = 0;
+  std::atomic<size_t> finished_thread_count = 0;
+  std::vector<std::thread> opening_threads;
+  for (size_t cpu_index = 0; cpu_index < cpus.size(); ++cpu_index) {
+    opening_threads.emplace_back([&, cpu_index] {
+      int32_t cpu = cpus[cpu_index];
+      for (size_t function_index = 0; function_index < function_count;
+           ++function_index) {
+        const LinuxTracing::Function& function =
+            instrumented_functions_[function_index];
+        uint64_t address = function.VirtualAddress();
+        ProbeFds& probe_fds = fds[cpu_index][function_index];
+        // Only open uretprobes for a "timer stop" manual instrumentation
+        // function, and only uprobes for a "timer start" or async one.
+        if (!manual_instrumentation_config_.IsTimerStopAddress(address)) {
+          probe_fds.uprobes_fd = OpenUprobes(function, cpu, wakeup_watermark);
+        }
+        if (!manual_instrumentation_config_.IsUprobesOnlyAddress(address)) {
+          probe_fds.uretprobes_fd =
+              OpenUretprobes(function, cpu, wakeup_watermark);
+        }
+        ++processed_count;
+      }
+      ++finished_thread_count;
+    });
+  }
+
+  const uint64_t total_count = cpus.size() * function_count;
+  constexpr auto kProgressPollInterval = std::chrono::milliseconds(10);
+  constexpr auto kProgressLogInterval = std::chrono::seconds(1);
+  auto last_progress_log = std::chrono::steady_clock::now();
+  while (finished_thread_count < opening_threads.size()) {
+    std::this_thread::sleep_for(kProgressPollInterval);
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_progress_log >= kProgressLogInterval) {
+      LOG("Opened uprobes and uretprobes for %lu/%lu functions and cpus",
+          processed_count.load(), total_count);
+      last_progress_log = now;
+    }
+  }
+  for (std::thread& thread : opening_threads) {
+    thread.join();
+  }
+
+  std::lock_guard<std::mutex> lock(opened_events_mutex_);
+  uprobes_fds_per_function_.resize(function_count);
+  uretprobes_fds_per_function_.resize(function_count);
   bool uprobes_event_open_errors = false;
+  for (size_t function_index = 0; function_index < function_count;
+       ++function_index) {
+    const LinuxTracing::Function& function =
+        instrumented_functions_[function_index];
+    uint64_t address = function.VirtualAddress();
+    bool has_uprobes =
+        !manual_instrumentation_config_.IsTimerStopAddress(address);
+    bool has_uretprobes =
+        !manual_instrumentation_config_.IsUprobesOnlyAddress(address);
 
-  for (const auto& function : instrumented_functions_) {
     absl::flat_hash_map<int32_t, int> uprobes_fds_per_cpu;
     absl::flat_hash_map<int32_t, int> uretprobes_fds_per_cpu;
-    uint64_t address = function.VirtualAddress();
-
-    if (manual_instrumentation_config_.IsTimerStartAddress(address)) {
-      // Only open uprobes for a "timer start" manual instrumentation function.
-      if (!OpenUprobes(function, cpus, &uprobes_fds_per_cpu)) {
-        CloseFileDescriptors(uprobes_fds_per_cpu);
-        uprobes_event_open_errors = true;
-        continue;
-      }
-    } else if (manual_instrumentation_config_.IsTimerStopAddress(address)) {
-      // Only open uretprobes for a "timer stop" manual instrumentation
-      // function.
-      if (!OpenUretprobes(function, cpus, &uretprobes_fds_per_cpu)) {
-        CloseFileDescriptors(uretprobes_fds_per_cpu);
-        uprobes_event_open_errors = true;
-        continue;
+    bool success = true;
+    for (size_t cpu_index = 0; cpu_index < cpus.size(); ++cpu_index) {
+      const ProbeFds& probe_fds = fds[cpu_index][function_index];
+      if (probe_fds.uprobes_fd >= 0) {
+        uprobes_fds_per_cpu[cpus[cpu_index]] = probe_fds.uprobes_fd;
+      } else if (has_uprobes) {
+        success = false;
       }
-    } else {
-      // Open both uprobes and uretprobes for regular functions.
-      bool success = OpenUprobes(function, cpus, &uprobes_fds_per_cpu) &&
-                     OpenUretprobes(function, cpus, &uretprobes_fds_per_cpu);
-      if (!success) {
-        CloseFileDescriptors(uprobes_fds_per_cpu);
-        CloseFileDescriptors(uretprobes_fds_per_cpu);
-        uprobes_event_open_errors = true;
-        continue;
+      if (probe_fds.uretprobes_fd >= 0) {
+        uretprobes_fds_per_cpu[cpus[cpu_index]] = probe_fds.uretprobes_fd;
+      } else if (has_uretprobes) {
+        success = false;
       }
     }
+    if (!success) {
+      CloseFileDescriptors(uprobes_fds_per_cpu);
+      CloseFileDescriptors(uretprobes_fds_per_cpu);
+      uprobes_event_open_errors = true;
+      continue;
+    }
 
     // Uretprobe need to be enabled before uprobes as we support temporarily
     // not having a uprobe associated with a uretprobe but not the opposite.
@@ -216,9 +971,11 @@ void TracerThread::OpenUserSpaceProbesRingBuffers() {
 
     // Create a single ring buffer per cpu.
     int ring_buffer_fd = fds[0];
-    constexpr uint64_t buffer_size = UPROBES_RING_BUFFER_SIZE_KB;
+    const uint64_t buffer_size = GetRingBufferSizeKb(RingBufferClass::kUprobes);
     std::string buffer_name = absl::StrFormat("uprobes_uretprobes_%u", cpu);
     ring_buffers_.emplace_back(ring_buffer_fd, buffer_size, buffer_name);
+    AddRingBufferFd(ring_buffer_fd, cpu, RingBufferClass::kUprobes);
+    uprobes_ring_buffer_fds_per_cpu_.emplace(cpu, ring_buffer_fd);
 
     // Redirect subsequent fds to the cpu specific ring buffer created above.
     for (size_t i = 1; i < fds.size(); ++i) {
@@ -228,14 +985,19 @@ void TracerThread::OpenUserSpaceProbesRingBuffers() {
 }
 
 bool TracerThread::OpenMmapTask(const std::vector<int32_t>& cpus) {
+  const uint64_t ring_buffer_size_kb =
+      GetRingBufferSizeKb(RingBufferClass::kMmapTask);
   std::vector<int> mmap_task_tracing_fds;
   std::vector<PerfEventRingBuffer> mmap_task_ring_buffers;
+  absl::flat_hash_map<int, int32_t> cpu_per_ring_buffer_fd;
   for (int32_t cpu : cpus) {
-    int mmap_task_fd = mmap_task_event_open(-1, cpu);
+    int mmap_task_fd = mmap_task_event_open(
+        -1, cpu, ComputeWakeupWatermark(ring_buffer_size_kb), flight_recorder_);
     std::string buffer_name = absl::StrFormat("mmap_task_%d", cpu);
     PerfEventRingBuffer mmap_task_ring_buffer{
-        mmap_task_fd, MMAP_TASK_RING_BUFFER_SIZE_KB, buffer_name};
+        mmap_task_fd, ring_buffer_size_kb, buffer_name, flight_recorder_};
     if (mmap_task_ring_buffer.IsOpen()) {
+      cpu_per_ring_buffer_fd.emplace(mmap_task_fd, cpu);
       mmap_task_tracing_fds.push_back(mmap_task_fd);
       mmap_task_ring_buffers.push_back(std::move(mmap_task_ring_buffer));
     } else {
@@ -245,47 +1007,112 @@ bool TracerThread::OpenMmapTask(const std::vector<int32_t>& cpus) {
     }
   }
 
+  std::lock_guard<std::mutex> lock(opened_events_mutex_);
   for (int fd : mmap_task_tracing_fds) {
     tracing_fds_.push_back(fd);
   }
   for (PerfEventRingBuffer& buffer : mmap_task_ring_buffers) {
     ring_buffers_.emplace_back(std::move(buffer));
   }
+  for (const auto [ring_buffer_fd, cpu] : cpu_per_ring_buffer_fd) {
+    AddRingBufferFd(ring_buffer_fd, cpu, RingBufferClass::kMmapTask);
+  }
   return true;
 }
 
+int TracerThread::OpenSamplingEvent(const SamplingEvent& sampling_event,
+                                    pid_t tid, int32_t cpu,
+                                    uint32_t wakeup_watermark) const {
+  switch (unwinding_method_) {
+    case CaptureOptions::kFramePointers:
+      return callchain_sample_event_open(sampling_event, tid, cpu,
+                                         wakeup_watermark, flight_recorder_);
+    case CaptureOptions::kDwarf:
+      return stack_sample_event_open(sampling_event, tid, cpu,
+                                     stack_dump_size_, wakeup_watermark);
+    case CaptureOptions::kHybrid:
+      return hybrid_sample_event_open(sampling_event, tid, cpu,
+                                      stack_dump_size_, wakeup_watermark);
+    case CaptureOptions::kLbr:
+      return lbr_sample_event_open(sampling_event, tid, cpu, wakeup_watermark);
+    case CaptureOptions::kUndefined:
+    default:
+      UNREACHABLE();
+  }
+}
+
 bool TracerThread::OpenSampling(const std::vector<int32_t>& cpus) {
+  const uint64_t ring_buffer_size_kb =
+      GetRingBufferSizeKb(RingBufferClass::kSampling);
   std::vector<int> sampling_tracing_fds;
+  absl::flat_hash_map<int, const absl::flat_hash_set<pid_t>*>
+      excluded_tids_per_fd;
+  // All the samples on the same cpu go to the same ring buffer.
+  absl::flat_hash_map<int32_t, int> sampling_ring_buffer_fds_per_cpu;
   std::vector<PerfEventRingBuffer> sampling_ring_buffers;
-  for (int32_t cpu : cpus) {
-    int sampling_fd;
-    switch (unwinding_method_) {
-      case CaptureOptions::kFramePointers:
-        sampling_fd = callchain_sample_event_open(sampling_period_ns_, -1, cpu);
-        break;
-      case CaptureOptions::kDwarf:
-        sampling_fd = stack_sample_event_open(sampling_period_ns_, -1, cpu);
-        break;
-      case CaptureOptions::kUndefined:
-      default:
-        UNREACHABLE();
+  std::vector<SamplingFd> sampling_fds;
+  uint32_t wakeup_watermark = ComputeWakeupWatermark(ring_buffer_size_kb);
+  for (const SamplingConfiguration& configuration : sampling_configurations_) {
+    // -1 samples all the threads on the cpu, the samples of other processes
+    // are then discarded.
+    std::vector<pid_t> tids = configuration.tids;
+    if (tids.empty()) {
+      tids.push_back(-1);
+    }
+
+    for (pid_t tid : tids) {
+      absl::flat_hash_map<int32_t, int> sampling_fds_per_cpu;
+      for (int32_t cpu : cpus) {
+        int sampling_fd = OpenSamplingEvent(configuration.event, tid, cpu,
+                                            wakeup_watermark);
+        if (sampling_fd < 0) {
+          ERROR("Opening sampling of thread %d for cpu %d", tid, cpu);
+          break;
+        }
+        sampling_fds_per_cpu.emplace(cpu, sampling_fd);
+      }
+      if (sampling_fds_per_cpu.size() < cpus.size()) {
+        CloseFileDescriptors(sampling_fds_per_cpu);
+        // A thread that was selected might have exited in the meantime, which
+        // doesn't prevent sampling the others.
+        if (tid != -1) {
+          continue;
+        }
         CloseFileDescriptors(sampling_tracing_fds);
         return false;
-    }
+      }
 
-    std::string buffer_name = absl::StrFormat("sampling_%d", cpu);
-    PerfEventRingBuffer sampling_ring_buffer{
-        sampling_fd, SAMPLING_RING_BUFFER_SIZE_KB, buffer_name};
-    if (sampling_ring_buffer.IsOpen()) {
-      sampling_tracing_fds.push_back(sampling_fd);
-      sampling_ring_buffers.push_back(std::move(sampling_ring_buffer));
-    } else {
-      ERROR("Opening sampling for cpu %d", cpu);
-      CloseFileDescriptors(sampling_tracing_fds);
-      return false;
+      for (const auto [cpu, sampling_fd] : sampling_fds_per_cpu) {
+        sampling_tracing_fds.push_back(sampling_fd);
+        if (!configuration.excluded_tids.empty()) {
+          excluded_tids_per_fd.emplace(sampling_fd,
+                                       &configuration.excluded_tids);
+        }
+
+        auto ring_buffer_fd_it = sampling_ring_buffer_fds_per_cpu.find(cpu);
+        if (ring_buffer_fd_it != sampling_ring_buffer_fds_per_cpu.end()) {
+          perf_event_redirect(sampling_fd, ring_buffer_fd_it->second);
+          sampling_fds.push_back(SamplingFd{sampling_fd, &configuration, tid,
+                                            cpu, ring_buffer_fd_it->second});
+          continue;
+        }
+        sampling_fds.push_back(
+            SamplingFd{sampling_fd, &configuration, tid, cpu, sampling_fd});
+        std::string buffer_name = absl::StrFormat("sampling_%d", cpu);
+        PerfEventRingBuffer sampling_ring_buffer{
+            sampling_fd, ring_buffer_size_kb, buffer_name, flight_recorder_};
+        if (!sampling_ring_buffer.IsOpen()) {
+          ERROR("Opening sampling ring buffer for cpu %d", cpu);
+          CloseFileDescriptors(sampling_tracing_fds);
+          return false;
+        }
+        sampling_ring_buffer_fds_per_cpu.emplace(cpu, sampling_fd);
+        sampling_ring_buffers.push_back(std::move(sampling_ring_buffer));
+      }
     }
   }
 
+  std::lock_guard<std::mutex> lock(opened_events_mutex_);
   for (int fd : sampling_tracing_fds) {
     tracing_fds_.push_back(fd);
     uint64_t stream_id = perf_event_get_id(fd);
@@ -293,8 +1120,22 @@ bool TracerThread::OpenSampling(const std::vector<int32_t>& cpus) {
       stack_sampling_ids_.insert(stream_id);
     } else if (unwinding_method_ == CaptureOptions::kFramePointers) {
       callchain_sampling_ids_.insert(stream_id);
+    } else if (unwinding_method_ == CaptureOptions::kHybrid) {
+      hybrid_sampling_ids_.insert(stream_id);
+    } else if (unwinding_method_ == CaptureOptions::kLbr) {
+      lbr_sampling_ids_.insert(stream_id);
+    }
+    auto excluded_tids_it = excluded_tids_per_fd.find(fd);
+    if (excluded_tids_it != excluded_tids_per_fd.end()) {
+      excluded_tids_per_sampling_id_.emplace(stream_id,
+                                             excluded_tids_it->second);
     }
   }
+  sampling_fds_.insert(sampling_fds_.end(), sampling_fds.begin(),
+                       sampling_fds.end());
+  for (const auto [cpu, ring_buffer_fd] : sampling_ring_buffer_fds_per_cpu) {
+    AddRingBufferFd(ring_buffer_fd, cpu, RingBufferClass::kSampling);
+  }
   for (PerfEventRingBuffer& buffer : sampling_ring_buffers) {
     ring_buffers_.emplace_back(std::move(buffer));
   }
@@ -328,14 +1169,15 @@ void TracerThread::OpenRingBuffersOrRedirectOnExisting(
 
 bool TracerThread::OpenRingBuffersForTracepoint(
     const char* tracepoint_category, const char* tracepoint_name,
-    const std::vector<int32_t>& cpus, std::vector<int>* tracing_fds,
+    const std::vector<int32_t>& cpus, uint32_t wakeup_watermark,
+    uint64_t ring_buffer_size_kb, std::vector<int>* tracing_fds,
     absl::flat_hash_set<uint64_t>* tracepoint_ids,
     absl::flat_hash_map<int32_t, int>* tracepoint_ring_buffer_fds_per_cpu,
     std::vector<PerfEventRingBuffer>* ring_buffers) {
   absl::flat_hash_map<int32_t, int> tracepoint_fds_per_cpu;
   for (int32_t cpu : cpus) {
-    int fd =
-        tracepoint_event_open(tracepoint_category, tracepoint_name, -1, cpu);
+    int fd = tracepoint_event_open(tracepoint_category, tracepoint_name, -1,
+                                   cpu, wakeup_watermark);
     if (fd < 0) {
       ERROR("Opening %s:%s tracepoint for cpu %d", tracepoint_category,
             tracepoint_name, cpu);
@@ -355,21 +1197,111 @@ bool TracerThread::OpenRingBuffersForTracepoint(
 
   OpenRingBuffersOrRedirectOnExisting(
       tracepoint_fds_per_cpu, tracepoint_ring_buffer_fds_per_cpu, ring_buffers,
-      TRACEPOINTS_RING_BUFFER_SIZE_KB, "tracepoints");
+      ring_buffer_size_kb, "tracepoints");
   return true;
 }
 
-bool TracerThread::OpenTracepoints(const std::vector<int32_t>& cpus) {
+bool TracerThread::OpenTracepoints(const std::vector<int32_t>& cpus,
+                                   const std::vector<int32_t>& all_cpus) {
+  const uint64_t ring_buffer_size_kb =
+      GetRingBufferSizeKb(RingBufferClass::kTracepoints);
   bool tracepoint_event_open_errors = false;
   absl::flat_hash_map<int32_t, int> tracepoint_ring_buffer_fds_per_cpu;
+  std::vector<int> tracepoint_tracing_fds;
+  std::vector<PerfEventRingBuffer> tracepoint_ring_buffers;
+  uint32_t wakeup_watermark = ComputeWakeupWatermark(ring_buffer_size_kb);
 
   tracepoint_event_open_errors |= !OpenRingBuffersForTracepoint(
-      "task", "task_newtask", cpus, &tracing_fds_, &task_newtask_ids_,
-      &tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_);
+      "task", "task_newtask", cpus, wakeup_watermark, ring_buffer_size_kb,
+      &tracepoint_tracing_fds, &task_newtask_ids_,
+      &tracepoint_ring_buffer_fds_per_cpu, &tracepoint_ring_buffers);
 
   tracepoint_event_open_errors |= !OpenRingBuffersForTracepoint(
-      "task", "task_rename", cpus, &tracing_fds_, &task_rename_ids_,
-      &tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_);
+      "task", "task_rename", cpus, wakeup_watermark, ring_buffer_size_kb,
+      &tracepoint_tracing_fds, &task_rename_ids_,
+      &tracepoint_ring_buffer_fds_per_cpu, &tracepoint_ring_buffers);
+
+  if (trace_thread_state_) {
+    // sched_waking is recorded in the context of the waker, while
+    // sched_wakeup can be recorded on the cpu of the wakee, but sched_waking
+    // was only added in Linux 4.3.
+    const char* wakeup_tracepoint_name =
+        GetTracepointId("sched", "sched_waking") >= 0 ? "sched_waking"
+                                                       : "sched_wakeup";
+    tracepoint_event_open_errors |= !OpenRingBuffersForTracepoint(
+        "sched", wakeup_tracepoint_name, all_cpus, wakeup_watermark,
+        ring_buffer_size_kb, &tracepoint_tracing_fds, &sched_wakeup_ids_,
+        &tracepoint_ring_buffer_fds_per_cpu, &tracepoint_ring_buffers);
+  }
+
+  if (trace_syscalls_) {
+    // The syscalls of all processes are recorded, as the filters of
+    // tracepoints can't match a pid, only a tid: the kernel only filters them
+    // by number.
+    const size_t first_syscall_fd_index = tracepoint_tracing_fds.size();
+    tracepoint_event_open_errors |= !OpenRingBuffersForTracepoint(
+        "raw_syscalls", "sys_enter", cpus, wakeup_watermark,
+        ring_buffer_size_kb, &tracepoint_tracing_fds, &syscall_enter_ids_,
+        &tracepoint_ring_buffer_fds_per_cpu, &tracepoint_ring_buffers);
+    tracepoint_event_open_errors |= !OpenRingBuffersForTracepoint(
+        "raw_syscalls", "sys_exit", cpus, wakeup_watermark, ring_buffer_size_kb,
+        &tracepoint_tracing_fds, &syscall_exit_ids_,
+        &tracepoint_ring_buffer_fds_per_cpu, &tracepoint_ring_buffers);
+    if (!syscall_filter_.empty()) {
+      for (size_t i = first_syscall_fd_index; i < tracepoint_tracing_fds.size();
+           ++i) {
+        perf_event_set_filter(tracepoint_tracing_fds[i],
+                              syscall_filter_.c_str());
+      }
+    }
+  }
+
+  if (trace_block_io_) {
+    tracepoint_event_open_errors |= !OpenRingBuffersForTracepoint(
+        "block", "block_rq_issue", all_cpus, wakeup_watermark,
+        ring_buffer_size_kb, &tracepoint_tracing_fds, &block_rq_issue_ids_,
+        &tracepoint_ring_buffer_fds_per_cpu, &tracepoint_ring_buffers);
+    tracepoint_event_open_errors |= !OpenRingBuffersForTracepoint(
+        "block", "block_rq_complete", all_cpus, wakeup_watermark,
+        ring_buffer_size_kb, &tracepoint_tracing_fds, &block_rq_complete_ids_,
+        &tracepoint_ring_buffer_fds_per_cpu, &tracepoint_ring_buffers);
+  }
+
+  // Rare events, of all cpus as the frequency of a cpu is not a property of
+  // the threads of the target.
+  if (trace_cpu_power_states_) {
+    tracepoint_event_open_errors |= !OpenRingBuffersForTracepoint(
+        "power", "cpu_frequency", all_cpus, wakeup_watermark,
+        ring_buffer_size_kb, &tracepoint_tracing_fds, &cpu_frequency_ids_,
+        &tracepoint_ring_buffer_fds_per_cpu, &tracepoint_ring_buffers);
+    tracepoint_event_open_errors |= !OpenRingBuffersForTracepoint(
+        "power", "cpu_idle", all_cpus, wakeup_watermark, ring_buffer_size_kb,
+        &tracepoint_tracing_fds, &cpu_idle_ids_,
+        &tracepoint_ring_buffer_fds_per_cpu, &tracepoint_ring_buffers);
+    // cpu_frequency is only recorded on changes: the tracks start from the
+    // current frequencies. The tracepoints are not enabled yet, so these come
+    // before any change.
+    for (int32_t cpu : all_cpus) {
+      std::optional<uint32_t> frequency_khz = GetCpuFrequencyKhz(cpu);
+      if (!frequency_khz.has_value()) continue;
+      CpuPowerEvent cpu_power_event;
+      cpu_power_event.set_cpu(cpu);
+      cpu_power_event.set_timestamp_ns(MonotonicTimestampNs());
+      cpu_power_event.set_frequency_khz(frequency_khz.value());
+      listener_->OnCpuPowerEvent(std::move(cpu_power_event));
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(opened_events_mutex_);
+  for (int fd : tracepoint_tracing_fds) {
+    tracing_fds_.push_back(fd);
+  }
+  for (PerfEventRingBuffer& buffer : tracepoint_ring_buffers) {
+    ring_buffers_.emplace_back(std::move(buffer));
+  }
+  for (const auto [cpu, ring_buffer_fd] : tracepoint_ring_buffer_fds_per_cpu) {
+    AddRingBufferFd(ring_buffer_fd, cpu, RingBufferClass::kTracepoints);
+  }
 
   return !tracepoint_event_open_errors;
 }
@@ -394,13 +1326,16 @@ bool TracerThread::InitGpuTracepointEventProcessor() {
 // relevant events.
 // This method returns true on success, otherwise false.
 bool TracerThread::OpenGpuTracepoints(const std::vector<int32_t>& cpus) {
+  const uint64_t ring_buffer_size_kb =
+      GetRingBufferSizeKb(RingBufferClass::kGpuTracing);
   absl::flat_hash_map<int32_t, int> amdgpu_cs_ioctl_fds_per_cpu;
   absl::flat_hash_map<int32_t, int> amdgpu_sched_run_job_fds_per_cpu;
   absl::flat_hash_map<int32_t, int> dma_fence_signaled_fds_per_cpu;
   bool tracepoint_event_open_errors = false;
+  uint32_t wakeup_watermark = ComputeWakeupWatermark(ring_buffer_size_kb);
   for (int32_t cpu : cpus) {
-    int amdgpu_cs_ioctl_fd =
-        tracepoint_event_open("amdgpu", "amdgpu_cs_ioctl", -1, cpu);
+    int amdgpu_cs_ioctl_fd = tracepoint_event_open(
+        "amdgpu", "amdgpu_cs_ioctl", -1, cpu, wakeup_watermark);
     if (amdgpu_cs_ioctl_fd == -1) {
       ERROR("Opening amdgpu:amdgpu_cs_ioctl tracepoint for cpu %d", cpu);
       tracepoint_event_open_errors = true;
@@ -408,8 +1343,8 @@ bool TracerThread::OpenGpuTracepoints(const std::vector<int32_t>& cpus) {
     }
     amdgpu_cs_ioctl_fds_per_cpu.emplace(cpu, amdgpu_cs_ioctl_fd);
 
-    int amdgpu_sched_run_job_fd =
-        tracepoint_event_open("amdgpu", "amdgpu_sched_run_job", -1, cpu);
+    int amdgpu_sched_run_job_fd = tracepoint_event_open(
+        "amdgpu", "amdgpu_sched_run_job", -1, cpu, wakeup_watermark);
     if (amdgpu_sched_run_job_fd == -1) {
       ERROR("Opening amdgpu:amdgpu_sched_run_job tracepoint for cpu %d", cpu);
       tracepoint_event_open_errors = true;
@@ -417,8 +1352,8 @@ bool TracerThread::OpenGpuTracepoints(const std::vector<int32_t>& cpus) {
     }
     amdgpu_sched_run_job_fds_per_cpu.emplace(cpu, amdgpu_sched_run_job_fd);
 
-    int dma_fence_signaled_fd =
-        tracepoint_event_open("dma_fence", "dma_fence_signaled", -1, cpu);
+    int dma_fence_signaled_fd = tracepoint_event_open(
+        "dma_fence", "dma_fence_signaled", -1, cpu, wakeup_watermark);
     if (dma_fence_signaled_fd == -1) {
       ERROR("Opening dma_fence:dma_fence_signaled tracepoint for cpu %d", cpu);
       tracepoint_event_open_errors = true;
@@ -442,6 +1377,7 @@ bool TracerThread::OpenGpuTracepoints(const std::vector<int32_t>& cpus) {
 
   // Since all tracepoints could successfully be opened, we can now commit all
   // file descriptors and ring buffers to the TracerThread members.
+  std::lock_guard<std::mutex> lock(opened_events_mutex_);
   for (const auto& cpu_and_fd : amdgpu_cs_ioctl_fds_per_cpu) {
     tracing_fds_.push_back(cpu_and_fd.second);
     amdgpu_cs_ioctl_ids_.insert(perf_event_get_id(cpu_and_fd.second));
@@ -460,17 +1396,22 @@ bool TracerThread::OpenGpuTracepoints(const std::vector<int32_t>& cpus) {
   absl::flat_hash_map<int32_t, int> gpu_tracepoint_ring_buffer_fds_per_cpu;
   OpenRingBuffersOrRedirectOnExisting(
       amdgpu_cs_ioctl_fds_per_cpu, &gpu_tracepoint_ring_buffer_fds_per_cpu,
-      &ring_buffers_, GPU_TRACING_RING_BUFFER_SIZE_KB,
+      &ring_buffers_, ring_buffer_size_kb,
       absl::StrFormat("%s:%s", "amdgpu", "amdgpu_cs_ioctl"));
   OpenRingBuffersOrRedirectOnExisting(
       amdgpu_sched_run_job_fds_per_cpu, &gpu_tracepoint_ring_buffer_fds_per_cpu,
-      &ring_buffers_, GPU_TRACING_RING_BUFFER_SIZE_KB,
+      &ring_buffers_, ring_buffer_size_kb,
       absl::StrFormat("%s:%s", "amdgpu", "amdgpu_sched_run_job"));
   OpenRingBuffersOrRedirectOnExisting(
       dma_fence_signaled_fds_per_cpu, &gpu_tracepoint_ring_buffer_fds_per_cpu,
-      &ring_buffers_, GPU_TRACING_RING_BUFFER_SIZE_KB,
+      &ring_buffers_, ring_buffer_size_kb,
       absl::StrFormat("%s:%s", "dma_fence", "dma_fence_signaled"));
 
+  for (const auto [cpu, ring_buffer_fd] :
+       gpu_tracepoint_ring_buffer_fds_per_cpu) {
+    AddRingBufferFd(ring_buffer_fd, cpu, RingBufferClass::kGpuTracing);
+  }
+
   return true;
 }
 
@@ -489,58 +1430,160 @@ void TracerThread::Run(
   }
 
   // Record calls to dynamically instrumented functions and sample only on cores
-  // in this process's cgroup's cpuset, as these are the only cores the process
-  // will be scheduled on.
-  std::vector<int32_t> cpuset_cpus = GetCpusetCpus(pid_);
-  if (cpuset_cpus.empty()) {
-    ERROR("Could not read cpuset");
-    cpuset_cpus = all_cpus;
+  // in the cgroups' cpusets of the captured processes, as these are the only
+  // cores the processes will be scheduled on.
+  std::vector<int32_t> cpuset_cpus;
+  for (pid_t pid : pids_) {
+    std::vector<int32_t> process_cpuset_cpus = GetCpusetCpus(pid);
+    if (process_cpuset_cpus.empty()) {
+      ERROR("Could not read cpuset of process %d", pid);
+      cpuset_cpus = all_cpus;
+      break;
+    }
+    cpuset_cpus.insert(cpuset_cpus.end(), process_cpuset_cpus.begin(),
+                       process_cpuset_cpus.end());
+  }
+  std::sort(cpuset_cpus.begin(), cpuset_cpus.end());
+  cpuset_cpus.erase(std::unique(cpuset_cpus.begin(), cpuset_cpus.end()),
+                    cpuset_cpus.end());
+
+  // First, so that the threads started for the capture already run there.
+  CaptureSetupPhase pin_phase;
+  std::vector<int32_t> cpus_before_pinning;
+  if (pin_service_threads_) {
+    pin_phase.set_name("pin_service_threads");
+    pin_phase.set_begin_timestamp_ns(MonotonicTimestampNs());
+    cpus_before_pinning = PinServiceThreads(all_cpus, cpuset_cpus);
+    pin_phase.set_end_timestamp_ns(MonotonicTimestampNs());
+    pin_phase.set_succeeded(!cpus_before_pinning.empty());
   }
 
   // As we open two perf_event_open file descriptors (uprobe and uretprobe) per
   // cpu per instrumented function, increase the maximum number of open files.
   SetMaxOpenFilesSoftLimit(GetMaxOpenFilesHardLimit());
 
-  bool perf_event_open_errors = false;
+  context_switch_manager_.Reset(all_cpus.size());
+  scheduling_slice_counters_manager_.Reset(all_cpus.size());
+
+  // The other processes can run on any core.
+  const std::vector<int32_t>& sampling_cpus =
+      sample_all_processes_ ? all_cpus : cpuset_cpus;
 
+  // Each phase opens its own events, one by one for each cpu, and only
+  // synchronizes to add them to tracing_fds_ and ring_buffers_: run them in
+  // parallel to reduce the time to the first event on large machines.
+  std::vector<OpenPhase> open_phases;
   if (trace_context_switches_) {
-    perf_event_open_errors |= !OpenContextSwitches(all_cpus);
+    open_phases.push_back({"context_switches",
+                           [&] { return OpenContextSwitches(all_cpus); }});
   }
-
-  context_switch_manager_.Clear();
-
-  perf_event_open_errors |= !OpenMmapTask(cpuset_cpus);
-
-  bool uprobes_event_open_errors = false;
+  if (trace_performance_counters_) {
+    open_phases.push_back({"performance_counters",
+                           [&] { return OpenSchedSwitchCounters(all_cpus); }});
+  }
+  if (trace_off_cpu_) {
+    open_phases.push_back(
+        {"off_cpu", [&] { return OpenOffCpuCallchains(all_cpus); }});
+  }
+  if (trace_lock_contention_) {
+    open_phases.push_back(
+        {"lock_contention", [&] { return OpenLockContention(all_cpus); }});
+  }
+  if (trace_allocations_) {
+    open_phases.push_back(
+        {"allocations", [&] { return OpenAllocationUprobes(cpuset_cpus); }});
+  }
+  if (trace_page_faults_) {
+    open_phases.push_back(
+        {"page_faults", [&] { return OpenPageFaults(cpuset_cpus); }});
+  }
+  open_phases.push_back(
+      {"mmap_task", [&] { return OpenMmapTask(sampling_cpus); }});
   if (!instrumented_functions_.empty()) {
-    uprobes_event_open_errors = !OpenUserSpaceProbes(cpuset_cpus);
-    perf_event_open_errors |= uprobes_event_open_errors;
+    open_phases.push_back(
+        {"uprobes", [&] { return OpenUserSpaceProbes(cpuset_cpus); }});
+  }
+  // Thread names are retrieved when the flight recorder is dumped instead.
+  if (!flight_recorder_) {
+    open_phases.push_back(
+        {"tracepoints",
+         [&] { return OpenTracepoints(cpuset_cpus, all_cpus); }});
+  }
+  if (unwinding_method_ == CaptureOptions::kLbr &&
+      !is_lbr_call_stack_supported()) {
+    ERROR("This CPU can't record call stacks in its last branch records, "
+          "falling back to frame pointer unwinding");
+    unwinding_method_ = CaptureOptions::kFramePointers;
   }
-
-  perf_event_open_errors |= !OpenTracepoints(cpuset_cpus);
-
-  // This takes an initial snapshot of the maps. Call it after OpenUprobes, as
-  // calling perf_event_open for uprobes (just calling it, it is not necessary
-  // to enable the file descriptor) causes a new [uprobes] map entry, and we
-  // want to catch it.
-  InitUprobesEventProcessor();
-
   if (unwinding_method_ == CaptureOptions::kFramePointers ||
-      unwinding_method_ == CaptureOptions::kDwarf) {
-    perf_event_open_errors |= !OpenSampling(cpuset_cpus);
+      unwinding_method_ == CaptureOptions::kDwarf ||
+      unwinding_method_ == CaptureOptions::kHybrid ||
+      unwinding_method_ == CaptureOptions::kLbr) {
+    open_phases.push_back(
+        {"sampling", [&] { return OpenSampling(sampling_cpus); }});
   }
-
-  bool gpu_event_open_errors = false;
   if (trace_gpu_driver_) {
     if (InitGpuTracepointEventProcessor()) {
       // We want to trace all GPU activity, hence we pass 'all_cpus' here.
-      gpu_event_open_errors = !OpenGpuTracepoints(all_cpus);
+      open_phases.push_back(
+          {"gpu_tracepoints", [&] { return OpenGpuTracepoints(all_cpus); }});
     } else {
       ERROR(
           "Failed to initialize GPU tracepoint event processor: "
           "skipping opening GPU tracepoint events");
     }
   }
+  std::vector<CaptureSetupPhase> setup_phases = RunOpenPhases(open_phases);
+
+  bool perf_event_open_errors = false;
+  bool uprobes_event_open_errors = false;
+  bool gpu_event_open_errors = false;
+  for (const CaptureSetupPhase& setup_phase : setup_phases) {
+    if (setup_phase.succeeded()) {
+      continue;
+    }
+    if (setup_phase.name() == "gpu_tracepoints") {
+      gpu_event_open_errors = true;
+      continue;
+    }
+    perf_event_open_errors = true;
+    if (setup_phase.name() == "uprobes") {
+      uprobes_event_open_errors = true;
+    }
+  }
+
+  // Not an error with perf_event_open.
+  if (pin_service_threads_) {
+    setup_phases.push_back(std::move(pin_phase));
+  }
+
+  // The flight recorder only sends events from here, when it's dumped.
+  if (flight_recorder_) {
+    RecordUntilExitRequested(exit_requested);
+  }
+
+  // This takes an initial snapshot of the maps. Call it after OpenUprobes, as
+  // calling perf_event_open for uprobes (just calling it, it is not necessary
+  // to enable the file descriptor) causes a new [uprobes] map entry, and we
+  // want to catch it.
+  CaptureSetupPhase& maps_phase = setup_phases.emplace_back();
+  maps_phase.set_name("maps_snapshot");
+  maps_phase.set_begin_timestamp_ns(MonotonicTimestampNs());
+  absl::flat_hash_map<pid_t, std::string> initial_maps_per_pid;
+  for (pid_t pid : pids_) {
+    initial_maps_per_pid.emplace(pid, ReadMaps(pid));
+  }
+  InitUprobesEventProcessor(initial_maps_per_pid);
+  maps_phase.set_end_timestamp_ns(MonotonicTimestampNs());
+  maps_phase.set_succeeded(true);
+
+  if (!perf_recording_path_.empty()) {
+    StartPerfRecording(initial_maps_per_pid);
+  }
+
+  for (CaptureSetupPhase& setup_phase : setup_phases) {
+    listener_->OnCaptureSetupPhase(std::move(setup_phase));
+  }
 
   if (gpu_event_open_errors) {
     LOG("There were errors opening GPU tracepoint events");
@@ -554,154 +1597,926 @@ void TracerThread::Run(
         "or to set /proc/sys/kernel/perf_event_paranoid to -1?");
   }
 
-  // Start recording events.
+  // Get the initial thread names and notify the listener_, without delaying
+  // the reading of the ring buffers. When the flight recorder is dumped, the
+  // current names are all there is to send.
+  std::thread thread_name_retriever_thread;
+  if (flight_recorder_) {
+    absl::flat_hash_map<pid_t, std::string> thread_names_sent;
+    RetrieveThreadNames(&thread_names_sent,
+                        std::make_shared<std::atomic<bool>>(false));
+  } else {
+    // Start recording events.
+    for (int fd : tracing_fds_) {
+      perf_event_enable(fd);
+    }
+
+    thread_name_retriever_thread = std::thread(
+        &TracerThread::RunThreadNameRetriever, this, exit_requested);
+  }
+
+  InitRingBufferReaders();
+
+  stats_.Reset();
+  SendClockOffset();
+
+  // The scopes of the ring buffer readers are only of interest once they
+  // start, and the ones of the setup are already CaptureSetupPhases.
+  if (introspection_) {
+    SetOrbitTracingListener(listener_);
+  }
+
+  std::thread deferred_events_thread(&TracerThread::ProcessDeferredEvents,
+                                     this);
+  std::thread instrumentation_governor_thread;
+  if (instrumentation_governor_ != nullptr && !flight_recorder_) {
+    instrumentation_governor_->StartMeasuring(MonotonicTimestampNs());
+    instrumentation_governor_thread = std::thread(
+        &TracerThread::RunInstrumentationGovernor, this, exit_requested);
+  }
+  std::thread cpu_budget_governor_thread;
+  if (cpu_budget_governor_ != nullptr && !flight_recorder_) {
+    cpu_budget_governor_thread = std::thread(
+        &TracerThread::RunCpuBudgetGovernor, this, exit_requested);
+  }
+  // The probes of the added functions would be missing from the header of the
+  // perf recording.
+  std::thread instrumented_functions_updater_thread;
+  if (instrumented_functions_updates_ != nullptr && !flight_recorder_ &&
+      perf_recording_writer_ == nullptr) {
+    instrumented_functions_updater_thread = std::thread(
+        &TracerThread::RunInstrumentedFunctionsUpdater, this, exit_requested);
+  }
+  std::thread manual_instrumentation_reader_thread;
+  if (manual_instrumentation_shared_memory_) {
+    manual_instrumentation_reader_thread =
+        std::thread(&TracerThread::RunManualInstrumentationReader, this,
+                    exit_requested);
+  }
+  std::thread vulkan_layer_reader_thread;
+  if (trace_vulkan_layer_) {
+    vulkan_layer_reader_thread = std::thread(
+        &TracerThread::RunVulkanLayerReader, this, exit_requested);
+  }
+
+  RunRingBufferReaders(exit_requested);
+
+  if (thread_name_retriever_thread.joinable()) {
+    thread_name_retriever_thread.join();
+  }
+  if (manual_instrumentation_reader_thread.joinable()) {
+    manual_instrumentation_reader_thread.join();
+  }
+  if (vulkan_layer_reader_thread.joinable()) {
+    vulkan_layer_reader_thread.join();
+  }
+  if (instrumentation_governor_thread.joinable()) {
+    instrumentation_governor_thread.join();
+  }
+  if (cpu_budget_governor_thread.joinable()) {
+    cpu_budget_governor_thread.join();
+  }
+  if (instrumented_functions_updater_thread.joinable()) {
+    instrumented_functions_updater_thread.join();
+  }
+
+  // Nothing is lost in overwrite ring buffers.
+  if (auto_ring_buffer_sizes_ && !flight_recorder_) {
+    std::array<uint64_t, RING_BUFFER_CLASS_COUNT> lost_count_per_class;
+    for (size_t i = 0; i < RING_BUFFER_CLASS_COUNT; ++i) {
+      lost_count_per_class[i] = lost_count_per_ring_buffer_class_[i];
+    }
+    GetRingBufferSizeTuner().ReportLostEvents(lost_count_per_class);
+  }
+
+  FinishProcessingEvents(&deferred_events_thread);
+  // All the threads of the Tracer with ORBIT_SCOPEs have exited.
+  if (introspection_) {
+    SetOrbitTracingListener(nullptr);
+  }
+
+  // Stop recording.
+  RunOnFileDescriptorsInParallel(tracing_fds_, &perf_event_disable);
+
+  // Close the ring buffers.
+  ring_buffers_.clear();
+  if (perf_recording_writer_ != nullptr) {
+    LOG("Wrote %lu bytes of records to perf recording \"%s\"",
+        perf_recording_writer_->GetRecordsBytesWritten(),
+        perf_recording_path_);
+    perf_recording_writer_.reset();
+  }
+
+  // Close the file descriptors.
+  RunOnFileDescriptorsInParallel(tracing_fds_, [](int fd) { close(fd); });
+
+  // All the events have been destroyed by now: give the memory that was
+  // recycled for them back.
+  SlabAllocator::ReleaseAllMemoryIfUnused();
+
+  if (!cpus_before_pinning.empty()) {
+    SetProcessCpuAffinity(cpus_before_pinning);
+  }
+}
+
+std::vector<CaptureSetupPhase> TracerThread::RunOpenPhases(
+    const std::vector<OpenPhase>& open_phases) {
+  // Each phase only writes its own element.
+  std::vector<CaptureSetupPhase> setup_phases(open_phases.size());
+  std::unique_ptr<ThreadPool> thread_pool = ThreadPool::Create(
+      open_phases.size(), open_phases.size(), absl::Seconds(1));
+  for (size_t phase_index = 0; phase_index < open_phases.size();
+       ++phase_index) {
+    thread_pool->Schedule([&open_phases, &setup_phases, phase_index] {
+      CaptureSetupPhase& setup_phase = setup_phases[phase_index];
+      setup_phase.set_name(open_phases[phase_index].name);
+      setup_phase.set_begin_timestamp_ns(MonotonicTimestampNs());
+      setup_phase.set_succeeded(open_phases[phase_index].open());
+      setup_phase.set_end_timestamp_ns(MonotonicTimestampNs());
+    });
+  }
+  thread_pool->ShutdownAndWait();
+  return setup_phases;
+}
+
+void TracerThread::RecordUntilExitRequested(
+    const std::shared_ptr<std::atomic<bool>>& exit_requested) {
   for (int fd : tracing_fds_) {
     perf_event_enable(fd);
   }
+  LOG("Flight recorder keeping the last %lu ms in %lu ring buffers",
+      flight_recorder_window_ms_, ring_buffers_.size());
 
-  // Get the initial thread names and notify the listener_.
-  RetrieveThreadNames();
+  // Nothing is read until the dump, hence there is nothing to do but wait.
+  while (!(*exit_requested)) {
+    usleep(FLIGHT_RECORDER_EXIT_CHECK_PERIOD_US);
+  }
 
-  stats_.Reset();
+  // The ring buffers must not change while they are copied.
+  RunOnFileDescriptorsInParallel(tracing_fds_, &perf_event_disable);
+  const uint64_t dump_timestamp_ns = MonotonicTimestampNs();
+  const uint64_t window_ns = flight_recorder_window_ms_ * 1'000'000;
+  const uint64_t min_timestamp_ns =
+      dump_timestamp_ns > window_ns ? dump_timestamp_ns - window_ns : 0;
+  std::vector<PerfEventRingBuffer> snapshots;
+  snapshots.reserve(ring_buffers_.size());
+  for (PerfEventRingBuffer& ring_buffer : ring_buffers_) {
+    snapshots.emplace_back(ring_buffer.TakeSnapshot(min_timestamp_ns));
+  }
+  // This unmaps the overwrite ring buffers.
+  ring_buffers_ = std::move(snapshots);
+  LOG("Dumping flight recorder: copying the ring buffers took %.3f ms",
+      (MonotonicTimestampNs() - dump_timestamp_ns) / 1e6);
+}
 
-  bool last_iteration_saw_events = false;
+void TracerThread::ReadRingBufferSnapshots(RingBufferReader* reader) {
+  auto exit_requested = std::make_shared<std::atomic<bool>>(false);
+  for (PerfEventRingBuffer* ring_buffer : reader->ring_buffers) {
+    while (ReadRingBufferBatch(ring_buffer, reader, exit_requested)) {
+    }
+  }
+}
+
+void TracerThread::StartPerfRecording(
+    const absl::flat_hash_map<pid_t, std::string>& initial_maps_per_pid) {
+  perf_recording_writer_ = PerfRecordingWriter::Create(perf_recording_path_);
+  if (perf_recording_writer_ == nullptr) {
+    return;
+  }
+
+  PerfRecordingHeader header;
+  *header.mutable_capture_options() = perf_recording_capture_options_;
+  header.set_cpu_count(GetNumCores());
+  for (const auto& [pid, maps] : initial_maps_per_pid) {
+    PerfRecordingHeader::InitialMaps* initial_maps = header.add_initial_maps();
+    initial_maps->set_pid(pid);
+    initial_maps->set_maps(maps);
+  }
+  for (const PerfEventRingBuffer& ring_buffer : ring_buffers_) {
+    const int fd = ring_buffer.GetFileDescriptor();
+    PerfRecordingHeader::RingBuffer* recorded_ring_buffer =
+        header.add_ring_buffers();
+    recorded_ring_buffer->set_file_descriptor(fd);
+    recorded_ring_buffer->set_cpu(cpu_per_ring_buffer_fd_.at(fd));
+    recorded_ring_buffer->set_ring_buffer_class(
+        static_cast<uint32_t>(ring_buffer_class_per_fd_.at(fd)));
+    recorded_ring_buffer->set_name(ring_buffer.GetName());
+  }
+  for (const auto& [kind, stream_ids] : GetStreamIdSets()) {
+    if (stream_ids->empty()) {
+      continue;
+    }
+    PerfRecordingHeader::StreamIds* recorded_stream_ids =
+        header.add_stream_ids();
+    recorded_stream_ids->set_kind(kind);
+    recorded_stream_ids->mutable_stream_ids()->Add(stream_ids->begin(),
+                                                   stream_ids->end());
+  }
+  for (const auto& [stream_id, function] :
+       uprobes_uretprobes_ids_to_function_) {
+    PerfRecordingHeader::FunctionStreamId* function_stream_id =
+        header.add_function_stream_ids();
+    function_stream_id->set_stream_id(stream_id);
+    function_stream_id->set_function_index(
+        static_cast<uint32_t>(function - instrumented_functions_.data()));
+  }
+  for (const auto& [stream_id, excluded_tids] :
+       excluded_tids_per_sampling_id_) {
+    for (size_t i = 0; i < sampling_configurations_.size(); ++i) {
+      if (&sampling_configurations_[i].excluded_tids == excluded_tids) {
+        PerfRecordingHeader::SamplingStreamId* sampling_stream_id =
+            header.add_sampling_stream_ids();
+        sampling_stream_id->set_stream_id(stream_id);
+        sampling_stream_id->set_sampling_configuration_index(
+            static_cast<uint32_t>(i));
+        break;
+      }
+    }
+  }
+  perf_recording_writer_->WriteHeader(header);
+
+  for (const auto& [pid, maps] : initial_maps_per_pid) {
+    perf_recording_writer_->BundleFilesOfMaps(maps);
+  }
+  for (PerfEventRingBuffer& ring_buffer : ring_buffers_) {
+    ring_buffer.SetRecordingWriter(perf_recording_writer_.get());
+  }
+  LOG("Recording the records of %lu ring buffers to \"%s\"",
+      ring_buffers_.size(), perf_recording_path_);
+}
+
+void TracerThread::RestoreStreamIds(const PerfRecordingHeader& header) {
+  absl::flat_hash_map<std::string, absl::flat_hash_set<uint64_t>*>
+      stream_id_sets_by_kind;
+  for (const auto& [kind, stream_ids] : GetStreamIdSets()) {
+    stream_id_sets_by_kind.emplace(kind, stream_ids);
+  }
+  for (const PerfRecordingHeader::StreamIds& recorded_stream_ids :
+       header.stream_ids()) {
+    auto stream_ids_it =
+        stream_id_sets_by_kind.find(recorded_stream_ids.kind());
+    if (stream_ids_it == stream_id_sets_by_kind.end()) {
+      ERROR("Unknown kind of stream ids \"%s\" in perf recording",
+            recorded_stream_ids.kind());
+      continue;
+    }
+    stream_ids_it->second->insert(recorded_stream_ids.stream_ids().begin(),
+                                  recorded_stream_ids.stream_ids().end());
+  }
+  for (const PerfRecordingHeader::FunctionStreamId& function_stream_id :
+       header.function_stream_ids()) {
+    if (function_stream_id.function_index() >= instrumented_functions_.size()) {
+      ERROR("Perf recording with unknown function %u",
+            function_stream_id.function_index());
+      continue;
+    }
+    uprobes_uretprobes_ids_to_function_.emplace(
+        function_stream_id.stream_id(),
+        &instrumented_functions_[function_stream_id.function_index()]);
+  }
+  for (const PerfRecordingHeader::SamplingStreamId& sampling_stream_id :
+       header.sampling_stream_ids()) {
+    const uint32_t index = sampling_stream_id.sampling_configuration_index();
+    if (index >= sampling_configurations_.size()) {
+      ERROR("Perf recording with unknown sampling configuration %u", index);
+      continue;
+    }
+    excluded_tids_per_sampling_id_.emplace(
+        sampling_stream_id.stream_id(),
+        &sampling_configurations_[index].excluded_tids);
+  }
+}
+
+std::vector<std::pair<std::string, absl::flat_hash_set<uint64_t>*>>
+TracerThread::GetStreamIdSets() {
+  return {
+      {"uprobes", &uprobes_ids_},
+      {"uretprobes", &uretprobes_ids_},
+      {"stack_sampling", &stack_sampling_ids_},
+      {"task_newtask", &task_newtask_ids_},
+      {"task_rename", &task_rename_ids_},
+      {"sched_wakeup", &sched_wakeup_ids_},
+      {"amdgpu_cs_ioctl", &amdgpu_cs_ioctl_ids_},
+      {"amdgpu_sched_run_job", &amdgpu_sched_run_job_ids_},
+      {"dma_fence_signaled", &dma_fence_signaled_ids_},
+      {"callchain_sampling", &callchain_sampling_ids_},
+      {"hybrid_sampling", &hybrid_sampling_ids_},
+      {"lbr_sampling", &lbr_sampling_ids_},
+      {"sched_switch_counters", &sched_switch_counters_ids_},
+      {"off_cpu_callchain", &off_cpu_callchain_ids_},
+      {"futex_wait", &futex_wait_ids_},
+      {"futex_exit", &futex_exit_ids_},
+      {"allocation", &allocation_ids_},
+      {"syscall_enter", &syscall_enter_ids_},
+      {"syscall_exit", &syscall_exit_ids_},
+      {"block_rq_issue", &block_rq_issue_ids_},
+      {"block_rq_complete", &block_rq_complete_ids_},
+      {"cpu_frequency", &cpu_frequency_ids_},
+      {"cpu_idle", &cpu_idle_ids_},
+      {"major_page_fault", &major_page_fault_ids_},
+      {"minor_page_fault", &minor_page_fault_ids_},
+      {"mmap_syscall", &mmap_syscall_ids_},
+      {"munmap_syscall", &munmap_syscall_ids_},
+  };
+}
+
+void TracerThread::Replay(PerfRecording recording) {
+  FAIL_IF(listener_ == nullptr, "No listener set");
+
+  Reset();
+  replaying_ = true;
+  bundled_files_directory_ = std::move(recording.bundled_files_directory);
+  const PerfRecordingHeader& header = recording.header;
+
+  context_switch_manager_.Reset(header.cpu_count());
+  scheduling_slice_counters_manager_.Reset(header.cpu_count());
+  RestoreStreamIds(header);
+  for (const PerfRecordingHeader::RingBuffer& recorded_ring_buffer :
+       header.ring_buffers()) {
+    if (recorded_ring_buffer.ring_buffer_class() >= RING_BUFFER_CLASS_COUNT) {
+      ERROR("Perf recording with unknown ring buffer class %u",
+            recorded_ring_buffer.ring_buffer_class());
+      continue;
+    }
+    const int fd = recorded_ring_buffer.file_descriptor();
+    std::vector<char> records;
+    auto records_it = recording.records_by_fd.find(fd);
+    if (records_it != recording.records_by_fd.end()) {
+      records = std::move(records_it->second);
+    }
+    ring_buffers_.emplace_back(PerfEventRingBuffer::FromRecords(
+        fd, recorded_ring_buffer.name(), std::move(records)));
+    AddRingBufferFd(
+        fd, recorded_ring_buffer.cpu(),
+        static_cast<RingBufferClass>(recorded_ring_buffer.ring_buffer_class()));
+  }
+  recording.records_by_fd.clear();
+
+  if (trace_gpu_driver_) {
+    InitGpuTracepointEventProcessor();
+  }
+  absl::flat_hash_map<pid_t, std::string> initial_maps_per_pid;
+  for (const PerfRecordingHeader::InitialMaps& initial_maps :
+       header.initial_maps()) {
+    initial_maps_per_pid.emplace(
+        initial_maps.pid(),
+        RemapMapsToBundledFiles(initial_maps.maps(), bundled_files_directory_));
+  }
+  InitUprobesEventProcessor(initial_maps_per_pid);
+
+  InitRingBufferReaders();
+  stats_.Reset();
   std::thread deferred_events_thread(&TracerThread::ProcessDeferredEvents,
                                      this);
+  RunRingBufferReaders(std::make_shared<std::atomic<bool>>(false));
+  FinishProcessingEvents(&deferred_events_thread);
+
+  ring_buffers_.clear();
+  SlabAllocator::ReleaseAllMemoryIfUnused();
+  replaying_ = false;
+}
+
+uint32_t TracerThread::ComputeWakeupWatermark(
+    uint64_t ring_buffer_size_kb) const {
+  if (!ring_buffer_wakeups_) {
+    return 0;
+  }
+  return static_cast<uint32_t>(1024 * ring_buffer_size_kb /
+                               RING_BUFFER_WAKEUP_WATERMARK_DIVISOR);
+}
+
+void TracerThread::InitRingBufferReaders() {
+  std::vector<int32_t> cpus;
+  for (const PerfEventRingBuffer& ring_buffer : ring_buffers_) {
+    CHECK(cpu_per_ring_buffer_fd_.contains(ring_buffer.GetFileDescriptor()));
+    cpus.push_back(cpu_per_ring_buffer_fd_.at(ring_buffer.GetFileDescriptor()));
+  }
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+
+  // There is no point in having more readers than CPUs with ring buffers.
+  size_t reader_count = std::min<size_t>(
+      std::clamp<uint32_t>(ring_buffer_reader_thread_count_, 1,
+                           MAX_RING_BUFFER_READER_THREAD_COUNT),
+      std::max<size_t>(cpus.size(), 1));
+  for (size_t i = 0; i < reader_count; ++i) {
+    auto reader = std::make_unique<RingBufferReader>();
+    reader->index = i;
+    ring_buffer_readers_.emplace_back(std::move(reader));
+  }
+
+  // The readers of a node are consecutive, and take its CPUs in turns.
+  std::vector<int> numa_node_by_cpu = GetNumaNodeByCpu();
+  std::vector<int> numa_nodes = numa_node_by_cpu;
+  numa_nodes.erase(std::remove(numa_nodes.begin(), numa_nodes.end(), -1),
+                   numa_nodes.end());
+  std::sort(numa_nodes.begin(), numa_nodes.end());
+  numa_nodes.erase(std::unique(numa_nodes.begin(), numa_nodes.end()),
+                   numa_nodes.end());
+  if (numa_nodes.size() > 1) {
+    numa_node_by_cpu_ = std::move(numa_node_by_cpu);
+  }
+  std::vector<std::vector<int>> cpus_per_reader =
+      DistributeCpusByNumaNode(cpus, numa_node_by_cpu_, reader_count);
+  absl::flat_hash_map<int32_t, RingBufferReader*> reader_per_cpu;
+  for (size_t i = 0; i < reader_count; ++i) {
+    RingBufferReader* reader = ring_buffer_readers_[i].get();
+    reader->cpus = std::move(cpus_per_reader[i]);
+    for (int32_t cpu : reader->cpus) {
+      reader_per_cpu.emplace(cpu, reader);
+    }
+    if (!reader->cpus.empty()) {
+      reader->numa_node = GetNumaNode(reader->cpus[0]);
+      for (int32_t cpu : reader->cpus) {
+        if (GetNumaNode(cpu) != reader->numa_node) {
+          reader->numa_node = -1;
+          break;
+        }
+      }
+    }
+  }
+  for (PerfEventRingBuffer& ring_buffer : ring_buffers_) {
+    int32_t cpu = cpu_per_ring_buffer_fd_.at(ring_buffer.GetFileDescriptor());
+    reader_per_cpu.at(cpu)->ring_buffers.push_back(&ring_buffer);
+    // Until a ring buffer has been read, its events could be older than any.
+    uprobes_event_processor_->UpdateWatermark(ring_buffer.GetFileDescriptor(),
+                                              0);
+  }
+
+  if (numa_node_by_cpu_.empty()) {
+    LOG("Reading from %lu ring buffers with %lu thread(s)",
+        ring_buffers_.size(), reader_count);
+  } else {
+    LOG("Reading from %lu ring buffers with %lu thread(s), on %lu NUMA nodes",
+        ring_buffers_.size(), reader_count, numa_nodes.size());
+  }
+}
+
+int TracerThread::GetNumaNode(int32_t cpu) const {
+  if (cpu < 0 || static_cast<size_t>(cpu) >= numa_node_by_cpu_.size()) {
+    return -1;
+  }
+  return numa_node_by_cpu_[cpu];
+}
+
+void TracerThread::RunRingBufferReaders(
+    const std::shared_ptr<std::atomic<bool>>& exit_requested) {
+  if (ring_buffer_readers_.size() == 1) {
+    RunRingBufferReader(ring_buffer_readers_[0].get(), exit_requested);
+    return;
+  }
+  std::vector<std::thread> ring_buffer_reader_threads;
+  for (std::unique_ptr<RingBufferReader>& reader : ring_buffer_readers_) {
+    ring_buffer_reader_threads.emplace_back(&TracerThread::RunRingBufferReader,
+                                            this, reader.get(), exit_requested);
+  }
+  for (std::thread& thread : ring_buffer_reader_threads) {
+    thread.join();
+  }
+}
+
+void TracerThread::FinishProcessingEvents(std::thread* deferred_events_thread) {
+  deferred_events_->Close();
+  deferred_events_thread->join();
+  uprobes_event_processor_->ProcessAllEvents();
+  // This waits for the stack samples that are still being unwound.
+  uprobes_event_processor_.reset();
+  if (gpu_event_processor_ != nullptr) {
+    LOG("GPU jobs: %lu complete, %lu expired incomplete, %lu pending",
+        gpu_event_processor_->GetCompleteJobCount(),
+        gpu_event_processor_->GetExpiredJobCount(),
+        gpu_event_processor_->GetPendingJobCount());
+  }
+}
+
+void TracerThread::RunRingBufferReader(
+    RingBufferReader* reader,
+    const std::shared_ptr<std::atomic<bool>>& exit_requested) {
+  if (ring_buffer_readers_.size() > 1) {
+    std::string thread_name =
+        absl::StrFormat("Tracer.Read.%lu", reader->index);
+    pthread_setname_np(pthread_self(), thread_name.c_str());
+    if ((pin_ring_buffer_reader_threads_ || reader->numa_node >= 0) &&
+        !replaying_) {
+      PinRingBufferReader(*reader);
+    }
+  }
+  reader->last_thread_cpu_time_ns = ThreadCpuTimeNs();
+
+  if (flight_recorder_ || replaying_) {
+    ReadRingBufferSnapshots(reader);
+  } else if (ring_buffer_wakeups_) {
+    WaitForAndReadRingBuffers(reader, exit_requested);
+  } else {
+    PollAndReadRingBuffers(reader, exit_requested);
+  }
+  SendSchedulingSlices(reader);
+}
+
+void TracerThread::PinRingBufferReader(const RingBufferReader& reader) {
+  std::vector<int> cpus;
+  if (pin_ring_buffer_reader_threads_) {
+    cpus = reader.cpus;
+  } else {
+    // Within the cpus the service threads may have been pinned to.
+    for (int cpu : GetThreadCpuAffinity()) {
+      if (GetNumaNode(cpu) == reader.numa_node) {
+        cpus.push_back(cpu);
+      }
+    }
+    if (cpus.empty()) {
+      return;
+    }
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int cpu : cpus) {
+    CPU_SET(cpu, &cpu_set);
+  }
+  int error = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+  if (error != 0) {
+    ERROR("Pinning ring buffer reader %lu: %s", reader.index,
+          SafeStrerror(error));
+  }
+}
+
+std::vector<int32_t> TracerThread::PinServiceThreads(
+    const std::vector<int32_t>& all_cpus,
+    const std::vector<int32_t>& target_cpus) {
+  std::optional<std::vector<int32_t>> service_cpus =
+      ComputeServiceCpus(service_cpus_, all_cpus.size(), target_cpus);
+  if (!service_cpus.has_value()) {
+    return {};
+  }
+  if (service_cpus->empty()) {
+    if (service_cpus_.empty()) {
+      ERROR(
+          "Not pinning the threads of the service: there is no cpu outside "
+          "the cpusets of the captured processes");
+    } else {
+      ERROR("Not pinning the threads of the service: no cpu in \"%s\"",
+            service_cpus_);
+    }
+    return {};
+  }
+  std::vector<int32_t> shared_cpus;
+  std::set_intersection(service_cpus->begin(), service_cpus->end(),
+                        target_cpus.begin(), target_cpus.end(),
+                        std::back_inserter(shared_cpus));
+  if (!shared_cpus.empty()) {
+    LOG("Warning: the threads of the service share cpus %s with the captured "
+        "processes",
+        absl::StrJoin(shared_cpus, ","));
+  }
+
+  std::vector<int32_t> cpus_before_pinning = GetThreadCpuAffinity();
+  if (cpus_before_pinning.empty()) {
+    return {};
+  }
+  if (!SetProcessCpuAffinity(*service_cpus)) {
+    ERROR("Could not pin all the threads of the service");
+    SetProcessCpuAffinity(cpus_before_pinning);
+    return {};
+  }
+  LOG("Pinned the threads of the service to cpus %s",
+      absl::StrJoin(*service_cpus, ","));
+  return cpus_before_pinning;
+}
+
+void TracerThread::UpdateReaderCpuTime(RingBufferReader* reader) {
+  uint64_t thread_cpu_time_ns = ThreadCpuTimeNs();
+  stats_.reader_cpu_time_ns +=
+      thread_cpu_time_ns - reader->last_thread_cpu_time_ns;
+  reader->last_thread_cpu_time_ns = thread_cpu_time_ns;
+}
+
+void TracerThread::PollAndReadRingBuffers(
+    RingBufferReader* reader,
+    const std::shared_ptr<std::atomic<bool>>& exit_requested) {
+  bool last_iteration_saw_events = false;
+  std::vector<bool> to_read(reader->ring_buffers.size());
 
   while (!(*exit_requested)) {
     ORBIT_SCOPE("Tracer Iteration");
 
     if (!last_iteration_saw_events) {
+      UpdateReaderCpuTime(reader);
       // Periodically print event statistics.
-      PrintStatsIfTimerElapsed();
+      if (reader->index == 0) {
+        PrintStatsIfTimerElapsed();
+      }
 
       // Sleep if there was no new event in the last iteration so that we are
       // not constantly polling. Don't sleep so long that ring buffers overflow.
       // TODO: Refine this sleeping pattern, possibly using exponential backoff.
       {
         ORBIT_SCOPE("Sleep");
+        uint64_t sleep_begin_ns = MonotonicTimestampNs();
         usleep(IDLE_TIME_ON_EMPTY_RING_BUFFERS_US);
+        stats_.idle_time_ns += MonotonicTimestampNs() - sleep_begin_ns;
+        ++stats_.wakeup_count;
       }
     }
 
-    last_iteration_saw_events = false;
-
     // Read and process events from all ring buffers. In order to ensure that no
-    // buffer is read constantly while others overflow, we schedule the reading
-    // using round-robin like scheduling.
-    for (PerfEventRingBuffer& ring_buffer : ring_buffers_) {
-      if (*exit_requested) {
-        break;
-      }
+    // buffer is read constantly while others overflow, we read a batch from
+    // each in turn, from the fullest to the emptiest.
+    std::fill(to_read.begin(), to_read.end(), true);
+    last_iteration_saw_events =
+        ReadRingBuffersByFill(reader, &to_read, exit_requested) <
+        to_read.size();
+    SendSchedulingSlices(reader);
+  }
+}
 
-      // Read up to ROUND_ROBIN_POLLING_BATCH_SIZE (5) new events.
-      // TODO: Some event types (e.g., stack samples) have a much longer
-      //  processing time but are less frequent than others (e.g., context
-      //  switches). Take this into account in our scheduling algorithm.
-      for (int32_t read_from_this_buffer = 0;
-           read_from_this_buffer < ROUND_ROBIN_POLLING_BATCH_SIZE;
-           ++read_from_this_buffer) {
-        if (*exit_requested) {
-          break;
-        }
-        if (!ring_buffer.HasNewData()) {
-          break;
-        }
+void TracerThread::WaitForAndReadRingBuffers(
+    RingBufferReader* reader,
+    const std::shared_ptr<std::atomic<bool>>& exit_requested) {
+  const std::vector<PerfEventRingBuffer*>& ring_buffers = reader->ring_buffers;
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd == -1) {
+    ERROR("epoll_create1: %s", SafeStrerror(errno));
+    PollAndReadRingBuffers(reader, exit_requested);
+    return;
+  }
 
-        last_iteration_saw_events = true;
-        perf_event_header header;
-        ring_buffer.ReadHeader(&header);
-
-        // perf_event_header::type contains the type of record, e.g.,
-        // PERF_RECORD_SAMPLE, PERF_RECORD_MMAP, etc., defined in enum
-        // perf_event_type in linux/perf_event.h.
-        switch (header.type) {
-          case PERF_RECORD_SWITCH:
-            // Note: as we are recording context switches on CPUs and not on
-            // threads, we don't expect this type of record.
-            ERROR(
-                "Unexpected PERF_RECORD_SWITCH in ring buffer '%s' (only "
-                "PERF_RECORD_SWITCH_CPU_WIDE are expected)",
-                ring_buffer.GetName().c_str());
-            break;
-          case PERF_RECORD_SWITCH_CPU_WIDE:
-            ProcessContextSwitchCpuWideEvent(header, &ring_buffer);
-            break;
-          case PERF_RECORD_FORK:
-            ProcessForkEvent(header, &ring_buffer);
-            break;
-          case PERF_RECORD_EXIT:
-            ProcessExitEvent(header, &ring_buffer);
-            break;
-          case PERF_RECORD_MMAP:
-            ProcessMmapEvent(header, &ring_buffer);
-            break;
-          case PERF_RECORD_SAMPLE:
-            ProcessSampleEvent(header, &ring_buffer);
-            break;
-          case PERF_RECORD_LOST:
-            ProcessLostEvent(header, &ring_buffer);
-            break;
-          case PERF_RECORD_THROTTLE:
-            // We don't use throttle/unthrottle events, but log them separately
-            // from the default 'Unexpected perf_event_header::type' case.
-            LOG("PERF_RECORD_THROTTLE in ring buffer '%s'",
-                ring_buffer.GetName().c_str());
-            ring_buffer.SkipRecord(header);
-            break;
-          case PERF_RECORD_UNTHROTTLE:
-            LOG("PERF_RECORD_UNTHROTTLE in ring buffer '%s'",
-                ring_buffer.GetName().c_str());
-            ring_buffer.SkipRecord(header);
-            break;
-          default:
-            ERROR("Unexpected perf_event_header::type in ring buffer '%s': %u",
-                  ring_buffer.GetName().c_str(), header.type);
-            ring_buffer.SkipRecord(header);
-            break;
-        }
+  for (size_t i = 0; i < ring_buffers.size(); ++i) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = i;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ring_buffers[i]->GetFileDescriptor(),
+                  &event) != 0) {
+      ERROR("epoll_ctl for ring buffer '%s': %s",
+            ring_buffers[i]->GetName().c_str(), SafeStrerror(errno));
+      close(epoll_fd);
+      PollAndReadRingBuffers(reader, exit_requested);
+      return;
+    }
+  }
+
+  // Ring buffers that epoll reported as readable (or that we are checking
+  // because of the periodic full pass) and that we haven't emptied yet. As the
+  // kernel only reports a ring buffer again after it crosses the watermark
+  // again, a ring buffer stays in this set until we have read all its records.
+  std::vector<bool> ring_buffers_to_read(ring_buffers.size(), false);
+  size_t ring_buffers_to_read_count = 0;
+  // epoll_wait requires maxevents to be greater than zero.
+  std::vector<epoll_event> ready_events(
+      std::max<size_t>(ring_buffers.size(), 1));
+  uint64_t last_full_pass_ns = MonotonicTimestampNs();
+
+  while (!(*exit_requested)) {
+    ORBIT_SCOPE("Tracer Iteration");
+
+    int timeout_ms = 0;
+    if (ring_buffers_to_read_count == 0) {
+      UpdateReaderCpuTime(reader);
+      // Periodically print event statistics.
+      if (reader->index == 0) {
+        PrintStatsIfTimerElapsed();
       }
+      timeout_ms = RING_BUFFERS_WAKEUP_TIMEOUT_MS;
     }
+
+    int ready_count;
+    {
+      ORBIT_SCOPE("Wait");
+      uint64_t wait_begin_ns = MonotonicTimestampNs();
+      ready_count =
+          epoll_wait(epoll_fd, ready_events.data(),
+                     static_cast<int>(ready_events.size()), timeout_ms);
+      if (timeout_ms > 0) {
+        stats_.idle_time_ns += MonotonicTimestampNs() - wait_begin_ns;
+      }
+    }
+    if (ready_count == -1 && errno != EINTR) {
+      ERROR("epoll_wait: %s", SafeStrerror(errno));
+      break;
+    }
+    if (ready_count > 0) {
+      ++stats_.wakeup_count;
+    }
+    for (int i = 0; i < ready_count; ++i) {
+      size_t ring_buffer_index = ready_events[i].data.u64;
+      if (!ring_buffers_to_read[ring_buffer_index]) {
+        ring_buffers_to_read[ring_buffer_index] = true;
+        ++ring_buffers_to_read_count;
+      }
+    }
+
+    // Ring buffers that receive records slowly might not reach the watermark
+    // for a long time. But PerfEventProcessor2 requires events to be read
+    // within PROCESSING_DELAY_MS, hence periodically check all ring buffers.
+    uint64_t now_ns = MonotonicTimestampNs();
+    if (now_ns - last_full_pass_ns >=
+        RING_BUFFERS_WAKEUP_TIMEOUT_MS * NS_PER_MILLISECOND) {
+      last_full_pass_ns = now_ns;
+      std::fill(ring_buffers_to_read.begin(), ring_buffers_to_read.end(),
+                true);
+      ring_buffers_to_read_count = ring_buffers_to_read.size();
+    }
+
+    // A batch from each ring buffer to read, like in PollAndReadRingBuffers.
+    ring_buffers_to_read_count -=
+        ReadRingBuffersByFill(reader, &ring_buffers_to_read, exit_requested);
+    SendSchedulingSlices(reader);
   }
 
-  // Finish processing all deferred events.
-  stop_deferred_thread_ = true;
-  deferred_events_thread.join();
-  uprobes_event_processor_->ProcessAllEvents();
+  close(epoll_fd);
+}
 
-  // Stop recording.
-  for (int fd : tracing_fds_) {
-    perf_event_disable(fd);
+size_t TracerThread::ReadRingBuffersByFill(
+    RingBufferReader* reader, std::vector<bool>* to_read,
+    const std::shared_ptr<std::atomic<bool>>& exit_requested) {
+  const std::vector<PerfEventRingBuffer*>& ring_buffers = reader->ring_buffers;
+  CHECK(to_read->size() == ring_buffers.size());
+  std::vector<std::pair<double, size_t>>& read_order = reader->read_order;
+  read_order.clear();
+  for (size_t i = 0; i < ring_buffers.size(); ++i) {
+    if (!(*to_read)[i]) {
+      continue;
+    }
+    PerfEventRingBuffer* ring_buffer = ring_buffers[i];
+    read_order.emplace_back(static_cast<double>(ring_buffer->GetFillBytes()) /
+                                ring_buffer->GetSizeBytes(),
+                            i);
   }
+  // Fullest first, then in order.
+  std::sort(read_order.begin(), read_order.end(),
+            [](const std::pair<double, size_t>& lhs,
+               const std::pair<double, size_t>& rhs) {
+              if (lhs.first != rhs.first) return lhs.first > rhs.first;
+              return lhs.second < rhs.second;
+            });
+
+  size_t emptied_count = 0;
+  for (const auto& [fill_ratio, index] : read_order) {
+    if (*exit_requested) {
+      break;
+    }
+    if (!ReadRingBufferBatch(ring_buffers[index], reader, exit_requested,
+                             ComputeRingBufferBatchSize(fill_ratio))) {
+      (*to_read)[index] = false;
+      ++emptied_count;
+    }
+  }
+  return emptied_count;
+}
 
-  // Close the ring buffers.
-  ring_buffers_.clear();
+int32_t TracerThread::ComputeRingBufferBatchSize(double fill_ratio) {
+  fill_ratio = std::clamp(fill_ratio, 0.0, 1.0);
+  return ROUND_ROBIN_POLLING_BATCH_SIZE +
+         static_cast<int32_t>(
+             fill_ratio *
+             (FULL_RING_BUFFER_BATCH_SIZE - ROUND_ROBIN_POLLING_BATCH_SIZE));
+}
 
-  // Close the file descriptors.
-  for (int fd : tracing_fds_) {
-    close(fd);
+bool TracerThread::ReadRingBufferBatch(
+    PerfEventRingBuffer* ring_buffer, RingBufferReader* reader,
+    const std::shared_ptr<std::atomic<bool>>& exit_requested,
+    int32_t max_records) {
+  // Read up to max_records new events.
+  // TODO: Some event types (e.g., stack samples) have a much longer
+  //  processing time but are less frequent than others (e.g., context
+  //  switches). Take this into account in our scheduling algorithm.
+  bool saw_events = false;
+  bool drained = false;
+  int32_t read_from_this_buffer = 0;
+  ring_buffer->BeginBatch();
+  for (; read_from_this_buffer < max_records; ++read_from_this_buffer) {
+    if (*exit_requested) {
+      break;
+    }
+    if (!ring_buffer->HasNewData()) {
+      drained = true;
+      break;
+    }
+
+    saw_events = true;
+    perf_event_header header;
+    ring_buffer->ReadHeader(&header);
+
+    // perf_event_header::type contains the type of record, e.g.,
+    // PERF_RECORD_SAMPLE, PERF_RECORD_MMAP2, etc., defined in enum
+    // perf_event_type in linux/perf_event.h.
+    switch (header.type) {
+      case PERF_RECORD_SWITCH:
+        // Note: as we are recording context switches on CPUs and not on
+        // threads, we don't expect this type of record.
+        ERROR(
+            "Unexpected PERF_RECORD_SWITCH in ring buffer '%s' (only "
+            "PERF_RECORD_SWITCH_CPU_WIDE are expected)",
+            ring_buffer->GetName().c_str());
+        break;
+      case PERF_RECORD_SWITCH_CPU_WIDE:
+        ProcessContextSwitchCpuWideEvent(header, ring_buffer, reader);
+        break;
+      case PERF_RECORD_FORK:
+        ProcessForkEvent(header, ring_buffer);
+        break;
+      case PERF_RECORD_EXIT:
+        ProcessExitEvent(header, ring_buffer);
+        break;
+      case PERF_RECORD_MMAP2:
+        ProcessMmapEvent(header, ring_buffer);
+        break;
+      case PERF_RECORD_SAMPLE:
+        ProcessSampleEvent(header, ring_buffer);
+        break;
+      case PERF_RECORD_LOST:
+        ProcessLostEvent(header, ring_buffer);
+        break;
+      case PERF_RECORD_THROTTLE:
+        // We don't use throttle/unthrottle events, but log them separately
+        // from the default 'Unexpected perf_event_header::type' case.
+        LOG("PERF_RECORD_THROTTLE in ring buffer '%s'",
+            ring_buffer->GetName().c_str());
+        ring_buffer->SkipRecord(header);
+        break;
+      case PERF_RECORD_UNTHROTTLE:
+        LOG("PERF_RECORD_UNTHROTTLE in ring buffer '%s'",
+            ring_buffer->GetName().c_str());
+        ring_buffer->SkipRecord(header);
+        break;
+      default:
+        ERROR("Unexpected perf_event_header::type in ring buffer '%s': %u",
+              ring_buffer->GetName().c_str(), header.type);
+        ring_buffer->SkipRecord(header);
+        break;
+    }
+  }
+  ring_buffer->EndBatch();
+  if (!numa_node_by_cpu_.empty() && !replaying_ && read_from_this_buffer > 0) {
+    // The records were read from this CPU, or from another one if the reader
+    // migrated meanwhile, which pinning makes unlikely.
+    stats_.numa_read_record_count += read_from_this_buffer;
+    if (GetNumaNode(sched_getcpu()) !=
+        GetNumaNode(
+            cpu_per_ring_buffer_fd_.at(ring_buffer->GetFileDescriptor()))) {
+      stats_.cross_numa_node_read_record_count += read_from_this_buffer;
+    }
   }
+  // After the batch, as this reads the head again.
+  if (drained) {
+    DeferRingBufferWatermark(ring_buffer, reader);
+  }
+  return saw_events;
+}
+
+void TracerThread::DeferRingBufferWatermark(PerfEventRingBuffer* ring_buffer,
+                                            RingBufferReader* reader) {
+  // Take the timestamp before checking again that the ring buffer is empty:
+  // the records written after the check have a later timestamp, save for the
+  // slack.
+  uint64_t now_ns = MonotonicTimestampNs();
+  if (ring_buffer->HasNewData()) {
+    return;
+  }
+  uint64_t watermark_ns = now_ns - RING_BUFFER_WATERMARK_SLACK_NS;
+  int fd = ring_buffer->GetFileDescriptor();
+  uint64_t& last_watermark_ns = reader->last_watermark_ns_by_fd[fd];
+  if (watermark_ns < last_watermark_ns + RING_BUFFER_WATERMARK_PERIOD_NS) {
+    return;
+  }
+  last_watermark_ns = watermark_ns;
+  deferred_events_->Push(DeferredEvent{fd, watermark_ns, nullptr});
 }
 
 void TracerThread::ProcessContextSwitchCpuWideEvent(
-    const perf_event_header& header, PerfEventRingBuffer* ring_buffer) {
-  SystemWideContextSwitchPerfEvent event;
-  ring_buffer->ConsumeRecord(header, &event.ring_buffer_record);
-  pid_t pid = event.GetPid();
-  pid_t tid = event.GetTid();
-  uint16_t cpu = static_cast<uint16_t>(event.GetCpu());
-  uint64_t time = event.GetTimestamp();
+    const perf_event_header& header, PerfEventRingBuffer* ring_buffer,
+    RingBufferReader* reader) {
+  // Context switches are by far the most frequent records: decode the few
+  // fields needed directly, without a SystemWideContextSwitchPerfEvent.
+  // The records of a cpu come in order from its ring buffer, so they don't
+  // need to go through a PerfEventProcessor either.
+  CHECK(header.size == sizeof(perf_event_context_switch_cpu_wide));
+  ContextSwitchCpuWideRecordView record{ring_buffer->GetRecordAtTail(header)};
+  pid_t pid = record.GetPid();
+  pid_t tid = record.GetTid();
+  uint16_t cpu = record.GetCpu();
+  uint64_t time = record.GetTimestamp();
+  // The switch-ins of the threads of pids_ end their off-CPU time: those go
+  // through the PerfEventProcessor, in order with the off-CPU callchains.
+  const bool is_switch_in = (header.misc & PERF_RECORD_MISC_SWITCH_OUT) == 0;
+  if (trace_off_cpu_ && is_switch_in && tid != 0 && IsCapturedPid(pid)) {
+    auto event = std::make_unique<SystemWideContextSwitchPerfEvent>();
+    ring_buffer->ConsumeRecord(header, &event->ring_buffer_record);
+    event->SetOriginFileDescriptor(ring_buffer->GetFileDescriptor());
+    DeferEvent(std::move(event));
+  } else {
+    ring_buffer->SkipRecord(header);
+  }
 
   // Switches with pid/tid 0 are associated with idle state, discard them.
   if (tid != 0) {
-    // TODO: Consider deferring context switches.
-    if (event.IsSwitchOut()) {
+    if ((header.misc & PERF_RECORD_MISC_SWITCH_OUT) != 0) {
       // Careful: when a switch out is caused by the thread exiting, pid and tid
       // have value -1.
       std::optional<SchedulingSlice> scheduling_slice =
           context_switch_manager_.ProcessContextSwitchOut(pid, tid, cpu, time);
       if (scheduling_slice.has_value()) {
-        listener_->OnSchedulingSlice(std::move(scheduling_slice.value()));
+        reader->scheduling_slices.emplace_back(
+            std::move(scheduling_slice.value()));
       }
     } else {
       context_switch_manager_.ProcessContextSwitchIn(pid, tid, cpu, time);
@@ -711,12 +2526,58 @@ void TracerThread::ProcessContextSwitchCpuWideEvent(
   ++stats_.sched_switch_count;
 }
 
+void TracerThread::SendSchedulingSlices(RingBufferReader* reader) {
+  if (reader->scheduling_slices.empty()) {
+    return;
+  }
+  listener_->OnSchedulingSlices(std::move(reader->scheduling_slices));
+  reader->scheduling_slices.clear();
+}
+
+void TracerThread::ProcessSchedSwitchCountersEvent(
+    const perf_event_header& header, PerfEventRingBuffer* ring_buffer) {
+  // As for context switches, the records of a cpu come in order from its ring
+  // buffer and are processed directly.
+  CHECK(header.size == sizeof(perf_event_sched_switch_counters_sample));
+  perf_event_sched_switch_counters_sample sample;
+  ring_buffer->ConsumeRecord(header, &sample);
+  CHECK(sample.nr == SCHED_SWITCH_HARDWARE_COUNTERS.size() + 1);
+
+  // The sample is recorded in the context of the thread being switched out.
+  // The counters need to be read at every sched_switch, also for the other
+  // processes, to compute the deltas for the slices of pids_.
+  std::optional<SchedulingSliceCounters> slice_counters =
+      scheduling_slice_counters_manager_.ProcessSchedSwitch(
+          sample.sample_id.pid, sample.sample_id.tid,
+          static_cast<uint16_t>(sample.sample_id.cpu), sample.sample_id.time,
+          {sample.sched_switch_count, sample.cycles, sample.instructions,
+           sample.cache_misses, sample.branch_misses});
+  if (slice_counters.has_value() && IsCapturedPid(slice_counters->pid())) {
+    listener_->OnSchedulingSliceCounters(std::move(slice_counters.value()));
+  }
+}
+
+void TracerThread::ProcessSchedWakeupEvent(const perf_event_header& header,
+                                           PerfEventRingBuffer* ring_buffer) {
+  // Wakeups are about as frequent as context switches: only the few fields
+  // needed are read, without a TracepointPerfEvent. They are reported for all
+  // threads, as the pid of the wakee is not in the tracepoint.
+  SchedWakeupRecordView record{ring_buffer->GetRecordAtTail(header)};
+  ThreadWakeup thread_wakeup;
+  thread_wakeup.set_wakee_tid(record.GetWakeeTid());
+  thread_wakeup.set_waker_tid(record.GetTid());
+  thread_wakeup.set_timestamp_ns(record.GetTimestamp());
+  ring_buffer->SkipRecord(header);
+  listener_->OnThreadWakeup(std::move(thread_wakeup));
+}
+
 void TracerThread::ProcessForkEvent(const perf_event_header& header,
                                     PerfEventRingBuffer* ring_buffer) {
-  ForkPerfEvent event;
-  ring_buffer->ConsumeRecord(header, &event.ring_buffer_record);
+  ForkExitRecordView record{ring_buffer->GetRecordAtTail(header)};
+  const pid_t pid = record.GetPid();
+  ring_buffer->SkipRecord(header);
 
-  if (event.GetPid() != pid_) {
+  if (!IsCapturedPid(pid)) {
     return;
   }
 
@@ -726,10 +2587,11 @@ void TracerThread::ProcessForkEvent(const perf_event_header& header,
 
 void TracerThread::ProcessExitEvent(const perf_event_header& header,
                                     PerfEventRingBuffer* ring_buffer) {
-  ExitPerfEvent event;
-  ring_buffer->ConsumeRecord(header, &event.ring_buffer_record);
+  ForkExitRecordView record{ring_buffer->GetRecordAtTail(header)};
+  const pid_t pid = record.GetPid();
+  ring_buffer->SkipRecord(header);
 
-  if (event.GetPid() != pid_) {
+  if (!IsCapturedPid(pid)) {
     return;
   }
 
@@ -739,16 +2601,30 @@ void TracerThread::ProcessExitEvent(const perf_event_header& header,
 void TracerThread::ProcessMmapEvent(const perf_event_header& header,
                                     PerfEventRingBuffer* ring_buffer) {
   pid_t pid = ReadMmapRecordPid(ring_buffer);
-  ring_buffer->SkipRecord(header);
-
-  if (pid != pid_) {
+  if (!IsSampledPid(pid)) {
+    ring_buffer->SkipRecord(header);
     return;
   }
 
-  // There was a call to mmap with PROT_EXEC, hence refresh the maps.
-  // This should happen rarely.
-  auto event =
-      std::make_unique<MapsPerfEvent>(MonotonicTimestampNs(), ReadMaps(pid_));
+  // There was a call to mmap with PROT_EXEC: the record contains the new map,
+  // which UprobesUnwindingVisitor adds to the maps it already has.
+  std::unique_ptr<MmapPerfEvent> event =
+      ConsumeMmapPerfEvent(ring_buffer, header);
+  if ((event->GetProt() & PROT_EXEC) != 0 &&
+      event->GetFilename() != "//anon") {
+    // As soon as the record is read, as the file could be gone by the end of
+    // the capture.
+    if (perf_recording_writer_ != nullptr) {
+      perf_recording_writer_->BundleFile(event->GetFilename());
+    }
+    if (replaying_) {
+      std::optional<std::string> bundled_path =
+          FindBundledFile(bundled_files_directory_, event->GetFilename());
+      if (bundled_path.has_value()) {
+        event->SetFilename(std::move(bundled_path.value()));
+      }
+    }
+  }
   event->SetOriginFileDescriptor(ring_buffer->GetFileDescriptor());
   DeferEvent(std::move(event));
 }
@@ -767,119 +2643,358 @@ void TracerThread::ProcessSampleEvent(const perf_event_header& header,
   bool is_dma_fence_signaled_event =
       dma_fence_signaled_ids_.contains(stream_id);
   bool is_callchain_sample = callchain_sampling_ids_.contains(stream_id);
-  CHECK(is_uprobe + is_uretprobe + is_stack_sample + is_task_newtask +
-            is_task_rename + is_amdgpu_cs_ioctl_event +
-            is_amdgpu_sched_run_job_event + is_dma_fence_signaled_event +
-            is_callchain_sample <=
-        1);
+  bool is_hybrid_sample = hybrid_sampling_ids_.contains(stream_id);
+  bool is_lbr_sample = lbr_sampling_ids_.contains(stream_id);
+  bool is_sched_switch_counters =
+      sched_switch_counters_ids_.contains(stream_id);
+  bool is_sched_wakeup = sched_wakeup_ids_.contains(stream_id);
+  bool is_off_cpu_callchain = off_cpu_callchain_ids_.contains(stream_id);
+  bool is_futex_wait = futex_wait_ids_.contains(stream_id);
+  bool is_futex_exit = futex_exit_ids_.contains(stream_id);
+  bool is_allocation = allocation_ids_.contains(stream_id);
+  bool is_syscall_enter = syscall_enter_ids_.contains(stream_id);
+  bool is_syscall_exit = syscall_exit_ids_.contains(stream_id);
+  bool is_block_rq_issue = block_rq_issue_ids_.contains(stream_id);
+  bool is_block_rq_complete = block_rq_complete_ids_.contains(stream_id);
+  bool is_cpu_frequency = cpu_frequency_ids_.contains(stream_id);
+  bool is_cpu_idle = cpu_idle_ids_.contains(stream_id);
+  bool is_major_page_fault = major_page_fault_ids_.contains(stream_id);
+  bool is_minor_page_fault = minor_page_fault_ids_.contains(stream_id);
+  bool is_mmap_syscall = mmap_syscall_ids_.contains(stream_id);
+  bool is_munmap_syscall = munmap_syscall_ids_.contains(stream_id);
+  const int event_kind_count =
+      is_uprobe + is_uretprobe + is_stack_sample + is_task_newtask +
+      is_task_rename + is_amdgpu_cs_ioctl_event +
+      is_amdgpu_sched_run_job_event + is_dma_fence_signaled_event +
+      is_callchain_sample + is_hybrid_sample + is_lbr_sample +
+      is_sched_switch_counters + is_sched_wakeup + is_off_cpu_callchain +
+      is_futex_wait + is_futex_exit + is_allocation + is_syscall_enter +
+      is_syscall_exit + is_block_rq_issue + is_block_rq_complete +
+      is_cpu_frequency + is_cpu_idle + is_major_page_fault +
+      is_minor_page_fault + is_mmap_syscall + is_munmap_syscall;
+  CHECK(event_kind_count <= 1);
+  const Function* added_function = nullptr;
+  const absl::flat_hash_set<pid_t>* excluded_tids = nullptr;
+  if (event_kind_count == 0) {
+    added_function = FindAddedFunction(stream_id, &is_uretprobe);
+    is_uprobe = added_function != nullptr && !is_uretprobe;
+    if (added_function == nullptr) {
+      is_callchain_sample =
+          FindAddedCallchainSampling(stream_id, &excluded_tids);
+    }
+  }
 
   int fd = ring_buffer->GetFileDescriptor();
 
+  if (is_stack_sample || is_callchain_sample || is_hybrid_sample ||
+      is_lbr_sample) {
+    if (excluded_tids == nullptr) {
+      auto excluded_tids_it = excluded_tids_per_sampling_id_.find(stream_id);
+      if (excluded_tids_it != excluded_tids_per_sampling_id_.end()) {
+        excluded_tids = excluded_tids_it->second;
+      }
+    }
+    if (excluded_tids != nullptr &&
+        excluded_tids->contains(ReadSampleRecordTid(ring_buffer))) {
+      ring_buffer->SkipRecord(header);
+      return;
+    }
+  }
+
   if (is_uprobe) {
-    auto event = make_unique_for_overwrite<UprobesPerfEvent>();
-    ring_buffer->ConsumeRecord(header, &event->ring_buffer_record);
-    using perf_event_uprobe = perf_event_sp_ip_arguments_8bytes_sample;
-    constexpr size_t size_of_uprobes = sizeof(perf_event_uprobe);
-    CHECK(header.size == size_of_uprobes);
-    if (event->GetPid() != pid_) {
+    // The layout of the record depends on the registers sampled for the
+    // function.
+    const Function* function =
+        added_function != nullptr
+            ? added_function
+            : uprobes_uretprobes_ids_to_function_.at(stream_id);
+    // Only copied when it is deferred.
+    if (SampleRecordView{ring_buffer->GetRecordAtTail(header)}.GetPid() !=
+        function->Pid()) {
+      ring_buffer->SkipRecord(header);
+      return;
+    }
+    std::unique_ptr<UprobesPerfEvent> event = ConsumeUprobesPerfEvent(
+        ring_buffer, header, function->RecordedArgumentCount());
+
+    event->SetFunction(function);
+    event->SetOriginFileDescriptor(fd);
+    DeferEvent(std::move(event));
+    ++stats_.uprobes_count;
+    // The functions added during the capture are not governed.
+    if (instrumentation_governor_ != nullptr && added_function == nullptr) {
+      instrumentation_governor_->CountCall(function -
+                                           instrumented_functions_.data());
+    }
+    if (cpu_budget_call_counter_ != nullptr && added_function == nullptr) {
+      cpu_budget_call_counter_->CountCall(function -
+                                          instrumented_functions_.data());
+    }
+
+  } else if (is_uretprobe) {
+    const Function* function =
+        added_function != nullptr
+            ? added_function
+            : uprobes_uretprobes_ids_to_function_.at(stream_id);
+    if (SampleRecordView{ring_buffer->GetRecordAtTail(header)}.GetPid() !=
+        function->Pid()) {
+      ring_buffer->SkipRecord(header);
+      return;
+    }
+    std::unique_ptr<UretprobesPerfEvent> event = ConsumeUretprobesPerfEvent(
+        ring_buffer, header, function->RecordReturnValue());
+
+    event->SetFunction(function);
+    event->SetOriginFileDescriptor(fd);
+    DeferEvent(std::move(event));
+    ++stats_.uprobes_count;
+
+  } else if (is_stack_sample) {
+    pid_t pid = ReadSampleRecordPid(ring_buffer);
+    size_t size_of_stack_sample = sizeof(perf_event_stack_sample_fixed) +
+                                  stack_dump_size_ + sizeof(uint64_t);
+    if (header.size != size_of_stack_sample) {
+      // Skip stack samples that have an unexpected size. These normally have
+      // abi == PERF_SAMPLE_REGS_ABI_NONE and no registers, and size == 0 and
+      // no stack. Usually, these samples have pid == tid == 0, but that's not
+      // always the case: for example, when a process exits while tracing, we
+      // might get a stack sample with pid and tid != 0 but still with
+      // abi == PERF_SAMPLE_REGS_ABI_NONE and size == 0.
+      ring_buffer->SkipRecord(header);
+      return;
+    }
+    if (!IsCapturedPid(pid)) {
+      ring_buffer->SkipRecord(header);
+      return;
+    }
+    // Do *not* filter out samples based on header.misc,
+    // e.g., with header.misc == PERF_RECORD_MISC_KERNEL,
+    // in general they seem to produce valid callstacks.
+
+    uint64_t max_stack_copy_size = std::numeric_limits<uint64_t>::max();
+    if (used_stack_size_tracker_ != nullptr) {
+      max_stack_copy_size = used_stack_size_tracker_->GetStackCopySize(
+          ReadSampleRecordTid(ring_buffer));
+    }
+    auto event =
+        ConsumeStackSamplePerfEvent(ring_buffer, header, max_stack_copy_size);
+    event->SetOriginFileDescriptor(fd);
+    stats_.stack_bytes_copied += event->GetStackSize();
+    DeferEvent(std::move(event));
+    ++stats_.sample_count;
+
+  } else if (is_task_newtask) {
+    TaskNewtaskRecordView record{ring_buffer->GetRecordAtTail(header)};
+    ThreadName thread_name;
+    thread_name.set_tid(record.GetNewTid());
+    thread_name.set_name(record.GetComm());
+    thread_name.set_timestamp_ns(record.GetTimestamp());
+    ring_buffer->SkipRecord(header);
+    listener_->OnThreadName(std::move(thread_name));
+
+  } else if (is_task_rename) {
+    TaskRenameRecordView record{ring_buffer->GetRecordAtTail(header)};
+    ThreadName thread_name;
+    thread_name.set_tid(record.GetRenamedTid());
+    thread_name.set_name(record.GetNewComm());
+    thread_name.set_timestamp_ns(record.GetTimestamp());
+    ring_buffer->SkipRecord(header);
+    listener_->OnThreadName(std::move(thread_name));
+
+  } else if (is_sched_wakeup) {
+    ProcessSchedWakeupEvent(header, ring_buffer);
+
+  } else if (is_amdgpu_cs_ioctl_event) {
+    auto event =
+        ConsumeTracepointPerfEvent<AmdgpuCsIoctlPerfEvent>(ring_buffer, header);
+    // Do not filter GPU tracepoint events based on pid as we want to have
+    // visibility into all GPU activity across the system. They are deferred
+    // so that gpu_event_processor_ receives the events of all ring buffers in
+    // order.
+    event->SetOriginFileDescriptor(fd);
+    DeferEvent(std::move(event));
+    ++stats_.gpu_events_count;
+  } else if (is_amdgpu_sched_run_job_event) {
+    auto event = ConsumeTracepointPerfEvent<AmdgpuSchedRunJobPerfEvent>(
+        ring_buffer, header);
+    event->SetOriginFileDescriptor(fd);
+    DeferEvent(std::move(event));
+    ++stats_.gpu_events_count;
+  } else if (is_dma_fence_signaled_event) {
+    auto event = ConsumeTracepointPerfEvent<DmaFenceSignaledPerfEvent>(
+        ring_buffer, header);
+    event->SetOriginFileDescriptor(fd);
+    DeferEvent(std::move(event));
+    ++stats_.gpu_events_count;
+
+  } else if (is_callchain_sample) {
+    pid_t pid = ReadSampleRecordPid(ring_buffer);
+    if (!IsSampledPid(pid)) {
+      ring_buffer->SkipRecord(header);
+      return;
+    }
+
+    auto event = ConsumeCallchainSamplePerfEvent(ring_buffer, header);
+    event->SetOriginFileDescriptor(fd);
+    DeferEvent(std::move(event));
+    ++stats_.sample_count;
+
+  } else if (is_hybrid_sample) {
+    pid_t pid = ReadSampleRecordPid(ring_buffer);
+    if (!IsCapturedPid(pid)) {
+      ring_buffer->SkipRecord(header);
+      return;
+    }
+
+    std::unique_ptr<HybridSamplePerfEvent> event =
+        ConsumeHybridSamplePerfEvent(ring_buffer, header);
+    if (event == nullptr) {
+      return;
+    }
+    event->SetOriginFileDescriptor(fd);
+    stats_.stack_bytes_copied += event->GetStackSize();
+    DeferEvent(std::move(event));
+    ++stats_.sample_count;
+
+  } else if (is_lbr_sample) {
+    pid_t pid = ReadSampleRecordPid(ring_buffer);
+    if (!IsCapturedPid(pid)) {
+      ring_buffer->SkipRecord(header);
+      return;
+    }
+
+    auto event = ConsumeLbrSamplePerfEvent(ring_buffer, header);
+    event->SetOriginFileDescriptor(fd);
+    DeferEvent(std::move(event));
+    ++stats_.sample_count;
+
+  } else if (is_sched_switch_counters) {
+    ProcessSchedSwitchCountersEvent(header, ring_buffer);
+
+  } else if (is_off_cpu_callchain) {
+    pid_t pid = ReadSampleRecordPid(ring_buffer);
+    if (!IsCapturedPid(pid)) {
+      ring_buffer->SkipRecord(header);
       return;
     }
 
-    event->SetFunction(
-        uprobes_uretprobes_ids_to_function_.at(event->GetStreamId()));
+    // nullptr for the threads that were preempted rather than blocked.
+    std::unique_ptr<OffCpuCallchainPerfEvent> event =
+        ConsumeOffCpuCallchainPerfEvent(ring_buffer, header);
+    if (event == nullptr) {
+      return;
+    }
     event->SetOriginFileDescriptor(fd);
     DeferEvent(std::move(event));
-    ++stats_.uprobes_count;
 
-  } else if (is_uretprobe) {
-    auto event = make_unique_for_overwrite<UretprobesPerfEvent>();
-    ring_buffer->ConsumeRecord(header, &event->ring_buffer_record);
-    constexpr size_t size_of_uretprobes = sizeof(perf_event_ax_sample);
-    CHECK(header.size == size_of_uretprobes);
-    if (event->GetPid() != pid_) {
+  } else if (is_futex_wait || is_futex_exit) {
+    pid_t pid = ReadSampleRecordPid(ring_buffer);
+    if (!IsCapturedPid(pid)) {
+      ring_buffer->SkipRecord(header);
       return;
     }
 
-    event->SetFunction(
-        uprobes_uretprobes_ids_to_function_.at(event->GetStreamId()));
+    std::unique_ptr<PerfEvent> event;
+    if (is_futex_wait) {
+      // nullptr for the other futex operations, e.g., wakes.
+      event = ConsumeFutexWaitPerfEvent(ring_buffer, header);
+    } else {
+      event = ConsumeFutexExitPerfEvent(ring_buffer, header);
+    }
+    if (event == nullptr) {
+      return;
+    }
     event->SetOriginFileDescriptor(fd);
     DeferEvent(std::move(event));
-    ++stats_.uprobes_count;
 
-  } else if (is_stack_sample) {
+  } else if (is_allocation) {
+    // The uprobe fires in all the processes that map the module. The sampling
+    // decision is made before the record is copied, so that only the sampled
+    // allocations cost more than reading the ring buffer.
     pid_t pid = ReadSampleRecordPid(ring_buffer);
-    constexpr size_t size_of_stack_sample = sizeof(perf_event_stack_sample);
-    if (header.size != size_of_stack_sample) {
-      // Skip stack samples that have an unexpected size. These normally have
-      // abi == PERF_SAMPLE_REGS_ABI_NONE and no registers, and size == 0 and
-      // no stack. Usually, these samples have pid == tid == 0, but that's not
-      // always the case: for example, when a process exits while tracing, we
-      // might get a stack sample with pid and tid != 0 but still with
-      // abi == PERF_SAMPLE_REGS_ABI_NONE and size == 0.
+    if (!IsCapturedPid(pid)) {
       ring_buffer->SkipRecord(header);
       return;
     }
-    if (pid != pid_) {
+    std::optional<uint64_t> sampled_bytes;
+    {
+      std::lock_guard<std::mutex> lock(allocation_sampler_mutex_);
+      sampled_bytes = allocation_sampler_.ProcessAllocation(
+          ReadSampleRecordTid(ring_buffer),
+          ReadAllocationRecordSize(ring_buffer));
+    }
+    if (!sampled_bytes.has_value()) {
+      ring_buffer->SkipRecord(header);
+      return;
+    }
+    auto event = ConsumeAllocationPerfEvent(ring_buffer, header);
+    event->sampled_bytes = sampled_bytes.value();
+    event->SetOriginFileDescriptor(fd);
+    DeferEvent(std::move(event));
+
+  } else if (is_syscall_enter || is_syscall_exit || is_block_rq_issue) {
+    // Deferred, to be matched in order with the events of the other cpus.
+    pid_t pid = ReadSampleRecordPid(ring_buffer);
+    if (!IsCapturedPid(pid)) {
       ring_buffer->SkipRecord(header);
       return;
     }
-    // Do *not* filter out samples based on header.misc,
-    // e.g., with header.misc == PERF_RECORD_MISC_KERNEL,
-    // in general they seem to produce valid callstacks.
 
-    auto event = ConsumeStackSamplePerfEvent(ring_buffer, header);
+    std::unique_ptr<PerfEvent> event;
+    if (is_syscall_enter) {
+      event = ConsumeSyscallEnterPerfEvent(ring_buffer, header);
+    } else if (is_syscall_exit) {
+      event = ConsumeSyscallExitPerfEvent(ring_buffer, header);
+    } else {
+      event = ConsumeBlockRqIssuePerfEvent(ring_buffer, header);
+    }
     event->SetOriginFileDescriptor(fd);
     DeferEvent(std::move(event));
-    ++stats_.sample_count;
 
-  } else if (is_task_newtask) {
-    auto event =
-        ConsumeTracepointPerfEvent<TaskNewtaskPerfEvent>(ring_buffer, header);
-    ThreadName thread_name;
-    thread_name.set_tid(event->GetTid());
-    thread_name.set_name(event->GetComm());
-    thread_name.set_timestamp_ns(event->GetTimestamp());
-    listener_->OnThreadName(std::move(thread_name));
+  } else if (is_block_rq_complete) {
+    // Usually recorded in an interrupt, in the context of any process.
+    auto event = ConsumeBlockRqCompletePerfEvent(ring_buffer, header);
+    event->SetOriginFileDescriptor(fd);
+    DeferEvent(std::move(event));
 
-  } else if (is_task_rename) {
-    auto event =
-        ConsumeTracepointPerfEvent<TaskRenamePerfEvent>(ring_buffer, header);
-    ThreadName thread_name;
-    thread_name.set_tid(event->GetTid());
-    thread_name.set_name(event->GetNewComm());
-    thread_name.set_timestamp_ns(event->GetTimestamp());
-    listener_->OnThreadName(std::move(thread_name));
+  } else if (is_major_page_fault || is_minor_page_fault) {
+    pid_t pid = ReadSampleRecordPid(ring_buffer);
+    if (!IsCapturedPid(pid)) {
+      ring_buffer->SkipRecord(header);
+      return;
+    }
 
-  } else if (is_amdgpu_cs_ioctl_event) {
-    // TODO: Consider deferring GPU events.
-    auto event =
-        ConsumeTracepointPerfEvent<AmdgpuCsIoctlPerfEvent>(ring_buffer, header);
-    // Do not filter GPU tracepoint events based on pid as we want to have
-    // visibility into all GPU activity across the system.
-    gpu_event_processor_->PushEvent(*event);
-    ++stats_.gpu_events_count;
-  } else if (is_amdgpu_sched_run_job_event) {
-    auto event = ConsumeTracepointPerfEvent<AmdgpuSchedRunJobPerfEvent>(
-        ring_buffer, header);
-    gpu_event_processor_->PushEvent(*event);
-    ++stats_.gpu_events_count;
-  } else if (is_dma_fence_signaled_event) {
-    auto event = ConsumeTracepointPerfEvent<DmaFenceSignaledPerfEvent>(
-        ring_buffer, header);
-    gpu_event_processor_->PushEvent(*event);
-    ++stats_.gpu_events_count;
+    auto event = ConsumePageFaultPerfEvent(ring_buffer, header);
+    event->major = is_major_page_fault;
+    event->weight = is_major_page_fault ? 1 : minor_page_fault_sampling_period_;
+    event->SetOriginFileDescriptor(fd);
+    DeferEvent(std::move(event));
 
-  } else if (is_callchain_sample) {
+  } else if (is_mmap_syscall || is_munmap_syscall) {
     pid_t pid = ReadSampleRecordPid(ring_buffer);
-    if (pid != pid_) {
+    if (!IsCapturedPid(pid)) {
       ring_buffer->SkipRecord(header);
       return;
     }
 
-    auto event = ConsumeCallchainSamplePerfEvent(ring_buffer, header);
+    auto event = ConsumeMemoryMapSyscallPerfEvent(ring_buffer, header);
+    event->munmap = is_munmap_syscall;
     event->SetOriginFileDescriptor(fd);
     DeferEvent(std::move(event));
-    ++stats_.sample_count;
+
+  } else if (is_cpu_frequency || is_cpu_idle) {
+    CpuPowerRecordView record{ring_buffer->GetRecordAtTail(header)};
+    CpuPowerEvent cpu_power_event;
+    cpu_power_event.set_cpu(record.GetCpuId());
+    cpu_power_event.set_timestamp_ns(record.GetTimestamp());
+    if (is_cpu_frequency) {
+      cpu_power_event.set_frequency_khz(record.GetState());
+    } else {
+      // PWR_EVENT_EXIT, (uint32_t)-1, becomes -1.
+      cpu_power_event.set_idle_state(static_cast<int32_t>(record.GetState()));
+    }
+    ring_buffer->SkipRecord(header);
+    listener_->OnCpuPowerEvent(std::move(cpu_power_event));
 
   } else {
     ERROR("PERF_EVENT_SAMPLE with unexpected stream_id: %lu", stream_id);
@@ -889,59 +3004,641 @@ void TracerThread::ProcessSampleEvent(const perf_event_header& header,
 
 void TracerThread::ProcessLostEvent(const perf_event_header& header,
                                     PerfEventRingBuffer* ring_buffer) {
-  LostPerfEvent event;
-  ring_buffer->ConsumeRecord(header, &event.ring_buffer_record);
-  stats_.lost_count += event.GetNumLost();
-  stats_.lost_count_per_buffer[ring_buffer] += event.GetNumLost();
+  const uint64_t num_lost =
+      LostRecordView{ring_buffer->GetRecordAtTail(header)}.GetNumLost();
+  ring_buffer->SkipRecord(header);
+  stats_.lost_count += num_lost;
+  // Only written while opening the events, before the ring buffers are read.
+  auto class_it =
+      ring_buffer_class_per_fd_.find(ring_buffer->GetFileDescriptor());
+  if (class_it != ring_buffer_class_per_fd_.end()) {
+    lost_count_per_ring_buffer_class_[static_cast<size_t>(class_it->second)] +=
+        num_lost;
+  }
+  std::lock_guard<std::mutex> lock(stats_.lost_count_per_buffer_mutex);
+  stats_.lost_count_per_buffer[ring_buffer] += num_lost;
 }
 
 void TracerThread::DeferEvent(std::unique_ptr<PerfEvent> event) {
-  std::lock_guard<std::mutex> lock(deferred_events_mutex_);
-  deferred_events_.emplace_back(std::move(event));
-}
-
-std::vector<std::unique_ptr<PerfEvent>> TracerThread::ConsumeDeferredEvents() {
-  std::lock_guard<std::mutex> lock(deferred_events_mutex_);
-  std::vector<std::unique_ptr<PerfEvent>> events(std::move(deferred_events_));
-  deferred_events_.clear();
-  return events;
+  int fd = event->GetOriginFileDescriptor();
+  uint64_t timestamp_ns = event->GetTimestamp();
+  deferred_events_->Push(DeferredEvent{fd, timestamp_ns, std::move(event)});
 }
 
 void TracerThread::ProcessDeferredEvents() {
   pthread_setname_np(pthread_self(), "Proc.Def.Events");
-  bool should_exit = false;
-  while (!should_exit) {
-    // When "should_exit" becomes true, we know that we have stopped generating
-    // deferred events. The last iteration will consume all remaining events.
-    should_exit = stop_deferred_thread_;
-    std::vector<std::unique_ptr<PerfEvent>> events = ConsumeDeferredEvents();
-    if (events.empty()) {
-      // TODO: use a wait/notify mechanism instead of check/sleep.
-      usleep(IDLE_TIME_ON_EMPTY_DEFERRED_EVENTS_US);
-    } else {
-      for (auto& event : events) {
-        int fd = event->GetOriginFileDescriptor();
-        uprobes_event_processor_->AddEvent(fd, std::move(event));
+  std::vector<DeferredEvent> events;
+  bool more_events = true;
+  while (more_events) {
+    // Wake up when new events are deferred, or when the oldest event becomes
+    // old enough to be processed.
+    absl::Duration timeout = absl::InfiniteDuration();
+    std::optional<uint64_t> next_processing_timestamp_ns =
+        uprobes_event_processor_->GetNextProcessingTimestampNs();
+    if (next_processing_timestamp_ns.has_value()) {
+      uint64_t now_ns = MonotonicTimestampNs();
+      timeout = absl::Nanoseconds(
+          next_processing_timestamp_ns.value() > now_ns
+              ? next_processing_timestamp_ns.value() - now_ns
+              : 0);
+    }
+    // This returns false for the last events, once the queue is closed.
+    more_events = deferred_events_->PopAll(&events, timeout);
+    ORBIT_SCOPE("Process Deferred Events");
+    for (DeferredEvent& event : events) {
+      if (event.event != nullptr) {
+        uprobes_event_processor_->AddEvent(event.origin_fd,
+                                           std::move(event.event));
+      } else {
+        uprobes_event_processor_->UpdateWatermark(event.origin_fd,
+                                                  event.watermark_ns);
       }
+    }
+    uprobes_event_processor_->ProcessOldEvents();
+    stats_.processor_queued_event_count.store(
+        uprobes_event_processor_->GetEventCount(), std::memory_order_relaxed);
+  }
+}
 
-      uprobes_event_processor_->ProcessOldEvents();
+void TracerThread::RunThreadNameRetriever(
+    const std::shared_ptr<std::atomic<bool>>& exit_requested) {
+  pthread_setname_np(pthread_self(), "ThreadNames");
+  absl::flat_hash_map<pid_t, std::string> thread_names_sent;
+  while (!*exit_requested) {
+    RetrieveThreadNames(&thread_names_sent, exit_requested);
+    for (uint64_t waited_ms = 0;
+         waited_ms < THREAD_NAME_RECONCILIATION_PERIOD_MS && !*exit_requested;
+         waited_ms += THREAD_NAME_EXIT_CHECK_PERIOD_MS) {
+      std::this_thread::sleep_for(
+          std::chrono::milliseconds(THREAD_NAME_EXIT_CHECK_PERIOD_MS));
     }
   }
 }
 
-void TracerThread::RetrieveThreadNames() {
-  uint64_t timestamp_ns = MonotonicTimestampNs();
-  for (pid_t tid : ListThreads(pid_)) {
-    std::string name = GetThreadName(tid);
-    if (name.empty()) {
+void TracerThread::RunInstrumentationGovernor(
+    const std::shared_ptr<std::atomic<bool>>& exit_requested) {
+  pthread_setname_np(pthread_self(), "Governor");
+  const uint64_t end_ns =
+      MonotonicTimestampNs() + InstrumentationGovernor::MEASUREMENT_DURATION_NS;
+  while (!*exit_requested && MonotonicTimestampNs() < end_ns) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(
+        INSTRUMENTATION_GOVERNOR_EXIT_CHECK_PERIOD_MS));
+  }
+  if (*exit_requested) {
+    return;
+  }
+
+  const int disabled_function_count = DisableInstrumentedFunctions(
+      instrumentation_governor_->StopMeasuring(MonotonicTimestampNs()));
+  if (disabled_function_count == 0) {
+    return;
+  }
+  LOG("Disabled the uprobes and uretprobes of %d instrumented functions "
+      "called more than %lu times per second",
+      disabled_function_count,
+      instrumentation_governor_->GetMaxCallsPerSecond());
+}
+
+bool TracerThread::CanDisableInstrumentedFunction(size_t function_index) {
+  // Disabling these would break the scopes, spans and frames.
+  if (manual_instrumentation_config_.IsManualInstrumentationAddress(
+          instrumented_functions_[function_index].VirtualAddress())) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(disabled_function_indices_mutex_);
+  return !disabled_function_indices_.contains(function_index);
+}
+
+int TracerThread::DisableInstrumentedFunctions(
+    const std::vector<InstrumentationGovernor::HotFunction>& hot_functions) {
+  DisabledInstrumentedFunctions disabled_functions;
+  std::vector<int> uprobes_fds;
+  std::vector<int> uretprobes_fds;
+  for (const InstrumentationGovernor::HotFunction& hot_function :
+       hot_functions) {
+    const size_t function_index = hot_function.function_index;
+    if (!CanDisableInstrumentedFunction(function_index)) {
       continue;
     }
+    {
+      // Both governors can disable functions.
+      std::lock_guard<std::mutex> lock(disabled_function_indices_mutex_);
+      if (!disabled_function_indices_.insert(function_index).second) {
+        continue;
+      }
+    }
+    const Function& function = instrumented_functions_[function_index];
+    const std::vector<int>& function_uprobes_fds =
+        uprobes_fds_per_function_[function_index];
+    uprobes_fds.insert(uprobes_fds.end(), function_uprobes_fds.begin(),
+                       function_uprobes_fds.end());
+    const std::vector<int>& function_uretprobes_fds =
+        uretprobes_fds_per_function_[function_index];
+    uretprobes_fds.insert(uretprobes_fds.end(),
+                          function_uretprobes_fds.begin(),
+                          function_uretprobes_fds.end());
+    DisabledInstrumentedFunctions::DisabledFunction* disabled_function =
+        disabled_functions.add_functions();
+    disabled_function->set_pid(function.Pid());
+    disabled_function->set_absolute_address(function.VirtualAddress());
+    disabled_function->set_calls_per_second(hot_function.calls_per_second);
+  }
+  const int disabled_function_count = disabled_functions.functions_size();
+  if (disabled_function_count == 0) {
+    return 0;
+  }
 
-    ThreadName thread_name;
-    thread_name.set_tid(tid);
-    thread_name.set_name(std::move(name));
-    thread_name.set_timestamp_ns(timestamp_ns);
-    listener_->OnThreadName(std::move(thread_name));
+  // Some of these file descriptors are the ones of the ring buffers, which
+  // keep receiving the records of the other probes redirected to them. The
+  // calls that are running when their uretprobes are disabled leave open
+  // uprobes behind, which UprobesUnwindingVisitor discards, but few are still
+  // running after the grace period.
+  RunOnFileDescriptorsInParallel(uprobes_fds, &perf_event_disable);
+  std::this_thread::sleep_for(
+      std::chrono::milliseconds(UPROBES_DISABLE_GRACE_PERIOD_MS));
+  RunOnFileDescriptorsInParallel(uretprobes_fds, &perf_event_disable);
+
+  disabled_functions.set_timestamp_ns(MonotonicTimestampNs());
+  listener_->OnDisabledInstrumentedFunctions(std::move(disabled_functions));
+  return disabled_function_count;
+}
+
+void TracerThread::RunCpuBudgetGovernor(
+    const std::shared_ptr<std::atomic<bool>>& exit_requested) {
+  pthread_setname_np(pthread_self(), "CpuBudget");
+  uint64_t window_begin_ns = MonotonicTimestampNs();
+  uint64_t window_begin_cpu_time_ns = ProcessCpuTimeNs();
+  if (cpu_budget_call_counter_ != nullptr) {
+    cpu_budget_call_counter_->StartMeasuring(window_begin_ns);
+  }
+  bool reported_no_step_left = false;
+  while (!*exit_requested) {
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(CPU_BUDGET_GOVERNOR_EXIT_CHECK_PERIOD_MS));
+    const uint64_t window_end_ns = MonotonicTimestampNs();
+    if (window_end_ns - window_begin_ns <
+        CpuBudgetGovernor::WINDOW_DURATION_NS) {
+      continue;
+    }
+    const uint64_t window_end_cpu_time_ns = ProcessCpuTimeNs();
+    std::vector<InstrumentationGovernor::HotFunction> hot_functions;
+    if (cpu_budget_call_counter_ != nullptr) {
+      hot_functions = cpu_budget_call_counter_->StopMeasuring(window_end_ns);
+    }
+    CpuBudgetGovernor::Step step = cpu_budget_governor_->OnWindow(
+        window_end_ns - window_begin_ns,
+        window_end_cpu_time_ns - window_begin_cpu_time_ns);
+
+    CpuBudgetStep cpu_budget_step;
+    cpu_budget_step.set_window_begin_timestamp_ns(window_begin_ns);
+    cpu_budget_step.set_cpu_usage(cpu_budget_governor_->GetLastCpuUsage());
+    std::vector<InstrumentationGovernor::HotFunction> functions_to_disable;
+    bool step_taken = false;
+    switch (step) {
+      case CpuBudgetGovernor::Step::kNone:
+        break;
+      case CpuBudgetGovernor::Step::kHalveSamplingRate:
+        HalveSamplingRate();
+        cpu_budget_step.set_action(CpuBudgetStep::kHalveSamplingRate);
+        step_taken = true;
+        break;
+      case CpuBudgetGovernor::Step::kFramePointerUnwinding:
+        cpu_budget_step.set_action(CpuBudgetStep::kFramePointerUnwinding);
+        step_taken = SwitchSamplingToFramePointers();
+        break;
+      case CpuBudgetGovernor::Step::kDisableHotFunctions:
+        functions_to_disable = SelectHotFunctionsToDisable(hot_functions);
+        if (functions_to_disable.empty()) {
+          cpu_budget_governor_->OnNoHotFunctionLeft();
+          break;
+        }
+        cpu_budget_step.set_action(CpuBudgetStep::kDisableHotFunctions);
+        step_taken = true;
+        break;
+    }
+
+    if (step_taken) {
+      cpu_budget_step.set_timestamp_ns(MonotonicTimestampNs());
+      LOG("The service used %.1f%% of a core, over the budget of %.1f%%: "
+          "%s",
+          100 * cpu_budget_governor_->GetLastCpuUsage(),
+          100 * cpu_budget_governor_->GetMaxCpuUsage(),
+          CpuBudgetStep::Action_Name(cpu_budget_step.action()));
+      listener_->OnCpuBudgetStep(std::move(cpu_budget_step));
+      if (!functions_to_disable.empty()) {
+        DisableInstrumentedFunctions(functions_to_disable);
+      }
+    } else if (step == CpuBudgetGovernor::Step::kNone &&
+               cpu_budget_governor_->GetLastCpuUsage() >
+                   cpu_budget_governor_->GetMaxCpuUsage() &&
+               !reported_no_step_left) {
+      LOG("The service used %.1f%% of a core, over the budget of %.1f%%, "
+          "but there is no fidelity left to give up",
+          100 * cpu_budget_governor_->GetLastCpuUsage(),
+          100 * cpu_budget_governor_->GetMaxCpuUsage());
+      reported_no_step_left = true;
+    }
+
+    window_begin_ns = MonotonicTimestampNs();
+    window_begin_cpu_time_ns = ProcessCpuTimeNs();
+    if (cpu_budget_call_counter_ != nullptr) {
+      cpu_budget_call_counter_->StartMeasuring(window_begin_ns);
+    }
+  }
+}
+
+void TracerThread::HalveSamplingRate() {
+  sampling_period_multiplier_ *= 2;
+  for (const SamplingFd& sampling_fd : sampling_fds_) {
+    perf_event_set_period(
+        sampling_fd.fd,
+        sampling_fd.configuration->event.period * sampling_period_multiplier_);
+  }
+}
+
+bool TracerThread::SwitchSamplingToFramePointers() {
+  const uint32_t wakeup_watermark = ComputeWakeupWatermark(
+      GetRingBufferSizeKb(RingBufferClass::kSampling));
+  std::vector<SamplingFd> callchain_sampling_fds;
+  for (const SamplingFd& sampling_fd : sampling_fds_) {
+    SamplingEvent sampling_event = sampling_fd.configuration->event;
+    sampling_event.period *= sampling_period_multiplier_;
+    int fd = callchain_sample_event_open(sampling_event, sampling_fd.tid,
+                                         sampling_fd.cpu, wakeup_watermark);
+    if (fd < 0) {
+      ERROR("Opening callchain sampling of thread %d for cpu %d",
+            sampling_fd.tid, sampling_fd.cpu);
+      for (const SamplingFd& opened_fd : callchain_sampling_fds) {
+        close(opened_fd.fd);
+      }
+      return false;
+    }
+    perf_event_redirect(fd, sampling_fd.ring_buffer_fd);
+    callchain_sampling_fds.push_back(SamplingFd{
+        fd, sampling_fd.configuration, sampling_fd.tid, sampling_fd.cpu,
+        sampling_fd.ring_buffer_fd});
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(added_probes_ids_mutex_);
+    for (const SamplingFd& sampling_fd : callchain_sampling_fds) {
+      const absl::flat_hash_set<pid_t>& excluded_tids =
+          sampling_fd.configuration->excluded_tids;
+      added_callchain_sampling_ids_.emplace(
+          perf_event_get_id(sampling_fd.fd),
+          excluded_tids.empty() ? nullptr : &excluded_tids);
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(opened_events_mutex_);
+    for (const SamplingFd& sampling_fd : callchain_sampling_fds) {
+      tracing_fds_.push_back(sampling_fd.fd);
+    }
+  }
+  // The old events are disabled first, so that no thread is sampled twice.
+  // Their file descriptors stay open, as some are the ones of the ring
+  // buffers.
+  for (const SamplingFd& sampling_fd : sampling_fds_) {
+    perf_event_disable(sampling_fd.fd);
+  }
+  for (const SamplingFd& sampling_fd : callchain_sampling_fds) {
+    perf_event_reset_and_enable(sampling_fd.fd);
+  }
+  sampling_fds_ = std::move(callchain_sampling_fds);
+  return true;
+}
+
+std::vector<InstrumentationGovernor::HotFunction>
+TracerThread::SelectHotFunctionsToDisable(
+    const std::vector<InstrumentationGovernor::HotFunction>& hot_functions) {
+  std::vector<InstrumentationGovernor::HotFunction> candidates;
+  uint64_t total_calls_per_second = 0;
+  for (const InstrumentationGovernor::HotFunction& hot_function :
+       hot_functions) {
+    if (!CanDisableInstrumentedFunction(hot_function.function_index)) {
+      continue;
+    }
+    candidates.push_back(hot_function);
+    total_calls_per_second += hot_function.calls_per_second;
+  }
+  // Hottest first, as returned by StopMeasuring.
+  std::vector<InstrumentationGovernor::HotFunction> selected;
+  uint64_t selected_calls_per_second = 0;
+  for (const InstrumentationGovernor::HotFunction& candidate : candidates) {
+    if (!selected.empty() &&
+        2 * selected_calls_per_second >= total_calls_per_second) {
+      break;
+    }
+    selected.push_back(candidate);
+    selected_calls_per_second += candidate.calls_per_second;
+  }
+  return selected;
+}
+
+void TracerThread::RunInstrumentedFunctionsUpdater(
+    const std::shared_ptr<std::atomic<bool>>& exit_requested) {
+  pthread_setname_np(pthread_self(), "FunctionsUpdate");
+  std::vector<InstrumentedFunctionsUpdate> updates;
+  while (!*exit_requested) {
+    instrumented_functions_updates_->PopAll(
+        &updates, absl::Milliseconds(INSTRUMENTED_FUNCTIONS_UPDATE_WAIT_MS));
+    for (const InstrumentedFunctionsUpdate& update : updates) {
+      if (*exit_requested) {
+        return;
+      }
+      CaptureSetupPhase update_phase;
+      update_phase.set_name("instrumented_functions_update");
+      update_phase.set_begin_timestamp_ns(MonotonicTimestampNs());
+      update_phase.set_succeeded(UpdateInstrumentedFunctions(update));
+      update_phase.set_end_timestamp_ns(MonotonicTimestampNs());
+      listener_->OnCaptureSetupPhase(std::move(update_phase));
+    }
+  }
+}
+
+bool TracerThread::UpdateInstrumentedFunctions(
+    const InstrumentedFunctionsUpdate& update) {
+  bool success = true;
+
+  // The probes of the removed functions are only disabled, so that the
+  // functions can be added back without opening them again, and closed with
+  // the others at the end of the capture.
+  std::vector<int> removed_uprobes_fds;
+  std::vector<int> removed_uretprobes_fds;
+  for (const CaptureOptions::InstrumentedFunction& removed_function :
+       update.removed_functions()) {
+    const uint64_t address = removed_function.absolute_address();
+    const pid_t pid =
+        removed_function.pid() == 0 ? pids_[0] : removed_function.pid();
+    if (manual_instrumentation_config_.IsManualInstrumentationAddress(
+            address) ||
+        !FindUserSpaceProbesFds(pid, address, &removed_uprobes_fds,
+                                &removed_uretprobes_fds)) {
+      ERROR("Cannot remove function 0x%lx of process %d", address, pid);
+      success = false;
+    }
+  }
+  // As in RunInstrumentationGovernor, the uprobes first, so that the calls
+  // running can return.
+  if (!removed_uprobes_fds.empty()) {
+    RunOnFileDescriptorsInParallel(removed_uprobes_fds, &perf_event_disable);
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(UPROBES_DISABLE_GRACE_PERIOD_MS));
+    RunOnFileDescriptorsInParallel(removed_uretprobes_fds,
+                                   &perf_event_disable);
+  }
+
+  std::vector<int> added_uprobes_fds;
+  std::vector<int> added_uretprobes_fds;
+  for (const CaptureOptions::InstrumentedFunction& instrumented_function :
+       update.added_functions()) {
+    // The scopes, spans and frames need all their probes from the start.
+    if (instrumented_function.function_type() !=
+        CaptureOptions_InstrumentedFunction::kRegular) {
+      ERROR("Cannot add manual instrumentation function 0x%lx to a capture",
+            instrumented_function.absolute_address());
+      success = false;
+      continue;
+    }
+    std::optional<Function> function = CreateFunction(instrumented_function);
+    if (!function.has_value()) {
+      success = false;
+      continue;
+    }
+    // The probes of a function that was removed are enabled again.
+    if (FindUserSpaceProbesFds(function->Pid(), function->VirtualAddress(),
+                               &added_uprobes_fds, &added_uretprobes_fds)) {
+      continue;
+    }
+    if (uprobes_ring_buffer_fds_per_cpu_.empty()) {
+      ERROR("Cannot add function 0x%lx to a capture started without "
+            "instrumented functions",
+            function->VirtualAddress());
+      success = false;
+      continue;
+    }
+
+    const Function& added_function =
+        added_functions_.emplace_back(std::move(function.value()));
+    AddedFunctionProbes probes{&added_function, {}, {}};
+    if (!OpenAddedUserSpaceProbes(added_function, &probes.uprobes_fds,
+                                  &probes.uretprobes_fds)) {
+      added_functions_.pop_back();
+      success = false;
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> lock(added_probes_ids_mutex_);
+      for (int fd : probes.uprobes_fds) {
+        added_uprobes_ids_to_function_.emplace(perf_event_get_id(fd),
+                                               &added_function);
+      }
+      for (int fd : probes.uretprobes_fds) {
+        added_uretprobes_ids_to_function_.emplace(perf_event_get_id(fd),
+                                                  &added_function);
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(opened_events_mutex_);
+      tracing_fds_.insert(tracing_fds_.end(), probes.uprobes_fds.begin(),
+                          probes.uprobes_fds.end());
+      tracing_fds_.insert(tracing_fds_.end(), probes.uretprobes_fds.begin(),
+                          probes.uretprobes_fds.end());
+    }
+    added_uprobes_fds.insert(added_uprobes_fds.end(),
+                             probes.uprobes_fds.begin(),
+                             probes.uprobes_fds.end());
+    added_uretprobes_fds.insert(added_uretprobes_fds.end(),
+                                probes.uretprobes_fds.begin(),
+                                probes.uretprobes_fds.end());
+    added_function_probes_.emplace(
+        std::make_pair(added_function.Pid(), added_function.VirtualAddress()),
+        std::move(probes));
+  }
+  // The uretprobes first, as when the capture starts.
+  RunOnFileDescriptorsInParallel(added_uretprobes_fds, &perf_event_enable);
+  RunOnFileDescriptorsInParallel(added_uprobes_fds, &perf_event_enable);
+
+  LOG("Updated the instrumented functions: %d added, %d removed",
+      update.added_functions_size(), update.removed_functions_size());
+  return success;
+}
+
+bool TracerThread::OpenAddedUserSpaceProbes(const Function& function,
+                                            std::vector<int>* uprobes_fds,
+                                            std::vector<int>* uretprobes_fds) {
+  // The records of these probes are redirected to existing ring buffers.
+  const uint32_t wakeup_watermark =
+      ComputeWakeupWatermark(GetRingBufferSizeKb(RingBufferClass::kUprobes));
+  for (const auto [cpu, ring_buffer_fd] : uprobes_ring_buffer_fds_per_cpu_) {
+    int uprobes_fd = OpenUprobes(function, cpu, wakeup_watermark);
+    if (uprobes_fd >= 0) {
+      uprobes_fds->push_back(uprobes_fd);
+    }
+    int uretprobes_fd = OpenUretprobes(function, cpu, wakeup_watermark);
+    if (uretprobes_fd >= 0) {
+      uretprobes_fds->push_back(uretprobes_fd);
+    }
+    if (uprobes_fd < 0 || uretprobes_fd < 0) {
+      CloseFileDescriptors(*uprobes_fds);
+      CloseFileDescriptors(*uretprobes_fds);
+      uprobes_fds->clear();
+      uretprobes_fds->clear();
+      return false;
+    }
+    perf_event_redirect(uprobes_fd, ring_buffer_fd);
+    perf_event_redirect(uretprobes_fd, ring_buffer_fd);
+  }
+  return true;
+}
+
+bool TracerThread::FindUserSpaceProbesFds(
+    pid_t pid, uint64_t address, std::vector<int>* uprobes_fds,
+    std::vector<int>* uretprobes_fds) const {
+  const std::vector<int>* function_uprobes_fds = nullptr;
+  const std::vector<int>* function_uretprobes_fds = nullptr;
+  for (size_t i = 0; i < uprobes_fds_per_function_.size(); ++i) {
+    const Function& function = instrumented_functions_[i];
+    if (function.Pid() == pid && function.VirtualAddress() == address) {
+      function_uprobes_fds = &uprobes_fds_per_function_[i];
+      function_uretprobes_fds = &uretprobes_fds_per_function_[i];
+      break;
+    }
+  }
+  if (function_uprobes_fds == nullptr) {
+    auto probes_it = added_function_probes_.find(std::make_pair(pid, address));
+    if (probes_it == added_function_probes_.end()) {
+      return false;
+    }
+    function_uprobes_fds = &probes_it->second.uprobes_fds;
+    function_uretprobes_fds = &probes_it->second.uretprobes_fds;
+  }
+  uprobes_fds->insert(uprobes_fds->end(), function_uprobes_fds->begin(),
+                      function_uprobes_fds->end());
+  uretprobes_fds->insert(uretprobes_fds->end(),
+                         function_uretprobes_fds->begin(),
+                         function_uretprobes_fds->end());
+  return true;
+}
+
+const Function* TracerThread::FindAddedFunction(uint64_t stream_id,
+                                                bool* is_uretprobe) {
+  std::lock_guard<std::mutex> lock(added_probes_ids_mutex_);
+  auto uprobes_it = added_uprobes_ids_to_function_.find(stream_id);
+  if (uprobes_it != added_uprobes_ids_to_function_.end()) {
+    *is_uretprobe = false;
+    return uprobes_it->second;
+  }
+  auto uretprobes_it = added_uretprobes_ids_to_function_.find(stream_id);
+  if (uretprobes_it != added_uretprobes_ids_to_function_.end()) {
+    *is_uretprobe = true;
+    return uretprobes_it->second;
+  }
+  return nullptr;
+}
+
+bool TracerThread::FindAddedCallchainSampling(
+    uint64_t stream_id, const absl::flat_hash_set<pid_t>** excluded_tids) {
+  std::lock_guard<std::mutex> lock(added_probes_ids_mutex_);
+  auto it = added_callchain_sampling_ids_.find(stream_id);
+  if (it == added_callchain_sampling_ids_.end()) {
+    return false;
+  }
+  *excluded_tids = it->second;
+  return true;
+}
+
+void TracerThread::RunManualInstrumentationReader(
+    const std::shared_ptr<std::atomic<bool>>& exit_requested) {
+  pthread_setname_np(pthread_self(), "ManualScopes");
+  ManualInstrumentationReader reader{pids_, listener_};
+  uint64_t event_count = 0;
+  uint64_t since_update_ms = MANUAL_INSTRUMENTATION_UPDATE_PERIOD_MS;
+  while (!*exit_requested) {
+    if (since_update_ms >= MANUAL_INSTRUMENTATION_UPDATE_PERIOD_MS) {
+      reader.UpdateBuffers();
+      since_update_ms = 0;
+    }
+    event_count += reader.ReadEvents();
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(MANUAL_INSTRUMENTATION_READ_PERIOD_MS));
+    since_update_ms += MANUAL_INSTRUMENTATION_READ_PERIOD_MS;
+  }
+  reader.UpdateBuffers();
+  event_count += reader.ReadEvents();
+  LOG("Read %lu manual instrumentation events from shared memory, %lu scopes "
+      "dropped as buffers were full",
+      event_count, reader.GetDroppedScopeCount());
+}
+
+void TracerThread::RunVulkanLayerReader(
+    const std::shared_ptr<std::atomic<bool>>& exit_requested) {
+  pthread_setname_np(pthread_self(), "VulkanLayer");
+  VulkanLayerReader reader{pids_, listener_};
+  uint64_t slice_count = 0;
+  uint64_t since_update_ms = VULKAN_LAYER_UPDATE_PERIOD_MS;
+  while (!*exit_requested) {
+    if (since_update_ms >= VULKAN_LAYER_UPDATE_PERIOD_MS) {
+      reader.UpdateBuffers();
+      since_update_ms = 0;
+    }
+    slice_count += reader.ReadSlices();
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(VULKAN_LAYER_READ_PERIOD_MS));
+    since_update_ms += VULKAN_LAYER_READ_PERIOD_MS;
+  }
+  reader.UpdateBuffers();
+  slice_count += reader.ReadSlices();
+  LOG("Read %lu GPU command buffer slices from the Vulkan layer, %lu dropped "
+      "as buffers were full",
+      slice_count, reader.GetDroppedSliceCount());
+}
+
+void TracerThread::RetrieveThreadNames(
+    absl::flat_hash_map<pid_t, std::string>* thread_names_sent,
+    const std::shared_ptr<std::atomic<bool>>& exit_requested) {
+  absl::flat_hash_set<pid_t> live_tids;
+  for (pid_t pid : pids_) {
+    std::vector<pid_t> tids = ListThreads(pid);
+    for (size_t batch_begin = 0; batch_begin < tids.size();
+         batch_begin += THREAD_NAME_BATCH_SIZE) {
+      if (*exit_requested) {
+        return;
+      }
+      size_t batch_end =
+          std::min(batch_begin + THREAD_NAME_BATCH_SIZE, tids.size());
+      uint64_t timestamp_ns = MonotonicTimestampNs();
+      for (size_t tid_index = batch_begin; tid_index < batch_end; ++tid_index) {
+        pid_t tid = tids[tid_index];
+        std::string name = GetThreadName(tid);
+        if (name.empty()) {
+          continue;
+        }
+        live_tids.insert(tid);
+
+        auto sent_it = thread_names_sent->find(tid);
+        if (sent_it != thread_names_sent->end() && sent_it->second == name) {
+          continue;
+        }
+        thread_names_sent->insert_or_assign(tid, name);
+
+        ThreadName thread_name;
+        thread_name.set_pid(pid);
+        thread_name.set_tid(tid);
+        thread_name.set_name(std::move(name));
+        thread_name.set_timestamp_ns(timestamp_ns);
+        listener_->OnThreadName(std::move(thread_name));
+      }
+    }
+  }
+
+  for (auto sent_it = thread_names_sent->begin();
+       sent_it != thread_names_sent->end();) {
+    if (live_tids.contains(sent_it->first)) {
+      ++sent_it;
+    } else {
+      thread_names_sent->erase(sent_it++);
+    }
   }
 }
 
@@ -953,16 +3650,58 @@ void TracerThread::Reset() {
   uprobes_uretprobes_ids_to_function_.clear();
   uprobes_ids_.clear();
   uretprobes_ids_.clear();
+  uprobes_fds_per_function_.clear();
+  uretprobes_fds_per_function_.clear();
+  uprobes_ring_buffer_fds_per_cpu_.clear();
+  added_function_probes_.clear();
+  {
+    std::lock_guard<std::mutex> lock(added_probes_ids_mutex_);
+    added_uprobes_ids_to_function_.clear();
+    added_uretprobes_ids_to_function_.clear();
+    added_callchain_sampling_ids_.clear();
+  }
+  {
+    std::lock_guard<std::mutex> lock(disabled_function_indices_mutex_);
+    disabled_function_indices_.clear();
+  }
+  sampling_fds_.clear();
+  sampling_period_multiplier_ = 1;
+  added_functions_.clear();
   stack_sampling_ids_.clear();
   task_newtask_ids_.clear();
   task_rename_ids_.clear();
+  sched_wakeup_ids_.clear();
   amdgpu_cs_ioctl_ids_.clear();
   amdgpu_sched_run_job_ids_.clear();
   dma_fence_signaled_ids_.clear();
   callchain_sampling_ids_.clear();
-
-  deferred_events_.clear();
-  stop_deferred_thread_ = false;
+  hybrid_sampling_ids_.clear();
+  lbr_sampling_ids_.clear();
+  sched_switch_counters_ids_.clear();
+  off_cpu_callchain_ids_.clear();
+  futex_wait_ids_.clear();
+  futex_exit_ids_.clear();
+  allocation_ids_.clear();
+  syscall_enter_ids_.clear();
+  syscall_exit_ids_.clear();
+  block_rq_issue_ids_.clear();
+  block_rq_complete_ids_.clear();
+  cpu_frequency_ids_.clear();
+  cpu_idle_ids_.clear();
+  major_page_fault_ids_.clear();
+  minor_page_fault_ids_.clear();
+  mmap_syscall_ids_.clear();
+  munmap_syscall_ids_.clear();
+  excluded_tids_per_sampling_id_.clear();
+
+  cpu_per_ring_buffer_fd_.clear();
+  ring_buffer_class_per_fd_.clear();
+  for (std::atomic<uint64_t>& lost_count : lost_count_per_ring_buffer_class_) {
+    lost_count = 0;
+  }
+  ring_buffer_readers_.clear();
+  deferred_events_ = std::make_unique<BatchQueue<DeferredEvent>>(
+      DEFERRED_EVENT_QUEUE_CAPACITY);
 }
 
 void TracerThread::PrintStatsIfTimerElapsed() {
@@ -975,16 +3714,67 @@ void TracerThread::PrintStatsIfTimerElapsed() {
     LOG("Events per second (last %.1f s):", actual_window_s);
     LOG("  sched switches: %.0f", stats_.sched_switch_count / actual_window_s);
     LOG("  samples: %.0f", stats_.sample_count / actual_window_s);
+    if (unwinding_method_ == CaptureOptions::kDwarf ||
+        unwinding_method_ == CaptureOptions::kHybrid) {
+      LOG("  stack bytes copied per sample: %.0f",
+          static_cast<double>(stats_.stack_bytes_copied) /
+              stats_.sample_count);
+    }
     LOG("  u(ret)probes: %.0f", stats_.uprobes_count / actual_window_s);
     LOG("  gpu events: %.0f", stats_.gpu_events_count / actual_window_s);
+    LOG("  tracer wakeups: %.0f", stats_.wakeup_count / actual_window_s);
+    // This is zero in the steady state, as the memory of events is recycled.
+    LOG("  event memory allocations: %.0f (%lu blocks in use)",
+        (SlabAllocator::GetTotalSlabAllocationCount() -
+         stats_.slab_allocation_count_begin) /
+            actual_window_s,
+        SlabAllocator::GetTotalBlocksInUseCount());
+
+    // Idle time and CPU usage are averaged over the ring buffer readers.
+    uint64_t reader_window_ns = (timestamp_ns - stats_.event_count_begin_ns) *
+                                ring_buffer_readers_.size();
+    LOG("  tracer idle: %.1f%%, cpu: %.1f%%",
+        100.0 * stats_.idle_time_ns / reader_window_ns,
+        100.0 * stats_.reader_cpu_time_ns / reader_window_ns);
+    if (stats_.numa_read_record_count > 0) {
+      LOG("  records read across NUMA nodes: %.1f%%",
+          100.0 * stats_.cross_numa_node_read_record_count /
+              stats_.numa_read_record_count);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(stats_.lost_count_per_buffer_mutex);
+      if (stats_.lost_count_per_buffer.empty()) {
+        LOG("  lost: %.0f", stats_.lost_count / actual_window_s);
+      } else {
+        LOG("  lost: %.0f, of which:", stats_.lost_count / actual_window_s);
+        for (const auto& lost_from_buffer : stats_.lost_count_per_buffer) {
+          LOG("    from %s: %.0f", lost_from_buffer.first->GetName().c_str(),
+              lost_from_buffer.second / actual_window_s);
+        }
+      }
+    }
 
-    if (stats_.lost_count_per_buffer.empty()) {
-      LOG("  lost: %.0f", stats_.lost_count / actual_window_s);
+    // The readers keep reading from ring_buffers_ meanwhile, but don't change
+    // it.
+    std::vector<std::pair<const PerfEventRingBuffer*, double>> max_fill_ratios;
+    double max_fill_ratio = 0.0;
+    for (PerfEventRingBuffer& ring_buffer : ring_buffers_) {
+      double fill_ratio = static_cast<double>(ring_buffer.TakeMaxFillBytes()) /
+                          ring_buffer.GetSizeBytes();
+      max_fill_ratio = std::max(max_fill_ratio, fill_ratio);
+      if (fill_ratio > REPORTED_RING_BUFFER_FILL_RATIO) {
+        max_fill_ratios.emplace_back(&ring_buffer, fill_ratio);
+      }
+    }
+    if (max_fill_ratios.empty()) {
+      LOG("  max ring buffer fill: %.1f%%", 100.0 * max_fill_ratio);
     } else {
-      LOG("  lost: %.0f, of which:", stats_.lost_count / actual_window_s);
-      for (const auto& lost_from_buffer : stats_.lost_count_per_buffer) {
-        LOG("    from %s: %.0f", lost_from_buffer.first->GetName().c_str(),
-            lost_from_buffer.second / actual_window_s);
+      LOG("  max ring buffer fill: %.1f%%, over %.0f%%:",
+          100.0 * max_fill_ratio, 100.0 * REPORTED_RING_BUFFER_FILL_RATIO);
+      for (const auto& [ring_buffer, fill_ratio] : max_fill_ratios) {
+        LOG("    %s: %.1f%%", ring_buffer->GetName().c_str(),
+            100.0 * fill_ratio);
       }
     }
 
@@ -996,8 +3786,83 @@ void TracerThread::PrintStatsIfTimerElapsed() {
     LOG("  discarded samples in u(ret)probes: %.0f (%.1f%%)",
         discarded_samples_in_uretprobes_count / actual_window_s,
         100.0 * discarded_samples_in_uretprobes_count / stats_.sample_count);
+    uint64_t unwind_memo_hit_count = *stats_.unwind_memo_hit_count;
+    LOG("  samples unwound from the memo: %.0f (%.1f%%)",
+        unwind_memo_hit_count / actual_window_s,
+        100.0 * unwind_memo_hit_count / stats_.sample_count);
+    if (capture_statistics_) {
+      SendCaptureStatistics(timestamp_ns, max_fill_ratios);
+    }
+    SendClockOffset();
     stats_.Reset();
   }
 }
 
+void TracerThread::SendClockOffset() {
+  // CLOCK_REALTIME is read between two readings of CLOCK_MONOTONIC.
+  const uint64_t before_ns = MonotonicTimestampNs();
+  const uint64_t realtime_ns = RealtimeTimestampNs();
+  const uint64_t after_ns = MonotonicTimestampNs();
+  const uint64_t timestamp_ns = before_ns + (after_ns - before_ns) / 2;
+  ClockOffset clock_offset;
+  clock_offset.set_timestamp_ns(timestamp_ns);
+  clock_offset.set_realtime_offset_ns(static_cast<int64_t>(realtime_ns) -
+                                      static_cast<int64_t>(timestamp_ns));
+  listener_->OnClockOffset(std::move(clock_offset));
+}
+
+void TracerThread::SendCaptureStatistics(
+    uint64_t timestamp_ns,
+    const std::vector<std::pair<const PerfEventRingBuffer*, double>>&
+        max_fill_ratios) {
+  CaptureStatistics capture_statistics;
+  capture_statistics.set_timestamp_ns(timestamp_ns);
+  capture_statistics.set_window_duration_ns(timestamp_ns -
+                                            stats_.event_count_begin_ns);
+  capture_statistics.set_sched_switch_count(stats_.sched_switch_count);
+  capture_statistics.set_sample_count(stats_.sample_count);
+  capture_statistics.set_uprobes_count(stats_.uprobes_count);
+  capture_statistics.set_gpu_event_count(stats_.gpu_events_count);
+  capture_statistics.set_unwind_error_count(*stats_.unwind_error_count);
+  capture_statistics.set_discarded_samples_in_uretprobes_count(
+      *stats_.discarded_samples_in_uretprobes_count);
+  capture_statistics.set_unwind_memo_hit_count(*stats_.unwind_memo_hit_count);
+  capture_statistics.set_numa_read_record_count(stats_.numa_read_record_count);
+  capture_statistics.set_cross_numa_node_read_record_count(
+      stats_.cross_numa_node_read_record_count);
+
+  capture_statistics.set_lost_count(stats_.lost_count);
+  {
+    std::lock_guard<std::mutex> lock(stats_.lost_count_per_buffer_mutex);
+    for (const auto& lost_from_buffer : stats_.lost_count_per_buffer) {
+      CaptureStatistics::LostRecords* lost_records =
+          capture_statistics.add_lost_records();
+      lost_records->set_ring_buffer_name(lost_from_buffer.first->GetName());
+      lost_records->set_count(lost_from_buffer.second);
+    }
+  }
+  for (const auto& [ring_buffer, fill_ratio] : max_fill_ratios) {
+    CaptureStatistics::RingBufferFill* ring_buffer_fill =
+        capture_statistics.add_ring_buffer_fills();
+    ring_buffer_fill->set_ring_buffer_name(ring_buffer->GetName());
+    ring_buffer_fill->set_max_fill_ratio(fill_ratio);
+  }
+
+  if (stats_.unwind_duration_histogram != nullptr) {
+    const UnwindDurationHistogram& histogram =
+        *stats_.unwind_duration_histogram;
+    size_t bucket_count = histogram.size();
+    while (bucket_count > 0 && histogram[bucket_count - 1] == 0) {
+      --bucket_count;
+    }
+    for (size_t i = 0; i < bucket_count; ++i) {
+      capture_statistics.add_unwind_duration_histogram(histogram[i]);
+    }
+  }
+
+  capture_statistics.set_processor_queued_event_count(
+      stats_.processor_queued_event_count.load(std::memory_order_relaxed));
+  listener_->OnCaptureStatistics(std::move(capture_statistics));
+}
+
 }  // namespace LinuxTracing
@@ -6,24 +6,45 @@
 #define ORBIT_LINUX_TRACING_TRACER_THREAD_H_
 
 #include <Function.h>
+#include <OrbitLinuxTracing/ElfCache.h>
+#include <OrbitLinuxTracing/KernelSymbols.h>
 #include <OrbitLinuxTracing/TracerListener.h>
 #include <linux/perf_event.h>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <deque>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <regex>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "AllocationSampler.h"
+#include "BatchQueue.h"
 #include "ContextSwitchManager.h"
+#include "CpuBudgetGovernor.h"
 #include "GpuTracepointEventProcessor.h"
+#include "InstrumentationGovernor.h"
 #include "ManualInstrumentationConfig.h"
 #include "PerfEvent.h"
+#include "PerfEventOpen.h"
 #include "PerfEventProcessor.h"
 #include "PerfEventProcessor2.h"
 #include "PerfEventReaders.h"
 #include "PerfEventRingBuffer.h"
+#include "PerfRecording.h"
+#include "RingBufferSizeTuner.h"
+#include "SchedulingSliceCountersManager.h"
+#include "SlabAllocator.h"
+#include "UprobesUnwindingVisitor.h"
+#include "UsedStackSizeTracker.h"
 #include "Utils.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
@@ -33,7 +54,10 @@ namespace LinuxTracing {
 
 class TracerThread {
  public:
-  explicit TracerThread(const CaptureOptions& capture_options);
+  explicit TracerThread(
+      const CaptureOptions& capture_options,
+      std::shared_ptr<ElfCache> elf_cache = nullptr,
+      std::shared_ptr<KernelSymbols> kernel_symbols = nullptr);
 
   TracerThread(const TracerThread&) = delete;
   TracerThread& operator=(const TracerThread&) = delete;
@@ -42,8 +66,21 @@ class TracerThread {
 
   void SetListener(TracerListener* listener) { listener_ = listener; }
 
+  // The updates are applied while the capture runs, see
+  // RunInstrumentedFunctionsUpdater.
+  void SetInstrumentedFunctionsUpdates(
+      std::shared_ptr<BatchQueue<InstrumentedFunctionsUpdate>> updates) {
+    instrumented_functions_updates_ = std::move(updates);
+  }
+
   void Run(const std::shared_ptr<std::atomic<bool>>& exit_requested);
 
+  // Reads the records of a perf recording, see
+  // CaptureOptions.perf_recording_path, instead of opening the events, and
+  // reports them to the listener as Run would have, as fast as possible. This
+  // TracerThread must have been created with the recorded capture options.
+  void Replay(PerfRecording recording);
+
  private:
   static std::optional<uint64_t> ComputeSamplingPeriodNs(
       double sampling_frequency) {
@@ -57,16 +94,77 @@ class TracerThread {
     }
   }
 
+  // Returns nullopt for an unknown event type or a period of zero.
+  static std::optional<SamplingEvent> ComputeSamplingEvent(
+      const CaptureOptions::SamplingConfiguration& sampling_configuration) {
+    if (sampling_configuration.period() == 0) {
+      return std::nullopt;
+    }
+    SamplingEvent sampling_event;
+    sampling_event.period = sampling_configuration.period();
+    switch (sampling_configuration.event_type()) {
+      case CaptureOptions::SamplingConfiguration::kCpuClock:
+        sampling_event.type = PERF_TYPE_SOFTWARE;
+        sampling_event.config = PERF_COUNT_SW_CPU_CLOCK;
+        return sampling_event;
+      case CaptureOptions::SamplingConfiguration::kCycles:
+        sampling_event.type = PERF_TYPE_HARDWARE;
+        sampling_event.config = PERF_COUNT_HW_CPU_CYCLES;
+        return sampling_event;
+      case CaptureOptions::SamplingConfiguration::kInstructions:
+        sampling_event.type = PERF_TYPE_HARDWARE;
+        sampling_event.config = PERF_COUNT_HW_INSTRUCTIONS;
+        return sampling_event;
+      case CaptureOptions::SamplingConfiguration::kCacheMisses:
+        sampling_event.type = PERF_TYPE_HARDWARE;
+        sampling_event.config = PERF_COUNT_HW_CACHE_MISSES;
+        return sampling_event;
+      case CaptureOptions::SamplingConfiguration::kBranchMisses:
+        sampling_event.type = PERF_TYPE_HARDWARE;
+        sampling_event.config = PERF_COUNT_HW_BRANCH_MISSES;
+        return sampling_event;
+      default:
+        return std::nullopt;
+    }
+  }
+
+  // The kernel requires the size of the stack dump to be a multiple of 8.
+  static uint16_t ComputeStackDumpSize(
+      uint32_t requested_stack_dump_size,
+      CaptureOptions::UnwindingMethod unwinding_method) {
+    if (unwinding_method == CaptureOptions::kHybrid) {
+      if (requested_stack_dump_size == 0) {
+        return SAMPLE_STACK_USER_SIZE_HYBRID;
+      }
+      requested_stack_dump_size = std::min<uint32_t>(
+          requested_stack_dump_size, SAMPLE_STACK_USER_SIZE_HYBRID_MAX);
+    }
+    if (requested_stack_dump_size == 0 ||
+        requested_stack_dump_size > SAMPLE_STACK_USER_SIZE) {
+      return SAMPLE_STACK_USER_SIZE;
+    }
+    return static_cast<uint16_t>(
+        std::max<uint32_t>(requested_stack_dump_size / 8 * 8, 8));
+  }
+
+  // Returns nullopt for a function of a process that is not captured.
+  [[nodiscard]] std::optional<Function> CreateFunction(
+      const CaptureOptions::InstrumentedFunction& instrumented_function) const;
+
   bool OpenContextSwitches(const std::vector<int32_t>& cpus);
-  void InitUprobesEventProcessor();
+  void InitUprobesEventProcessor(
+      const absl::flat_hash_map<pid_t, std::string>& initial_maps_per_pid);
   bool OpenUserSpaceProbes(const std::vector<int32_t>& cpus);
-  bool OpenUprobes(const LinuxTracing::Function& function,
-                   const std::vector<int32_t>& cpus,
-                   absl::flat_hash_map<int32_t, int>* fds_per_cpu);
-  bool OpenUretprobes(const LinuxTracing::Function& function,
-                      const std::vector<int32_t>& cpus,
-                      absl::flat_hash_map<int32_t, int>* fds_per_cpu);
+  // These return the file descriptor, or -1 on error.
+  static int OpenUprobes(const LinuxTracing::Function& function, int32_t cpu,
+                         uint32_t wakeup_watermark);
+  static int OpenUretprobes(const LinuxTracing::Function& function,
+                            int32_t cpu, uint32_t wakeup_watermark);
   bool OpenMmapTask(const std::vector<int32_t>& cpus);
+  void InitSamplingConfigurations(const CaptureOptions& capture_options);
+  // Returns the file descriptor, or -1 on error.
+  int OpenSamplingEvent(const SamplingEvent& sampling_event, pid_t tid,
+                        int32_t cpu, uint32_t wakeup_watermark) const;
   bool OpenSampling(const std::vector<int32_t>& cpus);
 
   void AddUprobesFileDescriptors(
@@ -87,17 +185,163 @@ class TracerThread {
 
   static bool OpenRingBuffersForTracepoint(
       const char* tracepoint_category, const char* tracepoint_name,
-      const std::vector<int32_t>& cpus, std::vector<int>* tracing_fds,
+      const std::vector<int32_t>& cpus, uint32_t wakeup_watermark,
+      uint64_t ring_buffer_size_kb, std::vector<int>* tracing_fds,
       absl::flat_hash_set<uint64_t>* tracepoint_ids,
       absl::flat_hash_map<int32_t, int>* tracepoint_ring_buffer_fds_per_cpu,
       std::vector<PerfEventRingBuffer>* ring_buffers);
-  bool OpenTracepoints(const std::vector<int32_t>& cpus);
+  // The wakeups, with trace_thread_state_, are traced on all_cpus, as the
+  // threads of pids_ can be woken up from any cpu, and so are the block I/O
+  // requests, with trace_block_io_, which can complete on any cpu.
+  bool OpenTracepoints(const std::vector<int32_t>& cpus,
+                       const std::vector<int32_t>& all_cpus);
+  bool OpenSchedSwitchCounters(const std::vector<int32_t>& cpus);
+  bool OpenOffCpuCallchains(const std::vector<int32_t>& cpus);
+  // The sys_enter_futex records, with callchains, and the sys_exit_futex ones
+  // of a cpu share a ring buffer, to be in order.
+  bool OpenLockContention(const std::vector<int32_t>& cpus);
+  // The uprobes of malloc, in the module of the first process of pids_ found
+  // by FindMallocModulePath.
+  bool OpenAllocationUprobes(const std::vector<int32_t>& cpus);
+  // The major-faults and minor-faults software events, with callchains, and
+  // the sys_enter_mmap and sys_enter_munmap tracepoints of a cpu share a ring
+  // buffer, like for OpenLockContention.
+  bool OpenPageFaults(const std::vector<int32_t>& cpus);
 
   bool InitGpuTracepointEventProcessor();
   bool OpenGpuTracepoints(const std::vector<int32_t>& cpus);
 
+  // A thread reading from the ring buffers of a subset of the CPUs. The
+  // events it defers are only merged in order by PerfEventProcessor2.
+  struct RingBufferReader {
+    size_t index = 0;
+    std::vector<int32_t> cpus;
+    // The NUMA node of all of cpus, -1 if they span several or the node is
+    // not known.
+    int numa_node = -1;
+    std::vector<PerfEventRingBuffer*> ring_buffers;
+    uint64_t last_thread_cpu_time_ns = 0;
+    // The last watermark deferred for each ring buffer, by file descriptor.
+    absl::flat_hash_map<int, uint64_t> last_watermark_ns_by_fd;
+    // Sent to the listener together after each pass over the ring buffers.
+    std::vector<SchedulingSlice> scheduling_slices;
+    // The fill ratio and the index of the ring buffers to read in a pass,
+    // reused by ReadRingBuffersByFill.
+    std::vector<std::pair<double, size_t>> read_order;
+  };
+
+  struct OpenPhase {
+    std::string name;
+    // Returns false on errors.
+    std::function<bool()> open;
+  };
+  // Runs the phases in parallel and returns how long each took.
+  static std::vector<CaptureSetupPhase> RunOpenPhases(
+      const std::vector<OpenPhase>& open_phases);
+
+  static RingBufferSizesKb ComputeRingBufferSizesKb(
+      const CaptureOptions& capture_options);
+  // Shared by the captures with auto_ring_buffer_sizes, which tune it.
+  static RingBufferSizeTuner& GetRingBufferSizeTuner();
+  [[nodiscard]] uint64_t GetRingBufferSizeKb(
+      RingBufferClass ring_buffer_class) const {
+    return ring_buffer_sizes_kb_[static_cast<size_t>(ring_buffer_class)];
+  }
+  // Requires opened_events_mutex_.
+  void AddRingBufferFd(int ring_buffer_fd, int32_t cpu,
+                       RingBufferClass ring_buffer_class);
+
+  // Distributes ring_buffers_ among ring_buffer_readers_ by CPU, keeping the
+  // CPUs of a reader on the same NUMA node when possible: the kernel allocates
+  // the ring buffer of a CPU on its node, which is then the cheapest to read
+  // it from.
+  void InitRingBufferReaders();
+  // Runs the ring buffer readers until exit_requested, on this thread if there
+  // is only one.
+  void RunRingBufferReaders(
+      const std::shared_ptr<std::atomic<bool>>& exit_requested);
+  void RunRingBufferReader(
+      RingBufferReader* reader,
+      const std::shared_ptr<std::atomic<bool>>& exit_requested);
+  // Once the ring buffer readers are done: waits for deferred_events_thread to
+  // pass on the deferred events, and for uprobes_event_processor_ to process
+  // them all, including the stack samples still being unwound.
+  void FinishProcessingEvents(std::thread* deferred_events_thread);
+  // On the cpus of the reader with pin_ring_buffer_reader_threads, else on the
+  // ones of its NUMA node that it is allowed to run on.
+  void PinRingBufferReader(const RingBufferReader& reader);
+  // -1 with a single NUMA node and for the cpus of no node.
+  [[nodiscard]] int GetNumaNode(int32_t cpu) const;
+  // Runs all the threads of the service on the cpus of service_cpus_, or on
+  // the ones outside of target_cpus. Returns the cpus they could run on before,
+  // empty if they weren't pinned.
+  std::vector<int32_t> PinServiceThreads(
+      const std::vector<int32_t>& all_cpus,
+      const std::vector<int32_t>& target_cpus);
+  void UpdateReaderCpuTime(RingBufferReader* reader);
+
+  // In flight recorder mode, enables the events and only waits for
+  // exit_requested, then replaces ring_buffers_ with snapshots of their last
+  // flight_recorder_window_ms_, to be read like in a regular capture.
+  void RecordUntilExitRequested(
+      const std::shared_ptr<std::atomic<bool>>& exit_requested);
+  // Reads all the records of the snapshots of reader, which don't change, or
+  // of the ring buffers of a replayed perf recording.
+  void ReadRingBufferSnapshots(RingBufferReader* reader);
+
+  // With perf_recording_path_: writes the header of the recording, bundles the
+  // files of the initial maps and makes the ring buffers write their records
+  // to perf_recording_writer_. Call before enabling the events.
+  void StartPerfRecording(
+      const absl::flat_hash_map<pid_t, std::string>& initial_maps_per_pid);
+  // Restores the stream ids of the header of a replayed perf recording.
+  void RestoreStreamIds(const PerfRecordingHeader& header);
+  // The stream ids recorded in PerfRecordingHeader.stream_ids, by kind.
+  std::vector<std::pair<std::string, absl::flat_hash_set<uint64_t>*>>
+  GetStreamIdSets();
+
+  // Returns the wakeup_watermark to pass to perf_event_open for events that
+  // write to a ring buffer of the specified size.
+  uint32_t ComputeWakeupWatermark(uint64_t ring_buffer_size_kb) const;
+
+  // Read from all ring buffers in turn, sleeping for a fixed amount of time
+  // when they are all empty.
+  void PollAndReadRingBuffers(
+      RingBufferReader* reader,
+      const std::shared_ptr<std::atomic<bool>>& exit_requested);
+  // Block with epoll until ring buffers pass their wakeup_watermark and only
+  // read from those, plus periodically from all ring buffers so that no event
+  // is read later than PerfEventProcessor2::PROCESSING_DELAY_MS.
+  void WaitForAndReadRingBuffers(
+      RingBufferReader* reader,
+      const std::shared_ptr<std::atomic<bool>>& exit_requested);
+  // Reads a batch from each of the ring buffers of reader that are marked in
+  // to_read, fullest first, and unmarks those that were empty. Returns how
+  // many were unmarked.
+  size_t ReadRingBuffersByFill(
+      RingBufferReader* reader, std::vector<bool>* to_read,
+      const std::shared_ptr<std::atomic<bool>>& exit_requested);
+  // Returns whether at least one record was read from this ring buffer.
+  bool ReadRingBufferBatch(
+      PerfEventRingBuffer* ring_buffer, RingBufferReader* reader,
+      const std::shared_ptr<std::atomic<bool>>& exit_requested,
+      int32_t max_records = ROUND_ROBIN_POLLING_BATCH_SIZE);
+  // From ROUND_ROBIN_POLLING_BATCH_SIZE for an empty ring buffer to
+  // FULL_RING_BUFFER_BATCH_SIZE for a full one.
+  static int32_t ComputeRingBufferBatchSize(double fill_ratio);
+  // Called when a ring buffer appears empty, to let PerfEventProcessor2
+  // process the events that no record still in the ring buffer can precede.
+  void DeferRingBufferWatermark(PerfEventRingBuffer* ring_buffer,
+                                RingBufferReader* reader);
+
   void ProcessContextSwitchCpuWideEvent(const perf_event_header& header,
-                                        PerfEventRingBuffer* ring_buffer);
+                                        PerfEventRingBuffer* ring_buffer,
+                                        RingBufferReader* reader);
+  void SendSchedulingSlices(RingBufferReader* reader);
+  void ProcessSchedSwitchCountersEvent(const perf_event_header& header,
+                                       PerfEventRingBuffer* ring_buffer);
+  void ProcessSchedWakeupEvent(const perf_event_header& header,
+                               PerfEventRingBuffer* ring_buffer);
   void ProcessForkEvent(const perf_event_header& header,
                         PerfEventRingBuffer* ring_buffer);
   void ProcessExitEvent(const perf_event_header& header,
@@ -109,94 +353,445 @@ class TracerThread {
   void ProcessLostEvent(const perf_event_header& header,
                         PerfEventRingBuffer* ring_buffer);
 
+  // Either an event, or only the watermark of the ring buffer with file
+  // descriptor origin_fd for PerfEventProcessor2::UpdateWatermark.
+  struct DeferredEvent {
+    int origin_fd;
+    uint64_t watermark_ns;
+    std::unique_ptr<PerfEvent> event;
+  };
+
   void DeferEvent(std::unique_ptr<PerfEvent> event);
-  std::vector<std::unique_ptr<PerfEvent>> ConsumeDeferredEvents();
   void ProcessDeferredEvents();
 
-  void RetrieveThreadNames();
+  // Runs on its own thread until exit_requested: sends the initial thread
+  // names, then periodically re-reads them to send the renames that were
+  // missed, e.g., the ones before task_rename was enabled.
+  void RunThreadNameRetriever(
+      const std::shared_ptr<std::atomic<bool>>& exit_requested);
+  // Sends the names that differ from thread_names_sent, which is updated, and
+  // removes the threads that have exited from it. Reads /proc in batches, so
+  // that exit_requested is honored promptly even with thousands of threads.
+  void RetrieveThreadNames(
+      absl::flat_hash_map<pid_t, std::string>* thread_names_sent,
+      const std::shared_ptr<std::atomic<bool>>& exit_requested);
+
+  // Runs on its own thread until exit_requested, with
+  // manual_instrumentation_shared_memory_: reads the shared-memory buffers of
+  // the scopes of the captured processes, and picks up the buffers of new
+  // threads less often.
+  void RunManualInstrumentationReader(
+      const std::shared_ptr<std::atomic<bool>>& exit_requested);
+  // Runs on its own thread until exit_requested, with trace_vulkan_layer_:
+  // reads the shared-memory buffers of OrbitVulkanLayer in the captured
+  // processes, and picks up the buffers of processes that load it later less
+  // often.
+  void RunVulkanLayerReader(
+      const std::shared_ptr<std::atomic<bool>>& exit_requested);
+
+  // Runs on its own thread, with instrumentation_governor_: disables the
+  // uprobes and uretprobes of the functions called too often at the beginning
+  // of the capture, unless exit_requested comes first.
+  void RunInstrumentationGovernor(
+      const std::shared_ptr<std::atomic<bool>>& exit_requested);
+  // Disables the uprobes and uretprobes of the hot functions and reports them,
+  // except the manual instrumentation functions and the ones already disabled.
+  // Returns the number of functions disabled.
+  int DisableInstrumentedFunctions(
+      const std::vector<InstrumentationGovernor::HotFunction>& hot_functions);
+  [[nodiscard]] bool CanDisableInstrumentedFunction(size_t function_index);
+
+  // Runs on its own thread, with cpu_budget_governor_, until exit_requested:
+  // measures the CPU usage of the service window after window, and takes the
+  // steps of the governor.
+  void RunCpuBudgetGovernor(
+      const std::shared_ptr<std::atomic<bool>>& exit_requested);
+  void HalveSamplingRate();
+  // Replaces the sampling events with callchain samples at the same period,
+  // which go to the same ring buffers. Returns false, and keeps the current
+  // ones, if some could not be opened.
+  bool SwitchSamplingToFramePointers();
+  // The hottest functions, among the ones that can still be disabled, that
+  // add up to half of their calls over the window.
+  std::vector<InstrumentationGovernor::HotFunction> SelectHotFunctionsToDisable(
+      const std::vector<InstrumentationGovernor::HotFunction>& hot_functions);
+
+  // Runs on its own thread, with instrumented_functions_updates_, until
+  // exit_requested: applies each update and reports it with a
+  // CaptureSetupPhase.
+  void RunInstrumentedFunctionsUpdater(
+      const std::shared_ptr<std::atomic<bool>>& exit_requested);
+  // Returns false if some of the probes could not be opened.
+  bool UpdateInstrumentedFunctions(const InstrumentedFunctionsUpdate& update);
+  // Opens the uprobes and uretprobes of function on the cpus of
+  // uprobes_ring_buffer_fds_per_cpu_ and redirects them to these ring buffers.
+  bool OpenAddedUserSpaceProbes(const Function& function,
+                                std::vector<int>* uprobes_fds,
+                                std::vector<int>* uretprobes_fds);
+  // Finds the file descriptors of the probes of the function, whether it was
+  // instrumented from the start or added. Returns false if there is none.
+  bool FindUserSpaceProbesFds(pid_t pid, uint64_t address,
+                              std::vector<int>* uprobes_fds,
+                              std::vector<int>* uretprobes_fds) const;
+  // The function of the probes of a function added during the capture, which
+  // are not in uprobes_uretprobes_ids_to_function_, or nullptr.
+  const Function* FindAddedFunction(uint64_t stream_id, bool* is_uretprobe);
+  // Whether the stream id is of a callchain sample opened by
+  // SwitchSamplingToFramePointers, and then its excluded tids, or nullptr.
+  bool FindAddedCallchainSampling(
+      uint64_t stream_id, const absl::flat_hash_set<pid_t>** excluded_tids);
 
   void PrintStatsIfTimerElapsed();
+  // At the beginning of the capture and with each window of stats.
+  void SendClockOffset();
+  // Called by PrintStatsIfTimerElapsed with capture_statistics_, before the
+  // stats are reset.
+  void SendCaptureStatistics(
+      uint64_t timestamp_ns,
+      const std::vector<std::pair<const PerfEventRingBuffer*, double>>&
+          max_fill_ratios);
 
   void Reset();
 
+  // There are only a few captured processes, hence a linear search is faster
+  // than a hash set.
+  [[nodiscard]] bool IsCapturedPid(pid_t pid) const {
+    return std::find(pids_.begin(), pids_.end(), pid) != pids_.end();
+  }
+  [[nodiscard]] bool IsSampledPid(pid_t pid) const {
+    return sample_all_processes_ || IsCapturedPid(pid);
+  }
+
   // Number of records to read consecutively from a perf_event_open ring buffer
-  // before switching to another one.
+  // before switching to another one, at least, so that no ring buffer starves
+  // while fuller ones are read first, and at most, for a full one.
   static constexpr int32_t ROUND_ROBIN_POLLING_BATCH_SIZE = 5;
+  static constexpr int32_t FULL_RING_BUFFER_BATCH_SIZE = 100;
+  // Ring buffers with a higher maximum fill ratio in a window of the stats are
+  // reported.
+  static constexpr double REPORTED_RING_BUFFER_FILL_RATIO = 0.5;
 
   // These values are supposed to be large enough to accommodate enough events
   // in case TracerThread::Run's thread is not scheduled for a few tens of
-  // milliseconds.
-  static constexpr uint64_t CONTEXT_SWITCHES_RING_BUFFER_SIZE_KB = 2 * 1024;
-  static constexpr uint64_t UPROBES_RING_BUFFER_SIZE_KB = 8 * 1024;
-  static constexpr uint64_t MMAP_TASK_RING_BUFFER_SIZE_KB = 64;
-  static constexpr uint64_t SAMPLING_RING_BUFFER_SIZE_KB = 16 * 1024;
-  static constexpr uint64_t TRACEPOINTS_RING_BUFFER_SIZE_KB = 256;
-  static constexpr uint64_t GPU_TRACING_RING_BUFFER_SIZE_KB = 256;
+  // milliseconds. By RingBufferClass.
+  static constexpr RingBufferSizesKb DEFAULT_RING_BUFFER_SIZES_KB = {
+      2 * 1024,   // kContextSwitches
+      8 * 1024,   // kUprobes
+      64,         // kMmapTask
+      16 * 1024,  // kSampling
+      256,        // kTracepoints
+      256,        // kGpuTracing
+      2 * 1024,   // kSchedSwitchCounters
+  };
 
   static constexpr uint32_t IDLE_TIME_ON_EMPTY_RING_BUFFERS_US = 100;
-  static constexpr uint32_t IDLE_TIME_ON_EMPTY_DEFERRED_EVENTS_US = 1000;
+  // Beyond this, the ring buffer readers wait for the deferred events to be
+  // processed, rather than memory growing.
+  static constexpr size_t DEFERRED_EVENT_QUEUE_CAPACITY = 1024 * 1024;
+  // The kernel takes the timestamp of a record shortly before writing it, so
+  // a ring buffer that is empty at some point could still receive records
+  // slightly older than that.
+  static constexpr uint64_t RING_BUFFER_WATERMARK_SLACK_NS = 1'000'000;
+  // Limits the watermarks deferred for ring buffers that are often empty.
+  static constexpr uint64_t RING_BUFFER_WATERMARK_PERIOD_NS = 10'000'000;
+
+  static constexpr uint64_t DEFAULT_FLIGHT_RECORDER_WINDOW_MS = 10'000;
+  static constexpr uint32_t FLIGHT_RECORDER_EXIT_CHECK_PERIOD_US = 100'000;
+
+  // As the heap profiler of tcmalloc.
+  static constexpr uint64_t DEFAULT_ALLOCATION_SAMPLING_INTERVAL_BYTES =
+      512 * 1024;
+
+  static constexpr size_t THREAD_NAME_BATCH_SIZE = 256;
+  static constexpr uint64_t THREAD_NAME_RECONCILIATION_PERIOD_MS = 2000;
+  static constexpr uint64_t THREAD_NAME_EXIT_CHECK_PERIOD_MS = 10;
+
+  // A thread's buffer holds orbit_api::kSharedMemoryEventCount events, i.e.,
+  // 1.6 million events per second at this period.
+  static constexpr uint64_t MANUAL_INSTRUMENTATION_READ_PERIOD_MS = 10;
+  static constexpr uint64_t MANUAL_INSTRUMENTATION_UPDATE_PERIOD_MS = 500;
+  // The layer only writes a submission once its GPU work has completed.
+  static constexpr uint64_t VULKAN_LAYER_READ_PERIOD_MS = 10;
+  static constexpr uint64_t VULKAN_LAYER_UPDATE_PERIOD_MS = 500;
+
+  static constexpr uint64_t INSTRUMENTATION_GOVERNOR_EXIT_CHECK_PERIOD_MS = 10;
+  static constexpr uint64_t INSTRUMENTED_FUNCTIONS_UPDATE_WAIT_MS = 10;
+  // Between disabling the uprobes and the uretprobes of the hot functions, for
+  // the calls already running to return.
+  static constexpr uint64_t UPROBES_DISABLE_GRACE_PERIOD_MS = 100;
+  static constexpr uint64_t CPU_BUDGET_GOVERNOR_EXIT_CHECK_PERIOD_MS = 10;
+
+  // With ring_buffer_wakeups_, a ring buffer is reported as readable when it's
+  // filled by 1/RING_BUFFER_WAKEUP_WATERMARK_DIVISOR of its size, and all ring
+  // buffers are read at least every RING_BUFFERS_WAKEUP_TIMEOUT_MS. The
+  // timeout needs to be well below PerfEventProcessor2::PROCESSING_DELAY_MS.
+  static constexpr uint64_t RING_BUFFER_WAKEUP_WATERMARK_DIVISOR = 4;
+  static constexpr int RING_BUFFERS_WAKEUP_TIMEOUT_MS = 10;
+
+  static constexpr uint32_t MAX_RING_BUFFER_READER_THREAD_COUNT = 64;
+  static constexpr uint32_t MAX_UNWINDING_THREAD_COUNT = 64;
+  // Processes that are sampled but not captured whose maps are remembered.
+  static constexpr size_t MAX_ON_DEMAND_PROCESS_COUNT = 256;
 
   bool trace_context_switches_;
-  pid_t pid_;
-  uint64_t sampling_period_ns_;
+  bool trace_performance_counters_;
+  // Only with kFramePointers: the other unwinding methods copy the stack.
+  bool sample_all_processes_;
+  bool auto_ring_buffer_sizes_;
+  RingBufferSizesKb ring_buffer_sizes_kb_;
+  bool flight_recorder_;
+  uint64_t flight_recorder_window_ms_;
+  bool capture_statistics_;
+  bool introspection_;
+  bool manual_instrumentation_shared_memory_;
+  bool trace_vulkan_layer_;
+  // Not with the flight recorder.
+  std::string perf_recording_path_;
+  // Recorded in the header, without perf_recording_path.
+  CaptureOptions perf_recording_capture_options_;
+  // CaptureOptions.pid, followed by the additional_pids.
+  std::vector<pid_t> pids_;
+
+  struct SamplingConfiguration {
+    SamplingEvent event;
+    // Empty means all the threads of pids_, except excluded_tids.
+    std::vector<pid_t> tids;
+    absl::flat_hash_set<pid_t> excluded_tids;
+  };
+  std::vector<SamplingConfiguration> sampling_configurations_;
   CaptureOptions::UnwindingMethod unwinding_method_;
+  // Only used with kHybrid.
+  absl::flat_hash_set<std::string> frame_pointer_safe_module_paths_;
   std::vector<Function> instrumented_functions_;
   bool trace_gpu_driver_;
+  bool trace_thread_state_;
+  // Requires trace_context_switches_: the switch-ins end the off-CPU time.
+  bool trace_off_cpu_;
+  bool trace_lock_contention_;
+  uint64_t min_lock_wait_duration_ns_;
+  bool trace_allocations_;
+  bool trace_syscalls_;
+  // The tracepoint filter of the syscalls, or empty for all of them.
+  std::string syscall_filter_;
+  uint64_t min_syscall_duration_ns_;
+  bool trace_block_io_;
+  bool trace_cpu_power_states_;
+  bool trace_page_faults_;
+  uint64_t minor_page_fault_sampling_period_;
+  bool ring_buffer_wakeups_;
+  uint32_t ring_buffer_reader_thread_count_;
+  bool pin_ring_buffer_reader_threads_;
+  bool pin_service_threads_;
+  std::string service_cpus_;
+  uint32_t unwinding_thread_count_;
+  std::shared_ptr<ElfCache> elf_cache_;
+  // Only set with kernel_callchains.
+  std::shared_ptr<KernelSymbols> kernel_symbols_;
+  uint16_t stack_dump_size_;
+  // Only set with adaptive_stack_dump.
+  std::shared_ptr<UsedStackSizeTracker> used_stack_size_tracker_;
 
   TracerListener* listener_ = nullptr;
 
   std::vector<int> tracing_fds_;
   absl::flat_hash_map<int32_t, std::vector<int>> fds_per_cpu_;
   std::vector<PerfEventRingBuffer> ring_buffers_;
+  absl::flat_hash_map<int, int32_t> cpu_per_ring_buffer_fd_;
+  absl::flat_hash_map<int, RingBufferClass> ring_buffer_class_per_fd_;
+  std::vector<std::unique_ptr<RingBufferReader>> ring_buffer_readers_;
+  // Only set on machines with more than one NUMA node, by CPU, see
+  // GetNumaNodeByCpu.
+  std::vector<int> numa_node_by_cpu_;
 
   absl::flat_hash_map<uint64_t, const Function*>
       uprobes_uretprobes_ids_to_function_;
   absl::flat_hash_set<uint64_t> uprobes_ids_;
   absl::flat_hash_set<uint64_t> uretprobes_ids_;
+  // By index in instrumented_functions_.
+  std::vector<std::vector<int>> uprobes_fds_per_function_;
+  std::vector<std::vector<int>> uretprobes_fds_per_function_;
   absl::flat_hash_set<uint64_t> stack_sampling_ids_;
   absl::flat_hash_set<uint64_t> task_newtask_ids_;
   absl::flat_hash_set<uint64_t> task_rename_ids_;
+  // Of sched_waking, or of sched_wakeup on kernels without it.
+  absl::flat_hash_set<uint64_t> sched_wakeup_ids_;
   absl::flat_hash_set<uint64_t> amdgpu_cs_ioctl_ids_;
   absl::flat_hash_set<uint64_t> amdgpu_sched_run_job_ids_;
   absl::flat_hash_set<uint64_t> dma_fence_signaled_ids_;
   absl::flat_hash_set<uint64_t> callchain_sampling_ids_;
-
-  std::atomic<bool> stop_deferred_thread_ = false;
-  std::vector<std::unique_ptr<PerfEvent>> deferred_events_;
-  std::mutex deferred_events_mutex_;
+  absl::flat_hash_set<uint64_t> hybrid_sampling_ids_;
+  absl::flat_hash_set<uint64_t> lbr_sampling_ids_;
+  absl::flat_hash_set<uint64_t> sched_switch_counters_ids_;
+  absl::flat_hash_set<uint64_t> off_cpu_callchain_ids_;
+  absl::flat_hash_set<uint64_t> futex_wait_ids_;
+  absl::flat_hash_set<uint64_t> futex_exit_ids_;
+  absl::flat_hash_set<uint64_t> allocation_ids_;
+  absl::flat_hash_set<uint64_t> syscall_enter_ids_;
+  absl::flat_hash_set<uint64_t> syscall_exit_ids_;
+  absl::flat_hash_set<uint64_t> block_rq_issue_ids_;
+  absl::flat_hash_set<uint64_t> block_rq_complete_ids_;
+  absl::flat_hash_set<uint64_t> cpu_frequency_ids_;
+  absl::flat_hash_set<uint64_t> cpu_idle_ids_;
+  absl::flat_hash_set<uint64_t> major_page_fault_ids_;
+  absl::flat_hash_set<uint64_t> minor_page_fault_ids_;
+  absl::flat_hash_set<uint64_t> mmap_syscall_ids_;
+  absl::flat_hash_set<uint64_t> munmap_syscall_ids_;
+  // Points into sampling_configurations_.
+  absl::flat_hash_map<uint64_t, const absl::flat_hash_set<pid_t>*>
+      excluded_tids_per_sampling_id_;
+
+  // Only accessed by the ring buffer readers, hence the mutexes are only
+  // contended when there is more than one.
+  // The context switches of a cpu are all read by the same RingBufferReader,
+  // and ContextSwitchManager keeps the state of each cpu separately, so the
+  // readers use it without synchronization.
   ContextSwitchManager context_switch_manager_;
+  // Same as context_switch_manager_, for the sched_switch_counters events.
+  SchedulingSliceCountersManager scheduling_slice_counters_manager_;
+  // The allocations of a thread can be read by any reader.
+  std::mutex allocation_sampler_mutex_;
+  AllocationSampler allocation_sampler_;
+  // Filled by the ring buffer readers and drained by the
+  // ProcessDeferredEvents thread into uprobes_event_processor_.
+  std::unique_ptr<BatchQueue<DeferredEvent>> deferred_events_;
   std::unique_ptr<PerfEventProcessor2> uprobes_event_processor_;
+  // Visited by uprobes_event_processor_, which it outlives.
   std::unique_ptr<GpuTracepointEventProcessor> gpu_event_processor_;
-
+  // Guards tracing_fds_, ring_buffers_, cpu_per_ring_buffer_fd_ and
+  // ring_buffer_class_per_fd_ while the events are opened in parallel.
+  std::mutex opened_events_mutex_;
+  // Over the whole capture, for auto_ring_buffer_sizes_.
+  std::array<std::atomic<uint64_t>, RING_BUFFER_CLASS_COUNT>
+      lost_count_per_ring_buffer_class_{};
+
+  // The counters are updated by all the ring buffer readers.
   struct EventStats {
     void Reset() {
       event_count_begin_ns = MonotonicTimestampNs();
+      slab_allocation_count_begin =
+          SlabAllocator::GetTotalSlabAllocationCount();
       sched_switch_count = 0;
       sample_count = 0;
+      stack_bytes_copied = 0;
       uprobes_count = 0;
       lost_count = 0;
-      lost_count_per_buffer.clear();
+      {
+        std::lock_guard<std::mutex> lock(lost_count_per_buffer_mutex);
+        lost_count_per_buffer.clear();
+      }
+      wakeup_count = 0;
+      idle_time_ns = 0;
+      reader_cpu_time_ns = 0;
+      numa_read_record_count = 0;
+      cross_numa_node_read_record_count = 0;
       *unwind_error_count = 0;
       *discarded_samples_in_uretprobes_count = 0;
+      *unwind_memo_hit_count = 0;
+      if (unwind_duration_histogram != nullptr) {
+        for (std::atomic<uint64_t>& count : *unwind_duration_histogram) {
+          count = 0;
+        }
+      }
     }
 
     uint64_t event_count_begin_ns = 0;
-    uint64_t sched_switch_count = 0;
-    uint64_t sample_count = 0;
-    uint64_t uprobes_count = 0;
-    uint64_t gpu_events_count = 0;
-    uint64_t lost_count = 0;
+    uint64_t slab_allocation_count_begin = 0;
+    std::atomic<uint64_t> sched_switch_count = 0;
+    std::atomic<uint64_t> sample_count = 0;
+    // Bytes of the stacks of stack samples copied out of the ring buffers.
+    std::atomic<uint64_t> stack_bytes_copied = 0;
+    std::atomic<uint64_t> uprobes_count = 0;
+    std::atomic<uint64_t> gpu_events_count = 0;
+    std::atomic<uint64_t> lost_count = 0;
     absl::flat_hash_map<PerfEventRingBuffer*, uint64_t> lost_count_per_buffer{};
+    std::mutex lost_count_per_buffer_mutex;
+    // Times the ring buffer readers woke up to read from the ring buffers, time
+    // they spent sleeping or blocked waiting for them, and CPU time they used.
+    std::atomic<uint64_t> wakeup_count = 0;
+    std::atomic<uint64_t> idle_time_ns = 0;
+    std::atomic<uint64_t> reader_cpu_time_ns = 0;
+    // Records read from the ring buffers, and of those the ones read from a
+    // CPU on a different NUMA node than the ring buffer's. Only counted on
+    // machines with more than one NUMA node.
+    std::atomic<uint64_t> numa_read_record_count = 0;
+    std::atomic<uint64_t> cross_numa_node_read_record_count = 0;
     std::shared_ptr<std::atomic<uint64_t>> unwind_error_count =
         std::make_unique<std::atomic<uint64_t>>(0);
     std::shared_ptr<std::atomic<uint64_t>>
         discarded_samples_in_uretprobes_count =
             std::make_unique<std::atomic<uint64_t>>(0);
+    // Stack samples whose frames were reused from the previous sample of the
+    // thread, see LibunwindstackUnwinder::UnwindWithMemo.
+    std::shared_ptr<std::atomic<uint64_t>> unwind_memo_hit_count =
+        std::make_unique<std::atomic<uint64_t>>(0);
+    // Only with capture_statistics_.
+    std::shared_ptr<UnwindDurationHistogram> unwind_duration_histogram;
+    // Set by ProcessDeferredEvents, not reset.
+    std::atomic<uint64_t> processor_queued_event_count = 0;
   };
 
   static constexpr uint64_t EVENT_STATS_WINDOW_S = 5;
   EventStats stats_{};
   ManualInstrumentationConfig manual_instrumentation_config_;
+  // Only with max_instrumented_function_call_rate.
+  std::unique_ptr<InstrumentationGovernor> instrumentation_governor_;
+  // The functions disabled by either governor, by index in
+  // instrumented_functions_.
+  std::mutex disabled_function_indices_mutex_;
+  absl::flat_hash_set<size_t> disabled_function_indices_;
+
+  // Only with max_service_cpu_usage, and not with the flight recorder.
+  std::unique_ptr<CpuBudgetGovernor> cpu_budget_governor_;
+  // Counts the calls of the instrumented functions over each window of
+  // cpu_budget_governor_, only with instrumented functions.
+  std::unique_ptr<InstrumentationGovernor> cpu_budget_call_counter_;
+  struct SamplingFd {
+    int fd;
+    // Points into sampling_configurations_.
+    const SamplingConfiguration* configuration;
+    pid_t tid;
+    int32_t cpu;
+    // The file descriptor of the ring buffer the samples are redirected to.
+    int ring_buffer_fd;
+  };
+  // The enabled sampling events. Only accessed by RunCpuBudgetGovernor once
+  // the capture runs.
+  std::vector<SamplingFd> sampling_fds_;
+  uint64_t sampling_period_multiplier_ = 1;
+
+  std::shared_ptr<BatchQueue<InstrumentedFunctionsUpdate>>
+      instrumented_functions_updates_;
+  // The ring buffer that the uprobes and uretprobes of each cpu are redirected
+  // to, which the probes of the functions added during the capture join.
+  absl::flat_hash_map<int32_t, int> uprobes_ring_buffer_fds_per_cpu_;
+  // The functions added during the capture. A deque, as the events point to
+  // them.
+  std::deque<Function> added_functions_;
+  struct AddedFunctionProbes {
+    const Function* function;
+    std::vector<int> uprobes_fds;
+    std::vector<int> uretprobes_fds;
+  };
+  // Only accessed by RunInstrumentedFunctionsUpdater, by pid and address.
+  absl::flat_hash_map<std::pair<pid_t, uint64_t>, AddedFunctionProbes>
+      added_function_probes_;
+  // Read by the ring buffer readers, for the few records whose stream id is
+  // not in the sets above.
+  std::mutex added_probes_ids_mutex_;
+  absl::flat_hash_map<uint64_t, const Function*> added_uprobes_ids_to_function_;
+  absl::flat_hash_map<uint64_t, const Function*>
+      added_uretprobes_ids_to_function_;
+  // The callchain samples of SwitchSamplingToFramePointers, with their
+  // excluded tids, pointing into sampling_configurations_, or nullptr.
+  absl::flat_hash_map<uint64_t, const absl::flat_hash_set<pid_t>*>
+      added_callchain_sampling_ids_;
+
+  // Only while recording, written to by the ring buffers and bundling the
+  // files of the mmap records.
+  std::unique_ptr<PerfRecordingWriter> perf_recording_writer_;
+  // During Replay, with the files of the mmap records.
+  bool replaying_ = false;
+  std::string bundled_files_directory_;
 
   static constexpr uint64_t NS_PER_MILLISECOND = 1'000'000;
   static constexpr uint64_t NS_PER_SECOND = 1'000'000'000;
@@ -0,0 +1,141 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "TscClock.h"
+
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+#include <atomic>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "PerfEventOpen.h"
+#include "Utils.h"
+
+namespace LinuxTracing {
+
+namespace {
+constexpr const char* kClockSourcePath =
+    "/sys/devices/system/clocksource/clocksource0/current_clocksource";
+
+// A reading of the TSC and of CLOCK_MONOTONIC at the same time, as far as it
+// gets: of a few attempts, the one where the readings of the TSC around
+// clock_gettime are closest, with the TSC in the middle of them.
+std::pair<uint64_t, uint64_t> ReadTscAndMonotonicNs() {
+  constexpr int kAttemptCount = 5;
+  uint64_t min_width = std::numeric_limits<uint64_t>::max();
+  std::pair<uint64_t, uint64_t> reading{0, 0};
+  for (int i = 0; i < kAttemptCount; ++i) {
+    const uint64_t tsc_before = TscClock::ReadTsc();
+    const uint64_t ns = MonotonicTimestampNs();
+    const uint64_t tsc_after = TscClock::ReadTsc();
+    if (tsc_after - tsc_before < min_width) {
+      min_width = tsc_after - tsc_before;
+      reading = {tsc_before + min_width / 2, ns};
+    }
+  }
+  return reading;
+}
+
+// The time_mult and time_shift of the mmap page of a dummy perf event on the
+// calling thread, if the kernel sets them.
+std::optional<std::pair<uint32_t, uint16_t>> ReadKernelTscRate() {
+  perf_event_attr attr{};
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_SOFTWARE;
+  attr.config = PERF_COUNT_SW_DUMMY;
+  attr.exclude_kernel = 1;
+  const int fd = perf_event_open(&attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+  if (fd < 0) return std::nullopt;
+  const size_t page_size = getpagesize();
+  void* memory = mmap(nullptr, page_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) return std::nullopt;
+
+  const auto* page = static_cast<volatile perf_event_mmap_page*>(memory);
+  uint32_t lock;
+  bool cap_user_time;
+  uint32_t mult;
+  uint16_t shift;
+  // The kernel updates the page under this sequence lock.
+  do {
+    lock = page->lock;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    cap_user_time = page->cap_user_time != 0;
+    mult = page->time_mult;
+    shift = page->time_shift;
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while (page->lock != lock);
+  munmap(memory, page_size);
+
+  if (!cap_user_time || mult == 0 || shift > 32) return std::nullopt;
+  return std::make_pair(mult, shift);
+}
+}  // namespace
+
+std::optional<TscClock> TscClock::Create(absl::Duration calibration_duration) {
+  if (!IsTscClockSource()) return std::nullopt;
+
+  const auto [anchor_tsc, anchor_ns] = ReadTscAndMonotonicNs();
+  std::optional<std::pair<uint32_t, uint16_t>> kernel_rate =
+      ReadKernelTscRate();
+  if (kernel_rate.has_value()) {
+    return TscClock{kernel_rate->first, kernel_rate->second, anchor_tsc,
+                    anchor_ns};
+  }
+
+  std::this_thread::sleep_for(absl::ToChronoNanoseconds(calibration_duration));
+  const auto [end_tsc, end_ns] = ReadTscAndMonotonicNs();
+  if (end_tsc <= anchor_tsc || end_ns <= anchor_ns) return std::nullopt;
+  const uint64_t ticks = end_tsc - anchor_tsc;
+  const uint64_t ns = end_ns - anchor_ns;
+  // The largest shift, for the most precision, with which mult fits.
+  using uint128 = unsigned __int128;
+  uint16_t shift = 32;
+  uint128 mult = (static_cast<uint128>(ns) << shift) / ticks;
+  while (shift > 0 && mult > std::numeric_limits<uint32_t>::max()) {
+    --shift;
+    mult = (static_cast<uint128>(ns) << shift) / ticks;
+  }
+  if (mult == 0 || mult > std::numeric_limits<uint32_t>::max()) {
+    return std::nullopt;
+  }
+  return TscClock{static_cast<uint32_t>(mult), shift, end_tsc, end_ns};
+}
+
+bool TscClock::IsTscClockSource() {
+  std::ifstream file{kClockSourcePath};
+  std::string clock_source;
+  return std::getline(file, clock_source) && clock_source == "tsc";
+}
+
+uint64_t TscClock::ReadTsc() { return __rdtsc(); }
+
+uint64_t TscClock::TicksToNs(uint64_t ticks) const {
+  // Split like in perf_event_mmap_page, so that the products can't overflow.
+  const uint64_t quotient = ticks >> shift_;
+  const uint64_t remainder = ticks & ((uint64_t{1} << shift_) - 1);
+  return quotient * mult_ + ((remainder * mult_) >> shift_);
+}
+
+uint64_t TscClock::ToMonotonicNs(uint64_t tsc) const {
+  if (tsc >= anchor_tsc_) {
+    return anchor_ns_ + TicksToNs(tsc - anchor_tsc_);
+  }
+  return anchor_ns_ - TicksToNs(anchor_tsc_ - tsc);
+}
+
+void TscClock::Resync() {
+  const auto [anchor_tsc, anchor_ns] = ReadTscAndMonotonicNs();
+  anchor_tsc_ = anchor_tsc;
+  anchor_ns_ = anchor_ns;
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,57 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_TSC_CLOCK_H_
+#define ORBIT_LINUX_TRACING_TSC_CLOCK_H_
+
+#include <cstdint>
+#include <optional>
+
+#include "absl/time/time.h"
+
+namespace LinuxTracing {
+
+// Converts readings of the time stamp counter to CLOCK_MONOTONIC nanoseconds
+// with integer math only, like the time_mult and time_shift of
+// perf_event_mmap_page. Reading the TSC takes a few nanoseconds and no
+// syscall, so processes can timestamp their events with it and the service
+// converts the timestamps as it reads them.
+//
+// The TSC ticks at a constant rate, while NTP slews CLOCK_MONOTONIC: Resync
+// anchors the conversion at the current readings of both again, which the
+// callers do every few milliseconds while they convert timestamps.
+class TscClock {
+ public:
+  // Only if the kernel itself uses the TSC as clock source, i.e., if it is
+  // invariant and synchronized across cores. The rate is the one the kernel
+  // publishes in the mmap page of a perf event if available, otherwise it is
+  // measured over calibration_duration.
+  [[nodiscard]] static std::optional<TscClock> Create(
+      absl::Duration calibration_duration);
+  [[nodiscard]] static bool IsTscClockSource();
+  [[nodiscard]] static uint64_t ReadTsc();
+
+  // ns = anchor_ns + ((tsc - anchor_tsc) * mult) >> shift, with shift <= 32.
+  TscClock(uint32_t mult, uint16_t shift, uint64_t anchor_tsc,
+           uint64_t anchor_ns)
+      : mult_(mult),
+        shift_(shift),
+        anchor_tsc_(anchor_tsc),
+        anchor_ns_(anchor_ns) {}
+
+  [[nodiscard]] uint64_t ToMonotonicNs(uint64_t tsc) const;
+  void Resync();
+
+ private:
+  [[nodiscard]] uint64_t TicksToNs(uint64_t ticks) const;
+
+  uint32_t mult_;
+  uint16_t shift_;
+  uint64_t anchor_tsc_;
+  uint64_t anchor_ns_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_TSC_CLOCK_H_
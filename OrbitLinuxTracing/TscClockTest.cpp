@@ -0,0 +1,42 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <optional>
+
+#include "TscClock.h"
+#include "Utils.h"
+
+namespace LinuxTracing {
+
+TEST(TscClock, ConvertsWithIntegerMath) {
+  // 2 ticks per nanosecond.
+  TscClock clock{1u << 31, 32, 1'000'000, 5'000'000};
+  EXPECT_EQ(clock.ToMonotonicNs(1'000'000), 5'000'000);
+  EXPECT_EQ(clock.ToMonotonicNs(1'000'200), 5'000'100);
+  EXPECT_EQ(clock.ToMonotonicNs(999'800), 4'999'900);
+  // Far from the anchor, where the product would overflow without the split.
+  EXPECT_EQ(clock.ToMonotonicNs(1'000'000 + 2 * 1'000'000'000'000'000),
+            5'000'000 + 1'000'000'000'000'000);
+}
+
+TEST(TscClock, MatchesMonotonicClock) {
+  std::optional<TscClock> clock = TscClock::Create(absl::Milliseconds(10));
+  if (!clock.has_value()) {
+    GTEST_SKIP() << "The TSC is not the clock source";
+  }
+  const uint64_t before_ns = MonotonicTimestampNs();
+  const uint64_t tsc = TscClock::ReadTsc();
+  const uint64_t after_ns = MonotonicTimestampNs();
+  clock->Resync();
+  const uint64_t converted_ns = clock->ToMonotonicNs(tsc);
+  // The tolerance covers the readings around clock_gettime.
+  constexpr uint64_t kToleranceNs = 10'000;
+  EXPECT_GE(converted_ns + kToleranceNs, before_ns);
+  EXPECT_LE(converted_ns, after_ns + kToleranceNs);
+}
+
+}  // namespace LinuxTracing
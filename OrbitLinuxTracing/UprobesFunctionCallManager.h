@@ -7,8 +7,11 @@
 
 #include <OrbitBase/Logging.h>
 
-#include <stack>
+#include <algorithm>
+#include <optional>
+#include <vector>
 
+#include "PerfEventOpen.h"
 #include "PerfEventRecords.h"
 #include "absl/container/flat_hash_map.h"
 #include "capture.pb.h"
@@ -28,16 +31,61 @@ class UprobesFunctionCallManager {
   UprobesFunctionCallManager(UprobesFunctionCallManager&&) = default;
   UprobesFunctionCallManager& operator=(UprobesFunctionCallManager&&) = default;
 
-  void ProcessUprobes(pid_t tid, uint64_t function_address,
-                      uint64_t begin_timestamp,
-                      const perf_event_sample_regs_user_sp_ip_arguments& regs) {
+  // Only the registers of the first recorded_argument_count arguments are
+  // added to the FunctionCall. Only one in sampling_ratio calls of the
+  // function, on any thread, produces a FunctionCall: the others are still
+  // kept on the stack, to be matched with their uretprobes.
+  void ProcessUprobes(
+      pid_t tid, uint64_t function_address, uint64_t begin_timestamp,
+      const perf_event_sample_regs_user_sp_ip_arguments& regs,
+      uint32_t recorded_argument_count = MAX_RECORDED_ARGUMENT_COUNT,
+      uint32_t sampling_ratio = 1) {
+    bool is_sampled = true;
+    if (sampling_ratio > 1) {
+      uint64_t& call_count = call_counts_[function_address];
+      is_sampled = call_count % sampling_ratio == 0;
+      ++call_count;
+    }
     auto& tid_uprobes_stack = tid_uprobes_stacks_[tid];
-    tid_uprobes_stack.emplace(function_address, begin_timestamp, regs);
+    tid_uprobes_stack.emplace_back(function_address, begin_timestamp, regs,
+                                   recorded_argument_count, is_sampled);
+  }
+
+  // Returns how many of the open uprobes of the thread are above the innermost
+  // one for whose function_address is_returned_from is true, or nullopt if
+  // there is none. The uprobes and uretprobes of a function can stop matching
+  // when its probes are disabled while it runs, see InstrumentationGovernor:
+  // the uprobes above are then left without uretprobes, while a uretprobe
+  // without an open uprobe has none.
+  template <typename Predicate>
+  [[nodiscard]] std::optional<size_t> CountOpenUprobesAbove(
+      pid_t tid, Predicate is_returned_from) const {
+    auto stack_it = tid_uprobes_stacks_.find(tid);
+    if (stack_it == tid_uprobes_stacks_.end()) {
+      return std::nullopt;
+    }
+    const std::vector<OpenUprobes>& tid_uprobes_stack = stack_it->second;
+    for (size_t count = 0; count < tid_uprobes_stack.size(); ++count) {
+      const OpenUprobes& tid_uprobe =
+          tid_uprobes_stack[tid_uprobes_stack.size() - 1 - count];
+      if (is_returned_from(tid_uprobe.function_address)) {
+        return count;
+      }
+    }
+    return std::nullopt;
   }
 
-  std::optional<FunctionCall> ProcessUretprobes(pid_t tid,
-                                                uint64_t end_timestamp,
-                                                uint64_t return_value) {
+  // The depth at which a call of the thread would be now.
+  [[nodiscard]] size_t GetOpenUprobesCount(pid_t tid) const {
+    auto stack_it = tid_uprobes_stacks_.find(tid);
+    return stack_it != tid_uprobes_stacks_.end() ? stack_it->second.size() : 0;
+  }
+
+  // return_value is empty when the return value of the function is not
+  // recorded.
+  std::optional<FunctionCall> ProcessUretprobes(
+      pid_t tid, uint64_t end_timestamp,
+      std::optional<uint64_t> return_value) {
     if (!tid_uprobes_stacks_.contains(tid)) {
       return std::optional<FunctionCall>{};
     }
@@ -46,7 +94,11 @@ class UprobesFunctionCallManager {
 
     // As we erase the stack for this thread as soon as it becomes empty.
     CHECK(!tid_uprobes_stack.empty());
-    auto& tid_uprobe = tid_uprobes_stack.top();
+    auto& tid_uprobe = tid_uprobes_stack.back();
+    if (!tid_uprobe.is_sampled) {
+      PopUprobes(tid);
+      return std::optional<FunctionCall>{};
+    }
 
     FunctionCall function_call;
     function_call.set_tid(tid);
@@ -54,36 +106,52 @@ class UprobesFunctionCallManager {
     function_call.set_begin_timestamp_ns(tid_uprobe.begin_timestamp);
     function_call.set_end_timestamp_ns(end_timestamp);
     function_call.set_depth(tid_uprobes_stack.size() - 1);
-    function_call.set_return_value(return_value);
-    function_call.add_registers(tid_uprobe.registers.di);
-    function_call.add_registers(tid_uprobe.registers.si);
-    function_call.add_registers(tid_uprobe.registers.dx);
-    function_call.add_registers(tid_uprobe.registers.cx);
-    function_call.add_registers(tid_uprobe.registers.r8);
-    function_call.add_registers(tid_uprobe.registers.r9);
-
-    tid_uprobes_stack.pop();
-    if (tid_uprobes_stack.empty()) {
-      tid_uprobes_stacks_.erase(tid);
+    if (return_value.has_value()) {
+      function_call.set_return_value(return_value.value());
+    }
+    const perf_event_sample_regs_user_sp_ip_arguments& registers =
+        tid_uprobe.registers;
+    const uint64_t arguments[MAX_RECORDED_ARGUMENT_COUNT] = {
+        registers.di, registers.si, registers.dx,
+        registers.cx, registers.r8, registers.r9};
+    for (uint32_t i = 0; i < tid_uprobe.recorded_argument_count; ++i) {
+      function_call.add_registers(arguments[i]);
     }
+
+    PopUprobes(tid);
     return function_call;
   }
 
  private:
+  void PopUprobes(pid_t tid) {
+    auto& tid_uprobes_stack = tid_uprobes_stacks_.at(tid);
+    tid_uprobes_stack.pop_back();
+    if (tid_uprobes_stack.empty()) {
+      tid_uprobes_stacks_.erase(tid);
+    }
+  }
+
   struct OpenUprobes {
     OpenUprobes(uint64_t function_address, uint64_t begin_timestamp,
-                const perf_event_sample_regs_user_sp_ip_arguments& regs)
+                const perf_event_sample_regs_user_sp_ip_arguments& regs,
+                uint32_t recorded_argument_count, bool is_sampled)
         : function_address{function_address},
           begin_timestamp{begin_timestamp},
-          registers(regs) {}
+          registers(regs),
+          recorded_argument_count{
+              std::min(recorded_argument_count, MAX_RECORDED_ARGUMENT_COUNT)},
+          is_sampled{is_sampled} {}
     uint64_t function_address;
     uint64_t begin_timestamp;
     perf_event_sample_regs_user_sp_ip_arguments registers;
+    uint32_t recorded_argument_count;
+    bool is_sampled;
   };
 
   // This map keeps the stack of the dynamically-instrumented functions entered.
-  absl::flat_hash_map<pid_t, std::stack<OpenUprobes, std::vector<OpenUprobes>>>
-      tid_uprobes_stacks_{};
+  absl::flat_hash_map<pid_t, std::vector<OpenUprobes>> tid_uprobes_stacks_{};
+  // The calls so far of the functions with a sampling ratio, by address.
+  absl::flat_hash_map<uint64_t, uint64_t> call_counts_{};
 };
 
 }  // namespace LinuxTracing
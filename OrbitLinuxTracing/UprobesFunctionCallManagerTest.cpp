@@ -103,6 +103,33 @@ TEST(UprobesFunctionCallManager, TwoUprobesDifferentThreads) {
   EXPECT_EQ(processed_function_call.value().registers_size(), 6);
 }
 
+TEST(UprobesFunctionCallManager, SelectedArgumentsAndNoReturnValue) {
+  constexpr pid_t tid = 42;
+  std::optional<FunctionCall> processed_function_call;
+  UprobesFunctionCallManager function_call_manager;
+  perf_event_sample_regs_user_sp_ip_arguments registers{};
+  registers.di = 11;
+  registers.si = 12;
+  registers.dx = 13;
+
+  function_call_manager.ProcessUprobes(tid, 100, 1, registers, 2);
+  function_call_manager.ProcessUprobes(tid, 200, 2, registers, 0);
+
+  processed_function_call =
+      function_call_manager.ProcessUretprobes(tid, 3, std::nullopt);
+  ASSERT_TRUE(processed_function_call.has_value());
+  EXPECT_EQ(processed_function_call.value().absolute_address(), 200);
+  EXPECT_EQ(processed_function_call.value().return_value(), 0);
+  EXPECT_EQ(processed_function_call.value().registers_size(), 0);
+
+  processed_function_call = function_call_manager.ProcessUretprobes(tid, 4, 5);
+  ASSERT_TRUE(processed_function_call.has_value());
+  EXPECT_EQ(processed_function_call.value().absolute_address(), 100);
+  EXPECT_EQ(processed_function_call.value().return_value(), 5);
+  EXPECT_THAT(processed_function_call.value().registers(),
+              testing::ElementsAre(11, 12));
+}
+
 TEST(UprobesFunctionCallManager, OnlyUretprobe) {
   constexpr pid_t tid = 42;
   std::optional<FunctionCall> processed_function_call;
@@ -112,4 +139,88 @@ TEST(UprobesFunctionCallManager, OnlyUretprobe) {
   ASSERT_FALSE(processed_function_call.has_value());
 }
 
+TEST(UprobesFunctionCallManager, CountOpenUprobesAbove) {
+  constexpr pid_t tid = 42;
+  UprobesFunctionCallManager function_call_manager;
+  perf_event_sample_regs_user_sp_ip_arguments registers;
+  auto is_returned_from = [](uint64_t returned_function_address) {
+    return [returned_function_address](uint64_t function_address) {
+      return function_address == returned_function_address;
+    };
+  };
+
+  EXPECT_FALSE(function_call_manager
+                   .CountOpenUprobesAbove(tid, is_returned_from(100))
+                   .has_value());
+
+  function_call_manager.ProcessUprobes(tid, 100, 1, registers);
+  function_call_manager.ProcessUprobes(tid, 200, 2, registers);
+  function_call_manager.ProcessUprobes(tid, 300, 3, registers);
+  EXPECT_EQ(function_call_manager.CountOpenUprobesAbove(tid,
+                                                        is_returned_from(300)),
+            0);
+  EXPECT_EQ(function_call_manager.CountOpenUprobesAbove(tid,
+                                                        is_returned_from(100)),
+            2);
+  EXPECT_FALSE(function_call_manager
+                   .CountOpenUprobesAbove(tid, is_returned_from(400))
+                   .has_value());
+}
+
+TEST(UprobesFunctionCallManager, SamplingRatio) {
+  constexpr pid_t tid = 42;
+  constexpr pid_t tid2 = 43;
+  constexpr uint32_t kSamplingRatio = 3;
+  UprobesFunctionCallManager function_call_manager;
+  perf_event_sample_regs_user_sp_ip_arguments registers;
+  auto process_call = [&](pid_t call_tid, uint64_t begin_timestamp) {
+    function_call_manager.ProcessUprobes(call_tid, 100, begin_timestamp,
+                                         registers, 0, kSamplingRatio);
+    return function_call_manager.ProcessUretprobes(
+        call_tid, begin_timestamp + 1, std::nullopt);
+  };
+
+  // The calls are counted across threads.
+  EXPECT_TRUE(process_call(tid, 1).has_value());
+  EXPECT_FALSE(process_call(tid2, 3).has_value());
+  EXPECT_FALSE(process_call(tid, 5).has_value());
+  std::optional<FunctionCall> processed_function_call = process_call(tid2, 7);
+  ASSERT_TRUE(processed_function_call.has_value());
+  EXPECT_EQ(processed_function_call->tid(), tid2);
+  EXPECT_EQ(processed_function_call->begin_timestamp_ns(), 7);
+
+  // A call not sampled still matches its uretprobe, hence the sampled call it
+  // is nested in gets the right end and depth.
+  function_call_manager.ProcessUprobes(tid, 200, 10, registers);
+  function_call_manager.ProcessUprobes(tid, 100, 11, registers, 0,
+                                       kSamplingRatio);
+  EXPECT_FALSE(
+      function_call_manager.ProcessUretprobes(tid, 12, std::nullopt)
+          .has_value());
+  processed_function_call =
+      function_call_manager.ProcessUretprobes(tid, 13, std::nullopt);
+  ASSERT_TRUE(processed_function_call.has_value());
+  EXPECT_EQ(processed_function_call->absolute_address(), 200);
+  EXPECT_EQ(processed_function_call->end_timestamp_ns(), 13);
+  EXPECT_EQ(processed_function_call->depth(), 0);
+}
+
+TEST(UprobesFunctionCallManager, CountsOpenUprobesPerThread) {
+  constexpr pid_t tid = 42;
+  constexpr pid_t tid2 = 43;
+  UprobesFunctionCallManager function_call_manager;
+  perf_event_sample_regs_user_sp_ip_arguments registers;
+  EXPECT_EQ(function_call_manager.GetOpenUprobesCount(tid), 0);
+
+  function_call_manager.ProcessUprobes(tid, 100, 1, registers);
+  function_call_manager.ProcessUprobes(tid, 200, 2, registers);
+  function_call_manager.ProcessUprobes(tid2, 100, 3, registers);
+  EXPECT_EQ(function_call_manager.GetOpenUprobesCount(tid), 2);
+  EXPECT_EQ(function_call_manager.GetOpenUprobesCount(tid2), 1);
+
+  EXPECT_TRUE(function_call_manager.ProcessUretprobes(tid, 4, std::nullopt)
+                  .has_value());
+  EXPECT_EQ(function_call_manager.GetOpenUprobesCount(tid), 1);
+}
+
 }  // namespace LinuxTracing
@@ -10,6 +10,7 @@
 #include <unwindstack/MapInfo.h>
 #include <unwindstack/Maps.h>
 
+#include <memory>
 #include <stack>
 #include <vector>
 
@@ -66,24 +67,43 @@ class UprobesReturnAddressManager {
     }
   }
 
+  // The kernel executes the instructions displaced by uprobes out of line, in
+  // a single special map named "[uprobes]". Its address range is cached by the
+  // callers of PatchCallchain, so that the frames of a callchain can be
+  // classified without looking up the maps.
+  struct UprobesMap {
+    uint64_t start = 0;
+    uint64_t end = 0;
+
+    [[nodiscard]] bool Contains(uint64_t address) const {
+      return address >= start && address < end;
+    }
+  };
+
+  // Returns an empty range if there is no "[uprobes]" map yet.
+  static UprobesMap FindUprobesMap(unwindstack::Maps* maps) {
+    for (const std::unique_ptr<unwindstack::MapInfo>& map_info : *maps) {
+      if (map_info->name == "[uprobes]") {
+        return UprobesMap{map_info->start, map_info->end};
+      }
+    }
+    return UprobesMap{};
+  }
+
   // In case of callchain sampling we don't have the complete stack to patch,
   // but only the callchain (as list of instruction pointers). In those,
   // a uprobe address occurs in place of the caller of an instrumented function.
-  // This function patches the callchain, using the maps information to identify
-  // instruction pointers of uprobe code and using the return address saved in
-  // the uprobes.
+  // This function patches the callchain, using the address range of the
+  // uprobes map to identify instruction pointers of uprobe code and using the
+  // return address saved in the uprobes.
+  // This is called for every callchain sample, hence it doesn't allocate.
   bool PatchCallchain(pid_t tid, uint64_t* callchain, uint64_t callchain_size,
-                      unwindstack::Maps* maps) {
-    std::vector<uint64_t> frames_to_patch;
+                      const UprobesMap& uprobes_map) {
+    size_t frames_to_patch_count = 0;
     for (uint64_t i = 0; i < callchain_size; i++) {
-      uint64_t ip = callchain[i];
-      unwindstack::MapInfo* map_info = maps->Find(ip);
-
-      if (map_info == nullptr || map_info->name != "[uprobes]") {
-        continue;
+      if (uprobes_map.Contains(callchain[i])) {
+        frames_to_patch_count++;
       }
-
-      frames_to_patch.push_back(i);
     }
 
     if (!tid_uprobes_stacks_.contains(tid)) {
@@ -92,8 +112,9 @@ class UprobesReturnAddressManager {
       // There are two situations where this may happen:
       //  1. At the beginning of a capture, where we missed the first uprobes
       //  2. When some events are lost or processed out of order.
-      if (!frames_to_patch.empty()) {
-        ERROR("Discarding sample in a uprobe as uprobe records are missing.");
+      if (frames_to_patch_count > 0) {
+        ERROR_RATE_LIMITED(
+            "Discarding sample in a uprobe as uprobe records are missing.");
         return false;
       }
       return true;
@@ -118,21 +139,23 @@ class UprobesReturnAddressManager {
     //  2. When some events are lost or processed out of order.
     // This is the same situation as above, but we have at least some uprobe
     // records.
-    if (num_unique_uprobes < frames_to_patch.size()) {
-      ERROR(
+    if (num_unique_uprobes < frames_to_patch_count) {
+      ERROR_RATE_LIMITED(
           "Discarding sample in a uprobe as some uprobe records are missing.");
       return false;
     }
     // In cases of lost events, or out of order processing, there might be wrong
     // uprobes. So we need to discard the event. In general we should be fast
     // enough, such that this does not happen.
-    if (num_unique_uprobes > frames_to_patch.size() + 1) {
-      ERROR("Discarding sample in a uprobe as uprobe records are incorrect.");
+    if (num_unique_uprobes > frames_to_patch_count + 1) {
+      ERROR_RATE_LIMITED(
+          "Discarding sample in a uprobe as uprobe records are incorrect.");
       return false;
     }
 
     // Process frames from the outermost to the innermost.
-    auto frames_to_patch_it = frames_to_patch.rbegin();
+    uint64_t frame_index = callchain_size;
+    size_t patched_frame_count = 0;
     size_t uprobes_size = tid_uprobes_stack.size();
 
     // There are two situations where this may true:
@@ -142,7 +165,7 @@ class UprobesReturnAddressManager {
     //   address was not yet overridden.
     // In any case, the uprobe(s) have not overridden the return address.
     // We do not need to patch the effect of this uprobe and can move forward.
-    bool skip_last_uprobes = num_unique_uprobes == frames_to_patch.size() + 1;
+    bool skip_last_uprobes = num_unique_uprobes == frames_to_patch_count + 1;
 
     // On tail-call optimization, when instrumenting the caller and the callee,
     // the correct call-stack will only contain the callee.
@@ -166,11 +189,15 @@ class UprobesReturnAddressManager {
       prev_uprobe_stack_pointer = uprobe.stack_pointer;
       unique_uprobes_so_far++;
 
-      uint64_t frame_to_patch = *frames_to_patch_it;
-      callchain[frame_to_patch] = uprobe.return_address;
-      frames_to_patch_it++;
+      // The uprobes processed so far match the frames to patch, so there is
+      // always a further frame in the uprobes map.
+      do {
+        frame_index--;
+      } while (!uprobes_map.Contains(callchain[frame_index]));
+      callchain[frame_index] = uprobe.return_address;
+      patched_frame_count++;
     }
-    CHECK(frames_to_patch_it == frames_to_patch.rend());
+    CHECK(patched_frame_count == frames_to_patch_count);
     return true;
   }
 
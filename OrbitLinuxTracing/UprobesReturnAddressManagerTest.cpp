@@ -485,6 +485,24 @@ const std::string maps_string =
 
 std::unique_ptr<unwindstack::BufferMaps> maps =
     LibunwindstackUnwinder::ParseMaps(maps_string);
+UprobesReturnAddressManager::UprobesMap uprobes_map =
+    UprobesReturnAddressManager::FindUprobesMap(maps.get());
+
+TEST(UprobesReturnAddressManager, FindUprobesMap) {
+  EXPECT_EQ(uprobes_map.start, 0x7fffffffe000lu);
+  EXPECT_EQ(uprobes_map.end, 0x7ffffffff000lu);
+  EXPECT_TRUE(uprobes_map.Contains(0x7fffffffe000lu));
+  EXPECT_FALSE(uprobes_map.Contains(0x7ffffffff000lu));
+  EXPECT_FALSE(uprobes_map.Contains(0x7ffcae7f3000lu));
+
+  std::unique_ptr<unwindstack::BufferMaps> maps_without_uprobes =
+      LibunwindstackUnwinder::ParseMaps(
+          "7ffcae7f3000-7ffcae7f4000 r-xp 00000000 00:00 0 [vdso]");
+  UprobesReturnAddressManager::UprobesMap no_uprobes_map =
+      UprobesReturnAddressManager::FindUprobesMap(maps_without_uprobes.get());
+  EXPECT_FALSE(no_uprobes_map.Contains(0));
+  EXPECT_FALSE(no_uprobes_map.Contains(0x7fffffffe000lu));
+}
 
 TEST(UprobesReturnAddressManager, CallchainNoUprobes) {
   UprobesReturnAddressManager return_address_manager;
@@ -504,7 +522,7 @@ TEST(UprobesReturnAddressManager, CallchainNoUprobes) {
       0x5541D68949564100lu};
 
   EXPECT_TRUE(return_address_manager.PatchCallchain(
-      1, callchain_sample.data(), callchain_sample.size(), maps.get()));
+      1, callchain_sample.data(), callchain_sample.size(), uprobes_map));
   EXPECT_THAT(callchain_sample, testing::ElementsAreArray(expected_callchain));
 }
 
@@ -528,7 +546,7 @@ TEST(UprobesReturnAddressManager, CallchainOneUprobe) {
       0x5541D68949564100lu};
 
   EXPECT_TRUE(return_address_manager.PatchCallchain(
-      1, callchain_sample.data(), callchain_sample.size(), maps.get()));
+      1, callchain_sample.data(), callchain_sample.size(), uprobes_map));
   EXPECT_THAT(callchain_sample, testing::ElementsAreArray(expected_callchain));
 }
 
@@ -552,7 +570,7 @@ TEST(UprobesReturnAddressManager, CallchainTwoUprobes) {
       0x5541D68949564100lu};
 
   EXPECT_TRUE(return_address_manager.PatchCallchain(
-      1, callchain_sample.data(), callchain_sample.size(), maps.get()));
+      1, callchain_sample.data(), callchain_sample.size(), uprobes_map));
   EXPECT_THAT(callchain_sample, testing::ElementsAreArray(expected_callchain));
 }
 
@@ -569,7 +587,7 @@ TEST(UprobesReturnAddressManager, CallchainTwoUprobesMissingOne) {
       0x5541D68949564100lu};
 
   EXPECT_FALSE(return_address_manager.PatchCallchain(
-      1, callchain_sample.data(), callchain_sample.size(), maps.get()));
+      1, callchain_sample.data(), callchain_sample.size(), uprobes_map));
 }
 
 TEST(UprobesReturnAddressManager, CallchainTwoConsecutiveUprobes) {
@@ -594,7 +612,7 @@ TEST(UprobesReturnAddressManager, CallchainTwoConsecutiveUprobes) {
       0x5541D68949564100lu};
 
   EXPECT_TRUE(return_address_manager.PatchCallchain(
-      1, callchain_sample.data(), callchain_sample.size(), maps.get()));
+      1, callchain_sample.data(), callchain_sample.size(), uprobes_map));
   EXPECT_THAT(callchain_sample, testing::ElementsAreArray(expected_callchain));
 }
 
@@ -618,7 +636,7 @@ TEST(UprobesReturnAddressManager, CallchainBeforeInjectionByUprobe) {
       0x5541D68949564100lu};
 
   EXPECT_TRUE(return_address_manager.PatchCallchain(
-      1, callchain_sample.data(), callchain_sample.size(), maps.get()));
+      1, callchain_sample.data(), callchain_sample.size(), uprobes_map));
   EXPECT_THAT(callchain_sample, testing::ElementsAreArray(expected_callchain));
 }
 
@@ -633,7 +651,7 @@ TEST(UprobesReturnAddressManager, CallchainWithoutUprobeRecord) {
       0x5541D68949564100lu};
 
   EXPECT_FALSE(return_address_manager.PatchCallchain(
-      1, callchain_sample.data(), callchain_sample.size(), maps.get()));
+      1, callchain_sample.data(), callchain_sample.size(), uprobes_map));
 }
 
 TEST(UprobesReturnAddressManager, CallchainOfTailcall) {
@@ -657,7 +675,7 @@ TEST(UprobesReturnAddressManager, CallchainOfTailcall) {
       0x00007FFFFFFFE000lu, 0x00007FE90B8B9E0Blu, 0x5541D68949564100lu};
 
   EXPECT_TRUE(return_address_manager.PatchCallchain(
-      1, callchain_sample.data(), callchain_sample.size(), maps.get()));
+      1, callchain_sample.data(), callchain_sample.size(), uprobes_map));
   EXPECT_THAT(callchain_sample, testing::ElementsAreArray(expected_callchain));
 }
 }  // namespace
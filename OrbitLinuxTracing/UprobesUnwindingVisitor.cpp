@@ -4,14 +4,262 @@
 
 #include "UprobesUnwindingVisitor.h"
 
+#include <sys/mman.h>
+
+#include <algorithm>
+
+#include "HybridCallstack.h"
+#include "LbrCallstack.h"
+#include "OrbitBase/LogLinearHistogram.h"
 #include "OrbitBase/Logging.h"
+#include "OrbitBase/Tracing.h"
+#include "Utils.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/time.h"
 
 namespace LinuxTracing {
 
+UprobesUnwindingVisitor::UprobesUnwindingVisitor(
+    const absl::flat_hash_map<pid_t, std::string>& initial_maps_per_pid,
+    size_t unwinding_thread_count, std::shared_ptr<ElfCache> elf_cache)
+    : elf_cache_{std::move(elf_cache)} {
+  for (const auto& [pid, initial_maps] : initial_maps_per_pid) {
+    std::shared_ptr<unwindstack::Maps> maps =
+        LibunwindstackUnwinder::ParseMaps(initial_maps);
+    if (maps == nullptr) {
+      ERROR("Parsing the maps of process %d", pid);
+      continue;
+    }
+    for (const std::unique_ptr<unwindstack::MapInfo>& map_info : *maps) {
+      LookUpElfInCache(map_info.get());
+    }
+    UprobesReturnAddressManager::UprobesMap uprobes_map =
+        UprobesReturnAddressManager::FindUprobesMap(maps.get());
+    maps_per_pid_.emplace(pid, ProcessMaps{std::move(maps), uprobes_map});
+  }
+
+  if (unwinding_thread_count > 0) {
+    unwound_samples_ = std::make_unique<ReorderBuffer<UnwoundStackSample>>(
+        [this](UnwoundStackSample&& unwound_sample) {
+          SendUnwoundStackSample(std::move(unwound_sample));
+        });
+    unwinding_thread_pool_ = ThreadPool::Create(
+        unwinding_thread_count, unwinding_thread_count, absl::Seconds(1));
+  }
+}
+
+UprobesUnwindingVisitor::~UprobesUnwindingVisitor() {
+  if (unwinding_thread_pool_ != nullptr) {
+    unwinding_thread_pool_->ShutdownAndWait();
+  }
+
+  if (elf_cache_ != nullptr) {
+    for (const auto& [unused_pid, process_maps] : maps_per_pid_) {
+      for (const std::unique_ptr<unwindstack::MapInfo>& map_info :
+           *process_maps.maps) {
+        elf_cache_->Insert(map_info.get());
+      }
+    }
+  }
+
+  if (async_span_manager_.GetForgottenSpanCount() > 0 ||
+      async_span_manager_.GetOpenSpanCount() > 0) {
+    LOG("%lu async spans were started but never stopped, %lu still open",
+        async_span_manager_.GetForgottenSpanCount(),
+        async_span_manager_.GetOpenSpanCount());
+  }
+
+  if (listener_ != nullptr) {
+    for (uint64_t absolute_address : changed_function_call_stats_) {
+      listener_->OnFunctionCallStats(
+          std::move(function_call_stats_.at(absolute_address)));
+    }
+    for (LockContentionStats& lock_contention_stats :
+         lock_contention_manager_.TakeChangedStats()) {
+      listener_->OnLockContentionStats(std::move(lock_contention_stats));
+    }
+    for (pid_t tid : changed_page_fault_stats_) {
+      listener_->OnPageFaultStats(std::move(page_fault_stats_.at(tid)));
+    }
+  }
+}
+
+void UprobesUnwindingVisitor::LookUpElfInCache(
+    unwindstack::MapInfo* map_info) {
+  // Only executable maps are unwound through.
+  if (elf_cache_ == nullptr || (map_info->flags & PROT_EXEC) == 0 ||
+      map_info->elf != nullptr) {
+    return;
+  }
+  elf_cache_->Lookup(map_info);
+}
+
+void UprobesUnwindingVisitor::AggregateFunctionCall(
+    const FunctionCall& function_call) {
+  uint64_t duration_ns =
+      function_call.end_timestamp_ns() - function_call.begin_timestamp_ns();
+  auto [stats_it, inserted] =
+      function_call_stats_.try_emplace(function_call.absolute_address());
+  FunctionCallStats& function_call_stats = stats_it->second;
+  if (inserted) {
+    function_call_stats.set_absolute_address(function_call.absolute_address());
+    function_call_stats.set_min_duration_ns(duration_ns);
+    function_call_stats.set_max_duration_ns(duration_ns);
+  } else {
+    function_call_stats.set_min_duration_ns(
+        std::min(function_call_stats.min_duration_ns(), duration_ns));
+    function_call_stats.set_max_duration_ns(
+        std::max(function_call_stats.max_duration_ns(), duration_ns));
+  }
+  function_call_stats.set_count(function_call_stats.count() + 1);
+  function_call_stats.set_total_duration_ns(
+      function_call_stats.total_duration_ns() + duration_ns);
+
+  google::protobuf::RepeatedField<uint64_t>* histogram =
+      function_call_stats.mutable_duration_histogram();
+  const int bucket_index = static_cast<int>(
+      OrbitBase::LogLinearHistogram::GetBucketIndex(duration_ns));
+  if (histogram->size() <= bucket_index) {
+    histogram->Resize(bucket_index + 1, 0);
+  }
+  ++(*histogram->Mutable(bucket_index));
+
+  changed_function_call_stats_.insert(function_call.absolute_address());
+  SendChangedFunctionCallStats(function_call.end_timestamp_ns());
+}
+
+void UprobesUnwindingVisitor::SendChangedFunctionCallStats(
+    uint64_t timestamp_ns) {
+  if (last_function_call_stats_timestamp_ns_ == 0) {
+    last_function_call_stats_timestamp_ns_ = timestamp_ns;
+    return;
+  }
+  if (timestamp_ns <
+      last_function_call_stats_timestamp_ns_ + FUNCTION_CALL_STATS_PERIOD_NS) {
+    return;
+  }
+  last_function_call_stats_timestamp_ns_ = timestamp_ns;
+
+  // Only the functions called since the last time, and always the whole
+  // histogram, so that the client simply keeps the last stats it receives.
+  for (uint64_t absolute_address : changed_function_call_stats_) {
+    listener_->OnFunctionCallStats(function_call_stats_.at(absolute_address));
+  }
+  changed_function_call_stats_.clear();
+}
+
+void UprobesUnwindingVisitor::SendChangedLockContentionStats(
+    uint64_t timestamp_ns) {
+  // The same period as for the function call stats.
+  if (last_lock_contention_stats_timestamp_ns_ == 0) {
+    last_lock_contention_stats_timestamp_ns_ = timestamp_ns;
+    return;
+  }
+  if (timestamp_ns < last_lock_contention_stats_timestamp_ns_ +
+                         FUNCTION_CALL_STATS_PERIOD_NS) {
+    return;
+  }
+  last_lock_contention_stats_timestamp_ns_ = timestamp_ns;
+  for (LockContentionStats& lock_contention_stats :
+       lock_contention_manager_.TakeChangedStats()) {
+    listener_->OnLockContentionStats(std::move(lock_contention_stats));
+  }
+}
+
+PageFaultStats& UprobesUnwindingVisitor::GetPageFaultStats(pid_t pid,
+                                                           pid_t tid) {
+  auto [stats_it, inserted] = page_fault_stats_.try_emplace(tid);
+  if (inserted) {
+    stats_it->second.set_pid(pid);
+    stats_it->second.set_tid(tid);
+  }
+  changed_page_fault_stats_.insert(tid);
+  return stats_it->second;
+}
+
+void UprobesUnwindingVisitor::SendChangedPageFaultStats(uint64_t timestamp_ns) {
+  // The same period as for the function call stats.
+  if (last_page_fault_stats_timestamp_ns_ == 0) {
+    last_page_fault_stats_timestamp_ns_ = timestamp_ns;
+    return;
+  }
+  if (timestamp_ns <
+      last_page_fault_stats_timestamp_ns_ + FUNCTION_CALL_STATS_PERIOD_NS) {
+    return;
+  }
+  last_page_fault_stats_timestamp_ns_ = timestamp_ns;
+  for (pid_t tid : changed_page_fault_stats_) {
+    listener_->OnPageFaultStats(page_fault_stats_.at(tid));
+  }
+  changed_page_fault_stats_.clear();
+}
+
+UprobesUnwindingVisitor::ProcessMaps* UprobesUnwindingVisitor::GetProcessMaps(
+    pid_t pid) {
+  auto process_maps_it = maps_per_pid_.find(pid);
+  if (process_maps_it == maps_per_pid_.end()) {
+    return nullptr;
+  }
+  return &process_maps_it->second;
+}
+
+bool UprobesUnwindingVisitor::AddOnDemandProcessIfNeeded(pid_t pid) {
+  if (max_on_demand_process_count_ == 0) {
+    return false;
+  }
+  if (on_demand_pids_.contains(pid)) {
+    return true;
+  }
+
+  if (on_demand_pids_in_order_.size() >= max_on_demand_process_count_) {
+    on_demand_pids_.erase(on_demand_pids_in_order_.front());
+    on_demand_pids_in_order_.pop_front();
+  }
+  on_demand_pids_.insert(pid);
+  on_demand_pids_in_order_.push_back(pid);
+
+  // Kernel threads and processes that have already exited have no maps, their
+  // samples are still reported.
+  std::shared_ptr<unwindstack::Maps> maps =
+      LibunwindstackUnwinder::ParseMaps(ReadMaps(pid));
+  if (maps == nullptr) {
+    return true;
+  }
+  size_t module_map_count = 0;
+  for (const std::unique_ptr<unwindstack::MapInfo>& map_info : *maps) {
+    if ((map_info->flags & PROT_EXEC) == 0 ||
+        map_info->name.empty() || map_info->name[0] == '[') {
+      continue;
+    }
+    if (module_map_count == MAX_MODULE_MAPS_PER_ON_DEMAND_PROCESS) {
+      ERROR("Process %d has more than %lu executable maps", pid,
+            MAX_MODULE_MAPS_PER_ON_DEMAND_PROCESS);
+      break;
+    }
+    SendModuleMap(pid, map_info->start, map_info->end, map_info->offset,
+                  map_info->name);
+    ++module_map_count;
+  }
+  return true;
+}
+
+void UprobesUnwindingVisitor::SendModuleMap(pid_t pid, uint64_t start,
+                                            uint64_t end, uint64_t offset,
+                                            const std::string& file_path) {
+  ModuleMap module_map;
+  module_map.set_pid(pid);
+  module_map.set_start_address(start);
+  module_map.set_end_address(end);
+  module_map.set_file_offset(offset);
+  module_map.set_file_path(file_path);
+  listener_->OnModuleMap(std::move(module_map));
+}
+
 void UprobesUnwindingVisitor::visit(StackSamplePerfEvent* event) {
   CHECK(listener_ != nullptr);
 
-  if (current_maps_ == nullptr) {
+  ProcessMaps* process_maps = GetProcessMaps(event->GetPid());
+  if (process_maps == nullptr) {
     return;
   }
 
@@ -19,15 +267,77 @@ void UprobesUnwindingVisitor::visit(StackSamplePerfEvent* event) {
       event->GetTid(), event->GetRegisters()[PERF_REG_X86_SP],
       event->GetStackData(), event->GetStackSize());
 
+  if (unwinding_thread_pool_ == nullptr) {
+    std::optional<UnwoundStackSample> unwound_sample = UnwindStackSample(
+        process_maps->maps, event->GetPid(), event->GetTid(),
+        event->GetTimestamp(),
+        event->GetRegisters(), event->GetStackData(), event->GetStackSize());
+    if (unwound_sample.has_value()) {
+      SendUnwoundStackSample(std::move(unwound_sample.value()));
+    }
+    return;
+  }
+
+  unwound_samples_->WaitForInFlightCountAtMost(MAX_IN_FLIGHT_STACK_SAMPLES -
+                                               1);
+  uint64_t sequence_number = unwound_samples_->ReserveSequenceNumber();
+  pid_t pid = event->GetPid();
+  pid_t tid = event->GetTid();
+  uint64_t timestamp_ns = event->GetTimestamp();
+  std::array<uint64_t, PERF_REG_X86_64_MAX> registers = event->GetRegisters();
+  // The event is destroyed right after being visited, so take ownership of its
+  // record instead of copying the (already patched) stack.
+  std::unique_ptr<dynamically_sized_perf_event_stack_sample> record =
+      std::move(event->ring_buffer_record);
+  unwinding_thread_pool_->Schedule(
+      [this, maps = process_maps->maps, sequence_number, pid, tid,
+       timestamp_ns, registers, record = std::move(record)] {
+        unwound_samples_->Complete(
+            sequence_number,
+            UnwindStackSample(maps, pid, tid, timestamp_ns, registers,
+                              record->stack.data.get(),
+                              record->stack.dyn_size));
+      });
+}
+
+std::optional<UprobesUnwindingVisitor::UnwoundStackSample>
+UprobesUnwindingVisitor::UnwindStackSample(
+    const std::shared_ptr<unwindstack::Maps>& maps, pid_t pid, pid_t tid,
+    uint64_t timestamp_ns,
+    const std::array<uint64_t, PERF_REG_X86_64_MAX>& registers,
+    const char* stack_data, uint64_t stack_size) {
+  ORBIT_SCOPE("Unwind");
+  uint64_t unwind_begin_ns =
+      unwind_duration_histogram_ != nullptr ? MonotonicTimestampNs() : 0;
+  bool memo_hit = false;
   const std::vector<unwindstack::FrameData>& libunwindstack_callstack =
-      unwinder_.Unwind(current_maps_.get(), event->GetRegisters(),
-                       event->GetStackData(), event->GetStackSize());
+      unwinder_.UnwindWithMemo(tid, maps, registers, stack_data, stack_size,
+                               &memo_hit);
+  if (memo_hit && unwind_memo_hit_counter_ != nullptr) {
+    ++(*unwind_memo_hit_counter_);
+  }
+  if (unwind_duration_histogram_ != nullptr) {
+    size_t bucket_index = OrbitBase::LogLinearHistogram::GetBucketIndex(
+        MonotonicTimestampNs() - unwind_begin_ns);
+    (*unwind_duration_histogram_)[bucket_index].fetch_add(
+        1, std::memory_order_relaxed);
+  }
 
   if (libunwindstack_callstack.empty()) {
     if (unwind_error_counter_ != nullptr) {
       ++(*unwind_error_counter_);
     }
-    return;
+    if (used_stack_size_tracker_ != nullptr) {
+      used_stack_size_tracker_->OnUnwindingFailed(tid);
+    }
+    return std::nullopt;
+  }
+
+  uint64_t sp = registers[PERF_REG_X86_SP];
+  uint64_t outermost_frame_sp = libunwindstack_callstack.back().sp;
+  if (used_stack_size_tracker_ != nullptr && outermost_frame_sp >= sp) {
+    used_stack_size_tracker_->OnUnwindingSucceeded(tid,
+                                                   outermost_frame_sp - sp);
   }
 
   // Some samples can actually fall inside u(ret)probes code. Discard them,
@@ -36,85 +346,497 @@ void UprobesUnwindingVisitor::visit(StackSamplePerfEvent* event) {
     if (discarded_samples_in_uretprobes_counter_ != nullptr) {
       ++(*discarded_samples_in_uretprobes_counter_);
     }
-    return;
+    return std::nullopt;
   }
 
-  CallstackSample sample;
-  sample.set_tid(event->GetTid());
-  sample.set_timestamp_ns(event->GetTimestamp());
+  UnwoundStackSample unwound_sample;
+  CallstackSample& sample = unwound_sample.callstack_sample;
+  sample.set_pid(pid);
+  sample.set_tid(tid);
+  sample.set_timestamp_ns(timestamp_ns);
 
   Callstack* callstack = sample.mutable_callstack();
+  unwound_sample.address_infos.reserve(libunwindstack_callstack.size());
   for (const unwindstack::FrameData& libunwindstack_frame :
        libunwindstack_callstack) {
-    AddressInfo address_info;
+    AddressInfo& address_info = unwound_sample.address_infos.emplace_back();
     address_info.set_absolute_address(libunwindstack_frame.pc);
     address_info.set_function_name(libunwindstack_frame.function_name);
     address_info.set_offset_in_function(libunwindstack_frame.function_offset);
     address_info.set_map_name(libunwindstack_frame.map_name);
-    listener_->OnAddressInfo(std::move(address_info));
 
     callstack->add_pcs(libunwindstack_frame.pc);
   }
 
-  listener_->OnCallstackSample(std::move(sample));
+  return unwound_sample;
 }
 
-void UprobesUnwindingVisitor::visit(CallchainSamplePerfEvent* event) {
-  CHECK(listener_ != nullptr);
-
-  if (current_maps_ == nullptr) {
-    return;
+void UprobesUnwindingVisitor::SendUnwoundStackSample(
+    UnwoundStackSample&& unwound_sample) {
+  for (AddressInfo& address_info : unwound_sample.address_infos) {
+    listener_->OnAddressInfo(std::move(address_info));
   }
+  listener_->OnCallstackSample(std::move(unwound_sample.callstack_sample));
+}
 
-  if (!return_address_manager_.PatchCallchain(
-          event->GetTid(), event->GetCallchain(), event->GetCallchainSize(),
-          current_maps_.get())) {
-    return;
+bool UprobesUnwindingVisitor::PatchAndCheckCallchain(
+    const ProcessMaps& process_maps, pid_t tid, uint64_t* callchain,
+    uint64_t callchain_size) {
+  if (!return_address_manager_.PatchCallchain(tid, callchain, callchain_size,
+                                              process_maps.uprobes_map)) {
+    return false;
   }
 
   // The top of a callchain is always inside the kernel code.
-  if (event->GetCallchainSize() <= 1) {
-    return;
+  if (callchain_size <= 1) {
+    return false;
   }
 
-  uint64_t top_ip = event->GetCallchain()[1];
-  unwindstack::MapInfo* top_ip_map_info = current_maps_->Find(top_ip);
+  uint64_t top_ip = callchain[1];
 
   // Some samples can actually fall inside u(ret)probes code. Discard them,
   // as we don't want to show the unnamed uprobes module in the samples.
-  if (top_ip_map_info == nullptr || top_ip_map_info->name == "[uprobes]") {
+  if (process_maps.uprobes_map.Contains(top_ip) ||
+      process_maps.maps->Find(top_ip) == nullptr) {
     if (discarded_samples_in_uretprobes_counter_ != nullptr) {
       ++(*discarded_samples_in_uretprobes_counter_);
     }
-    return;
+    return false;
+  }
+  return true;
+}
+
+void UprobesUnwindingVisitor::visit(CallchainSamplePerfEvent* event) {
+  CHECK(listener_ != nullptr);
+
+  std::vector<uint64_t> kernel_pcs;
+  uint64_t user_index = SplitKernelCallchain(
+      event->GetCallchain(), event->GetCallchainSize(), &kernel_pcs);
+  uint64_t* callchain = event->GetCallchain() + user_index;
+  uint64_t callchain_size = event->GetCallchainSize() - user_index;
+
+  ProcessMaps* process_maps = GetProcessMaps(event->GetPid());
+  if (process_maps != nullptr) {
+    if (!PatchAndCheckCallchain(*process_maps, event->GetTid(), callchain,
+                                callchain_size)) {
+      return;
+    }
+  } else {
+    // Processes that are not captured have no uprobes to patch.
+    if (!AddOnDemandProcessIfNeeded(event->GetPid()) || callchain_size <= 1) {
+      return;
+    }
   }
 
   CallstackSample sample;
+  sample.set_pid(event->GetPid());
   sample.set_tid(event->GetTid());
   sample.set_timestamp_ns(event->GetTimestamp());
+  for (uint64_t pc : kernel_pcs) {
+    sample.mutable_callstack()->add_pcs(pc);
+  }
+  CallchainToCallstack(callchain, callchain_size, sample.mutable_callstack());
+  SendKernelAddressInfos(kernel_pcs);
+  listener_->OnCallstackSample(std::move(sample));
+}
 
-  Callstack* callstack = sample.mutable_callstack();
-  uint64_t* raw_callchain = event->GetCallchain();
+uint64_t UprobesUnwindingVisitor::SplitKernelCallchain(
+    const uint64_t* callchain, uint64_t callchain_size,
+    std::vector<uint64_t>* kernel_pcs) {
+  if (callchain_size == 0 || callchain[0] != PERF_CONTEXT_KERNEL) {
+    return 0;
+  }
+  // As for the user space frames, the first pc is the sampled instruction and
+  // the following ones are return addresses.
+  uint64_t index = 1;
+  for (; index < callchain_size && callchain[index] != PERF_CONTEXT_USER;
+       ++index) {
+    kernel_pcs->push_back(index == 1 ? callchain[index]
+                                     : callchain[index] - 1);
+  }
+  return index;
+}
+
+void UprobesUnwindingVisitor::SendKernelAddressInfos(
+    const std::vector<uint64_t>& kernel_pcs) {
+  if (kernel_symbols_ == nullptr) {
+    return;
+  }
+  // The listener only sends the first AddressInfo of each address.
+  for (uint64_t pc : kernel_pcs) {
+    const KernelSymbols::Symbol* symbol = kernel_symbols_->Find(pc);
+    if (symbol == nullptr) {
+      continue;
+    }
+    AddressInfo address_info;
+    address_info.set_absolute_address(pc);
+    address_info.set_function_name(symbol->name);
+    address_info.set_offset_in_function(pc - symbol->address);
+    address_info.set_map_name(symbol->map_name);
+    listener_->OnAddressInfo(std::move(address_info));
+  }
+}
+
+void UprobesUnwindingVisitor::CallchainToCallstack(const uint64_t* callchain,
+                                                   uint64_t callchain_size,
+                                                   Callstack* callstack) {
+  callstack->mutable_pcs()->Reserve(callchain_size - 1);
   // Skip the first frame as the top of a perf_event_open callchain is always
   // inside kernel code.
-  callstack->add_pcs(raw_callchain[1]);
+  callstack->add_pcs(callchain[1]);
   // Only the address of the top of the stack is correct. Frame-based unwinding
   // uses the return address of a function call as the caller's address.
   // However, the actual address of the call instruction is before that.
   // As we don't know the size of the call instruction, we subtract 1 from the
   // return address. This way we fall into the range of the call instruction.
   // Note: This is also done the same way in Libunwindstack.
-  for (uint64_t frame_index = 2; frame_index < event->GetCallchainSize();
-       ++frame_index) {
-    callstack->add_pcs(raw_callchain[frame_index] - 1);
+  for (uint64_t frame_index = 2; frame_index < callchain_size; ++frame_index) {
+    callstack->add_pcs(callchain[frame_index] - 1);
+  }
+}
+
+void UprobesUnwindingVisitor::visit(OffCpuCallchainPerfEvent* event) {
+  CHECK(listener_ != nullptr);
+
+  ProcessMaps* process_maps = GetProcessMaps(event->GetPid());
+  if (process_maps == nullptr || event->GetCallchainSize() <= 1) {
+    return;
   }
+  // The thread is in the kernel, so the uprobes in its callchain are patched
+  // like in a sample taken in a system call.
+  if (!PatchAndCheckCallchain(*process_maps, event->GetTid(),
+                              event->GetCallchain(),
+                              event->GetCallchainSize())) {
+    return;
+  }
+
+  // A previous sample of the thread that is still open missed its switch-in,
+  // and is replaced.
+  OffCpuCallstackSample& sample = off_cpu_samples_[event->GetTid()];
+  sample.Clear();
+  sample.set_pid(event->GetPid());
+  sample.set_tid(event->GetTid());
+  sample.set_timestamp_ns(event->GetTimestamp());
+  CallchainToCallstack(event->GetCallchain(), event->GetCallchainSize(),
+                       sample.mutable_callstack());
+}
+
+void UprobesUnwindingVisitor::visit(FutexWaitPerfEvent* event) {
+  CHECK(listener_ != nullptr);
 
+  ProcessMaps* process_maps = GetProcessMaps(event->GetPid());
+  if (process_maps == nullptr || event->GetCallchainSize() <= 1) {
+    return;
+  }
+  if (!PatchAndCheckCallchain(*process_maps, event->GetTid(),
+                              event->GetCallchain(),
+                              event->GetCallchainSize())) {
+    return;
+  }
+
+  Callstack callstack;
+  CallchainToCallstack(event->GetCallchain(), event->GetCallchainSize(),
+                       &callstack);
+  lock_contention_manager_.ProcessWaitBegin(
+      event->GetPid(), event->GetTid(), event->lock_address,
+      event->GetTimestamp(),
+      function_call_manager_.GetOpenUprobesCount(event->GetTid()),
+      std::move(callstack));
+}
+
+void UprobesUnwindingVisitor::visit(FutexExitPerfEvent* event) {
+  CHECK(listener_ != nullptr);
+  std::optional<LockWait> lock_wait = lock_contention_manager_.ProcessFutexExit(
+      event->GetTid(), event->GetTimestamp(), event->ret);
+  if (!lock_wait.has_value()) {
+    return;
+  }
+  if (lock_wait->end_timestamp_ns() - lock_wait->begin_timestamp_ns() >=
+      min_lock_wait_duration_ns_) {
+    listener_->OnLockWait(std::move(lock_wait.value()));
+  }
+  SendChangedLockContentionStats(event->GetTimestamp());
+}
+
+void UprobesUnwindingVisitor::visit(AllocationPerfEvent* event) {
+  CHECK(listener_ != nullptr);
+
+  ProcessMaps* process_maps = GetProcessMaps(event->GetPid());
+  if (process_maps == nullptr || event->GetCallchainSize() <= 1) {
+    return;
+  }
+  if (!PatchAndCheckCallchain(*process_maps, event->GetTid(),
+                              event->GetCallchain(),
+                              event->GetCallchainSize())) {
+    return;
+  }
+
+  AllocationSample sample;
+  sample.set_pid(event->GetPid());
+  sample.set_tid(event->GetTid());
+  sample.set_timestamp_ns(event->GetTimestamp());
+  CallchainToCallstack(event->GetCallchain(), event->GetCallchainSize(),
+                       sample.mutable_callstack());
+  sample.set_size(event->size);
+  sample.set_sampled_bytes(event->sampled_bytes);
+  listener_->OnAllocationSample(std::move(sample));
+}
+
+void UprobesUnwindingVisitor::visit(PageFaultPerfEvent* event) {
+  CHECK(listener_ != nullptr);
+
+  // Counted even when the callchain is discarded.
+  PageFaultStats& stats = GetPageFaultStats(event->GetPid(), event->GetTid());
+  if (event->major) {
+    stats.set_major_page_fault_count(stats.major_page_fault_count() +
+                                     event->weight);
+  } else {
+    stats.set_minor_page_fault_count(stats.minor_page_fault_count() +
+                                     event->weight);
+  }
+  SendChangedPageFaultStats(event->GetTimestamp());
+
+  ProcessMaps* process_maps = GetProcessMaps(event->GetPid());
+  if (process_maps == nullptr || event->GetCallchainSize() <= 1) {
+    return;
+  }
+  if (!PatchAndCheckCallchain(*process_maps, event->GetTid(),
+                              event->GetCallchain(),
+                              event->GetCallchainSize())) {
+    return;
+  }
+
+  PageFault page_fault;
+  page_fault.set_pid(event->GetPid());
+  page_fault.set_tid(event->GetTid());
+  page_fault.set_timestamp_ns(event->GetTimestamp());
+  page_fault.set_major(event->major);
+  page_fault.set_weight(event->weight);
+  CallchainToCallstack(event->GetCallchain(), event->GetCallchainSize(),
+                       page_fault.mutable_callstack());
+  listener_->OnPageFault(std::move(page_fault));
+}
+
+void UprobesUnwindingVisitor::visit(MemoryMapSyscallPerfEvent* event) {
+  CHECK(listener_ != nullptr);
+  PageFaultStats& stats = GetPageFaultStats(event->GetPid(), event->GetTid());
+  if (event->munmap) {
+    stats.set_munmap_count(stats.munmap_count() + 1);
+  } else {
+    stats.set_mmap_count(stats.mmap_count() + 1);
+  }
+  SendChangedPageFaultStats(event->GetTimestamp());
+}
+
+void UprobesUnwindingVisitor::visit(SyscallEnterPerfEvent* event) {
+  io_latency_manager_.ProcessSyscallEnter(
+      event->GetPid(), event->GetTid(), event->syscall_nr,
+      event->GetTimestamp(),
+      function_call_manager_.GetOpenUprobesCount(event->GetTid()));
+}
+
+void UprobesUnwindingVisitor::visit(SyscallExitPerfEvent* event) {
+  CHECK(listener_ != nullptr);
+  std::optional<SyscallLatency> syscall_latency =
+      io_latency_manager_.ProcessSyscallExit(
+          event->GetTid(), event->syscall_nr, event->GetTimestamp(),
+          event->ret);
+  if (!syscall_latency.has_value() ||
+      syscall_latency->end_timestamp_ns() -
+              syscall_latency->begin_timestamp_ns() <
+          min_syscall_duration_ns_) {
+    return;
+  }
+  listener_->OnSyscallLatency(std::move(syscall_latency.value()));
+}
+
+void UprobesUnwindingVisitor::visit(BlockRqIssuePerfEvent* event) {
+  io_latency_manager_.ProcessBlockRqIssue(
+      event->GetPid(), event->GetTid(), event->dev, event->sector,
+      event->nr_sector, event->write, event->GetTimestamp(),
+      function_call_manager_.GetOpenUprobesCount(event->GetTid()));
+}
+
+void UprobesUnwindingVisitor::visit(BlockRqCompletePerfEvent* event) {
+  CHECK(listener_ != nullptr);
+  std::optional<BlockIoLatency> block_io_latency =
+      io_latency_manager_.ProcessBlockRqComplete(
+          event->dev, event->sector, event->GetTimestamp(), event->error);
+  if (!block_io_latency.has_value()) {
+    return;
+  }
+  listener_->OnBlockIoLatency(std::move(block_io_latency.value()));
+}
+
+void UprobesUnwindingVisitor::visit(SystemWideContextSwitchPerfEvent* event) {
+  CHECK(listener_ != nullptr);
+  if (!event->IsSwitchIn()) {
+    return;
+  }
+  auto sample_it = off_cpu_samples_.find(event->GetTid());
+  if (sample_it == off_cpu_samples_.end()) {
+    return;
+  }
+  OffCpuCallstackSample sample = std::move(sample_it->second);
+  off_cpu_samples_.erase(sample_it);
+  if (event->GetTimestamp() < sample.timestamp_ns()) {
+    return;
+  }
+  sample.set_off_cpu_duration_ns(event->GetTimestamp() - sample.timestamp_ns());
+  listener_->OnOffCpuCallstackSample(std::move(sample));
+}
+
+void UprobesUnwindingVisitor::visit(HybridSamplePerfEvent* event) {
+  CHECK(listener_ != nullptr);
+
+  ProcessMaps* process_maps = GetProcessMaps(event->GetPid());
+  if (process_maps == nullptr) {
+    return;
+  }
+
+  std::vector<uint64_t> kernel_pcs;
+  uint64_t user_index = SplitKernelCallchain(
+      event->GetCallchain(), event->GetCallchainSize(), &kernel_pcs);
+  uint64_t* raw_callchain = event->GetCallchain() + user_index;
+  uint64_t callchain_size = event->GetCallchainSize() - user_index;
+  if (!PatchAndCheckCallchain(*process_maps, event->GetTid(), raw_callchain,
+                              callchain_size)) {
+    return;
+  }
+
+  // Same as for CallchainSamplePerfEvent.
+  std::vector<uint64_t> frame_pointer_pcs;
+  frame_pointer_pcs.reserve(callchain_size - 1);
+  frame_pointer_pcs.push_back(raw_callchain[1]);
+  for (uint64_t frame_index = 2; frame_index < callchain_size; ++frame_index) {
+    frame_pointer_pcs.push_back(raw_callchain[frame_index] - 1);
+  }
+
+  // Note that the validation accepts leaf functions without frame pointer, as
+  // with -momit-leaf-frame-pointer, so the caller of such a function is still
+  // missing, as with kFramePointers.
+  if (!frame_pointer_safe_module_paths_.empty() &&
+      IsInFramePointerSafeModules(*process_maps, frame_pointer_pcs)) {
+    CallstackSample sample;
+    sample.set_pid(event->GetPid());
+    sample.set_tid(event->GetTid());
+    sample.set_timestamp_ns(event->GetTimestamp());
+    for (uint64_t pc : kernel_pcs) {
+      sample.mutable_callstack()->add_pcs(pc);
+    }
+    for (uint64_t pc : frame_pointer_pcs) {
+      sample.mutable_callstack()->add_pcs(pc);
+    }
+    SendKernelAddressInfos(kernel_pcs);
+    listener_->OnCallstackSample(std::move(sample));
+    return;
+  }
+
+  std::array<uint64_t, PERF_REG_X86_64_MAX> registers = event->GetRegisters();
+  return_address_manager_.PatchSample(event->GetTid(),
+                                      registers[PERF_REG_X86_SP],
+                                      event->GetStackData(),
+                                      event->GetStackSize());
+  std::vector<uint64_t> dwarf_pcs;
+  for (const unwindstack::FrameData& libunwindstack_frame :
+       unwinder_.UnwindInnermostFrames(process_maps->maps.get(), registers,
+                                       event->GetStackData(),
+                                       event->GetStackSize())) {
+    // Unwinding doesn't continue correctly past a uretprobe trampoline that
+    // couldn't be patched.
+    if (process_maps->uprobes_map.Contains(libunwindstack_frame.pc)) {
+      break;
+    }
+    dwarf_pcs.push_back(libunwindstack_frame.pc);
+  }
+
+  CallstackSample sample;
+  sample.set_pid(event->GetPid());
+  sample.set_tid(event->GetTid());
+  sample.set_timestamp_ns(event->GetTimestamp());
+  for (uint64_t pc : kernel_pcs) {
+    sample.mutable_callstack()->add_pcs(pc);
+  }
+  for (uint64_t pc : MergeHybridCallstack(frame_pointer_pcs, dwarf_pcs)) {
+    sample.mutable_callstack()->add_pcs(pc);
+  }
+
+  SendKernelAddressInfos(kernel_pcs);
+  listener_->OnCallstackSample(std::move(sample));
+}
+
+void UprobesUnwindingVisitor::visit(LbrSamplePerfEvent* event) {
+  CHECK(listener_ != nullptr);
+
+  ProcessMaps* process_maps = GetProcessMaps(event->GetPid());
+  if (process_maps == nullptr) {
+    return;
+  }
+
+  // The branch records have the actual call sites, which uretprobes don't
+  // change: only the frame pointer callchain needs to be patched. They are
+  // only of user space calls.
+  std::vector<uint64_t> kernel_pcs;
+  uint64_t user_index = SplitKernelCallchain(
+      event->GetCallchain(), event->GetCallchainSize(), &kernel_pcs);
+  uint64_t* raw_callchain = event->GetCallchain() + user_index;
+  uint64_t callchain_size = event->GetCallchainSize() - user_index;
+  if (!PatchAndCheckCallchain(*process_maps, event->GetTid(), raw_callchain,
+                              callchain_size)) {
+    return;
+  }
+
+  // Same as for CallchainSamplePerfEvent.
+  std::vector<uint64_t> frame_pointer_pcs;
+  frame_pointer_pcs.reserve(callchain_size - 1);
+  frame_pointer_pcs.push_back(raw_callchain[1]);
+  for (uint64_t frame_index = 2; frame_index < callchain_size; ++frame_index) {
+    frame_pointer_pcs.push_back(raw_callchain[frame_index] - 1);
+  }
+
+  CallstackSample sample;
+  sample.set_pid(event->GetPid());
+  sample.set_tid(event->GetTid());
+  sample.set_timestamp_ns(event->GetTimestamp());
+  for (uint64_t pc : kernel_pcs) {
+    sample.mutable_callstack()->add_pcs(pc);
+  }
+  for (uint64_t pc :
+       MergeLbrCallstack(frame_pointer_pcs, event->GetCallAddresses())) {
+    sample.mutable_callstack()->add_pcs(pc);
+  }
+
+  SendKernelAddressInfos(kernel_pcs);
   listener_->OnCallstackSample(std::move(sample));
 }
 
+bool UprobesUnwindingVisitor::IsInFramePointerSafeModules(
+    const ProcessMaps& process_maps, const std::vector<uint64_t>& pcs) const {
+  // Consecutive frames are often in the same module.
+  const unwindstack::MapInfo* safe_map_info = nullptr;
+  for (uint64_t pc : pcs) {
+    const unwindstack::MapInfo* map_info = process_maps.maps->Find(pc);
+    if (map_info == nullptr) {
+      return false;
+    }
+    if (map_info == safe_map_info) {
+      continue;
+    }
+    if (!frame_pointer_safe_module_paths_.contains(map_info->name)) {
+      return false;
+    }
+    safe_map_info = map_info;
+  }
+  return true;
+}
+
 void UprobesUnwindingVisitor::visit(UprobesPerfEvent* event) {
   CHECK(listener_ != nullptr);
 
+  if (ProcessManualInstrumentationUprobes(event)) {
+    return;
+  }
+
   // We are seeing that, on thread migration, uprobe events can sometimes be
   // duplicated: the duplicate uprobe event will have the same stack pointer and
   // instruction pointer as the previous uprobe, but different cpu. In that
@@ -136,11 +858,11 @@ void UprobesUnwindingVisitor::visit(UprobesPerfEvent* event) {
     uint32_t last_uprobe_cpu = std::get<2>(uprobe_sps_ips_cpus.back());
     uprobe_sps_ips_cpus.pop_back();
     if (uprobe_sp > last_uprobe_sp) {
-      ERROR("MISSING URETPROBE OR DUPLICATE UPROBE");
+      ERROR_RATE_LIMITED("MISSING URETPROBE OR DUPLICATE UPROBE");
       return;
     } else if (uprobe_sp == last_uprobe_sp && uprobe_ip == last_uprobe_ip &&
                uprobe_cpu != last_uprobe_cpu) {
-      ERROR("Duplicate uprobe on thread migration");
+      ERROR_RATE_LIMITED("Duplicate uprobe on thread migration");
       return;
     }
   }
@@ -148,15 +870,110 @@ void UprobesUnwindingVisitor::visit(UprobesPerfEvent* event) {
 
   function_call_manager_.ProcessUprobes(
       event->GetTid(), event->GetFunction()->VirtualAddress(),
-      event->GetTimestamp(), event->ring_buffer_record.regs);
+      event->GetTimestamp(), event->ring_buffer_record.regs,
+      event->GetFunction()->RecordedArgumentCount(),
+      event->GetFunction()->SamplingRatio());
 
   return_address_manager_.ProcessUprobes(event->GetTid(), event->GetSp(),
                                          event->GetReturnAddress());
 }
 
+bool UprobesUnwindingVisitor::ProcessManualInstrumentationUprobes(
+    UprobesPerfEvent* event) {
+  if (manual_instrumentation_config_ == nullptr) {
+    return false;
+  }
+  const uint64_t address = event->GetFunction()->VirtualAddress();
+  const perf_event_sample_regs_user_sp_ip_arguments& regs =
+      event->ring_buffer_record.regs;
+  // FrameMarker(const char* name).
+  if (manual_instrumentation_config_->IsFrameMarkerAddress(address)) {
+    FrameMarker frame_marker;
+    frame_marker.set_pid(event->GetPid());
+    frame_marker.set_tid(event->GetTid());
+    frame_marker.set_timestamp_ns(event->GetTimestamp());
+    frame_marker.set_name(
+        GetManualInstrumentationName(event->GetPid(), regs.di));
+    listener_->OnFrameMarker(std::move(frame_marker));
+    return true;
+  }
+  // StartAsync(const char* name, uint64_t id) and StopAsync(uint64_t id).
+  if (manual_instrumentation_config_->IsTimerStartAsyncAddress(address)) {
+    async_span_manager_.ProcessStart(event->GetPid(), event->GetTid(),
+                                     event->GetTimestamp(), regs.di, regs.si);
+    return true;
+  }
+  if (!manual_instrumentation_config_->IsTimerStopAsyncAddress(address)) {
+    return false;
+  }
+
+  std::optional<AsyncSpanManager::AsyncSpan> span =
+      async_span_manager_.ProcessStop(event->GetPid(), event->GetTid(),
+                                      event->GetTimestamp(), regs.di);
+  if (!span.has_value()) {
+    return true;
+  }
+
+  AsyncSpan async_span;
+  async_span.set_pid(span->pid);
+  async_span.set_begin_tid(span->begin_tid);
+  async_span.set_end_tid(span->end_tid);
+  async_span.set_begin_timestamp_ns(span->begin_timestamp_ns);
+  async_span.set_end_timestamp_ns(span->end_timestamp_ns);
+  async_span.set_id(span->id);
+  async_span.set_name(
+      GetManualInstrumentationName(span->pid, span->name_address));
+  listener_->OnAsyncSpan(std::move(async_span));
+  return true;
+}
+
+const std::string& UprobesUnwindingVisitor::GetManualInstrumentationName(
+    pid_t pid, uint64_t name_address) {
+  auto [name_it, inserted] = manual_instrumentation_names_.try_emplace(
+      std::make_pair(pid, name_address));
+  if (inserted) {
+    name_it->second =
+        ReadStringFromProcessMemory(pid, name_address,
+                                    MAX_MANUAL_INSTRUMENTATION_NAME_LENGTH)
+            .value_or(absl::StrFormat("%#lx", name_address));
+  }
+  return name_it->second;
+}
+
+bool UprobesUnwindingVisitor::IsReturnedFrom(
+    uint64_t open_function_address, const Function& returning_function) const {
+  const uint64_t address = returning_function.VirtualAddress();
+  if (open_function_address == address) {
+    return true;
+  }
+  // The uretprobes of a "timer stop" close the uprobes of a "timer start".
+  return manual_instrumentation_config_ != nullptr &&
+         manual_instrumentation_config_->IsTimerStopAddress(address) &&
+         manual_instrumentation_config_->IsTimerStartAddress(
+             open_function_address);
+}
+
 void UprobesUnwindingVisitor::visit(UretprobesPerfEvent* event) {
   CHECK(listener_ != nullptr);
 
+  // Only match the uretprobe with the open uprobe of its function, as the
+  // probes of a function can be disabled while it runs: the uprobes above it
+  // are left without uretprobes, and a uretprobe without open uprobe has none.
+  std::optional<size_t> unmatched_uprobes_count =
+      function_call_manager_.CountOpenUprobesAbove(
+          event->GetTid(), [this, event](uint64_t open_function_address) {
+            return IsReturnedFrom(open_function_address, *event->GetFunction());
+          });
+  if (!unmatched_uprobes_count.has_value()) {
+    return;
+  }
+  for (size_t i = 0; i < unmatched_uprobes_count.value(); ++i) {
+    function_call_manager_.ProcessUretprobes(event->GetTid(),
+                                             event->GetTimestamp(),
+                                             std::nullopt);
+    return_address_manager_.ProcessUretprobes(event->GetTid());
+  }
+
   // Duplicate uprobe detection.
   std::vector<std::tuple<uint64_t, uint64_t, uint32_t>>& uprobe_sps_ips_cpus =
       uprobe_sps_ips_cpus_per_thread_[event->GetTid()];
@@ -164,18 +981,59 @@ void UprobesUnwindingVisitor::visit(UretprobesPerfEvent* event) {
     uprobe_sps_ips_cpus.pop_back();
   }
 
+  std::optional<uint64_t> return_value;
+  if (event->GetFunction()->RecordReturnValue()) {
+    return_value = event->GetAx();
+  }
   std::optional<FunctionCall> function_call =
       function_call_manager_.ProcessUretprobes(
-          event->GetTid(), event->GetTimestamp(), event->GetAx());
+          event->GetTid(), event->GetTimestamp(), return_value);
   if (function_call.has_value()) {
-    listener_->OnFunctionCall(std::move(function_call.value()));
+    function_call->set_pid(event->GetPid());
+    if (event->GetFunction()->AggregateCalls()) {
+      AggregateFunctionCall(function_call.value());
+    } else {
+      listener_->OnFunctionCall(std::move(function_call.value()));
+    }
   }
 
   return_address_manager_.ProcessUretprobes(event->GetTid());
 }
 
-void UprobesUnwindingVisitor::visit(MapsPerfEvent* event) {
-  current_maps_ = LibunwindstackUnwinder::ParseMaps(event->GetMaps());
+void UprobesUnwindingVisitor::visit(MmapPerfEvent* event) {
+  ProcessMaps* process_maps = GetProcessMaps(event->GetPid());
+  if (process_maps == nullptr) {
+    // Processes that are not known yet have this map read with the others.
+    if (on_demand_pids_.contains(event->GetPid()) &&
+        event->GetFilename() != "//anon" &&
+        (event->GetProt() & PROT_EXEC) != 0) {
+      CHECK(listener_ != nullptr);
+      SendModuleMap(event->GetPid(), event->GetAddress(),
+                    event->GetAddress() + event->GetLength(),
+                    event->GetPageOffset(), event->GetFilename());
+    }
+    return;
+  }
+
+  // Use the same name and offset for anonymous maps as /proc/<pid>/maps.
+  bool is_anonymous = event->GetFilename() == "//anon";
+  std::string name = is_anonymous ? "" : event->GetFilename();
+  uint64_t offset = is_anonymous ? 0 : event->GetPageOffset();
+  // unwindstack::MAPS_FLAGS_READ, _WRITE and _EXEC have the same values as
+  // PROT_READ, PROT_WRITE and PROT_EXEC.
+  auto flags = static_cast<uint16_t>(event->GetProt() &
+                                     (PROT_READ | PROT_WRITE | PROT_EXEC));
+  process_maps->maps = LibunwindstackUnwinder::AddMap(
+      process_maps->maps.get(), event->GetAddress(),
+      event->GetAddress() + event->GetLength(), offset, flags, name);
+  unwindstack::MapInfo* map_info =
+      process_maps->maps->Find(event->GetAddress());
+  if (map_info != nullptr) {
+    LookUpElfInCache(map_info);
+  }
+  // The new map might have replaced or split the uprobes map.
+  process_maps->uprobes_map =
+      UprobesReturnAddressManager::FindUprobesMap(process_maps->maps.get());
 }
 
 }  // namespace LinuxTracing
@@ -5,20 +5,44 @@
 #ifndef ORBIT_LINUX_TRACING_UPROBES_UNWINDING_VISITOR_H_
 #define ORBIT_LINUX_TRACING_UPROBES_UNWINDING_VISITOR_H_
 
+#include <OrbitBase/LogLinearHistogram.h>
+#include <OrbitBase/ThreadPool.h>
+#include <OrbitLinuxTracing/ElfCache.h>
+#include <OrbitLinuxTracing/KernelSymbols.h>
 #include <OrbitLinuxTracing/TracerListener.h>
 
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <optional>
 #include <stack>
+#include <string>
 #include <utility>
+#include <vector>
 
+#include "AsyncSpanManager.h"
+#include "IoLatencyManager.h"
 #include "LibunwindstackUnwinder.h"
+#include "LockContentionManager.h"
+#include "ManualInstrumentationConfig.h"
 #include "PerfEvent.h"
 #include "PerfEventVisitor.h"
+#include "ReorderBuffer.h"
 #include "UprobesFunctionCallManager.h"
 #include "UprobesReturnAddressManager.h"
+#include "UsedStackSizeTracker.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 
 namespace LinuxTracing {
 
+// Number of stack samples per bucket of unwinding duration, as defined by
+// OrbitBase::LogLinearHistogram. Samples can be unwound by several threads.
+using UnwindDurationHistogram =
+    std::array<std::atomic<uint64_t>,
+               OrbitBase::LogLinearHistogram::BUCKET_COUNT>;
+
 // UprobesUnwindingVisitor processes stack samples and uprobes/uretprobes
 // records (as well as memory maps changes, to keep necessary unwinding
 // information up-to-date), assuming they come in order. The reason for
@@ -34,17 +58,46 @@ namespace LinuxTracing {
 // TODO: Make this more robust to losing uprobes or uretprobes events, if this
 //  is still observed. For example, pass the address of uretprobes and compare
 //  it against the address of uprobes on the stack.
+// With a non-zero unwinding_thread_count, stack samples are only patched in
+// order, while the actual unwinding happens in parallel on a thread pool, using
+// the maps that were current at the time of the sample. The resulting
+// callstack samples are then passed on in order by a ReorderBuffer.
+// The maps are kept separately for each of the processes being captured, while
+// the other state is per thread.
+// With on-demand processes enabled, callchain samples of processes that are not
+// captured are also reported, unpatched. The first sample of such a process
+// reads its executable maps from /proc and reports them with OnModuleMap, and
+// so do its later executable mmaps. Only a bounded number of such processes is
+// remembered: the oldest one is forgotten, and its maps are reported again on
+// its next sample.
+// The uprobes of the async manual instrumentation functions don't open
+// function calls: they are matched by id into AsyncSpans instead. Neither do
+// those of the frame marker, which are reported as FrameMarkers.
+// The futex waits are matched with the return of their syscall by a
+// LockContentionManager: only the waits of at least min_lock_wait_duration_ns
+// are reported one by one, all of them are aggregated in LockContentionStats.
+// The syscalls and the block I/O requests are matched with their end by an
+// IoLatencyManager in the same way, with the depth of the thread when they
+// began: only the syscalls of at least min_syscall_duration_ns are reported.
 
 class UprobesUnwindingVisitor : public PerfEventVisitor {
  public:
-  explicit UprobesUnwindingVisitor(const std::string& initial_maps)
-      : current_maps_{LibunwindstackUnwinder::ParseMaps(initial_maps)} {}
+  // If elf_cache is not nullptr, the Elf objects of executable maps are taken
+  // from it when possible, and the ones used in this capture are added to it.
+  // The events of processes without initial maps are ignored.
+  explicit UprobesUnwindingVisitor(
+      const absl::flat_hash_map<pid_t, std::string>& initial_maps_per_pid,
+      size_t unwinding_thread_count = 0,
+      std::shared_ptr<ElfCache> elf_cache = nullptr);
+  // Waits for the stack samples still being unwound, then reports the last
+  // stats of the functions whose calls are aggregated, and of the locks.
+  ~UprobesUnwindingVisitor() override;
 
   UprobesUnwindingVisitor(const UprobesUnwindingVisitor&) = delete;
   UprobesUnwindingVisitor& operator=(const UprobesUnwindingVisitor&) = delete;
 
-  UprobesUnwindingVisitor(UprobesUnwindingVisitor&&) = default;
-  UprobesUnwindingVisitor& operator=(UprobesUnwindingVisitor&&) = default;
+  UprobesUnwindingVisitor(UprobesUnwindingVisitor&&) = delete;
+  UprobesUnwindingVisitor& operator=(UprobesUnwindingVisitor&&) = delete;
 
   void SetListener(TracerListener* listener) { listener_ = listener; }
 
@@ -57,22 +110,197 @@ class UprobesUnwindingVisitor : public PerfEventVisitor {
         std::move(discarded_samples_in_uretprobes_counter);
   }
 
+  // If set, counts the stack samples whose frames LibunwindstackUnwinder
+  // reused from the previous sample of the thread.
+  void SetUnwindMemoHitCounter(
+      std::shared_ptr<std::atomic<uint64_t>> unwind_memo_hit_counter) {
+    unwind_memo_hit_counter_ = std::move(unwind_memo_hit_counter);
+  }
+
+  // If set, the duration of unwinding each sample is counted in histogram.
+  // Otherwise, unwinding is not timed at all.
+  void SetUnwindDurationHistogram(
+      std::shared_ptr<UnwindDurationHistogram> histogram) {
+    unwind_duration_histogram_ = std::move(histogram);
+  }
+
+  // If set, the tracker is told how much of the stack unwinding each sample
+  // needed, or that unwinding failed.
+  void SetUsedStackSizeTracker(
+      std::shared_ptr<UsedStackSizeTracker> used_stack_size_tracker) {
+    used_stack_size_tracker_ = std::move(used_stack_size_tracker);
+  }
+
+  void EnableOnDemandProcesses(size_t max_on_demand_process_count) {
+    max_on_demand_process_count_ = max_on_demand_process_count;
+  }
+
+  // The hybrid samples whose whole callchain is in these modules, whose
+  // functions were all validated as having frame pointers, are not unwound
+  // with DWARF: their callchain is reported as is.
+  void SetFramePointerSafeModules(
+      absl::flat_hash_set<std::string> module_paths) {
+    frame_pointer_safe_module_paths_ = std::move(module_paths);
+  }
+
+  void SetMinLockWaitDuration(uint64_t min_lock_wait_duration_ns) {
+    min_lock_wait_duration_ns_ = min_lock_wait_duration_ns;
+  }
+  void SetMinSyscallDuration(uint64_t min_syscall_duration_ns) {
+    min_syscall_duration_ns_ = min_syscall_duration_ns;
+  }
+
+  // If set, the kernel frames of callchain samples, with
+  // CaptureOptions.kernel_callchains, are symbolized with kernel_symbols and
+  // reported as AddressInfos.
+  void SetKernelSymbols(std::shared_ptr<KernelSymbols> kernel_symbols) {
+    kernel_symbols_ = std::move(kernel_symbols);
+  }
+
+  // config must outlive this visitor.
+  void SetManualInstrumentationConfig(
+      const ManualInstrumentationConfig* config) {
+    manual_instrumentation_config_ = config;
+  }
+
   void visit(StackSamplePerfEvent* event) override;
   void visit(CallchainSamplePerfEvent* event) override;
+  // The callstack of a thread that blocked is reported with the next
+  // switch-in of the thread, with how long it was off-CPU.
+  void visit(OffCpuCallchainPerfEvent* event) override;
+  void visit(SystemWideContextSwitchPerfEvent* event) override;
+  void visit(FutexWaitPerfEvent* event) override;
+  void visit(FutexExitPerfEvent* event) override;
+  void visit(AllocationPerfEvent* event) override;
+  void visit(PageFaultPerfEvent* event) override;
+  void visit(MemoryMapSyscallPerfEvent* event) override;
+  void visit(SyscallEnterPerfEvent* event) override;
+  void visit(SyscallExitPerfEvent* event) override;
+  void visit(BlockRqIssuePerfEvent* event) override;
+  void visit(BlockRqCompletePerfEvent* event) override;
+  void visit(HybridSamplePerfEvent* event) override;
+  void visit(LbrSamplePerfEvent* event) override;
   void visit(UprobesPerfEvent* event) override;
   void visit(UretprobesPerfEvent* event) override;
-  void visit(MapsPerfEvent* event) override;
+  void visit(MmapPerfEvent* event) override;
 
  private:
+  struct UnwoundStackSample {
+    std::vector<AddressInfo> address_infos;
+    CallstackSample callstack_sample;
+  };
+
+  struct ProcessMaps {
+    // Shared with the stack samples still being unwound with these maps.
+    std::shared_ptr<unwindstack::Maps> maps;
+    // Cached from maps, as callchain samples check every frame.
+    UprobesReturnAddressManager::UprobesMap uprobes_map;
+  };
+
+  // Returns nullptr if the process is not captured or its maps couldn't be
+  // parsed.
+  ProcessMaps* GetProcessMaps(pid_t pid);
+  // Returns whether the callchain samples of pid, which is not captured,
+  // are to be reported, reading and reporting its maps if pid is new.
+  bool AddOnDemandProcessIfNeeded(pid_t pid);
+  void SendModuleMap(pid_t pid, uint64_t start, uint64_t end, uint64_t offset,
+                     const std::string& file_path);
+
+  std::optional<UnwoundStackSample> UnwindStackSample(
+      const std::shared_ptr<unwindstack::Maps>& maps, pid_t pid, pid_t tid,
+      uint64_t timestamp_ns,
+      const std::array<uint64_t, PERF_REG_X86_64_MAX>& registers,
+      const char* stack_data, uint64_t stack_size);
+  void SendUnwoundStackSample(UnwoundStackSample&& unwound_sample);
+  void LookUpElfInCache(unwindstack::MapInfo* map_info);
+  // Patches the uprobes in the callchain of a callchain or hybrid sample.
+  // Returns false if the sample needs to be discarded.
+  bool PatchAndCheckCallchain(const ProcessMaps& process_maps, pid_t tid,
+                              uint64_t* callchain, uint64_t callchain_size);
+  // The callchain of a sample taken in the kernel, with
+  // CaptureOptions.kernel_callchains, starts with PERF_CONTEXT_KERNEL and the
+  // kernel frames, followed by PERF_CONTEXT_USER and the user space frames.
+  // Returns the index of PERF_CONTEXT_USER, from which the callchain has the
+  // layout of a user space only callchain, and sets kernel_pcs to the pcs of
+  // the kernel frames.
+  static uint64_t SplitKernelCallchain(const uint64_t* callchain,
+                                       uint64_t callchain_size,
+                                       std::vector<uint64_t>* kernel_pcs);
+  // Sends the AddressInfos of the kernel pcs that have a symbol.
+  void SendKernelAddressInfos(const std::vector<uint64_t>& kernel_pcs);
+  // The callstack of a patched callchain of at least two frames.
+  static void CallchainToCallstack(const uint64_t* callchain,
+                                   uint64_t callchain_size,
+                                   Callstack* callstack);
+  [[nodiscard]] bool IsInFramePointerSafeModules(
+      const ProcessMaps& process_maps, const std::vector<uint64_t>& pcs) const;
+  void AggregateFunctionCall(const FunctionCall& function_call);
+  // Returns whether the uprobes were of an async manual instrumentation
+  // function or of the frame marker, and processed as such.
+  bool ProcessManualInstrumentationUprobes(UprobesPerfEvent* event);
+  // Whether returning_function returns from a call whose uprobe was of
+  // open_function_address.
+  [[nodiscard]] bool IsReturnedFrom(uint64_t open_function_address,
+                                    const Function& returning_function) const;
+  // The name passed to a manual instrumentation function, read once.
+  const std::string& GetManualInstrumentationName(pid_t pid,
+                                                  uint64_t name_address);
+  void SendChangedFunctionCallStats(uint64_t timestamp_ns);
+  void SendChangedLockContentionStats(uint64_t timestamp_ns);
+  PageFaultStats& GetPageFaultStats(pid_t pid, pid_t tid);
+  void SendChangedPageFaultStats(uint64_t timestamp_ns);
+
+  // Limits the memory used by the stacks of samples waiting to be unwound.
+  static constexpr uint64_t MAX_IN_FLIGHT_STACK_SAMPLES = 1024;
+  // How often, in capture time, to report the stats of aggregated functions.
+  static constexpr uint64_t FUNCTION_CALL_STATS_PERIOD_NS = 1'000'000'000;
+  // Bounds the ModuleMap events of a single process that is not captured.
+  static constexpr size_t MAX_MODULE_MAPS_PER_ON_DEMAND_PROCESS = 4096;
+  static constexpr size_t MAX_MANUAL_INSTRUMENTATION_NAME_LENGTH = 256;
+
   UprobesFunctionCallManager function_call_manager_{};
   UprobesReturnAddressManager return_address_manager_{};
-  std::unique_ptr<unwindstack::BufferMaps> current_maps_;
+  const ManualInstrumentationConfig* manual_instrumentation_config_ = nullptr;
+  std::shared_ptr<KernelSymbols> kernel_symbols_;
+  absl::flat_hash_set<std::string> frame_pointer_safe_module_paths_;
+  AsyncSpanManager async_span_manager_{};
+  // By pid and address, as the names are read from the memory of the process.
+  absl::flat_hash_map<std::pair<pid_t, uint64_t>, std::string>
+      manual_instrumentation_names_;
+  // By absolute address of the function.
+  absl::flat_hash_map<uint64_t, FunctionCallStats> function_call_stats_{};
+  absl::flat_hash_set<uint64_t> changed_function_call_stats_{};
+  uint64_t last_function_call_stats_timestamp_ns_ = 0;
+  LockContentionManager lock_contention_manager_{};
+  uint64_t min_lock_wait_duration_ns_ = 0;
+  uint64_t last_lock_contention_stats_timestamp_ns_ = 0;
+  // By tid.
+  absl::flat_hash_map<pid_t, PageFaultStats> page_fault_stats_{};
+  absl::flat_hash_set<pid_t> changed_page_fault_stats_{};
+  uint64_t last_page_fault_stats_timestamp_ns_ = 0;
+  IoLatencyManager io_latency_manager_{};
+  uint64_t min_syscall_duration_ns_ = 0;
+  absl::flat_hash_map<pid_t, ProcessMaps> maps_per_pid_;
+  // The threads that blocked, by tid, until they switch in again.
+  absl::flat_hash_map<pid_t, OffCpuCallstackSample> off_cpu_samples_;
+  // Zero if on-demand processes are disabled.
+  size_t max_on_demand_process_count_ = 0;
+  absl::flat_hash_set<pid_t> on_demand_pids_;
+  // Oldest first, for eviction.
+  std::deque<pid_t> on_demand_pids_in_order_;
   LibunwindstackUnwinder unwinder_{};
+  std::shared_ptr<ElfCache> elf_cache_;
+
+  std::unique_ptr<ReorderBuffer<UnwoundStackSample>> unwound_samples_{};
+  std::unique_ptr<ThreadPool> unwinding_thread_pool_{};
 
   TracerListener* listener_ = nullptr;
   std::shared_ptr<std::atomic<uint64_t>> unwind_error_counter_ = nullptr;
   std::shared_ptr<std::atomic<uint64_t>>
       discarded_samples_in_uretprobes_counter_ = nullptr;
+  std::shared_ptr<std::atomic<uint64_t>> unwind_memo_hit_counter_ = nullptr;
+  std::shared_ptr<UsedStackSizeTracker> used_stack_size_tracker_ = nullptr;
+  std::shared_ptr<UnwindDurationHistogram> unwind_duration_histogram_ = nullptr;
 
   absl::flat_hash_map<pid_t,
                       std::vector<std::tuple<uint64_t, uint64_t, uint32_t>>>
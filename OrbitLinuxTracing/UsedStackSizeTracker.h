@@ -0,0 +1,63 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_USED_STACK_SIZE_TRACKER_H_
+#define ORBIT_LINUX_TRACING_USED_STACK_SIZE_TRACKER_H_
+
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+namespace LinuxTracing {
+
+// UsedStackSizeTracker keeps, for every thread, the largest number of bytes
+// above the stack pointer that a successful unwinding of a stack sample of the
+// thread has used. This allows to copy only that part of the stack (plus a
+// margin) out of the ring buffer for the following samples of the thread, as
+// the stacks of most threads are much smaller than the size of the stack dump.
+// When unwinding a sample fails, possibly because the stack was cut too short,
+// the size for the thread is forgotten, so that the next sample of the thread
+// is copied in full again.
+// The methods are called both by the threads reading the ring buffers and by
+// the threads unwinding, hence they are thread safe.
+class UsedStackSizeTracker {
+ public:
+  // Returns how many bytes of the stack of a sample of tid to copy.
+  uint64_t GetStackCopySize(pid_t tid) {
+    absl::MutexLock lock{&mutex_};
+    auto used_stack_size_it = used_stack_size_per_thread_.find(tid);
+    if (used_stack_size_it == used_stack_size_per_thread_.end()) {
+      return std::numeric_limits<uint64_t>::max();
+    }
+    return used_stack_size_it->second + STACK_COPY_SIZE_MARGIN;
+  }
+
+  void OnUnwindingSucceeded(pid_t tid, uint64_t used_stack_size) {
+    absl::MutexLock lock{&mutex_};
+    uint64_t& max_used_stack_size = used_stack_size_per_thread_[tid];
+    max_used_stack_size = std::max(max_used_stack_size, used_stack_size);
+  }
+
+  void OnUnwindingFailed(pid_t tid) {
+    absl::MutexLock lock{&mutex_};
+    used_stack_size_per_thread_.erase(tid);
+  }
+
+  // The stack pointer of the outermost frame doesn't account for the return
+  // address and the data of that frame, which unwinding still needs to read.
+  static constexpr uint64_t STACK_COPY_SIZE_MARGIN = 1024;
+
+ private:
+  absl::Mutex mutex_;
+  absl::flat_hash_map<pid_t, uint64_t> used_stack_size_per_thread_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_USED_STACK_SIZE_TRACKER_H_
@@ -0,0 +1,48 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <limits>
+
+#include "UsedStackSizeTracker.h"
+
+namespace LinuxTracing {
+
+TEST(UsedStackSizeTracker, UnknownThreadIsCopiedInFull) {
+  UsedStackSizeTracker tracker;
+  EXPECT_EQ(tracker.GetStackCopySize(42),
+            std::numeric_limits<uint64_t>::max());
+}
+
+TEST(UsedStackSizeTracker, KeepsLargestUsedStackSizePerThread) {
+  UsedStackSizeTracker tracker;
+  tracker.OnUnwindingSucceeded(42, 1000);
+  tracker.OnUnwindingSucceeded(42, 3000);
+  tracker.OnUnwindingSucceeded(42, 2000);
+  tracker.OnUnwindingSucceeded(43, 500);
+
+  EXPECT_EQ(tracker.GetStackCopySize(42),
+            3000 + UsedStackSizeTracker::STACK_COPY_SIZE_MARGIN);
+  EXPECT_EQ(tracker.GetStackCopySize(43),
+            500 + UsedStackSizeTracker::STACK_COPY_SIZE_MARGIN);
+}
+
+TEST(UsedStackSizeTracker, UnwindingFailureResetsThread) {
+  UsedStackSizeTracker tracker;
+  tracker.OnUnwindingSucceeded(42, 1000);
+  tracker.OnUnwindingSucceeded(43, 500);
+  tracker.OnUnwindingFailed(42);
+
+  EXPECT_EQ(tracker.GetStackCopySize(42),
+            std::numeric_limits<uint64_t>::max());
+  EXPECT_EQ(tracker.GetStackCopySize(43),
+            500 + UsedStackSizeTracker::STACK_COPY_SIZE_MARGIN);
+
+  tracker.OnUnwindingSucceeded(42, 200);
+  EXPECT_EQ(tracker.GetStackCopySize(42),
+            200 + UsedStackSizeTracker::STACK_COPY_SIZE_MARGIN);
+}
+
+}  // namespace LinuxTracing
@@ -7,12 +7,21 @@
 
 #include <OrbitBase/Logging.h>
 #include <OrbitBase/SafeStrerror.h>
+#include <dirent.h>
+#include <sched.h>
 #include <sys/resource.h>
+#include <sys/uio.h>
 
+#include <algorithm>
 #include <fstream>
+#include <map>
+#include <memory>
 #include <thread>
 
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
 #include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_split.h"
 
@@ -40,6 +49,41 @@ std::string ReadMaps(pid_t pid) {
   }
 }
 
+std::optional<std::string> FindMallocModulePath(std::string_view maps) {
+  std::optional<std::string> libc_path;
+  for (std::string_view line : absl::StrSplit(maps, '\n')) {
+    // E.g., "7f0a8e1c5000-7f0a8e33a000 r-xp 00025000 fe:01 1234 /lib/libc.so.6"
+    std::vector<std::string_view> fields =
+        absl::StrSplit(line, ' ', absl::SkipEmpty());
+    if (fields.size() < 6 || fields[1].size() < 3 || fields[1][2] != 'x') {
+      continue;
+    }
+    std::string_view path = fields[5];
+    std::string_view file_name = path.substr(path.find_last_of('/') + 1);
+    if (absl::StartsWith(file_name, "lib") &&
+        absl::StrContains(file_name, "malloc") &&
+        absl::StrContains(file_name, ".so")) {
+      return std::string(path);
+    }
+    if (!libc_path.has_value() && (absl::StartsWith(file_name, "libc.so") ||
+                                   absl::StartsWith(file_name, "libc-"))) {
+      libc_path = std::string(path);
+    }
+  }
+  return libc_path;
+}
+
+std::string ComputeSyscallFilter(absl::Span<const int32_t> syscall_nrs) {
+  std::string filter;
+  for (int32_t syscall_nr : syscall_nrs) {
+    if (!filter.empty()) {
+      filter += " || ";
+    }
+    absl::StrAppend(&filter, "id == ", syscall_nr);
+  }
+  return filter;
+}
+
 std::optional<std::string> ExecuteCommand(const std::string& cmd) {
   std::unique_ptr<FILE, decltype(&pclose)> pipe{popen(cmd.c_str(), "r"),
                                                 pclose};
@@ -57,19 +101,23 @@ std::optional<std::string> ExecuteCommand(const std::string& cmd) {
 }
 
 std::vector<pid_t> ListThreads(pid_t pid) {
-  std::vector<pid_t> threads;
-  std::optional<std::string> tasks =
-      ExecuteCommand(absl::StrFormat("ls /proc/%d/task", pid));
-  if (!tasks.has_value()) {
+  std::string task_dirname = absl::StrFormat("/proc/%d/task", pid);
+  std::unique_ptr<DIR, decltype(&closedir)> task_dir{
+      opendir(task_dirname.c_str()), closedir};
+  if (task_dir == nullptr) {
     return {};
   }
 
-  std::stringstream ss(tasks.value());
-  std::string line;
-  while (std::getline(ss, line, '\n')) {
-    threads.push_back(std::stol(line));
+  std::vector<pid_t> threads;
+  for (dirent* entry = readdir(task_dir.get()); entry != nullptr;
+       entry = readdir(task_dir.get())) {
+    pid_t tid;
+    // Also skips "." and "..".
+    if (absl::SimpleAtoi(entry->d_name, &tid)) {
+      threads.push_back(tid);
+    }
   }
-
+  std::sort(threads.begin(), threads.end());
   return threads;
 }
 
@@ -85,6 +133,23 @@ std::string GetThreadName(pid_t tid) {
   return comm_content.value();
 }
 
+std::optional<std::string> ReadStringFromProcessMemory(pid_t pid,
+                                                       uint64_t address,
+                                                       size_t max_size) {
+  // The read stops at the end of the mapping of the string, so this is only
+  // shorter than the buffer when the string is at the end of its mapping.
+  std::string str(max_size, '\0');
+  iovec local_iov{str.data(), str.size()};
+  iovec remote_iov{reinterpret_cast<void*>(address), str.size()};
+  const ssize_t read_size =
+      process_vm_readv(pid, &local_iov, 1, &remote_iov, 1, 0);
+  if (read_size <= 0) {
+    return std::nullopt;
+  }
+  str.resize(std::min(str.find('\0'), static_cast<size_t>(read_size)));
+  return str;
+}
+
 int GetNumCores() {
   int hw_conc = static_cast<int>(std::thread::hardware_concurrency());
   // Some compilers do not support std::thread::hardware_concurrency().
@@ -92,9 +157,9 @@ int GetNumCores() {
     return hw_conc;
   }
 
-  std::optional<std::string> nproc_str = ExecuteCommand("nproc");
-  if (nproc_str.has_value() && !nproc_str.value().empty()) {
-    return std::stoi(nproc_str.value());
+  long online_cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+  if (online_cpu_count > 0) {
+    return static_cast<int>(online_cpu_count);
   }
 
   return 1;
@@ -123,6 +188,17 @@ std::optional<std::string> ExtractCpusetFromCgroup(
   return std::optional<std::string>{};
 }
 
+std::optional<uint32_t> GetCpuFrequencyKhz(int cpu) {
+  std::optional<std::string> content = ReadFile(absl::StrFormat(
+      "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", cpu));
+  uint32_t frequency_khz;
+  if (!content.has_value() ||
+      !absl::SimpleAtoi(content.value(), &frequency_khz)) {
+    return std::nullopt;
+  }
+  return frequency_khz;
+}
+
 // Read /sys/fs/cgroup/cpuset/<cgroup>/cpuset.cpus.
 static std::optional<std::string> ReadCpusetCpusContent(
     const std::string& cgroup_cpuset) {
@@ -177,6 +253,169 @@ std::vector<int> GetCpusetCpus(pid_t pid) {
   return ParseCpusetCpus(cpuset_cpus_content_opt.value());
 }
 
+std::optional<std::vector<int>> ComputeServiceCpus(
+    const std::string& service_cpus, int core_count,
+    const std::vector<int>& target_cpus) {
+  std::vector<bool> is_service_cpu(core_count, service_cpus.empty());
+  if (service_cpus.empty()) {
+    for (int cpu : target_cpus) {
+      if (cpu >= 0 && cpu < core_count) {
+        is_service_cpu[cpu] = false;
+      }
+    }
+  }
+  // Unlike ParseCpusetCpus, this doesn't trust its input.
+  for (std::string_view range :
+       absl::StrSplit(service_cpus, ',', absl::SkipEmpty())) {
+    std::vector<std::string_view> values = absl::StrSplit(range, '-');
+    int first = 0;
+    int last = 0;
+    if (values.size() > 2 || !absl::SimpleAtoi(values[0], &first) ||
+        !absl::SimpleAtoi(values.back(), &last) || first < 0 || last < first) {
+      ERROR("Malformed list of cpus \"%s\"", service_cpus);
+      return std::nullopt;
+    }
+    for (int cpu = first; cpu <= last && cpu < core_count; ++cpu) {
+      is_service_cpu[cpu] = true;
+    }
+  }
+
+  std::vector<int> cpus;
+  for (int cpu = 0; cpu < core_count; ++cpu) {
+    if (is_service_cpu[cpu]) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+std::vector<int> GetThreadCpuAffinity() {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+    ERROR("sched_getaffinity: %s", SafeStrerror(errno));
+    return {};
+  }
+  std::vector<int> cpus;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &cpu_set)) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+std::vector<int> GetNumaNodeByCpu() {
+  static constexpr const char* kNodesDirectory = "/sys/devices/system/node";
+  DIR* directory = opendir(kNodesDirectory);
+  // Without CONFIG_NUMA.
+  if (directory == nullptr) {
+    return {};
+  }
+  std::vector<int> numa_node_by_cpu;
+  while (dirent* entry = readdir(directory)) {
+    std::string_view name = entry->d_name;
+    int node = 0;
+    if (!absl::ConsumePrefix(&name, "node") || !absl::SimpleAtoi(name, &node)) {
+      continue;
+    }
+    std::optional<std::string> cpulist = ReadFile(
+        absl::StrFormat("%s/node%d/cpulist", kNodesDirectory, node));
+    if (!cpulist.has_value()) {
+      continue;
+    }
+    // The nodes with only memory have an empty list.
+    for (int cpu : ParseCpusetCpus(
+             std::string{absl::StripAsciiWhitespace(cpulist.value())})) {
+      if (cpu < 0) continue;
+      if (static_cast<size_t>(cpu) >= numa_node_by_cpu.size()) {
+        numa_node_by_cpu.resize(cpu + 1, -1);
+      }
+      numa_node_by_cpu[cpu] = node;
+    }
+  }
+  closedir(directory);
+  return numa_node_by_cpu;
+}
+
+std::vector<std::vector<int>> DistributeCpusByNumaNode(
+    const std::vector<int>& cpus, const std::vector<int>& numa_node_by_cpu,
+    size_t group_count) {
+  if (group_count == 0) {
+    return {};
+  }
+  // In order of node, with -1 for the cpus of no known node.
+  std::map<int, std::vector<int>> cpus_by_node;
+  for (int cpu : cpus) {
+    int node = cpu >= 0 && static_cast<size_t>(cpu) < numa_node_by_cpu.size()
+                   ? numa_node_by_cpu[cpu]
+                   : -1;
+    cpus_by_node[node].push_back(cpu);
+  }
+
+  std::vector<std::vector<int>> groups(group_count);
+  if (group_count <= cpus_by_node.size()) {
+    size_t node_index = 0;
+    for (const auto& [node, node_cpus] : cpus_by_node) {
+      std::vector<int>& group = groups[node_index++ % group_count];
+      group.insert(group.end(), node_cpus.begin(), node_cpus.end());
+    }
+    return groups;
+  }
+
+  // One group per node, then each of the others to the node with the most
+  // cpus per group.
+  std::vector<const std::vector<int>*> node_cpus;
+  std::vector<size_t> group_count_by_node;
+  for (const auto& [node, cpus_of_node] : cpus_by_node) {
+    node_cpus.push_back(&cpus_of_node);
+    group_count_by_node.push_back(1);
+  }
+  for (size_t i = node_cpus.size(); i < group_count; ++i) {
+    size_t best_node = 0;
+    for (size_t node = 1; node < node_cpus.size(); ++node) {
+      // a / b > c / d, the first node on ties.
+      if (node_cpus[node]->size() * group_count_by_node[best_node] >
+          node_cpus[best_node]->size() * group_count_by_node[node]) {
+        best_node = node;
+      }
+    }
+    ++group_count_by_node[best_node];
+  }
+
+  size_t first_group = 0;
+  for (size_t node = 0; node < node_cpus.size(); ++node) {
+    for (size_t i = 0; i < node_cpus[node]->size(); ++i) {
+      groups[first_group + i % group_count_by_node[node]].push_back(
+          (*node_cpus[node])[i]);
+    }
+    first_group += group_count_by_node[node];
+  }
+  return groups;
+}
+
+bool SetProcessCpuAffinity(const std::vector<int>& cpus) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int cpu : cpus) {
+    CPU_SET(cpu, &cpu_set);
+  }
+  std::vector<pid_t> tids = ListThreads(getpid());
+  if (tids.empty()) {
+    return false;
+  }
+  bool succeeded = true;
+  for (pid_t tid : tids) {
+    // Threads can exit meanwhile.
+    if (sched_setaffinity(tid, sizeof(cpu_set), &cpu_set) != 0 &&
+        errno != ESRCH) {
+      ERROR("sched_setaffinity for thread %d: %s", tid, SafeStrerror(errno));
+      succeeded = false;
+    }
+  }
+  return succeeded;
+}
+
 int GetTracepointId(const char* tracepoint_category,
                     const char* tracepoint_name) {
   std::string filename =
@@ -11,6 +11,8 @@
 #include <ctime>
 #include <optional>
 
+#include "absl/types/span.h"
+
 namespace LinuxTracing {
 
 inline uint64_t MonotonicTimestampNs() {
@@ -19,6 +21,26 @@ inline uint64_t MonotonicTimestampNs() {
   return 1'000'000'000llu * ts.tv_sec + ts.tv_nsec;
 }
 
+inline uint64_t RealtimeTimestampNs() {
+  timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return 1'000'000'000llu * ts.tv_sec + ts.tv_nsec;
+}
+
+// CPU time consumed by all the threads of the calling process.
+inline uint64_t ProcessCpuTimeNs() {
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return 1'000'000'000llu * ts.tv_sec + ts.tv_nsec;
+}
+
+// CPU time consumed by the calling thread.
+inline uint64_t ThreadCpuTimeNs() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return 1'000'000'000llu * ts.tv_sec + ts.tv_nsec;
+}
+
 std::optional<std::string> ExecuteCommand(const std::string& cmd);
 
 std::optional<std::string> ReadFile(std::string_view filename);
@@ -27,8 +49,23 @@ std::string ReadMaps(pid_t pid);
 
 std::vector<pid_t> ListThreads(pid_t pid);
 
+// The executable file mapped in maps that malloc is expected to be defined in:
+// an allocator replacing the one of the libc, e.g. libtcmalloc or libjemalloc,
+// or else the libc.
+std::optional<std::string> FindMallocModulePath(std::string_view maps);
+
+// The filter of the raw_syscalls tracepoints that only records the syscalls
+// with these numbers, e.g., "id == 0 || id == 1", or "" for all syscalls.
+std::string ComputeSyscallFilter(absl::Span<const int32_t> syscall_nrs);
+
 std::string GetThreadName(pid_t tid);
 
+// Reads the null-terminated string at address in the memory of pid, cut at
+// max_size characters. Returns nothing if the memory can't be read.
+std::optional<std::string> ReadStringFromProcessMemory(pid_t pid,
+                                                       uint64_t address,
+                                                       size_t max_size);
+
 int GetNumCores();
 
 std::optional<std::string> ExtractCpusetFromCgroup(
@@ -38,6 +75,38 @@ std::vector<int> ParseCpusetCpus(const std::string& cpuset_cpus_content);
 
 std::vector<int> GetCpusetCpus(pid_t pid);
 
+// The current frequency of cpu in kHz, from cpufreq, which reports it by
+// policy: nothing without a cpufreq driver.
+std::optional<uint32_t> GetCpuFrequencyKhz(int cpu);
+
+// The cpus to run the threads of the service on: the ones of service_cpus, in
+// the format of cpuset.cpus, or, if service_cpus is empty, the ones outside
+// target_cpus. Only cpus below core_count are kept. Nothing if service_cpus is
+// malformed, empty if there are no such cpus.
+std::optional<std::vector<int>> ComputeServiceCpus(
+    const std::string& service_cpus, int core_count,
+    const std::vector<int>& target_cpus);
+
+// The cpus the calling thread can run on, empty in case of errors.
+std::vector<int> GetThreadCpuAffinity();
+
+// The NUMA node of each cpu, by cpu, from /sys/devices/system/node: -1 for the
+// cpus of no node, empty if the kernel doesn't report NUMA nodes.
+std::vector<int> GetNumaNodeByCpu();
+
+// Splits cpus into group_count groups, so that the cpus of a group are on the
+// same NUMA node whenever there are at least as many groups as nodes. The
+// groups of a node are as many as its share of cpus allows, at least one, and
+// take its cpus in turns. With fewer groups than nodes, the groups take whole
+// nodes in turns. The cpus missing from numa_node_by_cpu count as one node.
+std::vector<std::vector<int>> DistributeCpusByNumaNode(
+    const std::vector<int>& cpus, const std::vector<int>& numa_node_by_cpu,
+    size_t group_count);
+
+// Restricts all the threads of the calling process, hence also the threads
+// they create afterwards, to these cpus. Returns false if it failed for some.
+bool SetProcessCpuAffinity(const std::vector<int>& cpus);
+
 // Looks up the tracepoint id for the given category (example: "sched")
 // and name (example: "sched_waking"). Returns the tracepoint id or
 // -1 in case of any errors.
@@ -125,4 +125,85 @@ TEST(ParseCpusetCpus, SingleValuesAndRanges) {
   EXPECT_THAT(returned_cpus, ::testing::ElementsAre(0, 1, 2, 4, 7, 12, 13, 14));
 }
 
+TEST(ComputeSyscallFilter, JoinsSyscallNumbers) {
+  EXPECT_EQ(ComputeSyscallFilter({}), "");
+  EXPECT_EQ(ComputeSyscallFilter({202}), "id == 202");
+  EXPECT_EQ(ComputeSyscallFilter({0, 1, 17}),
+            "id == 0 || id == 1 || id == 17");
+}
+
+TEST(FindMallocModulePath, LibcOrAllocator) {
+  std::string maps =
+      "55d2c1a4e000-55d2c1a50000 r-xp 00002000 fe:01 12 /usr/bin/game\n"
+      "7f0a8e1c5000-7f0a8e33a000 r--p 00000000 fe:01 34 /lib/libtcmalloc.so.4\n"
+      "7f0a8e33a000-7f0a8e4a0000 r-xp 00025000 fe:01 56 /lib/libc-2.31.so\n"
+      "7f0a8e4a0000-7f0a8e4b0000 rw-p 00000000 00:00 0\n";
+  EXPECT_EQ(FindMallocModulePath(maps), "/lib/libc-2.31.so");
+
+  maps +=
+      "7f0a8e5c5000-7f0a8e63a000 r-xp 00008000 fe:01 34 "
+      "/lib/libtcmalloc.so.4\n";
+  EXPECT_EQ(FindMallocModulePath(maps), "/lib/libtcmalloc.so.4");
+
+  EXPECT_FALSE(FindMallocModulePath(
+                   "55d2c1a4e000-55d2c1a50000 r-xp 00002000 fe:01 12 /bin/a\n")
+                   .has_value());
+}
+
+TEST(ComputeServiceCpus, OutsideOfTargetCpusByDefault) {
+  std::optional<std::vector<int>> cpus = ComputeServiceCpus("", 6, {0, 1, 4});
+  ASSERT_TRUE(cpus.has_value());
+  EXPECT_THAT(cpus.value(), ::testing::ElementsAre(2, 3, 5));
+
+  cpus = ComputeServiceCpus("", 2, {0, 1});
+  ASSERT_TRUE(cpus.has_value());
+  EXPECT_TRUE(cpus.value().empty());
+}
+
+TEST(ComputeServiceCpus, ExplicitCpus) {
+  std::optional<std::vector<int>> cpus =
+      ComputeServiceCpus("5,0-2,9", 8, {0, 1, 4});
+  ASSERT_TRUE(cpus.has_value());
+  EXPECT_THAT(cpus.value(), ::testing::ElementsAre(0, 1, 2, 5));
+
+  EXPECT_FALSE(ComputeServiceCpus("1-", 8, {}).has_value());
+  EXPECT_FALSE(ComputeServiceCpus("3-1", 8, {}).has_value());
+  EXPECT_FALSE(ComputeServiceCpus("a", 8, {}).has_value());
+}
+
+TEST(DistributeCpusByNumaNode, InTurnsWithoutNumaNodes) {
+  EXPECT_THAT(DistributeCpusByNumaNode({0, 1, 2, 3, 4}, {}, 2),
+              ::testing::ElementsAre(::testing::ElementsAre(0, 2, 4),
+                                     ::testing::ElementsAre(1, 3)));
+  EXPECT_TRUE(DistributeCpusByNumaNode({0, 1}, {}, 0).empty());
+}
+
+TEST(DistributeCpusByNumaNode, GroupsByNode) {
+  const std::vector<int> numa_node_by_cpu{0, 0, 1, 1, 0, 0, 1, 1};
+  EXPECT_THAT(
+      DistributeCpusByNumaNode({0, 1, 2, 3, 4, 5, 6, 7}, numa_node_by_cpu, 4),
+      ::testing::ElementsAre(
+          ::testing::ElementsAre(0, 4), ::testing::ElementsAre(1, 5),
+          ::testing::ElementsAre(2, 6), ::testing::ElementsAre(3, 7)));
+  EXPECT_THAT(
+      DistributeCpusByNumaNode({0, 1, 2, 3, 4, 5, 6, 7}, numa_node_by_cpu, 2),
+      ::testing::ElementsAre(::testing::ElementsAre(0, 1, 4, 5),
+                             ::testing::ElementsAre(2, 3, 6, 7)));
+}
+
+TEST(DistributeCpusByNumaNode, GroupsByShareOfCpus) {
+  EXPECT_THAT(DistributeCpusByNumaNode({0, 1, 2, 3, 4, 5, 6, 7},
+                                       {0, 0, 0, 0, 0, 0, 1, 1}, 4),
+              ::testing::ElementsAre(
+                  ::testing::ElementsAre(0, 3), ::testing::ElementsAre(1, 4),
+                  ::testing::ElementsAre(2, 5), ::testing::ElementsAre(6, 7)));
+}
+
+TEST(DistributeCpusByNumaNode, WholeNodesWithFewerGroups) {
+  EXPECT_THAT(
+      DistributeCpusByNumaNode({0, 1, 2, 3, 4, 5}, {0, 1, 2, 0, 1, 2}, 2),
+      ::testing::ElementsAre(::testing::ElementsAre(0, 3, 2, 5),
+                             ::testing::ElementsAre(1, 4)));
+}
+
 }  // namespace LinuxTracing
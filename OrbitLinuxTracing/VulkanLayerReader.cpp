@@ -0,0 +1,180 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "VulkanLayerReader.h"
+
+#include <OrbitBase/Logging.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+
+namespace LinuxTracing {
+
+namespace {
+// Maps the buffer at path if it belongs to pid and is initialized.
+orbit_vulkan_layer::SharedMemoryBuffer* MapBuffer(const std::string& path,
+                                                  pid_t pid) {
+  const int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat file_stat;
+  void* memory = MAP_FAILED;
+  if (fstat(fd, &file_stat) == 0 &&
+      file_stat.st_size >=
+          static_cast<off_t>(sizeof(orbit_vulkan_layer::SharedMemoryBuffer))) {
+    memory = mmap(nullptr, sizeof(orbit_vulkan_layer::SharedMemoryBuffer),
+                  PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (memory == MAP_FAILED) {
+    return nullptr;
+  }
+
+  auto* buffer = static_cast<orbit_vulkan_layer::SharedMemoryBuffer*>(memory);
+  // The layer might still be initializing it, it's tried again later then.
+  if (buffer->magic.load(std::memory_order_acquire) !=
+          orbit_vulkan_layer::kSharedMemoryMagic ||
+      buffer->slice_count != orbit_vulkan_layer::kSharedMemorySliceCount ||
+      buffer->pid != pid) {
+    munmap(memory, sizeof(orbit_vulkan_layer::SharedMemoryBuffer));
+    return nullptr;
+  }
+  return buffer;
+}
+
+void UnmapBuffer(orbit_vulkan_layer::SharedMemoryBuffer* buffer) {
+  buffer->enabled.store(0, std::memory_order_relaxed);
+  munmap(buffer, sizeof(orbit_vulkan_layer::SharedMemoryBuffer));
+}
+}  // namespace
+
+VulkanLayerReader::VulkanLayerReader(std::vector<pid_t> pids,
+                                     TracerListener* listener)
+    : pids_(std::move(pids)), listener_(listener) {}
+
+VulkanLayerReader::~VulkanLayerReader() {
+  for (auto& [path, buffer] : buffers_by_path_) {
+    UnmapBuffer(buffer);
+  }
+}
+
+void VulkanLayerReader::UpdateBuffers() {
+  absl::flat_hash_set<std::string> paths;
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator(
+           orbit_vulkan_layer::kSharedMemoryDirectory, error)) {
+    // "orbit_vulkan_layer.<pid>"
+    const std::string name = entry.path().filename().string();
+    if (!absl::StartsWith(name, orbit_vulkan_layer::kSharedMemoryFilePrefix)) {
+      continue;
+    }
+    pid_t pid;
+    if (!absl::SimpleAtoi(
+            name.substr(
+                std::strlen(orbit_vulkan_layer::kSharedMemoryFilePrefix)),
+            &pid) ||
+        std::find(pids_.begin(), pids_.end(), pid) == pids_.end()) {
+      continue;
+    }
+
+    const std::string path = entry.path().string();
+    paths.insert(path);
+    if (buffers_by_path_.contains(path)) continue;
+    orbit_vulkan_layer::SharedMemoryBuffer* buffer = MapBuffer(path, pid);
+    if (buffer == nullptr) continue;
+
+    buffer->read_index.store(
+        buffer->write_index.load(std::memory_order_acquire),
+        std::memory_order_release);
+    buffer->enabled.store(1, std::memory_order_relaxed);
+    buffers_by_path_.emplace(path, buffer);
+  }
+  if (error) {
+    ERROR("Listing %s: %s", orbit_vulkan_layer::kSharedMemoryDirectory,
+          error.message());
+  }
+
+  for (auto it = buffers_by_path_.begin(); it != buffers_by_path_.end();) {
+    if (paths.contains(it->first)) {
+      ++it;
+      continue;
+    }
+    ReadSlices(it->second, listener_);
+    unmapped_dropped_slice_count_ +=
+        it->second->dropped_slice_count.load(std::memory_order_relaxed);
+    UnmapBuffer(it->second);
+    buffers_by_path_.erase(it++);
+  }
+}
+
+uint64_t VulkanLayerReader::ReadSlices() {
+  uint64_t slice_count = 0;
+  for (auto& [path, buffer] : buffers_by_path_) {
+    slice_count += ReadSlices(buffer, listener_);
+  }
+  return slice_count;
+}
+
+uint64_t VulkanLayerReader::ReadSlices(
+    orbit_vulkan_layer::SharedMemoryBuffer* buffer, TracerListener* listener) {
+  const uint64_t read_index =
+      buffer->read_index.load(std::memory_order_relaxed);
+  // The layer advances write_index once all the slices of a submission are
+  // written.
+  const uint64_t write_index =
+      buffer->write_index.load(std::memory_order_acquire);
+  GpuQueueSubmission submission;
+  uint64_t submission_index = 0;
+  for (uint64_t index = read_index; index < write_index; ++index) {
+    const orbit_vulkan_layer::SharedMemorySlice& slice =
+        buffer->slices[index % orbit_vulkan_layer::kSharedMemorySliceCount];
+    if (submission.slices_size() > 0 &&
+        slice.submission_index != submission_index) {
+      listener->OnGpuQueueSubmission(std::move(submission));
+      submission = GpuQueueSubmission{};
+    }
+    if (submission.slices_size() == 0) {
+      submission_index = slice.submission_index;
+      submission.set_pid(buffer->pid);
+      submission.set_tid(slice.submit_tid);
+      submission.set_submit_begin_timestamp_ns(slice.submit_begin_timestamp_ns);
+      submission.set_submit_end_timestamp_ns(slice.submit_end_timestamp_ns);
+    }
+    GpuCommandBufferSlice* command_buffer_slice = submission.add_slices();
+    command_buffer_slice->set_begin_timestamp_ns(slice.begin_timestamp_ns);
+    command_buffer_slice->set_end_timestamp_ns(slice.end_timestamp_ns);
+    command_buffer_slice->set_depth(slice.depth);
+    command_buffer_slice->set_label(
+        slice.label,
+        strnlen(slice.label, orbit_vulkan_layer::kSharedMemoryLabelLength));
+  }
+  if (submission.slices_size() > 0) {
+    listener->OnGpuQueueSubmission(std::move(submission));
+  }
+  buffer->read_index.store(write_index, std::memory_order_release);
+  return write_index - read_index;
+}
+
+uint64_t VulkanLayerReader::GetDroppedSliceCount() const {
+  uint64_t dropped_slice_count = unmapped_dropped_slice_count_;
+  for (const auto& [path, buffer] : buffers_by_path_) {
+    dropped_slice_count +=
+        buffer->dropped_slice_count.load(std::memory_order_relaxed);
+  }
+  return dropped_slice_count;
+}
+
+}  // namespace LinuxTracing
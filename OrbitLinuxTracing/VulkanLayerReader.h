@@ -0,0 +1,59 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_VULKAN_LAYER_READER_H_
+#define ORBIT_LINUX_TRACING_VULKAN_LAYER_READER_H_
+
+#include <OrbitLinuxTracing/TracerListener.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../OrbitVulkanLayerSharedMemory.h"
+#include "absl/container/flat_hash_map.h"
+
+namespace LinuxTracing {
+
+// Reads the ring buffers in shared memory through which OrbitVulkanLayer, in
+// the captured processes that loaded it, reports the GPU times of the command
+// buffers and debug label regions of each vkQueueSubmit, and reports them to
+// the listener as GpuQueueSubmissions.
+//
+// The buffers are enabled while they are mapped, so that the layer only
+// measures the command buffers recorded during the capture.
+class VulkanLayerReader {
+ public:
+  VulkanLayerReader(std::vector<pid_t> pids, TracerListener* listener);
+  ~VulkanLayerReader();
+
+  VulkanLayerReader(const VulkanLayerReader&) = delete;
+  VulkanLayerReader& operator=(const VulkanLayerReader&) = delete;
+
+  // Maps the buffers of the processes that loaded the layer since the last
+  // call, and unmaps the ones of the processes that unloaded it, after reading
+  // them a last time.
+  void UpdateBuffers();
+  // Reports the submissions written since the last call. Returns the number
+  // of slices read.
+  uint64_t ReadSlices();
+  // The slices that the layer couldn't write as a buffer was full.
+  [[nodiscard]] uint64_t GetDroppedSliceCount() const;
+
+ private:
+  static uint64_t ReadSlices(orbit_vulkan_layer::SharedMemoryBuffer* buffer,
+                             TracerListener* listener);
+
+  std::vector<pid_t> pids_;
+  TracerListener* listener_;
+  absl::flat_hash_map<std::string, orbit_vulkan_layer::SharedMemoryBuffer*>
+      buffers_by_path_;
+  // Of the buffers that were unmapped.
+  uint64_t unmapped_dropped_slice_count_ = 0;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_VULKAN_LAYER_READER_H_
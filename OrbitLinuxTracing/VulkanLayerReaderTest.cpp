@@ -0,0 +1,131 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "../OrbitVulkanLayer/SharedMemoryWriter.h"
+#include "VulkanLayerReader.h"
+
+namespace LinuxTracing {
+
+namespace {
+
+class GpuQueueSubmissionListener : public TracerListener {
+ public:
+  void OnSchedulingSlices(std::vector<SchedulingSlice>) override {}
+  void OnSchedulingSliceCounters(SchedulingSliceCounters) override {}
+  void OnCallstackSample(CallstackSample) override {}
+  void OnOffCpuCallstackSample(OffCpuCallstackSample) override {}
+  void OnLockWait(LockWait) override {}
+  void OnLockContentionStats(LockContentionStats) override {}
+  void OnAllocationSample(AllocationSample) override {}
+  void OnSyscallLatency(SyscallLatency) override {}
+  void OnBlockIoLatency(BlockIoLatency) override {}
+  void OnCpuPowerEvent(CpuPowerEvent) override {}
+  void OnPageFault(PageFault) override {}
+  void OnPageFaultStats(PageFaultStats) override {}
+  void OnFunctionCall(FunctionCall) override {}
+  void OnFunctionCallStats(FunctionCallStats) override {}
+  void OnGpuJob(GpuJob) override {}
+  void OnThreadName(ThreadName) override {}
+  void OnThreadWakeup(ThreadWakeup) override {}
+  void OnAddressInfo(AddressInfo) override {}
+  void OnModuleMap(ModuleMap) override {}
+  void OnCaptureSetupPhase(CaptureSetupPhase) override {}
+  void OnCaptureStatistics(CaptureStatistics) override {}
+  void OnIntrospectionScope(IntrospectionScope) override {}
+  void OnManualInstrumentationScope(ManualInstrumentationScope) override {}
+  void OnGpuQueueSubmission(GpuQueueSubmission gpu_queue_submission) override {
+    submissions.push_back(std::move(gpu_queue_submission));
+  }
+  void OnAsyncSpan(AsyncSpan) override {}
+  void OnFrameMarker(FrameMarker) override {}
+  void OnDisabledInstrumentedFunctions(
+      DisabledInstrumentedFunctions) override {}
+  void OnCpuBudgetStep(CpuBudgetStep) override {}
+  void OnClockOffset(ClockOffset) override {}
+
+  std::vector<GpuQueueSubmission> submissions;
+};
+
+}  // namespace
+
+TEST(VulkanLayerReader, ReportsSubmissionsOnceMapped) {
+  GpuQueueSubmissionListener listener;
+  VulkanLayerReader reader({getpid()}, &listener);
+  orbit_vulkan_layer::SharedMemoryWriter writer;
+  EXPECT_FALSE(writer.IsEnabled());
+  writer.WriteSubmission(11, 100, 200, {{0, 300, 400, ""}});
+  reader.UpdateBuffers();
+  ASSERT_TRUE(writer.IsEnabled());
+
+  writer.WriteSubmission(
+      11, 500, 600,
+      {{0, 700, 1000, ""}, {1, 750, 900, "shadows"}, {2, 800, 850, "cull"}});
+  writer.WriteSubmission(12, 650, 660, {{0, 1100, 1200, ""}});
+  EXPECT_EQ(reader.ReadSlices(), 4);
+  EXPECT_EQ(reader.ReadSlices(), 0);
+
+  ASSERT_EQ(listener.submissions.size(), 2);
+  const GpuQueueSubmission& first = listener.submissions[0];
+  EXPECT_EQ(first.pid(), getpid());
+  EXPECT_EQ(first.tid(), 11);
+  EXPECT_EQ(first.submit_begin_timestamp_ns(), 500);
+  EXPECT_EQ(first.submit_end_timestamp_ns(), 600);
+  ASSERT_EQ(first.slices_size(), 3);
+  EXPECT_EQ(first.slices(0).label(), "");
+  EXPECT_EQ(first.slices(0).begin_timestamp_ns(), 700);
+  EXPECT_EQ(first.slices(0).end_timestamp_ns(), 1000);
+  EXPECT_EQ(first.slices(1).label(), "shadows");
+  EXPECT_EQ(first.slices(1).depth(), 1);
+  EXPECT_EQ(first.slices(2).label(), "cull");
+  EXPECT_EQ(first.slices(2).depth(), 2);
+  EXPECT_EQ(listener.submissions[1].tid(), 12);
+  EXPECT_EQ(listener.submissions[1].slices_size(), 1);
+}
+
+TEST(VulkanLayerReader, CutsLongLabels) {
+  GpuQueueSubmissionListener listener;
+  VulkanLayerReader reader({getpid()}, &listener);
+  orbit_vulkan_layer::SharedMemoryWriter writer;
+  reader.UpdateBuffers();
+  writer.WriteSubmission(11, 100, 200, {{1, 300, 400, std::string(100, 'a')}});
+  reader.ReadSlices();
+  ASSERT_EQ(listener.submissions.size(), 1);
+  EXPECT_EQ(listener.submissions[0].slices(0).label(),
+            std::string(orbit_vulkan_layer::kSharedMemoryLabelLength - 1, 'a'));
+}
+
+TEST(VulkanLayerReader, IgnoresOtherProcesses) {
+  GpuQueueSubmissionListener listener;
+  VulkanLayerReader reader({getpid() + 1}, &listener);
+  orbit_vulkan_layer::SharedMemoryWriter writer;
+  reader.UpdateBuffers();
+  EXPECT_FALSE(writer.IsEnabled());
+  writer.WriteSubmission(11, 100, 200, {{0, 300, 400, ""}});
+  EXPECT_EQ(reader.ReadSlices(), 0);
+  EXPECT_TRUE(listener.submissions.empty());
+}
+
+TEST(VulkanLayerReader, DropsWholeSubmissionsWhenFull) {
+  GpuQueueSubmissionListener listener;
+  VulkanLayerReader reader({getpid()}, &listener);
+  orbit_vulkan_layer::SharedMemoryWriter writer;
+  reader.UpdateBuffers();
+  const std::vector<orbit_vulkan_layer::GpuSlice> slices(
+      orbit_vulkan_layer::kSharedMemorySliceCount / 2 + 1,
+      orbit_vulkan_layer::GpuSlice{0, 300, 400, ""});
+  writer.WriteSubmission(11, 100, 200, slices);
+  writer.WriteSubmission(11, 100, 200, slices);
+  EXPECT_EQ(reader.GetDroppedSliceCount(), slices.size());
+  EXPECT_EQ(reader.ReadSlices(), slices.size());
+  ASSERT_EQ(listener.submissions.size(), 1);
+  EXPECT_EQ(listener.submissions[0].slices_size(), slices.size());
+}
+
+}  // namespace LinuxTracing
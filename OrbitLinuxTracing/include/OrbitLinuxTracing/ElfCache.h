@@ -0,0 +1,99 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_ELF_CACHE_H_
+#define ORBIT_LINUX_TRACING_ELF_CACHE_H_
+
+#include <unwindstack/Elf.h>
+#include <unwindstack/MapInfo.h>
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+namespace LinuxTracing {
+
+// ElfCache keeps the unwindstack::Elf objects created while unwinding, so that
+// they can be reused across captures together with the unwinding information
+// libunwindstack lazily parses and caches in them (e.g., from .eh_frame).
+// An Elf is keyed by the path and offset of the file mapping it was created
+// for, and by the modification time, size and build id of the file, so that an
+// Elf is not reused for a file that has changed since. When the cache is full,
+// the least recently used Elf is evicted.
+// All methods are thread safe.
+class ElfCache {
+ public:
+  explicit ElfCache(size_t max_size = DEFAULT_MAX_SIZE)
+      : max_size_{max_size} {}
+
+  ElfCache(const ElfCache&) = delete;
+  ElfCache& operator=(const ElfCache&) = delete;
+  ElfCache(ElfCache&&) = delete;
+  ElfCache& operator=(ElfCache&&) = delete;
+
+  // If a cached Elf for the file mapped by map_info exists, assigns it to
+  // map_info and returns true. map_info must not have an Elf yet.
+  bool Lookup(unwindstack::MapInfo* map_info);
+  // Adds the Elf of map_info to the cache, if it has one and it was created
+  // from the file mapped by map_info.
+  void Insert(unwindstack::MapInfo* map_info);
+
+  [[nodiscard]] uint64_t GetHitCount() const { return hit_count_; }
+  [[nodiscard]] uint64_t GetMissCount() const { return miss_count_; }
+  [[nodiscard]] size_t GetSize();
+
+  static constexpr size_t DEFAULT_MAX_SIZE = 1024;
+
+ private:
+  struct Key {
+    std::string path;
+    uint64_t offset;
+    int64_t modification_time_ns;
+    uint64_t file_size;
+    std::string build_id;
+
+    bool operator==(const Key& other) const {
+      return path == other.path && offset == other.offset &&
+             modification_time_ns == other.modification_time_ns &&
+             file_size == other.file_size && build_id == other.build_id;
+    }
+
+    template <typename H>
+    friend H AbslHashValue(H h, const Key& key) {
+      return H::combine(std::move(h), key.path, key.offset,
+                        key.modification_time_ns, key.file_size,
+                        key.build_id);
+    }
+  };
+
+  struct Entry {
+    Key key;
+    std::shared_ptr<unwindstack::Elf> elf;
+    uint64_t elf_offset;
+    uint64_t elf_start_offset;
+  };
+
+  static std::optional<Key> ComputeKey(const std::string& path,
+                                       uint64_t offset);
+
+  size_t max_size_;
+  absl::Mutex mutex_;
+  // Most recently used first.
+  std::list<Entry> entries_;
+  absl::flat_hash_map<Key, std::list<Entry>::iterator> entries_by_key_;
+
+  std::atomic<uint64_t> hit_count_ = 0;
+  std::atomic<uint64_t> miss_count_ = 0;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_ELF_CACHE_H_
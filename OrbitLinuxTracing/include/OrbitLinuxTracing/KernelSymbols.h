@@ -0,0 +1,63 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_KERNEL_SYMBOLS_H_
+#define ORBIT_LINUX_TRACING_KERNEL_SYMBOLS_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/base/call_once.h"
+
+namespace LinuxTracing {
+
+// The function symbols of the kernel and of its modules, to symbolize the
+// kernel frames of callchains on the service. /proc/kallsyms is only read the
+// first time the symbols are needed, and a few MB of symbols read in the
+// process are then kept across captures: the modules loaded since are not
+// symbolized.
+// All methods are thread safe.
+class KernelSymbols {
+ public:
+  struct Symbol {
+    uint64_t address;
+    std::string name;
+    // "[kernel]", or the name of the module in brackets.
+    std::string map_name;
+  };
+
+  KernelSymbols() = default;
+  // Parses kallsyms, in the format of /proc/kallsyms, instead of reading it.
+  explicit KernelSymbols(std::string_view kallsyms);
+
+  KernelSymbols(const KernelSymbols&) = delete;
+  KernelSymbols& operator=(const KernelSymbols&) = delete;
+
+  // Reads /proc/kallsyms, if not done yet. Only the first call takes time.
+  void Load();
+  // The symbol of the function containing address, i.e., the last one before
+  // it, or nullptr. Loads the symbols if needed.
+  [[nodiscard]] const Symbol* Find(uint64_t address);
+  [[nodiscard]] size_t GetSize();
+
+  // On x86-64, the kernel is in the upper half of the address space.
+  [[nodiscard]] static bool IsKernelAddress(uint64_t address) {
+    return address >= KERNEL_ADDRESS_BEGIN;
+  }
+
+  static constexpr uint64_t KERNEL_ADDRESS_BEGIN = 0xffff800000000000;
+
+ private:
+  void Parse(std::string_view kallsyms);
+
+  absl::once_flag load_once_;
+  // Sorted by address.
+  std::vector<Symbol> symbols_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_KERNEL_SYMBOLS_H_
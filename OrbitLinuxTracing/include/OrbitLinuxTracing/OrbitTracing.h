@@ -6,13 +6,23 @@
 #define ORBIT_LINUX_TRACING_ORBIT_TRACING_H_
 
 #include <OrbitBase/Tracing.h>
+#include <OrbitLinuxTracing/TracerListener.h>
 #include <memory.h>
 
 #if ORBIT_TRACING_ENABLED
 
 namespace LinuxTracing {
-void SetOrbitTracingHandler(std::unique_ptr<orbit::tracing::Handler> handler);
-}
+
+// The handler is not owned, and must never be destroyed. nullptr disables the
+// ORBIT_SCOPEs of this process.
+void SetOrbitTracingHandler(orbit::tracing::Handler* handler);
+
+// Reports the ORBIT_SCOPEs of this process to listener as IntrospectionScopes,
+// until this is called again with nullptr. The listener must stay valid until
+// then, and until the scopes that are still open on other threads have ended.
+void SetOrbitTracingListener(TracerListener* listener);
+
+}  // namespace LinuxTracing
 
 #endif  // ORBIT_TRACING_ENABLED
 
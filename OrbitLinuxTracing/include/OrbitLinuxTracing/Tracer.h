@@ -5,6 +5,8 @@
 #ifndef ORBIT_LINUX_TRACING_TRACER_H_
 #define ORBIT_LINUX_TRACING_TRACER_H_
 
+#include <OrbitLinuxTracing/ElfCache.h>
+#include <OrbitLinuxTracing/KernelSymbols.h>
 #include <OrbitLinuxTracing/TracerListener.h>
 #include <unistd.h>
 
@@ -19,10 +21,20 @@
 
 namespace LinuxTracing {
 
+template <typename T>
+class BatchQueue;
+
 class Tracer {
  public:
-  explicit Tracer(CaptureOptions capture_options)
-      : capture_options_{std::move(capture_options)} {}
+  // elf_cache, if not nullptr, is shared with other captures to reuse the Elf
+  // objects needed for unwinding. Likewise for kernel_symbols, used with
+  // kernel_callchains.
+  explicit Tracer(CaptureOptions capture_options,
+                  std::shared_ptr<ElfCache> elf_cache = nullptr,
+                  std::shared_ptr<KernelSymbols> kernel_symbols = nullptr)
+      : capture_options_{std::move(capture_options)},
+        elf_cache_{std::move(elf_cache)},
+        kernel_symbols_{std::move(kernel_symbols)} {}
 
   ~Tracer() { Stop(); }
 
@@ -33,11 +45,11 @@ class Tracer {
 
   void SetListener(TracerListener* listener) { listener_ = listener; }
 
-  void Start() {
-    *exit_requested_ = false;
-    thread_ = std::make_shared<std::thread>(&Tracer::Run, capture_options_,
-                                            listener_, exit_requested_);
-  }
+  void Start();
+
+  // Changes the instrumented functions of the running capture. The update is
+  // applied asynchronously, and reported with a CaptureSetupPhase.
+  void UpdateInstrumentedFunctions(InstrumentedFunctionsUpdate update);
 
   bool IsTracing() { return thread_ != nullptr && thread_->joinable(); }
 
@@ -47,10 +59,13 @@ class Tracer {
       thread_->join();
     }
     thread_.reset();
+    instrumented_functions_updates_.reset();
   }
 
  private:
   CaptureOptions capture_options_;
+  std::shared_ptr<ElfCache> elf_cache_;
+  std::shared_ptr<KernelSymbols> kernel_symbols_;
 
   TracerListener* listener_ = nullptr;
 
@@ -60,10 +75,22 @@ class Tracer {
   std::shared_ptr<std::atomic<bool>> exit_requested_ =
       std::make_unique<std::atomic<bool>>(true);
   std::shared_ptr<std::thread> thread_;
-
-  static void Run(const CaptureOptions& capture_options,
-                  TracerListener* listener,
-                  const std::shared_ptr<std::atomic<bool>>& exit_requested);
+  // Like exit_requested_, shared with thread_.
+  std::shared_ptr<BatchQueue<InstrumentedFunctionsUpdate>>
+      instrumented_functions_updates_;
+
+  // Push blocks beyond this, which is only reached if the updates take
+  // longer to apply than the client takes to send them.
+  static constexpr size_t MAX_QUEUED_INSTRUMENTED_FUNCTIONS_UPDATE_COUNT = 64;
+
+  static void Run(
+      const CaptureOptions& capture_options,
+      const std::shared_ptr<ElfCache>& elf_cache,
+      const std::shared_ptr<KernelSymbols>& kernel_symbols,
+      TracerListener* listener,
+      const std::shared_ptr<std::atomic<bool>>& exit_requested,
+      const std::shared_ptr<BatchQueue<InstrumentedFunctionsUpdate>>&
+          instrumented_functions_updates);
 };
 
 }  // namespace LinuxTracing
@@ -5,6 +5,8 @@
 #ifndef ORBIT_LINUX_TRACING_TRACER_LISTENER_H_
 #define ORBIT_LINUX_TRACING_TRACER_LISTENER_H_
 
+#include <vector>
+
 #include "capture.pb.h"
 
 namespace LinuxTracing {
@@ -12,12 +14,66 @@ namespace LinuxTracing {
 class TracerListener {
  public:
   virtual ~TracerListener() = default;
-  virtual void OnSchedulingSlice(SchedulingSlice scheduling_slice) = 0;
+  // Scheduling slices are frequent enough that they are reported in batches.
+  virtual void OnSchedulingSlices(
+      std::vector<SchedulingSlice> scheduling_slices) = 0;
+  // Only called with trace_performance_counters.
+  virtual void OnSchedulingSliceCounters(
+      SchedulingSliceCounters scheduling_slice_counters) = 0;
   virtual void OnCallstackSample(CallstackSample callstack_sample) = 0;
+  // Only called with trace_off_cpu.
+  virtual void OnOffCpuCallstackSample(
+      OffCpuCallstackSample off_cpu_callstack_sample) = 0;
+  // Only called with trace_lock_contention.
+  virtual void OnLockWait(LockWait lock_wait) = 0;
+  virtual void OnLockContentionStats(
+      LockContentionStats lock_contention_stats) = 0;
+  // Only called with trace_allocations.
+  virtual void OnAllocationSample(AllocationSample allocation_sample) = 0;
+  // Only called with trace_syscalls and trace_block_io, respectively.
+  virtual void OnSyscallLatency(SyscallLatency syscall_latency) = 0;
+  virtual void OnBlockIoLatency(BlockIoLatency block_io_latency) = 0;
+  // Only called with trace_cpu_power_states.
+  virtual void OnCpuPowerEvent(CpuPowerEvent cpu_power_event) = 0;
+  // Only called with trace_page_faults. The PageFaultStats of a thread are
+  // sent periodically while they change, and once more at the end.
+  virtual void OnPageFault(PageFault page_fault) = 0;
+  virtual void OnPageFaultStats(PageFaultStats page_fault_stats) = 0;
   virtual void OnFunctionCall(FunctionCall function_call) = 0;
+  // Called at the end of the capture for the functions whose calls are
+  // aggregated instead of reported with OnFunctionCall.
+  virtual void OnFunctionCallStats(FunctionCallStats function_call_stats) = 0;
   virtual void OnGpuJob(GpuJob gpu_job) = 0;
   virtual void OnThreadName(ThreadName thread_name) = 0;
+  // Only called with trace_thread_state, for the wakeups of all threads.
+  virtual void OnThreadWakeup(ThreadWakeup thread_wakeup) = 0;
   virtual void OnAddressInfo(AddressInfo address_info) = 0;
+  // Only called with sample_all_processes.
+  virtual void OnModuleMap(ModuleMap module_map) = 0;
+  virtual void OnCaptureSetupPhase(CaptureSetupPhase capture_setup_phase) = 0;
+  // Only called with capture_statistics.
+  virtual void OnCaptureStatistics(CaptureStatistics capture_statistics) = 0;
+  // Only called with introspection, from any thread with ORBIT_SCOPEs,
+  // including threads that don't belong to the Tracer.
+  virtual void OnIntrospectionScope(IntrospectionScope introspection_scope) = 0;
+  // Only called with manual_instrumentation_shared_memory.
+  virtual void OnManualInstrumentationScope(
+      ManualInstrumentationScope manual_instrumentation_scope) = 0;
+  // Only called with trace_vulkan_layer.
+  virtual void OnGpuQueueSubmission(
+      GpuQueueSubmission gpu_queue_submission) = 0;
+  // For the instrumented functions of type kTimerStartAsync and
+  // kTimerStopAsync, when a span ends.
+  virtual void OnAsyncSpan(AsyncSpan async_span) = 0;
+  // For the instrumented functions of type kFrameMarker.
+  virtual void OnFrameMarker(FrameMarker frame_marker) = 0;
+  // Only called with max_instrumented_function_call_rate, once, and with
+  // max_service_cpu_usage, after a CpuBudgetStep that disabled functions.
+  virtual void OnDisabledInstrumentedFunctions(
+      DisabledInstrumentedFunctions disabled_instrumented_functions) = 0;
+  // Only called with max_service_cpu_usage.
+  virtual void OnCpuBudgetStep(CpuBudgetStep cpu_budget_step) = 0;
+  virtual void OnClockOffset(ClockOffset clock_offset) = 0;
 };
 
 }  // namespace LinuxTracing
@@ -0,0 +1,195 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "LoadGenerator.h"
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+
+#include "../Orbit.h"
+#include "absl/strings/str_format.h"
+
+#define NO_INLINE __attribute__((noinline))
+
+// Not static nor in a namespace, so that they are easy to instrument by name.
+uint64_t NO_INLINE LoadGeneratorLeaf(uint64_t work) {
+  volatile uint64_t accumulator = 0;
+  for (uint64_t i = 0; i < work; ++i) {
+    accumulator = accumulator + i;
+  }
+  return accumulator;
+}
+
+uint64_t NO_INLINE LoadGeneratorRecurse(uint32_t depth, uint64_t work) {
+  if (depth == 0) {
+    return LoadGeneratorLeaf(work);
+  }
+  // Not a tail call, so that every level keeps its frame.
+  return LoadGeneratorRecurse(depth - 1, work) + 1;
+}
+
+namespace {
+
+// The function of the plugin library that is called after each dlopen.
+constexpr const char* kPluginFunctionName = "OrbitLoadGeneratorPluginFunction";
+using PluginFunction = int (*)(int);
+
+// Calls function per_second times per second until exit_requested, or as
+// fast as possible for 0. When running late, e.g., because a profiler slows
+// the thread down, the calls that are late by more than 100 ms are skipped
+// rather than made up, so that the slowdown shows in the rate.
+template <typename Function>
+void RunAtRate(uint64_t per_second, const std::atomic<bool>& exit_requested,
+               Function function) {
+  using std::chrono::steady_clock;
+  const steady_clock::duration period =
+      per_second > 0 ? std::chrono::duration_cast<steady_clock::duration>(
+                           std::chrono::nanoseconds(1'000'000'000) / per_second)
+                     : steady_clock::duration::zero();
+  steady_clock::time_point next_call = steady_clock::now();
+  while (!exit_requested) {
+    function();
+    if (per_second == 0) {
+      continue;
+    }
+    next_call += period;
+    const steady_clock::time_point now = steady_clock::now();
+    // Sleeping for periods shorter than a millisecond mostly measures the
+    // timer slack, calls are made in bursts instead.
+    if (next_call - now > std::chrono::milliseconds(1)) {
+      std::this_thread::sleep_until(next_call);
+    } else if (now - next_call > std::chrono::milliseconds(100)) {
+      next_call = now;
+    }
+  }
+}
+
+void SetThreadName(const std::string& name) {
+  pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+}
+
+}  // namespace
+
+bool LoadGenerator::Start() {
+  if (options_.dlopens_per_second > 0) {
+    void* handle =
+        dlopen(options_.dlopen_library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr) {
+      absl::FPrintF(stderr, "Could not load \"%s\": %s\n",
+                    options_.dlopen_library, dlerror());
+      return false;
+    }
+    const bool has_function = dlsym(handle, kPluginFunctionName) != nullptr;
+    dlclose(handle);
+    if (!has_function) {
+      absl::FPrintF(stderr, "\"%s\" has no function %s\n",
+                    options_.dlopen_library, kPluginFunctionName);
+      return false;
+    }
+  }
+
+  exit_requested_ = false;
+  for (uint32_t i = 0; i < options_.thread_count; ++i) {
+    threads_.emplace_back([this, i] {
+      SetThreadName(absl::StrFormat("LoadCalls_%u", i));
+      RunCalls();
+    });
+  }
+  if (options_.manual_scopes_per_second > 0) {
+    threads_.emplace_back([this] {
+      SetThreadName("LoadScopes");
+      RunManualScopes();
+    });
+  }
+  if (options_.mmaps_per_second > 0) {
+    threads_.emplace_back([this] {
+      SetThreadName("LoadMmaps");
+      RunMmaps();
+    });
+  }
+  if (options_.dlopens_per_second > 0) {
+    threads_.emplace_back([this] {
+      SetThreadName("LoadDlopens");
+      RunDlopens();
+    });
+  }
+  return true;
+}
+
+void LoadGenerator::Stop() {
+  exit_requested_ = true;
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+}
+
+LoadGeneratorCounters LoadGenerator::GetCounters() const {
+  LoadGeneratorCounters counters;
+  counters.calls = calls_;
+  counters.manual_scopes = manual_scopes_;
+  counters.mmaps = mmaps_;
+  counters.dlopens = dlopens_;
+  return counters;
+}
+
+void LoadGenerator::RunCalls() {
+  RunAtRate(options_.calls_per_second, exit_requested_, [this] {
+    LoadGeneratorRecurse(options_.stack_depth, options_.work_per_call);
+    calls_.fetch_add(1, std::memory_order_relaxed);
+  });
+}
+
+void LoadGenerator::RunManualScopes() {
+  RunAtRate(options_.manual_scopes_per_second, exit_requested_, [this] {
+    {
+      ORBIT_SCOPE("LoadGeneratorScope");
+      LoadGeneratorLeaf(options_.work_per_call);
+    }
+    manual_scopes_.fetch_add(1, std::memory_order_relaxed);
+  });
+}
+
+void LoadGenerator::RunMmaps() {
+  // Only executable mappings are reported to profilers by perf_event_open.
+  int fd = open("/proc/self/exe", O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    absl::FPrintF(stderr, "Could not open /proc/self/exe\n");
+    return;
+  }
+  const size_t size = sysconf(_SC_PAGESIZE);
+  RunAtRate(options_.mmaps_per_second, exit_requested_, [this, fd, size] {
+    void* address =
+        mmap(nullptr, size, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) {
+      return;
+    }
+    munmap(address, size);
+    mmaps_.fetch_add(1, std::memory_order_relaxed);
+  });
+  close(fd);
+}
+
+void LoadGenerator::RunDlopens() {
+  RunAtRate(options_.dlopens_per_second, exit_requested_, [this] {
+    void* handle =
+        dlopen(options_.dlopen_library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr) {
+      return;
+    }
+    auto function =
+        reinterpret_cast<PluginFunction>(dlsym(handle, kPluginFunctionName));
+    if (function != nullptr) {
+      function(1);
+    }
+    dlclose(handle);
+    dlopens_.fetch_add(1, std::memory_order_relaxed);
+  });
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LOAD_GENERATOR_LOAD_GENERATOR_H_
+#define ORBIT_LOAD_GENERATOR_LOAD_GENERATOR_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// The load that OrbitLoadGenerator puts on a profiler. Rates are per second,
+// calls_per_second for each of the thread_count threads. A rate of 0 disables
+// the corresponding load, except for calls_per_second, where 0 means as fast
+// as possible.
+struct LoadGeneratorOptions {
+  uint32_t thread_count = 8;
+  // Each call is a chain of stack_depth nested calls of
+  // LoadGeneratorRecurse, around a call of LoadGeneratorLeaf, which spins
+  // work_per_call times.
+  uint64_t calls_per_second = 10'000;
+  uint32_t stack_depth = 20;
+  uint64_t work_per_call = 1'000;
+  // ORBIT_SCOPEs of Orbit.h, by a thread of their own.
+  uint64_t manual_scopes_per_second = 0;
+  // Executable file mappings mapped and unmapped, and dlopen and dlclose of
+  // dlopen_library, by a thread of their own each, which the profiler has to
+  // keep its view of the maps of the process up to date with.
+  uint64_t mmaps_per_second = 0;
+  uint64_t dlopens_per_second = 0;
+  std::string dlopen_library;
+};
+
+// The work done since the start, for the rates of the load to be compared
+// with and without a profiler attached.
+struct LoadGeneratorCounters {
+  uint64_t calls = 0;
+  uint64_t manual_scopes = 0;
+  uint64_t mmaps = 0;
+  uint64_t dlopens = 0;
+};
+
+// Runs the threads of the load until Stop or destruction.
+class LoadGenerator {
+ public:
+  explicit LoadGenerator(LoadGeneratorOptions options)
+      : options_(std::move(options)) {}
+  LoadGenerator(const LoadGenerator&) = delete;
+  LoadGenerator& operator=(const LoadGenerator&) = delete;
+  ~LoadGenerator() { Stop(); }
+
+  // Returns false if a thread of the load can't be started, e.g., when
+  // dlopen_library can't be loaded.
+  [[nodiscard]] bool Start();
+  void Stop();
+
+  [[nodiscard]] LoadGeneratorCounters GetCounters() const;
+
+ private:
+  void RunCalls();
+  void RunManualScopes();
+  void RunMmaps();
+  void RunDlopens();
+
+  const LoadGeneratorOptions options_;
+  std::atomic<bool> exit_requested_ = false;
+  std::vector<std::thread> threads_;
+  std::atomic<uint64_t> calls_ = 0;
+  std::atomic<uint64_t> manual_scopes_ = 0;
+  std::atomic<uint64_t> mmaps_ = 0;
+  std::atomic<uint64_t> dlopens_ = 0;
+};
+
+#endif  // ORBIT_LOAD_GENERATOR_LOAD_GENERATOR_H_
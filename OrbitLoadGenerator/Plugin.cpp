@@ -0,0 +1,16 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// The library that OrbitLoadGenerator loads and unloads with
+// --dlopens_per_second: a module with symbols that comes and goes, for the
+// profiler to keep track of.
+
+extern "C" __attribute__((visibility("default"))) int
+OrbitLoadGeneratorPluginFunction(int value) {
+  volatile int result = value;
+  for (int i = 0; i < 100; ++i) {
+    result = result * 3 + i;
+  }
+  return result;
+}
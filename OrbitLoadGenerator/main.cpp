@@ -0,0 +1,123 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A target with a controlled load for measuring the overhead of profiling
+// it: threads calling instrumentable functions at a given rate and stack
+// depth, ORBIT_SCOPEs, and mmap and dlopen churn. Prints the work done and
+// the CPU time used in each interval, as one JSON object per line, which
+// measure_overhead.py compares with and without a capture.
+//
+// Usage: OrbitLoadGenerator [flags]
+
+#include <absl/flags/flag.h>
+#include <absl/flags/parse.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "LoadGenerator.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+ABSL_FLAG(uint32_t, threads, 8, "Number of threads making calls");
+ABSL_FLAG(uint64_t, calls_per_second, 10'000,
+          "Calls per second of each thread, or 0 for as fast as possible");
+ABSL_FLAG(uint32_t, stack_depth, 20,
+          "Number of nested calls of LoadGeneratorRecurse in each call");
+ABSL_FLAG(uint64_t, work_per_call, 1'000,
+          "Iterations of the loop of LoadGeneratorLeaf in each call");
+ABSL_FLAG(uint64_t, manual_scopes_per_second, 0,
+          "ORBIT_SCOPEs per second, on a thread of their own");
+ABSL_FLAG(uint64_t, mmaps_per_second, 0,
+          "Executable file mappings mapped and unmapped per second");
+ABSL_FLAG(uint64_t, dlopens_per_second, 0,
+          "dlopens and dlcloses of --dlopen_library per second");
+ABSL_FLAG(std::string, dlopen_library, "",
+          "The library to dlopen, by default libOrbitLoadGeneratorPlugin.so "
+          "next to the executable");
+ABSL_FLAG(double, duration_s, 0,
+          "Seconds to run for, or 0 to run until killed");
+ABSL_FLAG(uint32_t, report_interval_ms, 1000,
+          "Interval between the reports of the work done");
+
+namespace {
+
+double GetProcessCpuSeconds() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return absl::ToDoubleSeconds(absl::DurationFromTimeval(usage.ru_utime) +
+                               absl::DurationFromTimeval(usage.ru_stime));
+}
+
+std::string GetDefaultDlopenLibrary() {
+  char path[4096];
+  ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+  if (length <= 0) {
+    return "libOrbitLoadGeneratorPlugin.so";
+  }
+  std::string executable(path, length);
+  return executable.substr(0, executable.rfind('/') + 1) +
+         "libOrbitLoadGeneratorPlugin.so";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+
+  LoadGeneratorOptions options;
+  options.thread_count = absl::GetFlag(FLAGS_threads);
+  options.calls_per_second = absl::GetFlag(FLAGS_calls_per_second);
+  options.stack_depth = absl::GetFlag(FLAGS_stack_depth);
+  options.work_per_call = absl::GetFlag(FLAGS_work_per_call);
+  options.manual_scopes_per_second =
+      absl::GetFlag(FLAGS_manual_scopes_per_second);
+  options.mmaps_per_second = absl::GetFlag(FLAGS_mmaps_per_second);
+  options.dlopens_per_second = absl::GetFlag(FLAGS_dlopens_per_second);
+  options.dlopen_library = absl::GetFlag(FLAGS_dlopen_library);
+  if (options.dlopen_library.empty()) {
+    options.dlopen_library = GetDefaultDlopenLibrary();
+  }
+  const double duration_s = absl::GetFlag(FLAGS_duration_s);
+  const absl::Duration report_interval = absl::Milliseconds(
+      std::max(absl::GetFlag(FLAGS_report_interval_ms), 1u));
+
+  LoadGenerator load_generator{options};
+  if (!load_generator.Start()) {
+    return 1;
+  }
+
+  const absl::Time start = absl::Now();
+  absl::Time previous_time = start;
+  double previous_cpu_s = GetProcessCpuSeconds();
+  LoadGeneratorCounters previous_counters = load_generator.GetCounters();
+  while (duration_s <= 0 || absl::Now() - start < absl::Seconds(duration_s)) {
+    absl::SleepFor(report_interval);
+    const absl::Time time = absl::Now();
+    const double cpu_s = GetProcessCpuSeconds();
+    const LoadGeneratorCounters counters = load_generator.GetCounters();
+    // The interval is between unix_time_s - interval_s and unix_time_s.
+    absl::PrintF(
+        "{\"unix_time_s\": %.3f, \"interval_s\": %.3f, \"calls\": %u, "
+        "\"manual_scopes\": %u, \"mmaps\": %u, \"dlopens\": %u, "
+        "\"cpu_s\": %.6f}\n",
+        absl::ToDoubleSeconds(time - absl::UnixEpoch()),
+        absl::ToDoubleSeconds(time - previous_time),
+        counters.calls - previous_counters.calls,
+        counters.manual_scopes - previous_counters.manual_scopes,
+        counters.mmaps - previous_counters.mmaps,
+        counters.dlopens - previous_counters.dlopens, cpu_s - previous_cpu_s);
+    fflush(stdout);
+    previous_time = time;
+    previous_cpu_s = cpu_s;
+    previous_counters = counters;
+  }
+  load_generator.Stop();
+  return 0;
+}
@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+# Copyright (c) 2020 The Orbit Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+"""Measures the overhead of capturing OrbitLoadGenerator with OrbitService.
+
+Runs OrbitLoadGenerator without a capture, then once for each mode while
+OrbitHeadlessCapture captures it, and reports for each mode:
+  - the slowdown of the target: its rate of calls, and its CPU time per call,
+    relative to the run without a capture,
+  - the CPU used by OrbitService during the capture, in cores,
+  - the events lost, as the dropped_event_count of the capture.
+
+Meant to run regularly on the same machine as a performance baseline, e.g.,
+from cron, with --append_to collecting the results of every run. Needs to
+run as root, like OrbitService, which it starts unless --service_pid is
+given.
+
+Usage: sudo measure_overhead.py --bin_dir=<build>/bin [options]
+       [-- <OrbitLoadGenerator flags>]
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import threading
+import time
+
+# The flags of OrbitHeadlessCapture for each mode.
+MODES = {
+    "dwarf": [],
+    "frame_pointers": ["--frame_pointer_unwinding"],
+    "uprobes": ["--sampling_rate=0", "--functions=LoadGeneratorLeaf",
+                "--modules=OrbitLoadGenerator"],
+    "manual": ["--sampling_rate=0",
+               "--functions=orbit_api::Start,orbit_api::Stop",
+               "--modules=OrbitLoadGenerator"],
+}
+
+
+class LoadGeneratorProcess:
+    """Runs OrbitLoadGenerator and collects the reports it prints."""
+
+    def __init__(self, bin_dir, flags):
+        self.process = subprocess.Popen(
+            [os.path.join(bin_dir, "OrbitLoadGenerator")] + flags,
+            stdout=subprocess.PIPE, universal_newlines=True)
+        self.reports = []
+        self.reader = threading.Thread(target=self._read_reports)
+        self.reader.start()
+
+    def _read_reports(self):
+        for line in self.process.stdout:
+            self.reports.append(json.loads(line))
+
+    def stop(self):
+        self.process.terminate()
+        self.process.wait()
+        self.reader.join()
+
+    def get_rates(self, begin_time, end_time):
+        """The work done in the reported intervals within the time range."""
+        reports = [report for report in self.reports
+                   if report["unix_time_s"] - report["interval_s"] >= begin_time
+                   and report["unix_time_s"] <= end_time]
+        duration_s = sum(report["interval_s"] for report in reports)
+        calls = sum(report["calls"] for report in reports)
+        cpu_s = sum(report["cpu_s"] for report in reports)
+        if duration_s == 0 or calls == 0:
+            return None
+        return {"calls_per_s": calls / duration_s,
+                "cpu_ns_per_call": 1e9 * cpu_s / calls,
+                "target_cpu_cores": cpu_s / duration_s}
+
+
+def get_process_cpu_s(pid):
+    with open("/proc/{}/stat".format(pid)) as stat_file:
+        # The fields after the command, which can contain spaces.
+        fields = stat_file.read().rsplit(")", 1)[1].split()
+    utime, stime = int(fields[11]), int(fields[12])
+    return (utime + stime) / os.sysconf("SC_CLK_TCK")
+
+
+def run_mode(args, mode, generator_flags, service_pid, baseline):
+    generator = LoadGeneratorProcess(args.bin_dir, generator_flags)
+    try:
+        time.sleep(args.warmup_s)
+        result = {"mode": mode}
+        if mode == "none":
+            begin_time = time.time()
+            time.sleep(args.duration_s)
+            end_time = time.time()
+        else:
+            service_cpu_before = get_process_cpu_s(service_pid)
+            capture_begin_time = time.time()
+            capture = subprocess.run(
+                [os.path.join(args.bin_dir, "OrbitHeadlessCapture"),
+                 "--pid={}".format(generator.process.pid),
+                 "--duration_s={}".format(args.duration_s)] + MODES[mode],
+                stdout=subprocess.PIPE, universal_newlines=True, check=True)
+            end_time = time.time()
+            # The capture takes a moment to start, e.g., to instrument the
+            # functions, which isn't part of its duration.
+            begin_time = max(capture_begin_time, end_time - args.duration_s)
+            service_cpu_s = get_process_cpu_s(service_pid) - service_cpu_before
+            summary = json.loads(capture.stdout)
+            result["service_cpu_cores"] = (
+                service_cpu_s / (end_time - capture_begin_time))
+            result["dropped_event_count"] = summary["dropped_event_count"]
+            result["sample_count"] = summary["sample_count"]
+            result["captured_calls"] = sum(
+                function["count"] for function in summary["functions"])
+        rates = generator.get_rates(begin_time, end_time)
+        if rates is None:
+            sys.exit("No reports of OrbitLoadGenerator during the {} run"
+                     .format(mode))
+        result.update(rates)
+        if baseline is not None:
+            result["call_rate_ratio"] = (
+                rates["calls_per_s"] / baseline["calls_per_s"])
+            result["cpu_per_call_ratio"] = (
+                rates["cpu_ns_per_call"] / baseline["cpu_ns_per_call"])
+        return result
+    finally:
+        generator.stop()
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument("--bin_dir", required=True,
+                        help="The directory of OrbitLoadGenerator, "
+                             "OrbitHeadlessCapture and OrbitService")
+    parser.add_argument("--modes", default=",".join(MODES),
+                        help="Comma-separated modes to measure, of " +
+                             ", ".join(MODES))
+    parser.add_argument("--duration_s", type=float, default=10,
+                        help="Duration of each measurement")
+    parser.add_argument("--warmup_s", type=float, default=2,
+                        help="Time the target runs before each measurement")
+    parser.add_argument("--service_pid", type=int, default=0,
+                        help="The pid of a running OrbitService to use, "
+                             "instead of starting one")
+    parser.add_argument("--append_to", default="",
+                        help="Also append the results as one JSON line to "
+                             "this file")
+    parser.add_argument("generator_flags", nargs="*",
+                        help="Flags of OrbitLoadGenerator")
+    args = parser.parse_args()
+
+    modes = [mode for mode in args.modes.split(",") if mode]
+    for mode in modes:
+        if mode not in MODES:
+            sys.exit("Unknown mode \"{}\"".format(mode))
+    generator_flags = args.generator_flags
+    if "manual" in modes and not any(
+            flag.startswith("--manual_scopes_per_second")
+            for flag in generator_flags):
+        generator_flags = generator_flags + ["--manual_scopes_per_second=10000"]
+
+    service = None
+    service_pid = args.service_pid
+    if service_pid == 0:
+        service = subprocess.Popen(
+            [os.path.join(args.bin_dir, "OrbitService")],
+            stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        service_pid = service.pid
+        time.sleep(1)
+    try:
+        baseline = run_mode(args, "none", generator_flags, service_pid, None)
+        results = [baseline]
+        for mode in modes:
+            results.append(
+                run_mode(args, mode, generator_flags, service_pid, baseline))
+    finally:
+        if service is not None:
+            service.terminate()
+            service.wait()
+
+    report = {"unix_time_s": time.time(), "generator_flags": generator_flags,
+              "duration_s": args.duration_s, "results": results}
+    print(json.dumps(report, indent=2))
+    if args.append_to:
+        with open(args.append_to, "a") as output:
+            output.write(json.dumps(report) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,135 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "DurationHistogramWidget.h"
+
+#include <QPainter>
+#include <algorithm>
+#include <optional>
+
+#include "OrbitBase/LogLinearHistogram.h"
+#include "Utils.h"
+#include "absl/strings/str_format.h"
+
+using orbit_client_protos::FunctionInfo;
+using OrbitBase::LogLinearHistogram;
+
+namespace {
+constexpr int kMargin = 4;
+constexpr int kHeight = 120;
+
+QString GetPrettyDuration(uint64_t duration_ns) {
+  return QString::fromStdString(
+      GetPrettyTime(absl::Nanoseconds(duration_ns)));
+}
+}  // namespace
+
+DurationHistogramWidget::DurationHistogramWidget(QWidget* parent)
+    : QWidget(parent) {
+  setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+}
+
+void DurationHistogramWidget::SetFunction(
+    std::shared_ptr<const FunctionInfo> function) {
+  function_ = std::move(function);
+  update();
+}
+
+QSize DurationHistogramWidget::sizeHint() const {
+  return QSize(QWidget::sizeHint().width(), kHeight);
+}
+
+void DurationHistogramWidget::paintEvent(QPaintEvent* /*event*/) {
+  QPainter painter(this);
+  const QFontMetrics metrics = painter.fontMetrics();
+  const QRect text_rect = rect().adjusted(kMargin, kMargin, -kMargin, -kMargin);
+
+  if (function_ == nullptr) {
+    painter.drawText(text_rect, Qt::AlignCenter,
+                     "Select a function above to show the distribution of "
+                     "the durations of its calls.");
+    return;
+  }
+
+  const auto& histogram = function_->stats().duration_histogram();
+  int first_bucket = 0;
+  while (first_bucket < histogram.size() && histogram[first_bucket] == 0) {
+    ++first_bucket;
+  }
+  if (first_bucket == histogram.size()) {
+    painter.drawText(text_rect, Qt::AlignCenter,
+                     QString::fromStdString(absl::StrFormat(
+                         "No calls of %s yet.", function_->pretty_name())));
+    return;
+  }
+  int last_bucket = histogram.size() - 1;
+  while (histogram[last_bucket] == 0) {
+    --last_bucket;
+  }
+  uint64_t max_count = 0;
+  for (int i = first_bucket; i <= last_bucket; ++i) {
+    max_count = std::max(max_count, histogram[i]);
+  }
+
+  // The name on top, the range of the durations at the bottom.
+  painter.drawText(text_rect, Qt::AlignTop | Qt::AlignLeft,
+                   QString::fromStdString(absl::StrFormat(
+                       "%s: %lu calls", function_->pretty_name(),
+                       function_->stats().count())));
+  painter.drawText(
+      text_rect, Qt::AlignBottom | Qt::AlignLeft,
+      GetPrettyDuration(LogLinearHistogram::GetBucketLowerBound(first_bucket)));
+  painter.drawText(
+      text_rect, Qt::AlignBottom | Qt::AlignRight,
+      GetPrettyDuration(LogLinearHistogram::GetBucketUpperBound(last_bucket)));
+
+  const QRect bars_rect =
+      text_rect.adjusted(0, metrics.height(), 0, -metrics.height());
+  if (bars_rect.height() <= 0 || bars_rect.width() <= 0) {
+    return;
+  }
+  const int bucket_count = last_bucket - first_bucket + 1;
+  const double bucket_width =
+      static_cast<double>(bars_rect.width()) / bucket_count;
+  auto get_bucket_x = [&](int bucket) {
+    return bars_rect.left() + (bucket - first_bucket) * bucket_width;
+  };
+
+  const QColor bar_color = palette().color(QPalette::Highlight);
+  for (int i = first_bucket; i <= last_bucket; ++i) {
+    if (histogram[i] == 0) continue;
+    // Buckets with few calls stay visible next to the largest one.
+    const int bar_height = std::max(
+        1, static_cast<int>(bars_rect.height() * histogram[i] / max_count));
+    painter.fillRect(QRectF(get_bucket_x(i), bars_rect.bottom() - bar_height,
+                            std::max(1.0, bucket_width - 1), bar_height),
+                     bar_color);
+  }
+
+  // The markers and labels of the percentiles, the labels one row apart so
+  // that close percentiles don't overlap.
+  painter.setPen(palette().color(QPalette::Text));
+  int label_row = 0;
+  for (double percentile : {50.0, 95.0, 99.0}) {
+    std::optional<uint64_t> percentile_ns =
+        LogLinearHistogram::ComputeQuantile(histogram, percentile / 100);
+    if (!percentile_ns.has_value()) continue;
+    const int bucket = static_cast<int>(
+        LogLinearHistogram::GetBucketIndex(percentile_ns.value()));
+    const int x = static_cast<int>(get_bucket_x(bucket) + bucket_width / 2);
+    painter.drawLine(x, bars_rect.top(), x, bars_rect.bottom());
+
+    const QString label = QString::fromStdString(absl::StrFormat(
+        "p%.0f %s", percentile,
+        GetPrettyTime(absl::Nanoseconds(percentile_ns.value()))));
+    const int label_width = metrics.horizontalAdvance(label);
+    const int label_x = std::max(
+        bars_rect.left(), std::min(x + 2, bars_rect.right() - label_width));
+    painter.drawText(label_x,
+                     bars_rect.top() + metrics.ascent() +
+                         label_row * metrics.height(),
+                     label);
+    ++label_row;
+  }
+}
@@ -0,0 +1,36 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_QT_DURATION_HISTOGRAM_WIDGET_H_
+#define ORBIT_QT_DURATION_HISTOGRAM_WIDGET_H_
+
+#include <QWidget>
+#include <memory>
+
+#include "capture_data.pb.h"
+
+// Draws the histogram of the durations of the calls of a function, one bar
+// per bucket of OrbitBase::LogLinearHistogram between the shortest and the
+// longest call, so that the horizontal axis is about logarithmic. The 50th,
+// 95th and 99th percentiles are marked. The histogram is read again from the
+// function on each paint, call update() to show the calls added since.
+class DurationHistogramWidget : public QWidget {
+  Q_OBJECT
+
+ public:
+  explicit DurationHistogramWidget(QWidget* parent = nullptr);
+
+  void SetFunction(
+      std::shared_ptr<const orbit_client_protos::FunctionInfo> function);
+
+  [[nodiscard]] QSize sizeHint() const override;
+
+ protected:
+  void paintEvent(QPaintEvent* event) override;
+
+ private:
+  std::shared_ptr<const orbit_client_protos::FunctionInfo> function_;
+};
+
+#endif  // ORBIT_QT_DURATION_HISTOGRAM_WIDGET_H_
@@ -145,6 +145,18 @@ OrbitStartupWindow::OrbitStartupWindow(QWidget* parent)
   model_->SetInstances({});
 }
 
+void OrbitStartupWindow::ShowCachedInstances() {
+  CHECK(ggp_client_);
+
+  QVector<Instance> instances = ggp_client_->GetCachedInstances();
+  std::optional<Instance> last_used_instance =
+      ggp_client_->GetLastUsedInstance(instances);
+  if (last_used_instance) {
+    ggp_client_->PrefetchSshInfo(last_used_instance.value());
+  }
+  model_->SetInstances(std::move(instances));
+}
+
 void OrbitStartupWindow::ReloadInstances() {
   CHECK(ggp_client_);
 
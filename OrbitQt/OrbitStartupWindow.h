@@ -38,6 +38,7 @@ class OrbitStartupWindow : public QDialog {
     OUTCOME_TRY(create_result, Client::Create(this));
     ggp_client_ = std::move(create_result);
 
+    ShowCachedInstances();
     ReloadInstances();
 
     result_ = std::monostate{};
@@ -64,6 +65,9 @@ class OrbitStartupWindow : public QDialog {
   }
 
  private:
+  // Shows the instances of the previous listing until they are reloaded, and
+  // prefetches the ssh info of the last used one.
+  void ShowCachedInstances();
   void ReloadInstances();
 
   QPointer<Client> ggp_client_;
@@ -5,7 +5,7 @@
 #include "TopDownViewItemModel.h"
 
 TopDownViewItemModel::TopDownViewItemModel(
-    std::unique_ptr<TopDownView> top_down_view, QObject* parent)
+    std::shared_ptr<TopDownView> top_down_view, QObject* parent)
     : QAbstractItemModel{parent}, top_down_view_{std::move(top_down_view)} {}
 
 QVariant TopDownViewItemModel::GetDisplayRoleData(
@@ -41,7 +41,8 @@ QVariant TopDownViewItemModel::GetDisplayRoleData(
   } else if (function_item != nullptr) {
     switch (index.column()) {
       case kThreadOrFunction:
-        return QString::fromStdString(function_item->function_name());
+        return QString::fromUtf8(function_item->function_name().data(),
+                                 function_item->function_name().size());
       case kInclusive:
         return QString::fromStdString(absl::StrFormat(
             "%.2f%% (%llu)",
@@ -79,7 +80,8 @@ QVariant TopDownViewItemModel::GetEditRoleData(const QModelIndex& index) const {
   } else if (function_item != nullptr) {
     switch (index.column()) {
       case kThreadOrFunction:
-        return QString::fromStdString(function_item->function_name());
+        return QString::fromUtf8(function_item->function_name().data(),
+                                 function_item->function_name().size());
       case kInclusive:
         return static_cast<qulonglong>(function_item->sample_count());
       case kExclusive:
@@ -165,10 +167,10 @@ QModelIndex TopDownViewItemModel::index(int row, int column,
   if (!parent.isValid()) {
     parent_item = top_down_view_.get();
   } else {
-    parent_item = static_cast<TopDownInternalNode*>(parent.internalPointer());
+    parent_item = static_cast<TopDownNode*>(parent.internalPointer());
   }
 
-  const std::vector<const TopDownNode*>& siblings = parent_item->children();
+  absl::Span<const TopDownNode* const> siblings = parent_item->children();
   if (row < 0 || static_cast<size_t>(row) >= siblings.size()) {
     return QModelIndex();
   }
@@ -187,15 +189,8 @@ QModelIndex TopDownViewItemModel::parent(const QModelIndex& index) const {
     return QModelIndex();
   }
 
-  const TopDownNode* parent_item = item->parent();
-  if (parent_item == nullptr) {
-    return createIndex(0, 0, const_cast<TopDownNode*>(item));
-  }
-
-  const std::vector<const TopDownNode*>& siblings = parent_item->children();
-  int row = static_cast<int>(std::distance(
-      siblings.begin(), std::find(siblings.begin(), siblings.end(), item)));
-  return createIndex(row, 0, const_cast<TopDownNode*>(item));
+  return createIndex(static_cast<int>(item->index_in_parent()), 0,
+                     const_cast<TopDownNode*>(item));
 }
 
 int TopDownViewItemModel::rowCount(const QModelIndex& parent) const {
@@ -212,3 +207,20 @@ int TopDownViewItemModel::rowCount(const QModelIndex& parent) const {
 int TopDownViewItemModel::columnCount(const QModelIndex& /*parent*/) const {
   return kColumnCount;
 }
+
+void TopDownViewItemModel::AddCallstackSamples(
+    absl::Span<const CallstackSamples> samples, const std::string& process_name,
+    const std::unordered_map<int32_t, std::string>& thread_names,
+    const std::unordered_map<uint64_t, std::string>& function_names) {
+  if (samples.empty()) {
+    return;
+  }
+  // Existing nodes keep their rows, new ones are only appended to the children
+  // of their parents. Hence the persistent indices, and with them which nodes
+  // the views have expanded or selected, stay valid, as opposed to resetting
+  // the model.
+  emit layoutAboutToBeChanged();
+  top_down_view_->AddCallstackSamples(samples, process_name, thread_names,
+                                      function_names);
+  emit layoutChanged();
+}
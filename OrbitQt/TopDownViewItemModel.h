@@ -9,14 +9,17 @@
 #include <QModelIndex>
 #include <QVariant>
 #include <memory>
+#include <string>
+#include <unordered_map>
 
 #include "TopDownView.h"
+#include "absl/types/span.h"
 
 class TopDownViewItemModel : public QAbstractItemModel {
   Q_OBJECT
 
  public:
-  explicit TopDownViewItemModel(std::unique_ptr<TopDownView> top_down_view,
+  explicit TopDownViewItemModel(std::shared_ptr<TopDownView> top_down_view,
                                 QObject* parent = nullptr);
 
   QVariant data(const QModelIndex& index, int role) const override;
@@ -29,6 +32,13 @@ class TopDownViewItemModel : public QAbstractItemModel {
   int rowCount(const QModelIndex& parent) const override;
   int columnCount(const QModelIndex& parent) const override;
 
+  // Adds the samples to the view, see TopDownView::AddCallstackSamples.
+  void AddCallstackSamples(
+      absl::Span<const CallstackSamples> samples,
+      const std::string& process_name,
+      const std::unordered_map<int32_t, std::string>& thread_names,
+      const std::unordered_map<uint64_t, std::string>& function_names);
+
   enum Columns {
     kThreadOrFunction = 0,
     kInclusive,
@@ -42,7 +52,7 @@ class TopDownViewItemModel : public QAbstractItemModel {
   QVariant GetDisplayRoleData(const QModelIndex& index) const;
   QVariant GetEditRoleData(const QModelIndex& index) const;
 
-  std::unique_ptr<TopDownView> top_down_view_;
+  std::shared_ptr<TopDownView> top_down_view_;
 };
 
 #endif  // ORBIT_QT_TOP_DOWN_VIEW_ITEM_MODEL_H_
@@ -42,6 +42,7 @@ void OrbitDataViewPanel::Initialize(DataView* data_view,
 
   data_view->SetUiFilterCallback(
       [this](const std::string& filter) { SetFilter(filter.c_str()); });
+  data_view->SetUiRefreshCallback([this] { Refresh(); });
 }
 
 OrbitTreeView* OrbitDataViewPanel::GetTreeView() { return ui->treeView; }
@@ -11,11 +11,15 @@
 #include <QOpenGLDebugMessage>
 #include <QSignalMapper>
 
+#include "../OrbitCore/Capture.h"
 #include "../OrbitCore/PrintVar.h"
 #include "../OrbitCore/Utils.h"
 #include "OrbitBase/Logging.h"
+#include "absl/flags/flag.h"
 #include "orbitmainwindow.h"
 
+ABSL_DECLARE_FLAG(uint32_t, max_capture_redraw_rate);
+
 #define ORBIT_DEBUG_OPEN_GL 0
 
 //-----------------------------------------------------------------------------
@@ -41,6 +45,34 @@ bool OrbitGLWidget::eventFilter(QObject* /*object*/, QEvent* event) {
   return false;
 }
 
+//-----------------------------------------------------------------------------
+void OrbitGLWidget::UpdateIfNeeded() {
+  if (m_OrbitPanel == nullptr) {
+    update();
+    return;
+  }
+  if (!isVisible()) {
+    return;
+  }
+
+  m_OrbitPanel->PreRender();
+  if (!m_OrbitPanel->GetNeedsRedraw()) {
+    return;
+  }
+
+  // While capturing, the new events make every tick need a redraw. The
+  // redraws skipped are not lost: the panel still needs a redraw on the next
+  // tick.
+  const uint32_t max_redraw_rate = absl::GetFlag(FLAGS_max_capture_redraw_rate);
+  if (Capture::IsCapturing() && max_redraw_rate > 0 &&
+      last_tick_update_timer_.isValid() &&
+      last_tick_update_timer_.elapsed() < 1000 / max_redraw_rate) {
+    return;
+  }
+  last_tick_update_timer_.start();
+  update();
+}
+
 //-----------------------------------------------------------------------------
 void OrbitGLWidget::Initialize(GlPanel::Type a_Type,
                                OrbitMainWindow* a_MainWindow) {
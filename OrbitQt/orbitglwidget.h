@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <QElapsedTimer>
 #include <QOpenGLFunctions>
 #include <QOpenGLWidget>
 
@@ -23,6 +24,10 @@ class OrbitGLWidget : public QOpenGLWidget, protected QOpenGLFunctions {
   void paintGL() override;
   bool eventFilter(QObject* object, QEvent* event) override;
   void TakeScreenShot();
+  // Called on every tick of the main window: schedules a repaint if the panel
+  // needs to be redrawn, at most --max_capture_redraw_rate times per second
+  // while capturing. Input events repaint right away instead.
+  void UpdateIfNeeded();
   GlPanel* GetPanel() { return m_OrbitPanel; }
   void PrintContextInformation();
 
@@ -44,4 +49,5 @@ class OrbitGLWidget : public QOpenGLWidget, protected QOpenGLFunctions {
  private:
   GlPanel* m_OrbitPanel;
   QOpenGLDebugLogger* m_DebugLogger;
+  QElapsedTimer last_tick_update_timer_;
 };
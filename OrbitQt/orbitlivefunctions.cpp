@@ -17,6 +17,10 @@ OrbitLiveFunctions::OrbitLiveFunctions(QWidget* parent)
       [this](size_t id, FunctionInfo* function) {
         this->AddIterator(id, function);
       });
+  live_functions_.SetSelectFunctionCallback(
+      [this](std::shared_ptr<const FunctionInfo> function) {
+        ui->durationHistogram->SetFunction(std::move(function));
+      });
 
   all_events_iterator_ = new OrbitEventIterator(this);
   all_events_iterator_->SetNextButtonCallback([this]() {
@@ -62,7 +66,11 @@ void OrbitLiveFunctions::SetFilter(const QString& a_Filter) {
 }
 
 //-----------------------------------------------------------------------------
-void OrbitLiveFunctions::Refresh() { ui->data_view_panel_->Refresh(); }
+void OrbitLiveFunctions::Refresh() {
+  ui->data_view_panel_->Refresh();
+  // The histogram of the selected function grows during a capture.
+  ui->durationHistogram->update();
+}
 
 void OrbitLiveFunctions::OnDataChanged() { live_functions_.OnDataChanged(); }
 
@@ -109,6 +117,7 @@ QLineEdit* OrbitLiveFunctions::GetFilterLineEdit() {
 
 void OrbitLiveFunctions::Reset() {
   live_functions_.Reset();
+  ui->durationHistogram->SetFunction(nullptr);
 
   for (auto& [_, iterator_ui] : iterator_uis) {
     ui->iteratorLayout->removeWidget(iterator_ui);
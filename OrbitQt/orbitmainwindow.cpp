@@ -25,6 +25,7 @@
 #include "MainThreadExecutorImpl.h"
 #include "OrbitVersion.h"
 #include "SamplingReport.h"
+#include "ScopeTimer.h"
 #include "TopDownViewItemModel.h"
 #include "absl/flags/flag.h"
 #include "absl/strings/match.h"
@@ -96,8 +97,18 @@ OrbitMainWindow::OrbitMainWindow(
 
   GOrbitApp->SetCaptureStopRequestedCallback([this, finalizing_capture_dialog] {
     ui->actionStop_Capture->setDisabled(true);
+    finalizing_capture_dialog->setLabelText(
+        "Waiting for the remaining capture data...");
+    finalizing_capture_dialog->setRange(0, 0);
     finalizing_capture_dialog->show();
   });
+  GOrbitApp->SetCaptureFinalizationProgressCallback(
+      [finalizing_capture_dialog](const std::string& step, size_t step_index,
+                                  size_t step_count) {
+        finalizing_capture_dialog->setLabelText(QString::fromStdString(step));
+        finalizing_capture_dialog->setRange(0, static_cast<int>(step_count));
+        finalizing_capture_dialog->setValue(static_cast<int>(step_index));
+      });
   GOrbitApp->SetCaptureStoppedCallback([this, finalizing_capture_dialog] {
     finalizing_capture_dialog->close();
     ui->actionStart_Capture->setDisabled(false);
@@ -127,9 +138,48 @@ OrbitMainWindow::OrbitMainWindow(
         this->OnNewSelectionReport(callstack_data_view, std::move(report));
       });
   GOrbitApp->SetTopDownViewCallback(
-      [this](std::unique_ptr<TopDownView> top_down_view) {
+      [this](std::shared_ptr<TopDownView> top_down_view) {
         this->OnNewTopDownView(std::move(top_down_view));
       });
+  GOrbitApp->SetBottomUpViewCallback(
+      [this](std::unique_ptr<BottomUpView> bottom_up_view) {
+        this->OnNewBottomUpView(std::move(bottom_up_view));
+      });
+  GOrbitApp->SetCallstackSamplesCallback(
+      [this](absl::Span<const CallstackSamples> samples,
+             const std::string& process_name,
+             const std::unordered_map<int32_t, std::string>& thread_names,
+             const std::unordered_map<uint64_t, std::string>& function_names) {
+        ui->topDownWidget->AddCallstackSamples(samples, process_name,
+                                               thread_names, function_names);
+        ui->bottomUpWidget->AddCallstackSamples(samples, process_name,
+                                                thread_names, function_names);
+      });
+  GOrbitApp->SetOffCpuTopDownViewCallback(
+      [this](std::shared_ptr<TopDownView> top_down_view) {
+        ui->offCpuWidget->SetTopDownView(std::move(top_down_view));
+      });
+  GOrbitApp->SetOffCpuCallstackSamplesCallback(
+      [this](absl::Span<const CallstackSamples> samples,
+             const std::string& process_name,
+             const std::unordered_map<int32_t, std::string>& thread_names,
+             const std::unordered_map<uint64_t, std::string>& function_names) {
+        ui->offCpuWidget->AddCallstackSamples(samples, process_name,
+                                              thread_names, function_names);
+      });
+  GOrbitApp->SetAllocationTopDownViewCallback(
+      [this](std::shared_ptr<TopDownView> top_down_view) {
+        ui->allocationsWidget->SetTopDownView(std::move(top_down_view));
+      });
+  GOrbitApp->SetAllocationCallstackSamplesCallback(
+      [this](absl::Span<const CallstackSamples> samples,
+             const std::string& process_name,
+             const std::unordered_map<int32_t, std::string>& thread_names,
+             const std::unordered_map<uint64_t, std::string>& function_names) {
+        ui->allocationsWidget->AddCallstackSamples(samples, process_name,
+                                                   thread_names,
+                                                   function_names);
+      });
 
   GOrbitApp->SetOpenCaptureCallback(
       [this] { on_actionOpen_Capture_triggered(); });
@@ -167,6 +217,25 @@ OrbitMainWindow::OrbitMainWindow(
   GOrbitApp->SetClipboardCallback(
       [this](const std::string& text) { this->OnSetClipboard(text); });
 
+  // Only shown when loading takes a while, and closed once all modules of the
+  // batch are loaded. The first module of a batch resets it.
+  auto symbol_loading_dialog = new QProgressDialog(
+      "Loading symbols...", "Cancel", 0, 0, this, Qt::Tool);
+  symbol_loading_dialog->setWindowTitle("Loading symbols");
+  symbol_loading_dialog->reset();
+  QObject::connect(symbol_loading_dialog, &QProgressDialog::canceled,
+                   [] { GOrbitApp->CancelSymbolLoading(); });
+  GOrbitApp->SetSymbolLoadingProgressCallback(
+      [symbol_loading_dialog](size_t loaded_count, size_t module_count) {
+        if (loaded_count == 1) {
+          symbol_loading_dialog->reset();
+        } else if (symbol_loading_dialog->wasCanceled()) {
+          return;
+        }
+        symbol_loading_dialog->setMaximum(static_cast<int>(module_count));
+        symbol_loading_dialog->setValue(static_cast<int>(loaded_count));
+      });
+
   GOrbitApp->SetSecureCopyCallback(
       [service_deploy_manager](std::string_view source,
                                std::string_view destination) {
@@ -178,6 +247,11 @@ OrbitMainWindow::OrbitMainWindow(
 
   ui->DebugGLWidget->Initialize(GlPanel::DEBUG, this);
   ui->CaptureGLWidget->Initialize(GlPanel::CAPTURE, this);
+  ui->FlameGraphGLWidget->Initialize(GlPanel::FLAME_GRAPH, this);
+  connect(ui->flameGraphSearchLineEdit, &QLineEdit::textChanged, this,
+          [](const QString& text) {
+            GOrbitApp->SearchFlameGraph(text.toStdString());
+          });
 
   ui->ModulesList->Initialize(
       data_view_factory->GetOrCreateDataView(DataViewType::MODULES),
@@ -188,6 +262,40 @@ OrbitMainWindow::OrbitMainWindow(
   ui->CallStackView->Initialize(
       data_view_factory->GetOrCreateDataView(DataViewType::CALLSTACK),
       SelectionType::kExtended, FontType::kDefault);
+  connect(ui->RightTabWidget, &QTabWidget::currentChanged, this,
+          [this] { OnTabShown(ui->RightTabWidget->currentWidget()); });
+  // The data views created here catch up with the data they missed.
+  auto create_data_view = [data_view_factory](DataViewType type) {
+    DataView* data_view = data_view_factory->GetOrCreateDataView(type);
+    data_view->OnDataChanged();
+    return data_view;
+  };
+  InitializeTabWhenShown(
+      ui->RightTabWidget, ui->samplingDiffTab, [this, data_view_factory] {
+        // Created by OrbitApp with the first baseline.
+        ui->samplingDiffList->Initialize(
+            data_view_factory->GetOrCreateDataView(DataViewType::SAMPLING_DIFF),
+            SelectionType::kExtended, FontType::kDefault);
+      });
+  InitializeTabWhenShown(
+      ui->RightTabWidget, ui->framesTab, [this, create_data_view] {
+        ui->framesList->Initialize(create_data_view(DataViewType::FRAMES),
+                                   SelectionType::kDefault,
+                                   FontType::kDefault);
+      });
+  InitializeTabWhenShown(
+      ui->RightTabWidget, ui->locksTab, [this, create_data_view] {
+        ui->locksList->Initialize(create_data_view(DataViewType::LOCKS),
+                                  SelectionType::kDefault, FontType::kDefault);
+      });
+  InitializeTabWhenShown(
+      ui->RightTabWidget, ui->queryTab, [this, create_data_view] {
+        ui->queryList->Initialize(create_data_view(DataViewType::QUERY),
+                                  SelectionType::kDefault, FontType::kDefault);
+        ui->queryList->GetFilterLineEdit()->setPlaceholderText(
+            "query, e.g., function=Foo from=1s to=2s group=caller "
+            "buckets=50");
+      });
   ui->SessionList->Initialize(
       data_view_factory->GetOrCreateDataView(DataViewType::PRESETS),
       SelectionType::kDefault, FontType::kDefault);
@@ -319,6 +427,19 @@ void OrbitMainWindow::SetupCaptureToolbar() {
   connect(filter_functions_line_edit_, &QLineEdit::textChanged, this,
           [this](const QString& text) { OnFilterFunctionsTextChanged(text); });
 
+  // Search timers. Enter selects the next match.
+  toolbar->addWidget(CreateSpacer(toolbar));
+  toolbar->addAction(CreateDummyAction(icon_search, toolbar));
+  search_timers_line_edit_ = new QLineEdit(toolbar);
+  search_timers_line_edit_->setClearButtonEnabled(true);
+  search_timers_line_edit_->setPlaceholderText("search timers");
+  SetFontSize(search_timers_line_edit_, kFontSize);
+  toolbar->addWidget(search_timers_line_edit_);
+  connect(search_timers_line_edit_, &QLineEdit::textChanged, this,
+          [this](const QString& text) { OnSearchTimersTextChanged(text); });
+  connect(search_timers_line_edit_, &QLineEdit::returnPressed, this,
+          [] { GOrbitApp->JumpToNextTimerSearchMatch(); });
+
   // Timer.
   toolbar->addWidget(CreateSpacer(toolbar));
   toolbar->addAction(CreateDummyAction(icon_timer, toolbar));
@@ -405,6 +526,30 @@ void OrbitMainWindow::ParseCommandlineArguments() {
 //-----------------------------------------------------------------------------
 void OrbitMainWindow::PostInit() {}
 
+//-----------------------------------------------------------------------------
+void OrbitMainWindow::InitializeTabWhenShown(QTabWidget* tab_widget,
+                                             QWidget* tab,
+                                             std::function<void()> initialize) {
+  if (tab_widget->currentWidget() == tab) {
+    initialize();
+    return;
+  }
+  tab_initializers_.emplace(tab, std::move(initialize));
+}
+
+//-----------------------------------------------------------------------------
+void OrbitMainWindow::OnTabShown(QWidget* tab) {
+  auto initializer_it = tab_initializers_.find(tab);
+  if (initializer_it == tab_initializers_.end()) {
+    return;
+  }
+  std::function<void()> initialize = std::move(initializer_it->second);
+  tab_initializers_.erase(initializer_it);
+  SCOPE_TIMER_LOG(absl::StrFormat("Initializing the \"%s\" tab",
+                                  tab->objectName().toStdString()));
+  initialize();
+}
+
 //-----------------------------------------------------------------------------
 bool OrbitMainWindow::HideTab(QTabWidget* a_TabWidget, const char* a_TabName) {
   QTabWidget* tab = a_TabWidget;
@@ -474,6 +619,26 @@ void OrbitMainWindow::UpdatePanel(DataViewType a_Type) {
       ui->selectionReport->RefreshCallstackView();
       ui->selectionReport->RefreshTabs();
       break;
+    case DataViewType::SAMPLING_DIFF:
+      if (IsTabInitialized(ui->samplingDiffTab)) {
+        ui->samplingDiffList->Refresh();
+      }
+      break;
+    case DataViewType::FRAMES:
+      if (IsTabInitialized(ui->framesTab)) {
+        ui->framesList->Refresh();
+      }
+      break;
+    case DataViewType::LOCKS:
+      if (IsTabInitialized(ui->locksTab)) {
+        ui->locksList->Refresh();
+      }
+      break;
+    case DataViewType::QUERY:
+      if (IsTabInitialized(ui->queryTab)) {
+        ui->queryList->Refresh();
+      }
+      break;
     default:
       break;
   }
@@ -513,10 +678,15 @@ void OrbitMainWindow::OnNewSelectionReport(
 }
 
 void OrbitMainWindow::OnNewTopDownView(
-    std::unique_ptr<TopDownView> top_down_view) {
+    std::shared_ptr<TopDownView> top_down_view) {
   ui->topDownWidget->SetTopDownView(std::move(top_down_view));
 }
 
+void OrbitMainWindow::OnNewBottomUpView(
+    std::unique_ptr<BottomUpView> bottom_up_view) {
+  ui->bottomUpWidget->SetTopDownView(std::move(bottom_up_view));
+}
+
 //-----------------------------------------------------------------------------
 std::string OrbitMainWindow::OnGetSaveFileName(const std::string& extension) {
   std::string filename =
@@ -586,7 +756,7 @@ void OrbitMainWindow::OnTimer() {
   OrbitApp::MainTick();
 
   for (OrbitGLWidget* glWidget : m_GlWidgets) {
-    glWidget->update();
+    glWidget->UpdateIfNeeded();
   }
 
   // Output window
@@ -619,6 +789,11 @@ void OrbitMainWindow::OnFilterTracksTextChanged(const QString& text) {
   GOrbitApp->FilterTracks(text.toStdString());
 }
 
+//-----------------------------------------------------------------------------
+void OrbitMainWindow::OnSearchTimersTextChanged(const QString& text) {
+  GOrbitApp->SearchTimers(text.toStdString());
+}
+
 //-----------------------------------------------------------------------------
 void OrbitMainWindow::on_actionOpen_Preset_triggered() {
   QStringList list = QFileDialog::getOpenFileNames(
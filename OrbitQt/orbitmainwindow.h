@@ -11,13 +11,16 @@
 #include <QLineEdit>
 #include <QMainWindow>
 #include <QString>
+#include <QTabWidget>
 #include <QTimer>
+#include <functional>
 #include <memory>
 #include <outcome.hpp>
 #include <string>
 #include <vector>
 
 #include "ApplicationOptions.h"
+#include "absl/container/flat_hash_map.h"
 #include "CallStackDataView.h"
 #include "TopDownView.h"
 #include "servicedeploymanager.h"
@@ -45,7 +48,8 @@ class OrbitMainWindow : public QMainWindow {
   void OnNewSelectionReport(
       DataView* callstack_data_view,
       std::shared_ptr<class SamplingReport> sampling_report);
-  void OnNewTopDownView(std::unique_ptr<TopDownView> top_down_view);
+  void OnNewTopDownView(std::shared_ptr<TopDownView> top_down_view);
+  void OnNewBottomUpView(std::unique_ptr<BottomUpView> bottom_up_view);
   std::string OnGetSaveFileName(const std::string& extension);
   void OnSetClipboard(const std::string& text);
   void ParseCommandlineArguments();
@@ -69,6 +73,7 @@ class OrbitMainWindow : public QMainWindow {
   void OnLiveTabFunctionsFilterTextChanged(const QString& text);
   void OnFilterFunctionsTextChanged(const QString& text);
   void OnFilterTracksTextChanged(const QString& text);
+  void OnSearchTimersTextChanged(const QString& text);
 
   void on_actionOpen_Preset_triggered();
   void on_actionQuit_triggered();
@@ -97,17 +102,28 @@ class OrbitMainWindow : public QMainWindow {
   void SetupCaptureToolbar();
   void SetupCodeView();
   void ShowFeedbackDialog();
+  // Runs initialize the first time tab is shown, or right away if it is the
+  // current tab: the panels of the tabs that are not shown at startup, and
+  // their data views, are only created when they are needed.
+  void InitializeTabWhenShown(QTabWidget* tab_widget, QWidget* tab,
+                              std::function<void()> initialize);
+  void OnTabShown(QWidget* tab);
+  [[nodiscard]] bool IsTabInitialized(QWidget* tab) const {
+    return !tab_initializers_.contains(tab);
+  }
 
  private:
   QApplication* m_App;
   Ui::OrbitMainWindow* ui;
   QTimer* m_MainTimer;
   std::vector<OrbitGLWidget*> m_GlWidgets;
+  absl::flat_hash_map<QWidget*, std::function<void()>> tab_initializers_;
 
   // Capture toolbar.
   QLabel* timer_label_ = nullptr;
   QLineEdit* filter_functions_line_edit_ = nullptr;
   QLineEdit* filter_tracks_line_edit_ = nullptr;
+  QLineEdit* search_timers_line_edit_ = nullptr;
 
   class OutputDialog* m_OutputDialog;
   std::string m_CurrentPdbName;
@@ -44,44 +44,68 @@ void OrbitSamplingReport::Initialize(DataView* callstack_data_view,
 
   m_SamplingReport->SetUiRefreshFunc([&]() { this->RefreshCallstackView(); });
 
+  // Only the panel of the tab shown is created, the others, and the reports
+  // of their threads, when their tab is first shown: processes can have
+  // thousands of threads.
   for (SamplingReportDataView& report_data_view : report->GetThreadReports()) {
     QWidget* tab = new QWidget();
     tab->setObjectName(QStringLiteral("tab"));
 
     QGridLayout* gridLayout_2 = new QGridLayout(tab);
     gridLayout_2->setObjectName(QStringLiteral("gridLayout_2"));
-    OrbitDataViewPanel* treeView = new OrbitDataViewPanel(tab);
-    treeView->SetDataModel(&report_data_view);
-
-    if (!report_data_view.IsSortingAllowed()) {
-      treeView->GetTreeView()->setSortingEnabled(false);
-    } else {
-      int column = report_data_view.GetDefaultSortingColumn();
-      Qt::SortOrder order =
-          report_data_view.GetColumns()[column].initial_order ==
-                  DataView::SortingOrder::Ascending
-              ? Qt::AscendingOrder
-              : Qt::DescendingOrder;
-      treeView->GetTreeView()->sortByColumn(column, order);
-    }
+    m_OrbitDataViews.push_back(nullptr);
 
-    treeView->setObjectName(QStringLiteral("treeView"));
-    gridLayout_2->addWidget(treeView, 0, 0, 1, 1);
-    treeView->GetTreeView()->setSelectionMode(OrbitTreeView::ExtendedSelection);
-    treeView->GetTreeView()->header()->resizeSections(
-        QHeaderView::ResizeToContents);
-    treeView->GetTreeView()->setAlternatingRowColors(true);
+    QString threadName = QString::fromStdString(report_data_view.GetName());
+    ui->tabWidget->addTab(tab, threadName);
+  }
 
-    treeView->Link(ui->CallstackTreeView);
+  connect(ui->tabWidget, &QTabWidget::currentChanged, this,
+          &OrbitSamplingReport::OnCurrentTabChanged);
+  OnCurrentTabChanged(ui->tabWidget->currentIndex());
+}
 
-    // This is hack - it is needed to update ui when data changes
-    // TODO: Remove this once model is implemented properly and there
-    // is no need in manual updates.
-    m_OrbitDataViews.push_back(treeView);
+//-----------------------------------------------------------------------------
+void OrbitSamplingReport::OnCurrentTabChanged(int index) {
+  if (index < 0 || static_cast<size_t>(index) >= m_OrbitDataViews.size() ||
+      m_OrbitDataViews[index] != nullptr) {
+    return;
+  }
 
-    QString threadName = QString::fromStdString(report_data_view.GetName());
-    ui->tabWidget->addTab(tab, threadName);
+  if (!m_SamplingReport->IsThreadReportFilled(index)) {
+    m_SamplingReport->FillThreadReport(index);
   }
+  SamplingReportDataView& report_data_view =
+      m_SamplingReport->GetThreadReports()[index];
+
+  QWidget* tab = ui->tabWidget->widget(index);
+  OrbitDataViewPanel* treeView = new OrbitDataViewPanel(tab);
+  treeView->SetDataModel(&report_data_view);
+
+  if (!report_data_view.IsSortingAllowed()) {
+    treeView->GetTreeView()->setSortingEnabled(false);
+  } else {
+    int column = report_data_view.GetDefaultSortingColumn();
+    Qt::SortOrder order =
+        report_data_view.GetColumns()[column].initial_order ==
+                DataView::SortingOrder::Ascending
+            ? Qt::AscendingOrder
+            : Qt::DescendingOrder;
+    treeView->GetTreeView()->sortByColumn(column, order);
+  }
+
+  treeView->setObjectName(QStringLiteral("treeView"));
+  static_cast<QGridLayout*>(tab->layout())->addWidget(treeView, 0, 0, 1, 1);
+  treeView->GetTreeView()->setSelectionMode(OrbitTreeView::ExtendedSelection);
+  treeView->GetTreeView()->header()->resizeSections(
+      QHeaderView::ResizeToContents);
+  treeView->GetTreeView()->setAlternatingRowColors(true);
+
+  treeView->Link(ui->CallstackTreeView);
+
+  // This is hack - it is needed to update ui when data changes
+  // TODO: Remove this once model is implemented properly and there
+  // is no need in manual updates.
+  m_OrbitDataViews[index] = treeView;
 }
 
 //-----------------------------------------------------------------------------
@@ -118,6 +142,8 @@ void OrbitSamplingReport::RefreshTabs() {
   }
 
   for (OrbitDataViewPanel* panel : m_OrbitDataViews) {
-    panel->Refresh();
+    if (panel != nullptr) {
+      panel->Refresh();
+    }
   }
 }
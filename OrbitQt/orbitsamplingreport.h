@@ -30,9 +30,11 @@ class OrbitSamplingReport : public QWidget {
  private slots:
   void on_NextCallstackButton_clicked();
   void on_PreviousCallstackButton_clicked();
+  void OnCurrentTabChanged(int index);
 
  private:
   Ui::OrbitSamplingReport* ui;
   std::shared_ptr<SamplingReport> m_SamplingReport;
+  // By tab, nullptr for the tabs not shown yet.
   std::vector<OrbitDataViewPanel*> m_OrbitDataViews;
 };
@@ -6,6 +6,7 @@
 
 #include <QColor>
 #include <memory>
+#include <variant>
 
 //-----------------------------------------------------------------------------
 OrbitTableModel::OrbitTableModel(DataView* data_view, QObject* parent)
@@ -59,8 +60,22 @@ QVariant OrbitTableModel::headerData(int section, Qt::Orientation orientation,
 //-----------------------------------------------------------------------------
 QVariant OrbitTableModel::data(const QModelIndex& index, int role) const {
   if (role == Qt::DisplayRole) {
-    std::string value = m_DataView->GetValue(index.row(), index.column());
-    return QVariant(QString::fromStdString(value));
+    const std::vector<QString>& values = GetRowValues(index.row());
+    if (index.column() < static_cast<int>(values.size())) {
+      return values[index.column()];
+    }
+  } else if (role == kNumericRole) {
+    DataView::NumericValue value =
+        m_DataView->GetNumericValue(index.row(), index.column());
+    if (const uint64_t* unsigned_value = std::get_if<uint64_t>(&value)) {
+      return QVariant::fromValue<quint64>(*unsigned_value);
+    }
+    if (const int64_t* signed_value = std::get_if<int64_t>(&value)) {
+      return QVariant::fromValue<qint64>(*signed_value);
+    }
+    if (const double* double_value = std::get_if<double>(&value)) {
+      return *double_value;
+    }
   } else if (role == Qt::ForegroundRole) {
     if (m_DataView->WantsDisplayColor()) {
       unsigned char r, g, b;
@@ -76,6 +91,25 @@ QVariant OrbitTableModel::data(const QModelIndex& index, int role) const {
   return QVariant();
 }
 
+//-----------------------------------------------------------------------------
+const std::vector<QString>& OrbitTableModel::GetRowValues(int row) const {
+  if (m_DataView->GetUpdateCount() != row_values_update_count_ ||
+      row_values_.size() >= kMaxCachedRowCount) {
+    row_values_.clear();
+    row_values_update_count_ = m_DataView->GetUpdateCount();
+  }
+  auto [it, inserted] = row_values_.try_emplace(row);
+  if (inserted) {
+    const int column_count = columnCount();
+    it->second.reserve(column_count);
+    for (int column = 0; column < column_count; ++column) {
+      it->second.push_back(
+          QString::fromStdString(m_DataView->GetValue(row, column)));
+    }
+  }
+  return it->second;
+}
+
 //-----------------------------------------------------------------------------
 void OrbitTableModel::sort(int column, Qt::SortOrder order) {
   // On Linux, the arrows for ascending/descending are reversed, e.g. ascending
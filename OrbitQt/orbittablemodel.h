@@ -5,15 +5,22 @@
 #pragma once
 
 #include <QAbstractTableModel>
+#include <QString>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "DataView.h"
+#include "absl/container/flat_hash_map.h"
 
 //-----------------------------------------------------------------------------
 class OrbitTableModel : public QAbstractTableModel {
   Q_OBJECT
  public:
+  // The role of the value of a cell as a number, for the columns of which
+  // DataView::GetNumericValue returns one, as a quint64, qint64 or double.
+  static constexpr int kNumericRole = Qt::UserRole;
+
   explicit OrbitTableModel(DataView* data_view, QObject* parent = nullptr);
   explicit OrbitTableModel(QObject* parent = nullptr);
   ~OrbitTableModel() override;
@@ -32,14 +39,30 @@ class OrbitTableModel : public QAbstractTableModel {
     return createIndex(a_Row, a_Column);
   }
   DataView* GetDataView() { return m_DataView; }
-  void SetDataView(DataView* model) { m_DataView = model; }
+  void SetDataView(DataView* model) {
+    m_DataView = model;
+    ClearCache();
+  }
   bool IsSortingAllowed() { return GetDataView()->IsSortingAllowed(); }
   std::pair<int, Qt::SortOrder> GetDefaultSortingColumnAndOrder();
 
   void OnTimer();
   void OnFilter(const QString& a_Filter);
   void OnRowSelected(int row);
+  // For when values change without the update count of the view changing,
+  // e.g., after a function was hooked from the context menu.
+  void ClearCache() { row_values_.clear(); }
 
  protected:
   DataView* m_DataView;
+
+ private:
+  [[nodiscard]] const std::vector<QString>& GetRowValues(int row) const;
+
+  // The values of the rows that were shown since the last update of the view,
+  // so that each row is only formatted once rather than for each paint, e.g.,
+  // while scrolling. Only as many rows are kept as a few screens hold.
+  static constexpr size_t kMaxCachedRowCount = 1024;
+  mutable absl::flat_hash_map<int, std::vector<QString>> row_values_;
+  mutable uint64_t row_values_update_count_ = 0;
 };
@@ -110,6 +110,7 @@ void OrbitTreeView::OnTimer() {
 
 void OrbitTreeView::Refresh() {
   QModelIndexList list = selectionModel()->selectedIndexes();
+  model_->ClearCache();
 
   if (model_->GetDataView()->GetType() == DataViewType::LIVE_FUNCTIONS) {
     model_->layoutAboutToBeChanged();
@@ -212,6 +213,8 @@ void OrbitTreeView::OnMenuClicked(const std::string& a_Action,
   std::vector<int> indices(selection_set.begin(), selection_set.end());
   if (!indices.empty()) {
     model_->GetDataView()->OnContextMenu(a_Action, a_MenuIndex, indices);
+    model_->ClearCache();
+    viewport()->update();
   }
 }
 
@@ -9,11 +9,17 @@
 #include <absl/strings/str_cat.h>
 #include <absl/strings/str_format.h>
 #include <absl/strings/str_split.h>
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
 
 #include <QApplication>
+#include <QCryptographicHash>
 #include <QDir>
 #include <QEventLoop>
+#include <QFile>
 #include <chrono>
+#include <filesystem>
+#include <optional>
 #include <system_error>
 #include <thread>
 
@@ -25,12 +31,14 @@
 #include "OrbitSshQt/Task.h"
 
 ABSL_DECLARE_FLAG(bool, devmode);
+ABSL_DECLARE_FLAG(bool, bulk_grpc_tunnel);
 
 static const std::string kLocalhost = "127.0.0.1";
 static const std::string kDebDestinationPath = "/tmp/orbitprofiler.deb";
 static const std::string kSigDestinationPath = "/tmp/orbitprofiler.deb.asc";
 static const std::string_view kSshWatchdogPassphrase = "start_watchdog";
 static const std::chrono::milliseconds kSshWatchdogInterval(1000);
+static const absl::Duration kCopyProgressInterval = absl::Seconds(1);
 
 namespace OrbitQt {
 
@@ -46,6 +54,28 @@ void PrintAsOrbitService(const std::string& buffer) {
   }
 };
 
+double ToMebibytes(uint64_t bytes) {
+  return static_cast<double>(bytes) / (1024 * 1024);
+}
+
+double GetMebibytesPerSecond(uint64_t bytes, absl::Duration duration) {
+  const double seconds = absl::ToDoubleSeconds(duration);
+  return seconds > 0 ? ToMebibytes(bytes) / seconds : 0;
+}
+
+// The SHA-256 of the file at path as hex digits, as printed by sha256sum.
+std::optional<std::string> ComputeLocalSha256(const std::string& path) {
+  QFile file{QString::fromStdString(path)};
+  if (!file.open(QIODevice::ReadOnly)) {
+    return std::nullopt;
+  }
+  QCryptographicHash hash{QCryptographicHash::Sha256};
+  if (!hash.addData(&file)) {
+    return std::nullopt;
+  }
+  return hash.result().toHex().toStdString();
+}
+
 }  // namespace
 
 template <typename T>
@@ -116,7 +146,7 @@ outcome::result<bool> ServiceDeployManager::CheckIfInstalled() {
 outcome::result<uint16_t> ServiceDeployManager::StartTunnel(
     std::optional<OrbitSshQt::Tunnel>* tunnel, uint16_t port) {
   emit statusMessage("Setting up port forwarding...");
-  LOG("Setting up tunnel on port %d", grpc_port_.grpc_port);
+  LOG("Setting up tunnel on port %d", port);
 
   tunnel->emplace(&session_.value(), kLocalhost, port);
 
@@ -151,9 +181,54 @@ ServiceDeployManager::StartSftpChannel(EventLoop* loop) {
   return sftp_channel;
 }
 
+outcome::result<bool> ServiceDeployManager::IsRemoteFileUpToDate(
+    const std::string& source, const std::string& dest) {
+  const std::optional<std::string> local_hash = ComputeLocalSha256(source);
+  if (!local_hash.has_value()) {
+    return outcome::success(false);
+  }
+
+  // Files of other users are copied over as before, as they could change
+  // between the check and their use.
+  const std::string command =
+      absl::StrFormat("test -O %1$s && sha256sum %1$s 2>/dev/null", dest);
+  OrbitSshQt::Task hash_task{&session_.value(), command};
+  std::string output;
+  QObject::connect(&hash_task, &OrbitSshQt::Task::readyReadStdOut, this,
+                   [&]() { output += hash_task.ReadStdOut(); });
+  QObject::connect(&hash_task, &OrbitSshQt::Task::finished, &loop_,
+                   &EventLoop::exit);
+
+  auto error_handler =
+      ConnectErrorHandler(&hash_task, &OrbitSshQt::Task::errorOccurred);
+
+  hash_task.Start();
+
+  OUTCOME_TRY(result, loop_.exec());
+  output += hash_task.ReadStdOut();
+  if (result != 0) {
+    // The file doesn't exist yet, isn't ours, or sha256sum isn't available.
+    return outcome::success(false);
+  }
+  const std::string_view remote_hash =
+      std::vector<std::string_view>(absl::StrSplit(output, ' ')).front();
+  return outcome::success(remote_hash == local_hash.value());
+}
+
 outcome::result<void> ServiceDeployManager::CopyFileToRemote(
     const std::string& source, const std::string& dest,
     OrbitSshQt::SftpCopyToRemoteOperation::FileMode dest_mode) {
+  // Deploying the same build again to an instance reuses the files of the
+  // previous copy, the hashes only cost a round trip.
+  OUTCOME_TRY(is_up_to_date, IsRemoteFileUpToDate(source, dest));
+  if (is_up_to_date) {
+    const std::string message =
+        absl::StrFormat("%s is up to date, skipping the copy.", dest);
+    LOG("%s", message);
+    emit statusMessage(QString::fromStdString(message));
+    return outcome::success();
+  }
+
   OrbitSshQt::SftpCopyToRemoteOperation operation{&session_.value(),
                                                   sftp_channel_.get()};
 
@@ -163,10 +238,39 @@ outcome::result<void> ServiceDeployManager::CopyFileToRemote(
   auto error_handler = ConnectErrorHandler(
       &operation, &OrbitSshQt::SftpCopyToRemoteOperation::errorOccurred);
 
+  // The progress is shown at most once per kCopyProgressInterval, with the
+  // throughput of the copy so far.
+  std::error_code file_size_error;
+  const uint64_t file_size =
+      std::filesystem::file_size(source, file_size_error);
+  const absl::Time start_time = absl::Now();
+  absl::Time last_progress_time = start_time;
+  QObject::connect(
+      &operation, &OrbitSshQt::SftpCopyToRemoteOperation::progress, this,
+      [&](uint64_t bytes_transferred) {
+        const absl::Time now = absl::Now();
+        if (now - last_progress_time < kCopyProgressInterval) return;
+        last_progress_time = now;
+        emit statusMessage(QString::fromStdString(absl::StrFormat(
+            "Copying %s: %.1f of %.1f MiB (%.1f MiB/s)...", dest,
+            ToMebibytes(bytes_transferred),
+            ToMebibytes(file_size_error ? 0 : file_size),
+            GetMebibytesPerSecond(bytes_transferred, now - start_time))));
+      });
+
   LOG("About to start copying from %s to %s...", source, dest);
   operation.CopyFileToRemote(source, dest, dest_mode);
 
   OUTCOME_TRY(loop_.exec());
+  if (!file_size_error) {
+    const absl::Duration duration = absl::Now() - start_time;
+    const std::string message = absl::StrFormat(
+        "Copied %s (%.1f MiB) in %.1f s (%.1f MiB/s).", dest,
+        ToMebibytes(file_size), absl::ToDoubleSeconds(duration),
+        GetMebibytesPerSecond(file_size, duration));
+    LOG("%s", message);
+    emit statusMessage(QString::fromStdString(message));
+  }
   return outcome::success();
 }
 
@@ -233,6 +337,14 @@ ErrorMessageOr<void> ServiceDeployManager::CopyFileToLocal(
   auto error_handler = ConnectErrorHandler(
       &loop, &operation, &OrbitSshQt::SftpCopyToLocalOperation::errorOccurred);
 
+  uint64_t bytes_copied = 0;
+  QObject::connect(&operation,
+                   &OrbitSshQt::SftpCopyToLocalOperation::progress, this,
+                   [&](uint64_t bytes_transferred) {
+                     bytes_copied = bytes_transferred;
+                   });
+
+  const absl::Time start_time = absl::Now();
   operation.CopyFileToLocal(source, destination);
 
   auto result = loop.exec();
@@ -241,6 +353,10 @@ ErrorMessageOr<void> ServiceDeployManager::CopyFileToLocal(
         absl::StrFormat(R"(Error copying remote "%s" to "%s": %s)", source,
                         destination, result.error().message()));
   }
+  const absl::Duration duration = absl::Now() - start_time;
+  LOG("Copied %.1f MiB in %.1f s (%.1f MiB/s)", ToMebibytes(bytes_copied),
+      absl::ToDoubleSeconds(duration),
+      GetMebibytesPerSecond(bytes_copied, duration));
 
   auto sftp_channel_stop_result =
       StopSftpChannel(&loop, sftp_channel.value().get());
@@ -458,11 +574,21 @@ outcome::result<ServiceDeployManager::GrpcPort> ServiceDeployManager::Exec() {
 
   OUTCOME_TRY(local_grpc_port,
               StartTunnel(&grpc_tunnel_, grpc_port_.grpc_port));
+  LOG("Local port for gRPC is %d", local_grpc_port);
+
+  // A second tunnel is a second SSH channel, with its own window, and a
+  // second TCP connection to the service.
+  uint16_t local_bulk_grpc_port = 0;
+  if (absl::GetFlag(FLAGS_bulk_grpc_tunnel)) {
+    OUTCOME_TRY(local_bulk_port,
+                StartTunnel(&bulk_grpc_tunnel_, grpc_port_.grpc_port));
+    local_bulk_grpc_port = local_bulk_port;
+    LOG("Local port for bulk gRPC transfers is %d", local_bulk_grpc_port);
+  }
 
   emit statusMessage("Successfully set up port forwarding!");
 
-  LOG("Local port for gRPC is %d", local_grpc_port);
-  return outcome::success(GrpcPort{local_grpc_port});
+  return outcome::success(GrpcPort{local_grpc_port, local_bulk_grpc_port});
 }
 
 void ServiceDeployManager::handleSocketError(std::error_code e) {
@@ -521,6 +647,7 @@ void ServiceDeployManager::ShutdownSession() {
 
 void ServiceDeployManager::Shutdown() {
   StopSftpChannel();
+  ShutdownTunnel(&bulk_grpc_tunnel_);
   ShutdownTunnel(&grpc_tunnel_);
   ShutdownOrbitService();
   ShutdownSession();
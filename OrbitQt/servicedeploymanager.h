@@ -28,6 +28,10 @@ class ServiceDeployManager : public QObject {
  public:
   struct GrpcPort {
     uint16_t grpc_port;
+    // The local port of the tunnel for the capture stream and other large
+    // transfers, when they get their own, 0 otherwise. The remote port is
+    // always grpc_port.
+    uint16_t bulk_grpc_port = 0;
   };
 
   explicit ServiceDeployManager(
@@ -58,6 +62,7 @@ class ServiceDeployManager : public QObject {
   std::optional<OrbitSshQt::Session> session_;
   std::optional<OrbitSshQt::Task> orbit_service_task_;
   std::optional<OrbitSshQt::Tunnel> grpc_tunnel_;
+  std::optional<OrbitSshQt::Tunnel> bulk_grpc_tunnel_;
   std::unique_ptr<OrbitSshQt::SftpChannel> sftp_channel_;
   QTimer ssh_watchdog_timer_;
 
@@ -74,6 +79,11 @@ class ServiceDeployManager : public QObject {
       EventLoop* loop);
   outcome::result<void> StopSftpChannel(EventLoop* loop,
                                         OrbitSshQt::SftpChannel* sftp_channel);
+  // Whether dest on the remote instance has the same SHA-256 as the local
+  // source. False as well if either file can't be hashed.
+  outcome::result<bool> IsRemoteFileUpToDate(const std::string& source,
+                                             const std::string& dest);
+  // Copies source to dest, unless dest is already up to date.
   outcome::result<void> CopyFileToRemote(
       const std::string& source, const std::string& dest,
       OrbitSshQt::SftpCopyToRemoteOperation::FileMode dest_mode);
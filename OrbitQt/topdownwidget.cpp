@@ -9,11 +9,11 @@
 
 #include "TopDownViewItemModel.h"
 
-void TopDownWidget::SetTopDownView(std::unique_ptr<TopDownView> top_down_view) {
-  auto* model =
+void TopDownWidget::SetTopDownView(std::shared_ptr<TopDownView> top_down_view) {
+  model_ =
       new TopDownViewItemModel{std::move(top_down_view), ui_->topDownTreeView};
   auto* proxy_model = new QSortFilterProxyModel{ui_->topDownTreeView};
-  proxy_model->setSourceModel(model);
+  proxy_model->setSourceModel(model_);
   proxy_model->setSortRole(Qt::EditRole);
   ui_->topDownTreeView->setModel(proxy_model);
   ui_->topDownTreeView->sortByColumn(TopDownViewItemModel::kInclusive,
@@ -21,6 +21,17 @@ void TopDownWidget::SetTopDownView(std::unique_ptr<TopDownView> top_down_view) {
   ui_->topDownTreeView->header()->resizeSections(QHeaderView::ResizeToContents);
 }
 
+void TopDownWidget::AddCallstackSamples(
+    absl::Span<const CallstackSamples> samples, const std::string& process_name,
+    const std::unordered_map<int32_t, std::string>& thread_names,
+    const std::unordered_map<uint64_t, std::string>& function_names) {
+  if (model_ == nullptr) {
+    return;
+  }
+  model_->AddCallstackSamples(samples, process_name, thread_names,
+                              function_names);
+}
+
 const QString TopDownWidget::kActionExpandRecursively =
     QStringLiteral("&Expand recursively");
 const QString TopDownWidget::kActionCollapseRecursively =
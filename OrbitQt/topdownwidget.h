@@ -8,8 +8,12 @@
 #include <QString>
 #include <QWidget>
 #include <memory>
+#include <string>
+#include <unordered_map>
 
 #include "TopDownView.h"
+#include "TopDownViewItemModel.h"
+#include "absl/types/span.h"
 #include "ui_topdownwidget.h"
 
 class TopDownWidget : public QWidget {
@@ -23,7 +27,13 @@ class TopDownWidget : public QWidget {
             &TopDownWidget::onCustomContextMenuRequested);
   }
 
-  void SetTopDownView(std::unique_ptr<TopDownView> top_down_view);
+  void SetTopDownView(std::shared_ptr<TopDownView> top_down_view);
+  // Adds the samples to the view last set, keeping the expanded nodes.
+  void AddCallstackSamples(
+      absl::Span<const CallstackSamples> samples,
+      const std::string& process_name,
+      const std::unordered_map<int32_t, std::string>& thread_names,
+      const std::unordered_map<uint64_t, std::string>& function_names);
 
  private slots:
   void onCustomContextMenuRequested(const QPoint& point);
@@ -36,6 +46,7 @@ class TopDownWidget : public QWidget {
   static const QString kActionCollapseAll;
 
   std::unique_ptr<Ui::TopDownWidget> ui_;
+  TopDownViewItemModel* model_ = nullptr;
 };
 
 #endif  // ORBIT_QT_TOP_DOWN_WIDGET_H_
@@ -5,28 +5,372 @@
 #include "CaptureServiceImpl.h"
 
 #include <OrbitBase/Logging.h>
+#include <absl/container/flat_hash_set.h>
+#include <absl/flags/flag.h>
 
-#include "LinuxTracingGrpcHandler.h"
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
 
-grpc::Status CaptureServiceImpl::Capture(
-    grpc::ServerContext*,
-    grpc::ServerReaderWriter<CaptureResponse, CaptureRequest>* reader_writer) {
-  pthread_setname_np(pthread_self(), "CSImpl::Capture");
-  LinuxTracingGrpcHandler tracing_handler{reader_writer};
+#include "LinuxUtils.h"
 
-  CaptureRequest request;
-  reader_writer->Read(&request);
-  LOG("Read CaptureRequest from Capture's gRPC stream: starting capture");
-  tracing_handler.Start(std::move(*request.mutable_capture_options()));
+ABSL_DECLARE_FLAG(bool, pin_service_threads);
+ABSL_DECLARE_FLAG(std::string, service_cpus);
+ABSL_DECLARE_FLAG(double, max_cpu_usage);
+ABSL_DECLARE_FLAG(std::string, record_perf_events);
 
-  // The client asks for the capture to be stopped by calling WritesDone.
-  // At that point, this call to Read will return false.
-  // In the meantime, it blocks if no message is received.
-  while (reader_writer->Read(&request)) {
+CaptureServiceImpl::~CaptureServiceImpl() {
+  absl::MutexLock lock{&flight_recorder_mutex_};
+  if (flight_recorder_handler_ != nullptr) {
+    flight_recorder_handler_->Stop();
   }
-  LOG("Client finished writing on Capture's gRPC stream: stopping capture");
-  tracing_handler.Stop();
+}
+
+// The state of one Capture call, driven by the completions of the operations
+// on its stream. The callback of each operation runs on the thread of the
+// completion queue, and schedules anything that blocks on the thread pool of
+// the service. There is at most one read and one write in flight.
+class CaptureServiceImpl::CaptureCall {
+ public:
+  CaptureCall(CaptureServiceImpl* service,
+              grpc::ServerCompletionQueue* completion_queue)
+      : service_{service}, completion_queue_{completion_queue} {
+    request_tag_.callback = [this](bool ok) { OnRequested(ok); };
+    finish_tag_.callback = [this](bool /*ok*/) {
+      service_->OnCaptureCallFinished();
+      delete this;
+    };
+    write_tag_.callback = [this](bool ok) { writer_.OnWriteDone(ok); };
+    service_->RequestCapture(&context_, &stream_, completion_queue_,
+                             completion_queue_, &request_tag_);
+  }
+
+  // What is given to the completion queue with each operation.
+  struct Tag {
+    std::function<void(bool ok)> callback;
+  };
+
+ private:
+  // Waits for each write to complete, as LinuxTracingGrpcHandler adjusts
+  // the size of its responses to how long the writes take.
+  class BlockingWriter : public CaptureResponseWriter {
+   public:
+    explicit BlockingWriter(CaptureCall* call) : call_{call} {}
+
+    bool Write(const CaptureResponse& response,
+               grpc::WriteOptions options) override {
+      absl::MutexLock lock{&mutex_};
+      write_done_ = false;
+      call_->stream_.Write(response, options, &call_->write_tag_);
+      mutex_.Await(absl::Condition(&write_done_));
+      return write_ok_;
+    }
+
+    void OnWriteDone(bool ok) {
+      absl::MutexLock lock{&mutex_};
+      write_ok_ = ok;
+      write_done_ = true;
+    }
+
+   private:
+    CaptureCall* call_;
+    absl::Mutex mutex_;
+    bool write_done_ = false;
+    bool write_ok_ = false;
+  };
+
+  void OnRequested(bool ok) {
+    if (!ok) {
+      // The server is shutting down.
+      delete this;
+      return;
+    }
+    if (service_->OnCaptureCallStarted()) {
+      new CaptureCall(service_, completion_queue_);
+    }
+    Read([this](bool ok) {
+      if (!ok) {
+        stream_.Finish(grpc::Status::OK, &finish_tag_);
+        return;
+      }
+      service_->capture_call_thread_pool_->Schedule([this] { Start(); });
+    });
+  }
+
+  void Start() {
+    LOG("Read CaptureRequest from Capture's gRPC stream: starting capture");
+    CaptureOptions* capture_options = request_.mutable_capture_options();
+    if (capture_options->compress_capture_stream()) {
+      // This applies to all the messages written after this point.
+      context_.set_compression_algorithm(GRPC_COMPRESS_GZIP);
+      LOG("Compressing the CaptureResponses with gzip");
+    }
+    service_->AddFramePointerSafeModules(capture_options);
+    ApplyServiceFlags(capture_options);
+    handler_ = std::make_unique<LinuxTracingGrpcHandler>(&writer_,
+                                                         service_->elf_cache_);
+    session_ = service_->StartOrJoinSession(*capture_options, handler_.get());
+    ReadNextRequest();
+  }
+
+  // The client asks for the capture to be stopped by calling WritesDone, at
+  // which point the read fails. In the meantime, the requests received can
+  // change the instrumented functions.
+  void ReadNextRequest() {
+    Read([this](bool ok) {
+      service_->capture_call_thread_pool_->Schedule([this, ok] {
+        if (!ok) {
+          Stop();
+          return;
+        }
+        if (request_.has_instrumented_functions_update()) {
+          LOG("Read CaptureRequest from Capture's gRPC stream: updating the "
+              "instrumented functions");
+          session_->UpdateInstrumentedFunctions(
+              std::move(*request_.mutable_instrumented_functions_update()));
+        }
+        ReadNextRequest();
+      });
+    });
+  }
+
+  void Stop() {
+    LOG("Client finished writing on Capture's gRPC stream: stopping capture");
+    service_->LeaveSession(session_, handler_.get());
+    session_.reset();
+    handler_->Stop();
+    handler_.reset();
+    const std::shared_ptr<LinuxTracing::ElfCache>& elf_cache =
+        service_->elf_cache_;
+    LOG("Elf cache: %lu hits, %lu misses, %lu entries",
+        elf_cache->GetHitCount(), elf_cache->GetMissCount(),
+        elf_cache->GetSize());
+    LOG("Finished handling gRPC call to Capture: all capture data has been "
+        "sent");
+    stream_.Finish(grpc::Status::OK, &finish_tag_);
+  }
+
+  void Read(std::function<void(bool ok)> callback) {
+    read_tag_.callback = std::move(callback);
+    stream_.Read(&request_, &read_tag_);
+  }
+
+  CaptureServiceImpl* service_;
+  grpc::ServerCompletionQueue* completion_queue_;
+  grpc::ServerContext context_;
+  grpc::ServerAsyncReaderWriter<CaptureResponse, CaptureRequest> stream_{
+      &context_};
+  CaptureRequest request_;
+  Tag request_tag_;
+  Tag read_tag_;
+  Tag write_tag_;
+  Tag finish_tag_;
+  BlockingWriter writer_{this};
+  std::unique_ptr<LinuxTracingGrpcHandler> handler_;
+  std::shared_ptr<CaptureSession> session_;
+};
+
+void CaptureServiceImpl::StartServingCaptures(
+    std::unique_ptr<grpc::ServerCompletionQueue> completion_queue) {
+  CHECK(completion_queue_ == nullptr);
+  completion_queue_ = std::move(completion_queue);
+  new CaptureCall(this, completion_queue_.get());
+  completion_queue_thread_ = std::thread{[this] {
+    pthread_setname_np(pthread_self(), "CSImpl::Capture");
+    void* tag;
+    bool ok;
+    while (completion_queue_->Next(&tag, &ok)) {
+      static_cast<CaptureCall::Tag*>(tag)->callback(ok);
+    }
+  }};
+}
+
+void CaptureServiceImpl::StopServingCaptures() {
+  if (completion_queue_ == nullptr) {
+    return;
+  }
+  {
+    absl::MutexLock lock{&capture_calls_mutex_};
+    stopping_capture_calls_ = true;
+    capture_calls_mutex_.Await(absl::Condition(
+        +[](size_t* count) { return *count == 0; }, &capture_call_count_));
+  }
+  completion_queue_->Shutdown();
+  completion_queue_thread_.join();
+  capture_call_thread_pool_->ShutdownAndWait();
+}
+
+bool CaptureServiceImpl::OnCaptureCallStarted() {
+  absl::MutexLock lock{&capture_calls_mutex_};
+  ++capture_call_count_;
+  return !stopping_capture_calls_;
+}
+
+void CaptureServiceImpl::OnCaptureCallFinished() {
+  absl::MutexLock lock{&capture_calls_mutex_};
+  --capture_call_count_;
+}
 
-  LOG("Finished handling gRPC call to Capture: all capture data has been sent");
+std::shared_ptr<CaptureSession> CaptureServiceImpl::StartOrJoinSession(
+    const CaptureOptions& capture_options, LinuxTracingGrpcHandler* handler) {
+  handler->StartWithoutTracer(capture_options);
+  if (capture_options.join_running_capture()) {
+    absl::MutexLock lock{&sessions_mutex_};
+    for (auto session_it = sessions_.rbegin(); session_it != sessions_.rend();
+         ++session_it) {
+      if (session_it->pid != capture_options.pid()) {
+        continue;
+      }
+      session_it->session->Attach(handler);
+      LOG("Joined the running capture of %d, now with %lu clients",
+          capture_options.pid(), session_it->session->GetListenerCount());
+      return session_it->session;
+    }
+    LOG("No running capture of %d to join: starting one",
+        capture_options.pid());
+  }
+
+  auto session = std::make_shared<CaptureSession>(capture_options, elf_cache_,
+                                                  kernel_symbols_);
+  session->Attach(handler);
+  {
+    absl::MutexLock lock{&sessions_mutex_};
+    sessions_.push_back({capture_options.pid(), session});
+  }
+  session->Start();
+  return session;
+}
+
+void CaptureServiceImpl::LeaveSession(
+    const std::shared_ptr<CaptureSession>& session,
+    LinuxTracingGrpcHandler* handler) {
+  {
+    absl::MutexLock lock{&sessions_mutex_};
+    if (session->GetListenerCount() > 1) {
+      session->Detach(handler);
+      return;
+    }
+    sessions_.erase(std::find_if(sessions_.begin(), sessions_.end(),
+                                 [&session](const RunningSession& running) {
+                                   return running.session == session;
+                                 }));
+  }
+  session->Stop();
+  session->Detach(handler);
+}
+
+grpc::Status CaptureServiceImpl::StartFlightRecorder(
+    grpc::ServerContext* /*context*/, const StartFlightRecorderRequest* request,
+    StartFlightRecorderResponse* /*response*/) {
+  absl::MutexLock lock{&flight_recorder_mutex_};
+  if (flight_recorder_handler_ != nullptr) {
+    return grpc::Status(grpc::StatusCode::ALREADY_EXISTS,
+                        "The flight recorder is already running");
+  }
+  flight_recorder_capture_options_ = request->capture_options();
+  flight_recorder_capture_options_.set_flight_recorder(true);
+  AddFramePointerSafeModules(&flight_recorder_capture_options_);
+  ApplyServiceFlags(&flight_recorder_capture_options_);
+  StartFlightRecorderLocked();
+  LOG("Started flight recorder");
+  return grpc::Status::OK;
+}
+
+grpc::Status CaptureServiceImpl::DumpFlightRecorder(
+    grpc::ServerContext* context, const DumpFlightRecorderRequest* /*request*/,
+    grpc::ServerWriter<CaptureResponse>* writer) {
+  pthread_setname_np(pthread_self(), "CSImpl::Dump");
+  absl::MutexLock lock{&flight_recorder_mutex_};
+  if (flight_recorder_handler_ == nullptr) {
+    return grpc::Status(grpc::StatusCode::FAILED_PRECONDITION,
+                        "The flight recorder is not running");
+  }
+  if (flight_recorder_capture_options_.compress_capture_stream()) {
+    context->set_compression_algorithm(GRPC_COMPRESS_GZIP);
+  }
+  LOG("Dumping flight recorder");
+  flight_recorder_handler_->Dump(writer);
+  // Keep recording, so that the next problem can be dumped too. What happens
+  // during the dump itself is not recorded.
+  StartFlightRecorderLocked();
+  LOG("Finished dumping flight recorder: all capture data has been sent");
   return grpc::Status::OK;
 }
+
+grpc::Status CaptureServiceImpl::StopFlightRecorder(
+    grpc::ServerContext* /*context*/,
+    const StopFlightRecorderRequest* /*request*/,
+    StopFlightRecorderResponse* /*response*/) {
+  absl::MutexLock lock{&flight_recorder_mutex_};
+  if (flight_recorder_handler_ == nullptr) {
+    return grpc::Status(grpc::StatusCode::FAILED_PRECONDITION,
+                        "The flight recorder is not running");
+  }
+  flight_recorder_handler_->Stop();
+  flight_recorder_handler_.reset();
+  LOG("Stopped flight recorder");
+  return grpc::Status::OK;
+}
+
+void CaptureServiceImpl::StartFlightRecorderLocked() {
+  flight_recorder_handler_ =
+      std::make_unique<LinuxTracingGrpcHandler>(nullptr, elf_cache_,
+                                                kernel_symbols_);
+  flight_recorder_handler_->Start(flight_recorder_capture_options_);
+}
+
+void CaptureServiceImpl::AddFramePointerSafeModules(
+    CaptureOptions* capture_options) const {
+  capture_options->clear_frame_pointer_safe_module_paths();
+  if (frame_pointer_validation_cache_ == nullptr ||
+      capture_options->unwinding_method() != CaptureOptions::kHybrid) {
+    return;
+  }
+  std::vector<int32_t> pids{capture_options->pid()};
+  pids.insert(pids.end(), capture_options->additional_pids().begin(),
+              capture_options->additional_pids().end());
+  absl::flat_hash_set<std::string> module_paths;
+  for (int32_t pid : pids) {
+    ErrorMessageOr<std::vector<ModuleInfo>> modules =
+        LinuxUtils::ListModules(pid);
+    if (!modules) {
+      ERROR("Unable to list the modules of %d: %s", pid,
+            modules.error().message());
+      continue;
+    }
+    for (const ModuleInfo& module : modules.value()) {
+      if (module.build_id().empty() ||
+          !frame_pointer_validation_cache_->IsFramePointerSafe(
+              module.build_id())) {
+        continue;
+      }
+      if (module_paths.insert(module.file_path()).second) {
+        capture_options->add_frame_pointer_safe_module_paths(
+            module.file_path());
+      }
+    }
+  }
+  LOG("%d modules are frame-pointer-safe",
+      capture_options->frame_pointer_safe_module_paths_size());
+}
+
+void CaptureServiceImpl::ApplyServiceFlags(
+    CaptureOptions* capture_options) {
+  capture_options->set_pin_service_threads(
+      absl::GetFlag(FLAGS_pin_service_threads));
+  capture_options->set_service_cpus(absl::GetFlag(FLAGS_service_cpus));
+  // The budget of the service caps the one asked for by the client.
+  const double max_cpu_usage = absl::GetFlag(FLAGS_max_cpu_usage);
+  if (max_cpu_usage > 0 &&
+      (capture_options->max_service_cpu_usage() <= 0 ||
+       max_cpu_usage < capture_options->max_service_cpu_usage())) {
+    capture_options->set_max_service_cpu_usage(max_cpu_usage);
+  }
+  // The flight recorder doesn't support perf recordings.
+  if (!capture_options->flight_recorder()) {
+    capture_options->set_perf_recording_path(
+        absl::GetFlag(FLAGS_record_perf_events));
+  }
+}
@@ -5,14 +5,118 @@
 #ifndef ORBIT_SERVICE_CAPTURE_SERVICE_IMPL_H_
 #define ORBIT_SERVICE_CAPTURE_SERVICE_IMPL_H_
 
+#include <OrbitBase/ThreadPool.h>
+#include <OrbitFramePointerValidator/FramePointerValidationCache.h>
+#include <OrbitLinuxTracing/ElfCache.h>
+#include <OrbitLinuxTracing/KernelSymbols.h>
+#include <absl/synchronization/mutex.h>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "CaptureSession.h"
+#include "LinuxTracingGrpcHandler.h"
+#include "grpcpp/grpcpp.h"
 #include "services.grpc.pb.h"
 
-class CaptureServiceImpl final : public CaptureService::Service {
+// Capture is served asynchronously, so that a capture doesn't hold a thread
+// of the server blocked on its stream for its whole duration, and several
+// clients can capture at once: different processes, or the same capture
+// with CaptureOptions.join_running_capture. The other methods are
+// synchronous.
+class CaptureServiceImpl final
+    : public CaptureService::WithAsyncMethod_Capture<CaptureService::Service> {
  public:
-  grpc::Status Capture(
-      grpc::ServerContext* context,
-      grpc::ServerReaderWriter<CaptureResponse, CaptureRequest>* reader_writer)
+  // If frame_pointer_validation_cache is not nullptr, the modules of the target
+  // that it knows to be frame-pointer-safe are passed to the captures.
+  explicit CaptureServiceImpl(
+      std::shared_ptr<FramePointerValidationCache>
+          frame_pointer_validation_cache = nullptr)
+      : frame_pointer_validation_cache_{
+            std::move(frame_pointer_validation_cache)} {}
+  ~CaptureServiceImpl() override;
+
+  // Serves the Capture calls of the server on completion_queue, polled by a
+  // thread of its own. Once the server is started.
+  void StartServingCaptures(
+      std::unique_ptr<grpc::ServerCompletionQueue> completion_queue);
+  // Once the server is shut down: waits for the Capture calls to end, then
+  // shuts down the completion queue.
+  void StopServingCaptures();
+
+  grpc::Status StartFlightRecorder(grpc::ServerContext* context,
+                                   const StartFlightRecorderRequest* request,
+                                   StartFlightRecorderResponse* response)
+      override;
+
+  grpc::Status DumpFlightRecorder(
+      grpc::ServerContext* context, const DumpFlightRecorderRequest* request,
+      grpc::ServerWriter<CaptureResponse>* writer) override;
+
+  grpc::Status StopFlightRecorder(grpc::ServerContext* context,
+                                  const StopFlightRecorderRequest* request,
+                                  StopFlightRecorderResponse* response)
       override;
+
+ private:
+  class CaptureCall;
+
+  // Starts a CaptureSession for handler, or attaches handler to the running
+  // one of the same pid with join_running_capture.
+  [[nodiscard]] std::shared_ptr<CaptureSession> StartOrJoinSession(
+      const CaptureOptions& capture_options, LinuxTracingGrpcHandler* handler);
+  // Detaches handler from session, and stops session if it was the last one
+  // attached, after which handler has received all the events of session.
+  void LeaveSession(const std::shared_ptr<CaptureSession>& session,
+                    LinuxTracingGrpcHandler* handler);
+  // Returns false once the calls are not served anymore.
+  bool OnCaptureCallStarted();
+  void OnCaptureCallFinished();
+
+  std::unique_ptr<grpc::ServerCompletionQueue> completion_queue_;
+  std::thread completion_queue_thread_;
+  // Runs what blocks in the Capture calls, like starting and stopping
+  // Tracers, and waiting for the writes of a handler to complete: not on
+  // completion_queue_thread_, which they complete on.
+  std::unique_ptr<ThreadPool> capture_call_thread_pool_ =
+      ThreadPool::Create(1, 256, absl::Seconds(10));
+  absl::Mutex capture_calls_mutex_;
+  size_t capture_call_count_ = 0;
+  bool stopping_capture_calls_ = false;
+
+  struct RunningSession {
+    int32_t pid;
+    std::shared_ptr<CaptureSession> session;
+  };
+  // Also taken to attach and detach the handlers of the sessions, so that
+  // the last handler of a session is never in doubt.
+  absl::Mutex sessions_mutex_;
+  std::vector<RunningSession> sessions_;
+
+  // Shared by all captures, so that the unwinding information of the modules
+  // of the target doesn't need to be parsed again at the start of every
+  // capture.
+  std::shared_ptr<LinuxTracing::ElfCache> elf_cache_ =
+      std::make_shared<LinuxTracing::ElfCache>();
+  // Likewise, /proc/kallsyms is read at most once.
+  std::shared_ptr<LinuxTracing::KernelSymbols> kernel_symbols_ =
+      std::make_shared<LinuxTracing::KernelSymbols>();
+  std::shared_ptr<FramePointerValidationCache> frame_pointer_validation_cache_;
+
+  // At most one flight recorder runs, independently of the captures.
+  absl::Mutex flight_recorder_mutex_;
+  CaptureOptions flight_recorder_capture_options_;
+  std::unique_ptr<LinuxTracingGrpcHandler> flight_recorder_handler_;
+
+  // Requires flight_recorder_mutex_.
+  void StartFlightRecorderLocked();
+  // Sets frame_pointer_safe_module_paths, for kHybrid.
+  void AddFramePointerSafeModules(CaptureOptions* capture_options) const;
+  // Sets pin_service_threads, service_cpus and perf_recording_path from the
+  // flags of the service, and lowers max_service_cpu_usage to its
+  // max_cpu_usage.
+  static void ApplyServiceFlags(CaptureOptions* capture_options);
 };
 
 #endif  // ORBIT_SERVICE_CAPTURE_SERVICE_IMPL_H_
@@ -0,0 +1,206 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "CaptureSession.h"
+
+#include <OrbitBase/Logging.h>
+
+#include <algorithm>
+#include <utility>
+
+using LinuxTracing::TracerListener;
+
+void CaptureSession::Start() {
+  tracer_.SetListener(this);
+  tracer_.Start();
+}
+
+void CaptureSession::Stop() { tracer_.Stop(); }
+
+void CaptureSession::UpdateInstrumentedFunctions(
+    InstrumentedFunctionsUpdate update) {
+  tracer_.UpdateInstrumentedFunctions(std::move(update));
+}
+
+void CaptureSession::Attach(TracerListener* listener) {
+  absl::WriterMutexLock lock{&listeners_mutex_};
+  CHECK(std::find(listeners_.begin(), listeners_.end(), listener) ==
+        listeners_.end());
+  {
+    absl::MutexLock cache_lock{&cache_mutex_};
+    for (const auto& [tid, thread_name] : thread_names_) {
+      listener->OnThreadName(thread_name);
+    }
+    for (const ModuleMap& module_map : module_maps_) {
+      listener->OnModuleMap(module_map);
+    }
+  }
+  listeners_.push_back(listener);
+}
+
+void CaptureSession::Detach(TracerListener* listener) {
+  absl::WriterMutexLock lock{&listeners_mutex_};
+  auto listener_it = std::find(listeners_.begin(), listeners_.end(), listener);
+  CHECK(listener_it != listeners_.end());
+  listeners_.erase(listener_it);
+}
+
+size_t CaptureSession::GetListenerCount() {
+  absl::ReaderMutexLock lock{&listeners_mutex_};
+  return listeners_.size();
+}
+
+template <typename Event>
+void CaptureSession::Forward(void (TracerListener::*on_event)(Event),
+                             Event&& event) {
+  absl::ReaderMutexLock lock{&listeners_mutex_};
+  if (listeners_.empty()) {
+    return;
+  }
+  for (size_t i = 0; i + 1 < listeners_.size(); ++i) {
+    (listeners_[i]->*on_event)(event);
+  }
+  (listeners_.back()->*on_event)(std::move(event));
+}
+
+void CaptureSession::OnSchedulingSlices(
+    std::vector<SchedulingSlice> scheduling_slices) {
+  Forward(&TracerListener::OnSchedulingSlices, std::move(scheduling_slices));
+}
+
+void CaptureSession::OnSchedulingSliceCounters(
+    SchedulingSliceCounters scheduling_slice_counters) {
+  Forward(&TracerListener::OnSchedulingSliceCounters,
+          std::move(scheduling_slice_counters));
+}
+
+void CaptureSession::OnCallstackSample(CallstackSample callstack_sample) {
+  Forward(&TracerListener::OnCallstackSample, std::move(callstack_sample));
+}
+
+void CaptureSession::OnOffCpuCallstackSample(
+    OffCpuCallstackSample off_cpu_callstack_sample) {
+  Forward(&TracerListener::OnOffCpuCallstackSample,
+          std::move(off_cpu_callstack_sample));
+}
+
+void CaptureSession::OnFunctionCall(FunctionCall function_call) {
+  Forward(&TracerListener::OnFunctionCall, std::move(function_call));
+}
+
+void CaptureSession::OnFunctionCallStats(
+    FunctionCallStats function_call_stats) {
+  Forward(&TracerListener::OnFunctionCallStats, std::move(function_call_stats));
+}
+
+void CaptureSession::OnLockWait(LockWait lock_wait) {
+  Forward(&TracerListener::OnLockWait, std::move(lock_wait));
+}
+
+void CaptureSession::OnLockContentionStats(
+    LockContentionStats lock_contention_stats) {
+  Forward(&TracerListener::OnLockContentionStats,
+          std::move(lock_contention_stats));
+}
+
+void CaptureSession::OnAllocationSample(AllocationSample allocation_sample) {
+  Forward(&TracerListener::OnAllocationSample, std::move(allocation_sample));
+}
+
+void CaptureSession::OnSyscallLatency(SyscallLatency syscall_latency) {
+  Forward(&TracerListener::OnSyscallLatency, std::move(syscall_latency));
+}
+
+void CaptureSession::OnBlockIoLatency(BlockIoLatency block_io_latency) {
+  Forward(&TracerListener::OnBlockIoLatency, std::move(block_io_latency));
+}
+
+void CaptureSession::OnCpuPowerEvent(CpuPowerEvent cpu_power_event) {
+  Forward(&TracerListener::OnCpuPowerEvent, std::move(cpu_power_event));
+}
+
+void CaptureSession::OnPageFault(PageFault page_fault) {
+  Forward(&TracerListener::OnPageFault, std::move(page_fault));
+}
+
+void CaptureSession::OnPageFaultStats(PageFaultStats page_fault_stats) {
+  Forward(&TracerListener::OnPageFaultStats, std::move(page_fault_stats));
+}
+
+void CaptureSession::OnGpuJob(GpuJob gpu_job) {
+  Forward(&TracerListener::OnGpuJob, std::move(gpu_job));
+}
+
+void CaptureSession::OnThreadName(ThreadName thread_name) {
+  {
+    absl::MutexLock lock{&cache_mutex_};
+    thread_names_.insert_or_assign(thread_name.tid(), thread_name);
+  }
+  Forward(&TracerListener::OnThreadName, std::move(thread_name));
+}
+
+void CaptureSession::OnThreadWakeup(ThreadWakeup thread_wakeup) {
+  Forward(&TracerListener::OnThreadWakeup, std::move(thread_wakeup));
+}
+
+void CaptureSession::OnAddressInfo(AddressInfo address_info) {
+  Forward(&TracerListener::OnAddressInfo, std::move(address_info));
+}
+
+void CaptureSession::OnModuleMap(ModuleMap module_map) {
+  {
+    absl::MutexLock lock{&cache_mutex_};
+    module_maps_.push_back(module_map);
+  }
+  Forward(&TracerListener::OnModuleMap, std::move(module_map));
+}
+
+void CaptureSession::OnCaptureSetupPhase(
+    CaptureSetupPhase capture_setup_phase) {
+  Forward(&TracerListener::OnCaptureSetupPhase, std::move(capture_setup_phase));
+}
+
+void CaptureSession::OnCaptureStatistics(CaptureStatistics capture_statistics) {
+  Forward(&TracerListener::OnCaptureStatistics, std::move(capture_statistics));
+}
+
+void CaptureSession::OnIntrospectionScope(
+    IntrospectionScope introspection_scope) {
+  Forward(&TracerListener::OnIntrospectionScope,
+          std::move(introspection_scope));
+}
+
+void CaptureSession::OnManualInstrumentationScope(
+    ManualInstrumentationScope manual_instrumentation_scope) {
+  Forward(&TracerListener::OnManualInstrumentationScope,
+          std::move(manual_instrumentation_scope));
+}
+
+void CaptureSession::OnGpuQueueSubmission(
+    GpuQueueSubmission gpu_queue_submission) {
+  Forward(&TracerListener::OnGpuQueueSubmission,
+          std::move(gpu_queue_submission));
+}
+
+void CaptureSession::OnAsyncSpan(AsyncSpan async_span) {
+  Forward(&TracerListener::OnAsyncSpan, std::move(async_span));
+}
+
+void CaptureSession::OnFrameMarker(FrameMarker frame_marker) {
+  Forward(&TracerListener::OnFrameMarker, std::move(frame_marker));
+}
+
+void CaptureSession::OnDisabledInstrumentedFunctions(
+    DisabledInstrumentedFunctions disabled_instrumented_functions) {
+  Forward(&TracerListener::OnDisabledInstrumentedFunctions,
+          std::move(disabled_instrumented_functions));
+}
+
+void CaptureSession::OnCpuBudgetStep(CpuBudgetStep cpu_budget_step) {
+  Forward(&TracerListener::OnCpuBudgetStep, std::move(cpu_budget_step));
+}
+
+void CaptureSession::OnClockOffset(ClockOffset clock_offset) {
+  Forward(&TracerListener::OnClockOffset, std::move(clock_offset));
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_SERVICE_CAPTURE_SESSION_H_
+#define ORBIT_SERVICE_CAPTURE_SESSION_H_
+
+#include <OrbitLinuxTracing/ElfCache.h>
+#include <OrbitLinuxTracing/KernelSymbols.h>
+#include <OrbitLinuxTracing/Tracer.h>
+#include <OrbitLinuxTracing/TracerListener.h>
+
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "capture.pb.h"
+
+// One Tracer whose events go to all the listeners attached to it, i.e., to
+// the LinuxTracingGrpcHandler of each client viewing the capture. The
+// handlers queue, encode and send the events on their own stream each, so an
+// additional viewer costs one more stream, not one more Tracer, and a slow
+// viewer only drops its own events.
+//
+// The listeners attached while the capture is running first receive the
+// thread names and module maps reported so far, which the Tracer only
+// reports once.
+class CaptureSession : public LinuxTracing::TracerListener {
+ public:
+  CaptureSession(CaptureOptions capture_options,
+                 std::shared_ptr<LinuxTracing::ElfCache> elf_cache,
+                 std::shared_ptr<LinuxTracing::KernelSymbols> kernel_symbols)
+      : tracer_{std::move(capture_options), std::move(elf_cache),
+                std::move(kernel_symbols)} {}
+  ~CaptureSession() override = default;
+  CaptureSession(const CaptureSession&) = delete;
+  CaptureSession& operator=(const CaptureSession&) = delete;
+
+  void Start();
+  // Returns once the Tracer is stopped, after its last events have been
+  // given to the listeners still attached.
+  void Stop();
+  void UpdateInstrumentedFunctions(InstrumentedFunctionsUpdate update);
+
+  // listener must stay valid until it is detached.
+  void Attach(LinuxTracing::TracerListener* listener);
+  void Detach(LinuxTracing::TracerListener* listener);
+  [[nodiscard]] size_t GetListenerCount();
+
+  void OnSchedulingSlices(
+      std::vector<SchedulingSlice> scheduling_slices) override;
+  void OnSchedulingSliceCounters(
+      SchedulingSliceCounters scheduling_slice_counters) override;
+  void OnCallstackSample(CallstackSample callstack_sample) override;
+  void OnOffCpuCallstackSample(
+      OffCpuCallstackSample off_cpu_callstack_sample) override;
+  void OnFunctionCall(FunctionCall function_call) override;
+  void OnFunctionCallStats(FunctionCallStats function_call_stats) override;
+  void OnLockWait(LockWait lock_wait) override;
+  void OnLockContentionStats(
+      LockContentionStats lock_contention_stats) override;
+  void OnAllocationSample(AllocationSample allocation_sample) override;
+  void OnSyscallLatency(SyscallLatency syscall_latency) override;
+  void OnBlockIoLatency(BlockIoLatency block_io_latency) override;
+  void OnCpuPowerEvent(CpuPowerEvent cpu_power_event) override;
+  void OnPageFault(PageFault page_fault) override;
+  void OnPageFaultStats(PageFaultStats page_fault_stats) override;
+  void OnGpuJob(GpuJob gpu_job) override;
+  void OnThreadName(ThreadName thread_name) override;
+  void OnThreadWakeup(ThreadWakeup thread_wakeup) override;
+  void OnAddressInfo(AddressInfo address_info) override;
+  void OnModuleMap(ModuleMap module_map) override;
+  void OnCaptureSetupPhase(CaptureSetupPhase capture_setup_phase) override;
+  void OnCaptureStatistics(CaptureStatistics capture_statistics) override;
+  void OnIntrospectionScope(IntrospectionScope introspection_scope) override;
+  void OnManualInstrumentationScope(
+      ManualInstrumentationScope manual_instrumentation_scope) override;
+  void OnGpuQueueSubmission(GpuQueueSubmission gpu_queue_submission) override;
+  void OnAsyncSpan(AsyncSpan async_span) override;
+  void OnFrameMarker(FrameMarker frame_marker) override;
+  void OnDisabledInstrumentedFunctions(
+      DisabledInstrumentedFunctions disabled_instrumented_functions) override;
+  void OnCpuBudgetStep(CpuBudgetStep cpu_budget_step) override;
+  void OnClockOffset(ClockOffset clock_offset) override;
+
+ private:
+  // Copies event for all the listeners but the last one, which gets it moved.
+  template <typename Event>
+  void Forward(void (LinuxTracing::TracerListener::*on_event)(Event),
+               Event&& event);
+
+  LinuxTracing::Tracer tracer_;
+
+  // The On* methods are called by several threads of the Tracer, which only
+  // share listeners_mutex_ for reading.
+  absl::Mutex listeners_mutex_;
+  std::vector<LinuxTracing::TracerListener*> listeners_;
+
+  // Taken inside listeners_mutex_ by Attach, as the cached events are given
+  // to the new listener.
+  absl::Mutex cache_mutex_;
+  absl::flat_hash_map<int32_t, ThreadName> thread_names_;
+  std::vector<ModuleMap> module_maps_;
+};
+
+#endif  // ORBIT_SERVICE_CAPTURE_SESSION_H_
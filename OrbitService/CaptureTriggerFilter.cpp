@@ -0,0 +1,177 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "CaptureTriggerFilter.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint64_t kDefaultWindowMs = 1000;
+
+// The time by which an event is complete, for the events that happen at a
+// time, as opposed to the metadata and the statistics.
+std::optional<uint64_t> GetTimestampNs(const CaptureEvent& event) {
+  switch (event.event_case()) {
+    case CaptureEvent::kSchedulingSlice:
+      return event.scheduling_slice().out_timestamp_ns();
+    case CaptureEvent::kCallstackSample:
+      return event.callstack_sample().timestamp_ns();
+    case CaptureEvent::kFunctionCall:
+      return event.function_call().end_timestamp_ns();
+    case CaptureEvent::kGpuJob:
+      return event.gpu_job().dma_fence_signaled_time_ns();
+    case CaptureEvent::kSchedulingSliceCounters:
+      return event.scheduling_slice_counters().out_timestamp_ns();
+    case CaptureEvent::kIntrospectionScope:
+      return event.introspection_scope().end_timestamp_ns();
+    case CaptureEvent::kManualInstrumentationScope:
+      return event.manual_instrumentation_scope().end_timestamp_ns();
+    case CaptureEvent::kAsyncSpan:
+      return event.async_span().end_timestamp_ns();
+    case CaptureEvent::kFrameMarker:
+      return event.frame_marker().timestamp_ns();
+    case CaptureEvent::kThreadWakeup:
+      return event.thread_wakeup().timestamp_ns();
+    case CaptureEvent::kOffCpuCallstackSample:
+      return event.off_cpu_callstack_sample().timestamp_ns();
+    case CaptureEvent::kLockWait:
+      return event.lock_wait().end_timestamp_ns();
+    case CaptureEvent::kAllocationSample:
+      return event.allocation_sample().timestamp_ns();
+    case CaptureEvent::kSyscallLatency:
+      return event.syscall_latency().end_timestamp_ns();
+    case CaptureEvent::kBlockIoLatency:
+      return event.block_io_latency().complete_timestamp_ns();
+    case CaptureEvent::kGpuQueueSubmission:
+      return event.gpu_queue_submission().submit_end_timestamp_ns();
+    case CaptureEvent::kCpuPowerEvent:
+      return event.cpu_power_event().timestamp_ns();
+    case CaptureEvent::kPageFault:
+      return event.page_fault().timestamp_ns();
+    default:
+      return std::nullopt;
+  }
+}
+
+}  // namespace
+
+CaptureTriggerFilter::CaptureTriggerFilter(
+    const CaptureOptions& capture_options) {
+  if (capture_options.flight_recorder()) {
+    return;
+  }
+  for (const CaptureOptions::CaptureTrigger& trigger :
+       capture_options.capture_triggers()) {
+    if (trigger.function_absolute_address() != 0) {
+      min_durations_by_function_[trigger.function_absolute_address()] =
+          trigger.min_duration_ns();
+    } else if (!trigger.frame_marker_name().empty()) {
+      min_intervals_by_frame_marker_[trigger.frame_marker_name()] =
+          trigger.min_duration_ns();
+    }
+  }
+  const uint64_t window_before_ms = capture_options.trigger_window_before_ms();
+  const uint64_t window_after_ms = capture_options.trigger_window_after_ms();
+  window_before_ns_ =
+      (window_before_ms != 0 ? window_before_ms : kDefaultWindowMs) * 1'000'000;
+  window_after_ns_ =
+      (window_after_ms != 0 ? window_after_ms : kDefaultWindowMs) * 1'000'000;
+}
+
+void CaptureTriggerFilter::AddEvent(CaptureEvent&& event,
+                                    std::deque<CaptureEvent>* events_to_send) {
+  const std::optional<uint64_t> timestamp_ns = GetTimestampNs(event);
+  if (!timestamp_ns.has_value()) {
+    events_to_send->push_back(std::move(event));
+    return;
+  }
+  latest_timestamp_ns_ = std::max(latest_timestamp_ns_, timestamp_ns.value());
+
+  std::optional<std::pair<uint64_t, uint64_t>> window = EvaluateTriggers(event);
+  if (window.has_value()) {
+    ++fired_count_;
+    const auto [begin_ns, end_ns] = window.value();
+    if (fired_ && begin_ns <= send_end_ns_ && end_ns >= send_begin_ns_) {
+      send_begin_ns_ = std::min(send_begin_ns_, begin_ns);
+      send_end_ns_ = std::max(send_end_ns_, end_ns);
+    } else {
+      send_begin_ns_ = begin_ns;
+      send_end_ns_ = end_ns;
+    }
+    fired_ = true;
+
+    // The held events of the window are sent in the order they arrived in.
+    std::deque<HeldEvent> still_held_events;
+    for (HeldEvent& held_event : held_events_) {
+      if (held_event.timestamp_ns >= send_begin_ns_ &&
+          held_event.timestamp_ns <= send_end_ns_) {
+        events_to_send->push_back(std::move(held_event.event));
+      } else {
+        still_held_events.push_back(std::move(held_event));
+      }
+    }
+    held_events_ = std::move(still_held_events);
+  }
+
+  if (fired_ && timestamp_ns.value() >= send_begin_ns_ &&
+      timestamp_ns.value() <= send_end_ns_) {
+    events_to_send->push_back(std::move(event));
+  } else {
+    held_events_.push_back({timestamp_ns.value(), std::move(event)});
+  }
+  DiscardEventsBefore(latest_timestamp_ns_ -
+                      std::min(latest_timestamp_ns_, window_before_ns_));
+}
+
+std::optional<std::pair<uint64_t, uint64_t>>
+CaptureTriggerFilter::EvaluateTriggers(const CaptureEvent& event) {
+  switch (event.event_case()) {
+    case CaptureEvent::kFunctionCall: {
+      const FunctionCall& function_call = event.function_call();
+      auto trigger_it =
+          min_durations_by_function_.find(function_call.absolute_address());
+      const uint64_t begin_ns = function_call.begin_timestamp_ns();
+      const uint64_t end_ns = function_call.end_timestamp_ns();
+      if (trigger_it == min_durations_by_function_.end() || end_ns < begin_ns ||
+          end_ns - begin_ns <= trigger_it->second) {
+        return std::nullopt;
+      }
+      return std::make_pair(begin_ns - std::min(begin_ns, window_before_ns_),
+                            end_ns + window_after_ns_);
+    }
+    case CaptureEvent::kFrameMarker: {
+      const FrameMarker& frame_marker = event.frame_marker();
+      auto trigger_it =
+          min_intervals_by_frame_marker_.find(frame_marker.name());
+      if (trigger_it == min_intervals_by_frame_marker_.end()) {
+        return std::nullopt;
+      }
+      const uint64_t timestamp_ns = frame_marker.timestamp_ns();
+      auto [last_it, inserted] = last_frame_marker_timestamps_ns_.try_emplace(
+          frame_marker.name(), timestamp_ns);
+      const uint64_t previous_ns = last_it->second;
+      if (inserted || timestamp_ns <= previous_ns) {
+        return std::nullopt;
+      }
+      last_it->second = timestamp_ns;
+      if (timestamp_ns - previous_ns <= trigger_it->second) {
+        return std::nullopt;
+      }
+      return std::make_pair(
+          previous_ns - std::min(previous_ns, window_before_ns_),
+          timestamp_ns + window_after_ns_);
+    }
+    default:
+      return std::nullopt;
+  }
+}
+
+void CaptureTriggerFilter::DiscardEventsBefore(uint64_t timestamp_ns) {
+  while (!held_events_.empty() &&
+         held_events_.front().timestamp_ns < timestamp_ns) {
+    held_events_.pop_front();
+    ++discarded_event_count_;
+  }
+}
@@ -0,0 +1,76 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_SERVICE_CAPTURE_TRIGGER_FILTER_H_
+#define ORBIT_SERVICE_CAPTURE_TRIGGER_FILTER_H_
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "capture.pb.h"
+
+// Applies CaptureOptions.capture_triggers to the events before they are sent.
+// The events with a time are held for trigger_window_before_ms, measured from
+// the latest time seen, and only those in the window of a trigger that fired
+// are let through, the others being discarded. The triggers are evaluated on
+// the FunctionCalls and FrameMarkers themselves, as they are produced.
+//
+// The events of the different producers arrive somewhat out of order, hence
+// an event is held until it is older than the window, not only until a newer
+// one arrives. This class is not thread safe: it is only used by the
+// SenderThread of a LinuxTracingGrpcHandler.
+class CaptureTriggerFilter {
+ public:
+  CaptureTriggerFilter() = default;
+  explicit CaptureTriggerFilter(const CaptureOptions& capture_options);
+
+  [[nodiscard]] bool IsEnabled() const {
+    return !min_durations_by_function_.empty() ||
+           !min_intervals_by_frame_marker_.empty();
+  }
+
+  // Appends to events_to_send the events to send now, in order: the held
+  // events in the window of a trigger that event fires, if any, then event
+  // itself, if it has no time or is in the window of a trigger that fired.
+  void AddEvent(CaptureEvent&& event, std::deque<CaptureEvent>* events_to_send);
+
+  [[nodiscard]] uint64_t GetFiredCount() const { return fired_count_; }
+  // Including the events still held, which are discarded if no trigger fires.
+  [[nodiscard]] uint64_t GetDiscardedEventCount() const {
+    return discarded_event_count_ + held_events_.size();
+  }
+
+ private:
+  struct HeldEvent {
+    uint64_t timestamp_ns;
+    CaptureEvent event;
+  };
+
+  // The window of the trigger that event fires, if it fires one.
+  [[nodiscard]] std::optional<std::pair<uint64_t, uint64_t>> EvaluateTriggers(
+      const CaptureEvent& event);
+  void DiscardEventsBefore(uint64_t timestamp_ns);
+
+  absl::flat_hash_map<uint64_t, uint64_t> min_durations_by_function_;
+  absl::flat_hash_map<std::string, uint64_t> min_intervals_by_frame_marker_;
+  absl::flat_hash_map<std::string, uint64_t> last_frame_marker_timestamps_ns_;
+  uint64_t window_before_ns_ = 0;
+  uint64_t window_after_ns_ = 0;
+
+  // The window of the last trigger that fired, merged with those of the
+  // previous ones it overlaps.
+  uint64_t send_begin_ns_ = 0;
+  uint64_t send_end_ns_ = 0;
+  bool fired_ = false;
+  uint64_t latest_timestamp_ns_ = 0;
+  std::deque<HeldEvent> held_events_;
+  uint64_t fired_count_ = 0;
+  uint64_t discarded_event_count_ = 0;
+};
+
+#endif  // ORBIT_SERVICE_CAPTURE_TRIGGER_FILTER_H_
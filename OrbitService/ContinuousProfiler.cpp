@@ -0,0 +1,245 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ContinuousProfiler.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#include "ElfUtils/ElfFile.h"
+#include "OrbitBase/Logging.h"
+#include "Profiling.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_format.h"
+
+ContinuousProfiler::ContinuousProfiler(std::string directory,
+                                       double sampling_rate,
+                                       absl::Duration window_duration,
+                                       size_t max_file_count)
+    : directory_{std::move(directory)},
+      sampling_rate_{sampling_rate},
+      window_duration_{window_duration},
+      max_file_count_{std::max<size_t>(max_file_count, 1)},
+      service_pid_{static_cast<int32_t>(getpid())} {}
+
+void ContinuousProfiler::Start() {
+  CHECK(tracer_ == nullptr);
+  std::error_code error;
+  std::filesystem::create_directories(directory_, error);
+  if (error) {
+    ERROR("Creating continuous profiling directory \"%s\": %s", directory_,
+          error.message());
+    return;
+  }
+  LOG("Profiling all processes at %.1f samples/s into \"%s\", every %s",
+      sampling_rate_, directory_, absl::FormatDuration(window_duration_));
+
+  // The processes other than the service itself are sampled on demand, as
+  // with sample_all_processes in the captures.
+  CaptureOptions capture_options;
+  capture_options.set_pid(service_pid_);
+  capture_options.set_sample_all_processes(true);
+  capture_options.set_sampling_rate(sampling_rate_);
+  capture_options.set_unwinding_method(CaptureOptions::kFramePointers);
+  capture_options.set_trace_context_switches(false);
+  capture_options.set_kernel_callchains(false);
+
+  window_begin_timestamp_ns_ = OrbitTicks(CLOCK_MONOTONIC);
+  window_begin_time_ = absl::Now();
+  tracer_ = std::make_unique<LinuxTracing::Tracer>(std::move(capture_options));
+  tracer_->SetListener(this);
+  tracer_->Start();
+
+  writer_thread_stop_requested_ = false;
+  writer_thread_ = std::thread{[this] { WriterThread(); }};
+}
+
+void ContinuousProfiler::Stop() {
+  if (tracer_ == nullptr) {
+    return;
+  }
+  tracer_->Stop();
+  tracer_.reset();
+  {
+    absl::MutexLock lock{&writer_thread_mutex_};
+    writer_thread_stop_requested_ = true;
+  }
+  writer_thread_.join();
+}
+
+void ContinuousProfiler::OnCallstackSample(CallstackSample callstack_sample) {
+  if (callstack_sample.pid() == service_pid_) {
+    return;
+  }
+  const auto& pcs = callstack_sample.callstack().pcs();
+  StackKey key{callstack_sample.pid(),
+               std::vector<uint64_t>(pcs.begin(), pcs.end())};
+
+  absl::MutexLock lock{&samples_mutex_};
+  auto it = sample_counts_.find(key);
+  if (it != sample_counts_.end()) {
+    ++it->second;
+  } else if (sample_counts_.size() < kMaxStackCount) {
+    sample_counts_.emplace(std::move(key), 1);
+  } else {
+    ++dropped_sample_count_;
+  }
+}
+
+void ContinuousProfiler::OnModuleMap(ModuleMap module_map) {
+  absl::MutexLock lock{&samples_mutex_};
+  const int32_t pid = module_map.pid();
+  const uint64_t start_address = module_map.start_address();
+  module_maps_[pid].insert_or_assign(start_address, std::move(module_map));
+}
+
+void ContinuousProfiler::WriterThread() {
+  bool stopped = false;
+  while (!stopped) {
+    writer_thread_mutex_.LockWhenWithTimeout(
+        absl::Condition(&writer_thread_stop_requested_), window_duration_);
+    stopped = writer_thread_stop_requested_;
+    writer_thread_mutex_.Unlock();
+    WriteWindow();
+  }
+}
+
+void ContinuousProfiler::WriteWindow() {
+  absl::flat_hash_map<StackKey, uint64_t> sample_counts;
+  uint64_t dropped_sample_count;
+  {
+    absl::MutexLock lock{&samples_mutex_};
+    sample_counts.swap(sample_counts_);
+    dropped_sample_count = dropped_sample_count_;
+    dropped_sample_count_ = 0;
+  }
+  ContinuousProfile profile =
+      BuildProfile(std::move(sample_counts), dropped_sample_count);
+  window_begin_timestamp_ns_ = profile.end_timestamp_ns();
+  const absl::Time window_begin_time = window_begin_time_;
+  window_begin_time_ = absl::Now();
+  if (profile.stacks_size() == 0) {
+    return;
+  }
+
+  // Named after the beginning of the window, for the files to sort by time.
+  const std::string file_name = absl::StrFormat(
+      "profile-%s.pb", absl::FormatTime("%Y%m%dT%H%M%SZ", window_begin_time,
+                                        absl::UTCTimeZone()));
+  const std::filesystem::path file_path =
+      std::filesystem::path{directory_} / file_name;
+  // Written to a temporary file first, for readers to only see complete
+  // profiles.
+  std::filesystem::path temporary_file_path = file_path;
+  temporary_file_path += ".tmp";
+  {
+    std::ofstream file{temporary_file_path, std::ios::binary};
+    if (!file || !profile.SerializeToOstream(&file)) {
+      ERROR("Writing continuous profile \"%s\"", temporary_file_path.string());
+      return;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary_file_path, file_path, error);
+  if (error) {
+    ERROR("Renaming \"%s\": %s", temporary_file_path.string(),
+          error.message());
+    return;
+  }
+  RemoveOldFiles();
+}
+
+ContinuousProfile ContinuousProfiler::BuildProfile(
+    absl::flat_hash_map<StackKey, uint64_t> sample_counts,
+    uint64_t dropped_sample_count) {
+  ContinuousProfile profile;
+  profile.set_begin_timestamp_ns(window_begin_timestamp_ns_);
+  profile.set_end_timestamp_ns(OrbitTicks(CLOCK_MONOTONIC));
+  profile.set_begin_unix_time_ns(absl::ToUnixNanos(window_begin_time_));
+  profile.set_sampling_rate(sampling_rate_);
+  profile.set_dropped_sample_count(dropped_sample_count);
+
+  absl::flat_hash_map<uint64_t, uint32_t> address_indices;
+  absl::flat_hash_map<int32_t, uint64_t> sample_counts_by_pid;
+  for (auto& [key, sample_count] : sample_counts) {
+    ContinuousProfile::Stack* stack = profile.add_stacks();
+    stack->set_pid(key.first);
+    stack->set_sample_count(sample_count);
+    for (uint64_t address : key.second) {
+      auto [it, inserted] =
+          address_indices.try_emplace(address, profile.addresses_size());
+      if (inserted) {
+        profile.add_addresses(address);
+      }
+      stack->add_address_indices(it->second);
+    }
+    sample_counts_by_pid[key.first] += sample_count;
+  }
+
+  // The maps of the processes that exited are dropped once they have been
+  // written with their last samples.
+  std::vector<ModuleMap> module_maps;
+  {
+    absl::MutexLock lock{&samples_mutex_};
+    for (auto it = module_maps_.begin(); it != module_maps_.end();) {
+      const int32_t pid = it->first;
+      if (sample_counts_by_pid.contains(pid)) {
+        for (const auto& [start_address, module_map] : it->second) {
+          module_maps.push_back(module_map);
+        }
+      }
+      if (!std::filesystem::exists(absl::StrFormat("/proc/%d", pid))) {
+        module_maps_.erase(it++);
+      } else {
+        ++it;
+      }
+    }
+  }
+  for (ModuleMap& module_map : module_maps) {
+    ContinuousProfile::Mapping* mapping = profile.add_mappings();
+    mapping->set_pid(module_map.pid());
+    mapping->set_start_address(module_map.start_address());
+    mapping->set_end_address(module_map.end_address());
+    mapping->set_file_offset(module_map.file_offset());
+    mapping->set_build_id(GetBuildId(module_map.file_path()));
+    mapping->set_file_path(std::move(*module_map.mutable_file_path()));
+  }
+  return profile;
+}
+
+const std::string& ContinuousProfiler::GetBuildId(
+    const std::string& file_path) {
+  auto [it, inserted] = build_ids_.try_emplace(file_path);
+  if (inserted) {
+    ErrorMessageOr<std::unique_ptr<ElfUtils::ElfFile>> elf_file =
+        ElfUtils::ElfFile::Create(file_path);
+    if (elf_file) {
+      it->second = elf_file.value()->GetBuildId();
+    }
+  }
+  return it->second;
+}
+
+void ContinuousProfiler::RemoveOldFiles() {
+  std::vector<std::string> file_paths;
+  std::error_code error;
+  for (const auto& entry :
+       std::filesystem::directory_iterator{directory_, error}) {
+    const std::string file_name = entry.path().filename().string();
+    if (absl::StartsWith(file_name, "profile-") &&
+        absl::EndsWith(file_name, ".pb")) {
+      file_paths.push_back(entry.path().string());
+    }
+  }
+  if (file_paths.size() <= max_file_count_) {
+    return;
+  }
+  std::sort(file_paths.begin(), file_paths.end());
+  for (size_t i = 0; i < file_paths.size() - max_file_count_; ++i) {
+    std::filesystem::remove(file_paths[i], error);
+  }
+}
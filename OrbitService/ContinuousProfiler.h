@@ -0,0 +1,120 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_SERVICE_CONTINUOUS_PROFILER_H_
+#define ORBIT_SERVICE_CONTINUOUS_PROFILER_H_
+
+#include <OrbitLinuxTracing/Tracer.h>
+#include <OrbitLinuxTracing/TracerListener.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "capture.pb.h"
+#include "profile.pb.h"
+
+// Samples all the processes at a low rate, with frame pointer callstacks, for
+// as long as the service runs, independently of the captures of the clients.
+// The samples are counted by process and distinct callstack over windows of
+// window_duration, and each window is written to directory as a
+// ContinuousProfile, from which the oldest files are removed to keep
+// max_file_count of them. The addresses are not symbolized: the profiles come
+// with the maps and the build ids to symbolize them offline.
+//
+// The memory used is bounded by the distinct callstacks of a window, of which
+// there are at most kMaxStackCount, and by the maps of the processes sampled,
+// which the Tracer bounds.
+class ContinuousProfiler : public LinuxTracing::TracerListener {
+ public:
+  ContinuousProfiler(std::string directory, double sampling_rate,
+                     absl::Duration window_duration, size_t max_file_count);
+  ~ContinuousProfiler() override { Stop(); }
+  ContinuousProfiler(const ContinuousProfiler&) = delete;
+  ContinuousProfiler& operator=(const ContinuousProfiler&) = delete;
+
+  void Start();
+  // Writes the partial window before returning.
+  void Stop();
+
+  void OnCallstackSample(CallstackSample callstack_sample) override;
+  void OnModuleMap(ModuleMap module_map) override;
+
+  // The other events are not requested by the CaptureOptions of the Tracer.
+  void OnSchedulingSlices(std::vector<SchedulingSlice>) override {}
+  void OnSchedulingSliceCounters(SchedulingSliceCounters) override {}
+  void OnOffCpuCallstackSample(OffCpuCallstackSample) override {}
+  void OnFunctionCall(FunctionCall) override {}
+  void OnFunctionCallStats(FunctionCallStats) override {}
+  void OnLockWait(LockWait) override {}
+  void OnLockContentionStats(LockContentionStats) override {}
+  void OnAllocationSample(AllocationSample) override {}
+  void OnSyscallLatency(SyscallLatency) override {}
+  void OnBlockIoLatency(BlockIoLatency) override {}
+  void OnCpuPowerEvent(CpuPowerEvent) override {}
+  void OnPageFault(PageFault) override {}
+  void OnPageFaultStats(PageFaultStats) override {}
+  void OnGpuJob(GpuJob) override {}
+  void OnThreadName(ThreadName) override {}
+  void OnThreadWakeup(ThreadWakeup) override {}
+  void OnAddressInfo(AddressInfo) override {}
+  void OnCaptureSetupPhase(CaptureSetupPhase) override {}
+  void OnCaptureStatistics(CaptureStatistics) override {}
+  void OnIntrospectionScope(IntrospectionScope) override {}
+  void OnManualInstrumentationScope(ManualInstrumentationScope) override {}
+  void OnGpuQueueSubmission(GpuQueueSubmission) override {}
+  void OnAsyncSpan(AsyncSpan) override {}
+  void OnFrameMarker(FrameMarker) override {}
+  void OnDisabledInstrumentedFunctions(
+      DisabledInstrumentedFunctions) override {}
+  void OnCpuBudgetStep(CpuBudgetStep) override {}
+  void OnClockOffset(ClockOffset) override {}
+
+ private:
+  static constexpr size_t kMaxStackCount = 64 * 1024;
+
+  using StackKey = std::pair<int32_t, std::vector<uint64_t>>;
+
+  void WriterThread();
+  // Takes the samples of the window that ends now and writes them.
+  void WriteWindow();
+  [[nodiscard]] ContinuousProfile BuildProfile(
+      absl::flat_hash_map<StackKey, uint64_t> sample_counts,
+      uint64_t dropped_sample_count);
+  [[nodiscard]] const std::string& GetBuildId(const std::string& file_path);
+  void RemoveOldFiles();
+
+  std::string directory_;
+  double sampling_rate_;
+  absl::Duration window_duration_;
+  size_t max_file_count_;
+  int32_t service_pid_;
+
+  std::unique_ptr<LinuxTracing::Tracer> tracer_;
+  std::thread writer_thread_;
+  absl::Mutex writer_thread_mutex_;
+  bool writer_thread_stop_requested_ = false;
+
+  // Written by the threads of the Tracer, taken by the writer thread.
+  absl::Mutex samples_mutex_;
+  absl::flat_hash_map<StackKey, uint64_t> sample_counts_;
+  uint64_t dropped_sample_count_ = 0;
+  // By pid, by start address, as the maps of a process are sent again when
+  // the Tracer samples it again after having evicted it.
+  absl::flat_hash_map<int32_t, absl::flat_hash_map<uint64_t, ModuleMap>>
+      module_maps_;
+
+  // Only used by the writer thread.
+  uint64_t window_begin_timestamp_ns_ = 0;
+  absl::Time window_begin_time_;
+  absl::flat_hash_map<std::string, std::string> build_ids_;
+};
+
+#endif  // ORBIT_SERVICE_CONTINUOUS_PROFILER_H_
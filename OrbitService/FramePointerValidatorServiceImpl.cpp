@@ -6,11 +6,26 @@
 
 #include <absl/strings/str_format.h>
 
+#include <algorithm>
+#include <thread>
 #include <vector>
 
 #include "ElfUtils/ElfFile.h"
+#include "OrbitBase/Logging.h"
 #include "OrbitFramePointerValidator/FramePointerValidator.h"
 
+FramePointerValidatorServiceImpl::FramePointerValidatorServiceImpl(
+    std::shared_ptr<FramePointerValidationCache> validation_cache)
+    : thread_pool_{ThreadPool::CreateWorkStealing(
+          std::max(std::thread::hardware_concurrency(), 2u) - 1)},
+      validation_cache_{std::move(validation_cache)} {
+  CHECK(validation_cache_ != nullptr);
+}
+
+FramePointerValidatorServiceImpl::~FramePointerValidatorServiceImpl() {
+  thread_pool_->ShutdownAndWait();
+}
+
 grpc::Status FramePointerValidatorServiceImpl::ValidateFramePointers(
     grpc::ServerContext*, const ValidateFramePointersRequest* request,
     ValidateFramePointersResponse* response) {
@@ -27,13 +42,26 @@ grpc::Status FramePointerValidatorServiceImpl::ValidateFramePointers(
   }
 
   bool is_64_bit = elf_file_result.value()->Is64Bit();
+  // Without a build-id, a module can't be told apart from another version of
+  // it at the same path, hence its results are not cached.
+  const std::string build_id = elf_file_result.value()->GetBuildId();
 
   std::vector<CodeBlock> function_infos(request->functions().begin(),
                                         request->functions().end());
+  std::vector<CodeBlock> unvalidated_functions =
+      build_id.empty()
+          ? function_infos
+          : validation_cache_->GetUnvalidatedFunctions(build_id,
+                                                       function_infos);
 
-  std::optional<std::vector<CodeBlock>> functions =
-      FramePointerValidator::GetFpoFunctions(function_infos,
-                                             request->module_path(), is_64_bit);
+  std::optional<std::vector<CodeBlock>> functions;
+  if (unvalidated_functions.empty()) {
+    functions.emplace();
+  } else {
+    functions = FramePointerValidator::GetFpoFunctions(
+        unvalidated_functions, request->module_path(), is_64_bit,
+        thread_pool_.get());
+  }
 
   if (!functions.has_value()) {
     return grpc::Status(
@@ -42,10 +70,32 @@ grpc::Status FramePointerValidatorServiceImpl::ValidateFramePointers(
                         request->module_path()));
   }
 
-  for (const auto& function : functions.value()) {
+  auto add_function_without_frame_pointer = [response](
+                                                 const CodeBlock& function) {
     CodeBlock* added_function = response->add_functions_without_frame_pointer();
     added_function->set_offset(function.offset());
     added_function->set_size(function.size());
+  };
+  if (build_id.empty()) {
+    for (const auto& function : functions.value()) {
+      add_function_without_frame_pointer(function);
+    }
+    return grpc::Status::OK;
+  }
+
+  validation_cache_->AddValidatedFunctions(build_id, unvalidated_functions,
+                                           functions.value());
+  bool is_frame_pointer_safe = true;
+  for (const auto& function : function_infos) {
+    std::optional<bool> has_frame_pointers =
+        validation_cache_->HasFramePointers(build_id, function);
+    if (has_frame_pointers.has_value() && !has_frame_pointers.value()) {
+      add_function_without_frame_pointer(function);
+      is_frame_pointer_safe = false;
+    }
+  }
+  if (request->contains_all_functions()) {
+    validation_cache_->AddValidatedModule(build_id, is_frame_pointer_safe);
   }
 
   return grpc::Status::OK;
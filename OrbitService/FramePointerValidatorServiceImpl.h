@@ -5,20 +5,33 @@
 #ifndef ORBIT_CORE_FRAME_POINTER_VALIDATOR_SERVICE_H_
 #define ORBIT_CORE_FRAME_POINTER_VALIDATOR_SERVICE_H_
 
+#include <memory>
+
+#include "OrbitBase/ThreadPool.h"
+#include "OrbitFramePointerValidator/FramePointerValidationCache.h"
 #include "services.grpc.pb.h"
 
 // Runs on the service and receives requests from FramePointerValidatorClient to
 // validate whether certain modules are compiled with frame pointers.
 // It returns a list of functions that don't have a prologue and epilogue
 // associated with frame pointers (see FunctionFramePointerValidator).
+// The results are cached by build-id, so that only the functions that were
+// never validated are validated again. The cache is shared with the captures,
+// which look up the modules that are frame-pointer-safe in it.
 class FramePointerValidatorServiceImpl final
     : public FramePointerValidatorService::Service {
  public:
+  explicit FramePointerValidatorServiceImpl(
+      std::shared_ptr<FramePointerValidationCache> validation_cache);
+  ~FramePointerValidatorServiceImpl() override;
+
   grpc::Status ValidateFramePointers(
       grpc::ServerContext* context, const ValidateFramePointersRequest* request,
       ValidateFramePointersResponse* response) override;
 
  private:
+  std::unique_ptr<ThreadPool> thread_pool_;
+  std::shared_ptr<FramePointerValidationCache> validation_cache_;
 };
 
 #endif  // ORBIT_CORE_FRAME_POINTER_VALIDATOR_SERVICE_H_
@@ -0,0 +1,79 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_SERVICE_INTERN_TABLE_H_
+#define ORBIT_SERVICE_INTERN_TABLE_H_
+
+#include <OrbitBase/Logging.h>
+
+#include <cstdint>
+#include <list>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+
+// InternTable assigns keys to the values (callstacks, strings) that are sent
+// to the client only once and then referred to by key. The key of a value is
+// its hash, unless that key is already assigned to a different value, in
+// which case the following free key is used: values are compared, so that a
+// collision never merges different values.
+// The table keeps at most max_size values, evicting the least recently used.
+// An evicted value is simply interned again, with a possibly different key,
+// when it occurs again. As the client replaces the value of a key it receives
+// again, it always resolves a key to the last value sent for it.
+// This class is not thread safe.
+template <typename Value>
+class InternTable {
+ public:
+  explicit InternTable(size_t max_size) : max_size_{max_size} {
+    CHECK(max_size_ > 0);
+  }
+
+  // Returns the key of value and whether value was added to the table, i.e.,
+  // whether it needs to be sent to the client.
+  std::pair<uint64_t, bool> Intern(uint64_t hash, const Value& value) {
+    uint64_t key = hash;
+    while (true) {
+      auto entry_it = entries_by_key_.find(key);
+      if (entry_it == entries_by_key_.end()) {
+        break;
+      }
+      if (entry_it->second->value == value) {
+        entries_.splice(entries_.begin(), entries_, entry_it->second);
+        return {key, false};
+      }
+      ++collision_count_;
+      ++key;
+    }
+
+    entries_.push_front(Entry{key, value});
+    entries_by_key_.emplace(key, entries_.begin());
+    if (entries_.size() > max_size_) {
+      entries_by_key_.erase(entries_.back().key);
+      entries_.pop_back();
+      ++eviction_count_;
+    }
+    return {key, true};
+  }
+
+  [[nodiscard]] size_t GetSize() const { return entries_.size(); }
+  [[nodiscard]] uint64_t GetCollisionCount() const { return collision_count_; }
+  [[nodiscard]] uint64_t GetEvictionCount() const { return eviction_count_; }
+
+ private:
+  struct Entry {
+    uint64_t key;
+    Value value;
+  };
+
+  size_t max_size_;
+  // Most recently used first.
+  std::list<Entry> entries_;
+  absl::flat_hash_map<uint64_t, typename std::list<Entry>::iterator>
+      entries_by_key_;
+  uint64_t collision_count_ = 0;
+  uint64_t eviction_count_ = 0;
+};
+
+#endif  // ORBIT_SERVICE_INTERN_TABLE_H_
@@ -4,92 +4,243 @@
 
 #include "LinuxTracingGrpcHandler.h"
 
+#include <OrbitBase/Tracing.h>
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+#include "Utils.h"
 #include "llvm/Demangle/Demangle.h"
+#include "xxhash.h"
 
 void LinuxTracingGrpcHandler::Start(CaptureOptions capture_options) {
   CHECK(tracer_ == nullptr);
   CHECK(!sender_thread_.joinable());
 
-  {
-    // Protect tracer_ with event_buffer_mutex_ so that we can use tracer_ in
-    // Conditions for Await/LockWhen (specifically, in SenderThread).
-    absl::MutexLock lock{&event_buffer_mutex_};
-    tracer_ =
-        std::make_unique<LinuxTracing::Tracer>(std::move(capture_options));
-  }
+  const bool flight_recorder = capture_options.flight_recorder();
+  ResetQueue(capture_options);
+  tracer_ = std::make_unique<LinuxTracing::Tracer>(
+      std::move(capture_options), elf_cache_, kernel_symbols_);
   tracer_->SetListener(this);
   tracer_->Start();
 
+  {
+    absl::MutexLock lock{&sender_thread_mutex_};
+    sender_thread_stop_requested_ = false;
+  }
+  // There is no stream to send to before the dump of the flight recorder.
+  if (!flight_recorder) {
+    sender_thread_ = std::thread{[this] { SenderThread(); }};
+  }
+}
+
+void LinuxTracingGrpcHandler::StartWithoutTracer(
+    const CaptureOptions& capture_options) {
+  CHECK(tracer_ == nullptr);
+  CHECK(!sender_thread_.joinable());
+
+  ResetQueue(capture_options);
+  {
+    absl::MutexLock lock{&sender_thread_mutex_};
+    sender_thread_stop_requested_ = false;
+  }
+  sender_thread_ = std::thread{[this] { SenderThread(); }};
+}
+
+void LinuxTracingGrpcHandler::ResetQueue(
+    const CaptureOptions& capture_options) {
+  compact_event_encoding_ = capture_options.compact_event_encoding();
+  client_side_symbolization_ = capture_options.client_side_symbolization();
+  service_symbolized_map_paths_ = {
+      capture_options.service_symbolized_map_paths().begin(),
+      capture_options.service_symbolized_map_paths().end()};
+  function_ids_by_address_.clear();
+  for (const CaptureOptions::InstrumentedFunction& instrumented_function :
+       capture_options.instrumented_functions()) {
+    if (instrumented_function.function_id() != 0) {
+      function_ids_by_address_.emplace(instrumented_function.absolute_address(),
+                                       instrumented_function.function_id());
+    }
+  }
+  callstack_sample_counts_interval_ns_ =
+      capture_options.callstack_sample_counts_interval_ns();
+  pending_sample_counts_.clear();
+  pending_sample_count_keys_.clear();
+  last_counted_sample_timestamp_ns_ = 0;
+  counted_sample_count_ = 0;
+  sent_sample_counts_count_ = 0;
+  trigger_filter_ = CaptureTriggerFilter{capture_options};
+  max_queued_event_bytes_ = capture_options.max_buffered_event_bytes();
+  buffer_full_policy_ = capture_options.buffer_full_policy();
+  queued_event_bytes_ = 0;
+  absl::MutexLock lock{&dropped_events_mutex_};
+  dropping_samples_ = false;
+  total_dropped_event_count_ = 0;
+}
+
+void LinuxTracingGrpcHandler::Dump(CaptureResponseWriter* writer) {
+  CHECK(tracer_ != nullptr);
+  CHECK(!sender_thread_.joinable());
+
+  writer_ = writer;
+  // The events are only enqueued while the Tracer stops, which can block on
+  // a full queue.
   sender_thread_ = std::thread{[this] { SenderThread(); }};
+  Stop();
 }
 
 void LinuxTracingGrpcHandler::Stop() {
-  CHECK(tracer_ != nullptr);
-  CHECK(sender_thread_.joinable());
+  CHECK(tracer_ != nullptr || sender_thread_.joinable());
+  if (!sender_thread_.joinable()) {
+    // A flight recorder stopped without Dump: its events are discarded.
+    writer_ = nullptr;
+    sender_thread_ = std::thread{[this] { SenderThread(); }};
+  }
 
-  tracer_->Stop();
-  {
-    absl::MutexLock lock{&event_buffer_mutex_};
+  if (tracer_ != nullptr) {
+    tracer_->Stop();
     tracer_.reset();
   }
 
+  // No more events are enqueued at this point: SenderThread sends what is left
+  // in the queue and exits.
+  {
+    absl::MutexLock lock{&sender_thread_mutex_};
+    sender_thread_stop_requested_ = true;
+  }
   sender_thread_.join();
 }
 
-void LinuxTracingGrpcHandler::OnSchedulingSlice(
-    SchedulingSlice scheduling_slice) {
-  CaptureEvent event;
-  *event.mutable_scheduling_slice() = std::move(scheduling_slice);
-  {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
+void LinuxTracingGrpcHandler::UpdateInstrumentedFunctions(
+    InstrumentedFunctionsUpdate update) {
+  CHECK(tracer_ != nullptr);
+  tracer_->UpdateInstrumentedFunctions(std::move(update));
+}
+
+void LinuxTracingGrpcHandler::OnSchedulingSlices(
+    std::vector<SchedulingSlice> scheduling_slices) {
+  std::vector<CaptureEvent> events(scheduling_slices.size());
+  for (size_t i = 0; i < scheduling_slices.size(); ++i) {
+    *events[i].mutable_scheduling_slice() = std::move(scheduling_slices[i]);
   }
+  EnqueueEvents(std::move(events));
+}
+
+void LinuxTracingGrpcHandler::OnSchedulingSliceCounters(
+    SchedulingSliceCounters scheduling_slice_counters) {
+  CaptureEvent event;
+  *event.mutable_scheduling_slice_counters() =
+      std::move(scheduling_slice_counters);
+  EnqueueEvent(std::move(event));
 }
 
 void LinuxTracingGrpcHandler::OnCallstackSample(
     CallstackSample callstack_sample) {
   CHECK(callstack_sample.callstack_or_key_case() ==
         CallstackSample::kCallstack);
-  callstack_sample.set_callstack_key(
-      InternCallstackIfNecessaryAndGetKey(callstack_sample.callstack()));
-
   CaptureEvent event;
   *event.mutable_callstack_sample() = std::move(callstack_sample);
-  {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
-  }
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnOffCpuCallstackSample(
+    OffCpuCallstackSample off_cpu_callstack_sample) {
+  CHECK(off_cpu_callstack_sample.callstack_or_key_case() ==
+        OffCpuCallstackSample::kCallstack);
+  CaptureEvent event;
+  *event.mutable_off_cpu_callstack_sample() =
+      std::move(off_cpu_callstack_sample);
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnAllocationSample(
+    AllocationSample allocation_sample) {
+  CHECK(allocation_sample.callstack_or_key_case() ==
+        AllocationSample::kCallstack);
+  CaptureEvent event;
+  *event.mutable_allocation_sample() = std::move(allocation_sample);
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnSyscallLatency(SyscallLatency syscall_latency) {
+  CaptureEvent event;
+  *event.mutable_syscall_latency() = std::move(syscall_latency);
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnBlockIoLatency(
+    BlockIoLatency block_io_latency) {
+  CaptureEvent event;
+  *event.mutable_block_io_latency() = std::move(block_io_latency);
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnCpuPowerEvent(CpuPowerEvent cpu_power_event) {
+  CaptureEvent event;
+  *event.mutable_cpu_power_event() = std::move(cpu_power_event);
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnPageFault(PageFault page_fault) {
+  CHECK(page_fault.callstack_or_key_case() == PageFault::kCallstack);
+  CaptureEvent event;
+  *event.mutable_page_fault() = std::move(page_fault);
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnPageFaultStats(
+    PageFaultStats page_fault_stats) {
+  CaptureEvent event;
+  *event.mutable_page_fault_stats() = std::move(page_fault_stats);
+  EnqueueEvent(std::move(event));
 }
 
 void LinuxTracingGrpcHandler::OnFunctionCall(FunctionCall function_call) {
   CaptureEvent event;
   *event.mutable_function_call() = std::move(function_call);
-  {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
-  }
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnFunctionCallStats(
+    FunctionCallStats function_call_stats) {
+  CaptureEvent event;
+  *event.mutable_function_call_stats() = std::move(function_call_stats);
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnLockWait(LockWait lock_wait) {
+  CaptureEvent event;
+  *event.mutable_lock_wait() = std::move(lock_wait);
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnLockContentionStats(
+    LockContentionStats lock_contention_stats) {
+  CHECK(lock_contention_stats.callstack_or_key_case() ==
+        LockContentionStats::kCallstack);
+  CaptureEvent event;
+  *event.mutable_lock_contention_stats() = std::move(lock_contention_stats);
+  EnqueueEvent(std::move(event));
 }
 
 void LinuxTracingGrpcHandler::OnGpuJob(GpuJob gpu_job) {
   CHECK(gpu_job.timeline_or_key_case() == GpuJob::kTimeline);
-  gpu_job.set_timeline_key(
-      InternStringIfNecessaryAndGetKey(std::move(*gpu_job.mutable_timeline())));
-
   CaptureEvent event;
   *event.mutable_gpu_job() = std::move(gpu_job);
-  {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
-  }
+  EnqueueEvent(std::move(event));
 }
 
 void LinuxTracingGrpcHandler::OnThreadName(ThreadName thread_name) {
   CaptureEvent event;
   *event.mutable_thread_name() = std::move(thread_name);
-  {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
-  }
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnThreadWakeup(ThreadWakeup thread_wakeup) {
+  CaptureEvent event;
+  *event.mutable_thread_wakeup() = std::move(thread_wakeup);
+  EnqueueEvent(std::move(event));
 }
 
 void LinuxTracingGrpcHandler::OnAddressInfo(AddressInfo address_info) {
@@ -102,118 +253,699 @@ void LinuxTracingGrpcHandler::OnAddressInfo(AddressInfo address_info) {
   }
 
   CHECK(address_info.function_name_or_key_case() == AddressInfo::kFunctionName);
-  address_info.set_function_name_key(InternStringIfNecessaryAndGetKey(
-      llvm::demangle(address_info.function_name())));
   CHECK(address_info.map_name_or_key_case() == AddressInfo::kMapName);
-  address_info.set_map_name_key(InternStringIfNecessaryAndGetKey(
-      std::move(*address_info.mutable_map_name())));
+  // The names the client resolves itself are neither demangled nor sent.
+  if (client_side_symbolization_ &&
+      !service_symbolized_map_paths_.contains(address_info.map_name()) &&
+      !LinuxTracing::KernelSymbols::IsKernelAddress(
+          address_info.absolute_address())) {
+    address_info.clear_function_name_or_key();
+    address_info.clear_offset_in_function();
+  }
 
   CaptureEvent event;
   *event.mutable_address_info() = std::move(address_info);
-  {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
-  }
+  EnqueueEvent(std::move(event));
 }
 
-uint64_t LinuxTracingGrpcHandler::ComputeCallstackKey(
-    const Callstack& callstack) {
-  uint64_t key = 17;
-  for (uint64_t pc : callstack.pcs()) {
-    key = 31 * key + pc;
-  }
-  return key;
+void LinuxTracingGrpcHandler::OnModuleMap(ModuleMap module_map) {
+  CaptureEvent event;
+  *event.mutable_module_map() = std::move(module_map);
+  EnqueueEvent(std::move(event));
 }
 
-uint64_t LinuxTracingGrpcHandler::InternCallstackIfNecessaryAndGetKey(
-    Callstack callstack) {
-  uint64_t key = ComputeCallstackKey(callstack);
-  {
-    absl::MutexLock lock{&callstack_keys_sent_mutex_};
-    if (callstack_keys_sent_.contains(key)) {
-      return key;
+void LinuxTracingGrpcHandler::OnCaptureSetupPhase(
+    CaptureSetupPhase capture_setup_phase) {
+  CaptureEvent event;
+  *event.mutable_capture_setup_phase() = std::move(capture_setup_phase);
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnCaptureStatistics(
+    CaptureStatistics capture_statistics) {
+  CaptureEvent event;
+  *event.mutable_capture_statistics() = std::move(capture_statistics);
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnIntrospectionScope(
+    IntrospectionScope introspection_scope) {
+  CaptureEvent event;
+  *event.mutable_introspection_scope() = std::move(introspection_scope);
+  // This is also called by SenderThread itself, which must not block waiting
+  // for room in the queue, and the scopes of the service are not worth
+  // slowing it down more: drop them while the queue is full instead.
+  if (max_queued_event_bytes_ != 0) {
+    if (!IsQueueBelowLimit()) {
+      return;
     }
-    callstack_keys_sent_.emplace(key);
+    queued_event_bytes_ += event.ByteSizeLong();
   }
+  event_queue_.enqueue(std::move(event));
+}
 
+void LinuxTracingGrpcHandler::OnManualInstrumentationScope(
+    ManualInstrumentationScope manual_instrumentation_scope) {
   CaptureEvent event;
-  event.mutable_interned_callstack()->set_key(key);
-  *event.mutable_interned_callstack()->mutable_intern() = std::move(callstack);
-  {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
+  *event.mutable_manual_instrumentation_scope() =
+      std::move(manual_instrumentation_scope);
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnGpuQueueSubmission(
+    GpuQueueSubmission gpu_queue_submission) {
+  CaptureEvent event;
+  *event.mutable_gpu_queue_submission() = std::move(gpu_queue_submission);
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnAsyncSpan(AsyncSpan async_span) {
+  CaptureEvent event;
+  *event.mutable_async_span() = std::move(async_span);
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnFrameMarker(FrameMarker frame_marker) {
+  CaptureEvent event;
+  *event.mutable_frame_marker() = std::move(frame_marker);
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnDisabledInstrumentedFunctions(
+    DisabledInstrumentedFunctions disabled_instrumented_functions) {
+  CaptureEvent event;
+  *event.mutable_disabled_instrumented_functions() =
+      std::move(disabled_instrumented_functions);
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnCpuBudgetStep(CpuBudgetStep cpu_budget_step) {
+  CaptureEvent event;
+  *event.mutable_cpu_budget_step() = std::move(cpu_budget_step);
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::OnClockOffset(ClockOffset clock_offset) {
+  CaptureEvent event;
+  *event.mutable_clock_offset() = std::move(clock_offset);
+  EnqueueEvent(std::move(event));
+}
+
+void LinuxTracingGrpcHandler::EnqueueEvent(CaptureEvent&& event) {
+  if (!MakeRoomForEvent(event)) {
+    return;
   }
-  return key;
+  event_queue_.enqueue(std::move(event));
 }
 
-uint64_t LinuxTracingGrpcHandler::ComputeStringKey(const std::string& str) {
-  return std::hash<std::string>{}(str);
+void LinuxTracingGrpcHandler::EnqueueEvents(
+    std::vector<CaptureEvent>&& events) {
+  if (max_queued_event_bytes_ != 0) {
+    events.erase(std::remove_if(events.begin(), events.end(),
+                                [this](const CaptureEvent& event) {
+                                  return !MakeRoomForEvent(event);
+                                }),
+                 events.end());
+  }
+  event_queue_.enqueue_bulk(std::make_move_iterator(events.begin()),
+                            events.size());
 }
 
-uint64_t LinuxTracingGrpcHandler::InternStringIfNecessaryAndGetKey(
-    std::string str) {
-  uint64_t key = ComputeStringKey(str);
-  {
-    absl::MutexLock lock{&string_keys_sent_mutex_};
-    if (string_keys_sent_.contains(key)) {
-      return key;
+bool LinuxTracingGrpcHandler::MakeRoomForEvent(const CaptureEvent& event) {
+  if (max_queued_event_bytes_ == 0) {
+    return true;
+  }
+
+  // This also caches the size in event, for SenderThread to retrieve it with
+  // GetCachedSize.
+  uint64_t event_bytes = event.ByteSizeLong();
+  switch (buffer_full_policy_) {
+    case CaptureOptions::kDropSamples:
+      if (ShouldDropEvent(event, event_bytes)) {
+        return false;
+      }
+      break;
+    case CaptureOptions::kBlockProducers:
+      if (!IsQueueBelowLimit()) {
+        queue_space_mutex_.LockWhen(absl::Condition(
+            +[](LinuxTracingGrpcHandler* self) {
+              return self->IsQueueBelowLimit();
+            },
+            this));
+        queue_space_mutex_.Unlock();
+      }
+      break;
+    default:
+      UNREACHABLE();
+  }
+  queued_event_bytes_ += event_bytes;
+  return true;
+}
+
+bool LinuxTracingGrpcHandler::ShouldDropEvent(const CaptureEvent& event,
+                                              uint64_t event_bytes) {
+  uint64_t timestamp_ns;
+  switch (event.event_case()) {
+    case CaptureEvent::kCallstackSample:
+      timestamp_ns = event.callstack_sample().timestamp_ns();
+      break;
+    case CaptureEvent::kSchedulingSlice:
+      timestamp_ns = event.scheduling_slice().out_timestamp_ns();
+      break;
+    default:
+      return false;
+  }
+
+  if (!dropping_samples_ &&
+      queued_event_bytes_ + event_bytes <= max_queued_event_bytes_) {
+    return false;
+  }
+
+  absl::MutexLock lock{&dropped_events_mutex_};
+  if (!dropping_samples_) {
+    if (queued_event_bytes_ + event_bytes <= max_queued_event_bytes_) {
+      return false;
     }
-    string_keys_sent_.emplace(key);
+    dropping_samples_ = true;
+    dropped_events_.Clear();
+    dropped_events_.set_begin_timestamp_ns(timestamp_ns);
+    dropped_events_.set_end_timestamp_ns(timestamp_ns);
   }
 
-  CaptureEvent event;
-  event.mutable_interned_string()->set_key(key);
-  event.mutable_interned_string()->set_intern(std::move(str));
-  {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
+  dropped_events_.set_begin_timestamp_ns(
+      std::min(dropped_events_.begin_timestamp_ns(), timestamp_ns));
+  dropped_events_.set_end_timestamp_ns(
+      std::max(dropped_events_.end_timestamp_ns(), timestamp_ns));
+  if (event.event_case() == CaptureEvent::kCallstackSample) {
+    dropped_events_.set_callstack_sample_count(
+        dropped_events_.callstack_sample_count() + 1);
+  } else {
+    dropped_events_.set_scheduling_slice_count(
+        dropped_events_.scheduling_slice_count() + 1);
   }
-  return key;
+  ++total_dropped_event_count_;
+  return true;
+}
+
+std::optional<DroppedEvents> LinuxTracingGrpcHandler::TakeDroppedEventsIfDone(
+    bool stopped) {
+  if (!dropping_samples_) {
+    return std::nullopt;
+  }
+  absl::MutexLock lock{&dropped_events_mutex_};
+  // Only resume when half of the buffer is free, so that samples are dropped
+  // in a few long ranges rather than one every now and then.
+  if (!stopped && queued_event_bytes_ > max_queued_event_bytes_ / 2) {
+    return std::nullopt;
+  }
+  dropping_samples_ = false;
+  return std::move(dropped_events_);
 }
 
 void LinuxTracingGrpcHandler::SenderThread() {
   pthread_setname_np(pthread_self(), "SenderThread");
   constexpr absl::Duration kSendTimeInterval = absl::Milliseconds(20);
-  // This should be lower than kMaxEventsPerResponse in SendBufferedEvents as
-  // a few more events are likely to arrive after the condition becomes true.
-  constexpr uint64_t kSendEventCountInterval = 5000;
+
+  // The initial block is never freed by Arena::Reset, so in the steady state
+  // building a response doesn't allocate at all.
+  constexpr size_t kArenaInitialBlockSize = 1024 * 1024;
+  std::unique_ptr<char[]> arena_initial_block =
+      std::make_unique<char[]>(kArenaInitialBlockSize);
+  google::protobuf::ArenaOptions arena_options;
+  arena_options.initial_block = arena_initial_block.get();
+  arena_options.initial_block_size = kArenaInitialBlockSize;
+  google::protobuf::Arena arena{arena_options};
+
+  bytes_sent_ = 0;
+  responses_sent_ = 0;
+  bytes_sent_at_last_statistics_ = 0;
+  write_duration_ = absl::ZeroDuration();
+  write_duration_at_last_statistics_ = absl::ZeroDuration();
+  target_response_bytes_ = MIN_TARGET_RESPONSE_BYTES;
+  max_arena_space_used_ = 0;
+  absl::Time begin = absl::Now();
 
   bool stopped = false;
   while (!stopped) {
-    event_buffer_mutex_.LockWhenWithTimeout(
-        absl::Condition(
-            +[](LinuxTracingGrpcHandler* self) {
-              return self->event_buffer_.size() >= kSendEventCountInterval ||
-                     self->tracer_ == nullptr;
-            },
-            this),
-        kSendTimeInterval);
-    if (tracer_ == nullptr) {
-      stopped = true;
+    sender_thread_mutex_.LockWhenWithTimeout(
+        absl::Condition(&sender_thread_stop_requested_), kSendTimeInterval);
+    stopped = sender_thread_stop_requested_;
+    sender_thread_mutex_.Unlock();
+    SendQueuedEvents(&arena, stopped);
+  }
+
+  double duration_s = absl::ToDoubleSeconds(absl::Now() - begin);
+  LOG("Sent %lu bytes (uncompressed) in %lu CaptureResponses (%.0f bytes/s, "
+      "%.0f responses/s), up to %lu bytes of arena space per response",
+      bytes_sent_, responses_sent_, bytes_sent_ / duration_s,
+      responses_sent_ / duration_s, max_arena_space_used_);
+  LOG("Interned %lu callstacks (%lu collisions, %lu evictions) and %lu "
+      "strings (%lu collisions, %lu evictions, %lu demangled)",
+      interned_callstacks_.GetSize(), interned_callstacks_.GetCollisionCount(),
+      interned_callstacks_.GetEvictionCount(), interned_strings_.GetSize(),
+      interned_strings_.GetCollisionCount(),
+      interned_strings_.GetEvictionCount(), demangled_string_count_);
+  if (callstack_sample_counts_interval_ns_ != 0) {
+    LOG("Counted %lu callstack samples, sent as %lu CallstackSampleCounts",
+        counted_sample_count_, sent_sample_counts_count_);
+  }
+  if (trigger_filter_.IsEnabled()) {
+    LOG("Capture triggers fired %lu times, %lu events outside of their "
+        "windows were discarded",
+        trigger_filter_.GetFiredCount(),
+        trigger_filter_.GetDiscardedEventCount());
+  }
+  absl::MutexLock lock{&dropped_events_mutex_};
+  if (total_dropped_event_count_ > 0) {
+    LOG("Dropped %lu events as the buffer of %lu bytes was full",
+        total_dropped_event_count_, max_queued_event_bytes_);
+  }
+}
+
+void LinuxTracingGrpcHandler::SendQueuedEvents(google::protobuf::Arena* arena,
+                                               bool stopped) {
+  constexpr size_t kDequeueBulkSize = 10'000;
+
+  CaptureResponse* response =
+      google::protobuf::Arena::CreateMessage<CaptureResponse>(arena);
+  // Serialized size of the events in response, not counting their tags.
+  size_t response_bytes = 0;
+  // The elements of dequeued_events_ from this index on are not referenced by
+  // response, so they can be overwritten by the next bulk dequeue.
+  size_t first_unreferenced_event_index = 0;
+  // The events let through by trigger_filter_, which the previous responses
+  // no longer reference.
+  released_events_.clear();
+
+  auto write_response = [&] {
+    bytes_sent_ += response_bytes;
+    ++responses_sent_;
+    absl::Time write_begin = absl::Now();
+    if (writer_ != nullptr) {
+      ORBIT_SCOPE("Write CaptureResponse");
+      writer_->Write(*response);
+    }
+    absl::Duration write_duration = absl::Now() - write_begin;
+    write_duration_ += write_duration;
+    AdjustTargetResponseBytes(write_duration);
+    max_arena_space_used_ =
+        std::max<size_t>(max_arena_space_used_, arena->SpaceUsed());
+    // This doesn't run the destructor of response, hence it doesn't delete
+    // the events in dequeued_events_ it points to.
+    arena->Reset();
+    response = google::protobuf::Arena::CreateMessage<CaptureResponse>(arena);
+    response_timestamp_base_ns_.reset();
+    response_bytes = 0;
+    first_unreferenced_event_index = 0;
+  };
+
+  auto add_event = [&](CaptureEvent* event) {
+    if (response_bytes >= target_response_bytes_) {
+      write_response();
+    }
+    if (event->event_case() == CaptureEvent::kCaptureStatistics) {
+      AddSenderStatistics(event->mutable_capture_statistics());
+    }
+    int first_new_event_index = response->capture_events_size();
+    // Interned callstacks and strings are added right before the event.
+    InternIfNecessary(event, response);
+    if (callstack_sample_counts_interval_ns_ != 0 &&
+        event->event_case() == CaptureEvent::kCallstackSample) {
+      CountCallstackSample(event->callstack_sample());
+    } else {
+      if (compact_event_encoding_) {
+        EncodeCompactly(event, response);
+      }
+      response->mutable_capture_events()->UnsafeArenaAddAllocated(event);
+    }
+    for (int j = first_new_event_index; j < response->capture_events_size();
+         ++j) {
+      response_bytes += response->capture_events(j).ByteSizeLong();
+    }
+  };
+
+  size_t dequeued_count;
+  do {
+    size_t first_index = first_unreferenced_event_index;
+    if (dequeued_events_.size() < first_index + kDequeueBulkSize) {
+      dequeued_events_.resize(first_index + kDequeueBulkSize);
     }
-    std::vector<CaptureEvent> buffered_events = std::move(event_buffer_);
-    event_buffer_.clear();
-    event_buffer_mutex_.Unlock();
-    SendBufferedEvents(std::move(buffered_events));
+    dequeued_count = event_queue_.try_dequeue_bulk(
+        dequeued_events_.begin() + first_index, kDequeueBulkSize);
+    if (max_queued_event_bytes_ != 0 && dequeued_count > 0) {
+      uint64_t dequeued_bytes = 0;
+      for (size_t i = first_index; i < first_index + dequeued_count; ++i) {
+        dequeued_bytes += dequeued_events_[i].GetCachedSize();
+      }
+      // Taking the mutex makes the producers blocked with kBlockProducers
+      // re-evaluate their condition.
+      absl::MutexLock lock{&queue_space_mutex_};
+      queued_event_bytes_ -= dequeued_bytes;
+    }
+    for (size_t i = first_index; i < first_index + dequeued_count; ++i) {
+      if (!trigger_filter_.IsEnabled()) {
+        add_event(&dequeued_events_[i]);
+        first_unreferenced_event_index = i + 1;
+        continue;
+      }
+      const size_t first_released_index = released_events_.size();
+      trigger_filter_.AddEvent(std::move(dequeued_events_[i]),
+                               &released_events_);
+      for (size_t j = first_released_index; j < released_events_.size(); ++j) {
+        add_event(&released_events_[j]);
+      }
+    }
+  } while (dequeued_count == kDequeueBulkSize);
+
+  if (callstack_sample_counts_interval_ns_ != 0) {
+    // The samples of the different threads arrive somewhat out of order: an
+    // interval is only sent once samples an interval later have arrived.
+    SendCallstackSampleCounts(
+        stopped ? std::numeric_limits<uint64_t>::max()
+                : last_counted_sample_timestamp_ns_ -
+                      std::min(last_counted_sample_timestamp_ns_,
+                               callstack_sample_counts_interval_ns_),
+        response);
+  }
+
+  std::optional<DroppedEvents> dropped_events =
+      TakeDroppedEventsIfDone(stopped);
+  if (dropped_events.has_value()) {
+    *response->add_capture_events()->mutable_dropped_events() =
+        std::move(dropped_events.value());
+  }
+
+  if (response->capture_events_size() > 0) {
+    write_response();
+  }
+}
+
+void LinuxTracingGrpcHandler::AdjustTargetResponseBytes(
+    absl::Duration write_duration) {
+  // Write blocks when the flow control window of the stream is full, i.e.,
+  // when the connection or the client can't keep up with the data produced.
+  // In that case send fewer, larger messages, which also compress better, and
+  // go back to smaller ones progressively when the stream has recovered.
+  constexpr absl::Duration kBackpressureWriteDuration = absl::Milliseconds(10);
+  if (write_duration >= kBackpressureWriteDuration) {
+    target_response_bytes_ =
+        std::min(2 * target_response_bytes_, MAX_TARGET_RESPONSE_BYTES);
+  } else {
+    target_response_bytes_ =
+        std::max(target_response_bytes_ - target_response_bytes_ / 8,
+                 MIN_TARGET_RESPONSE_BYTES);
+  }
+}
+
+void LinuxTracingGrpcHandler::AddSenderStatistics(
+    CaptureStatistics* capture_statistics) {
+  capture_statistics->set_sender_queued_event_count(event_queue_.size_approx());
+  capture_statistics->set_bytes_sent(bytes_sent_ -
+                                     bytes_sent_at_last_statistics_);
+  capture_statistics->set_sender_stall_duration_ns(absl::ToInt64Nanoseconds(
+      write_duration_ - write_duration_at_last_statistics_));
+  bytes_sent_at_last_statistics_ = bytes_sent_;
+  write_duration_at_last_statistics_ = write_duration_;
+}
+
+void LinuxTracingGrpcHandler::InternIfNecessary(CaptureEvent* event,
+                                                CaptureResponse* response) {
+  switch (event->event_case()) {
+    case CaptureEvent::kCallstackSample: {
+      CallstackSample* callstack_sample = event->mutable_callstack_sample();
+      Callstack callstack = std::move(*callstack_sample->mutable_callstack());
+      callstack_sample->set_callstack_key(
+          InternCallstackIfNecessaryAndGetKey(std::move(callstack), response));
+    } break;
+    case CaptureEvent::kOffCpuCallstackSample: {
+      OffCpuCallstackSample* off_cpu_callstack_sample =
+          event->mutable_off_cpu_callstack_sample();
+      Callstack callstack =
+          std::move(*off_cpu_callstack_sample->mutable_callstack());
+      off_cpu_callstack_sample->set_callstack_key(
+          InternCallstackIfNecessaryAndGetKey(std::move(callstack), response));
+    } break;
+    case CaptureEvent::kLockContentionStats: {
+      LockContentionStats* lock_contention_stats =
+          event->mutable_lock_contention_stats();
+      Callstack callstack =
+          std::move(*lock_contention_stats->mutable_callstack());
+      lock_contention_stats->set_callstack_key(
+          InternCallstackIfNecessaryAndGetKey(std::move(callstack), response));
+    } break;
+    case CaptureEvent::kAllocationSample: {
+      AllocationSample* allocation_sample = event->mutable_allocation_sample();
+      Callstack callstack = std::move(*allocation_sample->mutable_callstack());
+      allocation_sample->set_callstack_key(
+          InternCallstackIfNecessaryAndGetKey(std::move(callstack), response));
+    } break;
+    case CaptureEvent::kPageFault: {
+      PageFault* page_fault = event->mutable_page_fault();
+      Callstack callstack = std::move(*page_fault->mutable_callstack());
+      page_fault->set_callstack_key(
+          InternCallstackIfNecessaryAndGetKey(std::move(callstack), response));
+    } break;
+    case CaptureEvent::kIntrospectionScope: {
+      IntrospectionScope* scope = event->mutable_introspection_scope();
+      std::string name = std::move(*scope->mutable_name());
+      scope->set_name_key(
+          InternStringIfNecessaryAndGetKey(std::move(name), response));
+    } break;
+    case CaptureEvent::kManualInstrumentationScope: {
+      ManualInstrumentationScope* scope =
+          event->mutable_manual_instrumentation_scope();
+      std::string name = std::move(*scope->mutable_name());
+      scope->set_name_key(InternStringIfNecessaryAndGetKey(
+          scope->name_hash(), std::move(name), response));
+      scope->clear_name_hash();
+    } break;
+    case CaptureEvent::kAsyncSpan: {
+      AsyncSpan* async_span = event->mutable_async_span();
+      std::string name = std::move(*async_span->mutable_name());
+      async_span->set_name_key(
+          InternStringIfNecessaryAndGetKey(std::move(name), response));
+    } break;
+    case CaptureEvent::kFrameMarker: {
+      FrameMarker* frame_marker = event->mutable_frame_marker();
+      std::string name = std::move(*frame_marker->mutable_name());
+      frame_marker->set_name_key(
+          InternStringIfNecessaryAndGetKey(std::move(name), response));
+    } break;
+    case CaptureEvent::kGpuJob: {
+      GpuJob* gpu_job = event->mutable_gpu_job();
+      std::string timeline = std::move(*gpu_job->mutable_timeline());
+      gpu_job->set_timeline_key(
+          InternStringIfNecessaryAndGetKey(std::move(timeline), response));
+    } break;
+    case CaptureEvent::kAddressInfo: {
+      AddressInfo* address_info = event->mutable_address_info();
+      if (address_info->function_name_or_key_case() ==
+          AddressInfo::kFunctionName) {
+        std::string function_name =
+            std::move(*address_info->mutable_function_name());
+        address_info->set_function_name_key(InternStringIfNecessaryAndGetKey(
+            std::move(function_name), response, /*demangle=*/true));
+      }
+      std::string map_name = std::move(*address_info->mutable_map_name());
+      address_info->set_map_name_key(
+          InternStringIfNecessaryAndGetKey(std::move(map_name), response));
+    } break;
+    default:
+      break;
+  }
+}
+
+void LinuxTracingGrpcHandler::EncodeCompactly(CaptureEvent* event,
+                                              CaptureResponse* response) {
+  switch (event->event_case()) {
+    case CaptureEvent::kSchedulingSlice: {
+      const SchedulingSlice& scheduling_slice = event->scheduling_slice();
+      CompactSchedulingSlice compact;
+      compact.set_pid(scheduling_slice.pid());
+      compact.set_tid(scheduling_slice.tid());
+      compact.set_core(scheduling_slice.core());
+      compact.set_in_timestamp_delta_ns(
+          ComputeTimestampDelta(scheduling_slice.in_timestamp_ns(), response));
+      compact.set_duration_ns(scheduling_slice.out_timestamp_ns() -
+                              scheduling_slice.in_timestamp_ns());
+      *event->mutable_compact_scheduling_slice() = std::move(compact);
+    } break;
+    case CaptureEvent::kFunctionCall: {
+      FunctionCall* function_call = event->mutable_function_call();
+      CompactFunctionCall compact;
+      compact.set_pid(function_call->pid());
+      compact.set_tid(function_call->tid());
+      // The functions instrumented while capturing have no id.
+      auto function_id_it =
+          function_ids_by_address_.find(function_call->absolute_address());
+      if (function_id_it != function_ids_by_address_.end()) {
+        compact.set_function_id(function_id_it->second);
+      } else {
+        compact.set_absolute_address(function_call->absolute_address());
+      }
+      compact.set_begin_timestamp_delta_ns(ComputeTimestampDelta(
+          function_call->begin_timestamp_ns(), response));
+      compact.set_duration_ns(function_call->end_timestamp_ns() -
+                              function_call->begin_timestamp_ns());
+      compact.set_depth(function_call->depth());
+      compact.set_return_value(function_call->return_value());
+      compact.mutable_registers()->Swap(function_call->mutable_registers());
+      *event->mutable_compact_function_call() = std::move(compact);
+    } break;
+    case CaptureEvent::kCallstackSample: {
+      const CallstackSample& callstack_sample = event->callstack_sample();
+      CHECK(callstack_sample.callstack_or_key_case() ==
+            CallstackSample::kCallstackKey);
+      CompactCallstackSample compact;
+      compact.set_pid(callstack_sample.pid());
+      compact.set_tid(callstack_sample.tid());
+      compact.set_callstack_key(callstack_sample.callstack_key());
+      compact.set_timestamp_delta_ns(
+          ComputeTimestampDelta(callstack_sample.timestamp_ns(), response));
+      *event->mutable_compact_callstack_sample() = std::move(compact);
+    } break;
+    case CaptureEvent::kThreadWakeup: {
+      const ThreadWakeup& thread_wakeup = event->thread_wakeup();
+      CompactThreadWakeup compact;
+      compact.set_wakee_tid(thread_wakeup.wakee_tid());
+      compact.set_waker_tid(thread_wakeup.waker_tid());
+      compact.set_timestamp_delta_ns(
+          ComputeTimestampDelta(thread_wakeup.timestamp_ns(), response));
+      *event->mutable_compact_thread_wakeup() = std::move(compact);
+    } break;
+    default:
+      break;
+  }
+}
+
+int64_t LinuxTracingGrpcHandler::ComputeTimestampDelta(
+    uint64_t timestamp_ns, CaptureResponse* response) {
+  if (!response_timestamp_base_ns_.has_value()) {
+    response_timestamp_base_ns_ = timestamp_ns;
+    response->add_capture_events()->mutable_timestamp_base()->set_timestamp_ns(
+        timestamp_ns);
+  }
+  return static_cast<int64_t>(timestamp_ns -
+                              response_timestamp_base_ns_.value());
+}
+
+uint64_t LinuxTracingGrpcHandler::ComputeCallstackKey(
+    const Callstack& callstack) {
+  // Same as CallStack::Hash.
+  return XXH64(callstack.pcs().data(), callstack.pcs_size() * sizeof(uint64_t),
+               0xca1157ac);
+}
+
+uint64_t LinuxTracingGrpcHandler::InternCallstackIfNecessaryAndGetKey(
+    Callstack callstack, CaptureResponse* response) {
+  auto [key, added] = interned_callstacks_.Intern(
+      ComputeCallstackKey(callstack),
+      std::vector<uint64_t>{callstack.pcs().begin(), callstack.pcs().end()});
+  if (!added) {
+    return key;
   }
+  if (pending_sample_count_keys_.contains(key)) {
+    SendCallstackSampleCounts(std::numeric_limits<uint64_t>::max(), response);
+  }
+
+  CaptureEvent* event = response->add_capture_events();
+  if (compact_event_encoding_) {
+    CompactInternedCallstack* compact =
+        event->mutable_compact_interned_callstack();
+    compact->set_key(key);
+    uint64_t previous_pc = 0;
+    for (uint64_t pc : callstack.pcs()) {
+      compact->add_pc_deltas(static_cast<int64_t>(pc - previous_pc));
+      previous_pc = pc;
+    }
+    return key;
+  }
+  event->mutable_interned_callstack()->set_key(key);
+  *event->mutable_interned_callstack()->mutable_intern() =
+      std::move(callstack);
+  return key;
 }
 
-void LinuxTracingGrpcHandler::SendBufferedEvents(
-    std::vector<CaptureEvent>&& buffered_events) {
-  if (buffered_events.empty()) {
+void LinuxTracingGrpcHandler::CountCallstackSample(
+    const CallstackSample& callstack_sample) {
+  const uint64_t timestamp_ns = callstack_sample.timestamp_ns();
+  const uint64_t interval_begin_ns =
+      timestamp_ns - timestamp_ns % callstack_sample_counts_interval_ns_;
+  PendingSampleCounts& pending =
+      pending_sample_counts_[{interval_begin_ns, callstack_sample.tid()}];
+  pending.pid = callstack_sample.pid();
+  ++pending.counts_by_callstack_key[callstack_sample.callstack_key()];
+  pending_sample_count_keys_.insert(callstack_sample.callstack_key());
+  last_counted_sample_timestamp_ns_ =
+      std::max(last_counted_sample_timestamp_ns_, timestamp_ns);
+  ++counted_sample_count_;
+}
+
+void LinuxTracingGrpcHandler::SendCallstackSampleCounts(
+    uint64_t end_timestamp_ns, CaptureResponse* response) {
+  std::vector<std::pair<uint64_t, int32_t>> ended_intervals;
+  for (const auto& [interval, pending] : pending_sample_counts_) {
+    if (interval.first + callstack_sample_counts_interval_ns_ <=
+        end_timestamp_ns) {
+      ended_intervals.push_back(interval);
+    }
+  }
+  std::sort(ended_intervals.begin(), ended_intervals.end());
+
+  for (const std::pair<uint64_t, int32_t>& interval : ended_intervals) {
+    auto pending_it = pending_sample_counts_.find(interval);
+    CallstackSampleCounts* sample_counts =
+        response->add_capture_events()->mutable_callstack_sample_counts();
+    sample_counts->set_pid(pending_it->second.pid);
+    sample_counts->set_tid(interval.second);
+    sample_counts->set_begin_timestamp_ns(interval.first);
+    sample_counts->set_end_timestamp_ns(interval.first +
+                                        callstack_sample_counts_interval_ns_);
+    for (const auto& [callstack_key, count] :
+         pending_it->second.counts_by_callstack_key) {
+      sample_counts->add_callstack_keys(callstack_key);
+      sample_counts->add_counts(count);
+    }
+    pending_sample_counts_.erase(pending_it);
+    ++sent_sample_counts_count_;
+  }
+  if (ended_intervals.empty()) {
     return;
   }
-  constexpr uint64_t kMaxEventsPerResponse = 10'000;
-  CaptureResponse response;
-  for (CaptureEvent& event : buffered_events) {
-    // We buffer to avoid sending countless tiny messages, but we also want to
-    // avoid huge messages, which would cause the capture on the client to jump
-    // forward in time in few big steps and not look live anymore.
-    if (response.capture_events_size() == kMaxEventsPerResponse) {
-      reader_writer_->Write(response);
-      response.clear_capture_events();
+  pending_sample_count_keys_.clear();
+  for (const auto& [interval, pending] : pending_sample_counts_) {
+    for (const auto& [callstack_key, count] : pending.counts_by_callstack_key) {
+      pending_sample_count_keys_.insert(callstack_key);
     }
-    response.mutable_capture_events()->Add(std::move(event));
   }
-  reader_writer_->Write(response);
+}
+
+uint64_t LinuxTracingGrpcHandler::ComputeStringKey(const std::string& str) {
+  // Unlike std::hash, this is stable across builds and platforms.
+  return StringHash(str);
+}
+
+uint64_t LinuxTracingGrpcHandler::InternStringIfNecessaryAndGetKey(
+    std::string str, CaptureResponse* response, bool demangle) {
+  const uint64_t hash = ComputeStringKey(str);
+  return InternStringIfNecessaryAndGetKey(hash, std::move(str), response,
+                                          demangle);
+}
+
+uint64_t LinuxTracingGrpcHandler::InternStringIfNecessaryAndGetKey(
+    uint64_t hash, std::string str, CaptureResponse* response, bool demangle) {
+  auto [key, added] = interned_strings_.Intern(hash, str);
+  if (!added) {
+    return key;
+  }
+
+  CaptureEvent* event = response->add_capture_events();
+  event->mutable_interned_string()->set_key(key);
+  if (demangle) {
+    ++demangled_string_count_;
+    event->mutable_interned_string()->set_intern(llvm::demangle(str));
+  } else {
+    event->mutable_interned_string()->set_intern(std::move(str));
+  }
+  return key;
 }
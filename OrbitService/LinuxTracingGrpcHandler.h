@@ -6,18 +6,42 @@
 #define ORBIT_SERVICE_LINUX_TRACING_GRPC_HANDLER_H_
 
 #include <OrbitBase/Logging.h>
+#include <OrbitLinuxTracing/ElfCache.h>
+#include <OrbitLinuxTracing/KernelSymbols.h>
 #include <OrbitLinuxTracing/Tracer.h>
 #include <OrbitLinuxTracing/TracerListener.h>
 
+#include <atomic>
+#include <deque>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CaptureTriggerFilter.h"
+#include "InternTable.h"
+#include "Threading.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/synchronization/mutex.h"
+#include "google/protobuf/arena.h"
 #include "services.grpc.pb.h"
 
+// The CaptureResponses are written to the stream of Capture, or of
+// DumpFlightRecorder, hence to their common base.
+using CaptureResponseWriter = grpc::internal::WriterInterface<CaptureResponse>;
+
 class LinuxTracingGrpcHandler : public LinuxTracing::TracerListener {
  public:
+  // writer can be nullptr for a flight recorder capture, see Dump. Without a
+  // writer, the events are discarded.
   explicit LinuxTracingGrpcHandler(
-      grpc::ServerReaderWriter<CaptureResponse, CaptureRequest>* reader_writer)
-      : reader_writer_{reader_writer} {}
+      CaptureResponseWriter* writer,
+      std::shared_ptr<LinuxTracing::ElfCache> elf_cache = nullptr,
+      std::shared_ptr<LinuxTracing::KernelSymbols> kernel_symbols = nullptr)
+      : writer_{writer},
+        elf_cache_{std::move(elf_cache)},
+        kernel_symbols_{std::move(kernel_symbols)} {}
 
   ~LinuxTracingGrpcHandler() override = default;
   LinuxTracingGrpcHandler(const LinuxTracingGrpcHandler&) = delete;
@@ -26,36 +50,202 @@ class LinuxTracingGrpcHandler : public LinuxTracing::TracerListener {
   LinuxTracingGrpcHandler& operator=(LinuxTracingGrpcHandler&&) = delete;
 
   void Start(CaptureOptions capture_options);
+  // Only sends the events it is given as a TracerListener, e.g., by the
+  // CaptureSession it is attached to, with the options of capture_options
+  // that are about the stream: the encoding and the limit on queued events.
+  void StartWithoutTracer(const CaptureOptions& capture_options);
+  // Without a Tracer, the events must not be given to this anymore.
   void Stop();
+  // Stops a capture with CaptureOptions.flight_recorder, which only produces
+  // events when it's stopped, and sends them to writer.
+  void Dump(CaptureResponseWriter* writer);
+  // Changes the instrumented functions of the running capture.
+  void UpdateInstrumentedFunctions(InstrumentedFunctionsUpdate update);
 
-  void OnSchedulingSlice(SchedulingSlice scheduling_slice) override;
+  void OnSchedulingSlices(
+      std::vector<SchedulingSlice> scheduling_slices) override;
+  void OnSchedulingSliceCounters(
+      SchedulingSliceCounters scheduling_slice_counters) override;
   void OnCallstackSample(CallstackSample callstack_sample) override;
+  void OnOffCpuCallstackSample(
+      OffCpuCallstackSample off_cpu_callstack_sample) override;
   void OnFunctionCall(FunctionCall function_call) override;
+  void OnFunctionCallStats(FunctionCallStats function_call_stats) override;
+  void OnLockWait(LockWait lock_wait) override;
+  void OnLockContentionStats(
+      LockContentionStats lock_contention_stats) override;
+  void OnAllocationSample(AllocationSample allocation_sample) override;
+  void OnSyscallLatency(SyscallLatency syscall_latency) override;
+  void OnBlockIoLatency(BlockIoLatency block_io_latency) override;
+  void OnCpuPowerEvent(CpuPowerEvent cpu_power_event) override;
+  void OnPageFault(PageFault page_fault) override;
+  void OnPageFaultStats(PageFaultStats page_fault_stats) override;
   void OnGpuJob(GpuJob gpu_job) override;
   void OnThreadName(ThreadName thread_name) override;
+  void OnThreadWakeup(ThreadWakeup thread_wakeup) override;
   void OnAddressInfo(AddressInfo address_info) override;
+  void OnModuleMap(ModuleMap module_map) override;
+  void OnCaptureSetupPhase(CaptureSetupPhase capture_setup_phase) override;
+  void OnCaptureStatistics(CaptureStatistics capture_statistics) override;
+  void OnIntrospectionScope(IntrospectionScope introspection_scope) override;
+  void OnManualInstrumentationScope(
+      ManualInstrumentationScope manual_instrumentation_scope) override;
+  void OnGpuQueueSubmission(GpuQueueSubmission gpu_queue_submission) override;
+  void OnAsyncSpan(AsyncSpan async_span) override;
+  void OnFrameMarker(FrameMarker frame_marker) override;
+  void OnDisabledInstrumentedFunctions(
+      DisabledInstrumentedFunctions disabled_instrumented_functions) override;
+  void OnCpuBudgetStep(CpuBudgetStep cpu_budget_step) override;
+  void OnClockOffset(ClockOffset clock_offset) override;
 
  private:
-  grpc::ServerReaderWriter<CaptureResponse, CaptureRequest>* reader_writer_;
+  CaptureResponseWriter* writer_;
+  std::shared_ptr<LinuxTracing::ElfCache> elf_cache_;
+  std::shared_ptr<LinuxTracing::KernelSymbols> kernel_symbols_;
   std::unique_ptr<LinuxTracing::Tracer> tracer_;
 
-  static uint64_t ComputeCallstackKey(const Callstack& callstack);
-  uint64_t InternCallstackIfNecessaryAndGetKey(Callstack callstack);
-  static uint64_t ComputeStringKey(const std::string& str);
-  uint64_t InternStringIfNecessaryAndGetKey(std::string str);
-
   absl::flat_hash_set<uint64_t> addresses_seen_;
   absl::Mutex addresses_seen_mutex_;
-  absl::flat_hash_set<uint64_t> callstack_keys_sent_;
-  absl::Mutex callstack_keys_sent_mutex_;
-  absl::flat_hash_set<uint64_t> string_keys_sent_;
-  absl::Mutex string_keys_sent_mutex_;
 
+  // Applies the options of the queue and of the encoding of the events.
+  void ResetQueue(const CaptureOptions& capture_options);
+
+  // The On* methods are called by several threads of the Tracer. Each of them
+  // only enqueues the event, without locking: LockFreeQueue internally keeps a
+  // separate queue for each producer thread, which preserves the order of the
+  // events of each producer. SenderThread dequeues the events in bulk.
+  void EnqueueEvent(CaptureEvent&& event);
+  // Enqueues all of events at once, which is cheaper for many small events.
+  void EnqueueEvents(std::vector<CaptureEvent>&& events);
+  // Applies max_queued_event_bytes_ and buffer_full_policy_ to event before it
+  // is enqueued. Returns false if it has to be dropped.
+  bool MakeRoomForEvent(const CaptureEvent& event);
   void SenderThread();
-  void SendBufferedEvents(std::vector<CaptureEvent>&& buffered_events);
+  // Responses are built on arena, which is reset after each Write. The events
+  // are not copied into the arena: they stay owned by dequeued_events_.
+  void SendQueuedEvents(google::protobuf::Arena* arena, bool stopped);
+  void AdjustTargetResponseBytes(absl::Duration write_duration);
+  // Fills in the fields of capture_statistics that come from SenderThread.
+  void AddSenderStatistics(CaptureStatistics* capture_statistics);
+
+  // When max_queued_event_bytes_ is not 0, the events in event_queue_ are
+  // limited to that many bytes, and buffer_full_policy_ applies when the limit
+  // is reached.
+  [[nodiscard]] bool IsQueueBelowLimit() const {
+    return queued_event_bytes_ < max_queued_event_bytes_;
+  }
+  // Returns whether event has to be dropped, because of kDropSamples.
+  bool ShouldDropEvent(const CaptureEvent& event, uint64_t event_bytes);
+  // Returns the DroppedEvents to report if the current range of dropped
+  // events is over, i.e., if enough of the queue has been sent or if stopped.
+  std::optional<DroppedEvents> TakeDroppedEventsIfDone(bool stopped);
+
+  // Interning only happens on SenderThread, which makes sure that an interned
+  // callstack or string is always sent before the events that refer to it.
+  void InternIfNecessary(CaptureEvent* event, CaptureResponse* response);
+  // Replaces event with its compact variant, if it has one. This can add a
+  // TimestampBase event to response.
+  void EncodeCompactly(CaptureEvent* event, CaptureResponse* response);
+  int64_t ComputeTimestampDelta(uint64_t timestamp_ns,
+                                CaptureResponse* response);
+  static uint64_t ComputeCallstackKey(const Callstack& callstack);
+  // Before assigning a key to a different callstack than the one it was last
+  // sent for, this sends the CallstackSampleCounts that refer to the key.
+  uint64_t InternCallstackIfNecessaryAndGetKey(Callstack callstack,
+                                               CaptureResponse* response);
+  // With CaptureOptions.callstack_sample_counts_interval_ns, counts
+  // callstack_sample, whose callstack is already interned, instead of sending
+  // it.
+  void CountCallstackSample(const CallstackSample& callstack_sample);
+  // Adds to response the CallstackSampleCounts of the intervals that end at or
+  // before end_timestamp_ns, by increasing time.
+  void SendCallstackSampleCounts(uint64_t end_timestamp_ns,
+                                 CaptureResponse* response);
+  static uint64_t ComputeStringKey(const std::string& str);
+  // With demangle, str is a function name that is sent demangled. The string
+  // is still interned by its mangled version, so that each function name is
+  // only demangled once (while in the table), however many addresses of the
+  // function are seen. For strings that are not mangled names, like map
+  // names, demangling returns the string itself, hence sharing the table is
+  // not ambiguous.
+  uint64_t InternStringIfNecessaryAndGetKey(std::string str,
+                                            CaptureResponse* response,
+                                            bool demangle = false);
+  // For a string whose hash is already known.
+  uint64_t InternStringIfNecessaryAndGetKey(uint64_t hash, std::string str,
+                                            CaptureResponse* response,
+                                            bool demangle = false);
+
+  LockFreeQueue<CaptureEvent> event_queue_;
+  uint64_t max_queued_event_bytes_ = 0;
+  CaptureOptions::BufferFullPolicy buffer_full_policy_ =
+      CaptureOptions::kDropSamples;
+  std::atomic<uint64_t> queued_event_bytes_ = 0;
+  // Producers waiting with kBlockProducers wait on this mutex, which
+  // SenderThread also takes when it removes events from the queue.
+  absl::Mutex queue_space_mutex_;
+  // dropping_samples_ can be read without holding dropped_events_mutex_, but
+  // it is only written while holding it.
+  absl::Mutex dropped_events_mutex_;
+  std::atomic<bool> dropping_samples_ = false;
+  DroppedEvents dropped_events_;
+  uint64_t total_dropped_event_count_ = 0;
+  // Only accessed by SenderThread. A deque, as growing it must not move the
+  // events that the response being built points to.
+  std::deque<CaptureEvent> dequeued_events_;
+  // See CaptureOptions.capture_triggers. Only accessed by SenderThread, but
+  // for the reset before it starts. The events it lets through are moved to
+  // released_events_, which is a deque for the same reason.
+  CaptureTriggerFilter trigger_filter_;
+  std::deque<CaptureEvent> released_events_;
+  size_t target_response_bytes_ = MIN_TARGET_RESPONSE_BYTES;
+  bool compact_event_encoding_ = false;
+  // See CaptureOptions.client_side_symbolization. Only written before the
+  // Tracer and SenderThread start.
+  bool client_side_symbolization_ = false;
+  absl::flat_hash_set<std::string> service_symbolized_map_paths_;
+  // The CaptureOptions.InstrumentedFunction.function_ids, for the compact
+  // FunctionCalls.
+  absl::flat_hash_map<uint64_t, uint64_t> function_ids_by_address_;
+  std::optional<uint64_t> response_timestamp_base_ns_;
+  // See CaptureOptions.callstack_sample_counts_interval_ns. The samples not
+  // sent yet are counted by beginning of interval and tid, then by callstack
+  // key. Only accessed by SenderThread, but for the reset before it starts.
+  struct PendingSampleCounts {
+    int32_t pid = 0;
+    absl::flat_hash_map<uint64_t, uint32_t> counts_by_callstack_key;
+  };
+  uint64_t callstack_sample_counts_interval_ns_ = 0;
+  absl::flat_hash_map<std::pair<uint64_t, int32_t>, PendingSampleCounts>
+      pending_sample_counts_;
+  // The callstack keys in pending_sample_counts_.
+  absl::flat_hash_set<uint64_t> pending_sample_count_keys_;
+  uint64_t last_counted_sample_timestamp_ns_ = 0;
+  uint64_t counted_sample_count_ = 0;
+  uint64_t sent_sample_counts_count_ = 0;
+  static constexpr size_t MAX_INTERNED_CALLSTACK_COUNT = 256 * 1024;
+  static constexpr size_t MAX_INTERNED_STRING_COUNT = 256 * 1024;
+  InternTable<std::vector<uint64_t>> interned_callstacks_{
+      MAX_INTERNED_CALLSTACK_COUNT};
+  InternTable<std::string> interned_strings_{MAX_INTERNED_STRING_COUNT};
+  uint64_t demangled_string_count_ = 0;
+  uint64_t bytes_sent_ = 0;
+  uint64_t responses_sent_ = 0;
+  // For CaptureStatistics, the values at the time the last one was sent.
+  uint64_t bytes_sent_at_last_statistics_ = 0;
+  absl::Duration write_duration_ = absl::ZeroDuration();
+  absl::Duration write_duration_at_last_statistics_ = absl::ZeroDuration();
+  size_t max_arena_space_used_ = 0;
+
+  // We buffer to avoid sending countless tiny messages, but we also want to
+  // avoid huge messages, which would cause the capture on the client to jump
+  // forward in time in few big steps and not look live anymore. Larger
+  // messages are only used when the stream can't keep up with smaller ones.
+  static constexpr size_t MIN_TARGET_RESPONSE_BYTES = 256 * 1024;
+  static constexpr size_t MAX_TARGET_RESPONSE_BYTES = 16 * 1024 * 1024;
 
-  std::vector<CaptureEvent> event_buffer_;
-  absl::Mutex event_buffer_mutex_;
+  absl::Mutex sender_thread_mutex_;
+  bool sender_thread_stop_requested_ = false;
   std::thread sender_thread_;
 };
 
@@ -30,9 +30,13 @@ class OrbitGrpcServerImpl final : public OrbitGrpcServer {
   void Wait() override;
 
  private:
-  CaptureServiceImpl capture_service_;
+  // Filled by the frame pointer validations, read at the start of captures.
+  std::shared_ptr<FramePointerValidationCache> frame_pointer_validation_cache_ =
+      std::make_shared<FramePointerValidationCache>();
+  CaptureServiceImpl capture_service_{frame_pointer_validation_cache_};
   ProcessServiceImpl process_service_;
-  FramePointerValidatorServiceImpl frame_pointer_validator_service_;
+  FramePointerValidatorServiceImpl frame_pointer_validator_service_{
+      frame_pointer_validation_cache_};
   CrashServiceImpl crash_service_;
   std::unique_ptr<grpc::Server> server_;
 };
@@ -46,6 +50,8 @@ void OrbitGrpcServerImpl::Init(std::string_view server_address) {
   builder.AddListeningPort(std::string(server_address),
                            grpc::InsecureServerCredentials());
   builder.RegisterService(&capture_service_);
+  std::unique_ptr<grpc::ServerCompletionQueue> completion_queue =
+      builder.AddCompletionQueue();
   builder.RegisterService(&process_service_);
   builder.RegisterService(&frame_pointer_validator_service_);
   if (absl::GetFlag(FLAGS_devmode)) {
@@ -53,9 +59,13 @@ void OrbitGrpcServerImpl::Init(std::string_view server_address) {
   }
 
   server_ = builder.BuildAndStart();
+  capture_service_.StartServingCaptures(std::move(completion_queue));
 };
 
-void OrbitGrpcServerImpl::Shutdown() { server_->Shutdown(); }
+void OrbitGrpcServerImpl::Shutdown() {
+  server_->Shutdown();
+  capture_service_.StopServingCaptures();
+}
 
 void OrbitGrpcServerImpl::Wait() { server_->Wait(); }
 
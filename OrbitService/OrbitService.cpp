@@ -11,8 +11,15 @@
 #include <cstdio>
 #include <thread>
 
+#include "ContinuousProfiler.h"
 #include "OrbitBase/Logging.h"
 #include "OrbitGrpcServer.h"
+#include "absl/flags/flag.h"
+
+ABSL_DECLARE_FLAG(std::string, continuous_profiling_directory);
+ABSL_DECLARE_FLAG(double, continuous_profiling_sampling_rate);
+ABSL_DECLARE_FLAG(uint32_t, continuous_profiling_window_s);
+ABSL_DECLARE_FLAG(uint32_t, continuous_profiling_max_files);
 
 static std::string ReadStdIn() {
   int tmp = fgetc(stdin);
@@ -41,11 +48,29 @@ void OrbitService::Run(std::atomic<bool>* exit_requested) {
   std::unique_ptr<OrbitGrpcServer> grpc_server;
   grpc_server = OrbitGrpcServer::Create(grpc_address);
 
+  // As a daemon, the service only exits when requested, not with the ssh
+  // connection of a client.
+  std::unique_ptr<ContinuousProfiler> continuous_profiler;
+  const std::string continuous_profiling_directory =
+      absl::GetFlag(FLAGS_continuous_profiling_directory);
+  if (!continuous_profiling_directory.empty()) {
+    continuous_profiler = std::make_unique<ContinuousProfiler>(
+        continuous_profiling_directory,
+        absl::GetFlag(FLAGS_continuous_profiling_sampling_rate),
+        absl::Seconds(absl::GetFlag(FLAGS_continuous_profiling_window_s)),
+        absl::GetFlag(FLAGS_continuous_profiling_max_files));
+    continuous_profiler->Start();
+  }
+
   // Make stdin non-blocking.
   fcntl(STDIN_FILENO, F_SETFL, O_NONBLOCK);
 
   // Wait for exit_request or for the watchdog to expire.
   while (!(*exit_requested)) {
+    if (continuous_profiler != nullptr) {
+      std::this_thread::sleep_for(std::chrono::seconds{1});
+      continue;
+    }
     std::string stdin_data = ReadStdIn();
     // If ssh sends EOF, end main loop.
     if (feof(stdin)) break;
@@ -65,6 +90,9 @@ void OrbitService::Run(std::atomic<bool>* exit_requested) {
     std::this_thread::sleep_for(std::chrono::seconds{1});
   }
 
+  if (continuous_profiler != nullptr) {
+    continuous_profiler->Stop();
+  }
   grpc_server->Shutdown();
   grpc_server->Wait();
 }
@@ -8,6 +8,7 @@
 #include <absl/strings/numbers.h>
 #include <absl/strings/str_format.h>
 
+#include <algorithm>
 #include <filesystem>
 #include <unordered_map>
 
@@ -26,11 +27,9 @@ outcome::result<void, std::string> ProcessList::Refresh() {
       std::move(cpu_result.value());
 
   std::vector<ProcessInfo> updated_processes;
+  absl::flat_hash_map<int32_t, std::optional<ProcessInfo>>
+      updated_process_infos;
 
-
-  // TODO (161423785) This for loop should be refactored. For example, when
-  // parts are in a separate function, OUTCOME_TRY could be used to simplify
-  // error handling. Also use ErrorMessageOr
   for (const auto& directory_entry :
        std::filesystem::directory_iterator("/proc")) {
     if (!directory_entry.is_directory()) continue;
@@ -41,67 +40,69 @@ outcome::result<void, std::string> ProcessList::Refresh() {
     uint32_t pid;
     if (!absl::SimpleAtoi(folder_name, &pid)) continue;
 
-    auto iter = processes_map_.find(pid);
-    if (iter != processes_map_.end()) {
-      ProcessInfo& process(*(iter->second));
-      process.set_cpu_usage(cpu_usage_map[process.pid()]);
-      updated_processes.push_back(process);
-      continue;
+    auto iter = process_infos_.find(pid);
+    std::optional<ProcessInfo> process_info =
+        iter != process_infos_.end() ? std::move(iter->second)
+                                     : ReadProcessInfo(pid, path);
+    if (process_info.has_value()) {
+      process_info->set_cpu_usage(cpu_usage_map[pid]);
+      updated_processes.push_back(process_info.value());
     }
+    updated_process_infos.emplace(pid, std::move(process_info));
+  }
 
-    const std::filesystem::path name_file_path = path / "comm";
-    const auto name_file_result = OrbitUtils::FileToString(name_file_path);
-    if (!name_file_result) {
-      ERROR("Failed to read %s: %s", name_file_path.string(),
-            name_file_result.error().message());
-      continue;
-    }
-    std::string name = std::move(name_file_result.value());
-    // Remove new line character.
-    absl::StripTrailingAsciiWhitespace(&name);
-    if (name.empty()) continue;
-
-    ProcessInfo process;
-    process.set_pid(pid);
-    process.set_name(name);
-    process.set_cpu_usage(cpu_usage_map[pid]);
-
-    // "The command-line arguments appear [...] as a set of strings
-    // separated by null bytes ('\0')".
-    const std::filesystem::path cmdline_file_path =
-        directory_entry.path() / "cmdline";
-    const auto cmdline_file_result =
-        OrbitUtils::FileToString(cmdline_file_path);
-    if (!cmdline_file_result) {
-      ERROR("Failed to read %s: %s", cmdline_file_path.string(),
-            name_file_result.error().message());
-      continue;
-    }
-    std::string cmdline = std::move(cmdline_file_result.value());
-    std::replace(cmdline.begin(), cmdline.end(), '\0', ' ');
-    process.set_command_line(cmdline);
-
-    const auto& is_64_bit_result = LinuxUtils::Is64Bit(pid);
-    if (!is_64_bit_result) {
-      ERROR("Failed to get if process \"%s\" (pid %d) is 64 bit: %s",
-            name.c_str(), pid, is_64_bit_result.error().message().c_str());
-      continue;
-    }
-    process.set_is_64_bit(is_64_bit_result.value());
+  processes_ = std::move(updated_processes);
+  process_infos_ = std::move(updated_process_infos);
 
-    const auto file_path_result = LinuxUtils::GetExecutablePath(pid);
-    if (file_path_result) {
-      process.set_full_path(std::move(file_path_result.value()));
-    }
+  return outcome::success();
+}
 
-    updated_processes.push_back(process);
+std::optional<ProcessInfo> ProcessList::ReadProcessInfo(
+    int32_t pid, const std::filesystem::path& path) {
+  // TODO (161423785) When the parts of this function are in separate
+  // functions, OUTCOME_TRY could be used to simplify error handling. Also use
+  // ErrorMessageOr
+  const std::filesystem::path name_file_path = path / "comm";
+  const auto name_file_result = OrbitUtils::FileToString(name_file_path);
+  if (!name_file_result) {
+    ERROR("Failed to read %s: %s", name_file_path.string(),
+          name_file_result.error().message());
+    return std::nullopt;
+  }
+  std::string name = std::move(name_file_result.value());
+  // Remove new line character.
+  absl::StripTrailingAsciiWhitespace(&name);
+  if (name.empty()) return std::nullopt;
+
+  ProcessInfo process;
+  process.set_pid(pid);
+  process.set_name(name);
+
+  // "The command-line arguments appear [...] as a set of strings
+  // separated by null bytes ('\0')".
+  const std::filesystem::path cmdline_file_path = path / "cmdline";
+  const auto cmdline_file_result = OrbitUtils::FileToString(cmdline_file_path);
+  if (!cmdline_file_result) {
+    ERROR("Failed to read %s: %s", cmdline_file_path.string(),
+          cmdline_file_result.error().message());
+    return std::nullopt;
   }
+  std::string cmdline = std::move(cmdline_file_result.value());
+  std::replace(cmdline.begin(), cmdline.end(), '\0', ' ');
+  process.set_command_line(cmdline);
+
+  const auto& is_64_bit_result = LinuxUtils::Is64Bit(pid);
+  if (!is_64_bit_result) {
+    ERROR("Failed to get if process \"%s\" (pid %d) is 64 bit: %s",
+          name.c_str(), pid, is_64_bit_result.error().message().c_str());
+    return std::nullopt;
+  }
+  process.set_is_64_bit(is_64_bit_result.value());
 
-  processes_ = std::move(updated_processes);
-  processes_map_.clear();
-  for (auto& process : processes_) {
-    processes_map_[process.pid()] = &process;
+  const auto file_path_result = LinuxUtils::GetExecutablePath(pid);
+  if (file_path_result) {
+    process.set_full_path(std::move(file_path_result.value()));
   }
 
-  return outcome::success();
+  return process;
 }
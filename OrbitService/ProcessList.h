@@ -5,6 +5,10 @@
 #ifndef ORBIT_SERVICE_PROCESS_LIST_
 #define ORBIT_SERVICE_PROCESS_LIST_
 
+#include <absl/container/flat_hash_map.h>
+
+#include <filesystem>
+#include <optional>
 #include <outcome.hpp>
 #include <vector>
 
@@ -13,11 +17,19 @@
 class ProcessList {
  public:
   outcome::result<void, std::string> Refresh();
-  const std::vector<ProcessInfo>& GetProcesses() { return processes_; }
+  const std::vector<ProcessInfo>& GetProcesses() const { return processes_; }
 
  private:
+  // Reads what doesn't change during the lifetime of a process, or nullopt if
+  // that fails.
+  static std::optional<ProcessInfo> ReadProcessInfo(
+      int32_t pid, const std::filesystem::path& path);
+
   std::vector<ProcessInfo> processes_;
-  std::unordered_map<int32_t, ProcessInfo*> processes_map_;
+  // The processes of the last refresh, nullopt for those that couldn't be
+  // read, so that a refresh only reads the new processes, and doesn't try the
+  // others again, which can take a command per process.
+  absl::flat_hash_map<int32_t, std::optional<ProcessInfo>> process_infos_;
 };
 
 #endif  // ORBIT_SERVICE_PROCESS_LIST_
@@ -4,28 +4,84 @@
 
 #include "ProcessServiceImpl.h"
 
+#include <absl/container/flat_hash_map.h>
+#include <absl/time/clock.h>
+
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cerrno>
 #include <memory>
+#include <vector>
 
 #include "LinuxUtils.h"
 #include "OrbitBase/Logging.h"
+#include "OrbitBase/SafeStrerror.h"
 #include "SymbolHelper.h"
 #include "Utils.h"
 #include "symbol.pb.h"
 
 using grpc::ServerContext;
+using grpc::ServerWriter;
 using grpc::Status;
 using grpc::StatusCode;
 
+namespace {
+// Reads the ranges [begin, end) into response, with a single process_vm_readv
+// unless some of the ranges can't be read. As process_vm_readv stops at the
+// first range that it can't read, the following ones are read again with
+// another call.
+ErrorMessageOr<void> ReadRanges(
+    int32_t pid, const google::protobuf::RepeatedPtrField<MemoryRange>& ranges,
+    int begin, int end, uint64_t max_range_size,
+    ReadProcessMemoryRangesResponse* response) {
+  std::vector<iovec> local_iov;
+  std::vector<iovec> remote_iov;
+  for (int i = begin; i < end; ++i) {
+    const uint64_t size = std::min(ranges[i].size(), max_range_size);
+    RangeMemory* range_memory = response->add_ranges();
+    range_memory->set_range_index(i);
+    range_memory->mutable_memory()->resize(size);
+    local_iov.push_back({range_memory->mutable_memory()->data(), size});
+    remote_iov.push_back(
+        {reinterpret_cast<void*>(ranges[i].address()), size});
+  }
+
+  size_t next = 0;
+  while (next < local_iov.size()) {
+    const size_t count = local_iov.size() - next;
+    const ssize_t result = process_vm_readv(pid, &local_iov[next], count,
+                                            &remote_iov[next], count, 0);
+    // EFAULT only means that the first range can't be read.
+    if (result == -1 && errno != EFAULT) {
+      return ErrorMessage(
+          absl::StrFormat("Could not read the memory of process %d: %s", pid,
+                          SafeStrerror(errno)));
+    }
+    size_t remaining_bytes = result == -1 ? 0 : result;
+    while (next < local_iov.size() &&
+           remaining_bytes >= local_iov[next].iov_len) {
+      remaining_bytes -= local_iov[next].iov_len;
+      ++next;
+    }
+    if (next < local_iov.size()) {
+      response->mutable_ranges(next)->mutable_memory()->resize(
+          remaining_bytes);
+      ++next;
+    }
+  }
+  return outcome::success();
+}
+}  // namespace
+
 Status ProcessServiceImpl::GetProcessList(ServerContext*,
                                           const GetProcessListRequest*,
                                           GetProcessListResponse* response) {
-  {
-    absl::MutexLock lock(&mutex_);
+  absl::MutexLock lock(&mutex_);
 
-    const auto refresh_result = process_list_.Refresh();
-    if (!refresh_result) {
-      return Status(StatusCode::INTERNAL, refresh_result.error());
-    }
+  const auto refresh_result = RefreshProcessList(absl::ZeroDuration());
+  if (!refresh_result) {
+    return Status(StatusCode::INTERNAL, refresh_result.error());
   }
 
   const std::vector<ProcessInfo>& processes = process_list_.GetProcesses();
@@ -33,28 +89,142 @@ Status ProcessServiceImpl::GetProcessList(ServerContext*,
     return Status(StatusCode::NOT_FOUND, "Error while getting processes.");
   }
 
-  for (const auto& process_info : process_list_.GetProcesses()) {
+  for (const auto& process_info : processes) {
     *(response->add_processes()) = process_info;
   }
 
   return Status::OK;
 }
 
+Status ProcessServiceImpl::WatchProcessList(
+    ServerContext* context, const WatchProcessListRequest* request,
+    ServerWriter<WatchProcessListResponse>* writer) {
+  const absl::Duration refresh_interval =
+      request->refresh_interval_ms() > 0
+          ? absl::Milliseconds(request->refresh_interval_ms())
+          : kDefaultWatchRefreshInterval;
+  // The processes that the client knows of, with the cpu usage it last got.
+  absl::flat_hash_map<int32_t, double> sent_cpu_usages;
+  bool is_first_response = true;
+
+  while (!context->IsCancelled()) {
+    WatchProcessListResponse response;
+    {
+      absl::MutexLock lock(&mutex_);
+      // Watchers that refresh at about the same time share the refresh.
+      const auto refresh_result = RefreshProcessList(refresh_interval / 2);
+      if (!refresh_result) {
+        return Status(StatusCode::INTERNAL, refresh_result.error());
+      }
+
+      absl::flat_hash_map<int32_t, double> cpu_usages;
+      for (const ProcessInfo& process : process_list_.GetProcesses()) {
+        cpu_usages.emplace(process.pid(), process.cpu_usage());
+        auto sent_it = sent_cpu_usages.find(process.pid());
+        if (sent_it == sent_cpu_usages.end()) {
+          *response.add_added_processes() = process;
+        } else if (sent_it->second != process.cpu_usage()) {
+          ProcessCpuUsage* update = response.add_cpu_usage_updates();
+          update->set_pid(process.pid());
+          update->set_cpu_usage(process.cpu_usage());
+        }
+      }
+      for (const auto& [pid, cpu_usage] : sent_cpu_usages) {
+        if (!cpu_usages.contains(pid)) {
+          response.add_removed_pids(pid);
+        }
+      }
+      sent_cpu_usages = std::move(cpu_usages);
+    }
+
+    if (is_first_response || response.added_processes_size() > 0 ||
+        response.removed_pids_size() > 0 ||
+        response.cpu_usage_updates_size() > 0) {
+      if (!writer->Write(response)) {
+        // The client is gone.
+        break;
+      }
+      is_first_response = false;
+    }
+
+    // Sleeps in short steps, to notice soon when the call is canceled.
+    const absl::Time next_refresh_time = absl::Now() + refresh_interval;
+    while (!context->IsCancelled() && absl::Now() < next_refresh_time) {
+      absl::SleepFor(std::min(kWatchCancelationCheckInterval,
+                              next_refresh_time - absl::Now()));
+    }
+  }
+
+  return Status::OK;
+}
+
+outcome::result<void, std::string> ProcessServiceImpl::RefreshProcessList(
+    absl::Duration max_age) {
+  const absl::Time now = absl::Now();
+  if (now - last_refresh_time_ < max_age) {
+    return outcome::success();
+  }
+  OUTCOME_TRY(process_list_.Refresh());
+  last_refresh_time_ = now;
+  return outcome::success();
+}
+
 Status ProcessServiceImpl::GetModuleList(ServerContext*,
                                          const GetModuleListRequest* request,
                                          GetModuleListResponse* response) {
   int32_t pid = request->process_id();
   LOG("Sending modules for process %d", pid);
 
-  const auto module_infos = LinuxUtils::ListModules(pid);
+  const auto module_infos =
+      LinuxUtils::ListModules(pid, &module_build_id_cache_);
   if (!module_infos) {
+    absl::MutexLock lock(&module_lists_mutex_);
+    module_lists_.erase(pid);
     return Status(StatusCode::NOT_FOUND, module_infos.error().message());
   }
 
-  for (const auto& module_info : module_infos.value()) {
-    *(response->add_modules()) = module_info;
+  // The version is a hash of the list, so that a client only gets the changes
+  // since a list with the same content, even across restarts of the service.
+  ModuleList module_list;
+  std::string serialized_modules;
+  for (const ModuleInfo& module_info : module_infos.value()) {
+    serialized_modules.append(module_info.SerializeAsString());
+    module_list.modules_by_address_start.emplace(module_info.address_start(),
+                                                 module_info);
+  }
+  module_list.version = std::max<uint64_t>(StringHash(serialized_modules), 1);
+  response->set_modules_version(module_list.version);
+
+  absl::MutexLock lock(&module_lists_mutex_);
+  auto previous_it = module_lists_.find(pid);
+  if (request->known_modules_version() != 0 &&
+      previous_it != module_lists_.end() &&
+      previous_it->second.version == request->known_modules_version()) {
+    const auto& previous_modules = previous_it->second.modules_by_address_start;
+    response->set_is_incremental(true);
+    for (const ModuleInfo& module_info : module_infos.value()) {
+      auto it = previous_modules.find(module_info.address_start());
+      if (it == previous_modules.end() ||
+          it->second.SerializeAsString() != module_info.SerializeAsString()) {
+        *(response->add_modules()) = module_info;
+      }
+    }
+    for (const auto& [address_start, module_info] : previous_modules) {
+      if (!module_list.modules_by_address_start.contains(address_start)) {
+        response->add_removed_module_address_starts(address_start);
+      }
+    }
+  } else {
+    for (const auto& module_info : module_infos.value()) {
+      *(response->add_modules()) = module_info;
+    }
   }
 
+  if (previous_it == module_lists_.end() &&
+      module_lists_.size() >= kMaxModuleLists) {
+    module_lists_.clear();
+  }
+  module_lists_.insert_or_assign(pid, std::move(module_list));
   return Status::OK;
 }
 
@@ -82,6 +252,48 @@ Status ProcessServiceImpl::GetProcessMemory(
   }
 }
 
+Status ProcessServiceImpl::ReadProcessMemoryRanges(
+    ServerContext* context, const ReadProcessMemoryRangesRequest* request,
+    ServerWriter<ReadProcessMemoryRangesResponse>* writer) {
+  const auto& ranges = request->ranges();
+  int begin = 0;
+  while (begin < ranges.size()) {
+    if (context->IsCancelled()) {
+      return Status::CANCELLED;
+    }
+
+    // As many ranges as fit in a response, and in one process_vm_readv.
+    int end = begin;
+    uint64_t response_size = 0;
+    while (end < ranges.size() && end - begin < kMaxRangesPerRead) {
+      const uint64_t size =
+          std::min(ranges[end].size(), kMaxGetProcessMemoryResponseSize);
+      if (end > begin &&
+          response_size + size > kMaxGetProcessMemoryResponseSize) {
+        break;
+      }
+      response_size += size;
+      ++end;
+    }
+
+    ReadProcessMemoryRangesResponse response;
+    ErrorMessageOr<void> result =
+        ReadRanges(request->pid(), ranges, begin, end,
+                   kMaxGetProcessMemoryResponseSize, &response);
+    if (!result) {
+      ERROR("ReadProcessMemoryRanges: %s", result.error().message());
+      return Status(StatusCode::PERMISSION_DENIED, result.error().message());
+    }
+    if (!writer->Write(response)) {
+      // The client is gone.
+      return Status::CANCELLED;
+    }
+    begin = end;
+  }
+
+  return Status::OK;
+}
+
 Status ProcessServiceImpl::GetDebugInfoFile(
     ::grpc::ServerContext*, const ::GetDebugInfoFileRequest* request,
     ::GetDebugInfoFileResponse* response) {
@@ -96,3 +308,46 @@ Status ProcessServiceImpl::GetDebugInfoFile(
 
   return Status::OK;
 }
+
+Status ProcessServiceImpl::GetModuleSymbols(
+    ServerContext* context, const GetModuleSymbolsRequest* request,
+    ServerWriter<GetModuleSymbolsResponse>* writer) {
+  const SymbolHelper symbol_helper;
+  ErrorMessageOr<std::string> debug_info_file_path =
+      symbol_helper.FindDebugSymbolsFile(request->module_path(),
+                                         request->build_id());
+  if (!debug_info_file_path) {
+    return Status(StatusCode::NOT_FOUND,
+                  debug_info_file_path.error().message());
+  }
+  ErrorMessageOr<ModuleSymbols> module_symbols =
+      symbol_helper.LoadSymbolsFromFile(debug_info_file_path.value(),
+                                        request->build_id());
+  if (!module_symbols) {
+    return Status(StatusCode::INTERNAL, module_symbols.error().message());
+  }
+
+  // Names of symbols share long prefixes, and compress well.
+  context->set_compression_algorithm(GRPC_COMPRESS_GZIP);
+  auto* symbol_infos = module_symbols.value().mutable_symbol_infos();
+  int begin = 0;
+  do {
+    GetModuleSymbolsResponse response;
+    ModuleSymbols* response_symbols = response.mutable_module_symbols();
+    response_symbols->set_load_bias(module_symbols.value().load_bias());
+    response_symbols->set_symbols_file_path(
+        module_symbols.value().symbols_file_path());
+    const int end = std::min(symbol_infos->size(), begin + kSymbolsPerResponse);
+    for (int i = begin; i < end; ++i) {
+      *response_symbols->add_symbol_infos() =
+          std::move(*symbol_infos->Mutable(i));
+    }
+    if (!writer->Write(response)) {
+      // The client is gone.
+      return Status::CANCELLED;
+    }
+    begin = end;
+  } while (begin < symbol_infos->size());
+
+  return Status::OK;
+}
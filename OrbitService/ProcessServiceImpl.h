@@ -6,11 +6,14 @@
 #define ORBIT_SERVICE_PROCESS_SERVICE_IMPL_H_
 
 #include <absl/synchronization/mutex.h>
+#include <absl/time/time.h>
 
 #include <memory>
 #include <string>
 
+#include "LinuxUtils.h"
 #include "ProcessList.h"
+#include "absl/container/flat_hash_map.h"
 #include "services.grpc.pb.h"
 
 class ProcessServiceImpl final : public ProcessService::Service {
@@ -19,6 +22,10 @@ class ProcessServiceImpl final : public ProcessService::Service {
                               const GetProcessListRequest* request,
                               GetProcessListResponse* response) override;
 
+  grpc::Status WatchProcessList(
+      grpc::ServerContext* context, const WatchProcessListRequest* request,
+      grpc::ServerWriter<WatchProcessListResponse>* writer) override;
+
   grpc::Status GetModuleList(grpc::ServerContext* context,
                              const GetModuleListRequest* request,
                              GetModuleListResponse* response) override;
@@ -27,15 +34,54 @@ class ProcessServiceImpl final : public ProcessService::Service {
                                 const GetProcessMemoryRequest* request,
                                 GetProcessMemoryResponse* response) override;
 
+  grpc::Status ReadProcessMemoryRanges(
+      grpc::ServerContext* context,
+      const ReadProcessMemoryRangesRequest* request,
+      grpc::ServerWriter<ReadProcessMemoryRangesResponse>* writer) override;
+
   grpc::Status GetDebugInfoFile(grpc::ServerContext* context,
                                 const GetDebugInfoFileRequest* request,
                                 GetDebugInfoFileResponse* response) override;
 
+  grpc::Status GetModuleSymbols(
+      grpc::ServerContext* context, const GetModuleSymbolsRequest* request,
+      grpc::ServerWriter<GetModuleSymbolsResponse>* writer) override;
+
  private:
+  // Refreshes the list of processes, unless the last refresh is more recent
+  // than max_age, so that the watchers and the callers of GetProcessList share
+  // the refreshes.
+  outcome::result<void, std::string> RefreshProcessList(absl::Duration max_age)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   absl::Mutex mutex_;
-  ProcessList process_list_;
+  ProcessList process_list_ ABSL_GUARDED_BY(mutex_);
+  absl::Time last_refresh_time_ ABSL_GUARDED_BY(mutex_) = absl::InfinitePast();
+
+  LinuxUtils::ModuleBuildIdCache module_build_id_cache_;
+  // The latest list of modules sent for each process, from which the next
+  // response for the process only sends the changes.
+  struct ModuleList {
+    uint64_t version = 0;
+    absl::flat_hash_map<uint64_t, ModuleInfo> modules_by_address_start;
+  };
+  absl::Mutex module_lists_mutex_;
+  absl::flat_hash_map<int32_t, ModuleList> module_lists_
+      ABSL_GUARDED_BY(module_lists_mutex_);
 
   static constexpr size_t kMaxGetProcessMemoryResponseSize = 8 * 1024 * 1024;
+  // The lists of the processes that exited are only dropped once there are
+  // this many.
+  static constexpr size_t kMaxModuleLists = 256;
+  // The limit of process_vm_readv, IOV_MAX.
+  static constexpr int kMaxRangesPerRead = 1024;
+  // Keeps the responses of GetModuleSymbols well below the limit of gRPC on
+  // the size of a message, even for long names.
+  static constexpr int kSymbolsPerResponse = 4096;
+  static constexpr absl::Duration kDefaultWatchRefreshInterval =
+      absl::Seconds(1);
+  static constexpr absl::Duration kWatchCancelationCheckInterval =
+      absl::Milliseconds(100);
 };
 
 #endif  // ORBIT_SERVICE_PROCESS_SERVICE_IMPL_H_
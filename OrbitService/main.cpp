@@ -4,6 +4,7 @@
 
 #include <csignal>
 #include <iostream>
+#include <string>
 
 #include "OrbitBase/Logging.h"
 #include "OrbitService.h"
@@ -18,11 +19,39 @@ ABSL_FLAG(uint64_t, grpc_port, 44765, "Grpc server port");
 
 ABSL_FLAG(bool, devmode, false, "Enable developer mode");
 
+ABSL_FLAG(bool, pin_service_threads, false,
+          "Run the threads of the service on service_cpus during captures");
+ABSL_FLAG(std::string, service_cpus, "",
+          "The cpus for --pin_service_threads, e.g., \"0-2,7\". By default, "
+          "the cpus outside the cpusets of the captured processes");
+ABSL_FLAG(double, max_cpu_usage, 0,
+          "Maximum CPU usage of the service during captures, as a fraction "
+          "of one core, e.g., 0.05. The captures give up fidelity to stay "
+          "within it. 0 means no limit");
+ABSL_FLAG(std::string, record_perf_events, "",
+          "Also write the perf_event_open records of each capture to this "
+          "file, with copies of the mapped executable files, to be replayed "
+          "with PerfRecordingReplay");
+ABSL_FLAG(std::string, continuous_profiling_directory, "",
+          "Profile all processes for as long as the service runs, at "
+          "--continuous_profiling_sampling_rate, and write the profile of "
+          "each window of --continuous_profiling_window_s to this directory. "
+          "The service then keeps running when its stdin is closed");
+ABSL_FLAG(double, continuous_profiling_sampling_rate, 10,
+          "Samples per second of each thread with "
+          "--continuous_profiling_directory");
+ABSL_FLAG(uint32_t, continuous_profiling_window_s, 60,
+          "Duration in seconds of each profile written to "
+          "--continuous_profiling_directory");
+ABSL_FLAG(uint32_t, continuous_profiling_max_files, 1440,
+          "Number of most recent profiles kept in "
+          "--continuous_profiling_directory");
+
 namespace {
 std::atomic<bool> exit_requested;
 
 void sigint_handler(int signum) {
-  if (signum == SIGINT) {
+  if (signum == SIGINT || signum == SIGTERM) {
     exit_requested = true;
   }
 }
@@ -34,6 +63,8 @@ void install_sigint_handler() {
   act.sa_flags = 0;
   act.sa_restorer = nullptr;
   sigaction(SIGINT, &act, nullptr);
+  // As sent by the init system to the service running as a daemon.
+  sigaction(SIGTERM, &act, nullptr);
 }
 }  // namespace
 
@@ -148,4 +148,21 @@ bool Channel::GetRemoteEOF() {
   return libssh2_channel_eof(raw_channel_ptr_.get()) == 1;
 }
 
+uint32_t Channel::GetReceiveWindowSize() {
+  return libssh2_channel_window_read_ex(raw_channel_ptr_.get(), nullptr,
+                                        nullptr);
+}
+
+outcome::result<void> Channel::AdjustReceiveWindow(uint32_t adjustment) {
+  unsigned int window_size = 0;
+  const int rc = libssh2_channel_receive_window_adjust2(
+      raw_channel_ptr_.get(), adjustment, /*force=*/1, &window_size);
+
+  if (rc == 0) {
+    return outcome::success();
+  } else {
+    return static_cast<Error>(rc);
+  }
+}
+
 }  // namespace OrbitSsh
@@ -7,6 +7,7 @@
 
 #include <libssh2.h>
 
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <outcome.hpp>
@@ -40,6 +41,14 @@ class Channel {
   int GetExitStatus();
   bool GetRemoteEOF();
 
+  // The number of bytes the remote may still send before the window needs to
+  // be adjusted.
+  uint32_t GetReceiveWindowSize();
+  // Lets the remote send adjustment more bytes without waiting for the data in
+  // flight to be read, which bounds the throughput of the channel on links
+  // with a long round trip.
+  outcome::result<void> AdjustReceiveWindow(uint32_t adjustment);
+
  private:
   explicit Channel(LIBSSH2_CHANNEL* raw_channel_ptr);
   std::unique_ptr<LIBSSH2_CHANNEL, decltype(&libssh2_channel_free)>
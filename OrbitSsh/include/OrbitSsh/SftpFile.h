@@ -26,14 +26,29 @@ constexpr inline FxfFlags operator|(FxfFlags lhs, FxfFlags rhs) {
   return static_cast<FxfFlags>(static_cast<T>(lhs) | static_cast<T>(rhs));
 }
 
+// How much data a transfer hands to SftpFile::Read or Write per call.
+// libssh2 splits a call into requests of ~30 KiB and sends all of them
+// before waiting for the first reply, so window_size is how much is in
+// flight at once, which hides the latency of the connection. chunk_size is
+// how much of a local file is read at once to fill the window.
+struct SftpTransferOptions {
+  size_t chunk_size = 256 * 1024;
+  size_t window_size = 4 * 1024 * 1024;
+};
+
 class SftpFile {
  public:
   static outcome::result<SftpFile> Open(Session* session, Sftp* sftp,
                                         std::string_view filepath,
                                         FxfFlags flags, long mode);
 
+  // Reads ahead up to max_length_in_bytes with several requests at once.
   outcome::result<std::string> Read(size_t max_length_in_bytes);
   outcome::result<void> Close();
+  // Returns how many bytes from the start of data were written, which can be
+  // fewer than sent. When it returns fewer than data.size(), or EAGAIN, the
+  // next call must start with the bytes that weren't written yet, as libssh2
+  // keeps track of the requests that are in flight.
   outcome::result<size_t> Write(std::string_view data);
 
   LIBSSH2_SFTP_HANDLE* GetRawFilePtr() const noexcept {
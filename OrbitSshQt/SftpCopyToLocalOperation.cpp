@@ -6,9 +6,10 @@
 
 namespace OrbitSshQt {
 
-SftpCopyToLocalOperation::SftpCopyToLocalOperation(Session* session,
-                                                   SftpChannel* channel)
-    : session_(session), channel_(channel) {
+SftpCopyToLocalOperation::SftpCopyToLocalOperation(
+    Session* session, SftpChannel* channel,
+    OrbitSsh::SftpTransferOptions options)
+    : session_(session), options_(options), channel_(channel) {
   about_to_shutdown_connection_.emplace(
       QObject::connect(channel_, &SftpChannel::aboutToShutdown, this,
                        &SftpCopyToLocalOperation::HandleChannelShutdown));
@@ -18,6 +19,7 @@ void SftpCopyToLocalOperation::CopyFileToLocal(
     std::filesystem::path source, std::filesystem::path destination) {
   source_ = std::move(source);
   destination_ = std::move(destination);
+  bytes_transferred_ = 0;
 
   SetState(State::kNoOperation);
   OnEvent();
@@ -60,10 +62,9 @@ outcome::result<void> SftpCopyToLocalOperation::startup() {
       ABSL_FALLTHROUGH_INTENDED;
     }
     case State::kLocalFileOpened: {
-      constexpr size_t kReadBufferMaxSize = 1 * 1024 * 1024;
-
       while (true) {
-        OUTCOME_TRY(read_buffer, sftp_file_->Read(kReadBufferMaxSize));
+        // libssh2 reads ahead as much as the buffer holds.
+        OUTCOME_TRY(read_buffer, sftp_file_->Read(options_.window_size));
         if (read_buffer.empty()) {
           // This is end of file
           SetState(State::kLocalFileWritten);
@@ -71,6 +72,8 @@ outcome::result<void> SftpCopyToLocalOperation::startup() {
         }
 
         local_file_.write(read_buffer.data(), read_buffer.size());
+        bytes_transferred_ += read_buffer.size();
+        emit progress(bytes_transferred_);
       }
       ABSL_FALLTHROUGH_INTENDED;
     }
@@ -4,13 +4,16 @@
 
 #include "OrbitSshQt/SftpCopyToRemoteOperation.h"
 
+#include <algorithm>
+
 #include "OrbitBase/Logging.h"
 
 namespace OrbitSshQt {
 
-SftpCopyToRemoteOperation::SftpCopyToRemoteOperation(Session* session,
-                                                     SftpChannel* channel)
-    : session_(session), channel_(channel) {
+SftpCopyToRemoteOperation::SftpCopyToRemoteOperation(
+    Session* session, SftpChannel* channel,
+    OrbitSsh::SftpTransferOptions options)
+    : session_(session), options_(options), channel_(channel) {
   about_to_shutdown_connection_.emplace(
       QObject::connect(channel_, &SftpChannel::aboutToShutdown, this,
                        &SftpCopyToRemoteOperation::HandleChannelShutdown));
@@ -22,6 +25,7 @@ void SftpCopyToRemoteOperation::CopyFileToRemote(
   source_ = std::move(source);
   destination_ = std::move(destination);
   destination_mode_ = destination_mode;
+  bytes_transferred_ = 0;
 
   SetState(State::kNoOperation);
   OnEvent();
@@ -67,8 +71,15 @@ outcome::result<void> SftpCopyToRemoteOperation::startup() {
     }
     case State::kRemoteFileOpened: {
       while (true) {
-        if (!local_file_.atEnd() && write_buffer_.size() < 32 * 1024) {
-          write_buffer_.append(local_file_.read(56 * 1024));
+        // The whole window is handed to libssh2, which keeps that much in
+        // flight.
+        while (!local_file_.atEnd() &&
+               static_cast<size_t>(write_buffer_.size()) <
+                   options_.window_size) {
+          const size_t free_window_size =
+              options_.window_size - static_cast<size_t>(write_buffer_.size());
+          write_buffer_.append(local_file_.read(
+              std::min(options_.chunk_size, free_window_size)));
         }
 
         OUTCOME_TRY(bytes_written,
@@ -77,6 +88,10 @@ outcome::result<void> SftpCopyToRemoteOperation::startup() {
                         static_cast<size_t>(write_buffer_.size())}));
 
         write_buffer_.remove(0, bytes_written);
+        if (bytes_written > 0) {
+          bytes_transferred_ += bytes_written;
+          emit progress(bytes_transferred_);
+        }
 
         if (local_file_.atEnd() && write_buffer_.isEmpty()) {
           SetState(State::kRemoteFileWritten);
@@ -8,6 +8,15 @@
 
 #include "OrbitBase/Logging.h"
 #include "OrbitSshQt/Error.h"
+#include "absl/time/clock.h"
+
+namespace {
+constexpr absl::Duration kThroughputLogInterval = absl::Seconds(10);
+
+double ToMebibytes(uint64_t bytes) {
+  return static_cast<double>(bytes) / (1024 * 1024);
+}
+}  // namespace
 
 /**
  * Schedules a task in the currently running event loop.
@@ -29,10 +38,12 @@ static void deleteByEventLoop(P* parent, std::optional<T>* opt) {
 }
 
 namespace OrbitSshQt {
-Tunnel::Tunnel(Session* session, std::string remote_host, uint16_t remote_port)
+Tunnel::Tunnel(Session* session, std::string remote_host, uint16_t remote_port,
+               TunnelOptions options)
     : session_(session),
       remote_host_(std::move(remote_host)),
-      remote_port_(remote_port) {
+      remote_port_(remote_port),
+      options_(options) {
   about_to_shutdown_connection_.emplace(
       QObject::connect(session_, &Session::aboutToShutdown, this,
                        &Tunnel::HandleSessionShutdown));
@@ -79,6 +90,15 @@ outcome::result<void> Tunnel::startup() {
       ABSL_FALLTHROUGH_INTENDED;
     }
     case State::kChannelInitialized: {
+      const uint32_t window_size = channel_->GetReceiveWindowSize();
+      if (window_size < options_.receive_window_size) {
+        OUTCOME_TRY(channel_->AdjustReceiveWindow(options_.receive_window_size -
+                                                  window_size));
+      }
+      SetState(State::kWindowAdjusted);
+      ABSL_FALLTHROUGH_INTENDED;
+    }
+    case State::kWindowAdjusted: {
       local_server_.emplace();
       const auto result = local_server_->listen();
 
@@ -121,6 +141,7 @@ outcome::result<void> Tunnel::shutdown() {
     case State::kInitial:
     case State::kNoChannel:
     case State::kChannelInitialized:
+    case State::kWindowAdjusted:
     case State::kStarted:
     case State::kServerListening:
       UNREACHABLE();
@@ -146,6 +167,10 @@ outcome::result<void> Tunnel::shutdown() {
     case State::kWaitRemoteClosed: {
       OUTCOME_TRY(channel_->WaitClosed());
       SetState(State::kDone);
+      LOG("Tunnel to %s:%d closed after receiving %.1f MiB and sending %.1f "
+          "MiB",
+          remote_host_, remote_port_, ToMebibytes(bytes_received_),
+          ToMebibytes(bytes_sent_));
       data_event_connection_ = std::nullopt;
       about_to_shutdown_connection_ = std::nullopt;
       channel_ = std::nullopt;
@@ -162,8 +187,8 @@ outcome::result<void> Tunnel::shutdown() {
 
 outcome::result<void> Tunnel::readFromChannel() {
   while (true) {
-    const size_t kChunkSize = 8192;
-    const auto result = channel_->ReadStdOut(kChunkSize);
+    const auto result =
+        channel_->ReadStdOut(static_cast<int>(options_.read_chunk_size));
 
     if (!result && !OrbitSsh::shouldITryAgain(result)) {
       return outcome::failure(result.error());
@@ -175,6 +200,7 @@ outcome::result<void> Tunnel::readFromChannel() {
       // Empty result means remote socket was closed.
       return Error::kRemoteSocketClosed;
     } else if (result) {
+      bytes_received_ += result.value().size();
       read_buffer_.append(result.value());
     }
   }
@@ -186,17 +212,19 @@ outcome::result<void> Tunnel::readFromChannel() {
     if (bytes_written == -1) {
       SetError(Error::kLocalSocketClosed);
     } else {
-      read_buffer_ = read_buffer_.substr(bytes_written);
+      read_buffer_.erase(0, bytes_written);
     }
   }
 
+  LogThroughputIfDue();
   return outcome::success();
 }
 
 outcome::result<void> Tunnel::writeToChannel() {
   if (!write_buffer_.empty()) {
     OUTCOME_TRY(bytes_written, channel_->Write(write_buffer_));
-    write_buffer_ = write_buffer_.substr(bytes_written);
+    bytes_sent_ += bytes_written;
+    write_buffer_.erase(0, bytes_written);
   }
   return outcome::success();
 }
@@ -240,6 +268,26 @@ void Tunnel::HandleSessionShutdown() {
   }
 }
 
+void Tunnel::LogThroughputIfDue() {
+  const absl::Time now = absl::Now();
+  const absl::Duration duration = now - last_throughput_log_time_;
+  if (duration < kThroughputLogInterval) return;
+
+  const uint64_t received = bytes_received_ - bytes_received_at_last_log_;
+  const uint64_t sent = bytes_sent_ - bytes_sent_at_last_log_;
+  if (received != 0 || sent != 0) {
+    const double seconds = absl::ToDoubleSeconds(duration);
+    LOG("Tunnel to %s:%d: received %.1f MiB (%.2f MiB/s), sent %.1f MiB (%.2f "
+        "MiB/s) in the last %.0f s",
+        remote_host_, remote_port_, ToMebibytes(received),
+        ToMebibytes(received) / seconds, ToMebibytes(sent),
+        ToMebibytes(sent) / seconds, seconds);
+  }
+  last_throughput_log_time_ = now;
+  bytes_received_at_last_log_ = bytes_received_;
+  bytes_sent_at_last_log_ = bytes_sent_;
+}
+
 void Tunnel::HandleEagain() {
   if (session_) {
     session_->HandleEagain();
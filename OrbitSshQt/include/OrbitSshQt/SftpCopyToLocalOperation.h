@@ -46,7 +46,9 @@ class SftpCopyToLocalOperation
   friend StateMachineHelper;
 
  public:
-  explicit SftpCopyToLocalOperation(Session* session, SftpChannel* channel);
+  explicit SftpCopyToLocalOperation(
+      Session* session, SftpChannel* channel,
+      OrbitSsh::SftpTransferOptions options = {});
 
   void CopyFileToLocal(std::filesystem::path source,
                        std::filesystem::path destination);
@@ -56,9 +58,12 @@ class SftpCopyToLocalOperation
   void stopped();
   void aboutToShutdown();
   void errorOccurred(std::error_code);
+  // The number of bytes of the file copied so far.
+  void progress(uint64_t bytes_transferred);
 
  private:
   QPointer<Session> session_;
+  OrbitSsh::SftpTransferOptions options_;
 
   std::optional<ScopedConnection> data_event_connection_;
   std::optional<ScopedConnection> about_to_shutdown_connection_;
@@ -66,6 +71,7 @@ class SftpCopyToLocalOperation
   QPointer<SftpChannel> channel_;
   std::optional<OrbitSsh::SftpFile> sftp_file_;
   QFile local_file_;
+  uint64_t bytes_transferred_ = 0;
 
   std::filesystem::path source_;
   std::filesystem::path destination_;
@@ -52,7 +52,9 @@ class SftpCopyToRemoteOperation
     kUserWritableAllExecutable = 0755
   };
 
-  explicit SftpCopyToRemoteOperation(Session* session, SftpChannel* channel);
+  explicit SftpCopyToRemoteOperation(
+      Session* session, SftpChannel* channel,
+      OrbitSsh::SftpTransferOptions options = {});
 
   void CopyFileToRemote(std::filesystem::path source,
                         std::filesystem::path destination,
@@ -63,9 +65,12 @@ class SftpCopyToRemoteOperation
   void stopped();
   void aboutToShutdown();
   void errorOccurred(std::error_code);
+  // The number of bytes of the file copied so far.
+  void progress(uint64_t bytes_transferred);
 
  private:
   QPointer<Session> session_;
+  OrbitSsh::SftpTransferOptions options_;
 
   std::optional<ScopedConnection> data_event_connection_;
   std::optional<ScopedConnection> about_to_shutdown_connection_;
@@ -74,6 +79,7 @@ class SftpCopyToRemoteOperation
   std::optional<OrbitSsh::SftpFile> sftp_file_;
   QFile local_file_;
   QByteArray write_buffer_;
+  uint64_t bytes_transferred_ = 0;
 
   std::filesystem::path source_;
   std::filesystem::path destination_;
@@ -9,9 +9,12 @@
 #include <QPointer>
 #include <QTcpServer>
 #include <QTcpSocket>
+#include <cstdint>
 #include <deque>
 #include <outcome.hpp>
 
+#include "absl/time/time.h"
+
 #include "OrbitSsh/Channel.h"
 #include "OrbitSshQt/Error.h"
 #include "OrbitSshQt/ScopedConnection.h"
@@ -24,6 +27,7 @@ enum class TunnelState {
   kInitial,
   kNoChannel,
   kChannelInitialized,
+  kWindowAdjusted,
   kStarted,
   kServerListening,
   kShutdown,
@@ -36,6 +40,15 @@ enum class TunnelState {
 };
 }  // namespace details
 
+struct TunnelOptions {
+  // The maximum number of bytes read from the channel at once.
+  size_t read_chunk_size = 64 * 1024;
+  // The receive window of the channel. The remote can't have more bytes in
+  // flight, so on a link with a long round trip this bounds the throughput,
+  // e.g., to 16 MiB per 100 ms round trip.
+  uint32_t receive_window_size = 16 * 1024 * 1024;
+};
+
 /*
   Tunnel encapsulates SSH's TCP-tunneling feature and locally connects a
   listening TCP server.
@@ -45,6 +58,11 @@ enum class TunnelState {
   tunnelOpen(uint16_t) signal or the GetListenPort() member function.
 
   Tunnel needs a open and running Session to work.
+
+  Each Tunnel is its own SSH channel with its own window, so traffic that
+  would otherwise fill the window of an interactive tunnel can be given a
+  separate one. The throughput of the tunnel is logged periodically while data
+  flows.
 */
 class Tunnel : public StateMachineHelper<Tunnel, details::TunnelState> {
   Q_OBJECT
@@ -52,7 +70,7 @@ class Tunnel : public StateMachineHelper<Tunnel, details::TunnelState> {
 
  public:
   explicit Tunnel(Session* session, std::string remote_host,
-                  uint16_t remote_port);
+                  uint16_t remote_port, TunnelOptions options = {});
 
   void Start();
   void Stop();
@@ -61,6 +79,11 @@ class Tunnel : public StateMachineHelper<Tunnel, details::TunnelState> {
     return local_server_ ? local_server_->serverPort() : 0;
   }
 
+  // From the remote to the local socket.
+  [[nodiscard]] uint64_t GetBytesReceived() const { return bytes_received_; }
+  // From the local socket to the remote.
+  [[nodiscard]] uint64_t GetBytesSent() const { return bytes_sent_; }
+
  signals:
   void tunnelOpened(uint16_t listen_port);
   void started();
@@ -73,6 +96,7 @@ class Tunnel : public StateMachineHelper<Tunnel, details::TunnelState> {
 
   std::string remote_host_;
   uint16_t remote_port_ = 0;
+  TunnelOptions options_;
 
   outcome::result<void> startup();
   outcome::result<void> shutdown();
@@ -82,6 +106,7 @@ class Tunnel : public StateMachineHelper<Tunnel, details::TunnelState> {
   void HandleSessionShutdown();
   void HandleIncomingDataLocalSocket();
   void HandleEagain();
+  void LogThroughputIfDue();
 
   using StateMachineHelper::SetError;
   void SetError(std::error_code);
@@ -92,6 +117,12 @@ class Tunnel : public StateMachineHelper<Tunnel, details::TunnelState> {
   std::string write_buffer_;
   std::string read_buffer_;
 
+  uint64_t bytes_received_ = 0;
+  uint64_t bytes_sent_ = 0;
+  absl::Time last_throughput_log_time_ = absl::Now();
+  uint64_t bytes_received_at_last_log_ = 0;
+  uint64_t bytes_sent_at_last_log_ = 0;
+
   std::optional<ScopedConnection> data_event_connection_;
   std::optional<ScopedConnection> about_to_shutdown_connection_;
 };
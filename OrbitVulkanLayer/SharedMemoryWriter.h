@@ -0,0 +1,119 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_VULKAN_LAYER_SHARED_MEMORY_WRITER_H_
+#define ORBIT_VULKAN_LAYER_SHARED_MEMORY_WRITER_H_
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../OrbitVulkanLayerSharedMemory.h"
+
+namespace orbit_vulkan_layer {
+
+// A command buffer or debug label region of a submission, with its GPU
+// timestamps already converted to CLOCK_MONOTONIC.
+struct GpuSlice {
+  uint32_t depth;
+  uint64_t begin_timestamp_ns;
+  uint64_t end_timestamp_ns;
+  std::string label;
+};
+
+// The producer side of the buffer of the process. The submissions are
+// silently not reported if it can't be created. Thread-safe.
+class SharedMemoryWriter {
+ public:
+  SharedMemoryWriter() {
+    const int32_t pid = getpid();
+    snprintf(path_, sizeof(path_), "%s%s%d", kSharedMemoryDirectory,
+             kSharedMemoryFilePrefix, pid);
+    const int fd = open(path_, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return;
+    void* memory = MAP_FAILED;
+    if (ftruncate(fd, sizeof(SharedMemoryBuffer)) == 0) {
+      memory = mmap(nullptr, sizeof(SharedMemoryBuffer), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (memory == MAP_FAILED) {
+      unlink(path_);
+      return;
+    }
+    // The file is filled with zeros, so only the other fields need to be set.
+    buffer_ = static_cast<SharedMemoryBuffer*>(memory);
+    buffer_->slice_count = kSharedMemorySliceCount;
+    buffer_->pid = pid;
+    buffer_->magic.store(kSharedMemoryMagic, std::memory_order_release);
+  }
+
+  ~SharedMemoryWriter() {
+    if (buffer_ == nullptr) return;
+    munmap(buffer_, sizeof(SharedMemoryBuffer));
+    unlink(path_);
+  }
+
+  SharedMemoryWriter(const SharedMemoryWriter&) = delete;
+  SharedMemoryWriter& operator=(const SharedMemoryWriter&) = delete;
+
+  // Whether OrbitService is capturing the process.
+  [[nodiscard]] bool IsEnabled() const {
+    return buffer_ != nullptr &&
+           buffer_->enabled.load(std::memory_order_relaxed) != 0;
+  }
+
+  // Writes all the slices of a submission, or none if they don't fit.
+  void WriteSubmission(int32_t submit_tid, uint64_t submit_begin_timestamp_ns,
+                       uint64_t submit_end_timestamp_ns,
+                       const std::vector<GpuSlice>& slices) {
+    if (!IsEnabled() || slices.empty()) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint64_t write_index =
+        buffer_->write_index.load(std::memory_order_relaxed);
+    const uint64_t read_index =
+        buffer_->read_index.load(std::memory_order_acquire);
+    if (write_index - read_index + slices.size() > kSharedMemorySliceCount) {
+      buffer_->dropped_slice_count.fetch_add(slices.size(),
+                                             std::memory_order_relaxed);
+      return;
+    }
+    const uint64_t submission_index = next_submission_index_++;
+    for (size_t i = 0; i < slices.size(); ++i) {
+      SharedMemorySlice& slice =
+          buffer_->slices[(write_index + i) % kSharedMemorySliceCount];
+      slice.submission_index = submission_index;
+      slice.submit_tid = submit_tid;
+      slice.depth = slices[i].depth;
+      slice.submit_begin_timestamp_ns = submit_begin_timestamp_ns;
+      slice.submit_end_timestamp_ns = submit_end_timestamp_ns;
+      slice.begin_timestamp_ns = slices[i].begin_timestamp_ns;
+      slice.end_timestamp_ns = slices[i].end_timestamp_ns;
+      const size_t label_length = std::min<size_t>(
+          slices[i].label.size(), kSharedMemoryLabelLength - 1);
+      memcpy(slice.label, slices[i].label.data(), label_length);
+      slice.label[label_length] = '\0';
+    }
+    buffer_->write_index.store(write_index + slices.size(),
+                               std::memory_order_release);
+  }
+
+ private:
+  char path_[64] = {};
+  SharedMemoryBuffer* buffer_ = nullptr;
+  std::mutex mutex_;
+  uint64_t next_submission_index_ = 0;
+};
+
+}  // namespace orbit_vulkan_layer
+
+#endif  // ORBIT_VULKAN_LAYER_SHARED_MEMORY_WRITER_H_
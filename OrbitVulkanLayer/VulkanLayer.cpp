@@ -0,0 +1,906 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// An implicit Vulkan layer that measures the GPU time of the primary command
+// buffers, and of the vkCmdBeginDebugUtilsLabelEXT regions in them, with
+// timestamp queries, and reports them with the vkQueueSubmit that submitted
+// them through SharedMemoryWriter while OrbitService captures the process.
+//
+// The layer only measures the command buffers begun during a capture, on the
+// devices that support VK_EXT_calibrated_timestamps with CLOCK_MONOTONIC, so
+// that the GPU timestamps can be converted to the clock of the capture. The
+// results are read without waiting, at the following submissions and
+// presents.
+
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <vulkan/vk_layer.h>
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "SharedMemoryWriter.h"
+
+#define ORBIT_VULKAN_LAYER_EXPORT \
+  extern "C" __attribute__((visibility("default")))
+
+namespace orbit_vulkan_layer {
+
+namespace {
+
+constexpr const char kLayerName[] = "VK_LAYER_ORBIT_command_buffer_timing";
+
+// Each command buffer measured holds a block of the query pool of its device:
+// its begin and end, then the begin and end of each label region.
+constexpr uint32_t kQueryPoolBlockCount = 256;
+constexpr uint32_t kQueriesPerBlock = 64;
+constexpr uint32_t kFirstLabelQuery = 2;
+constexpr uint32_t kNoBlock = UINT32_MAX;
+constexpr uint32_t kNoQuery = UINT32_MAX;
+
+// The GPU clock drifts from CLOCK_MONOTONIC, hence is calibrated again
+// after this.
+constexpr uint64_t kCalibrationPeriodNs = 1'000'000'000;
+
+uint64_t MonotonicTimestampNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return 1'000'000'000ull * ts.tv_sec + ts.tv_nsec;
+}
+
+SharedMemoryWriter& GetWriter() {
+  // Removes the file of the buffer when the layer is unloaded.
+  static SharedMemoryWriter writer;
+  return writer;
+}
+
+// Dispatchable handles begin with the dispatch table of the loader, shared
+// by an instance and its physical devices, and by a device and its queues
+// and command buffers.
+template <typename DispatchableHandle>
+void* GetDispatchKey(DispatchableHandle handle) {
+  return *reinterpret_cast<void**>(handle);
+}
+
+struct InstanceData {
+  VkInstance instance;
+  PFN_vkGetInstanceProcAddr get_instance_proc_addr;
+  PFN_vkDestroyInstance destroy_instance;
+  PFN_vkEnumerateDeviceExtensionProperties
+      enumerate_device_extension_properties;
+  PFN_vkGetPhysicalDeviceProperties get_physical_device_properties;
+  PFN_vkGetPhysicalDeviceQueueFamilyProperties
+      get_physical_device_queue_family_properties;
+  PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT
+      get_physical_device_calibrateable_time_domains;
+};
+
+struct LabelRegion {
+  // The query of its begin, followed by the one of its end.
+  uint32_t query;
+  uint32_t depth;
+  std::string label;
+};
+
+struct RecordedCommandBuffer {
+  uint32_t block;
+  // The queries after the last one written are unused.
+  uint32_t query_count;
+  std::vector<LabelRegion> label_regions;
+};
+
+struct PendingSubmission {
+  int32_t submit_tid;
+  uint64_t submit_begin_timestamp_ns;
+  uint64_t submit_end_timestamp_ns;
+  std::vector<RecordedCommandBuffer> command_buffers;
+};
+
+struct DeviceData {
+  VkDevice device;
+  PFN_vkGetDeviceProcAddr get_device_proc_addr;
+  PFN_vkDestroyDevice destroy_device;
+  PFN_vkAllocateCommandBuffers allocate_command_buffers;
+  PFN_vkFreeCommandBuffers free_command_buffers;
+  PFN_vkCreateCommandPool create_command_pool;
+  PFN_vkDestroyCommandPool destroy_command_pool;
+  PFN_vkBeginCommandBuffer begin_command_buffer;
+  PFN_vkEndCommandBuffer end_command_buffer;
+  PFN_vkCmdBeginDebugUtilsLabelEXT cmd_begin_debug_utils_label;
+  PFN_vkCmdEndDebugUtilsLabelEXT cmd_end_debug_utils_label;
+  PFN_vkQueueSubmit queue_submit;
+  PFN_vkQueuePresentKHR queue_present;
+  PFN_vkCreateQueryPool create_query_pool;
+  PFN_vkDestroyQueryPool destroy_query_pool;
+  PFN_vkCmdResetQueryPool cmd_reset_query_pool;
+  PFN_vkCmdWriteTimestamp cmd_write_timestamp;
+  PFN_vkGetQueryPoolResults get_query_pool_results;
+  PFN_vkGetCalibratedTimestampsEXT get_calibrated_timestamps;
+
+  // VK_NULL_HANDLE if the device isn't measured.
+  VkQueryPool query_pool = VK_NULL_HANDLE;
+  double timestamp_period_ns = 1.0;
+  // Of the queue families with timestamps.
+  uint64_t timestamp_mask = UINT64_MAX;
+  // By queue family, 0 for the ones without timestamps.
+  std::vector<uint32_t> timestamp_valid_bits;
+  std::unordered_map<VkCommandPool, uint32_t> queue_families_by_command_pool;
+  uint64_t calibration_gpu_timestamp = 0;
+  uint64_t calibration_cpu_timestamp_ns = 0;
+
+  std::vector<uint32_t> free_blocks;
+  // By block, the command buffer and pending submissions that use it.
+  std::vector<uint32_t> block_reference_counts;
+  std::vector<PendingSubmission> pending_submissions;
+};
+
+struct CommandBufferData {
+  DeviceData* device;
+  VkCommandPool command_pool;
+  // Secondary command buffers can continue a render pass, in which the
+  // queries can't be reset, and some queue families have no timestamps.
+  bool measurable;
+  // Only valid while it's recorded, or was recorded, during a capture.
+  uint32_t block = kNoBlock;
+  uint32_t next_query = kFirstLabelQuery;
+  // Per depth, kNoQuery for the regions that didn't fit.
+  std::vector<LabelRegion> open_label_regions;
+  std::vector<LabelRegion> label_regions;
+  bool ended = false;
+};
+
+std::mutex mutex;
+// By dispatch key.
+std::unordered_map<void*, std::unique_ptr<InstanceData>> instances;
+std::unordered_map<void*, std::unique_ptr<DeviceData>> devices;
+std::unordered_map<VkCommandBuffer, CommandBufferData> command_buffers;
+
+InstanceData* GetInstanceData(void* dispatch_key) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = instances.find(dispatch_key);
+  return it == instances.end() ? nullptr : it->second.get();
+}
+
+DeviceData* GetDeviceData(void* dispatch_key) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = devices.find(dispatch_key);
+  return it == devices.end() ? nullptr : it->second.get();
+}
+
+// The following functions are called with mutex held.
+
+void UnreferenceBlock(DeviceData* device, uint32_t block) {
+  if (block == kNoBlock) return;
+  if (--device->block_reference_counts[block] == 0) {
+    device->free_blocks.push_back(block);
+  }
+}
+
+void ReleaseCommandBuffer(CommandBufferData* command_buffer) {
+  UnreferenceBlock(command_buffer->device, command_buffer->block);
+  command_buffer->block = kNoBlock;
+  command_buffer->next_query = kFirstLabelQuery;
+  command_buffer->open_label_regions.clear();
+  command_buffer->label_regions.clear();
+  command_buffer->ended = false;
+}
+
+bool Calibrate(DeviceData* device) {
+  VkCalibratedTimestampInfoEXT infos[2] = {};
+  infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+  infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+  infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+  infos[1].timeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+  uint64_t timestamps[2];
+  uint64_t max_deviation;
+  if (device->get_calibrated_timestamps(device->device, 2, infos, timestamps,
+                                        &max_deviation) != VK_SUCCESS) {
+    return false;
+  }
+  device->calibration_gpu_timestamp = timestamps[0] & device->timestamp_mask;
+  device->calibration_cpu_timestamp_ns = timestamps[1];
+  return true;
+}
+
+uint64_t GpuTimestampToCpuNs(const DeviceData& device,
+                             uint64_t gpu_timestamp) {
+  // The difference, with the sign of the valid bits, in case the counter
+  // wrapped around since the calibration.
+  const uint64_t ticks = (gpu_timestamp - device.calibration_gpu_timestamp) &
+                         device.timestamp_mask;
+  double delta_ns = ticks * device.timestamp_period_ns;
+  if (ticks > device.timestamp_mask / 2) {
+    delta_ns = -static_cast<double>(device.timestamp_mask - ticks + 1) *
+               device.timestamp_period_ns;
+  }
+  return device.calibration_cpu_timestamp_ns + static_cast<int64_t>(delta_ns);
+}
+
+// Returns false if the GPU hasn't completed the command buffer yet.
+bool ReadCommandBuffer(DeviceData* device,
+                       const RecordedCommandBuffer& command_buffer,
+                       std::vector<GpuSlice>* slices) {
+  uint64_t timestamps[kQueriesPerBlock];
+  if (device->get_query_pool_results(
+          device->device, device->query_pool,
+          command_buffer.block * kQueriesPerBlock, command_buffer.query_count,
+          sizeof(timestamps), timestamps, sizeof(uint64_t),
+          VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+    return false;
+  }
+  slices->push_back(GpuSlice{0, GpuTimestampToCpuNs(*device, timestamps[0]),
+                             GpuTimestampToCpuNs(*device, timestamps[1]), ""});
+  for (const LabelRegion& region : command_buffer.label_regions) {
+    slices->push_back(
+        GpuSlice{region.depth,
+                 GpuTimestampToCpuNs(*device, timestamps[region.query]),
+                 GpuTimestampToCpuNs(*device, timestamps[region.query + 1]),
+                 region.label});
+  }
+  return true;
+}
+
+// Reports the submissions whose command buffers all completed, in any order,
+// as they can be on different queues.
+void ReadPendingSubmissions(DeviceData* device) {
+  if (device->pending_submissions.empty()) return;
+  const uint64_t now_ns = MonotonicTimestampNs();
+  if (now_ns - device->calibration_cpu_timestamp_ns > kCalibrationPeriodNs) {
+    Calibrate(device);
+  }
+  auto& pending_submissions = device->pending_submissions;
+  for (auto it = pending_submissions.begin();
+       it != pending_submissions.end();) {
+    std::vector<GpuSlice> slices;
+    bool completed = true;
+    for (const RecordedCommandBuffer& command_buffer : it->command_buffers) {
+      if (!ReadCommandBuffer(device, command_buffer, &slices)) {
+        completed = false;
+        break;
+      }
+    }
+    if (!completed) {
+      ++it;
+      continue;
+    }
+    GetWriter().WriteSubmission(it->submit_tid, it->submit_begin_timestamp_ns,
+                                it->submit_end_timestamp_ns, slices);
+    for (const RecordedCommandBuffer& command_buffer : it->command_buffers) {
+      UnreferenceBlock(device, command_buffer.block);
+    }
+    it = pending_submissions.erase(it);
+  }
+}
+
+bool HasExtension(InstanceData* instance, VkPhysicalDevice physical_device,
+                  const char* extension_name) {
+  uint32_t count = 0;
+  instance->enumerate_device_extension_properties(physical_device, nullptr,
+                                                  &count, nullptr);
+  std::vector<VkExtensionProperties> extensions(count);
+  instance->enumerate_device_extension_properties(physical_device, nullptr,
+                                                  &count, extensions.data());
+  for (const VkExtensionProperties& extension : extensions) {
+    if (strcmp(extension.extensionName, extension_name) == 0) return true;
+  }
+  return false;
+}
+
+bool SupportsMonotonicCalibration(InstanceData* instance,
+                                  VkPhysicalDevice physical_device) {
+  if (instance->get_physical_device_calibrateable_time_domains == nullptr ||
+      !HasExtension(instance, physical_device,
+                    VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)) {
+    return false;
+  }
+  uint32_t count = 0;
+  instance->get_physical_device_calibrateable_time_domains(physical_device,
+                                                           &count, nullptr);
+  std::vector<VkTimeDomainEXT> time_domains(count);
+  instance->get_physical_device_calibrateable_time_domains(
+      physical_device, &count, time_domains.data());
+  bool has_device = false;
+  bool has_monotonic = false;
+  for (VkTimeDomainEXT time_domain : time_domains) {
+    has_device |= time_domain == VK_TIME_DOMAIN_DEVICE_EXT;
+    has_monotonic |= time_domain == VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+  }
+  return has_device && has_monotonic;
+}
+
+// Creates the query pool, unless the device can't be measured.
+void SetUpMeasurement(InstanceData* instance, VkPhysicalDevice physical_device,
+                      DeviceData* device) {
+  if (device->get_calibrated_timestamps == nullptr) return;
+
+  VkPhysicalDeviceProperties properties;
+  instance->get_physical_device_properties(physical_device, &properties);
+  if (properties.limits.timestampPeriod <= 0) return;
+  device->timestamp_period_ns = properties.limits.timestampPeriod;
+  uint32_t queue_family_count = 0;
+  instance->get_physical_device_queue_family_properties(
+      physical_device, &queue_family_count, nullptr);
+  std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+  instance->get_physical_device_queue_family_properties(
+      physical_device, &queue_family_count, queue_families.data());
+  uint32_t valid_bits = 64;
+  for (const VkQueueFamilyProperties& queue_family : queue_families) {
+    device->timestamp_valid_bits.push_back(queue_family.timestampValidBits);
+    if (queue_family.timestampValidBits == 0) continue;
+    valid_bits = std::min(valid_bits, queue_family.timestampValidBits);
+  }
+  device->timestamp_mask =
+      valid_bits == 64 ? UINT64_MAX : (uint64_t{1} << valid_bits) - 1;
+  if (!Calibrate(device)) return;
+
+  VkQueryPoolCreateInfo create_info = {};
+  create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  create_info.queryCount = kQueryPoolBlockCount * kQueriesPerBlock;
+  if (device->create_query_pool(device->device, &create_info, nullptr,
+                                &device->query_pool) != VK_SUCCESS) {
+    device->query_pool = VK_NULL_HANDLE;
+    return;
+  }
+  device->block_reference_counts.assign(kQueryPoolBlockCount, 0);
+  for (uint32_t block = kQueryPoolBlockCount; block > 0; --block) {
+    device->free_blocks.push_back(block - 1);
+  }
+}
+
+template <typename FunctionPointer>
+FunctionPointer GetDeviceFunction(DeviceData* device, const char* name) {
+  return reinterpret_cast<FunctionPointer>(
+      device->get_device_proc_addr(device->device, name));
+}
+
+VkLayerInstanceCreateInfo* FindInstanceLinkInfo(
+    const VkInstanceCreateInfo* create_info) {
+  auto* info =
+      static_cast<const VkLayerInstanceCreateInfo*>(create_info->pNext);
+  while (info != nullptr &&
+         (info->sType != VK_STRUCTURE_TYPE_LOADER_INSTANCE_CREATE_INFO ||
+          info->function != VK_LAYER_LINK_INFO)) {
+    info = static_cast<const VkLayerInstanceCreateInfo*>(info->pNext);
+  }
+  return const_cast<VkLayerInstanceCreateInfo*>(info);
+}
+
+VkLayerDeviceCreateInfo* FindDeviceLinkInfo(
+    const VkDeviceCreateInfo* create_info) {
+  auto* info = static_cast<const VkLayerDeviceCreateInfo*>(create_info->pNext);
+  while (info != nullptr &&
+         (info->sType != VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO ||
+          info->function != VK_LAYER_LINK_INFO)) {
+    info = static_cast<const VkLayerDeviceCreateInfo*>(info->pNext);
+  }
+  return const_cast<VkLayerDeviceCreateInfo*>(info);
+}
+
+// The intercepted functions.
+
+VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(
+    const VkInstanceCreateInfo* create_info,
+    const VkAllocationCallbacks* allocator, VkInstance* instance) {
+  VkLayerInstanceCreateInfo* link_info = FindInstanceLinkInfo(create_info);
+  if (link_info == nullptr) return VK_ERROR_INITIALIZATION_FAILED;
+  PFN_vkGetInstanceProcAddr next_get_instance_proc_addr =
+      link_info->u.pLayerInfo->pfnNextGetInstanceProcAddr;
+  // The next layer finds its own link info.
+  link_info->u.pLayerInfo = link_info->u.pLayerInfo->pNext;
+  auto next_create_instance = reinterpret_cast<PFN_vkCreateInstance>(
+      next_get_instance_proc_addr(VK_NULL_HANDLE, "vkCreateInstance"));
+  VkResult result = next_create_instance(create_info, allocator, instance);
+  if (result != VK_SUCCESS) return result;
+
+  auto data = std::make_unique<InstanceData>();
+  data->instance = *instance;
+  data->get_instance_proc_addr = next_get_instance_proc_addr;
+  auto get = [&](const char* name) {
+    return next_get_instance_proc_addr(*instance, name);
+  };
+  data->destroy_instance =
+      reinterpret_cast<PFN_vkDestroyInstance>(get("vkDestroyInstance"));
+  data->enumerate_device_extension_properties =
+      reinterpret_cast<PFN_vkEnumerateDeviceExtensionProperties>(
+          get("vkEnumerateDeviceExtensionProperties"));
+  data->get_physical_device_properties =
+      reinterpret_cast<PFN_vkGetPhysicalDeviceProperties>(
+          get("vkGetPhysicalDeviceProperties"));
+  data->get_physical_device_queue_family_properties =
+      reinterpret_cast<PFN_vkGetPhysicalDeviceQueueFamilyProperties>(
+          get("vkGetPhysicalDeviceQueueFamilyProperties"));
+  data->get_physical_device_calibrateable_time_domains =
+      reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+          get("vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+  // Creates the buffer, for OrbitService to find it.
+  GetWriter();
+  std::lock_guard<std::mutex> lock(mutex);
+  instances[GetDispatchKey(*instance)] = std::move(data);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL DestroyInstance(
+    VkInstance instance, const VkAllocationCallbacks* allocator) {
+  std::unique_ptr<InstanceData> data;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = instances.find(GetDispatchKey(instance));
+    if (it == instances.end()) return;
+    data = std::move(it->second);
+    instances.erase(it);
+  }
+  data->destroy_instance(instance, allocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL EnumerateDeviceExtensionProperties(
+    VkPhysicalDevice physical_device, const char* layer_name,
+    uint32_t* property_count, VkExtensionProperties* properties) {
+  // The layer doesn't expose extensions of its own.
+  if (layer_name != nullptr && strcmp(layer_name, kLayerName) == 0) {
+    *property_count = 0;
+    return VK_SUCCESS;
+  }
+  InstanceData* instance = GetInstanceData(GetDispatchKey(physical_device));
+  if (instance == nullptr) return VK_ERROR_INITIALIZATION_FAILED;
+  return instance->enumerate_device_extension_properties(
+      physical_device, layer_name, property_count, properties);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(
+    VkPhysicalDevice physical_device, const VkDeviceCreateInfo* create_info,
+    const VkAllocationCallbacks* allocator, VkDevice* device) {
+  InstanceData* instance = GetInstanceData(GetDispatchKey(physical_device));
+  VkLayerDeviceCreateInfo* link_info = FindDeviceLinkInfo(create_info);
+  if (instance == nullptr || link_info == nullptr) {
+    return VK_ERROR_INITIALIZATION_FAILED;
+  }
+  PFN_vkGetInstanceProcAddr next_get_instance_proc_addr =
+      link_info->u.pLayerInfo->pfnNextGetInstanceProcAddr;
+  PFN_vkGetDeviceProcAddr next_get_device_proc_addr =
+      link_info->u.pLayerInfo->pfnNextGetDeviceProcAddr;
+  link_info->u.pLayerInfo = link_info->u.pLayerInfo->pNext;
+  auto next_create_device = reinterpret_cast<PFN_vkCreateDevice>(
+      next_get_instance_proc_addr(instance->instance, "vkCreateDevice"));
+
+  // Enables VK_EXT_calibrated_timestamps, if the application didn't.
+  const bool measure =
+      SupportsMonotonicCalibration(instance, physical_device);
+  std::vector<const char*> extension_names(
+      create_info->ppEnabledExtensionNames,
+      create_info->ppEnabledExtensionNames +
+          create_info->enabledExtensionCount);
+  auto is_calibrated_timestamps = [](const char* name) {
+    return strcmp(name, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) == 0;
+  };
+  if (measure && std::none_of(extension_names.begin(), extension_names.end(),
+                              is_calibrated_timestamps)) {
+    extension_names.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+  }
+  VkDeviceCreateInfo layer_create_info = *create_info;
+  layer_create_info.enabledExtensionCount =
+      static_cast<uint32_t>(extension_names.size());
+  layer_create_info.ppEnabledExtensionNames = extension_names.data();
+  VkResult result = next_create_device(physical_device, &layer_create_info,
+                                       allocator, device);
+  if (result != VK_SUCCESS) return result;
+
+  auto data = std::make_unique<DeviceData>();
+  data->device = *device;
+  data->get_device_proc_addr = next_get_device_proc_addr;
+  DeviceData* d = data.get();
+  d->destroy_device =
+      GetDeviceFunction<PFN_vkDestroyDevice>(d, "vkDestroyDevice");
+  d->allocate_command_buffers =
+      GetDeviceFunction<PFN_vkAllocateCommandBuffers>(
+          d, "vkAllocateCommandBuffers");
+  d->free_command_buffers =
+      GetDeviceFunction<PFN_vkFreeCommandBuffers>(d, "vkFreeCommandBuffers");
+  d->create_command_pool =
+      GetDeviceFunction<PFN_vkCreateCommandPool>(d, "vkCreateCommandPool");
+  d->destroy_command_pool =
+      GetDeviceFunction<PFN_vkDestroyCommandPool>(d, "vkDestroyCommandPool");
+  d->begin_command_buffer =
+      GetDeviceFunction<PFN_vkBeginCommandBuffer>(d, "vkBeginCommandBuffer");
+  d->end_command_buffer =
+      GetDeviceFunction<PFN_vkEndCommandBuffer>(d, "vkEndCommandBuffer");
+  d->cmd_begin_debug_utils_label =
+      GetDeviceFunction<PFN_vkCmdBeginDebugUtilsLabelEXT>(
+          d, "vkCmdBeginDebugUtilsLabelEXT");
+  d->cmd_end_debug_utils_label =
+      GetDeviceFunction<PFN_vkCmdEndDebugUtilsLabelEXT>(
+          d, "vkCmdEndDebugUtilsLabelEXT");
+  d->queue_submit = GetDeviceFunction<PFN_vkQueueSubmit>(d, "vkQueueSubmit");
+  d->queue_present =
+      GetDeviceFunction<PFN_vkQueuePresentKHR>(d, "vkQueuePresentKHR");
+  d->create_query_pool =
+      GetDeviceFunction<PFN_vkCreateQueryPool>(d, "vkCreateQueryPool");
+  d->destroy_query_pool =
+      GetDeviceFunction<PFN_vkDestroyQueryPool>(d, "vkDestroyQueryPool");
+  d->cmd_reset_query_pool =
+      GetDeviceFunction<PFN_vkCmdResetQueryPool>(d, "vkCmdResetQueryPool");
+  d->cmd_write_timestamp =
+      GetDeviceFunction<PFN_vkCmdWriteTimestamp>(d, "vkCmdWriteTimestamp");
+  d->get_query_pool_results =
+      GetDeviceFunction<PFN_vkGetQueryPoolResults>(d, "vkGetQueryPoolResults");
+  d->get_calibrated_timestamps =
+      measure ? GetDeviceFunction<PFN_vkGetCalibratedTimestampsEXT>(
+                    d, "vkGetCalibratedTimestampsEXT")
+              : nullptr;
+  SetUpMeasurement(instance, physical_device, d);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  devices[GetDispatchKey(*device)] = std::move(data);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+DestroyDevice(VkDevice device, const VkAllocationCallbacks* allocator) {
+  std::unique_ptr<DeviceData> data;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = devices.find(GetDispatchKey(device));
+    if (it == devices.end()) return;
+    data = std::move(it->second);
+    devices.erase(it);
+    for (auto cb_it = command_buffers.begin();
+         cb_it != command_buffers.end();) {
+      if (cb_it->second.device == data.get()) {
+        cb_it = command_buffers.erase(cb_it);
+      } else {
+        ++cb_it;
+      }
+    }
+  }
+  // The results of the submissions still pending are lost, as the
+  // application waits for the device to be idle before destroying it.
+  if (data->query_pool != VK_NULL_HANDLE) {
+    data->destroy_query_pool(device, data->query_pool, nullptr);
+  }
+  data->destroy_device(device, allocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+CreateCommandPool(VkDevice device, const VkCommandPoolCreateInfo* create_info,
+                  const VkAllocationCallbacks* allocator,
+                  VkCommandPool* command_pool) {
+  DeviceData* data = GetDeviceData(GetDispatchKey(device));
+  VkResult result =
+      data->create_command_pool(device, create_info, allocator, command_pool);
+  if (result != VK_SUCCESS) return result;
+  std::lock_guard<std::mutex> lock(mutex);
+  data->queue_families_by_command_pool[*command_pool] =
+      create_info->queueFamilyIndex;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+AllocateCommandBuffers(VkDevice device,
+                       const VkCommandBufferAllocateInfo* allocate_info,
+                       VkCommandBuffer* command_buffer_handles) {
+  DeviceData* data = GetDeviceData(GetDispatchKey(device));
+  VkResult result = data->allocate_command_buffers(device, allocate_info,
+                                                   command_buffer_handles);
+  if (result != VK_SUCCESS) return result;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto queue_family_it =
+      data->queue_families_by_command_pool.find(allocate_info->commandPool);
+  const bool has_timestamps =
+      queue_family_it != data->queue_families_by_command_pool.end() &&
+      queue_family_it->second < data->timestamp_valid_bits.size() &&
+      data->timestamp_valid_bits[queue_family_it->second] > 0;
+  for (uint32_t i = 0; i < allocate_info->commandBufferCount; ++i) {
+    CommandBufferData command_buffer;
+    command_buffer.device = data;
+    command_buffer.command_pool = allocate_info->commandPool;
+    command_buffer.measurable =
+        has_timestamps &&
+        allocate_info->level == VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    command_buffers[command_buffer_handles[i]] = std::move(command_buffer);
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+FreeCommandBuffers(VkDevice device, VkCommandPool command_pool,
+                   uint32_t command_buffer_count,
+                   const VkCommandBuffer* command_buffer_handles) {
+  DeviceData* data = GetDeviceData(GetDispatchKey(device));
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (uint32_t i = 0; i < command_buffer_count; ++i) {
+      auto it = command_buffers.find(command_buffer_handles[i]);
+      if (it == command_buffers.end()) continue;
+      ReleaseCommandBuffer(&it->second);
+      command_buffers.erase(it);
+    }
+  }
+  data->free_command_buffers(device, command_pool, command_buffer_count,
+                             command_buffer_handles);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+DestroyCommandPool(VkDevice device, VkCommandPool command_pool,
+                   const VkAllocationCallbacks* allocator) {
+  DeviceData* data = GetDeviceData(GetDispatchKey(device));
+  {
+    // Frees the command buffers of the pool.
+    std::lock_guard<std::mutex> lock(mutex);
+    data->queue_families_by_command_pool.erase(command_pool);
+    for (auto it = command_buffers.begin(); it != command_buffers.end();) {
+      if (it->second.command_pool == command_pool) {
+        ReleaseCommandBuffer(&it->second);
+        it = command_buffers.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  data->destroy_command_pool(device, command_pool, allocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+BeginCommandBuffer(VkCommandBuffer command_buffer_handle,
+                   const VkCommandBufferBeginInfo* begin_info) {
+  DeviceData* data = GetDeviceData(GetDispatchKey(command_buffer_handle));
+  VkResult result = data->begin_command_buffer(command_buffer_handle,
+                                               begin_info);
+  if (result != VK_SUCCESS) return result;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = command_buffers.find(command_buffer_handle);
+  if (it == command_buffers.end()) return result;
+  CommandBufferData& command_buffer = it->second;
+  // Beginning implicitly resets it.
+  ReleaseCommandBuffer(&command_buffer);
+  if (!command_buffer.measurable || data->query_pool == VK_NULL_HANDLE ||
+      data->free_blocks.empty() || !GetWriter().IsEnabled()) {
+    return result;
+  }
+  command_buffer.block = data->free_blocks.back();
+  data->free_blocks.pop_back();
+  data->block_reference_counts[command_buffer.block] = 1;
+  const uint32_t first_query = command_buffer.block * kQueriesPerBlock;
+  data->cmd_reset_query_pool(command_buffer_handle, data->query_pool,
+                             first_query, kQueriesPerBlock);
+  data->cmd_write_timestamp(command_buffer_handle,
+                            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                            data->query_pool, first_query);
+  return result;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+EndCommandBuffer(VkCommandBuffer command_buffer_handle) {
+  DeviceData* data = GetDeviceData(GetDispatchKey(command_buffer_handle));
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = command_buffers.find(command_buffer_handle);
+    if (it != command_buffers.end() && it->second.block != kNoBlock) {
+      CommandBufferData& command_buffer = it->second;
+      data->cmd_write_timestamp(
+          command_buffer_handle, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+          data->query_pool, command_buffer.block * kQueriesPerBlock + 1);
+      // The regions that end in a later command buffer aren't measured.
+      command_buffer.open_label_regions.clear();
+      command_buffer.ended = true;
+    }
+  }
+  return data->end_command_buffer(command_buffer_handle);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+CmdBeginDebugUtilsLabelEXT(VkCommandBuffer command_buffer_handle,
+                           const VkDebugUtilsLabelEXT* label_info) {
+  DeviceData* data = GetDeviceData(GetDispatchKey(command_buffer_handle));
+  data->cmd_begin_debug_utils_label(command_buffer_handle, label_info);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = command_buffers.find(command_buffer_handle);
+  if (it == command_buffers.end() || it->second.block == kNoBlock) return;
+  CommandBufferData& command_buffer = it->second;
+  LabelRegion region{
+      kNoQuery,
+      static_cast<uint32_t>(command_buffer.open_label_regions.size() + 1),
+      label_info->pLabelName != nullptr ? label_info->pLabelName : ""};
+  if (command_buffer.next_query + 2 <= kQueriesPerBlock) {
+    region.query = command_buffer.next_query;
+    command_buffer.next_query += 2;
+    data->cmd_write_timestamp(
+        command_buffer_handle, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        data->query_pool,
+        command_buffer.block * kQueriesPerBlock + region.query);
+  }
+  command_buffer.open_label_regions.push_back(std::move(region));
+}
+
+VKAPI_ATTR void VKAPI_CALL
+CmdEndDebugUtilsLabelEXT(VkCommandBuffer command_buffer_handle) {
+  DeviceData* data = GetDeviceData(GetDispatchKey(command_buffer_handle));
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = command_buffers.find(command_buffer_handle);
+    // Regions that began in an earlier command buffer aren't measured.
+    if (it != command_buffers.end() && it->second.block != kNoBlock &&
+        !it->second.open_label_regions.empty()) {
+      CommandBufferData& command_buffer = it->second;
+      LabelRegion region = std::move(command_buffer.open_label_regions.back());
+      command_buffer.open_label_regions.pop_back();
+      if (region.query != kNoQuery) {
+        data->cmd_write_timestamp(
+            command_buffer_handle, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            data->query_pool,
+            command_buffer.block * kQueriesPerBlock + region.query + 1);
+        command_buffer.label_regions.push_back(std::move(region));
+      }
+    }
+  }
+  data->cmd_end_debug_utils_label(command_buffer_handle);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL QueueSubmit(VkQueue queue, uint32_t submit_count,
+                                           const VkSubmitInfo* submits,
+                                           VkFence fence) {
+  DeviceData* data = GetDeviceData(GetDispatchKey(queue));
+  PendingSubmission submission;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (uint32_t i = 0; i < submit_count; ++i) {
+      for (uint32_t j = 0; j < submits[i].commandBufferCount; ++j) {
+        auto it = command_buffers.find(submits[i].pCommandBuffers[j]);
+        if (it == command_buffers.end() || it->second.block == kNoBlock ||
+            !it->second.ended) {
+          continue;
+        }
+        const CommandBufferData& command_buffer = it->second;
+        ++data->block_reference_counts[command_buffer.block];
+        submission.command_buffers.push_back(RecordedCommandBuffer{
+            command_buffer.block, command_buffer.next_query,
+            command_buffer.label_regions});
+      }
+    }
+  }
+
+  submission.submit_tid = static_cast<int32_t>(syscall(SYS_gettid));
+  submission.submit_begin_timestamp_ns = MonotonicTimestampNs();
+  VkResult result = data->queue_submit(queue, submit_count, submits, fence);
+  submission.submit_end_timestamp_ns = MonotonicTimestampNs();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (result == VK_SUCCESS && !submission.command_buffers.empty()) {
+    data->pending_submissions.push_back(std::move(submission));
+  } else {
+    for (const RecordedCommandBuffer& command_buffer :
+         submission.command_buffers) {
+      UnreferenceBlock(data, command_buffer.block);
+    }
+  }
+  ReadPendingSubmissions(data);
+  return result;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL QueuePresentKHR(
+    VkQueue queue, const VkPresentInfoKHR* present_info) {
+  DeviceData* data = GetDeviceData(GetDispatchKey(queue));
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    ReadPendingSubmissions(data);
+  }
+  return data->queue_present(queue, present_info);
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(VkDevice device,
+                                                           const char* name);
+
+// The device functions the layer intercepts, or nullptr, also if the next
+// layer or the driver doesn't have them, e.g., without VK_EXT_debug_utils.
+PFN_vkVoidFunction GetInterceptedDeviceFunction(DeviceData* data,
+                                                const char* name) {
+  struct Interception {
+    const char* name;
+    PFN_vkVoidFunction function;
+    bool available;
+  };
+  const Interception interceptions[] = {
+      {"vkGetDeviceProcAddr",
+       reinterpret_cast<PFN_vkVoidFunction>(&GetDeviceProcAddr), true},
+      {"vkDestroyDevice", reinterpret_cast<PFN_vkVoidFunction>(&DestroyDevice),
+       true},
+      {"vkAllocateCommandBuffers",
+       reinterpret_cast<PFN_vkVoidFunction>(&AllocateCommandBuffers), true},
+      {"vkCreateCommandPool",
+       reinterpret_cast<PFN_vkVoidFunction>(&CreateCommandPool), true},
+      {"vkFreeCommandBuffers",
+       reinterpret_cast<PFN_vkVoidFunction>(&FreeCommandBuffers), true},
+      {"vkDestroyCommandPool",
+       reinterpret_cast<PFN_vkVoidFunction>(&DestroyCommandPool), true},
+      {"vkBeginCommandBuffer",
+       reinterpret_cast<PFN_vkVoidFunction>(&BeginCommandBuffer), true},
+      {"vkEndCommandBuffer",
+       reinterpret_cast<PFN_vkVoidFunction>(&EndCommandBuffer), true},
+      {"vkCmdBeginDebugUtilsLabelEXT",
+       reinterpret_cast<PFN_vkVoidFunction>(&CmdBeginDebugUtilsLabelEXT),
+       data == nullptr || data->cmd_begin_debug_utils_label != nullptr},
+      {"vkCmdEndDebugUtilsLabelEXT",
+       reinterpret_cast<PFN_vkVoidFunction>(&CmdEndDebugUtilsLabelEXT),
+       data == nullptr || data->cmd_end_debug_utils_label != nullptr},
+      {"vkQueueSubmit", reinterpret_cast<PFN_vkVoidFunction>(&QueueSubmit),
+       true},
+      {"vkQueuePresentKHR",
+       reinterpret_cast<PFN_vkVoidFunction>(&QueuePresentKHR),
+       data == nullptr || data->queue_present != nullptr},
+  };
+  for (const Interception& interception : interceptions) {
+    if (strcmp(name, interception.name) == 0) {
+      return interception.available ? interception.function : nullptr;
+    }
+  }
+  return nullptr;
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(VkDevice device,
+                                                           const char* name) {
+  DeviceData* data = GetDeviceData(GetDispatchKey(device));
+  if (data == nullptr) return nullptr;
+  if (PFN_vkVoidFunction function = GetInterceptedDeviceFunction(data, name);
+      function != nullptr) {
+    return function;
+  }
+  return data->get_device_proc_addr(device, name);
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+GetInstanceProcAddr(VkInstance instance, const char* name) {
+  if (strcmp(name, "vkGetInstanceProcAddr") == 0) {
+    return reinterpret_cast<PFN_vkVoidFunction>(&GetInstanceProcAddr);
+  }
+  if (strcmp(name, "vkCreateInstance") == 0) {
+    return reinterpret_cast<PFN_vkVoidFunction>(&CreateInstance);
+  }
+  if (strcmp(name, "vkDestroyInstance") == 0) {
+    return reinterpret_cast<PFN_vkVoidFunction>(&DestroyInstance);
+  }
+  if (strcmp(name, "vkCreateDevice") == 0) {
+    return reinterpret_cast<PFN_vkVoidFunction>(&CreateDevice);
+  }
+  if (strcmp(name, "vkEnumerateDeviceExtensionProperties") == 0) {
+    return reinterpret_cast<PFN_vkVoidFunction>(
+        &EnumerateDeviceExtensionProperties);
+  }
+  if (PFN_vkVoidFunction function = GetInterceptedDeviceFunction(nullptr, name);
+      function != nullptr) {
+    return function;
+  }
+  if (instance == VK_NULL_HANDLE) return nullptr;
+  InstanceData* data = GetInstanceData(GetDispatchKey(instance));
+  if (data == nullptr) return nullptr;
+  return data->get_instance_proc_addr(instance, name);
+}
+
+}  // namespace
+
+}  // namespace orbit_vulkan_layer
+
+ORBIT_VULKAN_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkNegotiateLoaderLayerInterfaceVersion(
+    VkNegotiateLayerInterface* version_struct) {
+  if (version_struct == nullptr ||
+      version_struct->sType != LAYER_NEGOTIATE_INTERFACE_STRUCT) {
+    return VK_ERROR_INITIALIZATION_FAILED;
+  }
+  version_struct->loaderLayerInterfaceVersion =
+      std::min<uint32_t>(version_struct->loaderLayerInterfaceVersion, 2);
+  version_struct->pfnGetInstanceProcAddr =
+      &orbit_vulkan_layer::GetInstanceProcAddr;
+  version_struct->pfnGetDeviceProcAddr = &orbit_vulkan_layer::GetDeviceProcAddr;
+  version_struct->pfnGetPhysicalDeviceProcAddr = nullptr;
+  return VK_SUCCESS;
+}
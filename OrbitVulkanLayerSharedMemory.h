@@ -0,0 +1,70 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_VULKAN_LAYER_SHARED_MEMORY_H_
+#define ORBIT_VULKAN_LAYER_SHARED_MEMORY_H_
+
+#include <stdint.h>
+
+#include <atomic>
+
+// The layout of the shared-memory ring buffer through which OrbitVulkanLayer
+// reports the GPU times of the command buffers submitted by a process, and of
+// the debug label regions in them, shared by the process (the producer) and
+// OrbitService (the consumer).
+//
+// The layer creates one buffer per process, the file
+// /dev/shm/orbit_vulkan_layer.<pid>, which it removes when the process
+// unloads it. The threads of the process write under a lock of the layer, only
+// OrbitService advances read_index and sets enabled while it captures the
+// process.
+//
+// The slices of a vkQueueSubmit are written consecutively with the same
+// submission_index, all of them or none.
+
+namespace orbit_vulkan_layer {
+
+constexpr uint32_t kSharedMemoryMagic = 0x4f52564b;  // "ORVK"
+constexpr uint32_t kSharedMemorySliceCount = 1u << 14;
+constexpr uint32_t kSharedMemoryLabelLength = 64;
+constexpr const char kSharedMemoryDirectory[] = "/dev/shm/";
+constexpr const char kSharedMemoryFilePrefix[] = "orbit_vulkan_layer.";
+
+// A command buffer, at depth 0, or a debug label region in it, at the depth
+// of its nesting in the command buffer. All timestamps are CLOCK_MONOTONIC:
+// the GPU timestamps are converted with VK_EXT_calibrated_timestamps.
+struct SharedMemorySlice {
+  uint64_t submission_index;
+  int32_t submit_tid;
+  uint32_t depth;
+  // Around the vkQueueSubmit, on the CPU.
+  uint64_t submit_begin_timestamp_ns;
+  uint64_t submit_end_timestamp_ns;
+  // On the GPU.
+  uint64_t begin_timestamp_ns;
+  uint64_t end_timestamp_ns;
+  // Empty for a command buffer, cut and null-terminated for a label.
+  char label[kSharedMemoryLabelLength];
+};
+
+struct SharedMemoryBuffer {
+  // Set last by the producer, once the other fields are.
+  std::atomic<uint32_t> magic;
+  uint32_t slice_count;
+  int32_t pid;
+  std::atomic<uint32_t> enabled;
+  // Slices that didn't fit, with the other slices of their submission.
+  std::atomic<uint64_t> dropped_slice_count;
+  alignas(64) std::atomic<uint64_t> write_index;
+  alignas(64) std::atomic<uint64_t> read_index;
+  alignas(64) SharedMemorySlice slices[kSharedMemorySliceCount];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "The atomics of SharedMemoryBuffer must be lock-free to be "
+              "shared between processes");
+
+}  // namespace orbit_vulkan_layer
+
+#endif  // ORBIT_VULKAN_LAYER_SHARED_MEMORY_H_
@@ -0,0 +1,8 @@
+# Copyright (c) 2020 The Orbit Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+if(NOT TARGET benchmark::benchmark)
+  add_library(benchmark::benchmark INTERFACE IMPORTED)
+  target_link_libraries(benchmark::benchmark INTERFACE CONAN_PKG::benchmark)
+endif()